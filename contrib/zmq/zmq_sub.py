@@ -17,6 +17,8 @@ zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "hashtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "rawblock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "rawtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "checkedblock")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "rawblockheader")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, "compactblock")
 zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
 try:
@@ -43,6 +45,12 @@ try:
         elif topic == "checkedblock":
             print '- CHECKED BLOCK ('+sequence+') -'
             print binascii.hexlify(body[:80])
+        elif topic == "rawblockheader":
+            print '- RAW BLOCK HEADER ('+sequence+') -'
+            print binascii.hexlify(body)
+        elif topic == "compactblock":
+            print '- COMPACT BLOCK ('+sequence+') -'
+            print binascii.hexlify(body)
 
 except KeyboardInterrupt:
     zmqContext.destroy()
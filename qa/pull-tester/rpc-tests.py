@@ -73,6 +73,7 @@ BASE_SCRIPTS= [
     'fundrawtransaction.py',
     'reorg_limit.py',
     'mempool_limit.py',
+    'mempool_persist.py',
     'p2p-fullblocktest.py',
     # vv Tests less than 30s vv
     'wallet_1941.py',
@@ -9,18 +9,31 @@
 #
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, str_to_b64str
+from test_framework.util import assert_equal, start_nodes, str_to_b64str
 
 import http.client
+import json
+import os
+import socket
 import urllib.parse
 
+class UnixHTTPConnection(http.client.HTTPConnection):
+    def __init__(self, path):
+        super().__init__('localhost')
+        self.socket_path = path
+
+    def connect(self):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(self.socket_path)
+
 class HTTPBasicsTest (BitcoinTestFramework):
     def __init__(self):
         super().__init__()
         self.num_nodes = 3
 
     def setup_network(self):
-        self.nodes = self.setup_nodes()
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir,
+                                 extra_args=[[], [], ['-rpcunixsocket=rpc.sock']])
 
     def run_test(self):
 
@@ -108,6 +121,21 @@ class HTTPBasicsTest (BitcoinTestFramework):
         out1 = conn.getresponse()
         assert_equal(out1.status, http.client.BAD_REQUEST)
 
+        # node2 also listens on a Unix socket, which serves the same calls
+        conn = UnixHTTPConnection(os.path.join(self.options.tmpdir, 'node2', 'regtest', 'rpc.sock'))
+        conn.request('POST', '/', '{"method": "getblockcount"}', headers)
+        out1 = conn.getresponse().read()
+        assert_equal(json.loads(out1)['result'], self.nodes[2].getblockcount())
+
+        # Hex results are sent as raw bytes to clients that accept them
+        besthash = self.nodes[2].getbestblockhash()
+        headers['Accept'] = 'application/octet-stream'
+        conn.request('POST', '/', '{"method": "getblock", "params": ["%s", 0]}' % besthash, headers)
+        out1 = conn.getresponse()
+        assert_equal(out1.getheader('Content-Type'), 'application/octet-stream')
+        assert_equal(out1.read(), bytes.fromhex(self.nodes[2].getblock(besthash, 0)))
+        conn.close()
+
 
 if __name__ == '__main__':
     HTTPBasicsTest().main()
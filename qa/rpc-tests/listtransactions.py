@@ -132,5 +132,15 @@ class ListTransactionsTest(BitcoinTestFramework):
                            {"category":"receive","amount":Decimal("0.1"),"amountZat":10000000},
                            {"txid":txid, "involvesWatchonly": True} )
 
+        # Paging with a cursor gives the same entries as one big call
+        everything = self.nodes[1].listtransactions("*", 1000)
+        paged = []
+        page = self.nodes[1].listtransactions("*", 3, 0, False, None, -1)
+        while page:
+            assert len(page) >= 3 or len(paged) + len(page) == len(everything)
+            paged = page + paged
+            page = self.nodes[1].listtransactions("*", 3, 0, False, None, page[0]["orderpos"])
+        assert_equal(paged, everything)
+
 if __name__ == '__main__':
     ListTransactionsTest().main()
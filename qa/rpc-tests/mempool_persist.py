@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# Copyright (c) 2014-2017 The Bitcoin Core developers
+# Copyright (c) 2025 The Juno Cash developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#
+# Test mempool persistence.
+#
+# By default, junocashd will dump mempool on shutdown and then reload it on
+# startup. This can be overridden with the -persistmempool=0 command line
+# option.
+#
+# Test is as follows:
+#
+# - node0 shields three coinbase outputs, which are relayed to node1 and
+#   node2. node1 prioritises one of them.
+# - Restart node1 and node2. node1 reloads the transactions, with the fee
+#   delta, from mempool.dat. node2 is started with -persistmempool=0 and
+#   comes back with an empty mempool.
+# - Restart node1 with -persistmempool=0. Its mempool is empty, and its
+#   mempool.dat is left alone.
+# - Restart node1 again with the default. The transactions come back.
+#
+# The wallets of node1 and node2 do not know these transactions, so only
+# mempool.dat can bring them back.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    NU5_BRANCH_ID,
+    assert_equal,
+    get_coinbase_address,
+    nuparams,
+    start_node,
+    start_nodes,
+    stop_node,
+    wait_and_assert_operationid_status,
+)
+from test_framework.zip317 import conventional_fee
+
+from decimal import Decimal
+import os
+import time
+
+FEE_DELTA = 1000
+
+
+class MempoolPersistTest(BitcoinTestFramework):
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 3
+
+    def setup_nodes(self):
+        return start_nodes(self.num_nodes, self.options.tmpdir, extra_args=[[
+            nuparams(NU5_BRANCH_ID, 205),
+        ]] * self.num_nodes)
+
+    def restart_node(self, i, extra_args=[]):
+        stop_node(self.nodes[i], i)
+        self.nodes[i] = start_node(i, self.options.tmpdir, [nuparams(NU5_BRANCH_ID, 205)] + extra_args)
+
+    def wait_for_mempool(self, node, size):
+        # The mempool is loaded in the background after startup
+        for _ in range(60):
+            if len(node.getrawmempool()) == size:
+                break
+            time.sleep(1)
+        assert_equal(size, len(node.getrawmempool()))
+
+    def run_test(self):
+        self.nodes[0].generate(10)
+        self.sync_all()
+
+        acct = self.nodes[0].z_getnewaccount()['account']
+        ua = self.nodes[0].z_getaddressforaccount(acct, ['orchard'])['address']
+
+        fee = conventional_fee(3)
+        txids = []
+        for _ in range(3):
+            recipients = [{"address": ua, "amount": Decimal('10') - fee}]
+            opid = self.nodes[0].z_sendmany(get_coinbase_address(self.nodes[0]), recipients, 1, fee, 'AllowRevealedSenders')
+            txids.append(wait_and_assert_operationid_status(self.nodes[0], opid))
+        self.sync_all()
+        for node in self.nodes:
+            assert_equal(set(txids), set(node.getrawmempool()))
+
+        self.nodes[1].prioritisetransaction(txids[0], 0, FEE_DELTA)
+        mempool = self.nodes[1].getrawmempool(True)
+        assert_equal(mempool[txids[0]]['fee'] + Decimal(FEE_DELTA) / 10**8, mempool[txids[0]]['modifiedfee'])
+
+        print("Restart node1 with mempool persistence and node2 without")
+        self.restart_node(1)
+        self.restart_node(2, ['-persistmempool=0'])
+        self.wait_for_mempool(self.nodes[1], 3)
+        assert_equal(set(txids), set(self.nodes[1].getrawmempool()))
+        # Give node2 the same time to load anything, which it must not
+        time.sleep(5)
+        assert_equal(0, len(self.nodes[2].getrawmempool()))
+
+        # The fee delta was saved with the transactions
+        mempool = self.nodes[1].getrawmempool(True)
+        assert_equal(mempool[txids[0]]['fee'] + Decimal(FEE_DELTA) / 10**8, mempool[txids[0]]['modifiedfee'])
+        assert_equal(mempool[txids[1]]['fee'], mempool[txids[1]]['modifiedfee'])
+
+        print("Restart node1 without mempool persistence")
+        mempooldat = os.path.join(self.options.tmpdir, 'node1', 'regtest', 'mempool.dat')
+        assert os.path.isfile(mempooldat)
+        self.restart_node(1, ['-persistmempool=0'])
+        time.sleep(5)
+        assert_equal(0, len(self.nodes[1].getrawmempool()))
+
+        print("Restart node1 with mempool persistence again")
+        # -persistmempool=0 neither loaded nor overwrote mempool.dat
+        assert os.path.isfile(mempooldat)
+        self.restart_node(1)
+        self.wait_for_mempool(self.nodes[1], 3)
+        assert_equal(set(txids), set(self.nodes[1].getrawmempool()))
+
+
+if __name__ == '__main__':
+    MempoolPersistTest().main()
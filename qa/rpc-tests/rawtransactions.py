@@ -180,5 +180,25 @@ class RawTransactionsTest(BitcoinTestFramework):
         decrawtx= self.nodes[0].decoderawtransaction(rawtx)
         assert_equal(decrawtx['vin'][0]['sequence'], 1000)
 
+        ##############################################
+        # sendrawtransactions gives a result for each #
+        ##############################################
+        missingtx = self.nodes[0].signrawtransaction(rawtx)['hex']
+        utxo = self.nodes[2].listunspent()[0]
+        inputs = [{'txid' : utxo['txid'], 'vout' : utxo['vout']}]
+        outputs = { self.nodes[0].getnewaddress() : utxo['amount'] - Decimal('0.001') }
+        goodtx = self.nodes[2].signrawtransaction(self.nodes[2].createrawtransaction(inputs, outputs))['hex']
+        results = self.nodes[2].sendrawtransactions([missingtx, "00", goodtx, goodtx])
+        assert_equal(len(results), 4)
+        assert_equal(results[0]['error']['message'], "Missing inputs")
+        assert_equal(results[1]['error']['code'], -22)
+        assert 'txid' not in results[1]
+        # The second copy is already in the mempool, which is not an error
+        assert 'error' not in results[2]
+        assert 'error' not in results[3]
+        assert_equal(results[2]['txid'], results[3]['txid'])
+        self.sync_all()
+        assert results[2]['txid'] in self.nodes[0].getrawmempool()
+
 if __name__ == '__main__':
     RawTransactionsTest().main()
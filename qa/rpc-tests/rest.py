@@ -289,6 +289,30 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(response_header_json_str)
         assert_equal(len(json_obj), 5) # now we should have 5 header objects
 
+        # the same headers by height
+        bb_height = rpc_block_json['height']
+        response_range_json = http_get_call(url.hostname, url.port, '/rest/headers/'+str(bb_height)+'/5'+self.FORMAT_SEPARATOR+"json")
+        assert_equal(json.loads(response_range_json), json_obj)
+        response_range_bin = http_get_call(url.hostname, url.port, '/rest/headers/'+str(bb_height)+'/1'+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response_range_bin.status, 200)
+        assert_equal(response_range_bin.read(), response_header_str)
+
+        # blocks by height, framed as in the block files
+        response_range = http_get_call(url.hostname, url.port, '/rest/blockrange/'+str(bb_height)+'/2'+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response_range.status, 200)
+        f = BytesIO(response_range.read())
+        blocks = []
+        while True:
+            prefix = f.read(8)
+            if len(prefix) == 0:
+                break
+            size = struct.unpack(b"<I", prefix[4:])[0]
+            blocks.append(f.read(size))
+        assert_equal(len(blocks), 2)
+        assert_equal(blocks[0], response_str)
+        response_range = http_get_call(url.hostname, url.port, '/rest/blockrange/'+str(bb_height)+'/1'+self.FORMAT_SEPARATOR+"json", True)
+        assert_equal(response_range.status, 404)
+
         # do tx test
         tx_hash = block_json_obj['tx'][0]['txid'];
         json_string = http_get_call(url.hostname, url.port, '/rest/tx/'+tx_hash+self.FORMAT_SEPARATOR+"json")
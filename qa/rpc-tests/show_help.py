@@ -418,6 +418,9 @@ Debugging/Testing options:
 |  -nuparams=hexBranchId:activationHeight
 |       Use given activation height for specified network upgrade (regtest-only)
 |
+|  -regtestfastpow
+|       Use a BLAKE2b hash instead of RandomX for proof of work (regtest-only)
+|
 |  -nurejectoldversions
 |       Reject peers that don't know about the current epoch (regtest-only)
 |       (default: 1)
@@ -570,6 +573,11 @@ RPC server options:
        Listen for JSON-RPC connections on <port> (default: 8232 or testnet:
        18232)
 
+  -rpcunixsocket=<path>
+       Also listen for JSON-RPC and REST connections on the Unix domain socket
+       <path>, for services on the same host. Relative paths are prefixed by
+       the data dir; only the user running the node may connect
+
   -rpcallowip=<ip>
        Allow JSON-RPC connections from specified source. Valid for <ip> are a
        single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0)
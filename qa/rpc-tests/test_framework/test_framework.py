@@ -27,6 +27,7 @@ from .util import (
     enable_coverage,
     check_json_precision,
     PortSeed,
+    PoWMode,
 )
 
 
@@ -120,6 +121,8 @@ class BitcoinTestFramework(object):
                           help="The seed to use for assigning port numbers (default: current process id)")
         parser.add_option("--coveragedir", dest="coveragedir",
                           help="Write tested RPC commands into this directory")
+        parser.add_option("--randomx", dest="randomx", default=False, action="store_true",
+                          help="Mine and verify blocks with RandomX instead of the fast regtest hash")
         self.add_options(parser)
         (self.options, self.args) = parser.parse_args()
 
@@ -132,6 +135,7 @@ class BitcoinTestFramework(object):
             enable_coverage(self.options.coveragedir)
 
         PortSeed.n = self.options.port_seed
+        PoWMode.randomx = self.options.randomx
 
         os.environ['PATH'] = self.options.srcdir+":"+os.environ['PATH']
 
@@ -60,6 +60,14 @@ class PortSeed:
     # Must be initialized with a unique integer for each process
     n = None
 
+class PoWMode:
+    # Nodes hash with a cheap BLAKE2b (-regtestfastpow) unless this is set by
+    # --randomx, in which case they mine and verify real RandomX
+    randomx = False
+
+def pow_args():
+    return [] if PoWMode.randomx else ['-regtestfastpow']
+
 def enable_coverage(dirname):
     """Maintain a log of which RPC calls are made during testing."""
     global COVERAGE_DIR
@@ -266,6 +274,7 @@ def initialize_chain(test_dir, num_nodes, cachedir, cache_behavior='current'):
                 '-nuparams=76b809bb:1', # Sapling
                 '-mocktime=%d' % block_time
             ])
+            args.extend(pow_args())
             if i > 0:
                 args.append("-connect=127.0.0.1:"+str(p2p_port(0)))
             bitcoind_processes[i] = subprocess.Popen(args)
@@ -308,7 +317,7 @@ def initialize_chain(test_dir, num_nodes, cachedir, cache_behavior='current'):
         for i in range(MAX_NODES):
             # record the system time at which the cache was regenerated
             with open(node_file(cachedir, i, 'cache_config.json'), "w", encoding="utf8") as cache_conf_file:
-                cache_config = { "cache_time": time.time() }
+                cache_config = { "cache_time": time.time(), "randomx": PoWMode.randomx }
                 cache_conf_json = json.dumps(cache_config, indent=4)
                 cache_conf_file.write(cache_conf_json)
 
@@ -371,6 +380,10 @@ def initialize_chain(test_dir, num_nodes, cachedir, cache_behavior='current'):
             if os.path.isdir(node_path):
                 if not os.path.isfile(node_file(cachedir, i, 'cache_config.json')):
                     return True
+                # Blocks mined with one hash are invalid under the other
+                with open(node_file(cachedir, i, 'cache_config.json'), "r", encoding="utf8") as cache_conf_file:
+                    if json.load(cache_conf_file).get("randomx", True) != PoWMode.randomx:
+                        return True
             else:
                 return True
         return False
@@ -488,6 +501,7 @@ def start_node(i, dirname, extra_args=None, rpchost=None, timewait=None, binary=
         '-nuparams=5ba81b19:1', # Overwinter
         '-nuparams=76b809bb:1', # Sapling
     ])
+    args.extend(pow_args())
     if extra_args is not None: args.extend(extra_args)
     bitcoind_processes[i] = subprocess.Popen(args, stderr=stderr)
     if os.getenv("PYTHON_DEBUG", ""):
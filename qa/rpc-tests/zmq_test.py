@@ -99,6 +99,16 @@ class ZMQTest(BitcoinTestFramework):
 
         assert_equal(hashRPC, hashZMQ) #blockhash from generate must be equal to the hash received over zmq
 
+        # every message was published, and numbered per topic
+        notifications = self.nodes[0].getzmqnotifications()
+        assert_equal(sorted(n['type'] for n in notifications), ['pubhashblock', 'pubhashtx'])
+        for n in notifications:
+            assert_equal(n['address'], 'tcp://127.0.0.1:'+str(self.port))
+            assert_equal(n['hwm'], 1000)
+            assert_equal(n['dropped'], 0)
+            if n['type'] == 'pubhashblock':
+                assert_equal(n['sequence'], blockcount+1)
+
 
 if __name__ == '__main__':
     ZMQTest ().main ()
@@ -58,7 +58,7 @@ function use_200k_benchmark {
 
 function zcashd_start {
     case "$1" in
-        sendtoaddress|loadwallet|listunspent)
+        sendtoaddress|loadwallet|listunspent|zlistunspent|getbalanceforaccounts|selectnotes|setbestchain|rescanwallet)
             case "$2" in
                 200k-recv)
                     use_200k_benchmark 0
@@ -89,7 +89,7 @@ function zcashd_stop {
 function zcashd_heaptrack_start {
     TEST_NAME="$1"
     case "$1" in
-        sendtoaddress|loadwallet|listunspent)
+        sendtoaddress|loadwallet|listunspent|zlistunspent|getbalanceforaccounts|selectnotes|setbestchain|rescanwallet)
             case "$2" in
                 200k-recv)
                     use_200k_benchmark 0
@@ -242,6 +242,9 @@ case "$1" in
                 extract_benchmark_data_1708048
                 zcash_rpc zcbenchmark connectblockorchard 10
                 ;;
+            historytreeupdate)
+                zcash_rpc zcbenchmark historytreeupdate 10 "${@:3}"
+                ;;
             sendtoaddress)
                 zcash_rpc zcbenchmark sendtoaddress 10 "${@:4}"
                 ;;
@@ -251,6 +254,9 @@ case "$1" in
             listunspent)
                 zcash_rpc zcbenchmark listunspent 10
                 ;;
+            zlistunspent|getbalanceforaccounts|selectnotes|setbestchain|rescanwallet)
+                zcash_rpc zcbenchmark "$2" 10
+                ;;
             *)
                 zcashd_stop
                 echo "Bad arguments to time."
@@ -312,6 +318,9 @@ case "$1" in
                 extract_benchmark_data_1708048
                 zcash_rpc zcbenchmark connectblockorchard 1
                 ;;
+            historytreeupdate)
+                zcash_rpc zcbenchmark historytreeupdate 1 "${@:3}"
+                ;;
             sendtoaddress)
                 zcash_rpc zcbenchmark sendtoaddress 1 "${@:4}"
                 ;;
@@ -321,6 +330,9 @@ case "$1" in
             listunspent)
                 zcash_rpc zcbenchmark listunspent 1
                 ;;
+            zlistunspent|getbalanceforaccounts|selectnotes|setbestchain|rescanwallet)
+                zcash_rpc zcbenchmark "$2" 1
+                ;;
             *)
                 zcashd_heaptrack_stop
                 echo "Bad arguments to memory."
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 The Juno Cash developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#
+# Benchmark wallet operations against a large Orchard wallet
+#
+# Builds a wallet holding --notes Orchard notes spread across --accounts
+# accounts, then times loading it, rescanning the chain, per-account balance
+# queries, z_listunspent, note selection and the SetBestChain flush with the
+# zcbenchmark RPC. The results are printed as JSON, and written to --output
+# if it is given.
+#
+# To use:
+# - Copy to qa/rpc-tests/wallet_benchmarks.py
+# - Add wallet_benchmarks.py to RPC tests list
+# - ./qa/pull-tester/rpc-tests.sh wallet_benchmarks --accounts=10 --notes=5000 --output=/tmp/wallet.json
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_greater_than,
+    connect_nodes_bi,
+    get_coinbase_address,
+    initialize_chain_clean,
+    start_nodes,
+    wait_and_assert_operationid_status,
+)
+
+from decimal import Decimal
+import json
+import statistics
+
+NOTE_VALUE = Decimal('0.001')
+OUTPUTS_PER_TX = 50
+
+BENCHMARKS = [
+    'loadwallet',
+    'rescanwallet',
+    'getbalanceforaccounts',
+    'zlistunspent',
+    'selectnotes',
+    'setbestchain',
+]
+
+class WalletBenchmarks(BitcoinTestFramework):
+
+    def add_options(self, parser):
+        parser.add_option("--accounts", dest="accounts", default=10, type='int',
+                          help="Number of accounts in the benchmarked wallet")
+        parser.add_option("--notes", dest="notes", default=1000, type='int',
+                          help="Number of Orchard notes in the benchmarked wallet")
+        parser.add_option("--samples", dest="samples", default=5, type='int',
+                          help="Number of samples taken of each benchmark")
+        parser.add_option("--output", dest="output", default=None,
+                          help="File to which the JSON results are written")
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 2)
+
+    def setup_network(self):
+        self.nodes = start_nodes(2, self.options.tmpdir)
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.is_network_split = False
+        self.sync_all()
+
+    def fund_sender(self):
+        self.nodes[0].generate(101 + self.options.notes // OUTPUTS_PER_TX)
+        self.sync_all()
+
+        account = self.nodes[0].z_getnewaccount()['account']
+        ua = self.nodes[0].z_getaddressforaccount(account, ['orchard'])['address']
+        opid = self.nodes[0].z_shieldcoinbase(
+            get_coinbase_address(self.nodes[0]), ua, None, 0)['opid']
+        wait_and_assert_operationid_status(self.nodes[0], opid)
+        self.nodes[0].generate(1)
+        self.sync_all()
+        return ua
+
+    def build_wallet(self):
+        source = self.fund_sender()
+
+        recipients = []
+        for _ in range(self.options.accounts):
+            account = self.nodes[1].z_getnewaccount()['account']
+            recipients.append(
+                self.nodes[1].z_getaddressforaccount(account, ['orchard'])['address'])
+
+        remaining = self.options.notes
+        while remaining > 0:
+            count = min(remaining, OUTPUTS_PER_TX)
+            outputs = [
+                {"address": recipients[(remaining - i) % len(recipients)], "amount": NOTE_VALUE}
+                for i in range(count)
+            ]
+            opid = self.nodes[0].z_sendmany(source, outputs, 1, None)
+            wait_and_assert_operationid_status(self.nodes[0], opid)
+            # Mine each batch so that the next one can spend the change.
+            self.nodes[0].generate(1)
+            self.sync_all()
+            remaining -= count
+
+        # Bury the notes so that every one of them is spendable.
+        self.nodes[0].generate(10)
+        self.sync_all()
+
+        notes = len(self.nodes[1].z_listunspent())
+        assert_greater_than(notes + 1, self.options.notes)
+        return notes
+
+    def run_test(self):
+        assert_greater_than(self.options.accounts, 0)
+        notes = self.build_wallet()
+        blocks = self.nodes[1].getblockcount()
+
+        results = {
+            'accounts': self.options.accounts,
+            'notes': notes,
+            'blocks': blocks,
+            'samples': self.options.samples,
+            'benchmarks': {},
+        }
+        for benchmark in BENCHMARKS:
+            times = [
+                sample['runningtime']
+                for sample in self.nodes[1].zcbenchmark(benchmark, self.options.samples)
+            ]
+            result = {
+                'median': statistics.median(times),
+                'min': min(times),
+                'max': max(times),
+            }
+            if benchmark == 'rescanwallet':
+                result['blocks_per_second'] = blocks / result['median']
+            results['benchmarks'][benchmark] = result
+
+        output = json.dumps(results, indent=2)
+        print(output)
+        if self.options.output is not None:
+            with open(self.options.output, 'w') as f:
+                f.write(output + '\n')
+
+
+if __name__ == '__main__':
+    WalletBenchmarks().main()
@@ -223,6 +223,44 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+// Running totals of the address index entries of one address, kept up to
+// date as blocks are indexed so that its balance can be read in one lookup.
+struct CAddressSummary {
+    CAmount balance;
+    CAmount received;
+    uint32_t txCount;
+    int firstHeight;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+        READWRITE(firstHeight);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummary() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        firstHeight = 0;
+        lastHeight = 0;
+    }
+
+    // An address that no indexed transaction touches has no record.
+    bool IsNull() const {
+        return (txCount == 0);
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
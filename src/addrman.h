@@ -5,6 +5,7 @@
 #ifndef BITCOIN_ADDRMAN_H
 #define BITCOIN_ADDRMAN_H
 
+#include "memusage.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
@@ -15,6 +16,7 @@
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -44,7 +46,7 @@ private:
     //! in tried set? (memory only)
     bool fInTried;
 
-    //! position in vRandom
+    //! position in vRandom, or -1 if this slot of the address table is unused
     int nRandomPos;
 
     friend class CAddrMan;
@@ -171,6 +173,19 @@ public:
 #define ADDRMAN_NEW_BUCKET_COUNT (1 << ADDRMAN_NEW_BUCKET_COUNT_LOG2)
 #define ADDRMAN_BUCKET_SIZE (1 << ADDRMAN_BUCKET_SIZE_LOG2)
 
+/** Salted hasher for the address index, so peers can't choose addresses that collide. */
+class CNetAddrHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    CNetAddrHasher();
+
+    size_t operator()(const CNetAddr& addr) const;
+};
+
 /** 
  * Stochastical (IP) address manager 
  */
@@ -180,14 +195,14 @@ private:
     //! critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
-    //! last used nId
-    int nIdCount;
+    //! table with information about all nIds, indexed by nId
+    std::vector<CAddrInfo> vInfo;
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    //! unused slots in vInfo, reused before the table grows
+    std::vector<int> vFreeIds;
 
     //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr;
+    std::unordered_map<CNetAddr, int, CNetAddrHasher> mapAddr;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -204,6 +219,12 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! Whether an nId refers to an entry in use.
+    bool IsUsed(int nId) const
+    {
+        return nId >= 0 && (size_t)nId < vInfo.size() && vInfo[nId].nRandomPos != -1;
+    }
+
 protected:
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -214,8 +235,8 @@ protected:
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int *pnId = NULL);
 
-    //! find an entry, creating it if necessary.
-    //! nTime and nServices of the found node are updated, if necessary.
+    //! Create an entry. The pointers returned by Find and Create are
+    //! invalidated by the next call to Create.
     CAddrInfo* Create(const CAddress &addr, const CNetAddr &addrSource, int *pnId = NULL);
 
     //! Swap two elements in vRandom.
@@ -256,6 +277,9 @@ protected:
     //! Mark an entry as currently-connected-to.
     void Connected_(const CService &addr, int64_t nTime);
 
+    //! Update an entry's service bits.
+    void SetServices_(const CService &addr, uint64_t nServices);
+
 public:
     /**
      * serialized format:
@@ -300,11 +324,13 @@ public:
 
         int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
         s << nUBuckets;
-        std::map<int, int> mapUnkIds;
+        std::vector<int> vUnkIds(vInfo.size(), -1);
         int nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            mapUnkIds[(*it).first] = nIds;
-            const CAddrInfo &info = (*it).second;
+        for (size_t n = 0; n < vInfo.size(); n++) {
+            const CAddrInfo &info = vInfo[n];
+            if (info.nRandomPos == -1)
+                continue;
+            vUnkIds[n] = nIds;
             if (info.nRefCount) {
                 assert(nIds != nNew); // this means nNew was wrong, oh ow
                 s << info;
@@ -312,9 +338,8 @@ public:
             }
         }
         nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            const CAddrInfo &info = (*it).second;
-            if (info.fInTried) {
+        for (const CAddrInfo &info : vInfo) {
+            if (info.nRandomPos != -1 && info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
                 nIds++;
@@ -329,7 +354,7 @@ public:
             s << nSize;
             for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
                 if (vvNew[bucket][i] != -1) {
-                    int nIndex = mapUnkIds[vvNew[bucket][i]];
+                    int nIndex = vUnkIds[vvNew[bucket][i]];
                     s << nIndex;
                 }
             }
@@ -365,9 +390,14 @@ public:
             throw std::ios_base::failure("Corrupt CAddrMan serialization, nTried exceeds limit.");
         }
 
+        vInfo.reserve(nNew + nTried);
+        vInfo.resize(nNew);
+        vRandom.reserve(nNew + nTried);
+        mapAddr.reserve(nNew + nTried);
+
         // Deserialize entries from the new table.
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = vInfo[n];
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
@@ -383,7 +413,6 @@ public:
                 }
             }
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -393,13 +422,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                int nId = vInfo.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                vInfo.push_back(info);
+                mapAddr[info] = nId;
+                vvTried[nKBucket][nKBucketPos] = nId;
             } else {
                 nLost++;
             }
@@ -414,7 +443,7 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo &info = mapInfo[nIndex];
+                    CAddrInfo &info = vInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
@@ -426,13 +455,10 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (int n = 0, nNewLoaded = nNew; n < nNewLoaded; n++) {
+            if (vInfo[n].nRefCount == 0) {
+                Delete(n);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -445,6 +471,9 @@ public:
     void Clear()
     {
         LOCK(cs);
+        std::vector<CAddrInfo>().swap(vInfo);
+        std::vector<int>().swap(vFreeIds);
+        mapAddr.clear();
         std::vector<int>().swap(vRandom);
         nKey = GetRandHash();
         for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
@@ -458,7 +487,6 @@ public:
             }
         }
 
-        nIdCount = 0;
         nTried = 0;
         nNew = 0;
     }
@@ -480,6 +508,15 @@ public:
         return vRandom.size();
     }
 
+    //! Memory used by the tables and the bucket arrays, in bytes.
+    size_t DynamicMemoryUsage() const
+    {
+        LOCK(cs);
+        return memusage::DynamicUsage(vInfo) + memusage::DynamicUsage(vFreeIds) +
+               memusage::DynamicUsage(mapAddr) + memusage::DynamicUsage(vRandom) +
+               sizeof(vvTried) + sizeof(vvNew);
+    }
+
     //! Consistency check
     void Check()
     {
@@ -575,6 +612,14 @@ public:
         Check();
     }
 
+    void SetServices(const CService &addr, uint64_t nServices)
+    {
+        LOCK(cs);
+        Check();
+        SetServices_(addr, nServices);
+        Check();
+    }
+
 };
 
 #endif // BITCOIN_ADDRMAN_H
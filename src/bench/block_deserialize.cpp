@@ -0,0 +1,49 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+// A block of transparent transactions, each spending two inputs with
+// signature-sized scripts into two P2PKH outputs.
+static std::vector<char> SerializedTransparentBlock()
+{
+    FastRandomContext rng(true);
+    CBlock block;
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(2);
+        for (auto& in : mtx.vin) {
+            in.prevout = COutPoint(rng.rand256(), 0);
+            std::vector<unsigned char> sig(107);
+            in.scriptSig = CScript(sig.begin(), sig.end());
+        }
+        mtx.vout.resize(2);
+        for (auto& out : mtx.vout) {
+            std::vector<unsigned char> script(25);
+            out.scriptPubKey = CScript(script.begin(), script.end());
+            out.nValue = 1000;
+        }
+        block.vtx.push_back(CTransaction(mtx));
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    return std::vector<char>(ss.begin(), ss.end());
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    std::vector<char> data = SerializedTransparentBlock();
+    while (state.KeepRunning()) {
+        CBlock block;
+        CSpanReader reader(SER_NETWORK, PROTOCOL_VERSION, data.data(), data.data() + data.size());
+        reader >> block;
+        assert(block.vtx.size() == 1000);
+    }
+}
+
+BENCHMARK(DeserializeBlock);
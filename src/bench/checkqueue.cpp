@@ -21,16 +21,19 @@ static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const unsigned int QUEUE_BATCH_SIZE = 128;
-static void CCheckQueueSpeed(benchmark::State& state)
+
+struct FakeJobNoWork {
+    bool operator()()
+    {
+        return true;
+    }
+    void swap(FakeJobNoWork& x){};
+};
+
+template <typename Queue>
+static void CheckQueueSpeed(benchmark::State& state)
 {
-    struct FakeJobNoWork {
-        bool operator()()
-        {
-            return true;
-        }
-        void swap(FakeJobNoWork& x){};
-    };
-    CCheckQueue<FakeJobNoWork> queue {QUEUE_BATCH_SIZE};
+    Queue queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
     for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
        tg.create_thread([&]{queue.Thread();});
@@ -62,22 +65,24 @@ static void CCheckQueueSpeed(benchmark::State& state)
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+struct PrevectorJob {
+    prevector<PREVECTOR_SIZE, uint8_t> p;
+    PrevectorJob(){
+    }
+    PrevectorJob(FastRandomContext& insecure_rand){
+        p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
+    }
+    bool operator()()
+    {
+        return true;
+    }
+    void swap(PrevectorJob& x){p.swap(x.p);};
+};
+
+template <typename Queue>
+static void CheckQueueSpeedPrevectorJob(benchmark::State& state)
 {
-    struct PrevectorJob {
-        prevector<PREVECTOR_SIZE, uint8_t> p;
-        PrevectorJob(){
-        }
-        PrevectorJob(FastRandomContext& insecure_rand){
-            p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
-        }
-        bool operator()()
-        {
-            return true;
-        }
-        void swap(PrevectorJob& x){p.swap(x.p);};
-    };
-    CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    Queue queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
     for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
        tg.create_thread([&]{queue.Thread();});
@@ -100,5 +105,27 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeed(benchmark::State& state)
+{
+    CheckQueueSpeed<CCheckQueue<FakeJobNoWork>>(state);
+}
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CheckQueueSpeedPrevectorJob<CCheckQueue<PrevectorJob>>(state);
+}
+
+// The same workloads on the work-stealing queue used for script checks.
+static void CWorkStealingCheckQueueSpeed(benchmark::State& state)
+{
+    CheckQueueSpeed<CWorkStealingCheckQueue<FakeJobNoWork>>(state);
+}
+static void CWorkStealingCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CheckQueueSpeedPrevectorJob<CWorkStealingCheckQueue<PrevectorJob>>(state);
+}
+
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CWorkStealingCheckQueueSpeed);
+BENCHMARK(CWorkStealingCheckQueueSpeedPrevectorJob);
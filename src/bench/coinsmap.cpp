@@ -0,0 +1,60 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "coins.h"
+#include "random.h"
+
+#include <boost/unordered_map.hpp>
+
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsNodeMap;
+
+static const size_t COINS_MAP_ENTRIES = 50000;
+
+// Shaped like a reindex: each created entry is looked up a few times, most
+// get spent and erased, and the rest are flushed by erasing while iterating.
+template <typename Map>
+static void CoinsMapWorkload(benchmark::State& state)
+{
+    std::vector<uint256> keys;
+    for (size_t i = 0; i < COINS_MAP_ENTRIES; i++) {
+        keys.push_back(GetRandHash());
+    }
+
+    while (state.KeepRunning()) {
+        Map map;
+        for (size_t i = 0; i < keys.size(); i++) {
+            auto ret = map.insert(std::make_pair(keys[i], CCoinsCacheEntry()));
+            ret.first->second.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+            if (i >= 8) {
+                const uint256& prev = keys[i - 8];
+                auto it = map.find(prev);
+                if (it != map.end() && (i & 3) != 0) {
+                    map.erase(it);
+                }
+            }
+        }
+        size_t found = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (map.find(keys[i]) != map.end()) found++;
+        }
+        assert(found == map.size());
+        for (auto it = map.begin(); it != map.end(); ) {
+            it = map.erase(it);
+        }
+    }
+}
+
+static void CoinsMapFlat(benchmark::State& state)
+{
+    CoinsMapWorkload<CCoinsMap>(state);
+}
+
+static void CoinsMapNodeBased(benchmark::State& state)
+{
+    CoinsMapWorkload<CCoinsNodeMap>(state);
+}
+
+BENCHMARK(CoinsMapFlat);
+BENCHMARK(CoinsMapNodeBased);
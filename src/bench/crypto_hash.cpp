@@ -49,6 +49,19 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+static void SHA256DMulti_1024(benchmark::State& state)
+{
+    // Transaction sized messages, as in a peer's queue of "tx" messages
+    std::vector<uint8_t> in(250 * 1024, 0);
+    std::vector<const unsigned char*> inputs;
+    std::vector<size_t> lengths(1024, 250);
+    for (size_t i = 0; i < 1024; ++i) inputs.push_back(in.data() + 250 * i);
+    std::vector<uint8_t> out(32 * 1024);
+    while (state.KeepRunning()) {
+        SHA256DMulti(out.data(), inputs.data(), lengths.data(), 1024);
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -85,5 +98,6 @@ BENCHMARK(SHA256);
 BENCHMARK(SHA512);
 
 BENCHMARK(SHA256D64_1024); // 7400
+BENCHMARK(SHA256DMulti_1024);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -0,0 +1,38 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+
+#include "zcash/IncrementalMerkleTree.hpp"
+
+// The number of Sapling outputs in a large block.
+static const size_t LEAVES = 1000;
+
+static std::vector<libzcash::PedersenHash> SaplingLeaves()
+{
+    return std::vector<libzcash::PedersenHash>(LEAVES, libzcash::PedersenHash::uncommitted());
+}
+
+static void SaplingTreeAppend(benchmark::State& state)
+{
+    auto leaves = SaplingLeaves();
+    while (state.KeepRunning()) {
+        SaplingMerkleTree tree;
+        for (const auto& leaf : leaves) {
+            tree.append(leaf);
+        }
+    }
+}
+
+static void SaplingTreeAppendBatch(benchmark::State& state)
+{
+    auto leaves = SaplingLeaves();
+    while (state.KeepRunning()) {
+        SaplingMerkleTree tree;
+        tree.append_batch(leaves);
+    }
+}
+
+BENCHMARK(SaplingTreeAppend);
+BENCHMARK(SaplingTreeAppendBatch);
@@ -8,6 +8,7 @@
 #include "support/lockedpool.h"
 
 #include <iostream>
+#include <thread>
 #include <vector>
 
 #define ASIZE 2048
@@ -44,4 +45,33 @@ static void LockedPool(benchmark::State& state)
     addr.clear();
 }
 
+#define CTHREADS 4
+#define CITER 20000
+
+/** Several threads allocating and freeing key-sized chunks of the live pool at
+ * once, as parallel signing and key derivation do.
+ */
+static void LockedPoolContention(benchmark::State& state)
+{
+    LockedPoolManager &pool = LockedPoolManager::Instance();
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < CTHREADS; ++t) {
+            threads.emplace_back([&pool, t]() {
+                void *addr[4] = {nullptr, nullptr, nullptr, nullptr};
+                for (int x = 0; x < CITER; ++x) {
+                    int idx = (x + t) & 3;
+                    pool.free(addr[idx]);
+                    addr[idx] = pool.alloc(32 << (x & 2));
+                }
+                for (void *ptr: addr)
+                    pool.free(ptr);
+            });
+        }
+        for (auto &thread: threads)
+            thread.join();
+    }
+}
+
 BENCHMARK(LockedPool);
+BENCHMARK(LockedPoolContention);
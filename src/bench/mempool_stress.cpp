@@ -0,0 +1,90 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "main.h"
+#include "random.h"
+#include "script/script.h"
+#include "txmempool.h"
+
+#include <list>
+#include <vector>
+
+static const size_t MEMPOOL_STRESS_TXS = 100000;
+// Transactions only depend on others in the same cluster, which keeps their
+// ancestor sets within the default limit.
+static const size_t MEMPOOL_STRESS_CLUSTER = 25;
+
+// Clusters of transactions that each spend one or two outputs of earlier
+// transactions in their cluster, the first of which spends a coin outside the
+// mempool.
+static std::vector<CTransaction> MakeClusters()
+{
+    FastRandomContext rng(true);
+    std::vector<CTransaction> vtx;
+    vtx.reserve(MEMPOOL_STRESS_TXS);
+    for (size_t i = 0; i < MEMPOOL_STRESS_TXS; i++) {
+        size_t nInCluster = i % MEMPOOL_STRESS_CLUSTER;
+        CMutableTransaction mtx;
+        if (nInCluster == 0) {
+            mtx.vin.emplace_back(COutPoint(GetRandHash(), 0));
+        } else {
+            size_t nInputs = nInCluster > 1 && rng.randbool() ? 2 : 1;
+            for (size_t j = 0; j < nInputs; j++) {
+                // Every transaction in a cluster spends outputs that no other
+                // transaction in it can, even if both inputs share a parent.
+                const CTransaction& parent = vtx[i - 1 - j - rng.randrange(nInCluster - j)];
+                mtx.vin.emplace_back(COutPoint(parent.GetHash(), nInCluster + j * MEMPOOL_STRESS_CLUSTER));
+            }
+        }
+        for (size_t j = 0; j < 2 * MEMPOOL_STRESS_CLUSTER; j++) {
+            mtx.vout.emplace_back(1000, CScript() << OP_TRUE);
+        }
+        vtx.emplace_back(mtx);
+    }
+    return vtx;
+}
+
+static void AddToMempool(CTxMemPool& pool, const CTransaction& tx)
+{
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 10000, 0, 1, false, false, 1, 0));
+}
+
+// Fill a mempool with 100k transactions, mine the first two transactions of
+// every other cluster, reorg them back in, and evict the rest of the clusters
+// with their descendants.
+static void MempoolStress(benchmark::State& state)
+{
+    std::vector<CTransaction> vtx = MakeClusters();
+    std::vector<CTransaction> vBlock;
+    std::vector<uint256> vBlockHashes;
+    for (size_t i = 0; i < vtx.size(); i += 2 * MEMPOOL_STRESS_CLUSTER) {
+        vBlock.push_back(vtx[i]);
+        vBlock.push_back(vtx[i + 1]);
+        vBlockHashes.push_back(vtx[i].GetHash());
+        vBlockHashes.push_back(vtx[i + 1].GetHash());
+    }
+
+    while (state.KeepRunning()) {
+        CTxMemPool pool(::minRelayTxFee);
+        for (const CTransaction& tx : vtx) {
+            AddToMempool(pool, tx);
+        }
+
+        std::list<CTransaction> conflicts;
+        pool.removeForBlock(vBlock, 2, conflicts);
+        for (const CTransaction& tx : vBlock) {
+            AddToMempool(pool, tx);
+        }
+        pool.UpdateTransactionsFromBlock(vBlockHashes);
+
+        for (size_t i = MEMPOOL_STRESS_CLUSTER; i < vtx.size(); i += 2 * MEMPOOL_STRESS_CLUSTER) {
+            std::list<CTransaction> removed;
+            pool.remove(vtx[i], removed, true);
+        }
+        assert(pool.size() == vtx.size() / 2);
+    }
+}
+
+BENCHMARK(MempoolStress);
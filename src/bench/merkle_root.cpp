@@ -7,6 +7,7 @@
 #include "uint256.h"
 #include "random.h"
 #include "consensus/merkle.h"
+#include "primitives/block.h"
 
 static void MerkleRoot(benchmark::State& state)
 {
@@ -24,3 +25,19 @@ static void MerkleRoot(benchmark::State& state)
 }
 
 BENCHMARK(MerkleRoot); // 800
+
+static void AuthDataMerkleRoot(benchmark::State& state)
+{
+    CBlock block;
+    for (uint32_t i = 0; i < 9001; i++) {
+        CMutableTransaction mtx;
+        mtx.nLockTime = i;
+        block.vtx.push_back(CTransaction(mtx));
+    }
+    while (state.KeepRunning()) {
+        uint256 root = block.BuildAuthDataMerkleTree();
+        assert(!root.IsNull());
+    }
+}
+
+BENCHMARK(AuthDataMerkleRoot);
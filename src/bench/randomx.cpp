@@ -0,0 +1,181 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "crypto/randomx/randomx.h"
+#include "crypto/randomx_wrapper.h"
+#include "pow.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "uint256.h"
+#include "version.h"
+
+#include <algorithm>
+#include <thread>
+
+/* RandomX input size of a block header: 108-byte prefix and 32-byte nonce */
+static const size_t INPUT_SIZE = 140;
+
+// Seed used for the genesis epoch, see GetRandomXSeedHash
+static uint256 BenchSeed()
+{
+    uint256 seed;
+    *seed.begin() = 0x08;
+    return seed;
+}
+
+static void SetMode(bool fastMode)
+{
+    RandomX_Init(fastMode, false);
+    if (RandomX_IsFastMode() != fastMode || RandomX_IsUsingHugepages()) {
+        RandomX_ChangeMode(fastMode, false);
+    }
+}
+
+static void HashWithSeed(benchmark::State& state, bool fastMode)
+{
+    SetMode(fastMode);
+    uint256 seed = BenchSeed();
+    unsigned char input[INPUT_SIZE] = {};
+    uint256 hash;
+    uint64_t nonce = 0;
+
+    // Build the cache (and dataset) before timing
+    RandomX_Hash_WithSeed(seed.begin(), 32, input, sizeof(input), hash.begin());
+    while (state.KeepRunning()) {
+        WriteLE64(input + 108, ++nonce);
+        RandomX_Hash_WithSeed(seed.begin(), 32, input, sizeof(input), hash.begin());
+    }
+}
+
+static void RandomXHashLight(benchmark::State& state)
+{
+    HashWithSeed(state, false);
+}
+
+static void RandomXHashFast(benchmark::State& state)
+{
+    HashWithSeed(state, true);
+}
+
+// The miner's loop: each call finishes one hash and starts the next
+static void RandomXHashPipelined(benchmark::State& state)
+{
+    SetMode(false);
+    uint256 seed = BenchSeed();
+    randomx_vm* vm = RandomX_GetVM(seed.begin(), 32);
+    assert(vm);
+    unsigned char input[INPUT_SIZE] = {};
+    uint256 hash;
+    uint64_t nonce = 0;
+
+    RandomX_HashFirst(vm, input, sizeof(input));
+    while (state.KeepRunning()) {
+        WriteLE64(input + 108, ++nonce);
+        RandomX_HashNext(vm, input, sizeof(input), hash.begin());
+    }
+    RandomX_HashLast(vm, hash.begin());
+}
+
+static void RandomXInitCache(benchmark::State& state)
+{
+    randomx_cache* cache = randomx_alloc_cache(randomx_get_flags());
+    assert(cache);
+    uint256 seed = BenchSeed();
+    while (state.KeepRunning()) {
+        randomx_init_cache(cache, seed.begin(), 32);
+    }
+    randomx_release_cache(cache);
+}
+
+static void InitDataset(benchmark::State& state, int numThreads)
+{
+    randomx_cache* cache = randomx_alloc_cache(randomx_get_flags());
+    assert(cache);
+    uint256 seed = BenchSeed();
+    randomx_init_cache(cache, seed.begin(), 32);
+    randomx_dataset* dataset = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
+    assert(dataset);
+
+    while (state.KeepRunning()) {
+        RandomX_InitDatasetParallel(dataset, cache, numThreads);
+    }
+    randomx_release_dataset(dataset);
+    randomx_release_cache(cache);
+}
+
+static void RandomXInitDataset_1Thread(benchmark::State& state)
+{
+    InitDataset(state, 1);
+}
+
+static void RandomXInitDataset_4Threads(benchmark::State& state)
+{
+    InitDataset(state, 4);
+}
+
+static void RandomXInitDataset_AllThreads(benchmark::State& state)
+{
+    InitDataset(state, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+static CBlockHeader SolvedHeader(uint32_t nTime)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = nTime;
+    header.nBits = 0x207fffff;
+
+    CEquihashInput I{header};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << I;
+    ss << header.nNonce;
+    uint256 hash;
+    uint256 seed = BenchSeed();
+    RandomX_Hash_WithSeed(seed.begin(), 32, ss.data(), ss.size(), hash.begin());
+    header.nSolution.assign(hash.begin(), hash.end());
+    return header;
+}
+
+// Checks a header on top of index through the same path as block validation
+static void CheckSolution(benchmark::State& state, bool fChangeHeader)
+{
+    SetMode(false);
+    CBlockIndex index;
+    index.nHeight = 0;
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    CBlockHeader header = SolvedHeader(fChangeHeader ? 1 : 0);
+    assert(CheckRandomXSolution(&header, params, &index));
+    while (state.KeepRunning()) {
+        CheckRandomXSolution(&header, params, &index);
+        if (fChangeHeader) header.nTime++;
+    }
+}
+
+// A valid header already in the RandomX solution cache
+static void CheckRandomXSolutionCached(benchmark::State& state)
+{
+    CheckSolution(state, false);
+}
+
+// A new header each time, so every check serializes and hashes it. The
+// solution goes stale after the first change, which costs the same hash as a
+// valid one and keeps the solution cache from answering.
+static void CheckRandomXSolutionUncached(benchmark::State& state)
+{
+    CheckSolution(state, true);
+}
+
+BENCHMARK(RandomXHashLight);
+BENCHMARK(RandomXHashFast);
+BENCHMARK(RandomXHashPipelined);
+BENCHMARK(RandomXInitCache);
+BENCHMARK(RandomXInitDataset_1Thread);
+BENCHMARK(RandomXInitDataset_4Threads);
+BENCHMARK(RandomXInitDataset_AllThreads);
+BENCHMARK(CheckRandomXSolutionCached);
+BENCHMARK(CheckRandomXSolutionUncached);
@@ -3,15 +3,19 @@
 // file COPYING or https://www.opensource.org/licenses/mit-license.php .
 
 #include "bench.h"
+#include "blockprecompute.h"
 #include "coins.h"
 #include "consensus/upgrades.h"
 #include "keystore.h"
+#include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "script/interpreter.h"
 #include "script/sign.h"
 #include "streams.h"
 #include "uint256.h"
 #include "util/strencodings.h"
+#include "util/system.h"
 #include "version.h"
 
 #include "librustzcash.h"
@@ -135,7 +139,108 @@ static void SaplingOutput(benchmark::State& state)
     }
 }
 
+// A block of v5 transactions, each spending two outputs of the block's first
+// transaction, for measuring how long building their precomputed data takes.
+static const size_t PRECOMPUTE_BLOCK_TXS = 1000;
+
+static CBlock PrecomputeBlock()
+{
+    CScript scriptPubKey = CScript() << OP_1;
+
+    CMutableTransaction fund;
+    fund.fOverwintered = true;
+    fund.nVersionGroupId = ZIP225_VERSION_GROUP_ID;
+    fund.nVersion = ZIP225_TX_VERSION;
+    fund.nConsensusBranchId = NetworkUpgradeInfo[Consensus::UPGRADE_NU5].nBranchId;
+    fund.vout.resize(2 * PRECOMPUTE_BLOCK_TXS);
+    for (auto& out : fund.vout) {
+        out.nValue = 1000;
+        out.scriptPubKey = scriptPubKey;
+    }
+
+    CBlock block;
+    block.vtx.push_back(fund);
+    for (uint32_t i = 0; i < PRECOMPUTE_BLOCK_TXS; i++) {
+        CMutableTransaction mtx;
+        mtx.fOverwintered = true;
+        mtx.nVersionGroupId = ZIP225_VERSION_GROUP_ID;
+        mtx.nVersion = ZIP225_TX_VERSION;
+        mtx.nConsensusBranchId = fund.nConsensusBranchId;
+        mtx.vin.resize(2);
+        mtx.vin[0].prevout = COutPoint(block.vtx[0].GetHash(), 2 * i);
+        mtx.vin[1].prevout = COutPoint(block.vtx[0].GetHash(), 2 * i + 1);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 1500;
+        mtx.vout[0].scriptPubKey = scriptPubKey;
+        block.vtx.push_back(mtx);
+    }
+    return block;
+}
+
+// Building each transaction's precomputed data one after the other on a
+// single thread, for comparison with the block-scoped arena.
+static void PrecomputeBlockSerial(benchmark::State& state)
+{
+    CBlock block = PrecomputeBlock();
+    const CTransaction& fund = block.vtx[0];
+
+    while (state.KeepRunning()) {
+        std::vector<PrecomputedTransactionData> txdata;
+        txdata.reserve(block.vtx.size());
+        for (const CTransaction& tx : block.vtx) {
+            std::vector<CTxOut> allPrevOutputs;
+            for (const auto& input : tx.vin) {
+                allPrevOutputs.push_back(fund.vout[input.prevout.n]);
+            }
+            txdata.emplace_back(tx, allPrevOutputs);
+        }
+    }
+}
+
+static void PrecomputeBlockArena(benchmark::State& state)
+{
+    CBlock block = PrecomputeBlock();
+    CCoinsViewDummy viewDummy;
+    CCoinsViewCache view(&viewDummy);
+
+    while (state.KeepRunning()) {
+        CBlockPrecomputedData txdata(block, view, GetNumCores());
+    }
+}
+
+// Signatures by a few keys, as in a sweep of many inputs to one address.
+static void ECDSAVerifyBatch(benchmark::State& state)
+{
+    const size_t nSigs = 100;
+    std::vector<CKey> keys;
+    std::vector<CPubKey> pubkeys;
+    for (int i = 0; i < 4; i++) {
+        keys.push_back(CKey::TestOnlyRandomKey(true));
+        pubkeys.push_back(keys.back().GetPubKey());
+    }
+    std::vector<uint256> hashes(nSigs);
+    std::vector<std::vector<unsigned char>> sigs(nSigs);
+    std::vector<CPubKeySigCheck> checks;
+    for (size_t i = 0; i < nSigs; i++) {
+        hashes[i] = GetRandHash();
+        bool fSigned = keys[i % keys.size()].Sign(hashes[i], sigs[i]);
+        assert(fSigned);
+    }
+    for (size_t i = 0; i < nSigs; i++) {
+        checks.push_back({&pubkeys[i % keys.size()], &hashes[i], &sigs[i]});
+    }
+
+    std::vector<bool> vResult;
+    while (state.KeepRunning()) {
+        bool fValid = CPubKey::VerifyBatch(checks, vResult);
+        assert(fValid);
+    }
+}
+
 BENCHMARK(ECDSA);
+BENCHMARK(ECDSAVerifyBatch);
 BENCHMARK(JoinSplitSig);
 BENCHMARK(SaplingSpend);
 BENCHMARK(SaplingOutput);
+BENCHMARK(PrecomputeBlockSerial);
+BENCHMARK(PrecomputeBlockArena);
@@ -0,0 +1,97 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "bip324.h"
+
+#include "crypto/hkdf_sha256_32.h"
+
+#include <assert.h>
+#include <string.h>
+
+BIP324Cipher::BIP324Cipher(const CKey& keyIn, const unsigned char* entropy32) :
+    key(keyIn)
+{
+    ourPubKey = key.EllSwiftCreate(entropy32);
+}
+
+BIP324Cipher::BIP324Cipher(const CKey& keyIn, const EllSwiftPubKey& pubkeyIn) :
+    key(keyIn), ourPubKey(pubkeyIn)
+{
+}
+
+void BIP324Cipher::Initialize(const EllSwiftPubKey& theirPubKey, const CMessageHeader::MessageStartChars& pchMessageStart,
+                              bool fInitiator, bool fSelfDecrypt)
+{
+    ECDHSecret secret = key.ComputeBIP324ECDHSecret(theirPubKey, ourPubKey, fInitiator);
+
+    std::string salt = std::string("bitcoin_v2_shared_secret") + std::string((const char*)pchMessageStart, CMessageHeader::MESSAGE_START_SIZE);
+    CHKDF_HMAC_SHA256_L32 hkdf(secret.data(), secret.size(), salt);
+    // Whether we send with the initiator's keys.
+    const bool fSide = fInitiator != fSelfDecrypt;
+    unsigned char okm[CHKDF_HMAC_SHA256_L32::OUTPUT_SIZE];
+    hkdf.Expand32("initiator_L", okm);
+    (fSide ? sendLCipher : recvLCipher).emplace(okm, REKEY_INTERVAL);
+    hkdf.Expand32("initiator_P", okm);
+    (fSide ? sendPCipher : recvPCipher).emplace(okm, REKEY_INTERVAL);
+    hkdf.Expand32("responder_L", okm);
+    (fSide ? recvLCipher : sendLCipher).emplace(okm, REKEY_INTERVAL);
+    hkdf.Expand32("responder_P", okm);
+    (fSide ? recvPCipher : sendPCipher).emplace(okm, REKEY_INTERVAL);
+
+    // The initiator's terminator comes first.
+    hkdf.Expand32("garbage_terminators", okm);
+    memcpy(fSide ? sendGarbageTerminator : recvGarbageTerminator, okm, GARBAGE_TERMINATOR_LEN);
+    memcpy(fSide ? recvGarbageTerminator : sendGarbageTerminator, okm + GARBAGE_TERMINATOR_LEN, GARBAGE_TERMINATOR_LEN);
+
+    hkdf.Expand32("session_id", sessionId.begin());
+
+    // The ephemeral key is of no more use.
+    key = CKey();
+    memset(okm, 0, sizeof(okm));
+    memset(secret.data(), 0, secret.size());
+}
+
+void BIP324Cipher::Encrypt(const unsigned char* contents1, size_t len1, const unsigned char* contents2, size_t len2,
+                           const unsigned char* aad, size_t aadlen, bool fIgnore, unsigned char* output)
+{
+    assert(IsInitialized());
+
+    unsigned char length[LENGTH_LEN];
+    uint32_t nLength = len1 + len2;
+    length[0] = nLength;
+    length[1] = nLength >> 8;
+    length[2] = nLength >> 16;
+    sendLCipher->Crypt(length, output, LENGTH_LEN);
+
+    // The header and the first part of the contents are put in place and
+    // encrypted there, the second part straight from where it is.
+    unsigned char* packet = output + LENGTH_LEN;
+    packet[0] = fIgnore ? IGNORE_BIT : 0;
+    if (len1)
+        memcpy(packet + HEADER_LEN, contents1, len1);
+    sendPCipher->Encrypt(packet, HEADER_LEN + len1, contents2, len2, aad, aadlen, packet);
+}
+
+uint32_t BIP324Cipher::DecryptLength(const unsigned char* input)
+{
+    assert(IsInitialized());
+
+    unsigned char length[LENGTH_LEN];
+    recvLCipher->Crypt(input, length, LENGTH_LEN);
+    return (uint32_t)length[0] | ((uint32_t)length[1] << 8) | ((uint32_t)length[2] << 16);
+}
+
+bool BIP324Cipher::Decrypt(const unsigned char* input, size_t inputlen, const unsigned char* aad, size_t aadlen,
+                           bool& fIgnore, unsigned char* output)
+{
+    assert(IsInitialized());
+
+    if (inputlen < HEADER_LEN + FSChaCha20Poly1305::EXPANSION)
+        return false;
+    size_t nPlain = inputlen - FSChaCha20Poly1305::EXPANSION;
+    if (!recvPCipher->Decrypt(input, inputlen, aad, aadlen, output, nPlain, output + nPlain))
+        return false;
+    fIgnore = output[0] & IGNORE_BIT;
+    return true;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_BIP324_H
+#define BITCOIN_BIP324_H
+
+#include "crypto/chacha20poly1305.h"
+#include "key.h"
+#include "protocol.h"
+#include "pubkey.h"
+#include "uint256.h"
+
+#include <optional>
+#include <stdint.h>
+
+/**
+ * The packet encryption of the BIP 324 v2 transport. Each side makes an
+ * ephemeral key and sends its ElligatorSwift public key; from the shared
+ * secret come a length cipher and a packet cipher for each direction, the
+ * garbage terminators and the session ID.
+ */
+class BIP324Cipher
+{
+public:
+    static constexpr unsigned int SESSION_ID_LEN = 32;
+    static constexpr unsigned int GARBAGE_TERMINATOR_LEN = 16;
+    static constexpr unsigned int REKEY_INTERVAL = 224;
+    static constexpr unsigned int LENGTH_LEN = 3;
+    static constexpr unsigned int HEADER_LEN = 1;
+    /** How many bytes longer a packet is than its contents. */
+    static constexpr unsigned int EXPANSION = LENGTH_LEN + HEADER_LEN + FSChaCha20Poly1305::EXPANSION;
+    /** The bit of the header that marks a packet to be ignored. */
+    static constexpr unsigned char IGNORE_BIT = 0x80;
+
+private:
+    std::optional<FSChaCha20> sendLCipher;
+    std::optional<FSChaCha20> recvLCipher;
+    std::optional<FSChaCha20Poly1305> sendPCipher;
+    std::optional<FSChaCha20Poly1305> recvPCipher;
+
+    CKey key;
+    EllSwiftPubKey ourPubKey;
+
+    uint256 sessionId;
+    unsigned char sendGarbageTerminator[GARBAGE_TERMINATOR_LEN];
+    unsigned char recvGarbageTerminator[GARBAGE_TERMINATOR_LEN];
+
+public:
+    /** Start with our ephemeral key, encoding its public key with 32 bytes of entropy. */
+    BIP324Cipher(const CKey& keyIn, const unsigned char* entropy32);
+
+    /** Start with our ephemeral key and the encoding of its public key, for tests. */
+    BIP324Cipher(const CKey& keyIn, const EllSwiftPubKey& pubkeyIn);
+
+    const EllSwiftPubKey& GetOurPubKey() const { return ourPubKey; }
+
+    /**
+     * Derive the ciphers from the peer's public key. The network magic keeps
+     * the keys of different networks apart. With fSelfDecrypt, the ciphers
+     * decrypt what we encrypt, for tests.
+     */
+    void Initialize(const EllSwiftPubKey& theirPubKey, const CMessageHeader::MessageStartChars& pchMessageStart,
+                    bool fInitiator, bool fSelfDecrypt = false);
+
+    bool IsInitialized() const { return sendLCipher.has_value(); }
+
+    /**
+     * Encrypt a packet whose contents are contents1 followed by contents2,
+     * writing len1 + len2 + EXPANSION bytes to output.
+     */
+    void Encrypt(const unsigned char* contents1, size_t len1, const unsigned char* contents2, size_t len2,
+                 const unsigned char* aad, size_t aadlen, bool fIgnore, unsigned char* output);
+
+    /** Decrypt the LENGTH_LEN bytes that start a packet into the length of its contents. */
+    uint32_t DecryptLength(const unsigned char* input);
+
+    /**
+     * Authenticate and decrypt the rest of a packet, inputlen bytes, writing
+     * its header and contents (inputlen - FSChaCha20Poly1305::EXPANSION bytes)
+     * to output, which may be input. Returns false if it is not authentic.
+     */
+    bool Decrypt(const unsigned char* input, size_t inputlen, const unsigned char* aad, size_t aadlen,
+                 bool& fIgnore, unsigned char* output);
+
+    const uint256& GetSessionId() const { return sessionId; }
+    const unsigned char* GetSendGarbageTerminator() const { return sendGarbageTerminator; }
+    const unsigned char* GetReceiveGarbageTerminator() const { return recvGarbageTerminator; }
+};
+
+#endif // BITCOIN_BIP324_H
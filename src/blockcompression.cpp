@@ -0,0 +1,60 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "blockcompression.h"
+
+#include "crypto/common.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+bool BlockCompressionAvailable()
+{
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CompressBlock(const char* pbegin, const char* pend, int nLevel, std::vector<char>& record)
+{
+#ifdef HAVE_ZSTD
+    size_t nSize = pend - pbegin;
+    record.resize(sizeof(uint32_t) + ZSTD_compressBound(nSize));
+    WriteLE32(reinterpret_cast<unsigned char*>(record.data()), nSize);
+    size_t nCompressed = ZSTD_compress(record.data() + sizeof(uint32_t), record.size() - sizeof(uint32_t), pbegin, nSize, nLevel);
+    if (ZSTD_isError(nCompressed) || sizeof(uint32_t) + nCompressed >= nSize) {
+        record.clear();
+        return false;
+    }
+    record.resize(sizeof(uint32_t) + nCompressed);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DecompressBlock(const char* pbegin, const char* pend, uint32_t nMaxSize, std::vector<char>& block)
+{
+#ifdef HAVE_ZSTD
+    if ((size_t)(pend - pbegin) < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t nSize = ReadLE32(reinterpret_cast<const unsigned char*>(pbegin));
+    if (nSize > nMaxSize) {
+        return false;
+    }
+    block.resize(nSize);
+    size_t nRead = ZSTD_decompress(block.data(), nSize, pbegin + sizeof(uint32_t), pend - pbegin - sizeof(uint32_t));
+    return !ZSTD_isError(nRead) && nRead == nSize;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCOMPRESSION_H
+#define BITCOIN_BLOCKCOMPRESSION_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Set in the size field that precedes a block in a block file when the
+ * block is stored compressed. The record then holds the block's serialized
+ * size (4 bytes, little endian) followed by a zstd frame of its bytes.
+ */
+static const uint32_t BLOCK_COMPRESSED_FLAG = 0x80000000;
+
+/** Default for -blockcompression, the zstd level new blocks are written with (0 = uncompressed) */
+static const int DEFAULT_BLOCK_COMPRESSION = 0;
+static const int MAX_BLOCK_COMPRESSION = 19;
+
+/** Whether this build can read and write compressed blocks. */
+bool BlockCompressionAvailable();
+
+/**
+ * Compress the serialized block [pbegin, pend) into a compressed record.
+ * Returns false if compression is unavailable or doesn't save any space.
+ */
+bool CompressBlock(const char* pbegin, const char* pend, int nLevel, std::vector<char>& record);
+
+/**
+ * Expand the compressed record [pbegin, pend) into the block's serialized
+ * bytes, which may be at most nMaxSize long.
+ */
+bool DecompressBlock(const char* pbegin, const char* pend, uint32_t nMaxSize, std::vector<char>& block);
+
+#endif // BITCOIN_BLOCKCOMPRESSION_H
@@ -0,0 +1,60 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "blockdownload.h"
+
+#include <algorithm>
+
+/** Fold a new sample into an average that weights it by 1/8, or start the average with it. */
+template <typename T>
+static void Smooth(T& average, T sample)
+{
+    average = average == 0 ? sample : average + (sample - average) / 8;
+}
+
+void CBlockDownloadStats::BlockReceived(int64_t nRequested, int64_t nReceived, size_t nBytes)
+{
+    if (nReceived < nRequested)
+        return;
+
+    // A block requested before the previous one arrived waited for it, so it
+    // only measures the time the peer took to send it.
+    int64_t nElapsed;
+    if (nRequested < nLastReceived) {
+        nElapsed = std::max<int64_t>(nReceived - nLastReceived, 1);
+        Smooth(nBlockTime, nElapsed);
+    } else {
+        nElapsed = std::max<int64_t>(nReceived - nRequested, 1);
+        Smooth(nLatency, nElapsed);
+    }
+    Smooth(dBytesPerSecond, nBytes * 1000000.0 / nElapsed);
+    nLastReceived = std::max(nLastReceived, nReceived);
+}
+
+void CBlockDownloadStats::BlockReassigned(int64_t nRequested, int64_t nNow)
+{
+    int64_t nElapsed = std::max<int64_t>(nNow - nRequested, 1);
+    Smooth(nBlockTime, nElapsed);
+    nPausedUntil = nNow + nElapsed;
+    nReassigned++;
+}
+
+int CBlockDownloadStats::Window() const
+{
+    int64_t nPerBlock = nBlockTime ? nBlockTime : nLatency;
+    if (nPerBlock == 0)
+        return DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+    // Enough blocks to cover the round trip, and then keep the peer busy.
+    int64_t nWindow = (nLatency + BLOCK_DOWNLOAD_TARGET_BUSY_TIME) / nPerBlock;
+    return std::min<int64_t>(std::max<int64_t>(nWindow, MIN_BLOCKS_IN_TRANSIT_PER_PEER), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+bool CBlockDownloadStats::IsOverdue(int64_t nRequested, int64_t nNow) const
+{
+    if (nLatency == 0)
+        return false;
+    // The longest a block should take is the round trip plus sending a full window.
+    int64_t nExpected = nLatency + Window() * (nBlockTime ? nBlockTime : nLatency);
+    return nNow - nRequested > std::max(BLOCK_REASSIGN_MIN_TIME, BLOCK_REASSIGN_OVERDUE_FACTOR * nExpected);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_BLOCKDOWNLOAD_H
+#define BITCOIN_BLOCKDOWNLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of blocks requested at once from a peer whose download speed we haven't measured yet. */
+static const int DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** The fewest blocks requested at once from a peer, however slow it is. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+/** The most blocks requested at once from a peer, however fast it is. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 64;
+/** How long (in microseconds) the blocks requested from a peer should keep it busy once its latency is covered. */
+static const int64_t BLOCK_DOWNLOAD_TARGET_BUSY_TIME = 2 * 1000000;
+/** A block is handed to another peer once it takes this many times longer than the peer's usual delivery time... */
+static const int BLOCK_REASSIGN_OVERDUE_FACTOR = 2;
+/** ...and it has been in flight at least this long (in microseconds). */
+static const int64_t BLOCK_REASSIGN_MIN_TIME = 2 * 1000000;
+
+/**
+ * How quickly a peer delivers the blocks we ask it for, measured from the
+ * time each request was sent to the time its block was fully received. This
+ * sizes the peer's window of blocks in flight and decides when one of them
+ * is overdue. Times are in microseconds.
+ */
+class CBlockDownloadStats
+{
+private:
+    //! Smoothed time for a block to arrive when the peer had nothing else of ours to send, or 0.
+    int64_t nLatency = 0;
+    //! Smoothed time between blocks arriving while more were queued, or 0.
+    int64_t nBlockTime = 0;
+    //! Smoothed rate at which block data arrives, or 0.
+    double dBytesPerSecond = 0;
+    //! When the last block from this peer arrived.
+    int64_t nLastReceived = 0;
+    //! No new blocks are requested from the peer before this time.
+    int64_t nPausedUntil = 0;
+    //! Number of blocks handed to other peers because this one was too slow.
+    int64_t nReassigned = 0;
+
+public:
+    /** A block of nBytes requested at nRequested arrived at nReceived. */
+    void BlockReceived(int64_t nRequested, int64_t nReceived, size_t nBytes);
+
+    /**
+     * The block requested at nRequested is being handed to another peer at
+     * nNow. The delay counts as one very slow block, and the peer is not
+     * asked for more blocks for as long again.
+     */
+    void BlockReassigned(int64_t nRequested, int64_t nNow);
+
+    /** The number of blocks to keep in flight from this peer. */
+    int Window() const;
+
+    /** Whether the block requested at nRequested should have arrived well before nNow. */
+    bool IsOverdue(int64_t nRequested, int64_t nNow) const;
+
+    bool IsPaused(int64_t nNow) const { return nNow < nPausedUntil; }
+
+    int64_t Latency() const { return nLatency; }
+    int64_t BlockTime() const { return nBlockTime; }
+    double BytesPerSecond() const { return dBytesPerSecond; }
+    int64_t Reassigned() const { return nReassigned; }
+};
+
+#endif // BITCOIN_BLOCKDOWNLOAD_H
@@ -0,0 +1,236 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_BLOCKENCODINGS_H
+#define BITCOIN_BLOCKENCODINGS_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class CTxMemPool;
+
+/** The smallest a serialized transaction can be, which bounds how many a block can hold */
+static const unsigned int MIN_SERIALIZED_TX_SIZE = 10;
+/** How deep a block may be below our tip for a MSG_CMPCT_BLOCK request to be answered with a cmpctblock */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** How deep a block may be below our tip for a getblocktxn request to be answered with a blocktxn */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** The most peers, besides whitelisted ones, we ask to announce new blocks with a cmpctblock */
+static const unsigned int MAX_CMPCTBLOCK_HB_PEERS = 3;
+
+/** A getblocktxn message, asking for the transactions of a block at the given indexes. */
+class BlockTransactionsRequest {
+public:
+    uint256 blockhash;
+    std::vector<uint16_t> indexes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(blockhash);
+        uint64_t indexes_size = (uint64_t)indexes.size();
+        READWRITE(COMPACTSIZE(indexes_size));
+        if (ser_action.ForRead()) {
+            // Grow the vector as the indexes arrive, so that a bogus size
+            // cannot make us allocate more than the message holds.
+            size_t i = 0;
+            while (indexes.size() < indexes_size) {
+                indexes.resize(std::min((uint64_t)(1000 + indexes.size()), indexes_size));
+                for (; i < indexes.size(); i++) {
+                    uint64_t index = 0;
+                    READWRITE(COMPACTSIZE(index));
+                    if (index > std::numeric_limits<uint16_t>::max())
+                        throw std::ios_base::failure("index overflowed 16 bits");
+                    indexes[i] = index;
+                }
+            }
+
+            // Indexes are sent as the difference from the previous one.
+            uint16_t offset = 0;
+            for (size_t j = 0; j < indexes.size(); j++) {
+                if (uint64_t(indexes[j]) + uint64_t(offset) > std::numeric_limits<uint16_t>::max())
+                    throw std::ios_base::failure("indexes overflowed 16 bits");
+                indexes[j] = indexes[j] + offset;
+                offset = indexes[j] + 1;
+            }
+        } else {
+            for (size_t i = 0; i < indexes.size(); i++) {
+                uint64_t index = indexes[i] - (i == 0 ? 0 : (indexes[i - 1] + 1));
+                READWRITE(COMPACTSIZE(index));
+            }
+        }
+    }
+};
+
+/** A blocktxn message, answering a BlockTransactionsRequest. */
+class BlockTransactions {
+public:
+    uint256 blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions() {}
+    explicit BlockTransactions(const BlockTransactionsRequest& req) :
+        blockhash(req.blockhash), txn(req.indexes.size()) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(blockhash);
+        uint64_t txn_size = (uint64_t)txn.size();
+        READWRITE(COMPACTSIZE(txn_size));
+        if (ser_action.ForRead()) {
+            size_t i = 0;
+            while (txn.size() < txn_size) {
+                txn.resize(std::min((uint64_t)(1000 + txn.size()), txn_size));
+                for (; i < txn.size(); i++)
+                    READWRITE(txn[i]);
+            }
+        } else {
+            for (size_t i = 0; i < txn.size(); i++)
+                READWRITE(txn[i]);
+        }
+    }
+};
+
+/** A transaction sent in full within a cmpctblock message. */
+struct PrefilledTransaction {
+    // On the wire, the difference from the index of the previous prefilled
+    // transaction. In PartiallyDownloadedBlock, the index within the block.
+    uint16_t index = 0;
+    CTransaction tx;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        uint64_t idx = index;
+        READWRITE(COMPACTSIZE(idx));
+        if (idx > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("index overflowed 16-bits");
+        index = idx;
+        READWRITE(tx);
+    }
+};
+
+enum ReadStatus {
+    READ_STATUS_OK,
+    READ_STATUS_INVALID, //!< Invalid object, the peer is misbehaving.
+    READ_STATUS_FAILED,  //!< Failed to process the object, e.g. on a short ID collision.
+};
+
+/**
+ * A cmpctblock message (BIP 152): a block header with the coinbase sent in
+ * full, and the other transactions identified by 6-byte short IDs that the
+ * receiver matches against its mempool.
+ *
+ * Short IDs are computed from the wtxid, so that a v5 transaction in the
+ * mempool with the same txid but different authorizing data than the one in
+ * the block is not mistaken for it.
+ */
+class CBlockHeaderAndShortTxIDs {
+private:
+    mutable uint64_t shorttxidk0, shorttxidk1;
+    uint64_t nonce;
+
+    void FillShortTxIDSelector() const;
+
+    friend class PartiallyDownloadedBlock;
+
+    static const int SHORTTXIDS_LENGTH = 6;
+
+protected:
+    std::vector<uint64_t> shorttxids;
+    std::vector<PrefilledTransaction> prefilledtxn;
+
+public:
+    CBlockHeader header;
+
+    // Dummy for deserialization
+    CBlockHeaderAndShortTxIDs() {}
+
+    explicit CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    uint64_t GetShortID(const WTxId& wtxid) const;
+
+    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(header);
+        READWRITE(nonce);
+
+        uint64_t shorttxids_size = (uint64_t)shorttxids.size();
+        READWRITE(COMPACTSIZE(shorttxids_size));
+        if (ser_action.ForRead()) {
+            size_t i = 0;
+            while (shorttxids.size() < shorttxids_size) {
+                shorttxids.resize(std::min((uint64_t)(1000 + shorttxids.size()), shorttxids_size));
+                for (; i < shorttxids.size(); i++) {
+                    uint32_t lsb = 0; uint16_t msb = 0;
+                    READWRITE(lsb);
+                    READWRITE(msb);
+                    shorttxids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
+                    static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids serialization assumes 6-byte shorttxids");
+                }
+            }
+        } else {
+            for (size_t i = 0; i < shorttxids.size(); i++) {
+                uint32_t lsb = shorttxids[i] & 0xffffffff;
+                uint16_t msb = (shorttxids[i] >> 32) & 0xffff;
+                READWRITE(lsb);
+                READWRITE(msb);
+            }
+        }
+
+        READWRITE(prefilledtxn);
+
+        if (ser_action.ForRead())
+            FillShortTxIDSelector();
+    }
+};
+
+/**
+ * A block being reconstructed from a cmpctblock, the mempool, and the
+ * blocktxn answering our request for the transactions that were missing.
+ */
+class PartiallyDownloadedBlock {
+protected:
+    std::vector<std::shared_ptr<const CTransaction>> txn_available;
+    size_t prefilled_count = 0, mempool_count = 0;
+    CTxMemPool* pool;
+
+public:
+    CBlockHeader header;
+
+    explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : pool(poolIn) {}
+
+    /** Fill in what we can from the cmpctblock and the mempool. Takes pool->cs. */
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock);
+    bool IsTxAvailable(size_t index) const;
+    /** The indexes of the transactions still to be requested with getblocktxn. */
+    std::vector<uint16_t> GetMissingIndexes() const;
+    /**
+     * Assemble the block from the transactions we have and vtx_missing, which
+     * must hold the missing ones in order. A merkle root that does not match
+     * the header is reported as READ_STATUS_FAILED, as a short ID collision
+     * may have put the wrong mempool transaction in the block.
+     */
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing) const;
+
+    size_t GetPrefilledCount() const { return prefilled_count; }
+    size_t GetMempoolCount() const { return mempool_count; }
+};
+
+#endif // BITCOIN_BLOCKENCODINGS_H
@@ -0,0 +1,103 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "util/system.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<char*>(pdata), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const fs::path& path)
+{
+#ifdef WIN32
+    return nullptr;
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t nSize = st.st_size;
+    void* base = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LogPrintf("Unable to map %s: %s\n", path.string(), strerror(errno));
+        return nullptr;
+    }
+    return std::make_shared<const CMappedFile>(static_cast<const char*>(base), nSize);
+#endif
+}
+
+void CBlockFileMapper::SetMaxFiles(size_t nMaxFilesIn)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    nMaxFiles = nMaxFilesIn;
+    while (mapped.size() > nMaxFiles) {
+        mapped.pop_back();
+    }
+}
+
+std::shared_ptr<const CMappedFile> CBlockFileMapper::Get(int nFile, size_t nEnd)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (nMaxFiles == 0) {
+        return nullptr;
+    }
+
+    for (auto it = mapped.begin(); it != mapped.end(); ++it) {
+        if (it->first != nFile) {
+            continue;
+        }
+        if (it->second->size() >= nEnd) {
+            mapped.splice(mapped.begin(), mapped, it);
+            return it->second;
+        }
+        // The file has been appended to since it was mapped.
+        mapped.erase(it);
+        break;
+    }
+
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Open(getPath(nFile));
+    if (!file) {
+        return nullptr;
+    }
+    mapped.emplace_front(nFile, file);
+    while (mapped.size() > nMaxFiles) {
+        mapped.pop_back();
+    }
+    return file->size() >= nEnd ? file : nullptr;
+}
+
+void CBlockFileMapper::Invalidate(int nFile)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    mapped.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedFile>>& entry) {
+        return entry.first == nFile;
+    });
+}
+
+void CBlockFileMapper::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    mapped.clear();
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include "fs.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/** Default for -mappedblockfiles, the number of block files kept memory-mapped for reading */
+static const unsigned int DEFAULT_MAPPED_BLOCK_FILES = sizeof(void*) > 4 ? 16 : 0;
+
+/** A read-only memory mapping of a whole file. */
+class CMappedFile
+{
+private:
+    const char* pdata;
+    size_t nSize;
+
+public:
+    CMappedFile(const char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+
+    /** Map the file at path, or return nullptr if it is empty or can't be mapped. */
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+};
+
+/**
+ * Keeps the most recently read block files mapped, so that blocks can be
+ * deserialized, or sent to peers as they are, straight from the page cache
+ * instead of opening, seeking and reading the file each time.
+ *
+ * A mapping stays valid for as long as a caller holds it, even once it has
+ * been evicted or invalidated here.
+ */
+class CBlockFileMapper
+{
+private:
+    std::mutex cs;
+    std::function<fs::path(int)> getPath;
+    size_t nMaxFiles;
+    //! Mapped files, most recently used first.
+    std::list<std::pair<int, std::shared_ptr<const CMappedFile>>> mapped;
+
+public:
+    CBlockFileMapper(std::function<fs::path(int)> getPathIn, size_t nMaxFilesIn) :
+        getPath(getPathIn), nMaxFiles(nMaxFilesIn) {}
+
+    /** Set how many files may be mapped at once; 0 disables mapping. */
+    void SetMaxFiles(size_t nMaxFilesIn);
+
+    /**
+     * Return a mapping of file nFile that covers at least its first nEnd
+     * bytes, remapping the file if it has grown since it was mapped. Returns
+     * nullptr if mapping is disabled or the file isn't that long.
+     */
+    std::shared_ptr<const CMappedFile> Get(int nFile, size_t nEnd);
+
+    /** Drop the mapping of file nFile, which is about to be truncated or deleted. */
+    void Invalidate(int nFile);
+
+    void Clear();
+};
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -0,0 +1,118 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilewriter.h"
+
+#include "util/system.h"
+
+CBlockFileWriter::CBlockFileWriter(OpenFunc openIn) : open(openIn)
+{
+    writer = std::thread(&CBlockFileWriter::ThreadWrite, this);
+}
+
+CBlockFileWriter::~CBlockFileWriter()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fShutdown = true;
+    }
+    cond.notify_all();
+    // The writer finishes everything queued before it exits.
+    writer.join();
+}
+
+void CBlockFileWriter::ThreadWrite()
+{
+    RenameThread("zc-blockwrite");
+    // The file last written to, kept open while more records follow
+    FILE* file = nullptr;
+    std::pair<FileType, int> fileId(BLOCK_FILE, -1);
+    while (true) {
+        bool fIdle;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            fIdle = queue.empty();
+        }
+        if (fIdle && file) {
+            fclose(file);
+            file = nullptr;
+        }
+
+        std::pair<RecordKey, std::shared_ptr<const std::vector<char>>> record;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [&]() { return fShutdown || !queue.empty(); });
+            if (queue.empty()) break;
+            record = queue.front();
+        }
+
+        FileType type = std::get<0>(record.first);
+        CDiskBlockPos pos(std::get<1>(record.first), std::get<2>(record.first));
+        const std::vector<char>& data = *record.second;
+        if (file && fileId == std::make_pair(type, pos.nFile)) {
+            if (fseek(file, pos.nPos, SEEK_SET) != 0) {
+                fclose(file);
+                file = nullptr;
+            }
+        } else if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+        if (!file) {
+            file = open(type, pos);
+            fileId = std::make_pair(type, pos.nFile);
+        }
+        // Flushed to the OS before the record is dropped from memory, so
+        // readers that miss it in Find see it in the file.
+        bool fOk = file && fwrite(data.data(), 1, data.size(), file) == data.size() && fflush(file) == 0;
+        if (!fOk) {
+            LogPrintf("%s: failed to write %s record at %s\n", __func__,
+                      type == BLOCK_FILE ? "block" : "undo", pos.ToString());
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            queue.pop_front();
+            nPendingBytes -= data.size();
+            auto it = mapPending.find(record.first);
+            if (fOk && it != mapPending.end() && it->second == record.second) {
+                mapPending.erase(it);
+            }
+            // A record that failed to write stays readable from memory.
+            if (!fOk) fFailed = true;
+        }
+        cond.notify_all();
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+void CBlockFileWriter::Write(FileType type, const CDiskBlockPos& pos, std::vector<char>&& data)
+{
+    auto record = std::make_pair(RecordKey(type, pos.nFile, pos.nPos),
+                                 std::make_shared<const std::vector<char>>(std::move(data)));
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [&]() { return nPendingBytes < MAX_BLOCK_WRITE_BEHIND_BYTES || queue.empty(); });
+        nPendingBytes += record.second->size();
+        mapPending[record.first] = record.second;
+        queue.push_back(std::move(record));
+    }
+    cond.notify_all();
+}
+
+std::shared_ptr<const std::vector<char>> CBlockFileWriter::Find(FileType type, const CDiskBlockPos& pos)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    auto it = mapPending.find(RecordKey(type, pos.nFile, pos.nPos));
+    return it == mapPending.end() ? nullptr : it->second;
+}
+
+bool CBlockFileWriter::Sync()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [&]() { return queue.empty(); });
+    return !fFailed;
+}
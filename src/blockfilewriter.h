@@ -0,0 +1,78 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEWRITER_H
+#define BITCOIN_BLOCKFILEWRITER_H
+
+#include "chain.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+/** Default for -blockwritebehind */
+static const bool DEFAULT_BLOCK_WRITE_BEHIND = false;
+/** Most bytes of block and undo records waiting to be written before writers wait for the disk */
+static const size_t MAX_BLOCK_WRITE_BEHIND_BYTES = 64 << 20;
+
+/**
+ * Writes block and undo records to their files on a background thread, so
+ * that accepting and connecting a block does not wait for the disk.
+ *
+ * Each record is written, in the order queued, at the position its caller
+ * reserved with FindBlockPos or FindUndoPos, and is not synced. Until it has
+ * been written it is served from memory by Find, so a block or its undo data
+ * can be read back as soon as it is queued. Sync waits for every queued
+ * record; FlushBlockFile calls it ahead of its fsyncs, and the block index
+ * is only written after those, so the index never refers to data that is
+ * not on disk.
+ */
+class CBlockFileWriter
+{
+public:
+    enum FileType { BLOCK_FILE, UNDO_FILE };
+    //! Opens the file of type at pos for writing, positioned at pos.nPos.
+    typedef std::function<FILE*(FileType type, const CDiskBlockPos& pos)> OpenFunc;
+
+private:
+    typedef std::tuple<FileType, int, unsigned int> RecordKey;
+
+    OpenFunc open;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Records in the order they are written; the front one may be in progress.
+    std::deque<std::pair<RecordKey, std::shared_ptr<const std::vector<char>>>> queue;
+    //! Queued records by type and position, until they have been written.
+    std::map<RecordKey, std::shared_ptr<const std::vector<char>>> mapPending;
+    size_t nPendingBytes = 0;
+    //! Set once a write has failed. Guarded by cs.
+    bool fFailed = false;
+    bool fShutdown = false;
+    std::thread writer;
+
+    void ThreadWrite();
+
+public:
+    explicit CBlockFileWriter(OpenFunc openIn);
+    ~CBlockFileWriter();
+
+    /** Queue data to be written to the file of type at pos, waiting first if too much is queued. */
+    void Write(FileType type, const CDiskBlockPos& pos, std::vector<char>&& data);
+
+    /** The data queued for pos that is not yet written, or nullptr. */
+    std::shared_ptr<const std::vector<char>> Find(FileType type, const CDiskBlockPos& pos);
+
+    /** Wait until everything queued has been written. Returns false if a write failed. */
+    bool Sync();
+};
+
+#endif // BITCOIN_BLOCKFILEWRITER_H
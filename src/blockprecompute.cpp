@@ -0,0 +1,90 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "blockprecompute.h"
+
+#include "coins.h"
+#include "primitives/block.h"
+
+#include <algorithm>
+#include <future>
+#include <map>
+
+CBlockPrecomputedData::CBlockPrecomputedData(const CBlock& block, const CCoinsViewCache& view, int nThreads) :
+    vEntries(block.vtx.size())
+{
+    // Resolve the spent outputs serially: the coins view is not thread-safe,
+    // and inputs may spend outputs created earlier in the same block. A
+    // transaction whose inputs cannot all be resolved is left for Get(),
+    // after the caller has checked them against the view.
+    std::map<uint256, const CTransaction*> mapBlockTxs;
+    std::vector<bool> vResolved(block.vtx.size(), true);
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        if (!tx.IsCoinBase()) {
+            auto& allPrevOutputs = vEntries[i].allPrevOutputs;
+            allPrevOutputs.reserve(tx.vin.size());
+            for (const auto& input : tx.vin) {
+                const COutPoint& prevout = input.prevout;
+                const std::vector<CTxOut>* vout = nullptr;
+                auto it = mapBlockTxs.find(prevout.hash);
+                if (it != mapBlockTxs.end()) {
+                    vout = &it->second->vout;
+                } else {
+                    const CCoins* coins = view.AccessCoins(prevout.hash);
+                    if (coins && prevout.n < coins->vout.size() && !coins->vout[prevout.n].IsNull()) {
+                        vout = &coins->vout;
+                    }
+                }
+                if (vout == nullptr || prevout.n >= vout->size()) {
+                    vResolved[i] = false;
+                    break;
+                }
+                allPrevOutputs.push_back((*vout)[prevout.n]);
+            }
+        }
+        mapBlockTxs.emplace(tx.GetHash(), &tx);
+    }
+
+    auto buildRange = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            if (!vResolved[i]) {
+                continue;
+            }
+            try {
+                vEntries[i].txdata.emplace(block.vtx[i], vEntries[i].allPrevOutputs);
+            } catch (const std::ios_base::failure&) {
+                // Rebuilt (and the error raised) on the calling thread by Get().
+            }
+        }
+    };
+
+    size_t nWorkers = std::min<size_t>(std::max(nThreads, 1), block.vtx.size() / BLOCK_PRECOMPUTE_MIN_PER_WORKER);
+    if (nWorkers <= 1) {
+        buildRange(0, block.vtx.size());
+        return;
+    }
+    size_t nPerWorker = (block.vtx.size() + nWorkers - 1) / nWorkers;
+    std::vector<std::future<void>> vWorkers;
+    for (size_t nBegin = nPerWorker; nBegin < block.vtx.size(); nBegin += nPerWorker) {
+        vWorkers.push_back(std::async(std::launch::async, buildRange,
+            nBegin, std::min(block.vtx.size(), nBegin + nPerWorker)));
+    }
+    buildRange(0, std::min(block.vtx.size(), nPerWorker));
+    for (auto& worker : vWorkers) {
+        worker.get();
+    }
+}
+
+PrecomputedTransactionData& CBlockPrecomputedData::Get(size_t i, const CTransaction& tx, const std::vector<CTxOut>& allPrevOutputs)
+{
+    Entry& entry = vEntries[i];
+    if (!entry.txdata.has_value() || entry.allPrevOutputs != allPrevOutputs) {
+        entry.txdata.reset();
+        entry.allPrevOutputs = allPrevOutputs;
+        entry.txdata.emplace(tx, allPrevOutputs);
+        nRebuilt++;
+    }
+    return *entry.txdata;
+}
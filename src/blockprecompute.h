@@ -0,0 +1,63 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKPRECOMPUTE_H
+#define BITCOIN_BLOCKPRECOMPUTE_H
+
+#include "primitives/transaction.h"
+#include "script/interpreter.h"
+
+#include <optional>
+#include <vector>
+
+class CBlock;
+class CCoinsViewCache;
+
+/** Minimum number of transactions per thread when building a block's precomputed data in parallel */
+static const size_t BLOCK_PRECOMPUTE_MIN_PER_WORKER = 8;
+
+/**
+ * Block-scoped arena of PrecomputedTransactionData.
+ *
+ * The transparent outputs spent by each transaction are resolved serially,
+ * against the coins view and the earlier transactions of the block, and the
+ * signature hash digests (including the ZIP 244 txid digests of v5
+ * transactions) are then computed in parallel, once per transaction. Script
+ * and shielded checks refer into the arena, whose storage never moves once
+ * built.
+ */
+class CBlockPrecomputedData
+{
+private:
+    struct Entry {
+        std::vector<CTxOut> allPrevOutputs;
+        std::optional<PrecomputedTransactionData> txdata;
+    };
+    std::vector<Entry> vEntries;
+    size_t nRebuilt = 0;
+
+public:
+    /**
+     * Build the precomputed data for every transaction of the block, using
+     * up to nThreads threads (including the calling one).
+     */
+    CBlockPrecomputedData(const CBlock& block, const CCoinsViewCache& view, int nThreads);
+
+    /**
+     * Return the precomputed data of transaction i, given the outputs that
+     * its inputs spend. If the arena resolved different outputs, or could not
+     * build the data up front, it is (re)built here on the calling thread.
+     */
+    PrecomputedTransactionData& Get(size_t i, const CTransaction& tx, const std::vector<CTxOut>& allPrevOutputs);
+
+    /** Return the precomputed data of transaction i, once built up front or by Get(). */
+    const PrecomputedTransactionData& operator[](size_t i) const { return *vEntries[i].txdata; }
+
+    size_t size() const { return vEntries.size(); }
+
+    /** Number of transactions whose data Get() had to (re)build on the calling thread */
+    size_t RebuiltCount() const { return nRebuilt; }
+};
+
+#endif // BITCOIN_BLOCKPRECOMPUTE_H
@@ -9,6 +9,9 @@
 #include "main.h"
 #include "txdb.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <rust/metrics.h>
 
 /**
@@ -63,12 +66,76 @@ const CBlockIndex *CChain::FindFork(const CBlockIndex *pindex) const {
     return pindex;
 }
 
+/**
+ * CChainSnapshot implementation
+ */
+CChainSnapshot::CChainSnapshot(const CChain& chain, const CChainSnapshot* prev) : nHeight(chain.Height())
+{
+    // Everything up to the last block chain shares with prev is unchanged.
+    int nForkHeight = -1;
+    if (prev && prev->Tip()) {
+        const CBlockIndex* pfork = chain.FindFork(prev->Tip());
+        if (pfork)
+            nForkHeight = pfork->nHeight;
+    }
+
+    // Reuse the chunks that lie wholly at or below the fork, and copy the rest.
+    size_t nKeep = prev ? std::min((size_t)((nForkHeight + 1) / CHUNK_SIZE), prev->vChunks.size()) : 0;
+    if (nKeep > 0)
+        vChunks.assign(prev->vChunks.begin(), prev->vChunks.begin() + nKeep);
+    for (int h = nKeep * CHUNK_SIZE; h <= nHeight; h += CHUNK_SIZE) {
+        auto chunk = std::make_shared<Chunk>();
+        int nEnd = std::min(h + CHUNK_SIZE, nHeight + 1);
+        chunk->reserve(nEnd - h);
+        for (int i = h; i < nEnd; i++)
+            chunk->push_back(chain[i]);
+        vChunks.push_back(std::move(chunk));
+    }
+
+    // Index the hashes of the blocks above the fork in a new run, then merge
+    // runs while the newest is at least as large as the one before it. Runs
+    // from prev keep the hashes of blocks that were reorganized away, which
+    // Find() skips.
+    if (prev)
+        vRuns = prev->vRuns;
+    if (nHeight > nForkHeight) {
+        auto run = std::make_shared<Run>();
+        run->reserve(nHeight - nForkHeight);
+        for (int i = nForkHeight + 1; i <= nHeight; i++)
+            run->emplace_back(chain[i]->GetBlockHash().GetUint64(0), i);
+        std::sort(run->begin(), run->end());
+        vRuns.push_back(std::move(run));
+    }
+    while (vRuns.size() >= 2 && vRuns[vRuns.size() - 2]->size() <= vRuns.back()->size()) {
+        const Run& a = *vRuns[vRuns.size() - 2];
+        const Run& b = *vRuns.back();
+        auto merged = std::make_shared<Run>();
+        merged->reserve(a.size() + b.size());
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(*merged));
+        vRuns.pop_back();
+        vRuns.back() = std::move(merged);
+    }
+}
+
+CBlockIndex *CChainSnapshot::Find(const uint256& hash) const {
+    uint64_t nKey = hash.GetUint64(0);
+    for (const auto& run : vRuns) {
+        auto it = std::lower_bound(run->begin(), run->end(), std::make_pair(nKey, std::numeric_limits<int>::min()));
+        for (; it != run->end() && it->first == nKey; ++it) {
+            CBlockIndex* pindex = (*this)[it->second];
+            if (pindex && pindex->GetBlockHash() == hash)
+                return pindex;
+        }
+    }
+    return NULL;
+}
+
 // TrimSolution() removed - not needed for RandomX's 32-byte solutions
 
+// The fields read here never change once the entry is in mapBlockIndex, so
+// this needs no lock.
 CBlockHeader CBlockIndex::GetBlockHeader() const
 {
-    AssertLockHeld(cs_main);
-
     CBlockHeader header;
     header.nVersion             = nVersion;
     if (pprev) {
@@ -79,7 +146,7 @@ CBlockHeader CBlockIndex::GetBlockHeader() const
     header.nTime                = nTime;
     header.nBits                = nBits;
     header.nNonce               = nNonce;
-    header.nSolution            = nSolution;
+    header.nSolution.assign(nSolution.begin(), nSolution.end());
     return header;
 }
 
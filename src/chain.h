@@ -7,14 +7,20 @@
 #ifndef BITCOIN_CHAIN_H
 #define BITCOIN_CHAIN_H
 
+#include "amount.h"
 #include "arith_uint256.h"
 #include "primitives/block.h"
 #include "pow.h"
+#include "prevector.h"
+#include "support/hugepagearena.h"
 #include "tinyformat.h"
 #include "uint256.h"
 #include "util/strencodings.h"
 
+#include <limits>
+#include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include <rust/metrics.h>
@@ -189,6 +195,59 @@ enum BlockStatus: uint32_t {
 //! Blocks with this validity are assumed to satisfy all consensus rules.
 static const BlockStatus BLOCK_VALID_CONSENSUS = BLOCK_VALID_SCRIPTS;
 
+/**
+ * An optional CAmount that takes 8 bytes rather than the 16 of
+ * std::optional<CAmount>, by using an amount no transaction can produce as
+ * the empty value. It converts to and from std::optional<CAmount> and
+ * serializes the same way.
+ */
+class OptionalAmount
+{
+private:
+    static constexpr CAmount NONE = std::numeric_limits<CAmount>::min();
+    CAmount amount;
+
+public:
+    OptionalAmount() : amount(NONE) {}
+    OptionalAmount(std::nullopt_t) : amount(NONE) {}
+    OptionalAmount(CAmount amountIn) : amount(amountIn) { assert(amount != NONE); }
+    OptionalAmount(const std::optional<CAmount>& opt) : amount(opt ? *opt : NONE) { assert(!opt || *opt != NONE); }
+
+    operator std::optional<CAmount>() const
+    {
+        if (!has_value()) return std::nullopt;
+        return amount;
+    }
+
+    bool has_value() const { return amount != NONE; }
+    explicit operator bool() const { return has_value(); }
+
+    const CAmount& operator*() const { return amount; }
+
+    CAmount value() const
+    {
+        if (!has_value()) throw std::bad_optional_access();
+        return amount;
+    }
+
+    friend bool operator==(const OptionalAmount& a, std::nullopt_t) { return !a.has_value(); }
+    friend bool operator!=(const OptionalAmount& a, std::nullopt_t) { return a.has_value(); }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ::Serialize(s, std::optional<CAmount>(*this));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        std::optional<CAmount> opt;
+        ::Unserialize(s, opt);
+        *this = opt;
+    }
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -259,36 +318,36 @@ public:
     //! Will be std::nullopt under the following conditions:
     //! - if the block has never been connected to a chain tip
     //! - for older blocks until a reindex has taken place
-    std::optional<CAmount> nChainSupplyDelta;
+    OptionalAmount nChainSupplyDelta;
 
     //! (memory only) Total chain supply up to and including this block.
     //!
     //! Will be std::nullopt until a reindex has taken place.
     //! Will be std::nullopt if nChainTx is zero, or if the block has never been
     //! connected to a chain tip.
-    std::optional<CAmount> nChainTotalSupply;
+    OptionalAmount nChainTotalSupply;
 
     //! Change in value in the transparent pool produced by the action of the
     //! transparent inputs to and outputs from transactions in this block.
     //!
     //! Will be std::nullopt for older blocks until a reindex has taken place.
-    std::optional<CAmount> nTransparentValue;
+    OptionalAmount nTransparentValue;
 
     //! (memory only) Total value of the transparent value pool up to and
     //! including this block.
     //!
     //! Will be std::nullopt until a reindex has taken place.
     //! Will be std::nullopt if nChainTx is zero.
-    std::optional<CAmount> nChainTransparentValue;
+    OptionalAmount nChainTransparentValue;
 
     //! Change in value held by the Sprout circuit over this block.
     //! Will be std::nullopt for older blocks on old nodes until a reindex has taken place.
-    std::optional<CAmount> nSproutValue;
+    OptionalAmount nSproutValue;
 
     //! (memory only) Total value held by the Sprout circuit up to and including this block.
     //! Will be std::nullopt for on old nodes until a reindex has taken place.
     //! Will be std::nullopt if nChainTx is zero.
-    std::optional<CAmount> nChainSproutValue;
+    OptionalAmount nChainSproutValue;
 
     //! Change in value held by the Sapling circuit over this block.
     //! Not a std::optional because this was added before Sapling activated, so we can
@@ -297,7 +356,7 @@ public:
 
     //! (memory only) Total value held by the Sapling circuit up to and including this block.
     //! Will be std::nullopt if nChainTx is zero.
-    std::optional<CAmount> nChainSaplingValue;
+    OptionalAmount nChainSaplingValue;
 
     //! Change in value held by the Orchard circuit over this block.
     //! Not a std::optional because this was added before Orchard activated, so we can
@@ -306,7 +365,7 @@ public:
 
     //! (memory only) Total value held by the Orchard circuit up to and including this block.
     //! Will be std::nullopt if and only if nChainTx is zero.
-    std::optional<CAmount> nChainOrchardValue;
+    OptionalAmount nChainOrchardValue;
 
     //! Change in value held by the development fund lockbox over this block.
     //!
@@ -317,7 +376,7 @@ public:
     //! (memory only) Total value held by the development fund lockbox up to
     //! and including this block. Will be std::nullopt if and only if nChainTx
     //! is zero.
-    std::optional<CAmount> nChainLockboxValue;
+    OptionalAmount nChainLockboxValue;
 
     //! Root of the Sapling commitment tree as of the end of this block.
     //!
@@ -354,8 +413,9 @@ public:
     unsigned int nBits;
     uint256 nNonce;
 protected:
-    // The proof-of-work solution (RandomX hash, 32 bytes).
-    std::vector<unsigned char> nSolution;
+    // The proof-of-work solution (RandomX hash, 32 bytes). Stored inline
+    // rather than in a separate heap allocation.
+    prevector<32, unsigned char> nSolution;
 
 public:
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
@@ -421,7 +481,7 @@ public:
         nTime          = block.nTime;
         nBits          = block.nBits;
         nNonce         = block.nNonce;
-        nSolution      = block.nSolution;
+        nSolution.assign(block.nSolution.begin(), block.nSolution.end());
         MetricsIncrementCounter("zcashd.debug.memory.allocated_equihash_solutions");
     }
 
@@ -499,7 +559,7 @@ public:
 
     void SetSolution(const std::vector<unsigned char>& solution)
     {
-        nSolution = solution;
+        nSolution.assign(solution.begin(), solution.end());
     }
 
     //! Raise the validity level of this block index entry.
@@ -647,7 +707,7 @@ public:
         header.nTime                = nTime;
         header.nBits                = nBits;
         header.nNonce               = nNonce;
-        header.nSolution            = nSolution;
+        header.nSolution.assign(nSolution.begin(), nSolution.end());
         return header;
     }
 
@@ -659,12 +719,12 @@ public:
     std::vector<unsigned char> GetSolution() const
     {
         assert(HasSolution());
-        return nSolution;
+        return std::vector<unsigned char>(nSolution.begin(), nSolution.end());
     }
 
     void SetSolution(const std::vector<unsigned char>& solution)
     {
-        nSolution = solution;
+        nSolution.assign(solution.begin(), solution.end());
     }
 
     std::string ToString() const
@@ -685,6 +745,35 @@ private:
     }
 };
 
+/**
+ * Allocates CBlockIndex objects in chunks rather than with one heap
+ * allocation each. Objects never move, and are all freed together by Clear().
+ * Chunks come from the block index huge page arena.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t CHUNK_SIZE = 4096;
+    std::vector<std::vector<CBlockIndex, hugepage_allocator<CBlockIndex, ARENA_BLOCKINDEX>>> chunks;
+
+public:
+    template<typename... Args>
+    CBlockIndex* Allocate(Args&&... args)
+    {
+        if (chunks.empty() || chunks.back().size() == CHUNK_SIZE) {
+            chunks.emplace_back();
+            chunks.back().reserve(CHUNK_SIZE);
+        }
+        chunks.back().emplace_back(std::forward<Args>(args)...);
+        return &chunks.back().back();
+    }
+
+    void Clear()
+    {
+        chunks.clear();
+    }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -742,4 +831,64 @@ public:
     const CBlockIndex *FindFork(const CBlockIndex *pindex) const;
 };
 
+/**
+ * An immutable copy of a CChain, for readers that cannot hold cs_main while
+ * they walk the chain. Heights are kept in fixed-size chunks and block hashes
+ * in sorted runs that are merged like a binary counter, so a snapshot made
+ * from the previous one shares everything below the fork point with it and
+ * costs little more than the blocks that changed.
+ *
+ * Entries are only valid to read where they do not change once the block is
+ * on the chain: the header fields, the chain totals and pprev.
+ */
+class CChainSnapshot {
+private:
+    static const int CHUNK_SIZE = 1024;
+
+    typedef std::vector<CBlockIndex*> Chunk;
+    //! (first 64 bits of the block hash, height), sorted.
+    typedef std::vector<std::pair<uint64_t, int>> Run;
+
+    std::vector<std::shared_ptr<const Chunk>> vChunks;
+    //! May name heights whose block has since been replaced; see Find().
+    std::vector<std::shared_ptr<const Run>> vRuns;
+    int nHeight;
+
+public:
+    /** Copy chain, reusing what it has in common with prev if given. */
+    CChainSnapshot(const CChain& chain, const CChainSnapshot* prev);
+
+    CBlockIndex *Genesis() const {
+        return (*this)[0];
+    }
+
+    CBlockIndex *Tip() const {
+        return (*this)[nHeight];
+    }
+
+    CBlockIndex *operator[](int nHeightIn) const {
+        if (nHeightIn < 0 || nHeightIn > nHeight)
+            return NULL;
+        return (*vChunks[nHeightIn / CHUNK_SIZE])[nHeightIn % CHUNK_SIZE];
+    }
+
+    bool Contains(const CBlockIndex *pindex) const {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    CBlockIndex *Next(const CBlockIndex *pindex) const {
+        if (Contains(pindex))
+            return (*this)[pindex->nHeight + 1];
+        else
+            return NULL;
+    }
+
+    int Height() const {
+        return nHeight;
+    }
+
+    /** The block in this chain with the given hash, or NULL if there is none. */
+    CBlockIndex *Find(const uint256& hash) const;
+};
+
 #endif // BITCOIN_CHAIN_H
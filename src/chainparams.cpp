@@ -44,7 +44,7 @@ static CBlock CreateGenesisBlock(const char* pszTimestamp, const CScript& genesi
     genesis.nTime    = nTime;
     genesis.nBits    = nBits;
     genesis.nNonce   = nNonce;
-    genesis.nSolution = nSolution;
+    genesis.nSolution.assign(nSolution.begin(), nSolution.end());
     genesis.nVersion = nVersion;
     genesis.vtx.push_back(txNew);
     genesis.hashPrevBlock.SetNull();
@@ -593,6 +593,11 @@ void SelectParams(const std::string& network)
         regTestParams.SetRegTestCoinbaseMustBeShielded();
     }
 
+    // The python qa rpc tests mine with a cheap hash unless asked for RandomX
+    if (network == CBaseChainParams::REGTEST && GetBoolArg("-regtestfastpow", false)) {
+        regTestParams.SetRegTestFastPoW();
+    }
+
     // When a developer is debugging turnstile violations in regtest mode, enable ZIP209
     if (network == CBaseChainParams::REGTEST && mapArgs.count("-developersetpoolsizezero")) {
         regTestParams.SetRegTestZIP209Enabled();
@@ -35,6 +35,14 @@ struct CCheckpointData {
     double fTransactionsPerDay;
 };
 
+/** A chain state snapshot (see dumptxoutset) known to be that of the main chain. */
+struct AssumeutxoData {
+    //! The snapshot hash that dumptxoutset reports for it
+    uint256 hashSnapshot;
+};
+
+typedef std::map<int, AssumeutxoData> MapAssumeutxo;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -101,6 +109,8 @@ public:
     }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    /** Chain state snapshots committed to, by the height of their block */
+    const MapAssumeutxo& Assumeutxo() const { return mapAssumeutxo; }
     /** Return the founder's reward address and script for a given block height */
     std::string GetFoundersRewardAddressAtHeight(int height) const;
     CScript GetFoundersRewardScriptAtHeight(int height) const;
@@ -109,6 +119,8 @@ public:
     std::string GetDefaultDonationAddress() const;
     /** Enforce coinbase consensus rule in regtest mode */
     void SetRegTestCoinbaseMustBeShielded() { consensus.fCoinbaseMustBeShielded = true; }
+    /** Replace RandomX with a cheap hash in regtest mode */
+    void SetRegTestFastPoW() { consensus.fPowFastHash = true; }
 protected:
     CChainParams() {}
 
@@ -129,6 +141,7 @@ protected:
     bool fMineBlocksOnDemand = false;
     bool fTestnetToBeDeprecatedFieldRPC = false;
     CCheckpointData checkpointData;
+    MapAssumeutxo mapAssumeutxo;
     std::vector<std::string> vFoundersRewardAddress;
 
     CAmount nSproutValuePoolCheckpointHeight = 0;
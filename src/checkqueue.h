@@ -7,6 +7,10 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -18,6 +22,26 @@
 template <typename T>
 class CCheckQueueControl;
 
+/**
+ * Interface shared by the check queue implementations, so that
+ * CCheckQueueControl can drive either of them.
+ */
+template <typename T>
+class CCheckQueueBase
+{
+public:
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    boost::mutex ControlMutex;
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    virtual bool Wait() = 0;
+
+    //! Add a batch of checks to the queue
+    virtual void Add(std::vector<T>& vChecks) = 0;
+
+    virtual ~CCheckQueueBase() {}
+};
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -29,7 +53,7 @@ class CCheckQueueControl;
   * as an N'th worker, until all jobs are done.
   */
 template <typename T>
-class CCheckQueue
+class CCheckQueue : public CCheckQueueBase<T>
 {
 private:
     //! Mutex to protect the inner state
@@ -129,9 +153,6 @@ private:
     }
 
 public:
-    //! Mutex to ensure only one concurrent CCheckQueueControl
-    boost::mutex ControlMutex;
-
     //! Create a new check queue
     CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
 
@@ -142,13 +163,13 @@ public:
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
-    bool Wait()
+    bool Wait() override
     {
         return Loop(true);
     }
 
     //! Add a batch of checks to the queue
-    void Add(std::vector<T>& vChecks)
+    void Add(std::vector<T>& vChecks) override
     {
         boost::unique_lock<boost::mutex> lock(mutex);
         for (T& check : vChecks) {
@@ -168,22 +189,218 @@ public:
 
 };
 
+/**
+ * Work-stealing variant of CCheckQueue.
+ *
+ * Every participating thread owns a deque of checks. The master spreads
+ * added checks across the deques of all registered workers; each worker
+ * takes batches from the back of its own deque and, once that is empty,
+ * steals from the front of the others. Each deque has its own mutex, so
+ * threads only contend when they touch the same deque, and the shared
+ * mutex and condition variables are only used to park idle threads and to
+ * wake the master when the last check completes.
+ *
+ * Thread() and Wait() follow the CCheckQueue contract: worker threads run
+ * until interrupted, and the master joins in until all checks are done.
+ */
+template <typename T>
+class CWorkStealingCheckQueue : public CCheckQueueBase<T>
+{
+private:
+    //! Upper bound on the number of deques; extra workers share slots.
+    static const int MAX_SLOTS = 64;
+
+    struct WorkerDeque {
+        std::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! One deque per participating thread. Slot 0 belongs to the master.
+    std::vector<std::unique_ptr<WorkerDeque>> slots;
+
+    //! Number of worker threads that have registered a slot.
+    std::atomic<int> nWorkers;
+
+    //! Slot that receives the next chunk of added checks.
+    std::atomic<unsigned int> nNextSlot;
+
+    //! Checks sitting in a deque that no thread has taken yet.
+    //! May briefly go negative while Add is still publishing.
+    std::atomic<int> nQueued;
+
+    //! Checks that have been added but not yet completed.
+    std::atomic<unsigned int> nTodo;
+
+    //! The temporary evaluation result.
+    std::atomic<bool> fAllOk;
+
+    //! Protects parking of idle threads; never held while running checks.
+    boost::mutex idleMutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMaster;
+    std::atomic<int> nIdle;
+    std::atomic<bool> fMasterWaiting;
+
+    //! The maximum number of elements to be processed in one batch
+    unsigned int nBatchSize;
+
+    int ActiveSlots() const
+    {
+        return std::min(MAX_SLOTS, nWorkers.load() + 1);
+    }
+
+    /** Take up to half of our own deque, newest checks first. */
+    bool TakeOwn(int nSlot, std::vector<T>& vChecks)
+    {
+        WorkerDeque& d = *slots[nSlot];
+        std::lock_guard<std::mutex> lock(d.mutex);
+        size_t nTake = std::min<size_t>(nBatchSize, std::max<size_t>(1, d.checks.size() / 2));
+        while (nTake-- && !d.checks.empty()) {
+            vChecks.emplace_back();
+            vChecks.back().swap(d.checks.back());
+            d.checks.pop_back();
+        }
+        return !vChecks.empty();
+    }
+
+    /** Steal up to half of another thread's deque, oldest checks first. */
+    bool Steal(int nSlot, std::vector<T>& vChecks)
+    {
+        int nActive = ActiveSlots();
+        for (int i = 1; i < nActive; i++) {
+            WorkerDeque& d = *slots[(nSlot + i) % nActive];
+            std::unique_lock<std::mutex> lock(d.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || d.checks.empty())
+                continue;
+            size_t nTake = std::min<size_t>(nBatchSize, std::max<size_t>(1, d.checks.size() / 2));
+            while (nTake-- && !d.checks.empty()) {
+                vChecks.emplace_back();
+                vChecks.back().swap(d.checks.front());
+                d.checks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /** Run one batch taken from the deques. Returns false if none was found. */
+    bool RunBatch(int nSlot, std::vector<T>& vChecks)
+    {
+        if (!TakeOwn(nSlot, vChecks) && !Steal(nSlot, vChecks))
+            return false;
+        unsigned int nNow = vChecks.size();
+        nQueued -= nNow;
+        bool fOk = fAllOk.load(std::memory_order_relaxed);
+        for (T& check : vChecks)
+            if (fOk)
+                fOk = check();
+        vChecks.clear();
+        if (!fOk)
+            fAllOk = false;
+        if (nTodo.fetch_sub(nNow) == nNow && fMasterWaiting.load()) {
+            // We completed the last check; wake the master.
+            boost::unique_lock<boost::mutex> lock(idleMutex);
+            condMaster.notify_one();
+        }
+        return true;
+    }
+
+public:
+    //! Create a new work-stealing check queue
+    CWorkStealingCheckQueue(unsigned int nBatchSizeIn) :
+        nWorkers(0), nNextSlot(0), nQueued(0), nTodo(0), fAllOk(true),
+        nIdle(0), fMasterWaiting(false), nBatchSize(nBatchSizeIn)
+    {
+        slots.reserve(MAX_SLOTS);
+        for (int i = 0; i < MAX_SLOTS; i++)
+            slots.emplace_back(new WorkerDeque());
+    }
+
+    //! Worker thread
+    void Thread()
+    {
+        int nSlot = 1 + (nWorkers++ % (MAX_SLOTS - 1));
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (RunBatch(nSlot, vChecks))
+                continue;
+            boost::unique_lock<boost::mutex> lock(idleMutex);
+            nIdle++;
+            while (nQueued.load() <= 0)
+                condWorker.wait(lock); // interruption point
+            nIdle--;
+        }
+    }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    bool Wait() override
+    {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (nTodo.load() != 0) {
+            if (RunBatch(0, vChecks))
+                continue;
+            // Nothing left to steal; the remaining checks are in flight on
+            // the workers, so sleep until the last of them completes.
+            boost::unique_lock<boost::mutex> lock(idleMutex);
+            fMasterWaiting = true;
+            while (nTodo.load() != 0 && nQueued.load() <= 0)
+                condMaster.wait(lock);
+            fMasterWaiting = false;
+        }
+        // reset the status for new work later
+        return fAllOk.exchange(true);
+    }
+
+    //! Add a batch of checks to the queue
+    void Add(std::vector<T>& vChecks) override
+    {
+        if (vChecks.empty())
+            return;
+        nTodo += vChecks.size();
+        // Split the checks into one contiguous chunk per active slot, so
+        // each deque is locked once per call.
+        int nActive = ActiveSlots();
+        size_t nChunks = std::min<size_t>(nActive, vChecks.size());
+        size_t nPerChunk = (vChecks.size() + nChunks - 1) / nChunks;
+        size_t nPos = 0;
+        while (nPos < vChecks.size()) {
+            WorkerDeque& d = *slots[nNextSlot++ % nActive];
+            size_t nEnd = std::min(vChecks.size(), nPos + nPerChunk);
+            std::lock_guard<std::mutex> lock(d.mutex);
+            for (; nPos < nEnd; nPos++) {
+                d.checks.emplace_back();
+                d.checks.back().swap(vChecks[nPos]);
+            }
+        }
+        nQueued += vChecks.size();
+        if (nIdle.load() > 0) {
+            boost::unique_lock<boost::mutex> lock(idleMutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
+    }
+};
+
 /** 
- * RAII-style controller object for a CCheckQueue that guarantees the passed
+ * RAII-style controller object for a check queue that guarantees the passed
  * queue is finished before continuing.
  */
 template <typename T>
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T> * const pqueue;
+    CCheckQueueBase<T> * const pqueue;
     bool fDone;
 
 public:
     CCheckQueueControl() = delete;
     CCheckQueueControl(const CCheckQueueControl&) = delete;
     CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
-    explicit CCheckQueueControl(CCheckQueue<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    explicit CCheckQueueControl(CCheckQueueBase<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
     {
         // passed queue is supposed to be unused, or NULL
         if (pqueue != NULL) {
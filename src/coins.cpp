@@ -11,6 +11,10 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <future>
+#include <set>
+
 #include <rust/history.h>
 
 #include <tracing.h>
@@ -84,6 +88,7 @@ bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins,
                             historyCacheMap, cacheSaplingSubtrees, cacheOrchardSubtrees);
 }
 bool CCoinsViewBacked::GetStats(CCoinsStats &stats) const { return base->GetStats(stats); }
+bool CCoinsViewBacked::DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const { return base->DumpSnapshot(file, metadata); }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
@@ -110,8 +115,10 @@ size_t CCoinsViewCache::DynamicMemoryUsage() const {
 
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const {
     CCoinsMap::iterator it = cacheCoins.find(txid);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.flags |= CCoinsCacheEntry::ACCESSED;
         return it;
+    }
     CCoins tmp;
     if (!base->GetCoins(txid, tmp))
         return cacheCoins.end();
@@ -122,11 +129,41 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
     }
+    ret->second.flags |= CCoinsCacheEntry::ACCESSED;
     cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
     return ret;
 }
 
 
+template<typename Tree, typename Cache, typename CacheEntry, typename Fetch>
+std::shared_ptr<const Tree> CCoinsViewCache::AbstractGetAnchorAt(
+    const uint256 &rt,
+    Cache &cacheAnchors,
+    Fetch fetch
+) const
+{
+    auto it = cacheAnchors.find(rt);
+    if (it != cacheAnchors.end()) {
+        if (it->second.entered) {
+            return it->second.tree;
+        } else {
+            return nullptr;
+        }
+    }
+
+    Tree tree;
+    if (!fetch(tree)) {
+        return nullptr;
+    }
+
+    auto ret = cacheAnchors.insert(std::make_pair(rt, CacheEntry())).first;
+    ret->second.entered = true;
+    ret->second.tree = std::make_shared<const Tree>(std::move(tree));
+    cachedCoinsUsage += AnchorTreeUsage(ret->second.tree);
+
+    return ret->second.tree;
+}
+
 bool CCoinsViewCache::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const {
     // Juno Cash: Handle empty_root specially before checking cache.
     // This prevents assertion failures when PopAnchor incorrectly marks
@@ -138,25 +175,13 @@ bool CCoinsViewCache::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tre
         return true;
     }
 
-    CAnchorsSproutMap::const_iterator it = cacheSproutAnchors.find(rt);
-    if (it != cacheSproutAnchors.end()) {
-        if (it->second.entered) {
-            tree = it->second.tree;
-            return true;
-        } else {
-            return false;
-        }
-    }
-
-    if (!base->GetSproutAnchorAt(rt, tree)) {
+    auto cached = AbstractGetAnchorAt<SproutMerkleTree, CAnchorsSproutMap, CAnchorsSproutCacheEntry>(
+        rt, cacheSproutAnchors,
+        [&](SproutMerkleTree &fetched) { return base->GetSproutAnchorAt(rt, fetched); });
+    if (!cached) {
         return false;
     }
-
-    CAnchorsSproutMap::iterator ret = cacheSproutAnchors.insert(std::make_pair(rt, CAnchorsSproutCacheEntry())).first;
-    ret->second.entered = true;
-    ret->second.tree = tree;
-    cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
-
+    tree = *cached;
     return true;
 }
 
@@ -171,48 +196,24 @@ bool CCoinsViewCache::GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &t
         return true;
     }
 
-    CAnchorsSaplingMap::const_iterator it = cacheSaplingAnchors.find(rt);
-    if (it != cacheSaplingAnchors.end()) {
-        if (it->second.entered) {
-            tree = it->second.tree;
-            return true;
-        } else {
-            return false;
-        }
-    }
-
-    if (!base->GetSaplingAnchorAt(rt, tree)) {
+    auto cached = AbstractGetAnchorAt<SaplingMerkleTree, CAnchorsSaplingMap, CAnchorsSaplingCacheEntry>(
+        rt, cacheSaplingAnchors,
+        [&](SaplingMerkleTree &fetched) { return base->GetSaplingAnchorAt(rt, fetched); });
+    if (!cached) {
         return false;
     }
-
-    CAnchorsSaplingMap::iterator ret = cacheSaplingAnchors.insert(std::make_pair(rt, CAnchorsSaplingCacheEntry())).first;
-    ret->second.entered = true;
-    ret->second.tree = tree;
-    cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
-
+    tree = *cached;
     return true;
 }
 
 bool CCoinsViewCache::GetOrchardAnchorAt(const uint256 &rt, OrchardMerkleFrontier &tree) const {
-    CAnchorsOrchardMap::const_iterator it = cacheOrchardAnchors.find(rt);
-    if (it != cacheOrchardAnchors.end()) {
-        if (it->second.entered) {
-            tree = it->second.tree;
-            return true;
-        } else {
-            return false;
-        }
-    }
-
-    if (!base->GetOrchardAnchorAt(rt, tree)) {
+    auto cached = AbstractGetAnchorAt<OrchardMerkleFrontier, CAnchorsOrchardMap, CAnchorsOrchardCacheEntry>(
+        rt, cacheOrchardAnchors,
+        [&](OrchardMerkleFrontier &fetched) { return base->GetOrchardAnchorAt(rt, fetched); });
+    if (!cached) {
         return false;
     }
-
-    CAnchorsOrchardMap::iterator ret = cacheOrchardAnchors.insert(std::make_pair(rt, CAnchorsOrchardCacheEntry())).first;
-    ret->second.entered = true;
-    ret->second.tree = tree;
-    cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
-
+    tree = *cached;
     return true;
 }
 
@@ -316,12 +317,12 @@ void CCoinsViewCache::AbstractPushAnchor(
         CacheIterator ret = insertRet.first;
 
         ret->second.entered = true;
-        ret->second.tree = tree;
+        ret->second.tree = std::make_shared<const Tree>(tree);
         ret->second.flags = CacheEntry::DIRTY;
 
         if (insertRet.second) {
             // An insert took place
-            cachedCoinsUsage += ret->second.tree.DynamicMemoryUsage();
+            cachedCoinsUsage += AnchorTreeUsage(ret->second.tree);
         }
     }
 
@@ -920,7 +921,7 @@ void BatchWriteAnchors(
                 entry.tree = child_it->second.tree;
                 entry.flags = MapEntry::DIRTY;
 
-                cachedCoinsUsage += entry.tree.DynamicMemoryUsage();
+                cachedCoinsUsage += AnchorTreeUsage(entry.tree);
             } else {
                 if (parent_it->second.entered != child_it->second.entered) {
                     // The parent may have removed the entry.
@@ -1066,6 +1067,280 @@ bool CCoinsViewCache::Flush() {
     return fOk;
 }
 
+bool CCoinsViewCache::WriteBack() {
+    assert(!hasModifier);
+    cacheSaplingSubtrees.Initialize(base);
+    cacheOrchardSubtrees.Initialize(base);
+
+    // The base takes (and may consume) copies of the modified coins; ours
+    // stay behind as clean entries, except spent ones, which are dropped.
+    CCoinsMap mapDirty;
+    size_t nCoinsUsage = 0;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            nCoinsUsage += it->second.coins.DynamicMemoryUsage();
+            ++it;
+            continue;
+        }
+        CCoinsCacheEntry& entry = mapDirty[it->first];
+        entry.flags = it->second.flags;
+        if (it->second.coins.IsPruned()) {
+            entry.coins.swap(it->second.coins);
+            it = cacheCoins.erase(it);
+        } else {
+            entry.coins = it->second.coins;
+            // Written back in this round, so recently used.
+            it->second.flags = CCoinsCacheEntry::ACCESSED;
+            nCoinsUsage += it->second.coins.DynamicMemoryUsage();
+            ++it;
+        }
+    }
+
+    bool fOk = base->BatchWrite(mapDirty,
+                                hashBlock,
+                                hashSproutAnchor,
+                                hashSaplingAnchor,
+                                hashOrchardAnchor,
+                                cacheSproutAnchors,
+                                cacheSaplingAnchors,
+                                cacheOrchardAnchors,
+                                cacheSproutNullifiers,
+                                cacheSaplingNullifiers,
+                                cacheOrchardNullifiers,
+                                historyCacheMap,
+                                cacheSaplingSubtrees,
+                                cacheOrchardSubtrees);
+    cacheSproutAnchors.clear();
+    cacheSaplingAnchors.clear();
+    cacheOrchardAnchors.clear();
+    cacheSproutNullifiers.clear();
+    cacheSaplingNullifiers.clear();
+    cacheOrchardNullifiers.clear();
+    historyCacheMap.clear();
+    cacheSaplingSubtrees.clear();
+    cacheOrchardSubtrees.clear();
+    // Anchor trees were counted in cachedCoinsUsage too.
+    cachedCoinsUsage = nCoinsUsage;
+    return fOk;
+}
+
+void CCoinsViewCache::EvictColdCoins(size_t nTargetUsage) {
+    assert(!hasModifier);
+    size_t nUsage = DynamicMemoryUsage();
+    if (nUsage <= nTargetUsage || cacheCoins.empty()) {
+        return;
+    }
+
+    // Erasing does not shrink the map itself, so track the usage the cache
+    // will have once it is compacted below, at the current cost per entry.
+    size_t nMapUsage = memusage::DynamicUsage(cacheCoins);
+    size_t nPerEntry = nMapUsage / cacheCoins.size();
+    size_t nOtherUsage = nUsage - nMapUsage - cachedCoinsUsage;
+    auto ProjectedUsage = [&]() {
+        return nOtherUsage + cacheCoins.size() * nPerEntry + cachedCoinsUsage;
+    };
+
+    // Second chance: on the first pass, coins read since the last eviction
+    // only lose their ACCESSED bit; on the second, any clean coin may go.
+    for (int pass = 0; pass < 2 && ProjectedUsage() > nTargetUsage; pass++) {
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end() && ProjectedUsage() > nTargetUsage;) {
+            if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+                ++it;
+            } else if (pass == 0 && (it->second.flags & CCoinsCacheEntry::ACCESSED)) {
+                it->second.flags &= ~CCoinsCacheEntry::ACCESSED;
+                ++it;
+            } else {
+                cachedCoinsUsage -= it->second.coins.DynamicMemoryUsage();
+                it = cacheCoins.erase(it);
+            }
+        }
+    }
+
+    // Move the survivors into a right-sized map to release the space of the
+    // evicted entries.
+    CCoinsMap compacted;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it) {
+        CCoinsCacheEntry& entry = compacted[it->first];
+        entry.coins.swap(it->second.coins);
+        entry.flags = it->second.flags;
+    }
+    cacheCoins.swap(compacted);
+}
+
+void CCoinsViewCache::Prefetch(const std::vector<CTransaction>& vtx, int nThreads) {
+    assert(!hasModifier);
+
+    // Collect the keys that are not cached yet. This is done serially, as
+    // the cache itself is not thread-safe.
+    std::set<uint256> setTxids;
+    std::vector<uint256> vTxids;
+    std::vector<std::pair<uint256, ShieldedType>> vNullifiers;
+    std::set<uint256> setSproutAnchors, setSaplingAnchors;
+    std::vector<uint256> vSproutAnchors, vSaplingAnchors, vOrchardAnchors;
+    auto AddNullifier = [&](const uint256& nf, ShieldedType type, const CNullifiersMap& cache) {
+        if (!cache.count(nf)) {
+            vNullifiers.emplace_back(nf, type);
+        }
+    };
+    std::set<uint256> setBlockTxids;
+    for (const CTransaction& tx : vtx) {
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                const uint256& txid = txin.prevout.hash;
+                if (!setBlockTxids.count(txid) && !cacheCoins.count(txid) && setTxids.insert(txid).second) {
+                    vTxids.push_back(txid);
+                }
+            }
+        }
+        for (const JSDescription& joinsplit : tx.vJoinSplit) {
+            for (const uint256& nf : joinsplit.nullifiers) {
+                AddNullifier(nf, SPROUT, cacheSproutNullifiers);
+            }
+            if (joinsplit.anchor != SproutMerkleTree::empty_root() &&
+                !cacheSproutAnchors.count(joinsplit.anchor) &&
+                setSproutAnchors.insert(joinsplit.anchor).second) {
+                vSproutAnchors.push_back(joinsplit.anchor);
+            }
+        }
+        for (const auto& spend : tx.GetSaplingSpends()) {
+            AddNullifier(uint256::FromRawBytes(spend.nullifier()), SAPLING, cacheSaplingNullifiers);
+            uint256 rt = uint256::FromRawBytes(spend.anchor());
+            if (rt != SaplingMerkleTree::empty_root() &&
+                !cacheSaplingAnchors.count(rt) &&
+                setSaplingAnchors.insert(rt).second) {
+                vSaplingAnchors.push_back(rt);
+            }
+        }
+        for (const uint256& nf : tx.GetOrchardBundle().GetNullifiers()) {
+            AddNullifier(nf, ORCHARD, cacheOrchardNullifiers);
+        }
+        std::optional<uint256> rt = tx.GetOrchardBundle().GetAnchor();
+        if (rt && !cacheOrchardAnchors.count(*rt) &&
+            std::find(vOrchardAnchors.begin(), vOrchardAnchors.end(), *rt) == vOrchardAnchors.end()) {
+            vOrchardAnchors.push_back(*rt);
+        }
+        setBlockTxids.insert(tx.GetHash());
+    }
+
+    // Read them from the base view in parallel. Each key has its own result
+    // slot, so the workers share nothing but the base view.
+    std::vector<std::optional<CCoins>> vCoins(vTxids.size());
+    std::vector<char> vNullifierEntered(vNullifiers.size());
+    std::vector<std::optional<SproutMerkleTree>> vSproutTrees(vSproutAnchors.size());
+    std::vector<std::optional<SaplingMerkleTree>> vSaplingTrees(vSaplingAnchors.size());
+    std::vector<std::optional<OrchardMerkleFrontier>> vOrchardTrees(vOrchardAnchors.size());
+    size_t nKeys = vTxids.size() + vNullifiers.size() + vSproutAnchors.size() + vSaplingAnchors.size() + vOrchardAnchors.size();
+    if (nKeys == 0) {
+        return;
+    }
+
+    auto fetchRange = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            size_t j = i;
+            if (j < vTxids.size()) {
+                vCoins[j].emplace();
+                if (!base->GetCoins(vTxids[j], *vCoins[j])) {
+                    vCoins[j].reset();
+                }
+                continue;
+            }
+            j -= vTxids.size();
+            if (j < vNullifiers.size()) {
+                vNullifierEntered[j] = base->GetNullifier(vNullifiers[j].first, vNullifiers[j].second);
+                continue;
+            }
+            j -= vNullifiers.size();
+            if (j < vSproutAnchors.size()) {
+                vSproutTrees[j].emplace();
+                if (!base->GetSproutAnchorAt(vSproutAnchors[j], *vSproutTrees[j])) {
+                    vSproutTrees[j].reset();
+                }
+                continue;
+            }
+            j -= vSproutAnchors.size();
+            if (j < vSaplingAnchors.size()) {
+                vSaplingTrees[j].emplace();
+                if (!base->GetSaplingAnchorAt(vSaplingAnchors[j], *vSaplingTrees[j])) {
+                    vSaplingTrees[j].reset();
+                }
+                continue;
+            }
+            j -= vSaplingAnchors.size();
+            vOrchardTrees[j].emplace();
+            if (!base->GetOrchardAnchorAt(vOrchardAnchors[j], *vOrchardTrees[j])) {
+                vOrchardTrees[j].reset();
+            }
+        }
+    };
+
+    size_t nWorkers = std::min<size_t>(std::max(nThreads, 1), nKeys / COINS_PREFETCH_MIN_PER_WORKER);
+    if (nWorkers <= 1) {
+        fetchRange(0, nKeys);
+    } else {
+        size_t nPerWorker = (nKeys + nWorkers - 1) / nWorkers;
+        std::vector<std::future<void>> vWorkers;
+        for (size_t nBegin = nPerWorker; nBegin < nKeys; nBegin += nPerWorker) {
+            vWorkers.push_back(std::async(std::launch::async, fetchRange,
+                nBegin, std::min(nKeys, nBegin + nPerWorker)));
+        }
+        fetchRange(0, std::min(nKeys, nPerWorker));
+        for (auto& worker : vWorkers) {
+            worker.get();
+        }
+    }
+
+    // Insert the results as FetchCoins, GetNullifier and the anchor getters
+    // would have.
+    for (size_t i = 0; i < vTxids.size(); i++) {
+        if (!vCoins[i]) {
+            continue;
+        }
+        CCoinsMap::iterator ret = cacheCoins.insert(std::make_pair(vTxids[i], CCoinsCacheEntry())).first;
+        vCoins[i]->swap(ret->second.coins);
+        if (ret->second.coins.IsPruned()) {
+            ret->second.flags = CCoinsCacheEntry::FRESH;
+        }
+        ret->second.flags |= CCoinsCacheEntry::ACCESSED;
+        cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
+    }
+    for (size_t i = 0; i < vNullifiers.size(); i++) {
+        CNullifiersCacheEntry entry;
+        entry.entered = vNullifierEntered[i];
+        switch (vNullifiers[i].second) {
+            case SPROUT:
+                cacheSproutNullifiers.insert(std::make_pair(vNullifiers[i].first, entry));
+                break;
+            case SAPLING:
+                cacheSaplingNullifiers.insert(std::make_pair(vNullifiers[i].first, entry));
+                break;
+            case ORCHARD:
+                cacheOrchardNullifiers.insert(std::make_pair(vNullifiers[i].first, entry));
+                break;
+        }
+    }
+    for (size_t i = 0; i < vSproutAnchors.size(); i++) {
+        if (!vSproutTrees[i]) continue;
+        CAnchorsSproutMap::iterator ret = cacheSproutAnchors.insert(std::make_pair(vSproutAnchors[i], CAnchorsSproutCacheEntry())).first;
+        ret->second.entered = true;
+        ret->second.tree = std::make_shared<const SproutMerkleTree>(std::move(*vSproutTrees[i]));
+        cachedCoinsUsage += AnchorTreeUsage(ret->second.tree);
+    }
+    for (size_t i = 0; i < vSaplingAnchors.size(); i++) {
+        if (!vSaplingTrees[i]) continue;
+        CAnchorsSaplingMap::iterator ret = cacheSaplingAnchors.insert(std::make_pair(vSaplingAnchors[i], CAnchorsSaplingCacheEntry())).first;
+        ret->second.entered = true;
+        ret->second.tree = std::make_shared<const SaplingMerkleTree>(std::move(*vSaplingTrees[i]));
+        cachedCoinsUsage += AnchorTreeUsage(ret->second.tree);
+    }
+    for (size_t i = 0; i < vOrchardAnchors.size(); i++) {
+        if (!vOrchardTrees[i]) continue;
+        CAnchorsOrchardMap::iterator ret = cacheOrchardAnchors.insert(std::make_pair(vOrchardAnchors[i], CAnchorsOrchardCacheEntry())).first;
+        ret->second.entered = true;
+        ret->second.tree = std::make_shared<const OrchardMerkleFrontier>(std::move(*vOrchardTrees[i]));
+        cachedCoinsUsage += AnchorTreeUsage(ret->second.tree);
+    }
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -1171,8 +1446,12 @@ tl::expected<void, UnsatisfiedShieldedReq> CCoinsViewCache::CheckShieldedRequire
 
     std::optional<uint256> root = tx.GetOrchardBundle().GetAnchor();
     if (root) {
-        OrchardMerkleFrontier tree;
-        if (!GetOrchardAnchorAt(root.value(), tree)) {
+        // Only the anchor's presence matters here, so look at the cached
+        // tree without copying it.
+        auto tree = AbstractGetAnchorAt<OrchardMerkleFrontier, CAnchorsOrchardMap, CAnchorsOrchardCacheEntry>(
+            root.value(), cacheOrchardAnchors,
+            [&](OrchardMerkleFrontier &fetched) { return base->GetOrchardAnchorAt(root.value(), fetched); });
+        if (!tree) {
             auto txid = tx.GetHash().ToString();
             auto anchor = root.value().ToString();
             TracingWarn("consensus", "Transaction uses unknown Orchard anchor",
@@ -9,12 +9,14 @@
 
 #include "compressor.h"
 #include "core_memusage.h"
+#include "flatmap.h"
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
 #include "uint256.h"
 
 #include <assert.h>
+#include <memory>
 #include <stdint.h>
 
 #include <boost/unordered_map.hpp>
@@ -272,15 +274,27 @@ struct CCoinsCacheEntry
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
+        ACCESSED = (1 << 2), // This cache entry was read since the last EvictColdCoins.
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
+/**
+ * Anchor cache entries point to an immutable tree, so that passing an entry
+ * between cache layers does not copy the tree. A tree is copied only when it
+ * first enters a cache. Entries that only record a removal may have no tree.
+ */
+template<typename Tree>
+size_t AnchorTreeUsage(const std::shared_ptr<const Tree>& tree)
+{
+    return tree ? tree->DynamicMemoryUsage() : 0;
+}
+
 struct CAnchorsSproutCacheEntry
 {
     bool entered; // This will be false if the anchor is removed from the cache
-    SproutMerkleTree tree; // The tree itself
+    std::shared_ptr<const SproutMerkleTree> tree; // The tree itself, shared by every copy of this entry
     unsigned char flags;
 
     enum Flags {
@@ -293,7 +307,7 @@ struct CAnchorsSproutCacheEntry
 struct CAnchorsSaplingCacheEntry
 {
     bool entered; // This will be false if the anchor is removed from the cache
-    SaplingMerkleTree tree; // The tree itself
+    std::shared_ptr<const SaplingMerkleTree> tree; // The tree itself, shared by every copy of this entry
     unsigned char flags;
 
     enum Flags {
@@ -306,7 +320,7 @@ struct CAnchorsSaplingCacheEntry
 struct CAnchorsOrchardCacheEntry
 {
     bool entered; // This will be false if the anchor is removed from the cache
-    OrchardMerkleFrontier tree; // The tree itself
+    std::shared_ptr<const OrchardMerkleFrontier> tree; // The tree itself, shared by every copy of this entry
     unsigned char flags;
 
     enum Flags {
@@ -338,11 +352,11 @@ enum ShieldedType: uint8_t
     ORCHARD = 0x03,
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
-typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, SaltedTxidHasher> CAnchorsSproutMap;
-typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, SaltedTxidHasher> CAnchorsSaplingMap;
-typedef boost::unordered_map<uint256, CAnchorsOrchardCacheEntry, SaltedTxidHasher> CAnchorsOrchardMap;
-typedef boost::unordered_map<uint256, CNullifiersCacheEntry, SaltedTxidHasher> CNullifiersMap;
+typedef flatmap<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
+typedef flatmap<uint256, CAnchorsSproutCacheEntry, SaltedTxidHasher> CAnchorsSproutMap;
+typedef flatmap<uint256, CAnchorsSaplingCacheEntry, SaltedTxidHasher> CAnchorsSaplingMap;
+typedef flatmap<uint256, CAnchorsOrchardCacheEntry, SaltedTxidHasher> CAnchorsOrchardMap;
+typedef flatmap<uint256, CNullifiersCacheEntry, SaltedTxidHasher> CNullifiersMap;
 typedef boost::unordered_map<uint32_t, HistoryCache> CHistoryCacheMap;
 
 struct CCoinsStats
@@ -358,6 +372,22 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
+/** A summary of a chain state snapshot written by CCoinsView::DumpSnapshot. */
+struct CCoinsSnapshotMetadata
+{
+    //! The block whose chain state the snapshot holds
+    uint256 hashBlock;
+    //! Number of database records in the snapshot, and of them coins records
+    uint64_t nRecords;
+    uint64_t nCoins;
+    //! Hash of the block hash and every record, as committed in chainparams
+    uint256 hashSnapshot;
+
+    CCoinsSnapshotMetadata() : nRecords(0), nCoins(0) {}
+};
+
+class CAutoFile;
+
 class SubtreeCache;
 
 /** Abstract view on the open txout dataset. */
@@ -442,6 +472,10 @@ public:
     //! Calculate statistics about the unspent transaction output set
     virtual bool GetStats(CCoinsStats &stats) const = 0;
 
+    //! Write the whole flushed chain state (coins, nullifier sets, anchors,
+    //! history trees and subtrees) to a snapshot file
+    virtual bool DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const { return false; }
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 };
@@ -579,6 +613,7 @@ public:
                     SubtreeCache &cacheSaplingSubtrees,
                     SubtreeCache &cacheOrchardSubtrees);
     bool GetStats(CCoinsStats &stats) const;
+    bool DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const;
 };
 
 
@@ -614,6 +649,9 @@ enum class UnsatisfiedShieldedReq {
     OrchardUnknownAnchor,
 };
 
+/** Minimum number of keys per thread when prefetching into a coins view cache */
+static const size_t COINS_PREFETCH_MIN_PER_WORKER = 16;
+
 /** CCoinsView that adds a memory cache for transactions to another CCoinsView */
 class CCoinsViewCache : public CCoinsViewBacked
 {
@@ -740,6 +778,33 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base, like Flush,
+     * but keep clean copies of the unspent coins so that they can still be
+     * served from memory. Only the coins are retained; anchors, nullifiers
+     * and history are dropped as in Flush.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool WriteBack();
+
+    /**
+     * Evict clean coins until the cache uses at most nTargetUsage bytes,
+     * taking those not read since the previous call first. Modified coins
+     * are never evicted, so call WriteBack first to make them evictable.
+     * Must not be called while a cache on top of this one has unflushed
+     * changes, as those may depend on the evicted entries.
+     */
+    void EvictColdCoins(size_t nTargetUsage);
+
+    /**
+     * Load the coins spent by the given transactions, and the nullifiers and
+     * anchors they refer to, into the cache ahead of use. Whatever is not
+     * cached yet is read from the base view on up to nThreads threads
+     * (including the calling one), so the base view must support concurrent
+     * reads. Coins created by earlier transactions in vtx are not fetched.
+     */
+    void Prefetch(const std::vector<CTransaction>& vtx, int nThreads);
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
@@ -801,6 +866,16 @@ private:
         uint256 &hash
     );
 
+    //! Generalized interface for looking up anchors. Returns the cached tree,
+    //! fetching it from the base view on a miss, or null if the anchor is
+    //! unknown.
+    template<typename Tree, typename Cache, typename CacheEntry, typename Fetch>
+    std::shared_ptr<const Tree> AbstractGetAnchorAt(
+        const uint256 &rt,
+        Cache &cacheAnchors,
+        Fetch fetch
+    ) const;
+
     //! Interface for bringing an anchor into the cache.
     template<typename Tree>
     void BringBestAnchorIntoCache(
@@ -496,6 +496,8 @@ struct Params {
     uint256 powLimit;
     std::optional<uint32_t> nPowAllowMinDifficultyBlocksAfterHeight;
     bool fPowNoRetargeting;
+    /** Regtest only: use a BLAKE2b hash in place of RandomX, see GetPoWHash */
+    bool fPowFastHash = false;
     int64_t nPowAveragingWindow;
     int64_t nPowMaxAdjustDown;
     int64_t nPowMaxAdjustUp;
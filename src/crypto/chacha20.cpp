@@ -8,9 +8,19 @@
 
 #include "crypto/common.h"
 #include "crypto/chacha20.h"
+#include "crypto/cpu_features.h"
 
 #include <string.h>
 
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace chacha20_avx2
+{
+static const size_t BATCH_BYTES = 8 * 64;
+/** Crypt a multiple of BATCH_BYTES, eight blocks at a time, advancing the block counter in input. */
+void Crypt_8way(uint32_t* input, const unsigned char* m, unsigned char* c, size_t bytes);
+}
+#endif
+
 constexpr static inline uint32_t rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
 
 #define QUARTERROUND(a,b,c,d) \
@@ -72,7 +82,8 @@ void ChaCha20::Seek(uint64_t pos)
     input[13] = pos >> 32;
 }
 
-void ChaCha20::Output(unsigned char* c, size_t bytes)
+/** Write bytes of keystream to c, XORed with m unless it is NULL. */
+static void ChaCha20Crypt(uint32_t* input, const unsigned char* m, unsigned char* c, size_t bytes)
 {
     uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
     uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
@@ -101,6 +112,10 @@ void ChaCha20::Output(unsigned char* c, size_t bytes)
 
     for (;;) {
         if (bytes < 64) {
+            if (m) {
+                for (i = 0;i < bytes;++i) tmp[i] = m[i];
+                m = tmp;
+            }
             ctarget = c;
             c = tmp;
         }
@@ -147,6 +162,25 @@ void ChaCha20::Output(unsigned char* c, size_t bytes)
         x14 += j14;
         x15 += j15;
 
+        if (m) {
+            x0 ^= ReadLE32(m + 0);
+            x1 ^= ReadLE32(m + 4);
+            x2 ^= ReadLE32(m + 8);
+            x3 ^= ReadLE32(m + 12);
+            x4 ^= ReadLE32(m + 16);
+            x5 ^= ReadLE32(m + 20);
+            x6 ^= ReadLE32(m + 24);
+            x7 ^= ReadLE32(m + 28);
+            x8 ^= ReadLE32(m + 32);
+            x9 ^= ReadLE32(m + 36);
+            x10 ^= ReadLE32(m + 40);
+            x11 ^= ReadLE32(m + 44);
+            x12 ^= ReadLE32(m + 48);
+            x13 ^= ReadLE32(m + 52);
+            x14 ^= ReadLE32(m + 56);
+            x15 ^= ReadLE32(m + 60);
+        }
+
         ++j12;
         if (!j12) ++j13;
 
@@ -177,5 +211,26 @@ void ChaCha20::Output(unsigned char* c, size_t bytes)
         }
         bytes -= 64;
         c += 64;
+        if (m) m += 64;
+    }
+}
+
+void ChaCha20::Output(unsigned char* c, size_t bytes)
+{
+    ChaCha20Crypt(input, NULL, c, bytes);
+}
+
+void ChaCha20::Crypt(const unsigned char* m, unsigned char* c, size_t bytes)
+{
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    static const bool fAVX2 = CPUFeatures::HasAVX2();
+    if (fAVX2 && bytes >= chacha20_avx2::BATCH_BYTES) {
+        size_t batch = bytes - bytes % chacha20_avx2::BATCH_BYTES;
+        chacha20_avx2::Crypt_8way(input, m, c, batch);
+        m += batch;
+        c += batch;
+        bytes -= batch;
     }
+#endif
+    ChaCha20Crypt(input, m, c, bytes);
 }
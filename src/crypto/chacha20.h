@@ -22,6 +22,11 @@ public:
     void SetIV(uint64_t iv);
     void Seek(uint64_t pos);
     void Output(unsigned char* output, size_t bytes);
+    /**
+     * XOR bytes of keystream into m, writing to c (which may equal m). Like
+     * Output, each call starts at a new block. Uses AVX2 where the CPU has it.
+     */
+    void Crypt(const unsigned char* m, unsigned char* c, size_t bytes);
 };
 
 #endif // BITCOIN_CRYPTO_CHACHA20_H
@@ -0,0 +1,146 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <immintrin.h>
+
+namespace chacha20_avx2 {
+namespace {
+
+/**
+ * Eight ChaCha20 blocks are computed at once, with lane i of each vector
+ * holding a word of block i.
+ */
+
+__m256i inline K(uint32_t x) { return _mm256_set1_epi32(x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+__m256i inline RotL16(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                                  13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+__m256i inline RotL8(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                                  14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+}
+
+void inline __attribute__((always_inline)) QuarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(a, b); d = RotL16(Xor(d, a));
+    c = Add(c, d); b = RotL(Xor(b, c), 12);
+    a = Add(a, b); d = RotL8(Xor(d, a));
+    c = Add(c, d); b = RotL(Xor(b, c), 7);
+}
+
+/** Turn eight vectors holding a word of each block into eight holding eight words of one block. */
+void inline __attribute__((always_inline)) Transpose(__m256i& r0, __m256i& r1, __m256i& r2, __m256i& r3,
+                                                     __m256i& r4, __m256i& r5, __m256i& r6, __m256i& r7)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1), t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3), t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5), t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7), t7 = _mm256_unpackhi_epi32(r6, r7);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+    r0 = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r1 = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r2 = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r3 = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r4 = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r5 = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r6 = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r7 = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/** XOR 32 bytes of keystream into m at offset, writing to c. */
+void inline __attribute__((always_inline)) Write(const unsigned char* m, unsigned char* c, size_t offset, __m256i x)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)(m + offset));
+    _mm256_storeu_si256((__m256i*)(c + offset), Xor(v, x));
+}
+
+}
+
+void Crypt_8way(uint32_t* input, const unsigned char* m, unsigned char* c, size_t bytes)
+{
+    const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (; bytes >= 512; bytes -= 512, m += 512, c += 512) {
+        // The 64-bit block counter in words 12 and 13 goes up by one from lane to lane.
+        uint64_t pos = ((uint64_t)input[13] << 32) | input[12];
+        __m256i j12 = Add(K(input[12]), lanes);
+        // Lanes whose low word wrapped around carry into the high word.
+        __m256i carry = _mm256_cmpgt_epi32(Xor(K(input[12]), K(0x80000000)), Xor(j12, K(0x80000000)));
+        __m256i j13 = _mm256_sub_epi32(K(input[13]), carry);
+
+        __m256i x0 = K(input[0]), x1 = K(input[1]), x2 = K(input[2]), x3 = K(input[3]);
+        __m256i x4 = K(input[4]), x5 = K(input[5]), x6 = K(input[6]), x7 = K(input[7]);
+        __m256i x8 = K(input[8]), x9 = K(input[9]), x10 = K(input[10]), x11 = K(input[11]);
+        __m256i x12 = j12, x13 = j13, x14 = K(input[14]), x15 = K(input[15]);
+
+        for (int i = 0; i < 10; i++) {
+            QuarterRound(x0, x4, x8, x12);
+            QuarterRound(x1, x5, x9, x13);
+            QuarterRound(x2, x6, x10, x14);
+            QuarterRound(x3, x7, x11, x15);
+            QuarterRound(x0, x5, x10, x15);
+            QuarterRound(x1, x6, x11, x12);
+            QuarterRound(x2, x7, x8, x13);
+            QuarterRound(x3, x4, x9, x14);
+        }
+
+        x0 = Add(x0, K(input[0]));
+        x1 = Add(x1, K(input[1]));
+        x2 = Add(x2, K(input[2]));
+        x3 = Add(x3, K(input[3]));
+        x4 = Add(x4, K(input[4]));
+        x5 = Add(x5, K(input[5]));
+        x6 = Add(x6, K(input[6]));
+        x7 = Add(x7, K(input[7]));
+        x8 = Add(x8, K(input[8]));
+        x9 = Add(x9, K(input[9]));
+        x10 = Add(x10, K(input[10]));
+        x11 = Add(x11, K(input[11]));
+        x12 = Add(x12, j12);
+        x13 = Add(x13, j13);
+        x14 = Add(x14, K(input[14]));
+        x15 = Add(x15, K(input[15]));
+
+        Transpose(x0, x1, x2, x3, x4, x5, x6, x7);
+        Transpose(x8, x9, x10, x11, x12, x13, x14, x15);
+
+        Write(m, c, 0, x0);
+        Write(m, c, 32, x8);
+        Write(m, c, 64, x1);
+        Write(m, c, 96, x9);
+        Write(m, c, 128, x2);
+        Write(m, c, 160, x10);
+        Write(m, c, 192, x3);
+        Write(m, c, 224, x11);
+        Write(m, c, 256, x4);
+        Write(m, c, 288, x12);
+        Write(m, c, 320, x5);
+        Write(m, c, 352, x13);
+        Write(m, c, 384, x6);
+        Write(m, c, 416, x14);
+        Write(m, c, 448, x7);
+        Write(m, c, 480, x15);
+
+        pos += 8;
+        input[12] = pos;
+        input[13] = pos >> 32;
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "crypto/chacha20poly1305.h"
+
+#include "crypto/common.h"
+
+#include <algorithm>
+#include <string.h>
+
+/**
+ * Crypt in1 followed by in2 into out1 followed by out2, with one keystream
+ * running across both. ChaCha20::Crypt starts each call at a new block, so a
+ * block that straddles the two parts is put together first.
+ */
+static void CryptParts(ChaCha20& chacha, const unsigned char* in1, unsigned char* out1, size_t len1,
+                       const unsigned char* in2, unsigned char* out2, size_t len2)
+{
+    size_t nFull = len1 - len1 % 64;
+    chacha.Crypt(in1, out1, nFull);
+    size_t nTail = len1 - nFull;
+    if (nTail) {
+        unsigned char block[64];
+        size_t nHead = std::min(len2, sizeof(block) - nTail);
+        memcpy(block, in1 + nFull, nTail);
+        if (nHead)
+            memcpy(block + nTail, in2, nHead);
+        chacha.Crypt(block, block, nTail + nHead);
+        memcpy(out1 + nFull, block, nTail);
+        if (nHead)
+            memcpy(out2, block + nTail, nHead);
+        in2 += nHead;
+        out2 += nHead;
+        len2 -= nHead;
+    }
+    chacha.Crypt(in2, out2, len2);
+}
+
+AEADChaCha20Poly1305::AEADChaCha20Poly1305(const unsigned char* key)
+{
+    SetKey(key);
+}
+
+void AEADChaCha20Poly1305::SetKey(const unsigned char* key)
+{
+    chacha.SetKey(key, KEYLEN);
+}
+
+void AEADChaCha20Poly1305::Seek(uint32_t nonce0, uint64_t nonce1, uint32_t block)
+{
+    // Word 12 is the block counter and words 13 to 15 the nonce.
+    chacha.Seek(((uint64_t)nonce0 << 32) | block);
+    chacha.SetIV(nonce1);
+}
+
+void AEADChaCha20Poly1305::ComputeTag(const unsigned char* aad, size_t aadlen, const unsigned char* cipher, size_t cipherlen, unsigned char* tag)
+{
+    // The Poly1305 key is the start of block 0, which is not used to encrypt.
+    unsigned char key[64];
+    chacha.Output(key, sizeof(key));
+    Poly1305 poly1305(key);
+
+    static const unsigned char zero[16] = {};
+    unsigned char lengths[16];
+    WriteLE64(lengths, aadlen);
+    WriteLE64(lengths + 8, cipherlen);
+    poly1305.Update(aad, aadlen).Update(zero, (16 - aadlen % 16) % 16);
+    poly1305.Update(cipher, cipherlen).Update(zero, (16 - cipherlen % 16) % 16);
+    poly1305.Update(lengths, sizeof(lengths));
+    poly1305.Finalize(tag);
+    memset(key, 0, sizeof(key));
+}
+
+void AEADChaCha20Poly1305::Encrypt(const unsigned char* plain1, size_t len1, const unsigned char* plain2, size_t len2,
+                                   const unsigned char* aad, size_t aadlen, uint32_t nonce0, uint64_t nonce1, unsigned char* cipher)
+{
+    Seek(nonce0, nonce1, 1);
+    CryptParts(chacha, plain1, cipher, len1, plain2, cipher + len1, len2);
+    Seek(nonce0, nonce1, 0);
+    ComputeTag(aad, aadlen, cipher, len1 + len2, cipher + len1 + len2);
+}
+
+bool AEADChaCha20Poly1305::Decrypt(const unsigned char* cipher, size_t cipherlen, const unsigned char* aad, size_t aadlen,
+                                   uint32_t nonce0, uint64_t nonce1, unsigned char* plain1, size_t len1, unsigned char* plain2)
+{
+    if (cipherlen < EXPANSION || len1 > cipherlen - EXPANSION)
+        return false;
+    size_t nContents = cipherlen - EXPANSION;
+
+    unsigned char tag[Poly1305::TAGLEN];
+    Seek(nonce0, nonce1, 0);
+    ComputeTag(aad, aadlen, cipher, nContents, tag);
+    // Compare in constant time.
+    unsigned char diff = 0;
+    for (size_t i = 0; i < sizeof(tag); i++)
+        diff |= tag[i] ^ cipher[nContents + i];
+    if (diff)
+        return false;
+
+    Seek(nonce0, nonce1, 1);
+    CryptParts(chacha, cipher, plain1, len1, cipher + len1, plain2, nContents - len1);
+    return true;
+}
+
+void AEADChaCha20Poly1305::Keystream(uint32_t nonce0, uint64_t nonce1, unsigned char* out, size_t len)
+{
+    Seek(nonce0, nonce1, 0);
+    chacha.Output(out, len);
+}
+
+FSChaCha20::FSChaCha20(const unsigned char* key, uint32_t nRekeyIntervalIn) :
+    chacha(key, KEYLEN), nRekeyInterval(nRekeyIntervalIn)
+{
+    chacha.SetIV(0);
+    chacha.Seek(0);
+}
+
+void FSChaCha20::Keystream(const unsigned char* in, unsigned char* out, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (nBufferPos == sizeof(buffer)) {
+            chacha.Output(buffer, sizeof(buffer));
+            nBufferPos = 0;
+        }
+        out[i] = (in ? in[i] : 0) ^ buffer[nBufferPos++];
+    }
+}
+
+void FSChaCha20::Crypt(const unsigned char* in, unsigned char* out, size_t len)
+{
+    Keystream(in, out, len);
+
+    if (++nChunkCounter == nRekeyInterval) {
+        unsigned char key[KEYLEN];
+        Keystream(NULL, key, sizeof(key));
+        chacha.SetKey(key, sizeof(key));
+        memset(key, 0, sizeof(key));
+        nChunkCounter = 0;
+        nRekeyCounter++;
+        // The nonce is (0, rekey counter).
+        chacha.SetIV(nRekeyCounter);
+        chacha.Seek(0);
+        nBufferPos = sizeof(buffer);
+    }
+}
+
+FSChaCha20Poly1305::FSChaCha20Poly1305(const unsigned char* key, uint32_t nRekeyIntervalIn) :
+    aead(key), nRekeyInterval(nRekeyIntervalIn)
+{
+}
+
+void FSChaCha20Poly1305::NextPacket()
+{
+    if (++nPacketCounter == nRekeyInterval) {
+        // The new key comes from a nonce no packet uses.
+        unsigned char block[64];
+        aead.Keystream(0xffffffff, nRekeyCounter, block, sizeof(block));
+        aead.SetKey(block);
+        memset(block, 0, sizeof(block));
+        nPacketCounter = 0;
+        nRekeyCounter++;
+    }
+}
+
+void FSChaCha20Poly1305::Encrypt(const unsigned char* plain1, size_t len1, const unsigned char* plain2, size_t len2,
+                                 const unsigned char* aad, size_t aadlen, unsigned char* cipher)
+{
+    aead.Encrypt(plain1, len1, plain2, len2, aad, aadlen, nPacketCounter, nRekeyCounter, cipher);
+    NextPacket();
+}
+
+bool FSChaCha20Poly1305::Decrypt(const unsigned char* cipher, size_t cipherlen, const unsigned char* aad, size_t aadlen,
+                                 unsigned char* plain1, size_t len1, unsigned char* plain2)
+{
+    bool ret = aead.Decrypt(cipher, cipherlen, aad, aadlen, nPacketCounter, nRekeyCounter, plain1, len1, plain2);
+    NextPacket();
+    return ret;
+}
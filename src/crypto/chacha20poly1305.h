@@ -0,0 +1,113 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_CRYPTO_CHACHA20POLY1305_H
+#define BITCOIN_CRYPTO_CHACHA20POLY1305_H
+
+#include "crypto/chacha20.h"
+#include "crypto/poly1305.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * The ChaCha20-Poly1305 AEAD of RFC 8439. Its 96-bit nonce is given as a
+ * 32-bit and a 64-bit integer, which are serialized little-endian one after
+ * the other.
+ */
+class AEADChaCha20Poly1305
+{
+private:
+    ChaCha20 chacha;
+
+    void Seek(uint32_t nonce0, uint64_t nonce1, uint32_t block);
+    void ComputeTag(const unsigned char* aad, size_t aadlen, const unsigned char* cipher, size_t cipherlen, unsigned char* tag);
+
+public:
+    static constexpr size_t KEYLEN = 32;
+    /** How many bytes longer a ciphertext is than its plaintext. */
+    static constexpr size_t EXPANSION = Poly1305::TAGLEN;
+
+    explicit AEADChaCha20Poly1305(const unsigned char* key);
+
+    void SetKey(const unsigned char* key);
+
+    /**
+     * Encrypt plain1 followed by plain2, writing len1 + len2 + EXPANSION
+     * bytes to cipher. Either may be empty.
+     */
+    void Encrypt(const unsigned char* plain1, size_t len1, const unsigned char* plain2, size_t len2,
+                 const unsigned char* aad, size_t aadlen, uint32_t nonce0, uint64_t nonce1, unsigned char* cipher);
+
+    /**
+     * Authenticate and decrypt cipherlen bytes of cipher, writing the first
+     * len1 bytes of plaintext to plain1 and the rest to plain2. Returns false,
+     * having written nothing, if cipher is not authentic.
+     */
+    bool Decrypt(const unsigned char* cipher, size_t cipherlen, const unsigned char* aad, size_t aadlen,
+                 uint32_t nonce0, uint64_t nonce1, unsigned char* plain1, size_t len1, unsigned char* plain2);
+
+    /** Write len bytes of the keystream for a nonce, starting with the block that makes the Poly1305 key. */
+    void Keystream(uint32_t nonce0, uint64_t nonce1, unsigned char* out, size_t len);
+};
+
+/**
+ * ChaCha20 with forward secrecy, as BIP 324 uses to encrypt packet lengths.
+ * Each call to Crypt encrypts a chunk with the keystream that follows the
+ * previous chunk's, and after rekey_interval chunks the key is replaced by
+ * the next 32 bytes of keystream.
+ */
+class FSChaCha20
+{
+private:
+    ChaCha20 chacha;
+    const uint32_t nRekeyInterval;
+    uint32_t nChunkCounter = 0;
+    uint64_t nRekeyCounter = 0;
+    //! Keystream left over from the last block.
+    unsigned char buffer[64];
+    size_t nBufferPos = sizeof(buffer);
+
+    /** Write the next len bytes of keystream to out, XORed with in unless it is NULL. */
+    void Keystream(const unsigned char* in, unsigned char* out, size_t len);
+
+public:
+    static constexpr size_t KEYLEN = 32;
+
+    FSChaCha20(const unsigned char* key, uint32_t nRekeyIntervalIn);
+
+    void Crypt(const unsigned char* in, unsigned char* out, size_t len);
+};
+
+/**
+ * ChaCha20-Poly1305 with forward secrecy, as BIP 324 uses to encrypt
+ * packets. The nonce counts packets, and after rekey_interval packets the key
+ * is replaced by keystream of a nonce no packet uses.
+ */
+class FSChaCha20Poly1305
+{
+private:
+    AEADChaCha20Poly1305 aead;
+    const uint32_t nRekeyInterval;
+    uint32_t nPacketCounter = 0;
+    uint64_t nRekeyCounter = 0;
+
+    void NextPacket();
+
+public:
+    static constexpr size_t KEYLEN = AEADChaCha20Poly1305::KEYLEN;
+    static constexpr size_t EXPANSION = AEADChaCha20Poly1305::EXPANSION;
+
+    FSChaCha20Poly1305(const unsigned char* key, uint32_t nRekeyIntervalIn);
+
+    /** Encrypt the next packet, as AEADChaCha20Poly1305::Encrypt does. */
+    void Encrypt(const unsigned char* plain1, size_t len1, const unsigned char* plain2, size_t len2,
+                 const unsigned char* aad, size_t aadlen, unsigned char* cipher);
+
+    /** Decrypt the next packet, as AEADChaCha20Poly1305::Decrypt does. */
+    bool Decrypt(const unsigned char* cipher, size_t cipherlen, const unsigned char* aad, size_t aadlen,
+                 unsigned char* plain1, size_t len1, unsigned char* plain2);
+};
+
+#endif // BITCOIN_CRYPTO_CHACHA20POLY1305_H
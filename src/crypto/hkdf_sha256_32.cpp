@@ -0,0 +1,24 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "crypto/hkdf_sha256_32.h"
+
+#include <string.h>
+
+CHKDF_HMAC_SHA256_L32::CHKDF_HMAC_SHA256_L32(const unsigned char* ikm, size_t ikmlen, const std::string& salt)
+{
+    CHMAC_SHA256((const unsigned char*)salt.data(), salt.size()).Write(ikm, ikmlen).Finalize(prk);
+}
+
+CHKDF_HMAC_SHA256_L32::~CHKDF_HMAC_SHA256_L32()
+{
+    memset(prk, 0, sizeof(prk));
+}
+
+void CHKDF_HMAC_SHA256_L32::Expand32(const std::string& info, unsigned char hash[OUTPUT_SIZE])
+{
+    // One block of output: T(1) = HMAC(PRK, info | 0x01).
+    static const unsigned char one[1] = {1};
+    CHMAC_SHA256(prk, sizeof(prk)).Write((const unsigned char*)info.data(), info.size()).Write(one, 1).Finalize(hash);
+}
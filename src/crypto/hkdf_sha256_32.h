@@ -0,0 +1,31 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_CRYPTO_HKDF_SHA256_32_H
+#define BITCOIN_CRYPTO_HKDF_SHA256_32_H
+
+#include "crypto/hmac_sha256.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** HKDF with HMAC-SHA256 (RFC 5869), limited to outputs of 32 bytes. */
+class CHKDF_HMAC_SHA256_L32
+{
+private:
+    unsigned char prk[32];
+
+public:
+    static constexpr size_t OUTPUT_SIZE = 32;
+
+    /** Extract a pseudorandom key from the input keying material and a salt. */
+    CHKDF_HMAC_SHA256_L32(const unsigned char* ikm, size_t ikmlen, const std::string& salt);
+    ~CHKDF_HMAC_SHA256_L32();
+
+    /** Expand the key with info into 32 bytes of output. */
+    void Expand32(const std::string& info, unsigned char hash[OUTPUT_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_HKDF_SHA256_32_H
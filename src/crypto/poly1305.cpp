@@ -0,0 +1,284 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+// Based on the public domain implementations 'poly1305-donna-64' and
+// 'poly1305-donna-32' by Andrew Moon.
+// See https://github.com/floodyberry/poly1305-donna.
+
+#include "crypto/common.h"
+#include "crypto/poly1305.h"
+
+#include <string.h>
+
+#if defined(__SIZEOF_INT128__)
+
+typedef unsigned __int128 uint128_t;
+
+Poly1305::Poly1305(const unsigned char* key)
+{
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff, in 44-bit limbs
+    uint64_t t0 = ReadLE64(key + 0);
+    uint64_t t1 = ReadLE64(key + 8);
+    r[0] = (t0) & 0xffc0fffffff;
+    r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffff;
+    r[2] = ((t1 >> 24)) & 0x00ffffffc0f;
+
+    memset(h, 0, sizeof(h));
+
+    pad[0] = ReadLE64(key + 16);
+    pad[1] = ReadLE64(key + 24);
+
+    leftover = 0;
+}
+
+void Poly1305::Blocks(const unsigned char* m, size_t bytes, uint32_t hibit)
+{
+    const uint64_t hibit64 = (uint64_t)hibit << 16;
+    const uint64_t r0 = r[0], r1 = r[1], r2 = r[2];
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = h[0], h1 = h[1], h2 = h[2];
+
+    while (bytes >= 16) {
+        // h += m[i]
+        uint64_t t0 = ReadLE64(m + 0);
+        uint64_t t1 = ReadLE64(m + 8);
+        h0 += (t0) & 0xfffffffffff;
+        h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffff;
+        h2 += (((t1 >> 24)) & 0x3ffffffffff) | hibit64;
+
+        // h *= r
+        uint128_t d0 = (uint128_t)h0 * r0 + (uint128_t)h1 * s2 + (uint128_t)h2 * s1;
+        uint128_t d1 = (uint128_t)h0 * r1 + (uint128_t)h1 * r0 + (uint128_t)h2 * s2;
+        uint128_t d2 = (uint128_t)h0 * r2 + (uint128_t)h1 * r1 + (uint128_t)h2 * r0;
+
+        // (partial) h %= p
+        uint64_t c = (uint64_t)(d0 >> 44); h0 = (uint64_t)d0 & 0xfffffffffff;
+        d1 += c;     c = (uint64_t)(d1 >> 44); h1 = (uint64_t)d1 & 0xfffffffffff;
+        d2 += c;     c = (uint64_t)(d2 >> 42); h2 = (uint64_t)d2 & 0x3ffffffffff;
+        h0 += c * 5; c = (h0 >> 44);           h0 = h0 & 0xfffffffffff;
+        h1 += c;
+
+        m += 16;
+        bytes -= 16;
+    }
+
+    h[0] = h0;
+    h[1] = h1;
+    h[2] = h2;
+}
+
+void Poly1305::Finalize(unsigned char* tag)
+{
+    // process the remaining block
+    if (leftover) {
+        buffer[leftover] = 1;
+        for (size_t i = leftover + 1; i < 16; i++)
+            buffer[i] = 0;
+        Blocks(buffer, 16, 0);
+    }
+
+    // fully carry h
+    uint64_t h0 = h[0], h1 = h[1], h2 = h[2];
+    uint64_t c;
+                 c = (h1 >> 44); h1 &= 0xfffffffffff;
+    h2 += c;     c = (h2 >> 42); h2 &= 0x3ffffffffff;
+    h0 += c * 5; c = (h0 >> 44); h0 &= 0xfffffffffff;
+    h1 += c;     c = (h1 >> 44); h1 &= 0xfffffffffff;
+    h2 += c;     c = (h2 >> 42); h2 &= 0x3ffffffffff;
+    h0 += c * 5; c = (h0 >> 44); h0 &= 0xfffffffffff;
+    h1 += c;
+
+    // compute h + -p
+    uint64_t g0 = h0 + 5; c = (g0 >> 44); g0 &= 0xfffffffffff;
+    uint64_t g1 = h1 + c; c = (g1 >> 44); g1 &= 0xfffffffffff;
+    uint64_t g2 = h2 + c - ((uint64_t)1 << 42);
+
+    // select h if h < p, or h + -p if h >= p
+    c = (g2 >> ((sizeof(uint64_t) * 8) - 1)) - 1;
+    g0 &= c;
+    g1 &= c;
+    g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0;
+    h1 = (h1 & c) | g1;
+    h2 = (h2 & c) | g2;
+
+    // h = (h + pad)
+    uint64_t t0 = pad[0];
+    uint64_t t1 = pad[1];
+    h0 += ((t0) & 0xfffffffffff);                         c = (h0 >> 44); h0 &= 0xfffffffffff;
+    h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffff) + c; c = (h1 >> 44); h1 &= 0xfffffffffff;
+    h2 += (((t1 >> 24)) & 0x3ffffffffff) + c;                              h2 &= 0x3ffffffffff;
+
+    // mac = h % (2^128)
+    WriteLE64(tag + 0, h0 | (h1 << 44));
+    WriteLE64(tag + 8, (h1 >> 20) | (h2 << 24));
+
+    // The key must not be used again.
+    memset(r, 0, sizeof(r));
+    memset(h, 0, sizeof(h));
+    memset(pad, 0, sizeof(pad));
+}
+
+#else
+
+Poly1305::Poly1305(const unsigned char* key)
+{
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff, in 26-bit limbs
+    r[0] = (ReadLE32(key + 0)) & 0x3ffffff;
+    r[1] = (ReadLE32(key + 3) >> 2) & 0x3ffff03;
+    r[2] = (ReadLE32(key + 6) >> 4) & 0x3ffc0ff;
+    r[3] = (ReadLE32(key + 9) >> 6) & 0x3f03fff;
+    r[4] = (ReadLE32(key + 12) >> 8) & 0x00fffff;
+
+    memset(h, 0, sizeof(h));
+
+    pad[0] = ReadLE32(key + 16);
+    pad[1] = ReadLE32(key + 20);
+    pad[2] = ReadLE32(key + 24);
+    pad[3] = ReadLE32(key + 28);
+
+    leftover = 0;
+}
+
+void Poly1305::Blocks(const unsigned char* m, size_t bytes, uint32_t hibit)
+{
+    const uint32_t r0 = r[0], r1 = r[1], r2 = r[2], r3 = r[3], r4 = r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+
+    while (bytes >= 16) {
+        // h += m[i]
+        h0 += (ReadLE32(m + 0)) & 0x3ffffff;
+        h1 += (ReadLE32(m + 3) >> 2) & 0x3ffffff;
+        h2 += (ReadLE32(m + 6) >> 4) & 0x3ffffff;
+        h3 += (ReadLE32(m + 9) >> 6) & 0x3ffffff;
+        h4 += (ReadLE32(m + 12) >> 8) | hibit;
+
+        // h *= r
+        uint64_t d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+        uint64_t d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+        uint64_t d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+        uint64_t d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+        uint64_t d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+        // (partial) h %= p
+        uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c;      c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c;      c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c;      c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c;      c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5;  c = (h0 >> 26);           h0 = h0 & 0x3ffffff;
+        h1 += c;
+
+        m += 16;
+        bytes -= 16;
+    }
+
+    h[0] = h0;
+    h[1] = h1;
+    h[2] = h2;
+    h[3] = h3;
+    h[4] = h4;
+}
+
+void Poly1305::Finalize(unsigned char* tag)
+{
+    // process the remaining block
+    if (leftover) {
+        buffer[leftover] = 1;
+        for (size_t i = leftover + 1; i < 16; i++)
+            buffer[i] = 0;
+        Blocks(buffer, 16, 0);
+    }
+
+    // fully carry h
+    uint32_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+    uint32_t c;
+                 c = h1 >> 26; h1 = h1 & 0x3ffffff;
+    h2 += c;     c = h2 >> 26; h2 = h2 & 0x3ffffff;
+    h3 += c;     c = h3 >> 26; h3 = h3 & 0x3ffffff;
+    h4 += c;     c = h4 >> 26; h4 = h4 & 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 = h0 & 0x3ffffff;
+    h1 += c;
+
+    // compute h + -p
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1UL << 26);
+
+    // select h if h < p, or h + -p if h >= p
+    uint32_t mask = (g4 >> ((sizeof(uint32_t) * 8) - 1)) - 1;
+    g0 &= mask;
+    g1 &= mask;
+    g2 &= mask;
+    g3 &= mask;
+    g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    // h = h % (2^128)
+    h0 = ((h0      ) | (h1 << 26)) & 0xffffffff;
+    h1 = ((h1 >>  6) | (h2 << 20)) & 0xffffffff;
+    h2 = ((h2 >> 12) | (h3 << 14)) & 0xffffffff;
+    h3 = ((h3 >> 18) | (h4 <<  8)) & 0xffffffff;
+
+    // mac = (h + pad) % (2^128)
+    uint64_t f;
+    f = (uint64_t)h0 + pad[0]            ; h0 = (uint32_t)f;
+    f = (uint64_t)h1 + pad[1] + (f >> 32); h1 = (uint32_t)f;
+    f = (uint64_t)h2 + pad[2] + (f >> 32); h2 = (uint32_t)f;
+    f = (uint64_t)h3 + pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+    WriteLE32(tag + 0, h0);
+    WriteLE32(tag + 4, h1);
+    WriteLE32(tag + 8, h2);
+    WriteLE32(tag + 12, h3);
+
+    // The key must not be used again.
+    memset(r, 0, sizeof(r));
+    memset(h, 0, sizeof(h));
+    memset(pad, 0, sizeof(pad));
+}
+
+#endif
+
+Poly1305& Poly1305::Update(const unsigned char* m, size_t bytes)
+{
+    // handle leftover
+    if (leftover) {
+        size_t want = 16 - leftover;
+        if (want > bytes)
+            want = bytes;
+        memcpy(buffer + leftover, m, want);
+        bytes -= want;
+        m += want;
+        leftover += want;
+        if (leftover < 16)
+            return *this;
+        Blocks(buffer, 16, 1 << 24);
+        leftover = 0;
+    }
+
+    // process full blocks
+    if (bytes >= 16) {
+        size_t want = bytes & ~(size_t)15;
+        Blocks(m, want, 1 << 24);
+        m += want;
+        bytes -= want;
+    }
+
+    // store leftover
+    if (bytes) {
+        memcpy(buffer, m, bytes);
+        leftover = bytes;
+    }
+    return *this;
+}
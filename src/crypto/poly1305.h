@@ -0,0 +1,46 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_CRYPTO_POLY1305_H
+#define BITCOIN_CRYPTO_POLY1305_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * The Poly1305 one-time authenticator of RFC 8439. Where the compiler has
+ * 128-bit integers, the accumulator is kept in three 44-bit limbs, which
+ * takes a third of the multiplications that five 26-bit limbs do.
+ */
+class Poly1305
+{
+private:
+#if defined(__SIZEOF_INT128__)
+    uint64_t r[3];
+    uint64_t h[3];
+    uint64_t pad[2];
+#else
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+#endif
+    unsigned char buffer[16];
+    size_t leftover;
+
+    void Blocks(const unsigned char* m, size_t bytes, uint32_t hibit);
+
+public:
+    static constexpr size_t KEYLEN = 32;
+    static constexpr size_t TAGLEN = 16;
+
+    /** Start a tag with a 32-byte key that is never used for anything else. */
+    explicit Poly1305(const unsigned char* key);
+
+    Poly1305& Update(const unsigned char* m, size_t bytes);
+
+    /** Write the 16-byte tag. */
+    void Finalize(unsigned char* tag);
+};
+
+#endif // BITCOIN_CRYPTO_POLY1305_H
@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdexcept>
 #include <cstring>
 #include <climits>
+#include <atomic>
 #include "jit_compiler_x86.hpp"
 #include "jit_compiler_x86_static.hpp"
 #include "superscalar.hpp"
@@ -323,12 +324,47 @@ namespace randomx {
 		emitByte(0xc0 + pcfg.readReg3);
 	}
 
+	static std::atomic<int> scratchpadPrefetchMode(1);
+
+	void JitCompilerX86::setScratchpadPrefetchMode(int mode) {
+		if (mode >= 0 && mode <= 3) {
+			scratchpadPrefetchMode.store(mode, std::memory_order_relaxed);
+		}
+	}
+
+	// Rewrite the "prefetcht0 [rsi+rax]" and "prefetcht0 [rsi+rdx]" copied from
+	// randomx_prefetch_scratchpad for the selected mode. All variants are 4 bytes
+	// and rcx is free here (the loop store reloads it).
+	void JitCompilerX86::patchScratchpadPrefetch(uint8_t* p, int32_t size) {
+		const int mode = scratchpadPrefetchMode.load(std::memory_order_relaxed);
+		if (mode == 1)
+			return;
+		for (int32_t i = 0; i + 4 <= size; ++i) {
+			if (p[i] != 0x0f || p[i + 1] != 0x18 || p[i + 2] != 0x0c)
+				continue;
+			switch (mode) {
+			case 0: // 4-byte nop
+				p[i] = 0x0f; p[i + 1] = 0x1f; p[i + 2] = 0x40; p[i + 3] = 0x00;
+				break;
+			case 2: // prefetchnta (same SIB byte)
+				p[i + 2] = 0x04;
+				break;
+			case 3: // mov rcx, [rsi+reg] (same SIB byte)
+				p[i] = 0x48; p[i + 1] = 0x8b;
+				break;
+			}
+			i += 3;
+		}
+	}
+
 	void JitCompilerX86::generateProgramEpilogue(Program& prog, ProgramConfiguration& pcfg) {
 		emit(REX_MOV_RR64);
 		emitByte(0xc0 + pcfg.readReg0);
 		emit(REX_XOR_RAX_R64);
 		emitByte(0xc0 + pcfg.readReg1);
+		const int32_t prefetchPos = codePos;
 		emit(ADDR(randomx_prefetch_scratchpad), ADDR(randomx_prefetch_scratchpad_end) - ADDR(randomx_prefetch_scratchpad));
+		patchScratchpadPrefetch(code + prefetchPos, codePos - prefetchPos);
 		memcpy(code + codePos, codeLoopStore, loopStoreSize);
 		codePos += loopStoreSize;
 		emit(SUB_EBX);
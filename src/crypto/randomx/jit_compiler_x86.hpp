@@ -65,6 +65,7 @@ namespace randomx {
 		void enableWriting();
 		void enableExecution();
 		void enableAll();
+		static void setScratchpadPrefetchMode(int mode);
 	private:
 		static InstructionGeneratorX86 engine[256];
 		std::vector<int32_t> instructionOffsets;
@@ -74,6 +75,7 @@ namespace randomx {
 
 		void generateProgramPrologue(Program&, ProgramConfiguration&);
 		void generateProgramEpilogue(Program&, ProgramConfiguration&);
+		static void patchScratchpadPrefetch(uint8_t* p, int32_t size);
 		void genAddressReg(Instruction&, bool);
 		void genAddressRegDst(Instruction&);
 		void genAddressImm(Instruction&);
@@ -428,4 +428,13 @@ extern "C" {
 		blake2b_update(&state, hash_in, RANDOMX_HASH_SIZE);
 		blake2b_final(&state, com_out, RANDOMX_HASH_SIZE);
 	}
+
+	void randomx_set_scratchpad_prefetch_mode(int mode) {
+#if defined(_M_X64) || defined(__x86_64__)
+		randomx::JitCompilerX86::setScratchpadPrefetchMode(mode);
+#else
+		(void)mode;
+#endif
+	}
+
 }
@@ -271,6 +271,16 @@ RANDOMX_EXPORT void randomx_calculate_hash_last(randomx_vm* machine, void* outpu
 */
 RANDOMX_EXPORT void randomx_calculate_commitment(const void* input, size_t inputSize, const void* hash_in, void* com_out);
 
+/**
+ * Selects how the x86-64 JIT prefetches the scratchpad lines used by the next
+ * program iteration: 0 = off, 1 = prefetcht0 (default), 2 = prefetchnta,
+ * 3 = mov. Takes effect for programs compiled afterwards, i.e. from the next
+ * hash on. Has no effect with other compilers or the interpreter.
+ *
+ * @param mode is the prefetch mode (0-3). Other values are ignored.
+*/
+RANDOMX_EXPORT void randomx_set_scratchpad_prefetch_mode(int mode);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -53,6 +53,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PAGE_EXECUTE_READWRITE (PROT_READ | PROT_WRITE | PROT_EXEC)
 #endif
 
+#include <stdint.h>
+
 #include "virtual_memory.h"
 
 #if defined(USE_PTHREAD_JIT_WP) && defined(MAC_OS_VERSION_11_0) \
@@ -246,6 +248,57 @@ void* allocLargePagesMemory(size_t bytes) {
 	return mem;
 }
 
+/* Read-write data pages for a multiple of 2MB bytes, 2MB aligned. With
+   tryLargePages, reserved huge pages are used when the system has enough
+   free, and *largePages is set; otherwise the kernel is asked to back the
+   pages with transparent huge pages. Free with freePagedMemory. */
+void* allocHugePagesMemory(size_t bytes, int tryLargePages, int* largePages) {
+	void* mem;
+	*largePages = 0;
+#if defined(__linux__)
+	const size_t align = 2 * 1024 * 1024;
+	char *raw, *start;
+	if (tryLargePages) {
+		/* Default-size pages only: unlike the RandomX dataset, a region
+		   is far smaller than a 1GB page. */
+		mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mem != MAP_FAILED) {
+			*largePages = 1;
+			return mem;
+		}
+	}
+	raw = mmap(NULL, bytes + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return NULL;
+	start = (char*)alignSize((uintptr_t)raw, align);
+	if (start > raw)
+		munmap(raw, start - raw);
+	if (raw + align > start)
+		munmap(start + bytes, raw + align - start);
+#ifdef MADV_HUGEPAGE
+	madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+	mem = start;
+#else
+	if (tryLargePages) {
+		mem = allocLargePagesMemory(bytes);
+		if (mem != NULL) {
+			*largePages = 1;
+			return mem;
+		}
+	}
+	/* Not allocMemoryPages, which maps JIT pages on macOS. */
+#if defined(_WIN32) || defined(__CYGWIN__)
+	mem = VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		mem = NULL;
+#endif
+#endif
+	return mem;
+}
+
 void freePagedMemory(void* ptr, size_t bytes) {
 #if defined(_WIN32) || defined(__CYGWIN__)
 	VirtualFree(ptr, 0, MEM_RELEASE);
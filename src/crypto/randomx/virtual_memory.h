@@ -41,6 +41,7 @@ void setPagesRW(void*, size_t);
 void setPagesRX(void*, size_t);
 void setPagesRWX(void*, size_t);
 void* allocLargePagesMemory(size_t);
+void* allocHugePagesMemory(size_t, int, int*);
 void freePagedMemory(void*, size_t);
 
 #ifdef __cplusplus
@@ -0,0 +1,203 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifdef ENABLE_AVX2
+
+#include "crypto/randomx/dataset.hpp"
+#include "crypto/randomx/intrin_portable.h"
+#include "crypto/randomx/superscalar.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace randomx_avx2 {
+namespace {
+
+/**
+ * Sixteen dataset items are computed at once, as four groups of four, with
+ * lane i of each vector holding a register of one item. The superscalar
+ * programs are the same for every item, so each instruction is applied to
+ * all of them; running four independent vectors keeps the multiply units
+ * busy. AVX2 has no 64-bit multiplies, so those are put together from
+ * 32-bit ones.
+ */
+constexpr int VECTORS = 4;
+constexpr int ITEMS = 4 * VECTORS;
+
+// The register seeds of a dataset item, from the RandomX specification
+constexpr uint64_t superscalarMul0 = 6364136223846793005ULL;
+constexpr uint64_t superscalarAdd[8] = {
+    0,
+    9298411001130361340ULL,
+    12065312585734608966ULL,
+    9306329213124626780ULL,
+    5281919268842080866ULL,
+    10536153434571861004ULL,
+    3398623926847679864ULL,
+    9549104520008361294ULL,
+};
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x(x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Sub(__m256i x, __m256i y) { return _mm256_sub_epi64(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline ShL(__m256i x, unsigned n) { return _mm256_sll_epi64(x, _mm_cvtsi32_si128(n)); }
+__m256i inline ShR(__m256i x, unsigned n) { return _mm256_srl_epi64(x, _mm_cvtsi32_si128(n)); }
+__m256i inline RotR(__m256i x, unsigned n) { return _mm256_or_si256(ShR(x, n), ShL(x, 64 - n)); }
+
+/** The low 64 bits of x * y. */
+__m256i inline MulLo(__m256i x, __m256i y)
+{
+    __m256i cross = Add(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y), _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+    return Add(_mm256_mul_epu32(x, y), _mm256_slli_epi64(cross, 32));
+}
+
+/** The high 64 bits of x * y, unsigned. */
+__m256i inline MulHi(__m256i x, __m256i y)
+{
+    const __m256i low = K(0xffffffff);
+    __m256i xh = _mm256_srli_epi64(x, 32);
+    __m256i yh = _mm256_srli_epi64(y, 32);
+    __m256i ll = _mm256_mul_epu32(x, y);
+    __m256i lh = _mm256_mul_epu32(x, yh);
+    __m256i hl = _mm256_mul_epu32(xh, y);
+    __m256i hh = _mm256_mul_epu32(xh, yh);
+    // The carry out of the low 64 bits
+    __m256i mid = Add(_mm256_srli_epi64(ll, 32), Add(_mm256_and_si256(lh, low), _mm256_and_si256(hl, low)));
+    return Add(Add(hh, _mm256_srli_epi64(mid, 32)), Add(_mm256_srli_epi64(lh, 32), _mm256_srli_epi64(hl, 32)));
+}
+
+/** The high 64 bits of x * y, signed. */
+__m256i inline SMulHi(__m256i x, __m256i y)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i hi = MulHi(x, y);
+    hi = Sub(hi, _mm256_and_si256(_mm256_cmpgt_epi64(zero, x), y));
+    return Sub(hi, _mm256_and_si256(_mm256_cmpgt_epi64(zero, y), x));
+}
+
+/** randomx::executeSuperscalar, on ITEMS items. */
+void Execute(__m256i (&r)[8][VECTORS], randomx::SuperscalarProgram& prog, const std::vector<uint64_t>& reciprocals)
+{
+    using randomx::SuperscalarInstructionType;
+    for (unsigned j = 0; j < prog.getSize(); ++j) {
+        randomx::Instruction& instr = prog(j);
+        __m256i (&dst)[VECTORS] = r[instr.dst];
+        const __m256i (&src)[VECTORS] = r[instr.src];
+        switch ((SuperscalarInstructionType)instr.opcode) {
+        case SuperscalarInstructionType::ISUB_R:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = Sub(dst[v], src[v]);
+            break;
+        case SuperscalarInstructionType::IXOR_R:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = Xor(dst[v], src[v]);
+            break;
+        case SuperscalarInstructionType::IADD_RS:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = Add(dst[v], ShL(src[v], instr.getModShift()));
+            break;
+        case SuperscalarInstructionType::IMUL_R:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = MulLo(dst[v], src[v]);
+            break;
+        case SuperscalarInstructionType::IROR_C:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = RotR(dst[v], instr.getImm32());
+            break;
+        case SuperscalarInstructionType::IADD_C7:
+        case SuperscalarInstructionType::IADD_C8:
+        case SuperscalarInstructionType::IADD_C9: {
+            const __m256i imm = K(signExtend2sCompl(instr.getImm32()));
+            for (int v = 0; v < VECTORS; ++v) dst[v] = Add(dst[v], imm);
+            break;
+        }
+        case SuperscalarInstructionType::IXOR_C7:
+        case SuperscalarInstructionType::IXOR_C8:
+        case SuperscalarInstructionType::IXOR_C9: {
+            const __m256i imm = K(signExtend2sCompl(instr.getImm32()));
+            for (int v = 0; v < VECTORS; ++v) dst[v] = Xor(dst[v], imm);
+            break;
+        }
+        case SuperscalarInstructionType::IMULH_R:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = MulHi(dst[v], src[v]);
+            break;
+        case SuperscalarInstructionType::ISMULH_R:
+            for (int v = 0; v < VECTORS; ++v) dst[v] = SMulHi(dst[v], src[v]);
+            break;
+        case SuperscalarInstructionType::IMUL_RCP: {
+            const __m256i rcp = K(reciprocals[instr.getImm32()]);
+            for (int v = 0; v < VECTORS; ++v) dst[v] = MulLo(dst[v], rcp);
+            break;
+        }
+        default:
+            UNREACHABLE;
+        }
+    }
+}
+
+uint64_t inline Load64(const uint8_t* p)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+    return x;
+}
+
+} // namespace
+
+void InitDataset_16way(randomx_cache* cache, uint8_t* out, uint64_t startItem, uint64_t count)
+{
+    constexpr uint64_t lineMask = randomx::CacheSize / randomx::CacheLineSize - 1;
+    alignas(32) uint64_t lanes[8][ITEMS];
+    for (uint64_t item = startItem; item < startItem + count; item += ITEMS, out += ITEMS * randomx::CacheLineSize) {
+        alignas(32) uint64_t registerValue[ITEMS];
+        for (int l = 0; l < ITEMS; ++l) {
+            registerValue[l] = item + l;
+            uint64_t r0 = (item + l + 1) * superscalarMul0;
+            for (int q = 0; q < 8; ++q) {
+                lanes[q][l] = r0 ^ superscalarAdd[q];
+            }
+        }
+        __m256i r[8][VECTORS];
+        for (int q = 0; q < 8; ++q) {
+            for (int v = 0; v < VECTORS; ++v) {
+                r[q][v] = _mm256_load_si256((const __m256i*)&lanes[q][4 * v]);
+            }
+        }
+
+        for (unsigned i = 0; i < RANDOMX_CACHE_ACCESSES; ++i) {
+            const uint8_t* mix[ITEMS];
+            for (int l = 0; l < ITEMS; ++l) {
+                mix[l] = cache->memory + (registerValue[l] & lineMask) * randomx::CacheLineSize;
+                _mm_prefetch((const char*)mix[l], _MM_HINT_NTA);
+            }
+            randomx::SuperscalarProgram& prog = cache->programs[i];
+
+            Execute(r, prog, cache->reciprocalCache);
+
+            for (int q = 0; q < 8; ++q) {
+                for (int v = 0; v < VECTORS; ++v) {
+                    const uint8_t* const* m = &mix[4 * v];
+                    r[q][v] = Xor(r[q][v], _mm256_set_epi64x(Load64(m[3] + 8 * q), Load64(m[2] + 8 * q),
+                                                             Load64(m[1] + 8 * q), Load64(m[0] + 8 * q)));
+                }
+            }
+
+            for (int v = 0; v < VECTORS; ++v) {
+                _mm256_store_si256((__m256i*)&registerValue[4 * v], r[prog.getAddressRegister()][v]);
+            }
+        }
+
+        for (int q = 0; q < 8; ++q) {
+            for (int v = 0; v < VECTORS; ++v) {
+                _mm256_store_si256((__m256i*)&lanes[q][4 * v], r[q][v]);
+            }
+        }
+        for (int l = 0; l < ITEMS; ++l) {
+            for (int q = 0; q < 8; ++q) {
+                memcpy(out + l * randomx::CacheLineSize + 8 * q, &lanes[q][l], 8);
+            }
+        }
+    }
+}
+
+} // namespace randomx_avx2
+
+#endif
@@ -0,0 +1,357 @@
+// Copyright (c) 2025 Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/randomx_shm.h"
+#include "randomx/randomx.h"
+#include "randomx/dataset.hpp"
+#include "random.h"
+#include "util/system.h"
+#include "util/strencodings.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// How long to wait for another process that is building the same dataset
+static const int SHARED_DATASET_WAIT_SECONDS = 120;
+// Dataset items recomputed from our own cache before trusting a published dataset
+static const int SHARED_DATASET_SAMPLE_ITEMS = 64;
+
+std::mutex shm_dir_mutex;
+std::string shm_dir;
+
+#ifndef WIN32
+// Descriptors of the segments we are building, locked until they are
+// published so that others can tell a live builder from a dead one
+std::mutex builder_locks_mutex;
+std::map<const randomx_dataset*, int> builder_locks;
+
+void ReleaseBuilderLock(const randomx_dataset* dataset)
+{
+    std::lock_guard<std::mutex> lock(builder_locks_mutex);
+    auto it = builder_locks.find(dataset);
+    if (it != builder_locks.end()) {
+        close(it->second);
+        builder_locks.erase(it);
+    }
+}
+
+SharedDatasetHeader* HeaderOf(randomx_dataset* dataset)
+{
+    return reinterpret_cast<SharedDatasetHeader*>(dataset->memory - SHARED_DATASET_HEADER_SIZE);
+}
+
+void DeallocSharedDataset(randomx_dataset* dataset)
+{
+    if (!dataset->memory) return;
+
+    SharedDatasetHeader* header = HeaderOf(dataset);
+    size_t mapping_size = header->mapping_size;
+
+    // A segment we created but never finished must not be picked up by others
+    if (header->state.load() != SHARED_DATASET_READY && header->builder_pid == (int64_t)getpid()) {
+        uint256 seedhash;
+        memcpy(seedhash.begin(), header->seedhash, 32);
+        std::string path = RandomX_SharedDatasetPath(seedhash, header->node_id);
+        if (!path.empty()) unlink(path.c_str());
+    }
+    ReleaseBuilderLock(dataset);
+
+    munmap(header, mapping_size);
+    dataset->memory = nullptr;
+}
+
+randomx_dataset* WrapMapping(void* base)
+{
+    randomx_dataset* dataset = new randomx_dataset();
+    dataset->memory = static_cast<uint8_t*>(base) + SHARED_DATASET_HEADER_SIZE;
+    dataset->dealloc = &DeallocSharedDataset;
+    return dataset;
+}
+
+// Create a new segment at path, unless someone else already has. The file
+// is created and locked under a temporary name and then linked into place,
+// so that a segment is never visible without its builder's lock.
+randomx_dataset* CreateSegment(const std::string& path, const uint256& seedhash, int nodeId, bool& fExists)
+{
+    fExists = false;
+    std::string tmp_path = path + ".tmp" + itostr(getpid());
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LogPrintf("RandomX: WARNING - Could not create shared dataset %s: %s\n", path, strerror(errno));
+        return nullptr;
+    }
+    if (flock(fd, LOCK_EX) != 0 || link(tmp_path.c_str(), path.c_str()) != 0) {
+        fExists = (errno == EEXIST);
+        if (!fExists) {
+            LogPrintf("RandomX: WARNING - Could not create shared dataset %s: %s\n", path, strerror(errno));
+        }
+        close(fd);
+        unlink(tmp_path.c_str());
+        return nullptr;
+    }
+    unlink(tmp_path.c_str());
+
+    struct statfs sfs;
+    size_t granularity = 4096;
+    if (fstatfs(fd, &sfs) == 0 && sfs.f_bsize > 0 && (size_t)sfs.f_bsize > granularity) {
+        granularity = sfs.f_bsize;  // hugetlbfs reports its page size here
+    }
+    size_t mapping_size = SHARED_DATASET_HEADER_SIZE + randomx::DatasetSize;
+    mapping_size = (mapping_size + granularity - 1) / granularity * granularity;
+
+    // Reserve the memory up front: running out of space in a tmpfs/hugetlbfs
+    // mount while the dataset is being written would raise SIGBUS.
+    int err = posix_fallocate(fd, 0, mapping_size);
+    if (err != 0) {
+        LogPrintf("RandomX: WARNING - Could not reserve %u MiB for shared dataset %s: %s\n",
+                  mapping_size >> 20, path, strerror(err));
+        close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        LogPrintf("RandomX: WARNING - Could not map shared dataset %s: %s\n", path, strerror(errno));
+        close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    SharedDatasetHeader* header = static_cast<SharedDatasetHeader*>(base);
+    header->magic = SHARED_DATASET_MAGIC;
+    header->version = SHARED_DATASET_VERSION;
+    header->state.store(SHARED_DATASET_BUILDING);
+    header->dataset_size = randomx::DatasetSize;
+    header->mapping_size = mapping_size;
+    header->builder_pid = getpid();
+    header->node_id = nodeId;
+    memcpy(header->seedhash, seedhash.begin(), 32);
+
+    LogPrintf("RandomX: Building shared dataset %s\n", path);
+    randomx_dataset* dataset = WrapMapping(base);
+    std::lock_guard<std::mutex> lock(builder_locks_mutex);
+    builder_locks[dataset] = fd;
+    return dataset;
+}
+
+// Whether a published dataset agrees with items computed from our own cache
+bool SampleMatchesCache(const uint8_t* memory, randomx_cache* cache)
+{
+    const uint64_t nItems = randomx::DatasetSize / randomx::CacheLineSize;
+    uint8_t item[randomx::CacheLineSize];
+    for (int i = 0; i < SHARED_DATASET_SAMPLE_ITEMS; i++) {
+        // The first and last items, and the rest at random
+        uint64_t nItem = i == 0 ? 0 : i == 1 ? nItems - 1 : GetRand(nItems);
+        randomx::initDatasetItem(cache, item, nItem);
+        if (memcmp(item, memory + nItem * randomx::CacheLineSize, randomx::CacheLineSize) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif // WIN32
+
+} // namespace
+
+bool RandomX_SetSharedDatasetDir(const std::string& dir)
+{
+    std::string base = dir;
+    while (base.size() > 1 && base.back() == '/') {
+        base.pop_back();
+    }
+
+    std::string private_dir;
+    bool fOk = base.empty();
+#ifndef WIN32
+    if (!base.empty()) {
+        // Directories like /dev/shm can be written by every local user, so
+        // keep the files in a subdirectory only we can use.
+        private_dir = base + "/junocash-rx-" + itostr(geteuid());
+        struct stat st;
+        if (mkdir(private_dir.c_str(), 0700) != 0 && errno != EEXIST) {
+            LogPrintf("RandomX: WARNING - Could not create shared dataset directory %s: %s\n", private_dir, strerror(errno));
+        } else if (lstat(private_dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+                   st.st_uid != geteuid() || (st.st_mode & 0077) != 0) {
+            LogPrintf("RandomX: WARNING - %s is not a directory private to this user, not sharing datasets\n", private_dir);
+        } else {
+            fOk = true;
+        }
+        if (!fOk) private_dir.clear();
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(shm_dir_mutex);
+    shm_dir = private_dir;
+    return fOk;
+}
+
+std::string RandomX_SharedDatasetPath(const uint256& seedhash, int nodeId)
+{
+    std::lock_guard<std::mutex> lock(shm_dir_mutex);
+    if (shm_dir.empty()) return "";
+    return shm_dir + "/dataset-" + (nodeId < 0 ? std::string("any") : itostr(nodeId)) + "-" + seedhash.GetHex();
+}
+
+bool RandomX_SharedDatasetEnabled()
+{
+#ifdef WIN32
+    return false;
+#else
+    std::lock_guard<std::mutex> lock(shm_dir_mutex);
+    return !shm_dir.empty();
+#endif
+}
+
+SharedDatasetAttach RandomX_SharedDataset_Attach(const std::string& path, const uint256& seedhash, randomx_cache* cache,
+                                                 int nWaitSeconds, randomx_dataset*& dataset)
+{
+    dataset = nullptr;
+#ifdef WIN32
+    return SharedDatasetAttach::FAILED;
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? SharedDatasetAttach::STALE : SharedDatasetAttach::FAILED;
+    }
+
+    // Anyone who can write the file could make us reject valid blocks
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        LogPrintf("RandomX: WARNING - Shared dataset %s is not a file private to this user, ignoring it\n", path);
+        close(fd);
+        return SharedDatasetAttach::UNTRUSTED;
+    }
+
+    // The builder holds an exclusive lock until it publishes, and the
+    // system drops it if the builder dies, so a lock we can take on an
+    // unpublished segment means nobody is going to finish it.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(nWaitSeconds);
+    bool fLogged = false;
+    while (true) {
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return SharedDatasetAttach::FAILED;
+        }
+        if ((size_t)st.st_size >= SHARED_DATASET_HEADER_SIZE + randomx::DatasetSize) {
+            SharedDatasetHeader header;
+            if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+                close(fd);
+                return SharedDatasetAttach::FAILED;
+            }
+            if (header.magic == SHARED_DATASET_MAGIC && header.version == SHARED_DATASET_VERSION &&
+                header.dataset_size == randomx::DatasetSize && header.mapping_size == (uint64_t)st.st_size &&
+                memcmp(header.seedhash, seedhash.begin(), 32) == 0 && header.state.load() == SHARED_DATASET_READY) {
+                break;
+            }
+        }
+        if (flock(fd, LOCK_SH | LOCK_NB) == 0) {
+            close(fd);
+            return SharedDatasetAttach::STALE;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            close(fd);
+            return SharedDatasetAttach::FAILED;
+        }
+        if (!fLogged) {
+            LogPrintf("RandomX: Waiting for another process to finish shared dataset %s\n", path);
+            fLogged = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    size_t mapping_size = st.st_size;
+    void* base = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LogPrintf("RandomX: WARNING - Could not map shared dataset %s: %s\n", path, strerror(errno));
+        return SharedDatasetAttach::FAILED;
+    }
+
+    // The dataset is used to validate blocks, so check it against our own
+    // cache before trusting it.
+    if (!SampleMatchesCache(static_cast<const uint8_t*>(base) + SHARED_DATASET_HEADER_SIZE, cache)) {
+        LogPrintf("RandomX: WARNING - Shared dataset %s does not match its seed\n", path);
+        munmap(base, mapping_size);
+        return SharedDatasetAttach::STALE;
+    }
+
+    // Fault the dataset in now rather than on the first hashes
+    madvise(base, mapping_size, MADV_WILLNEED);
+
+    dataset = WrapMapping(base);
+    return SharedDatasetAttach::OK;
+#endif
+}
+
+randomx_dataset* RandomX_SharedDataset_Acquire(const uint256& seedhash, int nodeId, randomx_cache* cache, bool& fReady)
+{
+    fReady = false;
+#ifdef WIN32
+    return nullptr;
+#else
+    std::string path = RandomX_SharedDatasetPath(seedhash, nodeId);
+    if (path.empty()) return nullptr;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        // Become the builder if nobody else has created the segment yet
+        bool fExists = false;
+        randomx_dataset* dataset = CreateSegment(path, seedhash, nodeId, fExists);
+        if (dataset || !fExists) {
+            return dataset;
+        }
+
+        switch (RandomX_SharedDataset_Attach(path, seedhash, cache, SHARED_DATASET_WAIT_SECONDS, dataset)) {
+        case SharedDatasetAttach::OK:
+            LogPrintf("RandomX: Attached to shared dataset %s\n", path);
+            fReady = true;
+            return dataset;
+        case SharedDatasetAttach::STALE:
+            LogPrintf("RandomX: Removing stale shared dataset %s\n", path);
+            unlink(path.c_str());
+            break;
+        case SharedDatasetAttach::UNTRUSTED:
+        case SharedDatasetAttach::FAILED:
+            return nullptr;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+void RandomX_SharedDataset_Publish(randomx_dataset* dataset)
+{
+#ifndef WIN32
+    if (!dataset || dataset->dealloc != &DeallocSharedDataset) return;
+    HeaderOf(dataset)->state.store(SHARED_DATASET_READY);
+    ReleaseBuilderLock(dataset);
+#endif
+}
+
+void RandomX_SharedDataset_Discard(const uint256& seedhash, int nodeId)
+{
+#ifndef WIN32
+    std::string path = RandomX_SharedDatasetPath(seedhash, nodeId);
+    if (!path.empty() && unlink(path.c_str()) == 0) {
+        LogPrintf("RandomX: Removed shared dataset %s\n", path);
+    }
+#endif
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2025 Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_RANDOMX_SHM_H
+#define BITCOIN_CRYPTO_RANDOMX_SHM_H
+
+#include "uint256.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+struct randomx_cache;
+struct randomx_dataset;
+
+/**
+ * Shared RandomX datasets.
+ *
+ * When a directory is configured (-randomxdatasetdir), fast-mode datasets are
+ * kept in files named after their seed hash and NUMA node, e.g. under
+ * /dev/shm or a hugetlbfs mount. The first process to need a dataset builds
+ * it in place and marks it ready; restarted or co-located nodes then map the
+ * finished dataset read-only instead of spending tens of seconds rebuilding
+ * it. Files outlive the process so a restart can reuse them, and are removed
+ * when their seed is evicted.
+ *
+ * The files live in a subdirectory private to the user, and are only mapped
+ * if they are owned by the user and writable by nobody else. A published
+ * dataset is also checked against items computed from our own cache before
+ * it is used, since it validates blocks.
+ */
+
+static const uint64_t SHARED_DATASET_MAGIC = 0x534458524f4e554aULL; // "JUNORXDS"
+static const uint32_t SHARED_DATASET_VERSION = 2;
+/** The dataset starts this far into the file so that it is aligned to a 2MB hugepage */
+static const size_t SHARED_DATASET_HEADER_SIZE = 2 * 1024 * 1024;
+
+enum SharedDatasetState : uint32_t {
+    SHARED_DATASET_BUILDING = 0,
+    SHARED_DATASET_READY = 1,
+};
+
+/** Stored at the start of each shared dataset file */
+struct SharedDatasetHeader {
+    uint64_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> state;
+    uint64_t dataset_size;
+    uint64_t mapping_size;
+    int64_t builder_pid;
+    int32_t node_id;
+    unsigned char seedhash[32];
+};
+
+static_assert(sizeof(SharedDatasetHeader) <= SHARED_DATASET_HEADER_SIZE, "header must fit before the dataset");
+
+/**
+ * Set the directory used for shared datasets. An empty path disables sharing.
+ * The files are kept in a subdirectory of it only this user can access,
+ * which is created if needed. Returns false, leaving sharing disabled, if
+ * that subdirectory cannot be created or is not private.
+ */
+bool RandomX_SetSharedDatasetDir(const std::string& dir);
+
+/** The file holding the shared dataset for a seed on a NUMA node, or "" if sharing is disabled. */
+std::string RandomX_SharedDatasetPath(const uint256& seedhash, int nodeId);
+
+/** Check whether shared datasets are enabled. */
+bool RandomX_SharedDatasetEnabled();
+
+/**
+ * Get the shared dataset for a seed on a NUMA node (-1 = any node).
+ *
+ * If another process (or a previous run) has published it, and a sample of
+ * its items matches those computed from cache, it is mapped read-only and
+ * fReady is set. Otherwise a new segment is created and
+ * returned writable with fReady unset; the caller must initialize it with
+ * randomx_init_dataset and then call RandomX_SharedDataset_Publish.
+ * Release with randomx_release_dataset either way; an unpublished segment
+ * is removed when released.
+ *
+ * @return The dataset, or nullptr if sharing is disabled or the segment
+ *         could not be created (the caller should allocate privately).
+ */
+randomx_dataset* RandomX_SharedDataset_Acquire(const uint256& seedhash, int nodeId, randomx_cache* cache, bool& fReady);
+
+enum class SharedDatasetAttach {
+    OK,
+    STALE,     //!< Left unfinished by a builder that is gone, or corrupt: remove it and rebuild
+    UNTRUSTED, //!< Not owned by this user or writable by others: leave it and build privately
+    FAILED,    //!< Still being built when the wait ran out, or could not be mapped
+};
+
+/**
+ * Map the published dataset in the file at path, waiting up to nWaitSeconds
+ * for a live builder to publish it. Used by RandomX_SharedDataset_Acquire;
+ * exposed for tests.
+ */
+SharedDatasetAttach RandomX_SharedDataset_Attach(const std::string& path, const uint256& seedhash, randomx_cache* cache,
+                                                 int nWaitSeconds, randomx_dataset*& dataset);
+
+/** Mark a dataset returned by RandomX_SharedDataset_Acquire as fully initialized. */
+void RandomX_SharedDataset_Publish(randomx_dataset* dataset);
+
+/**
+ * Remove the name of the shared dataset for a seed on a NUMA node, so that
+ * its memory is freed once the last process using it unmaps it.
+ */
+void RandomX_SharedDataset_Discard(const uint256& seedhash, int nodeId);
+
+#endif // BITCOIN_CRYPTO_RANDOMX_SHM_H
@@ -4,8 +4,12 @@
 
 #include "randomx_wrapper.h"
 #include "randomx/randomx.h"
+#include "randomx/configuration.h"
+#include "randomx/virtual_machine.hpp"
+#include "crypto/randomx_shm.h"
 #include "crypto/cpu_features.h"
 #include "util/system.h"
+#include "util/trace.h"
 
 #if defined(HAVE_CONFIG_H)
 #include "config/bitcoin-config.h"
@@ -13,8 +17,16 @@
 
 #ifdef HAVE_NUMA
 #include <numa.h>
+#include <numaif.h>
 #endif
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <condition_variable>
 #include <mutex>
 #include <memory>
 #include <map>
@@ -28,23 +40,45 @@
 static bool rx_fast_mode = false;
 static bool rx_use_hugepages = false;
 static std::atomic<bool> rx_initialized{false};
+static std::atomic<bool> rx_shutting_down{false};
 
 // Scratchpad prefetch mode (default to T0 - best for most CPUs)
 static RandomX_ScratchpadPrefetchMode rx_prefetch_mode = RANDOMX_PREFETCH_T0;
 
+// Allocated caches/datasets (including evicted ones VMs still hold) and builds
+// in progress, for RandomX_GetMemoryStats
+static std::atomic<int> rx_num_caches{0};
+static std::atomic<int> rx_num_datasets{0};
+static std::atomic<int> rx_datasets_building{0};
+static std::atomic<int64_t> rx_last_dataset_build_ms{0};
+
+// Memory pressure level (see RandomX_CheckMemoryPressure). While it is
+// RANDOMX_MEMORY_ONE_DATASET, every thread uses the dataset on
+// rx_shared_dataset_node instead of one on its own node.
+static std::atomic<int> rx_memory_level{RANDOMX_MEMORY_FULL};
+static std::atomic<int> rx_memory_level_changes{0};
+static std::atomic<int> rx_shared_dataset_node{-1};
+static std::mutex rx_memory_mutex;
+static int64_t rx_memory_level_time = 0;  // Time of the last step, guarded by rx_memory_mutex
+static size_t rx_full_dataset_nodes = 1;  // Nodes with a dataset before stepping down, guarded by rx_memory_mutex
+
 // Multi-cache system to support concurrent access to multiple seeds
 // This is essential for reindex and sync scenarios where background threads
 // need to validate old blocks while the tip processes new blocks
 struct CacheEntry {
     randomx_cache* cache;
     uint256 seedhash;
-    uint64_t last_used;  // Timestamp for LRU cleanup
+    std::atomic<uint64_t> last_used;  // Timestamp for LRU cleanup
+    std::atomic<bool> initialized{false};
+    std::atomic<bool> evicted{false};  // Removed from seed_caches
+    std::mutex build_mutex;  // Held while the cache is being initialized
 
     CacheEntry() : cache(nullptr), last_used(0) {}
     ~CacheEntry() {
         if (cache) {
             randomx_release_cache(cache);
             cache = nullptr;
+            rx_num_caches--;
         }
     }
 };
@@ -53,14 +87,17 @@ struct CacheEntry {
 struct DatasetEntry {
     randomx_dataset* dataset;
     uint256 seedhash;
-    uint64_t last_used;
+    std::atomic<uint64_t> last_used;
     std::atomic<bool> initialized{false};
+    std::atomic<bool> evicted{false};  // Removed from seed_datasets
+    std::mutex build_mutex;  // Held while the dataset is being initialized
 
     DatasetEntry() : dataset(nullptr), last_used(0) {}
     ~DatasetEntry() {
         if (dataset) {
             randomx_release_dataset(dataset);
             dataset = nullptr;
+            rx_num_datasets--;
         }
     }
 };
@@ -81,31 +118,66 @@ void RandomX_SetCurrentNode(int node) {
     rx_node_id = node;
 }
 
-static bool rx_shutting_down = false;
-
 // Main seed for mining (set via RandomX_SetMainSeedHash)
 static uint256 main_seed;
 static bool main_seed_set = false;
 static std::mutex main_seed_mutex;
 
-// Track which VMs are using fast mode (per thread, per seed)
-struct ThreadLocalVM {
-    std::map<uint256, randomx_vm*> vms;
-    std::map<uint256, bool> vm_is_fast;  // Track if VM was created in fast mode
+// Bumped whenever thread-local VMs may no longer match the shared caches and
+// datasets (mode change, eviction, shutdown), so each thread revalidates its
+// fast-path VM on its next hash.
+static std::atomic<uint64_t> rx_vm_generation{1};
+
+// A thread's VM for one seed. The cache/dataset it was created from are held
+// here so they stay alive for as long as the VM can use them, even if they
+// are evicted from the shared maps meanwhile.
+struct ThreadVM {
+    randomx_vm* vm;
+    bool is_fast;  // VM was created in fast mode
+    std::shared_ptr<CacheEntry> cache_entry;
+    std::shared_ptr<DatasetEntry> dataset_entry;
+    std::vector<randomx_vm*> extra_vms;  // Additional VMs for N-way mining (RandomX_GetVMs)
 
-    ~ThreadLocalVM() {
-        for (auto& pair : vms) {
-            if (pair.second) {
-                randomx_destroy_vm(pair.second);
-            }
+    ThreadVM() : vm(nullptr), is_fast(false) {}
+    ~ThreadVM() {
+        if (vm) {
+            randomx_destroy_vm(vm);
         }
+        for (randomx_vm* extra : extra_vms) {
+            randomx_destroy_vm(extra);
+        }
+    }
+};
+
+struct ThreadLocalVM {
+    std::map<uint256, std::unique_ptr<ThreadVM>> vms;
+
+    // Fast path: the VM used by this thread's previous hash. Valid while
+    // generation matches rx_vm_generation.
+    uint256 last_seed;
+    ThreadVM* last;
+    uint64_t generation;
+
+    ThreadLocalVM() : last(nullptr), generation(0) {}
+
+    void clear() {
+        last = nullptr;
+        generation = 0;
         vms.clear();
-        vm_is_fast.clear();
     }
 };
 
 thread_local ThreadLocalVM rxVM_thread;
 
+// Update an LRU timestamp without dirtying the cache line on every hash
+static inline void TouchLastUsed(std::atomic<uint64_t>& last_used)
+{
+    uint64_t now = GetTime();
+    if (last_used.load(std::memory_order_relaxed) != now) {
+        last_used.store(now, std::memory_order_relaxed);
+    }
+}
+
 // Calculate seed height for a given block height
 uint64_t RandomX_SeedHeight(uint64_t height)
 {
@@ -115,21 +187,11 @@ uint64_t RandomX_SeedHeight(uint64_t height)
     return (height - RANDOMX_SEEDHASH_EPOCH_LAG - 1) & ~(RANDOMX_SEEDHASH_EPOCH_BLOCKS - 1);
 }
 
-// Get or create a cache for a specific seed
-static std::shared_ptr<CacheEntry> GetOrCreateCache(const uint256& seedhash)
+// Allocate and initialize the RandomX cache for entry->seedhash
+static bool BuildCache(CacheEntry& entry)
 {
-    std::lock_guard<std::mutex> lock(cache_map_mutex);
-
-    // Check if cache already exists
-    auto it = seed_caches.find(seedhash);
-    if (it != seed_caches.end()) {
-        it->second->last_used = GetTime();
-        return it->second;
-    }
-
-    // Create new cache
     LogPrintf("RandomX: Creating new cache for seed %s%s\n",
-              seedhash.GetHex(),
+              entry.seedhash.GetHex(),
               rx_use_hugepages ? " (with hugepages)" : "");
 
     randomx_flags flags = randomx_get_flags();
@@ -139,51 +201,168 @@ static std::shared_ptr<CacheEntry> GetOrCreateCache(const uint256& seedhash)
         flags |= RANDOMX_FLAG_LARGE_PAGES;
     }
 
-    auto entry = std::make_shared<CacheEntry>();
-    entry->cache = randomx_alloc_cache(flags);
-    if (!entry->cache && rx_use_hugepages) {
+    entry.cache = randomx_alloc_cache(flags);
+    if (!entry.cache && rx_use_hugepages) {
         // Hugepages allocation failed, try without
         LogPrintf("RandomX: WARNING - Failed to allocate cache with hugepages, retrying with normal memory\n");
         flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
-        entry->cache = randomx_alloc_cache(flags);
+        entry.cache = randomx_alloc_cache(flags);
     }
 
-    if (!entry->cache) {
+    if (!entry.cache) {
         LogPrintf("RandomX: ERROR - Failed to allocate cache\n");
-        return nullptr;
+        return false;
     }
 
-    randomx_init_cache(entry->cache, seedhash.begin(), 32);
-    entry->seedhash = seedhash;
-    entry->last_used = GetTime();
+    rx_num_caches++;
+    auto startTime = std::chrono::steady_clock::now();
+    randomx_init_cache(entry.cache, entry.seedhash.begin(), 32);
+    TRACE2(randomx, cache_rebuilt, entry.seedhash.begin(),
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+    return true;
+}
+
+// Get or create a cache for a specific seed
+static std::shared_ptr<CacheEntry> GetOrCreateCache(const uint256& seedhash)
+{
+    std::shared_ptr<CacheEntry> entry;
+    {
+        std::lock_guard<std::mutex> lock(cache_map_mutex);
+
+        // Check if cache already exists
+        auto it = seed_caches.find(seedhash);
+        if (it != seed_caches.end()) {
+            entry = it->second;
+            entry->last_used = GetTime();
+        } else {
+            entry = std::make_shared<CacheEntry>();
+            entry->seedhash = seedhash;
+            entry->last_used = GetTime();
+            seed_caches[seedhash] = entry;
+
+            // Cleanup old caches (keep most recent 5, which covers +/-2 epochs around current)
+            if (seed_caches.size() > 5) {
+                // Find oldest cache
+                auto oldest = seed_caches.begin();
+                for (auto check_it = seed_caches.begin(); check_it != seed_caches.end(); ++check_it) {
+                    if (check_it->second->last_used < oldest->second->last_used) {
+                        oldest = check_it;
+                    }
+                }
+                LogPrintf("RandomX: Evicting old cache for seed %s\n", oldest->first.GetHex());
+                oldest->second->evicted = true;
+                seed_caches.erase(oldest);
+                rx_vm_generation++;
+            }
+        }
+    }
 
-    seed_caches[seedhash] = entry;
+    if (entry->initialized) {
+        return entry;
+    }
 
-    // Cleanup old caches (keep most recent 5, which covers +/-2 epochs around current)
-    if (seed_caches.size() > 5) {
-        // Find oldest cache
-        auto oldest = seed_caches.begin();
-        for (auto check_it = seed_caches.begin(); check_it != seed_caches.end(); ++check_it) {
-            if (check_it->second->last_used < oldest->second->last_used) {
-                oldest = check_it;
+    // Initialize outside cache_map_mutex so that threads hashing with other
+    // seeds are not blocked while this one is built. Threads that need this
+    // same seed wait on build_mutex instead of building it a second time.
+    std::lock_guard<std::mutex> build_lock(entry->build_mutex);
+    if (!entry->initialized) {
+        if (!BuildCache(*entry)) {
+            std::lock_guard<std::mutex> lock(cache_map_mutex);
+            auto it = seed_caches.find(seedhash);
+            if (it != seed_caches.end() && it->second == entry) {
+                seed_caches.erase(it);
             }
+            return nullptr;
         }
-        LogPrintf("RandomX: Evicting old cache for seed %s\n", oldest->first.GetHex());
-        seed_caches.erase(oldest);
+        entry->initialized = true;
     }
 
     return entry;
 }
 
-// Initialize dataset in parallel using multiple threads
-static void InitDatasetParallel(randomx_dataset* dataset, randomx_cache* cache, int numThreads)
+// Initialize dataset in parallel using multiple threads. Returns false if
+// initialization was abandoned because RandomX is shutting down.
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace randomx_avx2
+{
+/** Initialize count dataset items from startItem into out, sixteen at a time; count must be a multiple of sixteen. */
+void InitDataset_16way(randomx_cache* cache, uint8_t* out, uint64_t startItem, uint64_t count);
+}
+
+/**
+ * Whether to build this dataset with the AVX2 initializer instead
+ * of RandomX's own. Its first items are built both ways: the AVX2 ones must
+ * match exactly, as they run every instruction of the seed's programs, and
+ * must have been built faster. The items are left as RandomX built them.
+ */
+static bool UseAVX2DatasetInit(randomx_dataset* dataset, randomx_cache* cache)
 {
+    static const bool fAVX2 = CPUFeatures::HasAVX2();
+    static const unsigned long CHECK_ITEMS = 1024;
+    if (!fAVX2) {
+        return false;
+    }
+
+    uint8_t* memory = static_cast<uint8_t*>(randomx_get_dataset_memory(dataset));
+    size_t nBytes = CHECK_ITEMS * RANDOMX_DATASET_ITEM_SIZE;
+    std::vector<uint8_t> expected(nBytes);
+    auto time = [](const std::function<void()>& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double usDefault = time([&] { randomx_init_dataset(dataset, cache, 0, CHECK_ITEMS); });
+    memcpy(expected.data(), memory, nBytes);
+    double usAVX2 = time([&] { randomx_avx2::InitDataset_16way(cache, memory, 0, CHECK_ITEMS); });
+    bool fMatch = memcmp(expected.data(), memory, nBytes) == 0;
+    usDefault = std::min(usDefault, time([&] { randomx_init_dataset(dataset, cache, 0, CHECK_ITEMS); }));
+
+    if (!fMatch) {
+        LogPrintf("RandomX: AVX2 dataset initialization gave different items, not using it\n");
+        return false;
+    }
+    bool fUse = usAVX2 < usDefault;
+    LogPrintf("RandomX: %s AVX2 dataset initialization (%.2f us/item, default %.2f us/item)\n",
+              fUse ? "using" : "not using", usAVX2 / CHECK_ITEMS, usDefault / CHECK_ITEMS);
+    return fUse;
+}
+#endif
+
+bool RandomX_InitDatasetParallel(randomx_dataset* dataset, randomx_cache* cache, int numThreads)
+{
+    // Items are initialized in chunks so shutdown does not have to wait for a
+    // full (possibly low-priority) dataset build to finish.
+    static const unsigned long CHUNK_ITEMS = 1 << 16;
     unsigned long itemCount = randomx_dataset_item_count();
 
+    bool fAVX2 = false;
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    fAVX2 = UseAVX2DatasetInit(dataset, cache);
+#endif
+
+    auto initRange = [dataset, cache, fAVX2](unsigned long startItem, unsigned long count) {
+        while (count > 0 && !rx_shutting_down) {
+            unsigned long n = std::min(count, CHUNK_ITEMS);
+            unsigned long n16 = fAVX2 ? n - n % 16 : 0;
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+            if (n16 > 0) {
+                uint8_t* memory = static_cast<uint8_t*>(randomx_get_dataset_memory(dataset));
+                randomx_avx2::InitDataset_16way(cache, memory + startItem * RANDOMX_DATASET_ITEM_SIZE, startItem, n16);
+            }
+#endif
+            if (n16 < n) {
+                randomx_init_dataset(dataset, cache, startItem + n16, n - n16);
+            }
+            startItem += n;
+            count -= n;
+        }
+    };
+
     if (numThreads <= 1) {
         // Single-threaded initialization
-        randomx_init_dataset(dataset, cache, 0, itemCount);
-        return;
+        initRange(0, itemCount);
+        return !rx_shutting_down;
     }
 
     // Multi-threaded initialization
@@ -196,37 +375,43 @@ static void InitDatasetParallel(randomx_dataset* dataset, randomx_cache* cache,
         unsigned long endItem = startItem + itemsPerThread + (t < (int)remainder ? 1 : 0);
         unsigned long count = endItem - startItem;
 
-        threads.emplace_back([dataset, cache, startItem, count]() {
-            randomx_init_dataset(dataset, cache, startItem, count);
-        });
+        threads.emplace_back(initRange, startItem, count);
     }
 
     for (auto& thread : threads) {
         thread.join();
     }
+    return !rx_shutting_down;
 }
 
-// Get or create a dataset for a specific seed (fast mode only)
-static std::shared_ptr<DatasetEntry> GetOrCreateDataset(const uint256& seedhash, std::shared_ptr<CacheEntry> cache_entry)
+// Allocate and initialize the RandomX dataset for entry->seedhash on nodeId
+static bool BuildDataset(DatasetEntry& entry, const CacheEntry& cache_entry, int nodeId, int numThreads)
 {
-    std::lock_guard<std::mutex> lock(dataset_map_mutex);
-
-    // Use current thread's NUMA node (or -1 for default)
-    int nodeId = rx_node_id;
-
-    // Check if dataset already exists for this node
-    if (seed_datasets.count(seedhash) > 0) {
-        auto& nodeMap = seed_datasets[seedhash];
-        auto it = nodeMap.find(nodeId);
-        if (it != nodeMap.end() && it->second->initialized) {
-            it->second->last_used = GetTime();
-            return it->second;
+    // With -randomxdatasetdir, reuse a dataset another process (or a previous
+    // run) already built, or build it where others can find it.
+    bool fShared = false;
+    if (RandomX_SharedDatasetEnabled()) {
+        bool fReady = false;
+#ifdef HAVE_NUMA
+        if (nodeId >= 0) {
+            numa_set_preferred(nodeId);
+        }
+#endif
+        entry.dataset = RandomX_SharedDataset_Acquire(entry.seedhash, nodeId, cache_entry.cache, fReady);
+#ifdef HAVE_NUMA
+        if (nodeId >= 0) {
+            numa_set_preferred(-1); // Reset to default
+        }
+#endif
+        if (entry.dataset && fReady) {
+            rx_num_datasets++;
+            return true;
         }
+        fShared = (entry.dataset != nullptr);
     }
 
-    // Create new dataset
     LogPrintf("RandomX: Creating new dataset for seed %s (node %d, ~30s)%s...\n",
-              seedhash.GetHex(), nodeId,
+              entry.seedhash.GetHex(), nodeId,
               rx_use_hugepages ? " (with hugepages)" : "");
 
 #ifdef HAVE_NUMA
@@ -242,13 +427,14 @@ static std::shared_ptr<DatasetEntry> GetOrCreateDataset(const uint256& seedhash,
         flags |= RANDOMX_FLAG_LARGE_PAGES;
     }
 
-    auto entry = std::make_shared<DatasetEntry>();
-    entry->dataset = randomx_alloc_dataset(flags);
-    if (!entry->dataset && rx_use_hugepages) {
+    if (!fShared) {
+        entry.dataset = randomx_alloc_dataset(flags);
+    }
+    if (!entry.dataset && rx_use_hugepages) {
         // Hugepages allocation failed, try without
         LogPrintf("RandomX: WARNING - Failed to allocate dataset with hugepages, retrying with normal memory\n");
         flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
-        entry->dataset = randomx_alloc_dataset(flags);
+        entry.dataset = randomx_alloc_dataset(flags);
     }
 
 #ifdef HAVE_NUMA
@@ -257,52 +443,226 @@ static std::shared_ptr<DatasetEntry> GetOrCreateDataset(const uint256& seedhash,
     }
 #endif
 
-    if (!entry->dataset) {
+    if (!entry.dataset) {
         LogPrintf("RandomX: ERROR - Failed to allocate dataset (need ~2GB RAM)\n");
-        return nullptr;
+        return false;
     }
 
     // Initialize dataset from cache using multiple threads
+    auto startTime = std::chrono::steady_clock::now();
+    rx_datasets_building++;
+    bool fInitialized = RandomX_InitDatasetParallel(entry.dataset, cache_entry.cache, numThreads);
+    rx_datasets_building--;
+    if (!fInitialized) {
+        randomx_release_dataset(entry.dataset);
+        entry.dataset = nullptr;
+        return false;
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+    rx_last_dataset_build_ms = elapsed;
+    rx_num_datasets++;
+    TRACE4(randomx, dataset_rebuilt, entry.seedhash.begin(), nodeId, numThreads, elapsed);
+
+    if (fShared) {
+        RandomX_SharedDataset_Publish(entry.dataset);
+    }
+
+    LogPrintf("RandomX: Dataset initialized in %d ms using %d threads\n", (int)elapsed, numThreads);
+    return true;
+}
+
+// Number of threads used to initialize a dataset that a caller is waiting for
+static int DatasetInitThreads()
+{
     int numThreads = std::thread::hardware_concurrency();
     if (numThreads < 1) numThreads = 4;  // Fallback
     if (numThreads > 16) numThreads = 16;  // Cap at 16 threads
+    return numThreads;
+}
 
-    auto startTime = std::chrono::steady_clock::now();
-    InitDatasetParallel(entry->dataset, cache_entry->cache, numThreads);
-    auto endTime = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+// Get or create a dataset for a specific seed on a NUMA node (fast mode only)
+static std::shared_ptr<DatasetEntry> GetOrCreateDataset(const uint256& seedhash, std::shared_ptr<CacheEntry> cache_entry,
+                                                        int nodeId, int numThreads)
+{
+    std::shared_ptr<DatasetEntry> entry;
+    {
+        std::lock_guard<std::mutex> lock(dataset_map_mutex);
 
-    entry->seedhash = seedhash;
-    entry->last_used = GetTime();
-    entry->initialized = true;
+        // Check if dataset already exists (or is being built) for this node
+        auto& nodeMap = seed_datasets[seedhash];
+        auto it = nodeMap.find(nodeId);
+        if (it != nodeMap.end()) {
+            entry = it->second;
+            entry->last_used = GetTime();
+        } else {
+            entry = std::make_shared<DatasetEntry>();
+            entry->seedhash = seedhash;
+            entry->last_used = GetTime();
+            nodeMap[nodeId] = entry;
+
+            // Cleanup old datasets (keep most recent 2 seeds)
+            if (seed_datasets.size() > 2) {
+                auto oldest = seed_datasets.end();
+                // Find oldest seed by checking any of its datasets (they share same seed/time roughly)
+                uint64_t oldest_time = std::numeric_limits<uint64_t>::max();
+
+                for (auto it = seed_datasets.begin(); it != seed_datasets.end(); ++it) {
+                    if (it->first != seedhash && !it->second.empty()) {
+                        // Check first dataset in this seed's map
+                        if (it->second.begin()->second->last_used < oldest_time) {
+                            oldest_time = it->second.begin()->second->last_used;
+                            oldest = it;
+                        }
+                    }
+                }
 
-    seed_datasets[seedhash][nodeId] = entry;
+                if (oldest != seed_datasets.end()) {
+                    LogPrintf("RandomX: Evicting old datasets for seed %s\n", oldest->first.GetHex());
+                    for (auto& node : oldest->second) {
+                        node.second->evicted = true;
+                        RandomX_SharedDataset_Discard(oldest->first, node.first);
+                    }
+                    seed_datasets.erase(oldest);
+                    rx_vm_generation++;
+                }
+            }
+        }
+    }
 
-    LogPrintf("RandomX: Dataset initialized in %d ms using %d threads\n", (int)elapsed, numThreads);
+    if (entry->initialized) {
+        return entry;
+    }
 
-    // Cleanup old datasets (keep most recent 2 seeds)
-    if (seed_datasets.size() > 2) {
-        auto oldest = seed_datasets.begin();
-        // Find oldest seed by checking any of its datasets (they share same seed/time roughly)
-        uint64_t oldest_time = std::numeric_limits<uint64_t>::max();
-        
-        for (auto it = seed_datasets.begin(); it != seed_datasets.end(); ++it) {
-            if (!it->second.empty()) {
-                // Check first dataset in this seed's map
-                if (it->second.begin()->second->last_used < oldest_time) {
-                    oldest_time = it->second.begin()->second->last_used;
-                    oldest = it;
+    // As for caches, the (~30s) initialization runs outside dataset_map_mutex
+    // so that hashing with already-built datasets continues meanwhile.
+    std::lock_guard<std::mutex> build_lock(entry->build_mutex);
+    if (!entry->initialized) {
+        if (!BuildDataset(*entry, *cache_entry, nodeId, numThreads)) {
+            std::lock_guard<std::mutex> lock(dataset_map_mutex);
+            auto sit = seed_datasets.find(seedhash);
+            if (sit != seed_datasets.end()) {
+                auto nit = sit->second.find(nodeId);
+                if (nit != sit->second.end() && nit->second == entry) {
+                    sit->second.erase(nit);
+                }
+                if (sit->second.empty()) {
+                    seed_datasets.erase(sit);
                 }
             }
+            return nullptr;
         }
-        
-        LogPrintf("RandomX: Evicting old datasets for seed %s\n", oldest->first.GetHex());
-        seed_datasets.erase(oldest);
+        entry->initialized = true;
     }
 
     return entry;
 }
 
+static std::shared_ptr<DatasetEntry> GetOrCreateDataset(const uint256& seedhash, std::shared_ptr<CacheEntry> cache_entry)
+{
+    // Use current thread's NUMA node (or -1 for default), unless memory is
+    // short and all nodes share one dataset
+    int nodeId = rx_memory_level == RANDOMX_MEMORY_FULL ? rx_node_id : rx_shared_dataset_node.load();
+    return GetOrCreateDataset(seedhash, cache_entry, nodeId, DatasetInitThreads());
+}
+
+// Background builder for the next epoch's cache (and, in fast mode, datasets)
+static std::thread rx_prebuild_thread;
+static std::mutex rx_prebuild_mutex;
+static std::condition_variable rx_prebuild_cv;
+static uint256 rx_prebuild_seed;           // Most recently requested seed
+static bool rx_prebuild_requested = false; // rx_prebuild_seed is valid
+static bool rx_prebuild_pending = false;   // rx_prebuild_seed not yet picked up
+static bool rx_prebuild_stop = false;
+
+static void RandomXPrebuildThread()
+{
+    RenameThread("zc-rx-prebuild");
+
+    while (true) {
+        uint256 seed;
+        {
+            std::unique_lock<std::mutex> lock(rx_prebuild_mutex);
+            rx_prebuild_cv.wait(lock, [] { return rx_prebuild_pending || rx_prebuild_stop; });
+            if (rx_prebuild_stop) return;
+            seed = rx_prebuild_seed;
+            rx_prebuild_pending = false;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        auto cache = GetOrCreateCache(seed);
+        if (!cache || !rx_fast_mode) continue;
+
+        // Build a dataset on every NUMA node that has one for the seed that is
+        // currently being mined, so each node's miners can switch immediately.
+        uint256 current;
+        {
+            std::lock_guard<std::mutex> lock(main_seed_mutex);
+            current = main_seed;
+        }
+        std::vector<int> nodes;
+        {
+            std::lock_guard<std::mutex> lock(dataset_map_mutex);
+            auto it = seed_datasets.find(current);
+            if (it != seed_datasets.end()) {
+                for (const auto& node : it->second) {
+                    nodes.push_back(node.first);
+                }
+            }
+        }
+
+        // Leave most cores to the miners; there are ~RANDOMX_SEEDHASH_EPOCH_LAG
+        // blocks before the new seed is needed.
+        int numThreads = std::max(1, DatasetInitThreads() / 4);
+        for (int node : nodes) {
+            if (rx_shutting_down) break;
+            GetOrCreateDataset(seed, cache, node, numThreads);
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        LogPrintf("RandomX: Prepared seed %s for %u NUMA node(s) in %d ms\n", seed.GetHex(), nodes.size(), (int)elapsed);
+    }
+}
+
+void RandomX_PrepareSeedHash(const void* seedhash, size_t size)
+{
+    if (!seedhash || size != 32 || rx_shutting_down) {
+        return;
+    }
+
+    uint256 seed;
+    memcpy(seed.begin(), seedhash, 32);
+
+    std::lock_guard<std::mutex> lock(rx_prebuild_mutex);
+    if (rx_prebuild_stop || (rx_prebuild_requested && rx_prebuild_seed == seed)) {
+        return;
+    }
+    if (!rx_prebuild_thread.joinable()) {
+        rx_prebuild_thread = std::thread(RandomXPrebuildThread);
+    }
+    rx_prebuild_seed = seed;
+    rx_prebuild_requested = true;
+    rx_prebuild_pending = true;
+    rx_prebuild_cv.notify_one();
+}
+
+static void StopPrebuildThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(rx_prebuild_mutex);
+        rx_prebuild_stop = true;
+    }
+    rx_prebuild_cv.notify_all();
+    if (rx_prebuild_thread.joinable()) {
+        rx_prebuild_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(rx_prebuild_mutex);
+    rx_prebuild_stop = false;
+    rx_prebuild_requested = false;
+    rx_prebuild_pending = false;
+}
+
 // Check if fast mode is enabled
 bool RandomX_IsFastMode()
 {
@@ -324,8 +684,14 @@ void RandomX_ChangeMode(bool fastMode, bool useHugePages)
     // Update global flags
     // Mining threads will automatically detect the mode change and recreate their VMs
     // (see RandomX_Hash_WithSeed lines 394-406 for VM mode mismatch detection)
+    {
+        std::lock_guard<std::mutex> lock(rx_memory_mutex);
+        rx_memory_level = RANDOMX_MEMORY_FULL;
+        rx_memory_level_time = GetTime();
+    }
     rx_fast_mode = fastMode;
     rx_use_hugepages = useHugePages;
+    rx_vm_generation++;
 
     // Pre-create cache/dataset for current main seed with new settings
     uint256 seed;
@@ -364,6 +730,7 @@ void RandomX_Init(bool fastMode, bool useHugePages)
 
     rx_fast_mode = fastMode;
     rx_use_hugepages = useHugePages;
+    rx_memory_level = RANDOMX_MEMORY_FULL;
     LogPrintf("RandomX: Initializing %s mode%s\n",
               fastMode ? "FAST (2GB dataset)" : "light (256MB cache)",
               useHugePages ? " with hugepages" : "");
@@ -400,9 +767,12 @@ void RandomX_Shutdown()
 
     rx_shutting_down = true;
 
-    // Clean up thread-local VMs
-    rxVM_thread.vms.clear();
-    rxVM_thread.vm_is_fast.clear();
+    // Stop the next-epoch builder (it abandons any dataset it is initializing)
+    StopPrebuildThread();
+
+    // Clean up thread-local VMs; other threads drop theirs on their next hash
+    rx_vm_generation++;
+    rxVM_thread.clear();
 
     // Give other threads time to finish
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -410,12 +780,20 @@ void RandomX_Shutdown()
     // Clean up all datasets
     {
         std::lock_guard<std::mutex> lock(dataset_map_mutex);
+        for (auto& seed : seed_datasets) {
+            for (auto& node : seed.second) {
+                node.second->evicted = true;
+            }
+        }
         seed_datasets.clear();
     }
 
     // Clean up all caches
     {
         std::lock_guard<std::mutex> lock(cache_map_mutex);
+        for (auto& entry : seed_caches) {
+            entry.second->evicted = true;
+        }
         seed_caches.clear();
     }
 
@@ -423,6 +801,250 @@ void RandomX_Shutdown()
     LogPrintf("RandomX: Shutdown complete\n");
 }
 
+RandomXMemoryStats RandomX_GetMemoryStats()
+{
+    RandomXMemoryStats stats;
+    stats.caches = rx_num_caches.load();
+    stats.datasets = rx_num_datasets.load();
+    stats.datasets_building = rx_datasets_building.load();
+    stats.last_dataset_build_ms = rx_last_dataset_build_ms.load();
+    stats.memory_level = rx_memory_level.load();
+    stats.memory_level_changes = rx_memory_level_changes.load();
+    return stats;
+}
+
+std::vector<RandomXSeedMemory> RandomX_GetSeedMemory()
+{
+    std::vector<RandomXSeedMemory> result;
+    {
+        std::lock_guard<std::mutex> lock(cache_map_mutex);
+        for (const auto& [seedhash, entry] : seed_caches) {
+            if (entry->initialized) {
+                result.push_back({seedhash, false, -1, (size_t)RANDOMX_ARGON_MEMORY * 1024});
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(dataset_map_mutex);
+        for (const auto& [seedhash, nodes] : seed_datasets) {
+            for (const auto& [node, entry] : nodes) {
+                if (entry->initialized) {
+                    result.push_back({seedhash, true, node, (size_t)randomx_dataset_item_count() * RANDOMX_DATASET_ITEM_SIZE});
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Read the first number in a file, or -1 if there is none (as for a cgroup
+// memory.max of "max")
+static int64_t ReadInt64File(const std::string& path)
+{
+    std::ifstream file(path);
+    int64_t value;
+    if (!(file >> value)) {
+        return -1;
+    }
+    return value;
+}
+
+// Read a "key value" line of a cgroup memory.stat file, 0 if it is missing
+static int64_t ReadMemoryStat(const std::string& path, const std::string& key)
+{
+    std::ifstream file(path);
+    std::string name;
+    int64_t value;
+    while (file >> name >> value) {
+        if (name == key) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+// Bytes the process can still allocate before the host starts swapping or
+// its cgroup hits its limit, or -1 if this is not known (Linux only)
+static int64_t GetAvailableMemory()
+{
+    int64_t nAvailable = -1;
+    {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string name, unit;
+        int64_t value;
+        while (meminfo >> name >> value) {
+            std::getline(meminfo, unit);
+            if (name == "MemAvailable:") {
+                nAvailable = value * 1024;
+                break;
+            }
+        }
+    }
+
+    // Lines are hierarchy-ID:controller-list:cgroup-path. cgroup v2 has an
+    // empty controller list; v1 has its own hierarchy for "memory".
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        std::string root, limitFile, usageFile, inactiveKey;
+        if (controllers.empty()) {
+            root = "/sys/fs/cgroup";
+            limitFile = "memory.max";
+            usageFile = "memory.current";
+            inactiveKey = "inactive_file";
+        } else if (("," + controllers + ",").find(",memory,") != std::string::npos) {
+            root = "/sys/fs/cgroup/memory";
+            limitFile = "memory.limit_in_bytes";
+            usageFile = "memory.usage_in_bytes";
+            inactiveKey = "total_inactive_file";
+        } else {
+            continue;
+        }
+
+        // Inside a container the host's cgroup path may not be mounted
+        std::string dir = root + path;
+        int64_t nLimit = ReadInt64File(dir + "/" + limitFile);
+        if (nLimit < 0 && ReadInt64File(dir + "/" + usageFile) < 0) {
+            dir = root;
+            nLimit = ReadInt64File(dir + "/" + limitFile);
+        }
+        int64_t nUsage = ReadInt64File(dir + "/" + usageFile);
+        // cgroup v1 reports no limit as a huge number
+        if (nLimit < 0 || nUsage < 0 || nLimit >= (int64_t{1} << 62)) {
+            continue;
+        }
+        // Inactive page cache is reclaimed before the limit is enforced
+        nUsage -= std::min(nUsage, ReadMemoryStat(dir + "/memory.stat", inactiveKey));
+        int64_t nHeadroom = std::max<int64_t>(0, nLimit - nUsage);
+        nAvailable = nAvailable < 0 ? nHeadroom : std::min(nAvailable, nHeadroom);
+    }
+    return nAvailable;
+}
+
+// Drop the datasets of every seed on nodes other than keepNode (on all nodes
+// if fAll). Their memory is released once the VMs using them are recreated.
+static void EvictDatasets(bool fAll, int keepNode)
+{
+    {
+        std::lock_guard<std::mutex> lock(dataset_map_mutex);
+        for (auto sit = seed_datasets.begin(); sit != seed_datasets.end(); ) {
+            for (auto nit = sit->second.begin(); nit != sit->second.end(); ) {
+                if (fAll || nit->first != keepNode) {
+                    nit->second->evicted = true;
+                    RandomX_SharedDataset_Discard(sit->first, nit->first);
+                    nit = sit->second.erase(nit);
+                } else {
+                    ++nit;
+                }
+            }
+            if (sit->second.empty()) {
+                sit = seed_datasets.erase(sit);
+            } else {
+                ++sit;
+            }
+        }
+    }
+    rx_vm_generation++;
+}
+
+// Record a step of RandomX_CheckMemoryPressure. Caller holds rx_memory_mutex.
+static void SetMemoryLevel(RandomXMemoryLevel level, int64_t nAvailable)
+{
+    LogPrintf("RandomX: %d MiB of memory available, switching from %s to %s\n",
+              (int)(nAvailable >> 20),
+              RandomX_MemoryLevelName((RandomXMemoryLevel)rx_memory_level.load()),
+              RandomX_MemoryLevelName(level));
+    rx_memory_level = level;
+    rx_memory_level_time = GetTime();
+    rx_memory_level_changes++;
+}
+
+void RandomX_CheckMemoryPressure(int64_t nReserve)
+{
+    // Freed dataset memory only shows up once the VMs have been recreated, so
+    // give each step time to settle before judging it
+    static const int64_t SETTLE_SECONDS = 60;
+
+    if (nReserve <= 0 || !rx_initialized || rx_shutting_down) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(rx_memory_mutex);
+    int level = rx_memory_level;
+    if (level == RANDOMX_MEMORY_FULL && !rx_fast_mode) {
+        return;  // Light mode was asked for
+    }
+    if (GetTime() - rx_memory_level_time < SETTLE_SECONDS) {
+        return;
+    }
+    int64_t nAvailable = GetAvailableMemory();
+    if (nAvailable < 0) {
+        return;
+    }
+    const int64_t nDatasetBytes = (int64_t)randomx_dataset_item_count() * RANDOMX_DATASET_ITEM_SIZE;
+
+    if (nAvailable < nReserve) {
+        if (level == RANDOMX_MEMORY_LIGHT) {
+            return;
+        }
+        std::vector<int> nodes;
+        {
+            uint256 seed = RandomX_GetMainSeedHash();
+            std::lock_guard<std::mutex> datasetLock(dataset_map_mutex);
+            auto it = seed_datasets.find(seed);
+            if (it != seed_datasets.end()) {
+                for (const auto& node : it->second) {
+                    nodes.push_back(node.first);
+                }
+            }
+        }
+        if (level == RANDOMX_MEMORY_FULL) {
+            rx_full_dataset_nodes = std::max<size_t>(1, nodes.size());
+        }
+        if (level == RANDOMX_MEMORY_FULL && nodes.size() > 1) {
+            rx_shared_dataset_node = nodes.front();
+            SetMemoryLevel(RANDOMX_MEMORY_ONE_DATASET, nAvailable);
+            EvictDatasets(false, nodes.front());
+        } else {
+            rx_fast_mode = false;
+            SetMemoryLevel(RANDOMX_MEMORY_LIGHT, nAvailable);
+            EvictDatasets(true, -1);
+        }
+    } else if (level == RANDOMX_MEMORY_LIGHT && nAvailable - nReserve >= nDatasetBytes) {
+        // Threads build the dataset again on their next hash
+        SetMemoryLevel(rx_full_dataset_nodes > 1 ? RANDOMX_MEMORY_ONE_DATASET : RANDOMX_MEMORY_FULL, nAvailable);
+        rx_fast_mode = true;
+        rx_vm_generation++;
+    } else if (level == RANDOMX_MEMORY_ONE_DATASET &&
+               nAvailable - nReserve >= (int64_t)(rx_full_dataset_nodes - 1) * nDatasetBytes) {
+        SetMemoryLevel(RANDOMX_MEMORY_FULL, nAvailable);
+        rx_vm_generation++;
+    }
+}
+
+const char* RandomX_MemoryLevelName(RandomXMemoryLevel level)
+{
+    switch (level) {
+    case RANDOMX_MEMORY_FULL: return "full";
+    case RANDOMX_MEMORY_ONE_DATASET: return "onedataset";
+    case RANDOMX_MEMORY_LIGHT: return "light";
+    }
+    return "unknown";
+}
+
+uint256 RandomX_GetMainSeedHash()
+{
+    std::lock_guard<std::mutex> lock(main_seed_mutex);
+    return main_seed_set ? main_seed : uint256();
+}
+
 // Set main seed hash (for mining - pre-caches the seed)
 void RandomX_SetMainSeedHash(const void* seedhash, size_t size)
 {
@@ -452,9 +1074,88 @@ void RandomX_SetMainSeedHash(const void* seedhash, size_t size)
     LogPrintf("RandomX: Main seed set to %s\n", seed.GetHex());
 }
 
-// Get or create thread-local VM for a specific seed
-static randomx_vm* GetVM(const uint256& seed)
+// Create a VM for a seed's cache, or its dataset when use_fast is set.
+// use_fast is cleared if only a light VM could be created.
+static randomx_vm* CreateVM(CacheEntry& cache_entry, DatasetEntry* dataset_entry, bool& use_fast)
+{
+    randomx_flags flags = randomx_get_flags();
+    flags |= RANDOMX_FLAG_JIT;
+
+    if (rx_use_hugepages) {
+        flags |= RANDOMX_FLAG_LARGE_PAGES;
+    }
+
+    randomx_vm* vm = nullptr;
+    bool tried_hugepages = false;
+
+#ifdef HAVE_NUMA
+    // Reserve the scratchpad (populated up front when using hugepages) and
+    // JIT code buffer on this thread's node
+    if (rx_node_id >= 0) {
+        numa_set_preferred(rx_node_id);
+    }
+#endif
+
+    if (use_fast) {
+        // Fast mode: use dataset
+        flags |= RANDOMX_FLAG_FULL_MEM;
+        vm = randomx_create_vm(flags, nullptr, dataset_entry->dataset);
+        if (!vm && rx_use_hugepages) {
+            // Try without hugepages
+            tried_hugepages = true;
+            LogPrintf("RandomX: WARNING - Failed to create fast VM with hugepages, trying without\n");
+            flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
+            vm = randomx_create_vm(flags, nullptr, dataset_entry->dataset);
+        }
+        if (!vm) {
+            LogPrintf("RandomX: WARNING - Failed to create fast VM, trying light mode\n");
+            use_fast = false;
+        }
+    }
+
+    if (!vm) {
+        // Light mode: use cache
+        flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_FULL_MEM));
+        if (rx_use_hugepages && !tried_hugepages) {
+            flags |= RANDOMX_FLAG_LARGE_PAGES;
+        }
+        vm = randomx_create_vm(flags, cache_entry.cache, nullptr);
+        if (!vm && rx_use_hugepages) {
+            // Try without hugepages
+            LogPrintf("RandomX: WARNING - Failed to create VM with hugepages, trying without\n");
+            flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
+            vm = randomx_create_vm(flags, cache_entry.cache, nullptr);
+        }
+    }
+
+#ifdef HAVE_NUMA
+    if (rx_node_id >= 0) {
+        numa_set_preferred(-1); // Reset to default
+    }
+#endif
+
+    if (!vm) {
+        LogPrintf("RandomX: ERROR - Failed to create VM\n");
+    }
+    return vm;
+}
+
+// Slow path of GetVM: look the seed up in the shared maps and create or
+// revalidate this thread's VM for it.
+static ThreadVM* GetVMSlow(const uint256& seed)
 {
+    ThreadLocalVM& tls = rxVM_thread;
+
+    // Drop VMs whose cache or dataset has been evicted, releasing their memory
+    for (auto it = tls.vms.begin(); it != tls.vms.end(); ) {
+        const ThreadVM& tvm = *it->second;
+        if (tvm.cache_entry->evicted || (tvm.dataset_entry && tvm.dataset_entry->evicted)) {
+            it = tls.vms.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     // Get or create cache for this seed (always needed, even in fast mode for dataset init)
     auto cache_entry = GetOrCreateCache(seed);
     if (!cache_entry || !cache_entry->cache) {
@@ -473,77 +1174,109 @@ static randomx_vm* GetVM(const uint256& seed)
     bool use_fast = rx_fast_mode && dataset_entry && dataset_entry->dataset && dataset_entry->initialized;
 
     // Get or create thread-local VM for this seed
-    auto vm_it = rxVM_thread.vms.find(seed);
-    bool need_new_vm = (vm_it == rxVM_thread.vms.end());
+    auto vm_it = tls.vms.find(seed);
+    bool need_new_vm = (vm_it == tls.vms.end());
 
-    // Check if existing VM mode matches what we need
+    // Check if existing VM still matches what we need
     if (!need_new_vm) {
-        auto fast_it = rxVM_thread.vm_is_fast.find(seed);
-        bool vm_is_fast = (fast_it != rxVM_thread.vm_is_fast.end()) && fast_it->second;
-
-        // If we want fast mode but have light VM (or vice versa), recreate
-        if (use_fast != vm_is_fast) {
-            randomx_destroy_vm(vm_it->second);
-            rxVM_thread.vms.erase(vm_it);
-            rxVM_thread.vm_is_fast.erase(seed);
+        const ThreadVM& tvm = *vm_it->second;
+        // If we want fast mode but have light VM (or vice versa), or the VM
+        // was built from a different cache/dataset than the current ones, recreate
+        if (use_fast != tvm.is_fast || tvm.cache_entry != cache_entry ||
+            (use_fast && tvm.dataset_entry != dataset_entry)) {
+            tls.vms.erase(vm_it);
             need_new_vm = true;
         }
     }
 
     if (need_new_vm) {
-        randomx_flags flags = randomx_get_flags();
-        flags |= RANDOMX_FLAG_JIT;
-
-        if (rx_use_hugepages) {
-            flags |= RANDOMX_FLAG_LARGE_PAGES;
+        randomx_vm* vm = CreateVM(*cache_entry, dataset_entry.get(), use_fast);
+        if (!vm) {
+            return nullptr;
         }
 
-        randomx_vm* vm = nullptr;
-        bool tried_hugepages = false;
-
+        std::unique_ptr<ThreadVM> tvm(new ThreadVM());
+        tvm->vm = vm;
+        tvm->is_fast = use_fast;
+        tvm->cache_entry = cache_entry;
         if (use_fast) {
-            // Fast mode: use dataset
-            flags |= RANDOMX_FLAG_FULL_MEM;
-            vm = randomx_create_vm(flags, nullptr, dataset_entry->dataset);
-            if (!vm && rx_use_hugepages) {
-                // Try without hugepages
-                tried_hugepages = true;
-                LogPrintf("RandomX: WARNING - Failed to create fast VM with hugepages, trying without\n");
-                flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
-                vm = randomx_create_vm(flags, nullptr, dataset_entry->dataset);
-            }
-            if (!vm) {
-                LogPrintf("RandomX: WARNING - Failed to create fast VM, trying light mode\n");
-                use_fast = false;
-            }
+            tvm->dataset_entry = dataset_entry;
         }
+        vm_it = tls.vms.emplace(seed, std::move(tvm)).first;
+    }
 
-        if (!vm) {
-            // Light mode: use cache
-            flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_FULL_MEM));
-            if (rx_use_hugepages && !tried_hugepages) {
-                flags |= RANDOMX_FLAG_LARGE_PAGES;
-            }
-            vm = randomx_create_vm(flags, cache_entry->cache, nullptr);
-            if (!vm && rx_use_hugepages) {
-                // Try without hugepages
-                LogPrintf("RandomX: WARNING - Failed to create VM with hugepages, trying without\n");
-                flags = static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
-                vm = randomx_create_vm(flags, cache_entry->cache, nullptr);
-            }
-        }
+    return vm_it->second.get();
+}
 
-        if (!vm) {
-            LogPrintf("RandomX: ERROR - Failed to create VM\n");
-            return nullptr;
+// Get or create thread-local VM for a specific seed
+static randomx_vm* GetVM(const uint256& seed)
+{
+    ThreadLocalVM& tls = rxVM_thread;
+
+    // Read the generation before the slow path, so that an eviction or mode
+    // change racing with it forces another revalidation next time.
+    uint64_t generation = rx_vm_generation.load(std::memory_order_acquire);
+
+    // Common case: same seed as this thread's previous hash and nothing has
+    // changed since. This takes no locks.
+    if (tls.last && tls.generation == generation && tls.last_seed == seed) {
+        TouchLastUsed(tls.last->cache_entry->last_used);
+        if (tls.last->dataset_entry) {
+            TouchLastUsed(tls.last->dataset_entry->last_used);
         }
+        return tls.last->vm;
+    }
 
-        rxVM_thread.vms[seed] = vm;
-        rxVM_thread.vm_is_fast[seed] = use_fast;
-        vm_it = rxVM_thread.vms.find(seed);
+    ThreadVM* tvm = GetVMSlow(seed);
+    if (!tvm) {
+        tls.last = nullptr;
+        return nullptr;
     }
 
-    return vm_it->second;
+    tls.last = tvm;
+    tls.last_seed = seed;
+    tls.generation = generation;
+    return tvm->vm;
+}
+
+// Size of the pages backing addr, from /proc/self/smaps
+static size_t PageSizeOf(const void* addr)
+{
+#ifdef __linux__
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    uintptr_t target = reinterpret_cast<uintptr_t>(addr);
+    bool in_mapping = false;
+    while (std::getline(smaps, line)) {
+        unsigned long start, end;
+        if (sscanf(line.c_str(), "%lx-%lx ", &start, &end) == 2) {
+            // Header line of the next mapping
+            if (in_mapping) break;
+            in_mapping = (target >= start && target < end);
+        } else if (in_mapping && line.compare(0, 15, "KernelPageSize:") == 0) {
+            return strtoul(line.c_str() + 15, nullptr, 10) * 1024;
+        }
+    }
+#endif
+    return 0;
+}
+
+bool RandomX_GetVMPlacement(randomx_vm* vm, RandomXVMPlacement& placement)
+{
+    if (!vm || !vm->getScratchpad()) return false;
+    const void* scratchpad = vm->getScratchpad();
+
+    placement.requested_node = rx_node_id;
+    placement.node = -1;
+#ifdef HAVE_NUMA
+    int node = -1;
+    if (numa_available() != -1 &&
+        get_mempolicy(&node, nullptr, 0, const_cast<void*>(scratchpad), MPOL_F_NODE | MPOL_F_ADDR) == 0) {
+        placement.node = node;
+    }
+#endif
+    placement.page_size = PageSizeOf(scratchpad);
+    return true;
 }
 
 // Hash with a specific seed
@@ -569,6 +1302,40 @@ bool RandomX_Hash_WithSeed(const void* seedhash, size_t seedhashSize,
     return true;
 }
 
+// Hash several same-size inputs with a specific seed
+bool RandomX_HashBatch(const void* seedhash, size_t seedhashSize,
+                       const void* inputs, size_t inputSize, size_t count, uint256* outputs)
+{
+    if (!seedhash || seedhashSize != 32 || !inputs || !outputs) {
+        return false;
+    }
+    if (count == 0) return true;
+
+    if (rx_shutting_down) {
+        return false;
+    }
+
+    uint256 seed;
+    memcpy(seed.begin(), seedhash, 32);
+
+    randomx_vm* vm = GetVM(seed);
+    if (!vm) return false;
+
+    const unsigned char* input = static_cast<const unsigned char*>(inputs);
+    if (count == 1) {
+        randomx_calculate_hash(vm, input, inputSize, outputs[0].begin());
+        return true;
+    }
+
+    // Pipeline: finishing each hash also starts the next one
+    randomx_calculate_hash_first(vm, input, inputSize);
+    for (size_t i = 1; i < count; i++) {
+        randomx_calculate_hash_next(vm, input + i * inputSize, inputSize, outputs[i - 1].begin());
+    }
+    randomx_calculate_hash_last(vm, outputs[count - 1].begin());
+    return true;
+}
+
 // Get thread-local VM for a specific seed
 randomx_vm* RandomX_GetVM(const void* seedhash, size_t seedhashSize)
 {
@@ -580,6 +1347,35 @@ randomx_vm* RandomX_GetVM(const void* seedhash, size_t seedhashSize)
     return GetVM(seed);
 }
 
+// Get several thread-local VMs for a specific seed
+size_t RandomX_GetVMs(const void* seedhash, size_t seedhashSize, randomx_vm** vms, size_t count)
+{
+    if (!vms || count == 0) return 0;
+
+    vms[0] = RandomX_GetVM(seedhash, seedhashSize);
+    if (!vms[0]) return 0;
+
+    // GetVM left this thread's VM for the seed in the fast-path slot
+    ThreadVM* tvm = rxVM_thread.last;
+    while (tvm->extra_vms.size() < count - 1) {
+        bool use_fast = tvm->is_fast;
+        randomx_vm* vm = CreateVM(*tvm->cache_entry, tvm->dataset_entry.get(), use_fast);
+        if (vm && use_fast != tvm->is_fast) {
+            // All ways of a thread must hash at the same speed
+            randomx_destroy_vm(vm);
+            vm = nullptr;
+        }
+        if (!vm) break;
+        tvm->extra_vms.push_back(vm);
+    }
+
+    size_t n = 1;
+    for (; n < count && n - 1 < tvm->extra_vms.size(); n++) {
+        vms[n] = tvm->extra_vms[n - 1];
+    }
+    return n;
+}
+
 bool RandomX_HashFirst(randomx_vm* vm, const void* input, size_t inputSize)
 {
     if (!vm || !input) return false;
@@ -664,14 +1460,43 @@ void RandomX_SetScratchpadPrefetchMode(RandomX_ScratchpadPrefetchMode mode)
         return;
     }
 
-    // Note: Standard RandomX library doesn't expose scratchpad prefetch mode API
-    // Prefetching is handled internally by the RandomX implementation
-    // This function is kept for future compatibility if we integrate xmrig's RandomX fork
+    // The JIT patches the prefetch instructions of each program it compiles,
+    // so running VMs pick this up from their next hash
     rx_prefetch_mode = mode;
+    randomx_set_scratchpad_prefetch_mode(static_cast<int>(mode));
 
-    const char* mode_names[] = { "off", "t0", "nta", "mov" };
-    LogPrintf("RandomX: Scratchpad prefetch mode (API not available): %s\n", mode_names[mode]);
-    LogPrintf("RandomX: Note - Prefetching is handled internally by RandomX library\n");
+    if (RandomX_ScratchpadPrefetchModeSupported()) {
+        LogPrint("pow", "RandomX: Scratchpad prefetch mode: %s\n", RandomX_ScratchpadPrefetchModeName(mode));
+    } else {
+        LogPrintf("RandomX: Scratchpad prefetch mode %s has no effect on this platform\n", RandomX_ScratchpadPrefetchModeName(mode));
+    }
+}
+
+bool RandomX_ScratchpadPrefetchModeSupported()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* RandomX_ScratchpadPrefetchModeName(RandomX_ScratchpadPrefetchMode mode)
+{
+    static const char* mode_names[] = { "off", "t0", "nta", "mov" };
+    if (mode < 0 || mode >= RANDOMX_PREFETCH_MAX) return "unknown";
+    return mode_names[mode];
+}
+
+bool RandomX_ParseScratchpadPrefetchMode(const std::string& name, RandomX_ScratchpadPrefetchMode& mode)
+{
+    for (int m = 0; m < RANDOMX_PREFETCH_MAX; m++) {
+        if (name == RandomX_ScratchpadPrefetchModeName(static_cast<RandomX_ScratchpadPrefetchMode>(m))) {
+            mode = static_cast<RandomX_ScratchpadPrefetchMode>(m);
+            return true;
+        }
+    }
+    return false;
 }
 
 RandomX_ScratchpadPrefetchMode RandomX_GetScratchpadPrefetchMode()
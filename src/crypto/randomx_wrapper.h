@@ -6,11 +6,14 @@
 #define BITCOIN_CRYPTO_RANDOMX_WRAPPER_H
 
 #include "uint256.h"
+#include <string>
 #include <vector>
 #include <cstddef>
 
 // Forward declaration
 struct randomx_vm;
+struct randomx_cache;
+struct randomx_dataset;
 
 /**
  * RandomX wrapper for Juno Cash
@@ -22,6 +25,8 @@ struct randomx_vm;
 // RandomX epoch configuration
 static const uint64_t RANDOMX_SEEDHASH_EPOCH_BLOCKS = 2048;  // Power of 2 for efficient bitmask operations
 static const uint64_t RANDOMX_SEEDHASH_EPOCH_LAG = 96;
+// Confirmations the next epoch's seed block needs before its cache/dataset is prebuilt
+static const uint64_t RANDOMX_SEEDHASH_PREBUILD_DEPTH = 6;
 
 /**
  * Calculate the seed height for a given block height.
@@ -42,6 +47,24 @@ uint64_t RandomX_SeedHeight(uint64_t height);
  */
 void RandomX_SetMainSeedHash(const void* seedhash, size_t size);
 
+/**
+ * Get the main seed hash set by RandomX_Init or RandomX_SetMainSeedHash.
+ *
+ * @return The main seed hash, or null if none is set
+ */
+uint256 RandomX_GetMainSeedHash();
+
+/**
+ * Build the cache (and in fast mode, the dataset on each NUMA node that has
+ * one for the main seed) for an upcoming seed on a background thread, so the
+ * switch at the epoch boundary does not stall hashing. Repeated calls with
+ * the same seed are ignored.
+ *
+ * @param seedhash Pointer to seed hash (32 bytes)
+ * @param size Size of seed hash
+ */
+void RandomX_PrepareSeedHash(const void* seedhash, size_t size);
+
 /**
  * Get thread-local VM for a specific seed.
  * This allows avoiding repeated lookups/locks in tight loops.
@@ -52,6 +75,38 @@ void RandomX_SetMainSeedHash(const void* seedhash, size_t size);
  */
 randomx_vm* RandomX_GetVM(const void* seedhash, size_t seedhashSize);
 
+/**
+ * Get several thread-local VMs for a specific seed, for miners that keep
+ * more than one hash in flight per thread. vms[0] is the VM returned by
+ * RandomX_GetVM; the others share its cache or dataset and stay owned by
+ * the calling thread like it.
+ *
+ * @param seedhash Pointer to seed hash (32 bytes)
+ * @param seedhashSize Size of seed hash
+ * @param vms Output array of at least count VMs
+ * @param count Number of VMs wanted
+ * @return Number of VMs stored in vms (may be fewer than count if creating
+ *         more failed), or 0 on error
+ */
+size_t RandomX_GetVMs(const void* seedhash, size_t seedhashSize, randomx_vm** vms, size_t count);
+
+/** Where a VM's scratchpad memory was placed */
+struct RandomXVMPlacement {
+    int requested_node;  //!< NUMA node set with RandomX_SetCurrentNode, -1 if none
+    int node;            //!< NUMA node holding the scratchpad, -1 if unknown
+    size_t page_size;    //!< Size of the pages backing the scratchpad in bytes, 0 if unknown
+};
+
+/**
+ * Look up where the calling thread's VM keeps its scratchpad, so that a
+ * silent fallback to normal pages or remote memory can be reported.
+ *
+ * @param vm VM returned by RandomX_GetVM or RandomX_GetVMs on this thread
+ * @param placement Filled in on success
+ * @return true if successful, false otherwise
+ */
+bool RandomX_GetVMPlacement(randomx_vm* vm, RandomXVMPlacement& placement);
+
 /**
  * Calculate a RandomX hash with a specific seed.
  *
@@ -65,6 +120,22 @@ randomx_vm* RandomX_GetVM(const void* seedhash, size_t seedhashSize);
 bool RandomX_Hash_WithSeed(const void* seedhash, size_t seedhashSize,
                            const void* input, size_t inputSize, void* output);
 
+/**
+ * Calculate the RandomX hashes of several inputs with the same seed, using
+ * one VM lookup and pipelining the hashes through it. Produces the same
+ * results as calling RandomX_Hash_WithSeed on each input.
+ *
+ * @param seedhash Pointer to seed hash (32 bytes)
+ * @param seedhashSize Size of seed hash
+ * @param inputs Pointer to count inputs of inputSize bytes each, back to back
+ * @param inputSize Size of each input in bytes
+ * @param count Number of inputs
+ * @param outputs Array of count hashes to fill
+ * @return true if successful, false otherwise
+ */
+bool RandomX_HashBatch(const void* seedhash, size_t seedhashSize,
+                       const void* inputs, size_t inputSize, size_t count, uint256* outputs);
+
 /**
  * Calculate a RandomX hash (uses current main seed).
  *
@@ -114,6 +185,14 @@ bool RandomX_Verify_WithSeed(const void* seedhash, size_t seedhashSize,
  */
 bool RandomX_Verify(const void* input, size_t inputSize, const uint256& expectedHash);
 
+/**
+ * Initialize a dataset from an initialized cache, splitting the items over
+ * numThreads threads. Exposed so the dataset build can be benchmarked.
+ *
+ * @return false if initialization was abandoned because RandomX is shutting down
+ */
+bool RandomX_InitDatasetParallel(randomx_dataset* dataset, randomx_cache* cache, int numThreads);
+
 /**
  * Initialize RandomX (call once at startup).
  * This prepares the RandomX cache and VM.
@@ -129,6 +208,62 @@ void RandomX_SetCurrentNode(int node);
 
 void RandomX_Init(bool fastMode = false, bool useHugePages = false);
 
+/** Lock-free snapshot of the RandomX memory in use */
+struct RandomXMemoryStats {
+    int caches;                     //!< Allocated caches (256MB each)
+    int datasets;                   //!< Initialized datasets (2GB each), over all NUMA nodes
+    int datasets_building;          //!< Datasets being initialized right now
+    int64_t last_dataset_build_ms;  //!< Duration of the last dataset build, 0 if none
+    int memory_level;               //!< Current RandomXMemoryLevel
+    int memory_level_changes;       //!< Steps taken by RandomX_CheckMemoryPressure
+};
+
+/**
+ * Get the number of caches and datasets allocated, including evicted ones
+ * still held by VMs. Safe to call from any thread without taking locks.
+ */
+RandomXMemoryStats RandomX_GetMemoryStats();
+
+/** Memory held by a cache or a dataset kept for a seed */
+struct RandomXSeedMemory {
+    uint256 seedhash;
+    bool dataset;   //!< A dataset rather than a cache
+    int node;       //!< NUMA node of a dataset, -1 for a cache or if not bound to a node
+    size_t bytes;
+};
+
+/**
+ * List the caches and datasets kept for each seed. Evicted ones that VMs
+ * still hold are only counted by RandomX_GetMemoryStats.
+ */
+std::vector<RandomXSeedMemory> RandomX_GetSeedMemory();
+
+/** How far fast mode has been scaled back because the host is short of memory */
+enum RandomXMemoryLevel {
+    RANDOMX_MEMORY_FULL = 0,     //!< As configured
+    RANDOMX_MEMORY_ONE_DATASET,  //!< One dataset shared by all NUMA nodes
+    RANDOMX_MEMORY_LIGHT,        //!< Light mode, although fast mode was asked for
+};
+
+// Default for -randomxmemoryreserve, in MiB
+static const int64_t DEFAULT_RANDOMX_MEMORY_RESERVE = 512;
+// Seconds between RandomX_CheckMemoryPressure calls
+static const int64_t RANDOMX_MEMORY_CHECK_INTERVAL = 10;
+
+/**
+ * Compare the memory still available to the process (MemAvailable from
+ * /proc/meminfo, and the headroom under its cgroup's limit) with nReserve
+ * bytes and take at most one step: down when less is available, dropping
+ * the datasets on all but one NUMA node before falling back to light mode,
+ * or back up once the datasets of the step fit with nReserve to spare.
+ * Only acts when fast mode was asked for; RandomX_ChangeMode resets the
+ * level. Each step is logged.
+ */
+void RandomX_CheckMemoryPressure(int64_t nReserve);
+
+/** Get the name of a memory level ("full", "onedataset" or "light"). */
+const char* RandomX_MemoryLevelName(RandomXMemoryLevel level);
+
 /**
  * Check if RandomX is running in fast mode.
  * @return true if using full dataset, false if using light mode.
@@ -169,8 +304,9 @@ enum RandomX_ScratchpadPrefetchMode {
 
 /**
  * Set scratchpad prefetch mode for RandomX.
- * Should be called before mining starts or after RandomX_Init().
- * Different modes work better on different CPUs.
+ * Can be changed while mining; each VM uses the new mode from its next hash.
+ * Different modes work better on different CPUs; the miner can pick one
+ * automatically (-randomxprefetch=auto).
  *
  * @param mode Prefetch mode to use (default: RANDOMX_PREFETCH_T0)
  */
@@ -182,4 +318,15 @@ void RandomX_SetScratchpadPrefetchMode(RandomX_ScratchpadPrefetchMode mode);
  */
 RandomX_ScratchpadPrefetchMode RandomX_GetScratchpadPrefetchMode();
 
+/**
+ * Check whether the scratchpad prefetch mode has any effect (x86-64 JIT only).
+ */
+bool RandomX_ScratchpadPrefetchModeSupported();
+
+/** Get the name of a prefetch mode ("off", "t0", "nta" or "mov"). */
+const char* RandomX_ScratchpadPrefetchModeName(RandomX_ScratchpadPrefetchMode mode);
+
+/** Parse a prefetch mode name as returned by RandomX_ScratchpadPrefetchModeName. */
+bool RandomX_ParseScratchpadPrefetchMode(const std::string& name, RandomX_ScratchpadPrefetchMode& mode);
+
 #endif // BITCOIN_CRYPTO_RANDOMX_WRAPPER_H
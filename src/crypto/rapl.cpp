@@ -0,0 +1,149 @@
+// Copyright (c) 2025 Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/rapl.h"
+#include "crypto/msr.h"
+#include "util/system.h"
+
+#include <fstream>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+// Intel RAPL MSRs
+static const uint32_t MSR_RAPL_POWER_UNIT = 0x606;
+static const uint32_t MSR_PKG_ENERGY_STATUS = 0x611;
+// AMD equivalents (family 17h and later)
+static const uint32_t MSR_AMD_RAPL_POWER_UNIT = 0xC0010299;
+static const uint32_t MSR_AMD_PKG_ENERGY_STATUS = 0xC001029B;
+
+static bool ReadUInt64File(const std::string& path, uint64_t& value)
+{
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+
+CpuEnergyMeter::CpuEnergyMeter()
+{
+    FindPowercapCounters();
+    if (m_counters.empty()) {
+        FindMsrCounters();
+    }
+    for (Counter& counter : m_counters) {
+        ReadRaw(counter, counter.last);
+    }
+    LogPrint("msr", "RAPL: %u package energy counter(s) via %s\n", m_counters.size(), m_source);
+}
+
+void CpuEnergyMeter::FindPowercapCounters()
+{
+#ifdef __linux__
+    const std::string root = "/sys/class/powercap/";
+    DIR* dir = opendir(root.c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        // Package zones are "intel-rapl:<n>"; their subzones (core, dram) have a second colon
+        std::string name = entry->d_name;
+        if (name.compare(0, 11, "intel-rapl:") != 0 || name.find(':', 11) != std::string::npos) {
+            continue;
+        }
+        std::string zone = root + name + "/";
+        std::string zoneName;
+        std::ifstream nameFile(zone + "name");
+        if (!(nameFile >> zoneName) || zoneName.compare(0, 7, "package") != 0) {
+            continue;
+        }
+        Counter counter;
+        counter.path = zone + "energy_uj";
+        counter.unit = 1e-6;
+        uint64_t nMax, nValue;
+        if (!ReadUInt64File(zone + "max_energy_range_uj", nMax) || !ReadUInt64File(counter.path, nValue)) {
+            continue;
+        }
+        counter.range = nMax + 1;
+        m_counters.push_back(counter);
+    }
+    closedir(dir);
+    if (!m_counters.empty()) {
+        m_source = "powercap";
+    }
+#endif
+}
+
+void CpuEnergyMeter::FindMsrCounters()
+{
+#ifdef __linux__
+    // One CPU of each package
+    std::set<uint64_t> packages;
+    std::vector<int32_t> cpus;
+    int nCPUs = std::thread::hardware_concurrency();
+    for (int cpu = 0; cpu < nCPUs; cpu++) {
+        uint64_t package = 0;
+        ReadUInt64File(strprintf("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu), package);
+        if (packages.insert(package).second) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    std::shared_ptr<Msr> msr = Msr::get();
+    for (int32_t cpu : cpus) {
+        Counter counter;
+        counter.cpu = cpu;
+        MsrItem unit = msr->read(MSR_RAPL_POWER_UNIT, cpu, false);
+        counter.reg = MSR_PKG_ENERGY_STATUS;
+        if (!unit.isValid()) {
+            unit = msr->read(MSR_AMD_RAPL_POWER_UNIT, cpu, false);
+            counter.reg = MSR_AMD_PKG_ENERGY_STATUS;
+        }
+        if (!unit.isValid()) {
+            continue;
+        }
+        // Energy status unit: 1 / 2^ESU joules, ESU in bits 12:8
+        counter.unit = 1.0 / (uint64_t{1} << ((unit.value() >> 8) & 0x1f));
+        counter.range = uint64_t{1} << 32;
+        m_counters.push_back(counter);
+    }
+    if (!m_counters.empty()) {
+        m_source = "msr";
+    }
+#endif
+}
+
+bool CpuEnergyMeter::ReadRaw(const Counter& counter, uint64_t& value) const
+{
+    if (!counter.path.empty()) {
+        return ReadUInt64File(counter.path, value);
+    }
+    MsrItem item = Msr::get()->read(counter.reg, counter.cpu, false);
+    if (!item.isValid()) {
+        return false;
+    }
+    value = item.value() & 0xffffffff;
+    return true;
+}
+
+double CpuEnergyMeter::Read()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_counters.empty()) {
+        return -1;
+    }
+    double total = 0;
+    for (Counter& counter : m_counters) {
+        uint64_t value;
+        if (ReadRaw(counter, value)) {
+            // At most one wrap since the previous read
+            uint64_t delta = value >= counter.last ? value - counter.last : counter.range - counter.last + value;
+            counter.joules += delta * counter.unit;
+            counter.last = value;
+        }
+        total += counter.joules;
+    }
+    return total;
+}
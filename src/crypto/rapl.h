@@ -0,0 +1,55 @@
+// Copyright (c) 2025 Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_RAPL_H
+#define BITCOIN_CRYPTO_RAPL_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Energy used by the CPU packages, from their RAPL (Running Average Power
+ * Limit) counters. The powercap sysfs interface is used where the kernel
+ * provides it (Intel, and AMD since Linux 5.8); otherwise the package energy
+ * MSRs are read through Msr. Both usually need root.
+ *
+ * The hardware counters wrap after a few minutes at full load, so Read must
+ * be called more often than that for the total to stay correct.
+ */
+class CpuEnergyMeter
+{
+public:
+    CpuEnergyMeter();
+
+    bool IsAvailable() const { return !m_counters.empty(); }
+
+    /** "powercap", "msr" or "none" */
+    const char* Source() const { return m_source; }
+
+    /** Joules used by all packages since the meter was created, or -1 if unavailable */
+    double Read();
+
+private:
+    struct Counter {
+        std::string path;     //!< powercap energy_uj file, empty for an MSR
+        int32_t cpu = -1;     //!< CPU whose package MSR is read
+        uint32_t reg = 0;     //!< Energy status MSR
+        uint64_t range = 0;   //!< Raw value at which the counter wraps
+        double unit = 0;      //!< Joules per raw count
+        uint64_t last = 0;    //!< Previous raw value
+        double joules = 0;    //!< Accumulated since the meter was created
+    };
+
+    bool ReadRaw(const Counter& counter, uint64_t& value) const;
+    void FindPowercapCounters();
+    void FindMsrCounters();
+
+    std::mutex m_mutex;
+    std::vector<Counter> m_counters;
+    const char* m_source = "none";
+};
+
+#endif // BITCOIN_CRYPTO_RAPL_H
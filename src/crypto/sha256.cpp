@@ -6,10 +6,12 @@
 #include "crypto/sha256.h"
 #include "crypto/common.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <stdexcept>
 #include <atomic>
+#include <vector>
 
 #if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
 #if defined(USE_ASM)
@@ -24,11 +26,13 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+void TransformMulti_4way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+void TransformMulti_8way(uint32_t* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_shani
@@ -418,6 +422,8 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+/** Transform N states (8 words each, one after the other) by one chunk each. */
+typedef void (*TransformMultiType)(uint32_t*, const unsigned char* const*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -463,6 +469,8 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti_4way = nullptr;
+TransformMultiType TransformMulti_8way = nullptr;
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -546,6 +554,23 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test the multi-lane transforms: lane i continues from the state after
+    // i chunks with chunk i, which must give the state after i + 1 chunks.
+    for (TransformMultiType tr : {TransformMulti_4way, TransformMulti_8way}) {
+        if (!tr) continue;
+        uint32_t states[8 * 8];
+        const unsigned char* chunks[8];
+        for (size_t i = 0; i < 8; ++i) {
+            std::copy(result[i], result[i] + 8, states + 8 * i);
+            chunks[i] = data + 1 + 64 * i;
+        }
+        tr(states, chunks);
+        size_t lanes = tr == TransformMulti_8way ? 8 : 4;
+        for (size_t i = 0; i < lanes; ++i) {
+            if (!std::equal(states + 8 * i, states + 8 * i + 8, result[i + 1])) return false;
+        }
+    }
+
     return true;
 }
 
@@ -624,6 +649,7 @@ std::string SHA256AutoDetect()
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti_4way = sha256d64_sse41::TransformMulti_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -631,6 +657,7 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti_8way = sha256d64_avx2::TransformMulti_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -739,3 +766,101 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+namespace {
+
+/** Double-SHA256 up to lanes messages side by side with a multi-lane transform. */
+void SHA256DLanes(TransformMultiType tr, size_t lanes, unsigned char* const* out,
+                  const unsigned char* const* in, const size_t* len, size_t count)
+{
+    static const unsigned char idle[64] = {0};
+    uint32_t states[8 * 8];
+    uint32_t first[8][8];
+    unsigned char tails[8][128];
+    size_t nFull[8], nBlocks[8];
+    size_t nMaxBlocks = 0;
+    for (size_t i = 0; i < lanes; ++i) {
+        sha256::Initialize(states + 8 * i);
+        nFull[i] = nBlocks[i] = 0;
+        if (i >= count) continue;
+        // The last partial chunk, the padding and the length go in one or two tail chunks.
+        nFull[i] = len[i] / 64;
+        size_t rem = len[i] % 64;
+        size_t nTail = rem + 9 <= 64 ? 1 : 2;
+        memset(tails[i], 0, sizeof(tails[i]));
+        memcpy(tails[i], in[i] + 64 * nFull[i], rem);
+        tails[i][rem] = 0x80;
+        WriteBE64(tails[i] + 64 * nTail - 8, ((uint64_t)len[i]) << 3);
+        nBlocks[i] = nFull[i] + nTail;
+        nMaxBlocks = std::max(nMaxBlocks, nBlocks[i]);
+    }
+
+    // Lanes that have run out of chunks keep going on an idle chunk, their
+    // first hash having been saved when they finished.
+    const unsigned char* chunks[8];
+    for (size_t b = 0; b < nMaxBlocks; ++b) {
+        for (size_t i = 0; i < lanes; ++i) {
+            if (b < nFull[i]) {
+                chunks[i] = in[i] + 64 * b;
+            } else if (b < nBlocks[i]) {
+                chunks[i] = tails[i] + 64 * (b - nFull[i]);
+            } else {
+                chunks[i] = idle;
+            }
+        }
+        tr(states, chunks);
+        for (size_t i = 0; i < count; ++i) {
+            if (b + 1 == nBlocks[i]) std::copy(states + 8 * i, states + 8 * i + 8, first[i]);
+        }
+    }
+
+    // The second hash is of the 32-byte first hash, which is one chunk.
+    for (size_t i = 0; i < lanes; ++i) {
+        sha256::Initialize(states + 8 * i);
+        memset(tails[i], 0, 64);
+        if (i < count) {
+            for (int j = 0; j < 8; ++j) WriteBE32(tails[i] + 4 * j, first[i][j]);
+        }
+        tails[i][32] = 0x80;
+        tails[i][62] = 0x01;
+        chunks[i] = tails[i];
+    }
+    tr(states, chunks);
+    for (size_t i = 0; i < count; ++i) {
+        for (int j = 0; j < 8; ++j) WriteBE32(out[i] + 4 * j, states[8 * i + j]);
+    }
+}
+
+} // namespace
+
+void SHA256DMulti(unsigned char* output, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    TransformMultiType tr = TransformMulti_8way ? TransformMulti_8way : TransformMulti_4way;
+    size_t lanes = TransformMulti_8way ? 8 : 4;
+    if (!tr || count < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char first[CSHA256::OUTPUT_SIZE];
+            CSHA256().Write(inputs[i], lengths[i]).Finalize(first);
+            CSHA256().Write(first, sizeof(first)).Finalize(output + 32 * i);
+        }
+        return;
+    }
+
+    // Messages of similar length share a group, so that few lanes sit idle.
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return lengths[a] < lengths[b]; });
+
+    for (size_t pos = 0; pos < count; pos += lanes) {
+        size_t n = std::min(lanes, count - pos);
+        unsigned char* out[8];
+        const unsigned char* in[8];
+        size_t len[8];
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = output + 32 * order[pos + i];
+            in[i] = inputs[order[pos + i]];
+            len[i] = lengths[order[pos + i]];
+        }
+        SHA256DLanes(tr, lanes, out, in, len, n);
+    }
+}
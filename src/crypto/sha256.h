@@ -43,4 +43,12 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute the double-SHA256's of count messages of any length, side by
+ *  side in SIMD lanes where the CPU has them.
+ *  output:  pointer to a count*32 byte output buffer
+ *  inputs:  pointers to the messages
+ *  lengths: the length in bytes of each message
+ */
+void SHA256DMulti(unsigned char* output, const unsigned char* const* inputs, const size_t* lengths, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
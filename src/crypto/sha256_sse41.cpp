@@ -59,6 +59,28 @@ void inline Write4(unsigned char* out, int offset, __m128i v) {
     WriteLE32(out + 96 + offset, _mm_extract_epi32(v, 0));
 }
 
+/** The SHA-256 round constants, for the transform of arbitrary states. */
+const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul
+};
+
+/** The words at offset in each of the 4 lanes' chunks, read big endian. */
+__m128i inline ReadMulti(const unsigned char* const* chunks, int offset) {
+    return _mm_set_epi32(
+        ReadBE32(chunks[0] + offset),
+        ReadBE32(chunks[1] + offset),
+        ReadBE32(chunks[2] + offset),
+        ReadBE32(chunks[3] + offset)
+    );
+}
+
 }
 
 void Transform_4way(unsigned char* out, const unsigned char* in)
@@ -312,6 +334,37 @@ void Transform_4way(unsigned char* out, const unsigned char* in)
     Write4(out, 28, Add(h, K(0x5be0cd19ul)));
 }
 
+void TransformMulti_4way(uint32_t* s, const unsigned char* const* chunks)
+{
+    __m128i v[8];
+    for (int i = 0; i < 8; ++i) {
+        v[i] = _mm_set_epi32(s[0 + i], s[8 + i], s[16 + i], s[24 + i]);
+    }
+    __m128i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+
+    __m128i w[16];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = ReadMulti(chunks, 4 * i);
+    }
+    for (int i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            Inc(w[i & 15], sigma1(w[(i + 14) & 15]), w[(i + 9) & 15], sigma0(w[(i + 1) & 15]));
+        }
+        Round(a, b, c, d, e, f, g, h, Add(K(ROUND_CONSTANTS[i]), w[i & 15]));
+        __m128i t = h;
+        h = g; g = f; f = e; e = d; d = c; c = b; b = a; a = t;
+    }
+
+    v[0] = Add(v[0], a); v[1] = Add(v[1], b); v[2] = Add(v[2], c); v[3] = Add(v[3], d);
+    v[4] = Add(v[4], e); v[5] = Add(v[5], f); v[6] = Add(v[6], g); v[7] = Add(v[7], h);
+    for (int i = 0; i < 8; ++i) {
+        s[0 + i] = _mm_extract_epi32(v[i], 3);
+        s[8 + i] = _mm_extract_epi32(v[i], 2);
+        s[16 + i] = _mm_extract_epi32(v[i], 1);
+        s[24 + i] = _mm_extract_epi32(v[i], 0);
+    }
+}
+
 }
 
 #endif
@@ -16,31 +16,99 @@
 
 #include <boost/scoped_ptr.hpp>
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+#include <mutex>
+#include <set>
+
+static CDBTuning defaultTuning;
+
+void SetDefaultDBTuning(const CDBTuning& tuning)
+{
+    defaultTuning = tuning;
+}
+
+const CDBTuning& DefaultDBTuning()
+{
+    return defaultTuning;
+}
+
+//! Open databases, for GetAllStats.
+static std::mutex csOpenDatabases;
+static std::set<const CDBWrapper*> setOpenDatabases;
+
+//! Table reads made by this thread, so a lookup can tell whether it read a table.
+static thread_local uint64_t nThreadTableReads = 0;
+
+namespace {
+
+/** Table file that counts its reads */
+class CountingRandomAccessFile : public leveldb::RandomAccessFile
+{
+private:
+    leveldb::RandomAccessFile* target;
+    std::atomic<uint64_t>& nReads;
+
+public:
+    CountingRandomAccessFile(leveldb::RandomAccessFile* targetIn, std::atomic<uint64_t>& nReadsIn) : target(targetIn), nReads(nReadsIn) {}
+    ~CountingRandomAccessFile() { delete target; }
+
+    leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const override
+    {
+        nReads++;
+        nThreadTableReads++;
+        return target->Read(offset, n, result, scratch);
+    }
+
+    std::string GetName() const override { return target->GetName(); }
+};
+
+/** Environment whose random-access files (leveldb only reads tables that way) count their reads */
+class CountingEnv : public leveldb::EnvWrapper
+{
+private:
+    std::atomic<uint64_t>& nReads;
+
+public:
+    CountingEnv(leveldb::Env* target, std::atomic<uint64_t>& nReadsIn) : leveldb::EnvWrapper(target), nReads(nReadsIn) {}
+
+    leveldb::Status NewRandomAccessFile(const std::string& fname, leveldb::RandomAccessFile** result) override
+    {
+        leveldb::Status status = target()->NewRandomAccessFile(fname, result);
+        if (status.ok()) {
+            *result = new CountingRandomAccessFile(*result, nReads);
+        }
+        return status;
+    }
+};
+
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBTuning& tuning)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.filter_policy = tuning.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(tuning.nBloomBits) : NULL;
+    options.block_size = tuning.nBlockSize;
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.max_open_files = tuning.nMaxOpenFiles;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
-    options.max_file_size = std::max(options.max_file_size, DBWRAPPER_MAX_FILE_SIZE);
+    options.max_file_size = std::max(options.max_file_size, tuning.nMaxFileSize);
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, const CDBTuning& tuning)
 {
     penv = NULL;
+    name = path.filename().string();
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -54,23 +122,73 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         TryCreateDirectory(path);
         LogPrintf("Opening LevelDB in %s\n", path.string());
     }
+    pstatsenv = new CountingEnv(penv ? penv : leveldb::Env::Default(), nTableReads);
+    options.env = pstatsenv;
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
+    std::lock_guard<std::mutex> lock(csOpenDatabases);
+    setOpenDatabases.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(csOpenDatabases);
+        setOpenDatabases.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
     options.filter_policy = NULL;
     delete options.block_cache;
     options.block_cache = NULL;
+    delete pstatsenv;
+    pstatsenv = NULL;
     delete penv;
     options.env = NULL;
 }
 
+std::string& CDBWrapper::ReadBuffer()
+{
+    static thread_local std::string buffer;
+    return buffer;
+}
+
+leveldb::Status CDBWrapper::Get(const leveldb::Slice& key, std::string* value) const
+{
+    uint64_t nTableReadsBefore = nThreadTableReads;
+    leveldb::Status status = pdb->Get(readoptions, key, value);
+    nLookups++;
+    if (status.IsNotFound()) {
+        nMisses++;
+        if (nThreadTableReads != nTableReadsBefore) {
+            nMissesReadingTables++;
+        }
+    }
+    return status;
+}
+
+CDBStats CDBWrapper::GetStats() const
+{
+    CDBStats stats;
+    stats.nLookups = nLookups;
+    stats.nMisses = nMisses;
+    stats.nMissesReadingTables = nMissesReadingTables;
+    stats.nTableReads = nTableReads;
+    return stats;
+}
+
+std::vector<std::pair<std::string, CDBStats>> CDBWrapper::GetAllStats()
+{
+    std::lock_guard<std::mutex> lock(csOpenDatabases);
+    std::vector<std::pair<std::string, CDBStats>> vStats;
+    for (const CDBWrapper* pdbw : setOpenDatabases) {
+        vStats.emplace_back(pdbw->name, pdbw->GetStats());
+    }
+    return vStats;
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
@@ -88,7 +206,9 @@ bool CDBWrapper::IsEmpty()
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
@@ -13,12 +13,55 @@
 #include "util/system.h"
 #include "version.h"
 
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 static const size_t DBWRAPPER_MAX_FILE_SIZE = 32 << 20; // 32 MiB
+//! -dbbloombits default
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+//! -dbmaxopenfiles default
+static const int DEFAULT_DB_MAX_OPEN_FILES = 64;
+//! -dbblocksize default (leveldb's own default)
+static const size_t DEFAULT_DB_BLOCK_SIZE = 4096;
+
+/** LevelDB settings that may differ between databases with different access patterns */
+struct CDBTuning
+{
+    //! Bits per key of the bloom filter kept for each table, or 0 for no filter
+    int nBloomBits = DEFAULT_DB_BLOOM_BITS;
+    //! Maximum number of table files kept open
+    int nMaxOpenFiles = DEFAULT_DB_MAX_OPEN_FILES;
+    //! Approximate size of the uncompressed data in each table block
+    size_t nBlockSize = DEFAULT_DB_BLOCK_SIZE;
+    //! Target table file size; larger files mean fewer, larger compactions
+    size_t nMaxFileSize = DBWRAPPER_MAX_FILE_SIZE;
+};
+
+/** Set the tuning that databases are opened with unless they override it (from -dbbloombits etc.) */
+void SetDefaultDBTuning(const CDBTuning& tuning);
+const CDBTuning& DefaultDBTuning();
+
+/** Lookup counters of a database, for tuning its bloom filters and cache */
+struct CDBStats
+{
+    //! Reads and existence checks
+    uint64_t nLookups = 0;
+    //! Lookups of keys that are not in the database
+    uint64_t nMisses = 0;
+    //! Misses that still read a block from a table file. The bloom filters
+    //! are there to avoid these; those that remain are false positives or
+    //! filter blocks that were not cached.
+    uint64_t nMissesReadingTables = 0;
+    //! Blocks read from table files, by lookups, iterators and compactions
+    uint64_t nTableReads = 0;
+};
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -101,6 +144,8 @@ public:
 
     void SeekToFirst();
 
+    void SeekToLast();
+
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(GetSerializeSize(ssKey, key));
@@ -111,10 +156,12 @@ public:
 
     void Next();
 
+    void Prev();
+
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            CSpanReader ssKey(SER_DISK, CLIENT_VERSION, slKey.data(), slKey.data() + slKey.size());
             ssKey >> key;
         } catch(std::exception &e) {
             return false;
@@ -125,7 +172,7 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CSpanReader ssValue(SER_DISK, CLIENT_VERSION, slValue.data(), slValue.data() + slValue.size());
             ssValue >> value;
         } catch(std::exception &e) {
             return false;
@@ -137,6 +184,16 @@ public:
         return piter->value().size();
     }
 
+    //! The key and value as stored, for copying records verbatim.
+    void GetRawKey(std::vector<unsigned char>& key) {
+        leveldb::Slice slKey = piter->key();
+        key.assign(slKey.data(), slKey.data() + slKey.size());
+    }
+    void GetRawValue(std::vector<unsigned char>& value) {
+        leveldb::Slice slValue = piter->value();
+        value.assign(slValue.data(), slValue.data() + slValue.size());
+    }
+
 };
 
 class CDBWrapper
@@ -145,6 +202,17 @@ private:
     //! custom environment this database is using (may be NULL in case of default environment)
     leveldb::Env* penv;
 
+    //! environment wrapping penv (or the default one) to count table reads
+    leveldb::Env* pstatsenv;
+
+    //! name reported with the statistics
+    std::string name;
+
+    mutable std::atomic<uint64_t> nLookups{0};
+    mutable std::atomic<uint64_t> nMisses{0};
+    mutable std::atomic<uint64_t> nMissesReadingTables{0};
+    std::atomic<uint64_t> nTableReads{0};
+
     //! database options used
     leveldb::Options options;
 
@@ -163,14 +231,21 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! Look a key up, counting it in the statistics.
+    leveldb::Status Get(const leveldb::Slice& key, std::string* value) const;
+
+    //! Per-thread buffer that Read() fetches values into.
+    static std::string& ReadBuffer();
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
      * @param[in] nCacheSize  Configures various leveldb cache settings.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
+     * @param[in] tuning      Bloom filter, open file, block size and compaction settings.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBTuning& tuning = DefaultDBTuning());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -181,8 +256,10 @@ public:
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        // leveldb always copies the value out; reuse this thread's buffer for
+        // it and deserialize in place rather than copying it again.
+        std::string& strValue = ReadBuffer();
+        leveldb::Status status = Get(slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -190,7 +267,7 @@ public:
             dbwrapper_private::HandleError(status);
         }
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            CSpanReader ssValue(SER_DISK, CLIENT_VERSION, strValue.data(), strValue.data() + strValue.size());
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -214,8 +291,7 @@ public:
         ssKey << key;
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = Get(slKey, &ReadBuffer());
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -256,6 +332,12 @@ public:
      * Return true if the database managed by this class contains no entries.
      */
     bool IsEmpty();
+
+    //! Lookup counters since the database was opened.
+    CDBStats GetStats() const;
+
+    //! Name and lookup counters of every open database.
+    static std::vector<std::pair<std::string, CDBStats>> GetAllStats();
 };
 
 #endif // BITCOIN_DBWRAPPER_H
@@ -0,0 +1,314 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATMAP_H
+#define BITCOIN_FLATMAP_H
+
+#include "support/hugepagearena.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iterator>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Open-addressing hash map for the coins view caches.
+ *
+ * The table is a flat array of 16-byte slots holding the full hash of the
+ * key and a pointer to the element, probed linearly, so a lookup touches
+ * one cache line of slots and then the element it is after. Elements live
+ * in chunks allocated from a per-map pool and are recycled through a free
+ * list, so (as with boost::unordered_map) references to elements stay valid
+ * until the element is erased, even when the table grows. Iterators point
+ * at the element too, so an iterator held across an insert (as
+ * CCoinsModifier does) still dereferences to the same element.
+ *
+ * Erasing leaves a tombstone, so erasing while iterating (as BatchWrite
+ * does) never moves other elements. Tombstones are dropped when the table
+ * is rebuilt.
+ *
+ * The interface is the subset of boost::unordered_map used by the coins
+ * code. DynamicMemoryUsage() accounts for every allocation exactly. The
+ * table and the pool come from the coins huge page arena, which is plain
+ * malloc unless -hugepagearenas is set.
+ */
+template <typename K, typename V, typename Hasher>
+class flatmap
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const K, V> value_type;
+    typedef size_t size_type;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        value_type* node;
+    };
+
+    //! Marks a slot whose element was erased.
+    static value_type* Tombstone() { return reinterpret_cast<value_type*>(uintptr_t(1)); }
+    static bool IsLive(const value_type* node) { return node != nullptr && node != Tombstone(); }
+
+    union PoolNode {
+        PoolNode* next;
+        alignas(value_type) unsigned char storage[sizeof(value_type)];
+    };
+
+    static const size_t MIN_SLOTS = 16;
+    static const size_t MIN_CHUNK_NODES = 16;
+    static const size_t MAX_CHUNK_NODES = 4096;
+
+    Slot* slots;
+    size_t nSlots;     //!< Table size, zero or a power of two
+    size_t nSize;      //!< Live elements
+    size_t nTombstones;
+    //! Held in an optional so that swap() can exchange hashers whose salt is const.
+    std::optional<Hasher> hasher;
+
+    std::vector<std::pair<PoolNode*, size_t>> chunks; //!< Pool chunks and their node counts
+    PoolNode* freeList;
+    size_t nNextChunkNodes;
+
+    value_type* AllocateNode()
+    {
+        if (freeList == nullptr) {
+            size_t nNodes = nNextChunkNodes;
+            PoolNode* chunk = static_cast<PoolNode*>(HugePageArena(ARENA_COINS).Allocate(sizeof(PoolNode) * nNodes));
+            chunks.emplace_back(chunk, nNodes);
+            for (size_t i = 0; i < nNodes; i++) {
+                chunk[i].next = freeList;
+                freeList = &chunk[i];
+            }
+            if (nNextChunkNodes < MAX_CHUNK_NODES) nNextChunkNodes *= 2;
+        }
+        PoolNode* node = freeList;
+        freeList = node->next;
+        return reinterpret_cast<value_type*>(node->storage);
+    }
+
+    void FreeNode(value_type* value)
+    {
+        value->~value_type();
+        PoolNode* node = reinterpret_cast<PoolNode*>(value);
+        node->next = freeList;
+        freeList = node;
+    }
+
+    size_t Hash(const K& key) const { return (*hasher)(key); }
+
+    //! Index of the slot holding key, or nSlots if absent.
+    size_t FindSlot(const K& key, uint64_t hash) const
+    {
+        if (nSlots == 0) return 0;
+        size_t mask = nSlots - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.node == nullptr) return nSlots;
+            if (slot.hash == hash && slot.node != Tombstone() && slot.node->first == key) return i;
+        }
+    }
+
+    void Rebuild(size_t nNewSlots)
+    {
+        Slot* newSlots = static_cast<Slot*>(HugePageArena(ARENA_COINS).Allocate(nNewSlots * sizeof(Slot), true));
+        size_t mask = nNewSlots - 1;
+        for (size_t i = 0; i < nSlots; i++) {
+            if (!IsLive(slots[i].node)) continue;
+            size_t j = slots[i].hash & mask;
+            while (newSlots[j].node != nullptr) j = (j + 1) & mask;
+            newSlots[j] = slots[i];
+        }
+        HugePageArena(ARENA_COINS).Free(slots, nSlots * sizeof(Slot));
+        slots = newSlots;
+        nSlots = nNewSlots;
+        nTombstones = 0;
+    }
+
+    //! Make room for one more element, keeping the table at most 3/4 full.
+    void Reserve()
+    {
+        if (nSlots == 0) {
+            Rebuild(MIN_SLOTS);
+        } else if ((nSize + nTombstones + 1) * 4 > nSlots * 3) {
+            // Only grow if the live elements need it; otherwise just drop tombstones.
+            Rebuild((nSize + 1) * 2 > nSlots ? nSlots * 2 : nSlots);
+        }
+    }
+
+    template <bool Const>
+    class Iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename flatmap::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+    private:
+        typedef typename std::conditional<Const, const flatmap*, flatmap*>::type map_pointer;
+        map_pointer map;
+        size_t idx;        //!< Slot index; may be stale after the table is rebuilt
+        value_type* node;  //!< Element, or nullptr for end()
+        friend class flatmap;
+
+        void SkipEmpty()
+        {
+            while (idx < map->nSlots && !IsLive(map->slots[idx].node)) idx++;
+            node = idx < map->nSlots ? map->slots[idx].node : nullptr;
+        }
+
+    public:
+        Iterator() : map(nullptr), idx(0), node(nullptr) {}
+        Iterator(map_pointer mapIn, size_t idxIn) : map(mapIn), idx(idxIn), node(idxIn < mapIn->nSlots ? mapIn->slots[idxIn].node : nullptr) {}
+        //! Allow iterator -> const_iterator conversion.
+        template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+        Iterator(const Iterator<OtherConst>& other) : map(other.map), idx(other.idx), node(other.node) {}
+
+        reference operator*() const { return *node; }
+        pointer operator->() const { return node; }
+        Iterator& operator++() { idx++; SkipEmpty(); return *this; }
+        Iterator operator++(int) { Iterator copy(*this); ++*this; return copy; }
+        bool operator==(const Iterator& other) const { return node == other.node; }
+        bool operator!=(const Iterator& other) const { return node != other.node; }
+
+        template <bool> friend class Iterator;
+    };
+
+public:
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    flatmap() : slots(nullptr), nSlots(0), nSize(0), nTombstones(0), freeList(nullptr), nNextChunkNodes(MIN_CHUNK_NODES) { hasher.emplace(); }
+    flatmap(const flatmap&) = delete;
+    flatmap& operator=(const flatmap&) = delete;
+    ~flatmap() { clear(); }
+
+    iterator begin() { iterator it(this, 0); it.SkipEmpty(); return it; }
+    iterator end() { return iterator(this, nSlots); }
+    const_iterator begin() const { const_iterator it(this, 0); it.SkipEmpty(); return it; }
+    const_iterator end() const { return const_iterator(this, nSlots); }
+
+    size_type size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const K& key) { return iterator(this, FindSlot(key, Hash(key))); }
+    const_iterator find(const K& key) const { return const_iterator(this, FindSlot(key, Hash(key))); }
+    size_type count(const K& key) const { return find(key) == end() ? 0 : 1; }
+
+    template <typename Pair>
+    std::pair<iterator, bool> insert(Pair&& value)
+    {
+        uint64_t hash = Hash(value.first);
+        size_t idx = FindSlot(value.first, hash);
+        if (idx != nSlots) return std::make_pair(iterator(this, idx), false);
+
+        Reserve();
+        value_type* node = AllocateNode();
+        try {
+            new (node) value_type(std::forward<Pair>(value));
+        } catch (...) {
+            PoolNode* poolNode = reinterpret_cast<PoolNode*>(node);
+            poolNode->next = freeList;
+            freeList = poolNode;
+            throw;
+        }
+        // Reuse the first tombstone or empty slot on the probe sequence.
+        size_t mask = nSlots - 1;
+        idx = hash & mask;
+        while (IsLive(slots[idx].node)) idx = (idx + 1) & mask;
+        if (slots[idx].node == Tombstone()) nTombstones--;
+        slots[idx].hash = hash;
+        slots[idx].node = node;
+        nSize++;
+        return std::make_pair(iterator(this, idx), true);
+    }
+
+    V& operator[](const K& key)
+    {
+        return insert(value_type(key, V())).first->second;
+    }
+
+    //! Erase the element at it and return an iterator to the next one.
+    iterator erase(const_iterator it)
+    {
+        size_t idx = it.idx;
+        if (idx >= nSlots || slots[idx].node != it.node) {
+            // The table was rebuilt since the iterator was taken.
+            idx = FindSlot(it.node->first, Hash(it.node->first));
+        }
+        assert(idx < nSlots && slots[idx].node == it.node);
+        FreeNode(slots[idx].node);
+        slots[idx].node = Tombstone();
+        nSize--;
+        nTombstones++;
+        iterator next(this, idx);
+        ++next;
+        return next;
+    }
+
+    size_type erase(const K& key)
+    {
+        const_iterator it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    //! Exchange contents with another map. Element references stay valid.
+    void swap(flatmap& other)
+    {
+        std::swap(slots, other.slots);
+        std::swap(nSlots, other.nSlots);
+        std::swap(nSize, other.nSize);
+        std::swap(nTombstones, other.nTombstones);
+        std::optional<Hasher> tmp;
+        tmp.emplace(*hasher);
+        hasher.emplace(*other.hasher);
+        other.hasher.emplace(*tmp);
+        chunks.swap(other.chunks);
+        std::swap(freeList, other.freeList);
+        std::swap(nNextChunkNodes, other.nNextChunkNodes);
+    }
+
+    //! Destroy every element and release the table and the pool.
+    void clear()
+    {
+        for (size_t i = 0; i < nSlots; i++) {
+            if (IsLive(slots[i].node)) slots[i].node->~value_type();
+        }
+        HugePageArena(ARENA_COINS).Free(slots, nSlots * sizeof(Slot));
+        slots = nullptr;
+        nSlots = 0;
+        nSize = 0;
+        nTombstones = 0;
+        for (auto& chunk : chunks) HugePageArena(ARENA_COINS).Free(chunk.first, chunk.second * sizeof(PoolNode));
+        std::vector<std::pair<PoolNode*, size_t>>().swap(chunks);
+        freeList = nullptr;
+        nNextChunkNodes = MIN_CHUNK_NODES;
+    }
+
+    /**
+     * Memory allocated by the map itself: the slot table, the pool chunks
+     * (including nodes on the free list) and the chunk list. Memory owned by
+     * the elements is not included, as for the other memusage helpers.
+     */
+    template <typename MallocUsage>
+    size_t DynamicMemoryUsage(MallocUsage mallocUsage) const
+    {
+        size_t usage = mallocUsage(nSlots * sizeof(Slot)) + mallocUsage(chunks.capacity() * sizeof(chunks[0]));
+        for (const auto& chunk : chunks) usage += mallocUsage(chunk.second * sizeof(PoolNode));
+        return usage;
+    }
+};
+
+#endif // BITCOIN_FLATMAP_H
@@ -62,7 +62,7 @@ int main(int argc, char **argv) {
   assert(sodium_init() != -1);
   ECC_Start();
     InitSignatureCache(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
-    bundlecache::init(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
+    bundlecache::init(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20), DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
 
     // Log all errors to a common test file.
     fs::path tmpPath = fs::temp_directory_path();
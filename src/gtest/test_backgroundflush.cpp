@@ -0,0 +1,135 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "coins.h"
+#include "random.h"
+#include "txdb.h"
+
+static void AddCoins(CCoinsViewCache& view, const uint256& txid, CAmount nValue)
+{
+    CCoinsModifier coins = view.ModifyCoins(txid);
+    coins->vout.resize(1);
+    coins->vout[0].nValue = nValue;
+    coins->nHeight = 1;
+}
+
+TEST(BackgroundFlushTests, FlushedStateVisibleBeforeAndAfterWrite)
+{
+    CCoinsViewDB db(1 << 23, true);
+    CCoinsViewBackgroundFlush flush(&db);
+    CCoinsViewCache tip(&flush);
+
+    uint256 txid = GetRandHash();
+    uint256 hashBlock = GetRandHash();
+    AddCoins(tip, txid, 42);
+    tip.SetBestBlock(hashBlock);
+    ASSERT_TRUE(tip.Flush());
+    EXPECT_EQ(tip.GetCacheSize(), 0);
+
+    // Whether or not the write has finished, reads see the flushed state.
+    CCoins coins;
+    EXPECT_TRUE(tip.GetCoins(txid, coins));
+    EXPECT_EQ(coins.vout[0].nValue, 42);
+    EXPECT_EQ(flush.GetBestBlock(), hashBlock);
+
+    ASSERT_TRUE(flush.Sync());
+    EXPECT_FALSE(flush.IsFlushing());
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(db.GetBestBlock(), hashBlock);
+
+    // A spend is likewise visible while it is being written.
+    tip.ModifyCoins(txid)->Clear();
+    ASSERT_TRUE(tip.Flush());
+    EXPECT_FALSE(flush.HaveCoins(txid));
+    EXPECT_FALSE(flush.GetCoins(txid, coins));
+    ASSERT_TRUE(flush.Sync());
+    EXPECT_FALSE(db.HaveCoins(txid));
+}
+
+TEST(BackgroundFlushTests, BackToBackFlushes)
+{
+    CCoinsViewDB db(1 << 23, true);
+    CCoinsViewBackgroundFlush flush(&db);
+    CCoinsViewCache tip(&flush);
+
+    std::vector<uint256> txids;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 100; i++) {
+            txids.push_back(GetRandHash());
+            AddCoins(tip, txids.back(), round * 100 + i);
+        }
+        // Spend one coin from the previous round, which may still be in flight.
+        if (round > 0) {
+            tip.ModifyCoins(txids[(round - 1) * 100])->Clear();
+        }
+        tip.SetBestBlock(GetRandHash());
+        ASSERT_TRUE(tip.Flush());
+    }
+    uint256 hashBlock = tip.GetBestBlock();
+    ASSERT_TRUE(flush.Sync());
+
+    EXPECT_EQ(db.GetBestBlock(), hashBlock);
+    for (size_t i = 0; i < txids.size(); i++) {
+        bool fSpent = i % 100 == 0 && i < 900;
+        CCoins coins;
+        EXPECT_EQ(db.GetCoins(txids[i], coins), !fSpent);
+        if (!fSpent) {
+            EXPECT_EQ(coins.vout[0].nValue, (CAmount)i);
+        }
+    }
+}
+
+TEST(BackgroundFlushTests, SnapshotOfFlushedState)
+{
+    CCoinsViewDB db(1 << 23, true);
+    CCoinsViewBackgroundFlush flush(&db);
+    CCoinsViewCache tip(&flush);
+
+    uint256 hashBlock = GetRandHash();
+    AddCoins(tip, GetRandHash(), 1);
+    AddCoins(tip, GetRandHash(), 2);
+    tip.SetBestBlock(hashBlock);
+    ASSERT_TRUE(tip.Flush());
+
+    // The snapshot waits for the write in flight.
+    CAutoFile file(tmpfile(), SER_DISK, CLIENT_VERSION);
+    CCoinsSnapshotMetadata metadata;
+    ASSERT_TRUE(tip.DumpSnapshot(file, metadata));
+    EXPECT_EQ(metadata.hashBlock, hashBlock);
+    EXPECT_EQ(metadata.nCoins, 2U);
+    // The best block and anchor records are included.
+    EXPECT_GT(metadata.nRecords, metadata.nCoins);
+
+    // The same chain state always gives the same snapshot.
+    CAutoFile file2(tmpfile(), SER_DISK, CLIENT_VERSION);
+    CCoinsSnapshotMetadata metadata2;
+    ASSERT_TRUE(db.DumpSnapshot(file2, metadata2));
+    EXPECT_EQ(metadata2.hashSnapshot, metadata.hashSnapshot);
+
+    // The file ends with the record count and the hash.
+    rewind(file.Get());
+    unsigned char magic[5];
+    uint32_t nVersion;
+    uint256 hashFileBlock;
+    file.read((char*)magic, sizeof(magic));
+    file >> nVersion >> hashFileBlock;
+    EXPECT_EQ(hashFileBlock, hashBlock);
+    uint64_t nRecords = 0;
+    std::vector<unsigned char> key, value;
+    while (true) {
+        file >> key;
+        if (key.empty())
+            break;
+        file >> value;
+        nRecords++;
+    }
+    uint64_t nFileRecords;
+    uint256 hashSnapshot;
+    file >> nFileRecords >> hashSnapshot;
+    EXPECT_EQ(nRecords, metadata.nRecords);
+    EXPECT_EQ(nFileRecords, metadata.nRecords);
+    EXPECT_EQ(hashSnapshot, metadata.hashSnapshot);
+}
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#include "bip324.h"
+#include "key.h"
+#include "netbufferpool.h"
+#include "random.h"
+#include "v2transport.h"
+
+#include <string.h>
+
+static const CMessageHeader::MessageStartChars MAGIC = {0xf9, 0xbe, 0xb4, 0xd9};
+
+static CKey NewKey()
+{
+    return CKey::TestOnlyRandomKey(true);
+}
+
+static std::array<unsigned char, 32> NewEntropy()
+{
+    std::array<unsigned char, 32> entropy;
+    GetRandBytes(entropy.data(), entropy.size());
+    return entropy;
+}
+
+TEST(BIP324, CiphersAgree) {
+    BIP324Cipher initiator(NewKey(), NewEntropy().data());
+    BIP324Cipher responder(NewKey(), NewEntropy().data());
+    EXPECT_FALSE(initiator.IsInitialized());
+    initiator.Initialize(responder.GetOurPubKey(), MAGIC, true);
+    responder.Initialize(initiator.GetOurPubKey(), MAGIC, false);
+    ASSERT_TRUE(initiator.IsInitialized());
+    ASSERT_TRUE(responder.IsInitialized());
+
+    EXPECT_EQ(initiator.GetSessionId(), responder.GetSessionId());
+    EXPECT_EQ(0, memcmp(initiator.GetSendGarbageTerminator(), responder.GetReceiveGarbageTerminator(),
+                        BIP324Cipher::GARBAGE_TERMINATOR_LEN));
+    EXPECT_EQ(0, memcmp(responder.GetSendGarbageTerminator(), initiator.GetReceiveGarbageTerminator(),
+                        BIP324Cipher::GARBAGE_TERMINATOR_LEN));
+    EXPECT_NE(0, memcmp(initiator.GetSendGarbageTerminator(), initiator.GetReceiveGarbageTerminator(),
+                        BIP324Cipher::GARBAGE_TERMINATOR_LEN));
+
+    // Another network derives other keys.
+    const CMessageHeader::MessageStartChars otherMagic = {0xfa, 0x1a, 0xf9, 0xbf};
+    BIP324Cipher other1(NewKey(), NewEntropy().data());
+    BIP324Cipher other2(NewKey(), NewEntropy().data());
+    other1.Initialize(other2.GetOurPubKey(), MAGIC, true);
+    other2.Initialize(other1.GetOurPubKey(), otherMagic, false);
+    EXPECT_NE(other1.GetSessionId(), other2.GetSessionId());
+}
+
+TEST(BIP324, PacketsRoundTrip) {
+    BIP324Cipher initiator(NewKey(), NewEntropy().data());
+    BIP324Cipher responder(NewKey(), NewEntropy().data());
+    initiator.Initialize(responder.GetOurPubKey(), MAGIC, true);
+    responder.Initialize(initiator.GetOurPubKey(), MAGIC, false);
+
+    // Enough packets for both ciphers to rekey twice.
+    std::vector<unsigned char> aad = {1, 2, 3};
+    for (int i = 0; i < 3 * (int)BIP324Cipher::REKEY_INTERVAL; i++) {
+        std::vector<unsigned char> contents(GetRand(1000));
+        if (!contents.empty())
+            GetRandBytes(contents.data(), contents.size());
+        bool fIgnore = i % 5 == 0;
+        size_t split = GetRand(contents.size() + 1);
+
+        BIP324Cipher& sender = i % 2 ? initiator : responder;
+        BIP324Cipher& receiver = i % 2 ? responder : initiator;
+        std::vector<unsigned char> packet(contents.size() + BIP324Cipher::EXPANSION);
+        sender.Encrypt(contents.data(), split, contents.data() + split, contents.size() - split,
+                       aad.data(), aad.size(), fIgnore, packet.data());
+
+        ASSERT_EQ(contents.size(), receiver.DecryptLength(packet.data()));
+        std::vector<unsigned char> decrypted(BIP324Cipher::HEADER_LEN + contents.size());
+        bool fIgnoreOut;
+        ASSERT_TRUE(receiver.Decrypt(packet.data() + BIP324Cipher::LENGTH_LEN, packet.size() - BIP324Cipher::LENGTH_LEN,
+                                     aad.data(), aad.size(), fIgnoreOut, decrypted.data()));
+        EXPECT_EQ(fIgnore, fIgnoreOut);
+        EXPECT_TRUE(std::equal(contents.begin(), contents.end(), decrypted.begin() + BIP324Cipher::HEADER_LEN));
+    }
+}
+
+TEST(BIP324, TamperedPacketFails) {
+    BIP324Cipher initiator(NewKey(), NewEntropy().data());
+    BIP324Cipher responder(NewKey(), NewEntropy().data());
+    initiator.Initialize(responder.GetOurPubKey(), MAGIC, true);
+    responder.Initialize(initiator.GetOurPubKey(), MAGIC, false);
+
+    std::vector<unsigned char> contents(100, 0x55);
+    std::vector<unsigned char> packet(contents.size() + BIP324Cipher::EXPANSION);
+    initiator.Encrypt(contents.data(), contents.size(), NULL, 0, NULL, 0, false, packet.data());
+    packet[50] ^= 0x01;
+
+    ASSERT_EQ(contents.size(), responder.DecryptLength(packet.data()));
+    std::vector<unsigned char> decrypted(BIP324Cipher::HEADER_LEN + contents.size());
+    bool fIgnore;
+    EXPECT_FALSE(responder.Decrypt(packet.data() + BIP324Cipher::LENGTH_LEN, packet.size() - BIP324Cipher::LENGTH_LEN,
+                                   NULL, 0, fIgnore, decrypted.data()));
+}
+
+typedef std::pair<std::string, std::vector<unsigned char>> Message;
+
+// Give all of data to the transport, in pieces of at most nChunk bytes, doing
+// what the node would: advancing the handshake and taking messages.
+static bool Deliver(CV2Transport& transport, CRecvBufferPool& pool, const std::vector<unsigned char>& data,
+                    size_t nChunk, std::vector<unsigned char>& vReply, std::vector<Message>& vMessages)
+{
+    size_t nPos = 0;
+    while (true) {
+        if (transport.NeedsAdvance()) {
+            std::vector<CSerializeData> vSend;
+            transport.AdvanceHandshake(vSend);
+            for (const CSerializeData& send : vSend)
+                vReply.insert(vReply.end(), send.begin(), send.end());
+        }
+        std::array<char, CMessageHeader::COMMAND_SIZE> command;
+        CSerializeData buffer;
+        size_t nPayloadStart;
+        if (transport.TakeMessage(command, buffer, nPayloadStart)) {
+            vMessages.emplace_back(std::string(command.data(), strnlen(command.data(), command.size())),
+                                   std::vector<unsigned char>(buffer.begin() + nPayloadStart, buffer.end()));
+        }
+        if (nPos == data.size() || transport.IsV1())
+            return true;
+        int n = transport.ReceiveBytes((const char*)data.data() + nPos, std::min(nChunk, data.size() - nPos), pool);
+        if (n < 0)
+            return false;
+        nPos += n;
+    }
+}
+
+// Send a message the way CNode::EndMessage does.
+static void Send(CV2Transport& transport, const std::string& strCommand, const std::vector<unsigned char>& payload,
+                 std::vector<unsigned char>& vOut)
+{
+    char command[CMessageHeader::COMMAND_SIZE] = {};
+    strncpy(command, strCommand.c_str(), sizeof(command));
+    if (transport.IsSendReady()) {
+        CSerializeData packet;
+        transport.EncryptMessage(command, payload.data(), payload.size(), packet);
+        vOut.insert(vOut.end(), packet.begin(), packet.end());
+    } else {
+        CSerializeData data(CMessageHeader::HEADER_SIZE);
+        memcpy(&data[CMessageHeader::MESSAGE_START_SIZE], command, sizeof(command));
+        data.insert(data.end(), payload.begin(), payload.end());
+        transport.QueueMessage(std::move(data));
+    }
+}
+
+TEST(V2Transport, Handshake) {
+    for (size_t nChunk : {(size_t)1, (size_t)7, (size_t)100000}) {
+        CRecvBufferPool pool1, pool2;
+        CV2Transport initiator(true, MAGIC, 1000000);
+        CV2Transport responder(false, MAGIC, 1000000);
+        std::vector<Message> recv1, recv2;
+
+        // The initiator's version waits for the handshake.
+        std::vector<unsigned char> toResponder, toInitiator;
+        Send(initiator, "version", {1, 2, 3}, toResponder);
+        ASSERT_TRUE(toResponder.empty());
+        ASSERT_TRUE(Deliver(initiator, pool1, {}, nChunk, toResponder, recv1));
+        ASSERT_FALSE(toResponder.empty());
+
+        ASSERT_TRUE(Deliver(responder, pool2, toResponder, nChunk, toInitiator, recv2));
+        toResponder.clear();
+        Send(responder, "version", {4, 5}, toInitiator);
+        ASSERT_TRUE(Deliver(initiator, pool1, toInitiator, nChunk, toResponder, recv1));
+        toInitiator.clear();
+        ASSERT_TRUE(Deliver(responder, pool2, toResponder, nChunk, toInitiator, recv2));
+        toResponder.clear();
+        ASSERT_TRUE(Deliver(initiator, pool1, toInitiator, nChunk, toResponder, recv1));
+        toInitiator.clear();
+
+        ASSERT_TRUE(initiator.IsSendReady());
+        ASSERT_TRUE(responder.IsSendReady());
+        EXPECT_EQ(initiator.GetSessionId(), responder.GetSessionId());
+        ASSERT_EQ(1u, recv1.size());
+        EXPECT_EQ(Message("version", {4, 5}), recv1[0]);
+        ASSERT_EQ(1u, recv2.size());
+        EXPECT_EQ(Message("version", {1, 2, 3}), recv2[0]);
+
+        // Now messages go straight out, across rekeys, including empty ones.
+        for (int i = 0; i < 500; i++) {
+            std::vector<unsigned char> payload(GetRand(3000));
+            if (!payload.empty())
+                GetRandBytes(payload.data(), payload.size());
+            Send(initiator, "block", payload, toResponder);
+        }
+        ASSERT_TRUE(Deliver(responder, pool2, toResponder, nChunk, toInitiator, recv2));
+        ASSERT_EQ(501u, recv2.size());
+        EXPECT_EQ("block", recv2[500].first);
+        EXPECT_TRUE(toInitiator.empty());
+    }
+}
+
+TEST(V2Transport, CorruptPacketFails) {
+    CRecvBufferPool pool1, pool2;
+    CV2Transport initiator(true, MAGIC, 1000000);
+    CV2Transport responder(false, MAGIC, 1000000);
+    std::vector<Message> recv1, recv2;
+    std::vector<unsigned char> toResponder, toInitiator;
+    ASSERT_TRUE(Deliver(initiator, pool1, {}, 1000, toResponder, recv1));
+    ASSERT_TRUE(Deliver(responder, pool2, toResponder, 1000, toInitiator, recv2));
+    toResponder.clear();
+    ASSERT_TRUE(Deliver(initiator, pool1, toInitiator, 1000, toResponder, recv1));
+    ASSERT_TRUE(initiator.IsSendReady());
+
+    // Corrupt the last byte of the initiator's version packet's tag.
+    toResponder.back() ^= 0x80;
+    EXPECT_FALSE(Deliver(responder, pool2, toResponder, 1000, toInitiator, recv2));
+}
+
+TEST(V2Transport, DetectsV1) {
+    CRecvBufferPool pool;
+    CV2Transport responder(false, MAGIC, 1000000);
+    std::vector<unsigned char> data(MAGIC, MAGIC + CMessageHeader::MESSAGE_START_SIZE);
+    const char command[CMessageHeader::COMMAND_SIZE] = "version";
+    data.insert(data.end(), command, command + sizeof(command));
+    data.push_back(0x42);
+
+    // The prefix is held back for the v1 path, as is what follows it.
+    std::vector<unsigned char> vReply;
+    std::vector<Message> vMessages;
+    ASSERT_TRUE(Deliver(responder, pool, data, 3, vReply, vMessages));
+    ASSERT_TRUE(responder.IsV1());
+    EXPECT_TRUE(responder.IsSendV1());
+    EXPECT_TRUE(vReply.empty());
+    std::vector<unsigned char> vPrefix = responder.TakeV1Prefix();
+    EXPECT_EQ(std::vector<unsigned char>(data.begin(), data.begin() + CV2Transport::V1_PREFIX_LEN), vPrefix);
+}
+
+TEST(V2Transport, TooMuchGarbageFails) {
+    CRecvBufferPool pool;
+    CV2Transport responder(false, MAGIC, 1000000);
+    CKey key = NewKey();
+    EllSwiftPubKey pubkey = key.EllSwiftCreate(NewEntropy().data());
+    std::vector<unsigned char> data(pubkey.begin(), pubkey.end());
+    data.resize(data.size() + CV2Transport::MAX_GARBAGE_LEN + BIP324Cipher::GARBAGE_TERMINATOR_LEN, 0x11);
+
+    std::vector<unsigned char> vReply;
+    std::vector<Message> vMessages;
+    EXPECT_FALSE(Deliver(responder, pool, data, 1000, vReply, vMessages));
+    // It did answer with its key before giving up.
+    EXPECT_GE(vReply.size(), EllSwiftPubKey::SIZE);
+}
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
+#include "hash.h"
 #include "primitives/block.h"
 #include "streams.h"
 #include "version.h"
 
+#include <rust/constants.h>
+
 
 TEST(BlockTests, HeaderSizeIsExpected) {
     // Dummy header with an empty Equihash solution.
@@ -13,3 +16,46 @@ TEST(BlockTests, HeaderSizeIsExpected) {
 
     ASSERT_EQ(ss.size(), CBlockHeader::HEADER_SIZE);
 }
+
+// The ZIP 244 auth data tree, built serially with every node kept.
+static uint256 SerialAuthDataRoot(const CBlock& block)
+{
+    static const unsigned char personalization[blake2b::PERSONALBYTES] =
+        {'Z','c','a','s','h','A','u','t','h','D','a','t','H','a','s','h'};
+    if (block.vtx.empty()) {
+        return uint256();
+    }
+    size_t perfectSize = 1;
+    while (perfectSize < block.vtx.size()) {
+        perfectSize *= 2;
+    }
+    std::vector<uint256> tree;
+    for (const auto& tx : block.vtx) {
+        tree.push_back(tx.GetAuthDigest());
+    }
+    tree.resize(perfectSize);
+    size_t j = 0;
+    for (size_t layerWidth = perfectSize; layerWidth > 1; layerWidth /= 2) {
+        for (size_t i = 0; i < layerWidth; i += 2) {
+            CBLAKE2bWriter ss(SER_GETHASH, 0, personalization);
+            ss << tree[j + i];
+            ss << tree[j + i + 1];
+            tree.push_back(ss.GetHash());
+        }
+        j += layerWidth;
+    }
+    return tree.back();
+}
+
+TEST(BlockTests, AuthDataRootMatchesSerialTree) {
+    // Large enough for the widest layers to be hashed on several threads.
+    for (size_t nTx : {0, 1, 2, 3, 5, 8, 1000, 4097}) {
+        CBlock block;
+        for (size_t i = 0; i < nTx; i++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            block.vtx.push_back(CTransaction(mtx));
+        }
+        EXPECT_EQ(block.BuildAuthDataMerkleTree(), SerialAuthDataRoot(block)) << nTx;
+    }
+}
@@ -0,0 +1,261 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "blockcompression.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "fs.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util/system.h"
+
+#include <string.h>
+
+// A block of many similar transactions, which compresses well
+static CBlock CompressibleBlock()
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.nTime = 1700000000;
+    for (int i = 0; i < 50; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(uint256(), i);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 1000 + i;
+        mtx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG;
+        block.vtx.push_back(CTransaction(mtx));
+    }
+    return block;
+}
+
+// A block that is mostly random bytes, which does not
+static CBlock IncompressibleBlock()
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = GetRandHash();
+    block.hashMerkleRoot = GetRandHash();
+    block.hashBlockCommitments = GetRandHash();
+    block.nNonce = GetRandHash();
+    CMutableTransaction mtx;
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = GetRand(MAX_MONEY);
+    std::vector<unsigned char> vRandom(2000);
+    GetRandBytes(vRandom.data(), vRandom.size());
+    mtx.vout[0].scriptPubKey = CScript(vRandom.begin(), vRandom.end());
+    block.vtx.push_back(CTransaction(mtx));
+    return block;
+}
+
+static std::vector<char> Serialize(const CBlock& block)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    return std::vector<char>(ss.begin(), ss.end());
+}
+
+TEST(BlockCompression, RoundTrip) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    std::vector<char> data = Serialize(CompressibleBlock());
+    std::vector<char> record, block;
+    ASSERT_TRUE(CompressBlock(data.data(), data.data() + data.size(), 3, record));
+    EXPECT_LT(record.size(), data.size());
+    ASSERT_TRUE(DecompressBlock(record.data(), record.data() + record.size(), MAX_BLOCK_SIZE, block));
+    EXPECT_EQ(block, data);
+}
+
+TEST(BlockCompression, IncompressibleBlockIsStoredAsIs) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    CBlock incompressible = IncompressibleBlock();
+    std::vector<char> data = Serialize(incompressible);
+    std::vector<char> record;
+    EXPECT_FALSE(CompressBlock(data.data(), data.data() + data.size(), MAX_BLOCK_COMPRESSION, record));
+    EXPECT_TRUE(record.empty());
+
+    SetBlockCompression(MAX_BLOCK_COMPRESSION);
+    CBlockDiskRecord plain(incompressible);
+    EXPECT_EQ(plain.nSizeField, data.size());
+    EXPECT_EQ(plain.data, data);
+    CBlockDiskRecord compressed(CompressibleBlock());
+    EXPECT_TRUE(compressed.nSizeField & BLOCK_COMPRESSED_FLAG);
+    EXPECT_EQ(compressed.nSizeField & ~BLOCK_COMPRESSED_FLAG, compressed.data.size());
+    SetBlockCompression(DEFAULT_BLOCK_COMPRESSION);
+}
+
+TEST(BlockCompression, CorruptRecords) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    std::vector<char> data = Serialize(CompressibleBlock());
+    std::vector<char> record, block;
+    ASSERT_TRUE(CompressBlock(data.data(), data.data() + data.size(), 3, record));
+
+    // A damaged frame, or one cut short
+    std::vector<char> damaged = record;
+    damaged[sizeof(uint32_t)] ^= 0xff;
+    EXPECT_FALSE(DecompressBlock(damaged.data(), damaged.data() + damaged.size(), MAX_BLOCK_SIZE, block));
+    EXPECT_FALSE(DecompressBlock(record.data(), record.data() + record.size() - 1, MAX_BLOCK_SIZE, block));
+    EXPECT_FALSE(DecompressBlock(record.data(), record.data() + 2, MAX_BLOCK_SIZE, block));
+
+    // A stated size over the limit is refused before anything is allocated,
+    // as is one that does not match the frame.
+    EXPECT_FALSE(DecompressBlock(record.data(), record.data() + record.size(), data.size() - 1, block));
+    std::vector<char> wrongSize = record;
+    WriteLE32(reinterpret_cast<unsigned char*>(wrongSize.data()), data.size() + 1);
+    EXPECT_FALSE(DecompressBlock(wrongSize.data(), wrongSize.data() + wrongSize.size(), MAX_BLOCK_SIZE, block));
+}
+
+class BlockCompressionDiskTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+    unsigned int nFileSize = 0;
+
+    void SetUp() override {
+        SelectParams(CBaseChainParams::REGTEST);
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+        // Mappings of another test's block files must not be reused.
+        SetMappedBlockFiles(0);
+    }
+
+    void TearDown() override {
+        SetMappedBlockFiles(DEFAULT_MAPPED_BLOCK_FILES);
+        SetBlockCompression(DEFAULT_BLOCK_COMPRESSION);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        fs::remove_all(pathTemp);
+        SelectParams(CBaseChainParams::MAIN);
+    }
+
+    // Append a block to block file 0 at the given compression level
+    CDiskBlockPos Append(const CBlock& block, int nLevel) {
+        SetBlockCompression(nLevel);
+        CBlockDiskRecord record(block);
+        CDiskBlockPos pos(0, nFileSize);
+        EXPECT_TRUE(WriteBlockToDisk(record, pos, Params().MessageStart()));
+        nFileSize = pos.nPos + record.data.size();
+        return pos;
+    }
+
+    // Append a record with the given size field and contents
+    CDiskBlockPos AppendRaw(uint32_t nSizeField, const std::vector<char>& data) {
+        FILE* file = OpenBlockFile(CDiskBlockPos(0, nFileSize));
+        EXPECT_TRUE(file != nullptr);
+        unsigned char size[4];
+        WriteLE32(size, nSizeField);
+        fwrite(Params().MessageStart(), 1, CMessageHeader::MESSAGE_START_SIZE, file);
+        fwrite(size, 1, sizeof(size), file);
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+        CDiskBlockPos pos(0, nFileSize + 8);
+        nFileSize = pos.nPos + data.size();
+        return pos;
+    }
+
+    void Overwrite(unsigned int nPos, char c) {
+        FILE* file = OpenBlockFile(CDiskBlockPos(0, nPos));
+        ASSERT_TRUE(file != nullptr);
+        fwrite(&c, 1, 1, file);
+        fclose(file);
+    }
+};
+
+TEST_F(BlockCompressionDiskTest, MixedFileThroughMappingAndFile) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    CBlock plainBlock = IncompressibleBlock();
+    CBlock compressedBlock = CompressibleBlock();
+    CDiskBlockPos posPlain = Append(plainBlock, 0);
+    CDiskBlockPos posCompressed = Append(compressedBlock, 3);
+    CDiskBlockPos posLast = Append(plainBlock, 3);
+
+    for (unsigned int nMapped : {0u, 4u}) {
+        SetMappedBlockFiles(nMapped);
+        CBlock block;
+        ASSERT_TRUE(ReadBlockFromDisk(block, posPlain, Params().GetConsensus())) << nMapped;
+        EXPECT_EQ(block.GetHash(), plainBlock.GetHash());
+        ASSERT_TRUE(ReadBlockFromDisk(block, posCompressed, Params().GetConsensus())) << nMapped;
+        EXPECT_EQ(block.GetHash(), compressedBlock.GetHash());
+        ASSERT_TRUE(ReadBlockFromDisk(block, posLast, Params().GetConsensus())) << nMapped;
+        EXPECT_EQ(block.GetHash(), plainBlock.GetHash());
+
+        // The raw bytes of a compressed block are those of the block.
+        const char* pbegin;
+        const char* pend;
+        std::shared_ptr<const void> raw = ReadRawBlockFromDisk(posCompressed, pbegin, pend);
+        ASSERT_TRUE(raw != nullptr);
+        EXPECT_EQ(std::vector<char>(pbegin, pend), Serialize(compressedBlock));
+    }
+}
+
+TEST_F(BlockCompressionDiskTest, CorruptRecordsOnDisk) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    CDiskBlockPos posDamaged = Append(CompressibleBlock(), 3);
+    Overwrite(posDamaged.nPos + sizeof(uint32_t), 0);
+    std::vector<char> data = Serialize(IncompressibleBlock());
+    CDiskBlockPos posTooLarge = AppendRaw(MAX_BLOCK_SIZE + 1, data);
+    CDiskBlockPos posTooLargeCompressed = AppendRaw((MAX_BLOCK_SIZE + 1) | BLOCK_COMPRESSED_FLAG, data);
+
+    for (unsigned int nMapped : {0u, 4u}) {
+        SetMappedBlockFiles(nMapped);
+        CBlock block;
+        const char* pbegin;
+        const char* pend;
+        EXPECT_FALSE(ReadBlockFromDisk(block, posDamaged, Params().GetConsensus())) << nMapped;
+        EXPECT_TRUE(ReadRawBlockFromDisk(posTooLarge, pbegin, pend) == nullptr) << nMapped;
+        EXPECT_TRUE(ReadRawBlockFromDisk(posTooLargeCompressed, pbegin, pend) == nullptr) << nMapped;
+    }
+}
+
+TEST_F(BlockCompressionDiskTest, TxIndexOffsetInCompressedBlock) {
+    if (!BlockCompressionAvailable()) {
+        GTEST_SKIP() << "this build has no zstd support";
+    }
+    Append(IncompressibleBlock(), 0);
+    CBlock block = CompressibleBlock();
+    CDiskBlockPos pos = Append(block, 3);
+
+    // Index the transactions the way ConnectBlock does.
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    CDiskTxPos posTx(pos, GetSizeOfCompactSize(block.vtx.size()));
+    for (const CTransaction& tx : block.vtx) {
+        vPos.push_back(std::make_pair(tx.GetHash(), posTx));
+        posTx.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+    }
+
+    CBlockTreeDB* pblocktreeOld = pblocktree;
+    bool fTxIndexOld = fTxIndex;
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    fTxIndex = true;
+    ASSERT_TRUE(pblocktree->WriteTxIndex(vPos));
+
+    for (unsigned int nMapped : {0u, 4u}) {
+        SetMappedBlockFiles(nMapped);
+        for (size_t i : {size_t(0), size_t(31), block.vtx.size() - 1}) {
+            CTransaction tx;
+            uint256 hashBlock;
+            EXPECT_TRUE(GetTransaction(block.vtx[i].GetHash(), tx, Params().GetConsensus(), hashBlock)) << i;
+            EXPECT_EQ(tx.GetHash(), block.vtx[i].GetHash());
+            EXPECT_EQ(hashBlock, block.GetHash());
+        }
+    }
+
+    delete pblocktree;
+    pblocktree = pblocktreeOld;
+    fTxIndex = fTxIndexOld;
+}
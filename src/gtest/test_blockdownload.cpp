@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include "blockdownload.h"
+
+#include <algorithm>
+
+TEST(BlockDownloadStats, WindowFollowsSpeed) {
+    CBlockDownloadStats fast;
+    EXPECT_EQ(fast.Window(), DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER);
+    EXPECT_FALSE(fast.IsOverdue(0, 1000000000));
+
+    // The first block measures the round trip; the ones queued behind it how
+    // long each takes to send.
+    fast.BlockReceived(0, 100000, 10000);
+    EXPECT_EQ(fast.Latency(), 100000);
+    EXPECT_EQ(fast.BlockTime(), 0);
+    fast.BlockReceived(0, 110000, 10000);
+    EXPECT_EQ(fast.BlockTime(), 10000);
+    EXPECT_EQ(fast.BytesPerSecond(), 100000 + (1000000 - 100000) / 8);
+    EXPECT_EQ(fast.Window(), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    CBlockDownloadStats slow;
+    slow.BlockReceived(0, 3000000, 10000);
+    EXPECT_EQ(slow.Window(), MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // Blocks that arrive before they were requested are not measured.
+    slow.BlockReceived(5000000, 4000000, 10000);
+    EXPECT_EQ(slow.Latency(), 3000000);
+}
+
+TEST(BlockDownloadStats, Reassignment) {
+    CBlockDownloadStats stats;
+    stats.BlockReceived(0, 100000, 10000);
+    stats.BlockReceived(0, 200000, 10000);
+    int nWindow = stats.Window();
+    EXPECT_EQ(nWindow, (100000 + BLOCK_DOWNLOAD_TARGET_BUSY_TIME) / 100000);
+
+    // Nothing is overdue before the minimum time, however fast the peer.
+    int64_t nExpected = 100000 + nWindow * 100000;
+    int64_t nOverdue = std::max(BLOCK_REASSIGN_MIN_TIME, BLOCK_REASSIGN_OVERDUE_FACTOR * nExpected);
+    EXPECT_FALSE(stats.IsOverdue(1000000, 1000000 + nOverdue));
+    EXPECT_TRUE(stats.IsOverdue(1000000, 1000000 + nOverdue + 1));
+
+    // Reassigning a block slows the peer's window and pauses it.
+    int64_t nNow = 1000000 + nOverdue + 1;
+    stats.BlockReassigned(1000000, nNow);
+    EXPECT_EQ(stats.Reassigned(), 1);
+    EXPECT_LT(stats.Window(), nWindow);
+    EXPECT_TRUE(stats.IsPaused(nNow));
+    EXPECT_TRUE(stats.IsPaused(nNow + nOverdue));
+    EXPECT_FALSE(stats.IsPaused(nNow + nOverdue + 1));
+}
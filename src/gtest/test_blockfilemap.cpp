@@ -0,0 +1,83 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "blockfilemap.h"
+#include "fs.h"
+#include "tinyformat.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifndef WIN32
+
+class BlockFileMapTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+
+    void SetUp() override {
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+    }
+
+    void TearDown() override {
+        fs::remove_all(pathTemp);
+    }
+
+    fs::path FilePath(int nFile) const {
+        return pathTemp / strprintf("blk%05u.dat", nFile);
+    }
+
+    void Append(int nFile, const std::string& data) {
+        FILE* file = fsbridge::fopen(FilePath(nFile), "ab");
+        ASSERT_TRUE(file != nullptr);
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+};
+
+TEST_F(BlockFileMapTest, MapsAndRemapsGrowingFiles)
+{
+    CBlockFileMapper mapper([this](int nFile) { return FilePath(nFile); }, 2);
+    EXPECT_TRUE(mapper.Get(0, 1) == nullptr);
+
+    Append(0, "block one");
+    auto file = mapper.Get(0, 9);
+    ASSERT_TRUE(file != nullptr);
+    EXPECT_EQ(std::string(file->data(), file->size()), "block one");
+    EXPECT_EQ(mapper.Get(0, 5), file);
+    EXPECT_TRUE(mapper.Get(0, 10) == nullptr);
+
+    // A file that has grown is mapped again; the old mapping stays usable.
+    Append(0, ", block two");
+    auto grown = mapper.Get(0, 20);
+    ASSERT_TRUE(grown != nullptr);
+    EXPECT_NE(grown, file);
+    EXPECT_EQ(std::string(grown->data(), grown->size()), "block one, block two");
+    EXPECT_EQ(std::string(file->data(), file->size()), "block one");
+
+    mapper.Invalidate(0);
+    EXPECT_NE(mapper.Get(0, 1), grown);
+}
+
+TEST_F(BlockFileMapTest, EvictsLeastRecentlyUsed)
+{
+    CBlockFileMapper mapper([this](int nFile) { return FilePath(nFile); }, 2);
+    for (int i = 0; i < 3; i++) {
+        Append(i, "data");
+    }
+    auto file0 = mapper.Get(0, 4);
+    auto file1 = mapper.Get(1, 4);
+    EXPECT_EQ(mapper.Get(0, 4), file0);
+    mapper.Get(2, 4);
+    EXPECT_EQ(mapper.Get(0, 4), file0);
+    EXPECT_NE(mapper.Get(1, 4), file1);
+
+    mapper.SetMaxFiles(0);
+    EXPECT_TRUE(mapper.Get(0, 4) == nullptr);
+}
+
+#endif // WIN32
@@ -0,0 +1,113 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "blockfilewriter.h"
+#include "fs.h"
+#include "tinyformat.h"
+
+#include <cstdio>
+#include <future>
+#include <string>
+
+class BlockFileWriterTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+
+    void SetUp() override {
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+    }
+
+    void TearDown() override {
+        fs::remove_all(pathTemp);
+    }
+
+    fs::path FilePath(CBlockFileWriter::FileType type, int nFile) const {
+        return pathTemp / strprintf("%s%05u.dat", type == CBlockFileWriter::BLOCK_FILE ? "blk" : "rev", nFile);
+    }
+
+    FILE* Open(CBlockFileWriter::FileType type, const CDiskBlockPos& pos) const {
+        FILE* file = fsbridge::fopen(FilePath(type, pos.nFile), "rb+");
+        if (!file)
+            file = fsbridge::fopen(FilePath(type, pos.nFile), "wb+");
+        if (file && fseek(file, pos.nPos, SEEK_SET) != 0) {
+            fclose(file);
+            return nullptr;
+        }
+        return file;
+    }
+
+    std::string Contents(CBlockFileWriter::FileType type, int nFile) const {
+        std::string data;
+        FILE* file = fsbridge::fopen(FilePath(type, nFile), "rb");
+        if (!file)
+            return data;
+        char buf[256];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+            data.append(buf, n);
+        fclose(file);
+        return data;
+    }
+
+    static std::vector<char> Bytes(const std::string& s) {
+        return std::vector<char>(s.begin(), s.end());
+    }
+};
+
+TEST_F(BlockFileWriterTest, WritesInPlace) {
+    {
+        CBlockFileWriter writer([this](CBlockFileWriter::FileType type, const CDiskBlockPos& pos) { return Open(type, pos); });
+        writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 0), Bytes("aaaa"));
+        writer.Write(CBlockFileWriter::UNDO_FILE, CDiskBlockPos(0, 0), Bytes("uu"));
+        writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 4), Bytes("bb"));
+        writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(1, 0), Bytes("cc"));
+        EXPECT_TRUE(writer.Sync());
+
+        EXPECT_EQ(Contents(CBlockFileWriter::BLOCK_FILE, 0), "aaaabb");
+        EXPECT_EQ(Contents(CBlockFileWriter::UNDO_FILE, 0), "uu");
+        EXPECT_EQ(Contents(CBlockFileWriter::BLOCK_FILE, 1), "cc");
+        EXPECT_EQ(writer.Find(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 0)), nullptr);
+
+        // Records queued at shutdown are still written.
+        writer.Write(CBlockFileWriter::UNDO_FILE, CDiskBlockPos(0, 2), Bytes("vv"));
+    }
+    EXPECT_EQ(Contents(CBlockFileWriter::UNDO_FILE, 0), "uuvv");
+}
+
+TEST_F(BlockFileWriterTest, ReadsPendingRecords) {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    CBlockFileWriter writer([this, released](CBlockFileWriter::FileType type, const CDiskBlockPos& pos) {
+        released.wait();
+        return Open(type, pos);
+    });
+    writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 0), Bytes("aaaa"));
+    writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 4), Bytes("bb"));
+
+    // Neither record is written yet, so both are served from memory.
+    auto record = writer.Find(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 4));
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(std::string(record->begin(), record->end()), "bb");
+    EXPECT_EQ(writer.Find(CBlockFileWriter::UNDO_FILE, CDiskBlockPos(0, 4)), nullptr);
+    EXPECT_EQ(writer.Find(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 2)), nullptr);
+
+    release.set_value();
+    EXPECT_TRUE(writer.Sync());
+    EXPECT_EQ(writer.Find(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 4)), nullptr);
+    EXPECT_EQ(Contents(CBlockFileWriter::BLOCK_FILE, 0), "aaaabb");
+}
+
+TEST_F(BlockFileWriterTest, FailedWrite) {
+    CBlockFileWriter writer([](CBlockFileWriter::FileType type, const CDiskBlockPos& pos) -> FILE* { return nullptr; });
+    writer.Write(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 0), Bytes("aaaa"));
+    EXPECT_FALSE(writer.Sync());
+
+    // The record stays readable, so the block is not lost before the node stops.
+    auto record = writer.Find(CBlockFileWriter::BLOCK_FILE, CDiskBlockPos(0, 0));
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(std::string(record->begin(), record->end()), "aaaa");
+}
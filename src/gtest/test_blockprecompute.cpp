@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "blockprecompute.h"
+#include "coins.h"
+#include "consensus/upgrades.h"
+#include "primitives/block.h"
+
+static CMutableTransaction V5Transaction()
+{
+    CMutableTransaction mtx;
+    mtx.fOverwintered = true;
+    mtx.nVersionGroupId = ZIP225_VERSION_GROUP_ID;
+    mtx.nVersion = ZIP225_TX_VERSION;
+    mtx.nConsensusBranchId = NetworkUpgradeInfo[Consensus::UPGRADE_NU5].nBranchId;
+    return mtx;
+}
+
+TEST(BlockPrecomputedData, ResolvesInBlockOutputs) {
+    CMutableTransaction fund = V5Transaction();
+    fund.vout.resize(20);
+    for (size_t i = 0; i < fund.vout.size(); i++) {
+        fund.vout[i].nValue = 1000 + i;
+        fund.vout[i].scriptPubKey = CScript() << OP_1;
+    }
+
+    CBlock block;
+    block.vtx.push_back(fund);
+    for (uint32_t i = 0; i < fund.vout.size(); i++) {
+        CMutableTransaction mtx = V5Transaction();
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(block.vtx[0].GetHash(), i);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 500;
+        block.vtx.push_back(mtx);
+    }
+
+    CCoinsViewDummy viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    CBlockPrecomputedData txdata(block, view, 4);
+    ASSERT_EQ(txdata.size(), block.vtx.size());
+
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        // The arena already holds data for these outputs, so Get() must hand
+        // it out as built rather than rebuild it.
+        const PrecomputedTransactionData& built = txdata[i];
+        const PrecomputedTxParts* preTx = built.preTx.get();
+        ASSERT_NE(preTx, nullptr);
+        std::vector<CTxOut> allPrevOutputs {fund.vout[i - 1]};
+        EXPECT_EQ(&txdata.Get(i, block.vtx[i], allPrevOutputs), &built);
+        EXPECT_EQ(built.preTx.get(), preTx);
+    }
+    EXPECT_EQ(txdata.RebuiltCount(), 0u);
+}
+
+TEST(BlockPrecomputedData, RebuildsForOtherOutputs) {
+    CMutableTransaction mtx = V5Transaction();
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(uint256S("0x01"), 0);
+    mtx.vout.resize(1);
+
+    CBlock block;
+    block.vtx.push_back(V5Transaction());
+    block.vtx.push_back(mtx);
+
+    // The spent output is unknown to the view, so nothing is built up front.
+    CCoinsViewDummy viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    CBlockPrecomputedData txdata(block, view, 1);
+
+    std::vector<CTxOut> allPrevOutputs(1);
+    allPrevOutputs[0].nValue = 7;
+    const PrecomputedTransactionData& built = txdata.Get(1, block.vtx[1], allPrevOutputs);
+    EXPECT_EQ(&built, &txdata[1]);
+    EXPECT_EQ(txdata.RebuiltCount(), 1u);
+
+    // Asking again with the same outputs reuses the data, other outputs rebuild it.
+    txdata.Get(1, block.vtx[1], allPrevOutputs);
+    EXPECT_EQ(txdata.RebuiltCount(), 1u);
+    allPrevOutputs[0].nValue = 8;
+    txdata.Get(1, block.vtx[1], allPrevOutputs);
+    EXPECT_EQ(txdata.RebuiltCount(), 2u);
+}
@@ -303,7 +303,7 @@ public:
                 if (it->second.entered) {
                     if (it->first != Tree::empty_root()) {
                         auto ret = cacheAnchors.insert(std::make_pair(it->first, Tree())).first;
-                        ret->second = it->second.tree;
+                        ret->second = *it->second.tree;
                     }
                 } else {
                     cacheAnchors.erase(it->first);
@@ -406,6 +406,16 @@ public:
         EXPECT_EQ(DynamicMemoryUsage(), ret);
     }
 
+    bool IsCached(const uint256& txid) const
+    {
+        return cacheCoins.count(txid) > 0;
+    }
+
+    bool IsNullifierCached(const uint256& nf) const
+    {
+        return cacheSproutNullifiers.count(nf) > 0;
+    }
+
 };
 
 libzcash::SubtreeData RandomSubtree(libzcash::SubtreeIndex index) {
@@ -1203,3 +1213,108 @@ TEST(CoinsTests, SubtreesTest)
     testSubtreesForShieldedType(ORCHARD);
     }
 }
+
+TEST(CoinsTests, WriteBackAndEvictColdCoins)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    std::vector<uint256> txids;
+    for (int i = 0; i < 100; i++) {
+        txids.push_back(GetRandHash());
+        CCoinsModifier coins = cache.ModifyCoins(txids.back());
+        coins->vout.resize(1);
+        coins->vout[0].nValue = i;
+    }
+    cache.ModifyCoins(txids[0])->Clear();
+
+    // The base receives the changes; the cache keeps the unspent coins.
+    ASSERT_TRUE(cache.WriteBack());
+    cache.SelfTest();
+    EXPECT_EQ(cache.GetCacheSize(), 99);
+    CCoins coins;
+    EXPECT_TRUE(base.GetCoins(txids[1], coins));
+    EXPECT_EQ(coins.vout[0].nValue, 1);
+
+    // Age everything once, then read half of the coins.
+    cache.EvictColdCoins(cache.DynamicMemoryUsage() - 1);
+    for (int i = 1; i < 50; i++) {
+        ASSERT_NE(cache.AccessCoins(txids[i]), nullptr);
+    }
+
+    // Only coins that were not read are evicted.
+    cache.EvictColdCoins(cache.DynamicMemoryUsage() * 6 / 10);
+    cache.SelfTest();
+    EXPECT_LT(cache.GetCacheSize(), 99);
+    for (int i = 1; i < 50; i++) {
+        EXPECT_TRUE(cache.IsCached(txids[i]));
+    }
+
+    // Evicted coins are still found in the base.
+    for (int i = 1; i < 100; i++) {
+        const CCoins* pcoins = cache.AccessCoins(txids[i]);
+        ASSERT_NE(pcoins, nullptr);
+        EXPECT_EQ(pcoins->vout[0].nValue, i);
+    }
+}
+
+TEST(CoinsTests, PrefetchLoadsBlockInputs)
+{
+    CCoinsViewTest base;
+    std::vector<uint256> txids;
+    uint256 spentNullifier = GetRandHash();
+    {
+        CCoinsViewCacheTest writer(&base);
+        for (int i = 0; i < 64; i++) {
+            txids.push_back(GetRandHash());
+            CCoinsModifier coins = writer.ModifyCoins(txids.back());
+            coins->vout.resize(1);
+            coins->vout[0].nValue = i;
+        }
+        CMutableTransaction mtx;
+        JSDescription jsd;
+        jsd.nullifiers[0] = spentNullifier;
+        mtx.vJoinSplit.push_back(jsd);
+        writer.SetNullifiers(CTransaction(mtx), true);
+        ASSERT_TRUE(writer.Flush());
+    }
+
+    // Each transaction spends one stored coin, and the last one also spends
+    // the output of the first, which the base does not have.
+    std::vector<CTransaction> vtx;
+    for (int i = 0; i < 64; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(txids[i], 0));
+        if (i == 63) {
+            mtx.vin.emplace_back(COutPoint(vtx[0].GetHash(), 0));
+        }
+        mtx.vout.resize(1);
+        vtx.emplace_back(mtx);
+    }
+    uint256 unspentNullifier = GetRandHash();
+    CMutableTransaction mtx;
+    JSDescription jsd;
+    jsd.nullifiers[0] = spentNullifier;
+    jsd.nullifiers[1] = unspentNullifier;
+    mtx.vJoinSplit.push_back(jsd);
+    vtx.emplace_back(mtx);
+
+    CCoinsViewCacheTest cache(&base);
+    cache.Prefetch(vtx, 4);
+    cache.SelfTest();
+    EXPECT_EQ(cache.GetCacheSize(), 64);
+    for (int i = 0; i < 64; i++) {
+        EXPECT_TRUE(cache.IsCached(txids[i]));
+        EXPECT_EQ(cache.AccessCoins(txids[i])->vout[0].nValue, i);
+    }
+    EXPECT_FALSE(cache.IsCached(vtx[0].GetHash()));
+    EXPECT_TRUE(cache.IsNullifierCached(spentNullifier));
+    EXPECT_TRUE(cache.IsNullifierCached(unspentNullifier));
+    EXPECT_TRUE(cache.GetNullifier(spentNullifier, SPROUT));
+    EXPECT_FALSE(cache.GetNullifier(unspentNullifier, SPROUT));
+
+    // Prefetching again finds everything cached.
+    size_t nUsage = cache.DynamicMemoryUsage();
+    cache.Prefetch(vtx, 4);
+    EXPECT_EQ(cache.DynamicMemoryUsage(), nUsage);
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "coins.h"
+#include "flatmap.h"
+#include "random.h"
+
+#include <map>
+#include <string>
+
+struct IdentityHasher {
+    size_t operator()(uint64_t key) const { return key; }
+};
+
+// Every key lands in the same probe sequence.
+struct CollidingHasher {
+    size_t operator()(uint64_t key) const { return 42; }
+};
+
+TEST(FlatMapTests, InsertFindErase)
+{
+    flatmap<uint64_t, std::string, IdentityHasher> m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_TRUE(m.begin() == m.end());
+    EXPECT_TRUE(m.find(1) == m.end());
+
+    auto ret = m.insert(std::make_pair(uint64_t(1), std::string("one")));
+    EXPECT_TRUE(ret.second);
+    EXPECT_EQ(ret.first->first, 1);
+    EXPECT_EQ(ret.first->second, "one");
+
+    ret = m.insert(std::make_pair(uint64_t(1), std::string("uno")));
+    EXPECT_FALSE(ret.second);
+    EXPECT_EQ(ret.first->second, "one");
+
+    m[2] = "two";
+    EXPECT_EQ(m.size(), 2);
+    EXPECT_EQ(m.count(2), 1);
+    EXPECT_EQ(m.find(2)->second, "two");
+
+    EXPECT_EQ(m.erase(1), 1);
+    EXPECT_EQ(m.erase(1), 0);
+    EXPECT_TRUE(m.find(1) == m.end());
+    EXPECT_EQ(m.size(), 1);
+
+    m.clear();
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(memusage::DynamicUsage(m), 0);
+}
+
+TEST(FlatMapTests, ReferencesSurviveGrowth)
+{
+    flatmap<uint64_t, uint64_t, IdentityHasher> m;
+    auto it = m.insert(std::make_pair(uint64_t(7), uint64_t(70))).first;
+    uint64_t* value = &it->second;
+    for (uint64_t i = 100; i < 10000; i++) {
+        m[i] = i;
+    }
+    EXPECT_EQ(value, &m.find(7)->second);
+    EXPECT_EQ(&*it, &*m.find(7));
+
+    // An iterator taken before the table grew can still erase its element.
+    m.erase(it);
+    EXPECT_TRUE(m.find(7) == m.end());
+    EXPECT_EQ(m.size(), 9900);
+}
+
+TEST(FlatMapTests, EraseWhileIterating)
+{
+    flatmap<uint64_t, uint64_t, CollidingHasher> m;
+    for (uint64_t i = 0; i < 200; i++) {
+        m[i] = i;
+    }
+    size_t visited = 0;
+    for (auto it = m.begin(); it != m.end(); ) {
+        visited++;
+        if (it->first % 2 == 0) {
+            it = m.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    EXPECT_EQ(visited, 200);
+    EXPECT_EQ(m.size(), 100);
+    for (uint64_t i = 0; i < 200; i++) {
+        EXPECT_EQ(m.count(i), i % 2);
+    }
+}
+
+TEST(FlatMapTests, MatchesStdMap)
+{
+    flatmap<uint64_t, uint64_t, IdentityHasher> m;
+    std::map<uint64_t, uint64_t> expected;
+    for (int i = 0; i < 100000; i++) {
+        uint64_t key = GetRand(2000);
+        switch (GetRand(3)) {
+        case 0:
+            m[key] = i;
+            expected[key] = i;
+            break;
+        case 1:
+            EXPECT_EQ(m.erase(key), expected.erase(key));
+            break;
+        case 2:
+            EXPECT_EQ(m.find(key) == m.end(), expected.count(key) == 0);
+            break;
+        }
+    }
+    EXPECT_EQ(m.size(), expected.size());
+    size_t n = 0;
+    for (const auto& entry : m) {
+        EXPECT_EQ(entry.second, expected.at(entry.first));
+        n++;
+    }
+    EXPECT_EQ(n, expected.size());
+}
+
+struct SaltedHasher {
+    const uint64_t salt;
+    SaltedHasher() : salt(GetRand(1000000)) {}
+    size_t operator()(uint64_t key) const { return key ^ salt; }
+};
+
+TEST(FlatMapTests, Swap)
+{
+    flatmap<uint64_t, uint64_t, SaltedHasher> a, b;
+    for (uint64_t i = 0; i < 100; i++) {
+        a[i] = i;
+    }
+    uint64_t* value = &a.find(5)->second;
+    b[1000] = 1;
+
+    a.swap(b);
+    EXPECT_EQ(a.size(), 1);
+    EXPECT_EQ(b.size(), 100);
+    EXPECT_EQ(&b.find(5)->second, value);
+    EXPECT_TRUE(b.find(1000) == b.end());
+    EXPECT_EQ(a.find(1000)->second, 1);
+    for (uint64_t i = 100; i < 200; i++) {
+        b[i] = i;
+    }
+    for (uint64_t i = 0; i < 200; i++) {
+        EXPECT_EQ(b.find(i)->second, i);
+    }
+}
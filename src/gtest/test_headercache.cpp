@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "headercache.h"
+#include "streams.h"
+#include "version.h"
+
+static CBlockHeader MakeHeader(uint32_t nTime, size_t nSolutionSize)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = nTime;
+    header.nBits = 0x207fffff;
+    header.nNonce = uint256S("01");
+    header.nSolution.assign(nSolutionSize, 0xab);
+    return header;
+}
+
+static std::string Serialized(CHeaderCache& cache, const CBlockIndex* pindex, bool fStore = true)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    cache.Write(ss, pindex, fStore);
+    return ss.str();
+}
+
+static std::string Expected(const CBlockIndex* pindex)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHeader();
+    return ss.str();
+}
+
+TEST(HeaderCache, MatchesHeaderSerialization) {
+    CHeaderCache cache;
+    CBlockIndex genesis(MakeHeader(1000, HEADER_CACHE_SOLUTION_SIZE));
+    CBlockIndex next(MakeHeader(1060, HEADER_CACHE_SOLUTION_SIZE));
+    uint256 hashGenesis = uint256S("02");
+    genesis.phashBlock = &hashGenesis;
+    next.pprev = &genesis;
+    next.nHeight = 1;
+
+    EXPECT_EQ(Expected(&next).size(), HEADER_CACHE_RECORD_SIZE);
+    EXPECT_EQ(Serialized(cache, &next), Expected(&next));
+    EXPECT_EQ(Serialized(cache, &genesis), Expected(&genesis));
+    EXPECT_GT(cache.DynamicMemoryUsage(), 2 * HEADER_CACHE_RECORD_SIZE);
+
+    // Cached records are served again.
+    EXPECT_EQ(Serialized(cache, &next), Expected(&next));
+}
+
+TEST(HeaderCache, ReorgRefillsHeight) {
+    CHeaderCache cache;
+    CBlockIndex a(MakeHeader(1000, HEADER_CACHE_SOLUTION_SIZE));
+    CBlockIndex b(MakeHeader(2000, HEADER_CACHE_SOLUTION_SIZE));
+    EXPECT_EQ(Serialized(cache, &a), Expected(&a));
+    EXPECT_EQ(Serialized(cache, &b), Expected(&b));
+    EXPECT_NE(Expected(&a), Expected(&b));
+
+    // A block off the active chain is serialized without replacing the record.
+    EXPECT_EQ(Serialized(cache, &a, false), Expected(&a));
+    size_t nUsage = cache.DynamicMemoryUsage();
+    EXPECT_EQ(Serialized(cache, &b, false), Expected(&b));
+    EXPECT_EQ(cache.DynamicMemoryUsage(), nUsage);
+}
+
+TEST(HeaderCache, OtherSolutionSizes) {
+    CHeaderCache cache;
+    CBlockIndex odd(MakeHeader(1000, 100));
+    EXPECT_EQ(Serialized(cache, &odd), Expected(&odd));
+    EXPECT_EQ(cache.DynamicMemoryUsage(), 0);
+
+    cache.Clear();
+    CBlockIndex normal(MakeHeader(1000, HEADER_CACHE_SOLUTION_SIZE));
+    EXPECT_EQ(Serialized(cache, &normal), Expected(&normal));
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "main.h"
+#include "txdb.h"
 #include "util/test.h"
 #include "zcash/History.hpp"
 
@@ -55,6 +56,41 @@ TEST(History, Smoky) {
 }
 
 
+TEST(History, DatabaseCacheFollowsFlushes) {
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewDummy fakeDB;
+    CCoinsViewCache expected(&fakeDB);
+
+    uint32_t epochId = 0;
+
+    // Connect each block in its own view and flush it to the database, with
+    // a reorg part of the way through. The database answers from the nodes it
+    // kept in memory while writing.
+    for (uint64_t i = 1; i <= 40; i++) {
+        {
+            CCoinsViewCache view(&db);
+            view.PushHistoryNode(epochId, getLeafN(i));
+            ASSERT_TRUE(view.Flush());
+        }
+        expected.PushHistoryNode(epochId, getLeafN(i));
+
+        if (i == 20) {
+            for (int j = 0; j < 5; j++) {
+                CCoinsViewCache view(&db);
+                view.PopHistoryNode(epochId);
+                ASSERT_TRUE(view.Flush());
+                expected.PopHistoryNode(epochId);
+            }
+        }
+    }
+
+    EXPECT_EQ(db.GetHistoryLength(epochId), expected.GetHistoryLength(epochId));
+    EXPECT_EQ(db.GetHistoryRoot(epochId), expected.GetHistoryRoot(epochId));
+    for (HistoryIndex i = 0; i < expected.GetHistoryLength(epochId); i++) {
+        EXPECT_EQ(db.GetHistoryAt(epochId, i), expected.GetHistoryAt(epochId, i));
+    }
+}
+
 TEST(History, EpochBoundaries) {
     // Fake an empty view
     CCoinsViewDummy fakeDB;
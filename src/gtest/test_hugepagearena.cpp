@@ -0,0 +1,92 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "support/hugepagearena.h"
+
+#include <list>
+#include <string.h>
+
+TEST(HugePageArena, OffUsesMalloc) {
+    CHugePageArena arena;
+    void* p = arena.Allocate(100);
+    memset(p, 1, 100);
+    arena.Free(p, 100);
+    CHugePageArena::Stats stats = arena.GetStats();
+    EXPECT_EQ(stats.nMapped, 0);
+    EXPECT_EQ(stats.nUsed, 0);
+}
+
+TEST(HugePageArena, SmallAllocationsShareRegions) {
+    CHugePageArena arena(HugePageMode::THP);
+    char* a = static_cast<char*>(arena.Allocate(100));
+    char* b = static_cast<char*>(arena.Allocate(100));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % 16, 0);
+    EXPECT_EQ(b, a + 112);
+    memset(a, 1, 100);
+
+    CHugePageArena::Stats stats = arena.GetStats();
+    EXPECT_EQ(stats.nMapped, HUGE_PAGE_REGION_SIZE);
+    EXPECT_EQ(stats.nUsed, 224);
+    EXPECT_EQ(stats.nMappings, 1);
+
+    // A freed block is reused for the same size, zeroed on request.
+    arena.Free(a, 100);
+    EXPECT_EQ(arena.GetStats().nUsed, 112);
+    char* c = static_cast<char*>(arena.Allocate(100, true));
+    EXPECT_EQ(c, a);
+    for (int i = 0; i < 100; i++) EXPECT_EQ(c[i], 0);
+
+    arena.Free(b, 100);
+    arena.Free(c, 100);
+    stats = arena.GetStats();
+    EXPECT_EQ(stats.nUsed, 0);
+    EXPECT_EQ(stats.nMapped, HUGE_PAGE_REGION_SIZE);
+}
+
+TEST(HugePageArena, LargeAllocationsAreUnmapped) {
+    CHugePageArena arena(HugePageMode::THP);
+    size_t nSize = HUGE_PAGE_SIZE + 1;
+    char* p = static_cast<char*>(arena.Allocate(nSize, true));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % HUGE_PAGE_SIZE, 0);
+    EXPECT_EQ(p[0], 0);
+    EXPECT_EQ(p[nSize - 1], 0);
+    p[nSize - 1] = 1;
+    EXPECT_EQ(arena.GetStats().nMapped, 2 * HUGE_PAGE_SIZE);
+
+    arena.Free(p, nSize);
+    CHugePageArena::Stats stats = arena.GetStats();
+    EXPECT_EQ(stats.nMapped, 0);
+    EXPECT_EQ(stats.nUsed, 0);
+    EXPECT_EQ(stats.nMappings, 0);
+}
+
+TEST(HugePageArena, FreesMemoryFromBeforeModeChange) {
+    CHugePageArena arena;
+    void* before = arena.Allocate(64);
+    arena.SetMode(HugePageMode::THP);
+    void* after = arena.Allocate(64);
+    EXPECT_EQ(arena.GetStats().nUsed, 64);
+
+    arena.Free(before, 64);
+    EXPECT_EQ(arena.GetStats().nUsed, 64);
+    arena.SetMode(HugePageMode::OFF);
+    arena.Free(after, 64);
+    EXPECT_EQ(arena.GetStats().nUsed, 0);
+}
+
+TEST(HugePageArena, Allocator) {
+    HugePageArena(ARENA_MEMPOOL).SetMode(HugePageMode::THP);
+    size_t nUsedBefore = HugePageArena(ARENA_MEMPOOL).GetStats().nUsed;
+    {
+        std::list<int, hugepage_allocator<int, ARENA_MEMPOOL>> list;
+        for (int i = 0; i < 1000; i++) list.push_back(i);
+        EXPECT_GT(HugePageArena(ARENA_MEMPOOL).GetStats().nUsed, nUsedBefore);
+        int n = 0;
+        for (int i : list) EXPECT_EQ(i, n++);
+    }
+    EXPECT_EQ(HugePageArena(ARENA_MEMPOOL).GetStats().nUsed, nUsedBefore);
+    HugePageArena(ARENA_MEMPOOL).SetMode(HugePageMode::OFF);
+}
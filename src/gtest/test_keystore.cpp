@@ -539,6 +539,39 @@ TEST(KeystoreTests, StoreAndRetrieveSpendingKeyInEncryptedStore) {
     ASSERT_EQ(1, addrs.count(addr2));
 }
 
+TEST(KeystoreTests, UnlockedKeysAreDroppedOnLock) {
+    TestCCryptoKeyStore keyStore;
+    CKeyingMaterial vMasterKey(32, 0);
+    GetRandBytes(vMasterKey.data(), 32);
+
+    CKey key = CKey::TestOnlyRandomKey(true);
+    auto keyId = key.GetPubKey().GetID();
+    ASSERT_TRUE(keyStore.AddKey(key));
+    ASSERT_TRUE(keyStore.SetMnemonicSeed(MnemonicSeed::Random(SLIP44_TESTNET_TYPE)));
+    ASSERT_TRUE(keyStore.EncryptKeys(vMasterKey));
+    ASSERT_TRUE(keyStore.Unlock(vMasterKey));
+
+    // Repeated lookups return the key decrypted by the first one.
+    CKey keyOut;
+    ASSERT_TRUE(keyStore.GetKey(keyId, keyOut));
+    EXPECT_EQ(key, keyOut);
+    ASSERT_TRUE(keyStore.GetKey(keyId, keyOut));
+    EXPECT_EQ(key, keyOut);
+    auto seed = keyStore.GetMnemonicSeed();
+    ASSERT_TRUE(seed.has_value());
+    EXPECT_EQ(seed, keyStore.GetMnemonicSeed());
+
+    // Locking drops them.
+    ASSERT_TRUE(keyStore.Lock());
+    EXPECT_FALSE(keyStore.GetKey(keyId, keyOut));
+    EXPECT_FALSE(keyStore.GetMnemonicSeed().has_value());
+
+    ASSERT_TRUE(keyStore.Unlock(vMasterKey));
+    ASSERT_TRUE(keyStore.GetKey(keyId, keyOut));
+    EXPECT_EQ(key, keyOut);
+    EXPECT_EQ(seed, keyStore.GetMnemonicSeed());
+}
+
 TEST(KeystoreTests, StoreAndRetrieveUFVK) {
     SelectParams(CBaseChainParams::TESTNET);
     CBasicKeyStore keyStore;
@@ -0,0 +1,90 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "knownfilter.h"
+#include "uint256.h"
+
+static uint256 Hash(int n)
+{
+    uint256 hash;
+    *hash.begin() = n & 0xff;
+    *(hash.begin() + 1) = n >> 8;
+    return hash;
+}
+
+TEST(SharedKnownFilter, TracksEachPeer) {
+    FixedClock clock(std::chrono::seconds(1000));
+    CSharedKnownFilter shared(&clock, 60, 100);
+    CPeerKnownFilter a(50000, 0.000001, &shared);
+    CPeerKnownFilter b(50000, 0.000001, &shared);
+
+    a.insert(Hash(1));
+    EXPECT_TRUE(a.contains(Hash(1)));
+    EXPECT_FALSE(b.contains(Hash(1)));
+    b.insert(Hash(1));
+    EXPECT_TRUE(b.contains(Hash(1)));
+    EXPECT_EQ(shared.size(), 1);
+
+    // Byte keys and hashes of the same bytes are the same key.
+    uint256 hash = Hash(2);
+    std::vector<unsigned char> vKey(hash.begin(), hash.end());
+    b.insert(vKey);
+    EXPECT_TRUE(b.contains(Hash(2)));
+
+    a.reset();
+    EXPECT_FALSE(a.contains(Hash(1)));
+    EXPECT_TRUE(b.contains(Hash(1)));
+}
+
+TEST(SharedKnownFilter, ReusedSlotsStartEmpty) {
+    FixedClock clock(std::chrono::seconds(1000));
+    CSharedKnownFilter shared(&clock, 60, 100);
+    // Enough peers for the bitmaps to need more than one word.
+    std::vector<std::unique_ptr<CPeerKnownFilter>> peers;
+    for (int i = 0; i < 100; i++) {
+        peers.emplace_back(new CPeerKnownFilter(50000, 0.000001, &shared));
+        peers.back()->insert(Hash(i));
+    }
+    EXPECT_TRUE(peers[99]->contains(Hash(99)));
+    EXPECT_FALSE(peers[99]->contains(Hash(98)));
+
+    peers[70].reset();
+    peers[70].reset(new CPeerKnownFilter(50000, 0.000001, &shared));
+    EXPECT_FALSE(peers[70]->contains(Hash(70)));
+    EXPECT_TRUE(peers[71]->contains(Hash(71)));
+}
+
+TEST(SharedKnownFilter, Expires) {
+    FixedClock clock(std::chrono::seconds(1000));
+    CSharedKnownFilter shared(&clock, 60, 3);
+    CPeerKnownFilter peer(50000, 0.000001, &shared);
+
+    peer.insert(Hash(1));
+    clock.Set(std::chrono::seconds(1030));
+    peer.insert(Hash(2));
+
+    // Keys are forgotten once they are older than the expiry...
+    clock.Set(std::chrono::seconds(1061));
+    peer.insert(Hash(3));
+    EXPECT_FALSE(peer.contains(Hash(1)));
+    EXPECT_TRUE(peer.contains(Hash(2)));
+
+    // ... or the table is full.
+    peer.insert(Hash(4));
+    peer.insert(Hash(5));
+    EXPECT_EQ(shared.size(), 3);
+    EXPECT_FALSE(peer.contains(Hash(2)));
+    EXPECT_TRUE(peer.contains(Hash(5)));
+}
+
+TEST(SharedKnownFilter, OwnBloomFilterWithoutShared) {
+    CPeerKnownFilter peer(1000, 0.000001, nullptr);
+    peer.insert(Hash(1));
+    EXPECT_TRUE(peer.contains(Hash(1)));
+    EXPECT_FALSE(peer.contains(Hash(2)));
+    peer.reset();
+    EXPECT_FALSE(peer.contains(Hash(1)));
+}
@@ -1,16 +1,25 @@
 #include <gtest/gtest.h>
 #include <gtest/gtest-spi.h>
 
+#include "chainparams.h"
+#include "clientversion.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "fs.h"
 #include "main.h"
 #include "primitives/transaction.h"
+#include "streams.h"
 #include "txmempool.h"
 #include "util/system.h"
+#include "zip317.h"
+
+#include <fstream>
+#include <sstream>
 
 // Implementation is in test_checktransaction.cpp
 extern CMutableTransaction GetValidTransaction(uint32_t consensusBranchId=SPROUT_BRANCH_ID);
+extern std::atomic<bool> fRequestShutdown;
 
 // Fake the input of transaction 5295156213414ed77f6e538e7e8ebe14492156906b9fe995b242477818789364
 // - 532639cc6bebed47c1c69ae36dd498c68a012e74ad12729adbd3dbb56f8f3f4a, 0
@@ -203,6 +212,47 @@ TEST(Mempool, SproutV3TxWhenOverwinterActive) {
 }
 
 
+TEST(Mempool, PrecheckBeforeAcceptToMemoryPool) {
+    SelectParams(CBaseChainParams::REGTEST);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+
+    CTxMemPool pool(::minRelayTxFee);
+    bool missingInputs;
+    CMutableTransaction mtx = GetValidTransaction();
+    mtx.vJoinSplit.resize(0); // no joinsplits
+    mtx.fOverwintered = true;
+    mtx.nVersion = OVERWINTER_TX_VERSION;
+    mtx.nVersionGroupId = OVERWINTER_VERSION_GROUP_ID;
+    mtx.nExpiryHeight = 1;
+    CTransaction tx1(mtx);
+
+    // There is no active chain, so the next block height is 0.
+    MempoolPrecheck precheck;
+    CValidationState statePrecheck;
+    EXPECT_TRUE(PrecheckTransactionForMempool(Params(), tx1, 0, statePrecheck, precheck));
+    EXPECT_EQ(precheck.consensusBranchId, CurrentEpochBranchId(0, Params().GetConsensus()));
+
+    // The checks against the chain state and mempool policy still apply.
+    {
+        CValidationState state1;
+        LOCK(cs_main);
+        EXPECT_FALSE(AcceptToMemoryPool(Params(), pool, state1, tx1, false, &missingInputs, false, &precheck));
+        EXPECT_EQ(state1.GetRejectReason(), "tx-expiring-soon");
+    }
+
+    // The precheck rejects transactions the way AcceptToMemoryPool would.
+    mtx.fOverwintered = false;
+    mtx.nVersion = 3;
+    CTransaction tx2(mtx);
+    CValidationState state2;
+    EXPECT_FALSE(PrecheckTransactionForMempool(Params(), tx2, 0, state2, precheck));
+    EXPECT_EQ(state2.GetRejectReason(), "tx-overwintered-flag-not-set");
+
+    // Revert to default
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
+}
+
+
 // Subclass of CTransaction which doesn't call UpdateHash when constructing
 // from a CMutableTransaction.  This enables us to create a CTransaction
 // with bad values which normally trigger an exception during construction.
@@ -298,3 +348,277 @@ TEST(Mempool, ExpiringSoonTxRejection) {
     // Revert to default
     UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, Consensus::NetworkUpgrade::NO_ACTIVATION_HEIGHT);
 }
+
+TEST(Mempool, SnapshotFollowsChanges) {
+    CTxMemPool pool(CFeeRate(0));
+
+    CMutableTransaction mtxParent;
+    mtxParent.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    mtxParent.vout.emplace_back(1000, CScript() << OP_TRUE);
+    CTransaction parent(mtxParent);
+
+    CMutableTransaction mtxChild;
+    mtxChild.vin.emplace_back(COutPoint(parent.GetHash(), 0));
+    mtxChild.vout.emplace_back(900, CScript() << OP_TRUE);
+    CTransaction child(mtxChild);
+
+    pool.addUnchecked(parent.GetHash(), CTxMemPoolEntry(parent, 0, 0, 1, true, false, 1, SPROUT_BRANCH_ID));
+    auto snapshot1 = pool.GetSnapshot();
+    ASSERT_EQ(snapshot1->entries.size(), 1);
+    EXPECT_TRUE(snapshot1->parents[0].empty());
+
+    // An unchanged mempool shares its snapshot between readers.
+    EXPECT_EQ(pool.GetSnapshot(), snapshot1);
+
+    pool.addUnchecked(child.GetHash(), CTxMemPoolEntry(child, 100, 0, 1, false, false, 1, SPROUT_BRANCH_ID));
+    auto snapshot2 = pool.GetSnapshot();
+    EXPECT_NE(snapshot2, snapshot1);
+    ASSERT_EQ(snapshot2->entries.size(), 2);
+    // The child pays the higher fee rate, so it is sorted first.
+    EXPECT_EQ(snapshot2->entries[0].GetTx().GetHash(), child.GetHash());
+    EXPECT_EQ(snapshot2->entries[1].GetTx().GetHash(), parent.GetHash());
+    EXPECT_EQ(snapshot2->parents[0], std::vector<uint256>{parent.GetHash()});
+    EXPECT_TRUE(snapshot2->parents[1].empty());
+    // An earlier snapshot is not changed.
+    EXPECT_EQ(snapshot1->entries.size(), 1);
+
+    pool.PrioritiseTransaction(child.GetHash(), child.GetHash().ToString(), 50);
+    auto snapshot3 = pool.GetSnapshot();
+    EXPECT_EQ(snapshot3->entries[0].GetModifiedFee(), 150);
+
+    std::list<CTransaction> removed;
+    pool.remove(parent, removed, true);
+    EXPECT_TRUE(pool.GetSnapshot()->entries.empty());
+    EXPECT_EQ(snapshot3->entries.size(), 2);
+}
+
+TEST(Mempool, AddressSnapshotFollowsIndexChanges) {
+    CTxMemPool pool(CFeeRate(0));
+    FakeCoinsViewDB fakeDB;
+    CCoinsViewCache view(&fakeDB);
+
+    uint160 addressHash(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    mtx.vout.emplace_back(1000, CScript() << OP_DUP << OP_HASH160 << ToByteVector(addressHash) << OP_EQUALVERIFY << OP_CHECKSIG);
+    CTransaction tx(mtx);
+    CTxMemPoolEntry entry(tx, 0, 0, 1, true, false, 1, SPROUT_BRANCH_ID);
+
+    pool.addAddressIndex(entry, view);
+    pool.addSpentIndex(entry, view);
+    auto snapshot1 = pool.GetAddressSnapshot();
+
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> results;
+    snapshot1->getAddressIndex({{addressHash, CScript::P2PKH}}, results);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].first.txhash, tx.GetHash());
+    EXPECT_EQ(results[0].second.amount, 1000);
+
+    CSpentIndexValue value;
+    EXPECT_TRUE(snapshot1->getSpentIndex(CSpentIndexKey(uint256S("01"), 0), value));
+    EXPECT_EQ(value.txid, tx.GetHash());
+    EXPECT_FALSE(snapshot1->getSpentIndex(CSpentIndexKey(uint256S("01"), 1), value));
+
+    // Changes to the rest of the mempool keep the address snapshot.
+    pool.addUnchecked(tx.GetHash(), entry);
+    EXPECT_EQ(pool.GetAddressSnapshot(), snapshot1);
+
+    pool.removeAddressIndex(tx.GetHash());
+    pool.removeSpentIndex(tx.GetHash());
+    auto snapshot2 = pool.GetAddressSnapshot();
+    EXPECT_NE(snapshot2, snapshot1);
+    EXPECT_TRUE(snapshot2->addressIndex.empty());
+    EXPECT_TRUE(snapshot2->spentIndex.empty());
+    // An earlier snapshot is not changed.
+    EXPECT_EQ(snapshot1->addressIndex.size(), 1);
+}
+
+TEST(Mempool, DrainRecentlyAddedInBatches) {
+    CTxMemPool pool(CFeeRate(0));
+
+    std::vector<CTransaction> txs;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(GetRandHash(), 0));
+        mtx.vout.emplace_back(1000, CScript() << OP_TRUE);
+        txs.emplace_back(mtx);
+        pool.addUnchecked(txs.back().GetHash(), CTxMemPoolEntry(txs.back(), 0, 0, 1, true, false, 1, SPROUT_BRANCH_ID));
+    }
+
+    // The sequence number is withheld until the last transaction is taken.
+    EXPECT_EQ(pool.RecentlyAddedBacklog(), 3);
+    auto first = pool.DrainRecentlyAdded(2);
+    EXPECT_EQ(first.first.size(), 2);
+    EXPECT_EQ(first.second, 0);
+    EXPECT_EQ(pool.RecentlyAddedBacklog(), 1);
+
+    // The drained transactions are shared with the mempool, not copied.
+    EXPECT_EQ(first.first[0], pool.get(first.first[0]->GetHash()));
+
+    // A transaction removed before it is drained is not handed out.
+    std::set<uint256> drained;
+    for (const auto& ptx : first.first) {
+        drained.insert(ptx->GetHash());
+    }
+    for (const CTransaction& tx : txs) {
+        if (!drained.count(tx.GetHash())) {
+            std::list<CTransaction> removed;
+            pool.remove(tx, removed, true);
+        }
+    }
+    auto second = pool.DrainRecentlyAdded(2);
+    EXPECT_TRUE(second.first.empty());
+    EXPECT_EQ(second.second, 3);
+    EXPECT_EQ(pool.RecentlyAddedBacklog(), 0);
+}
+
+TEST(Mempool, StatsFollowChanges) {
+    CTxMemPool pool(CFeeRate(0));
+
+    CMutableTransaction mtx;
+    mtx.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    mtx.vout.emplace_back(1000, CScript() << OP_TRUE);
+    CTransaction tx(mtx);
+    CTxMemPoolEntry entry(tx, 0, 0, 1, true, false, 1, SPROUT_BRANCH_ID);
+    size_t txSize = entry.GetTxSize();
+
+    EXPECT_TRUE(pool.GetStats() == CTxMemPoolStats());
+
+    pool.addUnchecked(tx.GetHash(), entry);
+    CTxMemPoolStats stats = pool.GetStats();
+    EXPECT_EQ(stats.nTx, 1);
+    EXPECT_EQ(stats.nBytes, txSize);
+    EXPECT_EQ(stats.nFees, 0);
+    EXPECT_EQ(stats.feeRates[0].nTx, 1);
+    // A transaction paying no fee has no paid actions.
+    EXPECT_EQ(stats.nPaidActions, 0);
+    EXPECT_EQ(stats.unpaidActions[0], GRACE_ACTIONS);
+    EXPECT_EQ(stats.weightedBytes[0], txSize);
+
+    // Prioritising moves the transaction between buckets.
+    pool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), COIN);
+    stats = pool.GetStats();
+    EXPECT_EQ(stats.nTx, 1);
+    EXPECT_EQ(stats.nFees, COIN);
+    EXPECT_EQ(stats.feeRates[0].nTx, 0);
+    EXPECT_EQ(stats.feeRates.back().nTx, 1);
+    EXPECT_EQ(stats.feeRates.back().nFees, COIN);
+    EXPECT_EQ(stats.nPaidActions, GRACE_ACTIONS);
+    EXPECT_EQ(stats.unpaidActions[0], 0);
+    EXPECT_EQ(stats.weightedBytes[0], 0);
+    EXPECT_EQ(stats.weightedBytes[4], txSize);
+
+    std::list<CTransaction> removed;
+    pool.remove(tx, removed, true);
+    EXPECT_TRUE(pool.GetStats() == CTxMemPoolStats());
+}
+
+class MempoolPersistTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+
+    void SetUp() override {
+        SelectParams(CBaseChainParams::REGTEST);
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+    }
+
+    void TearDown() override {
+        fRequestShutdown = false;
+        mempool.clear();
+        {
+            LOCK(mempool.cs);
+            mempool.mapDeltas.clear();
+        }
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        fs::remove_all(pathTemp);
+        SelectParams(CBaseChainParams::MAIN);
+    }
+
+    static std::string ReadFile(const fs::path& path) {
+        std::ifstream f(path.string(), std::ios::binary);
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+    }
+};
+
+TEST_F(MempoolPersistTest, DumpWritesParentsBeforeChildren) {
+    // A chain whose fee rate rises towards the end, so that the mempool
+    // snapshot lists every child before its parent.
+    std::vector<CTransaction> chain;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(i == 0 ? COutPoint(uint256S("01"), 0) : COutPoint(chain.back().GetHash(), 0));
+        mtx.vout.emplace_back(1000, CScript() << OP_TRUE);
+        chain.emplace_back(mtx);
+        mempool.addUnchecked(chain.back().GetHash(), CTxMemPoolEntry(
+            chain.back(), 100 * (i + 1), 0, 1, i == 0, false, 1, SPROUT_BRANCH_ID));
+    }
+    auto snapshot = mempool.GetSnapshot();
+    ASSERT_EQ(snapshot->entries.size(), 3u);
+    ASSERT_EQ(snapshot->entries[0].GetTx().GetHash(), chain[2].GetHash());
+    ASSERT_EQ(snapshot->entries[2].GetTx().GetHash(), chain[0].GetHash());
+
+    // A delta for a transaction that is not in the mempool is saved too.
+    uint256 absent = uint256S("02");
+    mempool.PrioritiseTransaction(chain[1].GetHash(), chain[1].GetHash().ToString(), 5000);
+    mempool.PrioritiseTransaction(absent, absent.ToString(), -300);
+
+    ASSERT_TRUE(DumpMempool());
+    EXPECT_FALSE(fs::exists(GetDataDir() / "mempool.dat.new"));
+
+    CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "rb"), SER_DISK, CLIENT_VERSION);
+    ASSERT_FALSE(file.IsNull());
+    uint64_t version;
+    std::map<uint256, CAmount> mapDeltas;
+    uint64_t nTotal;
+    file >> version >> mapDeltas >> nTotal;
+    EXPECT_EQ(version, 1u);
+    EXPECT_EQ(mapDeltas, (std::map<uint256, CAmount>{{chain[1].GetHash(), 5000}, {absent, -300}}));
+    ASSERT_EQ(nTotal, chain.size());
+    for (const CTransaction& expected : chain) {
+        CTransaction tx;
+        file >> tx;
+        EXPECT_EQ(tx.GetHash(), expected.GetHash());
+    }
+}
+
+TEST_F(MempoolPersistTest, InterruptedLoadKeepsFile) {
+    // More transactions than one load batch; none of them can be accepted.
+    uint256 prioritised = uint256S("03");
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "wb"), SER_DISK, CLIENT_VERSION);
+        ASSERT_FALSE(file.IsNull());
+        file << (uint64_t)1;
+        file << std::map<uint256, CAmount>{{prioritised, 700}};
+        file << (uint64_t)300;
+        for (uint32_t i = 0; i < 300; i++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = i;
+            file << CTransaction(mtx);
+        }
+    }
+    std::string strSaved = ReadFile(GetDataDir() / "mempool.dat");
+
+    // A shutdown requested while loading stops after the current batch, and
+    // leaves the file for the next start.
+    fRequestShutdown = true;
+    EXPECT_FALSE(LoadMempool(Params()));
+    EXPECT_EQ(ReadFile(GetDataDir() / "mempool.dat"), strSaved);
+    {
+        LOCK(mempool.cs);
+        EXPECT_EQ(mempool.mapDeltas.at(prioritised), 700);
+        mempool.mapDeltas.clear();
+    }
+
+    fRequestShutdown = false;
+    EXPECT_TRUE(LoadMempool(Params()));
+    EXPECT_EQ(mempool.size(), 0u);
+    EXPECT_EQ(ReadFile(GetDataDir() / "mempool.dat"), strSaved);
+    LOCK(mempool.cs);
+    EXPECT_EQ(mempool.mapDeltas.at(prioritised), 700);
+}
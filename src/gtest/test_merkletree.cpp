@@ -163,6 +163,63 @@ TEST(merkletree, SaplingVectors) {
     );
 }
 
+template<typename Tree>
+void test_append_batch(UniValue commitment_tests, UniValue root_tests)
+{
+    typedef decltype(Tree::empty_root()) Hash;
+
+    vector<Hash> commitments;
+    for (size_t i = 0; i < 16; i++) {
+        commitments.push_back(uint256S(commitment_tests[i].get_str()));
+    }
+
+    // Split the commitments into a prefix appended one at a time, and two
+    // batches. Every split must produce the same tree as appending the
+    // commitments one at a time.
+    for (size_t prefix = 0; prefix <= 16; prefix++) {
+        for (size_t first = 0; prefix + first <= 16; first++) {
+            Tree expected;
+            Tree tree;
+            for (size_t i = 0; i < prefix; i++) {
+                expected.append(commitments[i]);
+                tree.append(commitments[i]);
+            }
+
+            auto batchStart = commitments.begin() + prefix;
+            tree.append_batch(vector<Hash>(batchStart, batchStart + first));
+            tree.append_batch(vector<Hash>(batchStart + first, commitments.end()));
+            for (size_t i = prefix; i < 16; i++) {
+                expected.append(commitments[i]);
+            }
+
+            ASSERT_TRUE(tree == expected);
+            ASSERT_TRUE(tree.size() == 16);
+            expect_test_vector(root_tests[15], tree.root());
+        }
+
+        // A batch that does not fit in the tree is rejected.
+        Tree tree;
+        for (size_t i = 0; i < prefix; i++) {
+            tree.append(commitments[i]);
+        }
+        ASSERT_THROW(tree.append_batch(vector<Hash>(17 - prefix)), std::runtime_error);
+    }
+}
+
+TEST(merkletree, AppendBatch) {
+    UniValue root_tests = read_json(MAKE_STRING(json_tests::merkle_roots));
+    UniValue commitment_tests = read_json(MAKE_STRING(json_tests::merkle_commitments));
+
+    test_append_batch<SproutTestingMerkleTree>(commitment_tests, root_tests);
+}
+
+TEST(merkletree, AppendBatchSapling) {
+    UniValue root_tests = read_json(MAKE_STRING(json_tests::merkle_roots_sapling));
+    UniValue commitment_tests = read_json(MAKE_STRING(json_tests::merkle_commitments_sapling));
+
+    test_append_batch<SaplingTestingMerkleTree>(commitment_tests, root_tests);
+}
+
 TEST(merkletree, emptyroots) {
     libzcash::EmptyMerkleRoots<64, libzcash::SHA256Compress> emptyroots;
     std::array<libzcash::SHA256Compress, 65> computed;
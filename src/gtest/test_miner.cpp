@@ -122,4 +122,21 @@ TEST(Miner, GetMinerAddress) {
         EXPECT_FALSE(IsValidMinerAddress(minerAddress));
     }
 }
+
+TEST(Miner, MinerNonceLayout) {
+    uint256 nonce = MinerNonce(0x11223344, 0x55667788, 0x0102030405060708);
+    const unsigned char* p = nonce.begin();
+    EXPECT_EQ(p[0], 0x08);
+    EXPECT_EQ(p[7], 0x01);
+    EXPECT_EQ(p[MINER_NONCE_SLOT_OFFSET], 0x88);
+    EXPECT_EQ(p[MINER_NONCE_HOST_OFFSET], 0x44);
+    for (int i = 16; i < 32; i++) {
+        EXPECT_EQ(p[i], 0);
+    }
+    EXPECT_EQ(MinerNonceCounter(nonce), 0x0102030405060708u);
+
+    // Neighbouring hosts and slots do not share nonces
+    EXPECT_NE(MinerNonce(0, 1, 5), MinerNonce(0, 2, 5));
+    EXPECT_NE(MinerNonce(1, 1, 5), MinerNonce(2, 1, 5));
+}
 #endif // ENABLE_MINING
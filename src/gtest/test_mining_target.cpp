@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include "arith_uint256.h"
+#include "mining_target.h"
+#include "random.h"
+#include "uint256.h"
+
+TEST(MiningTarget, FilterMatchesFullCompare) {
+    arith_uint256 target = UintToArith256(uint256S("00000fffff000000000000000000000000000000000000000000000000000000"));
+    MiningTarget filter(target);
+
+    for (int round = 0; round < 100; round++) {
+        uint256 hashes[4];
+        for (uint256& hash : hashes) {
+            hash = GetRandHash();
+        }
+        // Straddle the threshold: equal top 64 bits, just below and just above the target
+        hashes[1] = ArithToUint256(target);
+        hashes[2] = ArithToUint256(target - 1);
+        hashes[3] = ArithToUint256(target + 1);
+
+        uint32_t candidates = filter.Filter(hashes, 4);
+        for (int i = 0; i < 4; i++) {
+            bool meets = UintToArith256(hashes[i]) <= target;
+            EXPECT_EQ(filter.Meets(hashes[i]), meets);
+            // The filter may pass extra candidates, but never drops a solution
+            if (meets) {
+                EXPECT_TRUE(candidates & (1u << i));
+            }
+        }
+    }
+}
+
+TEST(MiningTarget, NearTargetShares) {
+    arith_uint256 target = UintToArith256(uint256S("0000000000ffff00000000000000000000000000000000000000000000000000"));
+    MiningTarget filter(target, 8);
+
+    uint256 hashes[3];
+    hashes[0] = ArithToUint256(target);             // meets the target, and so the share target
+    hashes[1] = ArithToUint256(target << 7);        // a share, not a block
+    hashes[2] = ArithToUint256((target << 8) << 1); // neither
+    EXPECT_EQ(filter.Filter(hashes, 3), 1u);
+    EXPECT_EQ(filter.GetShares(), 2u);
+    EXPECT_EQ(filter.TakeShares(), 2u);
+    EXPECT_EQ(filter.GetShares(), 0u);
+
+    // A share target beyond 2^256 saturates: every hash is a share
+    MiningTarget easy(~arith_uint256() >> 4, 8);
+    uint256 max = ArithToUint256(~arith_uint256());
+    easy.Filter(&max, 1);
+    EXPECT_EQ(easy.GetShares(), 1u);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "netbufferpool.h"
+
+TEST(RecvBufferPool, ReusesBuffers) {
+    RecvBufferPoolStats before = GetRecvBufferPoolStats();
+    {
+        CRecvBufferPool pool;
+
+        CSerializeData buffer;
+        pool.Acquire(buffer, 100);
+        EXPECT_EQ(buffer.size(), 0);
+        EXPECT_EQ(buffer.capacity(), RECV_BUFFER_SIZE_CLASSES[0]);
+        buffer.resize(100);
+        const char* data = buffer.data();
+
+        pool.Release(buffer);
+        EXPECT_EQ(buffer.capacity(), 0);
+        EXPECT_EQ(pool.PooledBytes(), RECV_BUFFER_SIZE_CLASSES[0]);
+
+        // The next message of that size class gets the same buffer.
+        CSerializeData buffer2;
+        pool.Acquire(buffer2, RECV_BUFFER_SIZE_CLASSES[0]);
+        EXPECT_EQ(buffer2.data(), data);
+        EXPECT_EQ(buffer2.size(), 0);
+        EXPECT_EQ(pool.PooledBytes(), 0);
+
+        // Messages too large for any size class are left to allocate.
+        CSerializeData large;
+        pool.Acquire(large, RECV_BUFFER_SIZE_CLASSES[RECV_BUFFER_SIZE_CLASS_COUNT - 1] + 1);
+        EXPECT_EQ(large.capacity(), 0);
+        large.resize(200000);
+        pool.Release(large);
+        EXPECT_EQ(pool.PooledBytes(), 0);
+
+        pool.Release(buffer2);
+
+        RecvBufferPoolStats stats = GetRecvBufferPoolStats();
+        EXPECT_EQ(stats.nAllocated - before.nAllocated, 1);
+        EXPECT_EQ(stats.nReused - before.nReused, 1);
+        EXPECT_EQ(stats.nUnpooled - before.nUnpooled, 1);
+        EXPECT_EQ(stats.nPooled - before.nPooled, 1);
+    }
+
+    // Pooled buffers are freed with their pool.
+    RecvBufferPoolStats after = GetRecvBufferPoolStats();
+    EXPECT_EQ(after.nPooled, before.nPooled);
+    EXPECT_EQ(after.nPooledBytes, before.nPooledBytes);
+}
+
+TEST(RecvBufferPool, Caps) {
+    CRecvBufferPool pool;
+
+    std::vector<CSerializeData> buffers(MAX_POOLED_RECV_BUFFERS_PER_CLASS + 1);
+    for (CSerializeData& buffer : buffers)
+        pool.Acquire(buffer, 1);
+    for (CSerializeData& buffer : buffers)
+        pool.Release(buffer);
+    EXPECT_EQ(pool.PooledBytes(), MAX_POOLED_RECV_BUFFERS_PER_CLASS * RECV_BUFFER_SIZE_CLASSES[0]);
+
+    // The largest buffers only fit while the peer's total stays under its cap.
+    size_t nLargest = RECV_BUFFER_SIZE_CLASSES[RECV_BUFFER_SIZE_CLASS_COUNT - 1];
+    std::vector<CSerializeData> largest(MAX_POOLED_RECV_BYTES / nLargest + 1);
+    for (CSerializeData& buffer : largest)
+        pool.Acquire(buffer, nLargest);
+    for (CSerializeData& buffer : largest)
+        pool.Release(buffer);
+    EXPECT_LE(pool.PooledBytes(), MAX_POOLED_RECV_BYTES);
+    EXPECT_GT(pool.PooledBytes(), MAX_POOLED_RECV_BYTES - nLargest);
+}
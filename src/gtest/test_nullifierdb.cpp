@@ -0,0 +1,150 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "chainparams.h"
+#include "coins.h"
+#include "fs.h"
+#include "nullifierset.h"
+#include "random.h"
+#include "txdb.h"
+#include "util/system.h"
+
+class NullifierDBTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+
+    void SetUp() override {
+        SelectParams(CBaseChainParams::REGTEST);
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+    }
+
+    void TearDown() override {
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        fs::remove_all(pathTemp);
+        SelectParams(CBaseChainParams::MAIN);
+    }
+};
+
+static CTransaction SpendSproutNullifier(const uint256& nf)
+{
+    CMutableTransaction mtx;
+    JSDescription jsd;
+    jsd.nullifiers[0] = nf;
+    mtx.vJoinSplit.push_back(jsd);
+    return CTransaction(mtx);
+}
+
+static void WriteNullifier(CCoinsViewDB& db, const uint256& nf, bool spent)
+{
+    CCoinsViewCache cache(&db);
+    cache.SetNullifiers(SpendSproutNullifier(nf), spent);
+    cache.SetBestBlock(GetRandHash());
+    ASSERT_TRUE(cache.Flush());
+}
+
+TEST_F(NullifierDBTest, SeparateDatabase)
+{
+    fs::path nullifierPath = GetDataDir() / "chainstate_nullifiers";
+    uint256 nf1 = GetRandHash();
+    uint256 nf2 = GetRandHash();
+    {
+        CCoinsViewDB db(1 << 20, false, false, 1 << 20);
+        EXPECT_TRUE(fs::exists(nullifierPath));
+        WriteNullifier(db, nf1, true);
+        WriteNullifier(db, nf2, true);
+        WriteNullifier(db, nf2, false);
+        EXPECT_TRUE(db.GetNullifier(nf1, SPROUT));
+        EXPECT_FALSE(db.GetNullifier(nf2, SPROUT));
+        EXPECT_FALSE(db.GetNullifier(nf1, SAPLING));
+    }
+    {
+        // Reopened without the separate database, the nullifiers are moved back.
+        CCoinsViewDB db(1 << 20);
+        EXPECT_FALSE(fs::exists(nullifierPath));
+        EXPECT_TRUE(db.GetNullifier(nf1, SPROUT));
+        EXPECT_FALSE(db.GetNullifier(nf2, SPROUT));
+        WriteNullifier(db, nf2, true);
+    }
+    {
+        // And moved out again when it is used once more.
+        CCoinsViewDB db(1 << 20, false, false, 1 << 20);
+        EXPECT_TRUE(db.GetNullifier(nf1, SPROUT));
+        EXPECT_TRUE(db.GetNullifier(nf2, SPROUT));
+    }
+    {
+        CCoinsViewDB db(1 << 20, false, true, 1 << 20);
+        EXPECT_FALSE(db.GetNullifier(nf1, SPROUT));
+    }
+}
+
+TEST_F(NullifierDBTest, BackgroundFlush)
+{
+    CCoinsViewDB db(1 << 20, false, false, 1 << 20);
+    CCoinsViewBackgroundFlush flush(&db);
+    CCoinsViewCache tip(&flush);
+
+    uint256 nf = GetRandHash();
+    tip.SetNullifiers(SpendSproutNullifier(nf), true);
+    tip.SetBestBlock(GetRandHash());
+    ASSERT_TRUE(tip.Flush());
+    EXPECT_TRUE(tip.GetNullifier(nf, SPROUT));
+    ASSERT_TRUE(flush.Sync());
+    EXPECT_TRUE(db.GetNullifier(nf, SPROUT));
+}
+
+TEST_F(NullifierDBTest, ResidentNullifiers)
+{
+    uint256 nf1 = GetRandHash();
+    uint256 nf2 = GetRandHash();
+    for (size_t nNullifierCacheSize : {0, 1 << 20}) {
+        {
+            CCoinsViewDB db(1 << 20, false, true, nNullifierCacheSize, true);
+            WriteNullifier(db, nf1, true);
+            WriteNullifier(db, nf2, true);
+            WriteNullifier(db, nf2, false);
+            EXPECT_TRUE(db.GetNullifier(nf1, SPROUT));
+            EXPECT_FALSE(db.GetNullifier(nf2, SPROUT));
+            EXPECT_FALSE(db.GetNullifier(nf1, ORCHARD));
+        }
+        {
+            // Loaded back from the database on opening
+            CCoinsViewDB db(1 << 20, false, false, nNullifierCacheSize, true);
+            EXPECT_TRUE(db.GetNullifier(nf1, SPROUT));
+            EXPECT_FALSE(db.GetNullifier(nf2, SPROUT));
+        }
+    }
+}
+
+TEST(NullifierSet, InsertErase)
+{
+    CNullifierSet set;
+    std::vector<uint256> vNullifiers;
+    // Collide in the low bits, so the probe runs are long.
+    for (int i = 0; i < 5000; i++) {
+        uint256 nf = GetRandHash();
+        *nf.begin() = 0;
+        vNullifiers.push_back(nf);
+        EXPECT_TRUE(set.Insert(nf));
+    }
+    EXPECT_TRUE(set.Insert(uint256()));
+    EXPECT_FALSE(set.Insert(vNullifiers[0]));
+    EXPECT_EQ(set.Size(), 5001);
+
+    for (size_t i = 0; i < vNullifiers.size(); i += 2) {
+        EXPECT_TRUE(set.Erase(vNullifiers[i]));
+    }
+    EXPECT_FALSE(set.Erase(vNullifiers[0]));
+    for (size_t i = 0; i < vNullifiers.size(); i++) {
+        EXPECT_EQ(set.Contains(vNullifiers[i]), i % 2 == 1);
+    }
+    EXPECT_TRUE(set.Contains(uint256()));
+    EXPECT_EQ(set.Size(), 2501);
+    EXPECT_FALSE(set.Contains(GetRandHash()));
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include "peerresources.h"
+
+TEST(PeerResources, CheapPeerKeepsItsTurns) {
+    CPeerResourceUsage usage;
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(usage.TakeTurn());
+        usage.AddMessage("inv", PEER_PROCESSING_QUANTUM / 10);
+    }
+    CPeerResourceStats stats = usage.GetStats();
+    EXPECT_EQ(stats.mapCpuTimePerMsgCmd["inv"], 100 * (PEER_PROCESSING_QUANTUM / 10));
+    EXPECT_EQ(stats.nTurnsSkipped, 0);
+}
+
+TEST(PeerResources, ExpensivePeerWaits) {
+    CPeerResourceUsage usage;
+    EXPECT_TRUE(usage.TakeTurn());
+    // Work worth three and a half quanta on top of the one it had.
+    usage.AddHeaderChecks(10, 3 * PEER_PROCESSING_QUANTUM);
+    usage.AddMessage("headers", PEER_PROCESSING_QUANTUM + PEER_PROCESSING_QUANTUM / 2);
+    EXPECT_FALSE(usage.TakeTurn());
+    EXPECT_FALSE(usage.TakeTurn());
+    EXPECT_FALSE(usage.TakeTurn());
+    EXPECT_TRUE(usage.TakeTurn());
+
+    CPeerResourceStats stats = usage.GetStats();
+    EXPECT_EQ(stats.nTurnsSkipped, 3);
+    EXPECT_EQ(stats.nHeadersVerified, 10);
+    EXPECT_EQ(stats.nVerifyTime, 3 * PEER_PROCESSING_QUANTUM);
+}
+
+TEST(PeerResources, CreditDoesNotBuildUp) {
+    CPeerResourceUsage usage;
+    for (int i = 0; i < 100; i++)
+        EXPECT_TRUE(usage.TakeTurn());
+    usage.AddDiskRead(2 * PEER_PROCESSING_QUANTUM * PEER_DISK_READ_BYTES_PER_MICRO);
+    EXPECT_FALSE(usage.TakeTurn());
+    EXPECT_TRUE(usage.TakeTurn());
+    EXPECT_EQ(usage.GetStats().nDiskReadBytes, 2 * PEER_PROCESSING_QUANTUM * PEER_DISK_READ_BYTES_PER_MICRO);
+}
+
+TEST(PeerResources, CommandsAreCapped) {
+    CPeerResourceUsage usage;
+    for (size_t i = 0; i < 2 * MAX_PEER_RESOURCE_COMMANDS; i++)
+        usage.AddMessage("cmd" + std::to_string(i), 1);
+    CPeerResourceStats stats = usage.GetStats();
+    EXPECT_EQ(stats.mapCpuTimePerMsgCmd.size(), MAX_PEER_RESOURCE_COMMANDS + 1);
+    EXPECT_EQ(stats.mapCpuTimePerMsgCmd["*other*"], MAX_PEER_RESOURCE_COMMANDS);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "perfhistory.h"
+
+#include <thread>
+
+static PerformanceSample Sample(int64_t nTime)
+{
+    PerformanceSample sample;
+    sample.nTime = nTime;
+    sample.nIntervalMillis = 1000;
+    sample.nThreads = 2;
+    sample.threadHashrate[0] = nTime;
+    sample.threadHashrate[1] = nTime + 1;
+    sample.hashrate = 2 * nTime + 1;
+    sample.nBlocksConnected = nTime % 3;
+    sample.nMempoolTx = nTime;
+    return sample;
+}
+
+TEST(PerformanceHistory, KeepsLatestSamples) {
+    CPerformanceHistory history(4);
+    EXPECT_TRUE(history.GetSamples(10).empty());
+
+    for (int64_t t = 1; t <= 3; t++)
+        history.Record(Sample(t));
+    auto samples = history.GetSamples(10);
+    ASSERT_EQ(samples.size(), 3);
+    EXPECT_EQ(samples[0].nTime, 1);
+    EXPECT_EQ(samples[2].nTime, 3);
+    EXPECT_EQ(samples[2].threadHashrate[1], 4);
+    EXPECT_EQ(samples[2].nMempoolTx, 3);
+
+    // Once full, the oldest samples are replaced.
+    for (int64_t t = 4; t <= 10; t++)
+        history.Record(Sample(t));
+    samples = history.GetSamples(10);
+    ASSERT_EQ(samples.size(), 4);
+    EXPECT_EQ(samples[0].nTime, 7);
+    EXPECT_EQ(samples[3].nTime, 10);
+
+    samples = history.GetSamples(2);
+    ASSERT_EQ(samples.size(), 2);
+    EXPECT_EQ(samples[0].nTime, 9);
+    EXPECT_TRUE(history.GetSamples(0).empty());
+}
+
+TEST(PerformanceHistory, ConsistentUnderConcurrentWrites) {
+    CPerformanceHistory history(8);
+    std::atomic<bool> fDone{false};
+    std::thread writer([&] {
+        for (int64_t t = 1; t <= 200000; t++)
+            history.Record(Sample(t));
+        fDone = true;
+    });
+
+    // Samples are never torn, and come out in order.
+    while (!fDone) {
+        int64_t nLast = 0;
+        for (const PerformanceSample& sample : history.GetSamples(8)) {
+            EXPECT_GT(sample.nTime, nLast);
+            EXPECT_EQ(sample.threadHashrate[0], (float)sample.nTime);
+            EXPECT_EQ(sample.hashrate, (float)(2 * sample.nTime + 1));
+            EXPECT_EQ(sample.nMempoolTx, (uint64_t)sample.nTime);
+            nLast = sample.nTime;
+        }
+    }
+    writer.join();
+}
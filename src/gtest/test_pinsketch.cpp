@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include "pinsketch.h"
+
+#include <algorithm>
+
+TEST(PinSketch, RecoversDifference) {
+    for (size_t nCapacity : {1, 2, 5, 20, 100}) {
+        for (size_t nDiff = 0; nDiff <= nCapacity; nDiff++) {
+            SCOPED_TRACE(testing::Message() << "capacity " << nCapacity << " difference " << nDiff);
+            CPinSketch a(nCapacity);
+            CPinSketch b(nCapacity);
+            std::vector<uint32_t> expected;
+            // Elements in both sets cancel out.
+            for (uint32_t i = 1; i <= 50; i++) {
+                a.Add(i * 0x01000193);
+                b.Add(i * 0x01000193);
+            }
+            for (uint32_t i = 0; i < nDiff; i++) {
+                uint32_t element = 0xdeadbeef * (i + 1) + i;
+                expected.push_back(element);
+                (i % 2 ? a : b).Add(element);
+            }
+            a.Merge(b);
+
+            std::vector<uint32_t> elements;
+            ASSERT_TRUE(a.Decode(elements));
+            std::sort(elements.begin(), elements.end());
+            std::sort(expected.begin(), expected.end());
+            EXPECT_EQ(elements, expected);
+        }
+    }
+}
+
+TEST(PinSketch, FailsBeyondCapacity) {
+    CPinSketch sketch(10);
+    for (uint32_t i = 1; i <= 11; i++)
+        sketch.Add(i * 0x9e3779b1);
+    std::vector<uint32_t> elements;
+    EXPECT_FALSE(sketch.Decode(elements));
+    EXPECT_TRUE(elements.empty());
+}
+
+TEST(PinSketch, Serialization) {
+    CPinSketch sketch(3);
+    sketch.Add(1);
+    sketch.Add(0x80000000);
+    std::vector<unsigned char> data = sketch.Serialize();
+    EXPECT_EQ(data.size(), 12);
+
+    CPinSketch copy(0);
+    ASSERT_TRUE(CPinSketch::Deserialize(data, copy));
+    EXPECT_EQ(copy.Capacity(), 3);
+    std::vector<uint32_t> elements;
+    ASSERT_TRUE(copy.Decode(elements));
+    std::sort(elements.begin(), elements.end());
+    EXPECT_EQ(elements, std::vector<uint32_t>({1, 0x80000000}));
+
+    data.pop_back();
+    EXPECT_FALSE(CPinSketch::Deserialize(data, copy));
+}
@@ -2,8 +2,11 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "crypto/randomx_wrapper.h"
 #include "pow.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "util/test.h"
 
 void TestDifficultyAveragingImpl(const Consensus::Params& params)
@@ -123,3 +126,207 @@ TEST(PoW, MinDifficultyRules) {
     EXPECT_EQ(GetNextWorkRequired(&blocks[lastBlk], &next, params),
               UintToArith256(params.powLimit).GetCompact());
 }
+
+TEST(PoW, RandomXSolutionCache) {
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    uint256 seedHash;
+    *seedHash.begin() = 0x08;
+
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = 1269211443;
+    header.nBits = 0x1e7fffff;
+    header.nNonce = GetRandHash();
+
+    CEquihashInput I{header};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << I;
+    ss << header.nNonce;
+    uint256 hash;
+    ASSERT_TRUE(RandomX_Hash_WithSeed(seedHash.begin(), 32, ss.data(), ss.size(), hash.begin()));
+    header.nSolution.assign(hash.begin(), hash.end());
+
+    uint64_t nHits, nMisses, nHitsBefore, nMissesBefore;
+    GetPoWCacheStats(nHitsBefore, nMissesBefore);
+
+    // The first check computes the hash, the second is answered by the cache.
+    EXPECT_TRUE(CheckRandomXSolutionWithSeed(&header, params, seedHash, 1));
+    GetPoWCacheStats(nHits, nMisses);
+    EXPECT_EQ(nHits, nHitsBefore);
+    EXPECT_EQ(nMisses, nMissesBefore + 1);
+
+    EXPECT_TRUE(CheckRandomXSolutionWithSeed(&header, params, seedHash, 1));
+    GetPoWCacheStats(nHits, nMisses);
+    EXPECT_EQ(nHits, nHitsBefore + 1);
+    EXPECT_EQ(nMisses, nMissesBefore + 1);
+
+    // The same header under a different seed is not a cache hit, and invalid
+    // solutions are never cached.
+    uint256 otherSeed = GetRandHash();
+    EXPECT_FALSE(CheckRandomXSolutionWithSeed(&header, params, otherSeed, 1));
+    EXPECT_FALSE(CheckRandomXSolutionWithSeed(&header, params, otherSeed, 1));
+    GetPoWCacheStats(nHits, nMisses);
+    EXPECT_EQ(nHits, nHitsBefore + 1);
+    EXPECT_EQ(nMisses, nMissesBefore + 3);
+}
+
+TEST(PoW, RandomXSolutionBatch) {
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    uint256 seedHash;
+    *seedHash.begin() = 0x08;
+
+    // Three valid headers and one with a wrong solution
+    std::vector<CBlockHeader> headers(4);
+    for (CBlockHeader& header : headers) {
+        header.nVersion = 4;
+        header.nTime = 1269211443;
+        header.nBits = 0x1e7fffff;
+        header.nNonce = GetRandHash();
+
+        CEquihashInput I{header};
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << I;
+        ss << header.nNonce;
+        uint256 hash;
+        ASSERT_TRUE(RandomX_Hash_WithSeed(seedHash.begin(), 32, ss.data(), ss.size(), hash.begin()));
+        header.nSolution.assign(hash.begin(), hash.end());
+    }
+    headers[2].nSolution[0] ^= 1;
+
+    std::vector<const CBlockHeader*> vHeaders;
+    for (const CBlockHeader& header : headers) {
+        vHeaders.push_back(&header);
+    }
+
+    // The batch gives the same answers as checking each header on its own
+    std::vector<bool> vValid;
+    EXPECT_FALSE(CheckRandomXSolutionsWithSeed(vHeaders, params, seedHash, vValid));
+    ASSERT_EQ(vValid.size(), 4);
+    EXPECT_TRUE(vValid[0]);
+    EXPECT_TRUE(vValid[1]);
+    EXPECT_FALSE(vValid[2]);
+    EXPECT_TRUE(vValid[3]);
+
+    // Valid headers were cached by the batch
+    uint64_t nHits, nMisses, nHitsBefore, nMissesBefore;
+    GetPoWCacheStats(nHitsBefore, nMissesBefore);
+    EXPECT_TRUE(CheckRandomXSolutionWithSeed(&headers[1], params, seedHash, 1));
+    EXPECT_FALSE(CheckRandomXSolutionWithSeed(&headers[2], params, seedHash, 1));
+    GetPoWCacheStats(nHits, nMisses);
+    EXPECT_EQ(nHits, nHitsBefore + 1);
+    EXPECT_EQ(nMisses, nMissesBefore + 1);
+
+    vHeaders.erase(vHeaders.begin() + 2);
+    EXPECT_TRUE(CheckRandomXSolutionsWithSeed(vHeaders, params, seedHash, vValid));
+}
+
+TEST(PoW, RegtestFastHash) {
+    Consensus::Params params = Params(CBaseChainParams::REGTEST).GetConsensus();
+    params.fPowFastHash = true;
+    uint256 seedHash;
+    *seedHash.begin() = 0x08;
+
+    std::vector<CBlockHeader> headers(3);
+    for (CBlockHeader& header : headers) {
+        header.nVersion = 4;
+        header.nTime = 1269211443;
+        header.nBits = 0x200f0f0f;
+        header.nNonce = GetRandHash();
+
+        CEquihashInput I{header};
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << I;
+        ss << header.nNonce;
+        uint256 hash;
+        ASSERT_TRUE(GetPoWHash(params, seedHash, ss.data(), ss.size(), hash));
+        header.nSolution.assign(hash.begin(), hash.end());
+    }
+
+    // The solution is the cheap hash, whatever the seed, and not RandomX.
+    // (RandomX is checked first, as valid solutions are cached by seed.)
+    EXPECT_FALSE(CheckRandomXSolutionWithSeed(&headers[0], Params(CBaseChainParams::MAIN).GetConsensus(), seedHash, 1));
+    EXPECT_TRUE(CheckRandomXSolutionWithSeed(&headers[0], params, seedHash, 1));
+    EXPECT_TRUE(CheckRandomXSolutionWithSeed(&headers[0], params, GetRandHash(), 1));
+    EXPECT_TRUE(CheckRandomXSolution(&headers[0], params));
+
+    headers[2].nSolution[0] ^= 1;
+    std::vector<const CBlockHeader*> vHeaders;
+    for (const CBlockHeader& header : headers) {
+        vHeaders.push_back(&header);
+    }
+    std::vector<bool> vValid;
+    EXPECT_FALSE(CheckRandomXSolutionsWithSeed(vHeaders, params, seedHash, vValid));
+    ASSERT_EQ(vValid.size(), 3);
+    EXPECT_TRUE(vValid[0]);
+    EXPECT_TRUE(vValid[1]);
+    EXPECT_FALSE(vValid[2]);
+}
+
+TEST(PoW, CachedAveragingWindowMatchesWalk) {
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+    const int nBlocks = 4 * params.nPowAveragingWindow;
+
+    // Two copies of a chain with varying difficulty; only the one whose
+    // blocks have hashes is cached.
+    std::vector<uint256> hashes(nBlocks);
+    std::vector<CBlockIndex> cached(nBlocks), uncached(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        hashes[i] = GetRandHash();
+        for (auto* blocks : {&cached, &uncached}) {
+            (*blocks)[i].pprev = i ? &(*blocks)[i - 1] : nullptr;
+            (*blocks)[i].nHeight = i;
+            (*blocks)[i].nTime = 1269211443 + i * params.PoWTargetSpacing(i) + GetRand(60);
+            (*blocks)[i].nBits = 0x1e7fffff - GetRand(0x10000);
+        }
+        uncached[i].nTime = cached[i].nTime;
+        uncached[i].nBits = cached[i].nBits;
+        cached[i].phashBlock = &hashes[i];
+    }
+
+    for (int i = 0; i < nBlocks; i++) {
+        EXPECT_EQ(GetNextWorkRequired(&cached[i], nullptr, params),
+                  GetNextWorkRequired(&uncached[i], nullptr, params)) << i;
+    }
+    // Again, now that every block's state is cached.
+    for (int i = 0; i < nBlocks; i++) {
+        EXPECT_EQ(GetNextWorkRequired(&cached[i], nullptr, params),
+                  GetNextWorkRequired(&uncached[i], nullptr, params)) << i;
+    }
+}
+
+TEST(PoW, CachedSeedHashFollowsBranch) {
+    // Two branches that fork between the first and second seed blocks.
+    const int nForkHeight = RANDOMX_SEEDHASH_EPOCH_BLOCKS + RANDOMX_SEEDHASH_EPOCH_BLOCKS / 2;
+    const int nBlocks = 2 * RANDOMX_SEEDHASH_EPOCH_BLOCKS + 2 * RANDOMX_SEEDHASH_EPOCH_LAG;
+    std::vector<uint256> hashesA(nBlocks), hashesB(nBlocks);
+    std::vector<CBlockIndex> branchA(nBlocks), branchB(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        hashesA[i] = GetRandHash();
+        hashesB[i] = GetRandHash();
+        branchA[i].pprev = i ? &branchA[i - 1] : nullptr;
+        branchA[i].nHeight = i;
+        branchA[i].phashBlock = &hashesA[i];
+        branchB[i].pprev = i <= nForkHeight ? branchA[i].pprev : &branchB[i - 1];
+        branchB[i].nHeight = i;
+        branchB[i].phashBlock = &hashesB[i];
+        branchA[i].BuildSkip();
+        branchB[i].BuildSkip();
+    }
+
+    // Query both branches in turn, twice, so that they evict each other.
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = nForkHeight + 1; i < nBlocks; i++) {
+            for (const CBlockIndex* pindex : {&branchA[i], &branchB[i]}) {
+                uint64_t nHeight = pindex->nHeight + 1;
+                uint256 seedHash;
+                ASSERT_TRUE(GetRandomXSeedHash(pindex, nHeight, seedHash));
+                EXPECT_EQ(seedHash, pindex->GetAncestor(RandomX_SeedHeight(nHeight))->GetBlockHash()) << i;
+            }
+        }
+    }
+    uint256 seedA, seedB;
+    ASSERT_TRUE(GetRandomXSeedHash(&branchA[nBlocks - 1], nBlocks, seedA));
+    ASSERT_TRUE(GetRandomXSeedHash(&branchB[nBlocks - 1], nBlocks, seedB));
+    EXPECT_NE(seedA, seedB);
+}
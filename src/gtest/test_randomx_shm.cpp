@@ -0,0 +1,133 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "crypto/randomx/dataset.hpp"
+#include "crypto/randomx/randomx.h"
+#include "crypto/randomx_shm.h"
+#include "fs.h"
+
+#ifndef WIN32
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class SharedDatasetTest : public ::testing::Test {
+protected:
+    fs::path pathTemp;
+    uint256 seedhash;
+
+    void SetUp() override {
+        pathTemp = fs::temp_directory_path() / fs::unique_path();
+        fs::create_directories(pathTemp);
+        ASSERT_TRUE(RandomX_SetSharedDatasetDir(pathTemp.string()));
+        *seedhash.begin() = 0x08;
+    }
+
+    void TearDown() override {
+        RandomX_SetSharedDatasetDir("");
+        fs::remove_all(pathTemp);
+    }
+
+    // Write a full-size (sparse) dataset file as another process would have
+    std::string Plant(SharedDatasetState state, mode_t mode) {
+        std::string path = RandomX_SharedDatasetPath(seedhash, -1);
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        EXPECT_GE(fd, 0);
+        size_t mapping_size = (SHARED_DATASET_HEADER_SIZE + randomx::DatasetSize + 4095) / 4096 * 4096;
+        EXPECT_EQ(ftruncate(fd, mapping_size), 0);
+
+        SharedDatasetHeader header{};
+        header.magic = SHARED_DATASET_MAGIC;
+        header.version = SHARED_DATASET_VERSION;
+        header.state.store(state);
+        header.dataset_size = randomx::DatasetSize;
+        header.mapping_size = mapping_size;
+        header.builder_pid = getpid();
+        header.node_id = -1;
+        memcpy(header.seedhash, seedhash.begin(), 32);
+        EXPECT_EQ(pwrite(fd, &header, sizeof(header), 0), (ssize_t)sizeof(header));
+        EXPECT_EQ(fchmod(fd, mode), 0);
+        close(fd);
+        return path;
+    }
+};
+
+TEST_F(SharedDatasetTest, FilesAreInPrivateDirectory) {
+    fs::path dir = fs::path(RandomX_SharedDatasetPath(seedhash, -1)).parent_path();
+    EXPECT_EQ(dir.parent_path(), pathTemp);
+    struct stat st;
+    ASSERT_EQ(lstat(dir.string().c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0700);
+    EXPECT_EQ(st.st_uid, geteuid());
+
+    // A subdirectory others can write to is not used.
+    ASSERT_EQ(chmod(dir.string().c_str(), 0777), 0);
+    EXPECT_FALSE(RandomX_SetSharedDatasetDir(pathTemp.string()));
+    EXPECT_FALSE(RandomX_SharedDatasetEnabled());
+    EXPECT_EQ(RandomX_SharedDatasetPath(seedhash, -1), "");
+}
+
+TEST_F(SharedDatasetTest, StaleFile) {
+    std::string path = Plant(SHARED_DATASET_BUILDING, 0600);
+    randomx_dataset* dataset = nullptr;
+
+    // While a builder holds its lock, we wait for it, even though the pid
+    // in the header (ours) would say nothing about whether it is alive.
+    int builder = open(path.c_str(), O_RDWR);
+    ASSERT_EQ(flock(builder, LOCK_EX), 0);
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, nullptr, 0, dataset), SharedDatasetAttach::FAILED);
+
+    // Once the builder is gone the unfinished file is stale.
+    close(builder);
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, nullptr, 0, dataset), SharedDatasetAttach::STALE);
+    EXPECT_TRUE(dataset == nullptr);
+
+    // So is a file for another seed, or one that was never sized.
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, uint256(), nullptr, 0, dataset), SharedDatasetAttach::STALE);
+    ASSERT_EQ(truncate(path.c_str(), 0), 0);
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, nullptr, 0, dataset), SharedDatasetAttach::STALE);
+}
+
+TEST_F(SharedDatasetTest, FileWritableByOthers) {
+    std::string path = Plant(SHARED_DATASET_READY, 0620);
+    randomx_dataset* dataset = nullptr;
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, nullptr, 0, dataset), SharedDatasetAttach::UNTRUSTED);
+
+    // Acquire builds privately, leaving the file alone.
+    bool fReady = true;
+    EXPECT_TRUE(RandomX_SharedDataset_Acquire(seedhash, -1, nullptr, fReady) == nullptr);
+    EXPECT_FALSE(fReady);
+    EXPECT_TRUE(fs::exists(path));
+}
+
+TEST_F(SharedDatasetTest, FileOwnedBySomeoneElse) {
+    if (geteuid() != 0) {
+        GTEST_SKIP() << "changing a file's owner needs root";
+    }
+    std::string path = Plant(SHARED_DATASET_READY, 0600);
+    ASSERT_EQ(chown(path.c_str(), 65534, 65534), 0);
+    randomx_dataset* dataset = nullptr;
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, nullptr, 0, dataset), SharedDatasetAttach::UNTRUSTED);
+    EXPECT_TRUE(dataset == nullptr);
+}
+
+TEST_F(SharedDatasetTest, CorruptReadyFile) {
+    // Published, but the dataset was never written: its items do not match
+    // those of the cache for the seed.
+    std::string path = Plant(SHARED_DATASET_READY, 0600);
+    randomx_cache* cache = randomx_alloc_cache(RANDOMX_FLAG_DEFAULT);
+    ASSERT_TRUE(cache != nullptr);
+    randomx_init_cache(cache, seedhash.begin(), 32);
+
+    randomx_dataset* dataset = nullptr;
+    EXPECT_EQ(RandomX_SharedDataset_Attach(path, seedhash, cache, 0, dataset), SharedDatasetAttach::STALE);
+    EXPECT_TRUE(dataset == nullptr);
+    randomx_release_cache(cache);
+}
+
+#endif // WIN32
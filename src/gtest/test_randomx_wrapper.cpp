@@ -0,0 +1,146 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "crypto/randomx/randomx.h"
+#include "crypto/randomx_wrapper.h"
+#include "random.h"
+#include "util/time.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const char INPUT[] = "RandomX wrapper test";
+
+class RandomXWrapperTest : public ::testing::Test {
+protected:
+    int64_t nTime = 1000;
+
+    void SetUp() override {
+        // Start from the genesis cache alone, on a clock that only moves when
+        // told to, so the order in which caches are evicted is known.
+        FixedClock::SetGlobal();
+        FixedClock::Instance()->Set(std::chrono::seconds(nTime));
+        RandomX_Shutdown();
+        RandomX_Init(false, false);
+    }
+
+    void TearDown() override {
+        RandomX_Shutdown();
+        RandomX_Init(false, false);
+        SystemClock::SetGlobal();
+    }
+
+    void Tick() {
+        FixedClock::Instance()->Set(std::chrono::seconds(++nTime));
+    }
+
+    static uint256 Hash(const uint256& seed) {
+        uint256 hash;
+        EXPECT_TRUE(RandomX_Hash_WithSeed(seed.begin(), 32, INPUT, sizeof(INPUT), hash.begin()));
+        return hash;
+    }
+
+    // The hash as computed without the wrapper
+    static uint256 ReferenceHash(randomx_cache* cache) {
+        randomx_vm* vm = randomx_create_vm(RANDOMX_FLAG_DEFAULT, cache, nullptr);
+        EXPECT_TRUE(vm != nullptr);
+        uint256 hash;
+        randomx_calculate_hash(vm, INPUT, sizeof(INPUT), hash.begin());
+        randomx_destroy_vm(vm);
+        return hash;
+    }
+
+    static randomx_cache* NewCache(const uint256& seed) {
+        randomx_cache* cache = randomx_alloc_cache(RANDOMX_FLAG_DEFAULT);
+        EXPECT_TRUE(cache != nullptr);
+        randomx_init_cache(cache, seed.begin(), 32);
+        return cache;
+    }
+
+    static bool HasCache(const uint256& seed) {
+        std::vector<RandomXSeedMemory> memory = RandomX_GetSeedMemory();
+        return std::any_of(memory.begin(), memory.end(), [&](const RandomXSeedMemory& entry) {
+            return !entry.dataset && entry.seedhash == seed;
+        });
+    }
+
+    static bool WaitForCache(const uint256& seed) {
+        for (int i = 0; i < 6000 && !HasCache(seed); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return HasCache(seed);
+    }
+};
+
+TEST_F(RandomXWrapperTest, PreparedSeedIsUsed) {
+    uint256 seed = GetRandHash();
+    RandomX_PrepareSeedHash(seed.begin(), 32);
+    ASSERT_TRUE(WaitForCache(seed));
+
+    // Hashing with the seed uses the prepared cache rather than building one.
+    int nCaches = RandomX_GetMemoryStats().caches;
+    uint256 hash = Hash(seed);
+    EXPECT_EQ(RandomX_GetMemoryStats().caches, nCaches);
+
+    randomx_cache* cache = NewCache(seed);
+    EXPECT_EQ(hash, ReferenceHash(cache));
+    randomx_release_cache(cache);
+}
+
+TEST_F(RandomXWrapperTest, VMIsRebuiltAfterItsCacheIsEvicted) {
+    uint256 seed = GetRandHash();
+    Tick();
+    uint256 hash = Hash(seed);
+
+    // Another thread hashes with five newer seeds, which evicts the genesis
+    // cache and then this one.
+    std::thread([this] {
+        for (int i = 0; i < 5; i++) {
+            Tick();
+            Hash(GetRandHash());
+        }
+    }).join();
+    EXPECT_FALSE(HasCache(seed));
+
+    // The evicted cache is kept for as long as this thread's VM holds it, but
+    // the next hash drops that VM and builds the seed's cache again, evicting
+    // the oldest of the other thread's.
+    int nCaches = RandomX_GetMemoryStats().caches;
+    Tick();
+    EXPECT_EQ(Hash(seed), hash);
+    EXPECT_TRUE(HasCache(seed));
+    EXPECT_EQ(RandomX_GetMemoryStats().caches, nCaches - 1);
+}
+
+TEST_F(RandomXWrapperTest, ShutdownDuringPrebuild) {
+    uint256 seed = GetRandHash();
+    randomx_cache* cache = NewCache(seed);
+    uint256 hash = ReferenceHash(cache);
+
+    // A dataset build under way when RandomX shuts down is abandoned, as is
+    // the preparation of a seed.
+    randomx_dataset* dataset = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
+    ASSERT_TRUE(dataset != nullptr);
+    bool fComplete = true;
+    std::thread builder([&] { fComplete = RandomX_InitDatasetParallel(dataset, cache, 2); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    RandomX_PrepareSeedHash(seed.begin(), 32);
+    RandomX_Shutdown();
+    builder.join();
+    EXPECT_FALSE(fComplete);
+    randomx_release_dataset(dataset);
+    randomx_release_cache(cache);
+
+    uint256 unused;
+    EXPECT_FALSE(RandomX_Hash_WithSeed(seed.begin(), 32, INPUT, sizeof(INPUT), unused.begin()));
+
+    // Initialized again, RandomX prepares the same seed and hashes with it.
+    RandomX_Init(false, false);
+    RandomX_PrepareSeedHash(seed.begin(), 32);
+    ASSERT_TRUE(WaitForCache(seed));
+    EXPECT_EQ(Hash(seed), hash);
+}
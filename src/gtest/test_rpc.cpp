@@ -107,3 +107,163 @@ TEST(rpc, ParseHeightArg) {
     ASSERT_THROW(parseHeightArg("-0x15", 21), UniValue);
     ASSERT_THROW(parseHeightArg("", 21), UniValue);
 }
+
+TEST(rpc, JSONStreamWriterMatchesUniValue) {
+    UniValue inner(UniValue::VOBJ);
+    inner.pushKV("a \"quoted\" key", "va\\lue\n");
+    inner.pushKV("empty", UniValue(UniValue::VARR));
+    inner.pushKV("null", NullUniValue);
+
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("inner", inner);
+    UniValue list(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        list.push_back(i);
+    }
+    list.push_back(inner);
+    expected.pushKV("list", list);
+    expected.pushKV("empty", UniValue(UniValue::VOBJ));
+
+    // A small chunk size makes the writer flush part way through.
+    std::vector<std::string> chunks;
+    JSONStreamWriter out([&](const std::string& chunk) { chunks.push_back(chunk); }, 16);
+    out.BeginObject();
+    out.Key("inner");
+    out.Value(inner);
+    out.Key("list");
+    out.BeginArray();
+    for (int i = 0; i < 100; i++) {
+        out.Value(i);
+    }
+    out.BeginObject();
+    for (size_t i = 0; i < inner.size(); i++) {
+        out.Key(inner.getKeys()[i]);
+        out.Value(inner.getValues()[i]);
+    }
+    out.EndObject();
+    out.EndArray();
+    out.Key("empty");
+    out.BeginObject();
+    out.EndObject();
+    out.EndObject();
+    EXPECT_TRUE(out.HasFlushed());
+    out.Flush();
+
+    EXPECT_GT(chunks.size(), 1);
+    std::string written;
+    for (const std::string& chunk : chunks) {
+        written += chunk;
+    }
+    EXPECT_EQ(written, expected.write());
+    EXPECT_TRUE(out.GetBuffer().empty());
+}
+
+TEST(rpc, JSONStreamWriterBuffersSmallOutput) {
+    bool fFlushed = false;
+    JSONStreamWriter out([&](const std::string&) { fFlushed = true; });
+    out.BeginArray();
+    out.Value("x");
+    out.EndArray();
+    EXPECT_FALSE(fFlushed);
+    EXPECT_FALSE(out.HasFlushed());
+    EXPECT_EQ(out.GetBuffer(), "[\"x\"]");
+}
+
+TEST(rpc, JSONStreamWriterRawValues) {
+    UniValue big(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        big.push_back(i);
+    }
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("small", "x");
+    expected.pushKV("big", big);
+
+    std::vector<std::string> chunks;
+    JSONStreamWriter out([&](const std::string& chunk) { chunks.push_back(chunk); }, 64);
+    out.BeginObject();
+    out.Key("small");
+    out.Raw("\"x\"");
+    EXPECT_FALSE(out.HasFlushed());
+    out.Key("big");
+    // Passed on whole as its own chunk
+    out.Raw(big.write());
+    EXPECT_TRUE(out.HasFlushed());
+    EXPECT_EQ(chunks.back(), big.write());
+    out.EndObject();
+    out.Flush();
+
+    std::string written;
+    for (const std::string& chunk : chunks) {
+        written += chunk;
+    }
+    EXPECT_EQ(written, expected.write());
+}
+
+TEST(rpc, AsyncCallResumesAndFinishesOnce) {
+    // Without blocking threads or a worker pool, every step runs in place.
+    std::vector<std::string> replies;
+    auto collect = [&](const RPCResultWriter& writeResult) {
+        std::string written;
+        JSONStreamWriter out([&](const std::string& chunk) { written += chunk; });
+        try {
+            writeResult(out);
+            out.Flush();
+        } catch (const UniValue& objError) {
+            written = "error " + find_value(objError, "message").get_str();
+        }
+        replies.push_back(written);
+    };
+
+    auto call = std::make_shared<RPCAsyncCall>(collect);
+    auto value = std::make_shared<int>(0);
+    call->Await([value] { *value = 42; }, [call, value] { call->Finish(UniValue(*value)); });
+    call->Finish(UniValue(7));
+    ASSERT_EQ(replies.size(), 1);
+    EXPECT_EQ(replies[0], "42");
+
+    // An error in the blocking step ends the call without resuming it.
+    replies.clear();
+    bool fResumed = false;
+    call = std::make_shared<RPCAsyncCall>(collect);
+    call->Await([] { throw std::runtime_error("disk went away"); }, [&] { fResumed = true; });
+    EXPECT_FALSE(fResumed);
+    ASSERT_EQ(replies.size(), 1);
+    EXPECT_EQ(replies[0], "error disk went away");
+}
+
+TEST(rpc, JSONRequestParseFastMatchesParse) {
+    const std::vector<std::string> requests = {
+        "{\"jsonrpc\":\"1.0\",\"id\":\"curltest\",\"method\":\"getblockcount\",\"params\":[]}",
+        " { \"method\" : \"getblock\" , \"params\" : [ \"00ab\", 2 ], \"id\": 7 } \n",
+        "{\"method\":\"getinfo\",\"params\":null,\"id\":{\"n\":[1,\"]}\"]}}",
+        "{\"method\":\"getinfo\",\"id\":1,\"id\":2}",
+    };
+    for (const std::string& strRequest : requests) {
+        UniValue valRequest;
+        ASSERT_TRUE(valRequest.read(strRequest));
+        JSONRequest expected;
+        expected.parse(valRequest);
+
+        JSONRequest jreq;
+        ASSERT_TRUE(jreq.parseFast(strRequest)) << strRequest;
+        EXPECT_EQ(jreq.strMethod, expected.strMethod);
+        EXPECT_EQ(jreq.params.write(), expected.params.write());
+        EXPECT_EQ(jreq.id.write(), expected.id.write());
+    }
+
+    // Left to the full parser, which reports what is wrong
+    const std::vector<std::string> others = {
+        "[{\"method\":\"getinfo\"}]",
+        "{}",
+        "{\"params\":[]}",
+        "{\"method\":1}",
+        "{\"method\":\"getinfo\",\"params\":{\"a\":1}}",
+        "{\"method\":\"getinfo\",\"params\":[}",
+        "{\"method\":\"getinfo\"} trailing",
+    };
+    for (const std::string& strRequest : others) {
+        JSONRequest jreq;
+        EXPECT_FALSE(jreq.parseFast(strRequest)) << strRequest;
+        EXPECT_TRUE(jreq.strMethod.empty());
+    }
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include <gtest/gtest.h>
+
+#include "chainparams.h"
+#include "consensus/upgrades.h"
+#include "consensus/validation.h"
+#include "gtest/utils.h"
+#include "main.h"
+#include "random.h"
+#include "shieldedbatch.h"
+#include "transaction_builder.h"
+#include "util/test.h"
+#include "zcash/address/mnemonic.h"
+
+#include <condition_variable>
+#include <mutex>
+
+static CTransaction BuildOrchardTransaction(CBasicKeyStore& keystore)
+{
+    CKey tsk = AddTestCKeyToKeyStore(keystore);
+    auto scriptPubKey = GetScriptForDestination(tsk.GetPubKey().GetID());
+
+    auto coinType = Params().BIP44CoinType();
+    auto seed = MnemonicSeed::Random(coinType);
+    auto sk = libzcash::OrchardSpendingKey::ForAccount(seed, coinType, 0);
+    libzcash::diversifier_index_t j(0);
+    auto recipient = sk.ToFullViewingKey().ToIncomingViewingKey().Address(j);
+
+    auto builder = TransactionBuilder(Params(), 1, uint256(), SaplingMerkleTree::empty_root(), &keystore);
+    builder.AddTransparentInput(COutPoint(GetRandHash(), 0), scriptPubKey, 5000);
+    builder.AddOrchardOutput(std::nullopt, recipient, 4000, std::nullopt);
+    return builder.Build().GetTxOrThrow();
+}
+
+TEST(ShieldedBatchVerifier, FindsInvalidTransactionInBatch)
+{
+    LoadProofParameters();
+    RegtestActivateNU5();
+
+    CBasicKeyStore keystore;
+    std::vector<std::shared_ptr<CShieldedAuthCheck>> checks;
+    for (int i = 0; i < 3; i++) {
+        CTransaction tx = BuildOrchardTransaction(keystore);
+        MempoolPrecheck precheck;
+        CValidationState state;
+        std::shared_ptr<CShieldedAuthCheck> check;
+        ASSERT_TRUE(PrecheckTransactionForMempool(Params(), tx, 2, state, precheck, &check));
+        ASSERT_TRUE(check);
+        EXPECT_FALSE(check->IsDone());
+        checks.push_back(check);
+    }
+
+    // The same bundle checked against a different sighash is invalid.
+    checks.push_back(std::make_shared<CShieldedAuthCheck>(
+        checks[1]->tx, checks[1]->consensusBranchId, GetRandHash(), 10));
+
+    CShieldedBatchVerifier::VerifyBatch(checks);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(checks[i]->IsDone());
+        EXPECT_TRUE(checks[i]->IsValid());
+    }
+    EXPECT_TRUE(checks[3]->IsDone());
+    EXPECT_FALSE(checks[3]->IsValid());
+    EXPECT_EQ(checks[3]->GetState().GetRejectReason(), "bad-orchard-bundle-authorization");
+
+    RegtestDeactivateNU5();
+}
+
+TEST(ShieldedBatchVerifier, VerifiesSubmittedChecks)
+{
+    LoadProofParameters();
+
+    std::mutex cs;
+    std::condition_variable cond;
+    int nNotified = 0;
+    std::vector<std::shared_ptr<CShieldedAuthCheck>> checks;
+    {
+        CShieldedBatchVerifier verifier(2, std::chrono::seconds(10), [&]() {
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                nNotified++;
+            }
+            cond.notify_all();
+        });
+        for (int i = 0; i < 3; i++) {
+            checks.push_back(std::make_shared<CShieldedAuthCheck>(
+                CTransaction(), SPROUT_BRANCH_ID, GetRandHash(), 10));
+            verifier.Submit(checks.back());
+        }
+
+        // A full batch does not wait for the window to close.
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [&]() { return nNotified > 0; });
+        }
+        EXPECT_TRUE(checks[0]->IsDone());
+        EXPECT_TRUE(checks[1]->IsDone());
+    }
+
+    // Checks still queued are verified before the verifier is destroyed.
+    for (const auto& check : checks) {
+        EXPECT_TRUE(check->IsDone());
+        EXPECT_TRUE(check->IsValid());
+    }
+}
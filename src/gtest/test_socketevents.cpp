@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "socketevents.h"
+
+#include <algorithm>
+
+#ifndef WIN32
+
+TEST(SocketEvents, ModeNamesRoundTrip) {
+    for (SocketEventsMode mode : GetSupportedSocketEventsModes()) {
+        EXPECT_EQ(ParseSocketEventsMode(GetSocketEventsModeName(mode)), mode);
+    }
+    EXPECT_EQ(GetSupportedSocketEventsModes().back(), SocketEventsMode::Select);
+    EXPECT_FALSE(ParseSocketEventsMode("poll").has_value());
+}
+
+TEST(SocketEvents, ReportsReadiness) {
+    for (SocketEventsMode mode : GetSupportedSocketEventsModes()) {
+        SCOPED_TRACE(GetSocketEventsModeName(mode));
+        auto socketEvents = MakeSocketEvents(mode);
+        ASSERT_TRUE(socketEvents);
+        EXPECT_EQ(socketEvents->Mode(), mode);
+
+        int sv[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+        ASSERT_TRUE(socketEvents->Register(sv[0], 42));
+
+        // A fresh socket can be written to.
+        std::vector<SocketEvent> events;
+        socketEvents->Watch(sv[0], 42, true, true);
+        ASSERT_TRUE(socketEvents->Wait(1000, events));
+        ASSERT_EQ(events.size(), 1);
+        EXPECT_EQ(events[0].tag, 42);
+        EXPECT_FALSE(events[0].fRecv);
+        EXPECT_TRUE(events[0].fSend);
+
+        // Once that is known, nothing more is reported until data arrives.
+        socketEvents->Watch(sv[0], 42, true, false);
+        ASSERT_TRUE(socketEvents->Wait(0, events));
+        EXPECT_TRUE(events.empty());
+
+        ASSERT_EQ(write(sv[1], "x", 1), 1);
+        socketEvents->Watch(sv[0], 42, true, false);
+        ASSERT_TRUE(socketEvents->Wait(1000, events));
+        ASSERT_EQ(events.size(), 1);
+        EXPECT_EQ(events[0].tag, 42);
+        EXPECT_TRUE(events[0].fRecv);
+
+        // Closing the peer is reported as readable, so that recv() sees it.
+        char buf;
+        ASSERT_EQ(read(sv[0], &buf, 1), 1);
+        close(sv[1]);
+        socketEvents->Watch(sv[0], 42, true, false);
+        ASSERT_TRUE(socketEvents->Wait(1000, events));
+        EXPECT_TRUE(std::any_of(events.begin(), events.end(), [](const SocketEvent& event) { return event.fRecv; }));
+        close(sv[0]);
+    }
+}
+
+#endif // WIN32
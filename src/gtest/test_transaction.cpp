@@ -91,3 +91,25 @@ TEST(Transaction, JSDescriptionRandomized) {
         EXPECT_EQ(expectedOutputMap, outputMap);
     }
 }
+
+TEST(Transaction, TotalSizeIsCached) {
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vout.resize(3);
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    CTransaction tx(mtx);
+    EXPECT_EQ(tx.GetTotalSize(), ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+
+    CTransaction empty;
+    EXPECT_EQ(empty.GetTotalSize(), ::GetSerializeSize(empty, SER_NETWORK, PROTOCOL_VERSION));
+
+    // Assignment and deserialization carry the size along with the hashes.
+    empty = tx;
+    EXPECT_EQ(empty.GetTotalSize(), tx.GetTotalSize());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tx;
+    CTransaction tx2;
+    ss >> tx2;
+    EXPECT_EQ(tx2.GetTotalSize(), tx.GetTotalSize());
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include "tinyformat.h"
+#include "txreconciliation.h"
+#include "uint256.h"
+
+#include <algorithm>
+
+static CInv TxInv(int i)
+{
+    return CInv(MSG_TX, uint256S(strprintf("%064x", i)));
+}
+
+TEST(TxReconciliation, ShortIdsAgree) {
+    CTxReconciliationState initiator(true, 1, 2);
+    CTxReconciliationState responder(false, 2, 1);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(initiator.GetShortTxId(TxInv(i)), responder.GetShortTxId(TxInv(i)));
+        EXPECT_NE(initiator.GetShortTxId(TxInv(i)), 0);
+    }
+    // Other salts give other short IDs.
+    CTxReconciliationState other(true, 1, 3);
+    EXPECT_NE(initiator.GetShortTxId(TxInv(0)), other.GetShortTxId(TxInv(0)));
+}
+
+TEST(TxReconciliation, Round) {
+    CTxReconciliationState initiator(true, 1, 2);
+    CTxReconciliationState responder(false, 2, 1);
+    // Both have 0..99, the initiator also 100..104 and the responder 200..202.
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(initiator.Add(TxInv(i)));
+        EXPECT_TRUE(responder.Add(TxInv(i)));
+    }
+    for (int i = 100; i < 105; i++)
+        EXPECT_TRUE(initiator.Add(TxInv(i)));
+    for (int i = 200; i < 203; i++)
+        EXPECT_TRUE(responder.Add(TxInv(i)));
+
+    initiator.StartRound(0);
+    responder.StartRound(0);
+    size_t nCapacity = ComputeSketchCapacity(responder.setRound.size(), initiator.setRound.size(), DEFAULT_TXRECONCILIATION_Q);
+    EXPECT_EQ(nCapacity, 2 + 103 / 4 + 1);
+    std::vector<unsigned char> vSketch = BuildTxReconciliationSketch(responder.setRound, nCapacity);
+
+    std::vector<CInv> vAnnounce;
+    std::vector<uint32_t> vAsk;
+    ASSERT_TRUE(ReconcileTxSketch(initiator.setRound, vSketch, vAnnounce, vAsk));
+    std::vector<uint256> vAnnounced;
+    for (const CInv& inv : vAnnounce)
+        vAnnounced.push_back(inv.hash);
+    std::sort(vAnnounced.begin(), vAnnounced.end());
+    std::vector<uint256> vExpected;
+    for (int i = 100; i < 105; i++)
+        vExpected.push_back(TxInv(i).hash);
+    std::sort(vExpected.begin(), vExpected.end());
+    EXPECT_EQ(vAnnounced, vExpected);
+
+    std::sort(vAsk.begin(), vAsk.end());
+    std::vector<uint32_t> vExpectedAsk;
+    for (int i = 200; i < 203; i++)
+        vExpectedAsk.push_back(responder.GetShortTxId(TxInv(i)));
+    std::sort(vExpectedAsk.begin(), vExpectedAsk.end());
+    EXPECT_EQ(vAsk, vExpectedAsk);
+
+    EXPECT_EQ(initiator.EndRound().size(), 105);
+    EXPECT_FALSE(initiator.fRoundInProgress);
+
+    // A difference larger than the sketch fails to decode.
+    CTxReconciliationState busy(true, 1, 2);
+    for (int i = 300; i < 300 + (int)nCapacity + 1; i++)
+        busy.Add(TxInv(i));
+    EXPECT_FALSE(ReconcileTxSketch(busy.setPending, BuildTxReconciliationSketch({}, nCapacity), vAnnounce, vAsk));
+}
+
+TEST(TxReconciliation, UnfinishedRound) {
+    CTxReconciliationState state(false, 1, 2);
+    state.Add(TxInv(1));
+    state.StartRound(0);
+    state.Add(TxInv(2));
+    // The peer never finished the first round, so both go in the second.
+    state.StartRound(1);
+    EXPECT_EQ(state.setRound.size(), 2);
+    EXPECT_TRUE(state.setPending.empty());
+}
+
+TEST(TxReconciliation, SetLimit) {
+    CTxReconciliationState state(false, 1, 2);
+    for (size_t i = 0; i < MAX_TXRECONCILIATION_SET_SIZE; i++)
+        EXPECT_TRUE(state.Add(TxInv(i)));
+    EXPECT_FALSE(state.Add(TxInv(MAX_TXRECONCILIATION_SET_SIZE)));
+    // Malformed sketches are rejected.
+    std::vector<CInv> vAnnounce;
+    std::vector<uint32_t> vAsk;
+    EXPECT_FALSE(ReconcileTxSketch(state.setPending, std::vector<unsigned char>(3), vAnnounce, vAsk));
+    EXPECT_FALSE(ReconcileTxSketch(state.setPending, std::vector<unsigned char>(), vAnnounce, vAsk));
+}
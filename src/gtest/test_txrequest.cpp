@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "tinyformat.h"
+#include "txrequest.h"
+#include "uint256.h"
+
+static CInv TxInv(int i)
+{
+    return CInv(MSG_TX, uint256S(strprintf("%064x", i)));
+}
+
+static WTxId TxId(int i)
+{
+    CInv inv = TxInv(i);
+    return WTxId(inv.hash, inv.hashAux);
+}
+
+TEST(TxRequest, AskOneAnnouncerAtATime) {
+    CTxRequestTracker tracker;
+    // Peer 1 is inbound, peer 2 outbound; peer 1 announced first.
+    EXPECT_TRUE(tracker.ReceivedInv(1, TxInv(0), false, 0));
+    EXPECT_TRUE(tracker.ReceivedInv(2, TxInv(0), true, 0));
+    EXPECT_FALSE(tracker.ReceivedInv(2, TxInv(0), true, 0));
+    EXPECT_EQ(tracker.Size(), 1);
+
+    // The outbound peer is asked right away, the inbound one not at all.
+    EXPECT_TRUE(tracker.GetRequestable(1, TX_REQUEST_NONPREF_DELAY).empty());
+    std::vector<CInv> vRequest = tracker.GetRequestable(2, TX_REQUEST_NONPREF_DELAY);
+    ASSERT_EQ(vRequest.size(), 1);
+    EXPECT_EQ(vRequest[0], TxInv(0));
+    EXPECT_EQ(tracker.CountInFlight(2), 1);
+    EXPECT_TRUE(tracker.GetRequestable(1, TX_REQUEST_NONPREF_DELAY + 1).empty());
+
+    // notfound from peer 2 passes the request on to peer 1.
+    tracker.ReceivedResponse(2, TxId(0));
+    EXPECT_EQ(tracker.CountInFlight(2), 0);
+    EXPECT_EQ(tracker.GetRequestable(1, TX_REQUEST_NONPREF_DELAY + 2).size(), 1);
+
+    // Having the transaction forgets it everywhere.
+    tracker.ForgetTx(TxId(0));
+    EXPECT_EQ(tracker.Size(), 0);
+    EXPECT_EQ(tracker.CountInFlight(1), 0);
+    EXPECT_EQ(tracker.CountAnnounced(1), 0);
+    EXPECT_EQ(tracker.CountAnnounced(2), 0);
+}
+
+TEST(TxRequest, InboundDelay) {
+    CTxRequestTracker tracker;
+    tracker.ReceivedInv(1, TxInv(0), false, 1000);
+    EXPECT_TRUE(tracker.GetRequestable(1, 1000).empty());
+    EXPECT_TRUE(tracker.GetRequestable(1, 1000 + TX_REQUEST_NONPREF_DELAY - 1).empty());
+    EXPECT_EQ(tracker.GetRequestable(1, 1000 + TX_REQUEST_NONPREF_DELAY).size(), 1);
+}
+
+TEST(TxRequest, Timeout) {
+    CTxRequestTracker tracker;
+    tracker.ReceivedInv(1, TxInv(0), true, 0);
+    tracker.ReceivedInv(2, TxInv(0), true, 0);
+    ASSERT_EQ(tracker.GetRequestable(1, 0).size(), 1);
+    EXPECT_TRUE(tracker.GetRequestable(2, TX_REQUEST_TIMEOUT - 1).empty());
+
+    // Peer 1 did not deliver in time, so peer 2 is asked.
+    EXPECT_EQ(tracker.GetRequestable(2, TX_REQUEST_TIMEOUT).size(), 1);
+    EXPECT_EQ(tracker.CountInFlight(1), 0);
+
+    // Once the last announcer times out too, the transaction is forgotten.
+    EXPECT_TRUE(tracker.GetRequestable(2, 2 * TX_REQUEST_TIMEOUT).empty());
+    EXPECT_EQ(tracker.Size(), 0);
+}
+
+TEST(TxRequest, Disconnect) {
+    CTxRequestTracker tracker;
+    tracker.ReceivedInv(1, TxInv(0), true, 0);
+    tracker.ReceivedInv(2, TxInv(0), true, 0);
+    ASSERT_EQ(tracker.GetRequestable(1, 0).size(), 1);
+    EXPECT_TRUE(tracker.GetRequestable(2, 0).empty());
+
+    tracker.DisconnectedPeer(1);
+    EXPECT_EQ(tracker.GetRequestable(2, 1).size(), 1);
+    tracker.DisconnectedPeer(2);
+    EXPECT_EQ(tracker.Size(), 0);
+}
+
+TEST(TxRequest, InFlightLimit) {
+    CTxRequestTracker tracker;
+    for (int i = 0; i < (int)MAX_PEER_TX_REQUEST_IN_FLIGHT + 10; i++)
+        tracker.ReceivedInv(1, TxInv(i), true, 0);
+    EXPECT_EQ(tracker.GetRequestable(1, 0).size(), MAX_PEER_TX_REQUEST_IN_FLIGHT);
+    EXPECT_TRUE(tracker.GetRequestable(1, 1).empty());
+
+    // Each delivery makes room for one more.
+    tracker.ReceivedResponse(1, TxId(0));
+    tracker.ForgetTx(TxId(0));
+    EXPECT_EQ(tracker.GetRequestable(1, 2).size(), 1);
+
+    // Announcements beyond the limit on remembered transactions are ignored.
+    for (int i = 1000; i < 1000 + (int)MAX_PEER_TX_ANNOUNCEMENTS; i++)
+        tracker.ReceivedInv(2, TxInv(i), true, 0);
+    EXPECT_FALSE(tracker.ReceivedInv(2, TxInv(0), true, 0));
+    EXPECT_EQ(tracker.CountAnnounced(2), MAX_PEER_TX_ANNOUNCEMENTS);
+}
@@ -4,7 +4,10 @@
 #include "consensus/merkle.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
+#include "crypto/randomx_wrapper.h"
 #include "main.h"
+#include "pow.h"
+#include "random.h"
 #include "transaction_builder.h"
 #include "util/test.h"
 
@@ -25,6 +28,45 @@ extern bool ReceivedBlockTransactions(
 extern void EnsureUnreferencedAsKeyOfMapBlocksUnlinked(
     const CBlockIndex *pindex);
 
+extern bool PreValidateBlock(
+    const CBlock& block,
+    bool fCheckProofs,
+    const CChainParams& chainparams);
+
+extern bool TakeBlockPreValidated(
+    const uint256& hash,
+    bool fCheckProofs);
+
+extern bool PreverifyHeadersPoW(
+    const std::vector<CBlockHeader>& headers,
+    const CChainParams& chainparams,
+    CPeerResourceUsage* pusage);
+
+extern bool AcceptBlockHeader(
+    const CBlockHeader& block,
+    CValidationState& state,
+    const CChainParams& chainparams,
+    CBlockIndex** ppindex,
+    bool fPoWPreverified);
+
+extern void InitializeNode(
+    NodeId nodeid,
+    const CNode *pnode);
+
+extern void AddHeadersSegment(
+    int nStartHeight,
+    const uint256& hashStart,
+    int nEndHeight,
+    const uint256& hashEnd);
+
+extern bool ProcessHeadersSegment(
+    CNode* pfrom,
+    const std::vector<CBlockHeader>& headers,
+    bool& fContinueSync);
+
+extern void LinkHeadersSegments(
+    const CChainParams& chainparams);
+
 void ExpectAmount(CAmount expected, std::optional<CAmount> actual) {
     EXPECT_EQ(std::make_optional(expected), actual);
 }
@@ -453,3 +495,341 @@ TEST(Validation, ReceivedBlockTransactions) {
     EnsureUnreferencedAsKeyOfMapBlocksUnlinked(&fakeIndex1);
     EnsureUnreferencedAsKeyOfMapBlocksUnlinked(&fakeIndex2);
 }
+
+TEST(Validation, CompactBlockIndexValues) {
+    OptionalAmount none;
+    EXPECT_FALSE(none.has_value());
+    EXPECT_TRUE(none == std::nullopt);
+    EXPECT_EQ(std::optional<CAmount>(none), std::nullopt);
+    EXPECT_THROW(none.value(), std::bad_optional_access);
+
+    OptionalAmount value = CAmount(-5);
+    EXPECT_TRUE(value != std::nullopt);
+    EXPECT_EQ(*value, -5);
+    { SCOPED_TRACE("ExpectAmount"); ExpectAmount(-5, value); }
+
+    // Both serialize exactly as std::optional<CAmount> does.
+    for (const auto& opt : {std::optional<CAmount>(), std::optional<CAmount>(0), std::optional<CAmount>(MAX_MONEY)}) {
+        CDataStream ssCompact(SER_DISK, CLIENT_VERSION);
+        CDataStream ssOptional(SER_DISK, CLIENT_VERSION);
+        ssCompact << OptionalAmount(opt);
+        ssOptional << opt;
+        EXPECT_EQ(ssCompact.str(), ssOptional.str());
+        OptionalAmount read;
+        ssCompact >> read;
+        EXPECT_EQ(std::optional<CAmount>(read), opt);
+    }
+
+    // The solution is kept inline, and survives a round trip through the
+    // block header.
+    CBlockHeader header;
+    header.nSolution.assign(32, 0x42);
+    CBlockIndex index(header);
+    EXPECT_TRUE(index.HasSolution());
+    EXPECT_EQ(index.GetBlockHeader().nSolution, header.nSolution);
+}
+
+// A block that passes the context-free checks, different on each call
+static CBlock PreValidationBlock()
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout.SetNull();
+    mtx.vin[0].scriptSig = CScript() << 1 << OP_0;
+    mtx.vout.resize(1);
+    mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    mtx.vout[0].nValue = 0;
+
+    CBlock block;
+    block.nVersion = 4;
+    block.nNonce = GetRandHash();
+    block.vtx.push_back(CTransaction(mtx));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+TEST(Validation, PreValidationWithoutProofsDoesNotCoverProofs) {
+    SelectParams(CBaseChainParams::MAIN);
+    CBlock block = PreValidationBlock();
+
+    // Checked without its proofs (as below the last checkpoint), the block
+    // is not taken as checked by a connect that verifies proofs...
+    ASSERT_TRUE(PreValidateBlock(block, false, Params()));
+    EXPECT_FALSE(TakeBlockPreValidated(block.GetHash(), true));
+
+    // ... but is by one that doesn't.
+    ASSERT_TRUE(PreValidateBlock(block, false, Params()));
+    EXPECT_TRUE(TakeBlockPreValidated(block.GetHash(), false));
+
+    // Checked with its proofs, it covers both.
+    ASSERT_TRUE(PreValidateBlock(block, true, Params()));
+    EXPECT_TRUE(TakeBlockPreValidated(block.GetHash(), true));
+}
+
+TEST(Validation, PreValidatedBlockIsUsedOnce) {
+    SelectParams(CBaseChainParams::MAIN);
+    CBlock block = PreValidationBlock();
+    ASSERT_TRUE(PreValidateBlock(block, true, Params()));
+    EXPECT_TRUE(TakeBlockPreValidated(block.GetHash(), true));
+    EXPECT_FALSE(TakeBlockPreValidated(block.GetHash(), true));
+    EXPECT_FALSE(TakeBlockPreValidated(block.GetHash(), false));
+}
+
+TEST(Validation, FailedPreValidationIsRejectedByConnectBlock) {
+    SelectParams(CBaseChainParams::MAIN);
+    CBlock block = PreValidationBlock();
+    block.hashMerkleRoot = uint256();
+    EXPECT_FALSE(PreValidateBlock(block, true, Params()));
+    EXPECT_FALSE(TakeBlockPreValidated(block.GetHash(), false));
+
+    // ConnectBlock checks the block itself, and rejects it before looking
+    // at the coins.
+    LOCK(cs_main);
+    CBlockIndex index(block);
+    index.nHeight = 1;
+    ValidationFakeCoinsViewDB base;
+    CCoinsViewCache view(&base);
+    CValidationState state;
+    EXPECT_FALSE(ConnectBlock(block, state, &index, view, Params(), false, CheckAs::Block));
+    EXPECT_TRUE(state.IsInvalid());
+    EXPECT_EQ(state.GetRejectReason(), "bad-txnmrklroot");
+}
+
+// A run of headers following prev, each with a RandomX solution that meets
+// its target.
+static std::vector<CBlockHeader> HeadersWithSolutions(const uint256& prev, size_t nCount)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    uint256 seedHash;
+    *seedHash.begin() = 0x08;
+
+    std::vector<CBlockHeader> headers(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        CBlockHeader& header = headers[i];
+        header.nVersion = 4;
+        header.hashPrevBlock = i ? headers[i - 1].GetHash() : prev;
+        header.nTime = 1269211443 + i;
+        header.nBits = UintToArith256(params.powLimit).GetCompact();
+        uint256 hash;
+        do {
+            header.nNonce = GetRandHash();
+            CEquihashInput I{header};
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << I;
+            ss << header.nNonce;
+            EXPECT_TRUE(RandomX_Hash_WithSeed(seedHash.begin(), 32, ss.data(), ss.size(), hash.begin()));
+        } while (!CheckProofOfWork(hash, header.nBits, params));
+        header.nSolution.assign(hash.begin(), hash.end());
+    }
+    return headers;
+}
+
+TEST(Validation, PreverifyHeadersPoWRejectsBatchWithOneBadSolution) {
+    SelectParams(CBaseChainParams::REGTEST);
+    int nHeaderCheckThreadsOld = nHeaderCheckThreads;
+    // No worker threads are started: the calling thread does the checks.
+    nHeaderCheckThreads = 2;
+
+    CBlockHeader genesis;
+    genesis.nVersion = 4;
+    genesis.nNonce = GetRandHash();
+    uint256 hashGenesis = genesis.GetHash();
+    CBlockIndex fakeGenesis {genesis};
+    fakeGenesis.phashBlock = &hashGenesis;
+    {
+        LOCK(cs_main);
+        mapBlockIndex.insert(std::make_pair(hashGenesis, &fakeGenesis));
+    }
+
+    std::vector<CBlockHeader> headers = HeadersWithSolutions(hashGenesis, 4);
+    EXPECT_TRUE(PreverifyHeadersPoW(headers, Params(), nullptr));
+
+    // The solution of one header does not match its hash, so none of the
+    // batch is taken as preverified...
+    std::vector<CBlockHeader> bad = HeadersWithSolutions(hashGenesis, 4);
+    bad[3].nSolution[0] ^= 1;
+    EXPECT_FALSE(PreverifyHeadersPoW(bad, Params(), nullptr));
+
+    // ... and AcceptBlockHeader, checking each header's PoW itself, rejects
+    // that header once the others are known.
+    {
+        LOCK(cs_main);
+        std::vector<uint256> hashes;
+        std::vector<CBlockIndex> indexes;
+        hashes.reserve(3);
+        indexes.reserve(3);
+        for (int i = 0; i < 3; i++) {
+            hashes.push_back(bad[i].GetHash());
+            indexes.emplace_back(bad[i]);
+            indexes[i].phashBlock = &hashes[i];
+            indexes[i].pprev = i ? &indexes[i - 1] : &fakeGenesis;
+            indexes[i].nHeight = i + 1;
+            mapBlockIndex.insert(std::make_pair(hashes[i], &indexes[i]));
+        }
+
+        CValidationState state;
+        CBlockIndex* pindex = nullptr;
+        EXPECT_FALSE(AcceptBlockHeader(bad[3], state, Params(), &pindex, false));
+        int nDoS;
+        EXPECT_TRUE(state.IsInvalid(nDoS));
+        EXPECT_EQ(nDoS, 100);
+        EXPECT_EQ(state.GetRejectReason(), "invalid-solution");
+        EXPECT_EQ(mapBlockIndex.count(bad[3].GetHash()), 0);
+
+        for (const uint256& hash : hashes) {
+            mapBlockIndex.erase(hash);
+        }
+        mapBlockIndex.erase(hashGenesis);
+    }
+
+    nHeaderCheckThreads = nHeaderCheckThreadsOld;
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+TEST(Validation, ClampHeaderCheckThreads) {
+    // 0 means all cores, and less than 0 that many fewer.
+    EXPECT_EQ(ClampHeaderCheckThreads(0, 8), 8);
+    EXPECT_EQ(ClampHeaderCheckThreads(-2, 8), 6);
+    EXPECT_EQ(ClampHeaderCheckThreads(4, 8), 4);
+    EXPECT_EQ(ClampHeaderCheckThreads(16, 8), 16);
+
+    // A single thread, or none left, means no threads.
+    EXPECT_EQ(ClampHeaderCheckThreads(1, 8), 0);
+    EXPECT_EQ(ClampHeaderCheckThreads(-7, 8), 0);
+    EXPECT_EQ(ClampHeaderCheckThreads(-100, 8), 0);
+    EXPECT_EQ(ClampHeaderCheckThreads(0, 1), 0);
+
+    // More than the maximum is capped, however large.
+    EXPECT_EQ(ClampHeaderCheckThreads(MAX_HEADERCHECK_THREADS + 1, 8), MAX_HEADERCHECK_THREADS);
+    EXPECT_EQ(ClampHeaderCheckThreads(int64_t(1) << 40, 8), MAX_HEADERCHECK_THREADS);
+    EXPECT_EQ(ClampHeaderCheckThreads(0, 256), MAX_HEADERCHECK_THREADS);
+}
+
+class HeadersSegmentTest : public ::testing::Test {
+protected:
+    CBlockHeader genesis;
+    uint256 hashGenesis;
+    std::unique_ptr<CBlockIndex> fakeGenesis;
+    std::unique_ptr<CNode> node;
+    bool fIBDSkipHeaderPoWOld;
+
+    void SetUp() override {
+        SelectParams(CBaseChainParams::REGTEST);
+        fIBDSkipHeaderPoWOld = fIBDSkipHeaderPoW;
+
+        // Just before the headers HeadersWithSolutions makes, at their target
+        genesis.nVersion = 4;
+        genesis.nTime = 1269211442;
+        genesis.nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+        genesis.nNonce = GetRandHash();
+        hashGenesis = genesis.GetHash();
+        fakeGenesis.reset(new CBlockIndex(genesis));
+        fakeGenesis->phashBlock = &hashGenesis;
+
+        node.reset(new CNode(INVALID_SOCKET, CAddress(), "", true));
+        LOCK(cs_main);
+        mapBlockIndex.insert(std::make_pair(hashGenesis, fakeGenesis.get()));
+        InitializeNode(node->GetId(), node.get());
+    }
+
+    void TearDown() override {
+        // Also drops the segments, and the headers linked from them.
+        UnloadBlockIndex();
+        node.reset();
+        fakeGenesis.reset();
+        fIBDSkipHeaderPoW = fIBDSkipHeaderPoWOld;
+        SelectParams(CBaseChainParams::MAIN);
+    }
+
+    // A run of headers following prev, with made-up solutions that meet
+    // their target
+    std::vector<CBlockHeader> HeadersAfter(const uint256& prev, size_t nCount) {
+        std::vector<CBlockHeader> headers(nCount);
+        for (size_t i = 0; i < nCount; i++) {
+            headers[i] = genesis;
+            headers[i].hashPrevBlock = i ? headers[i - 1].GetHash() : prev;
+            headers[i].nTime = genesis.nTime + 1 + i;
+            uint256 solution = GetRandHash();
+            *(solution.end() - 1) = 0;
+            headers[i].nSolution.assign(solution.begin(), solution.end());
+        }
+        return headers;
+    }
+
+    int Misbehavior() {
+        CNodeStateStats stats;
+        EXPECT_TRUE(GetNodeStateStats(node->GetId(), stats));
+        return stats.nMisbehavior;
+    }
+};
+
+TEST_F(HeadersSegmentTest, NonContinuousHeadersArePenalised) {
+    std::vector<CBlockHeader> headers = HeadersAfter(hashGenesis, 3);
+    LOCK(cs_main);
+    AddHeadersSegment(0, hashGenesis, 3, headers[2].GetHash());
+
+    bool fContinueSync;
+    EXPECT_TRUE(ProcessHeadersSegment(node.get(), {headers[0], headers[2]}, fContinueSync));
+    EXPECT_FALSE(fContinueSync);
+    EXPECT_EQ(Misbehavior(), 20);
+
+    // The headers before the gap are kept, so the rest follow on from them.
+    EXPECT_TRUE(ProcessHeadersSegment(node.get(), {headers[1], headers[2]}, fContinueSync));
+    EXPECT_EQ(Misbehavior(), 20);
+}
+
+TEST_F(HeadersSegmentTest, HeadersMissingTheCheckpointAreDropped) {
+    std::vector<CBlockHeader> headers = HeadersAfter(hashGenesis, 3);
+    std::vector<CBlockHeader> fork = HeadersAfter(hashGenesis, 3);
+    LOCK(cs_main);
+    AddHeadersSegment(0, hashGenesis, 3, headers[2].GetHash());
+
+    // The fork reaches the checkpoint's height, but not the checkpoint.
+    bool fContinueSync;
+    EXPECT_TRUE(ProcessHeadersSegment(node.get(), fork, fContinueSync));
+    EXPECT_EQ(Misbehavior(), 20);
+
+    // Its headers are gone, so more of them belong to no segment...
+    EXPECT_FALSE(ProcessHeadersSegment(node.get(), HeadersAfter(fork[1].GetHash(), 1), fContinueSync));
+
+    // ... and the segment is filled from its start again.
+    EXPECT_TRUE(ProcessHeadersSegment(node.get(), headers, fContinueSync));
+    EXPECT_EQ(Misbehavior(), 20);
+}
+
+TEST_F(HeadersSegmentTest, SolutionMissingItsTargetGetsFullChecks) {
+    fIBDSkipHeaderPoW = true;
+    bool fContinueSync;
+
+    // Solutions that meet their targets are taken as they are...
+    std::vector<CBlockHeader> headers = HeadersWithSolutions(hashGenesis, 3);
+    uint64_t nSkipped = GetSkippedHeaderPoWCount();
+    {
+        LOCK(cs_main);
+        AddHeadersSegment(0, hashGenesis, 3, headers[2].GetHash());
+        ASSERT_TRUE(ProcessHeadersSegment(node.get(), headers, fContinueSync));
+    }
+    LinkHeadersSegments(Params());
+    EXPECT_EQ(GetSkippedHeaderPoWCount(), nSkipped + 3);
+    {
+        LOCK(cs_main);
+        EXPECT_EQ(mapBlockIndex.count(headers[2].GetHash()), 1);
+    }
+
+    // ... but once one does not, the whole segment gets the full checks, so
+    // a made-up solution that does meet its target is rejected too.
+    std::vector<CBlockHeader> bad = HeadersAfter(hashGenesis, 3);
+    *(bad[1].nSolution.end() - 1) = 0xff;
+    bad[2].hashPrevBlock = bad[1].GetHash();
+    {
+        LOCK(cs_main);
+        AddHeadersSegment(0, hashGenesis, 3, bad[2].GetHash());
+        ASSERT_TRUE(ProcessHeadersSegment(node.get(), bad, fContinueSync));
+    }
+    LinkHeadersSegments(Params());
+    EXPECT_EQ(GetSkippedHeaderPoWCount(), nSkipped + 3);
+    LOCK(cs_main);
+    for (const CBlockHeader& header : bad) {
+        EXPECT_EQ(mapBlockIndex.count(header.GetHash()), 0);
+    }
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "validation_stats.h"
+
+TEST(LatencyHistogram, BucketsAndPercentiles) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.GetSnapshot().Percentile(0.5), 0);
+
+    // Bounds are inclusive
+    histogram.Record(100);
+    histogram.Record(101);
+    for (int i = 0; i < 97; i++) {
+        histogram.Record(2000);
+    }
+    histogram.Record(90000000);
+
+    LatencyHistogram::Snapshot stats = histogram.GetSnapshot();
+    EXPECT_EQ(stats.nCount, 100u);
+    EXPECT_EQ(stats.buckets[0], 1u);
+    EXPECT_EQ(stats.buckets[1], 1u);
+    EXPECT_EQ(stats.buckets[4], 97u);
+    EXPECT_EQ(stats.buckets[LatencyHistogram::BUCKETS - 1], 1u);
+    EXPECT_EQ(stats.nMaxMicros, 90000000);
+    EXPECT_EQ(stats.nSumMicros, 100 + 101 + 97 * 2000 + 90000000);
+
+    EXPECT_EQ(stats.Percentile(0.01), 100);
+    EXPECT_EQ(stats.Percentile(0.5), 2500);
+    EXPECT_EQ(stats.Percentile(0.99), 2500);
+    EXPECT_EQ(stats.Percentile(1), 90000000);
+}
+
+TEST(LatencyHistogram, PercentileCappedByMax) {
+    LatencyHistogram histogram;
+    histogram.Record(1200);
+    EXPECT_EQ(histogram.GetSnapshot().Percentile(0.5), 1200);
+
+    histogram.Record(-5);
+    EXPECT_EQ(histogram.GetSnapshot().buckets[0], 1u);
+}
+
+TEST(ValidationStats, SkippedWorkEstimate) {
+    // Nothing verified yet, so nothing is estimated to be saved.
+    EXPECT_EQ(RecordSkippedWork(VERIFICATION_WORK_ORCHARD, 3), 0);
+
+    RecordVerifiedWork(VERIFICATION_WORK_ORCHARD, 4, 2000);
+    EXPECT_EQ(RecordSkippedWork(VERIFICATION_WORK_ORCHARD, 10), 5000);
+
+    SkippedWorkStats stats = GetSkippedWorkStats(VERIFICATION_WORK_ORCHARD);
+    EXPECT_EQ(stats.nItems, 13u);
+    EXPECT_EQ(stats.nEstimatedMicros, 5000);
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include "random.h"
+#include "zcash/cache.h"
+
+using namespace libzcash;
+
+TEST(BundleValidityCache, SavedCacheIsRestored) {
+    auto cache = NewBundleValidityCache("GtestSaved", 1 << 20);
+    BundleCacheEntry inserted, erased, missing;
+    GetRandBytes(inserted.data(), inserted.size());
+    GetRandBytes(erased.data(), erased.size());
+    GetRandBytes(missing.data(), missing.size());
+    cache->insert(inserted);
+    cache->insert(erased);
+    EXPECT_TRUE(cache->contains(erased, true));
+    EXPECT_FALSE(cache->contains(missing, false));
+
+    uint64_t nHits, nMisses;
+    cache->GetStats(nHits, nMisses);
+    EXPECT_EQ(nHits, 1u);
+    EXPECT_EQ(nMisses, 1u);
+    EXPECT_EQ(GetBundleValidityCaches().count("GtestSaved"), 1u);
+
+    // Entries marked for erasure, which were already used by a block, are not saved.
+    SavedValidityCache saved = cache->Save();
+    ASSERT_EQ(saved.entries.size(), 1u);
+    EXPECT_TRUE(std::equal(inserted.begin(), inserted.end(), saved.entries[0].begin()));
+
+    // A cache of the same kind created later adopts the salt and the entries.
+    StashValidityCache("GtestSaved", saved);
+    auto restored = NewBundleValidityCache("GtestSaved", 1 << 20);
+    EXPECT_FALSE(TakeValidityCache("GtestSaved").has_value());
+    EXPECT_EQ(restored->nonce(), cache->nonce());
+    EXPECT_TRUE(restored->contains(inserted, false));
+    EXPECT_FALSE(restored->contains(erased, false));
+
+    // A cache of another kind gets a fresh salt.
+    auto other = NewBundleValidityCache("GtestOther", 1 << 20);
+    EXPECT_NE(other->nonce(), cache->nonce());
+
+    other.reset();
+    EXPECT_EQ(GetBundleValidityCaches().count("GtestOther"), 0u);
+}
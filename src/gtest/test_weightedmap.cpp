@@ -158,3 +158,33 @@ TEST(WeightedMapTests, WeightedMapRandomOps)
         m.checkInvariants();
     }
 }
+
+TEST(WeightedMapTests, SamplingCopy)
+{
+    WeightedMap<int, int, int, GetRandInt> m;
+    for (int e = 1; e <= 10; e++) {
+        EXPECT_TRUE(m.add(e, e*10, e));
+    }
+
+    auto copy = m.samplingCopy();
+    EXPECT_EQ(10, copy.size());
+    EXPECT_EQ(55, copy.getTotalWeight());
+    copy.checkInvariants();
+
+    std::set<int> taken;
+    while (!copy.empty()) {
+        auto [e, c, w] = copy.takeRandom().value();
+        EXPECT_EQ(c, e*10);
+        EXPECT_EQ(w, e);
+        EXPECT_TRUE(taken.insert(e).second);
+        copy.checkInvariants();
+    }
+    EXPECT_EQ(10, taken.size());
+    EXPECT_EQ(0, copy.getTotalWeight());
+
+    // The original map is unaffected.
+    EXPECT_EQ(10, m.size());
+    EXPECT_EQ(55, m.getTotalWeight());
+    EXPECT_EQ(30, m.remove(3).value());
+    m.checkInvariants();
+}
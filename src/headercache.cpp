@@ -0,0 +1,46 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "headercache.h"
+
+#include "memusage.h"
+#include "streams.h"
+#include "version.h"
+
+#include <string.h>
+
+const unsigned char* CHeaderCache::Lookup(const CBlockIndex* pindex, bool fStore)
+{
+    size_t nHeight = pindex->nHeight;
+    if (nHeight < vIndex.size() && vIndex[nHeight] == pindex)
+        return &vData[nHeight * HEADER_CACHE_RECORD_SIZE];
+    if (!fStore || pindex->nSolution.size() != HEADER_CACHE_SOLUTION_SIZE)
+        return nullptr;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHeader();
+    if (ss.size() != HEADER_CACHE_RECORD_SIZE)
+        return nullptr;
+    if (nHeight >= vIndex.size()) {
+        vIndex.resize(nHeight + 1, nullptr);
+        vData.resize(vIndex.size() * HEADER_CACHE_RECORD_SIZE);
+    }
+    unsigned char* pRecord = &vData[nHeight * HEADER_CACHE_RECORD_SIZE];
+    memcpy(pRecord, ss.data(), HEADER_CACHE_RECORD_SIZE);
+    vIndex[nHeight] = pindex;
+    return pRecord;
+}
+
+void CHeaderCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    std::vector<const CBlockIndex*>().swap(vIndex);
+    std::vector<unsigned char>().swap(vData);
+}
+
+size_t CHeaderCache::DynamicMemoryUsage()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return memusage::DynamicUsage(vIndex) + memusage::DynamicUsage(vData);
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_HEADERCACHE_H
+#define BITCOIN_HEADERCACHE_H
+
+#include "chain.h"
+
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+/** Size of a RandomX solution. */
+static const size_t HEADER_CACHE_SOLUTION_SIZE = 32;
+/** Serialized size of a block header with such a solution. */
+static const size_t HEADER_CACHE_RECORD_SIZE = 140 + 1 + HEADER_CACHE_SOLUTION_SIZE;
+
+/**
+ * Serialized headers of the blocks on the active chain, by height, so that
+ * getheaders, REST /headers and getblockheader copy bytes instead of
+ * building a CBlockHeader for each. The records sit in one contiguous buffer
+ * and are filled the first time each height is asked for. Each is tagged
+ * with the CBlockIndex it was made from, so after a reorg the height is
+ * refilled rather than served stale. Headers whose solution is not 32 bytes
+ * are serialized as before.
+ *
+ * Headers never change once in the index, so this has its own lock and
+ * callers need not hold cs_main.
+ */
+class CHeaderCache
+{
+private:
+    std::mutex cs;
+    std::vector<const CBlockIndex*> vIndex;
+    std::vector<unsigned char> vData;
+
+    /**
+     * The record for pindex, made now if fStore, or nullptr if there is none.
+     * Valid until the lock is released.
+     */
+    const unsigned char* Lookup(const CBlockIndex* pindex, bool fStore);
+
+public:
+    /**
+     * Write the header of pindex to s. fStore says whether pindex is on the
+     * active chain, and so worth keeping if it is not cached yet.
+     */
+    template<typename Stream>
+    void Write(Stream& s, const CBlockIndex* pindex, bool fStore = true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            const unsigned char* pRecord = Lookup(pindex, fStore);
+            if (pRecord) {
+                s.write((const char*)pRecord, HEADER_CACHE_RECORD_SIZE);
+                return;
+            }
+        }
+        s << pindex->GetBlockHeader();
+    }
+
+    /** Forget every record; needed before the block index is freed. */
+    void Clear();
+
+    size_t DynamicMemoryUsage();
+};
+
+#endif // BITCOIN_HEADERCACHE_H
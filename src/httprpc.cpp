@@ -3,6 +3,7 @@
 #include "chainparams.h"
 #include "httpserver.h"
 #include "key_io.h"
+#include "netbase.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -54,11 +55,32 @@ private:
     struct event_base* base;
 };
 
+/** Spreads batches over the HTTP worker threads */
+class HTTPRPCWorkerPool : public RPCWorkerPool
+{
+public:
+    size_t Size()
+    {
+        return GetHTTPWorkerCount();
+    }
+    bool Post(const std::function<void(void)>& task)
+    {
+        return QueueHTTPTask(task);
+    }
+};
 
 /* Pre-base64-encoded authentication token */
 static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static HTTPRPCTimerInterface* httpRPCTimerInterface = 0;
+/* RPC worker pool; never freed, as a batch may still hold it while stopping */
+static HTTPRPCWorkerPool httpRPCWorkerPool;
+/* Authorization headers that passed, by the connection (peer address and
+ * port) they came on. Clients that keep their connection open are checked
+ * once rather than on every call; a different header is checked in full. */
+static const size_t MAX_RPC_AUTH_SESSIONS = 1024;
+static Mutex cs_authSessions;
+static std::map<CService, std::string> mapAuthSessions GUARDED_BY(cs_authSessions);
 
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
@@ -138,6 +160,91 @@ static bool RPCAuthorized(const std::string& strAuth)
     return multiUserAuthorized(strUserPass);
 }
 
+/**
+ * Reply to a single call with the result writeResult writes. A reply that
+ * outgrows one chunk is sent in pieces, so that large results never have to
+ * be held in full. Throws the call's error if nothing has been sent yet.
+ */
+static bool RPCSessionAuthorized(const CService& peer, const std::string& strAuth)
+{
+    {
+        LOCK(cs_authSessions);
+        auto it = mapAuthSessions.find(peer);
+        if (it != mapAuthSessions.end() && TimingResistantEqual(it->second, strAuth))
+            return true;
+    }
+    if (!RPCAuthorized(strAuth))
+        return false;
+
+    LOCK(cs_authSessions);
+    // Entries of closed connections are only dropped here
+    if (mapAuthSessions.size() >= MAX_RPC_AUTH_SESSIONS)
+        mapAuthSessions.clear();
+    mapAuthSessions[peer] = strAuth;
+    return true;
+}
+
+static bool WriteJSONRPCResult(HTTPRequest* req, const JSONRequest& jreq, const RPCResultWriter& writeResult)
+{
+    bool fStarted = false;
+    JSONStreamWriter out([&](const std::string& strChunk) {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReply(HTTP_OK);
+            fStarted = true;
+        }
+        req->WriteReplyChunk(strChunk);
+    });
+    try {
+        out.BeginObject();
+        out.Key("result");
+        writeResult(out);
+        out.Key("error");
+        out.Value(NullUniValue);
+        out.Key("id");
+        out.Value(jreq.id);
+        out.EndObject();
+    } catch (...) {
+        if (!fStarted)
+            throw;
+        // Too late for an error reply; the client sees the reply
+        // end early.
+        LogPrintf("%s: %s failed after its reply was started\n", __func__, jreq.strMethod);
+        req->EndReply();
+        return false;
+    }
+
+    if (fStarted) {
+        out.Flush();
+        req->WriteReplyChunk("\n");
+        req->EndReply();
+        return true;
+    }
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, out.GetBuffer() + "\n");
+    return true;
+}
+
+/**
+ * Reply to a single call from a client that accepts application/octet-stream.
+ * A result that is a hex string (getblock with verbosity 0, getrawtransaction
+ * and the like) is sent as the bytes it spells, which saves co-located
+ * clients the encoding both ways. Any other result gets the usual JSON reply.
+ */
+static bool WriteBinaryRPCResult(HTTPRequest* req, const JSONRequest& jreq)
+{
+    UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+    if (result.isStr() && IsHex(result.get_str())) {
+        std::vector<unsigned char> vch = ParseHex(result.get_str());
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, std::string(vch.begin(), vch.end()));
+        return true;
+    }
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, JSONRPCReply(result, NullUniValue, jreq.id));
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -153,8 +260,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
-    if (!RPCAuthorized(authHeader.second)) {
-        LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", req->GetPeer().ToString());
+    CService peer = req->GetPeer();
+    if (!RPCSessionAuthorized(peer, authHeader.second)) {
+        LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", peer.ToString());
 
         /* Deter brute-forcing
            If this results in a DoS the user really
@@ -168,20 +276,51 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
     JSONRequest jreq;
     try {
-        // Parse request
+        // Parse request. A single call is read straight from the text;
+        // anything else is parsed in full.
+        std::string strBody = req->ReadBody();
+        bool fSingleton = jreq.parseFast(strBody);
         UniValue valRequest;
-        if (!valRequest.read(req->ReadBody()))
-            throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+        if (!fSingleton) {
+            if (!valRequest.read(strBody))
+                throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+            if (valRequest.isObject()) {
+                jreq.parse(valRequest);
+                fSingleton = true;
+            }
+        }
 
         std::string strReply;
         // singleton request
-        if (valRequest.isObject()) {
-            jreq.parse(valRequest);
-
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+        if (fSingleton) {
+            std::pair<bool, std::string> accept = req->GetHeader("accept");
+            if (accept.first && accept.second == "application/octet-stream")
+                return WriteBinaryRPCResult(req, jreq);
+
+            // Calls that can wait without holding a thread give this one
+            // back to the other requests. Their reply is written when they
+            // finish, which may be on another thread.
+            const CRPCCommand* pcmd = tableRPC[jreq.strMethod];
+            std::shared_ptr<HTTPRequest> hreq;
+            if (pcmd && pcmd->asyncActor)
+                hreq = DetachHTTPRequest(req);
+            if (hreq) {
+                tableRPC.execute(jreq.strMethod, jreq.params, std::make_shared<RPCAsyncCall>(
+                    [hreq, jreq](const RPCResultWriter& writeResult) {
+                        try {
+                            WriteJSONRPCResult(hreq.get(), jreq, writeResult);
+                        } catch (const UniValue& objError) {
+                            JSONErrorReply(hreq.get(), objError, jreq.id);
+                        } catch (const std::exception& e) {
+                            JSONErrorReply(hreq.get(), JSONRPCError(RPC_MISC_ERROR, e.what()), jreq.id);
+                        }
+                    }));
+                return true;
+            }
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            return WriteJSONRPCResult(req, jreq, [&](JSONStreamWriter& out) {
+                tableRPC.execute(jreq.strMethod, jreq.params, out);
+            });
 
         // array of requests
         } else if (valRequest.isArray())
@@ -224,12 +363,17 @@ bool StartHTTPRPC()
     LogPrint("rpc", "Starting HTTP RPC server\n");
     if (!InitRPCAuthentication())
         return false;
+    {
+        LOCK(cs_authSessions);
+        mapAuthSessions.clear();
+    }
 
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
     RPCRegisterTimerInterface(httpRPCTimerInterface);
+    RPCRegisterWorkerPool(&httpRPCWorkerPool);
     return true;
 }
 
@@ -243,6 +387,7 @@ void StopHTTPRPC()
     LogPrint("rpc", "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
     if (httpRPCTimerInterface) {
+        RPCUnregisterWorkerPool(&httpRPCWorkerPool);
         RPCUnregisterTimerInterface(httpRPCTimerInterface);
         delete httpRPCTimerInterface;
         httpRPCTimerInterface = 0;
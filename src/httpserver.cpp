@@ -13,7 +13,10 @@
 #include "sync.h"
 #include "ui_interface.h"
 
+#include <atomic>
 #include <deque>
+#include <map>
+#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +25,11 @@
 #include <sys/stat.h>
 #include <signal.h>
 #include <future>
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 #include <event2/event.h>
 #include <event2/http.h>
@@ -41,6 +49,10 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+class HTTPWorkItem;
+/** The request work item being handled on this thread, for DetachHTTPRequest */
+static thread_local HTTPWorkItem* currentWorkItem = nullptr;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -51,7 +63,9 @@ public:
     }
     void operator()()
     {
+        currentWorkItem = this;
         func(req.get(), path);
+        currentWorkItem = nullptr;
     }
 
     std::unique_ptr<HTTPRequest> req;
@@ -61,23 +75,55 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work item for a task queued by another module */
+class HTTPTaskItem : public HTTPClosure
+{
+public:
+    HTTPTaskItem(const std::function<void(void)>& task): task(task)
+    {
+    }
+    void operator()()
+    {
+        task();
+    }
+
+private:
+    std::function<void(void)> task;
+};
+
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects. Each item belongs to a flow, and
+ * waits in one of a few lanes; lower lanes are always served first. Within a
+ * lane the flows that have work are served round-robin, one item each, so a
+ * flow that queues a lot of work only delays itself. When the queue is full,
+ * the newest item of the longest flow gives way to an item from a shorter
+ * flow.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
+    typedef std::deque<std::unique_ptr<WorkItem>> Flow;
+    struct Lane
+    {
+        std::map<std::string, Flow> flows;
+        //! Flows with queued items, in the order they will be served
+        std::deque<std::string> order;
+    };
+
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    std::vector<Lane> lanes;
+    size_t depth;
     bool running;
     size_t maxDepth;
 
 public:
-    WorkQueue(size_t maxDepth) : running(true),
-                                 maxDepth(maxDepth)
+    WorkQueue(size_t maxDepth, size_t nLanes = 1) : lanes(std::max<size_t>(nLanes, 1)),
+                                                    depth(0),
+                                                    running(true),
+                                                    maxDepth(maxDepth)
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -85,14 +131,49 @@ public:
     ~WorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item in a flow and lane. If the queue is full, an item
+     * from a longer flow is dropped to make room and handed back in evicted;
+     * if no flow is longer than this one, or evicted is null, the item is
+     * refused.
+     */
+    bool Enqueue(WorkItem* item, const std::string& flow = "", size_t lane = 0, std::unique_ptr<WorkItem>* evicted = nullptr)
     {
         LOCK(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
+        lane = std::min(lane, lanes.size() - 1);
+        if (depth >= maxDepth) {
+            if (!evicted) {
+                return false;
+            }
+            // Flows are compared across lanes, and among equally long flows
+            // the one in the lowest-priority lane gives way.
+            auto itOwn = lanes[lane].flows.find(flow);
+            size_t nOwn = itOwn == lanes[lane].flows.end() ? 0 : itOwn->second.size();
+            Lane* victimLane = nullptr;
+            typename std::map<std::string, Flow>::iterator victim;
+            for (Lane& l : lanes) {
+                for (auto it = l.flows.begin(); it != l.flows.end(); ++it) {
+                    if (it->second.size() > nOwn + 1 &&
+                        (!victimLane || it->second.size() >= victim->second.size())) {
+                        victimLane = &l;
+                        victim = it;
+                    }
+                }
+            }
+            if (!victimLane) {
+                return false;
+            }
+            *evicted = std::move(victim->second.back());
+            victim->second.pop_back();
+            depth--;
+            assert(!victim->second.empty());
+        }
+        Lane& l = lanes[lane];
+        Flow& f = l.flows[flow];
+        if (f.empty()) {
+            l.order.push_back(flow);
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        f.emplace_back(std::unique_ptr<WorkItem>(item));
+        depth++;
         cond.notify_one();
         return true;
     }
@@ -103,12 +184,26 @@ public:
             std::unique_ptr<WorkItem> i;
             {
                 WAIT_LOCK(cs, lock);
-                while (running && queue.empty())
+                while (running && depth == 0)
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                for (Lane& l : lanes) {
+                    if (l.order.empty())
+                        continue;
+                    std::string flow = std::move(l.order.front());
+                    l.order.pop_front();
+                    auto it = l.flows.find(flow);
+                    i = std::move(it->second.front());
+                    it->second.pop_front();
+                    if (it->second.empty()) {
+                        l.flows.erase(it);
+                    } else {
+                        l.order.push_back(std::move(flow));
+                    }
+                    break;
+                }
+                depth--;
             }
             (*i)();
         }
@@ -144,10 +239,20 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queue lanes, served in this order
+enum {
+    HTTP_LANE_PRIORITY = 0,
+    HTTP_LANE_NORMAL,
+    HTTP_LANE_COUNT
+};
+//! JSON-RPC methods that are served from the priority lane
+static std::set<std::string> setPriorityMethods;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
+//! Path of the Unix domain socket listened on, if any, removed at shutdown
+static std::string strUnixSocketPath;
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -161,6 +266,25 @@ static bool ClientAllowed(const CNetAddr& netaddr)
     return false;
 }
 
+/**
+ * Whether req came in on the -rpcunixsocket listener. Access to it is
+ * controlled by the socket file's permissions rather than -rpcallowip.
+ */
+static bool FromUnixSocket(struct evhttp_request* req)
+{
+#ifndef WIN32
+    evhttp_connection* conn = evhttp_request_get_connection(req);
+    bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : nullptr;
+    if (!bev)
+        return false;
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    return getsockname(bufferevent_getfd(bev), (struct sockaddr*)&addr, &len) == 0 && addr.ss_family == AF_UNIX;
+#else
+    return false;
+#endif
+}
+
 /** Initialize ACL list for HTTP server */
 static bool InitHTTPAllowList()
 {
@@ -209,6 +333,50 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+/**
+ * Peek at the JSON-RPC method of a single request without parsing the body,
+ * so that it can be queued by method. Batches and bodies without a readable
+ * method name give an empty string.
+ */
+static std::string PeekRPCMethod(struct evhttp_request* req)
+{
+    evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    // Only a singleton request is classified, so that a batch cannot buy a
+    // place in the priority lane by naming a priority method first.
+    char first[16];
+    ev_ssize_t nFirst = evbuffer_copyout(buf, first, sizeof(first));
+    ev_ssize_t p = 0;
+    while (p < nFirst && isspace((unsigned char)first[p]))
+        p++;
+    if (p == nFirst || first[p] != '{')
+        return "";
+
+    static const char key[] = "\"method\"";
+    evbuffer_ptr pos = evbuffer_search(buf, key, sizeof(key) - 1, nullptr);
+    if (pos.pos < 0 || evbuffer_ptr_set(buf, &pos, sizeof(key) - 1, EVBUFFER_PTR_ADD) < 0)
+        return "";
+    char tail[80];
+    ev_ssize_t nTail = evbuffer_copyout_from(buf, &pos, tail, sizeof(tail));
+    ev_ssize_t i = 0;
+    while (i < nTail && isspace((unsigned char)tail[i]))
+        i++;
+    if (i == nTail || tail[i++] != ':')
+        return "";
+    while (i < nTail && isspace((unsigned char)tail[i]))
+        i++;
+    if (i == nTail || tail[i++] != '"')
+        return "";
+    std::string method;
+    for (; i < nTail && tail[i] != '"'; i++) {
+        if (!isalnum((unsigned char)tail[i]) && tail[i] != '_')
+            return "";
+        method.push_back(tail[i]);
+    }
+    return i < nTail ? method : "";
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
@@ -223,12 +391,14 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
         }
     }
     std::unique_ptr<HTTPRequest> hreq(new HTTPRequest(req));
+    bool fUnixSocket = FromUnixSocket(req);
 
     LogPrint("http", "Received a %s request for %s from %s\n",
-             RequestMethodString(hreq->GetRequestMethod()), hreq->GetURI(), hreq->GetPeer().ToString());
+             RequestMethodString(hreq->GetRequestMethod()), hreq->GetURI(),
+             fUnixSocket ? strUnixSocketPath : hreq->GetPeer().ToString());
 
     // Early address-based allow check
-    if (!ClientAllowed(hreq->GetPeer())) {
+    if (!fUnixSocket && !ClientAllowed(hreq->GetPeer())) {
         hreq->WriteReply(HTTP_FORBIDDEN);
         return;
     }
@@ -256,16 +426,28 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
         }
     }
 
-    // Dispatch to worker thread
+    // Dispatch to worker thread. Requests are queued fairly by client
+    // address (not port, so that extra connections don't buy extra turns)
+    // and by method, which is the JSON-RPC method or else the handler prefix.
     if (i != iend) {
+        std::string method = PeekRPCMethod(req);
+        size_t lane = setPriorityMethods.count(method) ? HTTP_LANE_PRIORITY : HTTP_LANE_NORMAL;
+        if (method.empty())
+            method = i->prefix;
+        std::string flow = (fUnixSocket ? "unix" : hreq->GetPeer().ToStringIP()) + " " + method;
+
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
+        std::unique_ptr<HTTPClosure> evicted;
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), flow, lane, &evicted))
         {
             item.release(); /* if true, queue took ownership */
         } else {
+            evicted = std::move(item);
+        }
+        if (evicted) {
             LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
-            item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
+            static_cast<HTTPWorkItem*>(evicted.get())->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
         hreq->WriteReply(HTTP_NOTFOUND);
@@ -329,6 +511,58 @@ static bool HTTPBindAddresses(struct evhttp* http)
     return !boundSockets.empty();
 }
 
+/**
+ * Also listen on the Unix domain socket -rpcunixsocket, if set, so that
+ * services on the same host skip the TCP stack. It serves the same handlers.
+ */
+static bool HTTPBindUnixSocket(struct evhttp* http)
+{
+    if (!mapArgs.count("-rpcunixsocket"))
+        return true;
+#ifdef WIN32
+    LogPrintf("-rpcunixsocket is not supported on this platform\n");
+    return false;
+#else
+    std::string path = fs::absolute(mapArgs["-rpcunixsocket"], GetDataDir()).string();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LogPrintf("RPC socket path %s is too long\n", path);
+        return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // A socket left behind by an earlier run would make bind fail
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    LogPrint("http", "Binding RPC on Unix socket %s\n", path);
+    evutil_socket_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LogPrintf("Creating RPC Unix socket failed: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    // Only our own user may connect; requests still need the RPC credentials.
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+        listen(fd, SOMAXCONN) != 0 || evutil_make_socket_nonblocking(fd) != 0 || evutil_make_socket_closeonexec(fd) != 0) {
+        LogPrintf("Binding RPC on Unix socket %s failed: %s\n", path, NetworkErrorString(WSAGetLastError()));
+        close(fd);
+        return false;
+    }
+    strUnixSocketPath = path;
+    evhttp_bound_socket* bind_handle = evhttp_accept_socket_with_handle(http, fd);
+    if (!bind_handle) {
+        LogPrintf("Binding RPC on Unix socket %s failed.\n", path);
+        close(fd);
+        return false;
+    }
+    boundSockets.push_back(bind_handle);
+    return true;
+#endif
+}
+
 /** Simple wrapper to set thread name and run work queue */
 static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
 {
@@ -405,12 +639,29 @@ bool InitHTTPServer()
         event_base_free(base);
         return false;
     }
+    if (!HTTPBindUnixSocket(http)) {
+        uiInterface.ThreadSafeMessageBox(
+            strprintf("Unable to listen for RPC connections on Unix socket %s", mapArgs["-rpcunixsocket"]),
+            "", CClientUIInterface::MSG_ERROR);
+        evhttp_free(http);
+        event_base_free(base);
+        return false;
+    }
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    setPriorityMethods.clear();
+    if (mapMultiArgs.count("-rpcprioritymethod")) {
+        for (const std::string& method : mapMultiArgs["-rpcprioritymethod"]) {
+            setPriorityMethods.insert(method);
+        }
+    } else {
+        setPriorityMethods = {"submitblock", "getblocktemplate"};
+    }
+
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, HTTP_LANE_COUNT);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -419,6 +670,7 @@ bool InitHTTPServer()
 std::thread threadHTTP;
 std::future<bool> threadResult;
 static std::vector<std::thread> g_thread_http_workers;
+static std::atomic<size_t> nHTTPWorkers{0};
 
 bool StartHTTPServer()
 {
@@ -432,6 +684,7 @@ bool StartHTTPServer()
     for (int i = 0; i < rpcThreads; i++) {
         g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue);
     }
+    nHTTPWorkers = rpcThreads;
     return true;
 }
 
@@ -459,6 +712,7 @@ void StopHTTPServer()
             thread.join();
         }
         g_thread_http_workers.clear();
+        nHTTPWorkers = 0;
         delete workQueue;
     }
     if (eventBase) {
@@ -481,6 +735,12 @@ void StopHTTPServer()
         evhttp_free(eventHTTP);
         eventHTTP = 0;
     }
+#ifndef WIN32
+    if (!strUnixSocketPath.empty()) {
+        unlink(strUnixSocketPath.c_str());
+        strUnixSocketPath.clear();
+    }
+#endif
     if (eventBase) {
         event_base_free(eventBase);
         eventBase = 0;
@@ -493,6 +753,30 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+bool QueueHTTPTask(const std::function<void(void)>& task)
+{
+    if (!workQueue)
+        return false;
+    // Tasks share one flow, and never displace a waiting request.
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(task));
+    if (!workQueue->Enqueue(item.get(), "task", HTTP_LANE_NORMAL))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
+std::unique_ptr<HTTPRequest> DetachHTTPRequest(HTTPRequest* req)
+{
+    if (!currentWorkItem || currentWorkItem->req.get() != req)
+        return nullptr;
+    return std::move(currentWorkItem->req);
+}
+
+size_t GetHTTPWorkerCount()
+{
+    return nHTTPWorkers;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -529,6 +813,9 @@ HTTPRequest::~HTTPRequest()
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
+    } else if (req) {
+        // A chunked reply that was never finished
+        EndReply();
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -571,6 +858,22 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/** Re-enable reading from the socket. This is the second part of the libevent
+ * workaround in http_request_cb.
+ */
+static void ReenableReading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -586,23 +889,82 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
-        }
+        ReenableReading(req_copy);
     });
     ev->trigger(0);
     replySent = true;
     req = 0; // transferred back to main thread
 }
 
+/** The pieces of a chunked reply are handed to the main http thread one
+ * event at a time. Events triggered immediately run in the order they were
+ * triggered, so the pieces go out in order.
+ */
+void HTTPRequest::StartReply(int nStatus)
+{
+    assert(!replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(0);
+    replySent = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replySent && req);
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        // Once the client is gone, libevent detaches the request from the
+        // connection and ignores the chunk.
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+}
+
+static void ReleaseReplyData(const void*, size_t, void* arg)
+{
+    delete static_cast<std::shared_ptr<const void>*>(arg);
+}
+
+void HTTPRequest::WriteReplyChunk(std::shared_ptr<const void> data, const char* pbegin, const char* pend)
+{
+    assert(replySent && req);
+    if (pbegin == pend)
+        return;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    auto holder = new std::shared_ptr<const void>(std::move(data));
+    if (evbuffer_add_reference(evb, pbegin, pend - pbegin, ReleaseReplyData, holder) != 0) {
+        evbuffer_add(evb, pbegin, pend - pbegin);
+        delete holder;
+    }
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndReply()
+{
+    assert(replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        // Re-enable reading before the request may be freed.
+        ReenableReading(req_copy);
+        evhttp_send_reply_end(req_copy);
+    });
+    ev->trigger(0);
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -9,6 +9,7 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -48,6 +49,20 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Queue a task for the worker threads, behind the requests already waiting.
+ * Returns false if the work queue is full or not running.
+ */
+bool QueueHTTPTask(const std::function<void(void)>& task);
+
+/** Take ownership of req away from the worker thread handling it, so that
+ * the handler can return and the reply be written later, from any thread.
+ * Returns nullptr if req is not being handled on this thread.
+ */
+std::unique_ptr<HTTPRequest> DetachHTTPRequest(HTTPRequest* req);
+
+/** Number of worker threads */
+size_t GetHTTPWorkerCount();
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -114,6 +129,27 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body is sent in pieces as it is produced, using
+     * chunked transfer encoding. Follow with any number of calls to
+     * WriteReplyChunk and then one to EndReply, instead of WriteReply.
+     *
+     * @note If the client goes away part way, the remaining pieces are
+     * dropped.
+     */
+    virtual void StartReply(int nStatus);
+    virtual void WriteReplyChunk(const std::string& strChunk);
+    /**
+     * Send the piece [pbegin, pend) of a reply without copying it. data
+     * keeps the memory alive until it has been written to the client.
+     */
+    virtual void WriteReplyChunk(std::shared_ptr<const void> data, const char* pbegin, const char* pend);
+    /**
+     * Finish a reply begun with StartReply. Like WriteReply, this gives the
+     * request back to the main thread.
+     */
+    virtual void EndReply();
 };
 
 /** Event handler closure.
@@ -0,0 +1,231 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "index/base.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "init.h"
+#include "main.h"
+#include "ui_interface.h"
+#include "util/system.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+
+BaseIndex::~BaseIndex()
+{
+    Stop();
+}
+
+bool BaseIndex::Start()
+{
+    {
+        LOCK(cs_main);
+        uint256 hashBestBlock;
+        if (!ReadBestBlock(hashBestBlock)) {
+            return error("%s: failed to read the best block of the %s", __func__, GetName());
+        }
+        if (!hashBestBlock.IsNull()) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBestBlock);
+            if (mi == mapBlockIndex.end()) {
+                LogPrintf("%s: best block %s of the %s is unknown, rebuilding it\n",
+                    __func__, hashBestBlock.GetHex(), GetName());
+            } else {
+                m_best_block = mi->second;
+            }
+        }
+        LogPrintf("%s: %s synced to height %d\n", __func__, GetName(), m_best_block ? m_best_block->nHeight : -1);
+    }
+
+    RegisterValidationInterface(this, GetName(), true);
+    m_thread = std::thread(&TraceThread<std::function<void()>>, GetName(), std::bind(&BaseIndex::ThreadSync, this));
+    return true;
+}
+
+void BaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interrupt = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void BaseIndex::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tip_changed = true;
+    }
+    m_cv.notify_all();
+}
+
+const CBlockIndex* BaseIndex::GetBestBlock()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_best_block;
+}
+
+void BaseIndex::SetBestBlock(const CBlockIndex* pindex)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_best_block = pindex;
+    }
+    m_cv.notify_all();
+}
+
+void BaseIndex::Fail(const std::string& strMessage)
+{
+    LogPrintf("*** %s: %s\n", GetName(), strMessage);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+    }
+    m_cv.notify_all();
+    uiInterface.ThreadSafeMessageBox(
+        strprintf(_("Error: A fatal internal error occurred, see %s for details"), GetDebugLogPath()),
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+bool BaseIndex::BlockUntilSyncedToCurrentChain()
+{
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    if (pindexTip == nullptr) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_synced) {
+        return false;
+    }
+    // The tip is not announced during initial block download, so wake the
+    // sync thread in case it is waiting for a tip it was never told about.
+    m_tip_changed = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [&] {
+        return m_failed || m_interrupt ||
+            (m_best_block && m_best_block->GetAncestor(pindexTip->nHeight) == pindexTip);
+    });
+    return !m_failed && !m_interrupt;
+}
+
+bool BaseIndex::ReadBlocks(const std::vector<const CBlockIndex*>& vIndex, std::vector<Block>& blocks) const
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    std::vector<std::pair<CDiskBlockPos, CDiskBlockPos>> vPos;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* pindex : vIndex) {
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || (pindex->pprev && !(pindex->nStatus & BLOCK_HAVE_UNDO))) {
+                return error("%s: %s needs block %s, which is not on disk",
+                    __func__, GetName(), pindex->GetBlockHash().GetHex());
+            }
+            vPos.emplace_back(pindex->GetBlockPos(), pindex->pprev ? pindex->GetUndoPos() : CDiskBlockPos());
+        }
+    }
+
+    // Blocks are read and deserialized on several threads, the first share
+    // on this one. The index applies them in order afterwards.
+    blocks.resize(vIndex.size());
+    auto readRange = [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            Block& block = blocks[i];
+            block.pindex = vIndex[i];
+            if (!ReadBlockFromDisk(block.block, vPos[i].first, consensusParams) ||
+                block.block.GetHash() != block.pindex->GetBlockHash()) {
+                return error("%s: failed to read block %s", __func__, block.pindex->GetBlockHash().GetHex());
+            }
+            if (block.pindex->pprev &&
+                !UndoReadFromDisk(block.undo, vPos[i].second, block.pindex->pprev->GetBlockHash())) {
+                return error("%s: failed to read undo data of block %s", __func__, block.pindex->GetBlockHash().GetHex());
+            }
+        }
+        return true;
+    };
+
+    size_t nWorkers = std::max(std::min((size_t)GetNumCores(), blocks.size()), (size_t)1);
+    size_t chunkSize = (blocks.size() + nWorkers - 1) / nWorkers;
+    std::vector<std::future<bool>> workers;
+    for (size_t w = 1; w < nWorkers; w++) {
+        size_t start = std::min(w * chunkSize, blocks.size());
+        size_t end = std::min(start + chunkSize, blocks.size());
+        workers.push_back(std::async(std::launch::async, readRange, start, end));
+    }
+    bool fOk = readRange(0, std::min(chunkSize, blocks.size()));
+    for (auto& worker : workers) {
+        fOk &= worker.get();
+    }
+    return fOk;
+}
+
+void BaseIndex::ThreadSync()
+{
+    while (!m_interrupt) {
+        std::vector<const CBlockIndex*> vConnect;
+        const CBlockIndex* pindexRewind = nullptr;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexBest = GetBestBlock();
+            const CBlockIndex* pindexTip = chainActive.Tip();
+            if (pindexBest && !chainActive.Contains(pindexBest)) {
+                // The best block has left the active chain. Rewind once the
+                // chain has moved on to another branch, but not while it is
+                // still being rebuilt, as with -reindex-chainstate.
+                if (pindexTip && (pindexTip->nChainWork >= pindexBest->nChainWork ||
+                                  (pindexBest->nStatus & BLOCK_FAILED_MASK))) {
+                    pindexRewind = pindexBest;
+                }
+            } else if (pindexTip) {
+                const CBlockIndex* pindex = pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis();
+                while (pindex && vConnect.size() < SYNC_BATCH_BLOCKS) {
+                    vConnect.push_back(pindex);
+                    pindex = chainActive.Next(pindex);
+                }
+            }
+        }
+
+        if (pindexRewind) {
+            std::vector<Block> blocks;
+            if (!ReadBlocks({pindexRewind}, blocks) || !RewindBlock(blocks[0])) {
+                Fail(strprintf("Failed to rewind block %s", pindexRewind->GetBlockHash().GetHex()));
+                return;
+            }
+            SetBestBlock(pindexRewind->pprev);
+            continue;
+        }
+
+        if (!vConnect.empty()) {
+            std::vector<Block> blocks;
+            if (!ReadBlocks(vConnect, blocks) || !WriteBlocks(blocks)) {
+                Fail(strprintf("Failed to index blocks %d to %d", vConnect.front()->nHeight, vConnect.back()->nHeight));
+                return;
+            }
+            SetBestBlock(vConnect.back());
+            continue;
+        }
+
+        // In step with the tip; wait for it to move. UpdatedBlockTip is not
+        // signalled during initial block download, so look again regularly.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_synced) {
+            m_synced = true;
+            LogPrintf("%s is in step with the chain\n", GetName());
+        }
+        m_cv.wait_for(lock, std::chrono::seconds(1), [&] { return m_tip_changed || m_interrupt; });
+        m_tip_changed = false;
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include "primitives/block.h"
+#include "undo.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CBlockIndex;
+
+/**
+ * Base class for indexes that are built from the block and undo files on a
+ * thread of their own, rather than inside ConnectBlock. An index catches up
+ * with the active chain from the last block it recorded, reading several
+ * blocks at once, and then follows the tip as UpdatedBlockTip reports it
+ * moving, rewinding blocks that have left the active chain. So an index can
+ * be turned on without a reindex, and its writes stay off the path that
+ * connects blocks.
+ */
+class BaseIndex : public CValidationInterface
+{
+public:
+    /** A block handed to the index, with its undo data (empty for the genesis block). */
+    struct Block
+    {
+        const CBlockIndex* pindex;
+        CBlock block;
+        CBlockUndo undo;
+    };
+
+private:
+    std::thread m_thread;
+    std::atomic<bool> m_interrupt{false};
+
+    std::mutex m_mutex;
+    /** Signalled when the tip or the best block moves, and on Stop(). */
+    std::condition_variable m_cv;
+    /** Last block applied to the index, or null before the genesis block. */
+    const CBlockIndex* m_best_block = nullptr;
+    bool m_tip_changed = false;
+    /** Set once the index has first caught up with the active chain. */
+    bool m_synced = false;
+    bool m_failed = false;
+
+    void ThreadSync();
+    bool ReadBlocks(const std::vector<const CBlockIndex*>& vIndex, std::vector<Block>& blocks) const;
+    void SetBestBlock(const CBlockIndex* pindex);
+    void Fail(const std::string& strMessage);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindex) override;
+
+    /** Read the hash of the last block applied to the index, or set it to
+     * null if the index is empty. Called with cs_main held. */
+    virtual bool ReadBestBlock(uint256& hashBestBlock) const = 0;
+
+    /** Apply blocks that extend the best block, in order, and record the
+     * last of them as the best block. */
+    virtual bool WriteBlocks(const std::vector<Block>& blocks) = 0;
+
+    /** Undo the best block, and record its parent as the best block. */
+    virtual bool RewindBlock(const Block& block) = 0;
+
+    virtual const char* GetName() const = 0;
+
+public:
+    /** Blocks read and written at a time while catching up. */
+    static const size_t SYNC_BATCH_BLOCKS = 64;
+
+    virtual ~BaseIndex();
+
+    /** Load the best block and start following the chain. Called once the
+     * block index has been loaded. */
+    bool Start();
+
+    /** Stop the sync thread, and stop listening for new tips. */
+    void Stop();
+
+    /**
+     * Wait until the index has applied the active chain tip as of the call.
+     * Returns false at once if the index is still catching up with the
+     * chain, and false if it has failed or is stopping. Must not be called
+     * with cs_main held, since the sync thread needs it.
+     */
+    bool BlockUntilSyncedToCurrentChain();
+
+    const CBlockIndex* GetBestBlock();
+};
+
+#endif // BITCOIN_INDEX_BASE_H
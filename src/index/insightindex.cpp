@@ -0,0 +1,322 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "index/insightindex.h"
+
+#include "chain.h"
+#include "main.h"
+#include "txdb.h"
+#include "util/system.h"
+
+#include <map>
+#include <set>
+
+std::unique_ptr<InsightIndex> g_insight_index;
+
+namespace {
+
+/**
+ * The summary records of the addresses touched by the blocks being written
+ * or rewound, each read from the database when it is first needed.
+ */
+class AddressSummaryBatch
+{
+private:
+    typedef std::pair<unsigned int, uint160> Address;
+
+    std::map<Address, CAddressSummary> summaries;
+    //! Addresses touched by the current transaction
+    std::set<Address> txAddresses;
+
+    CAddressSummary& Get(const Address& address)
+    {
+        auto it = summaries.find(address);
+        if (it == summaries.end()) {
+            CAddressSummary summary;
+            pblocktree->ReadAddressSummary(CAddressIndexIteratorKey(address.first, address.second), summary);
+            it = summaries.emplace(address, summary).first;
+        }
+        return it->second;
+    }
+
+public:
+    /** Add an address index entry of the current transaction, or take it
+     * away again when rewinding. */
+    void AddEntry(unsigned int type, const uint160& hash, CAmount value, bool fRewind)
+    {
+        CAddressSummary& summary = Get(Address(type, hash));
+        CAmount received = value > 0 ? value : 0;
+        summary.balance += fRewind ? -value : value;
+        summary.received += fRewind ? -received : received;
+        txAddresses.insert(Address(type, hash));
+    }
+
+    void ConnectTx(int nHeight)
+    {
+        for (const Address& address : txAddresses) {
+            CAddressSummary& summary = summaries[address];
+            if (summary.txCount == 0) {
+                summary.firstHeight = nHeight;
+            }
+            summary.txCount++;
+            summary.lastHeight = nHeight;
+        }
+        txAddresses.clear();
+    }
+
+    /** Take away the current transaction. Once the whole block has been
+     * rewound, FinishRewind must be called. */
+    void DisconnectTx()
+    {
+        for (const Address& address : txAddresses) {
+            summaries[address].txCount--;
+        }
+        txAddresses.clear();
+    }
+
+    /** Find the last height of addresses whose last transaction was in the
+     * rewound block at nHeight. */
+    bool FinishRewind(int nHeight)
+    {
+        for (auto& [address, summary] : summaries) {
+            if (summary.IsNull()) {
+                summary.SetNull();
+            } else if (summary.lastHeight == nHeight &&
+                       !pblocktree->ReadAddressLastHeight(
+                           CAddressIndexIteratorKey(address.first, address.second), nHeight, summary.lastHeight)) {
+                return error("%s: address summary does not match the address index", __func__);
+            }
+        }
+        return true;
+    }
+
+    std::vector<CAddressSummaryDbEntry> Entries() const
+    {
+        std::vector<CAddressSummaryDbEntry> entries;
+        entries.reserve(summaries.size());
+        for (const auto& [address, summary] : summaries) {
+            entries.emplace_back(CAddressIndexIteratorKey(address.first, address.second), summary);
+        }
+        return entries;
+    }
+};
+
+} // namespace
+
+bool InsightIndex::ReadBestBlock(uint256& hashBestBlock) const
+{
+    AssertLockHeld(cs_main);
+    if (pblocktree->ReadInsightIndexBestBlock(hashBestBlock)) {
+        return true;
+    }
+    // Databases without the record were kept in step with the chain tip by
+    // ConnectBlock, before the index was built on a thread of its own.
+    hashBestBlock = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    return true;
+}
+
+// https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2597
+bool InsightIndex::WriteBlocks(const std::vector<Block>& blocks)
+{
+    std::vector<CAddressIndexDbEntry> addressIndex;
+    std::vector<CAddressUnspentDbEntry> addressUnspentIndex;
+    std::vector<CSpentIndexDbEntry> spentIndex;
+    std::vector<CTimestampIndexKey> timestampIndex;
+    AddressSummaryBatch summaries;
+
+    // Summaries are rebuilt along with the rest of the index, and must not
+    // count the blocks indexed before it was reset.
+    if (fAddressIndex && blocks.front().pindex->pprev == nullptr && !pblocktree->EraseAddressSummaries()) {
+        return error("%s: failed to erase the address summaries", __func__);
+    }
+
+    const CBlockIndex* pindexLogicalTS = nullptr;
+    unsigned int lastLogicalTS = 0;
+
+    for (const Block& b : blocks) {
+        const CBlockIndex* pindex = b.pindex;
+        // The outputs of the genesis block cannot be spent, so it is not indexed.
+        if (pindex->pprev == nullptr) {
+            continue;
+        }
+        if (b.undo.vtxundo.size() + 1 != b.block.vtx.size()) {
+            return error("%s: block and undo data of %s are inconsistent", __func__, pindex->GetBlockHash().GetHex());
+        }
+
+        for (size_t i = 0; i < b.block.vtx.size(); i++) {
+            const CTransaction& tx = b.block.vtx[i];
+            const uint256 hash = tx.GetHash();
+
+            if (i > 0 && (fAddressIndex || fSpentIndex)) {
+                const CTxUndo& txundo = b.undo.vtxundo[i - 1];
+                if (txundo.vprevout.size() != tx.vin.size()) {
+                    return error("%s: transaction and undo data of %s are inconsistent", __func__, hash.GetHex());
+                }
+                for (size_t j = 0; j < tx.vin.size(); j++) {
+                    const CTxIn& input = tx.vin[j];
+                    const CTxOut& prevout = txundo.vprevout[j].txout;
+                    CScript::ScriptType scriptType = prevout.scriptPubKey.GetType();
+                    const uint160 addrHash = prevout.scriptPubKey.AddressHash();
+                    if (fAddressIndex && scriptType != CScript::UNKNOWN) {
+                        // record spending activity
+                        addressIndex.push_back(std::make_pair(
+                            CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, j, true),
+                            prevout.nValue * -1));
+                        summaries.AddEntry(scriptType, addrHash, prevout.nValue * -1, false);
+
+                        // remove address from unspent index
+                        addressUnspentIndex.push_back(std::make_pair(
+                            CAddressUnspentKey(scriptType, addrHash, input.prevout.hash, input.prevout.n),
+                            CAddressUnspentValue()));
+                    }
+                    if (fSpentIndex) {
+                        // Add the spent index to determine the txid and input that spent an output
+                        // and to find the amount and address from an input.
+                        // If we do not recognize the script type, we still add an entry to the
+                        // spentindex db, with a script type of 0 and addrhash of all zeroes.
+                        spentIndex.push_back(std::make_pair(
+                            CSpentIndexKey(input.prevout.hash, input.prevout.n),
+                            CSpentIndexValue(hash, j, pindex->nHeight, prevout.nValue, scriptType, addrHash)));
+                    }
+                }
+            }
+
+            if (fAddressIndex) {
+                for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                    const CTxOut& out = tx.vout[k];
+                    CScript::ScriptType scriptType = out.scriptPubKey.GetType();
+                    if (scriptType != CScript::UNKNOWN) {
+                        uint160 const addrHash = out.scriptPubKey.AddressHash();
+
+                        // record receiving activity
+                        addressIndex.push_back(std::make_pair(
+                            CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, k, false),
+                            out.nValue));
+                        summaries.AddEntry(scriptType, addrHash, out.nValue, false);
+
+                        // record unspent output
+                        addressUnspentIndex.push_back(std::make_pair(
+                            CAddressUnspentKey(scriptType, addrHash, hash, k),
+                            CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+                    }
+                }
+            }
+            summaries.ConnectTx(pindex->nHeight);
+        }
+
+        if (fTimestampIndex) {
+            unsigned int logicalTS = pindex->nTime;
+            unsigned int prevLogicalTS = 0;
+
+            // retrieve logical timestamp of the previous block, which is
+            // part of this batch unless this is its first block
+            if (pindexLogicalTS == pindex->pprev) {
+                prevLogicalTS = lastLogicalTS;
+            } else if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS)) {
+                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
+            }
+
+            if (logicalTS <= prevLogicalTS) {
+                logicalTS = prevLogicalTS + 1;
+                LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
+            }
+
+            timestampIndex.push_back(CTimestampIndexKey(logicalTS, pindex->GetBlockHash()));
+            pindexLogicalTS = pindex;
+            lastLogicalTS = logicalTS;
+        }
+    }
+
+    // Entries are applied in order, so an output created and spent within
+    // the batch ends up erased from the unspent index.
+    return pblocktree->UpdateInsightIndex(addressIndex, {}, addressUnspentIndex, summaries.Entries(),
+                                          spentIndex, timestampIndex, blocks.back().pindex->GetBlockHash());
+}
+
+// https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2236
+bool InsightIndex::RewindBlock(const Block& b)
+{
+    const CBlockIndex* pindex = b.pindex;
+    if (b.undo.vtxundo.size() + 1 != b.block.vtx.size()) {
+        return error("%s: block and undo data of %s are inconsistent", __func__, pindex->GetBlockHash().GetHex());
+    }
+
+    std::vector<CAddressIndexDbEntry> addressIndex;
+    std::vector<CAddressUnspentDbEntry> addressUnspentIndex;
+    std::vector<CSpentIndexDbEntry> spentIndex;
+    AddressSummaryBatch summaries;
+
+    // undo transactions in reverse order, so that an output spent within
+    // the block is restored to the unspent index and then erased with the
+    // transaction that created it
+    for (int i = b.block.vtx.size() - 1; i >= 0; i--) {
+        const CTransaction& tx = b.block.vtx[i];
+        uint256 const hash = tx.GetHash();
+
+        if (fAddressIndex) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                const CTxOut& out = tx.vout[k];
+                CScript::ScriptType scriptType = out.scriptPubKey.GetType();
+                if (scriptType != CScript::UNKNOWN) {
+                    uint160 const addrHash = out.scriptPubKey.AddressHash();
+
+                    // undo receiving activity
+                    addressIndex.push_back(std::make_pair(
+                        CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, k, false),
+                        out.nValue));
+                    summaries.AddEntry(scriptType, addrHash, out.nValue, true);
+
+                    // undo unspent index
+                    addressUnspentIndex.push_back(std::make_pair(
+                        CAddressUnspentKey(scriptType, addrHash, hash, k),
+                        CAddressUnspentValue()));
+                }
+            }
+        }
+
+        if (i > 0) {
+            const CTxUndo& txundo = b.undo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size()) {
+                return error("%s: transaction and undo data of %s are inconsistent", __func__, hash.GetHex());
+            }
+            for (unsigned int j = tx.vin.size(); j-- > 0;) {
+                const CTxIn& input = tx.vin[j];
+                const CTxInUndo& undo = txundo.vprevout[j];
+                if (fAddressIndex) {
+                    const CTxOut& prevout = undo.txout;
+                    CScript::ScriptType scriptType = prevout.scriptPubKey.GetType();
+                    if (scriptType != CScript::UNKNOWN) {
+                        uint160 const addrHash = prevout.scriptPubKey.AddressHash();
+
+                        // undo spending activity
+                        addressIndex.push_back(std::make_pair(
+                            CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, j, true),
+                            prevout.nValue * -1));
+                        summaries.AddEntry(scriptType, addrHash, prevout.nValue * -1, true);
+
+                        // restore unspent index
+                        addressUnspentIndex.push_back(std::make_pair(
+                            CAddressUnspentKey(scriptType, addrHash, input.prevout.hash, input.prevout.n),
+                            CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight)));
+                    }
+                }
+                if (fSpentIndex) {
+                    // undo and delete the spent index
+                    spentIndex.push_back(std::make_pair(
+                        CSpentIndexKey(input.prevout.hash, input.prevout.n),
+                        CSpentIndexValue()));
+                }
+            }
+        }
+        summaries.DisconnectTx();
+    }
+    if (!summaries.FinishRewind(pindex->nHeight)) {
+        return false;
+    }
+
+    // The timestamp index keeps the entries of blocks that have left the
+    // active chain; lookups filter them out.
+    return pblocktree->UpdateInsightIndex({}, addressIndex, addressUnspentIndex, summaries.Entries(),
+                                          spentIndex, {}, pindex->pprev->GetBlockHash());
+}
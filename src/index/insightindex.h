@@ -0,0 +1,30 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_INDEX_INSIGHTINDEX_H
+#define BITCOIN_INDEX_INSIGHTINDEX_H
+
+#include "index/base.h"
+
+#include <memory>
+
+/**
+ * The address, address unspent, spent and timestamp indexes of the insight
+ * explorer (-insightexplorer), and the address indexes that -lightwalletd
+ * uses, kept in the block tree database. Which of them are written follows
+ * fAddressIndex, fSpentIndex and fTimestampIndex.
+ */
+class InsightIndex : public BaseIndex
+{
+protected:
+    bool ReadBestBlock(uint256& hashBestBlock) const override;
+    bool WriteBlocks(const std::vector<Block>& blocks) override;
+    bool RewindBlock(const Block& block) override;
+    const char* GetName() const override { return "insightindex"; }
+};
+
+/** The running insight index, if address indexing is enabled. */
+extern std::unique_ptr<InsightIndex> g_insight_index;
+
+#endif // BITCOIN_INDEX_INSIGHTINDEX_H
@@ -12,6 +12,9 @@
 #include "init.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockcompression.h"
+#include "blockfilemap.h"
+#include "blockfilewriter.h"
 #include "checkpoints.h"
 #include "compat.h"
 #include "compat/sanity.h"
@@ -22,6 +25,7 @@
 #include "fs.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "index/insightindex.h"
 #include "key.h"
 #ifdef ENABLE_MINING
 #include "key_io.h"
@@ -31,17 +35,29 @@
 #include "metrics.h"
 #include "miner.h"
 #include "net.h"
+#include "numa_helper.h"
+#include "perfhistory.h"
 #include "policy/policy.h"
+#include "pow.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
 #include "script/sigcache.h"
 #include "scheduler.h"
+#include "shieldedbatch.h"
+#include "support/hugepagearena.h"
+#include "transaction_builder.h"
 #include "txdb.h"
 #include "torcontrol.h"
+#include "txreconciliation.h"
+#ifdef ENABLE_MINING
+#include "randomx_benchmark.h"
+#include "stratum.h"
+#endif
 #include "ui_interface.h"
 #include "util/system.h"
 #include "util/moneystr.h"
+#include "util/strencodings.h"
 #include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
@@ -49,8 +65,11 @@
 #endif
 #include "warnings.h"
 #include "zip317.h"
+#include "crypto/randomx_shm.h"
 #include "crypto/randomx_wrapper.h"
 #include <chrono>
+#include <future>
+#include <mutex>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -59,6 +78,7 @@
 #endif
 
 #include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -68,7 +88,9 @@
 #include <sodium.h>
 
 #if ENABLE_ZMQ
+#include "zmq/zmqabstractnotifier.h"
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 #include <rust/bridge.h>
@@ -142,6 +164,10 @@ CClientUIInterface uiInterface; // Declared but not defined in ui_interface.h
 //
 
 std::atomic<bool> fRequestShutdown(false);
+//! Set once the mempool saved at the last shutdown has been loaded.
+static std::atomic<bool> fDumpMempoolLater(false);
+//! Set once the validity caches have been created, possibly from the saved ones.
+static std::atomic<bool> fDumpValidityCachesLater(false);
 
 void StartShutdown()
 {
@@ -184,6 +210,9 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+#ifdef ENABLE_MINING
+    InterruptStratumServer();
+#endif
     threadGroup.interrupt_all();
 }
 
@@ -213,21 +242,39 @@ void Shutdown()
         pwalletMain->Flush(false);
 #endif
 #ifdef ENABLE_MINING
+    StopStratumServer();
     GenerateBitcoins(false, 0, Params());
 #endif
     StopNode();
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
+    StopValidationCallbackThread();
+    if (g_insight_index) {
+        g_insight_index->Stop();
+        g_insight_index.reset();
+    }
+    // Only overwrite mempool.dat once it has been fully loaded.
+    if (fDumpMempoolLater && GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        DumpMempool();
+    }
+    if (fDumpValidityCachesLater && GetBoolArg("-persistvaliditycaches", DEFAULT_PERSIST_VALIDITY_CACHES)) {
+        DumpValidityCaches();
+    }
+    delete pshieldedBatchVerifier;
+    pshieldedBatchVerifier = NULL;
 
     {
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
         }
+        SetBlockWriteBehind(false);
         delete pcoinsTip;
         pcoinsTip = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
+        delete pcoinsBackgroundFlush;
+        pcoinsBackgroundFlush = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
         delete pblocktree;
@@ -329,6 +376,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-allowdeprecated=<feature>", strprintf(_("Explicitly allow the use of the specified deprecated feature. Multiple instances of this parameter are permitted; values for <feature> must be selected from among {%s}"), GetAllowableDeprecatedFeatures()));
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", _("If this block is in the chain, assume that it and its ancestors are valid and skip their script and Sapling/Orchard proof verification; UTXO, nullifier, commitment tree and value pool checks still run (0 to verify all, default: 0)"));
+    if (showDebug)
+        strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to disk on a background thread while validation continues (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-blockcompression=<n>", strprintf(_("Store new blocks compressed with zstd at level <n> (1 to %d, 0 = uncompressed, default: %d). Blocks already stored stay as they are, and both kinds are read"), MAX_BLOCK_COMPRESSION, DEFAULT_BLOCK_COMPRESSION));
+    strUsage += HelpMessageOpt("-blockwritebehind", strprintf(_("Write new blocks and undo data to their files on a background thread, and sync them only when the block index is written (default: %u)"), DEFAULT_BLOCK_WRITE_BEHIND));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless '-whitelistforcerelay' is '1', in which case whitelisted peers' transactions will be relayed. RPC transactions are not affected. (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -344,16 +396,35 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory (this path cannot use '~')"));
     strUsage += HelpMessageOpt("-paramsdir=<dir>", _("Specify Juno Cash network parameters directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-dbbloombits=<n>", strprintf(_("Bits per key of the bloom filters of the block index and chain state databases (0 to disable, default: %u)"), DEFAULT_DB_BLOOM_BITS));
+        strUsage += HelpMessageOpt("-dbblocksize=<n>", strprintf(_("Approximate size in bytes of the data blocks of the block index and chain state databases (default: %u)"), DEFAULT_DB_BLOCK_SIZE));
+        strUsage += HelpMessageOpt("-dbmaxopenfiles=<n>", strprintf(_("Maximum number of table files each database keeps open (default: %u)"), DEFAULT_DB_MAX_OPEN_FILES));
+    }
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)"), DEFAULT_DEBUGLOGFILE));
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
+    strUsage += HelpMessageOpt("-hugepagearenas=<mode>", _("Place the coins cache, mempool and block index on 2MB pages: \"thp\" asks the kernel for transparent huge pages, \"hugetlb\" uses reserved huge pages while the system has free ones and transparent ones after that (default: 0)"));
+    strUsage += HelpMessageOpt("-ibdskipheaderpow", strprintf(_("Accept headers that are hash-linked to a checkpoint during initial block download without recomputing their RandomX hash; their proof-of-work target is still checked (default = %u)"), DEFAULT_IBD_SKIP_HEADER_POW));
     strUsage += HelpMessageOpt("-ibdskiptxverification", strprintf(_("Skip transaction verification during initial block download up to the last checkpoint height. Incompatible with flags that disable checkpoints. (default = %u)"), DEFAULT_IBD_SKIP_TX_VERIFICATION));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-nullifierdb", strprintf(_("Keep the Sprout, Sapling and Orchard nullifier sets in a separate database with its own cache and tuning (default: %u)"), DEFAULT_NULLIFIER_DB));
+    strUsage += HelpMessageOpt("-residentnullifiers", strprintf(_("Also keep every Sprout, Sapling and Orchard nullifier in memory (about 43 bytes each), so that double-spend checks never read the database (default: %u)"), DEFAULT_RESIDENT_NULLIFIERS));
+    strUsage += HelpMessageOpt("-mappedblockfiles=<n>", strprintf(_("Keep up to <n> block files memory-mapped for reading blocks, 0 to disable (default: %u)"), DEFAULT_MAPPED_BLOCK_FILES));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxorphantxsize=<n>", strprintf(_("Keep at most <n> kilobytes of unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-parheaders=<n>", strprintf(_("Set the number of threads used to verify RandomX proof-of-work of received headers (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+        -GetNumCores(), MAX_HEADERCHECK_THREADS, DEFAULT_HEADERCHECK_THREADS));
+    strUsage += HelpMessageOpt("-parblocks=<n>", strprintf(_("Set the number of threads used to check blocks received before their parent is connected (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+        -GetNumCores(), MAX_BLOCK_PREVALIDATION_THREADS, DEFAULT_BLOCK_PREVALIDATION_THREADS));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load it on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
+    strUsage += HelpMessageOpt("-persistvaliditycaches", strprintf(_("Whether to save the signature and shielded bundle validity caches on shutdown and load them on restart (default: %u)"), DEFAULT_PERSIST_VALIDITY_CACHES));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-proofthreads=<n>", strprintf(_("Set the number of threads used to create the proofs of shielded transactions built by this node (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+        -GetNumCores(), MAX_PROOF_THREADS, DEFAULT_PROOF_THREADS));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode disables wallet support and is incompatible with -txindex. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
@@ -365,6 +436,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
 #endif
+    strUsage += HelpMessageOpt("-schedulerthreads=<n>", strprintf(_("Set the number of threads that run periodic background tasks (1 to %d, default: %d)"), MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS));
+    strUsage += HelpMessageOpt("-shieldedindex", strprintf(_("Maintain a compact index of each block's transparent and Orchard outputs, which wallet rescans read instead of blocks that cannot involve the wallet (default: %u)"), DEFAULT_SHIELDEDINDEX));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -376,6 +449,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), DEFAULT_BANSCORE_THRESHOLD));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-compactknownfilters", strprintf(_("Track the addresses and transactions each peer knows in tables shared by all peers, rather than a bloom filter of up to 1MB per peer; for nodes with many peers (default: %u)"), DEFAULT_COMPACT_KNOWN_FILTERS));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s); -noconnect or -connect=0 alone to disable automatic connections"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + strprintf(_("(default: %u)"), DEFAULT_NAME_LOOKUP));
@@ -389,6 +463,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-mempoolevictionmemoryminutes=<n>", strprintf(_("The number of minutes before allowing rejected transactions to re-enter the mempool. (default: %u)"), DEFAULT_MEMPOOL_EVICTION_MEMORY_MINUTES));
     strUsage += HelpMessageOpt("-mempooltxcostlimit=<n>",strprintf(_("An upper bound on the maximum size in bytes of all transactions in the mempool. (default: %s)"), DEFAULT_MEMPOOL_TOTAL_COST_LIMIT));
+    strUsage += HelpMessageOpt("-msghandlerthreads=<n>", strprintf(_("Set the number of threads processing peer messages (1 to %d, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -400,9 +475,18 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    {
+        std::vector<std::string> modes;
+        for (SocketEventsMode mode : GetSupportedSocketEventsModes())
+            modes.push_back(GetSocketEventsModeName(mode));
+        strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Method used to wait for socket events, one of: %s (default: %s)"),
+            boost::algorithm::join(modes, ", "), modes.front()));
+    }
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
+    strUsage += HelpMessageOpt("-txreconciliation", strprintf(_("Announce transactions to peers that support it by set reconciliation rather than inv flooding (default: %u)"), DEFAULT_TXRECONCILIATION));
+    strUsage += HelpMessageOpt("-v2transport", strprintf(_("Support v2 transport, which encrypts and authenticates peer connections (BIP 324) (default: %u)"), DEFAULT_V2_TRANSPORT));
     strUsage += HelpMessageOpt("-whitebind=<addr>", _("Bind to given address and whitelist peers connecting to it. Use [host]:port notation for IPv6"));
     strUsage += HelpMessageOpt("-whitelist=<netmask>", _("Whitelist peers connecting from the given netmask or IP address. Can be specified multiple times.") +
         " " + _("Whitelisted peers cannot be DoS banned and their transactions are always relayed, even if they are already in the mempool, useful e.g. for a gateway"));
@@ -420,6 +504,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawblockheader=<address>", _("Enable publish raw block header in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubcompactblock=<address>", _("Enable publish compact block (BIP 152) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpub<type>hwm=<n>", strprintf(_("Set the outbound message high water mark for the <type> publisher (default: %d)"), DEFAULT_ZMQ_SNDHWM));
 #endif
 
     strUsage += HelpMessageGroup(_("Monitoring options:"));
@@ -449,6 +536,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-nuparams=hexBranchId:activationHeight", "Use given activation height for specified network upgrade (regtest-only)");
+        strUsage += HelpMessageOpt("-regtestfastpow", "Use a BLAKE2b hash instead of RandomX for proof of work (regtest-only)");
         strUsage += HelpMessageOpt("-nurejectoldversions", strprintf("Reject peers that don't know about the current epoch (regtest-only) (default: %u)", DEFAULT_NU_REJECT_OLD_VERSIONS));
         strUsage += HelpMessageOpt(
                 "-fundingstream=streamId:startHeight:endHeight:comma_delimited_addresses",
@@ -464,12 +552,15 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-nodebug", "Turn off debugging messages, same as -debug=0");
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-logratelimit=<n>", strprintf(_("Log at most <n> debugging messages a second for each category, 0 for no limit (default: %u)"), DEFAULT_LOGRATELIMIT));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
         strUsage += HelpMessageOpt("-clockoffset=<n>", "Applies offset of <n> seconds to the actual time. Incompatible with -mocktime (default: 0)");
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch. Incompatible with -clockoffset (default: 0)");
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit total size of signature and bundle caches to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxpowcachesize=<n>", strprintf("Limit size of the verified RandomX solution cache to <n> MiB (default: %u)", DEFAULT_MAX_POW_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-lockstats=<n>", strprintf("Sample the wait and hold times of one in <n> lock acquisitions for getlockstats, 0 to disable (default: %u)", DEFAULT_LOCKSTATS_INTERVAL));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Transactions must have at least this fee rate (in %s per 1000 bytes) for relaying, mining and transaction creation (default: %s). This is not the only fee constraint."),
@@ -488,6 +579,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("Node relay options:"));
     strUsage += HelpMessageOpt("-datacarrier", strprintf(_("Relay and mine data carrier transactions (default: %u)"), DEFAULT_ACCEPT_DATACARRIER));
     strUsage += HelpMessageOpt("-datacarriersize=<n>", strprintf(_("Maximum size of data in data carrier transactions we relay and mine (default: %u)"), MAX_OP_RETURN_RELAY));
+    strUsage += HelpMessageOpt("-mempoolbatchsize=<n>", strprintf(_("Verify the proofs of up to <n> relayed transactions in one batch, 0 to verify each on its own (default: %u)"), DEFAULT_MEMPOOL_BATCH_SIZE));
+    strUsage += HelpMessageOpt("-mempoolbatchwindow=<n>", strprintf(_("Wait up to <n> milliseconds for more relayed transactions to join a batch (default: %u)"), DEFAULT_MEMPOOL_BATCH_WINDOW));
     strUsage += HelpMessageOpt("-txunpaidactionlimit=<n>", strprintf(_("Transactions with more than this number of unpaid actions will not be accepted to the mempool or relayed (default: %u)"), DEFAULT_TX_UNPAID_ACTION_LIMIT));
 
     strUsage += HelpMessageGroup(_("Block creation options:"));
@@ -501,13 +594,28 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-gen", strprintf(_("Generate coins (default: %u)"), DEFAULT_GENERATE));
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads for coin generation if enabled (-1 = all cores, default: %d)"), DEFAULT_GENERATE_THREADS));
     strUsage += HelpMessageOpt("-equihashsolver=<name>", _("Specify the Equihash solver to be used if enabled (default: \"default\")"));
+    strUsage += HelpMessageOpt("-minerhostid=<n>", strprintf(_("Partition of the nonce space searched by this node's miner threads; give each node mining to the same address its own id so they never repeat work (0-%u, default: %u)"), std::numeric_limits<uint32_t>::max(), DEFAULT_MINER_HOST_ID));
+    strUsage += HelpMessageOpt("-minerthreadplacement=<policy>", _("How to pin mining threads to CPUs: \"numa\" spreads them across NUMA nodes on multi-socket systems, \"l3\" spreads them across L3 cache domains (CCXs) keeping at most one 2MB scratchpad per 2MB of L3 and using SMT siblings last, \"none\" does not pin (default: numa)"));
+    strUsage += HelpMessageOpt("-minervalidationpause=<n>", strprintf(_("Percentage of mining threads that stop hashing while a new block is connected to the tip, so it is validated and mined on sooner (0-100, default: %d)"), DEFAULT_MINER_VALIDATION_PAUSE));
+    strUsage += HelpMessageOpt("-minerways=<n>", strprintf(_("Number of RandomX VMs each mining thread interleaves, each with its own nonce range (1-%d, default: %d)"), MAX_MINER_WAYS, DEFAULT_MINER_WAYS));
     strUsage += HelpMessageOpt("-mineraddress=<addr>", _("(NOT NECESSARY) Send mined coins to a specific transparent P2PKH address (t...). A new address is generated per block if not set. Use t_getminingaddress RPC to get an address."));
+    strUsage += HelpMessageOpt("-randomxdatasetdir=<dir>", _("Keep fast mode RandomX datasets in files in a private subdirectory of <dir> (e.g. /dev/shm or a hugetlbfs mount) so restarted or co-located nodes can reuse them instead of rebuilding (default: disabled)"));
     strUsage += HelpMessageOpt("-randomxfastmode", _("Use RandomX fast mode with 2GB dataset for ~2x mining speed (default: 0)"));
+    strUsage += HelpMessageOpt("-randomxprefetch=<mode>", strprintf(_("Scratchpad prefetch instruction used by RandomX on x86-64: off, t0, nta or mov. \"auto\" measures each mode once while mining and remembers the fastest for this CPU model in %s (default: %s)"), "randomx_prefetch.json", DEFAULT_RANDOMX_PREFETCH));
+    strUsage += HelpMessageOpt("-randomxmemoryreserve=<n>", strprintf(_("In RandomX fast mode, when less than <n> MiB of memory is left to the process (host or cgroup), drop the datasets on all but one NUMA node and then fall back to light mode, restoring them once enough memory is free again; 0 to disable (default: %u)"), DEFAULT_RANDOMX_MEMORY_RESERVE));
     strUsage += HelpMessageOpt("-randomxmsr", _("Enable MSR (Model Specific Register) optimizations for 10-15% hashrate improvement (default: 1, requires setup-msr-permissions.sh)"));
     strUsage += HelpMessageOpt("-randomxcacheqos", _("Enable L3 cache QoS allocation for mining threads, 2-5% additional improvement (default: 1, requires -randomxmsr=1)"));
     strUsage += HelpMessageOpt("-randomxexceptionhandling", _("Enable Ryzen JIT exception handling for stability (default: 1)"));
     strUsage += HelpMessageOpt("-randomxhugepages", _("Use hugepages (1GB/2MB) for RandomX memory allocation for 5-10% extra performance. Requires system hugepages configured (default: 0)"));
     strUsage += HelpMessageOpt("-benchmark", _("Automatically benchmark mining performance with different thread counts and save results to benchmark.log (default: 0)"));
+    strUsage += HelpMessageOpt("-benchmarkobjective=<objective>", _("What the benchmark started from the metrics screen applies when asked to: the configuration with the highest hashrate, or with the most hashes per joule of CPU package energy (needs readable RAPL counters): hashrate or efficiency (default: hashrate)"));
+    strUsage += HelpMessageOpt("-benchmarkrandomx", _("Measure RandomX hashrate for each thread count and mode instead of mining, print the results as JSON to standard output and exit (default: 0)"));
+    strUsage += HelpMessageOpt("-benchmarkrandomxthreads=<n,...>", _("Comma-separated thread counts for -benchmarkrandomx (default: 1 to the number of CPUs)"));
+    strUsage += HelpMessageOpt("-benchmarkrandomxmodes=<mode,...>", _("Comma-separated RandomX modes for -benchmarkrandomx: Light, Fast, Fast+Hugepages (default: all)"));
+    strUsage += HelpMessageOpt("-benchmarkrandomxseconds=<n>", strprintf(_("Seconds to measure each -benchmarkrandomx point after warmup (default: %d)"), DEFAULT_RANDOMX_BENCHMARK_SECONDS));
+    strUsage += HelpMessageOpt("-stratumport=<port>", _("Serve mining jobs to external RandomX miners over Stratum on <port>, pushing a new job as soon as the block template changes (default: disabled)"));
+    strUsage += HelpMessageOpt("-stratumbind=<addr>", strprintf(_("Bind the Stratum server to the given address (default: %s)"), DEFAULT_STRATUM_BIND));
+    strUsage += HelpMessageOpt("-stratumdifficulty=<n>", strprintf(_("Accept Stratum shares meeting the minimum difficulty target divided by <n> (default: %d)"), DEFAULT_STRATUM_DIFFICULTY));
     strUsage += HelpMessageOpt("-minetolocalwallet", strprintf(
             _("Require that mined blocks use a coinbase address in the local wallet (default: %u)"),
  #ifdef ENABLE_WALLET
@@ -527,15 +635,17 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcauth=<userpw>", _("Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 8232, 18232));
+    strUsage += HelpMessageOpt("-rpcunixsocket=<path>", _("Also listen for JSON-RPC and REST connections on the Unix domain socket <path>, for services on the same host. Relative paths are prefixed by the data dir; only the user running the node may connect"));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcprioritymethod=<method>", _("Serve calls to this JSON-RPC method ahead of other queued calls. This option can be specified multiple times (default: submitblock and getblocktemplate)"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcblockingthreads=<n>", strprintf(_("Set the number of threads that RPC calls such as getblock, gettxout and z_getbalance wait for disk reads and locks on, leaving the RPC threads free for other calls (default: %d)"), DEFAULT_RPC_BLOCKING_THREADS));
     if (showDebug) {
-        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls, shared fairly between clients and methods (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
-    // Disabled until we can lock notes and also tune performance of the prover which by default uses multiple threads
-    //strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of threads to service Async RPC calls (default: %d)"), 1));
+    strUsage += HelpMessageOpt("-rpcasyncthreads=<n>", strprintf(_("Set the number of asynchronous operations such as z_sendmany that are built and proven at once (1 to %d, default: %d)"), MAX_RPC_ASYNC_THREADS, DEFAULT_RPC_ASYNC_THREADS));
 
     if (mode == HMM_BITCOIND) {
         strUsage += HelpMessageGroup(_("Metrics Options (only if -daemon and -printtoconsole are not set):"));
@@ -560,7 +670,9 @@ static void BlockNotifyCallback(bool initialSync, const CBlockIndex *pBlockIndex
     std::string strCmd = GetArg("-blocknotify", "");
 
     boost::replace_all(strCmd, "%s", pBlockIndex->GetBlockHash().GetHex());
-    boost::thread t(runCommand, strCmd); // thread runs free
+    QueueValidationCallback("blocknotify", [strCmd] {
+        boost::thread t(runCommand, strCmd); // thread runs free
+    });
 }
 
 static void TxExpiryNotifyCallback(const uint256& txid)
@@ -752,6 +864,25 @@ void ThreadStartWalletNotifier()
     ThreadNotifyWallets(pindexLastTip);
 }
 
+#ifdef ENABLE_MINING
+// -benchmarkrandomx: print the results as JSON to stdout and shut down
+void ThreadRandomXBenchmark(RandomXBenchmarkOptions options)
+{
+    RenameThread("zcash-rxbench");
+
+    std::vector<RandomXBenchmarkPoint> results;
+    std::string error;
+    if (RunRandomXBenchmark(options, results, error)) {
+        fprintf(stdout, "%s\n", RandomXBenchmarkToJSON(results).write(2).c_str());
+        fflush(stdout);
+    } else {
+        LogPrintf("RandomX benchmark failed: %s\n", error);
+        fprintf(stderr, "Error: RandomX benchmark failed: %s\n", error.c_str());
+    }
+    StartShutdown();
+}
+#endif
+
 void ThreadImport(std::vector<fs::path> vImportFiles, const CChainParams& chainparams)
 {
     RenameThread("zcash-loadblk");
@@ -829,6 +960,12 @@ void ThreadImport(std::vector<fs::path> vImportFiles, const CChainParams& chainp
         LogPrintf("Stopping after block import\n");
         StartShutdown();
     }
+
+    // The node is already serving peers and RPC while this runs.
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadMempool(chainparams);
+        fDumpMempoolLater = !ShutdownRequested();
+    }
 }
 
 /** Sanity checks
@@ -852,6 +989,24 @@ bool InitSanityCheck(void)
 }
 
 
+static std::mutex cs_initPhases;
+static std::vector<std::pair<std::string, int64_t>> vInitPhases;
+
+/** Record that a startup phase begun at nStartMillis has finished. */
+static void RecordInitPhase(const std::string& strPhase, int64_t nStartMillis)
+{
+    int64_t nMillis = GetTimeMillis() - nStartMillis;
+    LogPrintf("init: %s took %dms\n", strPhase, nMillis);
+    std::lock_guard<std::mutex> lock(cs_initPhases);
+    vInitPhases.emplace_back(strPhase, nMillis);
+}
+
+std::vector<std::pair<std::string, int64_t>> GetInitPhaseTimes()
+{
+    std::lock_guard<std::mutex> lock(cs_initPhases);
+    return vInitPhases;
+}
+
 static void ZC_LoadParams(
     const CChainParams& chainparams
 )
@@ -867,7 +1022,7 @@ static void ZC_LoadParams(
 
     LogPrintf("Sprout parameters will be fetched from %s if needed\n", sprout_groth16.string().c_str());
     LogPrintf("Sapling parameters are bundled in this binary\n");
-    LogPrintf("Orchard parameters are generated deterministically\n");
+    LogPrintf("Orchard parameters are generated deterministically; the proving key is built on first use\n");
 
     gettimeofday(&tv_start, 0);
 
@@ -978,6 +1133,7 @@ void InitLogging()
     fPrintToConsole = GetBoolArg("-printtoconsole", false);
     fLogTimestamps = GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    nLogRateLimit = std::max<int64_t>(GetArg("-logratelimit", DEFAULT_LOGRATELIMIT), 0);
 
     // Set up the initial filtering directive from the -debug flags.
     std::string initialFilter = LogConfigFilter();
@@ -1021,6 +1177,8 @@ void InitLogging()
  */
 bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 {
+    const int64_t nInitStart = GetTimeMillis();
+
     // ********************************************************* Step 1: setup
 #ifdef _MSC_VER
     // Turn off Microsoft heap dump noise
@@ -1097,13 +1255,28 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 #endif
     }
 
+    if (mapArgs.count("-socketevents")) {
+        auto mode = ParseSocketEventsMode(GetArg("-socketevents", ""));
+        if (!mode.has_value())
+            return InitError(strprintf(_("Unsupported -socketevents mode: '%s'"), GetArg("-socketevents", "")));
+        socketEventsMode = mode.value();
+    }
+    if (!MakeSocketEvents(socketEventsMode)) {
+        InitWarning(strprintf(_("Could not use %s to wait for socket events, falling back to select"), GetSocketEventsModeName(socketEventsMode)));
+        socketEventsMode = SocketEventsMode::Select;
+    }
+
+    nMessageHandlerThreads = std::min<int>(std::max<int>(GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS), 1), MAX_MESSAGE_HANDLER_THREADS);
+
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
-    // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS), 0);
+    // Trim requested connection counts, to fit into system limitations. Only
+    // select() cannot watch descriptors beyond FD_SETSIZE.
+    if (socketEventsMode == SocketEventsMode::Select)
+        nMaxConnections = std::max(std::min(nMaxConnections, FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1161,9 +1334,63 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     mempool.SetMempoolCostLimit(mempoolTotalCostLimit, mempoolEvictionMemorySeconds);
 
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    g_lockstats_interval = std::max<int64_t>(GetArg("-lockstats", DEFAULT_LOCKSTATS_INTERVAL), 0);
     fIBDSkipTxVerification = GetBoolArg("-ibdskiptxverification", DEFAULT_IBD_SKIP_TX_VERIFICATION);
+    fIBDSkipHeaderPoW = GetBoolArg("-ibdskipheaderpow", DEFAULT_IBD_SKIP_HEADER_POW);
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    std::string strAssumeValid = GetArg("-assumevalid", "0");
+    if (strAssumeValid != "0") {
+        if (strAssumeValid.size() != 64 || !IsHex(strAssumeValid))
+            return InitError(strprintf(_("Invalid block hash for -assumevalid=<hex>: '%s'"), strAssumeValid));
+        hashAssumeValid = uint256S(strAssumeValid);
+        LogPrintf("Assuming ancestors of block %s have valid scripts and proofs\n", hashAssumeValid.GetHex());
+    }
+
+    fBackgroundFlush = GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH);
+
+    CDBTuning dbTuning;
+    dbTuning.nBloomBits = GetArg("-dbbloombits", DEFAULT_DB_BLOOM_BITS);
+    dbTuning.nMaxOpenFiles = GetArg("-dbmaxopenfiles", DEFAULT_DB_MAX_OPEN_FILES);
+    int64_t nDBBlockSize = GetArg("-dbblocksize", DEFAULT_DB_BLOCK_SIZE);
+    if (dbTuning.nBloomBits < 0 || dbTuning.nBloomBits > 64)
+        return InitError(_("-dbbloombits must be between 0 and 64"));
+    if (dbTuning.nMaxOpenFiles < 1)
+        return InitError(_("-dbmaxopenfiles must be at least 1"));
+    if (nDBBlockSize < 1024 || nDBBlockSize > (4 << 20))
+        return InitError(strprintf(_("-dbblocksize must be between 1024 and %d"), 4 << 20));
+    dbTuning.nBlockSize = nDBBlockSize;
+    SetDefaultDBTuning(dbTuning);
+
+    int64_t nMappedBlockFiles = GetArg("-mappedblockfiles", DEFAULT_MAPPED_BLOCK_FILES);
+    if (nMappedBlockFiles < 0)
+        return InitError(_("-mappedblockfiles must not be negative"));
+    SetMappedBlockFiles(nMappedBlockFiles);
+
+    int64_t nBlockCompression = GetArg("-blockcompression", DEFAULT_BLOCK_COMPRESSION);
+    if (nBlockCompression < 0 || nBlockCompression > MAX_BLOCK_COMPRESSION)
+        return InitError(strprintf(_("-blockcompression must be between 0 and %d"), MAX_BLOCK_COMPRESSION));
+    if (nBlockCompression > 0 && !BlockCompressionAvailable())
+        return InitError(_("-blockcompression is not supported by this build, which has no zstd support"));
+    SetBlockCompression(nBlockCompression);
+    SetBlockWriteBehind(GetBoolArg("-blockwritebehind", DEFAULT_BLOCK_WRITE_BEHIND));
+
+    HugePageMode hugePageMode;
+    if (!ParseHugePageMode(GetArg("-hugepagearenas", "0"), hugePageMode))
+        return InitError(strprintf(_("Invalid value for -hugepagearenas=<mode>: '%s' (must be 0, thp or hugetlb)"), GetArg("-hugepagearenas", "")));
+    if (hugePageMode != HugePageMode::OFF) {
+        LogPrintf("Placing the coins cache, mempool and block index on %s pages\n",
+                  hugePageMode == HugePageMode::HUGETLB ? "reserved huge" : "transparent huge");
+    }
+    SetHugePageMode(hugePageMode);
+
+    int64_t nMempoolBatchSize = GetArg("-mempoolbatchsize", DEFAULT_MEMPOOL_BATCH_SIZE);
+    int64_t nMempoolBatchWindow = GetArg("-mempoolbatchwindow", DEFAULT_MEMPOOL_BATCH_WINDOW);
+    if (nMempoolBatchSize < 0)
+        return InitError(_("-mempoolbatchsize must not be negative"));
+    if (nMempoolBatchWindow < 0 || nMempoolBatchWindow > 1000)
+        return InitError(_("-mempoolbatchwindow must be between 0 and 1000"));
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
@@ -1173,6 +1400,29 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // -parheaders=0 means autodetect, but nHeaderCheckThreads==0 means no concurrency
+    nHeaderCheckThreads = ClampHeaderCheckThreads(GetArg("-parheaders", DEFAULT_HEADERCHECK_THREADS), GetNumCores());
+
+    // -parblocks=0 means autodetect; there is no master thread, so a single
+    // pre-validation thread still runs alongside block connection
+    nBlockPreValidationThreads = GetArg("-parblocks", DEFAULT_BLOCK_PREVALIDATION_THREADS);
+    if (nBlockPreValidationThreads <= 0)
+        nBlockPreValidationThreads += GetNumCores();
+    if (nBlockPreValidationThreads < 0)
+        nBlockPreValidationThreads = 0;
+    else if (nBlockPreValidationThreads > MAX_BLOCK_PREVALIDATION_THREADS)
+        nBlockPreValidationThreads = MAX_BLOCK_PREVALIDATION_THREADS;
+
+    // -proofthreads=0 means autodetect; proofs always get at least one thread
+    int nProofThreads = GetArg("-proofthreads", DEFAULT_PROOF_THREADS);
+    if (nProofThreads <= 0)
+        nProofThreads += GetNumCores();
+    if (nProofThreads < 1)
+        nProofThreads = 1;
+    else if (nProofThreads > MAX_PROOF_THREADS)
+        nProofThreads = MAX_PROOF_THREADS;
+    init::proof_threadpool(nProofThreads);
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1190,6 +1440,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 
     RegisterAllCoreRPCCommands(tableRPC);
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 #ifdef ENABLE_WALLET
     bool fDisableWallet = GetBoolArg("-disablewallet", false);
     if (!fDisableWallet)
@@ -1255,6 +1508,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     if (GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices |= NODE_BLOOM;
+    if (GetBoolArg("-v2transport", DEFAULT_V2_TRANSPORT))
+        nLocalServices |= NODE_P2P_V2;
+
+    fTxReconciliation = GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION);
 
     nMaxTipAge = GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
@@ -1448,6 +1705,68 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    std::string strPrefetch = GetArg("-randomxprefetch", DEFAULT_RANDOMX_PREFETCH);
+    RandomX_ScratchpadPrefetchMode prefetchMode;
+    if (strPrefetch != "auto" && !RandomX_ParseScratchpadPrefetchMode(strPrefetch, prefetchMode)) {
+        return InitError(strprintf(
+            _("Invalid value for -randomxprefetch=<mode>: '%s' (must be off, t0, nta, mov or auto)"),
+            strPrefetch));
+    }
+
+    int64_t nRandomXMemoryReserve = GetArg("-randomxmemoryreserve", DEFAULT_RANDOMX_MEMORY_RESERVE);
+    if (nRandomXMemoryReserve < 0 || nRandomXMemoryReserve > std::numeric_limits<int64_t>::max() >> 20) {
+        return InitError(strprintf(
+            _("Invalid value for -randomxmemoryreserve=<n>: '%s' (must be a number of MiB, or 0 to disable)"),
+            GetArg("-randomxmemoryreserve", "")));
+    }
+
+    std::string strBenchmarkObjective = GetArg("-benchmarkobjective", "hashrate");
+    if (strBenchmarkObjective != "hashrate" && strBenchmarkObjective != "efficiency") {
+        return InitError(strprintf(
+            _("Invalid value for -benchmarkobjective=<objective>: '%s' (must be hashrate or efficiency)"),
+            strBenchmarkObjective));
+    }
+
+    ThreadPlacementPolicy threadPlacement;
+    if (!ParseThreadPlacementPolicy(GetArg("-minerthreadplacement", "numa"), threadPlacement)) {
+        return InitError(strprintf(
+            _("Invalid value for -minerthreadplacement=<policy>: '%s' (must be none, numa or l3)"),
+            GetArg("-minerthreadplacement", "")));
+    }
+
+    int64_t nMinerHostId = GetArg("-minerhostid", DEFAULT_MINER_HOST_ID);
+    if (nMinerHostId < 0 || nMinerHostId > std::numeric_limits<uint32_t>::max()) {
+        return InitError(strprintf(
+            _("Invalid value for -minerhostid=<n>: '%s' (must be between 0 and %u)"),
+            GetArg("-minerhostid", ""), std::numeric_limits<uint32_t>::max()));
+    }
+
+    RandomXBenchmarkOptions randomxBenchmarkOptions;
+    if (mapArgs.count("-benchmarkrandomxthreads") &&
+        !ParseRandomXBenchmarkThreads(mapArgs["-benchmarkrandomxthreads"], randomxBenchmarkOptions.threads)) {
+        return InitError(strprintf(
+            _("Invalid value for -benchmarkrandomxthreads=<n,...>: '%s' (must be positive thread counts separated by commas)"),
+            mapArgs["-benchmarkrandomxthreads"]));
+    }
+    if (mapArgs.count("-benchmarkrandomxmodes") &&
+        !ParseRandomXBenchmarkModes(mapArgs["-benchmarkrandomxmodes"], randomxBenchmarkOptions.modes)) {
+        return InitError(strprintf(
+            _("Invalid value for -benchmarkrandomxmodes=<mode,...>: '%s' (must be Light, Fast or Fast+Hugepages separated by commas)"),
+            mapArgs["-benchmarkrandomxmodes"]));
+    }
+    randomxBenchmarkOptions.seconds = GetArg("-benchmarkrandomxseconds", DEFAULT_RANDOMX_BENCHMARK_SECONDS);
+    if (randomxBenchmarkOptions.seconds < 1) {
+        return InitError(strprintf(
+            _("Invalid value for -benchmarkrandomxseconds=<n>: '%s' (must be at least 1)"),
+            GetArg("-benchmarkrandomxseconds", "")));
+    }
+
+    if (GetArg("-stratumdifficulty", DEFAULT_STRATUM_DIFFICULTY) < 1) {
+        return InitError(strprintf(
+            _("Invalid value for -stratumdifficulty=<n>: '%s' (must be at least 1)"),
+            GetArg("-stratumdifficulty", "")));
+    }
+
     // Validate donation configuration
     if (mapArgs.count("-donationpercentage")) {
         int donationPercent = GetArg("-donationpercentage", 0);
@@ -1527,14 +1846,27 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // - Transparent signature validity.
     // - Sapling bundle validity.
     // - Orchard bundle validity.
-    // Assign half of the cap to transparent signatures, and split the rest
-    // between Sapling and Orchard bundles.
+    // Assign half of the cap to transparent signatures and nearly all of the
+    // rest to Orchard bundles: Sapling bundles are rejected by consensus on
+    // this Orchard-only chain, so their cache is kept small.
     size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
     if (nMaxCacheSize <= 0) {
         return InitError(strprintf(_("-maxsigcachesize must be at least 1")));
     }
+    // The caches saved at the last shutdown are restored as they are created,
+    // so that the mempool's transactions are not verified again in blocks.
+    if (GetBoolArg("-persistvaliditycaches", DEFAULT_PERSIST_VALIDITY_CACHES)) {
+        LoadValidityCaches();
+    }
     InitSignatureCache(nMaxCacheSize / 2);
-    bundlecache::init(nMaxCacheSize / 4);
+    bundlecache::init(nMaxCacheSize / 16, nMaxCacheSize / 2 - nMaxCacheSize / 16);
+    fDumpValidityCachesLater = true;
+
+    int64_t nMaxPoWCacheSize = GetArg("-maxpowcachesize", DEFAULT_MAX_POW_CACHE_SIZE);
+    if (nMaxPoWCacheSize < 1) {
+        return InitError(strprintf(_("-maxpowcachesize must be at least 1")));
+    }
+    InitPoWCache(nMaxPoWCacheSize * ((size_t) 1 << 20));
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1542,9 +1874,26 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
-    // Start the lightweight task scheduler thread
+    LogPrintf("Using %u threads for header proof-of-work verification\n", nHeaderCheckThreads);
+    if (nHeaderCheckThreads) {
+        for (int i=0; i<nHeaderCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
+    }
+
+    LogPrintf("Using %u threads for block pre-validation\n", nBlockPreValidationThreads);
+    for (int i=0; i<nBlockPreValidationThreads; i++)
+        threadGroup.create_thread(&ThreadBlockPreValidation);
+
+    // Start the lightweight task scheduler threads
+    int nSchedulerThreads = GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS);
+    if (nSchedulerThreads < 1 || nSchedulerThreads > MAX_SCHEDULER_THREADS)
+        return InitError(strprintf(_("-schedulerthreads must be between 1 and %d"), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+
+    // Run the validation notifications that may lag behind the tip on a thread of their own
+    StartValidationCallbackThread();
 
     // Count uptime
     MarkStartTime();
@@ -1571,7 +1920,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         if (!metrics_run(metricsBindCstr, vAllowCstr.data(), vAllowCstr.size(), prometheusPort, debugMetrics)) {
             return InitError(strprintf(_("Failed to start Prometheus metrics exporter")));
         }
+        ConnectPrometheusMetrics(scheduler);
     }
+    ConnectMetricsStats(scheduler);
+    ConnectPerformanceHistory(scheduler);
 
     // Expose binary metadata to metrics, using a single time series with value 1.
     // https://www.robustperception.io/exposing-the-software-version-to-prometheus
@@ -1589,8 +1941,27 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         );
     }
 
-    // Initialize Zcash circuit parameters
-    ZC_LoadParams(chainparams);
+    // Nothing needs the circuit parameters or RandomX until the block index
+    // is loaded, so set them up on their own threads while the servers,
+    // network and databases are started below.
+    std::future<void> zkParamsLoaded = std::async(std::launch::async, [&chainparams] {
+        int64_t nPhaseStart = GetTimeMillis();
+        ZC_LoadParams(chainparams);
+        RecordInitPhase("zkparams", nPhaseStart);
+    });
+    std::future<void> randomxInitialized = std::async(std::launch::async, [&chainparams] {
+        // Nothing is hashed with RandomX when regtest uses its fast hash
+        if (chainparams.GetConsensus().fPowFastHash) return;
+        int64_t nPhaseStart = GetTimeMillis();
+        RandomX_SetSharedDatasetDir(GetArg("-randomxdatasetdir", ""));
+        RandomX_Init(GetBoolArg("-randomxfastmode", false), GetBoolArg("-randomxhugepages", false));
+        RecordInitPhase("randomx", nPhaseStart);
+    });
+    if (nRandomXMemoryReserve > 0) {
+        scheduler.scheduleEvery([nRandomXMemoryReserve] {
+            RandomX_CheckMemoryPressure(nRandomXMemoryReserve << 20);
+        }, RANDOMX_MEMORY_CHECK_INTERVAL);
+    }
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1608,12 +1979,20 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 5: verify wallet database integrity
 #ifdef ENABLE_WALLET
+    // The wallet file is independent of the chain, so it is verified while
+    // the block index loads, and the result awaited before the wallet loads.
+    std::future<bool> walletVerified;
     if (!fDisableWallet) {
-        if (!CWallet::Verify())
-            return false;
+        walletVerified = std::async(std::launch::async, [] {
+            int64_t nPhaseStart = GetTimeMillis();
+            bool fVerified = CWallet::Verify();
+            RecordInitPhase("walletverify", nPhaseStart);
+            return fVerified;
+        });
     } // (!fDisableWallet)
 #endif // ENABLE_WALLET
     // ********************************************************* Step 6: network initialization
+    nStart = GetTimeMillis();
 
     RegisterNodeSignals(GetNodeSignals());
 
@@ -1737,7 +2116,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     pzmqNotificationInterface = CZMQNotificationInterface::CreateWithArguments(mapArgs);
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        RegisterValidationInterface(pzmqNotificationInterface, "zmq");
     }
 #endif
     if (mapArgs.count("-maxuploadtarget")) {
@@ -1746,6 +2125,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET)*1024*1024);
     }
 
+    RecordInitPhase("network", nStart);
+
     // ********************************************************* Step 7: load block chain
 
     fReindex = GetBoolArg("-reindex", false);
@@ -1773,9 +2154,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    int64_t nNullifierDBCache = 0;
+    if (GetBoolArg("-nullifierdb", DEFAULT_NULLIFIER_DB)) {
+        nNullifierDBCache = nCoinDBCache / 100 * NULLIFIER_DB_CACHE_PERCENT;
+        nCoinDBCache -= nNullifierDBCache;
+    }
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    if (nNullifierDBCache > 0) {
+        LogPrintf("* Using %.1fMiB for nullifier database\n", nNullifierDBCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
     bool clearWitnessCaches = false;
@@ -1792,13 +2181,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
-                delete pcoinsdbview;
                 delete pcoinscatcher;
+                delete pcoinsBackgroundFlush;
+                delete pcoinsdbview;
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
-                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState, nNullifierDBCache,
+                                                GetBoolArg("-residentnullifiers", DEFAULT_RESIDENT_NULLIFIERS));
+                pcoinsBackgroundFlush = new CCoinsViewBackgroundFlush(pcoinsdbview);
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsBackgroundFlush);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
                 if (fReindex) {
@@ -1808,16 +2200,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                         CleanupBlockRevFiles();
                 }
 
-                // Juno Cash: Initialize RandomX before loading block index
-                // This is required for PoW validation during LoadBlockIndex
-                bool randomxFastMode = GetBoolArg("-randomxfastmode", false);
-                bool randomxHugePages = GetBoolArg("-randomxhugepages", false);
-                RandomX_Init(randomxFastMode, randomxHugePages);
+                // Juno Cash: RandomX is required for PoW validation during
+                // LoadBlockIndex, so wait for its initialization to finish
+                if (randomxInitialized.valid())
+                    randomxInitialized.get();
 
+                int64_t nPhaseStart = GetTimeMillis();
                 if (!LoadBlockIndex()) {
                     strLoadError = _("Error loading block database");
                     break;
                 }
+                RecordInitPhase("blockindex", nPhaseStart);
 
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
@@ -1838,15 +2231,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
-                // Check for changed -insightexplorer state
-                bool fInsightExplorerPreviouslySet = false;
-                pblocktree->ReadFlag("insightexplorer", fInsightExplorerPreviouslySet);
-                if (fExperimentalInsightExplorer != fInsightExplorerPreviouslySet) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -insightexplorer");
+                // Check for changed -shieldedindex state
+                if (fShieldedIndex != GetBoolArg("-shieldedindex", DEFAULT_SHIELDEDINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -shieldedindex");
                     break;
                 }
 
-                // Check for changed -lightwalletd state
+                // Check for changed -lightwalletd state. Its subtrees are
+                // kept in the chain state, so they need a reindex.
                 bool fLightWalletdPreviouslySet = false;
                 pblocktree->ReadFlag("lightwalletd", fLightWalletdPreviouslySet);
                 if (fExperimentalLightWalletd != fLightWalletdPreviouslySet) {
@@ -1854,6 +2246,35 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // Turning -insightexplorer on only needs the insight index to
+                // be rebuilt from the start, which it does in the background
+                // once it is started below. Turning it off leaves the address
+                // index that -lightwalletd uses as it is.
+                bool fInsightExplorerPreviouslySet = false;
+                pblocktree->ReadFlag("insightexplorer", fInsightExplorerPreviouslySet);
+                if (fExperimentalInsightExplorer != fInsightExplorerPreviouslySet) {
+                    if (!pblocktree->WriteFlag("insightexplorer", fExperimentalInsightExplorer) ||
+                        (fExperimentalInsightExplorer && !pblocktree->WriteInsightIndexBestBlock(uint256()))) {
+                        strLoadError = _("Error writing to the block database");
+                        break;
+                    }
+                    fAddressIndex = fExperimentalInsightExplorer || fExperimentalLightWalletd;
+                    fSpentIndex = fExperimentalInsightExplorer;
+                    fTimestampIndex = fExperimentalInsightExplorer;
+                }
+
+                // Address indexes written before the address summaries were
+                // kept are rebuilt in the background to add them.
+                bool fAddressSummaries = false;
+                pblocktree->ReadFlag("addresssummaries", fAddressSummaries);
+                if (fAddressIndex && !fAddressSummaries) {
+                    if (!pblocktree->WriteInsightIndexBestBlock(uint256()) ||
+                        !pblocktree->WriteFlag("addresssummaries", true)) {
+                        strLoadError = _("Error writing to the block database");
+                        break;
+                    }
+                }
+
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1886,11 +2307,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     }
                 }
 
+                // Reconnecting blocks checks their proofs.
+                if (zkParamsLoaded.valid())
+                    zkParamsLoaded.get();
+
+                nPhaseStart = GetTimeMillis();
                 if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
                               GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
                     strLoadError = _("Corrupted block database detected");
                     break;
                 }
+                RecordInitPhase("verifydb", nPhaseStart);
 
                 if (fExperimentalLightWalletd) {
                     LOCK(cs_main);
@@ -1970,6 +2397,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         return false;
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
+    RecordInitPhase("loadchain", nStart);
 
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
@@ -1977,9 +2405,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         pwalletMain = NULL;
         LogPrintf("Wallet disabled!\n");
     } else {
+        if (!walletVerified.get())
+            return false;
+        nStart = GetTimeMillis();
         CWallet::InitLoadWallet(chainparams, clearWitnessCaches || fReindex);
         if (!pwalletMain)
             return false;
+        RecordInitPhase("wallet", nStart);
     }
 #else // ENABLE_WALLET
     LogPrintf("No wallet support compiled in!\n");
@@ -2080,9 +2512,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
 
+    // Build the insight explorer and lightwalletd indexes in the background,
+    // following the blocks that are imported or downloaded from here on.
+    if (fAddressIndex) {
+        g_insight_index = std::make_unique<InsightIndex>();
+        if (!g_insight_index->Start()) {
+            return InitError(_("Error starting the insight index"));
+        }
+    }
+
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles, chainparams));
 
     // Wait for genesis block to be processed
+    nStart = GetTimeMillis();
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
         // We previously could hang here if StartShutdown() is called prior to
@@ -2096,6 +2538,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (!fHaveGenesis) {
         return false;
     }
+    RecordInitPhase("genesiswait", nStart);
 
     if (ShutdownRequested()) {
         return false;
@@ -2125,6 +2568,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup, scheduler);
 
+    if (nMempoolBatchSize > 0) {
+        pshieldedBatchVerifier = new CShieldedBatchVerifier(
+            nMempoolBatchSize, std::chrono::milliseconds(nMempoolBatchWindow), WakeMessageHandler);
+    }
+    SetCompactKnownFilters(GetBoolArg("-compactknownfilters", DEFAULT_COMPACT_KNOWN_FILTERS));
     StartNode(threadGroup, scheduler);
 
 #ifdef ENABLE_MINING
@@ -2132,7 +2580,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     bool enableMining = GetBoolArg("-gen", DEFAULT_GENERATE);
     bool benchmarkMode = GetBoolArg("-benchmark", false);
 
-    if (benchmarkMode) {
+    if (GetBoolArg("-benchmarkrandomx", false)) {
+        // Headless benchmark: print the results and shut down instead of mining
+        LogPrintf("RandomX benchmark mode enabled\n");
+        threadGroup.create_thread(boost::bind(&ThreadRandomXBenchmark, randomxBenchmarkOptions));
+    } else if (benchmarkMode) {
         // Benchmark mode: automatically test different thread counts
         LogPrintf("Benchmark mode enabled\n");
 
@@ -2167,10 +2619,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             SetMiningStartTime();  // Track start time for progress display
         }
     }
+
+    if (!StartStratumServer(chainparams))
+        return InitError(_("Unable to start Stratum server. See debug log for details."));
 #endif
 
     // ********************************************************* Step 12: finished
 
+    RecordInitPhase("total", nInitStart);
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading"));
 
@@ -7,7 +7,10 @@
 #ifndef BITCOIN_INIT_H
 #define BITCOIN_INIT_H
 
+#include <stdint.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <tracing.h>
 
@@ -31,6 +34,8 @@ void InitLogging();
 //!Parameter interaction: change current parameters depending on various rules
 void InitParameterInteraction();
 bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler);
+/** How long each startup phase took, in milliseconds, in the order they finished */
+std::vector<std::pair<std::string, int64_t>> GetInitPhaseTimes();
 
 /** The help message mode determines what help message to show */
 enum HelpMessageMode {
@@ -12,6 +12,7 @@
 #include "random.h"
 
 #include <secp256k1.h>
+#include <secp256k1_ellswift.h>
 #include <secp256k1_recovery.h>
 
 static secp256k1_context* secp256k1_context_sign = NULL;
@@ -201,6 +202,27 @@ CPubKey CKey::GetPubKey() const {
     return result;
 }
 
+EllSwiftPubKey CKey::EllSwiftCreate(const unsigned char* entropy32) const {
+    assert(fValid);
+    unsigned char ellswift[EllSwiftPubKey::SIZE];
+    int ret = secp256k1_ellswift_create(secp256k1_context_sign, ellswift, begin(), entropy32);
+    assert(ret);
+    return EllSwiftPubKey(ellswift);
+}
+
+ECDHSecret CKey::ComputeBIP324ECDHSecret(const EllSwiftPubKey& theirs, const EllSwiftPubKey& ours, bool fInitiator) const {
+    assert(fValid);
+    ECDHSecret secret;
+    // Party A is the initiator.
+    const EllSwiftPubKey& a = fInitiator ? ours : theirs;
+    const EllSwiftPubKey& b = fInitiator ? theirs : ours;
+    int ret = secp256k1_ellswift_xdh(secp256k1_context_sign, secret.data(), a.begin(), b.begin(), begin(),
+                                     fInitiator ? 0 : 1, secp256k1_ellswift_xdh_hash_function_bip324, NULL);
+    // Only fails for an invalid secret key.
+    assert(ret);
+    return secret;
+}
+
 bool CKey::Sign(const uint256 &hash, std::vector<unsigned char>& vchSig, uint32_t test_case) const {
     if (!fValid)
         return false;
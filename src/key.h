@@ -12,6 +12,7 @@
 #include "support/allocators/secure.h"
 #include "uint256.h"
 
+#include <array>
 #include <stdexcept>
 #include <vector>
 
@@ -22,6 +23,9 @@
  */
 typedef std::vector<unsigned char, secure_allocator<unsigned char> > CPrivKey;
 
+/** The secret two peers share after a BIP 324 key exchange. */
+typedef std::array<unsigned char, 32> ECDHSecret;
+
 /** An encapsulated private key. */
 class CKey
 {
@@ -143,6 +147,19 @@ public:
      */
     bool VerifyPubKey(const CPubKey& vchPubKey) const;
 
+    /**
+     * Compute the ElligatorSwift encoding of the public key, made different
+     * each time by 32 bytes of entropy.
+     */
+    EllSwiftPubKey EllSwiftCreate(const unsigned char* entropy32) const;
+
+    /**
+     * Compute the secret shared with a peer from both sides' ElligatorSwift
+     * public keys, as in BIP 324. fInitiator tells whether we opened the
+     * connection, so that both sides hash the keys in the same order.
+     */
+    ECDHSecret ComputeBIP324ECDHSecret(const EllSwiftPubKey& theirs, const EllSwiftPubKey& ours, bool fInitiator) const;
+
     //! Load private key and check that public key matches.
     bool Load(CPrivKey& privkey, CPubKey& vchPubKey, bool fSkipCheck);
 
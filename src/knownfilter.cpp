@@ -0,0 +1,172 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "knownfilter.h"
+
+#include "hash.h"
+#include "random.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+
+CSharedKnownFilter::CSharedKnownFilter(const CClock* clockIn, int64_t nExpirySecondsIn, size_t nMaxEntriesIn) :
+    clock(clockIn), nExpirySeconds(nExpirySecondsIn), nMaxEntries(nMaxEntriesIn),
+    k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+uint64_t CSharedKnownFilter::Key(const unsigned char* data, size_t size) const
+{
+    return CSipHasher(k0, k1).Write(data, size).Finalize();
+}
+
+int CSharedKnownFilter::AllocateSlot()
+{
+    LOCK(cs);
+    if (vFreeSlots.empty()) {
+        return nSlots++;
+    }
+    // Reuse the lowest free slot, to keep the bitmaps short.
+    auto it = std::min_element(vFreeSlots.begin(), vFreeSlots.end());
+    int nSlot = *it;
+    *it = vFreeSlots.back();
+    vFreeSlots.pop_back();
+    return nSlot;
+}
+
+void CSharedKnownFilter::ReleaseSlot(int nSlot)
+{
+    LOCK(cs);
+    assert(nSlot >= 0 && nSlot < nSlots);
+    vFreeSlots.push_back(nSlot);
+}
+
+void CSharedKnownFilter::ClearSlot(int nSlot)
+{
+    LOCK(cs);
+    size_t nWord = nSlot / 32;
+    uint32_t mask = ~(uint32_t(1) << (nSlot % 32));
+    for (auto& entry : mapKnown) {
+        if (nWord < entry.second.size()) {
+            entry.second[nWord] &= mask;
+        }
+    }
+}
+
+void CSharedKnownFilter::Insert(int nSlot, uint64_t key)
+{
+    LOCK(cs);
+    int64_t nNow = clock->GetTime();
+    auto result = mapKnown.emplace(key, prevector<4, uint32_t>());
+    if (result.second) {
+        queueAdded.emplace_back(nNow, key);
+    }
+    prevector<4, uint32_t>& peers = result.first->second;
+    size_t nWord = nSlot / 32;
+    if (peers.size() <= nWord) {
+        peers.resize(nWord + 1);
+    }
+    peers[nWord] |= uint32_t(1) << (nSlot % 32);
+
+    while (!queueAdded.empty() &&
+           (queueAdded.front().first + nExpirySeconds < nNow || mapKnown.size() > nMaxEntries)) {
+        mapKnown.erase(queueAdded.front().second);
+        queueAdded.pop_front();
+    }
+}
+
+bool CSharedKnownFilter::Contains(int nSlot, uint64_t key) const
+{
+    LOCK(cs);
+    auto it = mapKnown.find(key);
+    if (it == mapKnown.end()) {
+        return false;
+    }
+    size_t nWord = nSlot / 32;
+    return nWord < it->second.size() && (it->second[nWord] >> (nSlot % 32)) & 1;
+}
+
+void CSharedKnownFilter::insert(int nSlot, const std::vector<unsigned char>& vKey)
+{
+    Insert(nSlot, Key(vKey.data(), vKey.size()));
+}
+
+void CSharedKnownFilter::insert(int nSlot, const uint256& hash)
+{
+    Insert(nSlot, Key(hash.begin(), hash.size()));
+}
+
+bool CSharedKnownFilter::contains(int nSlot, const std::vector<unsigned char>& vKey) const
+{
+    return Contains(nSlot, Key(vKey.data(), vKey.size()));
+}
+
+bool CSharedKnownFilter::contains(int nSlot, const uint256& hash) const
+{
+    return Contains(nSlot, Key(hash.begin(), hash.size()));
+}
+
+size_t CSharedKnownFilter::size() const
+{
+    LOCK(cs);
+    return mapKnown.size();
+}
+
+CPeerKnownFilter::CPeerKnownFilter(unsigned int nElements, double nFPRate, CSharedKnownFilter* sharedIn) :
+    shared(sharedIn)
+{
+    if (shared) {
+        nSlot = shared->AllocateSlot();
+    } else {
+        filter.reset(new CRollingBloomFilter(nElements, nFPRate));
+    }
+}
+
+CPeerKnownFilter::~CPeerKnownFilter()
+{
+    if (shared) {
+        reset();
+        shared->ReleaseSlot(nSlot);
+    }
+}
+
+void CPeerKnownFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    if (shared) {
+        fCleared = false;
+        shared->insert(nSlot, vKey);
+    } else {
+        filter->insert(vKey);
+    }
+}
+
+void CPeerKnownFilter::insert(const uint256& hash)
+{
+    if (shared) {
+        fCleared = false;
+        shared->insert(nSlot, hash);
+    } else {
+        filter->insert(hash);
+    }
+}
+
+bool CPeerKnownFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return shared ? shared->contains(nSlot, vKey) : filter->contains(vKey);
+}
+
+bool CPeerKnownFilter::contains(const uint256& hash) const
+{
+    return shared ? shared->contains(nSlot, hash) : filter->contains(hash);
+}
+
+void CPeerKnownFilter::reset()
+{
+    if (!shared) {
+        filter->reset();
+    } else if (!fCleared) {
+        // A disconnecting peer is cleared once, not again when it is deleted.
+        shared->ClearSlot(nSlot);
+        fCleared = true;
+    }
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_KNOWNFILTER_H
+#define BITCOIN_KNOWNFILTER_H
+
+#include "bloom.h"
+#include "prevector.h"
+#include "sync.h"
+#include "uint256.h"
+#include "util/time.h"
+
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** Whether peers share the tables of what they know instead of each keeping bloom filters */
+static const bool DEFAULT_COMPACT_KNOWN_FILTERS = false;
+/** How long the shared tables remember an inventory item or an address */
+static const int64_t KNOWN_INVENTORY_EXPIRY = 30 * 60;
+static const int64_t KNOWN_ADDRESS_EXPIRY = 4 * 60 * 60;
+/** The most keys each shared table holds; the oldest are forgotten first */
+static const size_t MAX_KNOWN_INVENTORY = 500000;
+static const size_t MAX_KNOWN_ADDRESSES = 500000;
+
+/**
+ * What each peer is known to have, for all peers in one table. A key (a
+ * txid, wtxid or address) maps to a bitmap with one bit per peer slot, so
+ * a key costs a few words however many peers know it, where per-peer
+ * rolling bloom filters cost every peer the space of its worst case. A
+ * lookup is one salted hash and one probe rather than a hash per bloom
+ * function.
+ *
+ * Keys are forgotten after a fixed time, or sooner if the table is full,
+ * which can only lead to an item being announced to a peer twice. Keys
+ * are stored as 64-bit salted hashes, so a collision is as unlikely as a
+ * bloom filter false positive is rare.
+ */
+class CSharedKnownFilter
+{
+private:
+    struct IdentityHasher {
+        size_t operator()(uint64_t key) const { return key; }
+    };
+
+    const CClock* const clock;
+    const int64_t nExpirySeconds;
+    const size_t nMaxEntries;
+    const uint64_t k0, k1;
+
+    mutable CCriticalSection cs;
+    //! Bitmaps of the peer slots that know each key, in 32-bit words as
+    //! prevector does not align its elements; 128 slots fit inline
+    std::unordered_map<uint64_t, prevector<4, uint32_t>, IdentityHasher> mapKnown;
+    //! Keys in the order they were added, with the time, for expiry
+    std::deque<std::pair<int64_t, uint64_t>> queueAdded;
+    std::vector<int> vFreeSlots;
+    int nSlots = 0;
+
+    uint64_t Key(const unsigned char* data, size_t size) const;
+    void Insert(int nSlot, uint64_t key);
+    bool Contains(int nSlot, uint64_t key) const;
+
+public:
+    CSharedKnownFilter(const CClock* clockIn, int64_t nExpirySecondsIn, size_t nMaxEntriesIn);
+
+    /** A slot for a new peer, known to have nothing */
+    int AllocateSlot();
+    /** Return a peer's slot for reuse; it must already be cleared */
+    void ReleaseSlot(int nSlot);
+    /** Forget everything a peer is known to have */
+    void ClearSlot(int nSlot);
+
+    void insert(int nSlot, const std::vector<unsigned char>& vKey);
+    void insert(int nSlot, const uint256& hash);
+    bool contains(int nSlot, const std::vector<unsigned char>& vKey) const;
+    bool contains(int nSlot, const uint256& hash) const;
+
+    /** Keys currently remembered */
+    size_t size() const;
+};
+
+/**
+ * A peer's record of what it knows: its own rolling bloom filter, or its
+ * slot in a shared filter if one is given.
+ */
+class CPeerKnownFilter
+{
+private:
+    std::unique_ptr<CRollingBloomFilter> filter;
+    CSharedKnownFilter* shared;
+    int nSlot = -1;
+    //! Whether the slot has been cleared since it was last inserted into
+    bool fCleared = true;
+
+public:
+    CPeerKnownFilter(unsigned int nElements, double nFPRate, CSharedKnownFilter* sharedIn);
+    ~CPeerKnownFilter();
+
+    CPeerKnownFilter(const CPeerKnownFilter&) = delete;
+    CPeerKnownFilter& operator=(const CPeerKnownFilter&) = delete;
+
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+
+    void reset();
+};
+
+#endif // BITCOIN_KNOWNFILTER_H
@@ -10,6 +10,9 @@
 #include "serialize.h"
 #include "util/system.h"
 
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <set>
 
 #include <boost/thread/mutex.hpp>
@@ -27,6 +30,7 @@ bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogIPs = DEFAULT_LOGIPS;
 std::atomic<bool> fReopenDebugLog(false);
+std::atomic<unsigned int> nLogRateLimit(DEFAULT_LOGRATELIMIT);
 
 /**
  * LogPrintf() has been broken a couple of times now
@@ -120,6 +124,41 @@ bool LogAcceptCategory(const char* category)
     return true;
 }
 
+bool CLogRateLimiter::Allow()
+{
+    unsigned int nLimit = nLogRateLimit.load(std::memory_order_relaxed);
+    if (nLimit == 0)
+        return true;
+
+    int64_t nNow = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t nLast = nWindow.load(std::memory_order_relaxed);
+    if (nLast != nNow && nWindow.compare_exchange_strong(nLast, nNow)) {
+        nCount = 0;
+        uint64_t nWasDropped = nDropped.exchange(0);
+        if (nWasDropped > 0) {
+            LogPrintf("Dropped %u %s debug messages over -logratelimit\n", nWasDropped, category);
+        }
+    }
+    if (nCount.fetch_add(1, std::memory_order_relaxed) < nLimit)
+        return true;
+    nDropped++;
+    return false;
+}
+
+CLogRateLimiter* GetLogRateLimiter(const char* category)
+{
+    // Called once for each LogPrint call site. The limiters are leaked, as
+    // messages may still be logged by global destructors at shutdown.
+    static std::mutex* cs = new std::mutex();
+    static std::map<std::string, CLogRateLimiter*>* mapLimiters = new std::map<std::string, CLogRateLimiter*>();
+    std::lock_guard<std::mutex> lock(*cs);
+    CLogRateLimiter*& limiter = (*mapLimiters)[category];
+    if (limiter == nullptr)
+        limiter = new CLogRateLimiter(category);
+    return limiter;
+}
+
 void ShrinkDebugFile()
 {
     // Scroll debug log if it's getting too big
@@ -18,6 +18,8 @@
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+/** Default for -logratelimit: debug messages logged per category a second, or 0 for no limit */
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fPrintToConsole;
@@ -26,6 +28,7 @@ extern bool fPrintToDebugLog;
 extern bool fLogTimestamps;
 extern bool fLogIPs;
 extern std::atomic<bool> fReopenDebugLog;
+extern std::atomic<unsigned int> nLogRateLimit;
 
 /** Returns the filtering directive set by the -debug flags. */
 std::string LogConfigFilter();
@@ -33,18 +36,54 @@ std::string LogConfigFilter();
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
 
+/**
+ * Counts the debug messages of one category logged in the current second,
+ * so that each category can be held to -logratelimit messages a second.
+ * Messages over the limit are dropped, and the number dropped is logged
+ * once the next second starts.
+ */
+class CLogRateLimiter
+{
+public:
+    explicit CLogRateLimiter(const std::string& categoryIn) : category(categoryIn) {}
+
+    /** Whether a message may be logged now. */
+    bool Allow();
+
+private:
+    const std::string category;
+    std::atomic<int64_t> nWindow{0};
+    std::atomic<unsigned int> nCount{0};
+    std::atomic<uint64_t> nDropped{0};
+};
+
+/** Return the rate limiter shared by the debug messages of a category. */
+CLogRateLimiter* GetLogRateLimiter(const char* category);
+
 /** Print to debug log with level INFO and category "main". */
-#define LogPrintf(...) LogPrintInner("info", "main", __VA_ARGS__)
+#define LogPrintf(...) LogPrintInner("info", "main", nullptr, __VA_ARGS__)
 
 /** Print to debug log with level DEBUG. */
-#define LogPrint(category, ...) LogPrintInner("debug", category, __VA_ARGS__)
-
-#define LogPrintInner(level, category, ...) do {           \
-    std::string T_MSG = tfm::format(__VA_ARGS__);          \
-    if (!T_MSG.empty() && T_MSG[T_MSG.size()-1] == '\n') { \
-        T_MSG.erase(T_MSG.size()-1);                       \
-    }                                                      \
-    TracingLog(level, category, T_MSG.c_str());            \
+#define LogPrint(category, ...) LogPrintInner("debug", category, GetLogRateLimiter(category), __VA_ARGS__)
+
+// The message is only formatted if the filter enables its callsite, so that
+// the debug messages of categories that are not logged cost next to nothing.
+#define LogPrintInner(level, category, limiter, ...) do {                 \
+    static constexpr const char* const T_LOG_FIELDS[] = {"message"};     \
+    static TracingCallsite* T_LOG_CALLSITE = T_CALLSITE(                 \
+        "event " __FILE__ ":" T_ESCAPEQUOTE(__LINE__),                   \
+        category, level, T_LOG_FIELDS, false);                           \
+    if (tracing_callsite_enabled(T_LOG_CALLSITE)) {                      \
+        static CLogRateLimiter* const T_LOG_LIMITER = limiter;           \
+        if (T_LOG_LIMITER == nullptr || T_LOG_LIMITER->Allow()) {        \
+            std::string T_MSG = tfm::format(__VA_ARGS__);                \
+            if (!T_MSG.empty() && T_MSG[T_MSG.size()-1] == '\n') {       \
+                T_MSG.erase(T_MSG.size()-1);                             \
+            }                                                            \
+            const char* T_LOG_VALUES[] = {T_MSG.c_str()};                \
+            tracing_log(T_LOG_CALLSITE, T_LOG_VALUES, 1);                \
+        }                                                                \
+    }                                                                    \
 } while(0)
 
 #define LogError(category, ...) ([&]() {          \
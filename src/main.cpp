@@ -10,6 +10,12 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcompression.h"
+#include "blockdownload.h"
+#include "blockencodings.h"
+#include "blockfilemap.h"
+#include "blockfilewriter.h"
+#include "blockprecompute.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -18,6 +24,9 @@
 #include "consensus/merkle.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
+#include "crypto/common.h"
+#include "crypto/randomx_wrapper.h"
+#include "crypto/sha256.h"
 #include "deprecation.h"
 #include "experimental_features.h"
 #include "init.h"
@@ -28,12 +37,19 @@
 #include "policy/policy.h"
 #include "pow.h"
 #include "reverse_iterator.h"
+#include "shieldedbatch.h"
+#include "shieldedindex.h"
 #include "time.h"
 #include "txmempool.h"
+#include "txorphanage.h"
+#include "txreconciliation.h"
+#include "txrequest.h"
 #include "ui_interface.h"
 #include "undo.h"
 #include "util/system.h"
 #include "util/moneystr.h"
+#include "util/trace.h"
+#include "validation_stats.h"
 #include "validationinterface.h"
 #include "wallet/asyncrpcoperation_sendmany.h"
 #include "wallet/asyncrpcoperation_shieldcoinbase.h"
@@ -42,7 +58,14 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <thread>
 #include <variant>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -79,17 +102,32 @@ using namespace std;
 RecursiveMutex cs_main;
 
 BlockMap mapBlockIndex;
+/** Owns every CBlockIndex in mapBlockIndex. */
+static CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
+//! The height of pindexBestHeader, for readers without cs_main.
+static std::atomic<int> nBestHeaderHeight(-1);
+//! Headers linked below a checkpoint without recomputing their RandomX hash.
+static std::atomic<uint64_t> nSkippedHeaderPoW(0);
+static Mutex cs_chainSnapshot;
+//! The latest chain state snapshot. Guarded by cs_chainSnapshot.
+static std::shared_ptr<const CChainStateSnapshot> chainSnapshot =
+    std::make_shared<CChainStateSnapshot>(CChain(), nullptr);
 static std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int g_best_block_height;
 int nScriptCheckThreads = 0;
+int nHeaderCheckThreads = 0;
+int nBlockPreValidationThreads = 0;
+uint256 hashAssumeValid;
+bool fBackgroundFlush = DEFAULT_BACKGROUND_FLUSH;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = false;
+bool fShieldedIndex = false;
 bool fAddressIndex = false;     // insightexplorer || lightwalletd
 bool fSpentIndex = false;       // insightexplorer
 bool fTimestampIndex = false;   // insightexplorer
@@ -100,10 +138,12 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 bool fIBDSkipTxVerification = DEFAULT_IBD_SKIP_TX_VERIFICATION;
+bool fIBDSkipHeaderPoW = DEFAULT_IBD_SKIP_HEADER_POW;
 bool fCoinbaseEnforcedShieldingEnabled = true;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 bool fAlerts = DEFAULT_ALERTS;
+bool fTxReconciliation = DEFAULT_TXRECONCILIATION;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 
 std::optional<unsigned int> expiryDeltaArg = std::nullopt;
@@ -115,23 +155,9 @@ CAmount nTxUnpaidActionLimit = DEFAULT_TX_UNPAID_ACTION_LIMIT;
 
 CTxMemPool mempool(::minRelayTxFee);
 
-struct IteratorComparator
-{
-    template<typename I>
-    bool operator()(const I& a, const I& b) const
-    {
-        return &(*a) < &(*b);
-    }
-};
-
-struct COrphanTx {
-    CTransaction tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-};
-map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);
-map<COutPoint, set<map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(cs_main);
-void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+CTxOrphanage orphanage GUARDED_BY(cs_main);
+CTxRequestTracker txrequest GUARDED_BY(cs_main);
+CHeaderCache headerCache;
 
 /**
  * Returns true if there are nRequired or more blocks of minVersion or above
@@ -291,6 +317,7 @@ namespace {
         int64_t nTime;           //!< Time of "getdata" request in microseconds.
         bool fValidatedHeaders;  //!< Whether this block has validated headers at the time of request.
         int64_t nTimeDisconnect; //!< The timeout for this block request (for disconnecting a slow peer)
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock; //!< Optional, set while waiting for a blocktxn.
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -311,6 +338,33 @@ namespace {
     MapRelay mapRelay;
     /** Expiration-time ordered list of (expire time, relay map entry) pairs, protected by cs_main). */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration;
+
+    /**
+     * The headers between two checkpoints above our best header, downloaded
+     * from another peer alongside the main headers sync. They are linked into
+     * the block index once they reach the end checkpoint and the headers up
+     * to the start checkpoint are known. Protected by cs_main.
+     */
+    struct HeadersSegment {
+        int nStartHeight;
+        uint256 hashStart;
+        int nEndHeight;
+        uint256 hashEnd;
+        //! The headers after hashStart received so far.
+        std::vector<CBlockHeader> vHeaders;
+        //! The peer last asked for the segment, or -1.
+        NodeId nodeid = -1;
+        //! Their hashes.
+        std::vector<uint256> vHashes;
+        //! When we last asked that peer for headers (in microseconds).
+        int64_t nRequested = 0;
+
+        const uint256& Tip() const { return vHashes.empty() ? hashStart : vHashes.back(); }
+        bool IsComplete() const { return Tip() == hashEnd; }
+    };
+    std::vector<HeadersSegment> vHeadersSegments;
+    /** The last headers of the segments linked so far. Protected by cs_main. */
+    std::vector<CBlockIndex*> vLinkedHeadersSegments;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -360,8 +414,28 @@ struct CNodeState {
     list<QueuedBlock> vBlocksInFlight;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! How quickly this peer delivers the blocks we request from it.
+    CBlockDownloadStats blockDownload;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether this peer relays compact blocks (it sent us a sendcmpct).
+    bool fProvidesHeaderAndIDs;
+    //! Whether this peer wants new blocks announced with a cmpctblock.
+    bool fPreferHeaderAndIDs;
+    //! Whether we want this peer to announce new blocks to us with a cmpctblock,
+    //! and whether we last told it so.
+    bool fWantHeaderAndIDs;
+    bool fSentWantHeaderAndIDs;
+    //! Whether this peer wants new blocks announced with headers (it sent us a sendheaders).
+    bool fPreferHeaders;
+    //! The last block header we sent this peer.
+    const CBlockIndex *pindexBestHeaderSent;
+    //! How many announced headers in a row did not connect to ours.
+    int nUnconnectingHeaders;
+    //! The salt we sent this peer in sendtxrcncl, or 0.
+    uint64_t nTxReconciliationSalt;
+    //! Set once the peer agreed to announce transactions by reconciliation.
+    std::optional<CTxReconciliationState> txReconciliation;
 
     CNodeState() {
         fCurrentlyConnected = false;
@@ -376,12 +450,30 @@ struct CNodeState {
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
         fPreferredDownload = false;
+        fProvidesHeaderAndIDs = false;
+        fPreferHeaderAndIDs = false;
+        fWantHeaderAndIDs = false;
+        fSentWantHeaderAndIDs = false;
+        fPreferHeaders = false;
+        pindexBestHeaderSent = NULL;
+        nUnconnectingHeaders = 0;
+        nTxReconciliationSalt = 0;
     }
 };
 
 /** Map maintaining per-node state. Requires cs_main. */
 map<NodeId, CNodeState> mapNodeState;
 
+/**
+ * The peers we asked to announce new blocks to us with a cmpctblock, least
+ * recently useful first. Whitelisted peers are asked as well, but are not
+ * counted here. Requires cs_main.
+ */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
+/** The cmpctblock built most recently, usually for our tip. Requires cs_main. */
+std::shared_ptr<const CBlockHeaderAndShortTxIDs> pMostRecentCompactBlock;
+
 // Requires cs_main.
 CNodeState *State(NodeId pnode) {
     map<NodeId, CNodeState>::iterator it = mapNodeState.find(pnode);
@@ -432,8 +524,14 @@ void FinalizeNode(NodeId nodeid) {
 
     for (const QueuedBlock& entry : state->vBlocksInFlight)
         mapBlocksInFlight.erase(entry.hash);
-    EraseOrphansFor(nodeid);
+    for (HeadersSegment& segment : vHeadersSegments) {
+        if (segment.nodeid == nodeid)
+            segment.nodeid = -1;
+    }
+    orphanage.EraseForPeer(nodeid);
+    txrequest.DisconnectedPeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
     mapNodeState.erase(nodeid);
 }
@@ -473,6 +571,79 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
 
+// Requires cs_main.
+// Measure the peer's download speed if it delivered a block we asked it for.
+void MarkBlockAsDownloaded(NodeId nodeid, const uint256& hash, int64_t nTimeReceived, size_t nBytes) {
+    auto itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    State(nodeid)->blockDownload.BlockReceived(itInFlight->second.second->nTime, nTimeReceived, nBytes);
+}
+
+// Requires cs_main.
+// Whether a peer other than nodeid has announced pindex and can be asked for it.
+bool OtherPeerCanProvideBlock(NodeId nodeid, const CBlockIndex* pindex, int64_t nNow) {
+    for (const auto& entry : mapNodeState) {
+        const CNodeState& state = entry.second;
+        if (entry.first != nodeid && state.fCurrentlyConnected && !state.blockDownload.IsPaused(nNow) &&
+            state.pindexBestKnownBlock && state.pindexBestKnownBlock->GetAncestor(pindex->nHeight) == pindex)
+            return true;
+    }
+    return false;
+}
+
+// Announce transactions left over from a reconciliation round with inv messages.
+void PushTxInventory(CNode* pto, const std::vector<CInv>& vInv) {
+    for (size_t i = 0; i < vInv.size(); i += MAX_INV_SZ) {
+        pto->PushMessage("inv", std::vector<CInv>(vInv.begin() + i, vInv.begin() + std::min(vInv.size(), i + MAX_INV_SZ)));
+    }
+}
+
+void PushTxInventory(CNode* pto, const TxReconciliationSet& set) {
+    std::vector<CInv> vInv;
+    vInv.reserve(set.size());
+    for (const auto& entry : set)
+        vInv.push_back(entry.second);
+    PushTxInventory(pto, vInv);
+}
+
+// Requires cs_main.
+// Ask a peer that just gave us a new block to announce the following ones with
+// a cmpctblock, replacing the peer that least recently did so once we have
+// MAX_CMPCTBLOCK_HB_PEERS of them.
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid) {
+    CNodeState *state = State(nodeid);
+    if (state == NULL || !state->fProvidesHeaderAndIDs)
+        return;
+    auto it = std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), nodeid);
+    if (it != lNodesAnnouncingHeaderAndIDs.end()) {
+        lNodesAnnouncingHeaderAndIDs.splice(lNodesAnnouncingHeaderAndIDs.end(), lNodesAnnouncingHeaderAndIDs, it);
+        return;
+    }
+    // Whitelisted peers always announce with a cmpctblock.
+    if (state->fWantHeaderAndIDs)
+        return;
+    if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_HB_PEERS) {
+        State(lNodesAnnouncingHeaderAndIDs.front())->fWantHeaderAndIDs = false;
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+    }
+    state->fWantHeaderAndIDs = true;
+    lNodesAnnouncingHeaderAndIDs.push_back(nodeid);
+}
+
+// Requires cs_main.
+// Returns the cmpctblock for a block we have. Announcing a new tip asks for the
+// same block for every peer, so the last one built is kept.
+std::shared_ptr<const CBlockHeaderAndShortTxIDs> GetCompactBlock(const CBlockIndex* pindex, const Consensus::Params& consensusParams) {
+    if (!pMostRecentCompactBlock || pMostRecentCompactBlock->header.GetHash() != pindex->GetBlockHash()) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensusParams))
+            assert(!"cannot load block from disk");
+        pMostRecentCompactBlock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block);
+    }
+    return pMostRecentCompactBlock;
+}
+
 /** Check whether the last unknown block a peer advertized is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) {
     CNodeState *state = State(nodeid);
@@ -506,6 +677,16 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) {
     }
 }
 
+/** Whether a peer is known to have the header of pindex. Requires cs_main. */
+static bool PeerHasHeader(const CNodeState *state, const CBlockIndex *pindex)
+{
+    if (state->pindexBestKnownBlock && pindex == state->pindexBestKnownBlock->GetAncestor(pindex->nHeight))
+        return true;
+    if (state->pindexBestHeaderSent && pindex == state->pindexBestHeaderSent->GetAncestor(pindex->nHeight))
+        return true;
+    return false;
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
@@ -623,6 +804,14 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.fTxReconciliation = state->txReconciliation.has_value();
+    stats.nTxInFlight = txrequest.CountInFlight(nodeid);
+    stats.nTxAnnounced = txrequest.CountAnnounced(nodeid);
+    stats.nBlockDownloadWindow = state->blockDownload.Window();
+    stats.nBlockLatency = state->blockDownload.Latency();
+    stats.nBlockTime = state->blockDownload.BlockTime();
+    stats.dBlockBytesPerSecond = state->blockDownload.BytesPerSecond();
+    stats.nBlocksReassigned = state->blockDownload.Reassigned();
     return true;
 }
 
@@ -663,117 +852,9 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewBackgroundFlush *pcoinsBackgroundFlush = NULL;
 CBlockTreeDB *pblocktree = NULL;
-
-//////////////////////////////////////////////////////////////////////////////
-//
-// mapOrphanTransactions
-//
-
-bool AddOrphanTx(const CTransaction& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    // See doc/book/src/design/p2p-data-propagation.md for why mapOrphanTransactions uses
-    // txid to index transactions instead of wtxid.
-    uint256 hash = tx.GetHash();
-    if (mapOrphanTransactions.count(hash))
-        return false;
-
-    // Ignore big transactions, to avoid a
-    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
-    // large transaction with a missing parent then we assume
-    // it will rebroadcast it later, after the parent transaction(s)
-    // have been mined or received.
-    // 100 orphans, each of which is at most 99,999 bytes big is
-    // at most 10 megabytes of orphans and somewhat more byprev index (in the worst case):
-    unsigned int sz = GetSerializeSize(tx, SER_NETWORK, tx.nVersion);
-    if (sz >= 100000)
-    {
-        LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
-        return false;
-    }
-
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME});
-    assert(ret.second);
-    for (const CTxIn& txin : tx.vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
-    }
-
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
-    return true;
-}
-
-int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
-    if (it == mapOrphanTransactions.end())
-        return 0;
-    for (const CTxIn& txin : it->second.tx.vin)
-    {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-        if (itPrev == mapOrphanTransactionsByPrev.end())
-            continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
-            mapOrphanTransactionsByPrev.erase(itPrev);
-    }
-    mapOrphanTransactions.erase(it);
-    return 1;
-}
-
-void EraseOrphansFor(NodeId peer)
-{
-    int nErased = 0;
-    map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end())
-    {
-        map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseOrphanTx(maybeErase->second.tx.GetHash());
-        }
-    }
-    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
-}
-
-
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    unsigned int nEvicted = 0;
-    static int64_t nNextSweep;
-    int64_t nNow = GetTime();
-    if (nNextSweep <= nNow) {
-        // Sweep out expired orphan pool entries:
-        int nErased = 0;
-        assert(nNow <= INT64_MAX - ORPHAN_TX_EXPIRE_TIME);
-        int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-        while (iter != mapOrphanTransactions.end())
-        {
-            map<uint256, COrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseOrphanTx(maybeErase->second.tx.GetHash());
-            } else {
-                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
-            }
-        }
-        // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
-        assert(nMinExpTime <= INT64_MAX - ORPHAN_TX_EXPIRE_INTERVAL);
-        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
-        if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
-    }
-    while (mapOrphanTransactions.size() > nMaxOrphans)
-    {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
-        ++nEvicted;
-    }
-    return nEvicted;
-}
+CShieldedBatchVerifier *pshieldedBatchVerifier = NULL;
 
 bool IsFinalTx(const CTransaction &tx, int nBlockHeight, int64_t nBlockTime)
 {
@@ -1052,7 +1133,7 @@ bool ContextualCheckTransaction(
 
         // Reject transactions that exceed pre-sapling size limits
         static_assert(MAX_BLOCK_SIZE > MAX_TX_SIZE_BEFORE_SAPLING); // sanity
-        if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) > MAX_TX_SIZE_BEFORE_SAPLING)
+        if (tx.GetTotalSize() > MAX_TX_SIZE_BEFORE_SAPLING)
             return state.DoS(
                 dosLevelPotentiallyRelaxing,
                 error("ContextualCheckTransaction(): size limits failed"),
@@ -1370,54 +1451,38 @@ bool ContextualCheckTransaction(
     return true;
 }
 
-bool ContextualCheckShieldedInputs(
+/**
+ * Computes the signature hash that the shielded components of a transaction
+ * sign, and verifies its JoinSplit signature against it. This reads nothing
+ * but the transaction and its precomputed data, so it may run concurrently
+ * for different transactions of a block.
+ */
+static bool CheckShieldedSignatures(
         const CTransaction& tx,
         const PrecomputedTransactionData& txdata,
         CValidationState &state,
-        const CCoinsViewCache &view,
-        std::optional<rust::Box<sapling::BatchValidator>>& saplingAuth,
-        std::optional<rust::Box<orchard::BatchValidator>>& orchardAuth,
         const Consensus::Params& consensus,
         uint32_t consensusBranchId,
-        bool nu5Active,
-        bool isMined,
-        bool (*isInitBlockDownload)(const Consensus::Params&))
+        int dosLevelPotentiallyRelaxing,
+        uint256& dataToBeSigned)
 {
-    // This doesn't trigger the DoS code on purpose; if it did, it would make it easier
-    // for an attacker to attempt to split the network.
-    if (!Consensus::CheckTxShieldedInputs(tx, state, view, 0)) {
-        return false;
+    if (tx.vJoinSplit.empty() &&
+        !tx.GetSaplingBundle().IsPresent() &&
+        !tx.GetOrchardBundle().IsPresent())
+    {
+        return true;
     }
 
-    const int DOS_LEVEL_BLOCK = 100;
-    // DoS level set to 10 to be more forgiving.
-    const int DOS_LEVEL_MEMPOOL = 10;
-
-    // For rules that are relaxing (or might become relaxing when a future
-    // network upgrade is implemented), we need to account for IBD mode.
-    auto dosLevelPotentiallyRelaxing = isMined ? DOS_LEVEL_BLOCK : (
-        isInitBlockDownload(consensus) ? 0 : DOS_LEVEL_MEMPOOL);
-
+    // Empty output script.
+    CScript scriptCode;
     auto prevConsensusBranchId = PrevEpochBranchId(consensusBranchId, consensus);
-    uint256 dataToBeSigned;
-    uint256 prevDataToBeSigned;
-
-    // Create signature hashes for shielded components.
-    if (!tx.vJoinSplit.empty() ||
-        tx.GetSaplingBundle().IsPresent() ||
-        tx.GetOrchardBundle().IsPresent())
-    {
-        // Empty output script.
-        CScript scriptCode;
-        try {
-            dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, consensusBranchId, txdata);
-            prevDataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, prevConsensusBranchId, txdata);
-        } catch (std::logic_error ex) {
-            // A logic error should never occur because we pass NOT_AN_INPUT and
-            // SIGHASH_ALL to SignatureHash().
-            return state.DoS(100, error("ContextualCheckShieldedInputs(): error computing signature hash"),
-                             REJECT_INVALID, "error-computing-signature-hash");
-        }
+    try {
+        dataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, consensusBranchId, txdata);
+    } catch (std::logic_error ex) {
+        // A logic error should never occur because we pass NOT_AN_INPUT and
+        // SIGHASH_ALL to SignatureHash().
+        return state.DoS(100, error("ContextualCheckShieldedInputs(): error computing signature hash"),
+                         REJECT_INVALID, "error-computing-signature-hash");
     }
 
     if (!tx.vJoinSplit.empty())
@@ -1428,6 +1493,13 @@ bool ContextualCheckShieldedInputs(
             // only check the previous epoch's branch ID, on the assumption that
             // users creating transactions will notice their transactions
             // failing before a second network upgrade occurs.
+            uint256 prevDataToBeSigned;
+            try {
+                prevDataToBeSigned = SignatureHash(scriptCode, tx, NOT_AN_INPUT, SIGHASH_ALL, 0, prevConsensusBranchId, txdata);
+            } catch (std::logic_error ex) {
+                return state.DoS(100, error("ContextualCheckShieldedInputs(): error computing signature hash"),
+                                 REJECT_INVALID, "error-computing-signature-hash");
+            }
             if (ed25519::verify(tx.joinSplitPubKey,
                                 tx.joinSplitSig,
                                 {prevDataToBeSigned.begin(), 32})) {
@@ -1444,6 +1516,22 @@ bool ContextualCheckShieldedInputs(
         }
     }
 
+    return true;
+}
+
+/**
+ * Queues the Sapling and Orchard bundles of a transaction for batch
+ * validation against its shielded signature hash. The batch validators are
+ * not thread-safe, so this must be called from one thread at a time.
+ */
+static bool QueueShieldedAuthValidation(
+        const CTransaction& tx,
+        CValidationState &state,
+        std::optional<rust::Box<sapling::BatchValidator>>& saplingAuth,
+        std::optional<rust::Box<orchard::BatchValidator>>& orchardAuth,
+        int dosLevelPotentiallyRelaxing,
+        const uint256& dataToBeSigned)
+{
     // Queue Sapling bundle to be batch-validated. This also checks some consensus rules.
     if (saplingAuth.has_value()) {
         if (!tx.GetSaplingBundle().QueueAuthValidation(*saplingAuth.value(), dataToBeSigned)) {
@@ -1462,6 +1550,44 @@ bool ContextualCheckShieldedInputs(
     return true;
 }
 
+bool ContextualCheckShieldedInputs(
+        const CTransaction& tx,
+        const PrecomputedTransactionData& txdata,
+        CValidationState &state,
+        const CCoinsViewCache &view,
+        std::optional<rust::Box<sapling::BatchValidator>>& saplingAuth,
+        std::optional<rust::Box<orchard::BatchValidator>>& orchardAuth,
+        const Consensus::Params& consensus,
+        uint32_t consensusBranchId,
+        bool nu5Active,
+        bool isMined,
+        bool (*isInitBlockDownload)(const Consensus::Params&))
+{
+    // This doesn't trigger the DoS code on purpose; if it did, it would make it easier
+    // for an attacker to attempt to split the network.
+    if (!Consensus::CheckTxShieldedInputs(tx, state, view, 0)) {
+        return false;
+    }
+
+    const int DOS_LEVEL_BLOCK = 100;
+    // DoS level set to 10 to be more forgiving.
+    const int DOS_LEVEL_MEMPOOL = 10;
+
+    // For rules that are relaxing (or might become relaxing when a future
+    // network upgrade is implemented), we need to account for IBD mode.
+    auto dosLevelPotentiallyRelaxing = isMined ? DOS_LEVEL_BLOCK : (
+        isInitBlockDownload(consensus) ? 0 : DOS_LEVEL_MEMPOOL);
+
+    uint256 dataToBeSigned;
+    if (!CheckShieldedSignatures(tx, txdata, state, consensus, consensusBranchId,
+                                 dosLevelPotentiallyRelaxing, dataToBeSigned)) {
+        return false;
+    }
+
+    return QueueShieldedAuthValidation(tx, state, saplingAuth, orchardAuth,
+                                       dosLevelPotentiallyRelaxing, dataToBeSigned);
+}
+
 
 bool CheckTransaction(const CTransaction& tx, CValidationState &state,
                       ProofVerifier& verifier)
@@ -1576,7 +1702,7 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
     // Size limits
     static_assert(MAX_BLOCK_SIZE >= MAX_TX_SIZE_AFTER_SAPLING); // sanity
     static_assert(MAX_TX_SIZE_AFTER_SAPLING > MAX_TX_SIZE_BEFORE_SAPLING); // sanity
-    if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) > MAX_TX_SIZE_AFTER_SAPLING)
+    if (tx.GetTotalSize() > MAX_TX_SIZE_AFTER_SAPLING)
         return state.DoS(100, false, REJECT_INVALID, "bad-txns-oversize");
 
     // Check for negative or overflow output values
@@ -1827,10 +1953,74 @@ std::string FormatStateMessage(const CValidationState &state)
         state.GetRejectCode());
 }
 
-bool AcceptToMemoryPool(
+bool PrecheckTransactionForMempool(
+        const CChainParams& chainparams, const CTransaction& tx, int nextBlockHeight,
+        CValidationState& state, MempoolPrecheck& precheck,
+        std::shared_ptr<CShieldedAuthCheck>* pauthCheck)
+{
+    const Consensus::Params& consensus = chainparams.GetConsensus();
+    auto consensusBranchId = CurrentEpochBranchId(nextBlockHeight, consensus);
+
+    auto verifier = ProofVerifier::Strict();
+    if (!CheckTransaction(tx, state, verifier))
+        return false;
+
+    if (!ContextualCheckTransaction(tx, state, chainparams, nextBlockHeight, false))
+        return false;
+
+    // Coinbase is only valid in a block, not as a loose transaction
+    if (tx.IsCoinBase())
+        return state.DoS(100, false, REJECT_INVALID, "coinbase");
+
+    if (!tx.vJoinSplit.empty() || tx.GetSaplingBundle().IsPresent() || tx.GetOrchardBundle().IsPresent()) {
+        // The shielded signature hash does not commit to the outputs spent by
+        // transparent inputs, so placeholders for them are enough to compute
+        // it without looking the real ones up.
+        std::vector<CTxOut> allPrevOutputs(tx.vin.size(), CTxOut(0, CScript()));
+        std::optional<PrecomputedTransactionData> txdata;
+        try {
+            txdata.emplace(tx, allPrevOutputs);
+        } catch (const std::exception&) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-txns-precomputed-data");
+        }
+
+        // The DoS level ContextualCheckShieldedInputs uses for loose transactions.
+        int dosLevelPotentiallyRelaxing = IsInitialBlockDownload(consensus) ? 0 : 10;
+        uint256 dataToBeSigned;
+        if (!CheckShieldedSignatures(tx, *txdata, state, consensus, consensusBranchId,
+                                     dosLevelPotentiallyRelaxing, dataToBeSigned)) {
+            return false;
+        }
+
+        if (pauthCheck && (tx.GetSaplingBundle().IsPresent() || tx.GetOrchardBundle().IsPresent())) {
+            *pauthCheck = std::make_shared<CShieldedAuthCheck>(
+                tx, consensusBranchId, dataToBeSigned, dosLevelPotentiallyRelaxing);
+            return true;
+        }
+
+        // As in AcceptToMemoryPool, use single-transaction batches.
+        std::optional<rust::Box<sapling::BatchValidator>> saplingAuth = sapling::init_batch_validator(true);
+        std::optional<rust::Box<orchard::BatchValidator>> orchardAuth = orchard::init_batch_validator(true);
+        if (!QueueShieldedAuthValidation(tx, state, saplingAuth, orchardAuth,
+                                         dosLevelPotentiallyRelaxing, dataToBeSigned)) {
+            return false;
+        }
+        if (!saplingAuth.value()->validate()) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-sapling-bundle-authorization");
+        }
+        if (!orchardAuth.value()->validate()) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-orchard-bundle-authorization");
+        }
+    }
+
+    precheck.consensusBranchId = consensusBranchId;
+    return true;
+}
+
+static bool AcceptToMemoryPoolWorker(
         const CChainParams& chainparams,
         CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-        bool* pfMissingInputs, bool fRejectAbsurdFee)
+        bool* pfMissingInputs, bool fRejectAbsurdFee, const MempoolPrecheck* pprecheck)
 {
     AssertLockHeld(cs_main);
     LOCK(pool.cs); // mempool "read lock" (held through pool.addUnchecked())
@@ -1848,7 +2038,11 @@ bool AcceptToMemoryPool(
         return false;
     }
 
-    auto verifier = ProofVerifier::Strict();
+    // A precheck against another branch (the tip has crossed a network
+    // upgrade since) has to be redone here.
+    bool fPrechecked = pprecheck && pprecheck->consensusBranchId == consensusBranchId;
+
+    auto verifier = fPrechecked ? ProofVerifier::Disabled() : ProofVerifier::Strict();
     if (!CheckTransaction(tx, state, verifier))
         return false;
 
@@ -2078,8 +2272,9 @@ bool AcceptToMemoryPool(
         // Orchard bundle contains at least two signatures.
         std::optional<rust::Box<orchard::BatchValidator>> orchardAuth = orchard::init_batch_validator(true);
 
-        // Check shielded input signatures.
-        if (!ContextualCheckShieldedInputs(
+        // Check shielded input signatures, unless the precheck already has.
+        // The spend requirements it also checks were checked above.
+        if (!fPrechecked && !ContextualCheckShieldedInputs(
             tx,
             txdata,
             state,
@@ -2096,16 +2291,17 @@ bool AcceptToMemoryPool(
 
         // Check Sapling and Orchard bundle authorizations.
         // `saplingAuth` and `orchardAuth` are known here to be non-null.
-        if (!saplingAuth.value()->validate()) {
+        if (!fPrechecked && !saplingAuth.value()->validate()) {
             return state.DoS(100, false, REJECT_INVALID, "bad-sapling-bundle-authorization");
         }
-        if (!orchardAuth.value()->validate()) {
+        if (!fPrechecked && !orchardAuth.value()->validate()) {
             return state.DoS(100, false, REJECT_INVALID, "bad-orchard-bundle-authorization");
         }
 
         {
             // Store transaction in memory
             pool.addUnchecked(hash, entry, setAncestors);
+            TRACE3(mempool, added, hash.begin(), nSize, nFees);
 
             // Add memory address index
             if (fAddressIndex) {
@@ -2132,38 +2328,217 @@ bool AcceptToMemoryPool(
     return true;
 }
 
-bool GetTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
-    std::vector<std::pair<uint256, unsigned int> > &hashes)
+bool AcceptToMemoryPool(
+        const CChainParams& chainparams,
+        CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+        bool* pfMissingInputs, bool fRejectAbsurdFee, const MempoolPrecheck* pprecheck)
 {
-    if (!fTimestampIndex) {
-        LogPrint("rpc", "Timestamp index not enabled");
-        return false;
-    }
-    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes)) {
-        LogPrint("rpc", "Unable to get hashes for timestamps");
+    if (!AcceptToMemoryPoolWorker(chainparams, pool, state, tx, fLimitFree, pfMissingInputs, fRejectAbsurdFee, pprecheck)) {
+        TRACE3(mempool, rejected, tx.GetHash().begin(), state.GetRejectReason().c_str(),
+            pfMissingInputs != nullptr && *pfMissingInputs);
         return false;
     }
     return true;
 }
 
-bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/** How many transactions from mempool.dat are prechecked together while loading */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 256;
+
+bool LoadMempool(const CChainParams& chainparams)
 {
-    AssertLockHeld(cs_main);
-    if (!fSpentIndex) {
-        LogPrint("rpc", "Spent index not enabled");
+    FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
         return false;
     }
-    if (mempool.getSpentIndex(key, value))
-        return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value)) {
-        LogPrint("rpc", "Unable to get spent index information");
+    int64_t nStart = GetTimeMicros();
+    uint64_t nLoaded = 0;
+    uint64_t nFailed = 0;
+    uint64_t nAlreadyThere = 0;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_DUMP_VERSION) {
+            return false;
+        }
+
+        // Fee deltas are restored first, so that AcceptToMemoryPool applies
+        // them to the transactions they were set for.
+        std::map<uint256, CAmount> mapDeltas;
+        file >> mapDeltas;
+        for (const auto& delta : mapDeltas) {
+            mempool.PrioritiseTransaction(delta.first, delta.first.ToString(), delta.second);
+        }
+
+        uint64_t nTotal;
+        file >> nTotal;
+        while (nLoaded + nFailed + nAlreadyThere < nTotal) {
+            std::vector<CTransaction> vtx;
+            while (vtx.size() < MEMPOOL_LOAD_BATCH_SIZE && nLoaded + nFailed + nAlreadyThere + vtx.size() < nTotal) {
+                CTransaction tx;
+                file >> tx;
+                vtx.push_back(tx);
+            }
+
+            int nextBlockHeight;
+            {
+                LOCK(cs_main);
+                nextBlockHeight = chainActive.Height() + 1;
+            }
+
+            // The chain may have changed since the transactions were saved,
+            // so they are validated again. The proofs and signatures, which
+            // are most of the work, are verified without any locks held on
+            // several threads, as for transactions relayed by peers.
+            std::vector<CValidationState> vState(vtx.size());
+            std::vector<MempoolPrecheck> vPrecheck(vtx.size());
+            std::vector<char> vPrechecked(vtx.size());
+            auto precheckRange = [&](size_t nBegin, size_t nEnd) {
+                for (size_t i = nBegin; i < nEnd; i++) {
+                    vPrechecked[i] = PrecheckTransactionForMempool(
+                        chainparams, vtx[i], nextBlockHeight, vState[i], vPrecheck[i]);
+                }
+            };
+            size_t nWorkers = std::min<size_t>(std::max(nScriptCheckThreads, 1), vtx.size());
+            std::vector<std::future<void>> vWorkers;
+            for (size_t i = 1; i < nWorkers; i++) {
+                vWorkers.push_back(std::async(std::launch::async, precheckRange,
+                    i * vtx.size() / nWorkers, (i + 1) * vtx.size() / nWorkers));
+            }
+            precheckRange(0, vtx.size() / nWorkers);
+            for (auto& worker : vWorkers) {
+                worker.get();
+            }
+
+            for (size_t i = 0; i < vtx.size(); i++) {
+                LOCK(cs_main);
+                if (mempool.exists(vtx[i].GetHash())) {
+                    nAlreadyThere++;
+                } else if (vPrechecked[i] && AcceptToMemoryPool(
+                        chainparams, mempool, vState[i], vtx[i], true, NULL, false, &vPrecheck[i])) {
+                    nLoaded++;
+                } else {
+                    nFailed++;
+                }
+            }
+
+            boost::this_thread::interruption_point();
+            if (ShutdownRequested()) {
+                return false;
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
         return false;
     }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i already there (%dms)\n",
+              nLoaded, nFailed, nAlreadyThere, (GetTimeMicros() - nStart) / 1000);
     return true;
 }
 
-bool GetAddressIndex(const uint160& addressHash, int type,
+bool DumpMempool()
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::map<uint256, CAmount> mapDeltas;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+    }
+    std::shared_ptr<const CTxMemPoolSnapshot> snapshot = mempool.GetSnapshot();
+
+    // Write every transaction after its in-mempool parents, so that each one
+    // can be accepted as soon as it is read back.
+    std::map<uint256, size_t> mapIndex;
+    for (size_t i = 0; i < snapshot->entries.size(); i++) {
+        mapIndex.emplace(snapshot->entries[i].GetTx().GetHash(), i);
+    }
+    std::vector<size_t> vOrder;
+    std::vector<bool> vVisited(snapshot->entries.size());
+    for (size_t i = 0; i < snapshot->entries.size(); i++) {
+        // Depth-first, emitting each entry once all its parents have been.
+        std::vector<std::pair<size_t, size_t>> vStack;
+        if (!vVisited[i]) {
+            vVisited[i] = true;
+            vStack.emplace_back(i, 0);
+        }
+        while (!vStack.empty()) {
+            auto& [n, nParent] = vStack.back();
+            if (nParent == snapshot->parents[n].size()) {
+                vOrder.push_back(n);
+                vStack.pop_back();
+                continue;
+            }
+            size_t parent = mapIndex.at(snapshot->parents[n][nParent++]);
+            if (!vVisited[parent]) {
+                vVisited[parent] = true;
+                vStack.emplace_back(parent, 0);
+            }
+        }
+    }
+
+    try {
+        FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat.new", "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << MEMPOOL_DUMP_VERSION;
+        file << mapDeltas;
+        file << (uint64_t)vOrder.size();
+        for (size_t n : vOrder) {
+            file << snapshot->entries[n].GetTx();
+        }
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Dumped %u mempool transactions to disk (%dms)\n",
+              vOrder.size(), (GetTimeMicros() - nStart) / 1000);
+    return true;
+}
+
+bool GetTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
+    std::vector<std::pair<uint256, unsigned int> > &hashes)
+{
+    if (!fTimestampIndex) {
+        LogPrint("rpc", "Timestamp index not enabled");
+        return false;
+    }
+    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes)) {
+        LogPrint("rpc", "Unable to get hashes for timestamps");
+        return false;
+    }
+    return true;
+}
+
+bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
+{
+    AssertLockHeld(cs_main);
+    if (!fSpentIndex) {
+        LogPrint("rpc", "Spent index not enabled");
+        return false;
+    }
+    if (mempool.getSpentIndex(key, value))
+        return true;
+
+    if (!pblocktree->ReadSpentIndex(key, value)) {
+        LogPrint("rpc", "Unable to get spent index information");
+        return false;
+    }
+    return true;
+}
+
+bool GetAddressIndex(const uint160& addressHash, int type,
                      std::vector<CAddressIndexDbEntry>& addressIndex,
                      int start, int end)
 {
@@ -2192,6 +2567,19 @@ bool GetAddressUnspent(const uint160& addressHash, int type,
     return true;
 }
 
+bool GetAddressSummary(const uint160& addressHash, int type, CAddressSummary& summary)
+{
+    if (!fAddressIndex) {
+        LogPrint("rpc", "address index not enabled");
+        return false;
+    }
+    // Addresses without a record have no confirmed transactions.
+    if (!pblocktree->ReadAddressSummary(CAddressIndexIteratorKey(type, addressHash), summary)) {
+        summary.SetNull();
+    }
+    return true;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -2213,14 +2601,19 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
+                // The offset is into the serialized block, which may be
+                // stored compressed, so go through the block's raw bytes.
+                const char* pbegin;
+                const char* pend;
+                std::shared_ptr<const void> raw = ReadRawBlockFromDisk(postx, pbegin, pend);
+                if (!raw)
+                    return error("%s: failed to read block at %s", __func__, postx.ToString());
                 CBlockHeader header;
                 try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
+                    CSpanReader reader(SER_DISK, CLIENT_VERSION, pbegin, pend);
+                    reader >> header;
+                    reader.ignore(postx.nTxOffset);
+                    reader >> txOut;
                 } catch (const std::exception& e) {
                     return error("%s: Deserialize or I/O error - %s", __func__, e.what());
                 }
@@ -2268,42 +2661,248 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
 // CBlock and CBlockIndex
 //
 
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+static std::atomic<int> nBlockCompression{DEFAULT_BLOCK_COMPRESSION};
+
+void SetBlockCompression(int nLevel)
+{
+    nBlockCompression = nLevel;
+}
+
+CBlockDiskRecord::CBlockDiskRecord(const CBlock& block)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    int nLevel = nBlockCompression;
+    if (nLevel > 0 && CompressBlock(ss.data(), ss.data() + ss.size(), nLevel, data)) {
+        nSizeField = data.size() | BLOCK_COMPRESSED_FLAG;
+    } else {
+        data.assign(ss.begin(), ss.end());
+        nSizeField = data.size();
+    }
+}
+
+/** Writes block and undo records behind the caller, if -blockwritebehind is set. */
+static std::unique_ptr<CBlockFileWriter> pblockWriter;
+
+void SetBlockWriteBehind(bool fEnable)
+{
+    if (fEnable && !pblockWriter) {
+        pblockWriter.reset(new CBlockFileWriter([](CBlockFileWriter::FileType type, const CDiskBlockPos& pos) {
+            return type == CBlockFileWriter::BLOCK_FILE ? OpenBlockFile(pos) : OpenUndoFile(pos);
+        }));
+    } else if (!fEnable && pblockWriter) {
+        if (!pblockWriter->Sync()) {
+            LogPrintf("%s: some block or undo data could not be written\n", __func__);
+        }
+        pblockWriter.reset();
+    }
+}
+
+/**
+ * Build a record of the header, its size field and data, and queue it to be
+ * written at pos. pos is moved past the header, as if the record had been
+ * written in place.
+ */
+static void QueueRecord(CBlockFileWriter::FileType type, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart,
+                        uint32_t nSizeField, const char* pbegin, const char* pend, const uint256* hashChecksum = nullptr)
+{
+    std::vector<char> record(CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t));
+    record.reserve(record.size() + (pend - pbegin) + (hashChecksum ? hashChecksum->size() : 0));
+    memcpy(record.data(), messageStart, CMessageHeader::MESSAGE_START_SIZE);
+    WriteLE32(reinterpret_cast<unsigned char*>(record.data()) + CMessageHeader::MESSAGE_START_SIZE, nSizeField);
+    record.insert(record.end(), pbegin, pend);
+    if (hashChecksum) {
+        record.insert(record.end(), hashChecksum->begin(), hashChecksum->end());
+    }
+    CDiskBlockPos posRecord = pos;
+    pos.nPos += CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+    pblockWriter->Write(type, posRecord, std::move(record));
+}
+
+/**
+ * The record whose data starts at pos, if it is still waiting to be
+ * written, with pbegin pointing at its size field.
+ */
+static std::shared_ptr<const std::vector<char>> FindPendingRecord(CBlockFileWriter::FileType type, const CDiskBlockPos& pos, const char*& pbegin)
+{
+    const unsigned int nHeaderSize = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+    if (!pblockWriter || pos.nPos < nHeaderSize) {
+        return nullptr;
+    }
+    std::shared_ptr<const std::vector<char>> record = pblockWriter->Find(type, CDiskBlockPos(pos.nFile, pos.nPos - nHeaderSize));
+    if (record) {
+        pbegin = record->data() + CMessageHeader::MESSAGE_START_SIZE;
+    }
+    return record;
+}
+
+bool WriteBlockToDisk(const CBlockDiskRecord& record, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
+    if (pblockWriter) {
+        QueueRecord(CBlockFileWriter::BLOCK_FILE, pos, messageStart, record.nSizeField,
+                    record.data.data(), record.data.data() + record.data.size());
+        return true;
+    }
+
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
+    fileout << FLATDATA(messageStart) << record.nSizeField;
 
     // Write block
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    fileout.write(record.data.data(), record.data.size());
 
     return true;
 }
 
+static CBlockFileMapper blockFileMapper([](int nFile) {
+    return GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+}, DEFAULT_MAPPED_BLOCK_FILES);
+
+void SetMappedBlockFiles(unsigned int nFiles)
+{
+    blockFileMapper.SetMaxFiles(nFiles);
+}
+
+/**
+ * Locate the record of the block at pos in its mapped block file, and tell
+ * whether it is compressed. The returned mapping must be held for as long as
+ * [pbegin, pend) is used; nullptr means the block has to be read through the
+ * file instead.
+ */
+static std::shared_ptr<const CMappedFile> MapBlockFromDisk(const CDiskBlockPos& pos, const char*& pbegin, const char*& pend, bool& fCompressed)
+{
+    // The block is preceded by its size.
+    if (pos.nPos < sizeof(uint32_t)) {
+        return nullptr;
+    }
+    std::shared_ptr<const CMappedFile> file = blockFileMapper.Get(pos.nFile, pos.nPos);
+    if (!file) {
+        return nullptr;
+    }
+    uint32_t nSize = ReadLE32(reinterpret_cast<const unsigned char*>(file->data() + pos.nPos - sizeof(uint32_t)));
+    fCompressed = (nSize & BLOCK_COMPRESSED_FLAG) != 0;
+    nSize &= ~BLOCK_COMPRESSED_FLAG;
+    if (nSize > MAX_BLOCK_SIZE) {
+        return nullptr;
+    }
+    if (file->size() - pos.nPos < nSize) {
+        file = blockFileMapper.Get(pos.nFile, (size_t)pos.nPos + nSize);
+        if (!file) {
+            return nullptr;
+        }
+    }
+    pbegin = file->data() + pos.nPos;
+    pend = pbegin + nSize;
+    return file;
+}
+
+/** Expand a compressed block record in place of [pbegin, pend). */
+static std::shared_ptr<const void> DecompressRawBlock(const CDiskBlockPos& pos, const char*& pbegin, const char*& pend)
+{
+    auto data = std::make_shared<std::vector<char>>();
+    if (!DecompressBlock(pbegin, pend, MAX_BLOCK_SIZE, *data)) {
+        error("%s: block at %s is compressed and %s", __func__, pos.ToString(),
+              BlockCompressionAvailable() ? "corrupt" : "this build has no zstd support");
+        return nullptr;
+    }
+    pbegin = data->data();
+    pend = pbegin + data->size();
+    return data;
+}
+
+std::shared_ptr<const void> ReadRawBlockFromDisk(const CDiskBlockPos& pos, const char*& pbegin, const char*& pend)
+{
+    bool fCompressed = false;
+    // A block not yet written may already have its space preallocated in
+    // the file, so it is looked for in memory first.
+    if (std::shared_ptr<const std::vector<char>> record = FindPendingRecord(CBlockFileWriter::BLOCK_FILE, pos, pbegin)) {
+        uint32_t nSize = ReadLE32(reinterpret_cast<const unsigned char*>(pbegin));
+        fCompressed = (nSize & BLOCK_COMPRESSED_FLAG) != 0;
+        pbegin += sizeof(uint32_t);
+        pend = pbegin + (nSize & ~BLOCK_COMPRESSED_FLAG);
+        if (fCompressed) {
+            return DecompressRawBlock(pos, pbegin, pend);
+        }
+        return record;
+    }
+    if (std::shared_ptr<const CMappedFile> file = MapBlockFromDisk(pos, pbegin, pend, fCompressed)) {
+        if (fCompressed) {
+            return DecompressRawBlock(pos, pbegin, pend);
+        }
+        return file;
+    }
+
+    // The block is preceded by its size.
+    if (pos.nPos < sizeof(uint32_t)) {
+        return nullptr;
+    }
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+        return nullptr;
+    }
+    try {
+        uint32_t nSize;
+        filein >> nSize;
+        fCompressed = (nSize & BLOCK_COMPRESSED_FLAG) != 0;
+        nSize &= ~BLOCK_COMPRESSED_FLAG;
+        if (nSize > MAX_BLOCK_SIZE) {
+            return nullptr;
+        }
+        auto data = std::make_shared<std::vector<char>>(nSize);
+        filein.read(data->data(), nSize);
+        pbegin = data->data();
+        pend = pbegin + nSize;
+        if (fCompressed) {
+            return DecompressRawBlock(pos, pbegin, pend);
+        }
+        return data;
+    }
+    catch (const std::exception& e) {
+        error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return nullptr;
+    }
+}
+
+uint256 GetRawBlockHash(const char* pbegin, const char* pend)
+{
+    CBlockHeader header;
+    try {
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, pbegin, pend);
+        reader >> header;
+    }
+    catch (const std::exception&) {
+        return uint256();
+    }
+    return header.GetHash();
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    // The block's bytes come from its mapped block file, or else from a
+    // single read of the file, and are deserialized where they are.
+    const char* pbegin;
+    const char* pend;
+    std::shared_ptr<const void> data = ReadRawBlockFromDisk(pos, pbegin, pend);
+    if (!data)
+        return error("ReadBlockFromDisk: failed to read block at %s", pos.ToString());
 
-    // Read block
     try {
-        filein >> block;
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, pbegin, pend);
+        reader >> block;
     }
     catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Juno Cash: Blocks on disk were already validated when stored
@@ -2590,6 +3189,28 @@ bool CScriptCheck::operator()() {
     return true;
 }
 
+bool CRandomXHeaderCheck::operator()() {
+    int64_t nStart = pnCpuTime ? GetThreadCPUTimeMicros() : 0;
+    bool fValid = true;
+    std::vector<bool> vValid;
+    if (!CheckRandomXSolutionsWithSeed(headers, *pparams, seedHash, vValid)) {
+        fValid = false;
+    } else {
+        // For RandomX, the POW hash is the RandomX hash stored in nSolution
+        for (const CBlockHeader* pheader : headers) {
+            uint256 randomxHash;
+            memcpy(randomxHash.begin(), pheader->nSolution.data(), 32);
+            if (!CheckProofOfWork(randomxHash, pheader->nBits, *pparams)) {
+                fValid = false;
+                break;
+            }
+        }
+    }
+    if (pnCpuTime)
+        *pnCpuTime += GetThreadCPUTimeMicros() - nStart;
+    return fValid;
+}
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -2770,13 +3391,27 @@ namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
+    // Serialize the undo data once; its size, the data and its checksum
+    // are all taken from these bytes.
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << blockundo;
+
+    if (pblockWriter) {
+        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+        hasher << hashBlock;
+        hasher.write(ss.data(), ss.size());
+        uint256 hashChecksum = hasher.GetHash();
+        QueueRecord(CBlockFileWriter::UNDO_FILE, pos, messageStart, ss.size(), ss.data(), ss.data() + ss.size(), &hashChecksum);
+        return true;
+    }
+
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
+    unsigned int nSize = ss.size();
     fileout << FLATDATA(messageStart) << nSize;
 
     // Write undo data
@@ -2784,46 +3419,75 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    fileout.write(ss.data(), ss.size());
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
+    hasher.write(ss.data(), ss.size());
     fileout << hasher.GetHash();
 
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenBlockFile failed", __func__);
+    // The undo data is preceded by its size.
+    if (pos.nPos < sizeof(uint32_t))
+        return error("%s: invalid position %s", __func__, pos.ToString());
 
-    // Read block
+    std::vector<char> data;
     uint256 hashChecksum;
-    try {
-        filein >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    const char* pbegin;
+    if (std::shared_ptr<const std::vector<char>> record = FindPendingRecord(CBlockFileWriter::UNDO_FILE, pos, pbegin)) {
+        // Not yet written; the record was built by UndoWriteToDisk, so its
+        // size field matches what it holds.
+        uint32_t nSize = ReadLE32(reinterpret_cast<const unsigned char*>(pbegin));
+        pbegin += sizeof(uint32_t);
+        data.assign(pbegin, pbegin + nSize);
+        memcpy(hashChecksum.begin(), pbegin + nSize, hashChecksum.size());
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+
+        // Read the undo data and its checksum in two reads, rather than field
+        // by field.
+        try {
+            uint32_t nSize;
+            filein >> nSize;
+            if (nSize > MAX_SIZE)
+                return error("%s: undo data too large (%u bytes)", __func__, nSize);
+            data.resize(nSize);
+            filein.read(data.data(), data.size());
+            filein >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
     }
 
-    // Verify checksum
+    // Verify checksum over the bytes as read, without reserializing
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
+    hasher.write(data.data(), data.size());
     if (hashChecksum != hasher.GetHash())
         return error("%s: Checksum mismatch", __func__);
 
+    try {
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, data.data(), data.data() + data.size());
+        reader >> blockundo;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s", __func__, e.what());
+    }
+
     return true;
 }
 
-} // anon namespace
-
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -2866,62 +3530,41 @@ enum DisconnectResult
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
- *  The addressIndex and spentIndex will be updated if requested.
  */
 static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state,
     const CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams,
-    const bool updateIndices)
+    const CBlockUndo* pblockUndo = nullptr)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
     bool fClean = true;
 
-    CBlockUndo blockUndo;
-    CDiskBlockPos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        error("DisconnectBlock(): no undo data available");
-        return DISCONNECT_FAILED;
-    }
-    if (!UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash())) {
-        error("DisconnectBlock(): failure reading undo data");
-        return DISCONNECT_FAILED;
+    // The undo data is read here unless the caller already has it.
+    CBlockUndo blockUndoRead;
+    if (pblockUndo == nullptr) {
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull()) {
+            error("DisconnectBlock(): no undo data available");
+            return DISCONNECT_FAILED;
+        }
+        if (!UndoReadFromDisk(blockUndoRead, pos, pindex->pprev->GetBlockHash())) {
+            error("DisconnectBlock(): failure reading undo data");
+            return DISCONNECT_FAILED;
+        }
+        pblockUndo = &blockUndoRead;
     }
+    const CBlockUndo& blockUndo = *pblockUndo;
 
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
         error("DisconnectBlock(): block and undo data inconsistent");
         return DISCONNECT_FAILED;
     }
-    std::vector<CAddressIndexDbEntry> addressIndex;
-    std::vector<CAddressUnspentDbEntry> addressUnspentIndex;
-    std::vector<CSpentIndexDbEntry> spentIndex;
 
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = block.vtx[i];
         uint256 const hash = tx.GetHash();
 
-        // insightexplorer
-        // https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2236
-        if (fAddressIndex && updateIndices) {
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-                CScript::ScriptType scriptType = out.scriptPubKey.GetType();
-                if (scriptType != CScript::UNKNOWN) {
-                    uint160 const addrHash = out.scriptPubKey.AddressHash();
-
-                    // undo receiving activity
-                    addressIndex.push_back(make_pair(
-                        CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, k, false),
-                        out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(make_pair(
-                        CAddressUnspentKey(scriptType, addrHash, hash, k),
-                        CAddressUnspentValue()));
-                }
-            }
-        }
-
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
         {
@@ -2956,34 +3599,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
                 const CTxInUndo &undo = txundo.vprevout[j];
                 if (!ApplyTxInUndo(undo, view, out))
                     fClean = false;
-
-                // insightexplorer
-                // https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2304
-                const CTxIn input = tx.vin[j];
-                if (fAddressIndex && updateIndices) {
-                    const CTxOut &prevout = view.GetOutputFor(input);
-                    CScript::ScriptType scriptType = prevout.scriptPubKey.GetType();
-                    if (scriptType != CScript::UNKNOWN) {
-                        uint160 const addrHash = prevout.scriptPubKey.AddressHash();
-
-                        // undo spending activity
-                        addressIndex.push_back(make_pair(
-                            CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, j, true),
-                            prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(make_pair(
-                            CAddressUnspentKey(scriptType, addrHash, input.prevout.hash, input.prevout.n),
-                            CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight)));
-                    }
-                }
-                // insightexplorer
-                if (fSpentIndex && updateIndices) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(make_pair(
-                        CSpentIndexKey(input.prevout.hash, input.prevout.n),
-                        CSpentIndexValue()));
-                }
             }
         }
     }
@@ -3052,33 +3667,23 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    // insightexplorer
-    if (fAddressIndex && updateIndices) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-    // insightexplorer
-    if (fSpentIndex && updateIndices) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            AbortNode(state, "Failed to write transaction index");
-            return DISCONNECT_FAILED;
-        }
-    }
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-void static FlushBlockFile(bool fFinalize = false)
+bool static FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
 
+    // Everything queued must be in the files before they are synced.
+    if (pblockWriter && !pblockWriter->Sync())
+        return false;
+
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
+    // Reads past the truncated end of a mapping would fault.
+    if (fFinalize)
+        blockFileMapper.Invalidate(nLastBlockFile);
+
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -3094,23 +3699,145 @@ void static FlushBlockFile(bool fFinalize = false)
         FileCommit(fileOld);
         fclose(fileOld);
     }
+    return true;
 }
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CWorkStealingCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
 void ThreadScriptCheck() {
     RenameThread("zc-scriptcheck");
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CRandomXHeaderCheck> headercheckqueue(8);
+
+void ThreadHeaderCheck() {
+    RenameThread("zc-headercheck");
+    headercheckqueue.Thread();
+}
+
+int ClampHeaderCheckThreads(int64_t nRequested, int nCores)
+{
+    if (nRequested <= 0)
+        nRequested += nCores;
+    if (nRequested <= 1)
+        return 0;
+    return std::min<int64_t>(nRequested, MAX_HEADERCHECK_THREADS);
+}
+
+/**
+ * Blocks that are accepted to disk before their parent is connected (as
+ * happens when blocks are downloaded in parallel during initial block
+ * download, or loaded from disk) are handed to a pool of pre-validation
+ * threads. These run the context-free CheckBlock, including JoinSplit proof
+ * verification, without holding cs_main. ConnectBlock then skips CheckBlock
+ * for blocks that passed, leaving only the contextual work under cs_main.
+ */
+struct CBlockPreValidation {
+    CBlock block;
+    bool fCheckProofs;
+};
+
+static boost::mutex csBlockPreValidation;
+static boost::condition_variable condBlockPreValidation;
+static std::deque<CBlockPreValidation> queueBlockPreValidation;
+//! Blocks that passed pre-validation, and whether their proofs were verified
+static std::map<uint256, bool> mapBlocksPreValidated;
+
+static void QueueBlockPreValidation(const CBlock& block, bool fCheckProofs)
+{
+    boost::unique_lock<boost::mutex> lock(csBlockPreValidation);
+    if (queueBlockPreValidation.size() >= MAX_BLOCK_PREVALIDATION_QUEUE ||
+        mapBlocksPreValidated.count(block.GetHash())) {
+        return;
+    }
+    queueBlockPreValidation.push_back({block, fCheckProofs});
+    condBlockPreValidation.notify_one();
+}
+
+/**
+ * Returns true if the block passed pre-validation with at least the given
+ * checks, and forgets it: a block is only connected once per pre-validation.
+ */
+bool TakeBlockPreValidated(const uint256& hash, bool fCheckProofs)
+{
+    boost::unique_lock<boost::mutex> lock(csBlockPreValidation);
+    auto it = mapBlocksPreValidated.find(hash);
+    if (it == mapBlocksPreValidated.end()) {
+        return false;
+    }
+    bool fPreValidated = it->second || !fCheckProofs;
+    mapBlocksPreValidated.erase(it);
+    return fPreValidated;
+}
+
+/**
+ * Run the context-free checks of a block, with or without its proofs, and
+ * remember it for ConnectBlock if it passes.
+ */
+bool PreValidateBlock(const CBlock& block, bool fCheckProofs, const CChainParams& chainparams)
+{
+    CValidationState state;
+    auto verifier = fCheckProofs ? ProofVerifier::Strict() : ProofVerifier::Disabled();
+    if (!CheckBlock(block, state, chainparams, verifier, false, true, true)) {
+        // ConnectBlock runs CheckBlock again and reports the failure.
+        LogPrint("bench", "Pre-validation of block %s failed: %s\n",
+            block.GetHash().ToString(), FormatStateMessage(state));
+        return false;
+    }
+
+    boost::unique_lock<boost::mutex> lock(csBlockPreValidation);
+    if (mapBlocksPreValidated.size() < MAX_BLOCKS_PREVALIDATED) {
+        mapBlocksPreValidated[block.GetHash()] = fCheckProofs;
+    }
+    return true;
+}
+
+void ThreadBlockPreValidation() {
+    RenameThread("zc-blockcheck");
+    const CChainParams& chainparams = Params();
+    while (true) {
+        CBlockPreValidation item;
+        {
+            boost::unique_lock<boost::mutex> lock(csBlockPreValidation);
+            while (queueBlockPreValidation.empty()) {
+                condBlockPreValidation.wait(lock); // interruption point
+            }
+            item = std::move(queueBlockPreValidation.front());
+            queueBlockPreValidation.pop_front();
+        }
+        PreValidateBlock(item.block, item.fCheckProofs, chainparams);
+    }
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/**
+ * Determine whether a block is covered by -assumevalid: it must be an
+ * ancestor of the assumed-valid block, which must itself be in the best
+ * header chain, and be buried under at least ASSUMEVALID_MIN_BURIED_TIME of
+ * equivalent work so that recent blocks are always fully verified.
+ */
+static bool IsAssumedValid(const CChainParams& chainparams, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (hashAssumeValid.IsNull())
+        return false;
+    BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+    if (it == mapBlockIndex.end() || it->second->GetAncestor(pindex->nHeight) != pindex)
+        return false;
+    if (pindexBestHeader == NULL || pindexBestHeader->GetAncestor(pindex->nHeight) != pindex)
+        return false;
+    return GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader,
+        chainparams.GetConsensus()) > ASSUMEVALID_MIN_BURIED_TIME;
+}
+
 /**
  * Determine whether to do transaction checks when verifying blocks.
  * Returns `false` (allowing transaction checks to be skipped) only if all
@@ -3159,6 +3886,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         fExpensiveChecks = false;
     }
 
+    // If this block is an ancestor of the -assumevalid block, skip script and
+    // proof verification too. UTXO, nullifier, commitment tree and value pool
+    // checks still run in full.
+    bool fAssumedValid = false;
+    if (fExpensiveChecks && blockChecks == CheckAs::Block && !fJustCheck && IsAssumedValid(chainparams, pindex)) {
+        fExpensiveChecks = false;
+        fAssumedValid = true;
+    }
+
     // Don't cache results if we're actually connecting blocks or benchmarking
     // (still consult the cache, though, which will be empty for benchmarks).
     bool fCacheResults = fJustCheck && (blockChecks != CheckAs::SlowBenchmark);
@@ -3176,8 +3912,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // and -ibdskiptxverification is set, disable all transaction checks.
     bool fCheckTransactions = ShouldCheckTransactions(chainparams, pindex);
 
-    // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in
-    if (!CheckBlock(block, state, chainparams, verifier,
+    // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in.
+    // Blocks that were pre-validated with these checks while waiting for their parent can skip this.
+    bool fPreValidated = !fJustCheck && TakeBlockPreValidated(block.GetHash(), fExpensiveChecks);
+    if (!fPreValidated && !CheckBlock(block, state, chainparams, verifier,
         !fJustCheck, !fJustCheck, fCheckTransactions))
     {
         return false;
@@ -3305,9 +4043,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<CAddressIndexDbEntry> addressIndex;
-    std::vector<CAddressUnspentDbEntry> addressUnspentIndex;
-    std::vector<CSpentIndexDbEntry> spentIndex;
 
     // Construct the incremental merkle tree at the current
     // block position,
@@ -3367,13 +4102,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CAmount transparentValueDelta = 0;
     size_t total_sapling_tx = 0;
     size_t total_orchard_tx = 0;
+    size_t total_transparent_only_tx = 0;
 
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Build the signature hash digests of every transaction once, in parallel.
+    // Script checks keep pointers into the arena, which does not move.
+    CBlockPrecomputedData txdata(block, view, nScriptCheckThreads + 1);
+    int64_t nTimeInputs = 0;
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = block.vtx[i];
-        const uint256 hash = tx.GetHash();
 
         nInputs += tx.vin.size();
         nSigOps += GetLegacySigOpCount(tx);
@@ -3389,6 +4126,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         std::vector<CTxOut> allPrevOutputs;
 
         // Are the shielded spends' requirements met?
+        int64_t nTimeInputsStart = GetTimeMicros();
         if (!Consensus::CheckTxShieldedInputs(tx, state, view, 100)) {
             return false;
         }
@@ -3404,49 +4142,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                 transparentValueDelta -= prevout.nValue;
                 allPrevOutputs.push_back(prevout);
             }
+            nTimeInputs += GetTimeMicros() - nTimeInputsStart;
 
             // Which orphan pool entries must we evict?
-            for (size_t j = 0; j < tx.vin.size(); j++) {
-                auto itByPrev = mapOrphanTransactionsByPrev.find(tx.vin[j].prevout);
-                if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-                for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-                    const CTransaction& orphanTx = (*mi)->second.tx;
-                    const uint256& orphanHash = orphanTx.GetHash();
-                    vOrphanErase.push_back(orphanHash);
-                }
-            }
-
-            // insightexplorer
-            // https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2597
-            if (fAddressIndex || fSpentIndex) {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-
-                    const CTxIn input = tx.vin[j];
-                    const CTxOut &prevout = allPrevOutputs[j];
-                    CScript::ScriptType scriptType = prevout.scriptPubKey.GetType();
-                    const uint160 addrHash = prevout.scriptPubKey.AddressHash();
-                    if (fAddressIndex && scriptType != CScript::UNKNOWN) {
-                        // record spending activity
-                        addressIndex.push_back(make_pair(
-                            CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, j, true),
-                            prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(make_pair(
-                            CAddressUnspentKey(scriptType, addrHash, input.prevout.hash, input.prevout.n),
-                            CAddressUnspentValue()));
-                    }
-                    if (fSpentIndex) {
-                        // Add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input.
-                        // If we do not recognize the script type, we still add an entry to the
-                        // spentindex db, with a script type of 0 and addrhash of all zeroes.
-                        spentIndex.push_back(make_pair(
-                            CSpentIndexKey(input.prevout.hash, input.prevout.n),
-                            CSpentIndexValue(hash, j, pindex->nHeight, prevout.nValue, scriptType, addrHash)));
-                    }
-                }
-            }
+            orphanage.GetConflicts(tx, vOrphanErase);
 
             // Add in sigops done by pay-to-script-hash inputs;
             // this is to prevent a "rogue miner" from creating
@@ -3457,7 +4156,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                                  REJECT_INVALID, "bad-blk-sigops");
         }
 
-        txdata.emplace_back(tx, allPrevOutputs);
+        PrecomputedTransactionData& txdataTx = txdata.Get(i, tx, allPrevOutputs);
 
         if (tx.IsCoinBase())
         {
@@ -3478,52 +4177,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             chainSupplyDelta -= txFee;
 
             std::vector<CScriptCheck> vChecks;
-            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, flags, fCacheResults, txdata.back(), consensusParams, consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
+            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, flags, fCacheResults, txdataTx, consensusParams, consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
                 return error("%s: CheckInputs on %s failed with %s", __func__,
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
         }
 
-        // Check shielded inputs.
-        if (!ContextualCheckShieldedInputs(
-            tx,
-            txdata.back(),
-            state,
-            view,
-            saplingAuth,
-            orchardAuth,
-            consensusParams,
-            consensusBranchId,
-            consensusParams.NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_NU5),
-            true))
-        {
-            return error(
-                "%s: ContextualCheckShieldedInputs() on %s failed with %s", __func__,
-                tx.GetHash().ToString(),
-                FormatStateMessage(state));
-        }
-
-        // insightexplorer
-        // https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-7ec3c68a81efff79b6ca22ac1f1eabbaR2656
-        if (fAddressIndex) {
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-                CScript::ScriptType scriptType = out.scriptPubKey.GetType();
-                if (scriptType != CScript::UNKNOWN) {
-                    uint160 const addrHash = out.scriptPubKey.AddressHash();
-
-                    // record receiving activity
-                    addressIndex.push_back(make_pair(
-                        CAddressIndexKey(scriptType, addrHash, pindex->nHeight, i, hash, k, false),
-                        out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(make_pair(
-                        CAddressUnspentKey(scriptType, addrHash, hash, k),
-                        CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                }
-            }
-        }
+        // The shielded requirements were checked against the view above; the
+        // shielded signatures are checked for the whole block after this loop.
 
         CTxUndo undoDummy;
         if (i > 0) {
@@ -3592,10 +4253,85 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             total_orchard_tx += 1;
         }
 
+        if (tx.vJoinSplit.empty() && !tx.GetSaplingBundle().IsPresent() && !tx.GetOrchardBundle().IsPresent()) {
+            total_transparent_only_tx += 1;
+        }
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
+    // Check the shielded signatures of every transaction. These only read the
+    // transaction and its precomputed data (which is complete now that every
+    // in-block spend has been resolved), so with script check threads enabled
+    // the signature hashes and JoinSplit signatures are computed in parallel.
+    // Queueing the bundles into the batch validators stays serial and in
+    // block order.
+    std::vector<uint256> vShieldedSighash(block.vtx.size());
+    std::vector<char> vShieldedOk(block.vtx.size(), true);
+    {
+        auto checkShieldedRange = [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                CValidationState stateDummy;
+                vShieldedOk[i] = CheckShieldedSignatures(block.vtx[i], txdata[i], stateDummy,
+                    consensusParams, consensusBranchId, 100, vShieldedSighash[i]);
+            }
+        };
+        size_t nShielded = block.vtx.size() - total_transparent_only_tx;
+        size_t nWorkers = std::min<size_t>(nScriptCheckThreads + 1, nShielded / SHIELDED_SIGHASH_MIN_PER_WORKER);
+        if (nWorkers <= 1) {
+            checkShieldedRange(0, block.vtx.size());
+        } else {
+            size_t nPerWorker = (block.vtx.size() + nWorkers - 1) / nWorkers;
+            std::vector<std::future<void>> vWorkers;
+            for (size_t nBegin = nPerWorker; nBegin < block.vtx.size(); nBegin += nPerWorker) {
+                vWorkers.push_back(std::async(std::launch::async, checkShieldedRange,
+                    nBegin, std::min(block.vtx.size(), nBegin + nPerWorker)));
+            }
+            checkShieldedRange(0, std::min(block.vtx.size(), nPerWorker));
+            for (auto& worker : vWorkers) {
+                worker.get();
+            }
+        }
+    }
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        // Re-run a failed check to report its error through the caller's state.
+        if (!vShieldedOk[i]) {
+            CheckShieldedSignatures(tx, txdata[i], state, consensusParams, consensusBranchId, 100, vShieldedSighash[i]);
+        }
+        if (!vShieldedOk[i] || !QueueShieldedAuthValidation(tx, state, saplingAuth, orchardAuth, 100, vShieldedSighash[i])) {
+            return error(
+                "%s: ContextualCheckShieldedInputs() on %s failed with %s", __func__,
+                tx.GetHash().ToString(),
+                FormatStateMessage(state));
+        }
+    }
+
+    // Every Sapling and Orchard authorization in the block is now queued. If
+    // script checks run in parallel, batch-validate the shielded bundles on
+    // their own threads too, so that the proofs are checked while the script
+    // check queue drains and the block commitments below are computed. The
+    // results are collected just before the script checks are.
+    int64_t nTimeSaplingAuth = 0;
+    int64_t nTimeOrchardAuth = 0;
+    auto validateAuth = [](auto& auth, int64_t& nMicros) {
+        int64_t nStart = GetTimeMicros();
+        bool fValid = auth.value()->validate();
+        nMicros = GetTimeMicros() - nStart;
+        return fValid;
+    };
+    std::future<bool> saplingValid;
+    std::future<bool> orchardValid;
+    if (saplingAuth.has_value()) {
+        saplingValid = std::async(nScriptCheckThreads && total_sapling_tx > 0 ? std::launch::async : std::launch::deferred,
+            [&]() { return validateAuth(saplingAuth, nTimeSaplingAuth); });
+    }
+    if (orchardAuth.has_value()) {
+        orchardValid = std::async(nScriptCheckThreads && total_orchard_tx > 0 ? std::launch::async : std::launch::deferred,
+            [&]() { return validateAuth(orchardAuth, nTimeOrchardAuth); });
+    }
+
     // Derive the various block commitments.
     // We only derive them if they will be used for this block.
     std::optional<uint256> hashAuthDataRoot;
@@ -3739,6 +4475,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime1 = GetTimeMicros(); nTimeConnect += nTime1 - nTimeStart;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs-1), nTimeConnect * 0.000001);
+    if (!fJustCheck)
+        MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime1 - nTimeStart) * 0.000001, "phase", "connect");
 
     CAmount cbTotalOutputValue = block.vtx[0].GetValueOut() + pindex->nLockboxValue;
     CAmount cbTotalInputValue = consensusParams.GetBlockSubsidy(pindex->nHeight) + nFees;
@@ -3783,36 +4521,62 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     // Ensure Sapling authorizations are valid (if we are checking them)
-    if (saplingAuth.has_value() && !saplingAuth.value()->validate()) {
+    if (saplingValid.valid() && !saplingValid.get()) {
         return state.DoS(100,
             error("%s: a Sapling bundle within the block is invalid", __func__),
             REJECT_INVALID, "bad-sapling-bundle-authorization");
     }
 
     // Ensure Orchard signatures are valid (if we are checking them)
-    if (orchardAuth.has_value() && !orchardAuth.value()->validate()) {
+    if (orchardValid.valid() && !orchardValid.get()) {
         return state.DoS(100,
             error("%s: an Orchard bundle within the block is invalid", __func__),
             REJECT_INVALID, "bad-orchard-bundle-authorization");
     }
 
+    int64_t nTimeScripts = GetTimeMicros();
     if (!control.Wait())
         return state.DoS(100, false);
     int64_t nTime2 = GetTimeMicros(); nTimeVerify += nTime2 - nTimeStart;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs-1), nTimeVerify * 0.000001);
+    if (!fJustCheck)
+        MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime2 - nTimeStart) * 0.000001, "phase", "verify");
 
     if (fJustCheck)
         return true;
 
+    RecordValidationPhase(VALIDATION_PHASE_INPUTS, nTimeInputs);
+    RecordValidationPhase(VALIDATION_PHASE_SAPLING, nTimeSaplingAuth);
+    RecordValidationPhase(VALIDATION_PHASE_ORCHARD, nTimeOrchardAuth);
+    RecordValidationPhase(VALIDATION_PHASE_SCRIPTS, nTime2 - nTimeScripts);
+
+    // Feed the estimate of what -assumevalid saves, from the cost of the
+    // same work in blocks that were checked.
+    if (fAssumedValid) {
+        int64_t nSaved = RecordSkippedWork(VERIFICATION_WORK_SCRIPTS, nInputs - 1) +
+            RecordSkippedWork(VERIFICATION_WORK_SAPLING, total_sapling_tx) +
+            RecordSkippedWork(VERIFICATION_WORK_ORCHARD, total_orchard_tx);
+        LogPrint("bench", "    - Assumed valid: skipped %u txins, %u Sapling and %u Orchard bundles, saving about %.2fms\n",
+            nInputs - 1, (unsigned)total_sapling_tx, (unsigned)total_orchard_tx, 0.001 * nSaved);
+    } else if (fExpensiveChecks) {
+        if (nScriptCheckThreads) {
+            RecordVerifiedWork(VERIFICATION_WORK_SCRIPTS, nInputs - 1, nTime2 - nTimeScripts);
+        }
+        RecordVerifiedWork(VERIFICATION_WORK_SAPLING, total_sapling_tx, nTimeSaplingAuth);
+        RecordVerifiedWork(VERIFICATION_WORK_ORCHARD, total_orchard_tx, nTimeOrchardAuth);
+    }
+
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS))
     {
         if (pindex->GetUndoPos().IsNull()) {
+            int64_t nTimeUndo = GetTimeMicros();
             CDiskBlockPos _pos;
             if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
                 return error("%s: FindUndoPos failed", __func__);
             if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
                 return AbortNode(state, "Failed to write undo data");
+            RecordValidationPhase(VALIDATION_PHASE_UNDO, GetTimeMicros() - nTimeUndo);
 
             // update nUndoPos in block index
             pindex->nUndoPos = _pos.nPos;
@@ -3845,53 +4609,22 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    // START insightexplorer
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-    if (fSpentIndex) {
-        if (!pblocktree->UpdateSpentIndex(spentIndex)) {
-            return AbortNode(state, "Failed to write spent index");
-        }
-    }
-    if (fTimestampIndex) {
-        unsigned int logicalTS = pindex->nTime;
-        unsigned int prevLogicalTS = 0;
-
-        // retrieve logical timestamp of the previous block
-        if (pindex->pprev)
-            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
-                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
-
-        if (logicalTS <= prevLogicalTS) {
-            logicalTS = prevLogicalTS + 1;
-            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
-        }
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
-    }
-    // END insightexplorer
+    if (fShieldedIndex)
+        if (!pblocktree->WriteShieldedIndex(pindex->GetBlockHash(), BuildCompactShieldedBlock(block)))
+            return AbortNode(state, "Failed to write shielded index");
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime3 = GetTimeMicros(); nTimeIndex += nTime3 - nTime2;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeIndex * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime3 - nTime2) * 0.000001, "phase", "index");
 
     // Erase orphan transactions include or precluded by this block
     if (vOrphanErase.size()) {
         int nErased = 0;
         for (uint256 &orphanHash : vOrphanErase) {
-            nErased += EraseOrphanTx(orphanHash);
+            nErased += orphanage.EraseTx(orphanHash);
         }
         LogPrint("mempool", "Erased %d orphan tx included or conflicted by block\n", nErased);
     }
@@ -3942,6 +4675,7 @@ bool static FlushStateToDisk(
         nLastFlush = nNow;
     }
     size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+    MetricsGauge("zcash.chain.coins.cache.bytes", cacheSize);
     // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
     bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0/9) > nCoinCacheUsage;
     // The cache is over the limit, we have to write now.
@@ -3958,7 +4692,8 @@ bool static FlushStateToDisk(
         if (!CheckDiskSpace(0))
             return state.Error("out of disk space");
         // First make sure all block and undo data is flushed to disk.
-        FlushBlockFile();
+        if (!FlushBlockFile())
+            return AbortNode(state, "Failed to write block and undo files");
         // Then update all block file information (which may refer to block and undo files).
         {
             std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -3992,8 +4727,23 @@ bool static FlushStateToDisk(
         if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
+        // Except on shutdown, the coins stay cached as clean entries, and
+        // if the cache is over its limit only the coldest are evicted, so
+        // the working set survives the flush.
+        int64_t nFlushStart = GetTimeMicros();
+        size_t nFlushCoins = pcoinsTip->GetCacheSize();
+        bool fFlushed = mode == FLUSH_STATE_ALWAYS ? pcoinsTip->Flush() : pcoinsTip->WriteBack();
+        TRACE4(coins, flush, (int)mode, nFlushCoins, fFlushed, GetTimeMicros() - nFlushStart);
+        if (!fFlushed)
             return AbortNode(state, "Failed to write to coin database");
+        if (fCacheLarge || fCacheCritical)
+            pcoinsTip->EvictColdCoins(nCoinCacheUsage / 100 * COINS_CACHE_EVICT_TARGET_PERCENT);
+        // With -backgroundflush the coins are written by another thread
+        // while we carry on. Shutdown and pruning need them on disk now.
+        if (pcoinsBackgroundFlush != NULL && (!fBackgroundFlush || mode == FLUSH_STATE_ALWAYS || fFlushForPrune)) {
+            if (!pcoinsBackgroundFlush->Sync())
+                return AbortNode(state, "Failed to write to coin database");
+        }
         nLastFlush = nNow;
     }
     // Don't flush the wallet witness cache (SetBestChain()) here, see #4301
@@ -4109,6 +4859,68 @@ struct PoolMetrics {
     } while (0)
 
 /** Update chainActive and related internal data structures. */
+std::shared_ptr<const CChainStateSnapshot> GetChainStateSnapshot()
+{
+    LOCK(cs_chainSnapshot);
+    return chainSnapshot;
+}
+
+int GetBestHeaderHeight()
+{
+    return nBestHeaderHeight.load(std::memory_order_relaxed);
+}
+
+uint64_t GetSkippedHeaderPoWCount()
+{
+    return nSkippedHeaderPoW.load(std::memory_order_relaxed);
+}
+
+size_t BlockIndexDynamicMemoryUsage()
+{
+    AssertLockHeld(cs_main);
+    return memusage::DynamicUsage(mapBlockIndex) +
+           mapBlockIndex.size() * memusage::MallocUsage(sizeof(CBlockIndex)) +
+           memusage::MallocUsage((chainActive.Height() + 1) * sizeof(CBlockIndex*)) +
+           headerCache.DynamicMemoryUsage();
+}
+
+size_t OrphanageDynamicMemoryUsage()
+{
+    AssertLockHeld(cs_main);
+    return orphanage.DynamicMemoryUsage();
+}
+
+static void SetBestHeader(CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    pindexBestHeader = pindex;
+    nBestHeaderHeight.store(pindex ? pindex->nHeight : -1, std::memory_order_relaxed);
+}
+
+/** Publish a snapshot of chainActive and the chain state that goes with it. */
+static void PublishChainStateSnapshot()
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<const CChainStateSnapshot> prev = GetChainStateSnapshot();
+    auto fresh = std::make_shared<CChainStateSnapshot>(chainActive, prev.get());
+    if (chainActive.Tip()) {
+        fresh->fInitialDownload = IsInitialBlockDownload(Params().GetConsensus());
+        SproutMerkleTree tree;
+        pcoinsTip->GetSproutAnchorAt(pcoinsTip->GetBestAnchor(SPROUT), tree);
+        fresh->nSproutCommitments = tree.size();
+        fresh->nSizeOnDisk = CalculateCurrentUsage();
+        if (fPruneMode) {
+            CBlockIndex *block = chainActive.Tip();
+            while (block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
+                block = block->pprev;
+            fresh->nPruneHeight = block->nHeight;
+        }
+    }
+
+    LOCK(cs_chainSnapshot);
+    chainSnapshot = fresh;
+}
+
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
 
@@ -4117,7 +4929,7 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     // blocks arrive after headers were already in mapBlockIndex, causing
     // header sync to stall during IBD.
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork) {
-        pindexBestHeader = pindexNew;
+        SetBestHeader(pindexNew);
     }
 
     // New best block
@@ -4154,6 +4966,11 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     RenderPoolMetrics("orchard", orchardPool);
     RenderPoolMetrics("transparent", transparentPool);
 
+    // Start building the next RandomX epoch's cache/dataset before it is needed.
+    PrepareNextRandomXSeed(pindexNew, chainParams.GetConsensus());
+
+    PublishChainStateSnapshot();
+
     {
         WAIT_LOCK(g_best_block_mutex, lock);
         g_best_block = pindexNew->GetBlockHash();
@@ -4162,18 +4979,80 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     }
 }
 
+/** A block and its undo data, read before the block is disconnected. */
+struct DisconnectData {
+    CBlock block;
+    CBlockUndo blockUndo;
+};
+
+/**
+ * Reads the next block to be disconnected, and its undo data, in the
+ * background while the current tip is disconnected, so that a long run of
+ * disconnects in a reorg or rewind does not wait on each read in turn.
+ */
+class DisconnectReadAhead
+{
+private:
+    const CBlockIndex* pindexNext = nullptr;
+    std::future<std::optional<DisconnectData>> next;
+
+public:
+    /** Start reading the data of pindex, which must have a parent. */
+    void Start(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+    {
+        pindexNext = nullptr;
+        CDiskBlockPos blockPos = pindex->GetBlockPos();
+        CDiskBlockPos undoPos = pindex->GetUndoPos();
+        if (blockPos.IsNull() || undoPos.IsNull() || pindex->pprev == nullptr) {
+            return;
+        }
+        // Only values are handed to the reader, not the block index.
+        uint256 hash = pindex->GetBlockHash();
+        uint256 hashPrev = pindex->pprev->GetBlockHash();
+        pindexNext = pindex;
+        next = std::async(std::launch::async, [=, &consensusParams]() -> std::optional<DisconnectData> {
+            DisconnectData data;
+            if (!ReadBlockFromDisk(data.block, blockPos, consensusParams) ||
+                data.block.GetHash() != hash ||
+                !UndoReadFromDisk(data.blockUndo, undoPos, hashPrev)) {
+                return std::nullopt;
+            }
+            return data;
+        });
+    }
+
+    /**
+     * Return the data read for pindex, or std::nullopt if it was not read
+     * ahead or the read failed (in which case it is read again, reporting
+     * the error).
+     */
+    std::optional<DisconnectData> Take(const CBlockIndex* pindex)
+    {
+        if (pindexNext != pindex || !next.valid()) {
+            return std::nullopt;
+        }
+        pindexNext = nullptr;
+        return next.get();
+    }
+};
+
 /**
  * Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and
- * mempool.removeWithoutBranchId after this, with cs_main held.
+ * mempool.removeWithoutBranchId after this, with cs_main held. pdata, if
+ * given, holds the tip's block and undo data, to bypass reading them.
  */
-bool static DisconnectTip(CValidationState &state, const CChainParams& chainparams, bool fBare = false)
+bool static DisconnectTip(CValidationState &state, const CChainParams& chainparams, bool fBare = false,
+                          const DisconnectData* pdata = nullptr)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
-    CBlock block;
-    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
+    CBlock blockRead;
+    if (pdata == nullptr && !ReadBlockFromDisk(blockRead, pindexDelete, chainparams.GetConsensus()))
         return AbortNode(state, "Failed to read block");
+    const CBlock& block = pdata ? pdata->block : blockRead;
+    TRACE3(validation, block_disconnect_start,
+        pindexDelete->phashBlock->begin(), pindexDelete->nHeight, block.vtx.size());
     // Apply the block atomically to the chain state.
     uint256 sproutAnchorBeforeDisconnect = pcoinsTip->GetBestAnchor(SPROUT);
     uint256 saplingAnchorBeforeDisconnect = pcoinsTip->GetBestAnchor(SAPLING);
@@ -4181,9 +5060,12 @@ bool static DisconnectTip(CValidationState &state, const CChainParams& chainpara
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        // insightexplorer: update indices (true)
-        if (DisconnectBlock(block, state, pindexDelete, view, chainparams, true) != DISCONNECT_OK)
+        if (DisconnectBlock(block, state, pindexDelete, view, chainparams,
+                            pdata ? &pdata->blockUndo : nullptr) != DISCONNECT_OK) {
+            TRACE4(validation, block_disconnect_end,
+                pindexDelete->phashBlock->begin(), pindexDelete->nHeight, false, GetTimeMicros() - nStart);
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        }
         assert(view.Flush());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
@@ -4235,17 +5117,20 @@ bool static DisconnectTip(CValidationState &state, const CChainParams& chainpara
 
     // Updates to connected wallets are triggered by ThreadNotifyWallets
 
+    TRACE4(validation, block_disconnect_end,
+        pindexDelete->phashBlock->begin(), pindexDelete->nHeight, true, GetTimeMicros() - nStart);
     return true;
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
 // Protected by cs_main
-std::map<const CBlockIndex*, std::list<CTransaction>> recentlyConflictedTxs;
+std::map<const CBlockIndex*, std::vector<std::shared_ptr<const CTransaction>>> recentlyConflictedTxs;
 uint64_t nConnectedSequence = 0;
 uint64_t nNotifiedSequence = 0;
 
@@ -4257,8 +5142,17 @@ uint64_t nNotifiedSequence = 0;
 bool static ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const CBlock* pblock)
 {
     assert(pblock && pindexNew->pprev == chainActive.Tip());
+    TRACE3(validation, block_connect_start,
+        pindexNew->phashBlock->begin(), pindexNew->nHeight, pblock->vtx.size());
+    // Warm the tip cache with the block's inputs, reading the misses from
+    // the database in parallel rather than one at a time in ConnectBlock.
+    int64_t nTime1 = GetTimeMicros();
+    pcoinsTip->Prefetch(pblock->vtx, nScriptCheckThreads + 1);
     // Apply the block atomically to the chain state.
-    int64_t nTime2 = GetTimeMicros();
+    int64_t nTime2 = GetTimeMicros(); nTimePrefetch += nTime2 - nTime1;
+    LogPrint("bench", "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimePrefetch * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime2 - nTime1) * 0.000001, "phase", "prefetch");
+    RecordValidationPhase(VALIDATION_PHASE_PREFETCH, nTime2 - nTime1);
     int64_t nTime3;
     {
         CCoinsViewCache view(pcoinsTip);
@@ -4267,6 +5161,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
         if (!rv) {
             if (state.IsInvalid())
                 InvalidBlockFound(pindexNew, state, chainparams);
+            TRACE4(validation, block_connect_end,
+                pindexNew->phashBlock->begin(), pindexNew->nHeight, false, GetTimeMicros() - nTime1);
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(pindexNew->GetBlockHash());
@@ -4276,11 +5172,15 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime4 - nTime3) * 0.000001, "phase", "flush");
+    RecordValidationPhase(VALIDATION_PHASE_FLUSH, nTime4 - nTime3);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime5 - nTime4) * 0.000001, "phase", "chainstate");
+    RecordValidationPhase(VALIDATION_PHASE_CHAINSTATE, nTime5 - nTime4);
     // Remove conflicting transactions from the mempool.
     std::list<CTransaction> txConflicted;
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted);
@@ -4297,7 +5197,12 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
 
     // Cache the conflicted transactions for subsequent notification.
     // Updates to connected wallets are triggered by ThreadNotifyWallets
-    recentlyConflictedTxs.insert(std::make_pair(pindexNew, txConflicted));
+    std::vector<std::shared_ptr<const CTransaction>> vConflicted;
+    vConflicted.reserve(txConflicted.size());
+    for (CTransaction& tx : txConflicted) {
+        vConflicted.push_back(std::make_shared<const CTransaction>(std::move(tx)));
+    }
+    recentlyConflictedTxs.insert(std::make_pair(pindexNew, std::move(vConflicted)));
 
     // Increment the count of `ConnectTip` calls.
     nConnectedSequence += 1;
@@ -4306,12 +5211,16 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5;
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
+    MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime6 - nTime5) * 0.000001, "phase", "postconnect");
+    RecordValidationPhase(VALIDATION_PHASE_CALLBACKS, nTime6 - nTime5);
     // Total connection time benchmarking occurs in ActivateBestChainStep.
     MetricsIncrementCounter("zcash.chain.verified.block.total");
+    TRACE4(validation, block_connect_end,
+        pindexNew->phashBlock->begin(), pindexNew->nHeight, true, nTime6 - nTime1);
     return true;
 }
 
-std::pair<std::list<CTransaction>, std::optional<uint64_t>> TakeRecentlyConflicted(const CBlockIndex* pindex)
+std::pair<std::vector<std::shared_ptr<const CTransaction>>, std::optional<uint64_t>> TakeRecentlyConflicted(const CBlockIndex* pindex)
 {
     AssertLockHeld(cs_main);
 
@@ -4321,7 +5230,7 @@ std::pair<std::list<CTransaction>, std::optional<uint64_t>> TakeRecentlyConflict
     // no entries will exist in `recentlyConflictedTxs` until the next block after the
     // node's chain tip at the point of shutdown. In these cases, the wallet cannot learn
     // about conflicts in those blocks (which should be fine).
-    std::list<CTransaction> conflictedTxs = recentlyConflictedTxs[pindex];
+    std::vector<std::shared_ptr<const CTransaction>> conflictedTxs = std::move(recentlyConflictedTxs[pindex]);
     recentlyConflictedTxs.erase(pindex);
     if (recentlyConflictedTxs.empty()) {
         return std::make_pair(conflictedTxs, nConnectedSequence);
@@ -4454,8 +5363,13 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
+    DisconnectReadAhead readAhead;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams))
+        auto data = readAhead.Take(chainActive.Tip());
+        if (chainActive.Tip()->pprev && chainActive.Tip()->pprev != pindexFork) {
+            readAhead.Start(chainActive.Tip()->pprev, chainparams.GetConsensus());
+        }
+        if (!DisconnectTip(state, chainparams, false, data ? &*data : nullptr))
             return false;
         fBlocksDisconnected = true;
     }
@@ -4492,6 +5406,8 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
             }
             int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
             LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+            MetricsHistogram("zcash.chain.verified.block.phase.seconds", (nTime2 - nTime1) * 0.000001, "phase", "readfromdisk");
+            RecordValidationPhase(VALIDATION_PHASE_READ, nTime2 - nTime1);
 
             if (!ConnectTip(state, chainparams, pindexConnect, pconnectBlock)) {
                 if (state.IsInvalid()) {
@@ -4510,6 +5426,7 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
                 int64_t nTime3 = GetTimeMicros(); nTimeTotal += nTime3 - nTime1;
                 LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime3 - nTime1) * 0.001, nTimeTotal * 0.000001);
                 MetricsHistogram("zcash.chain.verified.block.seconds", (nTime3 - nTime1) * 0.000001);
+                RecordValidationPhase(VALIDATION_PHASE_TOTAL, nTime3 - nTime1);
 
                 PruneBlockIndexCandidates();
                 if (!pindexOldTip || chainActive.Tip()->nChainWork > pindexOldTip->nChainWork) {
@@ -4559,6 +5476,68 @@ static void NotifyHeaderTip(const Consensus::Params& params) {
     }
 }
 
+static std::mutex cs_connectingTip;
+static std::condition_variable cvTipConnected;
+//! ActivateBestChain calls updating the tip. Guarded by cs_connectingTip.
+static int nConnectingTip = 0;
+static std::atomic<bool> fConnectingTip(false);
+static std::atomic<uint64_t> nTipConnects(0);
+static std::atomic<int64_t> nTipConnectMicros(0);
+
+/**
+ * Marks a tip update in ActivateBestChain for IsConnectingTip, from Start()
+ * until it goes out of scope, once initial block download is over, and
+ * times it.
+ */
+class CConnectingTipScope
+{
+    bool fActive = false;
+    int64_t nStart = 0;
+
+public:
+    void Start()
+    {
+        if (fActive || !IBDLatchToFalse.load(std::memory_order_relaxed))
+            return;
+        fActive = true;
+        nStart = GetTimeMicros();
+        std::lock_guard<std::mutex> lock(cs_connectingTip);
+        nConnectingTip++;
+        fConnectingTip = true;
+    }
+
+    ~CConnectingTipScope()
+    {
+        if (!fActive)
+            return;
+        nTipConnects++;
+        nTipConnectMicros += GetTimeMicros() - nStart;
+        {
+            std::lock_guard<std::mutex> lock(cs_connectingTip);
+            if (--nConnectingTip == 0)
+                fConnectingTip = false;
+        }
+        cvTipConnected.notify_all();
+    }
+};
+
+bool IsConnectingTip()
+{
+    return fConnectingTip.load(std::memory_order_relaxed);
+}
+
+void WaitForTipConnected(int64_t nMaxMillis)
+{
+    std::unique_lock<std::mutex> lock(cs_connectingTip);
+    cvTipConnected.wait_for(lock, std::chrono::milliseconds(nMaxMillis), [] { return nConnectingTip == 0; });
+}
+
+void GetTipConnectStats(uint64_t& nConnects, int64_t& nConnectMicros)
+{
+    nConnects = nTipConnects.load();
+    nConnectMicros = nTipConnectMicros.load();
+}
+
 /**
  * Make the best chain active, in multiple steps. The result is either failure
  * or an activated best chain. pblock is either NULL or a pointer to a block
@@ -4584,6 +5563,7 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
         bool fInitialDownload;
         int nNewHeight;
         {
+            CConnectingTipScope connectingTip;
             LOCK(cs_main);
             if (pindexMostWork == NULL) {
                 pindexMostWork = FindMostWorkChain();
@@ -4592,6 +5572,7 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
             // Whether we have anything to do at all.
             if (pindexMostWork == NULL || pindexMostWork == chainActive.Tip())
                 return true;
+            connectingTip.Start();
 
             bool fInvalidFound = false;
             if (!ActivateBestChainStep(state, chainparams, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : NULL, fInvalidFound))
@@ -4748,8 +5729,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const Consensus::Params&
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -4789,7 +5769,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const Consensus::Params&
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
-        pindexBestHeader = pindexNew;
+        SetBestHeader(pindexNew);
 
     setDirtyBlockIndex.insert(pindexNew);
 
@@ -5039,7 +6019,8 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAdd
         if (!fKnown) {
             LogPrintf("Leaving block file %i: %s\n", nFile, vinfoBlockFile[nFile].ToString());
         }
-        FlushBlockFile(!fKnown);
+        if (!FlushBlockFile(!fKnown))
+            return AbortNode(state, "Failed to write block and undo files");
         nLastBlockFile = nFile;
     }
 
@@ -5176,8 +6157,14 @@ bool CheckBlock(const CBlock& block,
     // transaction validation, as otherwise we may mark the header as invalid
     // because we receive the wrong transactions for it.
 
-    // Size limits
-    if (block.vtx.empty() || block.vtx.size() > MAX_BLOCK_SIZE || ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION) > MAX_BLOCK_SIZE)
+    // Size limits. The serialized size of each transaction is cached, so
+    // only the header needs to be measured.
+    size_t nBlockSize = ::GetSerializeSize(static_cast<const CBlockHeader&>(block), SER_NETWORK, PROTOCOL_VERSION) +
+                        GetSizeOfCompactSize(block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        nBlockSize += tx.GetTotalSize();
+    }
+    if (block.vtx.empty() || block.vtx.size() > MAX_BLOCK_SIZE || nBlockSize > MAX_BLOCK_SIZE)
         return state.DoS(100, error("CheckBlock(): size limits failed"),
                          REJECT_INVALID, "bad-blk-length");
 
@@ -5364,7 +6351,115 @@ bool ContextualCheckBlock(
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL)
+/**
+ * Verify the RandomX proof of work of a continuous run of headers on the
+ * header-check worker pool.
+ *
+ * Seed hashes are resolved under a short cs_main hold; the hashing itself runs
+ * without cs_main. Checks are ordered by seed so each worker batch keeps hitting
+ * the same thread-local VM. Returns true only if every new header in the run has
+ * a valid RandomX solution meeting its nBits target; on any failure (or if the
+ * run cannot be resolved against the block index) the caller falls back to the
+ * per-header checks in AcceptBlockHeader, which identify the offending header.
+ * The CPU time the other workers spend on the run is charged to pusage, if set;
+ * the share hashed by the calling thread counts towards the message at hand.
+ */
+bool PreverifyHeadersPoW(const std::vector<CBlockHeader>& headers, const CChainParams& chainparams,
+                                CPeerResourceUsage* pusage = nullptr)
+{
+    if (nHeaderCheckThreads == 0 || headers.empty())
+        return false;
+
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+    std::vector<std::pair<uint256, const CBlockHeader*>> vPending;
+    vPending.reserve(headers.size());
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(headers.front().hashPrevBlock);
+        if (mi == mapBlockIndex.end())
+            return false;
+        const CBlockIndex* pindexPrev = mi->second;
+        if (pindexPrev->nStatus & BLOCK_FAILED_MASK)
+            return false;
+
+        const uint64_t nFirstHeight = pindexPrev->nHeight + 1;
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            if (i > 0 && header.hashPrevBlock != headers[i - 1].GetHash())
+                return false;
+            if (mapBlockIndex.count(header.GetHash()))
+                continue;
+
+            const uint64_t nHeight = nFirstHeight + i;
+            const uint64_t nSeedHeight = RandomX_SeedHeight(nHeight);
+            uint256 seedHash;
+            if (nSeedHeight != 0 && nSeedHeight >= nFirstHeight) {
+                // The seed block is itself one of the earlier headers in this run.
+                seedHash = headers[nSeedHeight - nFirstHeight].GetHash();
+            } else if (!GetRandomXSeedHash(pindexPrev, nHeight, seedHash)) {
+                return false;
+            }
+            vPending.emplace_back(seedHash, &header);
+        }
+    }
+
+    if (vPending.empty())
+        return false;
+
+    std::stable_sort(vPending.begin(), vPending.end(),
+        [](const std::pair<uint256, const CBlockHeader*>& a, const std::pair<uint256, const CBlockHeader*>& b) {
+            return a.first < b.first;
+        });
+
+    // Hash up to RANDOMX_HEADER_CHECK_BATCH same-seed headers per check
+    std::atomic<int64_t> nCheckTime(0);
+    std::vector<CRandomXHeaderCheck> vChecks;
+    for (const auto& pending : vPending) {
+        if (vChecks.empty() || vChecks.back().GetSeedHash() != pending.first ||
+            vChecks.back().Size() >= RANDOMX_HEADER_CHECK_BATCH) {
+            vChecks.emplace_back(pending.first, consensusParams, pusage ? &nCheckTime : nullptr);
+        }
+        vChecks.back().Add(*pending.second);
+    }
+
+    int64_t nStart = GetTimeMicros();
+    int64_t nCpuStart = GetThreadCPUTimeMicros();
+    size_t nChecks = vPending.size();
+    CCheckQueueControl<CRandomXHeaderCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    bool fAllValid = control.Wait();
+    if (pusage)
+        pusage->AddHeaderChecks(nChecks, nCheckTime - (GetThreadCPUTimeMicros() - nCpuStart));
+    LogPrint("bench", "    - Verify %u header PoW solutions: %.2fms\n", nChecks, 0.001 * (GetTimeMicros() - nStart));
+    return fAllValid;
+}
+
+void PreverifyBlocksPoW(const std::vector<const CBlockHeader*>& blocks)
+{
+    std::map<uint256, std::vector<const CBlockHeader*>> mapBySeed;
+    {
+        LOCK(cs_main);
+        for (const CBlockHeader* pblock : blocks) {
+            BlockMap::iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
+            if (mi == mapBlockIndex.end())
+                continue;
+            const CBlockIndex* pindexPrev = mi->second;
+            uint256 seedHash;
+            if (!GetRandomXSeedHash(pindexPrev, pindexPrev->nHeight + 1, seedHash))
+                continue;
+            mapBySeed[seedHash].push_back(pblock);
+        }
+    }
+
+    // Only the cache matters here; invalid blocks are rejected by the
+    // normal checks with their usual error messages.
+    for (const auto& entry : mapBySeed) {
+        std::vector<bool> vValid;
+        CheckRandomXSolutionsWithSeed(entry.second, Params().GetConsensus(), entry.first, vValid);
+    }
+}
+
+bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL, bool fPoWPreverified=false)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -5392,7 +6487,9 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return state.DoS(100, error("%s: prev block invalid", __func__), REJECT_INVALID, "bad-prevblk");
     }
 
-    if (!CheckBlockHeader(block, state, chainparams, true, pindexPrev))
+    // A header whose PoW was already verified by PreverifyHeadersPoW only
+    // needs the cheap context-free checks here.
+    if (!CheckBlockHeader(block, state, chainparams, !fPoWPreverified, pindexPrev))
         return false;
 
     if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev))
@@ -5409,15 +6506,17 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 
 /**
  * Store block on disk.
- * If dbp is non-NULL, the file is known to already reside on disk.
+ * If dbp is non-NULL, the file is known to already reside on disk, in a
+ * record of nKnownDiskSize bytes.
  *
  * JoinSplit proofs are not verified here; the only
  * caller of AcceptBlock (ProcessNewBlock) later invokes ActivateBestChain,
  * which ultimately calls ConnectBlock in a manner that can verify the proofs.
  */
-static bool AcceptBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp)
+static bool AcceptBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, unsigned int nKnownDiskSize)
 {
     AssertLockHeld(cs_main);
+    assert(dbp == NULL || nKnownDiskSize != 0);
 
     CBlockIndex *pindexDummy = NULL;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
@@ -5465,15 +6564,23 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, const CCha
 
     // Write block to history file
     try {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        // A block that is already on disk keeps the record it was stored
+        // with, compressed or not; only new blocks are serialized (and
+        // compressed) here.
+        std::unique_ptr<CBlockDiskRecord> record;
+        unsigned int nDiskSize = nKnownDiskSize;
+        if (dbp == NULL) {
+            record.reset(new CBlockDiskRecord(block));
+            nDiskSize = record->DiskSize();
+        }
         CDiskBlockPos blockPos;
         if (dbp != NULL)
             blockPos = *dbp;
-        if (!FindBlockPos(state, blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != NULL))
+        if (!FindBlockPos(state, blockPos, nDiskSize, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock(): FindBlockPos failed");
 
         if (dbp == NULL) {
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
+            if (!WriteBlockToDisk(*record, blockPos, chainparams.MessageStart())) {
                 AbortNode(state, "Failed to write block");
             }
         }
@@ -5504,7 +6611,34 @@ static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned
 }
 
 
-bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp)
+/**
+ * Send a block that passed AcceptBlock and extends our tip as a cmpctblock to
+ * the peers that asked for them, before it is connected (BIP 152 high
+ * bandwidth relay). Peers that already have its header are skipped, which
+ * also keeps SendMessages from announcing it to them again. Requires cs_main.
+ */
+static void RelayCompactBlockEarly(const CBlock& block, const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock;
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (pnode->fDisconnect)
+            continue;
+        CNodeState *state = State(pnode->GetId());
+        if (!state || !state->fPreferHeaderAndIDs || PeerHasHeader(state, pindex) || !PeerHasHeader(state, pindex->pprev))
+            continue;
+        if (!pcmpctblock) {
+            pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block);
+            pMostRecentCompactBlock = pcmpctblock;
+        }
+        LogPrint("net", "relaying cmpctblock %s to peer=%d before connecting it\n", pindex->GetBlockHash().ToString(), pnode->id);
+        pnode->PushMessage("cmpctblock", *pcmpctblock);
+        state->pindexBestHeaderSent = pindex;
+    }
+}
+
+bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp, unsigned int nDiskSize)
 {
     auto span = TracingSpan("info", "main", "ProcessNewBlock");
     auto spanGuard = span.Enter();
@@ -5515,10 +6649,29 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, c
 
         // Store to disk
         CBlockIndex *pindex = NULL;
-        bool ret = AcceptBlock(*pblock, state, chainparams, &pindex, fRequested, dbp);
+        bool ret = AcceptBlock(*pblock, state, chainparams, &pindex, fRequested, dbp, nDiskSize);
         if (pindex && pfrom) {
             mapBlockSource[pindex->GetBlockHash()] = pfrom->GetId();
         }
+        // Its header and the context-free block checks have passed, so peers
+        // can start on a block that extends our tip, such as one we just
+        // mined, while we connect it.
+        if (ret && pindex && !dbp && pindex->pprev == chainActive.Tip() &&
+            (pindex->nStatus & BLOCK_HAVE_DATA) && !IsInitialBlockDownload(chainparams.GetConsensus()))
+        {
+            RelayCompactBlockEarly(*pblock, pindex);
+        }
+        // A block that cannot be connected yet is checked in the background
+        // while it waits for its parent. Blocks whose transactions would not
+        // be checked anyway (see ShouldCheckTransactions) are left alone.
+        if (ret && pindex && nBlockPreValidationThreads &&
+            pindex->pprev && pindex->pprev != chainActive.Tip() &&
+            (pindex->nStatus & BLOCK_HAVE_DATA) && !pindex->IsValid(BLOCK_VALID_SCRIPTS) &&
+            ShouldCheckTransactions(chainparams, pindex))
+        {
+            bool fCheckProofs = !(fCheckpointsEnabled && Checkpoints::IsAncestorOfLastCheckpoint(chainparams.Checkpoints(), pindex));
+            QueueBlockPreValidation(*pblock, fCheckProofs);
+        }
         CheckBlockIndex(chainparams.GetConsensus());
         if (!ret)
             return error("%s: AcceptBlock FAILED", __func__);
@@ -5622,6 +6775,7 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMapper.Invalidate(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5734,9 +6888,7 @@ CBlockIndex * InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex(): new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -5745,7 +6897,7 @@ CBlockIndex * InsertBlockIndex(const uint256& hash)
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, chainparams))
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, chainparams, nScriptCheckThreads + 1))
         return false;
 
     // Calculate nChainWork
@@ -5880,7 +7032,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
         if (pindex->pprev)
             pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
-            pindexBestHeader = pindex;
+            SetBestHeader(pindex);
     }
 
     // Load block file info
@@ -5932,6 +7084,10 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have a compact shielded index
+    pblocktree->ReadFlag("shieldedindex", fShieldedIndex);
+    LogPrintf("%s: shielded index %s\n", __func__, fShieldedIndex ? "enabled" : "disabled");
+
     // insightexplorer and lightwalletd
     // Check whether block explorer features are enabled
     bool fInsightExplorer = false;
@@ -5968,6 +7124,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    PublishChainStateSnapshot();
 
     // Juno Cash: Initialize genesis block anchor roots if loading from disk
     // and ensure they exist in the database
@@ -6051,42 +7208,91 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
 
-    // Flags used to permit skipping checks for efficiency
-    auto verifier = ProofVerifier::Disabled(); // No need to verify JoinSplits twice
-    bool fCheckTransactions = true;
-
+    // Levels 0 to 2 look at each block on its own, so they are run on
+    // several threads, which take the blocks from the tip down. Only values
+    // are handed to them, not the block index. Meanwhile this thread does
+    // level 3, which has to disconnect the blocks in turn.
+    struct BlockToCheck {
+        int nHeight;
+        uint256 hash;
+        uint256 hashPrev;
+        CDiskBlockPos blockPos;
+        CDiskBlockPos undoPos;
+        bool fCheckTransactions;
+    };
+    std::vector<BlockToCheck> vToCheck;
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
     {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
-
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-
-        // check level 1: verify block validity
-        fCheckTransactions = ShouldCheckTransactions(chainparams, pindex);
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams, verifier, true, true, fCheckTransactions))
-            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
+        vToCheck.push_back({pindex->nHeight, pindex->GetBlockHash(), pindex->pprev->GetBlockHash(),
+            pindex->GetBlockPos(), pindex->GetUndoPos(), ShouldCheckTransactions(chainparams, pindex)});
+    }
+
+    // The level of the check each block failed, or -1
+    std::vector<int> vFailed(vToCheck.size(), -1);
+    std::atomic<size_t> nNext{0};
+    std::atomic<size_t> nChecked{0};
+    std::atomic<bool> fStop{false};
+    auto checkBlocks = [&]() {
+        auto verifier = ProofVerifier::Disabled(); // No need to verify JoinSplits twice
+        for (size_t i = nNext++; i < vToCheck.size() && !fStop && !ShutdownRequested(); i = nNext++) {
+            const BlockToCheck& check = vToCheck[i];
+            CBlock block;
+            CValidationState stateCheck;
+            if (check.blockPos.IsNull() || !ReadBlockFromDisk(block, check.blockPos, consensusParams) || block.GetHash() != check.hash) {
+                // check level 0: read from disk
+                vFailed[i] = 0;
+            } else if (nCheckLevel >= 1 && !CheckBlock(block, stateCheck, chainparams, verifier, true, true, check.fCheckTransactions)) {
+                // check level 1: verify block validity
+                vFailed[i] = 1;
+            } else if (nCheckLevel >= 2 && !check.undoPos.IsNull()) {
+                // check level 2: verify undo validity
+                CBlockUndo undo;
+                if (!UndoReadFromDisk(undo, check.undoPos, check.hashPrev))
+                    vFailed[i] = 2;
+            }
+            // Blocks nearer the tip are all taken already, so the failure
+            // reported is the same one a serial check would find.
+            if (vFailed[i] >= 0)
+                fStop = true;
+            nChecked++;
         }
+    };
+    auto showProgress = [&]() {
+        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)((double)nChecked / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
+    };
+
+    std::vector<std::future<void>> vWorkers;
+    // Declared after the workers, so that leaving early stops them before
+    // waiting for them.
+    struct StopWorkers {
+        std::atomic<bool>& fStop;
+        ~StopWorkers() { fStop = true; }
+    } stopWorkers{fStop};
+    size_t nWorkers = std::min<size_t>(std::max(nScriptCheckThreads, 1), vToCheck.size());
+    for (size_t i = 0; i < nWorkers; i++) {
+        vWorkers.push_back(std::async(std::launch::async, checkBlocks));
+    }
+
+    // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+    if (nCheckLevel >= 3) {
+        for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev && !fStop; pindex = pindex->pprev)
+        {
+            boost::this_thread::interruption_point();
+            showProgress();
+            if (pindex->nHeight < chainActive.Height()-nCheckDepth ||
+                (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) > nCoinCacheUsage)
+                break;
+            if (ShutdownRequested())
+                return true;
 
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            // insightexplorer: do not update indices (false)
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, chainparams, false);
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, consensusParams))
+                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, chainparams);
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -6098,9 +7304,25 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
                 nGoodTransactions += block.vtx.size();
             }
         }
+    }
 
-        if (ShutdownRequested())
-            return true;
+    for (auto& worker : vWorkers) {
+        while (worker.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            boost::this_thread::interruption_point();
+            showProgress();
+        }
+        worker.get();
+    }
+    if (ShutdownRequested())
+        return true;
+    for (size_t i = 0; i < vToCheck.size(); i++) {
+        const BlockToCheck& check = vToCheck[i];
+        if (vFailed[i] == 0)
+            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", check.nHeight, check.hash.ToString());
+        if (vFailed[i] == 1)
+            return error("VerifyDB(): *** found bad block at %d, hash=%s\n", check.nHeight, check.hash.ToString());
+        if (vFailed[i] == 2)
+            return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", check.nHeight, check.hash.ToString());
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
@@ -6113,7 +7335,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
             pindex = chainActive.Next(pindex);
             CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            if (!ReadBlockFromDisk(block, pindex, consensusParams))
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             if (!ConnectBlock(block, state, pindex, coins, chainparams))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -6125,6 +7347,24 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+bool RewindCoinsView(const CChainParams& chainparams, CCoinsViewCache& view, const CBlockIndex* pindexTarget)
+{
+    AssertLockHeld(cs_main);
+    assert(view.GetBestBlock() == chainActive.Tip()->GetBlockHash());
+    assert(chainActive.Contains(pindexTarget));
+
+    CValidationState state;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex != pindexTarget; pindex = pindex->pprev) {
+        boost::this_thread::interruption_point();
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return error("%s: ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
+        if (DisconnectBlock(block, state, pindex, view, chainparams) != DISCONNECT_OK)
+            return error("%s: failed to disconnect block at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
 bool RegenerateSubtrees(ShieldedType type, const Consensus::Params& consensusParams)
 {
     AssertLockHeld(cs_main);
@@ -6134,9 +7374,6 @@ bool RegenerateSubtrees(ShieldedType type, const Consensus::Params& consensusPar
         return true;
     }
 
-    // Delete all subtrees in pcoinsTip.
-    pcoinsTip->ResetSubtrees(type);
-
     Consensus::UpgradeIndex upgrade;
     if (type == SAPLING) {
         upgrade = Consensus::UPGRADE_SAPLING;
@@ -6152,9 +7389,12 @@ bool RegenerateSubtrees(ShieldedType type, const Consensus::Params& consensusPar
     if (currentHeightMaybe.has_value()) {
         currentHeight = *currentHeightMaybe;
     } else {
+        // Delete all subtrees in pcoinsTip.
+        pcoinsTip->ResetSubtrees(type);
         LogPrintf("RegenerateSubtrees: shielded pool is not active; migration complete\n");
         return true;
     }
+    const int activationHeight = currentHeight;
 
     // The search space ends at the active chain tip.
     int chainHeight = chainActive.Tip()->nHeight;
@@ -6165,178 +7405,235 @@ bool RegenerateSubtrees(ShieldedType type, const Consensus::Params& consensusPar
         // We don't have any blocks to search through.
         // The subtrees will be added naturally as the
         // chain progresses.
+        pcoinsTip->ResetSubtrees(type);
         LogPrintf("RegenerateSubtrees: activation takes place in the future; migration complete\n");
         return true;
     }
 
-    // Vector to accumulate the heights of discovered blocks
-    // that complete subtrees.
-    std::vector<int> vHeights;
-
-    libzcash::SubtreeIndex chainSubtreeIndex;
-    libzcash::SubtreeIndex loggingModulus;
-    size_t percentage = 0;
-
-    {
-        auto lookupCurrentSubtreeIndex = [&] (int nHeight) {
-            auto blockIndex = chainActive[nHeight];
-            assert(blockIndex != nullptr);
-
-            // Because these blocks are connected to the active chain
-            // tip, and because we are inspecting blocks where Sapling/Orchard
-            // are activated, hashFinalSaplingRoot and hashFinalOrchardRoot
-            // are guaranteed to be non-null.
-            if (type == SAPLING) {
-                SaplingMerkleTree latest_frontier;
-                assert(pcoinsTip->GetSaplingAnchorAt(blockIndex->hashFinalSaplingRoot, latest_frontier));
-                return latest_frontier.current_subtree_index();
-            } else if (type == ORCHARD) {
-                OrchardMerkleFrontier latest_frontier;
-                assert(pcoinsTip->GetOrchardAnchorAt(blockIndex->hashFinalOrchardRoot, latest_frontier));
-                return latest_frontier.current_subtree_index();
-            } else {
-                assert(false);
-            }
-        };
-
-        chainSubtreeIndex = lookupCurrentSubtreeIndex(chainHeight);
+    auto lookupCurrentSubtreeIndex = [&] (int nHeight) {
+        auto blockIndex = chainActive[nHeight];
+        assert(blockIndex != nullptr);
 
-        if (chainSubtreeIndex == 0) {
-            // There's nothing to do, because no complete subtrees
-            // exist on chain yet.
-            LogPrintf("RegenerateSubtrees: current subtree is index 0, nothing to do; migration complete\n");
-            return true;
+        // Because these blocks are connected to the active chain
+        // tip, and because we are inspecting blocks where Sapling/Orchard
+        // are activated, hashFinalSaplingRoot and hashFinalOrchardRoot
+        // are guaranteed to be non-null.
+        if (type == SAPLING) {
+            SaplingMerkleTree latest_frontier;
+            assert(pcoinsTip->GetSaplingAnchorAt(blockIndex->hashFinalSaplingRoot, latest_frontier));
+            return latest_frontier.current_subtree_index();
+        } else if (type == ORCHARD) {
+            OrchardMerkleFrontier latest_frontier;
+            assert(pcoinsTip->GetOrchardAnchorAt(blockIndex->hashFinalOrchardRoot, latest_frontier));
+            return latest_frontier.current_subtree_index();
+        } else {
+            assert(false);
         }
+    };
 
-        // We'll report every ~10% of progress made.
-        loggingModulus = chainSubtreeIndex / 10;
+    // We'll grab the final frontier from the previous block (which
+    // should have a hashFinalSaplingRoot/hashFinalOrchardRoot
+    // because this block completed a 2^16 size subtree!) and append
+    // to it until we complete the subtree. Returns std::nullopt if the
+    // block's Orchard bundles could not be appended.
+    auto rebuildSubtree = [&](const CBlock& block, const CBlockIndex* pindex) -> std::optional<libzcash::SubtreeData> {
+        if (type == SAPLING) {
+            SaplingMerkleTree sapling_tree;
+            assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, sapling_tree));
 
-        if (loggingModulus == 0) {
-            loggingModulus = 1;
-        }
+            // Only the commitments up to the subtree boundary belong to
+            // the completed subtree, so append exactly those in one batch.
+            size_t needed = (size_t(1) << libzcash::TRACKED_SUBTREE_HEIGHT) -
+                (sapling_tree.size() % (size_t(1) << libzcash::TRACKED_SUBTREE_HEIGHT));
+            std::vector<libzcash::PedersenHash> commitments;
+            for (const CTransaction &tx : block.vtx) {
+                for (const auto &outputDescription : tx.GetSaplingOutputs()) {
+                    if (commitments.size() == needed) break;
+                    commitments.push_back(uint256::FromRawBytes(outputDescription.cmu()));
+                }
+            }
+            // This block should have completed the subtree.
+            assert(commitments.size() == needed);
+            sapling_tree.append_batch(commitments);
 
-        libzcash::SubtreeIndex subtreeIndex = 0;
-        while (currentHeight <= chainHeight) {
-            if ((subtreeIndex % loggingModulus) == 0) {
-                LogPrintf(
-                    "RegenerateSubtrees: Searching for complete subtrees... %d percent complete (%d / %d)\n",
-                    percentage,
-                    subtreeIndex,
-                    chainSubtreeIndex
-                );
-                percentage += 10;
+            auto completeSubtreeRoot = sapling_tree.complete_subtree_root();
+            assert(completeSubtreeRoot.has_value());
+            return libzcash::SubtreeData(completeSubtreeRoot->ToRawBytes(), pindex->nHeight);
+        } else if (type == ORCHARD) {
+            OrchardMerkleFrontier orchard_tree;
+            assert(pcoinsTip->GetOrchardAnchorAt(pindex->pprev->hashFinalOrchardRoot, orchard_tree));
+            for (const CTransaction &tx : block.vtx) {
+                if (tx.GetOrchardBundle().IsPresent()) {
+                    try {
+                        auto appendResult = orchard_tree.AppendBundle(tx.GetOrchardBundle());
+                        if (appendResult.has_subtree_boundary) {
+                            return libzcash::SubtreeData(appendResult.completed_subtree_root, pindex->nHeight);
+                        }
+                    } catch (const rust::Error& e) {
+                        return std::nullopt;
+                    }
+                }
             }
-            // In this loop we're looking for the completed subtree
-            // with index subtreeIndex (if it exists) somewhere
-            // between currentHeight and chainHeight (inclusive).
-            // We'll first need to find the first block in this
-            // range that has a "current" subtree index one larger,
-            // which implies that block completed the subtree.
 
-            auto searchRange = boost::irange(currentHeight, chainHeight + 1);
+            // Similarly we should not get here.
+            assert(false);
+        } else {
+            assert(false);
+        }
+    };
 
-            auto result = boost::lower_bound(
-                searchRange,
-                subtreeIndex + 1,
-                [&](int a, libzcash::SubtreeIndex b) {
-                    return lookupCurrentSubtreeIndex(a) < b;
-                }
-            );
+    // Subtrees are flushed to disk as they are rebuilt, so a migration that
+    // was interrupted leaves a prefix of the subtrees in the database. If the
+    // latest of them is the subtree that the active chain completed at that
+    // height, the migration resumes after it instead of starting over.
+    libzcash::SubtreeIndex subtreeIndex = 0;
+    bool resumed = false;
+    auto latestSubtree = pcoinsTip->GetLatestSubtree(type);
+    if (latestSubtree.has_value() &&
+        latestSubtree->nHeight > activationHeight &&
+        latestSubtree->nHeight <= chainHeight &&
+        lookupCurrentSubtreeIndex(latestSubtree->nHeight) == latestSubtree->index + 1 &&
+        lookupCurrentSubtreeIndex(latestSubtree->nHeight - 1) == latestSubtree->index)
+    {
+        auto pindex = chainActive[latestSubtree->nHeight];
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
+            LogPrintf("Failed to read block\n");
+            return false;
+        }
+        auto subtree = rebuildSubtree(block, pindex);
+        if (subtree.has_value() && subtree->root == latestSubtree->root) {
+            subtreeIndex = latestSubtree->index + 1;
+            currentHeight = latestSubtree->nHeight + 1;
+            resumed = true;
+            LogPrintf("RegenerateSubtrees: resuming after subtree %d at height %d\n", latestSubtree->index, latestSubtree->nHeight);
+        }
+    }
+    if (!resumed) {
+        // Delete all subtrees in pcoinsTip.
+        pcoinsTip->ResetSubtrees(type);
+    }
 
-            if (result != boost::end(searchRange)) {
-                vHeights.push_back(*result);
+    // Vector to accumulate the heights of discovered blocks
+    // that complete subtrees.
+    std::vector<int> vHeights;
 
-                // Search for the next subtree, starting with the
-                // next block.
-                currentHeight = *result + 1;
-                subtreeIndex += 1;
-            } else {
-                break;
-            }
-        }
+    libzcash::SubtreeIndex chainSubtreeIndex = lookupCurrentSubtreeIndex(chainHeight);
+    libzcash::SubtreeIndex firstSubtreeIndex = subtreeIndex;
+    libzcash::SubtreeIndex loggingModulus;
+    size_t percentage = 0;
+
+    if (chainSubtreeIndex == subtreeIndex) {
+        // There's nothing to do, because no complete subtrees
+        // exist on chain yet, or we already have all of them.
+        LogPrintf("RegenerateSubtrees: current subtree is index %d, nothing to do; migration complete\n", chainSubtreeIndex);
+        return true;
     }
 
-    LogPrintf("RegenerateSubtrees: Found all complete subtrees.\n");
+    // We'll report every ~10% of progress made.
+    loggingModulus = (chainSubtreeIndex - firstSubtreeIndex) / 10;
 
-    percentage = 0;
+    if (loggingModulus == 0) {
+        loggingModulus = 1;
+    }
 
-    for (size_t subtreeIndex = 0; subtreeIndex < vHeights.size(); subtreeIndex++) {
-        if ((subtreeIndex % loggingModulus) == 0) {
+    while (currentHeight <= chainHeight) {
+        if (((subtreeIndex - firstSubtreeIndex) % loggingModulus) == 0) {
             LogPrintf(
-                "RegenerateSubtrees: Rebuilding complete subtrees... %d percent complete (%d / %d)\n",
+                "RegenerateSubtrees: Searching for complete subtrees... %d percent complete (%d / %d)\n",
                 percentage,
                 subtreeIndex,
                 chainSubtreeIndex
             );
             percentage += 10;
         }
+        // In this loop we're looking for the completed subtree
+        // with index subtreeIndex (if it exists) somewhere
+        // between currentHeight and chainHeight (inclusive).
+        // We'll first need to find the first block in this
+        // range that has a "current" subtree index one larger,
+        // which implies that block completed the subtree.
 
-        int nHeight = vHeights[subtreeIndex];
+        auto searchRange = boost::irange(currentHeight, chainHeight + 1);
 
-        auto pindex = chainActive[nHeight];
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
-            LogPrintf("Failed to read block\n");
-            return false;
+        auto result = boost::lower_bound(
+            searchRange,
+            subtreeIndex + 1,
+            [&](int a, libzcash::SubtreeIndex b) {
+                return lookupCurrentSubtreeIndex(a) < b;
+            }
+        );
+
+        if (result != boost::end(searchRange)) {
+            vHeights.push_back(*result);
+
+            // Search for the next subtree, starting with the
+            // next block.
+            currentHeight = *result + 1;
+            subtreeIndex += 1;
+        } else {
+            break;
         }
+    }
 
-        // We'll grab the final frontier from the previous block (which
-        // should have a hashFinalSaplingRoot/hashFinalOrchardRoot
-        // because this block completed a 2^16 size subtree!) and append
-        // to it until we complete the subtree.
-        auto pushSapling = [&]() {
-            SaplingMerkleTree sapling_tree;
-            assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, sapling_tree));
-            for (const CTransaction &tx : block.vtx) {
-                for (const auto &outputDescription : tx.GetSaplingOutputs()) {
-                    sapling_tree.append(uint256::FromRawBytes(outputDescription.cmu()));
+    LogPrintf("RegenerateSubtrees: Found all complete subtrees.\n");
 
-                    auto completeSubtreeRoot = sapling_tree.complete_subtree_root();
-                    if (completeSubtreeRoot.has_value()) {
-                        libzcash::SubtreeData subtree(completeSubtreeRoot->ToRawBytes(), nHeight);
-                        pcoinsTip->PushSubtree(SAPLING, subtree);
-                        return;
-                    }
+    percentage = 0;
+
+    // Reading the blocks dominates the rebuild and needs neither cs_main nor
+    // pcoinsTip, so each batch of blocks is read in parallel before their
+    // subtrees are rebuilt in order. The subtrees are flushed after every
+    // batch so that an interrupted migration can resume from there.
+    const size_t nWorkers = std::max(nScriptCheckThreads, 1);
+    const size_t nBatchSize = nWorkers * 4;
+
+    std::vector<CBlock> vBlocks;
+    for (size_t batchStart = 0; batchStart < vHeights.size(); batchStart += nBatchSize) {
+        size_t batchEnd = std::min(batchStart + nBatchSize, vHeights.size());
+        vBlocks.assign(batchEnd - batchStart, CBlock());
+
+        auto readBlocks = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (!ReadBlockFromDisk(vBlocks[i - batchStart], chainActive[vHeights[i]], consensusParams)) {
+                    return false;
                 }
             }
-
-            // We should not get here; this block should have completed the subtree
-            // and the return statement above should have executed.
-            assert(false);
+            return true;
         };
 
-        auto pushOrchard = [&]() {
-            OrchardMerkleFrontier orchard_tree;
-            assert(pcoinsTip->GetOrchardAnchorAt(pindex->pprev->hashFinalOrchardRoot, orchard_tree));
-            for (const CTransaction &tx : block.vtx) {
-                if (tx.GetOrchardBundle().IsPresent()) {
-                    try {
-                        auto appendResult = orchard_tree.AppendBundle(tx.GetOrchardBundle());
-                        if (appendResult.has_subtree_boundary) {
-                            libzcash::SubtreeData subtree(appendResult.completed_subtree_root, nHeight);
+        size_t nChunk = (batchEnd - batchStart + nWorkers - 1) / nWorkers;
+        std::vector<std::future<bool>> futures;
+        for (size_t begin = batchStart + nChunk; begin < batchEnd; begin += nChunk) {
+            futures.push_back(std::async(std::launch::async, readBlocks, begin, std::min(begin + nChunk, batchEnd)));
+        }
+        bool fRead = readBlocks(batchStart, std::min(batchStart + nChunk, batchEnd));
+        for (auto& future : futures) {
+            fRead = future.get() && fRead;
+        }
+        if (!fRead) {
+            LogPrintf("Failed to read block\n");
+            return false;
+        }
 
-                            pcoinsTip->PushSubtree(ORCHARD, subtree);
-                            return true;
-                        }
-                    } catch (const rust::Error& e) {
-                        return false;
-                    }
-                }
+        for (size_t i = batchStart; i < batchEnd; i++) {
+            if ((i % loggingModulus) == 0) {
+                LogPrintf(
+                    "RegenerateSubtrees: Rebuilding complete subtrees... %d percent complete (%d / %d)\n",
+                    percentage,
+                    firstSubtreeIndex + i,
+                    chainSubtreeIndex
+                );
+                percentage += 10;
             }
 
-            // Similarly we should not get here.
-            assert(false);
-        };
-
-        if (type == SAPLING) {
-            pushSapling();
-        } else if (type == ORCHARD) {
-            if (!pushOrchard()) {
+            auto subtree = rebuildSubtree(vBlocks[i - batchStart], chainActive[vHeights[i]]);
+            if (!subtree.has_value()) {
                 return false;
             }
-        } else {
-            assert(false);
+            pcoinsTip->PushSubtree(type, *subtree);
         }
+
+        FlushStateToDisk();
     }
 
     return true;
@@ -6425,6 +7722,7 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
 
     CValidationState state;
     CBlockIndex* pindex = chainActive.Tip();
+    DisconnectReadAhead readAhead;
     while (chainActive.Height() > lastValidHeight) {
         if (fPruneMode && !(chainActive.Tip()->nStatus & BLOCK_HAVE_DATA)) {
             // If pruning, don't try rewinding past the HAVE_DATA point;
@@ -6434,7 +7732,11 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
             // of the blockchain).
             break;
         }
-        if (!DisconnectTip(state, chainparams, true)) {
+        auto data = readAhead.Take(chainActive.Tip());
+        if (chainActive.Height() - 1 > lastValidHeight) {
+            readAhead.Start(chainActive.Tip()->pprev, chainparams.GetConsensus());
+        }
+        if (!DisconnectTip(state, chainparams, true, data ? &*data : nullptr)) {
             return error("RewindBlockIndex: unable to disconnect block at height %i", pindex->nHeight);
         }
         // Occasionally flush state to disk.
@@ -6478,7 +7780,7 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
 
     // Set pindexBestHeader to the current chain tip
     // (since we are about to delete the block it is pointing to)
-    pindexBestHeader = chainActive.Tip();
+    SetBestHeader(chainActive.Tip());
 
     // Erase block indices on-disk
     if (!pblocktree->EraseBatchSync(vBlocks)) {
@@ -6489,8 +7791,8 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
     for (auto pindex : vBlocks) {
         auto ret = mapBlockIndex.find(*pindex->phashBlock);
         if (ret != mapBlockIndex.end()) {
+            // The object itself is freed with the rest of the arena.
             mapBlockIndex.erase(ret);
-            delete pindex;
         }
     }
 
@@ -6501,7 +7803,7 @@ bool RewindBlockIndex(const CChainParams& chainparams, bool& clearWitnessCaches)
     {
         std::set<CBlockIndex*, CBlockIndexWorkComparator>::reverse_iterator it = setBlockIndexCandidates.rbegin();
         assert(it != setBlockIndexCandidates.rend());
-        pindexBestHeader = *it;
+        SetBestHeader(*it);
     }
 
     CheckBlockIndex(chainparams.GetConsensus());
@@ -6518,11 +7820,12 @@ void UnloadBlockIndex()
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    PublishChainStateSnapshot();
     pindexBestInvalid = NULL;
-    pindexBestHeader = NULL;
+    SetBestHeader(NULL);
     mempool.clear();
-    mapOrphanTransactions.clear();
-    mapOrphanTransactionsByPrev.clear();
+    orphanage.Clear();
+    headerCache.Clear();
     nSyncStarted = 0;
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -6535,12 +7838,12 @@ void UnloadBlockIndex()
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
     mapNodeState.clear();
+    vHeadersSegments.clear();
+    vLinkedHeadersSegments.clear();
     recentRejects.reset(NULL);
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -6567,6 +7870,10 @@ bool InitBlockIndex(const CChainParams& chainparams)
     fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
     pblocktree->WriteFlag("txindex", fTxIndex);
 
+    // Use the provided setting for -shieldedindex in the new database
+    fShieldedIndex = GetBoolArg("-shieldedindex", DEFAULT_SHIELDEDINDEX);
+    pblocktree->WriteFlag("shieldedindex", fShieldedIndex);
+
     // Use the provided setting for -insightexplorer or -lightwalletd in the new database
     pblocktree->WriteFlag("insightexplorer", fExperimentalInsightExplorer);
     pblocktree->WriteFlag("lightwalletd", fExperimentalLightWalletd);
@@ -6586,12 +7893,12 @@ bool InitBlockIndex(const CChainParams& chainparams)
         try {
             CBlock &block = const_cast<CBlock&>(chainparams.GenesisBlock());
             // Start new block file
-            unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+            CBlockDiskRecord record(block);
             CDiskBlockPos blockPos;
             CValidationState state;
-            if (!FindBlockPos(state, blockPos, nBlockSize+8, 0, block.GetBlockTime()))
+            if (!FindBlockPos(state, blockPos, record.DiskSize(), 0, block.GetBlockTime()))
                 return error("LoadBlockIndex(): FindBlockPos failed");
-            if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
+            if (!WriteBlockToDisk(record, blockPos, chainparams.MessageStart()))
                 return error("LoadBlockIndex(): writing genesis block to disk failed");
             CBlockIndex *pindex = AddToBlockIndex(block, chainparams.GetConsensus());
             SetChainPoolValues(chainparams, block, pindex);
@@ -6614,115 +7921,308 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+namespace {
+
+/** A block read from an external block file. */
+struct ExternalBlock
+{
+    CBlock block;
+    //! Where the block starts in the file, and where it ends
+    unsigned int nPos;
+    uint64_t nEnd;
+
+    //! The size of its record, compressed or not, with the message start and size field
+    unsigned int DiskSize() const { return nEnd - nPos + 8; }
+};
+
+/**
+ * Scans a block file for blocks on its own thread, so that reading and
+ * deserializing them overlaps with the validation of the blocks it has
+ * already handed over. Blocks are handed over in chunks of about
+ * IMPORT_CHUNK_SIZE bytes, at most IMPORT_CHUNKS_AHEAD chunks ahead.
+ */
+class CExternalBlockReader
+{
+public:
+    //! Takes over fileIn, which is closed when the scan ends
+    explicit CExternalBlockReader(const CChainParams& chainparams, FILE* fileIn) :
+        m_thread(&CExternalBlockReader::Scan, this, std::cref(chainparams), fileIn) {}
+
+    ~CExternalBlockReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    /** Wait for the next chunk of blocks. Returns false at the end of the file. */
+    bool Next(std::vector<ExternalBlock>& chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_cv.wait_for(lock, std::chrono::milliseconds(100), [&] { return !m_chunks.empty() || m_done; })) {
+            lock.unlock();
+            boost::this_thread::interruption_point();
+            lock.lock();
+        }
+        if (m_chunks.empty()) {
+            return false;
+        }
+        chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_cv.notify_all();
+        return true;
+    }
+
+    /** The I/O error that ended the scan early, if any. */
+    std::string GetError()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::vector<ExternalBlock>> m_chunks;
+    bool m_done = false;
+    bool m_stop = false;
+    std::string m_error;
+    std::thread m_thread;
+
+    bool Push(std::vector<ExternalBlock>& chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return m_chunks.size() < IMPORT_CHUNKS_AHEAD || m_stop; });
+        if (m_stop) {
+            return false;
+        }
+        m_chunks.push_back(std::move(chunk));
+        chunk.clear();
+        m_cv.notify_all();
+        return true;
+    }
+
+    void Scan(const CChainParams& chainparams, FILE* fileIn)
+    {
+        RenameThread("zcash-loadblk-read");
+        try {
+            // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+            CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
+            uint64_t nRewind = blkdat.GetPos();
+            std::vector<ExternalBlock> chunk;
+            std::vector<char> vRecord, vBlock;
+            size_t nChunkSize = 0;
+            while (!blkdat.eof()) {
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                bool fCompressed = false;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    fCompressed = (nSize & BLOCK_COMPRESSED_FLAG) != 0;
+                    nSize &= ~BLOCK_COMPRESSED_FLAG;
+                    if (nSize < (fCompressed ? sizeof(uint32_t) : 80) || nSize > MAX_BLOCK_SIZE)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    break;
+                }
+                try {
+                    // read block
+                    uint64_t nBlockPos = blkdat.GetPos();
+                    blkdat.SetLimit(nBlockPos + nSize);
+                    blkdat.SetPos(nBlockPos);
+                    chunk.emplace_back();
+                    chunk.back().nPos = nBlockPos;
+                    if (fCompressed) {
+                        vRecord.resize(nSize);
+                        blkdat.read(vRecord.data(), nSize);
+                        if (!DecompressBlock(vRecord.data(), vRecord.data() + nSize, MAX_BLOCK_SIZE, vBlock))
+                            throw std::ios_base::failure("cannot decompress block");
+                        CSpanReader reader(SER_DISK, CLIENT_VERSION, vBlock.data(), vBlock.data() + vBlock.size());
+                        reader >> chunk.back().block;
+                    } else {
+                        blkdat >> chunk.back().block;
+                    }
+                    nRewind = blkdat.GetPos();
+                    chunk.back().nEnd = nRewind;
+                    nChunkSize += nSize;
+                } catch (const std::exception& e) {
+                    chunk.pop_back();
+                    LogPrintf("LoadExternalBlockFile: Deserialize or I/O error - %s\n", e.what());
+                }
+                if (nChunkSize >= IMPORT_CHUNK_SIZE) {
+                    if (!Push(chunk))
+                        return;
+                    nChunkSize = 0;
+                }
+            }
+            if (!chunk.empty() && !Push(chunk))
+                return;
+        } catch (const std::runtime_error& e) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+        }
+        m_cv.notify_all();
+    }
+};
+
+/**
+ * Run the context-free checks of a chunk of imported blocks ahead of
+ * AcceptBlock: CheckBlock on several threads, and the proof of work of each
+ * run of consecutive blocks on the header check threads. The outcomes are
+ * cached, in CBlock::fChecked and the PoW cache, and failures are left for
+ * AcceptBlock to find again and report.
+ */
+void PrecheckExternalBlocks(const CChainParams& chainparams, const std::vector<ExternalBlock>& chunk)
+{
+    auto checkRange = [&](size_t nBegin, size_t nEnd) {
+        auto verifier = ProofVerifier::Disabled();
+        for (size_t i = nBegin; i < nEnd; i++) {
+            CValidationState state;
+            CheckBlock(chunk[i].block, state, chainparams, verifier, true, true, true);
+        }
+    };
+    size_t nWorkers = std::min<size_t>(std::max(nScriptCheckThreads, 1), chunk.size());
+    std::vector<std::future<void>> vWorkers;
+    for (size_t i = 1; i < nWorkers; i++) {
+        vWorkers.push_back(std::async(std::launch::async, checkRange,
+            i * chunk.size() / nWorkers, (i + 1) * chunk.size() / nWorkers));
+    }
+
+    // The parent of the first block of a run is in an earlier chunk, which
+    // has been accepted by now, so the seeds of the whole run are known.
+    std::vector<CBlockHeader> run;
+    for (size_t i = 0; i <= chunk.size(); i++) {
+        if (i == chunk.size() || (!run.empty() && chunk[i].block.hashPrevBlock != run.back().GetHash())) {
+            PreverifyHeadersPoW(run, chainparams);
+            run.clear();
+        }
+        if (i < chunk.size()) {
+            run.push_back(chunk[i].block.GetBlockHeader());
+        }
+    }
+
+    checkRange(0, chunk.size() / nWorkers);
+    for (auto& worker : vWorkers) {
+        worker.get();
+    }
+}
+
+} // anon namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    // Map of disk positions and record sizes for blocks with unknown parent (only used for reindex)
+    static std::multimap<uint256, std::pair<CDiskBlockPos, unsigned int>> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
+        // Blocks are read ahead on another thread and checked a chunk at a
+        // time on several, then accepted here in file order.
         size_t initialSize = nSizeReindexed;
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+        CExternalBlockReader reader(chainparams, fileIn);
+        std::vector<ExternalBlock> chunk;
+        bool fStop = false;
+        while (!fStop && reader.Next(chunk)) {
+            PrecheckExternalBlocks(chainparams, chunk);
 
-            if (fReindex)
-               nSizeReindexed = initialSize + nRewind;
+            for (const ExternalBlock& entry : chunk) {
+                boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
+                if (fReindex)
+                    nSizeReindexed = initialSize + entry.nEnd;
+
+                try {
                     if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+                        dbp->nPos = entry.nPos;
+                    const CBlock& block = entry.block;
+
+                    // detect out of order blocks, and store them for later
+                    uint256 hash = block.GetHash();
+                    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+                        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                                block.hashPrevBlock.ToString());
+                        if (dbp)
+                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, std::make_pair(*dbp, entry.DiskSize())));
+                        continue;
+                    }
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(block, state, chainparams, NULL, true, dbp))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+                    // process in case the block isn't known yet
+                    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+                        LOCK(cs_main);
+                        CValidationState state;
+                        if (AcceptBlock(block, state, chainparams, NULL, true, dbp, entry.DiskSize()))
+                            nLoaded++;
+                        if (state.IsError()) {
+                            fStop = true;
+                            break;
+                        }
+                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+                        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                    }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
+                    // Activate the genesis block so normal node progress can continue
+                    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+                        CValidationState state;
+                        if (!ActivateBestChain(state, chainparams)) {
+                            fStop = true;
+                            break;
+                        }
                     }
-                }
 
-                NotifyHeaderTip(chainparams.GetConsensus());
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        if (ReadBlockFromDisk(block, range.first->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &(range.first->second)))
+                    NotifyHeaderTip(chainparams.GetConsensus());
+
+                    // Recursively process earlier encountered successors of this block
+                    deque<uint256> queue;
+                    queue.push_back(hash);
+                    while (!queue.empty()) {
+                        uint256 head = queue.front();
+                        queue.pop_front();
+                        auto range = mapBlocksUnknownParent.equal_range(head);
+                        while (range.first != range.second) {
+                            CBlock child;
+                            if (ReadBlockFromDisk(child, range.first->second.first, chainparams.GetConsensus()))
                             {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
+                                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, child.GetHash().ToString(),
+                                        head.ToString());
+                                LOCK(cs_main);
+                                CValidationState dummy;
+                                if (AcceptBlock(child, dummy, chainparams, NULL, true, &range.first->second.first, range.first->second.second))
+                                {
+                                    nLoaded++;
+                                    queue.push_back(child.GetHash());
+                                }
                             }
+                            range.first = mapBlocksUnknownParent.erase(range.first);
+                            NotifyHeaderTip(chainparams.GetConsensus());
                         }
-                        range.first = mapBlocksUnknownParent.erase(range.first);
-                        NotifyHeaderTip(chainparams.GetConsensus());
                     }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
+        std::string strError = reader.GetError();
+        if (!strError.empty())
+            AbortNode(std::string("System error: ") + strError);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -6961,7 +8461,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
             // validated (we don't care about alternative authorizing data).
             return recentRejects->contains(inv.GetWideHash()) ||
                    mempool.exists(inv.hash) ||
-                   mapOrphanTransactions.count(inv.hash) ||
+                   orphanage.HaveTx(inv.hash) ||
                    pcoinsTip->HaveCoins(inv.hash);
         }
     case MSG_BLOCK:
@@ -6979,160 +8479,205 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
     vector<CInv> vNotFound;
 
-    LOCK(cs_main);
+    // A block to send from disk, and the tip to announce after it.
+    CDiskBlockPos blockPos;
+    uint256 hashBlock;
+    bool fFilteredBlock = false;
+    uint256 hashContinueTip;
 
-    while (it != pfrom->vRecvGetData.end()) {
-        // Don't bother if send buffer is too full to respond anyway
-        if (pfrom->nSendSize >= SendBufferSize())
-            break;
+    {
+        LOCK(cs_main);
 
-        const CInv &inv = *it;
-        {
-            boost::this_thread::interruption_point();
-            it++;
+        while (it != pfrom->vRecvGetData.end()) {
+            // Don't bother if send buffer is too full to respond anyway
+            if (pfrom->nSendSize >= SendBufferSize())
+                break;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            const CInv &inv = *it;
             {
-                bool send = false;
-                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end())
-                {
-                    if (chainActive.Contains(mi->second)) {
-                        send = true;
-                    } else {
-                        static const int nOneMonth = 30 * 24 * 60 * 60;
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a month older (both in time, and in
-                        // best equivalent proof of work) than the best header chain we know about.
-                        send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                            (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
-                            (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, consensusParams) < nOneMonth);
-                        if (!send) {
-                            LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
-                        }
-                    }
-                }
-                // disconnect node in case we have reached the outbound limit for serving historical blocks
-                // never disconnect whitelisted nodes
-                static const int nOneWeek = 7 * 24 * 60 * 60; // assume > 1 week = historical
-                if (send && CNode::OutboundTargetReached(consensusParams.PoWTargetSpacing(currentHeight), true) && (
-                        (
-                            (pindexBestHeader != NULL) &&
-                            (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() > nOneWeek)
-                        ) || inv.type == MSG_FILTERED_BLOCK
-                    ) && !pfrom->fWhitelisted)
-                {
-                    LogPrint("net", "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+                boost::this_thread::interruption_point();
+                it++;
 
-                    //disconnect node
-                    pfrom->fDisconnect = true;
-                    send = false;
-                }
-                // Pruned nodes may have deleted the block, so check whether
-                // it's available before trying to send.
-                if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
+                if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    bool send = false;
+                    BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+                    if (mi != mapBlockIndex.end())
                     {
-                        bool send = false;
-                        CMerkleBlock merkleBlock;
-                        {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                send = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                        if (chainActive.Contains(mi->second)) {
+                            send = true;
+                        } else {
+                            static const int nOneMonth = 30 * 24 * 60 * 60;
+                            // To prevent fingerprinting attacks, only send blocks outside of the active
+                            // chain if they are valid, and no more than a month older (both in time, and in
+                            // best equivalent proof of work) than the best header chain we know about.
+                            send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
+                                (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
+                                (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, consensusParams) < nOneMonth);
+                            if (!send) {
+                                LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
                             }
                         }
-                        if (send) {
-                            pfrom->PushMessage("merkleblock", merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            for (PairType& pair : merkleBlock.vMatchedTxn)
-                                pfrom->PushMessage("tx", block.vtx[pair.first]);
-                        }
-                        // else
-                            // no response
                     }
+                    // disconnect node in case we have reached the outbound limit for serving historical blocks
+                    // never disconnect whitelisted nodes
+                    static const int nOneWeek = 7 * 24 * 60 * 60; // assume > 1 week = historical
+                    if (send && CNode::OutboundTargetReached(consensusParams.PoWTargetSpacing(currentHeight), true) && (
+                            (
+                                (pindexBestHeader != NULL) &&
+                                (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() > nOneWeek)
+                            ) || inv.type == MSG_FILTERED_BLOCK
+                        ) && !pfrom->fWhitelisted)
+                    {
+                        LogPrint("net", "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
 
-                    // Trigger the peer node to send a getblocks request for the next batch of inventory
-                    if (inv.hash == pfrom->hashContinue)
+                        //disconnect node
+                        pfrom->fDisconnect = true;
+                        send = false;
+                    }
+                    // Pruned nodes may have deleted the block, so check whether
+                    // it's available before trying to send.
+                    if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                     {
-                        // Bypass PushBlockInventory, this must send even if redundant,
-                        // and we want it right after the last block so they don't
-                        // wait for other stuff first.
-                        vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
-                        pfrom->PushMessage("inv", vInv);
-                        pfrom->hashContinue.SetNull();
+                        // A compact block is only worth sending for a recent
+                        // block, whose transactions the peer may still have in its
+                        // mempool. Older blocks are sent in full.
+                        if (inv.type == MSG_CMPCT_BLOCK && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                            pfrom->PushMessage("cmpctblock", *GetCompactBlock(mi->second, consensusParams));
+                        } else {
+                            // Full and filtered blocks are read from disk once
+                            // cs_main is released.
+                            blockPos = mi->second->GetBlockPos();
+                            hashBlock = inv.hash;
+                            fFilteredBlock = inv.type == MSG_FILTERED_BLOCK;
+                        }
+
+                        // Trigger the peer node to send a getblocks request for the next batch of inventory
+                        if (inv.hash == pfrom->hashContinue)
+                        {
+                            hashContinueTip = chainActive.Tip()->GetBlockHash();
+                            pfrom->hashContinue.SetNull();
+                        }
                     }
                 }
-            }
-            else if (inv.type == MSG_TX || inv.type == MSG_WTX)
-            {
-                // Send stream from relay memory
-                bool push = false;
-                auto mi = mapRelay.find(inv.hash);
-                if (mi != mapRelay.end() && !IsExpiringSoonTx(*mi->second, currentHeight + 1)) {
-                    // ZIP 239: MSG_TX should be used if and only if the tx is v4 or earlier.
-                    if ((mi->second->nVersion <= 4) != (inv.type == MSG_TX)) {
-                        Misbehaving(pfrom->GetId(), 100);
-                        LogPrint("net", "Wrong INV message type used for v%d tx", mi->second->nVersion);
-                        // Break so that this inv message will be erased from the queue
-                        // (otherwise the peer would repeatedly hit this case until its
-                        // Misbehaving level rises above -banscore, no matter what the
-                        // user set it to).
-                        break;
-                    }
-                    // Ensure we only reply with a transaction if it is exactly what the
-                    // peer requested from us. Otherwise we add it to vNotFound below.
-                    if (inv.hashAux == mi->second->GetAuthDigest()) {
-                        pfrom->PushMessage("tx", *mi->second);
-                        push = true;
-                    }
-                } else if (pfrom->timeLastMempoolReq) {
-                    auto txinfo = mempool.info(inv.hash);
-                    // To protect privacy, do not answer getdata using the mempool when
-                    // that TX couldn't have been INVed in reply to a MEMPOOL request.
-                    if (txinfo.tx && txinfo.nTime <= pfrom->timeLastMempoolReq && !IsExpiringSoonTx(*txinfo.tx, currentHeight + 1)) {
+                else if (inv.type == MSG_TX || inv.type == MSG_WTX)
+                {
+                    // Send stream from relay memory
+                    bool push = false;
+                    auto mi = mapRelay.find(inv.hash);
+                    if (mi != mapRelay.end() && !IsExpiringSoonTx(*mi->second, currentHeight + 1)) {
                         // ZIP 239: MSG_TX should be used if and only if the tx is v4 or earlier.
-                        if ((txinfo.tx->nVersion <= 4) != (inv.type == MSG_TX)) {
+                        if ((mi->second->nVersion <= 4) != (inv.type == MSG_TX)) {
                             Misbehaving(pfrom->GetId(), 100);
-                            LogPrint("net", "Wrong INV message type used for v%d tx", txinfo.tx->nVersion);
-                            // Break so that this inv message will be erased from the queue.
+                            LogPrint("net", "Wrong INV message type used for v%d tx", mi->second->nVersion);
+                            // Break so that this inv message will be erased from the queue
+                            // (otherwise the peer would repeatedly hit this case until its
+                            // Misbehaving level rises above -banscore, no matter what the
+                            // user set it to).
                             break;
                         }
-                        // Ensure we only reply with a transaction if it is exactly what
-                        // the peer requested from us. Otherwise we add it to vNotFound
-                        // below.
-                        if (inv.hashAux == txinfo.tx->GetAuthDigest()) {
-                            pfrom->PushMessage("tx", *txinfo.tx);
+                        // Ensure we only reply with a transaction if it is exactly what the
+                        // peer requested from us. Otherwise we add it to vNotFound below.
+                        if (inv.hashAux == mi->second->GetAuthDigest()) {
+                            pfrom->PushMessage("tx", *mi->second);
                             push = true;
                         }
+                    } else if (pfrom->timeLastMempoolReq) {
+                        auto txinfo = mempool.info(inv.hash);
+                        // To protect privacy, do not answer getdata using the mempool when
+                        // that TX couldn't have been INVed in reply to a MEMPOOL request.
+                        if (txinfo.tx && txinfo.nTime <= pfrom->timeLastMempoolReq && !IsExpiringSoonTx(*txinfo.tx, currentHeight + 1)) {
+                            // ZIP 239: MSG_TX should be used if and only if the tx is v4 or earlier.
+                            if ((txinfo.tx->nVersion <= 4) != (inv.type == MSG_TX)) {
+                                Misbehaving(pfrom->GetId(), 100);
+                                LogPrint("net", "Wrong INV message type used for v%d tx", txinfo.tx->nVersion);
+                                // Break so that this inv message will be erased from the queue.
+                                break;
+                            }
+                            // Ensure we only reply with a transaction if it is exactly what
+                            // the peer requested from us. Otherwise we add it to vNotFound
+                            // below.
+                            if (inv.hashAux == txinfo.tx->GetAuthDigest()) {
+                                pfrom->PushMessage("tx", *txinfo.tx);
+                                push = true;
+                            }
+                        }
+                    }
+                    if (!push) {
+                        vNotFound.push_back(inv);
                     }
                 }
-                if (!push) {
-                    vNotFound.push_back(inv);
-                }
-            }
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
-                break;
+                if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
+                    break;
+            }
         }
     }
 
     pfrom->vRecvGetData.erase(pfrom->vRecvGetData.begin(), it);
 
+    // Reading and sending a block does not need cs_main, so other peers' messages
+    // can be processed meanwhile.
+    if (!blockPos.IsNull()) {
+        // A full block is sent as it is stored, without being deserialized,
+        // and straight from the mapped block file if possible.
+        const char* pbegin;
+        const char* pend;
+        std::shared_ptr<const void> raw;
+        CBlock block;
+        bool fRead;
+        if (!fFilteredBlock) {
+            raw = ReadRawBlockFromDisk(blockPos, pbegin, pend);
+            fRead = raw && GetRawBlockHash(pbegin, pend) == hashBlock;
+            if (raw)
+                pfrom->resourceUsage.AddDiskRead(pend - pbegin);
+        } else {
+            fRead = ReadBlockFromDisk(block, blockPos, consensusParams) && block.GetHash() == hashBlock;
+            pfrom->resourceUsage.AddDiskRead(::GetSerializeSize(block, SER_DISK, CLIENT_VERSION));
+        }
+        if (!fRead) {
+            // The block may have been pruned since cs_main was released.
+            LogPrintf("%s: cannot load block %s from disk, disconnecting peer=%d\n", __func__, hashBlock.ToString(), pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return;
+        } else if (!fFilteredBlock) {
+            pfrom->PushMessageShared("block", raw, pbegin, pend);
+        } else {
+            bool send = false;
+            CMerkleBlock merkleBlock;
+            {
+                LOCK(pfrom->cs_filter);
+                if (pfrom->pfilter) {
+                    send = true;
+                    merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                }
+            }
+            if (send) {
+                pfrom->PushMessage("merkleblock", merkleBlock);
+                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                // This avoids hurting performance by pointlessly requiring a round-trip
+                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                // they must either disconnect and retry or request the full block.
+                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                // however we MUST always provide at least what the remote peer needs
+                typedef std::pair<unsigned int, uint256> PairType;
+                for (PairType& pair : merkleBlock.vMatchedTxn)
+                    pfrom->PushMessage("tx", block.vtx[pair.first]);
+            }
+            // else
+                // no response
+        }
+    }
+
+    if (!hashContinueTip.IsNull()) {
+        // Bypass PushBlockInventory, this must send even if redundant,
+        // and we want it right after the last block so they don't
+        // wait for other stuff first.
+        vector<CInv> vInv;
+        vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+        pfrom->PushMessage("inv", vInv);
+    }
+
     if (!vNotFound.empty()) {
         // Let the peer know that we didn't find what it asked for, so it doesn't
         // have to wait around forever. Currently only SPV clients actually care
@@ -7154,11 +8699,12 @@ void static ProcessOrphanTx(const CChainParams& chainparams, std::set<uint256>&
         const uint256 orphanHash = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
 
-        auto orphan_it = mapOrphanTransactions.find(orphanHash);
-        if (orphan_it == mapOrphanTransactions.end()) continue;
+        const COrphanTx* orphan = orphanage.GetTx(orphanHash);
+        if (!orphan) continue;
 
-        const CTransaction& orphanTx = orphan_it->second.tx;
-        NodeId fromPeer = orphan_it->second.fromPeer;
+        // Copied, as the orphan is erased below.
+        const CTransaction orphanTx = orphan->tx;
+        NodeId fromPeer = orphan->fromPeer;
         bool fMissingInputs2 = false;
         // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
         // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
@@ -7170,15 +8716,8 @@ void static ProcessOrphanTx(const CChainParams& chainparams, std::set<uint256>&
         {
             LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
             RelayTransaction(orphanTx);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
-            EraseOrphanTx(orphanHash);
+            orphanage.AddChildrenToWorkSet(orphanTx, orphan_work_set);
+            orphanage.EraseTx(orphanHash);
             done = true;
         } else if (!fMissingInputs2) {
             int nDos = 0;
@@ -7197,13 +8736,372 @@ void static ProcessOrphanTx(const CChainParams& chainparams, std::set<uint256>&
             // transaction regardless of version.
             assert(recentRejects);
             recentRejects->insert(orphanTx.GetWTxId().ToBytes());
-            EraseOrphanTx(orphanHash);
+            orphanage.EraseTx(orphanHash);
             done = true;
         }
         mempool.check(pcoinsTip);
     }
 }
 
+// Requires cs_main.
+// Note that pfrom can provide the transaction. Outbound and whitelisted peers
+// are asked first.
+static void AddTxAnnouncement(CNode* pfrom, const CInv& inv)
+{
+    bool fPreferred = !pfrom->fInbound || pfrom->fWhitelisted;
+    if (!txrequest.ReceivedInv(pfrom->GetId(), inv, fPreferred, GetTimeMicros()))
+        LogPrint("net", "not tracking announcement of %s peer=%d\n", inv.ToString(), pfrom->id);
+}
+
+/**
+ * Finish accepting a transaction relayed by pfrom once the lock-free checks
+ * of PrecheckTransactionForMempool are done: add it to the mempool, relay it,
+ * keep it as an orphan, or reject it. pstatePrecheck is given if those checks
+ * failed, and pprecheck if they passed.
+ */
+void static ProcessTransactionFromPeer(
+        const CChainParams& chainparams, CNode* pfrom, const CTransaction& tx,
+        const CValidationState* pstatePrecheck, const MempoolPrecheck* pprecheck) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    const uint256& txid = tx.GetHash();
+    const WTxId& wtxid = tx.GetWTxId();
+    CInv invTx(MSG_WTX, txid, wtxid.authDigest);
+
+    pfrom->AddKnownWTxId(wtxid);
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    txrequest.ReceivedResponse(pfrom->GetId(), wtxid);
+
+    bool fAccepted = false;
+    if (pstatePrecheck) {
+        state = *pstatePrecheck;
+    } else if (!AlreadyHave(invTx)) {
+        fAccepted = AcceptToMemoryPool(chainparams, mempool, state, tx, true, &fMissingInputs, false, pprecheck);
+    }
+    if (fAccepted)
+    {
+        mempool.check(pcoinsTip);
+        RelayTransaction(tx);
+        orphanage.AddChildrenToWorkSet(tx, pfrom->orphan_work_set);
+
+        LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom->id, pfrom->cleanSubVer,
+            tx.GetHash().ToString(),
+            mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this one
+        ProcessOrphanTx(chainparams, pfrom->orphan_work_set);
+    }
+    // TODO: currently, prohibit joinsplits and shielded spends/outputs/actions from entering mapOrphans
+    else if (fMissingInputs &&
+             tx.vJoinSplit.empty() &&
+             !tx.GetSaplingBundle().IsPresent() &&
+             !tx.GetOrchardBundle().IsPresent())
+    {
+        bool fRejectedParents = false; // It may be the case that the orphan's parents have all been rejected
+        for (const CTxIn& txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            for (const CTxIn& txin : tx.vin) {
+                CInv inv(MSG_TX, txin.prevout.hash);
+                pfrom->AddKnownTxId(inv.hash);
+                if (!AlreadyHave(inv)) AddTxAnnouncement(pfrom, inv);
+            }
+            orphanage.AddTx(tx, pfrom->GetId());
+
+            // DoS prevention: do not allow the orphanage to grow unbounded.
+            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            size_t nMaxOrphanTxSize = std::max((int64_t)0, GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000;
+            unsigned int nEvicted = orphanage.LimitOrphans(nMaxOrphanTx, nMaxOrphanTxSize);
+            if (nEvicted > 0)
+                LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
+        } else {
+            LogPrint("mempool", "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+        }
+    } else {
+        // Add the wtxid of this transaction to our reject filter.
+        // Unlike upstream Bitcoin Core, we can unconditionally add
+        // these, as they are always bound to the entirety of the
+        // transaction regardless of version.
+        assert(recentRejects);
+        recentRejects->insert(tx.GetWTxId().ToBytes());
+
+        if (pfrom->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
+                RelayTransaction(tx);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s (code %d))\n",
+                    tx.GetHash().ToString(), pfrom->id, state.GetRejectReason(), state.GetRejectCode());
+            }
+        }
+    }
+    // Once we have it, or have rejected it, the other announcers need not be asked
+    if (AlreadyHave(invTx))
+        txrequest.ForgetTx(wtxid);
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint("mempoolrej", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
+            pfrom->id, pfrom->cleanSubVer,
+            FormatStateMessage(state));
+        if (state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
+            pfrom->PushMessage("reject", string("tx"), (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), txid);
+        if (nDoS > 0)
+            Misbehaving(pfrom->GetId(), nDoS);
+    }
+}
+
+// Requires cs_main.
+// Expect the headers after hashStart, at nStartHeight, up to the checkpoint
+// hashEnd at nEndHeight.
+void AddHeadersSegment(int nStartHeight, const uint256& hashStart, int nEndHeight, const uint256& hashEnd)
+{
+    HeadersSegment segment;
+    segment.nStartHeight = nStartHeight;
+    segment.hashStart = hashStart;
+    segment.nEndHeight = nEndHeight;
+    segment.hashEnd = hashEnd;
+    vHeadersSegments.push_back(std::move(segment));
+}
+
+// Requires cs_main.
+// Add a segment for each checkpoint interval above our best header that we
+// don't have yet, as long as the headers buffered for them stay bounded, and
+// drop the segments the main headers sync has caught up with.
+static void UpdateHeadersSegments(const CChainParams& chainparams)
+{
+    vHeadersSegments.erase(std::remove_if(vHeadersSegments.begin(), vHeadersSegments.end(),
+        [](const HeadersSegment& segment) {
+            return mapBlockIndex.count(segment.hashEnd) ||
+                (segment.vHeaders.empty() && segment.nodeid == -1 && mapBlockIndex.count(segment.hashStart));
+        }), vHeadersSegments.end());
+    if (!fCheckpointsEnabled)
+        return;
+
+    const MapCheckpoints& checkpoints = chainparams.Checkpoints().mapCheckpoints;
+    size_t nBuffered = 0;
+    for (const HeadersSegment& segment : vHeadersSegments)
+        nBuffered += segment.nEndHeight - segment.nStartHeight;
+    for (auto it = checkpoints.begin(); it != checkpoints.end() && std::next(it) != checkpoints.end(); ++it) {
+        auto itNext = std::next(it);
+        if (it->first <= pindexBestHeader->nHeight || mapBlockIndex.count(it->second) || mapBlockIndex.count(itNext->second))
+            continue;
+        if (std::any_of(vHeadersSegments.begin(), vHeadersSegments.end(),
+                [&](const HeadersSegment& segment) { return segment.hashStart == it->second; }))
+            continue;
+        size_t nLength = itNext->first - it->first;
+        if (nBuffered + nLength > MAX_HEADERS_SEGMENT_BUFFER)
+            break;
+        AddHeadersSegment(it->first, it->second, itNext->first, itNext->second);
+        nBuffered += nLength;
+    }
+}
+
+// Requires cs_main.
+static void RequestHeadersSegment(CNode* pto, HeadersSegment& segment, int64_t nNow)
+{
+    segment.nodeid = pto->GetId();
+    segment.nRequested = nNow;
+    LogPrint("net", "getheaders (%d) to checkpoint %d to peer=%d\n",
+        segment.nStartHeight + (int)segment.vHeaders.size(), segment.nEndHeight, pto->id);
+    pto->PushMessage("getheaders", CBlockLocator(std::vector<uint256>(1, segment.Tip())), segment.hashEnd);
+}
+
+// Requires cs_main.
+// Continue headers sync from pindex with a segment up to the next checkpoint,
+// so that the headers below it are linked without their RandomX check. Returns
+// false if the headers should be asked for as usual.
+static bool RequestCheckpointedHeaders(CNode* pto, const CBlockIndex* pindex, const CChainParams& chainparams)
+{
+    if (!fIBDSkipHeaderPoW || !fCheckpointsEnabled || !IsInitialBlockDownload(chainparams.GetConsensus()))
+        return false;
+
+    const MapCheckpoints& checkpoints = chainparams.Checkpoints().mapCheckpoints;
+    auto itNext = checkpoints.upper_bound(pindex->nHeight);
+    if (itNext == checkpoints.end() || mapBlockIndex.count(itNext->second))
+        return false;
+    if (std::any_of(vHeadersSegments.begin(), vHeadersSegments.end(),
+            [&](const HeadersSegment& segment) { return segment.hashEnd == itNext->second; }))
+        return false;
+
+    AddHeadersSegment(pindex->nHeight, pindex->GetBlockHash(), itNext->first, itNext->second);
+    RequestHeadersSegment(pto, vHeadersSegments.back(), GetTimeMicros());
+    return true;
+}
+
+// Requires cs_main.
+// Take headers that extend a segment, whichever peer sent them. Returns false
+// if they belong to no segment, in which case they are processed as usual.
+// fContinueSync is set if the peer syncing our headers completed a segment
+// and should be asked for the headers after it.
+bool ProcessHeadersSegment(CNode* pfrom, const std::vector<CBlockHeader>& headers, bool& fContinueSync)
+{
+    fContinueSync = false;
+    if (vHeadersSegments.empty() || headers.empty())
+        return false;
+    const uint256& hashPrev = headers.front().hashPrevBlock;
+    auto it = std::find_if(vHeadersSegments.begin(), vHeadersSegments.end(),
+        [&](const HeadersSegment& segment) { return !segment.IsComplete() && segment.Tip() == hashPrev; });
+    if (it == vHeadersSegments.end()) {
+        if (mapBlockIndex.count(hashPrev))
+            return false;
+        // A late answer to a request that another peer already answered.
+        return std::any_of(vHeadersSegments.begin(), vHeadersSegments.end(),
+            [&](const HeadersSegment& segment) {
+                return std::find(segment.vHashes.begin(), segment.vHashes.end(), hashPrev) != segment.vHashes.end();
+            });
+    }
+
+    HeadersSegment& segment = *it;
+    for (const CBlockHeader& header : headers) {
+        if (header.hashPrevBlock != segment.Tip()) {
+            Misbehaving(pfrom->GetId(), 20);
+            segment.nodeid = -1;
+            LogPrint("net", "non-continuous headers sequence from peer=%d\n", pfrom->id);
+            return true;
+        }
+        segment.vHeaders.push_back(header);
+        segment.vHashes.push_back(header.GetHash());
+        if (segment.IsComplete())
+            break;
+        if (segment.nStartHeight + (int)segment.vHeaders.size() >= segment.nEndHeight) {
+            // The peer is on a chain that misses the checkpoint.
+            Misbehaving(pfrom->GetId(), 20);
+            segment.vHeaders.clear();
+            segment.vHashes.clear();
+            segment.nodeid = -1;
+            LogPrint("net", "headers from peer=%d do not reach checkpoint %d\n", pfrom->id, segment.nEndHeight);
+            return true;
+        }
+    }
+
+    CNodeState *nodestate = State(pfrom->GetId());
+    bool fSyncPeer = nodestate && nodestate->fSyncStarted;
+    if (fSyncPeer)
+        nodestate->nHeadersSyncStarted = GetTimeMicros();
+
+    if (segment.IsComplete()) {
+        LogPrint("net", "received headers up to checkpoint %d from peer=%d\n", segment.nEndHeight, pfrom->id);
+        fContinueSync = fSyncPeer && segment.nodeid == pfrom->GetId();
+        segment.nodeid = -1;
+    } else if (headers.size() == MAX_HEADERS_RESULTS) {
+        RequestHeadersSegment(pfrom, segment, GetTimeMicros());
+    } else if (segment.nodeid == pfrom->GetId()) {
+        // The peer has nothing more; another one will pick up from here.
+        segment.nodeid = -1;
+    }
+    return true;
+}
+
+// Requires cs_main.
+// Where headers sync from pindex should continue: past the segments that were
+// linked ahead of it.
+static CBlockIndex* SkipLinkedHeadersSegments(CBlockIndex* pindex)
+{
+    CBlockIndex* pindexSkip = pindex;
+    for (CBlockIndex* pindexEnd : vLinkedHeadersSegments) {
+        if (pindexEnd->nHeight > pindexSkip->nHeight && pindexEnd->GetAncestor(pindex->nHeight) == pindex)
+            pindexSkip = pindexEnd;
+    }
+    return pindexSkip;
+}
+
+// Link the complete segments that follow headers we already have into the
+// block index, verifying each segment's RandomX solutions in parallel without
+// holding cs_main. A complete segment is hash-linked to the checkpoint that
+// ends it, which already fixes its headers, so with -ibdskipheaderpow only
+// their solutions' targets are checked.
+void LinkHeadersSegments(const CChainParams& chainparams)
+{
+    while (true) {
+        std::vector<CBlockHeader> headers;
+        {
+            LOCK(cs_main);
+            auto it = std::find_if(vHeadersSegments.begin(), vHeadersSegments.end(),
+                [](const HeadersSegment& segment) { return segment.IsComplete() && mapBlockIndex.count(segment.hashStart); });
+            if (it == vHeadersSegments.end())
+                return;
+            headers = std::move(it->vHeaders);
+            vHeadersSegments.erase(it);
+        }
+
+        bool fPoWPreverified = false;
+        if (fIBDSkipHeaderPoW && fCheckpointsEnabled) {
+            // On any failure the headers get the full checks below, which
+            // reject the offending one.
+            fPoWPreverified = std::all_of(headers.begin(), headers.end(), [&](const CBlockHeader& header) {
+                if (header.nSolution.size() != 32)
+                    return false;
+                uint256 randomxHash;
+                memcpy(randomxHash.begin(), header.nSolution.data(), 32);
+                return CheckProofOfWork(randomxHash, header.nBits, chainparams.GetConsensus());
+            });
+            if (fPoWPreverified)
+                nSkippedHeaderPoW += headers.size();
+        }
+        if (!fPoWPreverified)
+            fPoWPreverified = PreverifyHeadersPoW(headers, chainparams);
+
+        LOCK(cs_main);
+        CBlockIndex *pindexLast = NULL;
+        for (const CBlockHeader& header : headers) {
+            CValidationState state;
+            if (!AcceptBlockHeader(header, state, chainparams, &pindexLast, fPoWPreverified)) {
+                LogPrintf("%s: checkpointed header %s rejected: %s\n", __func__, header.GetHash().ToString(), FormatStateMessage(state));
+                pindexLast = NULL;
+                break;
+            }
+        }
+        if (pindexLast) {
+            LogPrint("net", "linked %u headers up to checkpoint %d\n", headers.size(), pindexLast->nHeight);
+            vLinkedHeadersSegments.push_back(pindexLast);
+        }
+        CheckBlockIndex(chainparams.GetConsensus());
+    }
+}
+
+// Process a block a peer sent us, in full or as a reconstructed cmpctblock, and
+// ask the peer to announce new blocks with a cmpctblock if it became our tip.
+void static ProcessBlockFromPeer(const CChainParams& chainparams, CNode* pfrom, const std::string& strCommand, CBlock& block, bool forceProcessing)
+{
+    CValidationState state;
+    ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+        pfrom->PushMessage("reject", strCommand, (unsigned char)state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    } else {
+        LOCK(cs_main);
+        if (chainActive.Tip()->GetBlockHash() == block.GetHash())
+            MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom->GetId());
+    }
+}
+
 bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -7426,6 +9324,67 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         if (pfrom->fNetworkNode) {
             state->fCurrentlyConnected = true;
         }
+
+        // Tell the peer we relay compact blocks (BIP 152, version 1). We only
+        // ask it to announce new blocks with a cmpctblock once it has
+        // given us one.
+        pfrom->PushMessage("sendcmpct", false, uint64_t(1));
+
+        // Ask the peer to announce new blocks with their headers (BIP 130).
+        pfrom->PushMessage("sendheaders");
+
+        // Offer to announce transactions by set reconciliation.
+        bool fRelayTxes;
+        {
+            LOCK(pfrom->cs_filter);
+            fRelayTxes = pfrom->fRelayTxes;
+        }
+        if (fTxReconciliation && fRelayTxes) {
+            state->nTxReconciliationSalt = 1 + GetRand(std::numeric_limits<uint64_t>::max() - 1);
+            pfrom->PushMessage("sendtxrcncl", TXRECONCILIATION_VERSION, state->nTxReconciliationSalt);
+        }
+    }
+
+
+    else if (strCommand == "sendcmpct")
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == 1) {
+            LOCK(cs_main);
+            CNodeState* state = State(pfrom->GetId());
+            state->fProvidesHeaderAndIDs = true;
+            state->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+            // Whitelisted peers, such as our own miners, announce their blocks
+            // to us with a cmpctblock without first having to be among the
+            // peers that gave us the last few blocks.
+            if (pfrom->fWhitelisted)
+                state->fWantHeaderAndIDs = true;
+        }
+    }
+
+
+    else if (strCommand == "sendheaders")
+    {
+        LOCK(cs_main);
+        State(pfrom->GetId())->fPreferHeaders = true;
+    }
+
+
+    else if (strCommand == "sendtxrcncl")
+    {
+        uint32_t nVersion = 0;
+        uint64_t nRemoteSalt = 0;
+        vRecv >> nVersion >> nRemoteSalt;
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        // Only peers that answer our own offer, once, and speak our version.
+        if (state->nTxReconciliationSalt != 0 && !state->txReconciliation && nVersion >= TXRECONCILIATION_VERSION) {
+            state->txReconciliation.emplace(!pfrom->fInbound, state->nTxReconciliationSalt, nRemoteSalt);
+            state->txReconciliation->nNextRound = GetTimeMicros() + TXRECONCILIATION_INTERVAL;
+            LogPrint("net", "peer=%d announces transactions by reconciliation\n", pfrom->id);
+        }
     }
 
 
@@ -7592,7 +9551,7 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                 if (fBlocksOnly)
                     LogPrint("net", "transaction (%s) inv sent in violation of protocol peer=%d\n", inv.hash.ToString(), pfrom->id);
                 else if (!fAlreadyHave && !IsInitialBlockDownload(chainparams.GetConsensus()))
-                    pfrom->AskFor(inv);
+                    AddTxAnnouncement(pfrom, inv);
             }
 
             if (pfrom->nSendSize > (SendBufferSize() * 2)) {
@@ -7702,17 +9661,29 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                 pindex = chainActive.Next(pindex);
         }
 
-        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
-        vector<CBlock> vHeaders;
+        // Serialized as CBlocks, as CBlockHeaders won't include the 0x00 nTx
+        // count at the end, but copied from the header cache
+        std::vector<const CBlockIndex*> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
         LogPrint("net", "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
         for (; pindex; pindex = chainActive.Next(pindex))
         {
-            vHeaders.push_back(pindex->GetBlockHeader());
+            vHeaders.push_back(pindex);
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
                 break;
         }
-        pfrom->PushMessage("headers", vHeaders);
+        CDataStream ssHeaders(SER_NETWORK, PROTOCOL_VERSION);
+        ssHeaders.reserve(5 + vHeaders.size() * (HEADER_CACHE_RECORD_SIZE + 1));
+        WriteCompactSize(ssHeaders, vHeaders.size());
+        for (const CBlockIndex* pheader : vHeaders) {
+            headerCache.Write(ssHeaders, pheader, chainActive.Contains(pheader));
+            ssHeaders << uint8_t(0);
+        }
+        // Later announcements can build on the headers sent here, or on our
+        // tip if the peer already has all of them.
+        CNodeState *nodestate = State(pfrom->GetId());
+        nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
+        pfrom->PushMessage("headers", ssHeaders);
     }
 
 
@@ -7732,110 +9703,42 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         const uint256& txid = tx.GetHash();
         const WTxId& wtxid = tx.GetWTxId();
 
-        LOCK(cs_main);
-
-        pfrom->AddKnownWTxId(wtxid);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        pfrom->setAskFor.erase(wtxid);
-        mapAlreadyAskedFor.erase(wtxid);
-
         // We do the AlreadyHave() check using a MSG_WTX inv unconditionally,
         // because for pre-v5 transactions wtxid.authDigest is set to the same
         // placeholder as is used for the CInv.hashAux field for MSG_TX.
-        if (!AlreadyHave(CInv(MSG_WTX, txid, wtxid.authDigest)) &&
-            AcceptToMemoryPool(chainparams, mempool, state, tx, true, &fMissingInputs))
-        {
-            mempool.check(pcoinsTip);
-            RelayTransaction(tx);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(txid, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
+        CInv invTx(MSG_WTX, txid, wtxid.authDigest);
 
-            LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom->id, pfrom->cleanSubVer,
-                tx.GetHash().ToString(),
-                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(chainparams, pfrom->orphan_work_set);
-        }
-        // TODO: currently, prohibit joinsplits and shielded spends/outputs/actions from entering mapOrphans
-        else if (fMissingInputs &&
-                 tx.vJoinSplit.empty() &&
-                 !tx.GetSaplingBundle().IsPresent() &&
-                 !tx.GetOrchardBundle().IsPresent())
-        {
-            bool fRejectedParents = false; // It may be the case that the orphan's parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                for (const CTxIn& txin : tx.vin) {
-                    CInv inv(MSG_TX, txin.prevout.hash);
-                    pfrom->AddKnownTxId(inv.hash);
-                    if (!AlreadyHave(inv)) pfrom->AskFor(inv);
-                }
-                AddOrphanTx(tx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions and
-                // mapOrphanTransactionsByPrev to grow unbounded.
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0)
-                    LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
-            } else {
-                LogPrint("mempool", "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-            }
-        } else {
-            // Add the wtxid of this transaction to our reject filter.
-            // Unlike upstream Bitcoin Core, we can unconditionally add
-            // these, as they are always bound to the entirety of the
-            // transaction regardless of version.
-            assert(recentRejects);
-            recentRejects->insert(tx.GetWTxId().ToBytes());
-
-            if (pfrom->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->id);
-                    RelayTransaction(tx);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s (code %d))\n",
-                        tx.GetHash().ToString(), pfrom->id, state.GetRejectReason(), state.GetRejectCode());
-                }
-            }
-        }
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
+        // Verify the transaction's proofs and signatures before taking
+        // cs_main for the rest of AcceptToMemoryPool, so that block
+        // validation and other peers are not held up while that happens.
+        int nextBlockHeight;
+        bool fAlreadyHave;
         {
-            LogPrint("mempoolrej", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
-                pfrom->id, pfrom->cleanSubVer,
-                FormatStateMessage(state));
-            if (state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
-                pfrom->PushMessage("reject", strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), txid);
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
+            LOCK(cs_main);
+            nextBlockHeight = chainActive.Height() + 1;
+            fAlreadyHave = AlreadyHave(invTx);
+        }
+        std::shared_ptr<CShieldedAuthCheck> authCheck;
+        bool fDeferAuth = pshieldedBatchVerifier != NULL &&
+            pfrom->vPendingAuthChecks.size() < MAX_PENDING_AUTH_CHECKS_PER_PEER;
+        MempoolPrecheck precheck;
+        CValidationState statePrecheck;
+        bool fPrecheckFailed = !fAlreadyHave &&
+            !PrecheckTransactionForMempool(chainparams, tx, nextBlockHeight, statePrecheck, precheck,
+                                           fDeferAuth ? &authCheck : nullptr);
+
+        // Transactions with Sapling or Orchard proofs are finished in
+        // ProcessMessages once their batch has been verified.
+        if (authCheck) {
+            pshieldedBatchVerifier->Submit(authCheck);
+            pfrom->vPendingAuthChecks.push_back(authCheck);
+            return true;
         }
+
+        LOCK(cs_main);
+        ProcessTransactionFromPeer(chainparams, pfrom, tx,
+                                   fPrecheckFailed ? &statePrecheck : nullptr,
+                                   fAlreadyHave ? nullptr : &precheck);
     }
 
 
@@ -7856,6 +9759,31 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Headers for a checkpointed segment are kept aside until the
+        // headers before them are known.
+        bool fSegment, fContinueSync;
+        {
+            LOCK(cs_main);
+            fSegment = ProcessHeadersSegment(pfrom, headers, fContinueSync);
+        }
+        if (fSegment) {
+            LinkHeadersSegments(chainparams);
+            if (fContinueSync) {
+                LOCK(cs_main);
+                CBlockIndex *pindexContinue = SkipLinkedHeadersSegments(pindexBestHeader);
+                if (!RequestCheckpointedHeaders(pfrom, pindexContinue, chainparams)) {
+                    LogPrint("net", "more getheaders (%d) to send to peer=%d (startheight:%d)\n", pindexContinue->nHeight, pfrom->id, pfrom->nStartingHeight);
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexContinue), uint256());
+                }
+            }
+            NotifyHeaderTip(chainparams.GetConsensus());
+            return true;
+        }
+
+        // Run the RandomX checks for the whole message in parallel before
+        // taking cs_main for the serialized contextual checks.
+        bool fPoWPreverified = PreverifyHeadersPoW(headers, chainparams, &pfrom->resourceUsage);
+
         {
         LOCK(cs_main);
 
@@ -7864,6 +9792,20 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             return true;
         }
 
+        // An announcement that does not connect to our headers means we
+        // missed some blocks; ask for the headers in between rather than
+        // rejecting it, unless the peer keeps doing this.
+        CNodeState *nodestate = State(pfrom->GetId());
+        if (nCount <= MAX_BLOCKS_TO_ANNOUNCE && !mapBlockIndex.count(headers.front().hashPrevBlock)) {
+            if (++nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0)
+                Misbehaving(pfrom->GetId(), 20);
+            LogPrint("net", "received header %s that does not connect, getheaders (%d) to peer=%d\n",
+                headers.front().GetHash().ToString(), pindexBestHeader->nHeight, pfrom->id);
+            pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256());
+            UpdateBlockAvailability(pfrom->GetId(), headers.back().GetHash());
+            return true;
+        }
+
         // If we already know the last header in the message, then it contains
         // no new information for us.  In this case, we do not request
         // more headers later.  This prevents multiple chains of redundant
@@ -7883,7 +9825,7 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
-            if (!AcceptBlockHeader(header, state, chainparams, &pindexLast)) {
+            if (!AcceptBlockHeader(header, state, chainparams, &pindexLast, fPoWPreverified)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
                     if (nDoS > 0)
@@ -7893,61 +9835,338 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             }
         }
 
-        if (pindexLast)
+        if (pindexLast) {
+            nodestate->nUnconnectingHeaders = 0;
             UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
+        }
+
+        // Ask for the blocks of announced headers that beat our tip now,
+        // rather than on the next pass of the block download logic.
+        if (pindexLast && nCount <= MAX_BLOCKS_TO_ANNOUNCE && !pfrom->fClient &&
+            pindexLast->IsValid(BLOCK_VALID_TREE) && chainActive.Tip()->nChainWork <= pindexLast->nChainWork &&
+            !IsInitialBlockDownload(chainparams.GetConsensus())) {
+            std::vector<CBlockIndex*> vToFetch;
+            CBlockIndex *pindexWalk = pindexLast;
+            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_TO_ANNOUNCE) {
+                if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) && !mapBlocksInFlight.count(pindexWalk->GetBlockHash()))
+                    vToFetch.push_back(pindexWalk);
+                pindexWalk = pindexWalk->pprev;
+            }
+            // Leave deeper reorganizations to the block download logic.
+            if (pindexWalk && chainActive.Contains(pindexWalk)) {
+                std::vector<CInv> vGetData;
+                for (CBlockIndex *pindex : reverse_iterate(vToFetch)) {
+                    if (nodestate->nBlocksInFlight >= nodestate->blockDownload.Window())
+                        break;
+                    bool fCompact = nodestate->fProvidesHeaderAndIDs && pindex->pprev == chainActive.Tip();
+                    vGetData.push_back(CInv(fCompact ? MSG_CMPCT_BLOCK : MSG_BLOCK, pindex->GetBlockHash()));
+                    MarkBlockAsInFlight(pfrom->GetId(), pindex->GetBlockHash(), chainparams.GetConsensus(), pindex);
+                    LogPrint("net", "Requesting announced block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
+                        pindex->nHeight, pfrom->id);
+                }
+                if (!vGetData.empty())
+                    pfrom->PushMessage("getdata", vGetData);
+            }
+        }
 
         // Reset header sync timer if we received new headers
         if (hasNewHeaders && pindexLast) {
-            CNodeState *nodestate = State(pfrom->GetId());
             if (nodestate && nodestate->fSyncStarted) {
                 nodestate->nHeadersSyncStarted = GetTimeMicros();
             }
         }
 
+        // Headers we already have because a checkpointed segment was linked
+        // ahead of them are skipped rather than downloaded again.
+        CBlockIndex *pindexContinue = pindexLast ? SkipLinkedHeadersSegments(pindexLast) : NULL;
+
         // Temporary, until we're sure the optimization works
-        if (nCount == MAX_HEADERS_RESULTS && pindexLast && !hasNewHeaders) {
+        if (nCount == MAX_HEADERS_RESULTS && pindexLast && !hasNewHeaders && pindexContinue == pindexLast) {
             LogPrint("net", "NO more getheaders (%d) to send to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
         }
 
-        if (nCount == MAX_HEADERS_RESULTS && pindexLast && hasNewHeaders) {
+        if (nCount == MAX_HEADERS_RESULTS && pindexLast && (hasNewHeaders || pindexContinue != pindexLast)) {
             // Headers message had its maximum size; the peer may have more headers.
             // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
             // from there instead.
-            LogPrint("net", "more getheaders (%d) to send to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->id, pfrom->nStartingHeight);
-            pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexLast), uint256());
+            if (!RequestCheckpointedHeaders(pfrom, pindexContinue, chainparams)) {
+                LogPrint("net", "more getheaders (%d) to send to peer=%d (startheight:%d)\n", pindexContinue->nHeight, pfrom->id, pfrom->nStartingHeight);
+                pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexContinue), uint256());
+            }
         }
 
         CheckBlockIndex(chainparams.GetConsensus());
         }
 
+        // The segment after these headers may now be ready to link.
+        LinkHeadersSegments(chainparams);
+
         NotifyHeaderTip(chainparams.GetConsensus());
     }
 
     else if (strCommand == "block" && !fImporting && !fReindex) // Ignore blocks received while importing
     {
+        size_t nBytes = vRecv.size();
         CBlock block;
         vRecv >> block;
 
         LogPrint("net", "received block %s peer=%d\n", block.GetHash().ToString(), pfrom->id);
 
-        CValidationState state;
+        {
+            LOCK(cs_main);
+            MarkBlockAsDownloaded(pfrom->GetId(), block.GetHash(), nTimeReceived, nBytes);
+        }
+
         // Process all blocks from whitelisted peers, even if not requested,
         // unless we're still syncing with the network.
         // Such an unrequested block may still be processed, subject to the
         // conditions in AcceptBlock().
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload(chainparams.GetConsensus());
-        ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
-            pfrom->PushMessage("reject", strCommand, (unsigned char)state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
+        ProcessBlockFromPeer(chainparams, pfrom, strCommand, block, forceProcessing);
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        const uint256 hash = cmpctblock.header.GetHash();
+        LogPrint("net", "received cmpctblock %s peer=%d\n", hash.ToString(), pfrom->id);
+
+        // As for a headers message, check the PoW before taking cs_main.
+        bool fPoWPreverified = PreverifyHeadersPoW(std::vector<CBlockHeader>(1, cmpctblock.header), chainparams, &pfrom->resourceUsage);
+
+        CBlock block;
+        {
+        LOCK(cs_main);
+
+        if (mapBlockIndex.count(cmpctblock.header.hashPrevBlock) == 0) {
+            // We cannot check the header without its parent, so catch up on
+            // headers as we would for a block announced with an inv.
+            if (!IsInitialBlockDownload(chainparams.GetConsensus()))
+                pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), hash);
+            return true;
+        }
+
+        CBlockIndex *pindex = NULL;
+        CValidationState state;
+        if (!AcceptBlockHeader(cmpctblock.header, state, chainparams, &pindex, fPoWPreverified)) {
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                if (nDoS > 0)
+                    Misbehaving(pfrom->GetId(), nDoS);
+                return error("invalid header received in cmpctblock");
+            }
+            return true;
+        }
+        UpdateBlockAvailability(pfrom->GetId(), hash);
+
+        auto itInFlight = mapBlocksInFlight.find(hash);
+        bool fInFlightFromPeer = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+
+        if ((pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nTx != 0)
+            return true;
+        // Only a block that would become our tip is reconstructed. Any other
+        // block is fetched in full if we asked this peer for it, and by the
+        // normal block download otherwise.
+        if (pindex->nChainWork <= chainActive.Tip()->nChainWork || pindex->nHeight > chainActive.Height() + 2) {
+            if (fInFlightFromPeer)
+                pfrom->PushMessage("getdata", vector<CInv>(1, CInv(MSG_BLOCK, hash)));
+            return true;
+        }
+
+        auto partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+        ReadStatus status = partialBlock->InitData(cmpctblock);
+        if (status == READ_STATUS_INVALID) {
+            if (fInFlightFromPeer)
+                MarkBlockAsReceived(hash);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("invalid cmpctblock received from peer=%d", pfrom->id);
+        }
+
+        std::vector<uint16_t> vMissing;
+        if (status == READ_STATUS_OK) {
+            vMissing = partialBlock->GetMissingIndexes();
+            if (vMissing.empty())
+                status = partialBlock->FillBlock(block, std::vector<CTransaction>());
+        }
+        if (status != READ_STATUS_OK || !vMissing.empty()) {
+            if (!fInFlightFromPeer) {
+                // Leave the block to the peer already sending it.
+                if (itInFlight != mapBlocksInFlight.end() ||
+                    State(pfrom->GetId())->nBlocksInFlight >= State(pfrom->GetId())->blockDownload.Window())
+                    return true;
+                MarkBlockAsInFlight(pfrom->GetId(), hash, chainparams.GetConsensus(), pindex);
+                itInFlight = mapBlocksInFlight.find(hash);
+            }
+            if (status == READ_STATUS_OK) {
+                itInFlight->second.second->partialBlock = partialBlock;
+                BlockTransactionsRequest req;
+                req.blockhash = hash;
+                req.indexes = std::move(vMissing);
+                pfrom->PushMessage("getblocktxn", req);
+            } else {
+                // The short IDs collided, so fetch the full block instead.
+                pfrom->PushMessage("getdata", vector<CInv>(1, CInv(MSG_BLOCK, hash)));
+            }
+            return true;
+        }
+        }
+
+        // The block extends our tip with more work, so it is processed even
+        // if we did not ask for it.
+        ProcessBlockFromPeer(chainparams, pfrom, strCommand, block, true);
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        {
+        LOCK(cs_main);
+
+        BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+        if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "peer=%d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (mi->second->nHeight >= chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, mi->second, chainparams.GetConsensus()))
+                assert(!"cannot load block from disk");
+
+            BlockTransactions resp(req);
+            for (size_t i = 0; i < req.indexes.size(); i++) {
+                if (req.indexes[i] >= block.vtx.size()) {
+                    Misbehaving(pfrom->GetId(), 100);
+                    return error("getblocktxn with out-of-bounds tx indexes from peer=%d", pfrom->id);
+                }
+                resp.txn[i] = block.vtx[req.indexes[i]];
             }
+            pfrom->PushMessage("blocktxn", resp);
+            return true;
+        }
+        }
+
+        // An older block is served in full, subject to the same limits as
+        // a getdata for it.
+        LogPrint("net", "peer=%d sent us a getblocktxn for a block more than %d deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+        pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+        ProcessGetData(pfrom, chainparams.GetConsensus());
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        {
+        LOCK(cs_main);
+
+        auto itInFlight = mapBlocksInFlight.find(resp.blockhash);
+        if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId() ||
+            !itInFlight->second.second->partialBlock) {
+            LogPrint("net", "peer=%d sent us block transactions for a block we weren't expecting\n", pfrom->id);
+            return true;
+        }
+
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;
+        partialBlock.swap(itInFlight->second.second->partialBlock);
+        ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+        if (status == READ_STATUS_INVALID) {
+            MarkBlockAsReceived(resp.blockhash);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("invalid blocktxn received from peer=%d", pfrom->id);
+        } else if (status == READ_STATUS_FAILED) {
+            // A mempool transaction may have collided with a short ID, so
+            // fetch the full block instead. It stays in flight from this peer.
+            pfrom->PushMessage("getdata", vector<CInv>(1, CInv(MSG_BLOCK, resp.blockhash)));
+            return true;
+        }
+        }
+
+        ProcessBlockFromPeer(chainparams, pfrom, strCommand, block, true);
+    }
+
+
+    else if (strCommand == "reqrecon")
+    {
+        uint16_t nRemoteSize = 0;
+        uint16_t q = 0;
+        vRecv >> nRemoteSize >> q;
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        if (!state->txReconciliation || state->txReconciliation->fInitiator) {
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected reqrecon from peer=%d", pfrom->id);
+        }
+        CTxReconciliationState& recon = *state->txReconciliation;
+        recon.StartRound(GetTimeMicros());
+        size_t nCapacity = ComputeSketchCapacity(recon.setRound.size(), nRemoteSize, q);
+        pfrom->PushMessage("sketch", BuildTxReconciliationSketch(recon.setRound, nCapacity));
+    }
+
+
+    else if (strCommand == "sketch")
+    {
+        std::vector<unsigned char> vSketch;
+        vRecv >> vSketch;
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        if (!state->txReconciliation || !state->txReconciliation->fInitiator ||
+            !state->txReconciliation->fRoundInProgress || vSketch.size() > 4 * MAX_SKETCH_CAPACITY) {
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected sketch from peer=%d", pfrom->id);
+        }
+        CTxReconciliationState& recon = *state->txReconciliation;
+        std::vector<CInv> vAnnounce;
+        std::vector<uint32_t> vAsk;
+        if (ReconcileTxSketch(recon.setRound, vSketch, vAnnounce, vAsk)) {
+            LogPrint("net", "reconciled %u transactions with peer=%d, announcing %u and asking for %u\n",
+                recon.setRound.size(), pfrom->id, vAnnounce.size(), vAsk.size());
+            pfrom->PushMessage("reconcildiff", uint8_t(1), vAsk);
+            PushTxInventory(pfrom, vAnnounce);
+            recon.EndRound();
+        } else {
+            // The difference was too large to decode, so both sides flood.
+            LogPrint("net", "reconciliation with peer=%d failed, announcing %u transactions\n",
+                pfrom->id, recon.setRound.size());
+            pfrom->PushMessage("reconcildiff", uint8_t(0), std::vector<uint32_t>());
+            PushTxInventory(pfrom, recon.EndRound());
         }
+    }
 
+
+    else if (strCommand == "reconcildiff")
+    {
+        uint8_t fSuccess = 0;
+        std::vector<uint32_t> vAsk;
+        vRecv >> fSuccess >> vAsk;
+        LOCK(cs_main);
+        CNodeState* state = State(pfrom->GetId());
+        if (!state->txReconciliation || state->txReconciliation->fInitiator ||
+            !state->txReconciliation->fRoundInProgress) {
+            Misbehaving(pfrom->GetId(), 10);
+            return error("unexpected reconcildiff from peer=%d", pfrom->id);
+        }
+        TxReconciliationSet set = state->txReconciliation->EndRound();
+        if (fSuccess) {
+            std::vector<CInv> vInv;
+            for (uint32_t id : vAsk) {
+                auto it = set.find(id);
+                if (it != set.end())
+                    vInv.push_back(it->second);
+            }
+            PushTxInventory(pfrom, vInv);
+        } else {
+            PushTxInventory(pfrom, set);
+        }
     }
 
 
@@ -7966,7 +10185,10 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrKnown);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
@@ -8075,12 +10297,20 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
         vRecv >> alert;
 
         uint256 alertHash = alert.GetHash();
-        if (pfrom->setKnown.count(alertHash) == 0)
+        bool fKnown;
+        {
+            LOCK(cs_mapAlerts);
+            fKnown = pfrom->setKnown.count(alertHash) != 0;
+        }
+        if (!fKnown)
         {
             if (alert.ProcessAlert(chainparams.AlertKey()))
             {
                 // Relay
-                pfrom->setKnown.insert(alertHash);
+                {
+                    LOCK(cs_mapAlerts);
+                    pfrom->setKnown.insert(alertHash);
+                }
                 {
                     LOCK(cs_vNodes);
                     for (CNode* pnode : vNodes)
@@ -8199,11 +10429,20 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
     }
 
     else if (strCommand == "notfound") {
-        // We do not care about the NOTFOUND message, but logging an Unknown Command
-        // message would be undesirable as we transmit it ourselves.
+        // Ask another announcer for the transactions the peer does not have
+        vector<CInv> vInv;
+        vRecv >> vInv;
+        if (vInv.size() <= MAX_INV_SZ) {
+            LOCK(cs_main);
+            for (const CInv& inv : vInv) {
+                if (inv.type == MSG_TX || inv.type == MSG_WTX)
+                    txrequest.ReceivedResponse(pfrom->GetId(), WTxId(inv.hash, inv.hashAux));
+            }
+        }
     }
 
-    else if (!(strCommand == "tx" || strCommand == "block" || strCommand == "headers" || strCommand == "alert")) {
+    else if (!(strCommand == "tx" || strCommand == "block" || strCommand == "headers" || strCommand == "alert" ||
+               strCommand == "cmpctblock" || strCommand == "blocktxn")) {
         // Ignore unknown commands for extensibility
         LogPrint("net", "Unknown command \"%s\" from peer=%d\n", SanitizeString(strCommand), pfrom->id);
     }
@@ -8213,6 +10452,33 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
     return true;
 }
 
+/**
+ * Hash the payloads of the complete, unauthenticated messages that have not
+ * been hashed yet, side by side. A peer relaying transactions usually has
+ * several small messages queued, and their checksums are independent.
+ */
+static void HashMessagePayloads(std::deque<CNetMessage>& vRecvMsg)
+{
+    std::vector<CNetMessage*> vMessages;
+    std::vector<const unsigned char*> vInputs;
+    std::vector<size_t> vLengths;
+    for (CNetMessage& msg : vRecvMsg) {
+        if (!msg.complete()) break;
+        if (msg.fAuthenticated || msg.fHashed) continue;
+        vMessages.push_back(&msg);
+        vInputs.push_back(reinterpret_cast<const unsigned char*>(msg.vRecv.data()));
+        vLengths.push_back(msg.hdr.nMessageSize);
+    }
+    if (vMessages.size() < 2) return;
+
+    std::vector<unsigned char> vHashes(32 * vMessages.size());
+    SHA256DMulti(vHashes.data(), vInputs.data(), vLengths.data(), vMessages.size());
+    for (size_t i = 0; i < vMessages.size(); ++i) {
+        memcpy(vMessages[i]->hashPayload.begin(), vHashes.data() + 32 * i, 32);
+        vMessages[i]->fHashed = true;
+    }
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
 {
@@ -8229,18 +10495,48 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
     //
     bool fOk = true;
 
-    if (!pfrom->vRecvGetData.empty())
+    // The work done for the peer is charged to it, by the command that led to it.
+    if (!pfrom->vRecvGetData.empty()) {
+        int64_t nCpuStart = GetThreadCPUTimeMicros();
         ProcessGetData(pfrom, chainparams.GetConsensus());
+        pfrom->resourceUsage.AddMessage("getdata", GetThreadCPUTimeMicros() - nCpuStart);
+    }
 
     if (!pfrom->orphan_work_set.empty()) {
+        int64_t nCpuStart = GetThreadCPUTimeMicros();
+        {
+            LOCK(cs_main);
+            ProcessOrphanTx(chainparams, pfrom->orphan_work_set);
+        }
+        pfrom->resourceUsage.AddMessage("tx", GetThreadCPUTimeMicros() - nCpuStart);
+    }
+
+    // Finish the transactions whose shielded proofs have been verified, in
+    // the order they were received.
+    if (!pfrom->vPendingAuthChecks.empty() && pfrom->vPendingAuthChecks.front()->IsDone()) {
+        int64_t nCpuStart = GetThreadCPUTimeMicros();
         LOCK(cs_main);
-        ProcessOrphanTx(chainparams, pfrom->orphan_work_set);
+        while (!pfrom->vPendingAuthChecks.empty() && pfrom->vPendingAuthChecks.front()->IsDone()) {
+            std::shared_ptr<CShieldedAuthCheck> check = pfrom->vPendingAuthChecks.front();
+            pfrom->vPendingAuthChecks.pop_front();
+            pfrom->resourceUsage.AddProofChecks(1, check->GetVerifyTime());
+            if (check->IsValid()) {
+                MempoolPrecheck precheck;
+                precheck.consensusBranchId = check->consensusBranchId;
+                ProcessTransactionFromPeer(chainparams, pfrom, check->tx, nullptr, &precheck);
+            } else {
+                ProcessTransactionFromPeer(chainparams, pfrom, check->tx, &check->GetState(), nullptr);
+            }
+        }
+        pfrom->resourceUsage.AddMessage("tx", GetThreadCPUTimeMicros() - nCpuStart);
     }
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
     if (!pfrom->orphan_work_set.empty()) return true;
 
+    HashMessagePayloads(pfrom->vRecvMsg);
+
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
@@ -8259,6 +10555,11 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
         if (!msg.complete())
             break;
 
+        // More transactions may join a batch that is still being verified,
+        // but other messages wait for it so that responses keep their order.
+        if (!pfrom->vPendingAuthChecks.empty() && msg.hdr.GetCommand() != "tx")
+            break;
+
         // at this point, any failure means we can delete the current message
         it++;
 
@@ -8281,20 +10582,25 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
         // Message size
         unsigned int nMessageSize = hdr.nMessageSize;
 
-        // Checksum
+        // Checksum, unless the transport already authenticated the message
         CDataStream& vRecv = msg.vRecv;
-        uint256 hash = Hash(vRecv.begin(), vRecv.begin() + nMessageSize);
-        if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
-        {
-            LogPrintf("%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
-               SanitizeString(strCommand), nMessageSize,
-               HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
-               HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
-            continue;
+        if (!msg.fAuthenticated) {
+            uint256 hash = msg.fHashed ? msg.hashPayload : Hash(vRecv.begin(), vRecv.begin() + nMessageSize);
+            if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+            {
+                LogPrintf("%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
+                   SanitizeString(strCommand), nMessageSize,
+                   HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
+                   HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
+                continue;
+            }
         }
 
+        TRACE3(net, inbound_message, pfrom->id, strCommand.c_str(), nMessageSize);
+
         // Process message
         bool fRet = false;
+        int64_t nCpuStart = GetThreadCPUTimeMicros();
         try
         {
             fRet = ProcessMessage(chainparams, pfrom, strCommand, vRecv, msg.nTime);
@@ -8329,13 +10635,14 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom)
 
         if (!fRet)
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
+        pfrom->resourceUsage.AddMessage(strCommand, GetThreadCPUTimeMicros() - nCpuStart);
 
         break;
     }
 
     // In case the connection got shut down, its receive buffer was wiped
     if (!pfrom->fDisconnect)
-        pfrom->vRecvMsg.erase(pfrom->vRecvMsg.begin(), it);
+        pfrom->EraseProcessedMessages(it);
 
     return fOk;
 }
@@ -8409,9 +10716,15 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            // Other peers' message handlers may be relaying addresses to us.
+            vector<CAddress> vAddrToSend;
+            {
+                LOCK(pto->cs_addrKnown);
+                vAddrToSend.swap(pto->vAddrToSend);
+            }
             vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            for (const CAddress& addr : pto->vAddrToSend)
+            vAddr.reserve(vAddrToSend.size());
+            for (const CAddress& addr : vAddrToSend)
             {
                 if (pto->AddAddressIfNotAlreadyKnown(addr))
                 {
@@ -8424,7 +10737,6 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                     }
                 }
             }
-            pto->vAddrToSend.clear();
             if (!vAddr.empty())
                 pto->PushMessage("addr", vAddr);
         }
@@ -8454,7 +10766,7 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         // during IBD when headers arrive out of order or via different code paths.
         if (pindexBestHeader == NULL ||
             (chainActive.Tip() != NULL && pindexBestHeader->nChainWork < chainActive.Tip()->nChainWork)) {
-            pindexBestHeader = chainActive.Tip();
+            SetBestHeader(chainActive.Tip());
         }
         bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
 
@@ -8496,6 +10808,24 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
             }
         }
 
+        // During initial sync, peers other than the one syncing headers each
+        // download the headers between two checkpoints further ahead.
+        if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex && IsInitialBlockDownload(params)) {
+            UpdateHeadersSegments(Params());
+            int64_t nTimeout = 1000000 * HEADERS_SEGMENT_TIMEOUT;
+            bool fBusy = std::any_of(vHeadersSegments.begin(), vHeadersSegments.end(),
+                [&](const HeadersSegment& segment) { return segment.nodeid == pto->GetId() && segment.nRequested + nTimeout >= nNow; });
+            for (HeadersSegment& segment : vHeadersSegments) {
+                if (fBusy)
+                    break;
+                if (!segment.IsComplete() && (segment.nodeid == -1 || segment.nRequested + nTimeout < nNow) &&
+                    pto->nStartingHeight >= segment.nEndHeight) {
+                    RequestHeadersSegment(pto, segment, nNow);
+                    fBusy = true;
+                }
+            }
+        }
+
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
         // transactions become unconfirmed and spams other nodes.
@@ -8504,6 +10834,14 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
             GetMainSignals().Broadcast(nTimeBestReceived);
         }
 
+        //
+        // Message: sendcmpct
+        //
+        if (state.fProvidesHeaderAndIDs && state.fWantHeaderAndIDs != state.fSentWantHeaderAndIDs) {
+            pto->PushMessage("sendcmpct", state.fWantHeaderAndIDs, uint64_t(1));
+            state.fSentWantHeaderAndIDs = state.fWantHeaderAndIDs;
+        }
+
         //
         // Message: inventory
         //
@@ -8518,6 +10856,44 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
             }
             vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_MAX));
 
+            // A peer that asked for compact block announcements is sent a new
+            // tip extending a block it has as a cmpctblock, which it can
+            // usually rebuild from its mempool without another round trip.
+            const CBlockIndex* pindexTip = chainActive.Tip();
+            if (state.fPreferHeaderAndIDs && pto->vInventoryBlockToSend.size() == 1 &&
+                pto->vInventoryBlockToSend.back() == pindexTip->GetBlockHash() &&
+                pindexTip->pprev != NULL && state.pindexBestKnownBlock != NULL &&
+                state.pindexBestKnownBlock->GetAncestor(pindexTip->pprev->nHeight) == pindexTip->pprev) {
+                // It may have gone out already, before it was connected.
+                if (state.pindexBestHeaderSent != pindexTip)
+                    pto->PushMessage("cmpctblock", *GetCompactBlock(pindexTip, params));
+                state.pindexBestHeaderSent = pindexTip;
+                pto->vInventoryBlockToSend.clear();
+            }
+
+            // A peer that asked for header announcements (BIP 130) is sent
+            // the headers from the last one it has up to our new tip, so it
+            // can check their PoW and ask for the blocks in one round trip.
+            if (state.fPreferHeaders && !pto->vInventoryBlockToSend.empty() &&
+                pto->vInventoryBlockToSend.back() == pindexTip->GetBlockHash()) {
+                std::vector<const CBlockIndex*> vAnnounce;
+                const CBlockIndex* pindex = pindexTip;
+                while (pindex && !PeerHasHeader(&state, pindex) && vAnnounce.size() <= MAX_BLOCKS_TO_ANNOUNCE) {
+                    vAnnounce.push_back(pindex);
+                    pindex = pindex->pprev;
+                }
+                if (pindex && vAnnounce.size() <= MAX_BLOCKS_TO_ANNOUNCE) {
+                    // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
+                    vector<CBlock> vHeaders;
+                    for (const CBlockIndex* pindexAnnounce : reverse_iterate(vAnnounce))
+                        vHeaders.push_back(pindexAnnounce->GetBlockHeader());
+                    if (!vHeaders.empty())
+                        pto->PushMessage("headers", vHeaders);
+                    state.pindexBestHeaderSent = pindexTip;
+                    pto->vInventoryBlockToSend.clear();
+                }
+            }
+
             // Add blocks
             for (const uint256& hash : pto->vInventoryBlockToSend) {
                 vInv.push_back(CInv(MSG_BLOCK, hash));
@@ -8613,8 +10989,9 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                     if (inv.type == MSG_WTX) assert(pto->nVersion >= CINV_WTX_VERSION);
                     if (IsExpiringSoonTx(*txinfo.tx, currentHeight + 1)) continue;
                     if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
-                    // Send
-                    vInv.push_back(inv);
+                    // Send, or leave for the next reconciliation with the peer
+                    if (!state.txReconciliation || !state.txReconciliation->Add(inv))
+                        vInv.push_back(inv);
                     nRelayedTransactions++;
                     {
                         // Expire old relay messages
@@ -8640,6 +11017,24 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         if (!vInv.empty())
             pto->PushMessage("inv", vInv);
 
+        //
+        // Message: reqrecon
+        //
+        if (!pto->fDisconnect && state.txReconciliation) {
+            CTxReconciliationState& recon = *state.txReconciliation;
+            if (recon.fRoundInProgress && recon.nRoundStarted + TXRECONCILIATION_TIMEOUT < nNow) {
+                LogPrint("net", "reconciliation with peer=%d timed out, announcing %u transactions\n",
+                    pto->id, recon.setRound.size());
+                PushTxInventory(pto, recon.EndRound());
+            }
+            if (recon.fInitiator && !recon.fRoundInProgress && recon.nNextRound < nNow) {
+                recon.StartRound(nNow);
+                recon.nNextRound = nNow + TXRECONCILIATION_INTERVAL;
+                pto->PushMessage("reqrecon", uint16_t(std::min<size_t>(recon.setRound.size(), std::numeric_limits<uint16_t>::max())),
+                    DEFAULT_TXRECONCILIATION_Q);
+            }
+        }
+
         // Detect whether we're stalling
         nNow = GetTimeMicros();
         if (!pto->fDisconnect && state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
@@ -8671,17 +11066,40 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
                 pto->fDisconnect = true;
             }
         }
+        // Rather than wait for the timeout, hand a block this peer is taking
+        // much longer than usual to deliver to another peer that has it, and
+        // leave this one fewer blocks to work on.
+        if (!pto->fDisconnect && state.vBlocksInFlight.size() > 0) {
+            const QueuedBlock &queuedBlock = state.vBlocksInFlight.front();
+            if (queuedBlock.pindex && !queuedBlock.partialBlock &&
+                state.blockDownload.IsOverdue(queuedBlock.nTime, nNow) &&
+                OtherPeerCanProvideBlock(pto->GetId(), queuedBlock.pindex, nNow))
+            {
+                LogPrint("net", "Reassigning block %s (%d) from slow peer=%d after %dms\n", queuedBlock.hash.ToString(),
+                    queuedBlock.pindex->nHeight, pto->id, (nNow - queuedBlock.nTime) / 1000);
+                state.blockDownload.BlockReassigned(queuedBlock.nTime, nNow);
+                uint256 hash = queuedBlock.hash;
+                MarkBlockAsReceived(hash);
+            }
+        }
 
         //
         // Message: getdata (blocks)
         //
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload(params)) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        int nBlockDownloadWindow = state.blockDownload.Window();
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload(params)) &&
+            state.nBlocksInFlight < nBlockDownloadWindow && !state.blockDownload.IsPaused(nNow)) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            FindNextBlocksToDownload(pto->GetId(), nBlockDownloadWindow - state.nBlocksInFlight, vToDownload, staller);
             for (CBlockIndex *pindex : vToDownload) {
-                vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+                // The block after our tip is asked for as a cmpctblock when
+                // the peer relays them, as we likely have most of its
+                // transactions in our mempool already.
+                bool fCompact = state.fProvidesHeaderAndIDs && pindex->pprev == chainActive.Tip() &&
+                    !IsInitialBlockDownload(params);
+                vGetData.push_back(CInv(fCompact ? MSG_CMPCT_BLOCK : MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), params, pindex);
                 LogPrint("net", "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->id);
@@ -8697,24 +11115,23 @@ bool SendMessages(const Consensus::Params& params, CNode* pto)
         //
         // Message: getdata (non-blocks)
         //
-        while (!pto->fDisconnect && !pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
-        {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
-            if (!AlreadyHave(inv))
-            {
-                if (fDebug)
-                    LogPrint("net", "Requesting %s peer=%d\n", inv.ToString(), pto->id);
-                vGetData.push_back(inv);
-                if (vGetData.size() >= 1000)
+        if (!pto->fDisconnect) {
+            for (const CInv& inv : txrequest.GetRequestable(pto->GetId(), nNow)) {
+                if (!AlreadyHave(inv))
                 {
-                    pto->PushMessage("getdata", vGetData);
-                    vGetData.clear();
+                    if (fDebug)
+                        LogPrint("net", "Requesting %s peer=%d\n", inv.ToString(), pto->id);
+                    vGetData.push_back(inv);
+                    if (vGetData.size() >= 1000)
+                    {
+                        pto->PushMessage("getdata", vGetData);
+                        vGetData.clear();
+                    }
+                } else {
+                    //If we're not going to ask, don't expect a response.
+                    txrequest.ForgetTx(WTxId(inv.hash, inv.hashAux));
                 }
-            } else {
-                //If we're not going to ask, don't expect a response.
-                pto->setAskFor.erase(WTxId(inv.hash, inv.hashAux));
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
         if (!vGetData.empty())
             pto->PushMessage("getdata", vGetData);
@@ -8741,8 +11158,7 @@ public:
         mapBlockIndex.clear();
 
         // orphan transactions
-        mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
+        orphanage.Clear();
     }
 } instance_of_cmaincleanup;
 
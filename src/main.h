@@ -17,6 +17,7 @@
 #include "coins.h"
 #include "consensus/upgrades.h"
 #include "fs.h"
+#include "headercache.h"
 #include "net.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
@@ -34,8 +35,10 @@
 #include "timestampindex.h"
 
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdint.h>
@@ -50,10 +53,13 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CInv;
 class CScriptCheck;
+class CShieldedAuthCheck;
+class CShieldedBatchVerifier;
 class CValidationInterface;
 class CValidationState;
 class PrecomputedTransactionData;
@@ -80,10 +86,10 @@ static const CAmount HIGH_MAX_TX_FEE = 100 * HIGH_TX_FEE_PER_KB;
 static const unsigned int LOW_LOGICAL_ACTIONS = 10;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
-/** Expiration time for orphan transactions in seconds */
-static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
-/** Minimum time between orphan transactions expire time checks in seconds */
-static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** Default for -maxorphantxsize, maximum total size in kilobytes of orphan transactions kept in memory */
+static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 5000;
+/** The most transactions from one peer that may wait for their proofs to be batch-verified */
+static const unsigned int MAX_PENDING_AUTH_CHECKS_PER_PEER = 100;
 /** Default for -limitancestorcount, max number of in-mempool ancestors */
 static const unsigned int DEFAULT_ANCESTOR_LIMIT = 100;
 /** Default for -limitancestorsize, maximum kilobytes of tx + all in-mempool ancestors */
@@ -103,20 +109,48 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Bytes of blocks read ahead of validation at a time when importing a block file */
+static const unsigned int IMPORT_CHUNK_SIZE = 0x1000000; // 16 MiB
+/** Number of chunks read ahead of validation when importing a block file */
+static const unsigned int IMPORT_CHUNKS_AHEAD = 2;
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
-static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Minimum number of shielded transactions per thread when checking a block's shielded signatures in parallel */
+static const size_t SHIELDED_SIGHASH_MIN_PER_WORKER = 4;
+/** Maximum number of RandomX header-checking threads allowed */
+static const int MAX_HEADERCHECK_THREADS = 64;
+/** -parheaders default (number of RandomX header-checking threads, 0 = auto) */
+static const int DEFAULT_HEADERCHECK_THREADS = 0;
+/** Maximum number of block pre-validation threads allowed */
+static const int MAX_BLOCK_PREVALIDATION_THREADS = 16;
+/** -parblocks default (number of threads checking blocks received ahead of their parent, 0 = auto) */
+static const int DEFAULT_BLOCK_PREVALIDATION_THREADS = 0;
+/** -backgroundflush default: write the coins cache to disk on a background thread */
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+/** Maximum number of blocks waiting for pre-validation; further blocks are checked when connected */
+static const size_t MAX_BLOCK_PREVALIDATION_QUEUE = 64;
+/** Maximum number of pre-validated blocks remembered until they are connected */
+static const size_t MAX_BLOCKS_PREVALIDATED = 1024;
+/** Blocks must be buried under this much equivalent work (in seconds) for -assumevalid to skip their verification */
+static const int64_t ASSUMEVALID_MIN_BURIED_TIME = 60 * 60 * 24 * 14;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Timeout in seconds during which header sync can stall before allowing other peers to sync. */
 static const unsigned int HEADERS_SYNC_STALL_TIMEOUT = 10;
+/** Time in seconds a peer has to answer a getheaders for the headers between two checkpoints before another peer is asked. */
+static const unsigned int HEADERS_SEGMENT_TIMEOUT = 30;
+/** Most headers between checkpoints ahead of our best header that are downloaded and held before being linked. */
+static const size_t MAX_HEADERS_SEGMENT_BUFFER = 200000;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 160;
+/** Most new blocks announced to a peer with a headers message (BIP 130) rather than an inv. */
+static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
+/** Announced headers that do not connect to ours a peer may send in a row before it is penalized. */
+static const int MAX_UNCONNECTING_HEADERS = 10;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
@@ -126,6 +160,8 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** When the coins cache outgrows its limit, it is trimmed to this percentage of the limit after being written */
+static const unsigned int COINS_CACHE_EVICT_TARGET_PERCENT = 50;
 /** Time to wait (in seconds) between writing wallet witness data to disk. */
 static const unsigned int WITNESS_WRITE_INTERVAL = 10 * 60;
 /** Number of updates between writing wallet witness data to disk. */
@@ -149,7 +185,11 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_IBD_SKIP_TX_VERIFICATION = false;
+static const bool DEFAULT_IBD_SKIP_HEADER_POW = false;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_SHIELDEDINDEX = false;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -nurejectoldversions */
@@ -192,7 +232,14 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern int nHeaderCheckThreads;
+extern int nBlockPreValidationThreads;
+/** Block whose ancestors skip script and proof verification (-assumevalid), null if none */
+extern uint256 hashAssumeValid;
+extern bool fBackgroundFlush;
 extern bool fTxIndex;
+/** Whether the compact shielded index read by wallet rescans is maintained */
+extern bool fShieldedIndex;
 
 // The following flags enable specific indices (DB tables), but are not exposed as
 // separate command-line options; instead they are enabled by experimental feature "-insightexplorer"
@@ -212,9 +259,13 @@ extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern bool fIBDSkipTxVerification;
+/** Whether headers hash-linked to a checkpoint skip their RandomX check (-ibdskipheaderpow) */
+extern bool fIBDSkipHeaderPoW;
 // TODO: remove this flag by structuring our code such that
 // it is unneeded for testing
 extern bool fCoinbaseEnforcedShieldingEnabled;
+/** Whether to announce transactions by set reconciliation to peers that support it (-txreconciliation) */
+extern bool fTxReconciliation;
 extern size_t nCoinCacheUsage;
 /** Transactions must have at least this fee rate (in zatoshis per 1000 bytes) for relaying, mining and transaction creation. */
 extern CFeeRate minRelayTxFee;
@@ -276,9 +327,10 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
  * @param[in]   pblock  The block we want to process.
  * @param[in]   fForceProcessing Process this block even if unrequested; used for non-network block sources and whitelisted peers.
  * @param[out]  dbp     The already known disk position of pblock, or NULL if not yet stored.
+ * @param[in]   nDiskSize The size of the record at dbp as stored, including its message start and size field.
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp);
+bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp, unsigned int nDiskSize = 0);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -287,6 +339,20 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
+/** Keep up to nFiles block files memory-mapped for reading blocks; 0 disables mapping */
+void SetMappedBlockFiles(unsigned int nFiles);
+/** Write new blocks compressed at zstd level nLevel; 0 writes them uncompressed */
+void SetBlockCompression(int nLevel);
+/** Queue new block and undo records for a background thread to write, or stop doing so after writing what is queued */
+void SetBlockWriteBehind(bool fEnable);
+/**
+ * Read the serialized block at pos without deserializing it, from its mapped
+ * block file if possible. The returned buffer must be held for as long as
+ * [pbegin, pend) is used; nullptr means the block could not be read.
+ */
+std::shared_ptr<const void> ReadRawBlockFromDisk(const CDiskBlockPos& pos, const char*& pbegin, const char*& pend);
+/** The hash of the serialized block in [pbegin, pend), of which only the header is read. */
+uint256 GetRawBlockHash(const char* pbegin, const char* pend);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
 /** Initialize a new block tree database + block data on disk */
@@ -306,6 +372,16 @@ bool ProcessMessages(const CChainParams& chainparams, CNode* pfrom);
 bool SendMessages(const Consensus::Params& params, CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the RandomX header checking thread */
+void ThreadHeaderCheck();
+/**
+ * The number of header checking threads for -parheaders=nRequested on a
+ * machine with nCores cores: 0 means all of them and less than 0 that many
+ * fewer. A single thread means none, as the caller then does the work.
+ */
+int ClampHeaderCheckThreads(int64_t nRequested, int nCores);
+/** Run an instance of the block pre-validation thread */
+void ThreadBlockPreValidation();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload(const Consensus::Params& params);
 /** testing-only, set or reset initial block down (IBD) state, return previous */
@@ -351,11 +427,46 @@ void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
-/** (try to) add transaction to memory pool **/
+/**
+ * Records that a transaction passed the checks AcceptToMemoryPool can do
+ * without any locks held: the context-free checks and the verification of
+ * its Sprout, Sapling and Orchard proofs and signatures against
+ * consensusBranchId.
+ */
+struct MempoolPrecheck {
+    uint32_t consensusBranchId = 0;
+};
+
+/**
+ * Run the lock-free part of AcceptToMemoryPool for a transaction that would
+ * be mined at nextBlockHeight. This needs neither cs_main nor the mempool
+ * lock, so it can run for several incoming transactions at once.
+ *
+ * If pauthCheck is given and the transaction has Sapling or Orchard bundles,
+ * their authorization is not verified here. It is returned in *pauthCheck
+ * instead, to be verified by a CShieldedBatchVerifier, and precheck is only
+ * valid once that check has passed.
+ */
+bool PrecheckTransactionForMempool(
+        const CChainParams& chainparams, const CTransaction& tx, int nextBlockHeight,
+        CValidationState& state, MempoolPrecheck& precheck,
+        std::shared_ptr<CShieldedAuthCheck>* pauthCheck=nullptr);
+
+/**
+ * (try to) add transaction to memory pool. If pprecheck is given and was
+ * made against the current consensus branch, the proofs and signatures are
+ * not verified again.
+ **/
 bool AcceptToMemoryPool(
         const CChainParams& chainparams,
         CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-        bool* pfMissingInputs, bool fRejectAbsurdFee=false);
+        bool* pfMissingInputs, bool fRejectAbsurdFee=false, const MempoolPrecheck* pprecheck=nullptr);
+
+/** Load the mempool saved by DumpMempool, validating each transaction again. */
+bool LoadMempool(const CChainParams& chainparams);
+
+/** Save the mempool and its fee deltas to mempool.dat in the data directory. */
+bool DumpMempool();
 
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
@@ -365,6 +476,14 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlockDownloadWindow;
+    int64_t nBlockLatency;
+    int64_t nBlockTime;
+    double dBlockBytesPerSecond;
+    int64_t nBlocksReassigned;
+    bool fTxReconciliation;
+    size_t nTxInFlight;
+    size_t nTxAnnounced;
 };
 
 
@@ -538,19 +657,84 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/** Maximum number of same-seed headers hashed together by one CRandomXHeaderCheck */
+static const size_t RANDOMX_HEADER_CHECK_BATCH = 8;
+
+/**
+ * Closure representing the RandomX proof-of-work checks of a few block
+ * headers that share an already-resolved seed hash. This lets the expensive
+ * hashes run on a CCheckQueue worker without holding cs_main, pipelined
+ * through one VM.
+ */
+class CRandomXHeaderCheck
+{
+private:
+    std::vector<const CBlockHeader*> headers;
+    uint256 seedHash;
+    const Consensus::Params *pparams;
+    //! If set, the CPU time (in microseconds) the check takes is added to it.
+    std::atomic<int64_t> *pnCpuTime;
+
+public:
+    CRandomXHeaderCheck(): pparams(nullptr), pnCpuTime(nullptr) {}
+    CRandomXHeaderCheck(const uint256& seedHashIn, const Consensus::Params& paramsIn, std::atomic<int64_t> *pnCpuTimeIn = nullptr) :
+        seedHash(seedHashIn), pparams(&paramsIn), pnCpuTime(pnCpuTimeIn) { }
+
+    void Add(const CBlockHeader& header) { headers.push_back(&header); }
+    size_t Size() const { return headers.size(); }
+
+    bool operator()();
+
+    const uint256& GetSeedHash() const { return seedHash; }
+
+    void swap(CRandomXHeaderCheck &check) {
+        headers.swap(check.headers);
+        std::swap(seedHash, check.seedHash);
+        std::swap(pparams, check.pparams);
+        std::swap(pnCpuTime, check.pnCpuTime);
+    }
+};
+
+/**
+ * Verify the RandomX solutions of blocks received over RPC (submitblock,
+ * getblocktemplate proposals) before cs_main is taken, so that concurrent
+ * submissions hash in parallel. Results go to the solution cache, which then
+ * answers the checks made while processing the blocks; blocks whose previous
+ * block is unknown are skipped.
+ */
+void PreverifyBlocksPoW(const std::vector<const CBlockHeader*>& blocks);
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(const uint160& addressHash, int type,
         std::vector<CAddressIndexDbEntry> &addressIndex,
         int start = 0, int end = 0);
 bool GetAddressUnspent(const uint160& addressHash, int type,
         std::vector<CAddressUnspentDbEntry>& unspentOutputs);
+bool GetAddressSummary(const uint160& addressHash, int type, CAddressSummary& summary);
 bool GetTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
     std::vector<std::pair<uint256, unsigned int> > &hashes);
 
+/**
+ * A block serialized the way it is written to a block file, compressed if
+ * -blockcompression is set and that makes it smaller.
+ */
+struct CBlockDiskRecord
+{
+    std::vector<char> data;
+    //! The size field written ahead of data
+    uint32_t nSizeField;
+
+    explicit CBlockDiskRecord(const CBlock& block);
+
+    //! The space the record takes up in a block file, header included
+    unsigned int DiskSize() const { return data.size() + 8; }
+};
+
 /** Functions for disk access for blocks */
-bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool WriteBlockToDisk(const CBlockDiskRecord& record, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -635,6 +819,12 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/**
+ * Disconnect the blocks of the active chain above pindexTarget from a view
+ * of the chain tip, using their undo data. Nothing is written to disk.
+ */
+bool RewindCoinsView(const CChainParams& chainparams, CCoinsViewCache& view, const CBlockIndex* pindexTarget);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
@@ -655,9 +845,62 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * The active chain and the parts of the chain state that read-only RPCs
+ * report, as of the last change of tip. A new one is published, with cs_main
+ * held, whenever chainActive's tip changes.
+ */
+class CChainStateSnapshot : public CChainSnapshot
+{
+public:
+    bool fInitialDownload;
+    //! The number of Sprout note commitments as of the tip.
+    uint64_t nSproutCommitments;
+    //! The bytes taken by block and undo files.
+    uint64_t nSizeOnDisk;
+    //! The lowest height whose block data is still stored, if pruning.
+    int nPruneHeight;
+
+    CChainStateSnapshot(const CChain& chain, const CChainSnapshot* prev) :
+        CChainSnapshot(chain, prev), fInitialDownload(true), nSproutCommitments(0), nSizeOnDisk(0), nPruneHeight(0) {}
+};
+
+/** Return the latest chain state snapshot. This does not take cs_main. */
+std::shared_ptr<const CChainStateSnapshot> GetChainStateSnapshot();
+
+/** Serialized headers of the active chain, for serving them to peers and clients. */
+extern CHeaderCache headerCache;
+
+/** Return the height of pindexBestHeader, or -1. This does not take cs_main. */
+int GetBestHeaderHeight();
+
+/**
+ * Whether blocks are being connected to the tip after initial block download.
+ * The miner threads back off while they are (see -minervalidationpause).
+ */
+bool IsConnectingTip();
+/** Wait until IsConnectingTip() is false, for at most nMaxMillis milliseconds. */
+void WaitForTipConnected(int64_t nMaxMillis);
+/** Tip updates made after initial block download, and the time spent on them. */
+void GetTipConnectStats(uint64_t& nConnects, int64_t& nConnectMicros);
+
+/** Return how many headers were accepted without recomputing their RandomX hash. */
+uint64_t GetSkippedHeaderPoWCount();
+
+/** Memory used by the block index and the active chain, in bytes. Requires cs_main. */
+size_t BlockIndexDynamicMemoryUsage();
+/** Memory used by the orphan transactions, in bytes. Requires cs_main. */
+size_t OrphanageDynamicMemoryUsage();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the layer writing pcoinsTip flushes to disk (protected by cs_main) */
+extern CCoinsViewBackgroundFlush *pcoinsBackgroundFlush;
+
+/** Batch-verifies the shielded proofs of transactions relayed to us, if enabled */
+extern CShieldedBatchVerifier *pshieldedBatchVerifier;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -691,7 +934,7 @@ CMutableTransaction CreateNewContextualCMutableTransaction(
     int nHeight,
     bool requireV4);
 
-std::pair<std::list<CTransaction>, std::optional<uint64_t>> TakeRecentlyConflicted(const CBlockIndex* pindex);
+std::pair<std::vector<std::shared_ptr<const CTransaction>>, std::optional<uint64_t>> TakeRecentlyConflicted(const CBlockIndex* pindex);
 uint64_t GetChainConnectedSequence();
 void SetChainNotifiedSequence(const CChainParams& chainparams, uint64_t recentlyConflictedSequence);
 bool ChainIsFullyNotified(const CChainParams& chainparams);
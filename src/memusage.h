@@ -9,11 +9,14 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 
+#include "flatmap.h"
+
 namespace memusage
 {
 
@@ -150,6 +153,20 @@ static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// The standard library's hash tables are laid out like Boost's: a singly
+// linked node per element and an array of bucket pointers.
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
+{
+    return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const flatmap<X, Y, Z>& m)
+{
+    return m.DynamicMemoryUsage([](size_t alloc) { return MallocUsage(alloc); });
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -11,16 +11,21 @@
 #include "main.h"
 #include "miner.h"
 #include "rpc/server.h"
+#include "scheduler.h"
 #include "timedata.h"
 #include "ui_interface.h"
 #include "util/system.h"
 #include "util/time.h"
 #include "util/moneystr.h"
 #include "util/strencodings.h"
+#include "validationinterface.h"
 #include "wallet/wallet.h"
 #include "crypto/randomx_wrapper.h"
+#include "crypto/rapl.h"
 #include "hw/dmi/DmiReader.h"
 
+#include <rust/metrics.h>
+
 #include <boost/range/irange.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/synchronized_value.hpp>
@@ -161,6 +166,7 @@ static std::atomic<double> benchmarkAccumulatedHashrate(0.0);
 static std::atomic<int> benchmarkSampleCount(0);
 static std::atomic<bool> benchmarkWarmingUp(false);  // Track if currently in warmup phase
 static const int BENCHMARK_DURATION_SECONDS = 20; // Mine for 20 seconds per thread count
+static const char* const DEFAULT_BENCHMARK_OBJECTIVE = "hashrate"; // -benchmarkobjective
 static boost::thread* benchmarkThread = nullptr;
 static std::atomic<bool> benchmarkAutoApply(false); // Auto-apply optimal threads to config
 
@@ -376,7 +382,7 @@ static std::string GetMemoryInfo() {
 }
 
 // Get CPU model name using CPUID
-static std::string GetCPUModel() {
+std::string GetCPUModel() {
 #if defined(_M_X64) || defined(__x86_64__)
     #if defined(_MSC_VER)
         int CPUInfo[4] = {-1};
@@ -551,7 +557,7 @@ static double calculateExpectedBlockTime(double soloHashrate)
     if (soloHashrate <= 0) return 0;
 
     // Get network hashrate (average over last 120 blocks)
-    int64_t networkHashrate = GetNetworkHashPS(120, -1);
+    int64_t networkHashrate = GetMetricsStats()->netsolps;
     if (networkHashrate <= 0) return 0;
 
     // Expected time = (Network Hashrate / Solo Hashrate) × Target Block Time
@@ -567,7 +573,7 @@ static double calculateExpectedBlockTime(double soloHashrate)
 void RecordBlockFound(int64_t timeMining, double difficulty, double hashrate)
 {
     lastBlockFoundTime = GetTime();
-    lastBlockFoundHeight = chainActive.Height();
+    lastBlockFoundHeight = GetMetricsStats()->height;
 
     // Calculate luck percentage
     // Luck = expected time / actual time * 100
@@ -594,9 +600,39 @@ struct BenchmarkResult {
     std::string mode;  // "Light", "Fast", or "Fast+Hugepages"
     double hashrate;
     int samples;
+    double watts;           // CPU package power, -1 if the energy counters could not be read
+    double hashesPerJoule;  // -1 if the energy counters could not be read
 };
 static std::vector<BenchmarkResult> benchmarkResults;
 
+// Best of benchmarkResults for auto-apply. With -benchmarkobjective=efficiency
+// that is the most hashes per joule, as long as every result has an energy
+// reading; otherwise the highest hashrate.
+static BenchmarkResult FindBestBenchmarkResult(bool& fByEfficiency)
+{
+    fByEfficiency = GetArg("-benchmarkobjective", DEFAULT_BENCHMARK_OBJECTIVE) == "efficiency" &&
+        !benchmarkResults.empty() &&
+        std::all_of(benchmarkResults.begin(), benchmarkResults.end(),
+                    [](const BenchmarkResult& result) { return result.hashesPerJoule > 0; });
+
+    BenchmarkResult best{1, "Light", 0.0, 0, -1, -1};
+    for (const auto& result : benchmarkResults) {
+        if (fByEfficiency ? result.hashesPerJoule > best.hashesPerJoule : result.hashrate > best.hashrate) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+// Power and efficiency of a result for the benchmark log, empty if not measured
+static std::string FormatBenchmarkEnergy(const BenchmarkResult& result)
+{
+    if (result.hashesPerJoule <= 0) {
+        return "";
+    }
+    return strprintf(", %.1f W, %.2f H/J", result.watts, result.hashesPerJoule);
+}
+
 void TrackMinedBlock(uint256 hash)
 {
     LOCK(cs_metrics);
@@ -740,6 +776,94 @@ void ConnectMetricsScreen()
     uiInterface.InitMessage.connect(metrics_InitMessage);
 }
 
+// Counters only grow, so each publish reports what was added since the last one
+static uint64_t CounterDelta(uint64_t nValue, uint64_t& nLast)
+{
+    uint64_t nDelta = nValue > nLast ? nValue - nLast : 0;
+    nLast = nValue;
+    return nDelta;
+}
+
+static void PublishNodeMetrics()
+{
+    // Only run from the scheduler thread
+    static uint64_t nLastTransactions = 0, nLastSolverRuns = 0, nLastTargetChecks = 0, nLastMinedBlocks = 0;
+    MetricsCounter("zcash.mempool.validated.transactions", CounterDelta(transactionsValidated.value.load(), nLastTransactions));
+    uint64_t nSolverRuns = CounterDelta(ehSolverRuns.value.load(), nLastSolverRuns);
+    MetricsCounter("zcash.mining.solver.runs", nSolverRuns);
+    MetricsCounter("zcash.mining.target.checks", CounterDelta(solutionTargetChecks.value.load(), nLastTargetChecks));
+    MetricsCounter("zcash.mining.blocks.mined", CounterDelta(minedBlocks.value.load(), nLastMinedBlocks));
+
+    MetricsGauge("zcash.mining.solps", GetLocalSolPS());
+    MetricsGauge("zcash.mining.threads", (double)miningTimer.threadCount());
+
+    // CPU package power over the interval, and hashes per joule while mining
+    static CpuEnergyMeter energyMeter;
+    static double nLastJoules = energyMeter.Read();
+    static int64_t nLastEnergyTime = GetTimeMillis();
+    if (energyMeter.IsAvailable()) {
+        double nJoules = energyMeter.Read();
+        int64_t nNow = GetTimeMillis();
+        double nEnergy = nJoules - nLastJoules;
+        if (nNow > nLastEnergyTime) {
+            MetricsGauge("zcash.cpu.package.watts", nEnergy * 1000 / (nNow - nLastEnergyTime));
+        }
+        if (nEnergy > 0) {
+            MetricsGauge("zcash.mining.hashes_per_joule", nSolverRuns / nEnergy);
+        }
+        nLastJoules = nJoules;
+        nLastEnergyTime = nNow;
+    }
+#ifdef ENABLE_MINING
+    static uint64_t nLastShares = 0;
+    MetricsCounter("zcash.mining.neartarget.shares", CounterDelta(GetMinerNearTargetShares(), nLastShares));
+#endif
+
+    if (difficultyHistoryInitialized) {
+        MetricsGauge("zcash.chain.difficulty.historical", difficultyHistoricalHigh.load(), "bound", "high");
+        MetricsGauge("zcash.chain.difficulty.historical", difficultyHistoricalLow.load(), "bound", "low");
+    }
+
+    RandomXMemoryStats rx = RandomX_GetMemoryStats();
+    MetricsGauge("zcash.randomx.caches", rx.caches);
+    MetricsGauge("zcash.randomx.datasets", rx.datasets);
+    MetricsGauge("zcash.randomx.datasets.building", rx.datasets_building);
+    MetricsGauge("zcash.randomx.dataset.build.seconds", rx.last_dataset_build_ms * 0.001);
+    MetricsGauge("zcash.randomx.fastmode", RandomX_IsFastMode() ? 1 : 0);
+    MetricsGauge("zcash.randomx.hugepages", RandomX_IsUsingHugepages() ? 1 : 0);
+    MetricsGauge("zcash.randomx.memory.level", rx.memory_level);
+    MetricsGauge("zcash.randomx.memory.level.changes", rx.memory_level_changes);
+}
+
+static void PublishTipMetrics(bool, const CBlockIndex* pindex)
+{
+    if (pindex) {
+        QueueValidationCallback("metrics", [pindex] {
+            MetricsGauge("zcash.chain.difficulty", GetNetworkDifficulty(pindex));
+        });
+    }
+}
+
+static void PublishSchedulerMetrics(CScheduler& scheduler)
+{
+    // How long tasks wait for a free scheduler thread once due
+    CScheduler::LatencyStats stats = scheduler.takeLatencyStats();
+    MetricsCounter("zcash.scheduler.tasks", stats.nTasks);
+    MetricsGauge("zcash.scheduler.latency.max.ms", stats.nMaxMicros / 1000.0);
+    if (stats.nTasks > 0) {
+        MetricsGauge("zcash.scheduler.latency.mean.ms", stats.nTotalMicros / 1000.0 / stats.nTasks);
+    }
+    boost::chrono::system_clock::time_point first, last;
+    MetricsGauge("zcash.scheduler.queue.tasks", (double)scheduler.getQueueInfo(first, last));
+}
+
+void ConnectPrometheusMetrics(CScheduler& scheduler)
+{
+    uiInterface.NotifyBlockTip.connect(PublishTipMetrics);
+    scheduler.scheduleEvery(&PublishNodeMetrics, PROMETHEUS_PUBLISH_INTERVAL);
+    scheduler.scheduleEvery([&scheduler] { PublishSchedulerMetrics(scheduler); }, PROMETHEUS_PUBLISH_INTERVAL);
+}
+
 std::string DisplayDuration(int64_t duration, DurationFormat format)
 {
     int64_t days =  duration / (24 * 60 * 60);
@@ -818,41 +942,65 @@ std::optional<int64_t> SecondsLeftToNextEpoch(const Consensus::Params& params, i
     }
 }
 
-struct MetricsStats {
-    int height;
-    int64_t currentHeadersHeight;
-    int64_t currentHeadersTime;
-    size_t connections;
-    int64_t netsolps;
-};
+static std::shared_ptr<const MetricsStats> metricsStatsSnapshot;
 
-MetricsStats loadStats()
+static void PublishMetricsStats()
 {
-    int height;
-    int64_t currentHeadersHeight;
-    int64_t currentHeadersTime;
-    size_t connections;
-    int64_t netsolps;
-
+    auto stats = std::make_shared<MetricsStats>();
     {
         LOCK(cs_main);
-        height = chainActive.Height();
-        currentHeadersHeight = pindexBestHeader ? pindexBestHeader->nHeight: -1;
-        currentHeadersTime = pindexBestHeader ? pindexBestHeader->nTime : 0;
-        netsolps = GetNetworkHashPS(120, -1);
+        stats->height = chainActive.Height();
+        stats->currentHeadersHeight = pindexBestHeader ? pindexBestHeader->nHeight: -1;
+        stats->currentHeadersTime = pindexBestHeader ? pindexBestHeader->nTime : 0;
+        stats->netsolps = GetNetworkHashPS(120, -1);
+        stats->difficulty = GetNetworkDifficulty(chainActive.Tip());
+        stats->fInitialDownload = IsInitialBlockDownload(Params().GetConsensus());
+
+        LOCK(cs_metrics);
+        boost::strict_lock_ptr<std::list<uint256>> u = trackedBlocks.synchronize();
+
+        // Update orphaned block count
+        std::list<uint256>::iterator it = u->begin();
+        while (it != u->end()) {
+            auto hash = *it;
+            if (mapBlockIndex.count(hash) > 0 &&
+                    chainActive.Contains(mapBlockIndex[hash])) {
+                it++;
+            } else {
+                it = u->erase(it);
+            }
+        }
+        stats->orphanedBlocks = minedBlocks.get() - u->size();
     }
     {
         LOCK(cs_vNodes);
-        connections = vNodes.size();
+        stats->connections = vNodes.size();
     }
+    std::atomic_store(&metricsStatsSnapshot, std::shared_ptr<const MetricsStats>(stats));
+}
 
-    return MetricsStats {
-        height,
-        currentHeadersHeight,
-        currentHeadersTime,
-        connections,
-        netsolps
-    };
+std::shared_ptr<const MetricsStats> GetMetricsStats()
+{
+    auto stats = std::atomic_load(&metricsStatsSnapshot);
+    if (!stats) {
+        // Nothing published yet
+        PublishMetricsStats();
+        stats = std::atomic_load(&metricsStatsSnapshot);
+    }
+    return stats;
+}
+
+static void PublishTipMetricsStats(bool, const CBlockIndex*)
+{
+    // Before returning to the caller, so RPCs that connect a block see it
+    PublishMetricsStats();
+}
+
+void ConnectMetricsStats(CScheduler& scheduler)
+{
+    uiInterface.NotifyBlockTip.connect(PublishTipMetricsStats);
+    // Headers and peers change between tips
+    scheduler.scheduleEvery(&PublishMetricsStats, METRICS_STATS_INTERVAL);
 }
 
 // ============================================================================
@@ -1068,7 +1216,7 @@ static void drawDifficultyRow(double currentDifficulty, int rowWidth = 74) {
     std::cout << "\e[0m  \e[1;33m" << valueStr << "\e[0m " << BOX_VERTICAL << std::endl;
 }
 
-int printStats(MetricsStats stats, bool isScreen, bool mining)
+int printStats(const MetricsStats& stats, bool isScreen, bool mining)
 {
     int lines = 0;
     const Consensus::Params& params = Params().GetConsensus();
@@ -1079,7 +1227,7 @@ int printStats(MetricsStats stats, bool isScreen, bool mining)
     lines++;
 
     // Syncing or synced status
-    if (IsInitialBlockDownload(Params().GetConsensus())) {
+    if (stats.fInitialDownload) {
         if (fReindex) {
             int downloadPercent = nSizeReindexed * 100 / nFullSizeToReindex;
             drawRow("Status", strprintf("Reindexing (%d%%)", downloadPercent));
@@ -1120,7 +1268,7 @@ int printStats(MetricsStats stats, bool isScreen, bool mining)
     }
 
     // Network Difficulty with inline meter bar
-    double difficulty = GetNetworkDifficulty(chainActive.Tip());
+    double difficulty = stats.difficulty;
     if (isScreen) {
         drawDifficultyRow(difficulty);
     } else {
@@ -1149,6 +1297,22 @@ int printStats(MetricsStats stats, bool isScreen, bool mining)
     if (mining && miningTimer.running()) {
         drawRow("Your Hash Rate", DisplayHashRate(localsolps));
         lines++;
+#ifdef ENABLE_MINING
+        // Summed over miner threads; see getminingprofile for the breakdown
+        double seconds = 0, hashing = 0, latency = 0;
+        uint64_t switches = 0;
+        for (const MinerThreadProfile& profile : GetMinerProfile()) {
+            seconds += profile.seconds;
+            hashing += profile.phase_seconds[MINER_PHASE_HASHING];
+            latency += profile.avg_switch_latency * profile.switches;
+            switches += profile.switches;
+        }
+        if (seconds > 0) {
+            drawRow("Outside RandomX", strprintf("%.1f%%, template switch %.0f ms",
+                100 * (1 - hashing / seconds), switches > 0 ? 1000 * latency / switches : 0));
+            lines++;
+        }
+#endif
     }
 
     drawBoxBottom();
@@ -1185,26 +1349,7 @@ int printWalletStatus()
         // Show blocks mined if any
         int blocksMined = minedBlocks.get();
         if (blocksMined > 0) {
-            int orphaned = 0;
-            {
-                LOCK2(cs_main, cs_metrics);
-                boost::strict_lock_ptr<std::list<uint256>> u = trackedBlocks.synchronize();
-
-                // Update orphaned block count
-                std::list<uint256>::iterator it = u->begin();
-                while (it != u->end()) {
-                    auto hash = *it;
-                    if (mapBlockIndex.count(hash) > 0 &&
-                            chainActive.Contains(mapBlockIndex[hash])) {
-                        it++;
-                    } else {
-                        it = u->erase(it);
-                    }
-                }
-
-                orphaned = blocksMined - u->size();
-            }
-
+            int orphaned = GetMetricsStats()->orphanedBlocks;
             drawRow("Blocks Mined", strprintf("%d (orphaned: %d)", blocksMined, orphaned));
             lines++;
         }
@@ -1406,7 +1551,7 @@ int printMiningStatus(bool mining)
             }
 
             // Show block reward
-            int nHeight = chainActive.Height() + 1; // Next block to be mined
+            int nHeight = GetMetricsStats()->height + 1; // Next block to be mined
             CAmount blockReward = Params().GetConsensus().GetBlockSubsidy(nHeight);
             drawRow("Block Reward", FormatMoney(blockReward));
             lines++;
@@ -1495,14 +1640,10 @@ int printMiningStatus(bool mining)
                 lines++;
             }
         } else {
-            bool fvNodesEmpty;
-            {
-                LOCK(cs_vNodes);
-                fvNodesEmpty = vNodes.empty();
-            }
-            if (fvNodesEmpty) {
+            auto stats = GetMetricsStats();
+            if (stats->connections == 0) {
                 drawRow("Status", "\e[1;33m○ PAUSED\e[0m - Waiting for connections");
-            } else if (IsInitialBlockDownload(Params().GetConsensus())) {
+            } else if (stats->fInitialDownload) {
                 drawRow("Status", "\e[1;33m○ PAUSED\e[0m - Downloading blocks");
             } else {
                 drawRow("Status", "\e[1;33m○ PAUSED\e[0m - Processing");
@@ -2344,19 +2485,9 @@ static void promptForThreads(int screenHeight)
             // Restart mining with new thread count if currently mining
             bool currentlyMining = GetBoolArg("-gen", false);
             if (currentlyMining) {
-                // Stop mining first
-                GenerateBitcoins(false, 0, Params());
-                MilliSleep(500);  // Wait for threads to stop
-
-                // Reset counters and timer for accurate hashrate with new thread count
-                ehSolverRuns.value.store(0);
-                solutionTargetChecks.value.store(0);
-                miningTimer.zeroize();
-
-                // Restart mining with new thread count
+                // Resize the running pool; threads keep their VMs
                 GenerateBitcoins(true, threads, Params());
-                SetMiningStartTime();  // Track start time for warmup display
-                LogPrintf("User set mining threads to %d (mining restarted, counters reset)\n", threads);
+                LogPrintf("User set mining threads to %d\n", threads);
             } else {
                 LogPrintf("User set mining threads to %d (will apply when mining starts)\n", threads);
             }
@@ -2559,6 +2690,9 @@ void ThreadBenchmarkMining()
     std::string randomxMode = fastMode ? "Fast (2GB dataset)" : "Light (256MB dataset)";
     std::string hugepagesStatus = hugepagesEnabled ? "ENABLED" : "DISABLED";
 
+    // CPU package energy, for hashes per joule
+    CpuEnergyMeter energyMeter;
+
     // Print configuration to console
     LogPrintf("===========================================\n");
     LogPrintf("Benchmark Configuration:\n");
@@ -2606,6 +2740,8 @@ void ThreadBenchmarkMining()
     benchmarkLog << "Duration per test: " << BENCHMARK_DURATION_SECONDS << " seconds (+ 2s warmup per test)\n";
     benchmarkLog << "RandomX Mode: " << randomxMode << "\n";
     benchmarkLog << "Hugepages: " << hugepagesStatus << "\n";
+    benchmarkLog << "Energy Counters: " << energyMeter.Source() << "\n";
+    benchmarkLog << "Auto-apply Objective: " << GetArg("-benchmarkobjective", DEFAULT_BENCHMARK_OBJECTIVE) << "\n";
     if (!hugepagesEnabled) {
         benchmarkLog << "  Note: Hugepages disabled - hashrate may be 5-10% lower than with hugepages\n";
     }
@@ -2661,16 +2797,8 @@ void ThreadBenchmarkMining()
                 benchmarkLog << "\n  Thread Count: " << threadCount << "\n";
                 benchmarkLog << std::flush;
 
-                // Stop mining before changing thread count
-                GenerateBitcoins(false, 0, Params());
-                MilliSleep(500);  // Wait for threads to stop
-
-                // Reset hash counters and timer for this thread count test
-                ehSolverRuns.value.store(0);
-                solutionTargetChecks.value.store(0);
-                miningTimer.zeroize();
-
-                // Start mining with new thread count
+                // Resize the pool in place: the threads already running keep
+                // their VMs, so only the new one has to warm up
                 GenerateBitcoins(true, threadCount, Params());
 
                 // Reset benchmark stats for this test
@@ -2678,12 +2806,27 @@ void ThreadBenchmarkMining()
                 benchmarkSampleCount = 0;
                 benchmarkStartTime = GetTime();
 
-                // Wait for mining to produce first hashes (RandomX can be slow to start)
+                // Samples are rates over each interval, as the mining timer
+                // keeps running across steps
+                uint64_t nLastChecks = solutionTargetChecks.value.load();
+                int64_t nLastSample = GetTimeMillis();
+                auto sampleHashrate = [&]() {
+                    uint64_t nChecks = solutionTargetChecks.value.load();
+                    int64_t nNow = GetTimeMillis();
+                    double rate = nNow > nLastSample ? (nChecks - nLastChecks) * 1000.0 / (nNow - nLastSample) : 0;
+                    nLastChecks = nChecks;
+                    nLastSample = nNow;
+                    return rate;
+                };
+
+                // Let the new thread get its VM and the others pick up the
+                // new placement before measuring
                 benchmarkWarmingUp = true;
-                int64_t warmupTimeout = GetTime() + 10;  // Reduced from 30s to 10s
+                double warmupHashrate = 0;
+                int64_t warmupTimeout = GetTime() + 10;
                 while (GetTime() < warmupTimeout) {
                     MilliSleep(1000);
-                    double warmupHashrate = GetLocalSolPS();
+                    warmupHashrate = sampleHashrate();
 
                     if (warmupHashrate > 0) {
                         LogPrintf("Mining active, hashrate detected: %.2f H/s\n", warmupHashrate);
@@ -2693,19 +2836,22 @@ void ThreadBenchmarkMining()
                 }
                 benchmarkWarmingUp = false;
 
-                if (GetLocalSolPS() == 0) {
+                if (warmupHashrate == 0) {
                     LogPrintf("WARNING: No hashrate detected after warmup period\n");
                 }
 
                 // Mine for the specified duration and collect samples
+                double joulesStart = energyMeter.Read();
+                int64_t measureStart = GetTimeMillis();
                 int64_t endTime = GetTime() + BENCHMARK_DURATION_SECONDS;
+                sampleHashrate();
                 while (GetTime() < endTime) {
                     boost::this_thread::interruption_point();
 
                     // Sample hashrate every second
                     MilliSleep(1000);
 
-                    double currentHashrate = GetLocalSolPS();
+                    double currentHashrate = sampleHashrate();
                     if (currentHashrate > 0) {
                         benchmarkAccumulatedHashrate = benchmarkAccumulatedHashrate.load() + currentHashrate;
                         benchmarkSampleCount++;
@@ -2717,6 +2863,14 @@ void ThreadBenchmarkMining()
                 if (benchmarkSampleCount > 0) {
                     avgHashrate = benchmarkAccumulatedHashrate.load() / benchmarkSampleCount.load();
                 }
+                double watts = -1, hashesPerJoule = -1;
+                double measureSeconds = (GetTimeMillis() - measureStart) * 0.001;
+                if (joulesStart >= 0 && measureSeconds > 0) {
+                    watts = (energyMeter.Read() - joulesStart) / measureSeconds;
+                    if (watts > 0) {
+                        hashesPerJoule = avgHashrate / watts;
+                    }
+                }
 
                 // Log results
                 LogPrintf("Benchmark: %s mode, %d thread(s) = %.2f H/s (avg over %d samples)\n",
@@ -2724,6 +2878,11 @@ void ThreadBenchmarkMining()
 
                 benchmarkLog << "    Average Hashrate: " << std::fixed << std::setprecision(2) << avgHashrate << " H/s\n";
                 benchmarkLog << "    Samples: " << benchmarkSampleCount.load() << "\n";
+                if (hashesPerJoule > 0) {
+                    LogPrintf("Benchmark: %s mode, %d thread(s) = %.1f W, %.2f H/J\n", mode.name, threadCount, watts, hashesPerJoule);
+                    benchmarkLog << "    Package Power: " << std::fixed << std::setprecision(1) << watts << " W\n";
+                    benchmarkLog << "    Efficiency: " << std::fixed << std::setprecision(2) << hashesPerJoule << " H/J\n";
+                }
                 benchmarkLog << std::flush;
 
                 // Store result
@@ -2732,27 +2891,24 @@ void ThreadBenchmarkMining()
                 result.mode = mode.name;
                 result.hashrate = avgHashrate;
                 result.samples = benchmarkSampleCount.load();
+                result.watts = watts;
+                result.hashesPerJoule = hashesPerJoule;
                 benchmarkResults.push_back(result);
             }
         }
 
         // Find best configuration overall
-        int bestThreads = 1;
-        std::string bestMode = "Light";
-        double bestHashrate = 0.0;
-        for (const auto& result : benchmarkResults) {
-            if (result.hashrate > bestHashrate) {
-                bestHashrate = result.hashrate;
-                bestThreads = result.threads;
-                bestMode = result.mode;
-            }
-        }
+        bool fByEfficiency;
+        BenchmarkResult best = FindBestBenchmarkResult(fByEfficiency);
+        int bestThreads = best.threads;
+        std::string bestMode = best.mode;
+        double bestHashrate = best.hashrate;
 
         // Write summary
         benchmarkLog << "\n========================================\n";
         benchmarkLog << "Summary\n";
         benchmarkLog << "========================================\n";
-        benchmarkLog << "Best Configuration: " << bestMode << " mode, " << bestThreads << " threads @ " << std::fixed << std::setprecision(2) << bestHashrate << " H/s\n";
+        benchmarkLog << "Best Configuration" << (fByEfficiency ? " (by efficiency)" : "") << ": " << bestMode << " mode, " << bestThreads << " threads @ " << std::fixed << std::setprecision(2) << bestHashrate << " H/s" << FormatBenchmarkEnergy(best) << "\n";
 
         // Group results by mode
         benchmarkLog << "\nHashrate by mode and thread count:\n";
@@ -2760,7 +2916,7 @@ void ThreadBenchmarkMining()
             benchmarkLog << "\n  " << testMode.name << " Mode:\n";
             for (const auto& result : benchmarkResults) {
                 if (result.mode == testMode.name) {
-                    benchmarkLog << "    " << result.threads << " threads: " << std::fixed << std::setprecision(2) << result.hashrate << " H/s\n";
+                    benchmarkLog << "    " << result.threads << " threads: " << std::fixed << std::setprecision(2) << result.hashrate << " H/s" << FormatBenchmarkEnergy(result) << "\n";
                 }
             }
         }
@@ -2781,7 +2937,8 @@ void ThreadBenchmarkMining()
             }
         }
 
-        LogPrintf("Benchmark complete! Best: %s mode, %d threads @ %.2f H/s\n", bestMode, bestThreads, bestHashrate);
+        LogPrintf("Benchmark complete! Best%s: %s mode, %d threads @ %.2f H/s%s\n",
+                  fByEfficiency ? " by efficiency" : "", bestMode, bestThreads, bestHashrate, FormatBenchmarkEnergy(best));
         LogPrintf("Benchmark ran from block height %d to %d\n", benchmarkStartHeight, endHeight);
         LogPrintf("Results saved to %s\n", benchmarkLogPath.string());
 
@@ -2873,19 +3030,14 @@ void ThreadBenchmarkMining()
 
         if (!benchmarkResults.empty()) {
             // Find best from partial results
-            int bestThreads = 1;
-            std::string bestMode = "Light";
-            double bestHashrate = 0.0;
-            for (const auto& result : benchmarkResults) {
-                if (result.hashrate > bestHashrate) {
-                    bestHashrate = result.hashrate;
-                    bestThreads = result.threads;
-                    bestMode = result.mode;
-                }
-            }
+            bool fByEfficiency;
+            BenchmarkResult best = FindBestBenchmarkResult(fByEfficiency);
+            int bestThreads = best.threads;
+            std::string bestMode = best.mode;
+            double bestHashrate = best.hashrate;
 
             benchmarkLog << "Partial Results (tested " << benchmarkResults.size() << " configurations):\n";
-            benchmarkLog << "Best so far: " << bestMode << " mode, " << bestThreads << " threads @ " << std::fixed << std::setprecision(2) << bestHashrate << " H/s\n\n";
+            benchmarkLog << "Best so far" << (fByEfficiency ? " (by efficiency)" : "") << ": " << bestMode << " mode, " << bestThreads << " threads @ " << std::fixed << std::setprecision(2) << bestHashrate << " H/s" << FormatBenchmarkEnergy(best) << "\n\n";
 
             // Group partial results by mode
             benchmarkLog << "Results by mode:\n";
@@ -2897,7 +3049,7 @@ void ThreadBenchmarkMining()
                 benchmarkLog << "  " << modeName << " Mode:\n";
                 for (const auto& result : benchmarkResults) {
                     if (result.mode == modeName) {
-                        benchmarkLog << "    " << result.threads << " threads: " << std::fixed << std::setprecision(2) << result.hashrate << " H/s\n";
+                        benchmarkLog << "    " << result.threads << " threads: " << std::fixed << std::setprecision(2) << result.hashrate << " H/s" << FormatBenchmarkEnergy(result) << "\n";
                     }
                 }
             }
@@ -3072,10 +3224,9 @@ void ThreadShowMetricsScreen()
 #endif
         }
 
-        // Lock and fetch stats before erasing the screen, in case we block.
-        std::optional<MetricsStats> metricsStats;
+        std::shared_ptr<const MetricsStats> metricsStats;
         if (loaded) {
-            metricsStats = loadStats();
+            metricsStats = GetMetricsStats();
         }
 
         if (isScreen) {
@@ -3091,7 +3242,7 @@ void ThreadShowMetricsScreen()
 #endif
 
         if (loaded) {
-            lines += printStats(metricsStats.value(), isScreen, mining);
+            lines += printStats(*metricsStats, isScreen, mining);
             lines += printWalletStatus();
             lines += printMiningStatus(mining);
         }
@@ -10,10 +10,34 @@
 #include "consensus/params.h"
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 
+class CScheduler;
+
+/** Seconds between publishing the counters below to the Prometheus exporter */
+static const int64_t PROMETHEUS_PUBLISH_INTERVAL = 5;
+/** Seconds between refreshes of MetricsStats besides those on each new tip */
+static const int64_t METRICS_STATS_INTERVAL = 5;
+
+/**
+ * Chain and peer figures for the metrics screen and getmininginfo. They are
+ * gathered under cs_main on each new tip and every METRICS_STATS_INTERVAL
+ * seconds, so readers of the snapshot never take the lock.
+ */
+struct MetricsStats {
+    int height = -1;
+    int64_t currentHeadersHeight = -1;
+    int64_t currentHeadersTime = 0;
+    size_t connections = 0;
+    int64_t netsolps = 0;
+    double difficulty = 0;
+    bool fInitialDownload = true;
+    int orphanedBlocks = 0;  //!< Blocks mined here that left the active chain
+};
+
 struct AtomicCounter {
     std::atomic<uint64_t> value;
 
@@ -84,6 +108,8 @@ void SetMiningStartTime();
 
 void MarkStartTime();
 double GetLocalSolPS();
+/** CPU brand string from CPUID, "Unknown" if unavailable */
+std::string GetCPUModel();
 int EstimateNetHeight(const Consensus::Params& params, int currentBlockHeight, int64_t currentBlockTime);
 std::optional<int64_t> SecondsLeftToNextEpoch(const Consensus::Params& params, int currentHeight);
 std::string DisplayDuration(int64_t time, DurationFormat format);
@@ -92,7 +118,17 @@ std::string DisplayHashRate(double value);
 
 void TriggerRefresh();
 
+/** The latest MetricsStats snapshot */
+std::shared_ptr<const MetricsStats> GetMetricsStats();
+/** Refresh the MetricsStats snapshot on each new tip and on a timer */
+void ConnectMetricsStats(CScheduler& scheduler);
+
 void ConnectMetricsScreen();
+/**
+ * Publish the mining and RandomX counters to the -prometheusport exporter
+ * every PROMETHEUS_PUBLISH_INTERVAL seconds, and the difficulty on each new tip.
+ */
+void ConnectPrometheusMetrics(CScheduler& scheduler);
 void ThreadShowMetricsScreen();
 void ThreadBenchmarkMining();
 
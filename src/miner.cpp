@@ -13,6 +13,7 @@
 #include "crypto/randomx_msr.h"
 #include "crypto/randomx_fix.h"
 #include "crypto/cpu_features.h"
+#include "mining_target.h"
 #include "numa_helper.h"
 #endif
 
@@ -44,6 +45,7 @@
 #include "util/system.h"
 #include "util/match.h"
 #include "util/moneystr.h"
+#include "util/trace.h"
 #include "validationinterface.h"
 #include "zip317.h"
 
@@ -52,8 +54,13 @@
 
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
+
+#include <univalue.h>
 #ifdef ENABLE_MINING
+#include <condition_variable>
+#include <fstream>
 #include <functional>
+#include <map>
 #endif
 #include <mutex>
 #include <queue>
@@ -332,7 +339,24 @@ public:
     }
 };
 
-CMutableTransaction CreateCoinbaseTransaction(const CChainParams& chainparams, CAmount nFees, const MinerAddress& minerAddress, int nHeight)
+/**
+ * The last coinbase transaction built for a shielded miner address. Its
+ * proof takes seconds to create, while a template refreshed for new mempool
+ * transactions at the same height and fees needs exactly the same coinbase.
+ */
+struct ShieldedCoinbaseCache
+{
+    const CChainParams* chainparams = nullptr;
+    int nHeight = -1;
+    CAmount nFees = 0;
+    std::optional<MinerAddress> minerAddress;
+    CMutableTransaction mtx;
+};
+
+static std::mutex cs_shieldedCoinbase;
+static ShieldedCoinbaseCache shieldedCoinbaseCache;
+
+static CMutableTransaction BuildCoinbaseTransaction(const CChainParams& chainparams, CAmount nFees, const MinerAddress& minerAddress, int nHeight)
 {
         CMutableTransaction mtx = CreateNewContextualCMutableTransaction(
                 chainparams.GetConsensus(), nHeight,
@@ -357,6 +381,30 @@ CMutableTransaction CreateCoinbaseTransaction(const CChainParams& chainparams, C
         return mtx;
 }
 
+CMutableTransaction CreateCoinbaseTransaction(const CChainParams& chainparams, CAmount nFees, const MinerAddress& minerAddress, int nHeight)
+{
+    if (!IsShieldedMinerAddress(minerAddress)) {
+        return BuildCoinbaseTransaction(chainparams, nFees, minerAddress, nHeight);
+    }
+
+    // Held while building, so that concurrent callers after the same
+    // coinbase wait for it rather than proving it again.
+    std::lock_guard<std::mutex> lock(cs_shieldedCoinbase);
+    ShieldedCoinbaseCache& cache = shieldedCoinbaseCache;
+    if (cache.chainparams == &chainparams && cache.nHeight == nHeight &&
+        cache.nFees == nFees && cache.minerAddress == minerAddress) {
+        LogPrint("pow", "%s: Reusing shielded coinbase for height %d\n", __func__, nHeight);
+        return cache.mtx;
+    }
+    CMutableTransaction mtx = BuildCoinbaseTransaction(chainparams, nFees, minerAddress, nHeight);
+    cache.chainparams = &chainparams;
+    cache.nHeight = nHeight;
+    cache.nFees = nFees;
+    cache.minerAddress = minerAddress;
+    cache.mtx = mtx;
+    return mtx;
+}
+
 BlockAssembler::BlockAssembler(const CChainParams& _chainparams)
     : chainparams(_chainparams)
 {
@@ -393,12 +441,29 @@ void BlockAssembler::resetBlock(const MinerAddress& minerAddress)
 
     lastFewTxs = 0;
     blockFinished = false;
+    nBlockUnpaidActions = 0;
 }
 
 CBlockTemplate* BlockAssembler::CreateNewBlock(
     const MinerAddress& minerAddress,
-    const std::optional<CMutableTransaction>& next_cb_mtx)
+    const std::optional<CMutableTransaction>& next_cb_mtx,
+    bool fEmptyBlock)
+{
+    return CreateBlock(minerAddress, next_cb_mtx, fEmptyBlock, nullptr);
+}
+
+CBlockTemplate* BlockAssembler::UpdateBlock(const CBlockTemplate& previous, const MinerAddress& minerAddress)
+{
+    return CreateBlock(minerAddress, std::nullopt, false, &previous);
+}
+
+CBlockTemplate* BlockAssembler::CreateBlock(
+    const MinerAddress& minerAddress,
+    const std::optional<CMutableTransaction>& next_cb_mtx,
+    bool fEmptyBlock,
+    const CBlockTemplate* pprevious)
 {
+    int64_t nTimeStart = GetTimeMicros();
     resetBlock(minerAddress);
 
     pblocktemplate.reset(new CBlockTemplate());
@@ -414,12 +479,56 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
 
     // If we're given a coinbase tx, it's been precomputed, its fees are zero,
     // so we can't include any mempool transactions; this will be an empty block.
-    blockFinished = blockFinished || next_cb_mtx;
+    blockFinished = blockFinished || next_cb_mtx || fEmptyBlock;
 
-    LOCK2(cs_main, mempool.cs);
-    CBlockIndex* pindexPrev = chainActive.Tip();
-    nHeight = pindexPrev->nHeight + 1;
-    uint32_t consensusBranchId = CurrentEpochBranchId(nHeight, chainparams.GetConsensus());
+    // Capture what the template needs from the tip and its coins view. cs_main
+    // is not held while transactions are selected and the coinbase is built;
+    // the tip is checked again before the block is tested below.
+    CBlockIndex* pindexPrev;
+    SaplingMerkleTree sapling_tree;
+    uint256 hashChainHistoryRoot;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive.Tip();
+        if (pprevious && pprevious->block.hashPrevBlock != pindexPrev->GetBlockHash())
+            return NULL;
+        nHeight = pindexPrev->nHeight + 1;
+
+        CCoinsViewCache view(pcoinsTip);
+        assert(view.GetSaplingAnchorAt(view.GetBestAnchor(SAPLING), sapling_tree));
+
+        const Consensus::Params& consensus = chainparams.GetConsensus();
+        if (consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_NU5) ||
+            (consensus.NetworkUpgradeActive(nHeight, Consensus::UPGRADE_HEARTWOOD) &&
+             !IsActivationHeight(nHeight, consensus, Consensus::UPGRADE_HEARTWOOD))) {
+            uint32_t prevConsensusBranchId = CurrentEpochBranchId(pindexPrev->nHeight, consensus);
+            hashChainHistoryRoot = view.GetHistoryRoot(prevConsensusBranchId);
+        }
+
+        // We want to track the value pool, but if the miner gets
+        // invoked on an old block before the hardcoded fallback
+        // is active we don't want to trip up any assertions. So,
+        // we only adhere to the turnstile (as a miner) if we
+        // actually have all of the information necessary to do
+        // so.
+        if (chainparams.ZIP209Enabled()) {
+            if (pindexPrev->nChainSproutValue) {
+                sproutValue = *pindexPrev->nChainSproutValue;
+            } else {
+                monitoring_pool_balances = false;
+            }
+            if (pindexPrev->nChainSaplingValue) {
+                saplingValue = *pindexPrev->nChainSaplingValue;
+            } else {
+                monitoring_pool_balances = false;
+            }
+            if (pindexPrev->nChainOrchardValue) {
+                orchardValue = *pindexPrev->nChainOrchardValue;
+            } else {
+                monitoring_pool_balances = false;
+            }
+        }
+    }
 
     // -regtest only: allow overriding block.nVersion with
     // -blockversion=N to test forking scenarios
@@ -432,41 +541,20 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
     UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
 
     const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
-    CCoinsViewCache view(pcoinsTip);
-
-    SaplingMerkleTree sapling_tree;
-    assert(view.GetSaplingAnchorAt(view.GetBestAnchor(SAPLING), sapling_tree));
 
     nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
                        ? nMedianTimePast
                        : pblock->GetBlockTime();
 
-    // We want to track the value pool, but if the miner gets
-    // invoked on an old block before the hardcoded fallback
-    // is active we don't want to trip up any assertions. So,
-    // we only adhere to the turnstile (as a miner) if we
-    // actually have all of the information necessary to do
-    // so.
-    if (chainparams.ZIP209Enabled()) {
-        if (pindexPrev->nChainSproutValue) {
-            sproutValue = *pindexPrev->nChainSproutValue;
-        } else {
-            monitoring_pool_balances = false;
-        }
-        if (pindexPrev->nChainSaplingValue) {
-            saplingValue = *pindexPrev->nChainSaplingValue;
-        } else {
-            monitoring_pool_balances = false;
-        }
-        if (pindexPrev->nChainOrchardValue) {
-            orchardValue = *pindexPrev->nChainOrchardValue;
-        } else {
-            monitoring_pool_balances = false;
+    // Only the mempool is needed while selecting transactions
+    {
+        LOCK(mempool.cs);
+        if (pprevious) {
+            addPreviousTransactions(*pprevious);
         }
+        constructZIP317BlockTemplate();
     }
 
-    constructZIP317BlockTemplate();
-
     last_block_num_txs = nBlockTx;
     last_block_size = nBlockSize;
     LogPrintf("%s: total size %u (excluding coinbase) txs: %u fees: %ld sigops %d", __func__, nBlockSize, nBlockTx, nFees, nBlockSigOps);
@@ -493,8 +581,6 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
     nonce >>= 16;
     pblock->nNonce = ArithToUint256(nonce);
 
-    uint32_t prevConsensusBranchId = CurrentEpochBranchId(pindexPrev->nHeight, chainparams.GetConsensus());
-
     // Fill in header
     pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
     if (chainparams.GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_NU5)) {
@@ -502,7 +588,7 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         // update it whenever the coinbase transaction changes.
         //
         // - For the internal miner (either directly or via the `generate` RPC), this
-        //   will occur in `IncrementExtraNonce()`, like for `hashMerkleRoot`.
+        //   will occur in `IncrementExtraNonce()` if it changes the coinbase.
         // - For `getblocktemplate`, we have two sets of fields to handle:
         //   - The `defaultroots` fields, which contain both the default value (if
         //     nothing in the template is altered), and the roots that can be used to
@@ -513,9 +599,9 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         //     v4.6.0 where they were accidentally set to always be the NU5 value).
         //
         // To accommodate all use cases, we calculate the `hashBlockCommitments`
-        // default value here (unlike `hashMerkleRoot`), and additionally cache the
+        // default value here (like `hashMerkleRoot`), and additionally cache the
         // values necessary to recalculate it.
-        pblocktemplate->hashChainHistoryRoot = view.GetHistoryRoot(prevConsensusBranchId);
+        pblocktemplate->hashChainHistoryRoot = hashChainHistoryRoot;
         pblocktemplate->hashAuthDataRoot = pblock->BuildAuthDataMerkleTree();
         pblock->hashBlockCommitments = DeriveBlockCommitmentsHash(
                 pblocktemplate->hashChainHistoryRoot,
@@ -525,7 +611,7 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         pblocktemplate->hashAuthDataRoot.SetNull();
         pblock->hashBlockCommitments.SetNull();
     } else if (chainparams.GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_HEARTWOOD)) {
-        pblocktemplate->hashChainHistoryRoot = view.GetHistoryRoot(prevConsensusBranchId);
+        pblocktemplate->hashChainHistoryRoot = hashChainHistoryRoot;
         pblocktemplate->hashAuthDataRoot.SetNull();
         pblock->hashBlockCommitments = pblocktemplate->hashChainHistoryRoot;
     } else {
@@ -537,12 +623,22 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
     pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
     pblock->nSolution.clear();
     pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 
-    CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, true)) {
-        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    {
+        LOCK(cs_main);
+        // Everything above was built on pindexPrev; give up if the tip moved meanwhile
+        if (chainActive.Tip() != pindexPrev) {
+            LogPrint("miner", "%s: tip changed while the template was built, discarding it\n", __func__);
+            return NULL;
+        }
+        CValidationState state;
+        if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, true)) {
+            throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+        }
     }
 
+    TRACE5(miner, template_created, nHeight, nBlockTx, nBlockSize, nFees, GetTimeMicros() - nTimeStart);
     return pblocktemplate.release();
 }
 
@@ -673,20 +769,38 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
+void BlockAssembler::addPreviousTransactions(const CBlockTemplate& previous)
+{
+    // The previous block is in dependency order, so a transaction whose parent
+    // has left the mempool is dropped along with that parent.
+    size_t nDropped = 0;
+    for (size_t i = 1; i < previous.block.vtx.size(); i++) {
+        CTxMemPool::txiter iter = mempool.mapTx.find(previous.block.vtx[i].GetHash());
+        if (iter == mempool.mapTx.end() || isStillDependent(iter) ||
+            nBlockUnpaidActions + iter->GetUnpaidActionCount() > nBlockUnpaidActionLimit ||
+            !TestForBlock(iter)) {
+            nDropped++;
+            continue;
+        }
+        AddToBlock(iter);
+        nBlockUnpaidActions += iter->GetUnpaidActionCount();
+    }
+    LogPrint("miner", "%s: kept %u of %u transactions from the previous template\n",
+             __func__, nBlockTx, previous.block.vtx.size() - 1);
+    if (nDropped > 0) {
+        LogPrint("miner", "%s: dropped %u transactions no longer in the mempool\n", __func__, nDropped);
+    }
+}
+
 void BlockAssembler::constructZIP317BlockTemplate()
 {
+    if (blockFinished) return;
+
+    // The mempool keeps the candidates weighted as transactions come and go,
+    // so only a copy of them is needed for each template.
     CTxMemPool::weightedCandidates candidatesPayingConventionalFee;
     CTxMemPool::weightedCandidates candidatesNotPayingConventionalFee;
-
-    for (auto mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
-    {
-        int128_t weightRatio = mi->GetWeightRatio();
-        if (weightRatio >= WEIGHT_RATIO_SCALE) {
-            candidatesPayingConventionalFee.add(mi->GetTx().GetHash(), mi, weightRatio);
-        } else {
-            candidatesNotPayingConventionalFee.add(mi->GetTx().GetHash(), mi, weightRatio);
-        }
-    }
+    mempool.GetBlockCandidates(candidatesPayingConventionalFee, candidatesNotPayingConventionalFee);
 
     CTxMemPool::queueEntries waiting;
     CTxMemPool::queueEntries cleared;
@@ -699,8 +813,6 @@ void BlockAssembler::addTransactions(
     CTxMemPool::queueEntries& waiting,
     CTxMemPool::queueEntries& cleared)
 {
-    size_t nBlockUnpaidActions = 0;
-
     while (!blockFinished && !(candidates.empty() && cleared.empty()))
     {
         CTxMemPool::txiter iter;
@@ -710,6 +822,11 @@ void BlockAssembler::addTransactions(
             // from the candidate set.
             assert(!candidates.empty());
             iter = std::get<1>(candidates.takeRandom().value());
+            // Already kept from a previous template. Skipping it once drawn
+            // leaves the others as likely to be drawn as if it had never been
+            // a candidate.
+            if (inBlock.count(iter))
+                continue;
         } else {
             // If a previously postponed tx is available to try again, then it
             // has already been randomly sampled, so just take it in order.
@@ -717,7 +834,7 @@ void BlockAssembler::addTransactions(
             cleared.pop_front();
         }
 
-        // The tx should never already be in the block for ZIP 317.
+        // Otherwise the tx should never already be in the block for ZIP 317.
         assert(inBlock.count(iter) == 0);
 
         // If the tx would cause the block to exceed the unpaid action limit, skip it.
@@ -742,10 +859,10 @@ void BlockAssembler::addTransactions(
             // This tx was successfully added, so add waiting transactions that
             // depend on this one to the cleared queue to try again.
             //
-            // TODO: This makes the overall algorithm O(n^2 log n) in the worst case
-            // of a linear dependency chain. (children is a std::map; its count method
-            // is O(log n) given the maximum number of children at each step, and is
-            // called O(n^2) times.) Daira conjectures that O(n log n) is possible.
+            // TODO: This makes the overall algorithm O(n^2 k) in the worst case
+            // of a linear dependency chain. (children's count method is linear in
+            // the number of children k at each step, and is called O(n^2) times.)
+            // Daira conjectures that O(n log n) is possible.
             auto children = mempool.GetMemPoolChildren(iter);
             CTxMemPool::queueEntries stillWaiting;
             for (CTxMemPool::txiter maybeChild : waiting)
@@ -860,7 +977,7 @@ void IncrementExtraNonce(
     }
 }
 
-static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainparams)
+bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainparams)
 {
     LogPrintf("%s\n", pblock->ToString());
 
@@ -882,6 +999,7 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     }
 
     // Found a solution
+    TRACE2(miner, solution_found, pblock->GetHash().begin(), totalMinerReward);
     {
         LOCK(cs_main);
         if (pblock->hashPrevBlock != chainActive.Tip()->GetBlockHash())
@@ -907,13 +1025,201 @@ static inline void IncrementNonce256(uint256& nonce) {
     }
 }
 
+uint256 MinerNonce(uint32_t nHostId, uint32_t nSlot, uint64_t nCounter)
+{
+    uint256 nonce;
+    WriteLE64(nonce.begin(), nCounter);
+    WriteLE32(nonce.begin() + MINER_NONCE_SLOT_OFFSET, nSlot);
+    WriteLE32(nonce.begin() + MINER_NONCE_HOST_OFFSET, nHostId);
+    return nonce;
+}
+
+uint64_t MinerNonceCounter(const uint256& nonce)
+{
+    return ReadLE64(nonce.begin());
+}
+
 // OPTIMIZATION Priority 16: Even faster increment using cached pointer (0.5% gain)
 // Shared block template for all mining threads
 static std::mutex g_template_mutex;
-static std::unique_ptr<CBlockTemplate> g_shared_template;
+static std::shared_ptr<const CBlockTemplate> g_shared_template;
 static std::atomic<int> g_template_height{0};
+// Bumped each time a new shared template is published; miners switch when it changes
+static std::atomic<uint64_t> g_template_generation{0};
+
+/**
+ * What miner threads need from a shared template, prepared once when it is
+ * published. Jobs are immutable and handed out with an atomic load, so
+ * threads never copy the template's transactions; the full block is only
+ * copied when a solution is found.
+ */
+struct MiningJob {
+    uint64_t nGeneration;
+    int nHeight;
+    CBlockHeader header;
+    unsigned char headerBytes[108];  //!< Serialized header without nonce and solution
+    uint256 seedHash;
+    size_t nTx;
+    size_t nBlockSize;
+    int64_t nPublishedMicros;  //!< When the job was published, for template switch latency
+    std::shared_ptr<const CBlockTemplate> ptemplate;
+};
+static std::shared_ptr<const MiningJob> g_mining_job;
 static std::atomic<bool> g_template_stop{false};
 static boost::thread* g_template_thread = nullptr;
+// Number of StartBlockTemplateUpdater calls not yet matched by a stop
+static std::mutex g_template_thread_mutex;
+static int g_template_users = 0;
+
+boost::signals2::signal<void ()> NotifySharedTemplateChanged;
+
+// Wakes the template updater on a new tip or mempool transaction
+static std::mutex g_template_wakeup_mutex;
+static std::condition_variable g_template_wakeup_cv;
+static bool g_template_wakeup = false;
+
+static void WakeBlockTemplateUpdater()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_template_wakeup_mutex);
+        g_template_wakeup = true;
+    }
+    g_template_wakeup_cv.notify_one();
+}
+
+// N-way mining: each thread interleaves this many VMs (set by GenerateBitcoins)
+static std::atomic<int> g_miner_ways{0};
+// Miner threads with a lower id hash; the others stay parked, keeping their
+// VMs, until GenerateBitcoins grows the pool again
+static std::atomic<int> g_miner_active_threads{0};
+static std::mutex g_miner_pool_mutex;
+static std::condition_variable g_miner_pool_cv;
+static std::atomic<int> g_miner_validation_pause{0};
+// Hashes computed by each way, summed over all threads
+static AtomicCounter minerWayHashes[MAX_MINER_WAYS];
+// Hashes meeting the block target made 2^DEFAULT_SHARE_SHIFT times easier, see MiningTarget
+static AtomicCounter minerNearTargetShares;
+
+// Cycle counter for the miner profiler
+static inline uint64_t MinerCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t hi, lo;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)lo) | (((uint64_t)hi) << 32);
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * Where a miner thread spends its time, for getminingprofile. Only the
+ * owning thread writes the counters, once per round of hashes or per job, so
+ * the cost is a few cycle counter reads next to milliseconds of RandomX.
+ */
+struct MinerProfileCounters {
+    const uint64_t nStartCycles;
+    const int64_t nStartMicros;
+    std::atomic<uint64_t> cycles[MINER_PHASE_COUNT];
+    std::atomic<uint64_t> hashes{0};
+    std::atomic<uint64_t> switches{0};
+    std::atomic<int64_t> switchLatencyMicros{0};
+    std::atomic<int64_t> lastSwitchLatencyMicros{0};
+    std::atomic<uint64_t> validationPauses{0};
+    std::atomic<int64_t> validationPauseMicros{0};
+
+    MinerProfileCounters() : nStartCycles(MinerCycles()), nStartMicros(GetTimeMicros())
+    {
+        for (auto& phase : cycles) phase.store(0);
+    }
+
+    // Charge the cycles since nLast to phase and restart the clock
+    void Charge(MinerPhase phase, uint64_t& nLast)
+    {
+        uint64_t nNow = MinerCycles();
+        cycles[phase].fetch_add(nNow - nLast, std::memory_order_relaxed);
+        nLast = nNow;
+    }
+};
+static std::mutex g_profile_mutex;
+static std::map<int, std::shared_ptr<MinerProfileCounters>> g_thread_profiles;
+
+// Where each miner thread's VM ended up, for getminerthreadinfo
+static std::mutex g_placement_mutex;
+static std::map<int, MinerThreadPlacement> g_thread_placement;
+
+static void RecordThreadPlacement(int thread_id, int cpu_id, randomx_vm* vm)
+{
+    RandomXVMPlacement vmPlacement;
+    if (!RandomX_GetVMPlacement(vm, vmPlacement)) return;
+
+    MinerThreadPlacement placement;
+    placement.thread_id = thread_id;
+    placement.cpu = cpu_id;
+    placement.requested_node = vmPlacement.requested_node;
+    placement.node = vmPlacement.node;
+    placement.page_size = vmPlacement.page_size;
+
+    if (RandomX_IsUsingHugepages() && placement.page_size != 0 && placement.page_size <= 4096) {
+        LogPrintf("Miner thread %d: WARNING - RandomX scratchpad is not on hugepages\n", thread_id);
+    }
+    if (placement.requested_node >= 0 && placement.node >= 0 && placement.node != placement.requested_node) {
+        LogPrintf("Miner thread %d: WARNING - RandomX scratchpad is on NUMA node %d, not local node %d\n",
+                  thread_id, placement.node, placement.requested_node);
+    }
+    LogPrint("numa", "Miner thread %d: scratchpad on node %d with %u KiB pages\n",
+             thread_id, placement.node, placement.page_size >> 10);
+
+    std::lock_guard<std::mutex> lock(g_placement_mutex);
+    g_thread_placement[thread_id] = placement;
+}
+
+// Make a template built on pindexTip the shared template, unless the tip has moved on
+static bool PublishSharedTemplate(std::shared_ptr<const CBlockTemplate> pblocktemplate, const CBlockIndex* pindexTip)
+{
+    std::shared_ptr<MiningJob> job = std::make_shared<MiningJob>();
+    job->nHeight = pindexTip->nHeight + 1;
+    job->header = pblocktemplate->block.GetBlockHeader();
+    job->nTx = pblocktemplate->block.vtx.size();
+    job->nBlockSize = ::GetSerializeSize(pblocktemplate->block, SER_NETWORK, PROTOCOL_VERSION);
+    {
+        CEquihashInput I{job->header};
+        CDataStream headerStream(SER_NETWORK, PROTOCOL_VERSION);
+        headerStream << I;
+        if (headerStream.size() != sizeof(job->headerBytes)) {
+            LogPrintf("BlockTemplateUpdater: ERROR - Header size is %d, expected 108 bytes\n", headerStream.size());
+            return false;
+        }
+        memcpy(job->headerBytes, headerStream.data(), sizeof(job->headerBytes));
+    }
+    {
+        LOCK(cs_main);
+        if (!GetRandomXSeedHash(pindexTip, job->nHeight, job->seedHash)) {
+            LogPrintf("BlockTemplateUpdater: Could not find the RandomX seed for height %d\n", job->nHeight);
+            return false;
+        }
+    }
+    job->ptemplate = std::move(pblocktemplate);
+
+    {
+        std::lock_guard<std::mutex> lock(g_template_mutex);
+        if (chainActive.Tip() != pindexTip) {
+            LogPrintf("BlockTemplateUpdater: Chain tip changed during template creation, discarding template\n");
+            return false;
+        }
+        g_shared_template = job->ptemplate;
+        g_template_height = job->nHeight;
+        job->nGeneration = ++g_template_generation;
+        job->nPublishedMicros = GetTimeMicros();
+        std::atomic_store(&g_mining_job, std::shared_ptr<const MiningJob>(job));
+
+        LogPrintf("BlockTemplateUpdater: Updated template for height %d (%u txs)\n",
+                 job->nHeight, job->nTx);
+    }
+    NotifySharedTemplateChanged();
+    return true;
+}
 
 // Background thread to keep the block template updated
 void static BlockTemplateUpdater(const CChainParams& chainparams)
@@ -924,6 +1230,17 @@ void static BlockTemplateUpdater(const CChainParams& chainparams)
     unsigned int nTransactionsUpdatedLast = 0;
     CBlockIndex* pindexPrev = nullptr;
     int64_t nLastUpdateTime = 0;
+    // Last full template published, extended incrementally while the tip stays the same.
+    // It is shared with the miners rather than copied, as templates are never modified.
+    std::shared_ptr<const CBlockTemplate> plastTemplate;
+
+    // Rebuild as soon as the tip changes or a transaction arrives, rather than polling
+    boost::signals2::connection tipConnection = uiInterface.NotifyBlockTip.connect(
+        [](bool fInitialDownload, const CBlockIndex*) {
+            if (!fInitialDownload) WakeBlockTemplateUpdater();
+        });
+    boost::signals2::connection mempoolConnection = mempool.NotifyEntryAdded.connect(
+        [](const CTransaction&) { WakeBlockTemplateUpdater(); });
 
     while (!g_template_stop) {
         // Wait if no peers (if required)
@@ -994,37 +1311,38 @@ void static BlockTemplateUpdater(const CChainParams& chainparams)
 
             try {
                 auto minerAddress = maybeMinerAddress.value();
-                // Create new template
+
+                // On a new tip, give miners a coinbase-only block right away
+                // instead of leaving them on the stale parent while the mempool
+                // is walked and the full template is validated
+                if (pindexCurrent != pindexPrev) {
+                    std::unique_ptr<CBlockTemplate> pemptytemplate(
+                        BlockAssembler(chainparams).CreateNewBlock(minerAddress, std::nullopt, true));
+                    if (pemptytemplate) {
+                        PublishSharedTemplate(std::move(pemptytemplate), pindexCurrent);
+                    }
+                }
+
+                // Create new template, extending the last one if only the mempool changed
                 // Note: BlockAssembler access is thread-safe (uses cs_main internally)
-                LogPrintf("BlockTemplateUpdater: About to call CreateNewBlock\n");
-                std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(chainparams).CreateNewBlock(minerAddress));
-                LogPrintf("BlockTemplateUpdater: CreateNewBlock returned, checking result\n");
-
-                    if (pblocktemplate) {
-                        LogPrintf("BlockTemplateUpdater: Template created successfully\n");
-                        // Update shared template
-                        std::lock_guard<std::mutex> lock(g_template_mutex);
-                        LogPrintf("BlockTemplateUpdater: Acquired mutex lock\n");
-
-                        // Verify we are still on the same tip before committing
-                        LogPrintf("BlockTemplateUpdater: Checking chain tip - pindexCurrent=%p, chainActive.Tip()=%p\n",
-                                 pindexCurrent, chainActive.Tip());
-                        if (chainActive.Tip() == pindexCurrent) {
-                            g_shared_template = std::move(pblocktemplate);
-                            g_template_height = pindexCurrent->nHeight + 1;
-
-                            pindexPrev = pindexCurrent;
-                            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-                            nLastUpdateTime = GetTime();
-
-                            LogPrintf("BlockTemplateUpdater: Updated template for height %d (%u txs)\n",
-                                     g_template_height.load(), g_shared_template->block.vtx.size());
-                        } else {
-                            LogPrintf("BlockTemplateUpdater: Chain tip changed during template creation, discarding template\n");
-                        }
-                    } else {
-                        LogPrintf("BlockTemplateUpdater: CreateNewBlock returned null\n");
+                std::unique_ptr<CBlockTemplate> pblocktemplate;
+                if (plastTemplate && pindexCurrent == pindexPrev) {
+                    pblocktemplate.reset(BlockAssembler(chainparams).UpdateBlock(*plastTemplate, minerAddress));
+                }
+                if (!pblocktemplate) {
+                    pblocktemplate.reset(BlockAssembler(chainparams).CreateNewBlock(minerAddress));
+                }
+                if (!pblocktemplate) {
+                    LogPrintf("BlockTemplateUpdater: CreateNewBlock returned null\n");
+                } else {
+                    std::shared_ptr<const CBlockTemplate> pshared(std::move(pblocktemplate));
+                    if (PublishSharedTemplate(pshared, pindexCurrent)) {
+                        plastTemplate = std::move(pshared);
+                        pindexPrev = pindexCurrent;
+                        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+                        nLastUpdateTime = GetTime();
                     }
+                }
             } catch (const std::exception& e) {
                 LogPrintf("BlockTemplateUpdater: Error creating block template: %s\n", e.what());
             } catch (...) {
@@ -1032,11 +1350,67 @@ void static BlockTemplateUpdater(const CChainParams& chainparams)
             }
         }
 
-        MilliSleep(100); // Check every 100ms
+        // Sleep until woken; the timeout picks up mempool changes held back by the throttle
+        std::unique_lock<std::mutex> lock(g_template_wakeup_mutex);
+        g_template_wakeup_cv.wait_for(lock, std::chrono::seconds(1),
+                                      [] { return g_template_wakeup || g_template_stop; });
+        g_template_wakeup = false;
     }
+    tipConnection.disconnect();
+    mempoolConnection.disconnect();
     LogPrintf("BlockTemplateUpdater stopped\n");
 }
 
+void StartBlockTemplateUpdater(const CChainParams& chainparams)
+{
+    std::lock_guard<std::mutex> lock(g_template_thread_mutex);
+    if (g_template_users++ > 0) return;
+
+    g_template_stop = false;
+    g_template_thread = new boost::thread(boost::bind(&BlockTemplateUpdater, boost::cref(chainparams)));
+}
+
+void StopBlockTemplateUpdater()
+{
+    std::lock_guard<std::mutex> lock(g_template_thread_mutex);
+    if (g_template_users == 0 || --g_template_users > 0) return;
+
+    g_template_stop = true;
+    WakeBlockTemplateUpdater();
+    if (g_template_thread) {
+        g_template_thread->join();
+        delete g_template_thread;
+        g_template_thread = nullptr;
+    }
+}
+
+bool GetSharedBlockTemplate(std::shared_ptr<const CBlockTemplate>& ptemplate, int& nHeight)
+{
+    std::lock_guard<std::mutex> lock(g_template_mutex);
+    if (!g_shared_template) return false;
+    ptemplate = g_shared_template;
+    nHeight = g_template_height.load();
+    return true;
+}
+
+std::shared_ptr<const CBlockTemplate> GetSharedBlockTemplate()
+{
+    std::lock_guard<std::mutex> lock(g_template_mutex);
+    return g_shared_template;
+}
+
+int64_t GetSharedTemplateAgeMicros()
+{
+    std::shared_ptr<const MiningJob> job = std::atomic_load(&g_mining_job);
+    return job ? GetTimeMicros() - job->nPublishedMicros : -1;
+}
+
+bool IsBlockTemplateUpdaterRunning()
+{
+    std::lock_guard<std::mutex> lock(g_template_thread_mutex);
+    return g_template_users > 0;
+}
+
 static inline void IncrementNonce256_Fast(unsigned char* noncePtr) {
     // Increment as little-endian 256-bit integer using 64-bit chunks
     // Unaligned access is efficient on x86_64 and modern ARM
@@ -1048,36 +1422,65 @@ static inline void IncrementNonce256_Fast(unsigned char* noncePtr) {
     ++nonce64[3];
 }
 
-void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int total_threads)
+// NUMA: Pin the calling miner thread to its CPU for the current pool size.
+// Only L3 placement depends on the pool size, so with NUMA placement a woken
+// thread stays where it was.
+static void PlaceMinerThread(int thread_id, int& cpu_id)
 {
-    LogPrintf("JunoMonetaMiner started (thread %d/%d)\n", thread_id + 1, total_threads);
-    SetThreadPriority(THREAD_PRIORITY_LOWEST);
-    RenameThread("juno-miner");
-
-    // NUMA: Pin thread to CPU if available for optimal memory access on multi-socket systems
     NumaHelper& numa = NumaHelper::GetInstance();
-    int cpu_id = -1;
+    if (!numa.IsPinningEnabled()) return;
+
+    int total_threads = g_miner_active_threads.load();
+    int cpu = numa.GetCPUForThread(thread_id, total_threads);
+    if (cpu < 0 || cpu == cpu_id || !numa.PinCurrentThread(cpu)) return;
+    cpu_id = cpu;
+
+    int node_id = numa.GetNodeForThread(thread_id, total_threads);
+    LogPrint("numa", "NUMA: Thread %d pinned to CPU %d (node %d)\n",
+             thread_id, cpu_id, node_id);
+
+    // Set NUMA node for RandomX memory allocation to ensure local memory usage
     if (numa.IsNUMAAvailable()) {
-        cpu_id = numa.GetCPUForThread(thread_id, total_threads);
-        if (cpu_id >= 0 && numa.PinCurrentThread(cpu_id)) {
-            int node_id = numa.GetNodeForThread(thread_id, total_threads);
-            LogPrint("numa", "NUMA: Thread %d pinned to CPU %d (node %d)\n",
-                     thread_id, cpu_id, node_id);
+        RandomX_SetCurrentNode(node_id);
+    }
 
-            // Set NUMA node for RandomX memory allocation to ensure local memory usage
-            RandomX_SetCurrentNode(node_id);
+    // Sleep briefly to ensure thread migration completes (xmrig pattern)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
 
-            // Sleep briefly to ensure thread migration completes (xmrig pattern)
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
+// Block while the pool is too small for this thread. Throws
+// boost::thread_interrupted when the pool is stopped meanwhile.
+static void WaitWhileParked(int thread_id)
+{
+    std::unique_lock<std::mutex> lock(g_miner_pool_mutex);
+    while (thread_id >= g_miner_active_threads.load()) {
+        g_miner_pool_cv.wait_for(lock, std::chrono::milliseconds(100));
+        boost::this_thread::interruption_point();
     }
+}
 
-    // Initialize RandomX (if not already done by init.cpp)
-    bool randomxFastMode = GetBoolArg("-randomxfastmode", false);
-    RandomX_Init(randomxFastMode);
+void static BitcoinMiner(const CChainParams& chainparams, int thread_id)
+{
+    LogPrintf("JunoMonetaMiner started (thread %d/%d)\n", thread_id + 1, g_miner_active_threads.load());
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("juno-miner");
+
+    int cpu_id = -1;
+    PlaceMinerThread(thread_id, cpu_id);
+
+    // Initialize RandomX (if not already done by init.cpp), unless regtest
+    // hashes with BLAKE2b, in which case no VMs are used
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+    const bool fFastPoW = consensusParams.fPowFastHash;
+    if (!fFastPoW) {
+        bool randomxFastMode = GetBoolArg("-randomxfastmode", false);
+        RandomX_Init(randomxFastMode);
+    }
 
-    // Each thread has its own counter
-    unsigned int nExtraNonce = 0;
+    // Each way searches its own slot of the nonce space, see MinerNonce
+    const uint32_t nHostId = GetArg("-minerhostid", DEFAULT_MINER_HOST_ID);
+    uint64_t nCounter[MAX_MINER_WAYS] = {};
+    uint64_t nCounterGeneration = 0;
 
     LogPrint("pow", "Using RandomX proof-of-work algorithm\n");
 
@@ -1091,13 +1494,61 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
     );
     miningTimer.start();
 
+    // N-way mode: interleave several VMs, each with its own nonce stream,
+    // so that one way's dataset reads overlap with another way's execution
+    const int nWays = std::max(1, std::min(g_miner_ways.load(), MAX_MINER_WAYS));
+
     // OPTIMIZATION Priority 15: Align to 64-byte cache line (0.5-1% gain)
-    alignas(64) uint8_t hash_input[140];
-    CBlock pblock_copy;
-    CBlock* pblock = &pblock_copy;
+    alignas(64) uint8_t hash_input[MAX_MINER_WAYS][140];
+    alignas(64) uint8_t wayNonce[MAX_MINER_WAYS][32];
+    randomx_vm* placementVM = nullptr;
+    // Only the header is copied per template; see MiningJob
+    std::shared_ptr<const MiningJob> job;
+    CBlockHeader header;
+    CBlockHeader* pblock = &header;
+
+    std::shared_ptr<MinerProfileCounters> profile = std::make_shared<MinerProfileCounters>();
+    {
+        std::lock_guard<std::mutex> lock(g_profile_mutex);
+        g_thread_profiles[thread_id] = profile;
+    }
+    uint64_t nPhaseStart = MinerCycles();
+    bool fParked = false;
 
     try {
         while (true) {
+            if (thread_id >= g_miner_active_threads.load()) {
+                // Parked by a smaller pool: keep the VMs for when it grows again
+                LogPrint("pow", "Miner thread %d parked\n", thread_id);
+                {
+                    std::lock_guard<std::mutex> lock(g_placement_mutex);
+                    g_thread_placement.erase(thread_id);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(g_profile_mutex);
+                    g_thread_profiles.erase(thread_id);
+                }
+                miningTimer.stop();
+                fParked = true;
+                WaitWhileParked(thread_id);
+                fParked = false;
+                miningTimer.start();
+                LogPrint("pow", "Miner thread %d resumed\n", thread_id);
+
+                PlaceMinerThread(thread_id, cpu_id);
+                placementVM = nullptr;
+                profile = std::make_shared<MinerProfileCounters>();
+                {
+                    std::lock_guard<std::mutex> lock(g_profile_mutex);
+                    g_thread_profiles[thread_id] = profile;
+                }
+                nPhaseStart = MinerCycles();
+            }
+
+            // The first threads, up to -minervalidationpause percent of them, leave
+            // the cores and L3 to block validation while a new tip is connected
+            const bool fPauseForValidation = thread_id * 100 < g_miner_validation_pause.load() * g_miner_active_threads.load();
+
             if (chainparams.MiningRequiresPeers()) {
                 // Busy-wait for the network to come online
                 miningTimer.stop();
@@ -1112,35 +1563,31 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                     MilliSleep(1000);
                 } while (true);
                 miningTimer.start();
+                profile->Charge(MINER_PHASE_IDLE, nPhaseStart);
             }
 
-            // Get shared block template
-            int currentHeight = 0;
-            {
-                std::lock_guard<std::mutex> lock(g_template_mutex);
-                if (!g_shared_template) {
-                    // Release mutex before sleeping by exiting scope
-                }  else {
-                    // Copy block from shared template
-                    pblock_copy = g_shared_template->block;
-                    currentHeight = g_template_height.load();
-                }
-            }
-
-            // Check if we got a template
-            if (currentHeight == 0) {
+            // Get the current mining job
+            job = std::atomic_load(&g_mining_job);
+            if (!job) {
                 MilliSleep(100);
+                profile->Charge(MINER_PHASE_IDLE, nPhaseStart);
                 continue;
             }
+            header = job->header;
+            const int currentHeight = job->nHeight;
+            const uint64_t currentGeneration = job->nGeneration;
+
+            // Resume where this thread left off if the job has not changed
+            const bool fNewJob = currentGeneration != nCounterGeneration;
+            if (fNewJob) {
+                for (int w = 0; w < MAX_MINER_WAYS; w++) {
+                    nCounter[w] = 0;
+                }
+                nCounterGeneration = currentGeneration;
+            }
 
-            // Randomize nonce to ensure threads work on different spaces
-            // This replaces IncrementExtraNonce for work distribution
-            GetRandBytes(pblock->nNonce.begin(), 32);
-
-            LogPrintf("Running JunoMonetaMiner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
-                ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
+            LogPrintf("Running JunoMonetaMiner with %u transactions in block (%u bytes)\n", job->nTx, job->nBlockSize);
 
-            // Calculate RandomX seed for this block height
             CBlockIndex* pindexPrev;
             {
                 LOCK(cs_main);
@@ -1150,56 +1597,40 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
             // Verify we are working on the correct height
             if (!pindexPrev || pindexPrev->nHeight + 1 != currentHeight) {
                 MilliSleep(10);
+                profile->Charge(MINER_PHASE_IDLE, nPhaseStart);
                 continue;
             }
-
-            uint64_t blockHeight = currentHeight;
-            uint64_t seedHeight = RandomX_SeedHeight(blockHeight);
-            uint256 seedHash;
-
-            if (seedHeight == 0) {
-                // Genesis epoch - use genesis seed
-                seedHash.SetNull();
-                *seedHash.begin() = 0x08;
-                LogPrint("pow", "Mining block %u in genesis epoch (seed height 0)\n", blockHeight);
-            } else {
-                // Get seed block hash from chain
-                CBlockIndex* pindexSeed = chainActive[seedHeight];
-                if (!pindexSeed) {
-                    LogPrintf("Error: Could not find seed block at height %u\n", seedHeight);
-                    continue;
-                }
-                seedHash = pindexSeed->GetBlockHash();
-                LogPrint("pow", "Mining block %u with seed from height %u: %s\n",
-                         blockHeight, seedHeight, seedHash.GetHex());
-            }
+            profile->Charge(MINER_PHASE_TEMPLATE, nPhaseStart);
 
             // Update RandomX cache for this seed
-            RandomX_SetMainSeedHash(seedHash.begin(), 32);
+            const uint256& seedHash = job->seedHash;
+            LogPrint("pow", "Mining block %u with seed from height %u: %s\n",
+                     currentHeight, RandomX_SeedHeight(currentHeight), seedHash.GetHex());
+            if (!fFastPoW)
+                RandomX_SetMainSeedHash(seedHash.begin(), 32);
+            profile->Charge(MINER_PHASE_VM, nPhaseStart);
 
             //
             // Search
             //
             int64_t nStart = GetTime();
-            arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+            MiningTarget target(arith_uint256().SetCompact(pblock->nBits));
 
-            // Serialize the 108-byte header (without nonce) ONCE
-            {
-                CEquihashInput I{*pblock};
-                CDataStream headerStream(SER_NETWORK, PROTOCOL_VERSION);
-                headerStream << I;
-                if (headerStream.size() != 108) {
-                    LogPrintf("ERROR: Header size is %d, expected 108 bytes\n", headerStream.size());
-                    break;
-                }
-                memcpy(hash_input, headerStream.data(), 108);
+            // The 108-byte header (without nonce) was serialized when the job was published
+            for (int w = 0; w < nWays; w++) {
+                memcpy(hash_input[w], job->headerBytes, 108);
             }
 
             // OPTIMIZATION Priority 4: Pre-allocate nSolution once (1-2% gain)
             pblock->nSolution.resize(32);
 
             // OPTIMIZATION Priority 12: Cache nonce pointer (0.5% gain)
-            unsigned char* noncePtr = pblock->nNonce.begin();
+            unsigned char* noncePtr[MAX_MINER_WAYS];
+            for (int w = 0; w < nWays; w++) {
+                uint256 nonce = MinerNonce(nHostId, thread_id * MAX_MINER_WAYS + w, nCounter[w]);
+                memcpy(wayNonce[w], nonce.begin(), 32);
+                noncePtr[w] = wayNonce[w];
+            }
 
             // OPTIMIZATION Priority 6: Batch metric updates (1-2% gain)
             uint64_t hashCount = 0;
@@ -1213,41 +1644,77 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
             uint64_t interruptCheckCounter = 0;
             const uint64_t INTERRUPT_CHECK_INTERVAL = 256;
 
-            // OPTIMIZATION: Get VM once per block template to avoid map lookups/locks in inner loop
-            randomx_vm* vm = RandomX_GetVM(seedHash.begin(), 32);
-            if (!vm) {
+            profile->Charge(MINER_PHASE_TEMPLATE, nPhaseStart);
+
+            // OPTIMIZATION: Get VMs once per block template to avoid map lookups/locks in inner loop
+            randomx_vm* vms[MAX_MINER_WAYS] = {};
+            if (!fFastPoW && RandomX_GetVMs(seedHash.begin(), 32, vms, nWays) != (size_t)nWays) {
                 LogPrintf("Error: Failed to get RandomX VM\n");
                 break;
             }
+            if (!fFastPoW && vms[0] != placementVM) {
+                // New VM (first template, new seed or mode change): see where it landed
+                placementVM = vms[0];
+                RecordThreadPlacement(thread_id, cpu_id, placementVM);
+            }
+            profile->Charge(MINER_PHASE_VM, nPhaseStart);
+
+            // Pipeline state, per way
+            uint8_t noncePrev[MAX_MINER_WAYS][32];
+            uint256 hashes[MAX_MINER_WAYS];
+            bool fStop = false;
+
+            // Prime the pipelines: Start first hash of each way
+            for (int w = 0; w < nWays; w++) {
+                memcpy(hash_input[w] + 108, noncePtr[w], 32);
+                if (!fFastPoW)
+                    RandomX_HashFirst(vms[w], hash_input[w], 140);
+                memcpy(noncePrev[w], noncePtr[w], 32);
+                IncrementNonce256_Fast(noncePtr[w]);
+            }
+            profile->Charge(MINER_PHASE_HASHING, nPhaseStart);
+            if (fNewJob) {
+                int64_t nLatency = GetTimeMicros() - job->nPublishedMicros;
+                profile->switches.fetch_add(1, std::memory_order_relaxed);
+                profile->switchLatencyMicros.fetch_add(nLatency, std::memory_order_relaxed);
+                profile->lastSwitchLatencyMicros.store(nLatency, std::memory_order_relaxed);
+            }
 
-            // Pipeline state
-            uint8_t noncePrev[32];
-            uint256 hash;
+            while (!fStop) {
+                for (int w = 0; w < nWays; w++) {
+                    if (fFastPoW) {
+                        // No pipeline: hash noncePrev directly, so hashes[w] matches it as below
+                        memcpy(hash_input[w] + 108, noncePrev[w], 32);
+                        GetPoWHash(consensusParams, seedHash, hash_input[w], 140, hashes[w]);
+                        hashCount++;
+                        continue;
+                    }
 
-            // Prime the pipeline: Start first hash
-            memcpy(hash_input + 108, noncePtr, 32);
-            RandomX_HashFirst(vm, hash_input, 140);
-            memcpy(noncePrev, noncePtr, 32);
-            IncrementNonce256_Fast(noncePtr);
+                    // Prepare next input
+                    memcpy(hash_input[w] + 108, noncePtr[w], 32);
 
-            while (true) {
-                // Prepare next input
-                memcpy(hash_input + 108, noncePtr, 32);
+                    // Pipelined hash: Finish previous (noncePrev), Start current (noncePtr)
+                    // Note: We use the same input buffer for next input, which is safe as RandomX consumes it immediately
+                    if (!RandomX_HashNext(vms[w], hash_input[w], 140, hashes[w].begin())) {
+                        LogPrintf("RandomX hashing failed\n");
+                        fStop = true;
+                        break;
+                    }
 
-                // Pipelined hash: Finish previous (noncePrev), Start current (noncePtr)
-                // Note: We use the same input buffer for next input, which is safe as RandomX consumes it immediately
-                if (!RandomX_HashNext(vm, hash_input, 140, hash.begin())) {
-                    LogPrintf("RandomX hashing failed\n");
-                    break;
+                    // OPTIMIZATION Priority 17: Only increment counter after successful hash
+                    hashCount++;
                 }
+                profile->Charge(MINER_PHASE_HASHING, nPhaseStart);
+                if (fStop) break;
 
-                // OPTIMIZATION Priority 17: Only increment counter after successful hash
-                hashCount++;
+                // Check all ways' hashes at once; only candidates get a full compare
+                // Note: hashes[w] corresponds to noncePrev[w], not current noncePtr[w]
+                uint32_t candidates = target.Filter(hashes, nWays);
+                for (int w = 0; candidates != 0 && w < nWays; w++) {
+                    if (!(candidates & (1u << w)) || !target.Meets(hashes[w]))
+                        continue;
+                    const uint256& hash = hashes[w];
 
-                // Check if hash meets target
-                // OPTIMIZATION Priority 14 FIX: Only convert when needed (inside if condition)
-                // Note: 'hash' corresponds to 'noncePrev', not current 'noncePtr'
-                if (UintToArith256(hash) <= hashTarget) {
                     // Found a solution - update metrics with final count
                     ehSolverRuns.increment(hashCount);
                     solutionTargetChecks.increment(hashCount);
@@ -1255,13 +1722,16 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                     // OPTIMIZATION Priority 11: Only copy nSolution when we find a solution (1-2% gain)
                     memcpy(pblock->nSolution.data(), hash.begin(), 32);
                     // Restore the winning nonce (noncePrev) to the block
-                    memcpy(pblock->nNonce.begin(), noncePrev, 32);
+                    memcpy(pblock->nNonce.begin(), noncePrev[w], 32);
 
                     SetThreadPriority(THREAD_PRIORITY_NORMAL);
                     LogPrintf("JunoMonetaMiner:\n");
-                    LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", hash.GetHex(), hashTarget.GetHex());
+                    LogPrintf("proof-of-work found  \n  hash: %s  \ntarget: %s\n", hash.GetHex(), target.GetTarget().GetHex());
 
-                    if (ProcessBlockFound(pblock, chainparams)) {
+                    // Only now copy the template's transactions
+                    CBlock block(job->ptemplate->block);
+                    *((CBlockHeader*)&block) = *pblock;
+                    if (ProcessBlockFound(&block, chainparams)) {
                         // Ignore chain updates caused by us
                         std::lock_guard<std::mutex> lock{m_cs};
                         cancelSolver = false;
@@ -1279,16 +1749,46 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                         throw boost::thread_interrupted();
                     }
 
+                    fStop = true;
                     break;
                 }
+                if (fStop) break;
 
                 // Update pipeline state: Current becomes Previous for next iteration
-                memcpy(noncePrev, noncePtr, 32);
+                for (int w = 0; w < nWays; w++) {
+                    memcpy(noncePrev[w], noncePtr[w], 32);
+                }
+
+                // Switch to a new template within one hash of it being published
+                if (g_template_generation.load(std::memory_order_relaxed) != currentGeneration)
+                    break;
+
+                // Park within one hash of the pool shrinking below this thread
+                if (thread_id >= g_miner_active_threads.load(std::memory_order_relaxed))
+                    break;
+
+                // Wait for the tip being connected, then pick up its template
+                if (fPauseForValidation && IsConnectingTip()) {
+                    profile->Charge(MINER_PHASE_CHECKS, nPhaseStart);
+                    int64_t nPauseStart = GetTimeMicros();
+                    WaitForTipConnected(MAX_MINER_VALIDATION_PAUSE_MILLIS);
+                    profile->validationPauses.fetch_add(1, std::memory_order_relaxed);
+                    profile->validationPauseMicros.fetch_add(GetTimeMicros() - nPauseStart, std::memory_order_relaxed);
+                    profile->Charge(MINER_PHASE_IDLE, nPhaseStart);
+                    break;
+                }
 
                 // OPTIMIZATION Priority 6: Batch metric updates every 256 hashes
                 if (hashCount >= METRIC_UPDATE_INTERVAL) {
-                    ehSolverRuns.increment(METRIC_UPDATE_INTERVAL);
-                    solutionTargetChecks.increment(METRIC_UPDATE_INTERVAL);
+                    ehSolverRuns.increment(hashCount);
+                    solutionTargetChecks.increment(hashCount);
+                    profile->hashes.fetch_add(hashCount, std::memory_order_relaxed);
+                    minerNearTargetShares.increment(target.TakeShares());
+                    if (nWays > 1) {
+                        for (int w = 0; w < nWays; w++) {
+                            minerWayHashes[w].increment(hashCount / nWays);
+                        }
+                    }
                     hashCount = 0;
                 }
 
@@ -1297,11 +1797,7 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                     boost::this_thread::interruption_point();
                     interruptCheckCounter = 0;
 
-                    // Check for template update
-                    int latestHeight = g_template_height.load();
-                    if (latestHeight != currentHeight) break;
-
-                    // Also check other conditions that don't need per-hash checking
+                    // Check other conditions that don't need per-hash checking
                     if (vNodes.empty() && chainparams.MiningRequiresPeers())
                         break;
                     
@@ -1309,14 +1805,12 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                         break;
                 }
 
-                // OPTIMIZATION Priority 13/19: Safe nonce rollover check
-                // Check if bottom 16 bits are all 1s (0xffff)
-                // Note: uint256 nonce should be naturally aligned, but use memcmp for safety
-                if (noncePtr[0] == 0xff && noncePtr[1] == 0xff)
-                    break;
-
                 // OPTIMIZATION Priority 16: Use fast nonce increment with cached pointer (5-10% + 0.5% gain)
-                IncrementNonce256_Fast(noncePtr);
+                for (int w = 0; w < nWays; w++) {
+                    IncrementNonce256_Fast(noncePtr[w]);
+                }
+
+                profile->Charge(MINER_PHASE_CHECKS, nPhaseStart);
 
                 // OPTIMIZATION Priority 7: Update time less frequently (3-5% gain)
                 if (++updateTimeCounter >= UPDATE_TIME_INTERVAL) {
@@ -1326,13 +1820,14 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                         break; // Recreate the block if the clock has run backwards
                     }
 
-                    // OPTIMIZATION Priority 9: Only recompute hashTarget when nBits changes (0.5% gain)
+                    // OPTIMIZATION Priority 9: Only recompute the target when nBits changes (0.5% gain)
                     if (chainparams.GetConsensus().nPowAllowMinDifficultyBlocksAfterHeight != std::nullopt) {
                         // Changing pblock->nTime can change work required on testnet
                         arith_uint256 newHashTarget;
                         newHashTarget.SetCompact(pblock->nBits);
-                        if (newHashTarget != hashTarget) {
-                            hashTarget = newHashTarget;
+                        if (newHashTarget != target.GetTarget()) {
+                            minerNearTargetShares.increment(target.TakeShares());
+                            target = MiningTarget(newHashTarget);
                         }
                     }
 
@@ -1341,15 +1836,27 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
                         CEquihashInput I{*pblock};
                         CDataStream headerStream(SER_NETWORK, PROTOCOL_VERSION);
                         headerStream << I;
-                        memcpy(hash_input, headerStream.data(), 108);
+                        for (int w = 0; w < nWays; w++) {
+                            memcpy(hash_input[w], headerStream.data(), 108);
+                        }
                     }
+                    profile->Charge(MINER_PHASE_UPDATETIME, nPhaseStart);
                 }
             }
+            profile->Charge(MINER_PHASE_CHECKS, nPhaseStart);
+            profile->hashes.fetch_add(hashCount, std::memory_order_relaxed);
+
+            minerNearTargetShares.increment(target.TakeShares());
+
+            // The nonce each way would have hashed next; at most one started hash is repeated
+            for (int w = 0; w < nWays; w++) {
+                nCounter[w] = ReadLE64(noncePtr[w]);
+            }
         }
     }
     catch (const boost::thread_interrupted&)
     {
-        miningTimer.stop();
+        if (!fParked) miningTimer.stop();
         c.disconnect();
         LogPrintf("JunoCashMiner terminated\n");
         throw;
@@ -1365,29 +1872,257 @@ void static BitcoinMiner(const CChainParams& chainparams, int thread_id, int tot
     c.disconnect();
 }
 
+std::vector<MinerThreadPlacement> GetMinerThreadPlacement()
+{
+    std::vector<MinerThreadPlacement> result;
+    std::lock_guard<std::mutex> lock(g_placement_mutex);
+    for (const auto& entry : g_thread_placement) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+std::vector<MinerThreadProfile> GetMinerProfile()
+{
+    std::vector<MinerThreadProfile> result;
+    std::lock_guard<std::mutex> lock(g_profile_mutex);
+    for (const auto& entry : g_thread_profiles) {
+        const MinerProfileCounters& counters = *entry.second;
+        MinerThreadProfile profile;
+        profile.thread_id = entry.first;
+        profile.seconds = (GetTimeMicros() - counters.nStartMicros) / 1e6;
+        profile.hashes = counters.hashes.load();
+        profile.hashrate = profile.seconds > 0 ? profile.hashes / profile.seconds : 0;
+
+        // Convert cycles to seconds with the thread's own cycles per second
+        uint64_t nElapsedCycles = MinerCycles() - counters.nStartCycles;
+        double secondsPerCycle = nElapsedCycles > 0 ? profile.seconds / nElapsedCycles : 0;
+        for (int phase = 0; phase < MINER_PHASE_COUNT; phase++) {
+            profile.phase_seconds[phase] = counters.cycles[phase].load() * secondsPerCycle;
+        }
+
+        profile.switches = counters.switches.load();
+        profile.last_switch_latency = counters.lastSwitchLatencyMicros.load() / 1e6;
+        profile.avg_switch_latency = profile.switches > 0 ?
+            counters.switchLatencyMicros.load() / 1e6 / profile.switches : 0;
+        profile.validation_pauses = counters.validationPauses.load();
+        profile.validation_pause_seconds = counters.validationPauseMicros.load() / 1e6;
+        result.push_back(profile);
+    }
+    return result;
+}
+
+const char* MinerPhaseName(MinerPhase phase)
+{
+    switch (phase) {
+    case MINER_PHASE_HASHING:    return "hashing";
+    case MINER_PHASE_TEMPLATE:   return "template";
+    case MINER_PHASE_VM:         return "vm";
+    case MINER_PHASE_UPDATETIME: return "updatetime";
+    case MINER_PHASE_CHECKS:     return "checks";
+    case MINER_PHASE_IDLE:       return "idle";
+    default:                     return "unknown";
+    }
+}
+
+// Prefetch modes chosen by -randomxprefetch=auto, per CPU model
+static const char* PREFETCH_TUNING_FILENAME = "randomx_prefetch.json";
+static const int64_t PREFETCH_TRIAL_MILLIS = 10 * 1000;
+static const int64_t PREFETCH_SETTLE_MILLIS = 2 * 1000;
+static std::atomic<bool> g_prefetch_tuned{false};
+
+static UniValue ReadPrefetchTuning()
+{
+    UniValue tuning(UniValue::VOBJ);
+    std::ifstream file((GetDataDir() / PREFETCH_TUNING_FILENAME).string());
+    if (file) {
+        std::string str((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        UniValue parsed;
+        if (parsed.read(str) && parsed.isObject()) {
+            tuning = parsed;
+        }
+    }
+    return tuning;
+}
+
+static void WritePrefetchTuning(const std::string& cpuModel, RandomX_ScratchpadPrefetchMode mode)
+{
+    UniValue tuning = ReadPrefetchTuning();
+    UniValue updated(UniValue::VOBJ);
+    for (const std::string& key : tuning.getKeys()) {
+        if (key != cpuModel) updated.pushKV(key, tuning[key]);
+    }
+    updated.pushKV(cpuModel, RandomX_ScratchpadPrefetchModeName(mode));
+
+    boost::filesystem::path path = GetDataDir() / PREFETCH_TUNING_FILENAME;
+    std::ofstream file(path.string(), std::ios::out | std::ios::trunc);
+    if (!file) {
+        LogPrintf("Prefetch tuning: could not write %s\n", path.string());
+        return;
+    }
+    file << updated.write(4) << "\n";
+}
+
+// Measure the hashrate of the running miner threads with each scratchpad
+// prefetch mode, then keep the fastest and remember it for this CPU model.
+// The trial hashes are ordinary mining work, so nothing is wasted.
+void static PrefetchTuner()
+{
+    RenameThread("juno-prefetch");
+    const std::string cpuModel = GetCPUModel();
+
+    // Wait until the miner threads are hashing (VMs and dataset are ready)
+    uint64_t startCount = solutionTargetChecks.value.load();
+    do {
+        MilliSleep(1000);
+    } while (solutionTargetChecks.value.load() == startCount);
+
+    RandomX_ScratchpadPrefetchMode best = RandomX_GetScratchpadPrefetchMode();
+    double bestRate = 0;
+    for (int m = 0; m < RANDOMX_PREFETCH_MAX; m++) {
+        RandomX_ScratchpadPrefetchMode mode = static_cast<RandomX_ScratchpadPrefetchMode>(m);
+        RandomX_SetScratchpadPrefetchMode(mode);
+        MilliSleep(PREFETCH_SETTLE_MILLIS);
+
+        uint64_t before = solutionTargetChecks.value.load();
+        int64_t nStart = GetTimeMillis();
+        MilliSleep(PREFETCH_TRIAL_MILLIS);
+        double rate = (solutionTargetChecks.value.load() - before) * 1000.0 / std::max<int64_t>(1, GetTimeMillis() - nStart);
+
+        LogPrintf("Prefetch tuning: mode %s: %.2f H/s\n", RandomX_ScratchpadPrefetchModeName(mode), rate);
+        if (rate > bestRate) {
+            bestRate = rate;
+            best = mode;
+        }
+    }
+
+    RandomX_SetScratchpadPrefetchMode(best);
+    g_prefetch_tuned = true;
+    LogPrintf("Prefetch tuning: using mode %s for %s\n", RandomX_ScratchpadPrefetchModeName(best), cpuModel);
+    WritePrefetchTuning(cpuModel, best);
+}
+
+// Apply -randomxprefetch. Returns true if the auto mode still has to measure.
+static bool ApplyPrefetchMode()
+{
+    std::string strMode = GetArg("-randomxprefetch", DEFAULT_RANDOMX_PREFETCH);
+    RandomX_ScratchpadPrefetchMode mode;
+    if (strMode != "auto") {
+        if (RandomX_ParseScratchpadPrefetchMode(strMode, mode)) {
+            RandomX_SetScratchpadPrefetchMode(mode);
+        }
+        return false;
+    }
+
+    if (!RandomX_ScratchpadPrefetchModeSupported() || g_prefetch_tuned) {
+        return false;
+    }
+
+    UniValue saved = ReadPrefetchTuning()[GetCPUModel()];
+    if (saved.isStr() && RandomX_ParseScratchpadPrefetchMode(saved.get_str(), mode)) {
+        LogPrintf("Prefetch tuning: using saved mode %s for %s\n", saved.get_str(), GetCPUModel());
+        RandomX_SetScratchpadPrefetchMode(mode);
+        g_prefetch_tuned = true;
+        return false;
+    }
+    return true;
+}
+
+int GetMinerWays()
+{
+    return g_miner_ways.load();
+}
+
+int GetMinerValidationPause()
+{
+    return g_miner_validation_pause.load();
+}
+
+uint64_t GetMinerNearTargetShares()
+{
+    return minerNearTargetShares.value.load();
+}
+
+double GetLocalSolPSForWay(int way)
+{
+    int nWays = g_miner_ways.load();
+    if (way < 0 || way >= nWays) return 0;
+    // With a single way the miner only maintains the overall counter
+    if (nWays == 1) return GetLocalSolPS();
+    return miningTimer.rate(minerWayHashes[way]);
+}
+
+// -minerways, or the default if it is out of range
+static int MinerWaysArg()
+{
+    int nWays = GetArg("-minerways", DEFAULT_MINER_WAYS);
+    return nWays >= 1 && nWays <= MAX_MINER_WAYS ? nWays : DEFAULT_MINER_WAYS;
+}
+
+// Apply the MSR optimizations (with cache QoS for the CPUs of the first
+// nThreads miner threads). Returns false if they could not be applied.
+static bool InitMinerMsr(int nThreads)
+{
+    // Build list of CPU affinities for mining threads
+    std::vector<int> thread_affinities;
+    NumaHelper& numa = NumaHelper::GetInstance();
+    if (numa.IsPinningEnabled()) {
+        for (int i = 0; i < nThreads; i++) {
+            int cpu_id = numa.GetCPUForThread(i, nThreads);
+            if (cpu_id >= 0) {
+                thread_affinities.push_back(cpu_id);
+            }
+        }
+    }
+
+    // Initialize MSR with cache QoS if affinities are set
+    bool enable_cache_qos = GetBoolArg("-randomxcacheqos", true);
+    return RandomX_Msr::Init(thread_affinities, enable_cache_qos);
+}
+
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams)
 {
     static boost::thread_group* minerThreads = NULL;
+    static int nPoolThreads = 0;  // Miner threads in minerThreads, hashing or parked
     static bool msr_initialized = false;
     static bool exception_handler_initialized = false;
 
     if (nThreads < 0)
         nThreads = GetNumCores();
 
+    // Resize running miners in place: extra threads are parked with their
+    // VMs rather than destroyed, and parked ones are woken first
+    if (minerThreads != NULL && fGenerate && nThreads > 0 && MinerWaysArg() == g_miner_ways.load()) {
+        int nOldThreads = g_miner_active_threads.load();
+        if (nThreads == nOldThreads) return;
+        {
+            std::lock_guard<std::mutex> lock(g_miner_pool_mutex);
+            g_miner_active_threads = nThreads;
+        }
+        g_miner_pool_cv.notify_all();
+        for (int i = nPoolThreads; i < nThreads; i++) {
+            minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), i));
+        }
+        nPoolThreads = std::max(nPoolThreads, nThreads);
+        if (msr_initialized) {
+            // Cache QoS covers the CPUs of the hashing threads
+            RandomX_Msr::Destroy();
+            msr_initialized = InitMinerMsr(nThreads);
+        }
+        LogPrintf("Miner threads resized from %d to %d (%d parked)\n", nOldThreads, nThreads, nPoolThreads - nThreads);
+        return;
+    }
+
     if (minerThreads != NULL)
     {
         minerThreads->interrupt_all();
         minerThreads->join_all();
         delete minerThreads;
         minerThreads = NULL;
+        nPoolThreads = 0;
 
-        // Stop block template updater
-        g_template_stop = true;
-        if (g_template_thread) {
-            g_template_thread->join();
-            delete g_template_thread;
-            g_template_thread = nullptr;
-        }
+        // Stop block template updater (unless the Stratum server still uses it)
+        StopBlockTemplateUpdater();
 
         // Clean up MSR on shutdown
         if (msr_initialized) {
@@ -1402,10 +2137,40 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
         }
     }
 
+    g_miner_ways = 0;
+    g_miner_validation_pause = 0;
+    g_miner_active_threads = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_placement_mutex);
+        g_thread_placement.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_profile_mutex);
+        g_thread_profiles.clear();
+    }
     if (nThreads == 0 || !fGenerate)
         return;
 
+    int nWays = MinerWaysArg();
+    if (nWays != GetArg("-minerways", DEFAULT_MINER_WAYS)) {
+        LogPrintf("%s: -minerways=%d out of range, using %d\n", __func__, GetArg("-minerways", DEFAULT_MINER_WAYS), DEFAULT_MINER_WAYS);
+    }
+    for (AtomicCounter& counter : minerWayHashes) {
+        counter.value.store(0);
+    }
+    minerNearTargetShares.value.store(0);
+    g_miner_ways = nWays;
+    if (nWays > 1) {
+        LogPrintf("Mining with %d RandomX VMs per thread\n", nWays);
+    }
+    g_miner_validation_pause = std::max(0, std::min(100, (int)GetArg("-minervalidationpause", DEFAULT_MINER_VALIDATION_PAUSE)));
+
     // Initialize NUMA before spawning threads for optimal thread-to-CPU pinning
+    ThreadPlacementPolicy placement = DEFAULT_THREAD_PLACEMENT;
+    if (!ParseThreadPlacementPolicy(GetArg("-minerthreadplacement", "numa"), placement)) {
+        placement = DEFAULT_THREAD_PLACEMENT;
+    }
+    NumaHelper::GetInstance().SetPlacementPolicy(placement);
     NumaHelper::GetInstance().Initialize();
 
     // Initialize Ryzen exception handling for JIT stability
@@ -1416,21 +2181,7 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
 
     // Initialize MSR optimizations if enabled
     if (!msr_initialized && GetBoolArg("-randomxmsr", true)) {
-        // Build list of CPU affinities for mining threads
-        std::vector<int> thread_affinities;
-        NumaHelper& numa = NumaHelper::GetInstance();
-        if (numa.IsNUMAAvailable()) {
-            for (int i = 0; i < nThreads; i++) {
-                int cpu_id = numa.GetCPUForThread(i, nThreads);
-                if (cpu_id >= 0) {
-                    thread_affinities.push_back(cpu_id);
-                }
-            }
-        }
-
-        // Initialize MSR with cache QoS if affinities are set
-        bool enable_cache_qos = GetBoolArg("-randomxcacheqos", true);
-        if (RandomX_Msr::Init(thread_affinities, enable_cache_qos)) {
+        if (InitMinerMsr(nThreads)) {
             LogPrintf("RandomX MSR optimizations enabled (10-15%% expected hashrate improvement)\n");
             msr_initialized = true;
         } else {
@@ -1440,12 +2191,20 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
     }
 
     // Start block template updater
-    g_template_stop = false;
-    g_template_thread = new boost::thread(boost::bind(&BlockTemplateUpdater, boost::cref(chainparams)));
+    StartBlockTemplateUpdater(chainparams);
 
+    // Nothing to tune without RandomX
+    bool fTunePrefetch = !chainparams.GetConsensus().fPowFastHash && ApplyPrefetchMode();
+
+    g_miner_active_threads = nThreads;
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++) {
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), i, nThreads));
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), i));
+    }
+    nPoolThreads = nThreads;
+    if (fTunePrefetch) {
+        // Stopped together with the miner threads; reruns on the next start if interrupted
+        minerThreads->create_thread(&PrefetchTuner);
     }
 }
 
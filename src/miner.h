@@ -14,8 +14,10 @@
 #include <stdint.h>
 #include <memory>
 #include <variant>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/signals2/signal.hpp>
 
 class CBlockIndex;
 class CChainParams;
@@ -25,6 +27,17 @@ namespace Consensus { struct Params; };
 
 static const bool DEFAULT_GENERATE = false;
 static const int DEFAULT_GENERATE_THREADS = 1;
+/** Number of RandomX VMs each miner thread interleaves (-minerways) */
+static const int DEFAULT_MINER_WAYS = 1;
+static const int MAX_MINER_WAYS = 4;
+/** Partition of the nonce space this node's miner searches (-minerhostid) */
+static const uint32_t DEFAULT_MINER_HOST_ID = 0;
+/** Percentage of miner threads that stop hashing while a block is connected to the tip (-minervalidationpause) */
+static const int DEFAULT_MINER_VALIDATION_PAUSE = 50;
+/** Longest a miner thread waits for a block to be connected before hashing again */
+static const int64_t MAX_MINER_VALIDATION_PAUSE_MILLIS = 2000;
+/** Scratchpad prefetch mode (-randomxprefetch): off, t0, nta, mov or auto */
+static const char* const DEFAULT_RANDOMX_PREFETCH = "auto";
 
 static const bool DEFAULT_PRINTPRIORITY = false;
 
@@ -132,15 +145,34 @@ private:
     // Variables used for addScoreTxs and addPriorityTxs
     int lastFewTxs;
     bool blockFinished;
+    size_t nBlockUnpaidActions;
 
 public:
     BlockAssembler(const CChainParams& chainparams);
-    /** Construct a new block template with coinbase to minerAddress */
+    /**
+     * Construct a new block template with coinbase to minerAddress. With
+     * fEmptyBlock the mempool is not consulted and the block only holds the
+     * coinbase, which is fast enough to mine on while a full template is built.
+     */
     CBlockTemplate* CreateNewBlock(
         const MinerAddress& minerAddress,
-        const std::optional<CMutableTransaction>& next_coinbase_mtx = std::nullopt);
+        const std::optional<CMutableTransaction>& next_coinbase_mtx = std::nullopt,
+        bool fEmptyBlock = false);
+    /**
+     * Construct a new block template on the same parent as previous, keeping
+     * previous's transactions that are still in the mempool (and their order)
+     * and only selecting among the others. Returns NULL if the tip has moved
+     * on, in which case a full CreateNewBlock is needed.
+     */
+    CBlockTemplate* UpdateBlock(const CBlockTemplate& previous, const MinerAddress& minerAddress);
 
 private:
+    CBlockTemplate* CreateBlock(
+        const MinerAddress& minerAddress,
+        const std::optional<CMutableTransaction>& next_coinbase_mtx,
+        bool fEmptyBlock,
+        const CBlockTemplate* pprevious);
+    void addPreviousTransactions(const CBlockTemplate& previous);
     void constructZIP317BlockTemplate();
     void addTransactions(
         CTxMemPool::weightedCandidates& candidates,
@@ -165,6 +197,64 @@ private:
 };
 
 #ifdef ENABLE_MINING
+/** Where a miner thread runs and where its RandomX scratchpad was allocated */
+struct MinerThreadPlacement {
+    int thread_id;
+    int cpu;             //!< CPU the thread is pinned to, -1 if not pinned
+    int requested_node;  //!< NUMA node chosen by NumaHelper, -1 if none
+    int node;            //!< NUMA node holding the scratchpad, -1 if unknown
+    size_t page_size;    //!< Page size backing the scratchpad in bytes, 0 if unknown
+};
+
+/** What a miner thread's time is charged to by the profiler (getminingprofile) */
+enum MinerPhase {
+    MINER_PHASE_HASHING,     //!< RandomX hashing
+    MINER_PHASE_TEMPLATE,    //!< Picking up a job: header copy, tip check, nonce setup
+    MINER_PHASE_VM,          //!< Switching seeds and getting the job's VMs
+    MINER_PHASE_UPDATETIME,  //!< UpdateTime and reserializing the header
+    MINER_PHASE_CHECKS,      //!< Target filter, metrics, interruption and tip checks, found blocks
+    MINER_PHASE_IDLE,        //!< Waiting for peers, a job or the tip
+    MINER_PHASE_COUNT
+};
+
+/** Name of a phase as reported by getminingprofile */
+const char* MinerPhaseName(MinerPhase phase);
+
+struct MinerThreadProfile {
+    int thread_id;
+    double seconds;                          //!< Time since the thread started
+    uint64_t hashes;
+    double hashrate;                         //!< Hashes per second since the thread started
+    double phase_seconds[MINER_PHASE_COUNT]; //!< Time charged to each phase
+    uint64_t switches;                       //!< New jobs picked up
+    double last_switch_latency;              //!< Seconds from publishing the last job to hashing it
+    double avg_switch_latency;
+    uint64_t validation_pauses;              //!< Times the thread stopped while a block was connected
+    double validation_pause_seconds;
+};
+
+/** Raised by the template updater each time it publishes a new shared block template */
+extern boost::signals2::signal<void ()> NotifySharedTemplateChanged;
+
+/**
+ * Nonces searched by the built-in miner are laid out little-endian as
+ *
+ *   bytes 0-7    counter, incremented for each hash
+ *   bytes 8-11   slot: thread id * MAX_MINER_WAYS + way
+ *   bytes 12-15  host id (-minerhostid)
+ *   bytes 16-31  zero
+ *
+ * so threads, ways and hosts given distinct ids never search the same nonce
+ * of a template, and a thread that comes back to a template carries on from
+ * its counter instead of starting over.
+ */
+static const size_t MINER_NONCE_SLOT_OFFSET = 8;
+static const size_t MINER_NONCE_HOST_OFFSET = 12;
+/** Build the miner nonce for a host, slot and counter */
+uint256 MinerNonce(uint32_t nHostId, uint32_t nSlot, uint64_t nCounter);
+/** Read the counter back out of a miner nonce */
+uint64_t MinerNonceCounter(const uint256& nonce);
+
 /** Get -mineraddress */
 void GetMinerAddress(std::optional<MinerAddress> &minerAddress);
 /** Modify the extranonce in a block */
@@ -173,8 +263,38 @@ void IncrementExtraNonce(
     const CBlockIndex* pindexPrev,
     unsigned int& nExtraNonce,
     const Consensus::Params& consensusParams);
-/** Run the miner threads */
+/**
+ * Start keeping the shared block template up to date. Calls nest: the
+ * updater runs until every caller (the miner threads, the Stratum server)
+ * has called StopBlockTemplateUpdater.
+ */
+void StartBlockTemplateUpdater(const CChainParams& chainparams);
+void StopBlockTemplateUpdater();
+/** The shared block template and its height, false if there is none yet */
+bool GetSharedBlockTemplate(std::shared_ptr<const CBlockTemplate>& ptemplate, int& nHeight);
+/** The shared block template, nullptr if there is none yet */
+std::shared_ptr<const CBlockTemplate> GetSharedBlockTemplate();
+/** Microseconds since the shared block template was published, -1 if there is none */
+int64_t GetSharedTemplateAgeMicros();
+/** Whether the shared block template is being kept up to date */
+bool IsBlockTemplateUpdaterRunning();
+/** Check and submit a block solved by a miner thread or a Stratum client */
+bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainparams);
+/** Run the miner threads. While they run, changing nThreads resizes the pool in
+ * place: surplus threads are parked with their VMs and woken again first. */
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams);
+/** Cycle accounting of each running miner thread, ordered by thread id */
+std::vector<MinerThreadProfile> GetMinerProfile();
+/** Placement of each running miner thread's VM, ordered by thread id */
+std::vector<MinerThreadPlacement> GetMinerThreadPlacement();
+/** Number of ways the running miner threads interleave (0 if not mining) */
+int GetMinerWays();
+/** Percentage of the running miner threads that pause while a block is connected (0 if not mining) */
+int GetMinerValidationPause();
+/** Near-target shares found by the miner threads since they were started (see MiningTarget) */
+uint64_t GetMinerNearTargetShares();
+/** Local solution rate of one way, summed over all miner threads */
+double GetLocalSolPSForWay(int way);
 #endif
 
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
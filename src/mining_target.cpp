@@ -0,0 +1,19 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "mining_target.h"
+
+MiningTarget::MiningTarget(const arith_uint256& targetIn, unsigned int nShareShift) :
+    target(targetIn), nShares(0)
+{
+    nThreshold = (target >> 192).GetLow64();
+
+    // The share target saturates instead of wrapping for easy targets
+    arith_uint256 shareTarget = target << nShareShift;
+    if (nShareShift >= 256 || (shareTarget >> nShareShift) != target) {
+        nShareThreshold = ~(uint64_t)0;
+    } else {
+        nShareThreshold = (shareTarget >> 192).GetLow64();
+    }
+}
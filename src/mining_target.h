@@ -0,0 +1,79 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MINING_TARGET_H
+#define BITCOIN_MINING_TARGET_H
+
+#include "arith_uint256.h"
+#include "crypto/common.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Near-target shares meet the block target made 2^DEFAULT_SHARE_SHIFT times easier */
+static const unsigned int DEFAULT_SHARE_SHIFT = 16;
+
+/**
+ * Checks batches of RandomX outputs against a block target.
+ *
+ * A hash meets the target if, read as a little-endian 256-bit number, it is
+ * at or below it, so its last 8 bytes are the most significant. Filter only
+ * compares those top 64 bits against a threshold worked out once per target,
+ * without branches so the compiler can vectorize it, and leaves the full
+ * comparison to the rare candidates it reports.
+ *
+ * Filter also counts near-target shares, hashes whose top 64 bits meet the
+ * share target. Their expected rate is hashrate * share target / 2^256, which
+ * lets the hashrate behind them be checked the way pools verify miners.
+ */
+class MiningTarget
+{
+public:
+    MiningTarget() : MiningTarget(arith_uint256()) {}
+    explicit MiningTarget(const arith_uint256& target, unsigned int nShareShift = DEFAULT_SHARE_SHIFT);
+
+    /**
+     * Find the hashes that may meet the target.
+     *
+     * @param hashes Array of count hashes
+     * @param count Number of hashes, at most 32
+     * @return Bitmask with bit i set if hashes[i] may meet the target;
+     *         confirm each with Meets
+     */
+    uint32_t Filter(const uint256* hashes, size_t count)
+    {
+        uint32_t candidates = 0;
+        uint64_t shares = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t top = ReadLE64(hashes[i].begin() + 24);
+            candidates |= (uint32_t)(top <= nThreshold) << i;
+            shares += top <= nShareThreshold;
+        }
+        nShares += shares;
+        return candidates;
+    }
+
+    /** Full check of one hash against the target */
+    bool Meets(const uint256& hash) const { return UintToArith256(hash) <= target; }
+
+    const arith_uint256& GetTarget() const { return target; }
+    /** Near-target shares counted since construction or the last TakeShares */
+    uint64_t GetShares() const { return nShares; }
+    /** Return the near-target share count and reset it */
+    uint64_t TakeShares()
+    {
+        uint64_t shares = nShares;
+        nShares = 0;
+        return shares;
+    }
+
+private:
+    arith_uint256 target;
+    uint64_t nThreshold;       //!< Top 64 bits of target
+    uint64_t nShareThreshold;  //!< Top 64 bits of the share target
+    uint64_t nShares;
+};
+
+#endif // BITCOIN_MINING_TARGET_H
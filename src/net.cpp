@@ -22,7 +22,9 @@
 #include "hash.h"
 #include "primitives/transaction.h"
 #include "scheduler.h"
+#include "shieldedbatch.h"
 #include "ui_interface.h"
+#include "util/trace.h"
 
 #ifdef WIN32
 #include <string.h>
@@ -32,7 +34,9 @@
 
 #include <boost/thread.hpp>
 
+#include <functional>
 #include <math.h>
+#include <unordered_map>
 
 #include <rust/metrics.h>
 
@@ -70,12 +74,13 @@ uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
 CAddrMan addrman;
 int nMaxConnections = DEFAULT_MAX_PEER_CONNECTIONS;
+SocketEventsMode socketEventsMode = GetSupportedSocketEventsModes().front();
+int nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
 bool fAddressesInitialized = false;
 std::string strSubVersion;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-limitedmap<WTxId, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
 static deque<string> vOneShots;
 static CCriticalSection cs_vOneShots;
@@ -92,6 +97,11 @@ CCriticalSection cs_nLastNodeId;
 static CSemaphore *semOutbound = NULL;
 static boost::condition_variable messageHandlerCondition;
 
+// Shared tables of what peers know, if -compactknownfilters is set. They
+// are never deleted, as nodes release their slots when they are deleted.
+static std::atomic<CSharedKnownFilter*> sharedAddrKnown{nullptr};
+static std::atomic<CSharedKnownFilter*> sharedInventoryKnown{nullptr};
+
 // Signals for message handling
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
@@ -357,6 +367,12 @@ CNode* FindNode(const CService& addr)
     return NULL;
 }
 
+// Only select() is limited to descriptors below FD_SETSIZE.
+static bool IsWatchableSocket(SOCKET hSocket)
+{
+    return socketEventsMode != SocketEventsMode::Select || IsSelectableSocket(hSocket);
+}
+
 CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
 {
     if (pszDest == NULL) {
@@ -384,7 +400,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsWatchableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -393,7 +409,10 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
         addrman.Attempt(addrConnect);
 
         // Add node
-        CNode* pnode = new CNode(hSocket, addrConnect, pszDest ? pszDest : "", false);
+        // Try v2 with peers that say they support it; if one turns out not
+        // to, the disconnect clears the bit so the next attempt is v1.
+        bool fV2 = (nLocalServices & NODE_P2P_V2) && (addrConnect.nServices & NODE_P2P_V2);
+        CNode* pnode = new CNode(hSocket, addrConnect, pszDest ? pszDest : "", false, fV2);
         pnode->AddRef();
 
         {
@@ -711,27 +730,39 @@ void CNode::copyStats(CNodeStats &stats)
 
     stats.m_addr_processed = m_addr_processed.load();
     stats.m_addr_rate_limited = m_addr_rate_limited.load();
+    stats.resources = resourceUsage.GetStats();
 
     // Leave string empty if addrLocal invalid (not filled in yet)
     CService addrLocalUnlocked = GetAddrLocal();
     stats.addrLocal = addrLocalUnlocked.IsValid() ? addrLocalUnlocked.ToString() : "";
+
+    {
+        LOCK(cs_vSend);
+        bool fV2 = v2transport && v2transport->IsSendReady();
+        stats.transportType = fV2 ? "v2" : "v1";
+        stats.sessionId = fV2 ? HexStr(v2transport->GetSessionId()) : "";
+    }
 }
 
 // requires LOCK(cs_vRecvMsg)
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
 {
+    if (v2transport && !v2transport->IsV1())
+        return ReceiveV2Bytes(pch, nBytes);
+
     while (nBytes > 0) {
 
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, nRecvVersion));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, nRecvVersion);
 
         CNetMessage& msg = vRecvMsg.back();
 
         // absorb network data
         int handled;
-        if (!msg.in_data)
+        bool fHeader = !msg.in_data;
+        if (fHeader)
             handled = msg.readHeader(pch, nBytes);
         else
             handled = msg.readData(pch, nBytes);
@@ -744,6 +775,13 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
             return false;
         }
 
+        if (fHeader && msg.in_data) {
+            // Receive the payload into a buffer that already has room for it.
+            CSerializeData buffer;
+            recvBufferPool.Acquire(buffer, msg.hdr.nMessageSize);
+            msg.vRecv.swap(buffer);
+        }
+
         pch += handled;
         nBytes -= handled;
 
@@ -761,22 +799,87 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
     return true;
 }
 
+// requires LOCK(cs_vRecvMsg)
+bool CNode::ReceiveV2Bytes(const char *pch, unsigned int nBytes)
+{
+    while (nBytes > 0) {
+        int handled = v2transport->ReceiveBytes(pch, nBytes, recvBufferPool);
+        if (handled < 0) {
+            LogPrint("net", "Bad v2 transport data from peer=%i, disconnecting\n", GetId());
+            return false;
+        }
+        pch += handled;
+        nBytes -= handled;
+
+        if (v2transport->NeedsAdvance()) {
+            LOCK(cs_vSend);
+            std::vector<CSerializeData> vSend;
+            v2transport->AdvanceHandshake(vSend);
+            QueueSendData(vSend);
+        }
+
+        if (v2transport->IsV1()) {
+            // What the peer sent so far starts its first v1 message.
+            std::vector<unsigned char> vPrefix = v2transport->TakeV1Prefix();
+            return ReceiveMsgBytes((const char*)vPrefix.data(), vPrefix.size()) &&
+                   ReceiveMsgBytes(pch, nBytes);
+        }
+
+        std::array<char, CMessageHeader::COMMAND_SIZE> command;
+        CSerializeData buffer;
+        size_t nPayloadStart;
+        if (v2transport->TakeMessage(command, buffer, nPayloadStart)) {
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, nRecvVersion);
+            CNetMessage& msg = vRecvMsg.back();
+            memcpy(msg.hdr.pchCommand, command.data(), CMessageHeader::COMMAND_SIZE);
+            msg.hdr.nMessageSize = buffer.size() - nPayloadStart;
+            // The payload is read in place, after the packet header and command.
+            msg.vRecv.swap(buffer);
+            msg.vRecv.ignore(nPayloadStart);
+            msg.in_data = true;
+            msg.nDataPos = msg.hdr.nMessageSize;
+            msg.fAuthenticated = true;
+            msg.nTime = GetTimeMicros();
+
+            std::string strCommand = SanitizeString(msg.hdr.GetCommand());
+            MetricsIncrementCounter("zcash.net.in.messages", "command", strCommand.c_str());
+            MetricsCounter(
+                "zcash.net.in.bytes", msg.hdr.nMessageSize,
+                "command", strCommand.c_str());
+            messageHandlerCondition.notify_one();
+        }
+    }
+
+    return true;
+}
+
+void CNode::EraseProcessedMessages(std::deque<CNetMessage>::iterator it)
+{
+    for (std::deque<CNetMessage>::iterator mi = vRecvMsg.begin(); mi != it; mi++) {
+        CSerializeData buffer;
+        mi->vRecv.swap(buffer);
+        recvBufferPool.Release(buffer);
+    }
+    vRecvMsg.erase(vRecvMsg.begin(), it);
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
-    unsigned int nRemaining = 24 - nHdrPos;
+    unsigned int nRemaining = hdrbuf.size() - nHdrPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
     memcpy(&hdrbuf[nHdrPos], pch, nCopy);
     nHdrPos += nCopy;
 
     // if header incomplete, exit
-    if (nHdrPos < 24)
+    if (nHdrPos < hdrbuf.size())
         return nCopy;
 
     // deserialize to CMessageHeader
     try {
-        hdrbuf >> hdr;
+        CSpanReader reader(vRecv.GetType(), vRecv.GetVersion(), hdrbuf.data(), hdrbuf.data() + hdrbuf.size());
+        reader >> hdr;
     }
     catch (const std::exception&) {
         return -1;
@@ -819,17 +922,17 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSendData>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
+        const CSendData &data = *it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBytes = send(pnode->hSocket, data.begin() + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
@@ -1040,7 +1143,8 @@ static bool AttemptToEvictConnection(bool fPreferNewConnection) {
     return false;
 }
 
-static void AcceptConnection(const ListenSocket& hListenSocket) {
+/** Returns whether a connection was taken from the queue, so that there may be more. */
+static bool AcceptConnection(const ListenSocket& hListenSocket) {
     struct sockaddr_storage sockaddr;
     socklen_t len = sizeof(sockaddr);
     SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
@@ -1065,21 +1169,21 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         int nErr = WSAGetLastError();
         if (nErr != WSAEWOULDBLOCK)
             LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-        return;
+        return false;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!IsWatchableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
-        return;
+        return true;
     }
 
     if (CNode::IsBanned(addr) && !whitelisted)
     {
         LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
         CloseSocket(hSocket);
-        return;
+        return true;
     }
 
     if (nInbound >= nMaxInbound)
@@ -1088,7 +1192,7 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
             // No connection to evict, disconnect the new connection
             LogPrint("net", "failed to find an eviction candidate - connection dropped (full)\n");
             CloseSocket(hSocket);
-            return;
+            return true;
         }
     }
 
@@ -1101,7 +1205,7 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
     setsockopt(hSocket, IPPROTO_TCP, TCP_NODELAY, (void*)&set, sizeof(int));
 #endif
 
-    CNode* pnode = new CNode(hSocket, addr, "", true);
+    CNode* pnode = new CNode(hSocket, addr, "", true, nLocalServices & NODE_P2P_V2);
     pnode->AddRef();
     pnode->fWhitelisted = whitelisted;
 
@@ -1111,11 +1215,31 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    return true;
 }
 
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+
+    std::unique_ptr<CSocketEvents> socketEvents = MakeSocketEvents(socketEventsMode);
+    if (!socketEvents) {
+        LogPrintf("Could not use %s for socket events, falling back to select\n", GetSocketEventsModeName(socketEventsMode));
+        socketEvents = MakeSocketEvents(SocketEventsMode::Select);
+    }
+    LogPrintf("Waiting for socket events with %s\n", GetSocketEventsModeName(socketEvents->Mode()));
+
+    // Listening sockets are tagged with negative numbers, and peers with their
+    // ids. Check for connections that arrived before registration.
+    std::vector<bool> vListenReady(vhListenSocket.size());
+    for (size_t i = 0; i < vhListenSocket.size(); i++) {
+        vListenReady[i] = socketEvents->Register(vhListenSocket[i].socket, -1 - (int64_t)i);
+        if (!vListenReady[i])
+            LogPrintf("Could not watch listening socket: %s\n", NetworkErrorString(WSAGetLastError()));
+    }
+    std::vector<SocketEvent> events;
+    std::unordered_map<NodeId, SocketEvent> mapReady;
+
     while (true)
     {
         //
@@ -1132,6 +1256,20 @@ void ThreadSocketHandler()
                 {
                     auto spanGuard = pnode->span.Enter();
 
+                    // An outbound v2 connection that closed before the peer sent
+                    // anything was most likely to a v1 peer, so try v1 next time.
+                    if (pnode->v2transport && !pnode->fInbound) {
+                        bool fNothingReceived;
+                        {
+                            LOCK(pnode->cs_vRecv);
+                            fNothingReceived = pnode->nRecvBytes == 0;
+                        }
+                        if (fNothingReceived) {
+                            LogPrint("net", "v2 connection received nothing, retrying with v1 next time\n");
+                            addrman.SetServices(pnode->addr, pnode->addr.nServices & ~NODE_P2P_V2);
+                        }
+                    }
+
                     // remove from vNodes
                     vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
 
@@ -1187,25 +1325,16 @@ void ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Find which sockets can make progress. Sockets are watched in the
+        // directions they are not already known to be ready in, and if any
+        // can make progress now, we only check for events without waiting.
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+        bool fProgress = false;
+        for (size_t i = 0; i < vhListenSocket.size(); i++) {
+            if (vListenReady[i])
+                fProgress = true;
+            else
+                socketEvents->Watch(vhListenSocket[i].socket, -1 - (int64_t)i, true, false);
         }
 
         {
@@ -1213,13 +1342,13 @@ void ThreadSocketHandler()
             for (CNode* pnode : vNodes)
             {
                 // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
+                // * If there is data to send, wait for sending data. As this only
                 //   happens when optimistic write failed, we choose to first drain the
                 //   write buffer in this case before receiving more. This avoids
                 //   needlessly queueing received data, if the remote peer is not themselves
                 //   receiving data. This means properly utilizing TCP flow control signaling.
                 // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
+                //   or there is space left in the buffer, wait for receiving data.
                 // * (if neither of the above applies, there is certainly one message
                 //   in the receiver buffer ready to be processed).
                 // Together, that means that at least one of the following is always possible,
@@ -1246,46 +1375,59 @@ void ThreadSocketHandler()
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
 
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
+                if (!pnode->fSocketWatched) {
+                    if (!socketEvents->Register(pnode->hSocket, pnode->GetId())) {
+                        LogPrintf("Could not watch socket of peer=%d: %s\n", pnode->GetId(), NetworkErrorString(WSAGetLastError()));
+                        pnode->fDisconnect = true;
+                        continue;
+                    }
+                    // Data may have arrived before the socket was registered.
+                    pnode->fSocketWatched = true;
+                    pnode->fRecvReady = true;
+                    pnode->fSendReady = true;
                 }
+
+                pnode->fWantSend = select_send;
+                pnode->fWantRecv = !select_send && select_recv;
+                if ((pnode->fWantSend && pnode->fSendReady) || (pnode->fWantRecv && pnode->fRecvReady))
+                    fProgress = true;
+                socketEvents->Watch(pnode->hSocket, pnode->GetId(),
+                    pnode->fWantRecv && !pnode->fRecvReady,
+                    pnode->fWantSend && !pnode->fSendReady);
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        // 50ms is the frequency to poll pnode->vSend
+        bool fWaited = socketEvents->Wait(fProgress ? 0 : 50, events);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
+        if (!fWaited)
         {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+            LogPrintf("socket wait error %s\n", NetworkErrorString(WSAGetLastError()));
+            MilliSleep(50);
+        }
+
+        mapReady.clear();
+        for (const SocketEvent& event : events) {
+            if (event.tag < 0) {
+                size_t i = -1 - event.tag;
+                if (i < vListenReady.size())
+                    vListenReady[i] = true;
+                continue;
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
+            auto ready = mapReady.emplace(event.tag, SocketEvent{event.tag, false, false}).first;
+            ready->second.fRecv |= event.fRecv;
+            ready->second.fSend |= event.fSend;
         }
 
         //
         // Accept new connections
         //
-        for (const ListenSocket& hListenSocket : vhListenSocket)
+        for (size_t i = 0; i < vhListenSocket.size(); i++)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (vListenReady[i] && vhListenSocket[i].socket != INVALID_SOCKET)
             {
-                AcceptConnection(hListenSocket);
+                vListenReady[i] = AcceptConnection(vhListenSocket[i]);
             }
         }
 
@@ -1310,16 +1452,19 @@ void ThreadSocketHandler()
             //
             bool recvSet = false;
             bool sendSet = false;
-            bool errorSet = false;
             {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                auto ready = mapReady.find(pnode->GetId());
+                if (ready != mapReady.end()) {
+                    pnode->fRecvReady |= ready->second.fRecv;
+                    pnode->fSendReady |= ready->second.fSend;
+                }
+                recvSet = pnode->fWantRecv && pnode->fRecvReady;
+                sendSet = pnode->fWantSend && pnode->fSendReady;
             }
-            if (recvSet || errorSet)
+            if (recvSet)
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
@@ -1356,7 +1501,12 @@ void ThreadSocketHandler()
                         {
                             // error
                             int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+                            if (nErr == WSAEWOULDBLOCK)
+                            {
+                                // drained; wait to be told of more data
+                                pnode->fRecvReady = false;
+                            }
+                            else if (nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
                             {
                                 if (!pnode->fDisconnect)
                                     LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
@@ -1374,6 +1524,9 @@ void ThreadSocketHandler()
             {
                 LOCK(pnode->cs_vSend);
                 SocketSendData(pnode);
+                // Anything left over did not fit in the socket's send buffer.
+                if (!pnode->vSendMsg.empty())
+                    pnode->fSendReady = false;
             }
 
             //
@@ -1702,7 +1855,7 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
-void ThreadMessageHandler()
+void ThreadMessageHandler(int nThread)
 {
     const CChainParams& chainparams = Params();
     boost::mutex condition_mutex;
@@ -1722,15 +1875,27 @@ void ThreadMessageHandler()
 
         bool fSleep = true;
 
-        for (CNode* pnode : vNodesCopy)
+        // Each thread starts at a different node, so that they spread out
+        // over the nodes rather than queue behind each other.
+        size_t nStart = vNodesCopy.size() * nThread / nMessageHandlerThreads;
+        for (size_t i = 0; i < vNodesCopy.size(); i++)
         {
+            CNode* pnode = vNodesCopy[(nStart + i) % vNodesCopy.size()];
             if (pnode->fDisconnect)
                 continue;
 
+            // Skip nodes another thread is processing.
+            TRY_LOCK(pnode->cs_messageProcessing, lockProcessing);
+            if (!lockProcessing)
+                continue;
+
             auto spanGuard = pnode->span.Enter();
 
-            // Receive messages
-            {
+            // Receive messages, unless the node has used up its share of our
+            // time and must wait for later passes
+            if (!pnode->resourceUsage.TakeTurn()) {
+                fSleep = false;
+            } else {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv)
                 {
@@ -1739,7 +1904,8 @@ void ThreadMessageHandler()
 
                     if (pnode->nSendSize < SendBufferSize())
                     {
-                        if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete()))
+                        if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete()) ||
+                            (!pnode->vPendingAuthChecks.empty() && pnode->vPendingAuthChecks.front()->IsDone()))
                         {
                             fSleep = false;
                         }
@@ -1749,10 +1915,7 @@ void ThreadMessageHandler()
             boost::this_thread::interruption_point();
 
             // Send messages
-            {
-                LOCK(pnode->cs_sendProcessing);
-                g_signals.SendMessages(chainparams.GetConsensus(), pnode);
-            }
+            g_signals.SendMessages(chainparams.GetConsensus(), pnode);
             boost::this_thread::interruption_point();
         }
 
@@ -1921,6 +2084,21 @@ void static Discover(boost::thread_group& threadGroup)
 #endif
 }
 
+void SetCompactKnownFilters(bool fCompact)
+{
+    if (!fCompact) {
+        sharedAddrKnown = nullptr;
+        sharedInventoryKnown = nullptr;
+        return;
+    }
+    if (!sharedAddrKnown) {
+        sharedAddrKnown = new CSharedKnownFilter(GetNodeClock(), KNOWN_ADDRESS_EXPIRY, MAX_KNOWN_ADDRESSES);
+    }
+    if (!sharedInventoryKnown) {
+        sharedInventoryKnown = new CSharedKnownFilter(GetNodeClock(), KNOWN_INVENTORY_EXPIRY, MAX_KNOWN_INVENTORY);
+    }
+}
+
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
 {
     uiInterface.InitMessage(_("Loading addresses..."));
@@ -1996,12 +2174,18 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<std::function<void()>>, "msghand", std::function<void()>(std::bind(&ThreadMessageHandler, i))));
 
     // Dump network addresses
     scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
 }
 
+void WakeMessageHandler()
+{
+    messageHandlerCondition.notify_one();
+}
+
 bool StopNode()
 {
     LogPrintf("StopNode()\n");
@@ -2222,13 +2406,13 @@ void CNode::Fuzz(int nChance)
 unsigned int ReceiveFloodSize() { return 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER); }
 unsigned int SendBufferSize() { return 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER); }
 
-CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNameIn, bool fInboundIn) :
+CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNameIn, bool fInboundIn, bool fV2) :
     ssSend(SER_NETWORK, INIT_PROTO_VERSION),
     nTimeConnected(GetTime()),
     addr(addrIn),
     nKeyedNetGroup(CalculateKeyedNetGroup(addrIn)),
-    addrKnown(5000, 0.001),
-    filterInventoryKnown(50000, 0.000001)
+    addrKnown(5000, 0.001, sharedAddrKnown),
+    filterInventoryKnown(50000, 0.000001, sharedInventoryKnown)
 {
     nServices = 0;
     hSocket = hSocketIn;
@@ -2251,6 +2435,11 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    fSocketWatched = false;
+    fRecvReady = false;
+    fSendReady = false;
+    fWantRecv = false;
+    fWantSend = false;
     hashContinue = uint256();
     nStartingHeight = -1;
     fSendMempool = false;
@@ -2267,6 +2456,8 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nPingUsecTime = 0;
     fPingQueued = false;
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
+    if (fV2)
+        v2transport.reset(new CV2Transport(!fInbound, Params().MessageStart(), MAX_PROTOCOL_MESSAGE_LENGTH));
 
     {
         LOCK(cs_nLastNodeId);
@@ -2280,8 +2471,16 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     LogPrint("net", "Added connection");
 
     // Be shy and don't send version until we hear
-    if (hSocket != INVALID_SOCKET && !fInbound)
+    if (hSocket != INVALID_SOCKET && !fInbound) {
+        if (v2transport) {
+            // Our key goes first; the version waits for the handshake.
+            LOCK(cs_vSend);
+            std::vector<CSerializeData> vSend;
+            v2transport->AdvanceHandshake(vSend);
+            QueueSendData(vSend);
+        }
         PushVersion();
+    }
 
     GetNodeSignals().InitializeNode(GetId(), this);
 }
@@ -2308,41 +2507,6 @@ void CNode::ReloadTracingSpan()
     }
 }
 
-void CNode::AskFor(const CInv& inv)
-{
-    if (mapAskFor.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
-        return;
-    WTxId wtxid(inv.hash, inv.hashAux);
-    // a peer may not have multiple non-responded queue positions for a single inv item
-    if (!setAskFor.insert(wtxid).second)
-        return;
-
-    // We're using mapAskFor as a priority queue,
-    // the key is the earliest time the request can be sent
-    int64_t nRequestTime;
-    limitedmap<WTxId, int64_t>::const_iterator it = mapAlreadyAskedFor.find(wtxid);
-    if (it != mapAlreadyAskedFor.end())
-        nRequestTime = it->second;
-    else
-        nRequestTime = 0;
-    LogPrint("net", "askfor %s  %d (%s) peer=%d\n", inv.ToString(), nRequestTime, DateTimeStrFormat("%H:%M:%S", nRequestTime/1000000), id);
-
-    // Make sure not to reuse time indexes to keep things in the same order
-    int64_t nNow = GetTimeMicros() - 1000000;
-    static int64_t nLastTime;
-    ++nLastTime;
-    nNow = std::max(nNow, nLastTime);
-    nLastTime = nNow;
-
-    // Each retry is 2 minutes after the last
-    nRequestTime = std::max(nRequestTime + 2 * 60 * 1000000, nNow);
-    if (it != mapAlreadyAskedFor.end())
-        mapAlreadyAskedFor.update(it, nRequestTime);
-    else
-        mapAlreadyAskedFor.insert(std::make_pair(wtxid, nRequestTime));
-    mapAskFor.insert(std::make_pair(nRequestTime, inv));
-}
-
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
 {
     ENTER_CRITICAL_SECTION(cs_vSend);
@@ -2386,29 +2550,105 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     // Set the size
     unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
     WriteLE32((uint8_t*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
+    TRACE3(net, outbound_message, id, strSendCommand.c_str(), nSize);
+
+    CSerializeData data;
+    if (v2transport && v2transport->IsSendReady()) {
+        // The packet is authenticated, so there is no checksum to compute.
+        v2transport->EncryptMessage(&ssSend[CMessageHeader::MESSAGE_START_SIZE],
+                                    (const unsigned char*)ssSend.data() + CMessageHeader::HEADER_SIZE, nSize, data);
+        ssSend.clear();
+    } else {
+        // Set the checksum
+        uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
+        assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + CMessageHeader::CHECKSUM_SIZE);
+        memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+        ssSend.GetAndClear(data);
+
+        if (v2transport && !v2transport->IsSendV1()) {
+            // Until the handshake tells which transport to use, keep it as v1.
+            v2transport->QueueMessage(std::move(data));
+            strSendCommand.clear();
+            LEAVE_CRITICAL_SECTION(cs_vSend);
+            return;
+        }
+    }
+
+    LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
+
+    nSendSize += data.size();
+    MetricsCounter(
+        "zcash.net.out.bytes", data.size(),
+        "command", strSendCommand.c_str());
+    strSendCommand.clear();
+    vSendMsg.emplace_back(std::move(data));
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SocketSendData(this);
+
+    LEAVE_CRITICAL_SECTION(cs_vSend);
+}
+
+void CNode::PushMessageShared(const char* pszCommand, std::shared_ptr<const void> shared, const char* pbegin, const char* pend)
+{
+    unsigned int nSize = pend - pbegin;
+    uint256 hash;
+    if (!v2transport)
+        hash = Hash(pbegin, pend);
 
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + CMessageHeader::CHECKSUM_SIZE);
+    BeginMessage(pszCommand);
+    if (v2transport) {
+        if (!v2transport->IsSendV1()) {
+            // An encrypted payload can't be sent from where it is.
+            ssSend.write(pbegin, nSize);
+            EndMessage();
+            return;
+        }
+        hash = Hash(pbegin, pend);
+    }
+    WriteLE32((uint8_t*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
     memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
-    LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
+    LogPrint("net", "(%d bytes, shared) peer=%d\n", nSize, id);
+    TRACE3(net, outbound_message, id, strSendCommand.c_str(), nSize);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    // The header is queued on its own, followed by the payload in place.
+    CSerializeData header;
+    ssSend.GetAndClear(header);
+    bool fQueueEmpty = vSendMsg.empty();
+    nSendSize += header.size() + nSize;
+    MetricsIncrementCounter("zcash.net.out.messages", "command", strSendCommand.c_str());
     MetricsCounter(
-        "zcash.net.out.bytes", (*it).size(),
+        "zcash.net.out.bytes", header.size() + nSize,
         "command", strSendCommand.c_str());
     strSendCommand.clear();
+    vSendMsg.emplace_back(std::move(header));
+    if (nSize > 0)
+        vSendMsg.emplace_back(std::move(shared), pbegin, pend);
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (fQueueEmpty)
         SocketSendData(this);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+// requires LOCK(cs_vSend)
+void CNode::QueueSendData(std::vector<CSerializeData>& vSend)
+{
+    bool fQueueEmpty = vSendMsg.empty();
+    for (CSerializeData& data : vSend) {
+        nSendSize += data.size();
+        vSendMsg.emplace_back(std::move(data));
+    }
+    vSend.clear();
+
+    // If write queue was empty, attempt "optimistic write"
+    if (fQueueEmpty && !vSendMsg.empty())
+        SocketSendData(this);
+}
+
 /* static */ uint64_t CNode::CalculateKeyedNetGroup(const CAddress& ad)
 {
     static const uint64_t k0 = GetRand(std::numeric_limits<uint64_t>::max());
@@ -11,18 +11,24 @@
 #include "bloom.h"
 #include "compat.h"
 #include "fs.h"
-#include "limitedmap.h"
+#include "knownfilter.h"
 #include "netbase.h"
+#include "netbufferpool.h"
+#include "peerresources.h"
 #include "protocol.h"
 #include "random.h"
+#include "socketevents.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
 #include "util/strencodings.h"
+#include "v2transport.h"
 #include "chainparams.h"
 
+#include <array>
 #include <atomic>
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -36,6 +42,7 @@
 class CAddrMan;
 class CBlockIndex;
 class CScheduler;
+class CShieldedAuthCheck;
 class CNode;
 
 namespace boost {
@@ -63,10 +70,6 @@ static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 2 * 1024 * 1024;
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** -listen default */
 static const bool DEFAULT_LISTEN = true;
-/** The maximum number of entries in mapAskFor */
-static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
-/** The maximum number of entries in setAskFor (larger due to getdata latency)*/
-static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 /** The default for -maxuploadtarget. 0 = Unlimited */
@@ -80,8 +83,13 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const int NETWORK_UPGRADE_PEER_PREFERENCE_BLOCK_PERIOD = 1728;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
+/** Default for -v2transport */
+static const bool DEFAULT_V2_TRANSPORT = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** The default and the most for -msghandlerthreads */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 2;
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
@@ -100,7 +108,11 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
+/** Have peers connected from now on share the tables of the addresses and inventory they know (see CSharedKnownFilter) */
+void SetCompactKnownFilters(bool fCompact);
 bool StopNode();
+/** Wake the message handler thread if it is waiting for messages. */
+void WakeMessageHandler();
 void SocketSendData(CNode *pnode);
 
 typedef int64_t NodeId;
@@ -169,10 +181,14 @@ extern CAddrMan addrman;
 
 /** Maximum number of connections to simultaneously allow (aka connection slots) */
 extern int nMaxConnections;
+/** The number of threads processing messages, each peer being handled by one at a time. */
+extern int nMessageHandlerThreads;
+
+/** How ThreadSocketHandler waits for sockets to become ready */
+extern SocketEventsMode socketEventsMode;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern limitedmap<WTxId, int64_t> mapAlreadyAskedFor;
 
 extern std::vector<std::string> vAddedNodes;
 extern CCriticalSection cs_vAddedNodes;
@@ -214,6 +230,9 @@ public:
     std::string addrLocal;
     uint64_t m_addr_processed{0};
     uint64_t m_addr_rate_limited{0};
+    CPeerResourceStats resources;
+    std::string transportType;
+    std::string sessionId;
 };
 
 
@@ -223,7 +242,7 @@ class CNetMessage {
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    std::array<char, CMessageHeader::HEADER_SIZE> hdrbuf; // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
@@ -231,13 +250,17 @@ public:
     unsigned int nDataPos;
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
+    bool fAuthenticated;            // the transport authenticated it, so there is no checksum to check
+    bool fHashed;                   // hashPayload has been computed
+    uint256 hashPayload;            // double-SHA256 of the data, for the checksum
 
-    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
-        hdrbuf.resize(24);
+    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fAuthenticated = false;
+        fHashed = false;
     }
 
     bool complete() const
@@ -249,7 +272,6 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
@@ -258,6 +280,29 @@ public:
 };
 
 
+/**
+ * Bytes queued for sending to a peer. Usually they are a serialized message
+ * owned by the queue, but a block can also be sent straight from a buffer
+ * shared with others, such as a mapped block file, without being copied.
+ */
+class CSendData
+{
+private:
+    CSerializeData data;
+    // Keeps [pbegin, pend) alive when the bytes are not in data.
+    std::shared_ptr<const void> shared;
+    const char* pbegin;
+    const char* pend;
+
+public:
+    explicit CSendData(CSerializeData&& dataIn) : data(std::move(dataIn)), pbegin(nullptr), pend(nullptr) {}
+    CSendData(std::shared_ptr<const void> sharedIn, const char* pbeginIn, const char* pendIn) :
+        shared(std::move(sharedIn)), pbegin(pbeginIn), pend(pendIn) {}
+
+    const char* begin() const { return shared ? pbegin : data.data(); }
+    size_t size() const { return shared ? pend - pbegin : data.size(); }
+};
+
 /** Information about a peer */
 class CNode
 {
@@ -270,15 +315,33 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSendData> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
 
-    CCriticalSection cs_sendProcessing;
+    // Only used by ThreadSocketHandler. Whether hSocket is known to be ready
+    // to receive or send, which lasts until an attempt to do so would block,
+    // and whether there is room to receive or data to send.
+    bool fSocketWatched;
+    bool fRecvReady;
+    bool fSendReady;
+    bool fWantRecv;
+    bool fWantSend;
+
+    // Held by the message handler thread processing this node's messages,
+    // so that only one does at a time and they are handled in order.
+    CCriticalSection cs_messageProcessing;
+    // The work done for this node, which decides how often its messages get a turn.
+    CPeerResourceUsage resourceUsage;
 
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
+    CRecvBufferPool recvBufferPool; // protected by cs_vRecvMsg
+    // The BIP 324 transport, if the connection may use it. Set only by the
+    // constructor; its receive side is protected by cs_vRecvMsg and its send
+    // side by cs_vSend.
+    std::unique_ptr<CV2Transport> v2transport;
     CCriticalSection cs_vRecvMsg;
     uint64_t nRecvBytes;
     int nRecvVersion;
@@ -313,12 +376,12 @@ public:
     CBloomFilter* pfilter;
     NodeId id;
     std::atomic<int> nRefCount;
-    CRollingBloomFilter addrKnown;
+    CPeerKnownFilter addrKnown;
     mutable CCriticalSection cs_addrKnown;
 
     // Inventory based relay
     // This filter is protected by cs_inventory and contains both txids and wtxids.
-    CRollingBloomFilter filterInventoryKnown;
+    CPeerKnownFilter filterInventoryKnown;
 
     const uint64_t nKeyedNetGroup;
 
@@ -347,9 +410,9 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
+    std::vector<CAddress> vAddrToSend; // protected by cs_addrKnown
     bool fGetAddr;
-    std::set<uint256> setKnown;
+    std::set<uint256> setKnown; // protected by cs_mapAlerts
     int64_t nNextAddrSend;
     int64_t nNextLocalAddrSend;
 
@@ -371,8 +434,6 @@ public:
     // and in the order requested.
     std::vector<uint256> vInventoryBlockToSend;
     mutable CCriticalSection cs_inventory;
-    std::set<WTxId> setAskFor;
-    std::multimap<int64_t, CInv> mapAskFor;
     int64_t nNextInvSend;
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
@@ -392,8 +453,11 @@ public:
     std::atomic<bool> fPingQueued;
 
     std::set<uint256> orphan_work_set;
+    // Transactions from this peer whose shielded proofs are being batch-verified,
+    // in the order they were received. Only used by the message handler thread.
+    std::deque<std::shared_ptr<CShieldedAuthCheck>> vPendingAuthChecks;
 
-    CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNameIn = "", bool fInboundIn = false);
+    CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNameIn = "", bool fInboundIn = false, bool fV2 = false);
     ~CNode();
 
 private:
@@ -420,6 +484,13 @@ private:
 
     CService addrLocal;
     mutable CCriticalSection cs_addrLocal;
+
+    // requires LOCK(cs_vRecvMsg)
+    bool ReceiveV2Bytes(const char *pch, unsigned int nBytes);
+
+    // requires LOCK(cs_vSend)
+    /** Queue bytes the v2 transport produced, in order, after what is already queued. */
+    void QueueSendData(std::vector<CSerializeData>& vSend);
 public:
 
     // Regenerate the span for this CNode. This re-queries the log filter to see
@@ -448,6 +519,10 @@ public:
     // requires LOCK(cs_vRecvMsg)
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes);
 
+    // requires LOCK(cs_vRecvMsg)
+    /** Remove the processed messages before it, keeping their buffers for reuse. */
+    void EraseProcessedMessages(std::deque<CNetMessage>::iterator it);
+
     // requires LOCK(cs_vRecvMsg)
     void SetRecvVersion(int nVersionIn)
     {
@@ -498,6 +573,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrKnown);
         if (addr.IsValid() && !IsAddressKnown(addr)) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = addr;
@@ -546,8 +622,6 @@ public:
         }
     }
 
-    void AskFor(const CInv& inv);
-
     // TODO: Document the postcondition of this function.  Is cs_vSend locked?
     void BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend);
 
@@ -559,6 +633,13 @@ public:
 
     void PushVersion();
 
+    /**
+     * Send a message whose payload is [pbegin, pend) in a buffer that shared
+     * keeps alive, such as a mapped block file. The payload is not copied,
+     * so the buffer may be sent to several peers at once.
+     */
+    void PushMessageShared(const char* pszCommand, std::shared_ptr<const void> shared, const char* pbegin, const char* pend);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -0,0 +1,78 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "netbufferpool.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Totals across all peers' pools.
+static std::atomic<uint64_t> nBuffersAllocated{0};
+static std::atomic<uint64_t> nBuffersReused{0};
+static std::atomic<uint64_t> nBuffersDiscarded{0};
+static std::atomic<uint64_t> nMessagesUnpooled{0};
+static std::atomic<uint64_t> nBuffersPooled{0};
+static std::atomic<uint64_t> nBytesPooled{0};
+
+CRecvBufferPool::~CRecvBufferPool()
+{
+    for (const std::vector<CSerializeData>& free : vFree)
+        nBuffersPooled -= free.size();
+    nBytesPooled -= nPooledBytes;
+}
+
+void CRecvBufferPool::Acquire(CSerializeData& buffer, size_t nSize)
+{
+    auto it = std::lower_bound(std::begin(RECV_BUFFER_SIZE_CLASSES), std::end(RECV_BUFFER_SIZE_CLASSES), nSize);
+    if (it == std::end(RECV_BUFFER_SIZE_CLASSES)) {
+        nMessagesUnpooled++;
+        return;
+    }
+
+    std::vector<CSerializeData>& free = vFree[it - std::begin(RECV_BUFFER_SIZE_CLASSES)];
+    if (free.empty()) {
+        buffer.reserve(*it);
+        nBuffersAllocated++;
+        return;
+    }
+    buffer.swap(free.back());
+    free.pop_back();
+    nPooledBytes -= *it;
+    nBuffersPooled--;
+    nBytesPooled -= *it;
+    nBuffersReused++;
+}
+
+void CRecvBufferPool::Release(CSerializeData& buffer)
+{
+    // Only buffers from Acquire() have exactly the capacity of a size class.
+    size_t nCapacity = buffer.capacity();
+    auto it = std::lower_bound(std::begin(RECV_BUFFER_SIZE_CLASSES), std::end(RECV_BUFFER_SIZE_CLASSES), nCapacity);
+    if (it == std::end(RECV_BUFFER_SIZE_CLASSES) || *it != nCapacity)
+        return;
+
+    std::vector<CSerializeData>& free = vFree[it - std::begin(RECV_BUFFER_SIZE_CLASSES)];
+    if (free.size() >= MAX_POOLED_RECV_BUFFERS_PER_CLASS || nPooledBytes + nCapacity > MAX_POOLED_RECV_BYTES) {
+        nBuffersDiscarded++;
+        return;
+    }
+    buffer.clear();
+    free.emplace_back();
+    free.back().swap(buffer);
+    nPooledBytes += nCapacity;
+    nBuffersPooled++;
+    nBytesPooled += nCapacity;
+}
+
+RecvBufferPoolStats GetRecvBufferPoolStats()
+{
+    RecvBufferPoolStats stats;
+    stats.nAllocated = nBuffersAllocated;
+    stats.nReused = nBuffersReused;
+    stats.nDiscarded = nBuffersDiscarded;
+    stats.nUnpooled = nMessagesUnpooled;
+    stats.nPooled = nBuffersPooled;
+    stats.nPooledBytes = nBytesPooled;
+    return stats;
+}
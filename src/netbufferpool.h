@@ -0,0 +1,73 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_NETBUFFERPOOL_H
+#define BITCOIN_NETBUFFERPOOL_H
+
+#include "support/allocators/zeroafterfree.h"
+
+#include <array>
+#include <iterator>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * The capacities of pooled receive buffers. A message gets a buffer of the
+ * smallest class that holds it; larger ones get a buffer of their own.
+ */
+static constexpr size_t RECV_BUFFER_SIZE_CLASSES[] = {1024, 4096, 16384, 65536, 131072};
+static constexpr size_t RECV_BUFFER_SIZE_CLASS_COUNT = std::size(RECV_BUFFER_SIZE_CLASSES);
+/** The most buffers of each size class a peer keeps for reuse. */
+static const size_t MAX_POOLED_RECV_BUFFERS_PER_CLASS = 8;
+/** The most bytes of buffers a peer keeps for reuse. */
+static const size_t MAX_POOLED_RECV_BYTES = 256 * 1024;
+
+struct RecvBufferPoolStats {
+    /** Buffers allocated because none of their size class was pooled. */
+    uint64_t nAllocated = 0;
+    /** Buffers taken from a pool. */
+    uint64_t nReused = 0;
+    /** Buffers freed because their pool was full. */
+    uint64_t nDiscarded = 0;
+    /** Messages too large for any size class. */
+    uint64_t nUnpooled = 0;
+    /** Buffers currently pooled, and their capacity. */
+    uint64_t nPooled = 0;
+    uint64_t nPooledBytes = 0;
+};
+
+/**
+ * Message payload buffers that a peer has finished with, kept so that its
+ * later messages can be received without allocating. Not thread safe; a
+ * peer's pool is protected by its cs_vRecvMsg.
+ */
+class CRecvBufferPool
+{
+private:
+    std::array<std::vector<CSerializeData>, RECV_BUFFER_SIZE_CLASS_COUNT> vFree;
+    size_t nPooledBytes = 0;
+
+public:
+    CRecvBufferPool() {}
+    ~CRecvBufferPool();
+
+    CRecvBufferPool(const CRecvBufferPool&) = delete;
+    CRecvBufferPool& operator=(const CRecvBufferPool&) = delete;
+
+    /**
+     * Replace buffer, which must be empty, with one that can hold nSize bytes
+     * without reallocating. Leaves it empty if nSize fits no size class.
+     */
+    void Acquire(CSerializeData& buffer, size_t nSize);
+
+    /** Take buffer back for reuse if it came from Acquire() and there is room. */
+    void Release(CSerializeData& buffer);
+
+    size_t PooledBytes() const { return nPooledBytes; }
+};
+
+/** Counts of receive buffer allocation and reuse across all peers. */
+RecvBufferPoolStats GetRecvBufferPoolStats();
+
+#endif // BITCOIN_NETBUFFERPOOL_H
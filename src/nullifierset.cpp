@@ -0,0 +1,103 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "nullifierset.h"
+
+#include <algorithm>
+
+//! Slots in a new table; always a power of two.
+static const size_t NULLIFIER_SET_MIN_SLOTS = 1024;
+
+size_t CNullifierSet::Find(const uint256& nf) const
+{
+    size_t mask = vSlots.size() - 1;
+    size_t i = Home(nf);
+    while (!vSlots[i].IsNull() && vSlots[i] != nf) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void CNullifierSet::Resize(size_t nSlots)
+{
+    std::vector<uint256> vOld;
+    vOld.swap(vSlots);
+    vSlots.resize(nSlots);
+    for (const uint256& nf : vOld) {
+        if (!nf.IsNull()) {
+            vSlots[Find(nf)] = nf;
+        }
+    }
+}
+
+bool CNullifierSet::Contains(const uint256& nf) const
+{
+    if (nf.IsNull()) {
+        return fHaveNull;
+    }
+    return !vSlots.empty() && !vSlots[Find(nf)].IsNull();
+}
+
+bool CNullifierSet::Insert(const uint256& nf)
+{
+    if (nf.IsNull()) {
+        bool fInserted = !fHaveNull;
+        fHaveNull = true;
+        return fInserted;
+    }
+    // Keep the table at most three quarters full, so probe runs stay short.
+    if ((nSize + 1) * 4 > vSlots.size() * 3) {
+        Resize(std::max(vSlots.size() * 2, NULLIFIER_SET_MIN_SLOTS));
+    }
+    size_t i = Find(nf);
+    if (!vSlots[i].IsNull()) {
+        return false;
+    }
+    vSlots[i] = nf;
+    nSize++;
+    return true;
+}
+
+bool CNullifierSet::Erase(const uint256& nf)
+{
+    if (nf.IsNull()) {
+        bool fErased = fHaveNull;
+        fHaveNull = false;
+        return fErased;
+    }
+    if (vSlots.empty()) {
+        return false;
+    }
+    size_t i = Find(nf);
+    if (vSlots[i].IsNull()) {
+        return false;
+    }
+    // Move back any later entry of the probe run that could no longer be
+    // reached past the hole.
+    size_t mask = vSlots.size() - 1;
+    for (size_t j = (i + 1) & mask; !vSlots[j].IsNull(); j = (j + 1) & mask) {
+        size_t home = Home(vSlots[j]);
+        bool fReachable = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!fReachable) {
+            vSlots[i] = vSlots[j];
+            i = j;
+        }
+    }
+    vSlots[i].SetNull();
+    nSize--;
+    return true;
+}
+
+void CNullifierSet::Clear()
+{
+    std::vector<uint256>().swap(vSlots);
+    nSize = 0;
+    fHaveNull = false;
+}
+
+size_t CNullifierSet::DynamicMemoryUsage() const
+{
+    // One allocation, so malloc's overhead is negligible
+    return vSlots.capacity() * sizeof(uint256);
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_NULLIFIERSET_H
+#define BITCOIN_NULLIFIERSET_H
+
+#include "uint256.h"
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A set of nullifiers kept in one flat open-addressing table, so that a
+ * whole pool's nullifiers can stay in memory at little more than their 32
+ * bytes each.
+ *
+ * Nullifiers are uniformly random, so their low bits serve as the hash.
+ * Collisions are resolved by linear probing, and erasing shifts the rest of
+ * the probe run back rather than leaving tombstones, so reorgs do not slow
+ * later lookups. The all-zero value marks an empty slot and is tracked on
+ * its own. Callers provide their own locking.
+ */
+class CNullifierSet
+{
+private:
+    std::vector<uint256> vSlots;
+    size_t nSize = 0;
+    bool fHaveNull = false;
+
+    size_t Home(const uint256& nf) const { return nf.GetUint64(0) & (vSlots.size() - 1); }
+    size_t Find(const uint256& nf) const;
+    void Resize(size_t nSlots);
+
+public:
+    bool Contains(const uint256& nf) const;
+    //! Returns false if nf was present already.
+    bool Insert(const uint256& nf);
+    //! Returns false if nf was not present.
+    bool Erase(const uint256& nf);
+    void Clear();
+
+    size_t Size() const { return nSize + fHaveNull; }
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_NULLIFIERSET_H
@@ -9,11 +9,75 @@
 #include "numa_helper.h"
 #include "util/system.h"
 
-#ifdef HAVE_NUMA
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#if defined(HAVE_NUMA) || defined(__linux__)
 #include <pthread.h>
+#include <sched.h>
 #include <cstring>
 #endif
 
+// Memory each RandomX miner thread wants to keep in L3
+static const size_t SCRATCHPAD_BYTES = 2 * 1024 * 1024;
+
+bool ParseThreadPlacementPolicy(const std::string& str, ThreadPlacementPolicy& policy)
+{
+    if (str == "none") {
+        policy = ThreadPlacementPolicy::NONE;
+    } else if (str == "numa") {
+        policy = ThreadPlacementPolicy::NUMA;
+    } else if (str == "l3") {
+        policy = ThreadPlacementPolicy::L3;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#ifdef __linux__
+// Read the first line of a sysfs file
+static bool ReadSysfsLine(const std::string& path, std::string& line)
+{
+    std::ifstream file(path);
+    return file && std::getline(file, line);
+}
+
+// Parse a sysfs CPU list such as "0-7,16-23"
+static std::vector<int> ParseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // Ignore malformed entries
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// Parse a sysfs cache size such as "32768K"
+static size_t ParseCacheSize(const std::string& str)
+{
+    size_t size = strtoul(str.c_str(), nullptr, 10);
+    if (str.find('K') != std::string::npos) size <<= 10;
+    if (str.find('M') != std::string::npos) size <<= 20;
+    return size;
+}
+#endif
+
 NumaHelper& NumaHelper::GetInstance() {
     static NumaHelper instance;
     return instance;
@@ -23,6 +87,8 @@ void NumaHelper::Initialize() {
     if (initialized_) return;
     initialized_ = true;
 
+    DetectCacheTopology();
+
 #ifdef HAVE_NUMA
     if (numa_available() == -1) {
         LogPrintf("NUMA: Not available on this system\n");
@@ -64,7 +130,140 @@ void NumaHelper::Initialize() {
 #endif
 }
 
+void NumaHelper::DetectCacheTopology() {
+#ifdef __linux__
+    std::string online;
+    if (!ReadSysfsLine("/sys/devices/system/cpu/online", online)) {
+        LogPrint("numa", "NUMA: CPU topology not available\n");
+        return;
+    }
+
+    std::map<std::string, int> cores;    // thread_siblings_list -> core index
+    std::map<std::string, int> domains;  // L3 shared_cpu_list -> domain index
+    for (int cpu : ParseCpuList(online)) {
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuInfo info;
+        info.cpu = cpu;
+        info.node = 0;
+#ifdef HAVE_NUMA
+        if (numa_available() != -1) {
+            info.node = std::max(0, numa_node_of_cpu(cpu));
+        }
+#endif
+
+        std::string siblings;
+        if (!ReadSysfsLine(base + "/topology/thread_siblings_list", siblings)) {
+            siblings = std::to_string(cpu);
+        }
+        info.core = cores.emplace(siblings, (int)cores.size()).first->second;
+
+        info.l3_domain = -1;
+        for (int index = 0; ; index++) {
+            std::string cache = base + "/cache/index" + std::to_string(index);
+            std::string level;
+            if (!ReadSysfsLine(cache + "/level", level)) break;
+            if (level != "3") continue;
+
+            std::string shared, size;
+            if (!ReadSysfsLine(cache + "/shared_cpu_list", shared)) break;
+            auto it = domains.find(shared);
+            if (it == domains.end()) {
+                it = domains.emplace(shared, (int)l3_domains_.size()).first;
+                L3Domain domain;
+                domain.size = ReadSysfsLine(cache + "/size", size) ? ParseCacheSize(size) : 0;
+                l3_domains_.push_back(domain);
+            }
+            info.l3_domain = it->second;
+            l3_domains_[info.l3_domain].cpus.push_back(cpu);
+            break;
+        }
+        cpus_.push_back(info);
+    }
+
+    for (size_t d = 0; d < l3_domains_.size(); d++) {
+        LogPrint("numa", "NUMA: L3 domain %u has %u CPUs and %u KiB (room for %u scratchpads)\n",
+                 d, l3_domains_[d].cpus.size(), l3_domains_[d].size >> 10,
+                 l3_domains_[d].size / SCRATCHPAD_BYTES);
+    }
+    LogPrintf("NUMA: Found %u CPUs, %u physical cores, %u L3 domains\n",
+              cpus_.size(), cores.size(), l3_domains_.size());
+#endif
+}
+
+void NumaHelper::SetPlacementPolicy(ThreadPlacementPolicy policy) {
+    std::lock_guard<std::mutex> lock(plan_mutex_);
+    policy_ = policy;
+    planned_threads_ = 0;
+    planned_cpus_.clear();
+}
+
+bool NumaHelper::IsPinningEnabled() const {
+    switch (policy_) {
+    case ThreadPlacementPolicy::NONE:
+        return false;
+    case ThreadPlacementPolicy::NUMA:
+        return numa_available_;
+    case ThreadPlacementPolicy::L3:
+        return !l3_domains_.empty();
+    }
+    return false;
+}
+
+void NumaHelper::PlanL3Placement(int total_threads) {
+    planned_threads_ = total_threads;
+    planned_cpus_.clear();
+    if (l3_domains_.empty() || total_threads <= 0) return;
+
+    // Within each domain, use one CPU of every physical core before any SMT sibling
+    std::vector<std::vector<int>> order(l3_domains_.size());
+    for (size_t d = 0; d < l3_domains_.size(); d++) {
+        std::vector<int> seen_cores;
+        std::vector<int> siblings;
+        for (int cpu : l3_domains_[d].cpus) {
+            auto info = std::find_if(cpus_.begin(), cpus_.end(), [cpu](const CpuInfo& c) { return c.cpu == cpu; });
+            int core = info != cpus_.end() ? info->core : cpu;
+            if (std::find(seen_cores.begin(), seen_cores.end(), core) == seen_cores.end()) {
+                seen_cores.push_back(core);
+                order[d].push_back(cpu);
+            } else {
+                siblings.push_back(cpu);
+            }
+        }
+        order[d].insert(order[d].end(), siblings.begin(), siblings.end());
+    }
+
+    // Round-robin across domains while each stays within its L3 budget
+    std::vector<size_t> used(l3_domains_.size(), 0);
+    bool progress = true;
+    while ((int)planned_cpus_.size() < total_threads && progress) {
+        progress = false;
+        for (size_t d = 0; d < l3_domains_.size() && (int)planned_cpus_.size() < total_threads; d++) {
+            size_t budget = std::max<size_t>(1, l3_domains_[d].size / SCRATCHPAD_BYTES);
+            if (used[d] < std::min(budget, order[d].size())) {
+                planned_cpus_.push_back(order[d][used[d]++]);
+                progress = true;
+            }
+        }
+    }
+
+    if ((int)planned_cpus_.size() < total_threads) {
+        LogPrintf("NUMA: WARNING - %d mining threads exceed the L3 capacity of %u domains; scratchpads will spill out of L3\n",
+                  total_threads, l3_domains_.size());
+        for (size_t i = 0; (int)planned_cpus_.size() < total_threads; i++) {
+            size_t d = i % l3_domains_.size();
+            planned_cpus_.push_back(order[d][used[d]++ % order[d].size()]);
+        }
+    }
+}
+
 int NumaHelper::GetNodeForThread(int thread_id, int total_threads) {
+    if (policy_ == ThreadPlacementPolicy::L3) {
+        int cpu = GetCPUForThread(thread_id, total_threads);
+        for (const CpuInfo& info : cpus_) {
+            if (info.cpu == cpu) return info.node;
+        }
+        return 0;
+    }
     if (!numa_available_ || num_numa_nodes_ <= 1) {
         return 0;
     }
@@ -73,6 +272,21 @@ int NumaHelper::GetNodeForThread(int thread_id, int total_threads) {
 }
 
 int NumaHelper::GetCPUForThread(int thread_id, int total_threads) {
+    if (policy_ == ThreadPlacementPolicy::NONE) {
+        return -1;
+    }
+
+    if (policy_ == ThreadPlacementPolicy::L3) {
+        std::lock_guard<std::mutex> lock(plan_mutex_);
+        if (planned_threads_ != total_threads) {
+            PlanL3Placement(total_threads);
+        }
+        if (thread_id < 0 || thread_id >= (int)planned_cpus_.size()) {
+            return -1;
+        }
+        return planned_cpus_[thread_id];
+    }
+
     if (!numa_available_ || num_numa_nodes_ <= 1) {
         return -1; // No pinning on single-node systems
     }
@@ -96,7 +310,7 @@ int NumaHelper::GetCPUForThread(int thread_id, int total_threads) {
 }
 
 bool NumaHelper::PinCurrentThread(int cpu_id) {
-#ifdef HAVE_NUMA
+#if defined(HAVE_NUMA) || defined(__linux__)
     if (cpu_id < 0) return false;
 
     cpu_set_t cpuset;
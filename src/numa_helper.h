@@ -9,7 +9,10 @@
 #include "config/bitcoin-config.h"
 #endif
 
+#include <mutex>
+#include <string>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 #ifdef HAVE_NUMA
@@ -17,10 +20,28 @@
 #include <sched.h>
 #endif
 
+/** How mining threads are assigned to CPUs (-minerthreadplacement) */
+enum class ThreadPlacementPolicy {
+    NONE,   //!< Do not pin threads
+    NUMA,   //!< Round-robin across NUMA nodes (only on multi-node systems)
+    L3,     //!< Spread across L3 cache domains (CCXs), within each domain's scratchpad budget
+};
+
+static const ThreadPlacementPolicy DEFAULT_THREAD_PLACEMENT = ThreadPlacementPolicy::NUMA;
+
+/** Parse a -minerthreadplacement value ("none", "numa" or "l3") */
+bool ParseThreadPlacementPolicy(const std::string& str, ThreadPlacementPolicy& policy);
+
 /**
  * NUMA helper for mining thread optimization.
  * Provides topology detection and thread pinning for multi-socket NUMA systems.
  * On single-socket or non-NUMA systems, all functions return safe defaults.
+ *
+ * On Linux it also reads the CPU cache topology from sysfs. Each RandomX
+ * scratchpad is 2MB and should stay in L3, so with the L3 policy threads are
+ * spread over L3 domains (a CCX on Zen, a socket on most Intel parts), one
+ * per physical core before using SMT siblings, and no domain gets more
+ * threads than L3 size / 2MB until every domain is full.
  */
 class NumaHelper {
 public:
@@ -34,8 +55,18 @@ public:
     bool IsNUMAAvailable() const { return numa_available_; }
     int GetNumNodes() const { return num_numa_nodes_; }
 
-    // Get CPU assignment for a thread (round-robin across nodes)
-    // Returns -1 if NUMA not available
+    // Select how GetCPUForThread assigns CPUs (takes effect for new thread counts)
+    void SetPlacementPolicy(ThreadPlacementPolicy policy);
+    ThreadPlacementPolicy GetPlacementPolicy() const { return policy_; }
+
+    // Check if mining threads should be pinned under the current policy
+    bool IsPinningEnabled() const;
+
+    // Get number of L3 cache domains found (0 if the topology is unknown)
+    int GetNumL3Domains() const { return (int)l3_domains_.size(); }
+
+    // Get CPU assignment for a thread according to the placement policy
+    // Returns -1 if the thread should not be pinned
     int GetCPUForThread(int thread_id, int total_threads);
 
     // Get NUMA node for a thread
@@ -46,16 +77,42 @@ public:
     bool PinCurrentThread(int cpu_id);
 
 private:
-    NumaHelper() : numa_available_(false), num_numa_nodes_(1), initialized_(false) {}
+    NumaHelper() : numa_available_(false), num_numa_nodes_(1), initialized_(false),
+                   policy_(DEFAULT_THREAD_PLACEMENT), planned_threads_(0) {}
     NumaHelper(const NumaHelper&) = delete;
     NumaHelper& operator=(const NumaHelper&) = delete;
 
+    struct CpuInfo {
+        int cpu;
+        int node;
+        int core;       //!< Index of the physical core (SMT siblings share it)
+        int l3_domain;  //!< Index into l3_domains_, -1 if unknown
+    };
+
+    struct L3Domain {
+        size_t size;            //!< L3 size in bytes
+        std::vector<int> cpus;  //!< CPUs sharing this L3
+    };
+
+    void DetectCacheTopology();
+    void PlanL3Placement(int total_threads);
+
     bool numa_available_;
     int num_numa_nodes_;
     bool initialized_;
+    ThreadPlacementPolicy policy_;
 
     // Per-node CPU list
     std::vector<std::vector<int>> node_cpus_;
+
+    // Cache topology (Linux sysfs)
+    std::vector<CpuInfo> cpus_;
+    std::vector<L3Domain> l3_domains_;
+
+    // CPU for each thread under the L3 policy, for planned_threads_ threads
+    std::mutex plan_mutex_;
+    std::vector<int> planned_cpus_;
+    int planned_threads_;
 };
 
 #endif // BITCOIN_NUMA_HELPER_H
@@ -0,0 +1,67 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "peerresources.h"
+
+#include <algorithm>
+
+void CPeerResourceUsage::Charge(int64_t nCost)
+{
+    if (nCost > 0)
+        nCredit -= nCost;
+}
+
+void CPeerResourceUsage::AddMessage(const std::string& strCommand, int64_t nCpuTime)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    // A peer making up commands can't grow the map without bound.
+    auto it = stats.mapCpuTimePerMsgCmd.find(strCommand);
+    if (it == stats.mapCpuTimePerMsgCmd.end()) {
+        const std::string key = stats.mapCpuTimePerMsgCmd.size() < MAX_PEER_RESOURCE_COMMANDS ? strCommand : "*other*";
+        it = stats.mapCpuTimePerMsgCmd.emplace(key, 0).first;
+    }
+    it->second += std::max<int64_t>(nCpuTime, 0);
+    Charge(nCpuTime);
+}
+
+void CPeerResourceUsage::AddHeaderChecks(size_t nHeaders, int64_t nCpuTime)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    stats.nHeadersVerified += nHeaders;
+    stats.nVerifyTime += std::max<int64_t>(nCpuTime, 0);
+    Charge(nCpuTime);
+}
+
+void CPeerResourceUsage::AddProofChecks(size_t nTransactions, int64_t nCpuTime)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    stats.nProofsVerified += nTransactions;
+    stats.nVerifyTime += std::max<int64_t>(nCpuTime, 0);
+    Charge(nCpuTime);
+}
+
+void CPeerResourceUsage::AddDiskRead(uint64_t nBytes)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    stats.nDiskReadBytes += nBytes;
+    Charge(nBytes / PEER_DISK_READ_BYTES_PER_MICRO);
+}
+
+bool CPeerResourceUsage::TakeTurn()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    // Credit doesn't build up while the peer is idle, so that it can't save
+    // it for a burst of expensive messages.
+    nCredit = std::min(nCredit + PEER_PROCESSING_QUANTUM, PEER_PROCESSING_QUANTUM);
+    if (nCredit > 0)
+        return true;
+    stats.nTurnsSkipped++;
+    return false;
+}
+
+CPeerResourceStats CPeerResourceUsage::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return stats;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_PEERRESOURCES_H
+#define BITCOIN_PEERRESOURCES_H
+
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Time (in microseconds) of work each peer may cost us per pass of a message
+ * handler thread. Cheap peers never use it up; a peer that does is skipped
+ * until enough passes have gone by to pay for its work.
+ */
+static const int64_t PEER_PROCESSING_QUANTUM = 10000;
+/** Bytes read from disk for a peer that cost as much as one microsecond of processing. */
+static const uint64_t PEER_DISK_READ_BYTES_PER_MICRO = 1000;
+/** Most message commands whose CPU time is kept apart for a peer; the time of any others is added up under "*other*". */
+static const size_t MAX_PEER_RESOURCE_COMMANDS = 64;
+
+/** What a peer has cost us, as reported by getpeerinfo. Times are in microseconds. */
+struct CPeerResourceStats
+{
+    //! CPU time spent processing each message command from the peer.
+    std::map<std::string, int64_t> mapCpuTimePerMsgCmd;
+    //! CPU time spent on other threads verifying the peer's headers and transactions.
+    int64_t nVerifyTime = 0;
+    uint64_t nHeadersVerified = 0;
+    uint64_t nProofsVerified = 0;
+    //! Block data read from disk to answer the peer.
+    uint64_t nDiskReadBytes = 0;
+    //! Passes of the message handler in which the peer was skipped for having used up its share.
+    uint64_t nTurnsSkipped = 0;
+};
+
+/**
+ * The resources a peer uses, which schedule its messages by deficit round
+ * robin: each pass of a message handler thread gives the peer
+ * PEER_PROCESSING_QUANTUM of credit, the work done for it is taken off, and
+ * the peer's messages wait while its credit is used up. A peer whose messages
+ * are expensive thus gets fewer turns, while the others keep theirs. When no
+ * one else has work, passes come quickly and the peer is not held back long.
+ */
+class CPeerResourceUsage
+{
+private:
+    mutable std::mutex cs;
+    CPeerResourceStats stats;
+    //! Work the peer may still cost us before it misses a turn. Guarded by cs.
+    int64_t nCredit = PEER_PROCESSING_QUANTUM;
+
+    void Charge(int64_t nCost);
+
+public:
+    /** Processing a message took nCpuTime of the handler thread's time. */
+    void AddMessage(const std::string& strCommand, int64_t nCpuTime);
+
+    /** Other threads took nCpuTime to verify the proof of work of nHeaders of the peer's headers. */
+    void AddHeaderChecks(size_t nHeaders, int64_t nCpuTime);
+
+    /** Another thread took nCpuTime to verify the shielded proofs of nTransactions of the peer's transactions. */
+    void AddProofChecks(size_t nTransactions, int64_t nCpuTime);
+
+    /** nBytes were read from disk for the peer. */
+    void AddDiskRead(uint64_t nBytes);
+
+    /**
+     * Called once per pass of a message handler thread. Returns whether the
+     * peer's messages may be processed in this pass.
+     */
+    bool TakeTurn();
+
+    CPeerResourceStats GetStats() const;
+};
+
+#endif // BITCOIN_PEERRESOURCES_H
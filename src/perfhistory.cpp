@@ -0,0 +1,157 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "perfhistory.h"
+
+#include "main.h"
+#include "scheduler.h"
+#include "txmempool.h"
+#include "util/time.h"
+#include "validation_stats.h"
+#ifdef ENABLE_MINING
+#include "miner.h"
+#endif
+
+#include <algorithm>
+#include <map>
+
+CPerformanceHistory::CPerformanceHistory(size_t nCapacityIn) :
+    nCapacity(std::max<size_t>(nCapacityIn, 1)), slots(new Slot[nCapacity])
+{
+    for (size_t i = 0; i < nCapacity; i++) {
+        for (auto& rate : slots[i].threadHashrate) {
+            rate.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CPerformanceHistory::Record(const PerformanceSample& sample)
+{
+    uint64_t n = nRecorded.load(std::memory_order_relaxed);
+    Slot& slot = slots[n % nCapacity];
+
+    slot.nSeq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.nTime.store(sample.nTime, std::memory_order_relaxed);
+    slot.nIntervalMillis.store(sample.nIntervalMillis, std::memory_order_relaxed);
+    for (size_t i = 0; i < PERF_HISTORY_MAX_THREADS; i++) {
+        slot.threadHashrate[i].store(sample.threadHashrate[i], std::memory_order_relaxed);
+    }
+    slot.nThreads.store(sample.nThreads, std::memory_order_relaxed);
+    slot.hashrate.store(sample.hashrate, std::memory_order_relaxed);
+    slot.nTemplateAgeMillis.store(sample.nTemplateAgeMillis, std::memory_order_relaxed);
+    slot.nBlocksConnected.store(sample.nBlocksConnected, std::memory_order_relaxed);
+    slot.nConnectMicros.store(sample.nConnectMicros, std::memory_order_relaxed);
+    slot.nMempoolTx.store(sample.nMempoolTx, std::memory_order_relaxed);
+    slot.nMempoolBytes.store(sample.nMempoolBytes, std::memory_order_relaxed);
+
+    slot.nSeq.store(2 * n + 2, std::memory_order_release);
+    nRecorded.store(n + 1, std::memory_order_release);
+}
+
+std::vector<PerformanceSample> CPerformanceHistory::GetSamples(size_t nMax) const
+{
+    uint64_t nEnd = nRecorded.load(std::memory_order_acquire);
+    uint64_t nBegin = nEnd - std::min<uint64_t>({nEnd, nCapacity, nMax});
+
+    std::vector<PerformanceSample> result;
+    result.reserve(nEnd - nBegin);
+    for (uint64_t n = nBegin; n < nEnd; n++) {
+        const Slot& slot = slots[n % nCapacity];
+        // Skip the sample if the writer has moved on to a later one in its slot.
+        const uint64_t nSeq = 2 * n + 2;
+        if (slot.nSeq.load(std::memory_order_acquire) != nSeq) {
+            continue;
+        }
+
+        PerformanceSample sample;
+        sample.nTime = slot.nTime.load(std::memory_order_relaxed);
+        sample.nIntervalMillis = slot.nIntervalMillis.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < PERF_HISTORY_MAX_THREADS; i++) {
+            sample.threadHashrate[i] = slot.threadHashrate[i].load(std::memory_order_relaxed);
+        }
+        sample.nThreads = slot.nThreads.load(std::memory_order_relaxed);
+        sample.hashrate = slot.hashrate.load(std::memory_order_relaxed);
+        sample.nTemplateAgeMillis = slot.nTemplateAgeMillis.load(std::memory_order_relaxed);
+        sample.nBlocksConnected = slot.nBlocksConnected.load(std::memory_order_relaxed);
+        sample.nConnectMicros = slot.nConnectMicros.load(std::memory_order_relaxed);
+        sample.nMempoolTx = slot.nMempoolTx.load(std::memory_order_relaxed);
+        sample.nMempoolBytes = slot.nMempoolBytes.load(std::memory_order_relaxed);
+
+        // ... or did so while it was copied.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.nSeq.load(std::memory_order_relaxed) != nSeq) {
+            continue;
+        }
+        result.push_back(sample);
+    }
+    return result;
+}
+
+static CPerformanceHistory performanceHistory;
+
+const CPerformanceHistory& GetPerformanceHistory()
+{
+    return performanceHistory;
+}
+
+static void SamplePerformance()
+{
+    // Only run from the scheduler, which never overlaps a repeating task
+    // with itself, so the previous readings need no lock.
+    static int64_t nLastMillis = 0;
+    static std::map<int, uint64_t> mapLastThreadHashes;
+    static uint64_t nLastConnectCount = 0;
+    static int64_t nLastConnectMicros = 0;
+
+    PerformanceSample sample;
+    sample.nTime = GetTimeMillis();
+    sample.nIntervalMillis = nLastMillis ? sample.nTime - nLastMillis : 0;
+    double seconds = sample.nIntervalMillis / 1000.0;
+
+#ifdef ENABLE_MINING
+    // A thread's counters start over when it is parked and resumed.
+    std::map<int, uint64_t> mapThreadHashes;
+    double hashrate = 0;
+    for (const MinerThreadProfile& profile : GetMinerProfile()) {
+        auto it = mapLastThreadHashes.find(profile.thread_id);
+        uint64_t nLast = it != mapLastThreadHashes.end() && it->second <= profile.hashes ? it->second : 0;
+        double rate = seconds > 0 ? (profile.hashes - nLast) / seconds : 0;
+        hashrate += rate;
+        if (profile.thread_id >= 0 && (size_t)profile.thread_id < PERF_HISTORY_MAX_THREADS) {
+            sample.threadHashrate[profile.thread_id] = rate;
+            sample.nThreads = std::max<uint32_t>(sample.nThreads, profile.thread_id + 1);
+        }
+        mapThreadHashes[profile.thread_id] = profile.hashes;
+    }
+    mapLastThreadHashes.swap(mapThreadHashes);
+    sample.hashrate = hashrate;
+
+    int64_t nTemplateAge = GetSharedTemplateAgeMicros();
+    sample.nTemplateAgeMillis = nTemplateAge < 0 ? -1 : nTemplateAge / 1000;
+#endif
+
+    LatencyHistogram::Snapshot connects = GetValidationPhaseStats(VALIDATION_PHASE_TOTAL);
+    if (nLastMillis) {
+        sample.nBlocksConnected = connects.nCount - nLastConnectCount;
+        sample.nConnectMicros = connects.nSumMicros - nLastConnectMicros;
+    }
+    nLastConnectCount = connects.nCount;
+    nLastConnectMicros = connects.nSumMicros;
+
+    sample.nMempoolTx = mempool.size();
+    sample.nMempoolBytes = mempool.GetTotalTxSize();
+
+    // The first call only takes the readings the next one is measured from.
+    if (nLastMillis) {
+        performanceHistory.Record(sample);
+    }
+    nLastMillis = sample.nTime;
+}
+
+void ConnectPerformanceHistory(CScheduler& scheduler)
+{
+    scheduler.scheduleEvery(&SamplePerformance, 1);
+}
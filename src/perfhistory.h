@@ -0,0 +1,82 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PERFHISTORY_H
+#define BITCOIN_PERFHISTORY_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class CScheduler;
+
+/** Per-second samples kept by the performance history (see getperformancehistory) */
+static const size_t PERF_HISTORY_SAMPLES = 600;
+/** Miner threads whose hashrate is sampled individually; threads with higher ids count only towards the total */
+static const size_t PERF_HISTORY_MAX_THREADS = 64;
+
+/** One second of node activity */
+struct PerformanceSample {
+    int64_t nTime = 0;                 //!< When the sample was taken, in unix milliseconds
+    int64_t nIntervalMillis = 0;       //!< Time since the previous sample
+    float threadHashrate[PERF_HISTORY_MAX_THREADS] = {}; //!< Hashes per second by miner thread id
+    uint32_t nThreads = 0;             //!< Entries of threadHashrate in use
+    float hashrate = 0;                //!< Hashes per second over all miner threads
+    int64_t nTemplateAgeMillis = -1;   //!< Age of the shared block template, -1 if there is none
+    uint32_t nBlocksConnected = 0;     //!< Blocks connected to the tip during the interval
+    int64_t nConnectMicros = 0;        //!< Time spent connecting them
+    uint64_t nMempoolTx = 0;
+    uint64_t nMempoolBytes = 0;
+};
+
+/**
+ * A fixed-size ring of the most recent samples. There is one writer, and
+ * readers never block it: each slot carries the number of the sample it
+ * holds, marked while the slot is being written, and a reader that finds a
+ * different number before or after copying the slot drops that sample.
+ */
+class CPerformanceHistory
+{
+private:
+    struct Slot {
+        //! 2n + 2 once sample n is written, 2n + 1 while it is being written
+        std::atomic<uint64_t> nSeq{0};
+        std::atomic<int64_t> nTime{0};
+        std::atomic<int64_t> nIntervalMillis{0};
+        std::atomic<float> threadHashrate[PERF_HISTORY_MAX_THREADS];
+        std::atomic<uint32_t> nThreads{0};
+        std::atomic<float> hashrate{0};
+        std::atomic<int64_t> nTemplateAgeMillis{-1};
+        std::atomic<uint32_t> nBlocksConnected{0};
+        std::atomic<int64_t> nConnectMicros{0};
+        std::atomic<uint64_t> nMempoolTx{0};
+        std::atomic<uint64_t> nMempoolBytes{0};
+    };
+
+    const size_t nCapacity;
+    std::unique_ptr<Slot[]> slots;
+    //! Samples recorded so far; the next one goes to slot nRecorded % nCapacity.
+    std::atomic<uint64_t> nRecorded{0};
+
+public:
+    explicit CPerformanceHistory(size_t nCapacityIn = PERF_HISTORY_SAMPLES);
+
+    /** Add a sample, replacing the oldest once the ring is full. Only one thread may call this. */
+    void Record(const PerformanceSample& sample);
+
+    /** Up to nMax of the latest samples, oldest first */
+    std::vector<PerformanceSample> GetSamples(size_t nMax) const;
+
+    size_t Capacity() const { return nCapacity; }
+};
+
+/** Samples taken each second since ConnectPerformanceHistory */
+const CPerformanceHistory& GetPerformanceHistory();
+
+/** Sample hashrate, template age, block connects and the mempool every second */
+void ConnectPerformanceHistory(CScheduler& scheduler);
+
+#endif // BITCOIN_PERFHISTORY_H
@@ -0,0 +1,252 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "pinsketch.h"
+
+#include <algorithm>
+
+namespace {
+
+/** The low terms of the field's modulus, x^32 + x^7 + x^3 + x^2 + 1. */
+const uint32_t FIELD_MODULUS = 0x8d;
+
+/** Number of random traces tried to split a polynomial before giving up. */
+const int MAX_SPLIT_ATTEMPTS = 64;
+
+uint32_t FieldMul(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+    while (b) {
+        if (b & 1)
+            r ^= a;
+        b >>= 1;
+        a = (a << 1) ^ ((a >> 31) ? FIELD_MODULUS : 0);
+    }
+    return r;
+}
+
+uint32_t FieldInv(uint32_t a)
+{
+    // a^(2^32 - 2)
+    uint32_t r = 1;
+    for (int i = 0; i < 31; i++) {
+        a = FieldMul(a, a);
+        r = FieldMul(r, a);
+    }
+    return r;
+}
+
+/** A polynomial over the field, lowest term first, without leading zeros. */
+typedef std::vector<uint32_t> Poly;
+
+void Trim(Poly& p)
+{
+    while (!p.empty() && p.back() == 0)
+        p.pop_back();
+}
+
+void MakeMonic(Poly& p)
+{
+    uint32_t inv = FieldInv(p.back());
+    for (uint32_t& coeff : p)
+        coeff = FieldMul(coeff, inv);
+}
+
+/** Reduce p modulo the monic polynomial m, returning the quotient. */
+Poly DivMod(Poly& p, const Poly& m)
+{
+    size_t nDegree = m.size() - 1;
+    Poly quotient(p.size() > nDegree ? p.size() - nDegree : 0, 0);
+    while (p.size() > nDegree) {
+        uint32_t lead = p.back();
+        size_t nShift = p.size() - 1 - nDegree;
+        quotient[nShift] = lead;
+        if (lead) {
+            for (size_t i = 0; i < nDegree; i++)
+                p[nShift + i] ^= FieldMul(lead, m[i]);
+        }
+        p.pop_back();
+    }
+    Trim(p);
+    Trim(quotient);
+    return quotient;
+}
+
+Poly SquareMod(const Poly& p, const Poly& m)
+{
+    Poly r(p.empty() ? 0 : 2 * p.size() - 1, 0);
+    for (size_t i = 0; i < p.size(); i++)
+        r[2 * i] = FieldMul(p[i], p[i]);
+    DivMod(r, m);
+    return r;
+}
+
+Poly Gcd(Poly a, Poly b)
+{
+    while (!b.empty()) {
+        MakeMonic(b);
+        DivMod(a, b);
+        std::swap(a, b);
+    }
+    MakeMonic(a);
+    return a;
+}
+
+/** The trace of beta * z modulo p: the sum of (beta * z)^(2^i) for i < 32. */
+Poly Trace(uint32_t beta, const Poly& p)
+{
+    Poly t = {0, beta};
+    DivMod(t, p);
+    Poly sum = t;
+    for (int i = 1; i < 32; i++) {
+        t = SquareMod(t, p);
+        sum.resize(std::max(sum.size(), t.size()), 0);
+        for (size_t j = 0; j < t.size(); j++)
+            sum[j] ^= t[j];
+    }
+    Trim(sum);
+    return sum;
+}
+
+/**
+ * Find the roots of a monic polynomial that is a product of distinct linear
+ * factors, by splitting it along the roots whose trace with a random beta is
+ * zero and recursing on both halves.
+ */
+bool FindRoots(const Poly& p, std::vector<uint32_t>& roots, uint32_t& nRand)
+{
+    if (p.size() == 2) {
+        roots.push_back(p[0]);
+        return true;
+    }
+    for (int i = 0; i < MAX_SPLIT_ATTEMPTS; i++) {
+        // xorshift32
+        nRand ^= nRand << 13;
+        nRand ^= nRand >> 17;
+        nRand ^= nRand << 5;
+        Poly factor = Gcd(p, Trace(nRand, p));
+        if (factor.size() > 1 && factor.size() < p.size()) {
+            Poly rest = p;
+            Poly cofactor = DivMod(rest, factor);
+            return FindRoots(factor, roots, nRand) && FindRoots(cofactor, roots, nRand);
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void CPinSketch::Add(uint32_t element)
+{
+    if (element == 0)
+        return;
+    uint32_t square = FieldMul(element, element);
+    uint32_t power = element;
+    for (uint32_t& syndrome : vSyndromes) {
+        syndrome ^= power;
+        power = FieldMul(power, square);
+    }
+}
+
+void CPinSketch::Merge(const CPinSketch& other)
+{
+    for (size_t i = 0; i < std::min(vSyndromes.size(), other.vSyndromes.size()); i++)
+        vSyndromes[i] ^= other.vSyndromes[i];
+}
+
+bool CPinSketch::Decode(std::vector<uint32_t>& elements) const
+{
+    elements.clear();
+    if (std::all_of(vSyndromes.begin(), vSyndromes.end(), [](uint32_t s) { return s == 0; }))
+        return true;
+
+    // The even power sums follow from the odd ones, as s_2k = s_k^2.
+    size_t nSums = 2 * vSyndromes.size();
+    std::vector<uint32_t> sums(nSums);
+    for (size_t n = 1; n <= nSums; n++)
+        sums[n - 1] = n % 2 ? vSyndromes[n / 2] : FieldMul(sums[n / 2 - 1], sums[n / 2 - 1]);
+
+    // Berlekamp-Massey finds the shortest recurrence of the power sums, whose
+    // connection polynomial has the inverses of the elements as its roots.
+    Poly connection = {1};
+    Poly previous = {1};
+    size_t nLength = 0;
+    size_t nShift = 1;
+    uint32_t previousDiscrepancy = 1;
+    for (size_t n = 0; n < nSums; n++) {
+        uint32_t discrepancy = sums[n];
+        for (size_t i = 1; i <= nLength && i < connection.size(); i++)
+            discrepancy ^= FieldMul(connection[i], sums[n - i]);
+        if (discrepancy == 0) {
+            nShift++;
+            continue;
+        }
+        uint32_t coeff = FieldMul(discrepancy, FieldInv(previousDiscrepancy));
+        Poly updated = connection;
+        updated.resize(std::max(updated.size(), previous.size() + nShift), 0);
+        for (size_t i = 0; i < previous.size(); i++)
+            updated[i + nShift] ^= FieldMul(coeff, previous[i]);
+        if (2 * nLength <= n) {
+            previous = connection;
+            nLength = n + 1 - nLength;
+            previousDiscrepancy = discrepancy;
+            nShift = 1;
+        } else {
+            nShift++;
+        }
+        connection = updated;
+    }
+    Trim(connection);
+    if (nLength > vSyndromes.size() || connection.size() != nLength + 1)
+        return false;
+
+    // Reversing the connection polynomial gives one with the elements
+    // themselves as roots. It must split into distinct linear factors, that
+    // is divide z^(2^32) - z.
+    Poly locator(connection.rbegin(), connection.rend());
+    Poly z = {0, 1};
+    DivMod(z, locator);
+    Poly frobenius = z;
+    for (int i = 0; i < 32; i++)
+        frobenius = SquareMod(frobenius, locator);
+    if (frobenius != z)
+        return false;
+
+    uint32_t nRand = 0x9e3779b9;
+    if (!FindRoots(locator, elements, nRand) || elements.size() != nLength) {
+        elements.clear();
+        return false;
+    }
+
+    // Make sure the elements found really account for the whole sketch.
+    CPinSketch check(vSyndromes.size());
+    for (uint32_t element : elements)
+        check.Add(element);
+    if (check.vSyndromes != vSyndromes) {
+        elements.clear();
+        return false;
+    }
+    return true;
+}
+
+std::vector<unsigned char> CPinSketch::Serialize() const
+{
+    std::vector<unsigned char> data;
+    data.reserve(4 * vSyndromes.size());
+    for (uint32_t syndrome : vSyndromes) {
+        for (int i = 0; i < 4; i++)
+            data.push_back((syndrome >> (8 * i)) & 0xff);
+    }
+    return data;
+}
+
+bool CPinSketch::Deserialize(const std::vector<unsigned char>& data, CPinSketch& sketch)
+{
+    if (data.size() % 4)
+        return false;
+    sketch.vSyndromes.assign(data.size() / 4, 0);
+    for (size_t i = 0; i < data.size(); i++)
+        sketch.vSyndromes[i / 4] |= uint32_t(data[i]) << (8 * (i % 4));
+    return true;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_PINSKETCH_H
+#define BITCOIN_PINSKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A PinSketch of a set of nonzero 32-bit elements: the odd power sums of its
+ * elements in GF(2^32). Sketches combine with XOR, so combining the sketches
+ * of two sets gives the sketch of their symmetric difference, which can be
+ * recovered as long as it has no more elements than the sketch's capacity.
+ * Serialized, a sketch of capacity c takes 4c bytes.
+ */
+class CPinSketch
+{
+private:
+    //! The sums of the 1st, 3rd, 5th, ... powers of the elements.
+    std::vector<uint32_t> vSyndromes;
+
+public:
+    explicit CPinSketch(size_t nCapacity) : vSyndromes(nCapacity, 0) {}
+
+    size_t Capacity() const { return vSyndromes.size(); }
+
+    /** Add an element, or remove it if it is already in the set. Zero is ignored. */
+    void Add(uint32_t element);
+
+    /** Combine with a sketch of the same capacity. */
+    void Merge(const CPinSketch& other);
+
+    /**
+     * Recover the elements of the set. Returns false if it has more elements
+     * than the capacity, in which case nothing is known about them.
+     */
+    bool Decode(std::vector<uint32_t>& elements) const;
+
+    std::vector<unsigned char> Serialize() const;
+
+    /** Read a sketch serialized by Serialize(). Returns false if the data is not a whole number of elements. */
+    static bool Deserialize(const std::vector<unsigned char>& data, CPinSketch& sketch);
+};
+
+#endif // BITCOIN_PINSKETCH_H
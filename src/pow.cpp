@@ -9,18 +9,75 @@
 #include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "crypto/sha256.h"
 // Juno Cash: Legacy Equihash includes - kept for reference
 // #include "crypto/equihash.h"
 #include "crypto/randomx_wrapper.h"
+#include "cuckoocache.h"
+#include "hash.h"
 #include "primitives/block.h"
+#include "random.h"
 #include "streams.h"
 #include "uint256.h"
 #include "util/system.h"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+#include <boost/thread.hpp>
+
 #include <librustzcash.h>
 // Juno Cash: Legacy Equihash includes - kept for reference
 // #include <rust/equihash.h>
 
+namespace {
+
+/**
+ * The sum of the targets in the averaging window that ends at a block, and
+ * the block's median time past. Both depend only on the block's ancestry,
+ * so they are keyed by its hash.
+ */
+struct AveragingWindowState {
+    uint256 hash;
+    int nWindow{0};
+    arith_uint256 bnTot;
+    int64_t nMedianTimePast{0};
+};
+
+// States of recently seen blocks, slotted by height. During header sync and
+// mining, a block's state is then derived from its parent's by adding one
+// target and removing another, instead of walking the whole window.
+const size_t AVERAGING_WINDOW_CACHE_SIZE = 1024;
+std::mutex cs_averagingWindowCache;
+AveragingWindowState averagingWindowCache[AVERAGING_WINDOW_CACHE_SIZE];
+
+std::optional<AveragingWindowState> LookupAveragingWindow(const CBlockIndex* pindex, int nWindow)
+{
+    // Block indices without a hash (in tests) are never cached.
+    if (pindex == nullptr || pindex->phashBlock == nullptr) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(cs_averagingWindowCache);
+    const auto& state = averagingWindowCache[pindex->nHeight % AVERAGING_WINDOW_CACHE_SIZE];
+    if (state.nWindow != nWindow || state.hash != *pindex->phashBlock) {
+        return std::nullopt;
+    }
+    return state;
+}
+
+void StoreAveragingWindow(const CBlockIndex* pindex, const AveragingWindowState& state)
+{
+    if (pindex->phashBlock == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(cs_averagingWindowCache);
+    averagingWindowCache[pindex->nHeight % AVERAGING_WINDOW_CACHE_SIZE] = state;
+}
+
+} // namespace
+
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
@@ -48,12 +105,9 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
     }
 
     // Find the first block in the averaging interval
+    const int nWindow = params.nPowAveragingWindow;
     const CBlockIndex* pindexFirst = pindexLast;
-    arith_uint256 bnTot {0};
-    for (int i = 0; pindexFirst && i < params.nPowAveragingWindow; i++) {
-        arith_uint256 bnTmp;
-        bnTmp.SetCompact(pindexFirst->nBits);
-        bnTot += bnTmp;
+    for (int i = 0; pindexFirst && i < nWindow; i++) {
         pindexFirst = pindexFirst->pprev;
     }
 
@@ -61,6 +115,37 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
     if (pindexFirst == NULL)
         return nProofOfWorkLimit;
 
+    auto state = LookupAveragingWindow(pindexLast, nWindow);
+    if (!state.has_value()) {
+        state = AveragingWindowState();
+        state->hash = pindexLast->GetBlockHash();
+        state->nWindow = nWindow;
+
+        auto parentState = LookupAveragingWindow(pindexLast->pprev, nWindow);
+        if (parentState.has_value()) {
+            // The parent's window, moved along by one block.
+            arith_uint256 bnAdded, bnRemoved;
+            bnAdded.SetCompact(pindexLast->nBits);
+            bnRemoved.SetCompact(pindexFirst->nBits);
+            state->bnTot = parentState->bnTot + bnAdded - bnRemoved;
+        } else {
+            const CBlockIndex* pindex = pindexLast;
+            for (int i = 0; i < nWindow; i++) {
+                arith_uint256 bnTmp;
+                bnTmp.SetCompact(pindex->nBits);
+                state->bnTot += bnTmp;
+                pindex = pindex->pprev;
+            }
+        }
+        state->nMedianTimePast = pindexLast->GetMedianTimePast();
+        StoreAveragingWindow(pindexLast, *state);
+    }
+    arith_uint256 bnTot {state->bnTot};
+
+    auto firstState = LookupAveragingWindow(pindexFirst, nWindow);
+    int64_t nFirstMedianTimePast = firstState.has_value() ?
+        firstState->nMedianTimePast : pindexFirst->GetMedianTimePast();
+
     // The protocol specification leaves MeanTarget(height) as a rational, and takes the floor
     // only after dividing by AveragingWindowTimespan in the computation of Threshold(height):
     // <https://zips.z.cash/protocol/protocol.pdf#diffadjustment>
@@ -70,7 +155,7 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
     arith_uint256 bnAvg {bnTot / params.nPowAveragingWindow};
 
     return CalculateNextWorkRequired(bnAvg,
-                                     pindexLast->GetMedianTimePast(), pindexFirst->GetMedianTimePast(),
+                                     state->nMedianTimePast, nFirstMedianTimePast,
                                      params,
                                      pindexLast->nHeight + 1);
 }
@@ -129,64 +214,336 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const Consensus::Params&
 }
 */
 
-bool CheckRandomXSolution(const CBlockHeader *pblock, const Consensus::Params& params,
-                         const CBlockIndex* pindexPrev)
+namespace {
+/**
+ * Entries are nonced hashes, so (as for the signature cache) we can use their
+ * bytes directly as the cuckoo cache hashes.
+ */
+class PoWCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select <8, "PoWCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin()+4*hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Valid RandomX solution cache, to avoid hashing the same header more than
+ * once (when the header is received, when the full block is checked, and
+ * again in submitblock/TestBlockValidity).
+ */
+class CPoWCache
+{
+private:
+    //! Entries are SHA256(nonce || seed hash || block hash); the block hash
+    //! commits to the whole header including nSolution.
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, PoWCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_powcache;
+
+public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+    CPoWCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(DEFAULT_MAX_POW_CACHE_SIZE * ((size_t) 1 << 20));
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256& seedHash, const uint256& blockHash)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(seedHash.begin(), 32).Write(blockHash.begin(), 32).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        setValid.insert(entry);
+    }
+    uint32_t setup_bytes(size_t n)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CPoWCache powCache;
+}
+
+void InitPoWCache(size_t nMaxCacheSize)
+{
+    if (nMaxCacheSize <= 0) return;
+    size_t nElems = powCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for RandomX solution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+void GetPoWCacheStats(uint64_t& nHits, uint64_t& nMisses)
+{
+    nHits = powCache.nHits.load();
+    nMisses = powCache.nMisses.load();
+}
+
+namespace {
+
+/** The seed block hash that a block's branch has at a seed height. */
+struct SeedHashEntry {
+    uint256 hash;
+    uint64_t nSeedHeight{0};
+    uint256 seedHash;
+};
+
+// Seed hashes of recently seen blocks, slotted by height and keyed by block
+// hash, so that an entry belongs to a single branch and a reorg below the
+// seed block simply misses. A block shares its parent's seed block unless it
+// is the seed block, so during sync each header takes its parent's entry
+// instead of walking the skip list back to the seed block.
+const size_t SEED_HASH_CACHE_SIZE = 1024;
+std::mutex cs_seedHashCache;
+SeedHashEntry seedHashCache[SEED_HASH_CACHE_SIZE];
+
+bool LookupSeedHash(const CBlockIndex* pindex, uint64_t nSeedHeight, uint256& seedHash)
+{
+    // Block indices without a hash (in tests) are never cached.
+    if (pindex == nullptr || pindex->phashBlock == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cs_seedHashCache);
+    const auto& entry = seedHashCache[pindex->nHeight % SEED_HASH_CACHE_SIZE];
+    if (entry.nSeedHeight != nSeedHeight || entry.hash != *pindex->phashBlock) {
+        return false;
+    }
+    seedHash = entry.seedHash;
+    return true;
+}
+
+void StoreSeedHash(const CBlockIndex* pindex, uint64_t nSeedHeight, const uint256& seedHash)
+{
+    if (pindex->phashBlock == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(cs_seedHashCache);
+    seedHashCache[pindex->nHeight % SEED_HASH_CACHE_SIZE] = {*pindex->phashBlock, nSeedHeight, seedHash};
+}
+
+} // namespace
+
+bool GetRandomXSeedHash(const CBlockIndex* pindex, uint64_t nHeight, uint256& seedHash)
+{
+    uint64_t seedHeight = RandomX_SeedHeight(nHeight);
+    if (seedHeight == 0) {
+        // Genesis epoch - use genesis seed
+        seedHash.SetNull();
+        *seedHash.begin() = 0x08;
+        return true;
+    }
+
+    if (pindex == nullptr || (uint64_t)pindex->nHeight < seedHeight) return false;
+    if (LookupSeedHash(pindex, seedHeight, seedHash)) return true;
+
+    // Get seed block hash from the parent's entry, or else from the chain
+    if ((uint64_t)pindex->nHeight == seedHeight) {
+        seedHash = pindex->GetBlockHash();
+    } else if (!LookupSeedHash(pindex->pprev, seedHeight, seedHash)) {
+        const CBlockIndex* pindexSeed = pindex->GetAncestor(seedHeight);
+        if (!pindexSeed) return false;
+        seedHash = pindexSeed->GetBlockHash();
+    }
+    StoreSeedHash(pindex, seedHeight, seedHash);
+    return true;
+}
+
+void PrepareNextRandomXSeed(const CBlockIndex* pindexTip, const Consensus::Params& params)
+{
+    if (pindexTip == nullptr || params.fPowFastHash) return;
+
+    uint64_t nNextHeight = pindexTip->nHeight + 1;
+    uint64_t nNextSeedHeight = RandomX_SeedHeight(nNextHeight + RANDOMX_SEEDHASH_EPOCH_LAG);
+    if (nNextSeedHeight == RandomX_SeedHeight(nNextHeight)) return;
+
+    // Wait until the seed block is buried so a short reorg does not waste the build
+    if ((uint64_t)pindexTip->nHeight < nNextSeedHeight + RANDOMX_SEEDHASH_PREBUILD_DEPTH) return;
+
+    uint256 seedHash;
+    if (!GetRandomXSeedHash(pindexTip, nNextHeight + RANDOMX_SEEDHASH_EPOCH_LAG, seedHash)) return;
+    RandomX_PrepareSeedHash(seedHash.begin(), 32);
+}
+
+static const unsigned char REGTEST_FAST_POW_PERSONALIZATION[blake2b::PERSONALBYTES] =
+    {'J','u','n','o','R','e','g','t','e','s','t','F','a','s','t','P'};
+
+bool GetPoWHash(const Consensus::Params& params, const uint256& seedHash,
+                const void* input, size_t inputSize, uint256& hash)
 {
+    if (params.fPowFastHash) {
+        CBLAKE2bWriter ss(SER_GETHASH, 0, REGTEST_FAST_POW_PERSONALIZATION);
+        ss.write((const char*)input, inputSize);
+        hash = ss.GetHash();
+        return true;
+    }
+    return RandomX_Hash_WithSeed(seedHash.begin(), 32, input, inputSize, hash.begin());
+}
+
+bool CheckRandomXSolutionWithSeed(const CBlockHeader *pblock, const Consensus::Params& params,
+                                  const uint256& seedHash, uint64_t blockHeight)
+{
+    // Verify stored solution size before doing any hashing
+    if (pblock->nSolution.size() != 32) {
+        LogPrintf("CheckRandomXSolution: Invalid solution size %d for height %d\n", pblock->nSolution.size(), blockHeight);
+        return false;
+    }
+
+    uint256 entry;
+    powCache.ComputeEntry(entry, seedHash, pblock->GetHash());
+    if (powCache.Get(entry)) {
+        ++powCache.nHits;
+        return true;
+    }
+    ++powCache.nMisses;
+
     // Serialize header (minus solution) + nonce for RandomX input
     CEquihashInput I{*pblock};
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << I;
     ss << pblock->nNonce;
 
-    uint64_t blockHeight = 0;
-    uint256 seedHash;
+    // Calculate RandomX hash with specific seed
+    uint256 hash;
+    if (!GetPoWHash(params, seedHash, ss.data(), ss.size(), hash)) {
+        LogPrintf("CheckRandomXSolution: RandomX_Hash_WithSeed failed for height %d\n", blockHeight);
+        return false;
+    }
 
-    if (pindexPrev != nullptr) {
-        blockHeight = pindexPrev->nHeight + 1;
-        uint64_t seedHeight = RandomX_SeedHeight(blockHeight);
+    uint256 storedHash;
+    memcpy(storedHash.begin(), pblock->nSolution.data(), 32);
 
-        if (seedHeight == 0) {
-            // Genesis epoch - use genesis seed
-            seedHash.SetNull();
-            *seedHash.begin() = 0x08;
-        } else {
-            // Get seed block hash from chain
-            const CBlockIndex* pindexSeed = pindexPrev->GetAncestor(seedHeight);
-            if (!pindexSeed) return false;
-            seedHash = pindexSeed->GetBlockHash();
+    bool match = (hash == storedHash);
+    if (!match) {
+        LogPrintf("CheckRandomXSolution: Hash mismatch at height %d\n", blockHeight);
+        LogPrintf("  Seed height: %d, Seed hash: %s\n", RandomX_SeedHeight(blockHeight), seedHash.GetHex());
+        LogPrintf("  Input size: %d bytes\n", ss.size());
+        LogPrintf("  Calculated: %s\n", hash.GetHex());
+        LogPrintf("  Stored:     %s\n", storedHash.GetHex());
+        return false;
+    }
+
+    powCache.Set(entry);
+    return true;
+}
+
+bool CheckRandomXSolutionsWithSeed(const std::vector<const CBlockHeader*>& headers, const Consensus::Params& params,
+                                   const uint256& seedHash, std::vector<bool>& vValid)
+{
+    vValid.assign(headers.size(), false);
+
+    // Answer what we can from the cache, and collect the rest for one batch
+    std::vector<size_t> vPending;
+    std::vector<uint256> vEntries(headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (headers[i]->nSolution.size() != 32) {
+            LogPrintf("CheckRandomXSolution: Invalid solution size %d for block %s\n",
+                      headers[i]->nSolution.size(), headers[i]->GetHash().GetHex());
+            continue;
+        }
+        powCache.ComputeEntry(vEntries[i], seedHash, headers[i]->GetHash());
+        if (powCache.Get(vEntries[i])) {
+            ++powCache.nHits;
+            vValid[i] = true;
+            continue;
         }
+        ++powCache.nMisses;
+        vPending.push_back(i);
+    }
+    if (vPending.empty()) {
+        return std::find(vValid.begin(), vValid.end(), false) == vValid.end();
+    }
 
-        // Calculate RandomX hash with specific seed
-        uint256 hash;
-        if (!RandomX_Hash_WithSeed(seedHash.begin(), 32, ss.data(), ss.size(), hash.begin())) {
-            LogPrintf("CheckRandomXSolution: RandomX_Hash_WithSeed failed for height %d\n", blockHeight);
-            return false;
+    // Serialize all pending headers (minus solution) + nonce into one buffer
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    size_t nInputSize = 0;
+    for (size_t i : vPending) {
+        size_t nStart = ss.size();
+        CEquihashInput I{*headers[i]};
+        ss << I;
+        ss << headers[i]->nNonce;
+        if (nInputSize == 0) {
+            nInputSize = ss.size() - nStart;
+        } else if (ss.size() - nStart != nInputSize) {
+            // Headers always serialize to the same size; don't batch anything odd
+            nInputSize = 0;
+            break;
         }
+    }
 
-        // Verify stored solution matches calculated hash
-        if (pblock->nSolution.size() != 32) {
-            LogPrintf("CheckRandomXSolution: Invalid solution size %d for height %d\n", pblock->nSolution.size(), blockHeight);
-            return false;
+    std::vector<uint256> vHashes(vPending.size());
+    if (params.fPowFastHash && nInputSize != 0) {
+        // Nothing to batch without a VM
+        for (size_t n = 0; n < vPending.size(); n++) {
+            GetPoWHash(params, seedHash, ss.data() + n * nInputSize, nInputSize, vHashes[n]);
         }
+    } else if (nInputSize == 0 ||
+        !RandomX_HashBatch(seedHash.begin(), 32, ss.data(), nInputSize, vPending.size(), vHashes.data())) {
+        LogPrintf("CheckRandomXSolution: RandomX_HashBatch failed for %u headers\n", vPending.size());
+        return false;
+    }
 
+    bool fAllValid = true;
+    for (size_t n = 0; n < vPending.size(); n++) {
+        size_t i = vPending[n];
         uint256 storedHash;
-        memcpy(storedHash.begin(), pblock->nSolution.data(), 32);
-
-        bool match = (hash == storedHash);
-        if (!match) {
-            LogPrintf("CheckRandomXSolution: Hash mismatch at height %d\n", blockHeight);
-            LogPrintf("  Seed height: %d, Seed hash: %s\n", seedHeight, seedHash.GetHex());
-            LogPrintf("  Input size: %d bytes\n", ss.size());
-            LogPrintf("  Calculated: %s\n", hash.GetHex());
+        memcpy(storedHash.begin(), headers[i]->nSolution.data(), 32);
+        if (vHashes[n] != storedHash) {
+            LogPrintf("CheckRandomXSolution: Hash mismatch for block %s\n", headers[i]->GetHash().GetHex());
+            LogPrintf("  Seed hash: %s\n", seedHash.GetHex());
+            LogPrintf("  Calculated: %s\n", vHashes[n].GetHex());
             LogPrintf("  Stored:     %s\n", storedHash.GetHex());
+            fAllValid = false;
+            continue;
         }
-        return match;
+        powCache.Set(vEntries[i]);
+        vValid[i] = true;
+    }
+    return fAllValid && std::find(vValid.begin(), vValid.end(), false) == vValid.end();
+}
+
+bool CheckRandomXSolution(const CBlockHeader *pblock, const Consensus::Params& params,
+                         const CBlockIndex* pindexPrev)
+{
+    if (pindexPrev != nullptr) {
+        uint256 seedHash;
+        if (!GetRandomXSeedHash(pindexPrev, pindexPrev->nHeight + 1, seedHash)) return false;
+        return CheckRandomXSolutionWithSeed(pblock, params, seedHash, pindexPrev->nHeight + 1);
     } else {
         // No pindexPrev - use current main seed (for mining/mempool)
+        if (pblock->nSolution.size() != 32) return false;
+
+        CEquihashInput I{*pblock};
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << I;
+        ss << pblock->nNonce;
+
         uint256 hash;
-        if (!RandomX_Hash_Block(ss.data(), ss.size(), hash)) return false;
+        if (params.fPowFastHash) {
+            GetPoWHash(params, uint256(), ss.data(), ss.size(), hash);
+        } else if (!RandomX_Hash_Block(ss.data(), ss.size(), hash)) {
+            return false;
+        }
 
-        if (pblock->nSolution.size() != 32) return false;
         uint256 storedHash;
         memcpy(storedHash.begin(), pblock->nSolution.data(), 32);
 
@@ -10,6 +10,10 @@
 #include "consensus/params.h"
 
 #include <stdint.h>
+#include <vector>
+
+/** Default for -maxpowcachesize, the size of the verified RandomX solution cache in MiB */
+static const unsigned int DEFAULT_MAX_POW_CACHE_SIZE = 1;
 
 class CBlockHeader;
 class CBlockIndex;
@@ -31,6 +35,51 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const Consensus::Params&)
 bool CheckRandomXSolution(const CBlockHeader *pblock, const Consensus::Params&,
                          const CBlockIndex* pindexPrev = nullptr);
 
+/**
+ * Find the RandomX seed hash for a block at nHeight. The seed block is looked
+ * up on the chain ending at pindex, which must reach the seed height.
+ */
+bool GetRandomXSeedHash(const CBlockIndex* pindex, uint64_t nHeight, uint256& seedHash);
+
+/**
+ * Compute the proof-of-work hash of input, a header without its solution
+ * followed by its nonce, for a block on seedHash. This is RandomX, except
+ * with fPowFastHash (regtest with -regtestfastpow), where it is a BLAKE2b
+ * hash of the same input, so that tests need no RandomX cache or VM.
+ */
+bool GetPoWHash(const Consensus::Params& params, const uint256& seedHash,
+                const void* input, size_t inputSize, uint256& hash);
+
+/**
+ * Check whether the RandomX solution in a block header is valid for an
+ * already-resolved seed. This does not touch the block index, so it may be
+ * called without holding cs_main.
+ */
+bool CheckRandomXSolutionWithSeed(const CBlockHeader *pblock, const Consensus::Params& params,
+                                  const uint256& seedHash, uint64_t blockHeight);
+
+/**
+ * Check the RandomX solutions of several headers that share a seed, hashing
+ * the ones not already in the solution cache as one batch on a single VM.
+ * vValid[i] is set to whether headers[i] is valid. Like
+ * CheckRandomXSolutionWithSeed, this may be called without holding cs_main.
+ *
+ * @return true if every header is valid
+ */
+bool CheckRandomXSolutionsWithSeed(const std::vector<const CBlockHeader*>& headers, const Consensus::Params& params,
+                                   const uint256& seedHash, std::vector<bool>& vValid);
+
+/**
+ * Once the seed block of the next RandomX epoch is buried under pindexTip,
+ * start building that seed's cache/dataset in the background.
+ */
+void PrepareNextRandomXSeed(const CBlockIndex* pindexTip, const Consensus::Params& params);
+
+/** To be called once in AppInit2/TestingSetup to size the verified RandomX solution cache */
+void InitPoWCache(size_t nMaxCacheSize);
+/** Number of RandomX solution checks answered from / missed in the verified solution cache */
+void GetPoWCacheStats(uint64_t& nHits, uint64_t& nMisses);
+
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
 arith_uint256 GetBlockProof(const CBlockIndex& block);
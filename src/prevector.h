@@ -305,6 +305,14 @@ public:
         return *item_ptr(pos);
     }
 
+    T* data() {
+        return item_ptr(0);
+    }
+
+    const T* data() const {
+        return item_ptr(0);
+    }
+
     void resize(size_type new_size) {
         if (size() > new_size) {
             erase(item_ptr(new_size), end());
@@ -14,6 +14,8 @@
 #include <rust/constants.h>
 
 #include <algorithm>
+#include <future>
+#include <thread>
 
 const unsigned char ZCASH_AUTH_DATA_HASH_PERSONALIZATION[blake2b::PERSONALBYTES] =
     {'Z','c','a','s','h','A','u','t','h','D','a','t','H','a','s','h'};
@@ -60,37 +62,73 @@ static uint64_t next_pow2(uint64_t x)
     return x + 1;
 }
 
+// Below this many node hashes per worker, a layer is cheaper to hash on the
+// calling thread than to hand out to workers.
+static const size_t MIN_AUTH_DATA_HASHES_PER_WORKER = 256;
+
+// Hashes adjacent pairs of nodes into the next layer of the auth data tree.
+static void HashAuthDataLayer(const std::vector<uint256>& layer, std::vector<uint256>& parents)
+{
+    static_assert(sizeof(uint256) == 32, "the children of each node must be adjacent");
+    parents.resize(layer.size() / 2);
+    auto hashRange = [&](size_t start, size_t end) {
+        if (start == end) return;
+        // Each node hashes its two children, which lie next to each other
+        // in the layer, so the range is hashed several nodes at a time.
+        blake2b::hash_many(
+            32,
+            {ZCASH_AUTH_DATA_HASH_PERSONALIZATION, blake2b::PERSONALBYTES},
+            {layer[2*start].begin(), 64 * (end - start)},
+            64,
+            {parents[start].begin(), 32 * (end - start)});
+    };
+
+    size_t nWorkers = std::max(
+        std::min((size_t)std::thread::hardware_concurrency(), parents.size() / MIN_AUTH_DATA_HASHES_PER_WORKER),
+        (size_t)1);
+    size_t chunkSize = (parents.size() + nWorkers - 1) / nWorkers;
+    std::vector<std::future<void>> workers;
+    for (size_t w = 1; w < nWorkers; w++) {
+        size_t start = std::min(w * chunkSize, parents.size());
+        size_t end = std::min(start + chunkSize, parents.size());
+        workers.push_back(std::async(std::launch::async, hashRange, start, end));
+    }
+    hashRange(0, std::min(chunkSize, parents.size()));
+    for (auto& worker : workers) {
+        worker.get();
+    }
+}
+
 uint256 CBlock::BuildAuthDataMerkleTree() const
 {
-    std::vector<uint256> tree;
+    if (vtx.empty()) {
+        return uint256();
+    }
     auto perfectSize = next_pow2(vtx.size());
     assert((perfectSize & (perfectSize - 1)) == 0);
-    size_t expectedSize = std::max(perfectSize*2, (uint64_t)1) - 1;  // The total number of nodes.
-    tree.reserve(expectedSize);
+
+    // Only the layer being hashed and its parents are kept; large layers
+    // are hashed across several threads.
+    std::vector<uint256> layer;
+    layer.reserve(perfectSize);
 
     // Add the leaves to the tree. v1-v4 transactions will append empty leaves.
     for (auto &tx : vtx) {
-        tree.push_back(tx.GetAuthDigest());
+        layer.push_back(tx.GetAuthDigest());
     }
     // Append empty leaves until we get a perfect tree.
-    tree.insert(tree.end(), perfectSize - vtx.size(), uint256());
-    assert(tree.size() == perfectSize);
-
-    int j = 0;
-    for (int layerWidth = perfectSize; layerWidth > 1; layerWidth = layerWidth / 2) {
-        for (int i = 0; i < layerWidth; i += 2) {
-            CBLAKE2bWriter ss(SER_GETHASH, 0, ZCASH_AUTH_DATA_HASH_PERSONALIZATION);
-            ss << tree[j + i];
-            ss << tree[j + i + 1];
-            tree.push_back(ss.GetHash());
-        }
+    layer.insert(layer.end(), perfectSize - vtx.size(), uint256());
+    assert(layer.size() == perfectSize);
 
+    std::vector<uint256> parents;
+    parents.reserve(perfectSize / 2);
+    while (layer.size() > 1) {
+        HashAuthDataLayer(layer, parents);
         // Move to the next layer.
-        j += layerWidth;
+        layer.swap(parents);
     }
 
-    assert(tree.size() == expectedSize);
-    return (tree.empty() ? uint256() : tree.back());
+    return layer[0];
 }
 
 std::string CBlock::ToString() const
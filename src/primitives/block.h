@@ -7,6 +7,7 @@
 #ifndef BITCOIN_PRIMITIVES_BLOCK_H
 #define BITCOIN_PRIMITIVES_BLOCK_H
 
+#include "prevector.h"
 #include "primitives/transaction.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -36,7 +37,8 @@ public:
     uint32_t nTime;
     uint32_t nBits;
     uint256 nNonce;
-    std::vector<unsigned char> nSolution;
+    //! RandomX hash of the header, 32 bytes, so it is kept inline
+    prevector<32, unsigned char> nSolution;
 
     CBlockHeader()
     {
@@ -153,7 +155,8 @@ public:
         *((CBlockHeader*)this) = header;
     }
 
-    ADD_SERIALIZE_METHODS;
+    // Written once per proof-of-work check, so it goes out in one piece.
+    ADD_FIXED_SIZE_SERIALIZE_METHODS(HEADER_SIZE - 32);
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
@@ -5,11 +5,16 @@
 #ifndef ZCASH_PRIMITIVES_ORCHARD_H
 #define ZCASH_PRIMITIVES_ORCHARD_H
 
+#include "consensus/consensus.h"
+#include "memusage.h"
 #include "streams.h"
 #include "streams_rust.h"
 
 #include <amount.h>
 
+#include <atomic>
+#include <mutex>
+
 #include <rust/bridge.h>
 #include <rust/orchard/wallet.h>
 #include "zcash/address/orchard.hpp"
@@ -20,31 +25,104 @@ namespace orchard { class UnauthorizedBundle; }
 
 /**
  * The Orchard component of an authorized transaction.
+ *
+ * A deserialized bundle is kept as the bytes it was read from, and only
+ * parsed into its Rust representation the first time its details are
+ * needed. A relayed transaction that is dropped before it is validated, for
+ * instance because it is already in the mempool, is never parsed.
  */
 class OrchardBundle
 {
 private:
-    /// An optional Orchard bundle.
+    /// An optional Orchard bundle, once parsed.
     /// Memory is allocated by Rust.
-    rust::Box<orchard_bundle::Bundle> inner;
+    mutable rust::Box<orchard_bundle::Bundle> inner;
+    /// The serialized bundle while it hasn't been parsed; empty afterwards.
+    mutable std::vector<unsigned char> raw;
+    mutable std::atomic<bool> fParsed{true};
+    mutable std::mutex cs;
 
     OrchardBundle(OrchardBundlePtr* bundle) : inner(orchard_bundle::from_raw_box(bundle)) {}
 
+    /** Parse the bundle's bytes, if that hasn't happened yet. */
+    void Parse() const
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (fParsed) {
+            return;
+        }
+        try {
+            inner = orchard_bundle::parse_bytes({raw.data(), raw.size()});
+        } catch (const std::exception& e) {
+            throw std::ios_base::failure(e.what());
+        }
+        std::vector<unsigned char>().swap(raw);
+        fParsed.store(true, std::memory_order_release);
+    }
+
+    const rust::Box<orchard_bundle::Bundle>& Inner() const
+    {
+        if (!fParsed.load(std::memory_order_acquire)) {
+            Parse();
+        }
+        return inner;
+    }
+
+    /** Read n bytes of the bundle from s onto the end of raw. */
+    template<typename Stream>
+    void ReadRaw(Stream& s, uint64_t n)
+    {
+        if (n > MAX_TX_SIZE_AFTER_SAPLING - raw.size()) {
+            throw std::ios_base::failure("Orchard bundle is larger than a transaction");
+        }
+        size_t nPos = raw.size();
+        raw.resize(nPos + n);
+        if (n > 0) {
+            s.read(reinterpret_cast<char*>(raw.data() + nPos), n);
+        }
+    }
+
+    /** Read a compact size from s onto the end of raw, and return its value. */
+    template<typename Stream>
+    uint64_t ReadRawCompactSize(Stream& s)
+    {
+        size_t nPos = raw.size();
+        ReadRaw(s, 1);
+        unsigned char chSize = raw[nPos];
+        ReadRaw(s, chSize < 253 ? 0 : chSize == 253 ? 2 : chSize == 254 ? 4 : 8);
+        CSpanReader reader(SER_NETWORK, PROTOCOL_VERSION,
+            reinterpret_cast<const char*>(raw.data() + nPos),
+            reinterpret_cast<const char*>(raw.data() + raw.size()));
+        return ReadCompactSize(reader);
+    }
+
     friend class OrchardMerkleFrontier;
+    friend class OrchardCommitmentBatch;
     friend class OrchardWallet;
     friend class orchard::UnauthorizedBundle;
 public:
+    /// The serialized size of an action, and of the fields that follow the
+    /// actions of a non-empty bundle up to its proof.
+    static const size_t ACTION_SIZE = 820;
+    static const size_t BUNDLE_FIELDS_SIZE = 1 + 8 + 32;
+    static const size_t SIGNATURE_SIZE = 64;
+
     OrchardBundle() : inner(orchard_bundle::none()) {}
 
-    OrchardBundle(OrchardBundle&& bundle) : inner(std::move(bundle.inner)) {}
+    OrchardBundle(OrchardBundle&& bundle) :
+        inner(std::move(bundle.inner)), raw(std::move(bundle.raw)), fParsed(bundle.fParsed.load()) {}
 
-    OrchardBundle(const OrchardBundle& bundle) :
-        inner(bundle.inner->box_clone()) {}
+    OrchardBundle(const OrchardBundle& bundle) : inner(orchard_bundle::none())
+    {
+        *this = bundle;
+    }
 
     OrchardBundle& operator=(OrchardBundle&& bundle)
     {
         if (this != &bundle) {
             inner = std::move(bundle.inner);
+            raw = std::move(bundle.raw);
+            fParsed = bundle.fParsed.load();
         }
         return *this;
     }
@@ -52,21 +130,42 @@ public:
     OrchardBundle& operator=(const OrchardBundle& bundle)
     {
         if (this != &bundle) {
-            inner = bundle.inner->box_clone();
+            // An unparsed bundle is copied as its bytes.
+            std::lock_guard<std::mutex> lock(bundle.cs);
+            if (bundle.fParsed) {
+                inner = bundle.inner->box_clone();
+                raw.clear();
+            } else {
+                raw = bundle.raw;
+            }
+            fParsed = bundle.fParsed.load();
         }
         return *this;
     }
 
     const rust::Box<orchard_bundle::Bundle>& GetDetails() const {
-        return inner;
+        return Inner();
     }
 
     size_t RecursiveDynamicUsage() const {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            if (!fParsed) {
+                return memusage::MallocUsage(raw.capacity());
+            }
+        }
         return inner->recursive_dynamic_usage();
     }
 
     template<typename Stream>
     void Serialize(Stream& s) const {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            if (!fParsed) {
+                s.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+                return;
+            }
+        }
         try {
             inner->serialize(*ToRustStream(s));
         } catch (const std::exception& e) {
@@ -74,23 +173,42 @@ public:
         }
     }
 
+    /**
+     * Read the bundle's bytes off the stream in bulk, following just enough
+     * of its layout to find where it ends, rather than parsing it through
+     * many small reads across the Rust bridge.
+     */
     template<typename Stream>
     void Unserialize(Stream& s) {
-        try {
-            inner = orchard_bundle::parse(*ToRustStream(s));
-        } catch (const std::exception& e) {
-            throw std::ios_base::failure(e.what());
+        raw.clear();
+        uint64_t nActions = ReadRawCompactSize(s);
+        if (nActions == 0) {
+            inner = orchard_bundle::none();
+            raw.clear();
+            fParsed = true;
+            return;
         }
+        if (nActions > MAX_TX_SIZE_AFTER_SAPLING / ACTION_SIZE) {
+            throw std::ios_base::failure("Orchard bundle is larger than a transaction");
+        }
+        ReadRaw(s, nActions * ACTION_SIZE + BUNDLE_FIELDS_SIZE);
+        uint64_t nProofSize = ReadRawCompactSize(s);
+        ReadRaw(s, nProofSize);
+        ReadRaw(s, (nActions + 1) * SIGNATURE_SIZE);
+        fParsed = false;
     }
 
     /// Returns true if this contains an Orchard bundle, or false if there is no
     /// Orchard component.
-    bool IsPresent() const { return inner->is_present(); }
+    bool IsPresent() const {
+        // Only a bundle with actions is kept unparsed.
+        return !fParsed.load(std::memory_order_acquire) || inner->is_present();
+    }
 
     /// Returns the net value entering or exiting the Orchard pool as a result of this
     /// bundle.
     CAmount GetValueBalance() const {
-        return inner->value_balance_zat();
+        return Inner()->value_balance_zat();
     }
 
     /// Queues this bundle's authorization for validation.
@@ -99,15 +217,15 @@ public:
     void QueueAuthValidation(
         orchard::BatchValidator& batch, const uint256& sighash) const
     {
-        batch.add_bundle(inner->box_clone(), sighash.GetRawBytes());
+        batch.add_bundle(Inner()->box_clone(), sighash.GetRawBytes());
     }
 
     const size_t GetNumActions() const {
-        return inner->num_actions();
+        return Inner()->num_actions();
     }
 
     const std::vector<uint256> GetNullifiers() const {
-        const auto actions = inner->actions();
+        const auto actions = Inner()->actions();
         std::vector<uint256> result;
         result.reserve(actions.size());
         for (const auto& action : actions) {
@@ -118,22 +236,22 @@ public:
 
     const std::optional<uint256> GetAnchor() const {
         if (IsPresent()) {
-            return uint256::FromRawBytes(inner->anchor());
+            return uint256::FromRawBytes(Inner()->anchor());
         } else {
             return std::nullopt;
         }
     }
 
     bool OutputsEnabled() const {
-        return inner->enable_outputs();
+        return Inner()->enable_outputs();
     }
 
     bool SpendsEnabled() const {
-        return inner->enable_spends();
+        return Inner()->enable_spends();
     }
 
     bool CoinbaseOutputsAreValid() const {
-        return inner->coinbase_outputs_are_valid();
+        return Inner()->coinbase_outputs_are_valid();
     }
 };
 
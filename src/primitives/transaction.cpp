@@ -133,9 +133,20 @@ uint256 CMutableTransaction::GetAuthDigest() const
     return authDigest;
 }
 
+// Serialized transactions larger than this do not keep their buffer for
+// the next UpdateHash on the same thread.
+static const size_t MAX_RETAINED_HASH_BUFFER = 1 << 20;
+
 void CTransaction::UpdateHash() const
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    // Every transaction that is built or deserialized is serialized again
+    // here, so each thread reuses one buffer rather than growing a new one
+    // for every transaction in a block.
+    static thread_local CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    if (ss.size() > MAX_RETAINED_HASH_BUFFER) {
+        ss = CDataStream(SER_NETWORK, PROTOCOL_VERSION);
+    }
+    ss.clear();
     ss << *this;
     if (!zcash_transaction_digests(
         reinterpret_cast<const unsigned char*>(ss.data()),
@@ -145,6 +156,7 @@ void CTransaction::UpdateHash() const
     {
         throw std::ios_base::failure("CTransaction::UpdateHash: Invalid transaction format");
     }
+    *const_cast<size_t*>(&nTotalSize) = ss.size();
 }
 
 CTransaction::CTransaction() : nVersion(CTransaction::SPROUT_MIN_CURRENT_VERSION),
@@ -153,7 +165,10 @@ CTransaction::CTransaction() : nVersion(CTransaction::SPROUT_MIN_CURRENT_VERSION
                                vin(), vout(), nLockTime(0),
                                saplingBundle(),
                                orchardBundle(),
-                               vJoinSplit(), joinSplitPubKey(), joinSplitSig() { }
+                               vJoinSplit(), joinSplitPubKey(), joinSplitSig()
+{
+    *const_cast<size_t*>(&nTotalSize) = ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+}
 
 CTransaction::CTransaction(const CMutableTransaction &tx) : nVersion(tx.nVersion), fOverwintered(tx.fOverwintered), nVersionGroupId(tx.nVersionGroupId), nExpiryHeight(tx.nExpiryHeight),
                                                             nConsensusBranchId(tx.nConsensusBranchId),
@@ -177,6 +192,7 @@ CTransaction::CTransaction(
                               vJoinSplit(tx.vJoinSplit), joinSplitPubKey(tx.joinSplitPubKey), joinSplitSig(tx.joinSplitSig)
 {
     assert(evilDeveloperFlag);
+    *const_cast<size_t*>(&nTotalSize) = ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
 }
 
 CTransaction::CTransaction(CMutableTransaction &&tx) : nVersion(tx.nVersion),
@@ -208,6 +224,7 @@ CTransaction& CTransaction::operator=(const CTransaction &tx) {
     *const_cast<ed25519::Signature*>(&joinSplitSig) = tx.joinSplitSig;
     *const_cast<uint256*>(&wtxid.hash) = tx.wtxid.hash;
     *const_cast<uint256*>(&wtxid.authDigest) = tx.wtxid.authDigest;
+    *const_cast<size_t*>(&nTotalSize) = tx.nTotalSize;
     return *this;
 }
 
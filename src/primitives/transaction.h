@@ -244,7 +244,7 @@ public:
     BaseOutPoint() { SetNull(); }
     BaseOutPoint(uint256 hashIn, uint32_t nIn) { hash = hashIn; n = nIn; }
 
-    ADD_SERIALIZE_METHODS;
+    ADD_FIXED_SIZE_SERIALIZE_METHODS(32 + 4);
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
@@ -462,6 +462,8 @@ private:
 
     /** Memory only. */
     const WTxId wtxid;
+    /** Memory only. The serialized size, measured while computing wtxid. */
+    const size_t nTotalSize{0};
     void UpdateHash() const;
 
 protected:
@@ -667,6 +669,11 @@ public:
         return wtxid;
     }
 
+    /** Returns the serialized size of this transaction, which is cached. */
+    size_t GetTotalSize() const {
+        return nTotalSize;
+    }
+
     uint32_t GetHeader() const {
         // When serializing v1 and v2, the 4 byte header is nVersion
         uint32_t header = this->nVersion;
@@ -6,8 +6,13 @@
 #include "pubkey.h"
 
 #include <secp256k1.h>
+#include <secp256k1_ellswift.h>
 #include <secp256k1_recovery.h>
 
+#include <algorithm>
+#include <mutex>
+#include <random>
+
 namespace {
 
 struct Secp256k1SelfTester
@@ -18,16 +23,74 @@ struct Secp256k1SelfTester
     }
 } SECP256K1_SELFTESTER;
 
-} // namespace
+/**
+ * Parsed forms of recently used public keys. Parsing a compressed key takes
+ * a square root, which is a noticeable share of verifying a signature when
+ * the same keys sign many inputs, as in sweeps and consolidations.
+ *
+ * The cache is direct-mapped on a salted hash of the serialized key, and
+ * split into shards with their own locks for the script check threads. Only
+ * keys that parsed are stored, and a lookup compares the whole serialized
+ * key, so a colliding key can only evict an entry.
+ */
+class ParsedPubKeyCache
+{
+private:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t ENTRIES_PER_SHARD = 128;
 
-bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
-    if (!IsValid())
-        return false;
-    secp256k1_pubkey pubkey;
-    secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_static, &pubkey, &(*this)[0], size())) {
-        return false;
+    struct Entry
+    {
+        unsigned char vch[CPubKey::PUBLIC_KEY_SIZE];
+        unsigned char len = 0;
+        secp256k1_pubkey parsed;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        Entry entries[ENTRIES_PER_SHARD];
+    };
+
+    const uint64_t k0;
+    const uint64_t k1;
+    Shard shards[SHARDS];
+
+public:
+    ParsedPubKeyCache() : k0(std::random_device()()), k1(std::random_device()()) {}
+
+    bool Parse(const CPubKey& key, secp256k1_pubkey& pubkey)
+    {
+        const uint64_t h = CSipHasher(k0, k1).Write(key.begin(), key.size()).Finalize();
+        Shard& shard = shards[h % SHARDS];
+        Entry& entry = shard.entries[(h / SHARDS) % ENTRIES_PER_SHARD];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (entry.len == key.size() && memcmp(entry.vch, key.begin(), key.size()) == 0) {
+                pubkey = entry.parsed;
+                return true;
+            }
+        }
+        if (!secp256k1_ec_pubkey_parse(secp256k1_context_static, &pubkey, key.begin(), key.size())) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        memcpy(entry.vch, key.begin(), key.size());
+        entry.len = key.size();
+        entry.parsed = pubkey;
+        return true;
     }
+};
+
+ParsedPubKeyCache& GetParsedPubKeyCache()
+{
+    static ParsedPubKeyCache cache;
+    return cache;
+}
+
+bool VerifyParsed(const secp256k1_pubkey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    secp256k1_ecdsa_signature sig;
     if (vchSig.size() == 0) {
         return false;
     }
@@ -41,6 +104,47 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
     return secp256k1_ecdsa_verify(secp256k1_context_static, &sig, hash.begin(), &pubkey);
 }
 
+} // namespace
+
+bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
+    if (!IsValid())
+        return false;
+    secp256k1_pubkey pubkey;
+    if (!GetParsedPubKeyCache().Parse(*this, pubkey)) {
+        return false;
+    }
+    return VerifyParsed(pubkey, hash, vchSig);
+}
+
+bool CPubKey::VerifyBatch(const std::vector<CPubKeySigCheck>& checks, std::vector<bool>& vResult)
+{
+    // Visit the checks grouped by key, so that each distinct key is looked
+    // up and parsed once.
+    std::vector<size_t> order(checks.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return *checks[a].pubkey < *checks[b].pubkey;
+    });
+
+    vResult.assign(checks.size(), false);
+    bool fAllValid = true;
+    const CPubKey* pkeyParsed = nullptr;
+    bool fParsed = false;
+    secp256k1_pubkey pubkey;
+    for (size_t i : order) {
+        const CPubKeySigCheck& check = checks[i];
+        if (pkeyParsed == nullptr || *pkeyParsed != *check.pubkey) {
+            pkeyParsed = check.pubkey;
+            fParsed = check.pubkey->IsValid() && GetParsedPubKeyCache().Parse(*check.pubkey, pubkey);
+        }
+        vResult[i] = fParsed && VerifyParsed(pubkey, *check.hash, *check.sig);
+        fAllValid &= vResult[i];
+    }
+    return fAllValid;
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE)
         return false;
@@ -156,3 +260,14 @@ bool CExtPubKey::Derive(CExtPubKey &out, unsigned int _nChild) const {
         return std::nullopt;
     }
 }
+
+CPubKey EllSwiftPubKey::Decode() const {
+    secp256k1_pubkey pubkey;
+    // Every 64 bytes decode to some point.
+    int ret = secp256k1_ellswift_decode(secp256k1_context_static, &pubkey, vch.data());
+    assert(ret);
+    unsigned char pub[CPubKey::COMPRESSED_PUBLIC_KEY_SIZE];
+    size_t publen = sizeof(pub);
+    secp256k1_ec_pubkey_serialize(secp256k1_context_static, pub, &publen, &pubkey, SECP256K1_EC_COMPRESSED);
+    return CPubKey(pub, pub + publen);
+}
@@ -11,7 +11,9 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <array>
 #include <stdexcept>
+#include <string.h>
 #include <vector>
 
 const unsigned int BIP32_EXTKEY_SIZE = 74;
@@ -27,6 +29,8 @@ public:
 
 typedef uint256 ChainCode;
 
+struct CPubKeySigCheck;
+
 /** An encapsulated public key. */
 class CPubKey
 {
@@ -188,6 +192,13 @@ public:
      */
     bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
 
+    /**
+     * Verify a group of DER signatures, setting vResult[i] to whether
+     * checks[i] is valid. Signatures by the same key share one parse of the
+     * key. Returns whether all of them are valid.
+     */
+    static bool VerifyBatch(const std::vector<CPubKeySigCheck>& checks, std::vector<bool>& vResult);
+
     /**
      * Check whether a signature is normalized (lower-S).
      */
@@ -203,6 +214,41 @@ public:
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 };
 
+/** A signature to check with CPubKey::VerifyBatch. The pointed-to objects
+ * must outlive the call. */
+struct CPubKeySigCheck
+{
+    const CPubKey* pubkey;
+    const uint256* hash;
+    const std::vector<unsigned char>* sig;
+};
+
+/**
+ * A public key in the ElligatorSwift encoding of BIP 324, which can't be told
+ * apart from 64 random bytes.
+ */
+class EllSwiftPubKey
+{
+private:
+    std::array<unsigned char, 64> vch;
+
+public:
+    static constexpr unsigned int SIZE = 64;
+
+    EllSwiftPubKey() { vch.fill(0); }
+    explicit EllSwiftPubKey(const unsigned char* pch) { memcpy(vch.data(), pch, SIZE); }
+
+    const unsigned char* begin() const { return vch.data(); }
+    const unsigned char* end() const { return vch.data() + SIZE; }
+    unsigned int size() const { return SIZE; }
+
+    //! Decode to an ordinary (compressed) public key.
+    CPubKey Decode() const;
+
+    friend bool operator==(const EllSwiftPubKey& a, const EllSwiftPubKey& b) { return a.vch == b.vch; }
+    friend bool operator!=(const EllSwiftPubKey& a, const EllSwiftPubKey& b) { return a.vch != b.vch; }
+};
+
 class CChainablePubKey {
 private:
     ChainCode chaincode;
@@ -0,0 +1,278 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "randomx_benchmark.h"
+
+#include "crypto/common.h"
+#include "crypto/rapl.h"
+#include "crypto/randomx_wrapper.h"
+#include "init.h"
+#include "numa_helper.h"
+#include "util/strencodings.h"
+#include "util/system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
+
+// RandomX input hashed by the benchmark: 108-byte header prefix and 32-byte nonce
+static const size_t BENCHMARK_INPUT_SIZE = 140;
+static const size_t BENCHMARK_NONCE_OFFSET = 108;
+
+// Give up on a point if its threads are not all hashing after this long
+static const int BENCHMARK_WARMUP_TIMEOUT_SECONDS = 600;
+
+struct BenchmarkWorker {
+    std::atomic<uint64_t> hashes{0};
+    std::atomic<bool> hashing{false};
+    std::atomic<bool> failed{false};
+    RandomXBenchmarkPlacement placement{-1, -1, -1, 0};
+};
+
+static void ThreadRandomXBenchmark(int thread_id, int total_threads, uint256 seed,
+                                   BenchmarkWorker& worker, const std::atomic<bool>& stop)
+{
+    RenameThread("juno-rx-bench");
+
+    // Same placement as the miner threads
+    NumaHelper& numa = NumaHelper::GetInstance();
+    if (numa.IsPinningEnabled()) {
+        int cpu_id = numa.GetCPUForThread(thread_id, total_threads);
+        if (cpu_id >= 0 && numa.PinCurrentThread(cpu_id)) {
+            worker.placement.cpu = cpu_id;
+            if (numa.IsNUMAAvailable()) {
+                RandomX_SetCurrentNode(numa.GetNodeForThread(thread_id, total_threads));
+            }
+        }
+    }
+
+    randomx_vm* vm = RandomX_GetVM(seed.begin(), 32);
+    RandomXVMPlacement vmPlacement;
+    if (!vm) {
+        worker.failed = true;
+        return;
+    }
+    if (RandomX_GetVMPlacement(vm, vmPlacement)) {
+        worker.placement.requested_node = vmPlacement.requested_node;
+        worker.placement.node = vmPlacement.node;
+        worker.placement.page_size = vmPlacement.page_size;
+    }
+
+    // Each thread hashes its own nonces so no two threads repeat work
+    unsigned char input[BENCHMARK_INPUT_SIZE] = {};
+    unsigned char output[32];
+    WriteLE32(input + BENCHMARK_NONCE_OFFSET + 8, thread_id);
+    uint64_t counter = 0;
+    WriteLE64(input + BENCHMARK_NONCE_OFFSET, counter);
+    RandomX_HashFirst(vm, input, sizeof(input));
+    while (!stop.load(std::memory_order_relaxed)) {
+        WriteLE64(input + BENCHMARK_NONCE_OFFSET, ++counter);
+        RandomX_HashNext(vm, input, sizeof(input), output);
+        worker.hashes.fetch_add(1, std::memory_order_relaxed);
+        if (counter == 1) worker.hashing = true;
+    }
+    RandomX_HashLast(vm, output);
+}
+
+static bool RunBenchmarkPoint(int nThreads, const std::string& mode, int nSeconds, CpuEnergyMeter& energy,
+                              RandomXBenchmarkPoint& point, std::string& error)
+{
+    bool fFast = mode != "Light";
+    bool fHugepages = mode == "Fast+Hugepages";
+    if (RandomX_IsFastMode() != fFast || RandomX_IsUsingHugepages() != fHugepages) {
+        RandomX_ChangeMode(fFast, fHugepages);
+    }
+
+    uint256 seed = RandomX_GetMainSeedHash();
+    if (seed.IsNull()) {
+        error = "RandomX is not initialized";
+        return false;
+    }
+
+    LogPrintf("RandomX benchmark: %d threads, %s mode, %d seconds\n", nThreads, mode, nSeconds);
+
+    std::vector<std::unique_ptr<BenchmarkWorker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop(false);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nThreads; i++) {
+        workers.emplace_back(new BenchmarkWorker());
+        threads.emplace_back(ThreadRandomXBenchmark, i, nThreads, seed, std::ref(*workers.back()), std::cref(stop));
+    }
+
+    // Warmup: building VMs (and in fast mode the dataset) until every thread hashes
+    bool fWarm = false;
+    while (!fWarm && !ShutdownRequested()) {
+        fWarm = true;
+        for (const auto& worker : workers) {
+            if (worker->failed) {
+                error = "Unable to create a RandomX VM";
+                break;
+            }
+            fWarm &= worker->hashing.load();
+        }
+        if (!error.empty() || std::chrono::steady_clock::now() - start > std::chrono::seconds(BENCHMARK_WARMUP_TIMEOUT_SECONDS)) {
+            break;
+        }
+        if (!fWarm) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    point.warmup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // One total hashrate sample per second
+    std::vector<double> samples;
+    double joules = -1, seconds = 0;
+    if (fWarm && error.empty()) {
+        double joulesStart = energy.Read();
+        auto sampleStart = std::chrono::steady_clock::now();
+        uint64_t nLast = 0;
+        for (const auto& worker : workers) nLast += worker->hashes.load(std::memory_order_relaxed);
+        for (int i = 0; i < nSeconds && !ShutdownRequested(); i++) {
+            std::this_thread::sleep_until(sampleStart + std::chrono::seconds(i + 1));
+            auto now = std::chrono::steady_clock::now();
+            uint64_t nTotal = 0;
+            for (const auto& worker : workers) nTotal += worker->hashes.load(std::memory_order_relaxed);
+            double elapsed = std::chrono::duration<double>(now - sampleStart).count() - i;
+            samples.push_back((nTotal - nLast) / std::max(elapsed, 1e-3));
+            nLast = nTotal;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sampleStart).count();
+        if (joulesStart >= 0) joules = energy.Read() - joulesStart;
+    }
+
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (!error.empty()) return false;
+    if (!fWarm && !ShutdownRequested()) {
+        error = strprintf("Threads did not start hashing within %d seconds", BENCHMARK_WARMUP_TIMEOUT_SECONDS);
+        return false;
+    }
+
+    point.threads = nThreads;
+    point.mode = mode;
+    point.samples = samples.size();
+    point.hashrate = 0;
+    point.variance = 0;
+    for (double sample : samples) point.hashrate += sample;
+    if (!samples.empty()) point.hashrate /= samples.size();
+    for (double sample : samples) point.variance += (sample - point.hashrate) * (sample - point.hashrate);
+    if (samples.size() > 1) point.variance /= samples.size() - 1;
+    for (const auto& worker : workers) {
+        point.placement.push_back(worker->placement);
+    }
+    point.watts = joules > 0 && seconds > 0 ? joules / seconds : -1;
+    point.hashes_per_joule = point.watts > 0 ? point.hashrate / point.watts : -1;
+
+    LogPrintf("RandomX benchmark: %d threads, %s mode: %.2f H/s (variance %.2f, warmup %.1fs)\n",
+              nThreads, mode, point.hashrate, point.variance, point.warmup_seconds);
+    if (point.watts > 0) {
+        LogPrintf("RandomX benchmark: %d threads, %s mode: %.1f W, %.2f H/J\n",
+                  nThreads, mode, point.watts, point.hashes_per_joule);
+    }
+    return true;
+}
+
+bool RunRandomXBenchmark(const RandomXBenchmarkOptions& options,
+                         std::vector<RandomXBenchmarkPoint>& results, std::string& error)
+{
+    if (options.seconds <= 0) {
+        error = "Benchmark duration must be positive";
+        return false;
+    }
+
+    std::vector<int> threads = options.threads;
+    if (threads.empty()) {
+        int nCPUs = std::max<int>(1, std::thread::hardware_concurrency());
+        for (int i = 1; i <= nCPUs; i++) threads.push_back(i);
+    }
+    std::vector<std::string> modes = options.modes;
+    if (modes.empty()) {
+        modes.assign(std::begin(RANDOMX_BENCHMARK_MODES), std::end(RANDOMX_BENCHMARK_MODES));
+    }
+
+    bool fOrigFast = RandomX_IsFastMode();
+    bool fOrigHugepages = RandomX_IsUsingHugepages();
+    CpuEnergyMeter energy;
+
+    bool fSuccess = true;
+    for (const std::string& mode : modes) {
+        for (int nThreads : threads) {
+            if (ShutdownRequested()) break;
+            RandomXBenchmarkPoint point;
+            if (!RunBenchmarkPoint(nThreads, mode, options.seconds, energy, point, error)) {
+                fSuccess = false;
+                break;
+            }
+            if (point.samples > 0) results.push_back(point);
+        }
+        if (!fSuccess) break;
+    }
+
+    if (RandomX_IsFastMode() != fOrigFast || RandomX_IsUsingHugepages() != fOrigHugepages) {
+        RandomX_ChangeMode(fOrigFast, fOrigHugepages);
+    }
+    return fSuccess;
+}
+
+bool ParseRandomXBenchmarkThreads(const std::string& str, std::vector<int>& threads)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of(","));
+    for (const std::string& part : parts) {
+        int32_t n;
+        if (!ParseInt32(part, &n) || n <= 0) return false;
+        threads.push_back(n);
+    }
+    return true;
+}
+
+bool ParseRandomXBenchmarkModes(const std::string& str, std::vector<std::string>& modes)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of(","));
+    for (const std::string& part : parts) {
+        auto it = std::find_if(std::begin(RANDOMX_BENCHMARK_MODES), std::end(RANDOMX_BENCHMARK_MODES),
+                               [&part](const char* name) { return boost::iequals(part, name); });
+        if (it == std::end(RANDOMX_BENCHMARK_MODES)) return false;
+        modes.push_back(*it);
+    }
+    return true;
+}
+
+UniValue RandomXBenchmarkToJSON(const std::vector<RandomXBenchmarkPoint>& results)
+{
+    UniValue result(UniValue::VARR);
+    for (const RandomXBenchmarkPoint& point : results) {
+        UniValue placement(UniValue::VARR);
+        for (size_t i = 0; i < point.placement.size(); i++) {
+            UniValue thread(UniValue::VOBJ);
+            thread.pushKV("thread", (int)i);
+            thread.pushKV("cpu", point.placement[i].cpu);
+            thread.pushKV("requestednode", point.placement[i].requested_node);
+            thread.pushKV("node", point.placement[i].node);
+            thread.pushKV("pagesize", (uint64_t)point.placement[i].page_size);
+            placement.push_back(thread);
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("threads", point.threads);
+        obj.pushKV("mode", point.mode);
+        obj.pushKV("hashrate", point.hashrate);
+        obj.pushKV("variance", point.variance);
+        obj.pushKV("samples", point.samples);
+        obj.pushKV("warmupseconds", point.warmup_seconds);
+        if (point.watts > 0) {
+            obj.pushKV("watts", point.watts);
+            obj.pushKV("hashesperjoule", point.hashes_per_joule);
+        }
+        obj.pushKV("placement", placement);
+        result.push_back(obj);
+    }
+    return result;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RANDOMX_BENCHMARK_H
+#define BITCOIN_RANDOMX_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Default for -benchmarkrandomxseconds: how long each point is measured */
+static const int DEFAULT_RANDOMX_BENCHMARK_SECONDS = 20;
+
+/** RandomX modes a benchmark can sweep, named as on the metrics screen */
+static const char* const RANDOMX_BENCHMARK_MODES[] = {"Light", "Fast", "Fast+Hugepages"};
+
+/** What to measure; empty lists mean every thread count up to the CPU count and every mode */
+struct RandomXBenchmarkOptions {
+    std::vector<int> threads;
+    std::vector<std::string> modes;
+    int seconds = DEFAULT_RANDOMX_BENCHMARK_SECONDS;
+};
+
+/** Where one benchmark thread ran */
+struct RandomXBenchmarkPlacement {
+    int cpu;             //!< CPU the thread was pinned to, -1 if not pinned
+    int requested_node;  //!< NUMA node requested for its VM, -1 if none
+    int node;            //!< NUMA node holding its scratchpad, -1 if unknown
+    size_t page_size;    //!< Page size backing its scratchpad in bytes, 0 if unknown
+};
+
+/** One measured thread count and mode */
+struct RandomXBenchmarkPoint {
+    int threads;
+    std::string mode;
+    double hashrate;         //!< Mean hashes per second over the samples
+    double variance;         //!< Sample variance of the per-second hashrate
+    int samples;
+    double warmup_seconds;   //!< Time until every thread had its VM and finished a hash
+    double watts;            //!< Mean CPU package power over the samples, -1 if not measured
+    double hashes_per_joule; //!< hashrate / watts, -1 if not measured
+    std::vector<RandomXBenchmarkPlacement> placement;
+};
+
+/**
+ * Measure RandomX hashrate (and, where the CPU's energy counters can be read,
+ * hashes per joule) for each thread count and mode, hashing a fixed
+ * seed directly through the RandomX wrapper so that no chain, peers or block
+ * template are needed. Threads are placed as by the miner
+ * (-minerthreadplacement). The RandomX mode in use beforehand is restored.
+ *
+ * Must not be run while the miner is hashing.
+ *
+ * @return false with error set if the options are invalid
+ */
+bool RunRandomXBenchmark(const RandomXBenchmarkOptions& options,
+                         std::vector<RandomXBenchmarkPoint>& results, std::string& error);
+
+/** Parse a comma-separated list of thread counts such as "1,2,4,8" */
+bool ParseRandomXBenchmarkThreads(const std::string& str, std::vector<int>& threads);
+
+/** Parse a comma-separated list of RANDOMX_BENCHMARK_MODES names */
+bool ParseRandomXBenchmarkModes(const std::string& str, std::vector<std::string>& modes);
+
+/** Benchmark results as a JSON array, one object per point */
+UniValue RandomXBenchmarkToJSON(const std::vector<RandomXBenchmarkPoint>& results);
+
+#endif // BITCOIN_RANDOMX_BENCHMARK_H
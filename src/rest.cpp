@@ -24,6 +24,8 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int32_t MAX_REST_BLOCKRANGE_COUNT = 1000; //most blocks returned by one /rest/blockrange request
+static const size_t MAX_REST_BLOCKRANGE_BYTES = 64 * 1024 * 1024; //a /rest/blockrange reply ends after the block that reaches this size
 
 enum RetFormat {
     RF_UNDEF,
@@ -128,21 +130,16 @@ static bool rest_headers(HTTPRequest* req,
     boost::split(path, params[0], boost::is_any_of("/"));
 
     if (path.size() != 2)
-        return RESTERR(req, HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
+        return RESTERR(req, HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext> or /rest/headers/<start>/<count>.<ext>.");
 
-    long count = strtol(path[0].c_str(), NULL, 10);
-    if (count < 1 || count > 2000)
-        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[0]);
-
-    string hashStr = path[1];
+    std::vector<const CBlockIndex *> headers;
     uint256 hash;
-    if (!ParseHashStr(hashStr, hash))
-        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+    if (ParseHashStr(path[1], hash)) {
+        long count = strtol(path[0].c_str(), NULL, 10);
+        if (count < 1 || count > 2000)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[0]);
 
-    std::vector<const CBlockIndex *> headers;
-    headers.reserve(count);
-    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-    {
+        headers.reserve(count);
         LOCK(cs_main);
         BlockMap::const_iterator it = mapBlockIndex.find(hash);
         const CBlockIndex *pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
@@ -152,15 +149,31 @@ static bool rest_headers(HTTPRequest* req,
                 break;
             pindex = chainActive.Next(pindex);
         }
+    } else {
+        // A range of heights on the active chain, looked up without cs_main.
+        int32_t start, count;
+        if (!ParseInt32(path[0], &start) || !ParseInt32(path[1], &count))
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash or height range: " + params[0]);
+        if (start < 0 || count < 1 || count > 2000)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Header range out of range: " + params[0]);
+
+        std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
+        int64_t end = std::min<int64_t>((int64_t)start + count, (int64_t)chain->Height() + 1);
+        for (int64_t nHeight = start; nHeight < end; nHeight++) {
+            headers.push_back((*chain)[nHeight]);
+        }
+    }
 
-        if (rf == RF_BINARY || rf == RF_HEX) {
-            try {
-                for (const CBlockIndex *pindex : headers) {
-                    ssHeader << pindex->GetBlockHeader();
-                }
-            } catch (const std::runtime_error&) {
-                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to read index entry");
+    // Headers are immutable once in the index, so they can be serialized
+    // without cs_main.
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    if (rf == RF_BINARY || rf == RF_HEX) {
+        try {
+            for (const CBlockIndex *pindex : headers) {
+                headerCache.Write(ssHeader, pindex);
             }
+        } catch (const std::runtime_error&) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to read index entry");
         }
     }
 
@@ -278,6 +291,76 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+/**
+ * Blocks [start, start + count) of the active chain, as they are stored in
+ * the block files: each one preceded by the network magic and its size. The
+ * bytes are sent straight from the mapped block files where possible, and the
+ * reply ends early once it is MAX_REST_BLOCKRANGE_BYTES long, so clients
+ * carry on from the height after the last block they got.
+ */
+static bool rest_blockrange(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    if (rf != RF_BINARY)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin)");
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    int32_t start, count;
+    if (path.size() != 2 || !ParseInt32(path[0], &start) || !ParseInt32(path[1], &count))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid block range. Use /rest/blockrange/<start>/<count>.bin.");
+    if (start < 0 || count < 1 || count > MAX_REST_BLOCKRANGE_COUNT)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block range out of range: " + params[0]);
+
+    // Block positions change when files are pruned, so they are looked up
+    // under cs_main; the blocks are read without it and checked afterwards.
+    std::vector<std::pair<CDiskBlockPos, uint256>> blocks;
+    {
+        LOCK(cs_main);
+        int64_t end = std::min<int64_t>((int64_t)start + count, (int64_t)chainActive.Height() + 1);
+        for (int64_t nHeight = start; nHeight < end; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                break;
+            blocks.emplace_back(pindex->GetBlockPos(), pindex->GetBlockHash());
+        }
+    }
+    if (blocks.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block %d not found or not available (pruned data)", start));
+
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    bool fStarted = false;
+    size_t nBytes = 0;
+    for (const auto& block : blocks) {
+        const char* pbegin;
+        const char* pend;
+        std::shared_ptr<const void> raw = ReadRawBlockFromDisk(block.first, pbegin, pend);
+        if (!raw || GetRawBlockHash(pbegin, pend) != block.second) {
+            // The block may have been pruned since cs_main was released.
+            if (!fStarted)
+                return RESTERR(req, HTTP_NOT_FOUND, block.second.GetHex() + " not available (pruned data)");
+            break;
+        }
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->StartReply(HTTP_OK);
+            fStarted = true;
+        }
+        CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+        ssPrefix << FLATDATA(messageStart) << (uint32_t)(pend - pbegin);
+        req->WriteReplyChunk(ssPrefix.str());
+        req->WriteReplyChunk(raw, pbegin, pend);
+        nBytes += pend - pbegin;
+        if (nBytes >= MAX_REST_BLOCKRANGE_BYTES)
+            break;
+    }
+    req->EndReply();
+    return true;
+}
+
 // A bit of a hack - dependency on a function defined in rpc/blockchain.cpp
 UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 
@@ -617,6 +700,7 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockrange/", rest_blockrange},
       {"/rest/getutxos", rest_getutxos},
 };
 
@@ -10,15 +10,20 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "consensus/validation.h"
+#include "dbwrapper.h"
 #include "experimental_features.h"
 #include "key_io.h"
 #include "main.h"
 #include "metrics.h"
+#include "perfhistory.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "streams.h"
 #include "sync.h"
 #include "util/system.h"
+#include "validation_stats.h"
+#include "zcash/cache.h"
 
 #include <stdint.h>
 
@@ -107,13 +112,13 @@ static UniValue ValuePoolDesc(
 
 UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 {
-    AssertLockHeld(cs_main);
+    std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
     UniValue result(UniValue::VOBJ);
     result.pushKV("hash", blockindex->GetBlockHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (chain->Contains(blockindex))
+        confirmations = chain->Height() - blockindex->nHeight + 1;
     result.pushKV("confirmations", confirmations);
     result.pushKV("height", blockindex->nHeight);
     result.pushKV("version", blockindex->nVersion);
@@ -121,14 +126,14 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     result.pushKV("finalsaplingroot", blockindex->hashFinalSaplingRoot.GetHex());
     result.pushKV("time", (int64_t)blockindex->nTime);
     result.pushKV("nonce", blockindex->nNonce.GetHex());
-    result.pushKV("solution", HexStr(blockindex->GetBlockHeader().nSolution));
+    result.pushKV("solution", HexStr(blockindex->nSolution.begin(), blockindex->nSolution.end()));
     result.pushKV("bits", strprintf("%08x", blockindex->nBits));
     result.pushKV("difficulty", GetDifficulty(blockindex));
     result.pushKV("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
         result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    CBlockIndex *pnext = chain->Next(blockindex);
     if (pnext)
         result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
     return result;
@@ -225,7 +230,7 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
 
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
-    AssertLockHeld(cs_main);
+    std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
     bool nu5Active = Params().GetConsensus().NetworkUpgradeActive(
         blockindex->nHeight, Consensus::UPGRADE_NU5);
 
@@ -233,8 +238,8 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.pushKV("hash", block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (chain->Contains(blockindex))
+        confirmations = chain->Height() - blockindex->nHeight + 1;
     result.pushKV("confirmations", confirmations);
     result.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
     result.pushKV("height", blockindex->nHeight);
@@ -278,6 +283,8 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.pushKV("valuePools", valuePools);
 
     {
+        // The coins view is the one part of this that needs cs_main.
+        LOCK(cs_main);
         UniValue trees(UniValue::VOBJ);
 
         SaplingMerkleTree saplingTree;
@@ -299,12 +306,39 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     if (blockindex->pprev)
         result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    CBlockIndex *pnext = chain->Next(blockindex);
     if (pnext)
         result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
     return result;
 }
 
+/**
+ * Write the verbosity 2 form of a block, one transaction at a time, so that
+ * the transactions of a large block are never all held as UniValues at once.
+ */
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, JSONStreamWriter& out)
+{
+    UniValue result = blockToJSON(block, blockindex);
+
+    out.BeginObject();
+    for (size_t i = 0; i < result.size(); i++) {
+        const std::string& key = result.getKeys()[i];
+        out.Key(key);
+        if (key != "tx") {
+            out.Value(result.getValues()[i]);
+            continue;
+        }
+        out.BeginArray();
+        for (const CTransaction& tx : block.vtx) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(tx, uint256(), objTx);
+            out.Value(objTx);
+        }
+        out.EndArray();
+    }
+    out.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -357,47 +391,54 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
     return GetNetworkDifficulty();
 }
 
+/** The verbose description of the i'th entry of a mempool snapshot. */
+static UniValue mempoolEntryToJSON(const CTxMemPoolSnapshot& snapshot, size_t i)
+{
+    const CTxMemPoolEntry& e = snapshot.entries[i];
+    UniValue info(UniValue::VOBJ);
+    info.pushKV("size", (int)e.GetTxSize());
+    info.pushKV("fee", ValueFromAmount(e.GetFee()));
+    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
+    info.pushKV("time", e.GetTime());
+    info.pushKV("height", (int)e.GetHeight());
+    info.pushKV("descendantcount", e.GetCountWithDescendants());
+    info.pushKV("descendantsize", e.GetSizeWithDescendants());
+    info.pushKV("descendantfees", e.GetModFeesWithDescendants());
+    set<string> setDepends;
+    for (const uint256& parent : snapshot.parents[i])
+    {
+        setDepends.insert(parent.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    for (const string& dep : setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.pushKV("depends", depends);
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
+    // Read from a snapshot so that transactions can still be accepted to the
+    // mempool while the result is built.
+    std::shared_ptr<const CTxMemPoolSnapshot> snapshot = mempool.GetSnapshot();
     if (fVerbose)
     {
-        LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
+        for (size_t i = 0; i < snapshot->entries.size(); i++)
         {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.pushKV("size", (int)e.GetTxSize());
-            info.pushKV("fee", ValueFromAmount(e.GetFee()));
-            info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-            info.pushKV("time", e.GetTime());
-            info.pushKV("height", (int)e.GetHeight());
-            info.pushKV("descendantcount", e.GetCountWithDescendants());
-            info.pushKV("descendantsize", e.GetSizeWithDescendants());
-            info.pushKV("descendantfees", e.GetModFeesWithDescendants());
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            for (const CTxIn& txin : tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            for (const string& dep : setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.pushKV("depends", depends);
-            o.pushKV(hash.ToString(), info);
+            const uint256& hash = snapshot->entries[i].GetTx().GetHash();
+            o.pushKV(hash.ToString(), mempoolEntryToJSON(*snapshot, i));
         }
         return o;
     }
     else
     {
         vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
+        snapshot->queryHashes(vtxid);
 
         UniValue a(UniValue::VARR);
         for (const uint256& hash : vtxid)
@@ -450,6 +491,32 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+void getrawmempool_stream(const UniValue& params, JSONStreamWriter& out)
+{
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    // The snapshot needs no locks while it is written out.
+    std::shared_ptr<const CTxMemPoolSnapshot> snapshot = mempool.GetSnapshot();
+    if (fVerbose) {
+        out.BeginObject();
+        for (size_t i = 0; i < snapshot->entries.size(); i++) {
+            out.Key(snapshot->entries[i].GetTx().GetHash().ToString());
+            out.Value(mempoolEntryToJSON(*snapshot, i));
+        }
+        out.EndObject();
+    } else {
+        vector<uint256> vtxid;
+        snapshot->queryHashes(vtxid);
+
+        out.BeginArray();
+        for (const uint256& hash : vtxid)
+            out.Value(hash.ToString());
+        out.EndArray();
+    }
+}
+
 // insightexplorer
 UniValue getblockdeltas(const UniValue& params, bool fHelp)
 {
@@ -516,6 +583,7 @@ UniValue getblockdeltas(const UniValue& params, bool fHelp)
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
+    SyncInsightIndex();
     LOCK(cs_main);
 
     if (mapBlockIndex.count(hash) == 0)
@@ -592,6 +660,7 @@ UniValue getblockhashes(const UniValue& params, bool fHelp)
     }
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
+    SyncInsightIndex();
     {
         LOCK(cs_main);
         if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
@@ -660,9 +729,8 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
-
-    const CBlockIndex* pblockindex = chainActive[interpretHeightArg(params[0].get_int(), chainActive.Height())];
+    std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
+    const CBlockIndex* pblockindex = (*chain)[interpretHeightArg(params[0].get_int(), chain->Height())];
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -698,8 +766,6 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -707,15 +773,20 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    // Blocks on the active chain are found without cs_main.
+    CBlockIndex* pblockindex = GetChainStateSnapshot()->Find(hash);
+    if (!pblockindex) {
+        LOCK(cs_main);
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = it->second;
+    }
 
     try {
         if (!fVerbose) {
             CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-            ssBlock << pblockindex->GetBlockHeader();
+            headerCache.Write(ssBlock, pblockindex, GetChainStateSnapshot()->Contains(pblockindex));
             std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
             return strHex;
         } else {
@@ -726,6 +797,66 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     }
 }
 
+/**
+ * Parse the arguments of getblock and read the block they name. cs_main is
+ * only taken for a block off the active chain, or when pruning can move
+ * blocks while they are read.
+ */
+static CBlockIndex* ReadBlockForRPC(const UniValue& params, int& verbosity, CBlock& block)
+{
+    std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
+
+    std::string strHash = params[0].get_str();
+
+    // If height is supplied, find the block at that height
+    CBlockIndex* pblockindex;
+    if (strHash.size() < (2 * sizeof(uint256))) {
+        pblockindex = (*chain)[parseHeightArg(strHash, chain->Height())];
+    } else {
+        pblockindex = chain->Find(uint256S(strHash));
+    }
+
+    verbosity = 1;
+    if (params.size() > 1) {
+        if(params[1].isNum()) {
+            verbosity = params[1].get_int();
+        } else {
+            verbosity = params[1].get_bool() ? 1 : 0;
+        }
+    }
+
+    if (verbosity < 0 || verbosity > 2) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
+    }
+
+    CDiskBlockPos pos;
+    if (!pblockindex || fPruneMode || fHavePruned) {
+        LOCK(cs_main);
+        if (!pblockindex) {
+            BlockMap::iterator it = mapBlockIndex.find(uint256S(strHash));
+            if (it == mapBlockIndex.end())
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+            pblockindex = it->second;
+        }
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+        pos = pblockindex->GetBlockPos();
+    } else {
+        // Where a block on the active chain is stored only changes when it
+        // is pruned.
+        pos = pblockindex->GetBlockPos();
+    }
+
+    if (pos.IsNull() ||
+        !ReadBlockFromDisk(block, pos, Params().GetConsensus()) ||
+        block.GetHash() != pblockindex->GetBlockHash())
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    return pblockindex;
+}
+
 UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -807,41 +938,9 @@ UniValue getblock(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblock", "12800")
         );
 
-    LOCK(cs_main);
-
-    std::string strHash = params[0].get_str();
-
-    // If height is supplied, find the hash
-    if (strHash.size() < (2 * sizeof(uint256))) {
-        strHash = chainActive[parseHeightArg(strHash, chainActive.Height())]->GetBlockHash().GetHex();
-    }
-
-    uint256 hash(uint256S(strHash));
-
-    int verbosity = 1;
-    if (params.size() > 1) {
-        if(params[1].isNum()) {
-            verbosity = params[1].get_int();
-        } else {
-            verbosity = params[1].get_bool() ? 1 : 0;
-        }
-    }
-
-    if (verbosity < 0 || verbosity > 2) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
-    }
-
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
+    int verbosity;
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
-
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    CBlockIndex* pblockindex = ReadBlockForRPC(params, verbosity, block);
 
     if (verbosity == 0)
     {
@@ -854,6 +953,47 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
+static void WriteBlockForRPC(const CBlock& block, const CBlockIndex* pblockindex, int verbosity, JSONStreamWriter& out)
+{
+    if (verbosity == 0)
+    {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+        out.Value(HexStr(ssBlock.begin(), ssBlock.end()));
+    } else if (verbosity == 1) {
+        out.Value(blockToJSON(block, pblockindex));
+    } else {
+        blockToJSON(block, pblockindex, out);
+    }
+}
+
+void getblock_stream(const UniValue& params, JSONStreamWriter& out)
+{
+    int verbosity;
+    CBlock block;
+    CBlockIndex* pblockindex = ReadBlockForRPC(params, verbosity, block);
+    WriteBlockForRPC(block, pblockindex, verbosity, out);
+}
+
+void getblock_async(const UniValue& params, std::shared_ptr<RPCAsyncCall> call)
+{
+    // A block that is not in the OS cache is waited for on a blocking
+    // thread, and written back on an RPC thread.
+    struct ReadBlock {
+        int verbosity;
+        CBlock block;
+        CBlockIndex* pblockindex;
+    };
+    auto read = std::make_shared<ReadBlock>();
+    call->Await([params, read] {
+        read->pblockindex = ReadBlockForRPC(params, read->verbosity, read->block);
+    }, [call, read] {
+        call->Finish([read](JSONStreamWriter& out) {
+            WriteBlockForRPC(read->block, read->pblockindex, read->verbosity, out);
+        });
+    });
+}
+
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -892,6 +1032,80 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the chain state at the current tip to a snapshot file: the unspent\n"
+            "transaction outputs, the nullifier sets, the note commitment tree anchors,\n"
+            "the history trees and the subtree roots.\n"
+            "Note this call may take some time, during which blocks are not connected.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, absolute or relative to the data directory.\n"
+            "              It must not exist already.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hash\",       (string) the hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,          (numeric) the height of that block\n"
+            "  \"records\": n,              (numeric) the number of database records written\n"
+            "  \"coins_written\": n,        (numeric) the number of transactions with unspent outputs written\n"
+            "  \"snapshot_hash\": \"hash\",   (string) the hash of the snapshot contents\n"
+            "  \"assumeutxo\": true|false,  (boolean) whether the snapshot matches one committed to in the chain parameters\n"
+            "  \"path\": \"path\"             (string) the absolute path of the file written\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    fs::path path = fs::absolute(params[0].get_str(), GetDataDir());
+    fs::path pathTmp = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    FILE* filestr = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open " + pathTmp.string() + " for writing");
+    }
+
+    // The tip must not move while the database is read.
+    LOCK(cs_main);
+    FlushStateToDisk();
+    CCoinsSnapshotMetadata metadata;
+    bool fDumped;
+    try {
+        fDumped = pcoinsTip->DumpSnapshot(file, metadata);
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        file.fclose();
+        fs::remove(pathTmp);
+        throw JSONRPCError(RPC_MISC_ERROR, std::string("Unable to write the snapshot: ") + e.what());
+    }
+    if (!fDumped) {
+        fs::remove(pathTmp);
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to read the chain state");
+    }
+    RenameOver(pathTmp, path);
+
+    const CBlockIndex* pindex = mapBlockIndex.at(metadata.hashBlock);
+    const MapAssumeutxo& mapAssumeutxo = Params().Assumeutxo();
+    auto it = mapAssumeutxo.find(pindex->nHeight);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("base_hash", metadata.hashBlock.GetHex());
+    ret.pushKV("base_height", pindex->nHeight);
+    ret.pushKV("records", (uint64_t)metadata.nRecords);
+    ret.pushKV("coins_written", (uint64_t)metadata.nCoins);
+    ret.pushKV("snapshot_hash", metadata.hashSnapshot.GetHex());
+    ret.pushKV("assumeutxo", it != mapAssumeutxo.end() && it->second.hashSnapshot == metadata.hashSnapshot);
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -1076,6 +1290,7 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"blocks\": xxxxxx,         (numeric) the current number of blocks processed in the server\n"
             "  \"initial_block_download_complete\": xx, (boolean) true if the initial download of the blockchain is complete\n"
             "  \"headers\": xxxxxx,        (numeric) the current number of headers we have validated\n"
+            "  \"headers_pow_skipped\": xxxxxx, (numeric) how many headers below a checkpoint were accepted without recomputing their RandomX hash\n"
             "  \"bestblockhash\": \"...\", (string) the hash of the currently best block\n"
             "  \"difficulty\": xxxxxx,     (numeric) the current difficulty\n"
             "  \"verificationprogress\": xxxx, (numeric) estimate of verification progress [0..1]\n"
@@ -1127,30 +1342,31 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockchaininfo", "")
         );
 
-    LOCK(cs_main);
+    // Everything here comes from the chain state snapshot, so this does not
+    // take cs_main.
+    std::shared_ptr<const CChainStateSnapshot> chain = GetChainStateSnapshot();
+    CBlockIndex* tip = chain->Tip();
 
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("chain",                 Params().NetworkIDString());
-    obj.pushKV("blocks",                (int)chainActive.Height());
-    obj.pushKV("initial_block_download_complete", !IsInitialBlockDownload(Params().GetConsensus()));
-    obj.pushKV("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1);
-    obj.pushKV("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex());
-    obj.pushKV("difficulty",            (double)GetNetworkDifficulty());
-    obj.pushKV("verificationprogress",  Checkpoints::GuessVerificationProgress(Params().Checkpoints(), chainActive.Tip()));
-    obj.pushKV("chainwork",             chainActive.Tip()->nChainWork.GetHex());
+    obj.pushKV("blocks",                (int)chain->Height());
+    obj.pushKV("initial_block_download_complete", !chain->fInitialDownload);
+    obj.pushKV("headers",               GetBestHeaderHeight());
+    obj.pushKV("headers_pow_skipped",   GetSkippedHeaderPoWCount());
+    obj.pushKV("bestblockhash",         tip->GetBlockHash().GetHex());
+    obj.pushKV("difficulty",            (double)GetNetworkDifficulty(tip));
+    obj.pushKV("verificationprogress",  Checkpoints::GuessVerificationProgress(Params().Checkpoints(), tip));
+    obj.pushKV("chainwork",             tip->nChainWork.GetHex());
     obj.pushKV("pruned",                fPruneMode);
-    obj.pushKV("size_on_disk",          CalculateCurrentUsage());
+    obj.pushKV("size_on_disk",          chain->nSizeOnDisk);
 
-    if (IsInitialBlockDownload(Params().GetConsensus()))
-        obj.pushKV("estimatedheight",       EstimateNetHeight(Params().GetConsensus(), (int)chainActive.Height(), chainActive.Tip()->GetMedianTimePast()));
+    if (chain->fInitialDownload)
+        obj.pushKV("estimatedheight",       EstimateNetHeight(Params().GetConsensus(), (int)chain->Height(), tip->GetMedianTimePast()));
     else
-        obj.pushKV("estimatedheight",       (int)chainActive.Height());
+        obj.pushKV("estimatedheight",       (int)chain->Height());
 
-    SproutMerkleTree tree;
-    pcoinsTip->GetSproutAnchorAt(pcoinsTip->GetBestAnchor(SPROUT), tree);
-    obj.pushKV("commitments",           static_cast<uint64_t>(tree.size()));
+    obj.pushKV("commitments",           chain->nSproutCommitments);
 
-    CBlockIndex* tip = chainActive.Tip();
     obj.pushKV("chainSupply", ValuePoolDesc(std::nullopt, tip->nChainTotalSupply, std::nullopt));
     UniValue valuePools(UniValue::VARR);
     valuePools.push_back(ValuePoolDesc("transparent", tip->nChainTransparentValue, std::nullopt));
@@ -1181,13 +1397,7 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     obj.pushKV("consensus", consensus);
 
     if (fPruneMode)
-    {
-        CBlockIndex *block = chainActive.Tip();
-        while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
-            block = block->pprev;
-
-        obj.pushKV("pruneheight",        block->nHeight);
-    }
+        obj.pushKV("pruneheight",        chain->nPruneHeight);
 
     if (Params().NetworkIDString() == "regtest") {
         obj.pushKV("fullyNotified", ChainIsFullyNotified(chainparams));
@@ -1578,6 +1788,253 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
     return mempoolInfoToJSON();
 }
 
+UniValue getmempoolstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmempoolstats\n"
+            "\nReturns fee and size totals over the TX memory pool. These are kept up to date as\n"
+            "transactions enter and leave the mempool, so this is cheap even when it is full.\n"
+            "Fees are modified fees, including any prioritisetransaction deltas.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"size\": xxxxx               (numeric) Current tx count\n"
+            "  \"bytes\": xxxxx              (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx              (numeric) Total memory usage for the mempool\n"
+            "  \"fees\": x.xxx               (numeric) Sum of all tx fees in " + CURRENCY_UNIT + "\n"
+            "  \"paidactions\": xxxxx        (numeric) ZIP 317 logical actions paid for\n"
+            "  \"unpaidactions\": {          (json object) ZIP 317 unpaid actions, by weight ratio\n"
+            "    \"< 0.2\": xxxxx, \"< 0.4\": xxxxx, \"< 0.6\": xxxxx, \"< 0.8\": xxxxx, \"< 1\": xxxxx\n"
+            "  },\n"
+            "  \"weightedbytes\": {          (json object) Sum of tx sizes, by ZIP 317 weight ratio\n"
+            "    \"< 1\": xxxxx, \"1\": xxxxx, \"> 1\": xxxxx, \"> 2\": xxxxx, \"> 3\": xxxxx\n"
+            "  },\n"
+            "  \"feerates\": [               (json array) Transactions by fee rate\n"
+            "    {\n"
+            "      \"minfeerate\": n,        (numeric) Lowest fee rate in the bucket, in zatoshis per 1000 bytes\n"
+            "      \"count\": n,             (numeric) Number of transactions in the bucket\n"
+            "      \"bytes\": n,             (numeric) Sum of their sizes\n"
+            "      \"fees\": x.xxx           (numeric) Sum of their fees in " + CURRENCY_UNIT + "\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmempoolstats", "")
+            + HelpExampleRpc("getmempoolstats", "")
+        );
+
+    CTxMemPoolStats stats = mempool.GetStats();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("size", (int64_t) stats.nTx);
+    ret.pushKV("bytes", (int64_t) stats.nBytes);
+    ret.pushKV("usage", (int64_t) mempool.DynamicMemoryUsage());
+    ret.pushKV("fees", ValueFromAmount(stats.nFees));
+    ret.pushKV("paidactions", (int64_t) stats.nPaidActions);
+
+    UniValue unpaid(UniValue::VOBJ);
+    const char* unpaidLabels[] = {"< 0.2", "< 0.4", "< 0.6", "< 0.8", "< 1"};
+    for (size_t i = 0; i < stats.unpaidActions.size(); i++) {
+        unpaid.pushKV(unpaidLabels[i], (int64_t) stats.unpaidActions[i]);
+    }
+    ret.pushKV("unpaidactions", unpaid);
+
+    UniValue weighted(UniValue::VOBJ);
+    const char* weightedLabels[] = {"< 1", "1", "> 1", "> 2", "> 3"};
+    for (size_t i = 0; i < stats.weightedBytes.size(); i++) {
+        weighted.pushKV(weightedLabels[i], (int64_t) stats.weightedBytes[i]);
+    }
+    ret.pushKV("weightedbytes", weighted);
+
+    UniValue feeRates(UniValue::VARR);
+    for (size_t i = 0; i < CTxMemPoolStats::FEE_RATE_BUCKET_COUNT; i++) {
+        UniValue bucket(UniValue::VOBJ);
+        bucket.pushKV("minfeerate", CTxMemPoolStats::FEE_RATE_BUCKETS[i]);
+        bucket.pushKV("count", (int64_t) stats.feeRates[i].nTx);
+        bucket.pushKV("bytes", (int64_t) stats.feeRates[i].nBytes);
+        bucket.pushKV("fees", ValueFromAmount(stats.feeRates[i].nFees));
+        feeRates.push_back(bucket);
+    }
+    ret.pushKV("feerates", feeRates);
+
+    return ret;
+}
+
+UniValue getvalidationstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getvalidationstats\n"
+            "\nReturns how long each phase of connecting blocks to the tip has taken since startup.\n"
+            "Latencies are in milliseconds. Percentiles are the upper bound of the histogram bucket\n"
+            "they fall in, so they are estimates.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"phase\": {              (json object) One entry per phase: read, prefetch, inputs,\n"
+            "                            scriptwait, sapling, orchard, undo, flush, chainstate,\n"
+            "                            callbacks, total\n"
+            "    \"count\": n,           (numeric) Number of blocks timed\n"
+            "    \"mean\": x.xxx,        (numeric) Mean latency\n"
+            "    \"p50\": x.xxx,         (numeric) Median latency\n"
+            "    \"p90\": x.xxx,         (numeric) 90th percentile latency\n"
+            "    \"p99\": x.xxx,         (numeric) 99th percentile latency\n"
+            "    \"max\": x.xxx,         (numeric) Highest latency\n"
+            "    \"buckets\": [          (array) Blocks per bucket\n"
+            "      {\n"
+            "        \"le\": x.xxx,      (numeric) Upper bound of the bucket, omitted for the last one\n"
+            "        \"count\": n        (numeric) Blocks in the bucket\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "  \"assumevalid\": {        (json object) Verification skipped under -assumevalid\n"
+            "    \"kind\": {             (json object) One entry per kind: scripts, sapling, orchard\n"
+            "      \"skipped\": n,       (numeric) Transparent inputs or shielded bundles not verified\n"
+            "      \"saved\": x.xxx      (numeric) Estimated time saved, from the cost of checked blocks\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"databases\": {          (json object) Lookups in each open database, for tuning -dbbloombits\n"
+            "    \"name\": {             (json object) Keyed by directory name, e.g. chainstate or index\n"
+            "      \"lookups\": n,       (numeric) Reads and existence checks\n"
+            "      \"misses\": n,        (numeric) Lookups of keys not in the database\n"
+            "      \"missestableread\": n, (numeric) Misses that still read a table block (bloom filter false\n"
+            "                                positives, or filter blocks not in the cache)\n"
+            "      \"tablereads\": n     (numeric) Table blocks read by lookups, iterators and compactions\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"caches\": {             (json object) Validity cache lookups since startup, for tuning -maxsigcachesize\n"
+            "    \"name\": {             (json object) One entry per cache: Transparent, Sapling, Orchard\n"
+            "      \"hits\": n,          (numeric) Signatures or bundles found already verified\n"
+            "      \"misses\": n,        (numeric) Signatures or bundles that had to be verified\n"
+            "      \"hitrate\": x.xxx    (numeric) Fraction of lookups that hit, 0 if there were none\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationstats", "")
+            + HelpExampleRpc("getvalidationstats", "")
+        );
+
+    UniValue result(UniValue::VOBJ);
+    for (int phase = 0; phase < VALIDATION_PHASE_COUNT; phase++) {
+        LatencyHistogram::Snapshot stats = GetValidationPhaseStats((ValidationPhase)phase);
+        UniValue buckets(UniValue::VARR);
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+            UniValue bucket(UniValue::VOBJ);
+            if (i < LatencyHistogram::BUCKETS - 1) {
+                bucket.pushKV("le", LatencyHistogram::BUCKET_BOUNDS[i] * 0.001);
+            }
+            bucket.pushKV("count", stats.buckets[i]);
+            buckets.push_back(bucket);
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", stats.nCount);
+        obj.pushKV("mean", stats.nCount ? stats.nSumMicros * 0.001 / stats.nCount : 0);
+        obj.pushKV("p50", stats.Percentile(0.5) * 0.001);
+        obj.pushKV("p90", stats.Percentile(0.9) * 0.001);
+        obj.pushKV("p99", stats.Percentile(0.99) * 0.001);
+        obj.pushKV("max", stats.nMaxMicros * 0.001);
+        obj.pushKV("buckets", buckets);
+        result.pushKV(ValidationPhaseName((ValidationPhase)phase), obj);
+    }
+    UniValue assumevalid(UniValue::VOBJ);
+    for (int kind = 0; kind < VERIFICATION_WORK_COUNT; kind++) {
+        SkippedWorkStats stats = GetSkippedWorkStats((VerificationWork)kind);
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("skipped", stats.nItems);
+        obj.pushKV("saved", stats.nEstimatedMicros * 0.001);
+        assumevalid.pushKV(VerificationWorkName((VerificationWork)kind), obj);
+    }
+    result.pushKV("assumevalid", assumevalid);
+    UniValue databases(UniValue::VOBJ);
+    for (const auto& entry : CDBWrapper::GetAllStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("lookups", entry.second.nLookups);
+        obj.pushKV("misses", entry.second.nMisses);
+        obj.pushKV("missestableread", entry.second.nMissesReadingTables);
+        obj.pushKV("tablereads", entry.second.nTableReads);
+        databases.pushKV(entry.first, obj);
+    }
+    result.pushKV("databases", databases);
+    UniValue caches(UniValue::VOBJ);
+    auto pushCacheStats = [&](const std::string& name, uint64_t nHits, uint64_t nMisses) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("hits", nHits);
+        obj.pushKV("misses", nMisses);
+        obj.pushKV("hitrate", nHits + nMisses ? (double)nHits / (nHits + nMisses) : 0);
+        caches.pushKV(name, obj);
+    };
+    uint64_t nHits, nMisses;
+    GetSignatureCacheStats(nHits, nMisses);
+    pushCacheStats(SIGNATURE_CACHE_KIND, nHits, nMisses);
+    for (const auto& entry : libzcash::GetBundleValidityCaches()) {
+        entry.second->GetStats(nHits, nMisses);
+        pushCacheStats(entry.first, nHits, nMisses);
+    }
+    result.pushKV("caches", caches);
+    return result;
+}
+
+UniValue getperformancehistory(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getperformancehistory ( seconds )\n"
+            "\nReturns what the node did in each of the last seconds, oldest first, from samples\n"
+            "taken once a second and kept for the last " + std::to_string(PERF_HISTORY_SAMPLES) + " seconds.\n"
+            "\nArguments:\n"
+            "1. seconds    (numeric, optional, default=" + std::to_string(PERF_HISTORY_SAMPLES) + ") How many of the latest samples to return\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"time\": x.xxx,            (numeric) When the sample was taken, in seconds since epoch\n"
+            "    \"interval\": x.xxx,        (numeric) Seconds since the previous sample\n"
+            "    \"hashrate\": x.xxx,        (numeric) Hashes per second over all miner threads\n"
+            "    \"threadhashrate\": [       (array) Hashes per second by miner thread id\n"
+            "      x.xxx, ...\n"
+            "    ],\n"
+            "    \"templateage\": x.xxx,     (numeric, optional) Seconds since the block template was published\n"
+            "    \"blocks\": n,              (numeric) Blocks connected to the tip during the interval\n"
+            "    \"connecttime\": x.xxx,     (numeric) Milliseconds spent connecting them\n"
+            "    \"mempooltx\": n,           (numeric) Transactions in the mempool\n"
+            "    \"mempoolbytes\": n         (numeric) Serialized size of the mempool's transactions\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getperformancehistory", "60")
+            + HelpExampleRpc("getperformancehistory", "60")
+        );
+
+    size_t nMax = PERF_HISTORY_SAMPLES;
+    if (params.size() > 0) {
+        int64_t nSeconds = params[0].get_int64();
+        if (nSeconds < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "seconds must not be negative");
+        nMax = nSeconds;
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const PerformanceSample& sample : GetPerformanceHistory().GetSamples(nMax)) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("time", sample.nTime * 0.001);
+        obj.pushKV("interval", sample.nIntervalMillis * 0.001);
+        obj.pushKV("hashrate", sample.hashrate);
+        UniValue threads(UniValue::VARR);
+        for (uint32_t i = 0; i < sample.nThreads; i++) {
+            threads.push_back(sample.threadHashrate[i]);
+        }
+        obj.pushKV("threadhashrate", threads);
+        if (sample.nTemplateAgeMillis >= 0) {
+            obj.pushKV("templateage", sample.nTemplateAgeMillis * 0.001);
+        }
+        obj.pushKV("blocks", (uint64_t)sample.nBlocksConnected);
+        obj.pushKV("connecttime", sample.nConnectMicros * 0.001);
+        obj.pushKV("mempooltx", sample.nMempoolTx);
+        obj.pushKV("mempoolbytes", sample.nMempoolBytes);
+        result.push_back(obj);
+    }
+    return result;
+}
+
 UniValue preciousblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -1694,27 +2151,31 @@ UniValue reconsiderblock(const UniValue& params, bool fHelp)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode, streamActor, okParallel, asyncActor
+  //  --------------------- ------------------------  -----------------------  -------------------------------------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  nullptr, true },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  nullptr, true },
+    { "blockchain",         "getblock",               &getblock,               true,  &getblock_stream, true, &getblock_async },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  nullptr, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  nullptr, true },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
     { "blockchain",         "z_gettreestate",         &z_gettreestate,         true  },
     { "blockchain",         "z_getsubtreesbyindex",   &z_getsubtreesbyindex,   true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
+    { "blockchain",         "getmempoolstats",        &getmempoolstats,        true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  &getrawmempool_stream },
+    { "blockchain",         "gettxout",               &gettxout,               true,  nullptr, true, &RPCAwaitActor<gettxout> },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     true  },
+    { "blockchain",         "getperformancehistory",  &getperformancehistory,  true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     // insightexplorer
-    { "blockchain",         "getblockdeltas",         &getblockdeltas,         false },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
+    { "blockchain",         "getblockdeltas",         &getblockdeltas,         false, nullptr, true },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,  nullptr, true },
 
     /* Not shown in help */
     { "hidden",             "preciousblock",          &preciousblock,          true  },
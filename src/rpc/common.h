@@ -54,6 +54,9 @@ static const CRPCConvertTable rpcCvtTable =
     { "getblockheader",              {{s}, {o}} },
     { "getblock",                    {{s}, {o}} },
     { "gettxoutsetinfo",             {{}, {}} },
+    { "dumptxoutset",                {{s}, {}} },
+    { "getvalidationstats",          {{}, {}} },
+    { "getperformancehistory",       {{}, {o}} },
     { "gettxout",                    {{s, o}, {o}} },
     { "verifychain",                 {{}, {o, o}} },
     { "getblockchaininfo",           {{}, {}} },
@@ -61,6 +64,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "z_gettreestate",              {{s}, {}} },
     { "z_getsubtreesbyindex",        {{s, o}, {o}} },
     { "getmempoolinfo",              {{}, {}} },
+    { "getmempoolstats",             {{}, {}} },
     { "invalidateblock",             {{s}, {}} },
     { "reconsiderblock",             {{s}, {}} },
     // mining
@@ -70,12 +74,16 @@ static const CRPCConvertTable rpcCvtTable =
     { "getgenerate",                 {{}, {}} },
     { "generate",                    {{o}, {}} },
     { "setgenerate",                 {{o}, {o}} },
+    { "getminerthreadinfo",          {{}, {}} },
+    { "getminingprofile",            {{}, {}} },
+    { "benchmarkrandomx",            {{}, {o, o, o}} },
     { "getmininginfo",               {{}, {}} },
     { "prioritisetransaction",       {{s, o, o}, {}} },
     { "getblocktemplate",            {{}, {o}} },
     // NB: The second argument _should_ be an object, but upstream treats it as a string, so we
     //     preserve that here.
     { "submitblock",                 {{s}, {s}} },
+    { "submitsolution",              {{s, s, o, s}, {}} },
     { "getblocksubsidy",             {{}, {o}} },
     // misc
     { "getinfo",                     {{}, {}} },
@@ -92,6 +100,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "getaddresstxids",             {{o}, {}} },
     { "getspentinfo",                {{o}, {}} },
     { "getmemoryinfo",               {{}, {}} },
+    { "getlockstats",                {{}, {o, o}} },
     // net
     { "getconnectioncount",          {{}, {}} },
     { "ping",                        {{}, {}} },
@@ -102,6 +111,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "getnettotals",                {{}, {}} },
     { "getdeprecationinfo",          {{}, {}} },
     { "getnetworkinfo",              {{}, {}} },
+    { "getnetworkstats",             {{}, {}} },
     { "setban",                      {{s, s}, {o, o}} },
     { "listbanned",                  {{}, {}} },
     { "clearbanned",                 {{}, {}} },
@@ -114,6 +124,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "decodescript",                {{s}, {}} },
     { "signrawtransaction",          {{s}, {o, o, s, s}} },
     { "sendrawtransaction",          {{s}, {o}} },
+    { "sendrawtransactions",         {{o}, {o}} },
     // rpcdisclosure
     { "z_getpaymentdisclosure",      {{s, o, o}, {s}} },
     { "z_validatepaymentdisclosure", {{s}, {}} },
@@ -145,7 +156,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "sendmany",                    {{s, o}, {o, s, o}} },
     { "addmultisigaddress",          {{o, o}, {s}} },
     { "listreceivedbyaddress",       {{}, {o, o, o, s, o, o}} },
-    { "listtransactions",            {{}, {s, o, o, o, o}} },
+    { "listtransactions",            {{}, {s, o, o, o, o, o}} },
     { "listsinceblock",              {{}, {s, o, o, o, o, o}} },
     { "gettransaction",              {{s}, {o, o, o}} },
     { "backupwallet",                {{s}, {}} },
@@ -168,6 +179,7 @@ static const CRPCConvertTable rpcCvtTable =
     { "z_getnewaddress",             {{}, {s}} },
     { "z_getnewaccount",             {{}, {}} },
     { "z_getaddressforaccount",      {{o}, {o, o}} },
+    { "z_getaddressesforaccount",    {{o, o}, {o}} },
     { "z_listaccounts",              {{}, {}} },
     { "z_listaddresses",             {{}, {o}} },
     { "z_listunifiedreceivers",      {{s}, {}} },
@@ -191,6 +203,8 @@ static const CRPCConvertTable rpcCvtTable =
     { "help",                        {{}, {s}} },
     { "setlogfilter",                {{s}, {}} },
     { "stop",                        {{}, {o}} },
+    // zmq
+    { "getzmqnotifications",         {{}, {}} },
 };
 
 #endif // ZCASH_RPC_COMMON_H
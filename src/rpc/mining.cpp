@@ -23,10 +23,13 @@
 #include "main.h"
 #include "metrics.h"
 #include "miner.h"
+#include "mining_target.h"
 #include "net.h"
 #include "pow.h"
+#include "randomx_benchmark.h"
 #include "rpc/server.h"
 #include "txmempool.h"
+#include "ui_interface.h"
 #include "util/match.h"
 #include "util/system.h"
 #include "validationinterface.h"
@@ -171,6 +174,172 @@ UniValue getgenerate(const UniValue& params, bool fHelp)
     return GetBoolArg("-gen", DEFAULT_GENERATE);
 }
 
+UniValue getminerthreadinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getminerthreadinfo\n"
+            "\nReturns where each running miner thread is pinned and where its RandomX scratchpad was allocated.\n"
+            "A page size of 4096 while -randomxhugepages is set, or a node that differs from requestednode,\n"
+            "means the allocation silently fell back and hashrate is lower than it could be.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"thread\": n,          (numeric) The miner thread index\n"
+            "    \"cpu\": n,             (numeric) The CPU the thread is pinned to, -1 if not pinned\n"
+            "    \"requestednode\": n,   (numeric) The NUMA node the thread was assigned, -1 if none\n"
+            "    \"node\": n,            (numeric) The NUMA node holding the scratchpad, -1 if unknown\n"
+            "    \"pagesize\": n,        (numeric) The size in bytes of the pages backing the scratchpad, 0 if unknown\n"
+            "    \"hugepages\": true|false (boolean) Whether the scratchpad is on hugepages\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getminerthreadinfo", "")
+            + HelpExampleRpc("getminerthreadinfo", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const MinerThreadPlacement& placement : GetMinerThreadPlacement()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("thread", placement.thread_id);
+        obj.pushKV("cpu", placement.cpu);
+        obj.pushKV("requestednode", placement.requested_node);
+        obj.pushKV("node", placement.node);
+        obj.pushKV("pagesize", (uint64_t)placement.page_size);
+        obj.pushKV("hugepages", placement.page_size > 4096);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue getminingprofile(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getminingprofile\n"
+            "\nReturns where each running miner thread has spent its time since mining started,\n"
+            "from per-thread cycle counters. Time outside \"hashing\" is time not spent in RandomX.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"thread\": n,             (numeric) The miner thread index\n"
+            "    \"seconds\": x.xxx,        (numeric) Seconds since the thread started\n"
+            "    \"hashes\": n,             (numeric) Hashes computed by the thread\n"
+            "    \"hashrate\": x.xxx,       (numeric) Hashes per second since the thread started\n"
+            "    \"phases\": {              (json object) Seconds charged to each phase\n"
+            "      \"hashing\": x.xxx,      (numeric) RandomX hashing\n"
+            "      \"template\": x.xxx,     (numeric) Picking up jobs\n"
+            "      \"vm\": x.xxx,           (numeric) Switching seeds and getting VMs\n"
+            "      \"updatetime\": x.xxx,   (numeric) Updating the block time\n"
+            "      \"checks\": x.xxx,       (numeric) Target, interruption and tip checks and found blocks\n"
+            "      \"idle\": x.xxx          (numeric) Waiting for peers, a job or the tip\n"
+            "    },\n"
+            "    \"outsiderandomx\": x.xxx, (numeric) Fraction of the time not charged to hashing\n"
+            "    \"templateswitches\": n,   (numeric) New jobs the thread picked up\n"
+            "    \"lastswitchlatency\": x.xxx, (numeric) Seconds from publishing the last job to the thread hashing it\n"
+            "    \"avgswitchlatency\": x.xxx, (numeric) Average of the above over all jobs\n"
+            "    \"validationpauses\": n,     (numeric) Times the thread stopped hashing while a block was connected (see -minervalidationpause)\n"
+            "    \"validationpauseseconds\": x.xxx (numeric) Seconds spent stopped\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getminingprofile", "")
+            + HelpExampleRpc("getminingprofile", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const MinerThreadProfile& profile : GetMinerProfile()) {
+        UniValue phases(UniValue::VOBJ);
+        for (int phase = 0; phase < MINER_PHASE_COUNT; phase++) {
+            phases.pushKV(MinerPhaseName((MinerPhase)phase), profile.phase_seconds[phase]);
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("thread", profile.thread_id);
+        obj.pushKV("seconds", profile.seconds);
+        obj.pushKV("hashes", profile.hashes);
+        obj.pushKV("hashrate", profile.hashrate);
+        obj.pushKV("phases", phases);
+        obj.pushKV("outsiderandomx", profile.seconds > 0 ?
+            1 - profile.phase_seconds[MINER_PHASE_HASHING] / profile.seconds : 0);
+        obj.pushKV("templateswitches", profile.switches);
+        obj.pushKV("lastswitchlatency", profile.last_switch_latency);
+        obj.pushKV("avgswitchlatency", profile.avg_switch_latency);
+        obj.pushKV("validationpauses", profile.validation_pauses);
+        obj.pushKV("validationpauseseconds", profile.validation_pause_seconds);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue benchmarkrandomx(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 3)
+        throw runtime_error(
+            "benchmarkrandomx ( [threads,...] [\"mode\",...] seconds )\n"
+            "\nMeasures RandomX hashrate for each thread count and mode and returns the results.\n"
+            "Hashes the current RandomX seed directly, so no peers or block template are needed,\n"
+            "and places threads as the miner does (-minerthreadplacement). The RandomX mode is\n"
+            "restored afterwards. Blocks until every point is measured and fails while mining.\n"
+            "\nArguments:\n"
+            "1. threads    (array, optional, default=[1,...,number of CPUs]) Thread counts to measure\n"
+            "2. modes      (array, optional, default=[\"Light\",\"Fast\",\"Fast+Hugepages\"]) RandomX modes to measure\n"
+            "3. seconds    (numeric, optional, default=" + strprintf("%d", DEFAULT_RANDOMX_BENCHMARK_SECONDS) + ") Seconds to measure each point, after warmup\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"threads\": n,           (numeric) Number of hashing threads\n"
+            "    \"mode\": \"mode\",         (string) RandomX mode\n"
+            "    \"hashrate\": x.xxx,      (numeric) Mean hashes per second\n"
+            "    \"variance\": x.xxx,      (numeric) Sample variance of the per-second hashrate\n"
+            "    \"samples\": n,           (numeric) Number of one-second samples\n"
+            "    \"warmupseconds\": x.xxx, (numeric) Seconds until every thread was hashing\n"
+            "    \"placement\": [          (array) Where each thread ran\n"
+            "      {\n"
+            "        \"thread\": n,        (numeric) The thread index\n"
+            "        \"cpu\": n,           (numeric) CPU the thread was pinned to, -1 if not pinned\n"
+            "        \"requestednode\": n, (numeric) NUMA node requested for the VM, -1 if none\n"
+            "        \"node\": n,          (numeric) NUMA node holding the scratchpad, -1 if unknown\n"
+            "        \"pagesize\": n       (numeric) Size of the pages backing the scratchpad, 0 if unknown\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("benchmarkrandomx", "\"[1,2,4]\" \"[\\\"Fast\\\"]\" 10")
+            + HelpExampleRpc("benchmarkrandomx", "[1,2,4], [\"Fast\"], 10")
+        );
+
+    if (GetMinerWays() > 0)
+        throw JSONRPCError(RPC_MISC_ERROR, "Cannot benchmark RandomX while mining; stop mining first");
+
+    RandomXBenchmarkOptions options;
+    if (params.size() > 0 && !params[0].isNull()) {
+        const UniValue& threads = params[0].get_array();
+        for (size_t i = 0; i < threads.size(); i++) {
+            int nThreads = threads[i].get_int();
+            if (nThreads <= 0)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Thread counts must be positive");
+            options.threads.push_back(nThreads);
+        }
+    }
+    if (params.size() > 1 && !params[1].isNull()) {
+        const UniValue& modes = params[1].get_array();
+        for (size_t i = 0; i < modes.size(); i++) {
+            if (!ParseRandomXBenchmarkModes(modes[i].get_str(), options.modes))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown RandomX mode: " + modes[i].get_str());
+        }
+    }
+    if (params.size() > 2) {
+        options.seconds = params[2].get_int();
+    }
+
+    std::vector<RandomXBenchmarkPoint> results;
+    std::string error;
+    if (!RunRandomXBenchmark(options, results, error))
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+    return RandomXBenchmarkToJSON(results);
+}
+
 UniValue generate(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 1)
@@ -259,9 +428,6 @@ UniValue generate(const UniValue& params, bool fHelp)
             seedHash = pindexSeed->GetBlockHash();
         }
 
-        // Update RandomX cache for this seed
-        RandomX_SetMainSeedHash(seedHash.begin(), 32);
-
         // I = the block header minus nonce and solution
         CEquihashInput I{*pblock};
 
@@ -277,7 +443,7 @@ UniValue generate(const UniValue& params, bool fHelp)
 
             // Calculate RandomX hash
             uint256 randomxHash;
-            if (!RandomX_Hash_Block(randomxInput.data(), randomxInput.size(), randomxHash)) {
+            if (!GetPoWHash(Params().GetConsensus(), seedHash, randomxInput.data(), randomxInput.size(), randomxHash)) {
                 throw JSONRPCError(RPC_INTERNAL_ERROR, "RandomX hash calculation failed");
             }
 
@@ -366,8 +532,16 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"generate\": true|false     (boolean) If the generation is on or off (see getgenerate or setgenerate calls)\n"
             "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
             "  \"localsolps\": xxx.xxxxx    (numeric) The average local solution rate in Sol/s since this node was started\n"
+            "  \"minerways\": n             (numeric) The number of RandomX VMs each miner thread interleaves (see -minerways). 0 if not mining\n"
+            "  \"localsolpsperway\": [ x, ... ] (array) The local solution rate of each way, summed over all miner threads\n"
+            "  \"neartargetshares\": n      (numeric) Hashes found by the miner threads meeting the block target made 2^" + std::to_string(DEFAULT_SHARE_SHIFT) + " times easier, since mining was started\n"
+            "  \"minervalidationpause\": n  (numeric) The percentage of miner threads that stop while a block is connected (see -minervalidationpause). 0 if not mining\n"
+            "  \"tipconnects\": n           (numeric) Tip updates since initial block download finished\n"
+            "  \"avgtipconnectms\": x.xxx   (numeric) Average milliseconds each of them took, to compare -minervalidationpause settings\n"
             "  \"networksolps\": x          (numeric) The estimated network solution rate in Sol/s\n"
             "  \"pooledtx\": n              (numeric) The size of the mem pool\n"
+            "  \"powcachehits\": n          (numeric) RandomX solution checks answered from the verified solution cache\n"
+            "  \"powcachemisses\": n        (numeric) RandomX solution checks that had to compute the hash\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
             "}\n"
@@ -377,25 +551,47 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
         );
 
 
-    LOCK(cs_main);
+    // Chain figures come from the metrics snapshot rather than cs_main
+    auto stats = GetMetricsStats();
 
     UniValue obj(UniValue::VOBJ);
-    obj.pushKV("blocks",           (int)chainActive.Height());
-    if (last_block_size.has_value()) obj.pushKV("currentblocksize", last_block_size.value());
-    if (last_block_num_txs.has_value()) obj.pushKV("currentblocktx", last_block_num_txs.value());
-    obj.pushKV("difficulty",       (double)GetNetworkDifficulty());
+    obj.pushKV("blocks",           stats->height);
+    {
+        LOCK(cs_main);
+        if (last_block_size.has_value()) obj.pushKV("currentblocksize", last_block_size.value());
+        if (last_block_num_txs.has_value()) obj.pushKV("currentblocktx", last_block_num_txs.value());
+    }
+    obj.pushKV("difficulty",       stats->difficulty);
     auto warnings = GetWarnings("statusbar");
     obj.pushKV("errors",           warnings.first);
     obj.pushKV("errorstimestamp",  warnings.second);
     obj.pushKV("genproclimit",     (int)GetArg("-genproclimit", DEFAULT_GENERATE_THREADS));
     obj.pushKV("localsolps"  ,     getlocalsolps(params, false));
-    obj.pushKV("networksolps",     getnetworksolps(params, false));
-    obj.pushKV("networkhashps",    getnetworksolps(params, false));
+    obj.pushKV("networksolps",     stats->netsolps);
+    obj.pushKV("networkhashps",    stats->netsolps);
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
+    uint64_t nPoWCacheHits, nPoWCacheMisses;
+    GetPoWCacheStats(nPoWCacheHits, nPoWCacheMisses);
+    obj.pushKV("powcachehits",     nPoWCacheHits);
+    obj.pushKV("powcachemisses",   nPoWCacheMisses);
     obj.pushKV("testnet",          Params().TestnetToBeDeprecatedFieldRPC());
     obj.pushKV("chain",            Params().NetworkIDString());
+    uint64_t nTipConnects;
+    int64_t nTipConnectMicros;
+    GetTipConnectStats(nTipConnects, nTipConnectMicros);
+    obj.pushKV("tipconnects",      nTipConnects);
+    obj.pushKV("avgtipconnectms",  nTipConnects ? nTipConnectMicros * 0.001 / nTipConnects : 0);
 #ifdef ENABLE_MINING
     obj.pushKV("generate",         getgenerate(params, false));
+    int nWays = GetMinerWays();
+    UniValue wayRates(UniValue::VARR);
+    for (int way = 0; way < nWays; way++) {
+        wayRates.push_back(GetLocalSolPSForWay(way));
+    }
+    obj.pushKV("minerways",        nWays);
+    obj.pushKV("localsolpsperway", wayRates);
+    obj.pushKV("neartargetshares", GetMinerNearTargetShares());
+    obj.pushKV("minervalidationpause", GetMinerValidationPause());
 #endif
     return obj;
 }
@@ -454,6 +650,146 @@ static UniValue BIP22ValidationResult(const CValidationState& state)
     return "valid?";
 }
 
+/** Templates handed out by getblocktemplate, by workid, for submitsolution */
+static const size_t MAX_WORK_TEMPLATES = 16;
+static std::map<uint64_t, std::shared_ptr<const CBlockTemplate>> mapWorkTemplates GUARDED_BY(cs_main);
+static uint64_t nNextWorkId GUARDED_BY(cs_main) = 1;
+
+/**
+ * The last template reply of getblocktemplate, serialized. The reply only
+ * changes when a new template is made or curtime moves on to the next
+ * second, so callers polling in between get a copy of the text rather than
+ * having every transaction converted to JSON again.
+ */
+struct CachedTemplateReply {
+    uint256 hashPrevBlock;              //!< Tip the template builds on
+    unsigned int nTransactionsUpdated;  //!< Mempool counter the template was made at
+    int64_t nStart;                     //!< When the template was made
+    int64_t nTime;                      //!< Second the reply was written in
+    std::shared_ptr<const std::string> json;
+};
+static Mutex cs_templateReply;
+static CachedTemplateReply templateReply GUARDED_BY(cs_templateReply);
+
+static void CheckMiningAddressConfigured()
+{
+    // Wallet or miner address is required because we support coinbasetxn
+    if (GetArg("-mineraddress", "").empty()) {
+#ifdef ENABLE_WALLET
+        if (!pwalletMain) {
+            throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Wallet disabled and -mineraddress not set");
+        }
+#else
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "junocashd compiled without wallet and -mineraddress not set");
+#endif
+    }
+}
+
+static void CheckTemplateAvailable()
+{
+    if (Params().NetworkIDString() != "regtest" && vNodes.empty())
+        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Juno Cash is not connected!");
+
+    if (IsInitialBlockDownload(Params().GetConsensus()))
+        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Juno Cash is downloading blocks...");
+}
+
+/**
+ * The cached reply to a plain template request, if getblocktemplate would
+ * still answer with it. Found without cs_main; nullptr if a new reply has
+ * to be made.
+ */
+static std::shared_ptr<const std::string> GetCachedTemplateReply(const UniValue& params)
+{
+    // Longpolls wait for a new template, and proposals are checked every time
+    if (params.size() > 0) {
+        if (!params[0].isObject())
+            return nullptr;
+        const UniValue& modeval = find_value(params[0].get_obj(), "mode");
+        if (!modeval.isNull() && !(modeval.isStr() && modeval.get_str() == "template"))
+            return nullptr;
+        if (!find_value(params[0].get_obj(), "longpollid").isNull())
+            return nullptr;
+    }
+
+    uint256 hashBestBlock;
+    {
+        LOCK(g_best_block_mutex);
+        hashBestBlock = g_best_block;
+    }
+    const int64_t nNow = GetTime();
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+
+    LOCK(cs_templateReply);
+    if (!templateReply.json || templateReply.hashPrevBlock != hashBestBlock || templateReply.nTime != nNow)
+        return nullptr;
+    // The same test getblocktemplate uses to decide on a new template
+    if (nTransactionsUpdated != templateReply.nTransactionsUpdated && nNow - templateReply.nStart > 5)
+        return nullptr;
+    return templateReply.json;
+}
+
+/** How long a longpoll holds back for new transactions alone */
+static const std::chrono::seconds LONGPOLL_TX_DELAY{10};
+/** How long a longpoll waits on a new tip for the template updater's template */
+static const std::chrono::milliseconds LONGPOLL_TEMPLATE_WAIT{1000};
+
+/**
+ * Wakes longpolling getblocktemplate callers. Bumped on every new tip, every
+ * new mempool transaction and every template the template updater
+ * publishes, so that waiters look again as soon as something changed
+ * instead of on a timer.
+ */
+static Mutex cs_longpoll;
+static std::condition_variable condLongpoll;
+static uint64_t nLongpollGeneration GUARDED_BY(cs_longpoll) = 0;
+
+static void NotifyLongpollWaiters()
+{
+    {
+        LOCK(cs_longpoll);
+        nLongpollGeneration++;
+    }
+    condLongpoll.notify_all();
+}
+
+static void ConnectLongpollNotifications()
+{
+    static std::once_flag connected;
+    std::call_once(connected, [] {
+        uiInterface.NotifyBlockTip.connect([](bool, const CBlockIndex*) { NotifyLongpollWaiters(); });
+        mempool.NotifyEntryAdded.connect([](const CTransaction&) { NotifyLongpollWaiters(); });
+#ifdef ENABLE_MINING
+        NotifySharedTemplateChanged.connect(&NotifyLongpollWaiters);
+#endif
+    });
+}
+
+/** The template updater's template, if it is running and has one on hashTip */
+static std::shared_ptr<const CBlockTemplate> GetUpdaterTemplate(const uint256& hashTip)
+{
+#ifdef ENABLE_MINING
+    if (IsBlockTemplateUpdaterRunning()) {
+        std::shared_ptr<const CBlockTemplate> pshared = GetSharedBlockTemplate();
+        if (pshared && pshared->block.hashPrevBlock == hashTip)
+            return pshared;
+    }
+#endif
+    return nullptr;
+}
+
+/** Whether the template updater is running but has no template on hashTip yet */
+static bool IsTemplateBeingBuilt(const uint256& hashTip)
+{
+#ifdef ENABLE_MINING
+    return IsBlockTemplateUpdaterRunning() && !GetUpdaterTemplate(hashTip);
+#else
+    return false;
+#endif
+}
+
+static UniValue BlockTemplateResult(const UniValue& params, std::shared_ptr<const std::string>* pjson);
+
 UniValue getblocktemplate(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -518,6 +854,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             "  \"coinbasetxn\" : { ... },           (json object) information for coinbase transaction\n"
             "  \"target\" : \"xxxx\",                 (string) The hash target\n"
             "  \"longpollid\" : \"str\",              (string) an id to include with a request to longpoll on an update to this template\n"
+            "  \"workid\" : \"str\",                  (string) an id to pass to submitsolution to submit a solved header for this template\n"
             "  \"mintime\" : xxx,                   (numeric) The minimum timestamp appropriate for next block time in seconds since epoch (Jan 1 1970 GMT)\n"
             "  \"mutable\" : [                      (array of string) list of ways the block template may be changed \n"
             "     \"value\"                         (string) A way the block template may be changed, e.g. 'time', 'transactions', 'prevblock'\n"
@@ -539,19 +876,51 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblocktemplate", "")
          );
 
-    LOCK(cs_main);
+    return BlockTemplateResult(params, nullptr);
+}
 
-    // Wallet or miner address is required because we support coinbasetxn
-    if (GetArg("-mineraddress", "").empty()) {
-#ifdef ENABLE_WALLET
-        if (!pwalletMain) {
-            throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Wallet disabled and -mineraddress not set");
+void getblocktemplate_stream(const UniValue& params, JSONStreamWriter& out)
+{
+    std::shared_ptr<const std::string> json = GetCachedTemplateReply(params);
+    if (json) {
+        CheckMiningAddressConfigured();
+        CheckTemplateAvailable();
+        out.Raw(*json);
+        return;
+    }
+
+    UniValue result = BlockTemplateResult(params, &json);
+    if (json) {
+        out.Raw(*json);
+    } else {
+        out.Value(result);
+    }
+}
+
+/**
+ * Everything getblocktemplate does but the help. If pjson is given, a
+ * template reply is also serialized into it and kept for later callers.
+ */
+static UniValue BlockTemplateResult(const UniValue& params, std::shared_ptr<const std::string>* pjson)
+{
+    // Decode a proposal and verify its PoW before taking cs_main, so that
+    // concurrent proposals and submissions hash in parallel
+    CBlock proposal;
+    bool fProposalDecoded = false;
+    if (params.size() > 0 && params[0].isObject()) {
+        const UniValue& modeval = find_value(params[0].get_obj(), "mode");
+        const UniValue& dataval = find_value(params[0].get_obj(), "data");
+        if (modeval.isStr() && modeval.get_str() == "proposal" && dataval.isStr() &&
+            DecodeHexBlk(proposal, dataval.get_str())) {
+            fProposalDecoded = true;
+            PreverifyBlocksPoW({&proposal});
         }
-#else
-        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "junocashd compiled without wallet and -mineraddress not set");
-#endif
     }
 
+    LOCK(cs_main);
+
+    CheckMiningAddressConfigured();
+
     std::string strMode = "template";
     UniValue lpval = NullUniValue;
     // TODO: Re-enable coinbasevalue once a specification has been written
@@ -576,9 +945,9 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             if (!dataval.isStr())
                 throw JSONRPCError(RPC_TYPE_ERROR, "Missing data String key for proposal");
 
-            CBlock block;
-            if (!DecodeHexBlk(block, dataval.get_str()))
+            if (!fProposalDecoded)
                 throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+            const CBlock& block = proposal;
 
             uint256 hash = block.GetHash();
             BlockMap::iterator mi = mapBlockIndex.find(hash);
@@ -605,11 +974,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     if (strMode != "template")
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid mode");
 
-    if (Params().NetworkIDString() != "regtest" && vNodes.empty())
-        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Juno Cash is not connected!");
-
-    if (IsInitialBlockDownload(Params().GetConsensus()))
-        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Juno Cash is downloading blocks...");
+    CheckTemplateAvailable();
 
     std::optional<MinerAddress> maybeMinerAddress;
     GetMainSignals().AddressForMining(maybeMinerAddress);
@@ -658,38 +1023,67 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         // Don't call chainActive->Tip() without holding cs_main
         LEAVE_CRITICAL_SECTION(cs_main);
         {
-            checktxtime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            // Before waiting, generate the coinbase for the block following the next
+            // block (since this is cpu-intensive), so that when next block arrives,
+            // we can quickly respond with a template for following block.
+            // Note that the time to create the coinbase tx here does not add to,
+            // but instead is included in, the delay for new transactions, since
+            // we're waiting until an absolute time is reached.
+            checktxtime = std::chrono::steady_clock::now() + LONGPOLL_TX_DELAY;
+            if (!cached_next_cb_mtx && IsShieldedMinerAddress(minerAddress)) {
+                cached_next_cb_height = nHeight + 2;
+                cached_next_cb_mtx = CreateCoinbaseTransaction(
+                    Params(), CAmount{0}, minerAddress, cached_next_cb_height);
+                next_cb_mtx = cached_next_cb_mtx;
+            }
 
-            WAIT_LOCK(g_best_block_mutex, lock);
-            while (g_best_block == hashWatchedChain && IsRPCRunning())
+            ConnectLongpollNotifications();
+            std::optional<std::chrono::steady_clock::time_point> tiptime;
+            int nBestHeight = nHeight;
+            while (IsRPCRunning())
             {
-                // Before waiting, generate the coinbase for the block following the next
-                // block (since this is cpu-intensive), so that when next block arrives,
-                // we can quickly respond with a template for following block.
-                // Note that the time to create the coinbase tx here does not add to,
-                // but instead is included in, the 10 second delay, since we're waiting
-                // until an absolute time is reached.
-                if (!cached_next_cb_mtx && IsShieldedMinerAddress(minerAddress)) {
-                    cached_next_cb_height = nHeight + 2;
-                    cached_next_cb_mtx = CreateCoinbaseTransaction(
-                        Params(), CAmount{0}, minerAddress, cached_next_cb_height);
-                    next_cb_mtx = cached_next_cb_mtx;
+                // Look at the chain and mempool without holding cs_longpoll,
+                // which is taken while the mempool is locked; any change from
+                // here on ends the wait below.
+                uint64_t nGeneration;
+                {
+                    LOCK(cs_longpoll);
+                    nGeneration = nLongpollGeneration;
+                }
+                uint256 hashBestBlock;
+                {
+                    LOCK(g_best_block_mutex);
+                    hashBestBlock = g_best_block;
+                    nBestHeight = g_best_block_height;
                 }
-                bool timedout = g_best_block_cv.wait_until(lock, checktxtime) == std::cv_status::timeout;
-
-                // Optimization: even if timed out, a new block may have arrived
-                // while waiting for cs_main; if so, don't discard next_cb_mtx.
-                if (g_best_block != hashWatchedChain) break;
 
-                // Timeout: Check transactions for update
-                if (timedout && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP) {
-                    // Create a non-empty block.
-                    next_cb_mtx = nullopt;
-                    break;
+                auto now = std::chrono::steady_clock::now();
+                std::chrono::steady_clock::time_point until;
+                if (hashBestBlock != hashWatchedChain) {
+                    // Give the template updater a moment to publish a template
+                    // on the new tip, so that it is handed out rather than
+                    // built again.
+                    if (!tiptime)
+                        tiptime = now;
+                    if (!IsTemplateBeingBuilt(hashBestBlock) || now >= *tiptime + LONGPOLL_TEMPLATE_WAIT)
+                        break;
+                    until = *tiptime + LONGPOLL_TEMPLATE_WAIT;
+                } else if (now >= checktxtime) {
+                    if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP) {
+                        // Create a non-empty block.
+                        next_cb_mtx = nullopt;
+                        break;
+                    }
+                    // Only to notice a shutdown
+                    until = now + LONGPOLL_TX_DELAY;
+                } else {
+                    until = checktxtime;
                 }
-                checktxtime += std::chrono::seconds(10);
+
+                WAIT_LOCK(cs_longpoll, lock);
+                condLongpoll.wait_until(lock, until, [&] { return nLongpollGeneration != nGeneration; });
             }
-            if (g_best_block_height != nHeight + 1) {
+            if (nBestHeight != nHeight + 1) {
                 // Unexpected height (reorg or >1 blocks arrived while waiting) invalidates coinbase tx.
                 next_cb_mtx = nullopt;
             }
@@ -704,10 +1098,13 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     // Update block
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
-    static CBlockTemplate* pblocktemplate;
+    static std::shared_ptr<CBlockTemplate> pblocktemplate;
+    static uint64_t nWorkId;
     if (!lpval.isNull() || pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
+        const bool fNewTip = pindexPrev != chainActive.Tip();
+
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
 
@@ -723,21 +1120,39 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         nStart = GetTime();
 
         // Create new block
-        if(pblocktemplate)
-        {
-            delete pblocktemplate;
-            pblocktemplate = nullptr;
-        }
+        pblocktemplate.reset();
 
         // Throw an error if no address valid for mining was provided.
         if (!std::visit(IsValidMinerAddress(), minerAddress)) {
             throw JSONRPCError(RPC_INTERNAL_ERROR, "No miner address available (mining requires a wallet or -mineraddress)");
         }
 
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(minerAddress, next_cb_mtx);
+        // On a new tip the template updater has usually built the template
+        // already. It is only taken then, as it may lag behind the mempool.
+        std::shared_ptr<const CBlockTemplate> pupdaterTemplate;
+        if (fNewTip)
+            pupdaterTemplate = GetUpdaterTemplate(pindexPrevNew->GetBlockHash());
+        if (pupdaterTemplate) {
+            pblocktemplate = std::make_shared<CBlockTemplate>(*pupdaterTemplate);
+        } else {
+            pblocktemplate.reset(BlockAssembler(Params()).CreateNewBlock(minerAddress, next_cb_mtx));
+        }
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
+        // Remember it for submitsolution, dropping the oldest templates and
+        // those for an earlier tip
+        for (auto it = mapWorkTemplates.begin(); it != mapWorkTemplates.end(); ) {
+            if (it->second->block.hashPrevBlock != pindexPrevNew->GetBlockHash() ||
+                mapWorkTemplates.size() >= MAX_WORK_TEMPLATES) {
+                it = mapWorkTemplates.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        nWorkId = nNextWorkId++;
+        mapWorkTemplates.emplace(nWorkId, pblocktemplate);
+
         // Mark script as important because it was used at least for one coinbase output
         std::visit(KeepMinerAddress(), minerAddress);
 
@@ -748,11 +1163,13 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
 
     const Consensus::Params& consensus = Params().GetConsensus();
 
-    // Update nTime
+    // Update nTime. The reply depends on the clock only through this, so it
+    // stays the same for the rest of the second.
+    const int64_t nReplyTime = GetTime();
     UpdateTime(pblock, consensus, pindexPrev);
     pblock->nNonce = uint256();
 
-    UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
+    UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal"); aCaps.push_back("workid");
 
     UniValue txCoinbase = NullUniValue;
     UniValue transactions(UniValue::VARR);
@@ -844,6 +1261,7 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         result.pushKV("coinbasevalue", (int64_t)pblock->vtx[0].vout[0].nValue);
     }
     result.pushKV("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast));
+    result.pushKV("workid", strprintf("%d", nWorkId));
     result.pushKV("target", hashTarget.GetHex());
     result.pushKV("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1);
     result.pushKV("mutable", aMutable);
@@ -901,6 +1319,14 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         }
     }
 
+    if (pjson) {
+        *pjson = std::make_shared<const std::string>(result.write());
+        if (GetTime() == nReplyTime) {
+            LOCK(cs_templateReply);
+            templateReply = {pindexPrev->GetBlockHash(), nTransactionsUpdatedLast, nStart, nReplyTime, *pjson};
+        }
+    }
+
     return result;
 }
 
@@ -922,6 +1348,48 @@ protected:
     };
 };
 
+/** Process a block submitted over RPC and report the result as in BIP 22 */
+static UniValue SubmitBlock(CBlock& block)
+{
+    uint256 hash = block.GetHash();
+    bool fBlockPresent = false;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi != mapBlockIndex.end()) {
+            CBlockIndex *pindex = mi->second;
+            if (pindex->IsValid(BLOCK_VALID_SCRIPTS))
+                return "duplicate";
+            if (pindex->nStatus & BLOCK_FAILED_MASK)
+                return "duplicate-invalid";
+            // Otherwise, we might only have the header - process the block before returning
+            fBlockPresent = true;
+        }
+    }
+
+    // Hash outside cs_main; ProcessNewBlock then finds the result in the PoW cache
+    PreverifyBlocksPoW({&block});
+
+    CValidationState state;
+    submitblock_StateCatcher sc(block.GetHash());
+    RegisterValidationInterface(&sc, "submitblock", true);
+    bool fAccepted = ProcessNewBlock(state, Params(), NULL, &block, true, NULL);
+    UnregisterValidationInterface(&sc);
+    if (fBlockPresent)
+    {
+        if (fAccepted && !sc.found)
+            return "duplicate-inconclusive";
+        return "duplicate";
+    }
+    if (fAccepted)
+    {
+        if (!sc.found)
+            return "inconclusive";
+        state = sc.state;
+    }
+    return BIP22ValidationResult(state);
+}
+
 UniValue submitblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -953,40 +1421,55 @@ UniValue submitblock(const UniValue& params, bool fHelp)
     if (!DecodeHexBlk(block, params[0].get_str()))
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
 
-    uint256 hash = block.GetHash();
-    bool fBlockPresent = false;
+    return SubmitBlock(block);
+}
+
+UniValue submitsolution(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 4)
+        throw runtime_error(
+            "submitsolution \"workid\" \"nonce\" time \"solution\"\n"
+            "\nSubmits a solved header for a template returned by getblocktemplate.\n"
+            "The node rebuilds the block from the template it returned with that workid,\n"
+            "so the miner does not have to send the transactions back.\n"
+            "\nArguments\n"
+            "1. \"workid\"     (string, required) the workid of the template\n"
+            "2. \"nonce\"      (string, required) the 256-bit nonce, hex encoded like getblock's \"nonce\"\n"
+            "3. time         (numeric, required) the block time in seconds since epoch\n"
+            "4. \"solution\"   (string, required) the hex-encoded solution (the RandomX hash)\n"
+            "\nResult:\n"
+            "The same results as submitblock\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitsolution", "\"12\" \"00..01\" 1700000000 \"ab..cd\"")
+            + HelpExampleRpc("submitsolution", "\"12\", \"00..01\", 1700000000, \"ab..cd\"")
+        );
+
+    int64_t nWorkId;
+    if (!ParseInt64(params[0].get_str(), &nWorkId) || nWorkId <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid workid");
+    std::string strNonce = params[1].get_str();
+    if (strNonce.size() != 64 || !IsHex(strNonce))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid nonce");
+    int64_t nTime = params[2].get_int64();
+    if (nTime < 0 || nTime > std::numeric_limits<uint32_t>::max())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid time");
+    if (!IsHex(params[3].get_str()))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid solution");
+
+    CBlock block;
     {
         LOCK(cs_main);
-        BlockMap::iterator mi = mapBlockIndex.find(hash);
-        if (mi != mapBlockIndex.end()) {
-            CBlockIndex *pindex = mi->second;
-            if (pindex->IsValid(BLOCK_VALID_SCRIPTS))
-                return "duplicate";
-            if (pindex->nStatus & BLOCK_FAILED_MASK)
-                return "duplicate-invalid";
-            // Otherwise, we might only have the header - process the block before returning
-            fBlockPresent = true;
-        }
+        auto it = mapWorkTemplates.find(nWorkId);
+        if (it == mapWorkTemplates.end())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown or stale workid");
+        block = it->second->block;
     }
+    block.nNonce = uint256S(strNonce);
+    block.nTime = nTime;
+    std::vector<unsigned char> solution = ParseHex(params[3].get_str());
+    block.nSolution.assign(solution.begin(), solution.end());
 
-    CValidationState state;
-    submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
-    bool fAccepted = ProcessNewBlock(state, Params(), NULL, &block, true, NULL);
-    UnregisterValidationInterface(&sc);
-    if (fBlockPresent)
-    {
-        if (fAccepted && !sc.found)
-            return "duplicate-inconclusive";
-        return "duplicate";
-    }
-    if (fAccepted)
-    {
-        if (!sc.found)
-            return "inconclusive";
-        state = sc.state;
-    }
-    return BIP22ValidationResult(state);
+    return SubmitBlock(block);
 }
 
 UniValue getblocksubsidy(const UniValue& params, bool fHelp)
@@ -1102,20 +1585,24 @@ UniValue getblocksubsidy(const UniValue& params, bool fHelp)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
+{ //  category              name                      actor (function)         okSafeMode, streamActor
   //  --------------------- ------------------------  -----------------------  ----------
     { "mining",             "getlocalsolps",          &getlocalsolps,          true  },
     { "mining",             "getnetworksolps",        &getnetworksolps,        true  },
     { "mining",             "getnetworkhashps",       &getnetworkhashps,       true  },
     { "mining",             "getmininginfo",          &getmininginfo,          true  },
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,  &getblocktemplate_stream },
     { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "submitsolution",         &submitsolution,         true  },
     { "mining",             "getblocksubsidy",        &getblocksubsidy,        true  },
 
 #ifdef ENABLE_MINING
     { "generating",         "getgenerate",            &getgenerate,            true  },
     { "generating",         "setgenerate",            &setgenerate,            true  },
+    { "generating",         "getminerthreadinfo",     &getminerthreadinfo,     true  },
+    { "generating",         "getminingprofile",       &getminingprofile,       true  },
+    { "generating",         "benchmarkrandomx",       &benchmarkrandomx,       true  },
     { "generating",         "generate",               &generate,               true  },
 #endif
 };
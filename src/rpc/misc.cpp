@@ -6,16 +6,21 @@
 // file COPYING or https://www.opensource.org/licenses/mit-license.php .
 
 #include "clientversion.h"
+#include "crypto/randomx_wrapper.h"
 #include "deprecation.h"
 #include "init.h"
 #include "key_io.h"
 #include "experimental_features.h"
+#include "index/insightindex.h"
 #include "main.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
+#include "support/hugepagearena.h"
 #include "txmempool.h"
 #include "util/system.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
@@ -23,12 +28,16 @@
 
 #include <stdint.h>
 #include <variant>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #include <boost/assign/list_of.hpp>
 
 #include <univalue.h>
 
 #include "zcash/Address.hpp"
+#include "zcash/cache.h"
 
 using namespace std;
 
@@ -72,6 +81,10 @@ UniValue getinfo(const UniValue& params, bool fHelp)
             "  \"relayfee\": x.xxxx,         (numeric) minimum relay fee rate for transactions in " + CURRENCY_UNIT + " per 1000 bytes\n"
             "  \"errors\": \"...\"           (string) message describing the latest or highest-priority error\n"
             "  \"errorstimestamp\": \"...\"  (string) timestamp associated with the latest or highest-priority error\n"
+            "  \"inittimes\": {              (object) how long each startup phase took, in milliseconds\n"
+            "    \"phase\": xxxx,            (numeric) the duration of the named phase\n"
+            "    ...\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getinfo", "")
@@ -117,6 +130,10 @@ UniValue getinfo(const UniValue& params, bool fHelp)
     auto warnings = GetWarnings("statusbar");
     obj.pushKV("errors",           warnings.first);
     obj.pushKV("errorstimestamp",  warnings.second);
+    UniValue initTimes(UniValue::VOBJ);
+    for (const auto& phase : GetInitPhaseTimes())
+        initTimes.pushKV(phase.first, phase.second);
+    obj.pushKV("inittimes",        initTimes);
     return obj;
 }
 
@@ -599,6 +616,18 @@ static bool getIndexKey(
     return false;
 }
 
+// insightexplorer
+// Wait for the insight index to apply the blocks connected so far, so that a
+// lookup made after a block arrives sees it.
+void SyncInsightIndex()
+{
+    if (g_insight_index && !g_insight_index->BlockUntilSyncedToCurrentChain()) {
+        const CBlockIndex* pindex = g_insight_index->GetBestBlock();
+        throw JSONRPCError(RPC_IN_WARMUP, strprintf(
+            "The insight index is still being built, at height %d", pindex ? pindex->nHeight : -1));
+    }
+}
+
 // insightexplorer
 static bool getAddressesFromParams(
     const UniValue& params,
@@ -784,6 +813,7 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
+    SyncInsightIndex();
     std::vector<CAddressUnspentDbEntry> unspentOutputs;
     for (const auto& it : addresses) {
         if (!GetAddressUnspent(it.first, it.second, unspentOutputs)) {
@@ -870,6 +900,7 @@ static void getAddressesInHeightRange(
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
+    SyncInsightIndex();
     for (const auto& it : addresses) {
         if (!GetAddressIndex(it.first, it.second, addressIndex, start, end)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
@@ -1036,6 +1067,9 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
             "{\n"
             "  \"balance\"  (string) The current balance in " + MINOR_CURRENCY_UNIT + "\n"
             "  \"received\"  (string) The total number of " + MINOR_CURRENCY_UNIT + " received (including change)\n"
+            "  \"txcount\"  (numeric) The number of transactions of each address, summed over the addresses\n"
+            "  \"firstheight\"  (numeric) The height of the first transaction of any of the addresses, or 0 if none\n"
+            "  \"lastheight\"  (numeric) The height of the last transaction of any of the addresses, or 0 if none\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"tmYXBYJj1K7vhejSec5osXK2QsGa5MTisUQ\"]}'")
@@ -1048,22 +1082,41 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
     }
 
     std::vector<std::pair<uint160, int>> addresses;
-    std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
-    // this method doesn't take start and end block height params, so set
-    // to zero (full range, entire blockchain)
-    getAddressesInHeightRange(params, 0, 0, addresses, addressIndex);
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+    SyncInsightIndex();
 
+    // The summary record of each address holds its totals, so the balance
+    // does not depend on how many transactions the address has.
     CAmount balance = 0;
     CAmount received = 0;
-    for (const auto& it : addressIndex) {
-        if (it.second > 0) {
-            received += it.second;
+    int64_t txCount = 0;
+    int firstHeight = 0;
+    int lastHeight = 0;
+    for (const auto& it : addresses) {
+        CAddressSummary summary;
+        if (!GetAddressSummary(it.first, it.second, summary)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                "No information available for address");
+        }
+        if (summary.IsNull()) {
+            continue;
+        }
+        balance += summary.balance;
+        received += summary.received;
+        if (txCount == 0 || summary.firstHeight < firstHeight) {
+            firstHeight = summary.firstHeight;
         }
-        balance += it.second;
+        lastHeight = std::max(lastHeight, summary.lastHeight);
+        txCount += summary.txCount;
     }
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
     result.pushKV("received", received);
+    result.pushKV("txcount", txCount);
+    result.pushKV("firstheight", firstHeight);
+    result.pushKV("lastheight", lastHeight);
     return result;
 }
 
@@ -1186,6 +1239,7 @@ UniValue getspentinfo(const UniValue& params, bool fHelp)
     CSpentIndexKey key(txid, outputIndex);
     CSpentIndexValue value;
 
+    SyncInsightIndex();
     {
         LOCK(cs_main);
         if (!GetSpentIndex(key, value)) {
@@ -1213,6 +1267,22 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCHugePageArenaInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    for (int id = 0; id < ARENA_COUNT; id++) {
+        CHugePageArena::Stats stats = HugePageArena(static_cast<HugePageArenaId>(id)).GetStats();
+        UniValue arena(UniValue::VOBJ);
+        arena.pushKV("used", uint64_t(stats.nUsed));
+        arena.pushKV("mapped", uint64_t(stats.nMapped));
+        arena.pushKV("hugetlb", uint64_t(stats.nHugeTLB));
+        arena.pushKV("mappings", uint64_t(stats.nMappings));
+        arena.pushKV("failed_mappings", uint64_t(stats.nFailedMappings));
+        obj.pushKV(HugePageArenaName(static_cast<HugePageArenaId>(id)), arena);
+    }
+    return obj;
+}
+
 UniValue getmemoryinfo(const UniValue& params, bool fHelp)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -1231,6 +1301,15 @@ UniValue getmemoryinfo(const UniValue& params, bool fHelp)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"hugepages\": {            (json object) Memory of the -hugepagearenas arenas, by structure\n"
+            "    \"coins\"|\"mempool\"|\"blockindex\": {\n"
+            "      \"used\": xxxxx,        (numeric) Bytes allocated from the arena\n"
+            "      \"mapped\": xxxxx,      (numeric) Bytes mapped for the arena, in 2MB pages\n"
+            "      \"hugetlb\": xxxxx,     (numeric) Of which on reserved huge pages; the rest are madvised for transparent huge pages\n"
+            "      \"mappings\": xxxxx,    (numeric) Number of mappings\n"
+            "      \"failed_mappings\": xx (numeric) Mappings that failed, whose allocations were made with malloc instead\n"
+            "    }\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -1239,14 +1318,290 @@ UniValue getmemoryinfo(const UniValue& params, bool fHelp)
         );
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("locked", RPCLockedMemoryInfo());
+    obj.pushKV("hugepages", RPCHugePageArenaInfo());
+    return obj;
+}
+
+/** Resident set size of the process in bytes, or -1 if it is not known here */
+static int64_t GetResidentMemory()
+{
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file) {
+        long nSize, nResident;
+        int nRead = fscanf(file, "%ld %ld", &nSize, &nResident);
+        fclose(file);
+        if (nRead == 2) {
+            return (int64_t)nResident * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+UniValue getmemoryusage(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryusage\n"
+            "Returns an estimate of the memory held by each subsystem, in bytes, to compare\n"
+            "with the resident memory of the process. Allocator overhead is estimated, and\n"
+            "memory that is not listed (such as thread stacks, VM scratchpads and database\n"
+            "caches) is only included in \"unaccounted\".\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coinstip\": n,          (numeric) The coins cache (see -dbcache)\n"
+            "  \"mempool\": n,           (numeric) The transaction memory pool\n"
+            "  \"blockindex\": n,        (numeric) The block index and the active chain\n"
+            "  \"orphans\": n,           (numeric) Orphan transactions and their indexes\n"
+            "  \"addrman\": n,           (numeric) The address manager\n"
+            "  \"sigcache\": n,          (numeric) The signature cache\n"
+            "  \"bundlecaches\": {       (object) The bundle validity caches, by kind\n"
+            "    \"kind\": n, ...\n"
+            "  },\n"
+            "  \"randomx\": {\n"
+            "    \"total\": n,           (numeric) Memory of the caches and datasets below\n"
+            "    \"memorylevel\": \"level\", (string) \"full\", or \"onedataset\" or \"light\" while short of memory (-randomxmemoryreserve)\n"
+            "    \"seeds\": [            (array) The caches and datasets kept for each seed\n"
+            "      {\n"
+            "        \"seedhash\": \"hash\", (string) The seed\n"
+            "        \"type\": \"type\",   (string) \"cache\" or \"dataset\"\n"
+            "        \"node\": n,        (numeric) NUMA node of a dataset, -1 if none\n"
+            "        \"bytes\": n\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  },\n"
+            "  \"wallet\": {             (object) Only if the wallet is enabled\n"
+            "    \"transactions\": n,    (numeric) Wallet transactions, note data and witnesses\n"
+            "    \"orchard_notes\": n,   (numeric) The Orchard wallet's note data\n"
+            "    \"batchscanners\": n    (numeric) Transactions queued for trial decryption\n"
+            "  },\n"
+            "  \"total\": n,             (numeric) Sum of the above\n"
+            "  \"rss\": n,               (numeric) Resident memory of the process, if known\n"
+            "  \"unaccounted\": n        (numeric) rss minus total, if rss is known\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmemoryusage", "")
+            + HelpExampleRpc("getmemoryusage", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    size_t nTotal = 0;
+    auto pushUsage = [&](UniValue& o, const std::string& key, size_t nUsage) {
+        o.pushKV(key, (uint64_t)nUsage);
+        nTotal += nUsage;
+    };
+
+    {
+        LOCK(cs_main);
+        pushUsage(obj, "coinstip", pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0);
+        pushUsage(obj, "mempool", mempool.DynamicMemoryUsage());
+        pushUsage(obj, "blockindex", BlockIndexDynamicMemoryUsage());
+        pushUsage(obj, "orphans", OrphanageDynamicMemoryUsage());
+    }
+    pushUsage(obj, "addrman", addrman.DynamicMemoryUsage());
+    pushUsage(obj, "sigcache", GetSignatureCacheMemoryUsage());
+
+    UniValue bundleCaches(UniValue::VOBJ);
+    for (const auto& [kind, cache] : libzcash::GetBundleValidityCaches()) {
+        pushUsage(bundleCaches, kind, cache->memory_usage());
+    }
+    obj.pushKV("bundlecaches", bundleCaches);
+
+    UniValue randomx(UniValue::VOBJ);
+    UniValue seeds(UniValue::VARR);
+    size_t nRandomX = 0;
+    for (const RandomXSeedMemory& seed : RandomX_GetSeedMemory()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("seedhash", seed.seedhash.GetHex());
+        entry.pushKV("type", seed.dataset ? "dataset" : "cache");
+        entry.pushKV("node", seed.node);
+        entry.pushKV("bytes", (uint64_t)seed.bytes);
+        seeds.push_back(entry);
+        nRandomX += seed.bytes;
+    }
+    pushUsage(randomx, "total", nRandomX);
+    randomx.pushKV("memorylevel", RandomX_MemoryLevelName((RandomXMemoryLevel)RandomX_GetMemoryStats().memory_level));
+    randomx.pushKV("seeds", seeds);
+    obj.pushKV("randomx", randomx);
+
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        UniValue walletUsage(UniValue::VOBJ);
+        {
+            LOCK(pwalletMain->cs_wallet);
+            pushUsage(walletUsage, "transactions", pwalletMain->WalletTxUsage());
+            pushUsage(walletUsage, "orchard_notes", pwalletMain->OrchardNoteDataUsage());
+        }
+        pushUsage(walletUsage, "batchscanners", wallet::batch_scanners_dynamic_usage());
+        obj.pushKV("wallet", walletUsage);
+    }
+#endif
+
+    obj.pushKV("total", (uint64_t)nTotal);
+    int64_t nResident = GetResidentMemory();
+    if (nResident >= 0) {
+        obj.pushKV("rss", nResident);
+        obj.pushKV("unaccounted", nResident - (int64_t)nTotal);
+    }
+    return obj;
+}
+
+UniValue getlockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "getlockstats ( sites reset )\n"
+            "Returns wait and hold times of the locks taken with LOCK, as sampled by the\n"
+            "lock profiler since it was started or last reset. The profiler is off unless\n"
+            "the node is started with -lockstats=<n>, which samples one in <n> acquisitions\n"
+            "on each thread. Times are in microseconds and cover the sampled acquisitions.\n"
+            "\nArguments:\n"
+            "1. sites     (numeric, optional, default=5) The number of call sites to list for each lock\n"
+            "2. reset     (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"interval\": n,             (numeric) One in this many acquisitions is sampled, 0 if off\n"
+            "  \"locks\": [                 (array) The locks, most waited for first\n"
+            "    {\n"
+            "      \"name\": \"name\",        (string) The lock as named at its LOCK call sites\n"
+            "      \"samples\": n,          (numeric) Sampled acquisitions\n"
+            "      \"contended\": n,        (numeric) Sampled acquisitions that had to wait\n"
+            "      \"wait_total\": n,       (numeric) Total time spent waiting for the lock\n"
+            "      \"wait_max\": n,         (numeric) Longest wait for the lock\n"
+            "      \"hold_total\": n,       (numeric) Total time the lock was held\n"
+            "      \"hold_max\": n,         (numeric) Longest time the lock was held\n"
+            "      \"sites\": [             (array) The call sites with the most wait and hold time\n"
+            "        {\n"
+            "          \"site\": \"file:line\", (string) The LOCK call site\n"
+            "          \"samples\": n, \"contended\": n, \"wait_total\": n, \"wait_max\": n, \"hold_total\": n, \"hold_max\": n\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "10 true")
+            + HelpExampleRpc("getlockstats", "10, true")
+        );
+
+    int nSites = 5;
+    if (params.size() > 0) {
+        nSites = params[0].get_int();
+        if (nSites < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid number of sites");
+    }
+    bool fReset = params.size() > 1 && params[1].get_bool();
+
+    std::vector<LockSiteStats> vSites = GetLockStats();
+    if (fReset)
+        ResetLockStats();
+
+    // The same lock is named by different string literals in each file.
+    std::map<std::string, std::vector<const LockSiteStats*>> mapLocks;
+    for (const LockSiteStats& site : vSites) {
+        mapLocks[site.name].push_back(&site);
+    }
+
+    auto statsToJSON = [](UniValue& obj, const LockSiteStats& stats) {
+        obj.pushKV("samples", stats.nSamples);
+        obj.pushKV("contended", stats.nContended);
+        obj.pushKV("wait_total", stats.nWaitMicros);
+        obj.pushKV("wait_max", stats.nMaxWaitMicros);
+        obj.pushKV("hold_total", stats.nHoldMicros);
+        obj.pushKV("hold_max", stats.nMaxHoldMicros);
+    };
+
+    std::vector<std::pair<LockSiteStats, std::vector<const LockSiteStats*>>> vLocks;
+    for (auto& [name, sites] : mapLocks) {
+        LockSiteStats total{name, "", 0, 0, 0, 0, 0, 0, 0};
+        for (const LockSiteStats* site : sites) {
+            total.nSamples += site->nSamples;
+            total.nContended += site->nContended;
+            total.nWaitMicros += site->nWaitMicros;
+            total.nMaxWaitMicros = std::max(total.nMaxWaitMicros, site->nMaxWaitMicros);
+            total.nHoldMicros += site->nHoldMicros;
+            total.nMaxHoldMicros = std::max(total.nMaxHoldMicros, site->nMaxHoldMicros);
+        }
+        std::sort(sites.begin(), sites.end(), [](const LockSiteStats* a, const LockSiteStats* b) {
+            return a->nWaitMicros + a->nHoldMicros > b->nWaitMicros + b->nHoldMicros;
+        });
+        vLocks.emplace_back(total, std::move(sites));
+    }
+    std::sort(vLocks.begin(), vLocks.end(), [](const auto& a, const auto& b) {
+        return a.first.nWaitMicros > b.first.nWaitMicros;
+    });
+
+    UniValue locks(UniValue::VARR);
+    for (const auto& [total, sites] : vLocks) {
+        UniValue lock(UniValue::VOBJ);
+        lock.pushKV("name", total.name);
+        statsToJSON(lock, total);
+        UniValue arrSites(UniValue::VARR);
+        for (size_t i = 0; i < sites.size() && i < (size_t)nSites; i++) {
+            UniValue site(UniValue::VOBJ);
+            site.pushKV("site", strprintf("%s:%d", sites[i]->file, sites[i]->line));
+            statsToJSON(site, *sites[i]);
+            arrSites.push_back(site);
+        }
+        lock.pushKV("sites", arrSites);
+        locks.push_back(lock);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("interval", (uint64_t)g_lockstats_interval.load());
+    obj.pushKV("locks", locks);
     return obj;
 }
 
+UniValue getvalidationqueueinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getvalidationqueueinfo\n"
+            "Returns statistics of the validation notifications that are run after a block is\n"
+            "connected rather than while it is, grouped by subscriber. Times are in microseconds.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"subscriber\": \"name\",   (string) The subscriber the notifications are for\n"
+            "    \"queued\": n,             (numeric) Notifications queued\n"
+            "    \"run\": n,                (numeric) Notifications run\n"
+            "    \"backlog\": n,            (numeric) Notifications waiting to be run\n"
+            "    \"max_backlog\": n,        (numeric) Most notifications that have been waiting at once\n"
+            "    \"run_total\": n,          (numeric) Total time spent running the notifications\n"
+            "    \"delay_max\": n           (numeric) Longest a notification waited to be run\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const ValidationCallbackStats& stats : GetValidationCallbackStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("subscriber", stats.strSubscriber);
+        obj.pushKV("queued", stats.nQueued);
+        obj.pushKV("run", stats.nRun);
+        obj.pushKV("backlog", (uint64_t)stats.nBacklog);
+        obj.pushKV("max_backlog", (uint64_t)stats.nMaxBacklog);
+        obj.pushKV("run_total", stats.nRunMicros);
+        obj.pushKV("delay_max", stats.nMaxDelayMicros);
+        result.push_back(obj);
+    }
+    return result;
+}
+
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode, streamActor, okParallel
+  //  --------------------- ------------------------  -----------------------  -------------------------------------
     { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true  },
+    { "control",            "getmemoryusage",         &getmemoryusage,         true  },
+    { "control",            "getlockstats",           &getlockstats,           true  },
+    { "control",            "getvalidationqueueinfo", &getvalidationqueueinfo, true  },
     { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
     { "util",               "z_validateaddress",      &z_validateaddress,      true  }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true  },
@@ -1255,12 +1610,12 @@ static const CRPCCommand commands[] =
 
     // START insightexplorer
     /* Address index */
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false }, /* insight explorer */
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false }, /* insight explorer */
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false }, /* insight explorer */
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false }, /* insight explorer */
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, nullptr, true }, /* insight explorer */
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false, nullptr, true }, /* insight explorer */
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, nullptr, true }, /* insight explorer */
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false, nullptr, true }, /* insight explorer */
     { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  }, /* insight explorer */
-    { "blockchain",         "getspentinfo",           &getspentinfo,           false }, /* insight explorer */
+    { "blockchain",         "getspentinfo",           &getspentinfo,           false, nullptr, true }, /* insight explorer */
     // END insightexplorer
 
     /* Not shown in help */
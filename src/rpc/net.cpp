@@ -100,6 +100,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"version\": v,              (numeric) The peer version, such as 170002\n"
             "    \"subver\": \"/MagicBean:x.y.z[-v]/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
+            "    \"transport_protocol_type\": \"v1\"|\"v2\", (string) The transport the connection uses\n"
+            "    \"session_id\": \"hex\",       (string) The BIP 324 session ID, or empty for v1\n"
             "    \"startingheight\": n,       (numeric) The starting height (block) of the peer\n"
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
@@ -107,7 +109,27 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"download_window\": n,      (numeric) The number of blocks we keep in flight from this peer\n"
+            "    \"download_latency\": n,     (numeric) The time in seconds a block from this peer takes to arrive when nothing else is queued\n"
+            "    \"download_blocktime\": n,   (numeric) The time in seconds between blocks from this peer while more are queued\n"
+            "    \"download_bytespersec\": n, (numeric) The rate at which this peer sends us block data\n"
+            "    \"download_reassigned\": n,  (numeric) The number of blocks asked from other peers because this one was too slow\n"
+            "    \"txreconciliation\": true|false, (boolean) Whether we announce transactions to this peer by set reconciliation\n"
+            "    \"tx_inflight\": n,          (numeric) The number of transactions we have asked this peer for and are waiting for\n"
+            "    \"tx_announced\": n,         (numeric) The number of transactions this peer announced that we are still tracking\n"
+            "    \"resources\": {            (json object) The work this peer has cost us\n"
+            "      \"cputime\": n,           (numeric) The CPU time in seconds spent processing its messages\n"
+            "      \"cputime_per_msg\": {    (json object) The CPU time in seconds spent per message type\n"
+            "        \"msg\": n,\n"
+            "        ...\n"
+            "      },\n"
+            "      \"verifytime\": n,        (numeric) The CPU time in seconds other threads spent verifying its headers and transactions\n"
+            "      \"headers_verified\": n,  (numeric) The number of its headers whose proof of work was verified by other threads\n"
+            "      \"proofs_verified\": n,   (numeric) The number of its transactions whose shielded proofs were batch-verified\n"
+            "      \"diskread_bytes\": n,    (numeric) The block data read from disk to answer it\n"
+            "      \"turns_skipped\": n      (numeric) The number of times its messages waited for having used up its share of our time\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -148,6 +170,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         // their ver message.
         obj.pushKV("subver", stats.cleanSubVer);
         obj.pushKV("inbound", stats.fInbound);
+        obj.pushKV("transport_protocol_type", stats.transportType);
+        obj.pushKV("session_id", stats.sessionId);
         obj.pushKV("startingheight", stats.nStartingHeight);
         if (fStateStats) {
             obj.pushKV("banscore", statestats.nMisbehavior);
@@ -158,9 +182,32 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("download_window", statestats.nBlockDownloadWindow);
+            obj.pushKV("download_latency", statestats.nBlockLatency * 0.000001);
+            obj.pushKV("download_blocktime", statestats.nBlockTime * 0.000001);
+            obj.pushKV("download_bytespersec", statestats.dBlockBytesPerSecond);
+            obj.pushKV("download_reassigned", statestats.nBlocksReassigned);
+            obj.pushKV("txreconciliation", statestats.fTxReconciliation);
+            obj.pushKV("tx_inflight", (uint64_t)statestats.nTxInFlight);
+            obj.pushKV("tx_announced", (uint64_t)statestats.nTxAnnounced);
         }
         obj.pushKV("addr_processed", stats.m_addr_processed);
         obj.pushKV("addr_rate_limited", stats.m_addr_rate_limited);
+        UniValue resources(UniValue::VOBJ);
+        int64_t nCpuTime = 0;
+        UniValue cpuTimePerMsg(UniValue::VOBJ);
+        for (const auto& entry : stats.resources.mapCpuTimePerMsgCmd) {
+            nCpuTime += entry.second;
+            cpuTimePerMsg.pushKV(entry.first, entry.second * 0.000001);
+        }
+        resources.pushKV("cputime", nCpuTime * 0.000001);
+        resources.pushKV("cputime_per_msg", cpuTimePerMsg);
+        resources.pushKV("verifytime", stats.resources.nVerifyTime * 0.000001);
+        resources.pushKV("headers_verified", stats.resources.nHeadersVerified);
+        resources.pushKV("proofs_verified", stats.resources.nProofsVerified);
+        resources.pushKV("diskread_bytes", stats.resources.nDiskReadBytes);
+        resources.pushKV("turns_skipped", stats.resources.nTurnsSkipped);
+        obj.pushKV("resources", resources);
         obj.pushKV("whitelisted", stats.fWhitelisted);
 
         ret.push_back(obj);
@@ -406,6 +453,43 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getnetworkstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getnetworkstats\n"
+            "\nReturns counts of the buffers allocated to receive messages from peers.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"recvbuffers\":\n"
+            "  {\n"
+            "    \"allocated\": n,     (numeric) Buffers allocated because none of the size needed was pooled\n"
+            "    \"reused\": n,        (numeric) Buffers reused from a peer's pool\n"
+            "    \"discarded\": n,     (numeric) Buffers freed because the peer's pool was full\n"
+            "    \"unpooled\": n,      (numeric) Messages too large to be received into a pooled buffer\n"
+            "    \"pooled\": n,        (numeric) Buffers currently pooled for reuse\n"
+            "    \"pooledbytes\": n    (numeric) Capacity of the buffers currently pooled, in bytes\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnetworkstats", "")
+            + HelpExampleRpc("getnetworkstats", "")
+       );
+
+    RecvBufferPoolStats stats = GetRecvBufferPoolStats();
+    UniValue recvBuffers(UniValue::VOBJ);
+    recvBuffers.pushKV("allocated", stats.nAllocated);
+    recvBuffers.pushKV("reused", stats.nReused);
+    recvBuffers.pushKV("discarded", stats.nDiscarded);
+    recvBuffers.pushKV("unpooled", stats.nUnpooled);
+    recvBuffers.pushKV("pooled", stats.nPooled);
+    recvBuffers.pushKV("pooledbytes", stats.nPooledBytes);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("recvbuffers", recvBuffers);
+    return obj;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -680,6 +764,7 @@ static const CRPCCommand commands[] =
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true  },
     { "network",            "getnettotals",           &getnettotals,           true  },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
+    { "network",            "getnetworkstats",        &getnetworkstats,        true  },
     { "network",            "setban",                 &setban,                 true  },
     { "network",            "listbanned",             &listbanned,             true  },
     { "network",            "clearbanned",            &clearbanned,            true  },
@@ -13,6 +13,7 @@
 #include "util/time.h"
 #include "version.h"
 
+#include <assert.h>
 #include <stdint.h>
 #include <fstream>
 
@@ -62,6 +63,96 @@ UniValue JSONRPCError(int code, const string& message)
     return error;
 }
 
+JSONStreamWriter::JSONStreamWriter(Sink sinkIn, size_t chunkSizeIn) :
+    sink(std::move(sinkIn)), chunkSize(chunkSizeIn), fAfterKey(false), fFlushed(false)
+{
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+    } else if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            buffer += ',';
+        vEmpty.back() = false;
+    }
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (buffer.size() >= chunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    buffer += '{';
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    buffer += '}';
+    vEmpty.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    buffer += '[';
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    buffer += ']';
+    vEmpty.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    Separate();
+    buffer += UniValue(key).write();
+    buffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separate();
+    buffer += value.write();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Raw(const std::string& json)
+{
+    Separate();
+    if (json.size() >= chunkSize) {
+        // Hand large values over as they are instead of copying them in
+        Flush();
+        sink(json);
+        fFlushed = true;
+        return;
+    }
+    buffer += json;
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (buffer.empty())
+        return;
+    sink(buffer);
+    buffer.clear();
+    fFlushed = true;
+}
+
 /** Username used when cookie authentication is in use (arbitrary, only for
  * recognizability in debugging/logging purposes)
  */
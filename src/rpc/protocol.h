@@ -9,10 +9,12 @@
 
 #include "fs.h"
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <univalue.h>
 
@@ -84,6 +86,51 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+/**
+ * Writes JSON as it is produced rather than building the whole value first,
+ * handing the text to a sink whenever about chunkSize bytes have built up.
+ * The text is what UniValue::write() gives for the same value.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit JSONStreamWriter(Sink sinkIn, size_t chunkSizeIn = DEFAULT_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Start a member of the current object; its value is written next. */
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    /** Write a value that is already serialized JSON, as kept by callers
+     * that answer repeatedly with the same result. */
+    void Raw(const std::string& json);
+
+    /** Hand everything written so far to the sink. */
+    void Flush();
+    /** Whether the sink has been given anything yet. */
+    bool HasFlushed() const { return fFlushed; }
+    /** What has been written but not yet handed to the sink. */
+    const std::string& GetBuffer() const { return buffer; }
+
+private:
+    Sink sink;
+    size_t chunkSize;
+    std::string buffer;
+    //! For each open object or array, whether nothing is in it yet.
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+    bool fFlushed;
+
+    void Separate();
+    void MaybeFlush();
+};
+
 /** Generate a new RPC authentication cookie and write it to disk */
 bool GenerateAuthCookie(std::string *cookie_out);
 /** Read the RPC authentication cookie from disk */
@@ -10,6 +10,7 @@
 #include "core_io.h"
 #include "init.h"
 #include "deprecation.h"
+#include "index/insightindex.h"
 #include "key_io.h"
 #include "keystore.h"
 #include "main.h"
@@ -22,11 +23,13 @@
 #include "script/script_error.h"
 #include "script/sign.h"
 #include "script/standard.h"
+#include "shieldedbatch.h"
 #include "uint256.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #endif
 
+#include <future>
 #include <stdint.h>
 #include <variant>
 
@@ -215,7 +218,7 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
     const uint256 txid = tx.GetHash();
     entry.pushKV("txid", txid.GetHex());
     entry.pushKV("authdigest", tx.GetAuthDigest().GetHex());
-    entry.pushKV("size", (int)::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    entry.pushKV("size", (int)tx.GetTotalSize());
     entry.pushKV("overwintered", tx.fOverwintered);
     entry.pushKV("version", tx.nVersion);
     if (tx.fOverwintered) {
@@ -506,6 +509,12 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
             + HelpExampleCli("getrawtransaction", "\"mytxid\" 1 \"myblockhash\"")
         );
 
+    // Let the spent index catch up with the tip. While it is still being
+    // built, outputs it has not reached yet show no spent fields.
+    if (g_insight_index) {
+        g_insight_index->BlockUntilSyncedToCurrentChain();
+    }
+
     LOCK(cs_main);
 
     bool in_active_chain = true;
@@ -1237,6 +1246,62 @@ UniValue signrawtransaction(const UniValue& params, bool fHelp)
     return result;
 }
 
+/**
+ * Add a decoded transaction to the mempool and relay it, for
+ * sendrawtransaction(s). Throws the JSONRPCError to report if it is
+ * rejected. pprecheck is passed on to AcceptToMemoryPool; pstatePrecheck,
+ * if given, is the state of a failed PrecheckTransactionForMempool.
+ */
+static void SubmitRawTransaction(const CChainParams& chainparams, const CTransaction& tx, bool fOverrideFees,
+                                 const MempoolPrecheck* pprecheck = nullptr,
+                                 const CValidationState* pstatePrecheck = nullptr)
+{
+    AssertLockHeld(cs_main);
+    uint256 hashTx = tx.GetHash();
+
+    // DoS mitigation: reject transactions expiring soon
+    if (tx.nExpiryHeight > 0) {
+        int nextBlockHeight = chainActive.Height() + 1;
+        if (chainparams.GetConsensus().NetworkUpgradeActive(nextBlockHeight, Consensus::UPGRADE_OVERWINTER)) {
+            if (nextBlockHeight + TX_EXPIRING_SOON_THRESHOLD > tx.nExpiryHeight) {
+                throw JSONRPCError(RPC_TRANSACTION_REJECTED,
+                    strprintf("tx-expiring-soon: expiryheight is %d but should be at least %d to avoid transaction expiring soon",
+                    tx.nExpiryHeight,
+                    nextBlockHeight + TX_EXPIRING_SOON_THRESHOLD));
+            }
+        }
+    }
+
+    CCoinsViewCache &view = *pcoinsTip;
+    const CCoins* existingCoins = view.AccessCoins(hashTx);
+    bool fHaveMempool = mempool.exists(hashTx);
+    bool fHaveChain = existingCoins && existingCoins->nHeight < 1000000000;
+    if (!fHaveMempool && !fHaveChain) {
+        // push to local node and sync with wallets
+        CValidationState state;
+        bool fMissingInputs = false;
+        bool fAccepted = false;
+        if (pstatePrecheck) {
+            state = *pstatePrecheck;
+        } else {
+            fAccepted = AcceptToMemoryPool(chainparams, mempool, state, tx, true, &fMissingInputs, !fOverrideFees, pprecheck);
+        }
+        if (!fAccepted) {
+            if (state.IsInvalid()) {
+                throw JSONRPCError(RPC_TRANSACTION_REJECTED, strprintf("%i: %s", state.GetRejectCode(), state.GetRejectReason()));
+            } else {
+                if (fMissingInputs) {
+                    throw JSONRPCError(RPC_TRANSACTION_ERROR, "Missing inputs");
+                }
+                throw JSONRPCError(RPC_TRANSACTION_ERROR, state.GetRejectReason());
+            }
+        }
+    } else if (fHaveChain) {
+        throw JSONRPCError(RPC_TRANSACTION_ALREADY_IN_CHAIN, "transaction already in block chain");
+    }
+    RelayTransaction(tx);
+}
+
 UniValue sendrawtransaction(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -1267,61 +1332,135 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp)
     CTransaction tx;
     if (!DecodeHexTx(tx, params[0].get_str()))
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "TX decode failed");
-    uint256 hashTx = tx.GetHash();
 
-    auto chainparams = Params();
+    bool fOverrideFees = false;
+    if (params.size() > 1)
+        fOverrideFees = params[1].get_bool();
 
-    // DoS mitigation: reject transactions expiring soon
-    if (tx.nExpiryHeight > 0) {
-        int nextBlockHeight = chainActive.Height() + 1;
-        if (chainparams.GetConsensus().NetworkUpgradeActive(nextBlockHeight, Consensus::UPGRADE_OVERWINTER)) {
-            if (nextBlockHeight + TX_EXPIRING_SOON_THRESHOLD > tx.nExpiryHeight) {
-                throw JSONRPCError(RPC_TRANSACTION_REJECTED,
-                    strprintf("tx-expiring-soon: expiryheight is %d but should be at least %d to avoid transaction expiring soon",
-                    tx.nExpiryHeight,
-                    nextBlockHeight + TX_EXPIRING_SOON_THRESHOLD));
-            }
-        }
-    }
+    SubmitRawTransaction(Params(), tx, fOverrideFees);
+
+    return tx.GetHash().GetHex();
+}
+
+UniValue sendrawtransactions(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "sendrawtransactions [\"hexstring\",...] ( allowhighfees )\n"
+            "\nSubmits several raw transactions (serialized, hex-encoded) to local node and network.\n"
+            "Each is handled as by sendrawtransaction, in the order given, so a transaction may spend\n"
+            "the outputs of one before it. Their Sapling and Orchard proofs are verified as one batch,\n"
+            "which is much faster than submitting them one at a time.\n"
+            "\nArguments:\n"
+            "1. [\"hexstring\",...] (array, required) The hex strings of the raw transactions\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (array) One entry for each transaction, in the order given\n"
+            "  {\n"
+            "    \"txid\" : \"hex\",    (string) The transaction hash, if the transaction could be decoded\n"
+            "    \"error\" : {        (object) Only if the transaction was rejected\n"
+            "      \"code\" : n,      (numeric) The error code sendrawtransaction would have returned\n"
+            "      \"message\" : \"text\" (string) The error message\n"
+            "    }\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendrawtransactions", "\"[\\\"signedhex1\\\",\\\"signedhex2\\\"]\"")
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex1\",\"signedhex2\"]")
+        );
 
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VARR)(UniValue::VBOOL));
+    const UniValue& hexTxs = params[0].get_array();
     bool fOverrideFees = false;
     if (params.size() > 1)
         fOverrideFees = params[1].get_bool();
 
-    CCoinsViewCache &view = *pcoinsTip;
-    const CCoins* existingCoins = view.AccessCoins(hashTx);
-    bool fHaveMempool = mempool.exists(hashTx);
-    bool fHaveChain = existingCoins && existingCoins->nHeight < 1000000000;
-    if (!fHaveMempool && !fHaveChain) {
-        // push to local node and sync with wallets
-        CValidationState state;
-        bool fMissingInputs;
-        if (!AcceptToMemoryPool(chainparams, mempool, state, tx, true, &fMissingInputs, !fOverrideFees)) {
-            if (state.IsInvalid()) {
-                throw JSONRPCError(RPC_TRANSACTION_REJECTED, strprintf("%i: %s", state.GetRejectCode(), state.GetRejectReason()));
-            } else {
-                if (fMissingInputs) {
-                    throw JSONRPCError(RPC_TRANSACTION_ERROR, "Missing inputs");
-                }
-                throw JSONRPCError(RPC_TRANSACTION_ERROR, state.GetRejectReason());
+    const CChainParams& chainparams = Params();
+    int nextBlockHeight;
+    {
+        LOCK(cs_main);
+        nextBlockHeight = chainActive.Height() + 1;
+    }
+
+    // Decode the transactions and run the checks that need no locks on
+    // several threads, leaving out their Sapling and Orchard authorization.
+    size_t nTxs = hexTxs.size();
+    std::vector<CTransaction> vtx(nTxs);
+    std::vector<char> vDecoded(nTxs), vPrechecked(nTxs);
+    std::vector<CValidationState> vState(nTxs);
+    std::vector<MempoolPrecheck> vPrecheck(nTxs);
+    std::vector<std::shared_ptr<CShieldedAuthCheck>> vAuthCheck(nTxs);
+    auto precheckRange = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            vDecoded[i] = hexTxs[i].isStr() && DecodeHexTx(vtx[i], hexTxs[i].get_str());
+            if (vDecoded[i]) {
+                vPrechecked[i] = PrecheckTransactionForMempool(
+                    chainparams, vtx[i], nextBlockHeight, vState[i], vPrecheck[i], &vAuthCheck[i]);
             }
         }
-    } else if (fHaveChain) {
-        throw JSONRPCError(RPC_TRANSACTION_ALREADY_IN_CHAIN, "transaction already in block chain");
+    };
+    size_t nWorkers = std::min<size_t>(std::max(nScriptCheckThreads, 1), std::max<size_t>(nTxs, 1));
+    std::vector<std::future<void>> vWorkers;
+    for (size_t i = 1; i < nWorkers; i++) {
+        vWorkers.push_back(std::async(std::launch::async, precheckRange,
+            i * nTxs / nWorkers, (i + 1) * nTxs / nWorkers));
+    }
+    precheckRange(0, nTxs / nWorkers);
+    for (auto& worker : vWorkers) {
+        worker.get();
     }
-    RelayTransaction(tx);
 
-    return hashTx.GetHex();
+    // Verify the authorization of all of them as one batch, which falls back
+    // to checking each transaction on its own if it fails.
+    std::vector<std::shared_ptr<CShieldedAuthCheck>> vBatch;
+    for (size_t i = 0; i < nTxs; i++) {
+        if (vPrechecked[i] && vAuthCheck[i])
+            vBatch.push_back(vAuthCheck[i]);
+    }
+    if (!vBatch.empty())
+        CShieldedBatchVerifier::VerifyBatch(vBatch);
+    for (size_t i = 0; i < nTxs; i++) {
+        if (!vPrechecked[i] || !vAuthCheck[i])
+            continue;
+        if (vAuthCheck[i]->IsValid()) {
+            vPrecheck[i].consensusBranchId = vAuthCheck[i]->consensusBranchId;
+        } else {
+            vPrechecked[i] = false;
+            vState[i] = vAuthCheck[i]->GetState();
+        }
+    }
+
+    UniValue results(UniValue::VARR);
+    LOCK(cs_main);
+    for (size_t i = 0; i < nTxs; i++) {
+        UniValue entry(UniValue::VOBJ);
+        if (!vDecoded[i]) {
+            entry.pushKV("error", JSONRPCError(RPC_DESERIALIZATION_ERROR, "TX decode failed"));
+        } else {
+            entry.pushKV("txid", vtx[i].GetHash().GetHex());
+            try {
+                SubmitRawTransaction(chainparams, vtx[i], fOverrideFees,
+                                     vPrechecked[i] ? &vPrecheck[i] : nullptr,
+                                     vPrechecked[i] ? nullptr : &vState[i]);
+            } catch (const UniValue& objError) {
+                entry.pushKV("error", objError);
+            }
+        }
+        results.push_back(entry);
+    }
+    return results;
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
+{ //  category              name                      actor (function)         okSafeMode, streamActor, okParallel
+  //  --------------------- ------------------------  -----------------------  -------------------------------------
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,  nullptr, true },
     { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  nullptr, true },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,  nullptr, true },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
+    { "rawtransactions",    "sendrawtransactions",    &sendrawtransactions,    false },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
 
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
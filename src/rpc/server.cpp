@@ -18,7 +18,10 @@
 #include "util/strencodings.h"
 #include "asyncrpcqueue.h"
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <thread>
 
 #include <univalue.h>
 
@@ -42,6 +45,17 @@ static std::string rpcWarmupStatus("RPC server started");
 static CCriticalSection cs_rpcWarmup;
 /* Timer-creating functions */
 static std::vector<RPCTimerInterface*> timerInterfaces;
+/* Pool that parallel-safe batch calls are spread over, if any */
+static std::atomic<RPCWorkerPool*> rpcWorkerPool{nullptr};
+
+/** Steps of asynchronous calls waiting for a blocking thread. Beyond this,
+ * steps run on the thread that awaits them. */
+static const size_t MAX_BLOCKING_QUEUE = 256;
+static Mutex cs_blocking;
+static std::condition_variable condBlocking;
+static std::deque<std::function<void()>> blockingQueue GUARDED_BY(cs_blocking);
+static bool fBlockingRunning GUARDED_BY(cs_blocking) = false;
+static std::vector<std::thread> blockingThreads;
 /* Map of name to timer.
  * @note Can be changed to std::unique_ptr when C++11 */
 static std::map<std::string, boost::shared_ptr<RPCTimerBase> > deadlineTimers;
@@ -338,26 +352,97 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+static void ThreadRPCBlocking()
+{
+    RenameThread("zc-rpcblocking");
+    while (true)
+    {
+        std::function<void()> step;
+        {
+            WAIT_LOCK(cs_blocking, lock);
+            while (fBlockingRunning && blockingQueue.empty())
+                condBlocking.wait(lock);
+            // Steps still queued at shutdown are run, so that every call finishes
+            if (blockingQueue.empty())
+                return;
+            step = std::move(blockingQueue.front());
+            blockingQueue.pop_front();
+        }
+        step();
+    }
+}
+
+bool RPCAsyncCall::Run(const std::function<void()>& step)
+{
+    try {
+        step();
+        return true;
+    } catch (const UniValue& objError) {
+        Fail(objError);
+    } catch (const std::exception& e) {
+        Fail(JSONRPCError(RPC_MISC_ERROR, e.what()));
+    }
+    return false;
+}
+
+void RPCAsyncCall::Await(std::function<void()> blocking, std::function<void()> resume)
+{
+    std::shared_ptr<RPCAsyncCall> self = shared_from_this();
+    auto step = [self, blocking, resume] {
+        if (!self->Run(blocking))
+            return;
+        RPCWorkerPool* pool = rpcWorkerPool;
+        auto next = [self, resume] { self->Run(resume); };
+        if (!pool || !pool->Post(next))
+            next();
+    };
+
+    {
+        LOCK(cs_blocking);
+        if (fBlockingRunning && blockingQueue.size() < MAX_BLOCKING_QUEUE) {
+            blockingQueue.push_back(std::move(step));
+            condBlocking.notify_one();
+            return;
+        }
+    }
+    step();
+}
+
+void RPCAsyncCall::Finish(const UniValue& result)
+{
+    Finish([result](JSONStreamWriter& out) { out.Value(result); });
+}
+
+void RPCAsyncCall::Finish(RPCResultWriter writeResult)
+{
+    if (!fDone.exchange(true))
+        done(writeResult);
+}
+
+void RPCAsyncCall::Fail(const UniValue& error)
+{
+    Finish([error](JSONStreamWriter&) { throw error; });
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
     fRPCRunning = true;
     g_rpcSignals.Started();
 
-    // Launch one async rpc worker.  The ability to launch multiple workers is not recommended at present and thus the option is disabled.
-    getAsyncRPCQueue()->addWorker();
-/*
-    int n = GetArg("-rpcasyncthreads", 1);
-    if (n<1) {
-        LogPrintf("ERROR: Invalid value %d for -rpcasyncthreads.  Must be at least 1.\n", n);
-        strerr = strprintf(_("An error occurred while setting up the Async RPC threads, invalid parameter value of %d (must be at least 1)."), n);
-        uiInterface.ThreadSafeMessageBox(strerr, "", CClientUIInterface::MSG_ERROR);
-        StartShutdown();
-        return;
+    int nBlockingThreads = std::max((int)GetArg("-rpcblockingthreads", DEFAULT_RPC_BLOCKING_THREADS), 1);
+    {
+        LOCK(cs_blocking);
+        fBlockingRunning = true;
     }
-    for (int i = 0; i < n; i++)
+    for (int i = 0; i < nBlockingThreads; i++)
+        blockingThreads.emplace_back(&ThreadRPCBlocking);
+
+    // Operations lock the inputs they select, so several can run at once;
+    // their proofs share the proving thread pool.
+    int nAsyncThreads = std::min(std::max((int)GetArg("-rpcasyncthreads", DEFAULT_RPC_ASYNC_THREADS), 1), MAX_RPC_ASYNC_THREADS);
+    for (int i = 0; i < nAsyncThreads; i++)
         getAsyncRPCQueue()->addWorker();
-*/
     return true;
 }
 
@@ -377,6 +462,15 @@ void StopRPC()
     // Tells async queue to cancel all operations and shutdown.
     LogPrintf("%s: waiting for async rpc workers to stop\n", __func__);
     getAsyncRPCQueue()->closeAndWait();
+
+    {
+        LOCK(cs_blocking);
+        fBlockingRunning = false;
+        condBlocking.notify_all();
+    }
+    for (std::thread& thread : blockingThreads)
+        thread.join();
+    blockingThreads.clear();
 }
 
 bool IsRPCRunning()
@@ -434,6 +528,126 @@ void JSONRequest::parse(const UniValue& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array");
 }
 
+static size_t SkipJSONSpace(const std::string& str, size_t i)
+{
+    while (i < str.size() && (str[i] == ' ' || str[i] == '\t' || str[i] == '\n' || str[i] == '\r'))
+        i++;
+    return i;
+}
+
+/**
+ * Find the end of the JSON value that starts at i, without checking or
+ * decoding it. Returns std::string::npos if it does not end.
+ */
+static size_t SkipJSONValue(const std::string& str, size_t i)
+{
+    int nDepth = 0;
+    bool fString = false;
+    for (; i < str.size(); i++) {
+        char c = str[i];
+        if (fString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                fString = false;
+                if (nDepth == 0)
+                    return i + 1;
+            }
+        } else if (c == '"') {
+            fString = true;
+        } else if (c == '[' || c == '{') {
+            nDepth++;
+        } else if (c == ']' || c == '}') {
+            if (nDepth == 0)
+                return i;
+            if (--nDepth == 0)
+                return i + 1;
+        } else if (nDepth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+            return i;
+        }
+    }
+    return (fString || nDepth > 0) ? std::string::npos : i;
+}
+
+bool JSONRequest::parseFast(const std::string& strRequest)
+{
+    // Members other than id, method and params are skipped unread. The
+    // first of any repeated member counts, as with find_value.
+    size_t idBegin = 0, idEnd = 0, methodBegin = 0, methodEnd = 0, paramsBegin = 0, paramsEnd = 0;
+    size_t i = SkipJSONSpace(strRequest, 0);
+    if (i == strRequest.size() || strRequest[i] != '{')
+        return false;
+    i = SkipJSONSpace(strRequest, i + 1);
+    while (true) {
+        if (i == strRequest.size() || strRequest[i] != '"')
+            return false;
+        size_t keyEnd = strRequest.find('"', i + 1);
+        if (keyEnd == std::string::npos)
+            return false;
+        std::string key = strRequest.substr(i + 1, keyEnd - i - 1);
+        if (key.find('\\') != std::string::npos)
+            return false;
+        i = SkipJSONSpace(strRequest, keyEnd + 1);
+        if (i == strRequest.size() || strRequest[i] != ':')
+            return false;
+        size_t valueBegin = SkipJSONSpace(strRequest, i + 1);
+        size_t valueEnd = SkipJSONValue(strRequest, valueBegin);
+        if (valueEnd == std::string::npos || valueEnd == valueBegin)
+            return false;
+        if (key == "id" && idEnd == 0) {
+            idBegin = valueBegin;
+            idEnd = valueEnd;
+        } else if (key == "method" && methodEnd == 0) {
+            methodBegin = valueBegin;
+            methodEnd = valueEnd;
+        } else if (key == "params" && paramsEnd == 0) {
+            paramsBegin = valueBegin;
+            paramsEnd = valueEnd;
+        }
+        i = SkipJSONSpace(strRequest, valueEnd);
+        if (i == strRequest.size())
+            return false;
+        if (strRequest[i] == '}')
+            break;
+        if (strRequest[i] != ',')
+            return false;
+        i = SkipJSONSpace(strRequest, i + 1);
+    }
+    if (SkipJSONSpace(strRequest, i + 1) != strRequest.size())
+        return false;
+
+    // Method names need no unescaping
+    if (methodEnd - methodBegin < 2 || strRequest[methodBegin] != '"' || strRequest[methodEnd - 1] != '"')
+        return false;
+    std::string strMethodIn = strRequest.substr(methodBegin + 1, methodEnd - methodBegin - 2);
+    if (strMethodIn.find('\\') != std::string::npos)
+        return false;
+
+    UniValue valId;
+    if (idEnd != 0 && !valId.read(strRequest.substr(idBegin, idEnd - idBegin)))
+        return false;
+
+    UniValue valParams(UniValue::VARR);
+    if (paramsEnd != 0) {
+        if (strRequest[paramsBegin] == '[' && strRequest[paramsEnd - 1] == ']' &&
+            SkipJSONSpace(strRequest, paramsBegin + 1) == paramsEnd - 1) {
+            // Calls without arguments are the common case
+        } else if (!valParams.read(strRequest.substr(paramsBegin, paramsEnd - paramsBegin))) {
+            return false;
+        } else if (valParams.isNull()) {
+            valParams = UniValue(UniValue::VARR);
+        } else if (!valParams.isArray()) {
+            return false;
+        }
+    }
+
+    id = valId;
+    strMethod = strMethodIn;
+    params = valParams;
+    LogPrint("rpc", "ThreadRPCServer method=%s\n", SanitizeString(strMethod));
+    return true;
+}
+
 static UniValue JSONRPCExecOne(const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ);
@@ -458,16 +672,114 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsParallelCall(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->okParallel;
+}
+
+/**
+ * Executes the calls [begin, end) of a batch, each exactly once, on however
+ * many threads call Work(). Threads that join late, after every call has been
+ * claimed, return at once without touching the batch.
+ */
+class RPCBatchRun
+{
+private:
+    const UniValue& vReq;
+    std::vector<UniValue>& results;
+    std::atomic<size_t> next;
+    const size_t begin;
+    const size_t end;
+
+    Mutex cs;
+    std::condition_variable cond;
+    size_t nDone GUARDED_BY(cs);
+
+public:
+    RPCBatchRun(const UniValue& vReq, std::vector<UniValue>& results, size_t begin, size_t end) :
+        vReq(vReq), results(results), next(begin), begin(begin), end(end), nDone(0) {}
+
+    void Work()
+    {
+        size_t n = 0;
+        for (size_t i; (i = next++) < end; n++) {
+            results[i] = JSONRPCExecOne(vReq[i]);
+        }
+        if (n > 0) {
+            LOCK(cs);
+            nDone += n;
+            if (nDone == end - begin)
+                cond.notify_all();
+        }
+    }
+
+    /** Wait for calls claimed by other threads to finish. */
+    void Wait()
+    {
+        WAIT_LOCK(cs, lock);
+        while (nDone < end - begin)
+            cond.wait(lock);
+    }
+};
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    // Consecutive parallel-safe calls are spread over the worker pool, with
+    // this thread taking its share. Any other call runs on its own, after
+    // everything before it and before anything after it, as it did when the
+    // whole batch was executed in order.
+    std::vector<UniValue> results(vReq.size());
+    RPCWorkerPool* pool = rpcWorkerPool;
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t runEnd = reqIdx;
+        while (runEnd < vReq.size() && IsParallelCall(vReq[runEnd]))
+            runEnd++;
+        if (pool && runEnd - reqIdx > 1) {
+            auto run = std::make_shared<RPCBatchRun>(vReq, results, reqIdx, runEnd);
+            size_t nHelpers = std::min(runEnd - reqIdx, std::max<size_t>(pool->Size(), 1)) - 1;
+            for (size_t i = 0; i < nHelpers; i++) {
+                if (!pool->Post([run] { run->Work(); }))
+                    break;
+            }
+            run->Work();
+            run->Wait();
+        } else {
+            runEnd = std::max(runEnd, reqIdx + 1);
+            for (size_t i = reqIdx; i < runEnd; i++)
+                results[i] = JSONRPCExecOne(vReq[i]);
+        }
+        reqIdx = runEnd;
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(results);
     return ret.write() + "\n";
 }
 
 UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
+{
+    return execute(strMethod, params, nullptr);
+}
+
+void CRPCTable::execute(const std::string &strMethod, const UniValue &params, JSONStreamWriter& out) const
+{
+    execute(strMethod, params, &out);
+}
+
+void CRPCTable::execute(const std::string &strMethod, const UniValue &params, std::shared_ptr<RPCAsyncCall> call) const
+{
+    call->Run([&] { execute(strMethod, params, nullptr, call); });
+}
+
+UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params, JSONStreamWriter* out,
+                            const std::shared_ptr<RPCAsyncCall>& call) const
 {
     // Return immediately if in warmup
     {
@@ -511,6 +823,18 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
                             : strprintf("at least %u and at most %u", numRequired, numRequired + numOptional),
                             params.size(),
                             helpMsg));
+            } else if (call && pcmd->asyncActor) {
+                pcmd->asyncActor(params, call);
+                return NullUniValue;
+            } else if (call) {
+                call->Finish(pcmd->actor(params, false));
+                return NullUniValue;
+            } else if (out && pcmd->streamActor) {
+                pcmd->streamActor(params, *out);
+                return NullUniValue;
+            } else if (out) {
+                out->Value(pcmd->actor(params, false));
+                return NullUniValue;
             } else {
                 return pcmd->actor(params, false);
             }
@@ -640,6 +964,18 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface)
     timerInterfaces.erase(i);
 }
 
+void RPCRegisterWorkerPool(RPCWorkerPool *pool)
+{
+    rpcWorkerPool = pool;
+}
+
+void RPCUnregisterWorkerPool(RPCWorkerPool *pool)
+{
+    RPCWorkerPool* expected = pool;
+    bool fRegistered = rpcWorkerPool.compare_exchange_strong(expected, nullptr);
+    assert(fRegistered);
+}
+
 void RPCRunLater(const std::string& name, std::function<void(void)> func, int64_t nSeconds)
 {
     if (timerInterfaces.empty())
@@ -12,6 +12,8 @@
 #include "uint256.h"
 #include "zcash/memo.h"
 
+#include <atomic>
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -43,6 +45,13 @@ public:
 
     JSONRequest() { id = NullUniValue; }
     void parse(const UniValue& valRequest);
+    /**
+     * Read a single request straight from its text, parsing only its id
+     * and params rather than a tree of the whole request. Returns false,
+     * with nothing read, for anything but a plain request object; parse
+     * the body in full then, which also reports what is wrong with it.
+     */
+    bool parseFast(const std::string& strRequest);
 };
 
 /** Query whether RPC is running */
@@ -111,6 +120,28 @@ void RPCRegisterTimerInterface(RPCTimerInterface *iface);
 /** Unregister factory function for timers */
 void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 
+/**
+ * Threads that the parallel-safe calls of a JSON-RPC batch are spread over.
+ * The HTTP server provides them, as its workers are the ones executing RPC
+ * calls; this keeps rpcserver independent of httpserver.
+ */
+class RPCWorkerPool
+{
+public:
+    virtual ~RPCWorkerPool() {}
+    /** Number of threads executing RPC calls, including the calling one */
+    virtual size_t Size() = 0;
+    /** Queue task for another thread. Returns false if it cannot be queued
+     * right now; the caller then does the work itself.
+     */
+    virtual bool Post(const std::function<void(void)>& task) = 0;
+};
+
+/** Register the pool that batches are executed on */
+void RPCRegisterWorkerPool(RPCWorkerPool *pool);
+/** Unregister the pool; batches are executed serially again */
+void RPCUnregisterWorkerPool(RPCWorkerPool *pool);
+
 /**
  * Run func nSeconds from now.
  * Overrides previous timer <name> (if any).
@@ -118,6 +149,68 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, std::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+/** Writes a call's result as it produces it, for results too large to build whole. */
+typedef void(*rpcstreamfn_type)(const UniValue& params, JSONStreamWriter& out);
+
+/** Threads for the steps of asynchronous calls that wait on locks or disk */
+static const int DEFAULT_RPC_BLOCKING_THREADS = 4;
+
+/** Threads running asynchronous operations such as z_sendmany, each building and proving its own transaction */
+static const int DEFAULT_RPC_ASYNC_THREADS = 1;
+static const int MAX_RPC_ASYNC_THREADS = 16;
+
+/** Writes a call's result, or throws the call's error (UniValue) */
+typedef std::function<void(JSONStreamWriter& out)> RPCResultWriter;
+
+/**
+ * An RPC call that gives up its thread while it waits. A call that reads
+ * blocks from disk or waits for cs_main would otherwise hold an RPC thread
+ * for as long as that takes. Instead it runs in steps: a step that may
+ * block is handed to one of a few threads set aside for such steps, and
+ * the call carries on from there on an RPC thread. Without coroutines in
+ * C++17 the steps are written as continuations, which share state through
+ * what they capture.
+ */
+class RPCAsyncCall : public std::enable_shared_from_this<RPCAsyncCall>
+{
+public:
+    /** Called once, with the call's result or error */
+    typedef std::function<void(const RPCResultWriter& writeResult)> Completion;
+
+    explicit RPCAsyncCall(Completion doneIn) : done(std::move(doneIn)) {}
+
+    /** Run step now, ending the call with its error if it throws. Returns
+     * false if it did. */
+    bool Run(const std::function<void()>& step);
+    /**
+     * Run blocking on a blocking thread, then resume on an RPC thread. If
+     * either throws, the call ends with the error. Where no thread can take
+     * a step, it runs on the current one.
+     */
+    void Await(std::function<void()> blocking, std::function<void()> resume);
+    /** End the call with result. */
+    void Finish(const UniValue& result);
+    /** End the call with a result that is written as it is produced. */
+    void Finish(RPCResultWriter writeResult);
+    /** End the call with an error. */
+    void Fail(const UniValue& error);
+
+private:
+    Completion done;
+    std::atomic<bool> fDone{false};
+};
+
+typedef void(*rpcasyncfn_type)(const UniValue& params, std::shared_ptr<RPCAsyncCall> call);
+
+/** Run actor as a single blocking step, for calls that spend their time
+ * waiting on locks or disk rather than computing. */
+template <rpcfn_type actor>
+void RPCAwaitActor(const UniValue& params, std::shared_ptr<RPCAsyncCall> call)
+{
+    auto result = std::make_shared<UniValue>();
+    call->Await([params, result] { *result = actor(params, false); },
+                [call, result] { call->Finish(*result); });
+}
 
 class CRPCCommand
 {
@@ -126,6 +219,14 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Optional; used in place of actor when the result can be streamed.
+    rpcstreamfn_type streamActor;
+    //! Whether calls may run concurrently with other calls in the same
+    //! batch. Only set for read-only calls that don't depend on each other.
+    bool okParallel = false;
+    //! Optional; used in place of actor by callers that can wait for the
+    //! result without holding a thread.
+    rpcasyncfn_type asyncActor = nullptr;
 };
 
 /**
@@ -149,6 +250,19 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method, writing its result to out rather than returning it.
+     * Methods with a streaming actor write the result as they produce it.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    void execute(const std::string &method, const UniValue &params, JSONStreamWriter& out) const;
+
+    /**
+     * Execute a method, finishing call with its result or error. Methods
+     * with an asynchronous actor may finish it later, from another thread.
+     */
+    void execute(const std::string &method, const UniValue &params, std::shared_ptr<RPCAsyncCall> call) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -162,6 +276,10 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+private:
+    UniValue execute(const std::string &method, const UniValue &params, JSONStreamWriter* out,
+                     const std::shared_ptr<RPCAsyncCall>& call = nullptr) const;
 };
 
 extern CRPCTable tableRPC;
@@ -185,6 +303,7 @@ extern std::string HelpExampleCli(const std::string& methodname, const std::stri
 extern std::string HelpExampleRpc(const std::string& methodname, const std::string& args);
 
 extern void EnsureWalletIsUnlocked();
+extern void SyncInsightIndex();
 
 bool StartRPC();
 void InterruptRPC();
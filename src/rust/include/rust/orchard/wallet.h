@@ -173,6 +173,108 @@ bool orchard_wallet_append_bundle_commitments(
         const OrchardBundlePtr* bundle
         );
 
+/**
+ * A C struct used to pass the parts of an Orchard action that trial decryption
+ * and the note commitment tree need across the FFI boundary: its nullifier,
+ * note commitment, ephemeral key, and the first 52 bytes of its encrypted note.
+ * This must have the same in-memory representation as the `FFICompactAction`
+ * type in orchard_ffi/wallet.rs.
+ */
+struct RawOrchardCompactAction {
+    unsigned char nullifier[32];
+    unsigned char cmx[32];
+    unsigned char ephemeralKey[32];
+    unsigned char encCiphertext[52];
+};
+static_assert(
+    sizeof(RawOrchardCompactAction) == 148,
+    "RawOrchardCompactAction struct should have no padding.");
+
+/**
+ * Add the note commitments of the specified compact actions, which must be all
+ * of a transaction's Orchard actions in order, to the wallet's note commitment
+ * tree. This is equivalent to `orchard_wallet_append_bundle_commitments` for a
+ * transaction whose bundle the caller does not have.
+ *
+ * Returns `false` if the transaction is not in the correct position to have its
+ * note commitments appended to the note commitment tree, or if an action is
+ * not valid.
+ */
+bool orchard_wallet_append_compact_commitments(
+        OrchardWalletPtr* wallet,
+        const uint32_t block_height,
+        const size_t block_tx_idx,
+        const unsigned char txid[32],
+        const RawOrchardCompactAction* actions,
+        size_t actionsLen
+        );
+
+/**
+ * A C struct used to pass one transaction's Orchard actions to
+ * `orchard_wallet_append_blocks`, either as its bundle or, if `bundle` is null,
+ * as its compact actions. This must have the same in-memory representation as
+ * the `FFIBatchTx` type in orchard_ffi/wallet.rs.
+ */
+struct RawOrchardBatchTx {
+    uint32_t blockHeight;
+    size_t blockTxIdx;
+    unsigned char txid[32];
+    const OrchardBundlePtr* bundle;
+    const RawOrchardCompactAction* actions;
+    size_t actionsLen;
+};
+
+/**
+ * Checkpoint the note commitment tree for each of the `block_count` blocks
+ * starting at `first_height` and append the note commitments of their
+ * transactions, which must be given in chain order. This is equivalent to
+ * calling `orchard_wallet_checkpoint` and then appending each transaction's
+ * commitments for every block in turn, except that blocks below
+ * `checkpoint_from_height` other than the last are not given a checkpoint in
+ * the tree; the wallet cannot be rewound to them afterwards.
+ *
+ * Returns `false` if the blocks are not in the correct position to be added to
+ * the note commitment tree, if a transaction is not in one of the blocks, or if
+ * an action is not valid. The tree may have been partially updated in that case.
+ */
+bool orchard_wallet_append_blocks(
+        OrchardWalletPtr* wallet,
+        const uint32_t first_height,
+        const uint32_t block_count,
+        const uint32_t checkpoint_from_height,
+        const RawOrchardBatchTx* txs,
+        size_t txsLen
+        );
+
+/**
+ * A type-safe pointer type for a trial decryptor of compact Orchard actions.
+ */
+struct OrchardCompactDecryptorPtr;
+typedef struct OrchardCompactDecryptorPtr OrchardCompactDecryptorPtr;
+
+/**
+ * Constructs a trial decryptor for compact Orchard actions with the incoming
+ * viewing keys the wallet currently has. The decryptor does not refer to the
+ * wallet, so it may be used on any thread. Memory is allocated by Rust and must
+ * be manually freed using `orchard_compact_decryptor_free`.
+ */
+OrchardCompactDecryptorPtr* orchard_wallet_compact_decryptor(const OrchardWalletPtr* wallet);
+
+/**
+ * Frees the memory associated with a compact trial decryptor.
+ */
+void orchard_compact_decryptor_free(OrchardCompactDecryptorPtr* decryptor);
+
+/**
+ * Returns whether any of the specified compact actions decrypts with one of the
+ * decryptor's incoming viewing keys. Actions that cannot be parsed are counted
+ * as decrypting, so that the caller falls back to the full transaction.
+ */
+bool orchard_compact_decryptor_any_decrypts(
+        const OrchardCompactDecryptorPtr* decryptor,
+        const RawOrchardCompactAction* actions,
+        size_t actionsLen);
+
 /**
  * Obtains the root of the wallet's Orchard note commitment tree at the given
  * checkpoint depth, copying it to `root_ret` which must point to a 32-byte
@@ -342,6 +444,16 @@ bool orchard_wallet_is_nullifier_from_me(
         const OrchardWalletPtr* wallet,
         const unsigned char *nullifier);
 
+/**
+ * Returns true if any of the `nullifiersLen` 32-byte nullifiers stored
+ * contiguously at `nullifiers` belongs to one of the notes in our wallet.
+ * This checks a whole block's worth of nullifiers in a single call.
+ */
+bool orchard_wallet_any_nullifier_from_me(
+        const OrchardWalletPtr* wallet,
+        const unsigned char *nullifiers,
+        size_t nullifiersLen);
+
 typedef void (*push_txid_callback_t)(void* resultVector, unsigned char txid[32]);
 
 /**
@@ -416,6 +528,13 @@ bool orchard_wallet_load_note_commitment_tree(
 bool orchard_wallet_unspent_notes_are_spendable(
         const OrchardWalletPtr* wallet);
 
+/**
+ * Returns an estimate, in bytes, of the heap memory held by the Orchard
+ * wallet's note data. The key store and note commitment tree are not included.
+ */
+size_t orchard_wallet_note_data_usage(
+        const OrchardWalletPtr* wallet);
+
 #ifdef __cplusplus
 }
 #endif
@@ -100,6 +100,10 @@ TracingSpanGuard* tracing_span_enter(const TracingSpanHandle* span);
 /// Exits a span by dropping the given guard.
 void tracing_span_exit(TracingSpanGuard* guard);
 
+/// Returns whether events at a callsite would be recorded by the current
+/// filter, so that their field values need not be built when they are not.
+bool tracing_callsite_enabled(const TracingCallsite* callsite);
+
 /// Logs a message for a callsite.
 ///
 /// You should usually call the `TracingLog` macro (or one of the helper
@@ -11,9 +11,19 @@ mod ffi {
         fn box_clone(&self) -> Box<State>;
         fn update(&mut self, input: &[u8]);
         fn finalize(&self, output: &mut [u8]);
+
+        fn hash_many(
+            output_len: usize,
+            personalization: &[u8],
+            inputs: &[u8],
+            input_len: usize,
+            outputs: &mut [u8],
+        );
     }
 }
 
+use blake2b_simd::many::{self, HashManyJob};
+
 #[derive(Clone)]
 struct State(blake2b_simd::State);
 
@@ -42,3 +52,28 @@ impl State {
         output.copy_from_slice(&hash.as_bytes()[..output.len()]);
     }
 }
+
+/// Hashes each of the consecutive `input_len`-byte messages in `inputs` into the
+/// corresponding `output_len` bytes of `outputs`. The messages are hashed several
+/// at a time in SIMD lanes where the CPU supports it.
+fn hash_many(
+    output_len: usize,
+    personalization: &[u8],
+    inputs: &[u8],
+    input_len: usize,
+    outputs: &mut [u8],
+) {
+    assert!(input_len > 0 && inputs.len() % input_len == 0);
+    assert_eq!(outputs.len(), inputs.len() / input_len * output_len);
+
+    let mut params = blake2b_simd::Params::new();
+    params.hash_length(output_len).personal(personalization);
+    let mut jobs: Vec<_> = inputs
+        .chunks(input_len)
+        .map(|input| HashManyJob::new(&params, input))
+        .collect();
+    many::hash_many(jobs.iter_mut());
+    for (job, output) in jobs.iter().zip(outputs.chunks_mut(output_len)) {
+        output.copy_from_slice(job.to_hash().as_bytes());
+    }
+}
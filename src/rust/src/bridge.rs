@@ -15,7 +15,8 @@ use crate::{
         try_sapling_note_decryption, try_sapling_output_recovery, DecryptedSaplingOutput,
     },
     orchard_bundle::{
-        none_orchard_bundle, orchard_bundle_from_raw_box, parse_orchard_bundle, Action, Bundle,
+        none_orchard_bundle, orchard_bundle_from_raw_box, parse_orchard_bundle_bytes, Action,
+        Bundle,
     },
     orchard_ffi::{orchard_batch_validation_init, BatchValidator as OrchardBatchValidator},
     params::{network, Network},
@@ -30,13 +31,13 @@ use crate::{
     },
     streams::{
         from_auto_file, from_blake2b_writer, from_buffered_file, from_data, from_hash_writer,
-        from_size_computer, CppStream,
+        from_size_computer, from_span_reader, CppStream,
     },
     test_harness_ffi::{
         test_only_invalid_sapling_bundle, test_only_replace_sapling_nullifier,
         test_only_replace_sapling_output_parts,
     },
-    wallet_scanner::{init_batch_scanner, BatchResult, BatchScanner},
+    wallet_scanner::{batch_scanners_dynamic_usage, init_batch_scanner, BatchResult, BatchScanner},
 };
 
 #[allow(clippy::needless_lifetimes)]
@@ -50,6 +51,7 @@ pub(crate) mod ffi {
         type RustStream = crate::streams::ffi::RustStream;
         type CAutoFile = crate::streams::ffi::CAutoFile;
         type CBufferedFile = crate::streams::ffi::CBufferedFile;
+        type CSpanReader = crate::streams::ffi::CSpanReader;
         type CHashWriter = crate::streams::ffi::CHashWriter;
         type CBLAKE2bWriter = crate::streams::ffi::CBLAKE2bWriter;
         type CSizeComputer = crate::streams::ffi::CSizeComputer;
@@ -61,6 +63,7 @@ pub(crate) mod ffi {
         fn from_data(stream: Pin<&mut RustStream>) -> Box<CppStream<'_>>;
         fn from_auto_file(file: Pin<&mut CAutoFile>) -> Box<CppStream<'_>>;
         fn from_buffered_file(file: Pin<&mut CBufferedFile>) -> Box<CppStream<'_>>;
+        fn from_span_reader(reader: Pin<&mut CSpanReader>) -> Box<CppStream<'_>>;
         fn from_hash_writer(writer: Pin<&mut CHashWriter>) -> Box<CppStream<'_>>;
         fn from_blake2b_writer(writer: Pin<&mut CBLAKE2bWriter>) -> Box<CppStream<'_>>;
         fn from_size_computer(sc: Pin<&mut CSizeComputer>) -> Box<CppStream<'_>>;
@@ -93,11 +96,12 @@ pub(crate) mod ffi {
         fn NewBundleValidityCache(kind: &str, bytes: usize) -> UniquePtr<BundleValidityCache>;
         fn insert(self: Pin<&mut BundleValidityCache>, entry: [u8; 32]);
         fn contains(&self, entry: &[u8; 32], erase: bool) -> bool;
+        fn nonce(&self) -> [u8; 32];
     }
     #[namespace = "bundlecache"]
     extern "Rust" {
         #[rust_name = "bundlecache_init"]
-        fn init(cache_bytes: usize);
+        fn init(sapling_cache_bytes: usize, orchard_cache_bytes: usize);
     }
 
     #[namespace = "sapling"]
@@ -286,8 +290,8 @@ pub(crate) mod ffi {
         #[rust_name = "orchard_bundle_from_raw_box"]
         unsafe fn from_raw_box(bundle: *mut OrchardBundlePtr) -> Box<Bundle>;
         fn box_clone(self: &Bundle) -> Box<Bundle>;
-        #[rust_name = "parse_orchard_bundle"]
-        fn parse(stream: &mut CppStream<'_>) -> Result<Box<Bundle>>;
+        #[rust_name = "parse_orchard_bundle_bytes"]
+        fn parse_bytes(bytes: &[u8]) -> Result<Box<Bundle>>;
         fn serialize(self: &Bundle, stream: &mut CppStream<'_>) -> Result<()>;
         fn as_ptr(self: &Bundle) -> *const OrchardBundlePtr;
         fn recursive_dynamic_usage(self: &Bundle) -> usize;
@@ -414,5 +418,7 @@ pub(crate) mod ffi {
         ) -> Box<BatchResult>;
 
         fn get_sapling(self: &BatchResult) -> Vec<SaplingDecryptionResult>;
+
+        fn batch_scanners_dynamic_usage() -> usize;
     }
 }
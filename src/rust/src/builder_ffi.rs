@@ -28,8 +28,8 @@ use zcash_protocol::value::ZatBalance;
 
 use crate::{
     bridge::ffi::OrchardUnauthorizedBundlePtr,
+    init::{orchard_proving_key, PROOF_THREADPOOL},
     transaction_ffi::{MapTransparent, TransparentAuth},
-    ORCHARD_PK,
 };
 
 pub struct OrchardSpendInfo {
@@ -171,8 +171,8 @@ pub extern "C" fn orchard_unauthorized_bundle_prove_and_sign(
     let bundle = unsafe { Box::from_raw(bundle) };
     let keys = unsafe { slice::from_raw_parts(keys, keys_len) };
     let sighash = unsafe { sighash.as_ref() }.expect("sighash pointer may not be null.");
-    let pk = unsafe { ORCHARD_PK.as_ref() }
-        .expect("Parameters not loaded: ORCHARD_PK should have been initialized");
+    let pk = orchard_proving_key()
+        .expect("Parameters not loaded: proving keys should have been enabled");
 
     let signing_keys = keys
         .iter()
@@ -184,9 +184,13 @@ pub extern "C" fn orchard_unauthorized_bundle_prove_and_sign(
         .collect::<Vec<_>>();
 
     let mut rng = OsRng;
-    let res = bundle
-        .create_proof(pk, &mut rng)
-        .and_then(|b| b.apply_signatures(rng, *sighash, &signing_keys));
+    // The circuit's multicore passes run on whichever pool the proof is created
+    // in, so this uses the proving pool when one has been configured.
+    let proven = match PROOF_THREADPOOL.get() {
+        Some(pool) => pool.install(|| bundle.create_proof(pk, &mut rng)),
+        None => bundle.create_proof(pk, &mut rng),
+    };
+    let res = proven.and_then(|b| b.apply_signatures(rng, *sighash, &signing_keys));
 
     match res {
         Ok(signed) => Box::into_raw(Box::new(signed)),
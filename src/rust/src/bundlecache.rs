@@ -3,8 +3,6 @@ use std::{
     sync::{Once, RwLock, RwLockReadGuard, RwLockWriteGuard},
 };
 
-use rand_core::{OsRng, RngCore};
-
 use crate::bridge::ffi;
 
 pub(crate) struct CacheEntry([u8; 32]);
@@ -42,15 +40,12 @@ impl BundleValidityCache {
             .to_state();
 
         // Pre-load the hasher with a per-instance nonce. This ensures that cache entries
-        // are deterministic but also unique per node.
-        let mut nonce = [0; 32];
-        OsRng.fill_bytes(&mut nonce);
-        hasher.update(&nonce);
-
-        Self {
-            hasher,
-            cache: ffi::NewBundleValidityCache(kind, cache_bytes),
-        }
+        // are deterministic but also unique per node. The cache picks the nonce, and
+        // reuses the saved one if it was restored from disk.
+        let cache = ffi::NewBundleValidityCache(kind, cache_bytes);
+        hasher.update(&cache.nonce());
+
+        Self { hasher, cache }
     }
 
     pub(crate) fn compute_entry(
@@ -98,17 +93,17 @@ static BUNDLE_CACHES_LOADED: Once = Once::new();
 static mut SAPLING_BUNDLE_VALIDITY_CACHE: Option<RwLock<BundleValidityCache>> = None;
 static mut ORCHARD_BUNDLE_VALIDITY_CACHE: Option<RwLock<BundleValidityCache>> = None;
 
-pub(crate) fn init(cache_bytes: usize) {
+pub(crate) fn init(sapling_cache_bytes: usize, orchard_cache_bytes: usize) {
     BUNDLE_CACHES_LOADED.call_once(|| unsafe {
         SAPLING_BUNDLE_VALIDITY_CACHE = Some(RwLock::new(BundleValidityCache::new(
             "Sapling",
             b"SaplingVeriCache",
-            cache_bytes,
+            sapling_cache_bytes,
         )));
         ORCHARD_BUNDLE_VALIDITY_CACHE = Some(RwLock::new(BundleValidityCache::new(
             "Orchard",
             b"OrchardVeriCache",
-            cache_bytes,
+            orchard_cache_bytes,
         )));
     });
 }
@@ -1,20 +1,34 @@
-use std::sync::Once;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Once, OnceLock};
+use std::time::Instant;
 
 use tracing::info;
 
-use crate::{ORCHARD_PK, ORCHARD_VK};
+use crate::ORCHARD_VK;
 
 #[cxx::bridge]
 mod ffi {
     #[namespace = "init"]
     extern "Rust" {
         fn rayon_threadpool();
+        fn proof_threadpool(num_threads: usize);
         fn zksnark_params(sprout_path: String, load_proving_keys: bool);
     }
 }
 
 static PROOF_PARAMETERS_LOADED: Once = Once::new();
 
+/// Whether `zksnark_params` allowed proofs to be created.
+static PROVING_KEYS_ENABLED: AtomicBool = AtomicBool::new(false);
+
+/// The Orchard proving key, built the first time a proof is created.
+static ORCHARD_PK: OnceLock<orchard::circuit::ProvingKey> = OnceLock::new();
+
+/// The threads that Orchard proofs are created on, so that building a large
+/// bundle neither waits behind nor stalls the note scanning that shares the
+/// global pool.
+pub(crate) static PROOF_THREADPOOL: OnceLock<rayon::ThreadPool> = OnceLock::new();
+
 fn rayon_threadpool() {
     rayon::ThreadPoolBuilder::new()
         .thread_name(|i| format!("zc-rayon-{}", i))
@@ -22,9 +36,24 @@ fn rayon_threadpool() {
         .expect("Only initialized once");
 }
 
+fn proof_threadpool(num_threads: usize) {
+    let pool = rayon::ThreadPoolBuilder::new()
+        .num_threads(num_threads)
+        .thread_name(|i| format!("zc-prover-{}", i))
+        .build()
+        .expect("Proving threads can be spawned");
+    if PROOF_THREADPOOL.set(pool).is_err() {
+        panic!("Only initialized once");
+    }
+}
+
 /// Loads the zk-SNARK parameters into memory (Orchard-only chain).
 /// Only called once.
 ///
+/// Only the verifying key is built here. The proving key takes much longer to
+/// build and is far larger, and a node that never creates a proof doesn't
+/// need it, so it is built by `orchard_proving_key` on first use.
+///
 /// If `load_proving_keys` is `false`, the proving keys will not be loaded, making it
 /// impossible to create proofs. This flag is for the Boost test suite.
 ///
@@ -36,14 +65,32 @@ fn zksnark_params(_sprout_path: String, load_proving_keys: bool) {
 
         // Generate Orchard parameters.
         info!(target: "main", "Loading Orchard parameters");
-        let orchard_pk = load_proving_keys.then(orchard::circuit::ProvingKey::build);
         let orchard_vk = orchard::circuit::VerifyingKey::build();
+        PROVING_KEYS_ENABLED.store(load_proving_keys, Ordering::Release);
 
         // Caller is responsible for calling this function once, so
         // these global mutations are safe.
         unsafe {
-            ORCHARD_PK = orchard_pk;
             ORCHARD_VK = Some(orchard_vk);
         }
     });
 }
+
+/// Returns the Orchard proving key, building it if this is the first proof,
+/// or `None` if proving keys were not requested.
+pub(crate) fn orchard_proving_key() -> Option<&'static orchard::circuit::ProvingKey> {
+    if !PROVING_KEYS_ENABLED.load(Ordering::Acquire) {
+        return None;
+    }
+    Some(ORCHARD_PK.get_or_init(|| {
+        info!(target: "main", "Building Orchard proving key for the first proof");
+        let start = Instant::now();
+        let pk = orchard::circuit::ProvingKey::build();
+        info!(
+            target: "main",
+            "Built Orchard proving key in {:.3}s",
+            start.elapsed().as_secs_f64()
+        );
+        pk
+    }))
+}
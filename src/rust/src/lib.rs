@@ -72,7 +72,6 @@ static mut SAPLING_SPEND_PARAMS: Option<SpendParameters> = None;
 static mut SAPLING_OUTPUT_PARAMS: Option<OutputParameters> = None;
 static mut SPROUT_GROTH16_PARAMS_PATH: Option<PathBuf> = None;
 
-static mut ORCHARD_PK: Option<orchard::circuit::ProvingKey> = None;
 static mut ORCHARD_VK: Option<orchard::circuit::VerifyingKey> = None;
 
 /// Converts CtOption<t> into Option<T>
@@ -62,9 +62,16 @@ pub(crate) unsafe fn orchard_bundle_from_raw_box(
     Bundle::from_raw_box(bundle)
 }
 
-/// Parses an authorized Orchard bundle from the given stream.
-pub(crate) fn parse_orchard_bundle(reader: &mut CppStream<'_>) -> Result<Box<Bundle>, String> {
-    Bundle::parse(reader)
+/// Parses an authorized Orchard bundle from its serialized bytes, all of which
+/// must belong to the bundle.
+pub(crate) fn parse_orchard_bundle_bytes(bytes: &[u8]) -> Result<Box<Bundle>, String> {
+    let mut reader = bytes;
+    let parsed = orchard_serialization::read_v5_bundle(&mut reader)
+        .map_err(|e| format!("Failed to parse Orchard bundle: {}", e))?;
+    if !reader.is_empty() {
+        return Err("Failed to parse Orchard bundle: trailing bytes".to_owned());
+    }
+    Ok(Box::new(Bundle(parsed)))
 }
 
 impl Bundle {
@@ -82,14 +89,6 @@ impl Bundle {
         Box::new(self.clone())
     }
 
-    /// Parses an authorized Orchard bundle from the given stream.
-    pub(crate) fn parse(reader: &mut CppStream<'_>) -> Result<Box<Self>, String> {
-        match orchard_serialization::read_v5_bundle(reader) {
-            Ok(parsed) => Ok(Box::new(Bundle(parsed))),
-            Err(e) => Err(format!("Failed to parse Orchard bundle: {}", e)),
-        }
-    }
-
     /// Serializes an authorized Orchard bundle to the given stream.
     ///
     /// If `bundle == None`, this serializes `nActionsOrchard = 0`.
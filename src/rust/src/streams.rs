@@ -19,6 +19,9 @@ pub(crate) mod ffi {
         type CBufferedFile;
         unsafe fn read_u8(self: Pin<&mut CBufferedFile>, pch: *mut u8, nSize: usize) -> Result<()>;
 
+        type CSpanReader;
+        unsafe fn read_u8(self: Pin<&mut CSpanReader>, pch: *mut u8, nSize: usize) -> Result<()>;
+
         type CHashWriter;
         unsafe fn write_u8(self: Pin<&mut CHashWriter>, pch: *const u8, nSize: usize)
             -> Result<()>;
@@ -41,6 +44,7 @@ pub(crate) mod ffi {
     impl UniquePtr<RustStream> {}
     impl UniquePtr<CAutoFile> {}
     impl UniquePtr<CBufferedFile> {}
+    impl UniquePtr<CSpanReader> {}
     impl UniquePtr<CHashWriter> {}
     impl UniquePtr<CBLAKE2bWriter> {}
     impl UniquePtr<CSizeComputer> {}
@@ -58,6 +62,10 @@ pub(crate) fn from_buffered_file(file: Pin<&mut ffi::CBufferedFile>) -> Box<CppS
     Box::new(CppStream::BufferedFile(file))
 }
 
+pub(crate) fn from_span_reader(reader: Pin<&mut ffi::CSpanReader>) -> Box<CppStream<'_>> {
+    Box::new(CppStream::SpanReader(reader))
+}
+
 pub(crate) fn from_hash_writer(writer: Pin<&mut ffi::CHashWriter>) -> Box<CppStream<'_>> {
     Box::new(CppStream::Hash(writer))
 }
@@ -74,6 +82,7 @@ pub(crate) enum CppStream<'a> {
     Data(Pin<&'a mut ffi::RustStream>),
     AutoFile(Pin<&'a mut ffi::CAutoFile>),
     BufferedFile(Pin<&'a mut ffi::CBufferedFile>),
+    SpanReader(Pin<&'a mut ffi::CSpanReader>),
     Hash(Pin<&'a mut ffi::CHashWriter>),
     Blake2b(Pin<&'a mut ffi::CBLAKE2bWriter>),
     Size(Pin<&'a mut ffi::CSizeComputer>),
@@ -93,6 +102,9 @@ impl<'a> io::Read for CppStream<'a> {
             CppStream::BufferedFile(inner) => unsafe { inner.as_mut().read_u8(pch, len) }
                 .map(|()| buf.len())
                 .map_err(|e| io::Error::new(io::ErrorKind::Other, e)),
+            CppStream::SpanReader(inner) => unsafe { inner.as_mut().read_u8(pch, len) }
+                .map(|()| buf.len())
+                .map_err(|e| io::Error::new(io::ErrorKind::Other, e)),
             CppStream::Hash(_) => Err(io::Error::new(
                 io::ErrorKind::Unsupported,
                 "Cannot read from CHashWriter",
@@ -124,6 +136,10 @@ impl<'a> io::Write for CppStream<'a> {
                 io::ErrorKind::Unsupported,
                 "Cannot write to CBufferedFile",
             )),
+            CppStream::SpanReader(_) => Err(io::Error::new(
+                io::ErrorKind::Unsupported,
+                "Cannot write to CSpanReader",
+            )),
             CppStream::Hash(inner) => unsafe { inner.as_mut().write_u8(pch, len) }
                 .map(|()| buf.len())
                 .map_err(|e| io::Error::new(io::ErrorKind::Other, e)),
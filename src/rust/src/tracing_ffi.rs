@@ -600,6 +600,12 @@ pub extern "C" fn tracing_span_exit(guard: *mut Entered) {
     }
 }
 
+#[no_mangle]
+pub extern "C" fn tracing_callsite_enabled(callsite: *const FfiCallsite) -> bool {
+    let callsite = unsafe { &*callsite };
+    level_enabled!(*callsite.metadata().level()) && callsite.is_enabled()
+}
+
 #[no_mangle]
 pub extern "C" fn tracing_log(
     callsite: *const FfiCallsite,
@@ -2,7 +2,7 @@ use bridgetree::{self, BridgeTree};
 use byteorder::{LittleEndian, ReadBytesExt, WriteBytesExt};
 use incrementalmerkletree::Position;
 use libc::c_uchar;
-use std::collections::{BTreeMap, BTreeSet};
+use std::collections::{BTreeMap, BTreeSet, HashSet};
 use std::convert::TryInto;
 use std::io;
 use std::ptr;
@@ -19,11 +19,16 @@ use zcash_primitives::{
 
 use orchard::{
     bundle::Authorized,
-    keys::{FullViewingKey, IncomingViewingKey, OutgoingViewingKey, Scope, SpendingKey},
-    note::Nullifier,
+    keys::{
+        FullViewingKey, IncomingViewingKey, OutgoingViewingKey, PreparedIncomingViewingKey, Scope,
+        SpendingKey,
+    },
+    note::{ExtractedNoteCommitment, Nullifier},
+    note_encryption::{CompactAction, OrchardDomain},
     tree::{MerkleHashOrchard, MerklePath},
     Address, Bundle, Note,
 };
+use zcash_note_encryption::{batch, EphemeralKeyBytes, COMPACT_NOTE_SIZE};
 
 use crate::{
     builder_ffi::OrchardSpendInfo,
@@ -59,7 +64,30 @@ pub struct InPoint {
 #[derive(Debug, Clone)]
 pub struct DecryptedNote {
     note: Note,
-    memo: [u8; 512],
+    /// The note's memo, or `None` for the empty memo (0xF6 followed by zeroes)
+    /// that most notes carry, so that those notes do not each hold 512 bytes.
+    memo: Option<Box<[u8; 512]>>,
+}
+
+impl DecryptedNote {
+    fn new(note: Note, memo: [u8; 512]) -> Self {
+        let is_empty = memo[0] == 0xF6 && memo[1..].iter().all(|b| *b == 0);
+        DecryptedNote {
+            note,
+            memo: if is_empty { None } else { Some(Box::new(memo)) },
+        }
+    }
+
+    fn memo(&self) -> [u8; 512] {
+        match &self.memo {
+            Some(memo) => **memo,
+            None => {
+                let mut memo = [0u8; 512];
+                memo[0] = 0xF6;
+                memo
+            }
+        }
+    }
 }
 
 /// A data structure tracking the note data that was decrypted from a single transaction.
@@ -84,6 +112,10 @@ struct KeyStore {
     payment_addresses: BTreeMap<OrderedAddress, IncomingViewingKey>,
     viewing_keys: BTreeMap<IncomingViewingKey, FullViewingKey>,
     spending_keys: BTreeMap<FullViewingKey, SpendingKey>,
+    /// Every key in `viewing_keys`, in the order it was added, alongside the
+    /// prepared form that trial decryption needs. Preparing the keys once here
+    /// saves redoing it for every bundle that is scanned.
+    decryption_keys: Vec<(IncomingViewingKey, PreparedIncomingViewingKey)>,
 }
 
 impl KeyStore {
@@ -92,6 +124,7 @@ impl KeyStore {
             payment_addresses: BTreeMap::new(),
             viewing_keys: BTreeMap::new(),
             spending_keys: BTreeMap::new(),
+            decryption_keys: vec![],
         }
     }
 
@@ -100,8 +133,15 @@ impl KeyStore {
         // incoming viewing keys.
         let external_ivk = fvk.to_ivk(Scope::External);
         let internal_ivk = fvk.to_ivk(Scope::Internal);
-        self.viewing_keys.insert(external_ivk, fvk.clone());
-        self.viewing_keys.insert(internal_ivk, fvk);
+        self.add_incoming_viewing_key(external_ivk, fvk.clone());
+        self.add_incoming_viewing_key(internal_ivk, fvk);
+    }
+
+    fn add_incoming_viewing_key(&mut self, ivk: IncomingViewingKey, fvk: FullViewingKey) {
+        let prepared_ivk = PreparedIncomingViewingKey::new(&ivk);
+        if self.viewing_keys.insert(ivk.clone(), fvk).is_none() {
+            self.decryption_keys.push((ivk, prepared_ivk));
+        }
     }
 
     pub fn add_spending_key(&mut self, sk: SpendingKey) {
@@ -119,6 +159,42 @@ impl KeyStore {
         has_fvk
     }
 
+    /// Trial-decrypts the actions of `bundle` with every incoming viewing key, returning
+    /// the index of each action that decrypts along with the key that decrypted it.
+    ///
+    /// All of the (action, key) pairs are tried in one batch, which parses each
+    /// ephemeral key once rather than once per key and shares the field inversions
+    /// of the key derivations across the whole batch.
+    pub fn decrypt_outputs(
+        &self,
+        bundle: &Bundle<Authorized, ZatBalance>,
+    ) -> Vec<(usize, IncomingViewingKey, Note, Address, [u8; 512])> {
+        if self.decryption_keys.is_empty() {
+            return vec![];
+        }
+        let prepared_ivks = self
+            .decryption_keys
+            .iter()
+            .map(|(_, prepared_ivk)| prepared_ivk.clone())
+            .collect::<Vec<_>>();
+        let outputs = bundle
+            .actions()
+            .iter()
+            .map(|action| (OrchardDomain::for_action(action), action.clone()))
+            .collect::<Vec<_>>();
+
+        batch::try_note_decryption(&prepared_ivks, &outputs)
+            .into_iter()
+            .enumerate()
+            .filter_map(|(action_idx, result)| {
+                result.map(|((note, recipient, memo), ivk_idx)| {
+                    let ivk = self.decryption_keys[ivk_idx].0.clone();
+                    (action_idx, ivk, note, recipient, memo)
+                })
+            })
+            .collect()
+    }
+
     pub fn spending_key_for_ivk(&self, ivk: &IncomingViewingKey) -> Option<&SpendingKey> {
         self.viewing_keys
             .get(ivk)
@@ -148,6 +224,9 @@ pub struct Wallet {
     /// The in-memory index from nullifier to the outpoint of the note from which that
     /// nullifier was derived.
     nullifiers: BTreeMap<Nullifier, OutPoint>,
+    /// The encodings of the keys of `nullifiers`, hashed so that nullifiers revealed
+    /// on chain can be checked for membership without decoding them.
+    nullifier_bytes: HashSet<[u8; 32]>,
     /// The incremental Merkle tree used to track note commitments and witnesses for notes
     /// belonging to the wallet.
     // TODO: Replace this with an `orchard` crate constant (they happen to be the same).
@@ -234,6 +313,7 @@ impl Wallet {
             wallet_received_notes: BTreeMap::new(),
             wallet_note_positions: BTreeMap::new(),
             nullifiers: BTreeMap::new(),
+            nullifier_bytes: HashSet::new(),
             commitment_tree: BridgeTree::new(MAX_CHECKPOINTS),
             last_checkpoint: None,
             last_observed: None,
@@ -242,6 +322,41 @@ impl Wallet {
         }
     }
 
+    /// Returns an estimate of the heap memory held by the wallet's note data, that
+    /// is everything other than the key store and the note commitment tree.
+    pub fn note_data_usage(&self) -> usize {
+        use std::mem::size_of;
+
+        let decrypted_notes: usize = self
+            .wallet_received_notes
+            .values()
+            .flat_map(|tx_notes| tx_notes.decrypted_notes.values())
+            .map(|dnote| {
+                size_of::<(usize, DecryptedNote)>() + dnote.memo.as_ref().map_or(0, |_| 512)
+            })
+            .sum();
+        let note_positions: usize = self
+            .wallet_note_positions
+            .values()
+            .map(|positions| positions.note_positions.len() * size_of::<(usize, Position)>())
+            .sum();
+        let potential_spends: usize = self
+            .potential_spends
+            .values()
+            .map(|inpoints| inpoints.len() * size_of::<InPoint>())
+            .sum();
+
+        self.wallet_received_notes.len() * size_of::<(TxId, TxNotes)>()
+            + decrypted_notes
+            + self.wallet_note_positions.len() * size_of::<(TxId, NotePositions)>()
+            + note_positions
+            + self.nullifiers.len() * size_of::<(Nullifier, OutPoint)>()
+            + self.nullifier_bytes.capacity() * size_of::<[u8; 32]>()
+            + self.mined_notes.len() * size_of::<(OutPoint, InPoint)>()
+            + self.potential_spends.len() * size_of::<(Nullifier, BTreeSet<InPoint>)>()
+            + potential_spends
+    }
+
     /// Reset the state of the wallet to be suitable for rescan from the NU5 activation
     /// height.  This removes all witness and spentness information from the wallet. The
     /// keystore is unmodified and decrypted note, nullifier, and conflict data are left
@@ -281,6 +396,28 @@ impl Wallet {
         true
     }
 
+    /// Records that the given block has been observed without checkpointing the note
+    /// commitment tree, for blocks so far below the chain tip that the wallet will never
+    /// be asked to rewind to them; such checkpoints would be evicted before they could be
+    /// used. The same ordering rule as `Self::checkpoint` applies.
+    #[tracing::instrument(level = "trace", skip(self))]
+    pub fn skip_checkpoint(&mut self, block_height: BlockHeight) -> bool {
+        if let Some(last_height) = self.last_checkpoint {
+            let expected_height = last_height + 1;
+            if block_height != expected_height {
+                tracing::error!(
+                    "Expected checkpoint height {}, given {}",
+                    expected_height,
+                    block_height
+                );
+                return false;
+            }
+        }
+
+        self.last_checkpoint = Some(block_height);
+        true
+    }
+
     /// Returns the last checkpoint if any. If no checkpoint exists, the wallet has not
     /// yet observed any blocks.
     pub fn last_checkpoint(&self) -> Option<BlockHeight> {
@@ -393,14 +530,7 @@ impl Wallet {
         // in this bundle, record them as potential spends.
         involvement.spend_action_metadata = self.add_potential_spends(txid, bundle);
 
-        let keys = self
-            .key_store
-            .viewing_keys
-            .keys()
-            .cloned()
-            .collect::<Vec<_>>();
-
-        for (action_idx, ivk, note, recipient, memo) in bundle.decrypt_outputs_with_keys(&keys) {
+        for (action_idx, ivk, note, recipient, memo) in self.key_store.decrypt_outputs(bundle) {
             assert!(self.add_decrypted_note(txid, action_idx, ivk.clone(), note, recipient, memo));
             involvement.receive_action_metadata.insert(action_idx, ivk);
         }
@@ -481,9 +611,10 @@ impl Wallet {
             // that we can detect when the note is later spent.
             let nf = note.nullifier(fvk);
             self.nullifiers.insert(nf, outpoint);
+            self.nullifier_bytes.insert(nf.to_bytes());
 
             // add the decrypted note data to the wallet
-            let note_data = DecryptedNote { note, memo };
+            let note_data = DecryptedNote::new(note, memo);
             self.wallet_received_notes
                 .entry(*txid)
                 .or_insert_with(|| TxNotes {
@@ -562,6 +693,28 @@ impl Wallet {
         block_tx_idx: usize,
         txid: &TxId,
         bundle: &Bundle<Authorized, ZatBalance>,
+    ) -> Result<(), WalletError> {
+        self.append_commitments(
+            block_height,
+            block_tx_idx,
+            txid,
+            bundle
+                .actions()
+                .iter()
+                .map(|action| (*action.cmx(), *action.nullifier())),
+        )
+    }
+
+    /// Add the note commitments of a transaction's Orchard actions to the note commitment
+    /// tree, given as the `(cmx, nullifier)` pair of each action in order. This is what
+    /// `Self::append_bundle_commitments` does for a whole bundle, for callers that only
+    /// have the compact form of the actions.
+    pub fn append_commitments(
+        &mut self,
+        block_height: BlockHeight,
+        block_tx_idx: usize,
+        txid: &TxId,
+        actions: impl Iterator<Item = (ExtractedNoteCommitment, Nullifier)>,
     ) -> Result<(), WalletError> {
         // Check that the wallet is in the correct state to update the note commitment tree with
         // new outputs.
@@ -601,11 +754,11 @@ impl Wallet {
                 .is_none());
         }
 
-        for (action_idx, action) in bundle.actions().iter().enumerate() {
+        for (action_idx, (cmx, nullifier)) in actions.enumerate() {
             // append the note commitment for each action to the note commitment tree
             if !self
                 .commitment_tree
-                .append(MerkleHashOrchard::from_cmx(action.cmx()))
+                .append(MerkleHashOrchard::from_cmx(&cmx))
             {
                 return Err(WalletError::NoteCommitmentTreeFull);
             }
@@ -629,7 +782,7 @@ impl Wallet {
 
             // For nullifiers that are ours that we detect as spent by this action,
             // we will record that input as being mined.
-            if let Some(outpoint) = self.nullifiers.get(action.nullifier()) {
+            if let Some(outpoint) = self.nullifiers.get(&nullifier) {
                 assert!(self
                     .mined_notes
                     .insert(
@@ -943,6 +1096,201 @@ pub extern "C" fn orchard_wallet_append_bundle_commitments(
     true
 }
 
+/// The parts of an Orchard action that trial decryption and the note commitment tree
+/// need. This must have the same representation as `struct RawOrchardCompactAction`
+/// in `rust/include/rust/orchard/wallet.h`.
+#[repr(C)]
+pub struct FFICompactAction {
+    nullifier: [u8; 32],
+    cmx: [u8; 32],
+    ephemeral_key: [u8; 32],
+    enc_ciphertext: [u8; COMPACT_NOTE_SIZE],
+}
+
+impl FFICompactAction {
+    fn commitment(&self) -> Option<(ExtractedNoteCommitment, Nullifier)> {
+        let cmx = Option::from(ExtractedNoteCommitment::from_bytes(&self.cmx))?;
+        let nullifier = Option::from(Nullifier::from_bytes(&self.nullifier))?;
+        Some((cmx, nullifier))
+    }
+
+    fn parse(&self) -> Option<CompactAction> {
+        let (cmx, nullifier) = self.commitment()?;
+        Some(CompactAction::from_parts(
+            nullifier,
+            cmx,
+            EphemeralKeyBytes(self.ephemeral_key),
+            self.enc_ciphertext,
+        ))
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_wallet_append_compact_commitments(
+    wallet: *mut Wallet,
+    block_height: u32,
+    block_tx_idx: usize,
+    txid: *const [c_uchar; 32],
+    actions: *const FFICompactAction,
+    actions_len: usize,
+) -> bool {
+    let wallet = unsafe { wallet.as_mut() }.expect("Wallet pointer may not be null");
+    let txid = TxId::from_bytes(*unsafe { txid.as_ref() }.expect("txid may not be null."));
+    if actions_len == 0 {
+        return true;
+    }
+    let actions = unsafe { slice::from_raw_parts(actions, actions_len) };
+    let parsed = match actions
+        .iter()
+        .map(|action| action.commitment())
+        .collect::<Option<Vec<_>>>()
+    {
+        Some(parsed) => parsed,
+        None => {
+            error!("An invalid compact Orchard action was passed to orchard_wallet_append_compact_commitments");
+            return false;
+        }
+    };
+    if let Err(e) =
+        wallet.append_commitments(block_height.into(), block_tx_idx, &txid, parsed.into_iter())
+    {
+        error!("An error occurred adding compact Orchard actions to the note commitment tree: {:?}", e);
+        return false;
+    }
+
+    true
+}
+
+/// One transaction's Orchard actions in a range of blocks passed to
+/// `orchard_wallet_append_blocks`, given either as the transaction's bundle or, when
+/// `bundle` is null, as its compact actions. This must have the same representation as
+/// `struct RawOrchardBatchTx` in `rust/include/rust/orchard/wallet.h`.
+#[repr(C)]
+pub struct FFIBatchTx {
+    block_height: u32,
+    block_tx_idx: usize,
+    txid: [u8; 32],
+    bundle: *const Bundle<Authorized, ZatBalance>,
+    actions: *const FFICompactAction,
+    actions_len: usize,
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_wallet_append_blocks(
+    wallet: *mut Wallet,
+    first_height: u32,
+    block_count: u32,
+    checkpoint_from_height: u32,
+    txs: *const FFIBatchTx,
+    txs_len: usize,
+) -> bool {
+    let wallet = unsafe { wallet.as_mut() }.expect("Wallet pointer may not be null");
+    let txs = if txs_len == 0 {
+        &[][..]
+    } else {
+        unsafe { slice::from_raw_parts(txs, txs_len) }
+    };
+
+    let mut txs = txs.iter().peekable();
+    for offset in 0..block_count {
+        let height = first_height + offset;
+        // The last block is always checkpointed, so that the wallet can be rewound by
+        // one block wherever a batch ends.
+        let observed = if height >= checkpoint_from_height || offset + 1 == block_count {
+            wallet.checkpoint(height.into())
+        } else {
+            wallet.skip_checkpoint(height.into())
+        };
+        if !observed {
+            return false;
+        }
+
+        while let Some(tx) = txs.next_if(|tx| tx.block_height == height) {
+            let txid = TxId::from_bytes(tx.txid);
+            let result = if let Some(bundle) = unsafe { tx.bundle.as_ref() } {
+                wallet.append_bundle_commitments(height.into(), tx.block_tx_idx, &txid, bundle)
+            } else if tx.actions_len == 0 {
+                Ok(())
+            } else {
+                let actions = unsafe { slice::from_raw_parts(tx.actions, tx.actions_len) };
+                match actions
+                    .iter()
+                    .map(|action| action.commitment())
+                    .collect::<Option<Vec<_>>>()
+                {
+                    Some(parsed) => wallet.append_commitments(
+                        height.into(),
+                        tx.block_tx_idx,
+                        &txid,
+                        parsed.into_iter(),
+                    ),
+                    None => {
+                        error!("An invalid compact Orchard action was passed to orchard_wallet_append_blocks");
+                        return false;
+                    }
+                }
+            };
+            if let Err(e) = result {
+                error!("An error occurred adding a batch of blocks to the note commitment tree: {:?}", e);
+                return false;
+            }
+        }
+    }
+
+    // Every transaction must have been in one of the blocks.
+    txs.next().is_none()
+}
+
+/// Trial-decrypts compact Orchard actions with the incoming viewing keys a wallet had
+/// when it was created. It holds no reference to the wallet, so it may be used from
+/// other threads while the wallet is being updated.
+pub struct CompactDecryptor {
+    ivks: Vec<PreparedIncomingViewingKey>,
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_wallet_compact_decryptor(wallet: *const Wallet) -> *mut CompactDecryptor {
+    let wallet = unsafe { wallet.as_ref() }.expect("Wallet pointer may not be null.");
+    let ivks = wallet
+        .key_store
+        .decryption_keys
+        .iter()
+        .map(|(_, prepared_ivk)| prepared_ivk.clone())
+        .collect();
+    Box::into_raw(Box::new(CompactDecryptor { ivks }))
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_compact_decryptor_free(decryptor: *mut CompactDecryptor) {
+    if !decryptor.is_null() {
+        drop(unsafe { Box::from_raw(decryptor) });
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_compact_decryptor_any_decrypts(
+    decryptor: *const CompactDecryptor,
+    actions: *const FFICompactAction,
+    actions_len: usize,
+) -> bool {
+    let decryptor = unsafe { decryptor.as_ref() }.expect("Decryptor pointer may not be null.");
+    if actions_len == 0 || decryptor.ivks.is_empty() {
+        return false;
+    }
+    let actions = unsafe { slice::from_raw_parts(actions, actions_len) };
+    let mut outputs = Vec::with_capacity(actions_len);
+    for action in actions {
+        match action.parse() {
+            Some(action) => outputs.push((OrchardDomain::for_compact_action(&action), action)),
+            // Leave anything we cannot parse to a full read of the transaction.
+            None => return true,
+        }
+    }
+    batch::try_compact_note_decryption(&decryptor.ivks, &outputs)
+        .into_iter()
+        .any(|result| result.is_some())
+}
+
 #[no_mangle]
 pub extern "C" fn orchard_wallet_commitment_tree_root(
     wallet: *const Wallet,
@@ -1070,7 +1418,7 @@ pub extern "C" fn orchard_wallet_get_filtered_notes(
             action_idx: outpoint.action_idx as u32,
             recipient: Box::into_raw(Box::new(dnote.note.recipient())),
             note_value: dnote.note.value().inner() as i64,
-            memo: dnote.memo,
+            memo: dnote.memo(),
         };
         unsafe { (push_cb.unwrap())(result, metadata) };
     }
@@ -1126,15 +1474,9 @@ pub extern "C" fn orchard_wallet_get_txdata(
         .map(|k| OutgoingViewingKey::from(*k))
         .collect();
     if let Some(bundle) = unsafe { bundle.as_ref() } {
-        let ivks = wallet
+        let incoming: BTreeMap<usize, (Note, Address, [u8; 512])> = wallet
             .key_store
-            .viewing_keys
-            .keys()
-            .cloned()
-            .collect::<Vec<_>>();
-
-        let incoming: BTreeMap<usize, (Note, Address, [u8; 512])> = bundle
-            .decrypt_outputs_with_keys(&ivks)
+            .decrypt_outputs(bundle)
             .into_iter()
             .map(|(idx, _, note, addr, memo)| (idx, (note, addr, memo)))
             .collect();
@@ -1190,10 +1532,26 @@ pub extern "C" fn orchard_wallet_is_nullifier_from_me(
     nullifier: *const [c_uchar; 32],
 ) -> bool {
     let wallet = unsafe { wallet.as_ref() }.expect("Wallet pointer may not be null.");
-    let nullifier =
-        Nullifier::from_bytes(unsafe { nullifier.as_ref() }.expect("nullifier may not be null."));
+    let nullifier = unsafe { nullifier.as_ref() }.expect("nullifier may not be null.");
+
+    wallet.nullifier_bytes.contains(nullifier)
+}
+
+#[no_mangle]
+pub extern "C" fn orchard_wallet_any_nullifier_from_me(
+    wallet: *const Wallet,
+    nullifiers: *const [c_uchar; 32],
+    nullifiers_len: usize,
+) -> bool {
+    let wallet = unsafe { wallet.as_ref() }.expect("Wallet pointer may not be null.");
+    if nullifiers_len == 0 {
+        return false;
+    }
+    let nullifiers = unsafe { slice::from_raw_parts(nullifiers, nullifiers_len) };
 
-    wallet.nullifiers.contains_key(&nullifier.unwrap())
+    nullifiers
+        .iter()
+        .any(|nf| wallet.nullifier_bytes.contains(nf))
 }
 
 pub type PushTxId = unsafe extern "C" fn(obj: Option<FFICallbackReceiver>, txid: *const [u8; 32]);
@@ -1427,3 +1785,10 @@ pub extern "C" fn orchard_wallet_unspent_notes_are_spendable(wallet: *const Wall
         .iter()
         .all(|(outpoint, _)| wallet.get_spend_info(*outpoint, 0).is_ok())
 }
+
+#[no_mangle]
+pub extern "C" fn orchard_wallet_note_data_usage(wallet: *const Wallet) -> usize {
+    let wallet = unsafe { wallet.as_ref() }.expect("Wallet pointer may not be null.");
+
+    wallet.note_data_usage()
+}
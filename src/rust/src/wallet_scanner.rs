@@ -31,6 +31,15 @@ const METRIC_LABEL_KIND: &str = "kind";
 
 const METRIC_SIZE_TXS: &str = "zcashd.wallet.batchscanner.size.transactions";
 
+/// The dynamic usage of every live batch scanner, as of their last update.
+static BATCH_SCANNERS_USAGE: AtomicUsize = AtomicUsize::new(0);
+
+/// Returns the dynamic usage of the live batch scanners, so that it can be
+/// read without locking the wallets that own them.
+pub(crate) fn batch_scanners_dynamic_usage() -> usize {
+    BATCH_SCANNERS_USAGE.load(Ordering::Relaxed)
+}
+
 trait OutputDomain: BatchDomain {
     // The kind of output, for metrics labelling.
     const KIND: &'static str;
@@ -554,6 +563,14 @@ type SaplingRunner =
 pub(crate) struct BatchScanner {
     params: Network,
     sapling_runner: Option<SaplingRunner>,
+    /// The dynamic usage last added to `BATCH_SCANNERS_USAGE`.
+    reported_usage: usize,
+}
+
+impl Drop for BatchScanner {
+    fn drop(&mut self) {
+        BATCH_SCANNERS_USAGE.fetch_sub(self.reported_usage, Ordering::Relaxed);
+    }
 }
 
 impl DynamicUsage for BatchScanner {
@@ -587,10 +604,22 @@ pub(crate) fn init_batch_scanner(
     Ok(Box::new(BatchScanner {
         params: *network,
         sapling_runner,
+        reported_usage: 0,
     }))
 }
 
 impl BatchScanner {
+    /// Brings this scanner's share of `BATCH_SCANNERS_USAGE` up to date.
+    fn update_usage(&mut self) {
+        let usage = self.dynamic_usage();
+        if usage >= self.reported_usage {
+            BATCH_SCANNERS_USAGE.fetch_add(usage - self.reported_usage, Ordering::Relaxed);
+        } else {
+            BATCH_SCANNERS_USAGE.fetch_sub(self.reported_usage - usage, Ordering::Relaxed);
+        }
+        self.reported_usage = usage;
+    }
+
     /// Adds the given transaction's shielded outputs to the various batch runners.
     ///
     /// `block_tag` is the hash of the block that triggered this txid being added to the
@@ -627,6 +656,7 @@ impl BatchScanner {
 
         // Update the size of the batch scanner.
         metrics::increment_gauge!(METRIC_SIZE_TXS, 1.0);
+        self.update_usage();
 
         Ok(())
     }
@@ -663,6 +693,7 @@ impl BatchScanner {
 
         // Update the size of the batch scanner.
         metrics::decrement_gauge!(METRIC_SIZE_TXS, 1.0);
+        self.update_usage();
 
         Box::new(BatchResult { sapling })
     }
@@ -7,6 +7,7 @@
 
 #include "reverselock.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <utility>
 
@@ -22,6 +23,15 @@ CScheduler::~CScheduler()
 }
 
 
+CScheduler::TaskQueue::iterator CScheduler::nextRunnable()
+{
+    TaskQueue::iterator it = taskQueue.begin();
+    while (it != taskQueue.end() && !it->second.key.empty() && runningKeys.count(it->second.key)) {
+        ++it;
+    }
+    return it;
+}
+
 void CScheduler::serviceQueue()
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
@@ -32,37 +42,50 @@ void CScheduler::serviceQueue()
     // is called.
     while (!shouldStop()) {
         try {
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
-            }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
-
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty())
-            {
-                auto copy = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, copy) == boost::cv_status::timeout) {
+            // Wait until the first task that may run now is due. Tasks
+            // whose key is running are passed over until it finishes.
+            TaskQueue::iterator it = taskQueue.end();
+            while (!shouldStop()) {
+                it = nextRunnable();
+                if (it == taskQueue.end()) {
+                    newTaskScheduled.wait(lock);
+                } else if (it->first <= boost::chrono::system_clock::now()) {
                     break;
+                } else {
+                    // Some boost versions have a conflicting overload of wait_until that returns void.
+                    // Explicitly use a template here to avoid hitting that overload.
+                    auto copy = it->first;
+                    newTaskScheduled.wait_until<>(lock, copy);
                 }
             }
-
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            if (shouldStop())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            int64_t nLatencyMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(
+                boost::chrono::system_clock::now() - it->first).count();
+            latency.nTasks++;
+            latency.nTotalMicros += nLatencyMicros;
+            latency.nMaxMicros = std::max(latency.nMaxMicros, nLatencyMicros);
 
-            {
+            Task task = std::move(it->second);
+            taskQueue.erase(it);
+            if (!task.key.empty())
+                runningKeys.insert(task.key);
+
+            try {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
+            } catch (...) {
+                if (!task.key.empty())
+                    runningKeys.erase(task.key);
+                throw;
+            }
+            if (!task.key.empty()) {
+                // Tasks waiting on this key may run now.
+                runningKeys.erase(task.key);
+                newTaskScheduled.notify_all();
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -85,29 +108,29 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, const std::string& key)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, Task{f, key}));
     }
     newTaskScheduled.notify_one();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaSeconds, const std::string& key)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::seconds(deltaSeconds), key);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaSeconds, const std::string& key)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaSeconds), deltaSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaSeconds, key), deltaSeconds, key);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds, const std::string& key)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds, key), deltaSeconds, key);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
@@ -121,3 +144,11 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+CScheduler::LatencyStats CScheduler::takeLatencyStats()
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    LatencyStats result = latency;
+    latency = LatencyStats();
+    return result;
+}
@@ -14,6 +14,13 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <set>
+#include <string>
+
+/** Default for -schedulerthreads, the number of threads servicing the node's scheduler */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+/** Maximum number of threads servicing the node's scheduler */
+static const int MAX_SCHEDULER_THREADS = 16;
 
 //
 // Simple class for background tasks that should be run
@@ -32,6 +39,10 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Several threads may service the same queue. Tasks scheduled with the same
+// non-empty key are run one at a time, in the order they fall due, while
+// other tasks go on running on the other threads.
+//
 
 class CScheduler
 {
@@ -41,18 +52,19 @@ public:
 
     typedef std::function<void(void)> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t);
+    // Call func at/after time t, but never while another task with the
+    // same non-empty key is running
+    void schedule(Function f, boost::chrono::system_clock::time_point t, const std::string& key = "");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaSeconds);
+    void scheduleFromNow(Function f, int64_t deltaSeconds, const std::string& key = "");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaSeconds);
+    void scheduleEvery(Function f, int64_t deltaSeconds, const std::string& key = "");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -70,14 +82,34 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // How many tasks were started, and how long they waited past their
+    // due time for a thread, since the last call
+    struct LatencyStats {
+        uint64_t nTasks = 0;
+        int64_t nTotalMicros = 0;
+        int64_t nMaxMicros = 0;
+    };
+    LatencyStats takeLatencyStats();
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        Function f;
+        std::string key;
+    };
+    typedef std::multimap<boost::chrono::system_clock::time_point, Task> TaskQueue;
+
+    TaskQueue taskQueue;
+    // Keys of the tasks being run
+    std::set<std::string> runningKeys;
+    LatencyStats latency;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    // The first task whose key is not running, or taskQueue.end()
+    TaskQueue::iterator nextRunnable();
 };
 
 #endif
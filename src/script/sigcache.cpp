@@ -6,11 +6,16 @@
 
 #include "sigcache.h"
 
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
 #include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
+#include "streams.h"
 #include "uint256.h"
 #include "util/system.h"
+#include "zcash/cache.h"
 
 #include "cuckoocache.h"
 #include <boost/thread.hpp>
@@ -31,11 +36,20 @@ private:
     boost::shared_mutex cs_sigcache;
 
 public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
     CSignatureCache()
     {
         GetRandBytes(nonce.begin(), 32);
     }
 
+    //! Adopt the salt of a saved cache, before any entry is computed
+    void SetNonce(const uint256& nonceIn)
+    {
+        nonce = nonceIn;
+    }
+
     void
     ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
     {
@@ -58,6 +72,21 @@ public:
     {
         return setValid.setup_bytes(n);
     }
+
+    size_t MemoryUsage()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.memory_usage();
+    }
+
+    libzcash::SavedValidityCache Save()
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        libzcash::SavedValidityCache saved;
+        saved.salt = nonce;
+        setValid.for_each([&](const uint256& entry) { saved.entries.push_back(entry); });
+        return saved;
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -76,14 +105,129 @@ void InitSignatureCache(size_t nMaxCacheSize)
     size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
             (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+
+    std::optional<libzcash::SavedValidityCache> saved = libzcash::TakeValidityCache(SIGNATURE_CACHE_KIND);
+    if (saved.has_value()) {
+        signatureCache.SetNonce(saved->salt);
+        for (uint256 entry : saved->entries) {
+            signatureCache.Set(entry);
+        }
+        LogPrintf("Restored %zu entries to the signature cache\n", saved->entries.size());
+    }
+}
+
+void GetSignatureCacheStats(uint64_t& nHits, uint64_t& nMisses)
+{
+    nHits = signatureCache.nHits.load();
+    nMisses = signatureCache.nMisses.load();
+}
+
+size_t GetSignatureCacheMemoryUsage()
+{
+    return signatureCache.MemoryUsage();
+}
+
+// Entries are only meaningful with the salt they were computed with, which is
+// saved next to them; the checksum catches a truncated or corrupted file.
+static const uint64_t VALIDITY_CACHES_DUMP_VERSION = 1;
+
+bool LoadValidityCaches()
+{
+    fs::path path = GetDataDir() / "validitycaches.dat";
+    FILE* file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        LogPrintf("No validity caches saved on disk. Continuing anyway.\n");
+        return false;
+    }
+
+    uint64_t fileSize = fs::file_size(path);
+    std::vector<unsigned char> vchData(fileSize >= sizeof(uint256) ? fileSize - sizeof(uint256) : 0);
+    uint256 hashIn;
+    try {
+        filein.read((char*)vchData.data(), vchData.size());
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    filein.fclose();
+
+    CDataStream ss(vchData, SER_DISK, CLIENT_VERSION);
+    if (Hash(ss.begin(), ss.end()) != hashIn) {
+        return error("%s: Checksum mismatch, data corrupted", __func__);
+    }
+
+    try {
+        uint64_t version;
+        unsigned char pchMsgTmp[4];
+        std::map<std::string, libzcash::SavedValidityCache> caches;
+        ss >> version;
+        if (version != VALIDITY_CACHES_DUMP_VERSION) {
+            return error("%s: Unknown version %d", __func__, version);
+        }
+        ss >> FLATDATA(pchMsgTmp);
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
+            return error("%s: Invalid network magic number", __func__);
+        }
+        ss >> caches;
+        for (auto& entry : caches) {
+            libzcash::StashValidityCache(entry.first, std::move(entry.second));
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+bool DumpValidityCaches()
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::map<std::string, libzcash::SavedValidityCache> caches;
+    caches[SIGNATURE_CACHE_KIND] = signatureCache.Save();
+    for (const auto& entry : libzcash::GetBundleValidityCaches()) {
+        caches[entry.first] = entry.second->Save();
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << VALIDITY_CACHES_DUMP_VERSION;
+    ss << FLATDATA(Params().MessageStart());
+    ss << caches;
+    uint256 hash = Hash(ss.begin(), ss.end());
+    ss << hash;
+
+    fs::path pathTmp = GetDataDir() / "validitycaches.dat.new";
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+    }
+    try {
+        fileout << ss;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, GetDataDir() / "validitycaches.dat")) {
+        return error("%s: Rename-into-place failed", __func__);
+    }
+
+    size_t nEntries = 0;
+    for (const auto& entry : caches) nEntries += entry.second.entries.size();
+    LogPrintf("Dumped %u validity cache entries: %.fms\n", nEntries, (GetTimeMicros() - nStart) * 0.001);
+    return true;
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
-    if (signatureCache.Get(entry, !store))
+    if (signatureCache.Get(entry, !store)) {
+        signatureCache.nHits.fetch_add(1, std::memory_order_relaxed);
         return true;
+    }
+    signatureCache.nMisses.fetch_add(1, std::memory_order_relaxed);
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
     if (store)
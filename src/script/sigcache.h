@@ -50,6 +50,25 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Default for -persistvaliditycaches */
+static const bool DEFAULT_PERSIST_VALIDITY_CACHES = true;
+/** Kind under which the signature cache is saved, next to the Sapling and Orchard bundle caches */
+static const char* const SIGNATURE_CACHE_KIND = "Transparent";
+
 void InitSignatureCache(size_t nMaxCacheSize);
 
+/** Signature checks answered from the cache, and those that were not */
+void GetSignatureCacheStats(uint64_t& nHits, uint64_t& nMisses);
+
+/** Memory allocated for the signature cache, in bytes */
+size_t GetSignatureCacheMemoryUsage();
+
+/**
+ * Read the validity caches saved by DumpValidityCaches, for the signature and
+ * bundle caches to restore as they are created. Call before creating them.
+ */
+bool LoadValidityCaches();
+/** Save the signature and bundle validity caches. Call once validation has stopped. */
+bool DumpValidityCaches();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -1052,6 +1052,85 @@ inline void SerReadWrite(Stream& s, T& obj, CSerActionUnserialize ser_action)
 
 
 
+/**
+ * Streams over a stack buffer for types that always serialize to the same
+ * number of bytes. The fields are copied into the buffer without any growth
+ * or bounds checks, and the buffer goes to the real stream in one write() or
+ * read() call. See ADD_FIXED_SIZE_SERIALIZE_METHODS.
+ */
+template<size_t N>
+class CFixedSizeWriter
+{
+private:
+    char buf[N];
+    size_t pos = 0;
+
+public:
+    void write(const char* pch, size_t nSize)
+    {
+        memcpy(buf + pos, pch, nSize);
+        pos += nSize;
+    }
+
+    template<typename Stream>
+    void WriteTo(Stream& s) const
+    {
+        assert(pos == N);
+        s.write(buf, N);
+    }
+};
+
+template<size_t N>
+class CFixedSizeReader
+{
+private:
+    char buf[N];
+    size_t pos = 0;
+
+public:
+    template<typename Stream>
+    explicit CFixedSizeReader(Stream& s)
+    {
+        s.read(buf, N);
+    }
+
+    void read(char* pch, size_t nSize)
+    {
+        memcpy(pch, buf + pos, nSize);
+        pos += nSize;
+    }
+
+    ~CFixedSizeReader()
+    {
+        assert(pos == N);
+    }
+};
+
+/**
+ * Like ADD_SERIALIZE_METHODS, for classes whose serialization is always the
+ * given number of bytes. The SerializationOp may only use types that write
+ * through the stream's write() and read() methods, such as integers and
+ * uint256, since the buffer streams have no type or version.
+ */
+#define ADD_FIXED_SIZE_SERIALIZE_METHODS(size)                        \
+    static constexpr size_t SERIALIZED_SIZE = size;                   \
+    template<typename Stream>                                         \
+    void Serialize(Stream& s) const {                                 \
+        CFixedSizeWriter<SERIALIZED_SIZE> w;                          \
+        NCONST_PTR(this)->SerializationOp(w, CSerActionSerialize());  \
+        w.WriteTo(s);                                                 \
+    }                                                                 \
+    void Serialize(CSizeComputer& s) const {                          \
+        s.seek(SERIALIZED_SIZE);                                      \
+    }                                                                 \
+    template<typename Stream>                                         \
+    void Unserialize(Stream& s) {                                     \
+        CFixedSizeReader<SERIALIZED_SIZE> r(s);                       \
+        SerializationOp(r, CSerActionUnserialize());                  \
+    }
+
+
+
 
 
 
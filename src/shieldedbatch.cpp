@@ -0,0 +1,148 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "shieldedbatch.h"
+
+#include "util/system.h"
+#include "util/time.h"
+
+#include <algorithm>
+#include <optional>
+
+#include <rust/bridge.h>
+
+CShieldedBatchVerifier::CShieldedBatchVerifier(
+        size_t nMaxBatchIn, std::chrono::microseconds windowIn, std::function<void()> notifyIn) :
+    nMaxBatch(std::max<size_t>(nMaxBatchIn, 1)), window(windowIn), notify(notifyIn), fShutdown(false)
+{
+    verifier = std::thread(&CShieldedBatchVerifier::ThreadVerify, this);
+}
+
+CShieldedBatchVerifier::~CShieldedBatchVerifier()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fShutdown = true;
+    }
+    cond.notify_all();
+    // The verifier finishes the checks already submitted before it exits.
+    verifier.join();
+}
+
+void CShieldedBatchVerifier::Submit(std::shared_ptr<CShieldedAuthCheck> check)
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (vQueue.empty())
+            queueStart = std::chrono::steady_clock::now();
+        vQueue.push_back(std::move(check));
+    }
+    cond.notify_one();
+}
+
+void CShieldedBatchVerifier::ThreadVerify()
+{
+    RenameThread("zc-batchverify");
+    while (true) {
+        std::vector<std::shared_ptr<CShieldedAuthCheck>> vBatch;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [&]() { return fShutdown || !vQueue.empty(); });
+            if (vQueue.empty()) return;
+            // Give other transactions until the end of the window opened by
+            // the oldest one to join the batch.
+            cond.wait_until(lock, queueStart + window, [&]() { return fShutdown || vQueue.size() >= nMaxBatch; });
+            if (vQueue.size() <= nMaxBatch) {
+                vBatch.swap(vQueue);
+            } else {
+                vBatch.assign(vQueue.begin(), vQueue.begin() + nMaxBatch);
+                vQueue.erase(vQueue.begin(), vQueue.begin() + nMaxBatch);
+                queueStart = std::chrono::steady_clock::now();
+            }
+        }
+        VerifyBatch(vBatch);
+        notify();
+    }
+}
+
+// Verify one transaction's Sapling and/or Orchard authorization on its own.
+// Its Sapling bundle is already known to pass the checks made while queueing.
+static void VerifyAlone(const CShieldedAuthCheck& check, CValidationState& state, bool fSapling, bool fOrchard)
+{
+    if (fSapling) {
+        rust::Box<sapling::BatchValidator> saplingAuth = sapling::init_batch_validator(true);
+        check.tx.GetSaplingBundle().QueueAuthValidation(*saplingAuth, check.dataToBeSigned);
+        if (!saplingAuth->validate()) {
+            state.DoS(100, false, REJECT_INVALID, "bad-sapling-bundle-authorization");
+            return;
+        }
+    }
+    if (fOrchard) {
+        rust::Box<orchard::BatchValidator> orchardAuth = orchard::init_batch_validator(true);
+        check.tx.GetOrchardBundle().QueueAuthValidation(*orchardAuth, check.dataToBeSigned);
+        if (!orchardAuth->validate()) {
+            state.DoS(100, false, REJECT_INVALID, "bad-orchard-bundle-authorization");
+        }
+    }
+}
+
+void CShieldedBatchVerifier::VerifyBatch(const std::vector<std::shared_ptr<CShieldedAuthCheck>>& checks)
+{
+    int64_t nStart = GetThreadCPUTimeMicros();
+    std::vector<CShieldedAuthCheck*> vPending;
+    for (const auto& check : checks) {
+        vPending.push_back(check.get());
+    }
+
+    // A Sapling bundle that breaks the consensus rules checked while it is
+    // queued may already be partly in the batch, which then must not be
+    // validated. Reject those bundles and build the batch again without them.
+    std::optional<rust::Box<sapling::BatchValidator>> saplingAuth;
+    while (true) {
+        saplingAuth = sapling::init_batch_validator(true);
+        std::vector<CShieldedAuthCheck*> vQueued;
+        for (CShieldedAuthCheck* check : vPending) {
+            if (check->tx.GetSaplingBundle().QueueAuthValidation(*saplingAuth.value(), check->dataToBeSigned)) {
+                vQueued.push_back(check);
+            } else {
+                check->state.DoS(check->nDoS, false, REJECT_INVALID, "bad-txns-sapling-bundle-invalid");
+            }
+        }
+        bool fRejected = vQueued.size() < vPending.size();
+        vPending.swap(vQueued);
+        if (!fRejected) break;
+    }
+
+    rust::Box<orchard::BatchValidator> orchardAuth = orchard::init_batch_validator(true);
+    for (CShieldedAuthCheck* check : vPending) {
+        check->tx.GetOrchardBundle().QueueAuthValidation(*orchardAuth, check->dataToBeSigned);
+    }
+
+    bool fSaplingOk = saplingAuth.value()->validate();
+    bool fOrchardOk = orchardAuth->validate();
+
+    // The batch is shared evenly between its checks.
+    int64_t nShare = (GetThreadCPUTimeMicros() - nStart) / (int64_t)std::max<size_t>(checks.size(), 1);
+    for (const auto& check : checks) {
+        check->nVerifyTime = nShare;
+    }
+    if (vPending.size() == 1) {
+        if (!fSaplingOk) {
+            vPending[0]->state.DoS(100, false, REJECT_INVALID, "bad-sapling-bundle-authorization");
+        } else if (!fOrchardOk) {
+            vPending[0]->state.DoS(100, false, REJECT_INVALID, "bad-orchard-bundle-authorization");
+        }
+    } else if (!fSaplingOk || !fOrchardOk) {
+        // Only the pools whose batch failed need to be verified again.
+        for (CShieldedAuthCheck* check : vPending) {
+            int64_t nCheckStart = GetThreadCPUTimeMicros();
+            VerifyAlone(*check, check->state, !fSaplingOk, !fOrchardOk);
+            check->nVerifyTime += GetThreadCPUTimeMicros() - nCheckStart;
+        }
+    }
+
+    for (const auto& check : checks) {
+        check->fDone.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SHIELDEDBATCH_H
+#define BITCOIN_SHIELDEDBATCH_H
+
+#include "consensus/validation.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Default for -mempoolbatchsize, the most transactions whose proofs are verified in one batch */
+static const unsigned int DEFAULT_MEMPOOL_BATCH_SIZE = 64;
+/** Default for -mempoolbatchwindow, how long in milliseconds a batch waits for more transactions */
+static const unsigned int DEFAULT_MEMPOOL_BATCH_WINDOW = 5;
+
+/**
+ * The Sapling and Orchard authorization (proofs and signatures) of a loose
+ * transaction, waiting to be verified by a CShieldedBatchVerifier.
+ */
+class CShieldedAuthCheck
+{
+public:
+    const CTransaction tx;
+    //! The consensus branch dataToBeSigned was computed for.
+    const uint32_t consensusBranchId;
+    const uint256 dataToBeSigned;
+    //! DoS score for a bundle that breaks the Sapling consensus rules.
+    const int nDoS;
+
+    CShieldedAuthCheck(const CTransaction& txIn, uint32_t consensusBranchIdIn,
+                       const uint256& dataToBeSignedIn, int nDoSIn) :
+        tx(txIn), consensusBranchId(consensusBranchIdIn),
+        dataToBeSigned(dataToBeSignedIn), nDoS(nDoSIn), fDone(false), nVerifyTime(0) {}
+
+    bool IsDone() const { return fDone.load(std::memory_order_acquire); }
+    //! The result of the check. Only meaningful once IsDone() returns true.
+    bool IsValid() const { return state.IsValid(); }
+    const CValidationState& GetState() const { return state; }
+    //! The CPU time (in microseconds) this check took, including its share
+    //! of its batch. Only meaningful once IsDone() returns true.
+    int64_t GetVerifyTime() const { return nVerifyTime; }
+
+private:
+    friend class CShieldedBatchVerifier;
+
+    std::atomic<bool> fDone;
+    CValidationState state;
+    int64_t nVerifyTime;
+};
+
+/**
+ * Verifies the shielded authorization of loose transactions in batches.
+ *
+ * Checks submitted within a short window of each other, or until the batch
+ * is full, are queued into one sapling::BatchValidator and one
+ * orchard::BatchValidator, which is much cheaper per transaction than
+ * validating each of them on its own. If a batch fails, its transactions are
+ * verified one at a time to find the invalid ones.
+ *
+ * Checks are verified on a thread owned by this object, which calls notify
+ * after finishing each batch.
+ */
+class CShieldedBatchVerifier
+{
+private:
+    const size_t nMaxBatch;
+    const std::chrono::microseconds window;
+    const std::function<void()> notify;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Checks not yet picked up by the verifier thread. Guarded by cs.
+    std::vector<std::shared_ptr<CShieldedAuthCheck>> vQueue;
+    //! When the oldest check in vQueue was submitted. Guarded by cs.
+    std::chrono::steady_clock::time_point queueStart;
+    bool fShutdown;
+    std::thread verifier;
+
+    void ThreadVerify();
+
+public:
+    CShieldedBatchVerifier(size_t nMaxBatchIn, std::chrono::microseconds windowIn, std::function<void()> notifyIn);
+    ~CShieldedBatchVerifier();
+
+    CShieldedBatchVerifier(const CShieldedBatchVerifier&) = delete;
+    CShieldedBatchVerifier& operator=(const CShieldedBatchVerifier&) = delete;
+
+    void Submit(std::shared_ptr<CShieldedAuthCheck> check);
+
+    /** Verify the checks as one batch and mark them as done. */
+    static void VerifyBatch(const std::vector<std::shared_ptr<CShieldedAuthCheck>>& checks);
+};
+
+#endif // BITCOIN_SHIELDEDBATCH_H
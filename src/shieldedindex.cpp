@@ -0,0 +1,44 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "shieldedindex.h"
+
+#include <algorithm>
+
+CCompactShieldedBlock BuildCompactShieldedBlock(const CBlock& block)
+{
+    CCompactShieldedBlock compact;
+    compact.vtx.reserve(block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        CCompactShieldedTx ctx;
+        ctx.txid = tx.GetHash();
+        ctx.fOtherShielded = !tx.vJoinSplit.empty() ||
+            tx.GetSaplingSpendsCount() > 0 ||
+            tx.GetSaplingOutputsCount() > 0;
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                ctx.vTransparentIn.push_back(txin.prevout);
+            }
+        }
+        for (const CTxOut& txout : tx.vout) {
+            ctx.vTransparentOut.push_back(txout.scriptPubKey);
+        }
+        if (tx.GetOrchardBundle().IsPresent()) {
+            for (const auto& action : tx.GetOrchardBundle().GetDetails()->actions()) {
+                CCompactOrchardAction caction;
+                auto nullifier = action.nullifier();
+                auto cmx = action.cmx();
+                auto ephemeralKey = action.ephemeral_key();
+                auto encCiphertext = action.enc_ciphertext();
+                std::copy(nullifier.begin(), nullifier.end(), caction.nullifier);
+                std::copy(cmx.begin(), cmx.end(), caction.cmx);
+                std::copy(ephemeralKey.begin(), ephemeralKey.end(), caction.ephemeralKey);
+                std::copy(encCiphertext.begin(), encCiphertext.begin() + sizeof(caction.encCiphertext), caction.encCiphertext);
+                ctx.vActions.push_back(caction);
+            }
+        }
+        compact.vtx.push_back(std::move(ctx));
+    }
+    return compact;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_SHIELDEDINDEX_H
+#define BITCOIN_SHIELDEDINDEX_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include "rust/orchard/wallet.h"
+
+#include <vector>
+
+/**
+ * The parts of an Orchard action that trial decryption and the note commitment
+ * tree need, as lightwalletd's compact blocks carry them. This is about a sixth
+ * of the size of the action, and leaves out the bundle's proof altogether.
+ */
+struct CCompactOrchardAction : public RawOrchardCompactAction
+{
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(FLATDATA(nullifier));
+        READWRITE(FLATDATA(cmx));
+        READWRITE(FLATDATA(ephemeralKey));
+        READWRITE(FLATDATA(encCiphertext));
+    }
+};
+static_assert(
+    sizeof(CCompactOrchardAction) == sizeof(RawOrchardCompactAction),
+    "CCompactOrchardAction must be passable to Rust as an array of RawOrchardCompactAction.");
+
+/**
+ * What the wallet needs from one transaction to tell whether a block can
+ * involve it without reading the block: the transparent prevouts and scripts,
+ * and the compact Orchard actions. Transactions with Sprout or Sapling parts
+ * are only flagged, as the wallet reads those in full.
+ */
+struct CCompactShieldedTx
+{
+    uint256 txid;
+    bool fOtherShielded;
+    std::vector<COutPoint> vTransparentIn;
+    std::vector<CScript> vTransparentOut;
+    std::vector<CCompactOrchardAction> vActions;
+
+    CCompactShieldedTx() : fOtherShielded(false) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(fOtherShielded);
+        READWRITE(vTransparentIn);
+        READWRITE(vTransparentOut);
+        READWRITE(vActions);
+    }
+};
+
+/** The compact form of every transaction in a block, in block order. */
+struct CCompactShieldedBlock
+{
+    std::vector<CCompactShieldedTx> vtx;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vtx);
+    }
+};
+
+/** Build the shielded index entry for a block. */
+CCompactShieldedBlock BuildCompactShieldedBlock(const CBlock& block);
+
+#endif // BITCOIN_SHIELDEDINDEX_H
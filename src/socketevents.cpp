@@ -0,0 +1,232 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "socketevents.h"
+
+#include "netbase.h"
+#include "util/time.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_EVENT_H
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+/** The most events collected by one epoll_wait() or kevent() call. Any others are left for the next. */
+static const int MAX_SOCKET_EVENTS = 1024;
+
+class CSelectSocketEvents : public CSocketEvents
+{
+private:
+    struct WatchedSocket {
+        SOCKET hSocket;
+        int64_t tag;
+    };
+
+    std::vector<WatchedSocket> vWatched;
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    SOCKET hSocketMax;
+
+    void Reset()
+    {
+        vWatched.clear();
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        hSocketMax = 0;
+    }
+
+public:
+    CSelectSocketEvents() { Reset(); }
+
+    SocketEventsMode Mode() const override { return SocketEventsMode::Select; }
+
+    bool Register(SOCKET hSocket, int64_t tag) override
+    {
+        return IsSelectableSocket(hSocket);
+    }
+
+    void Watch(SOCKET hSocket, int64_t tag, bool fRecv, bool fSend) override
+    {
+        if (!IsSelectableSocket(hSocket))
+            return;
+        vWatched.push_back({hSocket, tag});
+        FD_SET(hSocket, &fdsetError);
+        if (fRecv)
+            FD_SET(hSocket, &fdsetRecv);
+        if (fSend)
+            FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<SocketEvent>& events) override
+    {
+        events.clear();
+        if (vWatched.empty()) {
+            MilliSleep(nTimeout);
+            return true;
+        }
+
+        struct timeval timeout = MillisToTimeval(nTimeout);
+        bool fOk = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout) != SOCKET_ERROR;
+        for (const WatchedSocket& watched : vWatched) {
+            // After an error, report every socket as readable so that recv()
+            // finds any that failed.
+            bool fRecv = !fOk || FD_ISSET(watched.hSocket, &fdsetRecv) || FD_ISSET(watched.hSocket, &fdsetError);
+            bool fSend = fOk && FD_ISSET(watched.hSocket, &fdsetSend);
+            if (fRecv || fSend)
+                events.push_back({watched.tag, fRecv, fSend});
+        }
+        Reset();
+        return fOk;
+    }
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+class CEpollSocketEvents : public CSocketEvents
+{
+private:
+    int fdEpoll;
+    std::vector<struct epoll_event> vReady;
+
+public:
+    explicit CEpollSocketEvents(int fdEpollIn) : fdEpoll(fdEpollIn), vReady(MAX_SOCKET_EVENTS) {}
+    ~CEpollSocketEvents() { close(fdEpoll); }
+
+    SocketEventsMode Mode() const override { return SocketEventsMode::Epoll; }
+
+    bool Register(SOCKET hSocket, int64_t tag) override
+    {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = tag;
+        return epoll_ctl(fdEpoll, EPOLL_CTL_ADD, hSocket, &ev) == 0;
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<SocketEvent>& events) override
+    {
+        events.clear();
+        int nReady = epoll_wait(fdEpoll, vReady.data(), vReady.size(), nTimeout);
+        if (nReady < 0)
+            return errno == EINTR;
+        for (int i = 0; i < nReady; i++) {
+            uint32_t flags = vReady[i].events;
+            events.push_back({
+                (int64_t)vReady[i].data.u64,
+                (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0,
+                (flags & EPOLLOUT) != 0});
+        }
+        return true;
+    }
+};
+#endif
+
+#ifdef HAVE_SYS_EVENT_H
+class CKqueueSocketEvents : public CSocketEvents
+{
+private:
+    int fdKqueue;
+    std::vector<struct kevent> vReady;
+
+public:
+    explicit CKqueueSocketEvents(int fdKqueueIn) : fdKqueue(fdKqueueIn), vReady(MAX_SOCKET_EVENTS) {}
+    ~CKqueueSocketEvents() { close(fdKqueue); }
+
+    SocketEventsMode Mode() const override { return SocketEventsMode::Kqueue; }
+
+    bool Register(SOCKET hSocket, int64_t tag) override
+    {
+        struct kevent changes[2];
+        EV_SET(&changes[0], hSocket, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, (void*)(intptr_t)tag);
+        EV_SET(&changes[1], hSocket, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, (void*)(intptr_t)tag);
+        return kevent(fdKqueue, changes, 2, nullptr, 0, nullptr) == 0;
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<SocketEvent>& events) override
+    {
+        events.clear();
+        struct timespec timeout;
+        timeout.tv_sec = nTimeout / 1000;
+        timeout.tv_nsec = (nTimeout % 1000) * 1000000;
+        int nReady = kevent(fdKqueue, nullptr, 0, vReady.data(), vReady.size(), &timeout);
+        if (nReady < 0)
+            return errno == EINTR;
+        // The read and write filters of a socket are reported separately.
+        for (int i = 0; i < nReady; i++) {
+            bool fSend = vReady[i].filter == EVFILT_WRITE && !(vReady[i].flags & EV_ERROR);
+            events.push_back({(int64_t)(intptr_t)vReady[i].udata, !fSend, fSend});
+        }
+        return true;
+    }
+};
+#endif
+
+std::vector<SocketEventsMode> GetSupportedSocketEventsModes()
+{
+    std::vector<SocketEventsMode> modes;
+#ifdef HAVE_SYS_EPOLL_H
+    modes.push_back(SocketEventsMode::Epoll);
+#endif
+#ifdef HAVE_SYS_EVENT_H
+    modes.push_back(SocketEventsMode::Kqueue);
+#endif
+    modes.push_back(SocketEventsMode::Select);
+    return modes;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SocketEventsMode::Select:
+        return "select";
+    case SocketEventsMode::Epoll:
+        return "epoll";
+    case SocketEventsMode::Kqueue:
+        return "kqueue";
+    }
+    assert(false);
+}
+
+std::optional<SocketEventsMode> ParseSocketEventsMode(const std::string& name)
+{
+    for (SocketEventsMode mode : GetSupportedSocketEventsModes()) {
+        if (GetSocketEventsModeName(mode) == name)
+            return mode;
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<CSocketEvents> MakeSocketEvents(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SocketEventsMode::Select:
+        return std::make_unique<CSelectSocketEvents>();
+    case SocketEventsMode::Epoll:
+#ifdef HAVE_SYS_EPOLL_H
+    {
+        int fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (fdEpoll >= 0)
+            return std::make_unique<CEpollSocketEvents>(fdEpoll);
+    }
+#endif
+        break;
+    case SocketEventsMode::Kqueue:
+#ifdef HAVE_SYS_EVENT_H
+    {
+        int fdKqueue = kqueue();
+        if (fdKqueue >= 0)
+            return std::make_unique<CKqueueSocketEvents>(fdKqueue);
+    }
+#endif
+        break;
+    }
+    return nullptr;
+}
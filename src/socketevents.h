@@ -0,0 +1,69 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_SOCKETEVENTS_H
+#define BITCOIN_SOCKETEVENTS_H
+
+#include "compat.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/** The ways ThreadSocketHandler can wait for sockets to become ready. */
+enum class SocketEventsMode {
+    Select,
+    Epoll,
+    Kqueue,
+};
+
+/** A watched socket that has become ready, identified by its tag. */
+struct SocketEvent {
+    int64_t tag;
+    bool fRecv;
+    bool fSend;
+};
+
+/**
+ * Waits for watched sockets to become ready.
+ *
+ * Events are edge triggered: a socket is reported when it becomes readable or
+ * writable, and the caller must treat it as ready in that direction until an
+ * operation on it would block. A socket is registered once, and stops being
+ * watched when it is closed.
+ *
+ * select() is level triggered, and has no registration. Its backend instead
+ * watches the directions passed to Watch() since the last Wait(), which the
+ * caller limits to those it does not already know to be ready.
+ */
+class CSocketEvents
+{
+public:
+    virtual ~CSocketEvents() {}
+
+    virtual SocketEventsMode Mode() const = 0;
+
+    /** Start watching hSocket, reporting its events with the given tag. */
+    virtual bool Register(SOCKET hSocket, int64_t tag) = 0;
+
+    /** Watch hSocket for the next Wait() only. Ignored by edge triggered backends. */
+    virtual void Watch(SOCKET hSocket, int64_t tag, bool fRecv, bool fSend) {}
+
+    /**
+     * Wait up to nTimeout milliseconds for sockets to become ready, replacing
+     * the contents of events with them. Returns false on error.
+     */
+    virtual bool Wait(int64_t nTimeout, std::vector<SocketEvent>& events) = 0;
+};
+
+/** The modes supported on this platform, most scalable first. */
+std::vector<SocketEventsMode> GetSupportedSocketEventsModes();
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+std::optional<SocketEventsMode> ParseSocketEventsMode(const std::string& name);
+
+/** Returns nullptr if the backend could not be created. */
+std::unique_ptr<CSocketEvents> MakeSocketEvents(SocketEventsMode mode);
+
+#endif // BITCOIN_SOCKETEVENTS_H
@@ -0,0 +1,484 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "stratum.h"
+
+#ifdef ENABLE_MINING
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "crypto/randomx_wrapper.h"
+#include "main.h"
+#include "miner.h"
+#include "netbase.h"
+#include "pow.h"
+#include "random.h"
+#include "streams.h"
+#include "util/strencodings.h"
+#include "util/system.h"
+
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include <boost/thread.hpp>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+#include <event2/util.h>
+
+#include <univalue.h>
+
+/** Maximum length of a request line; anything longer is a misbehaving client */
+static const size_t MAX_STRATUM_LINE_LENGTH = 16 * 1024;
+/** Maximum number of connected miners */
+static const size_t MAX_STRATUM_CLIENTS = 1024;
+/** Number of jobs for the current tip that still accept shares */
+static const size_t MAX_STRATUM_JOBS = 4;
+/** Size of the RandomX input: header prefix and nonce */
+static const size_t STRATUM_HEADER_SIZE = 108;
+static const size_t STRATUM_INPUT_SIZE = STRATUM_HEADER_SIZE + 32;
+
+namespace {
+
+struct StratumJob {
+    std::string strId;
+    int nHeight;
+    std::shared_ptr<const CBlockTemplate> ptemplate;  //!< Shared with the miner, never modified
+    unsigned char header[STRATUM_HEADER_SIZE];
+    uint256 seedHash;
+    arith_uint256 blockTarget;
+    arith_uint256 shareTarget;
+    std::set<uint256> setNonces;  //!< Nonces already submitted for this job
+};
+
+struct StratumClient {
+    std::string strPeer;
+    uint32_t nExtraNonce;
+    bool fLoggedIn;
+};
+
+// Everything below is only touched from the Stratum thread, except where noted
+struct event_base* gBase = nullptr;
+struct evconnlistener* gListener = nullptr;
+boost::thread stratumThread;
+const CChainParams* gChainParams = nullptr;
+arith_uint256 gShareLimit;
+
+std::map<struct bufferevent*, StratumClient> mapClients;
+std::deque<std::shared_ptr<StratumJob>> gJobs;  // oldest first
+uint64_t nNextJobId = 0;
+uint32_t nNextExtraNonce = 0;
+
+// Raised from the template updater thread when a new template is published
+std::mutex cs_jobEvent;
+struct event* gJobEvent = nullptr;
+boost::signals2::connection gTemplateConnection;
+
+uint64_t nSharesAccepted = 0;
+uint64_t nSharesRejected = 0;
+
+void Send(struct bufferevent* bev, const UniValue& msg)
+{
+    std::string str = msg.write() + "\n";
+    evbuffer_add(bufferevent_get_output(bev), str.data(), str.size());
+}
+
+void SendResult(struct bufferevent* bev, const UniValue& id, const UniValue& result)
+{
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("id", id);
+    reply.pushKV("jsonrpc", "2.0");
+    reply.pushKV("error", NullUniValue);
+    reply.pushKV("result", result);
+    Send(bev, reply);
+}
+
+void SendError(struct bufferevent* bev, const UniValue& id, const std::string& message)
+{
+    UniValue error(UniValue::VOBJ);
+    error.pushKV("code", -1);
+    error.pushKV("message", message);
+
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("id", id);
+    reply.pushKV("jsonrpc", "2.0");
+    reply.pushKV("error", error);
+    reply.pushKV("result", NullUniValue);
+    Send(bev, reply);
+}
+
+std::string SessionId(const StratumClient& client)
+{
+    return strprintf("%08x", client.nExtraNonce);
+}
+
+UniValue JobToJSON(const StratumJob& job, const StratumClient& client)
+{
+    unsigned char input[STRATUM_INPUT_SIZE] = {};
+    memcpy(input, job.header, STRATUM_HEADER_SIZE);
+    WriteLE32(input + STRATUM_HEADER_SIZE, client.nExtraNonce);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("job_id", job.strId);
+    obj.pushKV("blob", HexStr(input, input + STRATUM_INPUT_SIZE));
+    obj.pushKV("target", ArithToUint256(job.shareTarget).GetHex());
+    obj.pushKV("height", job.nHeight);
+    obj.pushKV("seed_hash", HexStr(job.seedHash.begin(), job.seedHash.end()));
+    obj.pushKV("algo", "rx/juno");
+    return obj;
+}
+
+void Disconnect(struct bufferevent* bev)
+{
+    auto it = mapClients.find(bev);
+    if (it != mapClients.end()) {
+        LogPrint("stratum", "Stratum: %s disconnected\n", it->second.strPeer);
+        mapClients.erase(it);
+    }
+    bufferevent_free(bev);
+}
+
+// Turn the shared block template into a job and push it to every miner
+void UpdateJob()
+{
+    std::shared_ptr<const CBlockTemplate> ptemplate;
+    int nHeight;
+    if (!GetSharedBlockTemplate(ptemplate, nHeight))
+        return;
+    const CBlock& block = ptemplate->block;
+
+    uint256 seedHash;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+        if (mi == mapBlockIndex.end() || !GetRandomXSeedHash(mi->second, nHeight, seedHash))
+            return;
+    }
+
+    CEquihashInput I{block};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << I;
+    if (ss.size() != STRATUM_HEADER_SIZE) {
+        LogPrintf("Stratum: ERROR - Header size is %d, expected %d bytes\n", ss.size(), STRATUM_HEADER_SIZE);
+        return;
+    }
+
+    // Shares for older tips can never become blocks
+    if (!gJobs.empty() && gJobs.back()->ptemplate->block.hashPrevBlock != block.hashPrevBlock) {
+        gJobs.clear();
+    }
+
+    auto job = std::make_shared<StratumJob>();
+    job->strId = strprintf("%x", nNextJobId++);
+    job->nHeight = nHeight;
+    job->ptemplate = ptemplate;
+    memcpy(job->header, ss.data(), STRATUM_HEADER_SIZE);
+    job->seedHash = seedHash;
+    job->blockTarget.SetCompact(block.nBits);
+    job->shareTarget = std::max(gShareLimit, job->blockTarget);
+
+    gJobs.push_back(job);
+    while (gJobs.size() > MAX_STRATUM_JOBS) {
+        gJobs.pop_front();
+    }
+
+    for (const auto& entry : mapClients) {
+        if (!entry.second.fLoggedIn) continue;
+        UniValue notify(UniValue::VOBJ);
+        notify.pushKV("jsonrpc", "2.0");
+        notify.pushKV("method", "job");
+        notify.pushKV("params", JobToJSON(*job, entry.second));
+        Send(entry.first, notify);
+    }
+    LogPrint("stratum", "Stratum: New job %s for height %d sent to %u miners\n",
+             job->strId, nHeight, mapClients.size());
+}
+
+void jobcb(evutil_socket_t, short, void*)
+{
+    UpdateJob();
+}
+
+void TemplateChanged()
+{
+    std::lock_guard<std::mutex> lock(cs_jobEvent);
+    if (gJobEvent) {
+        event_active(gJobEvent, 0, 0);
+    }
+}
+
+// Check a share and, if it meets the block target, submit the block.
+// Returns an error message, or an empty string if the share is accepted.
+std::string ProcessSubmit(const StratumClient& client, const UniValue& params)
+{
+    const UniValue& jobId = find_value(params, "job_id");
+    const UniValue& nonceHex = find_value(params, "nonce");
+    if (!jobId.isStr() || !nonceHex.isStr())
+        return "Missing job_id or nonce";
+
+    std::shared_ptr<StratumJob> job;
+    for (const auto& candidate : gJobs) {
+        if (candidate->strId == jobId.get_str()) job = candidate;
+    }
+    if (!job)
+        return "Stale job";
+
+    std::vector<unsigned char> vNonce = ParseHex(nonceHex.get_str());
+    if (vNonce.size() != 32 || !IsHex(nonceHex.get_str()))
+        return "Invalid nonce";
+    if (ReadLE32(vNonce.data()) != client.nExtraNonce)
+        return "Nonce does not start with the session extranonce";
+
+    uint256 nonce;
+    memcpy(nonce.begin(), vNonce.data(), 32);
+    if (!job->setNonces.insert(nonce).second)
+        return "Duplicate share";
+
+    unsigned char input[STRATUM_INPUT_SIZE];
+    memcpy(input, job->header, STRATUM_HEADER_SIZE);
+    memcpy(input + STRATUM_HEADER_SIZE, nonce.begin(), 32);
+    uint256 hash;
+    if (!GetPoWHash(gChainParams->GetConsensus(), job->seedHash, input, sizeof(input), hash))
+        return "Could not verify share";
+
+    arith_uint256 hashValue = UintToArith256(hash);
+    if (hashValue > job->shareTarget)
+        return "Low difficulty share";
+
+    if (hashValue <= job->blockTarget) {
+        CBlock block = job->ptemplate->block;
+        block.nNonce = nonce;
+        block.nSolution.assign(hash.begin(), hash.end());
+        LogPrintf("Stratum: %s found block at height %d\n", client.strPeer, job->nHeight);
+        ProcessBlockFound(&block, *gChainParams);
+    }
+    return "";
+}
+
+void HandleRequest(struct bufferevent* bev, StratumClient& client, const UniValue& request)
+{
+    const UniValue& id = find_value(request, "id");
+    const UniValue& method = find_value(request, "method");
+    const UniValue& params = find_value(request, "params");
+    if (!method.isStr()) {
+        SendError(bev, id, "Missing method");
+        return;
+    }
+
+    const std::string& strMethod = method.get_str();
+    if (strMethod == "login") {
+        client.fLoggedIn = true;
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("id", SessionId(client));
+        if (!gJobs.empty()) {
+            result.pushKV("job", JobToJSON(*gJobs.back(), client));
+        }
+        result.pushKV("status", "OK");
+        SendResult(bev, id, result);
+        LogPrint("stratum", "Stratum: %s logged in as session %s\n", client.strPeer, SessionId(client));
+    } else if (!client.fLoggedIn) {
+        SendError(bev, id, "Unauthenticated");
+    } else if (strMethod == "getjob") {
+        if (gJobs.empty()) {
+            SendError(bev, id, "No job available");
+        } else {
+            SendResult(bev, id, JobToJSON(*gJobs.back(), client));
+        }
+    } else if (strMethod == "submit") {
+        std::string strError = params.isObject() ? ProcessSubmit(client, params) : "Invalid params";
+        if (strError.empty()) {
+            nSharesAccepted++;
+            UniValue result(UniValue::VOBJ);
+            result.pushKV("status", "OK");
+            SendResult(bev, id, result);
+        } else {
+            nSharesRejected++;
+            LogPrint("stratum", "Stratum: Rejected share from %s: %s\n", client.strPeer, strError);
+            SendError(bev, id, strError);
+        }
+    } else if (strMethod == "keepalived") {
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("status", "KEEPALIVED");
+        SendResult(bev, id, result);
+    } else {
+        SendError(bev, id, "Unknown method");
+    }
+}
+
+void readcb(struct bufferevent* bev, void*)
+{
+    auto it = mapClients.find(bev);
+    if (it == mapClients.end()) return;
+
+    struct evbuffer* input = bufferevent_get_input(bev);
+    size_t n_read_out = 0;
+    char* line;
+    while ((line = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF)) != nullptr) {
+        std::string s(line, n_read_out);
+        free(line);
+        if (s.empty()) continue;
+
+        UniValue request;
+        if (!request.read(s) || !request.isObject()) {
+            LogPrint("stratum", "Stratum: Disconnecting %s after malformed request\n", it->second.strPeer);
+            Disconnect(bev);
+            return;
+        }
+        HandleRequest(bev, it->second, request);
+    }
+
+    // Everything left is an incomplete line
+    if (evbuffer_get_length(input) > MAX_STRATUM_LINE_LENGTH) {
+        LogPrint("stratum", "Stratum: Disconnecting %s because MAX_STRATUM_LINE_LENGTH exceeded\n", it->second.strPeer);
+        Disconnect(bev);
+    }
+}
+
+void eventcb(struct bufferevent* bev, short what, void*)
+{
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+        Disconnect(bev);
+    }
+}
+
+void acceptcb(struct evconnlistener*, evutil_socket_t fd, struct sockaddr* addr, int, void*)
+{
+    CService peer;
+    peer.SetSockAddr(addr);
+    if (mapClients.size() >= MAX_STRATUM_CLIENTS) {
+        LogPrint("stratum", "Stratum: Refusing %s, too many miners connected\n", peer.ToStringIPPort());
+        evutil_closesocket(fd);
+        return;
+    }
+
+    struct bufferevent* bev = bufferevent_socket_new(gBase, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (!bev) {
+        evutil_closesocket(fd);
+        return;
+    }
+
+    StratumClient& client = mapClients[bev];
+    client.strPeer = peer.ToStringIPPort();
+    client.nExtraNonce = nNextExtraNonce++;
+    client.fLoggedIn = false;
+
+    bufferevent_setcb(bev, readcb, nullptr, eventcb, nullptr);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+    LogPrint("stratum", "Stratum: %s connected\n", client.strPeer);
+}
+
+void StratumThread()
+{
+    // Pick up a template published before the server started
+    UpdateJob();
+    event_base_dispatch(gBase);
+}
+
+} // namespace
+
+bool StartStratumServer(const CChainParams& chainparams)
+{
+    int nPort = GetArg("-stratumport", 0);
+    if (nPort <= 0)
+        return true;
+
+    assert(!gBase);
+    std::string strBind = GetArg("-stratumbind", DEFAULT_STRATUM_BIND);
+    CService addrBind;
+    if (!LookupNumeric(strBind.c_str(), addrBind, nPort)) {
+        LogPrintf("Stratum: Invalid -stratumbind address %s\n", strBind);
+        return false;
+    }
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!addrBind.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+        LogPrintf("Stratum: Invalid -stratumbind address %s\n", strBind);
+        return false;
+    }
+
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+    gBase = event_base_new();
+    if (!gBase) {
+        LogPrintf("Stratum: Unable to create event_base\n");
+        return false;
+    }
+
+    gListener = evconnlistener_new_bind(gBase, acceptcb, nullptr, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1,
+                                        (struct sockaddr*)&sockaddr, len);
+    if (!gListener) {
+        event_base_free(gBase);
+        gBase = nullptr;
+        LogPrintf("Stratum: Unable to bind to %s\n", addrBind.ToStringIPPort());
+        return false;
+    }
+
+    gChainParams = &chainparams;
+    gShareLimit = UintToArith256(chainparams.GetConsensus().powLimit) /
+                  std::max<int64_t>(1, GetArg("-stratumdifficulty", DEFAULT_STRATUM_DIFFICULTY));
+    nNextExtraNonce = GetRand(std::numeric_limits<uint32_t>::max());
+
+    {
+        std::lock_guard<std::mutex> lock(cs_jobEvent);
+        gJobEvent = event_new(gBase, -1, 0, jobcb, nullptr);
+    }
+    gTemplateConnection = NotifySharedTemplateChanged.connect(&TemplateChanged);
+    StartBlockTemplateUpdater(chainparams);
+
+    LogPrintf("Stratum: Listening on %s\n", addrBind.ToStringIPPort());
+    stratumThread = boost::thread(boost::bind(&TraceThread<void (*)()>, "stratum", &StratumThread));
+    return true;
+}
+
+void InterruptStratumServer()
+{
+    if (gBase) {
+        LogPrint("stratum", "Stratum: Thread interrupt\n");
+        event_base_loopbreak(gBase);
+    }
+}
+
+void StopStratumServer()
+{
+    if (!gBase)
+        return;
+
+    gTemplateConnection.disconnect();
+    StopBlockTemplateUpdater();
+    event_base_loopbreak(gBase);
+    stratumThread.join();
+
+    for (const auto& entry : mapClients) {
+        bufferevent_free(entry.first);
+    }
+    mapClients.clear();
+    gJobs.clear();
+    LogPrintf("Stratum: Stopped after %u accepted and %u rejected shares\n", nSharesAccepted, nSharesRejected);
+
+    {
+        std::lock_guard<std::mutex> lock(cs_jobEvent);
+        event_free(gJobEvent);
+        gJobEvent = nullptr;
+    }
+    evconnlistener_free(gListener);
+    gListener = nullptr;
+    event_base_free(gBase);
+    gBase = nullptr;
+}
+
+#endif // ENABLE_MINING
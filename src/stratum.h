@@ -0,0 +1,49 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Built-in Stratum server for external RandomX miners.
+ *
+ * Speaks line-delimited JSON-RPC in the style of RandomX pool miners:
+ *
+ *   login      -> {"id": session, "job": job, "status": "OK"}
+ *   getjob     -> job
+ *   submit     {"id": session, "job_id": id, "nonce": hex} -> {"status": "OK"}
+ *   keepalived -> {"status": "KEEPALIVED"}
+ *
+ * and pushes {"method": "job", "params": job} to every logged-in miner as soon
+ * as the block template updater publishes a new template. A job carries:
+ *
+ *   blob       140-byte RandomX input in hex: the 108-byte header prefix and
+ *              the 32-byte starting nonce. The first 4 nonce bytes are the
+ *              session's extranonce and must be kept; miners vary the rest.
+ *   target     256-bit share target as a hex number (GetHex order); a share
+ *              is valid if the hash, read as a little-endian number, is at
+ *              or below it
+ *   seed_hash  RandomX key in hex (raw byte order), height and job_id
+ *
+ * Shares are checked with this node's RandomX VMs and any share meeting the
+ * block target is submitted as a block paying the node's miner address.
+ */
+#ifndef BITCOIN_STRATUM_H
+#define BITCOIN_STRATUM_H
+
+#include <stdint.h>
+#include <string>
+
+class CChainParams;
+
+/** Default for -stratumbind */
+static const char* const DEFAULT_STRATUM_BIND = "127.0.0.1";
+/** Default for -stratumdifficulty: shares must meet powLimit / difficulty */
+static const int64_t DEFAULT_STRATUM_DIFFICULTY = 1;
+
+/** Start the Stratum server on -stratumbind:-stratumport, if -stratumport is set */
+bool StartStratumServer(const CChainParams& chainparams);
+/** Interrupt the Stratum server's event loop */
+void InterruptStratumServer();
+/** Stop the Stratum server and disconnect all miners */
+void StopStratumServer();
+
+#endif // BITCOIN_STRATUM_H
@@ -410,6 +410,12 @@ public:
         d.insert(d.end(), begin(), end());
         clear();
     }
+
+    // Exchange the underlying vector with v, and read from the start of it.
+    void swap(vector_type& v) {
+        vch.swap(v);
+        nReadPos = 0;
+    }
 };
 
 class CDataStream : public CBaseDataStream<CSerializeData>
@@ -451,6 +457,61 @@ public:
  */
 typedef CBaseDataStream<CSerializeData> RustDataStream;
 
+/**
+ * Stream that deserializes from a buffer it does not own, such as a value
+ * returned by leveldb, without copying it first. The buffer must outlive
+ * the reader.
+ */
+class CSpanReader
+{
+private:
+    const int nType;
+    const int nVersion;
+    const char* pbegin;
+    const char* pend;
+
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const char* pbeginIn, const char* pendIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn) {}
+
+    template<typename T>
+    CSpanReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+
+    size_t size() const { return pend - pbegin; }
+    bool empty() const { return pbegin == pend; }
+
+    void read_u8(unsigned char* pch, size_t nSize)
+    {
+        read(reinterpret_cast<char*>(pch), nSize);
+    }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize == 0) return;
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > size()) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        pbegin += nSize;
+    }
+};
+
 
 
 
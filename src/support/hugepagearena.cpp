@@ -0,0 +1,166 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "support/hugepagearena.h"
+
+#include "crypto/randomx/virtual_memory.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t ALIGNMENT = 16;
+
+static size_t RoundUp(size_t nSize, size_t nAlign)
+{
+    return (nSize + nAlign - 1) / nAlign * nAlign;
+}
+
+CHugePageArena::~CHugePageArena()
+{
+    for (const auto& region : mapRegions) {
+        freePagedMemory(reinterpret_cast<void*>(region.first), region.second.nSize);
+    }
+}
+
+void* CHugePageArena::Map(size_t nSize, bool fDedicated)
+{
+    int fHugeTLB = 0;
+    void* p = allocHugePagesMemory(nSize, mode == HugePageMode::HUGETLB, &fHugeTLB);
+    if (p == nullptr) {
+        stats.nFailedMappings++;
+        return nullptr;
+    }
+    mapRegions.emplace(reinterpret_cast<uintptr_t>(p), Region{nSize, fHugeTLB != 0, fDedicated});
+    nRegions = mapRegions.size();
+    stats.nMapped += nSize;
+    if (fHugeTLB) stats.nHugeTLB += nSize;
+    return p;
+}
+
+bool CHugePageArena::Owns(const void* p) const
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+    auto it = mapRegions.upper_bound(addr);
+    if (it == mapRegions.begin()) return false;
+    --it;
+    return addr < it->first + it->second.nSize;
+}
+
+void* CHugePageArena::Allocate(size_t nSize, bool fZero)
+{
+    nSize = RoundUp(std::max<size_t>(nSize, 1), ALIGNMENT);
+    void* p = nullptr;
+    if (mode != HugePageMode::OFF) {
+        std::lock_guard<std::mutex> lock(cs);
+        if (nSize >= HUGE_PAGE_SIZE) {
+            // Fresh from the kernel, so already zeroed.
+            p = Map(RoundUp(nSize, HUGE_PAGE_SIZE), true);
+            fZero = false;
+        } else {
+            auto it = mapFree.find(nSize);
+            if (it != mapFree.end() && it->second != nullptr) {
+                p = it->second;
+                it->second = *static_cast<void**>(p);
+            } else {
+                if (nBumpLeft < nSize) {
+                    // The rest of the current region is left unused.
+                    pBump = static_cast<char*>(Map(HUGE_PAGE_REGION_SIZE, false));
+                    nBumpLeft = pBump ? HUGE_PAGE_REGION_SIZE : 0;
+                }
+                if (pBump != nullptr) {
+                    p = pBump;
+                    pBump += nSize;
+                    nBumpLeft -= nSize;
+                }
+            }
+        }
+        if (p != nullptr) stats.nUsed += nSize;
+    }
+
+    if (p == nullptr) {
+        p = fZero ? calloc(1, nSize) : malloc(nSize);
+        if (p == nullptr) throw std::bad_alloc();
+    } else if (fZero) {
+        memset(p, 0, nSize);
+    }
+    return p;
+}
+
+void CHugePageArena::Free(void* p, size_t nSize)
+{
+    if (p == nullptr) return;
+    if (nRegions == 0) {
+        free(p);
+        return;
+    }
+
+    nSize = RoundUp(std::max<size_t>(nSize, 1), ALIGNMENT);
+    std::lock_guard<std::mutex> lock(cs);
+    if (!Owns(p)) {
+        free(p);
+        return;
+    }
+    stats.nUsed -= nSize;
+
+    auto it = mapRegions.find(reinterpret_cast<uintptr_t>(p));
+    if (it != mapRegions.end() && it->second.fDedicated) {
+        stats.nMapped -= it->second.nSize;
+        if (it->second.fHugeTLB) stats.nHugeTLB -= it->second.nSize;
+        freePagedMemory(p, it->second.nSize);
+        mapRegions.erase(it);
+        nRegions = mapRegions.size();
+        return;
+    }
+
+    void*& head = mapFree[nSize];
+    *static_cast<void**>(p) = head;
+    head = p;
+}
+
+CHugePageArena::Stats CHugePageArena::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    Stats result = stats;
+    result.nMappings = mapRegions.size();
+    return result;
+}
+
+CHugePageArena& HugePageArena(HugePageArenaId id)
+{
+    // Never destroyed, as static containers may free into them during exit.
+    static CHugePageArena* arenas = new CHugePageArena[ARENA_COUNT];
+    return arenas[id];
+}
+
+void SetHugePageMode(HugePageMode mode)
+{
+    for (int id = 0; id < ARENA_COUNT; id++) {
+        HugePageArena(static_cast<HugePageArenaId>(id)).SetMode(mode);
+    }
+}
+
+bool ParseHugePageMode(const std::string& str, HugePageMode& mode)
+{
+    if (str == "0") {
+        mode = HugePageMode::OFF;
+    } else if (str == "thp") {
+        mode = HugePageMode::THP;
+    } else if (str == "hugetlb") {
+        mode = HugePageMode::HUGETLB;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string HugePageArenaName(HugePageArenaId id)
+{
+    switch (id) {
+    case ARENA_COINS: return "coins";
+    case ARENA_MEMPOOL: return "mempool";
+    case ARENA_BLOCKINDEX: return "blockindex";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_HUGEPAGEARENA_H
+#define BITCOIN_SUPPORT_HUGEPAGEARENA_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+/** Size of the pages the arenas map their memory in */
+static const size_t HUGE_PAGE_SIZE = 2 << 20;
+/** Memory the arenas map at a time for allocations smaller than a page */
+static const size_t HUGE_PAGE_REGION_SIZE = 4 * HUGE_PAGE_SIZE;
+
+enum class HugePageMode {
+    OFF,     //!< Plain malloc
+    THP,     //!< Ordinary pages, madvised for transparent huge pages
+    HUGETLB, //!< Reserved huge pages where the system has some free, otherwise as THP
+};
+
+/** The structures that can be placed on huge pages */
+enum HugePageArenaId {
+    ARENA_COINS,      //!< Coins view cache tables and element pools
+    ARENA_MEMPOOL,    //!< Mempool entries and their indexes
+    ARENA_BLOCKINDEX, //!< CBlockIndex objects
+    ARENA_COUNT
+};
+
+/**
+ * Memory for one large, long-lived structure, carved out of 2MB-aligned
+ * mappings so that walking it needs few TLB entries. Allocations of at
+ * least a page get a mapping of their own, which is unmapped when they are
+ * freed; smaller ones are cut from shared regions and recycled through a
+ * free list per size, so regions are only returned when the arena is
+ * destroyed.
+ *
+ * Callers pass the size back when freeing. Memory that did not come from
+ * the arena (because it was off, or a mapping failed) is passed to free(),
+ * so the mode can change while allocations are live.
+ */
+class CHugePageArena
+{
+public:
+    struct Stats {
+        size_t nMapped = 0;          //!< Bytes mapped
+        size_t nHugeTLB = 0;         //!< Of which on reserved huge pages
+        size_t nUsed = 0;            //!< Bytes handed out and not freed
+        size_t nMappings = 0;
+        size_t nFailedMappings = 0;  //!< Mappings that fell back to malloc
+    };
+
+private:
+    struct Region {
+        size_t nSize;
+        bool fHugeTLB;
+        bool fDedicated; //!< Holds a single allocation
+    };
+
+    std::atomic<HugePageMode> mode;
+    //! Nonzero once anything was mapped, so Free() can skip the lookup before that.
+    std::atomic<size_t> nRegions{0};
+
+    mutable std::mutex cs;
+    std::map<uintptr_t, Region> mapRegions; //!< By start address
+    std::unordered_map<size_t, void*> mapFree; //!< Freed small blocks by size, linked through their first word
+    char* pBump = nullptr;
+    size_t nBumpLeft = 0;
+    Stats stats;
+
+    void* Map(size_t nSize, bool fDedicated);
+    bool Owns(const void* p) const;
+
+public:
+    explicit CHugePageArena(HugePageMode modeIn = HugePageMode::OFF) : mode(modeIn) {}
+    ~CHugePageArena();
+    CHugePageArena(const CHugePageArena&) = delete;
+    CHugePageArena& operator=(const CHugePageArena&) = delete;
+
+    void SetMode(HugePageMode modeIn) { mode = modeIn; }
+    HugePageMode GetMode() const { return mode; }
+
+    /** Allocate nSize bytes aligned to 16, zeroed if fZero, or throw std::bad_alloc */
+    void* Allocate(size_t nSize, bool fZero = false);
+    /** Release memory from Allocate of the same size */
+    void Free(void* p, size_t nSize);
+
+    Stats GetStats() const;
+};
+
+/** The arena for one structure */
+CHugePageArena& HugePageArena(HugePageArenaId id);
+/** Set the mode of every arena; allocations already made stay where they are */
+void SetHugePageMode(HugePageMode mode);
+/** Parse a -hugepagearenas value ("0", "thp" or "hugetlb") */
+bool ParseHugePageMode(const std::string& str, HugePageMode& mode);
+std::string HugePageArenaName(HugePageArenaId id);
+
+/** Standard allocator over one of the arenas, for node-based containers */
+template <typename T, HugePageArenaId Id>
+class hugepage_allocator
+{
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef hugepage_allocator<U, Id> other;
+    };
+
+    hugepage_allocator() noexcept {}
+    template <typename U>
+    hugepage_allocator(const hugepage_allocator<U, Id>&) noexcept {}
+
+    T* allocate(size_t n)
+    {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_alloc();
+        return static_cast<T*>(HugePageArena(Id).Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        HugePageArena(Id).Free(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const hugepage_allocator<U, Id>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const hugepage_allocator<U, Id>&) const noexcept { return false; }
+};
+
+#endif // BITCOIN_SUPPORT_HUGEPAGEARENA_H
@@ -23,6 +23,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #ifdef ARENA_DEBUG
 #include <iomanip>
@@ -285,6 +286,16 @@ size_t PosixLockedPageAllocator::GetLimit()
 /*******************************************************************************/
 // Implementation: LockedPool
 
+/** Shard used by the calling thread. Threads are spread over the shards in
+ * the order in which they first use the pool.
+ */
+static size_t ThisThreadShard()
+{
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard++ % LockedPool::SHARDS;
+    return shard;
+}
+
 LockedPool::LockedPool(std::unique_ptr<LockedPageAllocator> allocator_in, LockingFailed_Callback lf_cb_in):
     allocator(std::move(allocator_in)), lf_cb(lf_cb_in), cumulative_bytes_locked(0)
 {
@@ -295,24 +306,99 @@ LockedPool::~LockedPool()
 }
 void* LockedPool::alloc(size_t size)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-
     // Don't handle impossible sizes
     if (size == 0 || size > ARENA_SIZE)
         return nullptr;
 
+    const size_t hint = ThisThreadShard();
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (size <= SMALL_CHUNK_MAX) {
+            void *addr = alloc_small(shards[hint], align_up(size, ARENA_ALIGN), hint);
+            if (addr) {
+                return addr;
+            }
+        } else {
+            char *addr;
+            if (alloc_arena(size, 1, hint, &addr)) {
+                return addr;
+            }
+        }
+        // The arenas are full, but the shards may be holding on to free chunks
+        drain_shards();
+    }
+    return nullptr;
+}
+
+void* LockedPool::alloc_small(Shard& shard, size_t size, size_t hint)
+{
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::vector<char*>& free_list = shard.free_lists[size / ARENA_ALIGN - 1];
+    if (free_list.empty()) {
+        // Refill the free list with a batch, staying within the cache limit
+        char *batch[SMALL_CHUNK_BATCH];
+        size_t count = std::min(SMALL_CHUNK_BATCH, (SHARD_CACHE_SIZE - shard.cached_bytes) / size + 1);
+        count = alloc_arena(size, count, hint, batch);
+        if (count == 0) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            shard.chunks.emplace(batch[i], SmallChunk{size, true});
+            free_list.push_back(batch[i]);
+        }
+        shard.cached_bytes += count * size;
+        shard.cached_chunks += count;
+    }
+    char *addr = free_list.back();
+    free_list.pop_back();
+    shard.cached_bytes -= size;
+    shard.cached_chunks -= 1;
+    shard.chunks[addr].cached = false;
+    return addr;
+}
+
+size_t LockedPool::alloc_from_arenas(size_t size, size_t count, size_t hint, char** out)
+{
+    // Threads on different shards start with different arenas, when there
+    // is more than one
+    for (size_t i = 0; i < arenas.size(); ++i) {
+        LockedPageArena &arena = *arenas[(hint + i) % arenas.size()];
+        std::lock_guard<std::mutex> lock(arena.mutex);
+        size_t n = 0;
+        while (n < count) {
+            void *addr = arena.alloc(size);
+            if (!addr) {
+                break;
+            }
+            out[n++] = static_cast<char*>(addr);
+        }
+        if (n > 0) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+size_t LockedPool::alloc_arena(size_t size, size_t count, size_t hint, char** out)
+{
     // Try allocating from each current arena
-    for (auto &arena: arenas) {
-        void *addr = arena.alloc(size);
-        if (addr) {
-            return addr;
+    {
+        std::shared_lock<std::shared_mutex> lock(arenas_mutex);
+        size_t n = alloc_from_arenas(size, count, hint, out);
+        if (n > 0) {
+            return n;
         }
     }
-    // If that fails, create a new one
+    // If that fails, create a new one. Another thread may have added an arena
+    // or freed memory in the meantime, so try the current arenas once more.
+    std::unique_lock<std::shared_mutex> lock(arenas_mutex);
+    size_t n = alloc_from_arenas(size, count, hint, out);
+    if (n > 0) {
+        return n;
+    }
     if (new_arena(ARENA_SIZE, ARENA_ALIGN)) {
-        return arenas.back().alloc(size);
+        return alloc_from_arenas(size, count, arenas.size() - 1, out);
     }
-    return nullptr;
+    return 0;
 }
 
 void LockedPool::free(void *ptr) noexcept
@@ -322,30 +408,89 @@ void LockedPool::free(void *ptr) noexcept
         return;
     }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    // TODO we can do better than this linear search by keeping a map of arena
-    // extents to arena, and looking up the address.
+    char *addr = static_cast<char*>(ptr);
+    // Small chunks are mostly freed by the thread that allocated them, so
+    // start with the shard of this thread.
+    const size_t hint = ThisThreadShard();
+    for (size_t i = 0; i < SHARDS; ++i) {
+        Shard &shard = shards[(hint + i) % SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.chunks.find(addr);
+        if (it == shard.chunks.end()) {
+            continue;
+        }
+        if (it->second.cached) {
+            assert(!"Arena: invalid or double free");
+        }
+        const size_t size = it->second.size;
+        if (shard.cached_bytes + size <= SHARD_CACHE_SIZE) {
+            it->second.cached = true;
+            shard.free_lists[size / ARENA_ALIGN - 1].push_back(addr);
+            shard.cached_bytes += size;
+            shard.cached_chunks += 1;
+            return;
+        }
+        shard.chunks.erase(it);
+        break;
+    }
+    free_arena(addr);
+}
+
+void LockedPool::free_arena(char* ptr) noexcept
+{
+    std::shared_lock<std::shared_mutex> lock(arenas_mutex);
     for (auto &arena: arenas) {
-        if (arena.addressInArena(ptr)) {
-            arena.free(ptr);
+        if (arena->addressInArena(ptr)) {
+            std::lock_guard<std::mutex> arena_lock(arena->mutex);
+            arena->free(ptr);
             return;
         }
     }
     assert(!"LockedPool: invalid address not pointing to any arena");
 }
 
+void LockedPool::drain_shards() noexcept
+{
+    for (auto &shard: shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto &free_list: shard.free_lists) {
+            for (char *addr: free_list) {
+                shard.chunks.erase(addr);
+                free_arena(addr);
+            }
+            free_list.clear();
+        }
+        shard.cached_bytes = 0;
+        shard.cached_chunks = 0;
+    }
+}
+
 LockedPool::Stats LockedPool::stats() const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    // Lock every shard first, so that no chunk moves between a free list and
+    // an arena while the totals are taken.
+    std::vector<std::unique_lock<std::mutex>> shard_locks;
+    for (const auto &shard: shards) {
+        shard_locks.emplace_back(shard.mutex);
+    }
+    std::shared_lock<std::shared_mutex> lock(arenas_mutex);
     LockedPool::Stats r{0, 0, 0, cumulative_bytes_locked, 0, 0};
     for (const auto &arena: arenas) {
-        Arena::Stats i = arena.stats();
+        std::lock_guard<std::mutex> arena_lock(arena->mutex);
+        Arena::Stats i = arena->stats();
         r.used += i.used;
         r.free += i.free;
         r.total += i.total;
         r.chunks_used += i.chunks_used;
         r.chunks_free += i.chunks_free;
     }
+    // Chunks on the free lists are free as far as users of the pool can tell
+    for (const auto &shard: shards) {
+        r.used -= shard.cached_bytes;
+        r.free += shard.cached_bytes;
+        r.chunks_used -= shard.cached_chunks;
+        r.chunks_free += shard.cached_chunks;
+    }
     return r;
 }
 
@@ -374,7 +519,7 @@ bool LockedPool::new_arena(size_t size, size_t align)
             return false;
         }
     }
-    arenas.emplace_back(allocator.get(), addr, size, align);
+    arenas.emplace_back(new LockedPageArena(allocator.get(), addr, size, align));
     return true;
 }
 
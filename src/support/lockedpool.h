@@ -7,11 +7,12 @@
 #define BITCOIN_SUPPORT_LOCKEDPOOL_H
 
 #include <stdint.h>
-#include <list>
 #include <map>
 #include <mutex>
 #include <memory>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 /**
  * OS-dependent allocation and deallocation of locked/pinned memory pages.
@@ -122,6 +123,10 @@ private:
  * memory. This has been done as the sizes and bases of objects are not in themselves sensitive
  * information, as to conserve precious locked memory. In some operating systems
  * the amount of memory that can be locked is small.
+ *
+ * Each arena has its own lock, and small chunks are served from size-class free
+ * lists kept by a number of shards that threads are spread over, so threads
+ * signing or deriving keys in parallel rarely wait on each other.
  */
 class LockedPool
 {
@@ -136,6 +141,21 @@ public:
      * memory, setting it too low will facilitate fragmentation.
      */
     static const size_t ARENA_ALIGN = 16;
+    /** Number of shards that threads are spread over.
+     */
+    static const size_t SHARDS = 8;
+    /** Largest chunk that is served from the shard free lists. Key material
+     * is small, so this covers nearly every allocation.
+     */
+    static const size_t SMALL_CHUNK_MAX = 256;
+    /** Number of small chunks taken from an arena at a time to refill a free
+     * list, so that the arena lock is taken once per batch.
+     */
+    static const size_t SMALL_CHUNK_BATCH = 8;
+    /** Bytes of unused small chunks one shard may hold on to. This keeps the
+     * free lists from tying up much of the scarce locked memory.
+     */
+    static const size_t SHARD_CACHE_SIZE = 4096;
 
     /** Callback when allocation succeeds but locking fails.
      */
@@ -187,20 +207,56 @@ private:
     public:
         LockedPageArena(LockedPageAllocator *alloc_in, void *base_in, size_t size, size_t align);
         ~LockedPageArena();
+
+        /** Mutex protects access to the chunks of this arena. */
+        std::mutex mutex;
     private:
         void *base;
         size_t size;
         LockedPageAllocator *allocator;
     };
 
-    bool new_arena(size_t size, size_t align);
+    /** A small chunk handed out by a shard. */
+    struct SmallChunk
+    {
+        size_t size;
+        /** Whether the chunk is on the free list rather than in use */
+        bool cached;
+    };
+
+    /** Free lists of small chunks, by size class. A chunk stays allocated in
+     * its arena while it is on a free list, and is returned to the shard that
+     * handed it out when it is freed, whichever thread frees it.
+     */
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<char*, SmallChunk> chunks;
+        std::vector<char*> free_lists[SMALL_CHUNK_MAX / ARENA_ALIGN];
+        size_t cached_bytes = 0;
+        size_t cached_chunks = 0;
+    };
 
-    std::list<LockedPageArena> arenas;
+    bool new_arena(size_t size, size_t align);
+    /** Allocate up to count chunks of size bytes from the arenas, starting
+     * with the arena picked by hint. Returns the number allocated.
+     */
+    size_t alloc_arena(size_t size, size_t count, size_t hint, char** out);
+    size_t alloc_from_arenas(size_t size, size_t count, size_t hint, char** out);
+    void* alloc_small(Shard& shard, size_t size, size_t hint);
+    void free_arena(char* ptr) noexcept;
+    /** Return the chunks on every shard free list to their arenas. */
+    void drain_shards() noexcept;
+
+    std::vector<std::unique_ptr<LockedPageArena>> arenas;
+    Shard shards[SHARDS];
     LockingFailed_Callback lf_cb;
     size_t cumulative_bytes_locked;
-    /** Mutex protects access to this pool's data structures, including arenas.
+    /** Mutex protects the list of arenas and cumulative_bytes_locked. It is
+     * only held exclusively while an arena is added. When it is taken
+     * together with other locks, the order is shard, then this, then arena.
      */
-    mutable std::mutex mutex;
+    mutable std::shared_mutex arenas_mutex;
 };
 
 /**
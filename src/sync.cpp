@@ -10,9 +10,86 @@
 
 #include <stdio.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <set>
+#include <tuple>
+
+std::atomic<unsigned int> g_lockstats_interval{DEFAULT_LOCKSTATS_INTERVAL};
+
+bool LockStatsSampleNext()
+{
+    // Each thread counts its own acquisitions, so sampling needs no shared
+    // state; only the sampled acquisitions take the profiler's mutex.
+    static thread_local unsigned int nSkipped = 0;
+    if (++nSkipped < g_lockstats_interval.load(std::memory_order_relaxed))
+        return false;
+    nSkipped = 0;
+    return true;
+}
+
+namespace {
+
+// Call sites are keyed by the string literals LOCK passes, which are unique
+// to the site; the lock name is compared by value when the totals are read.
+typedef std::tuple<const char*, const char*, int> LockSite;
+
+struct LockStatsData {
+    std::mutex cs;
+    std::map<LockSite, LockSiteStats> sites;
+};
+
+// Never destroyed, as locks may still be released during static destruction.
+LockStatsData& GetLockStatsData()
+{
+    static LockStatsData* data = new LockStatsData();
+    return *data;
+}
+
+} // namespace
+
+void LockStatsSample::Released()
+{
+    auto released = std::chrono::steady_clock::now();
+    int64_t nWait = std::chrono::duration_cast<std::chrono::microseconds>(acquired - begin).count();
+    int64_t nHold = std::chrono::duration_cast<std::chrono::microseconds>(released - acquired).count();
+
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.cs);
+    auto it = data.sites.find(LockSite(pszName, pszFile, nLine));
+    if (it == data.sites.end()) {
+        it = data.sites.emplace(LockSite(pszName, pszFile, nLine),
+                                LockSiteStats{pszName, pszFile, nLine, 0, 0, 0, 0, 0, 0}).first;
+    }
+    LockSiteStats& site = it->second;
+    site.nSamples++;
+    if (fContended)
+        site.nContended++;
+    site.nWaitMicros += nWait;
+    site.nMaxWaitMicros = std::max(site.nMaxWaitMicros, nWait);
+    site.nHoldMicros += nHold;
+    site.nMaxHoldMicros = std::max(site.nMaxHoldMicros, nHold);
+}
+
+std::vector<LockSiteStats> GetLockStats()
+{
+    std::vector<LockSiteStats> vStats;
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.cs);
+    vStats.reserve(data.sites.size());
+    for (const auto& entry : data.sites) {
+        vStats.push_back(entry.second);
+    }
+    return vStats;
+}
+
+void ResetLockStats()
+{
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.cs);
+    data.sites.clear();
+}
 
 #ifdef DEBUG_LOCKCONTENTION
 #if !defined(HAVE_THREAD_LOCAL)
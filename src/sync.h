@@ -12,9 +12,14 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <thread>
 #include <mutex>
+#include <string>
+#include <vector>
 
 
 ////////////////////////////////////////////////
@@ -118,14 +123,87 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -lockstats: the lock profiler is off. */
+static const unsigned int DEFAULT_LOCKSTATS_INTERVAL = 0;
+
+/**
+ * The lock profiler samples one in this many acquisitions made through LOCK,
+ * LOCK2, TRY_LOCK and WAIT_LOCK on each thread, 0 to sample none (-lockstats).
+ */
+extern std::atomic<unsigned int> g_lockstats_interval;
+
+/** Whether this acquisition is one the lock profiler samples. */
+bool LockStatsSampleNext();
+
+/** Totals of the sampled acquisitions of a lock from one call site. */
+struct LockSiteStats {
+    std::string name;
+    std::string file;
+    int line;
+    uint64_t nSamples;
+    uint64_t nContended;
+    int64_t nWaitMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nHoldMicros;
+    int64_t nMaxHoldMicros;
+};
+
+/** The sampled acquisitions so far, one entry per lock and call site. */
+std::vector<LockSiteStats> GetLockStats();
+void ResetLockStats();
+
+/**
+ * One acquisition sampled by the lock profiler. The wait runs from Begin()
+ * until the lock is taken, the hold from then until the lock is destroyed,
+ * which includes any time a WAIT_LOCK spends released in a condition
+ * variable wait.
+ */
+class LockStatsSample
+{
+private:
+    const char* pszName = nullptr;
+    const char* pszFile;
+    int nLine;
+    bool fContended = false;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point acquired;
+
+public:
+    bool Active() const { return pszName != nullptr; }
+
+    void Begin(const char* pszNameIn, const char* pszFileIn, int nLineIn)
+    {
+        pszName = pszNameIn;
+        pszFile = pszFileIn;
+        nLine = nLineIn;
+        begin = std::chrono::steady_clock::now();
+    }
+
+    void Contended() { fContended = true; }
+    void Acquired() { acquired = std::chrono::steady_clock::now(); }
+    /** Record the sample; called with the lock still held. */
+    void Released();
+};
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    LockStatsSample stats;
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        if (g_lockstats_interval.load(std::memory_order_relaxed) != 0 && LockStatsSampleNext()) {
+            stats.Begin(pszName, pszFile, nLine);
+            if (!Base::try_lock()) {
+                stats.Contended();
+                Base::lock();
+            }
+            stats.Acquired();
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -167,8 +245,11 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
+            if (stats.Active())
+                stats.Released();
             LeaveCritical();
+        }
     }
 
     operator bool()
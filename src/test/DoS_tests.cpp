@@ -16,6 +16,7 @@
 #include "pow.h"
 #include "script/sign.h"
 #include "serialize.h"
+#include "txorphanage.h"
 #include "util/system.h"
 
 #include "test/test_bitcoin.h"
@@ -27,16 +28,8 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/data/test_case.hpp>
 
-// Tests this internal-to-main.cpp method:
-extern bool AddOrphanTx(const CTransaction& tx, NodeId peer);
-extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
-struct COrphanTx {
-    CTransaction tx;
-    NodeId fromPeer;
-};
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+// Tests this internal-to-main.cpp object:
+extern CTxOrphanage orphanage;
 
 CService ip(uint32_t i)
 {
@@ -117,13 +110,9 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     SystemClock::SetGlobal();
 }
 
-CTransaction RandomOrphan()
+CTransaction RandomOrphan(const std::vector<CTransaction>& vOrphans)
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(InsecureRand256());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
-    return it->second.tx;
+    return vOrphans[InsecureRandRange(vOrphans.size())];
 }
 
 // Parameterized testing over consensus branch ids
@@ -135,6 +124,9 @@ BOOST_DATA_TEST_CASE(DoS_mapOrphans, boost::unit_test::data::xrange(static_cast<
     CBasicKeyStore keystore;
     keystore.AddKey(key);
 
+    orphanage.Clear();
+    std::vector<CTransaction> vOrphans;
+
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++)
     {
@@ -147,13 +139,14 @@ BOOST_DATA_TEST_CASE(DoS_mapOrphans, boost::unit_test::data::xrange(static_cast<
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
 
-        AddOrphanTx(tx, i);
+        BOOST_CHECK(orphanage.AddTx(tx, i));
+        vOrphans.push_back(tx);
     }
 
     // ... and 50 that depend on other orphans:
     for (int i = 0; i < 50; i++)
     {
-        CTransaction txPrev = RandomOrphan();
+        CTransaction txPrev = RandomOrphan(vOrphans);
 
         CMutableTransaction tx;
         tx.vin.resize(1);
@@ -165,13 +158,15 @@ BOOST_DATA_TEST_CASE(DoS_mapOrphans, boost::unit_test::data::xrange(static_cast<
         const PrecomputedTransactionData txdata(tx, {txPrev.vout[0]});
         SignSignature(keystore, txPrev, tx, txdata, 0, SIGHASH_ALL, consensusBranchId);
 
-        AddOrphanTx(tx, i);
+        if (orphanage.AddTx(tx, i)) {
+            vOrphans.push_back(tx);
+        }
     }
 
     // This really-big orphan should be ignored:
     for (int i = 0; i < 10; i++)
     {
-        CTransaction txPrev = RandomOrphan();
+        CTransaction txPrev = RandomOrphan(vOrphans);
 
         CMutableTransaction tx;
         tx.vout.resize(1);
@@ -193,25 +188,30 @@ BOOST_DATA_TEST_CASE(DoS_mapOrphans, boost::unit_test::data::xrange(static_cast<
         for (unsigned int j = 1; j < tx.vin.size(); j++)
             tx.vin[j].scriptSig = tx.vin[0].scriptSig;
 
-        BOOST_CHECK(!AddOrphanTx(tx, i));
+        BOOST_CHECK(!orphanage.AddTx(tx, i));
     }
 
-    // Test EraseOrphansFor:
+    // Test EraseForPeer:
     for (NodeId i = 0; i < 3; i++)
     {
-        size_t sizeBefore = mapOrphanTransactions.size();
-        EraseOrphansFor(i);
-        BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        size_t sizeBefore = orphanage.Size();
+        orphanage.EraseForPeer(i);
+        BOOST_CHECK(orphanage.Size() < sizeBefore);
     }
 
-    // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
-    BOOST_CHECK(mapOrphanTransactions.empty());
-    BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    // Test LimitOrphans() function:
+    orphanage.LimitOrphans(40, SIZE_MAX);
+    BOOST_CHECK(orphanage.Size() <= 40);
+    orphanage.LimitOrphans(10, SIZE_MAX);
+    BOOST_CHECK(orphanage.Size() <= 10);
+    size_t nHalfSize = orphanage.TotalTxSize() / 2;
+    orphanage.LimitOrphans(10, nHalfSize);
+    BOOST_CHECK(orphanage.TotalTxSize() <= nHalfSize);
+    BOOST_CHECK(orphanage.Size() > 0);
+    orphanage.LimitOrphans(0, SIZE_MAX);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 0);
+    BOOST_CHECK_EQUAL(orphanage.TotalTxSize(), 0);
+    BOOST_CHECK_EQUAL(orphanage.PrevoutCount(), 0);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,8 +7,10 @@
 #include <string>
 #include <boost/test/unit_test.hpp>
 
+#include "clientversion.h"
 #include "hash.h"
 #include "random.h"
+#include "streams.h"
 
 using namespace std;
 
@@ -332,6 +334,46 @@ BOOST_AUTO_TEST_CASE(addrman_delete)
     BOOST_CHECK(addrman.size() == 0);
     CAddrInfo* info2 = addrman.Find(addr1);
     BOOST_CHECK(info2 == NULL);
+
+    // Test 21.1: The slot of a deleted entry is reused.
+    CAddress addr2 = CAddress(CService("250.1.2.2", 8333));
+    int nId2;
+    addrman.Create(addr2, source1, &nId2);
+    BOOST_CHECK_EQUAL(nId2, nId);
+    BOOST_CHECK(addrman.Find(addr2) != NULL);
+    BOOST_CHECK(addrman.Find(addr1) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_serialize)
+{
+    CAddrManTest addrman;
+    addrman.MakeDeterministic();
+
+    CNetAddr source = CNetAddr("252.2.2.2");
+    for (unsigned int i = 1; i < 64; i++) {
+        CAddress addr = CAddress(CService("250.1." + boost::to_string(i) + ".1", 8333));
+        addrman.Add(addr, source);
+        if (i % 4 == 0)
+            addrman.Good(addr);
+    }
+    size_t nSize = addrman.size();
+    BOOST_CHECK(nSize > 0);
+
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addrman;
+
+    // Test 21.2: Every entry survives a round trip through peers.dat.
+    CAddrManTest addrman2;
+    ssPeers >> addrman2;
+    BOOST_CHECK_EQUAL(addrman2.size(), nSize);
+    for (unsigned int i = 1; i < 64; i++) {
+        CService addr = CService("250.1." + boost::to_string(i) + ".1", 8333);
+        CAddrInfo* info1 = addrman.Find(addr);
+        CAddrInfo* info2 = addrman2.Find(addr);
+        BOOST_CHECK_EQUAL(info1 == NULL, info2 == NULL);
+        if (info1 && info2)
+            BOOST_CHECK_EQUAL(info1->ToString(), info2->ToString());
+    }
 }
 
 BOOST_AUTO_TEST_CASE(addrman_getaddr)
@@ -10,6 +10,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <set>
+#include <thread>
+
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
 
 BOOST_AUTO_TEST_CASE(arena_tests)
@@ -202,6 +205,58 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_mock)
     BOOST_CHECK(pool.stats().used == 0);
 }
 
+BOOST_AUTO_TEST_CASE(lockedpool_tests_threads)
+{
+    std::unique_ptr<LockedPageAllocator> x(new TestLockedPageAllocator(3, 1));
+    LockedPool pool(std::move(x));
+
+    // Allocate small chunks on several threads, and free half of them on a
+    // thread other than the one that allocated them.
+    const int nThreads = 4;
+    const int nChunks = 1000;
+    std::vector<std::vector<void*>> chunks(nThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&pool, &chunks, t]() {
+            for (int i = 0; i < nChunks; ++i) {
+                chunks[t].push_back(pool.alloc(16 + 16 * (i % 16)));
+            }
+            for (int i = 0; i < nChunks; i += 2) {
+                pool.free(chunks[t][i]);
+                chunks[t][i] = nullptr;
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    std::set<void*> seen;
+    for (const auto& v: chunks) {
+        for (void* chunk: v) {
+            BOOST_CHECK(chunk == nullptr || seen.insert(chunk).second);
+        }
+    }
+    BOOST_CHECK_EQUAL(seen.size(), nThreads * nChunks / 2);
+
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&pool, &chunks, t]() {
+            for (void* chunk: chunks[(t + 1) % nThreads]) {
+                pool.free(chunk);
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    // Chunks held on the shard free lists do not count as used
+    BOOST_CHECK(pool.stats().used == 0);
+    BOOST_CHECK(pool.stats().chunks_used == 0);
+    BOOST_CHECK(pool.stats().free == pool.stats().total);
+}
+
 // These tests used the live LockedPoolManager object, this is also used
 // by other tests so the conditions are somewhat less controllable and thus the
 // tests are somewhat more error-prone.
@@ -142,14 +142,17 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CWorkStealingCheckQueue<FakeCheckCheckCompletion> WorkStealing_Correct_Queue;
+typedef CWorkStealingCheckQueue<FailingCheck> WorkStealing_Failing_Queue;
 
 
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
+template <typename Queue = Correct_Queue>
 void Correct_Queue_range(std::vector<size_t> range)
 {
-    auto small_queue = std::unique_ptr<Correct_Queue>(new Correct_Queue {QUEUE_BATCH_SIZE});
+    auto small_queue = std::unique_ptr<Queue>(new Queue {QUEUE_BATCH_SIZE});
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
        tg.create_thread([&]{small_queue->Thread();});
@@ -439,5 +442,51 @@ BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
         tg.join_all();
     }
 }
+/** Test that the work-stealing queue completes every check exactly once
+ */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue_Correct_Random)
+{
+    std::vector<size_t> range {0, 1, 100000};
+    for (size_t i = 2; i < 100000; i += std::max((size_t)1, (size_t)InsecureRandRange(std::min((size_t)1000, ((size_t)100000) - i))))
+        range.push_back(i);
+    Correct_Queue_range<WorkStealing_Correct_Queue>(range);
+}
+
+/** Test that the work-stealing queue catches failures and recovers from them */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue_Catches_Failure)
+{
+    auto fail_queue = std::unique_ptr<WorkStealing_Failing_Queue>(new WorkStealing_Failing_Queue {QUEUE_BATCH_SIZE});
+
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{fail_queue->Thread();});
+    }
+
+    for (size_t i = 0; i < 1001; ++i) {
+        CCheckQueueControl<FailingCheck> control(fail_queue.get());
+        size_t remaining = i;
+        while (remaining) {
+            size_t r = InsecureRandRange(10);
+
+            std::vector<FailingCheck> vChecks;
+            vChecks.reserve(r);
+            for (size_t k = 0; k < r && remaining; k++, remaining--)
+                vChecks.emplace_back(remaining == 1);
+            control.Add(vChecks);
+        }
+        bool success = control.Wait();
+        BOOST_REQUIRE_EQUAL(success, i == 0);
+    }
+    // A failed run must not leak into the next one.
+    for (size_t i = 0; i < 100; ++i) {
+        CCheckQueueControl<FailingCheck> control(fail_queue.get());
+        std::vector<FailingCheck> vChecks(10, FailingCheck(false));
+        control.Add(vChecks);
+        BOOST_REQUIRE(control.Wait());
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -184,7 +184,7 @@ public:
                 if (it->second.entered) {
                     if (it->first != Tree::empty_root()) {
                         auto ret = cacheAnchors.insert(std::make_pair(it->first, Tree())).first;
-                        ret->second = it->second.tree;
+                        ret->second = *it->second.tree;
                     }
                 } else {
                     cacheAnchors.erase(it->first);
@@ -469,6 +469,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     bool updated_an_entry = false;
     bool found_an_entry = false;
     bool missed_an_entry = false;
+    bool wrote_back_a_cache = false;
 
     // A simple map to track what we expect the cache stack to represent.
     std::map<uint256, CCoins> result;
@@ -526,6 +527,13 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             }
         }
 
+        if (stack.size() > 0 && InsecureRandRange(200) == 0) {
+            // Sometimes write the top cache back but keep it, evicting down to half its size.
+            BOOST_CHECK(stack.back()->WriteBack());
+            stack.back()->EvictColdCoins(stack.back()->DynamicMemoryUsage() / 2);
+            wrote_back_a_cache = true;
+        }
+
         if (InsecureRandRange(100) == 0) {
             // Every 100 iterations, change the cache stack.
             if (stack.size() > 0 && InsecureRandBool() == 0) {
@@ -562,6 +570,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(updated_an_entry);
     BOOST_CHECK(found_an_entry);
     BOOST_CHECK(missed_an_entry);
+    BOOST_CHECK(wrote_back_a_cache);
 }
 
 BOOST_AUTO_TEST_CASE(coins_coinbase_spends)
@@ -5,6 +5,9 @@
 
 #include "crypto/aes.h"
 #include "crypto/chacha20.h"
+#include "crypto/chacha20poly1305.h"
+#include "crypto/hkdf_sha256_32.h"
+#include "crypto/poly1305.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -197,6 +200,74 @@ void TestChaCha20(const std::string &hexkey, uint64_t nonce, uint64_t seek, cons
     outres.resize(out.size());
     rng.Output(outres.data(), outres.size());
     BOOST_CHECK(out == outres);
+
+    // Encrypting zeros gives the keystream.
+    std::vector<unsigned char> zeros(out.size());
+    rng.Seek(seek);
+    rng.Crypt(zeros.data(), outres.data(), outres.size());
+    BOOST_CHECK(out == outres);
+}
+
+void TestPoly1305(const std::string &hexmessage, const std::string &hexkey, const std::string& hextag)
+{
+    std::vector<unsigned char> key = ParseHex(hexkey);
+    std::vector<unsigned char> m = ParseHex(hexmessage);
+    std::vector<unsigned char> tag = ParseHex(hextag);
+    std::vector<unsigned char> tagres(Poly1305::TAGLEN);
+    Poly1305(key.data()).Update(m.data(), m.size()).Finalize(tagres.data());
+    BOOST_CHECK(tag == tagres);
+
+    // The same in pieces of every size.
+    for (size_t split = 1; split < m.size(); split++) {
+        Poly1305 poly(key.data());
+        for (size_t pos = 0; pos < m.size(); pos += split)
+            poly.Update(m.data() + pos, std::min(split, m.size() - pos));
+        poly.Finalize(tagres.data());
+        BOOST_CHECK(tag == tagres);
+    }
+}
+
+void TestChaCha20Poly1305(const std::string &hexplain, const std::string &hexaad, const std::string &hexkey,
+                          uint32_t nonce0, uint64_t nonce1, const std::string& hexcipher)
+{
+    std::vector<unsigned char> plain = ParseHex(hexplain);
+    std::vector<unsigned char> aad = ParseHex(hexaad);
+    std::vector<unsigned char> key = ParseHex(hexkey);
+    std::vector<unsigned char> cipher = ParseHex(hexcipher);
+    AEADChaCha20Poly1305 aead(key.data());
+
+    // Any split of the plaintext between the two parts encrypts the same.
+    for (size_t split = 0; split <= plain.size(); split++) {
+        std::vector<unsigned char> cipherres(plain.size() + AEADChaCha20Poly1305::EXPANSION);
+        aead.Encrypt(plain.data(), split, plain.data() + split, plain.size() - split,
+                     aad.data(), aad.size(), nonce0, nonce1, cipherres.data());
+        BOOST_CHECK(cipher == cipherres);
+
+        std::vector<unsigned char> plainres(plain.size());
+        BOOST_CHECK(aead.Decrypt(cipher.data(), cipher.size(), aad.data(), aad.size(), nonce0, nonce1,
+                                 plainres.data(), split, plainres.data() + split));
+        BOOST_CHECK(plain == plainres);
+    }
+
+    // Changing any byte of the ciphertext, or the nonce, makes it fail.
+    std::vector<unsigned char> plainres(plain.size());
+    for (size_t i = 0; i < cipher.size(); i++) {
+        std::vector<unsigned char> tampered = cipher;
+        tampered[i] ^= 1;
+        BOOST_CHECK(!aead.Decrypt(tampered.data(), tampered.size(), aad.data(), aad.size(), nonce0, nonce1,
+                                  plainres.data(), plainres.size(), NULL));
+    }
+    BOOST_CHECK(!aead.Decrypt(cipher.data(), cipher.size(), aad.data(), aad.size(), nonce0 + 1, nonce1,
+                              plainres.data(), plainres.size(), NULL));
+}
+
+void TestHKDF_SHA256_32(const std::string &hexikm, const std::string &salt, const std::string &info, const std::string &hexout)
+{
+    std::vector<unsigned char> ikm = ParseHex(hexikm);
+    std::vector<unsigned char> out = ParseHex(hexout);
+    std::vector<unsigned char> outres(CHKDF_HMAC_SHA256_L32::OUTPUT_SIZE);
+    CHKDF_HMAC_SHA256_L32(ikm.data(), ikm.size(), salt).Expand32(info, outres.data());
+    BOOST_CHECK(out == outres);
 }
 
 std::string LongTestString(void) {
@@ -482,6 +553,80 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+BOOST_AUTO_TEST_CASE(chacha20_crypt)
+{
+    // Crypt must give what Output does, XORed, however the stream is split,
+    // including lengths long enough for the vectorized path, and carrying
+    // the block counter from its low word into its high word.
+    std::vector<unsigned char> key = ParseHex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+    std::vector<unsigned char> plain(5000);
+    for (size_t i = 0; i < plain.size(); i++)
+        plain[i] = i * 7;
+    for (uint64_t seek : {(uint64_t)0, (uint64_t)0xfffffff0}) {
+        ChaCha20 stream(key.data(), key.size());
+        stream.SetIV(0x0102030405060708ULL);
+        stream.Seek(seek);
+        std::vector<unsigned char> keystream(plain.size());
+        stream.Output(keystream.data(), keystream.size());
+
+        for (size_t split : {1, 63, 64, 65, 511, 512, 513, 1500}) {
+            ChaCha20 crypt(key.data(), key.size());
+            crypt.SetIV(0x0102030405060708ULL);
+            crypt.Seek(seek);
+            std::vector<unsigned char> cipher(plain.size());
+            // Whole blocks only, so that each call starts where the last ended.
+            size_t chunk = (split + 63) / 64 * 64;
+            for (size_t pos = 0; pos < plain.size(); pos += chunk)
+                crypt.Crypt(plain.data() + pos, cipher.data() + pos, std::min(chunk, plain.size() - pos));
+            for (size_t i = 0; i < plain.size(); i++)
+                BOOST_CHECK_EQUAL(cipher[i], plain[i] ^ keystream[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(poly1305_testvector)
+{
+    // Test vector from RFC 8439 section 2.5.2
+    TestPoly1305("43727970746f6772617068696320466f72756d2052657365617263682047726f7570",
+                 "85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b",
+                 "a8061dc1305136c6c22b8baf0c0127a9");
+    // Test vectors from RFC 8439 appendix A.3
+    TestPoly1305("0000000000000000000000000000000000000000000000000000000000000000"
+                 "0000000000000000000000000000000000000000000000000000000000000000",
+                 "0000000000000000000000000000000000000000000000000000000000000000",
+                 "00000000000000000000000000000000");
+    TestPoly1305("ffffffffffffffffffffffffffffffff",
+                 "0200000000000000000000000000000000000000000000000000000000000000",
+                 "03000000000000000000000000000000");
+    TestPoly1305("02000000000000000000000000000000",
+                 "02000000000000000000000000000000ffffffffffffffffffffffffffffffff",
+                 "03000000000000000000000000000000");
+}
+
+BOOST_AUTO_TEST_CASE(chacha20poly1305_testvector)
+{
+    // Test vector from RFC 8439 section 2.8.2
+    TestChaCha20Poly1305("4c616469657320616e642047656e746c656d656e206f662074686520636c617373206f66202739393a204966204920"
+                         "636f756c64206f6666657220796f75206f6e6c79206f6e652074697020666f7220746865206675747572652c207375"
+                         "6e73637265656e20776f756c642062652069742e",
+                         "50515253c0c1c2c3c4c5c6c7",
+                         "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+                         7, 0x4746454443424140ULL,
+                         "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d63dbea45e8ca9671282fafb69da9272"
+                         "8b1a71de0a9e060b2905d6a5b67ecd3b3692ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831"
+                         "d7bc3ff4def08e4b7a9de576d26586cec64b6116"
+                         "1ae10b594f09e26a7e902ecbd0600691");
+}
+
+BOOST_AUTO_TEST_CASE(hkdf_hmac_sha256_l32_testvector)
+{
+    // Test vector from RFC 5869 appendix A.1, truncated to 32 bytes
+    TestHKDF_SHA256_32("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
+                       std::string("\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c", 13),
+                       std::string("\xf0\xf1\xf2\xf3\xf4\xf5\xf6\xf7\xf8\xf9", 10),
+                       "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf");
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -520,4 +665,26 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256d_multi)
+{
+    // Random lengths of up to a few chunks, so that lanes finish at different chunks.
+    for (int count = 0; count <= 33; ++count) {
+        std::vector<std::vector<unsigned char>> messages(count);
+        std::vector<const unsigned char*> inputs;
+        std::vector<size_t> lengths;
+        for (auto& message : messages) {
+            message.resize(InsecureRandRange(200));
+            for (auto& c : message) c = InsecureRandBits(8);
+            inputs.push_back(message.data());
+            lengths.push_back(message.size());
+        }
+        std::vector<unsigned char> out1(32 * count), out2(32 * count);
+        for (int j = 0; j < count; ++j) {
+            CHash256().Write(inputs[j], lengths[j]).Finalize(out1.data() + 32 * j);
+        }
+        SHA256DMulti(out2.data(), inputs.data(), lengths.data(), count);
+        BOOST_CHECK(out1 == out2);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or https://www.opensource.org/licenses/mit-license.php .
 
+#include "addressindex.h"
 #include "dbwrapper.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "random.h"
 #include "test/test_bitcoin.h"
@@ -79,6 +81,36 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_stats)
+{
+    for (int nBloomBits : {0, 10}) {
+        path ph = temp_directory_path() / unique_path();
+        CDBTuning tuning;
+        tuning.nBloomBits = nBloomBits;
+        CDBWrapper dbw(ph, (1 << 20), true, false, tuning);
+        uint256 in = InsecureRand256();
+        uint256 res;
+
+        BOOST_CHECK(dbw.Write('k', in));
+        BOOST_CHECK(dbw.Read('k', res));
+        BOOST_CHECK(!dbw.Read('l', res));
+        BOOST_CHECK(dbw.Exists('k'));
+        BOOST_CHECK(!dbw.Exists('m'));
+
+        CDBStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.nLookups, 4U);
+        BOOST_CHECK_EQUAL(stats.nMisses, 2U);
+        // Nothing has been written to a table yet.
+        BOOST_CHECK_EQUAL(stats.nMissesReadingTables, 0U);
+
+        bool fFound = false;
+        for (const auto& entry : CDBWrapper::GetAllStats()) {
+            fFound |= entry.first == ph.filename().string() && entry.second.nLookups == 4;
+        }
+        BOOST_CHECK(fFound);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     {
@@ -229,6 +261,67 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
-
+BOOST_AUTO_TEST_CASE(address_summaries)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashA, hashB;
+    hashA.begin()[0] = 'a';
+    hashB.begin()[0] = 'b';
+    CAddressIndexIteratorKey keyA(CScript::P2PKH, hashA);
+    CAddressIndexIteratorKey keyB(CScript::P2PKH, hashB);
+    uint256 txid = InsecureRand256();
+
+    // Address A has entries at heights 5 and 9, B at height 7.
+    std::vector<CAddressIndexDbEntry> addressIndex = {
+        {CAddressIndexKey(CScript::P2PKH, hashA, 5, 1, txid, 0, false), 100},
+        {CAddressIndexKey(CScript::P2PKH, hashA, 9, 1, txid, 0, true), -40},
+        {CAddressIndexKey(CScript::P2PKH, hashB, 7, 1, txid, 1, false), 60},
+    };
+    CAddressSummary summaryA;
+    summaryA.balance = 60;
+    summaryA.received = 100;
+    summaryA.txCount = 2;
+    summaryA.firstHeight = 5;
+    summaryA.lastHeight = 9;
+    CAddressSummary summaryB;
+    summaryB.balance = 60;
+    summaryB.received = 60;
+    summaryB.txCount = 1;
+    summaryB.firstHeight = summaryB.lastHeight = 7;
+    uint256 hashBest = InsecureRand256();
+    BOOST_CHECK(db.UpdateInsightIndex(addressIndex, {}, {}, {{keyA, summaryA}, {keyB, summaryB}}, {}, {}, hashBest));
+
+    CAddressSummary summary;
+    BOOST_CHECK(db.ReadAddressSummary(keyA, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 60);
+    BOOST_CHECK_EQUAL(summary.received, 100);
+    BOOST_CHECK_EQUAL(summary.txCount, 2U);
+    BOOST_CHECK_EQUAL(summary.firstHeight, 5);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 9);
+    uint256 hashRead;
+    BOOST_CHECK(db.ReadInsightIndexBestBlock(hashRead));
+    BOOST_CHECK(hashRead == hashBest);
+
+    // The last height below a height stays within the address.
+    int height = 0;
+    BOOST_CHECK(db.ReadAddressLastHeight(keyA, 9, height));
+    BOOST_CHECK_EQUAL(height, 5);
+    BOOST_CHECK(db.ReadAddressLastHeight(keyA, 100, height));
+    BOOST_CHECK_EQUAL(height, 9);
+    BOOST_CHECK(!db.ReadAddressLastHeight(keyA, 5, height));
+    BOOST_CHECK(!db.ReadAddressLastHeight(keyB, 7, height));
+    BOOST_CHECK(db.ReadAddressLastHeight(keyB, 8, height));
+    BOOST_CHECK_EQUAL(height, 7);
+
+    // A null summary erases the record.
+    BOOST_CHECK(db.UpdateInsightIndex({}, {}, {}, {{keyB, CAddressSummary()}}, {}, {}, hashBest));
+    BOOST_CHECK(!db.ReadAddressSummary(keyB, summary));
+    BOOST_CHECK(db.ReadAddressSummary(keyA, summary));
+
+    // Erasing the summaries leaves the address index alone.
+    BOOST_CHECK(db.EraseAddressSummaries());
+    BOOST_CHECK(!db.ReadAddressSummary(keyA, summary));
+    BOOST_CHECK(db.ReadAddressLastHeight(keyA, 100, height));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -162,6 +162,51 @@ BOOST_AUTO_TEST_CASE(key_test1)
     BOOST_CHECK(detsigc == ParseHex("2052d8a32079c11e79db95af63bb9600c5b04f21a9ca33dc129c2bfa8ac9dc1cd561d8ae5e0f6c1a16bde3719c64c2fd70e404b6428ab9a69566962e8771b5944d"));
 }
 
+BOOST_AUTO_TEST_CASE(key_verify_batch)
+{
+    KeyIO keyIO(Params());
+    std::vector<CKey> keys = {
+        keyIO.DecodeSecret(strSecret1),
+        keyIO.DecodeSecret(strSecret2C),
+    };
+    std::vector<CPubKey> pubkeys;
+    for (const CKey& key : keys) {
+        pubkeys.push_back(key.GetPubKey());
+    }
+
+    // Interleave signatures by both keys, so that each key appears more than once.
+    std::vector<uint256> hashes;
+    std::vector<std::vector<unsigned char>> sigs;
+    for (int i = 0; i < 6; i++) {
+        hashes.push_back(Hash(BEGIN(i), END(i)));
+        sigs.emplace_back();
+        BOOST_CHECK(keys[i % 2].Sign(hashes[i], sigs[i]));
+    }
+    std::vector<CPubKeySigCheck> checks;
+    for (int i = 0; i < 6; i++) {
+        checks.push_back({&pubkeys[i % 2], &hashes[i], &sigs[i]});
+    }
+
+    std::vector<bool> vResult;
+    BOOST_CHECK(CPubKey::VerifyBatch(checks, vResult));
+    BOOST_CHECK(vResult == std::vector<bool>(6, true));
+
+    // A signature by the other key, a corrupted signature and an invalid key
+    // fail on their own, without affecting the other results.
+    CPubKey badPubKey;
+    checks[1].pubkey = &pubkeys[0];
+    sigs[2][10] ^= 1;
+    checks[4].pubkey = &badPubKey;
+    BOOST_CHECK(!CPubKey::VerifyBatch(checks, vResult));
+    BOOST_CHECK(vResult == std::vector<bool>({true, false, false, true, false, true}));
+    for (int i = 0; i < 6; i++) {
+        BOOST_CHECK_EQUAL(checks[i].pubkey->Verify(hashes[i], sigs[i]), vResult[i]);
+    }
+
+    BOOST_CHECK(CPubKey::VerifyBatch({}, vResult));
+    BOOST_CHECK(vResult.empty());
+}
+
 BOOST_AUTO_TEST_CASE(zc_address_test)
 {
     KeyIO keyIO(Params());
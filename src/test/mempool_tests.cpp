@@ -11,6 +11,7 @@
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
+#include <limits>
 #include <list>
 #include <vector>
 
@@ -374,6 +375,213 @@ BOOST_AUTO_TEST_CASE(RemoveWithoutBranchId) {
     BOOST_CHECK_EQUAL(pool.size(), 0);
 }
 
+// A transaction spending the given outputs, told apart from others by its scriptSig
+static CMutableTransaction GraphTx(int nId, const std::vector<COutPoint>& vPrevouts, int nOutputs = 2)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(std::max<size_t>(vPrevouts.size(), 1));
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        tx.vin[i].scriptSig = CScript() << nId;
+        if (i < vPrevouts.size()) tx.vin[i].prevout = vPrevouts[i];
+    }
+    tx.vout.resize(nOutputs);
+    for (auto& out : tx.vout) {
+        out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        out.nValue = 1000LL;
+    }
+    return tx;
+}
+
+// The in-mempool ancestors of tx, found by following its inputs rather than
+// the mempool's dependency graph
+static std::set<uint256> ReferenceAncestors(const CTxMemPool& pool, const CTransaction& tx)
+{
+    std::set<uint256> ancestors;
+    std::vector<const CTransaction*> vStage {&tx};
+    while (!vStage.empty()) {
+        const CTransaction* ptx = vStage.back();
+        vStage.pop_back();
+        for (const CTxIn& txin : ptx->vin) {
+            auto it = pool.mapTx.find(txin.prevout.hash);
+            if (it != pool.mapTx.end() && ancestors.insert(it->GetTx().GetHash()).second) {
+                vStage.push_back(&it->GetTx());
+            }
+        }
+    }
+    return ancestors;
+}
+
+static std::set<uint256> Hashes(const CTxMemPool::setEntries& entries)
+{
+    std::set<uint256> hashes;
+    for (CTxMemPool::txiter it : entries) {
+        hashes.insert(it->GetTx().GetHash());
+    }
+    return hashes;
+}
+
+// Check every entry's ancestors, descendants and descendant state against
+// the ones found by following transaction inputs.
+static void CheckGraph(CTxMemPool& pool)
+{
+    LOCK(pool.cs);
+    std::map<uint256, std::set<uint256>> mapAncestors;
+    for (auto it = pool.mapTx.begin(); it != pool.mapTx.end(); ++it) {
+        mapAncestors[it->GetTx().GetHash()] = ReferenceAncestors(pool, it->GetTx());
+    }
+
+    for (auto it = pool.mapTx.begin(); it != pool.mapTx.end(); ++it) {
+        const uint256& hash = it->GetTx().GetHash();
+
+        CTxMemPool::setEntries setAncestors;
+        std::string dummy;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        BOOST_CHECK(pool.CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false));
+        BOOST_CHECK(Hashes(setAncestors) == mapAncestors[hash]);
+
+        std::set<uint256> descendants {hash};
+        uint64_t nSize = 0;
+        CAmount nModFees = 0;
+        for (auto other = pool.mapTx.begin(); other != pool.mapTx.end(); ++other) {
+            const uint256& otherHash = other->GetTx().GetHash();
+            if (otherHash == hash || mapAncestors[otherHash].count(hash)) {
+                descendants.insert(otherHash);
+                nSize += other->GetTxSize();
+                nModFees += other->GetModifiedFee();
+            }
+        }
+        CTxMemPool::setEntries setDescendants;
+        pool.CalculateDescendants(pool.mapTx.find(hash), setDescendants);
+        BOOST_CHECK(Hashes(setDescendants) == descendants);
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), descendants.size());
+        BOOST_CHECK_EQUAL(it->GetSizeWithDescendants(), nSize);
+        BOOST_CHECK_EQUAL(it->GetModFeesWithDescendants(), nModFees);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MempoolGraphChainAndDiamond)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+
+    // A chain of four, each spending the first output of the one before
+    std::vector<CMutableTransaction> vChain;
+    for (int i = 0; i < 4; i++) {
+        std::vector<COutPoint> vPrevouts;
+        if (i > 0) vPrevouts.push_back(COutPoint(vChain.back().GetHash(), 0));
+        vChain.push_back(GraphTx(i, vPrevouts));
+        pool.addUnchecked(vChain.back().GetHash(), entry.Fee(1000LL * (i + 1)).FromTx(vChain.back()));
+        CheckGraph(pool);
+    }
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[0].GetHash())->GetCountWithDescendants(), 4);
+
+    // A diamond hanging off the chain: two children of the last link, joined
+    // again by a grandchild that spends both of them
+    CMutableTransaction txLeft = GraphTx(10, {COutPoint(vChain[3].GetHash(), 0)});
+    CMutableTransaction txRight = GraphTx(11, {COutPoint(vChain[3].GetHash(), 1)});
+    CMutableTransaction txJoin = GraphTx(12, {COutPoint(txLeft.GetHash(), 0), COutPoint(txRight.GetHash(), 0)});
+    pool.addUnchecked(txLeft.GetHash(), entry.Fee(5000LL).FromTx(txLeft));
+    pool.addUnchecked(txRight.GetHash(), entry.Fee(6000LL).FromTx(txRight));
+    pool.addUnchecked(txJoin.GetHash(), entry.Fee(7000LL).FromTx(txJoin));
+    CheckGraph(pool);
+    // The grandchild is reached along both sides but only counted once
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[0].GetHash())->GetCountWithDescendants(), 7);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[3].GetHash())->GetCountWithDescendants(), 4);
+
+    // Fee deltas reach every ancestor once
+    pool.PrioritiseTransaction(txJoin.GetHash(), txJoin.GetHash().ToString(), 100000LL);
+    pool.PrioritiseTransaction(txLeft.GetHash(), txLeft.GetHash().ToString(), -2000LL);
+    CheckGraph(pool);
+
+    // Removing one side of the diamond takes the grandchild with it
+    std::list<CTransaction> removed;
+    pool.remove(txLeft, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    CheckGraph(pool);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolGraphReaddedFromBlock)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+
+    // Two transactions that were mined in a block, the second spending the
+    // first, and mempool transactions spending both of them
+    CMutableTransaction txBlock1 = GraphTx(0, {});
+    CMutableTransaction txBlock2 = GraphTx(1, {COutPoint(txBlock1.GetHash(), 0)});
+    CMutableTransaction txChild1 = GraphTx(2, {COutPoint(txBlock1.GetHash(), 1)});
+    CMutableTransaction txChild2 = GraphTx(3, {COutPoint(txBlock2.GetHash(), 0)});
+    CMutableTransaction txGrandChild = GraphTx(4, {COutPoint(txChild1.GetHash(), 0), COutPoint(txChild2.GetHash(), 0)});
+    pool.addUnchecked(txChild1.GetHash(), entry.Fee(3000LL).FromTx(txChild1));
+    pool.addUnchecked(txChild2.GetHash(), entry.Fee(4000LL).FromTx(txChild2));
+    pool.addUnchecked(txGrandChild.GetHash(), entry.Fee(5000LL).FromTx(txGrandChild));
+    CheckGraph(pool);
+
+    // The block is disconnected: its transactions go back in block order, and
+    // then get linked to the children already in the mempool
+    pool.addUnchecked(txBlock1.GetHash(), entry.Fee(1000LL).FromTx(txBlock1));
+    pool.addUnchecked(txBlock2.GetHash(), entry.Fee(2000LL).FromTx(txBlock2));
+    pool.UpdateTransactionsFromBlock({txBlock1.GetHash(), txBlock2.GetHash()});
+    CheckGraph(pool);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txBlock1.GetHash())->GetCountWithDescendants(), 5);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txBlock2.GetHash())->GetCountWithDescendants(), 3);
+
+    // Mining the block again takes the graph back to where it was
+    std::list<CTransaction> conflicts;
+    std::vector<CTransaction> vtx {txBlock1, txBlock2};
+    pool.removeForBlock(vtx, 2, conflicts);
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+    CheckGraph(pool);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolGraphReusesRemovedNodes)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+
+    // A parent with a chain of two on one output and a single child on the other
+    CMutableTransaction txParent = GraphTx(0, {});
+    CMutableTransaction txChain1 = GraphTx(1, {COutPoint(txParent.GetHash(), 0)});
+    CMutableTransaction txChain2 = GraphTx(2, {COutPoint(txChain1.GetHash(), 0)});
+    CMutableTransaction txOther = GraphTx(3, {COutPoint(txParent.GetHash(), 1)});
+    for (CMutableTransaction* ptx : {&txParent, &txChain1, &txChain2, &txOther}) {
+        pool.addUnchecked(ptx->GetHash(), entry.Fee(1000LL).FromTx(*ptx));
+    }
+    CheckGraph(pool);
+
+    // Removing the chain frees two graph nodes, which the next two
+    // transactions reuse. Neither may inherit the links of the removed ones.
+    std::list<CTransaction> removed;
+    pool.remove(txChain1, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    CheckGraph(pool);
+
+    CMutableTransaction txUnrelated = GraphTx(4, {});
+    CMutableTransaction txNewChild = GraphTx(5, {COutPoint(txOther.GetHash(), 0)});
+    pool.addUnchecked(txUnrelated.GetHash(), entry.Fee(2000LL).FromTx(txUnrelated));
+    pool.addUnchecked(txNewChild.GetHash(), entry.Fee(3000LL).FromTx(txNewChild));
+    CheckGraph(pool);
+    {
+        LOCK(pool.cs);
+        auto itUnrelated = pool.mapTx.find(txUnrelated.GetHash());
+        BOOST_CHECK(pool.GetMemPoolParents(itUnrelated).empty());
+        BOOST_CHECK(pool.GetMemPoolChildren(itUnrelated).empty());
+        auto itParent = pool.mapTx.find(txParent.GetHash());
+        BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(itParent).size(), 1);
+        BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(itParent).count(pool.mapTx.find(txOther.GetHash())), 1);
+    }
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txParent.GetHash())->GetCountWithDescendants(), 3);
+
+    // The freed nodes are reused again once everything is removed and re-added
+    pool.remove(txParent, removed, true);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    for (CMutableTransaction* ptx : {&txParent, &txChain1, &txChain2}) {
+        pool.addUnchecked(ptx->GetHash(), entry.Fee(1000LL).FromTx(*ptx));
+    }
+    CheckGraph(pool);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txParent.GetHash())->GetCountWithDescendants(), 3);
+}
+
 // Test that nCheckFrequency is set correctly when calling setSanityCheck().
 // https://github.com/zcash/zcash/issues/3134
 BOOST_AUTO_TEST_CASE(SetSanityCheck) {
@@ -359,7 +359,8 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 
         if (i < sizeof(blockinfo)/sizeof(*blockinfo)) {
             pblock->nNonce = uint256S(blockinfo[i].nonce_hex);
-            pblock->nSolution = ParseHex(blockinfo[i].solution_hex);
+            std::vector<unsigned char> solution = ParseHex(blockinfo[i].solution_hex);
+            pblock->nSolution.assign(solution.begin(), solution.end());
         } else {
 #ifdef ENABLE_MINING
             // If you need to mine more blocks than are currently in blockinfo, increase
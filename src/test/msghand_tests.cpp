@@ -0,0 +1,221 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "chain.h"
+#include "chainparams.h"
+#include "main.h"
+#include "net.h"
+#include "protocol.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
+
+// Defined in net.cpp
+void ThreadMessageHandler(int nThread);
+
+static CAddress PeerAddress(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = htonl(0x01020000 | i);
+    return CAddress(CService(CNetAddr(s), Params().GetDefaultPort()));
+}
+
+// The messages of a fake peer, and what the handler threads did with them
+struct TestPeer
+{
+    std::deque<int> vQueue;
+    std::vector<int> vProcessed;
+    int nSends = 0;
+    std::atomic<int> nInside{0};
+    std::atomic<bool> fOverlap{false};
+};
+
+static std::map<CNode*, TestPeer> mapPeers;
+static std::atomic<int> nRemaining;
+static CCriticalSection cs_threads;
+static std::set<boost::thread::id> setThreads;
+
+static bool ProcessTestMessages(const CChainParams& chainparams, CNode* pnode)
+{
+    TestPeer& peer = mapPeers.at(pnode);
+    if (peer.nInside++ != 0)
+        peer.fOverlap = true;
+    {
+        LOCK(cs_threads);
+        setThreads.insert(boost::this_thread::get_id());
+    }
+    // Take a few messages per pass, slowly enough for the threads to meet.
+    for (int i = 0; i < 3 && !peer.vQueue.empty(); i++) {
+        MilliSleep(1);
+        peer.vProcessed.push_back(peer.vQueue.front());
+        peer.vQueue.pop_front();
+        nRemaining--;
+    }
+    peer.nInside--;
+    return true;
+}
+
+static bool SendTestMessages(const Consensus::Params& params, CNode* pnode)
+{
+    TestPeer& peer = mapPeers.at(pnode);
+    if (peer.nInside++ != 0)
+        peer.fOverlap = true;
+    peer.nSends++;
+    peer.nInside--;
+    return true;
+}
+
+BOOST_FIXTURE_TEST_SUITE(msghand_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(handler_threads_process_each_peer_in_order)
+{
+    static const int NODES = 6;
+    static const int MESSAGES = 30;
+
+    // Replace the real message handlers for the lifetime of the nodes.
+    UnregisterNodeSignals(GetNodeSignals());
+    boost::signals2::connection processConnection = GetNodeSignals().ProcessMessages.connect(&ProcessTestMessages);
+    boost::signals2::connection sendConnection = GetNodeSignals().SendMessages.connect(&SendTestMessages);
+
+    std::vector<CNode*> vTestNodes;
+    nRemaining = NODES * MESSAGES;
+    for (int i = 0; i < NODES; i++) {
+        CNode* pnode = new CNode(INVALID_SOCKET, PeerAddress(i), "", true);
+        TestPeer& peer = mapPeers[pnode];
+        for (int j = 0; j < MESSAGES; j++)
+            peer.vQueue.push_back(j);
+        vTestNodes.push_back(pnode);
+    }
+    {
+        LOCK(cs_vNodes);
+        vNodes = vTestNodes;
+    }
+
+    nMessageHandlerThreads = 4;
+    boost::thread_group handlers;
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        handlers.create_thread([i] { ThreadMessageHandler(i); });
+
+    int64_t nDeadline = GetTime() + 30;
+    while (nRemaining > 0 && GetTime() < nDeadline)
+        MilliSleep(10);
+    handlers.interrupt_all();
+    handlers.join_all();
+    nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
+
+    BOOST_CHECK_EQUAL(nRemaining.load(), 0);
+    for (CNode* pnode : vTestNodes) {
+        const TestPeer& peer = mapPeers.at(pnode);
+        // Each peer's messages were handled by one thread at a time, in the
+        // order they arrived, and its sends did not overlap them either.
+        BOOST_CHECK(!peer.fOverlap);
+        BOOST_CHECK_EQUAL(peer.vProcessed.size(), (size_t)MESSAGES);
+        for (size_t j = 0; j < peer.vProcessed.size(); j++)
+            BOOST_CHECK_EQUAL(peer.vProcessed[j], (int)j);
+        BOOST_CHECK(peer.nSends > 0);
+    }
+    // The peers were spread over more than one thread.
+    BOOST_CHECK(setThreads.size() > 1);
+
+    {
+        LOCK(cs_vNodes);
+        vNodes.clear();
+    }
+    for (CNode* pnode : vTestNodes)
+        delete pnode;
+    mapPeers.clear();
+    setThreads.clear();
+
+    processConnection.disconnect();
+    sendConnection.disconnect();
+    RegisterNodeSignals(GetNodeSignals());
+}
+
+BOOST_AUTO_TEST_CASE(addresses_relayed_while_sending_are_not_lost)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    CNode node(INVALID_SOCKET, PeerAddress(0), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // Another peer's handler relays addresses to the node while its own
+    // handler swaps them out to send.
+    static const int ADDRESSES = 500;
+    std::atomic<bool> fDone(false);
+    std::thread relay([&] {
+        FastRandomContext insecure_rand;
+        for (int i = 1; i <= ADDRESSES; i++)
+            node.PushAddress(PeerAddress(i), insecure_rand);
+        fDone = true;
+    });
+    while (!fDone) {
+        node.nNextAddrSend = 0;
+        SendMessages(params, &node);
+    }
+    relay.join();
+    node.nNextAddrSend = 0;
+    SendMessages(params, &node);
+
+    // Every address was either sent, and so is known, or skipped as known.
+    {
+        LOCK(node.cs_addrKnown);
+        BOOST_CHECK(node.vAddrToSend.empty());
+    }
+    for (int i = 1; i <= ADDRESSES; i++)
+        BOOST_CHECK(node.IsAddressKnown(PeerAddress(i)));
+}
+
+BOOST_AUTO_TEST_CASE(getdata_for_unreadable_block_disconnects)
+{
+    const CChainParams& chainparams = Params();
+    CBlockIndex* pindex;
+    int nFile;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Genesis();
+        nFile = pindex->nFile;
+    }
+
+    for (int type : {MSG_BLOCK, MSG_FILTERED_BLOCK}) {
+        // The block is served while it is on disk
+        {
+            CNode node(INVALID_SOCKET, PeerAddress(1), "", true);
+            node.vRecvGetData.push_back(CInv(type, pindex->GetBlockHash()));
+            LOCK(node.cs_vRecvMsg);
+            BOOST_CHECK(ProcessMessages(chainparams, &node));
+            BOOST_CHECK(node.vRecvGetData.empty());
+            BOOST_CHECK(!node.fDisconnect);
+            if (type == MSG_BLOCK)
+                BOOST_CHECK(node.nSendSize > 0);
+        }
+
+        // and the peer is disconnected, rather than an assertion failing, once
+        // its file is gone, as when it is pruned while the request is handled.
+        {
+            LOCK(cs_main);
+            pindex->nFile = 9999;
+        }
+        {
+            CNode node(INVALID_SOCKET, PeerAddress(2), "", true);
+            node.vRecvGetData.push_back(CInv(type, pindex->GetBlockHash()));
+            LOCK(node.cs_vRecvMsg);
+            ProcessMessages(chainparams, &node);
+            BOOST_CHECK(node.vRecvGetData.empty());
+            BOOST_CHECK(node.fDisconnect);
+            BOOST_CHECK_EQUAL(node.nSendSize, 0u);
+        }
+        {
+            LOCK(cs_main);
+            pindex->nFile = nFile;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -143,4 +143,26 @@ BOOST_AUTO_TEST_CASE(caddrdb_read_corrupted)
     BOOST_CHECK(addrman2.size() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(push_message_shared)
+{
+    CNode node(INVALID_SOCKET, CAddress(), "", true);
+    auto payload = std::make_shared<std::vector<char>>(1000);
+    for (size_t i = 0; i < payload->size(); i++)
+        (*payload)[i] = i;
+
+    node.PushMessage("block", CFlatData(payload->data(), payload->data() + payload->size()));
+    node.PushMessageShared("block", payload, payload->data(), payload->data() + payload->size());
+
+    // The shared payload is queued in place, after its header.
+    BOOST_REQUIRE_EQUAL(node.vSendMsg.size(), 3);
+    BOOST_CHECK(node.vSendMsg[2].begin() == payload->data());
+
+    // Either way, the same bytes are sent.
+    std::string copied(node.vSendMsg[0].begin(), node.vSendMsg[0].size());
+    std::string shared(node.vSendMsg[1].begin(), node.vSendMsg[1].size());
+    shared.append(node.vSendMsg[2].begin(), node.vSendMsg[2].size());
+    BOOST_CHECK(copied == shared);
+    BOOST_CHECK_EQUAL(node.nSendSize, 2 * copied.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,9 @@
 
 #include "test/test_bitcoin.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <boost/bind/bind.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
@@ -108,4 +111,53 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(serial_keys)
+{
+    // Tasks sharing a key never overlap, even with threads to spare, while
+    // tasks with other keys or none run alongside them.
+    CScheduler scheduler;
+    boost::mutex mutex;
+    int nRunning[2] = { 0 };
+    int nMaxRunning[2] = { 0 };
+    int nUnkeyed = 0;
+    std::vector<int> order;
+
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    for (int i = 0; i < 20; i++) {
+        int k = i % 2;
+        scheduler.schedule([&, i, k] {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                nMaxRunning[k] = std::max(nMaxRunning[k], ++nRunning[k]);
+                if (k == 0) order.push_back(i);
+            }
+            MicroSleep(200);
+            boost::unique_lock<boost::mutex> lock(mutex);
+            --nRunning[k];
+        }, now + boost::chrono::microseconds(i), k == 0 ? "a" : "b");
+        scheduler.schedule([&] {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nUnkeyed++;
+        }, now);
+    }
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(nMaxRunning[0], 1);
+    BOOST_CHECK_EQUAL(nMaxRunning[1], 1);
+    BOOST_CHECK_EQUAL(nUnkeyed, 20);
+    // Tasks with the same key run in the order they fall due.
+    BOOST_CHECK_EQUAL(order.size(), 10);
+    BOOST_CHECK(std::is_sorted(order.begin(), order.end()));
+
+    CScheduler::LatencyStats stats = scheduler.takeLatencyStats();
+    BOOST_CHECK_EQUAL(stats.nTasks, 40);
+    BOOST_CHECK(stats.nMaxMicros >= 0);
+    BOOST_CHECK_EQUAL(scheduler.takeLatencyStats().nTasks, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -418,4 +418,37 @@ BOOST_AUTO_TEST_CASE(class_methods)
     BOOST_CHECK(methodtest3 == methodtest4);
 }
 
+BOOST_AUTO_TEST_CASE(fixed_size_methods)
+{
+    // A fixed-size class serializes to the same bytes as its fields do.
+    COutPoint outpoint(uint256S("0102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f20"), 0x11223344);
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    CDataStream ssFields(SER_DISK, PROTOCOL_VERSION);
+    ssFields << outpoint.hash << outpoint.n;
+    BOOST_CHECK(ss.str() == ssFields.str());
+    BOOST_CHECK_EQUAL(GetSerializeSize(outpoint, SER_DISK, PROTOCOL_VERSION), COutPoint::SERIALIZED_SIZE);
+
+    COutPoint outpoint2;
+    ss >> outpoint2;
+    BOOST_CHECK(outpoint2 == outpoint);
+    BOOST_CHECK(ss.empty());
+
+    // Unserializing from a short stream fails without reading past the end.
+    ssFields.resize(COutPoint::SERIALIZED_SIZE - 1);
+    BOOST_CHECK_THROW(ssFields >> outpoint2, std::ios_base::failure);
+
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = outpoint.hash;
+    header.nTime = 1269211443;
+    header.nBits = 0x1e7fffff;
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << CEquihashInput{header};
+    BOOST_CHECK_EQUAL(ssHeader.size(), CBlockHeader::HEADER_SIZE - 32);
+    CDataStream ssFullHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssFullHeader << header;
+    BOOST_CHECK(std::equal(ssHeader.begin(), ssHeader.end(), ssFullHeader.begin()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -100,4 +100,76 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(chainsnapshot_test)
+{
+    // A main chain 5000 blocks long and a branch from block 2999 that is
+    // 3000 blocks long. The branch hashes share their low 64 bits with the
+    // main chain hashes at the same height.
+    std::vector<uint256> vHashMain(5000);
+    std::vector<CBlockIndex> vBlocksMain(5000);
+    for (unsigned int i=0; i<vBlocksMain.size(); i++) {
+        vHashMain[i] = ArithToUint256(i);
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : NULL;
+        vBlocksMain[i].phashBlock = &vHashMain[i];
+        vBlocksMain[i].BuildSkip();
+    }
+    std::vector<uint256> vHashSide(3000);
+    std::vector<CBlockIndex> vBlocksSide(3000);
+    for (unsigned int i=0; i<vBlocksSide.size(); i++) {
+        vHashSide[i] = ArithToUint256(i + 3000 + (arith_uint256(1) << 128));
+        vBlocksSide[i].nHeight = i + 3000;
+        vBlocksSide[i].pprev = i ? &vBlocksSide[i - 1] : &vBlocksMain[2999];
+        vBlocksSide[i].phashBlock = &vHashSide[i];
+        vBlocksSide[i].BuildSkip();
+    }
+
+    // Grow the main chain a block at a time, each snapshot made from the last.
+    CChain chain;
+    std::shared_ptr<const CChainSnapshot> snapshot = std::make_shared<CChainSnapshot>(chain, nullptr);
+    BOOST_CHECK(snapshot->Tip() == NULL);
+    BOOST_CHECK_EQUAL(snapshot->Height(), -1);
+    std::shared_ptr<const CChainSnapshot> snapshotMain;
+    for (unsigned int i=0; i<vBlocksMain.size(); i++) {
+        chain.SetTip(&vBlocksMain[i]);
+        snapshot = std::make_shared<CChainSnapshot>(chain, snapshot.get());
+        BOOST_CHECK(snapshot->Tip() == &vBlocksMain[i]);
+        if (i == 4000)
+            snapshotMain = snapshot;
+    }
+    for (int n=0; n<1000; n++) {
+        int r = InsecureRandRange(vBlocksMain.size());
+        BOOST_CHECK((*snapshot)[r] == &vBlocksMain[r]);
+        BOOST_CHECK(snapshot->Find(vHashMain[r]) == &vBlocksMain[r]);
+    }
+    BOOST_CHECK(snapshot->Find(ArithToUint256(5000)) == NULL);
+    BOOST_CHECK(snapshot->Find(vHashSide[0]) == NULL);
+
+    // Reorganize to the branch.
+    chain.SetTip(&vBlocksSide.back());
+    snapshot = std::make_shared<CChainSnapshot>(chain, snapshot.get());
+    BOOST_CHECK_EQUAL(snapshot->Height(), 5999);
+    BOOST_CHECK(snapshot->Genesis() == &vBlocksMain[0]);
+    BOOST_CHECK(snapshot->Next(&vBlocksMain[2999]) == &vBlocksSide[0]);
+    BOOST_CHECK(snapshot->Next(&vBlocksSide.back()) == NULL);
+    BOOST_CHECK(!snapshot->Contains(&vBlocksMain[3000]));
+    for (int n=0; n<1000; n++) {
+        int r = InsecureRandRange(vBlocksMain.size());
+        if (r < 3000) {
+            BOOST_CHECK(snapshot->Find(vHashMain[r]) == &vBlocksMain[r]);
+        } else {
+            BOOST_CHECK(snapshot->Find(vHashMain[r]) == NULL);
+            BOOST_CHECK(snapshot->Find(vHashSide[r - 3000]) == &vBlocksSide[r - 3000]);
+        }
+        BOOST_CHECK(snapshot->Find(vHashSide[r % 3000]) == &vBlocksSide[r % 3000]);
+    }
+
+    // Earlier snapshots are unaffected.
+    BOOST_CHECK_EQUAL(snapshotMain->Height(), 4000);
+    BOOST_CHECK(snapshotMain->Tip() == &vBlocksMain[4000]);
+    BOOST_CHECK(snapshotMain->Find(vHashMain[3500]) == &vBlocksMain[3500]);
+    BOOST_CHECK(snapshotMain->Find(vHashMain[4500]) == NULL);
+    BOOST_CHECK(snapshotMain->Find(vHashSide[500]) == NULL);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "crypto/randomx_wrapper.h"
+#include "key.h"
+#include "main.h"
+#include "miner.h"
+#include "netbase.h"
+#include "pow.h"
+#include "stratum.h"
+#include "test/test_bitcoin.h"
+#include "util/strencodings.h"
+#include "validationinterface.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(stratum_tests, TestingSetup)
+
+#ifdef ENABLE_MINING
+
+// Read one reply line, waiting up to ten seconds for it
+static UniValue ReadReply(SOCKET hSocket, std::string& strBuffer)
+{
+    int64_t nDeadline = GetTimeMillis() + 10000;
+    size_t nEnd;
+    while ((nEnd = strBuffer.find('\n')) == std::string::npos && GetTimeMillis() < nDeadline) {
+        char buf[4096];
+        int nBytes = recv(hSocket, buf, sizeof(buf), 0);
+        if (nBytes > 0) {
+            strBuffer.append(buf, nBytes);
+        } else if (nBytes == 0 || WSAGetLastError() != WSAEWOULDBLOCK) {
+            break;
+        } else {
+            MilliSleep(10);
+        }
+    }
+    UniValue reply;
+    if (nEnd != std::string::npos) {
+        BOOST_CHECK(reply.read(strBuffer.substr(0, nEnd)));
+        strBuffer.erase(0, nEnd + 1);
+    }
+    return reply;
+}
+
+// Send a request and return the reply to it, skipping job notifications
+static UniValue Call(SOCKET hSocket, std::string& strBuffer, int nId, const std::string& strMethod, const UniValue& params)
+{
+    UniValue request(UniValue::VOBJ);
+    request.pushKV("id", nId);
+    request.pushKV("jsonrpc", "2.0");
+    request.pushKV("method", strMethod);
+    request.pushKV("params", params);
+    std::string str = request.write() + "\n";
+    BOOST_REQUIRE_EQUAL(send(hSocket, str.data(), str.size(), MSG_NOSIGNAL), (int)str.size());
+
+    while (true) {
+        UniValue reply = ReadReply(hSocket, strBuffer);
+        if (!reply.isObject() || find_value(reply, "id").isNum()) return reply;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(share_meeting_block_target_is_accepted)
+{
+    const CChainParams& chainparams = Params();
+    RandomX_Init();
+
+    CScript scriptPubKey = CScript() << ToByteVector(CKey::TestOnlyRandomKey(true).GetPubKey()) << OP_CHECKSIG;
+    boost::signals2::connection addressConnection = GetMainSignals().AddressForMining.connect(
+        [&](std::optional<MinerAddress>& minerAddress) {
+            boost::shared_ptr<CReserveScript> coinbaseScript(new CReserveScript());
+            coinbaseScript->reserveScript = scriptPubKey;
+            minerAddress = coinbaseScript;
+        });
+
+    int nPort = 20000 + InsecureRandRange(10000);
+    mapArgs["-stratumport"] = std::to_string(nPort);
+    BOOST_REQUIRE(StartStratumServer(chainparams));
+
+    SOCKET hSocket = INVALID_SOCKET;
+    CService addr;
+    BOOST_REQUIRE(LookupNumeric("127.0.0.1", addr, nPort));
+    BOOST_REQUIRE(ConnectSocket(addr, hSocket, DEFAULT_CONNECT_TIMEOUT));
+    std::string strBuffer;
+
+    // Wait for the template updater to publish the first template
+    UniValue params(UniValue::VOBJ);
+    params.pushKV("login", "test");
+    UniValue reply = Call(hSocket, strBuffer, 1, "login", params);
+    BOOST_REQUIRE(find_value(reply, "error").isNull());
+    std::string strSession = find_value(find_value(reply, "result"), "id").get_str();
+    UniValue job = find_value(find_value(reply, "result"), "job");
+    for (int i = 0; i < 1000 && !job.isObject(); i++) {
+        MilliSleep(10);
+        reply = Call(hSocket, strBuffer, 2, "getjob", UniValue(UniValue::VOBJ));
+        if (find_value(reply, "error").isNull()) job = find_value(reply, "result");
+    }
+    BOOST_REQUIRE(job.isObject());
+
+    // Jobs only carry the share target, so take the block target from the template
+    std::shared_ptr<const CBlockTemplate> ptemplate;
+    int nHeight;
+    BOOST_REQUIRE(GetSharedBlockTemplate(ptemplate, nHeight));
+    BOOST_REQUIRE_EQUAL(find_value(job, "height").get_int(), 1);
+    arith_uint256 blockTarget;
+    blockTarget.SetCompact(ptemplate->block.nBits);
+
+    // Mine the job the way an external miner would, keeping the session's extranonce
+    std::vector<unsigned char> vInput = ParseHex(find_value(job, "blob").get_str());
+    std::vector<unsigned char> vSeed = ParseHex(find_value(job, "seed_hash").get_str());
+    BOOST_REQUIRE_EQUAL(vInput.size(), 140u);
+    BOOST_REQUIRE_EQUAL(vSeed.size(), 32u);
+    uint256 seedHash(vSeed);
+    uint256 hash;
+    for (uint32_t nCounter = 0; ; nCounter++) {
+        WriteLE32(vInput.data() + 112, nCounter);
+        BOOST_REQUIRE(GetPoWHash(chainparams.GetConsensus(), seedHash, vInput.data(), vInput.size(), hash));
+        if (UintToArith256(hash) <= blockTarget) break;
+    }
+
+    params = UniValue(UniValue::VOBJ);
+    params.pushKV("id", strSession);
+    params.pushKV("job_id", find_value(job, "job_id").get_str());
+    params.pushKV("nonce", HexStr(vInput.begin() + 108, vInput.end()));
+    reply = Call(hSocket, strBuffer, 3, "submit", params);
+    BOOST_CHECK(find_value(reply, "error").isNull());
+    BOOST_CHECK_EQUAL(find_value(find_value(reply, "result"), "status").get_str(), "OK");
+
+    // The block was processed before the reply was sent
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), 1);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hash);
+    }
+
+    CloseSocket(hSocket);
+    StopStratumServer();
+    mapArgs.erase("-stratumport");
+    addressConnection.disconnect();
+}
+
+#endif // ENABLE_MINING
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -253,4 +253,32 @@ BOOST_AUTO_TEST_CASE(streams_buffered_file_rand)
     fs::remove("streams_test_tmp");
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    uint32_t a = 0x01020304;
+    std::string b = "span";
+    std::vector<unsigned char> c{5, 6, 7};
+    ss << a << b << c;
+
+    CSpanReader reader(SER_DISK, CLIENT_VERSION, ss.data(), ss.data() + ss.size());
+    BOOST_CHECK_EQUAL(reader.size(), ss.size());
+    uint32_t a2;
+    std::string b2;
+    std::vector<unsigned char> c2;
+    reader >> a2 >> b2 >> c2;
+    BOOST_CHECK_EQUAL(a2, a);
+    BOOST_CHECK_EQUAL(b2, b);
+    BOOST_CHECK(c2 == c);
+    BOOST_CHECK(reader.empty());
+
+    // Reading past the end throws and leaves the reader where it was.
+    CSpanReader shortReader(SER_DISK, CLIENT_VERSION, ss.data(), ss.data() + 2);
+    BOOST_CHECK_THROW(shortReader >> a2, std::ios_base::failure);
+    BOOST_CHECK_EQUAL(shortReader.size(), 2);
+    shortReader.ignore(2);
+    BOOST_CHECK(shortReader.empty());
+    BOOST_CHECK_THROW(shortReader.ignore(1), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -49,4 +49,31 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_stats_sampling)
+{
+    unsigned int prev = g_lockstats_interval;
+    ResetLockStats();
+
+    Mutex mutex;
+    g_lockstats_interval = 0;
+    for (int i = 0; i < 4; i++) {
+        LOCK(mutex);
+    }
+    BOOST_CHECK(GetLockStats().empty());
+
+    g_lockstats_interval = 2;
+    for (int i = 0; i < 4; i++) {
+        LOCK(mutex);
+    }
+    std::vector<LockSiteStats> vStats = GetLockStats();
+    BOOST_REQUIRE_EQUAL(vStats.size(), 1U);
+    BOOST_CHECK_EQUAL(vStats[0].name, "mutex");
+    BOOST_CHECK_EQUAL(vStats[0].nSamples, 2U);
+    BOOST_CHECK_EQUAL(vStats[0].nContended, 0U);
+
+    ResetLockStats();
+    BOOST_CHECK(GetLockStats().empty());
+    g_lockstats_interval = prev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -55,7 +55,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
-    bundlecache::init(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
+    bundlecache::init(DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20), DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20));
 
     // Uncomment this to log all errors to stdout so we see them in test output.
     // We don't enable this by default because several tests intentionally cause
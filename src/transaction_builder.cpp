@@ -12,10 +12,15 @@
 #include "util/moneystr.h"
 #include "zcash/Note.hpp"
 
+#include <future>
+
 #include <librustzcash.h>
 #include <rust/builder.h>
 #include <rust/ed25519.h>
 
+/** The fewest transparent inputs worth signing on a thread of their own. */
+static const size_t MIN_INPUTS_PER_SIGNING_WORKER = 16;
+
 uint256 ProduceShieldedSignatureHash(
     uint32_t consensusBranchId,
     const CTransaction& tx,
@@ -608,22 +613,40 @@ TransactionBuilderResult TransactionBuilder::Build()
         return TransactionBuilderResult("Sprout joinSplitSig sanity check failed");
     }
 
-    // Transparent signatures
+    // Transparent signatures. The inputs are independent, so they are signed
+    // in contiguous ranges across the available cores, all sharing the
+    // precomputed sighash data, and the signatures are then applied in order.
     CTransaction txNewConst(mtx);
     const PrecomputedTransactionData txdata(txNewConst, tIns);
-    for (int nIn = 0; nIn < mtx.vin.size(); nIn++) {
-        auto tIn = tIns[nIn];
-        SignatureData sigdata;
-        bool signSuccess = ProduceSignature(
-            TransactionSignatureCreator(
-                keystore, &txNewConst, txdata, nIn, tIn.nValue, SIGHASH_ALL),
-            tIn.scriptPubKey, sigdata, consensusBranchId);
-
-        if (!signSuccess) {
+    size_t nIns = mtx.vin.size();
+    size_t nWorkers = std::max<size_t>(
+        std::min<size_t>(GetNumCores(), nIns / MIN_INPUTS_PER_SIGNING_WORKER), 1);
+    std::vector<SignatureData> vSigData(nIns);
+    std::vector<char> vSigned(nIns);
+    auto signRange = [&](size_t nBegin, size_t nEnd) {
+        for (size_t nIn = nBegin; nIn < nEnd; nIn++) {
+            const auto& tIn = tIns[nIn];
+            vSigned[nIn] = ProduceSignature(
+                TransactionSignatureCreator(
+                    keystore, &txNewConst, txdata, nIn, tIn.nValue, SIGHASH_ALL),
+                tIn.scriptPubKey, vSigData[nIn], consensusBranchId);
+        }
+    };
+    std::vector<std::future<void>> vWorkers;
+    for (size_t i = 1; i < nWorkers; i++) {
+        vWorkers.push_back(std::async(std::launch::async, signRange,
+            i * nIns / nWorkers, (i + 1) * nIns / nWorkers));
+    }
+    signRange(0, nIns / nWorkers);
+    for (auto& worker : vWorkers) {
+        worker.get();
+    }
+
+    for (size_t nIn = 0; nIn < nIns; nIn++) {
+        if (!vSigned[nIn]) {
             return TransactionBuilderResult("Failed to sign transaction");
-        } else {
-            UpdateTransaction(mtx, nIn, sigdata);
         }
+        UpdateTransaction(mtx, nIn, vSigData[nIn]);
     }
 
     return TransactionBuilderResult(CTransaction(mtx));
@@ -30,6 +30,11 @@
 class OrchardWallet;
 namespace orchard { class UnauthorizedBundle; }
 
+/** Maximum number of threads that Orchard proofs are created on */
+static const int MAX_PROOF_THREADS = 64;
+/** -proofthreads default (0 = one per core) */
+static const int DEFAULT_PROOF_THREADS = 0;
+
 uint256 ProduceShieldedSignatureHash(
     uint32_t consensusBranchId,
     const CTransaction& tx,
@@ -10,11 +10,15 @@
 #include "hash.h"
 #include "main.h"
 #include "pow.h"
+#include "shieldedindex.h"
 #include "uint256.h"
 #include "zcash/History.hpp"
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <future>
+
 #include <boost/thread.hpp>
 
 #include <rust/metrics.h>
@@ -32,6 +36,7 @@ static const char DB_ORCHARD_NULLIFIER = 'O';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
+static const char DB_SHIELDEDINDEX = 'k';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -49,18 +54,224 @@ static const char DB_MMR_ROOT = 'r';
 static const char DB_SUBTREE_LATEST = 'e';
 static const char DB_SUBTREE_DATA = 'n';
 
+static const char DB_NULLIFIER_JOURNAL = 'J';
+
 // insightexplorer
 static const char DB_ADDRESSINDEX = 'd';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSSUMMARY = 'D';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_TIMESTAMPINDEX = 'T';
 static const char DB_BLOCKHASHINDEX = 'h';
+static const char DB_INSIGHT_INDEX_BEST = 'I';
+
+// Chain state snapshots (dumptxoutset) start with this magic and version,
+// and hold the chain state records with these prefixes, in this order. The
+// nullifier journal is left out, as it is empty once a flush has finished.
+static const unsigned char COINS_SNAPSHOT_MAGIC[] = {'u', 't', 'x', 'o', 0xff};
+static const uint32_t COINS_SNAPSHOT_VERSION = 1;
+static const char COINS_SNAPSHOT_RECORDS[] = {
+    DB_BEST_BLOCK, DB_COINS,
+    DB_SPROUT_ANCHOR, DB_SAPLING_ANCHOR, DB_ORCHARD_ANCHOR,
+    DB_BEST_SPROUT_ANCHOR, DB_BEST_SAPLING_ANCHOR, DB_BEST_ORCHARD_ANCHOR,
+    DB_NULLIFIER, DB_SAPLING_NULLIFIER, DB_ORCHARD_NULLIFIER,
+    DB_MMR_LENGTH, DB_MMR_NODE, DB_MMR_ROOT,
+    DB_SUBTREE_LATEST, DB_SUBTREE_DATA,
+};
+
+// Lookups of the nullifiers of new spends always miss, so a lower bloom
+// filter false positive rate than the coin database's (about 1% at the
+// default -dbbloombits) saves a table read on most of them. Unless the
+// filters are disabled, the nullifier database uses at least this many.
+static const int NULLIFIER_DB_BLOOM_BITS = 16;
+// Nullifiers are only ever added (and removed on reorgs), so the nullifier
+// database compacts into larger tables.
+static const size_t NULLIFIER_DB_MAX_FILE_SIZE = 64 << 20;
+// Changes per journal entry, and nullifiers per batch when moving them
+// between databases.
+static const size_t NULLIFIER_BATCH_SIZE = 65536;
+// Address summary records erased per batch when they are rebuilt.
+static const size_t ADDRESS_SUMMARY_ERASE_BATCH_SIZE = 65536;
+// Transaction index entries and compact shielded blocks held between
+// flushes, past which they are written at once (tens of MiB at most).
+static const size_t MAX_PENDING_TX_INDEX = 262144;
+static const size_t MAX_PENDING_SHIELDED_INDEX = 4096;
+// History tree nodes kept in memory per epoch (about 4 MiB). Extending the
+// tree reads only the peaks and the nodes just appended, far fewer than this.
+static const size_t MAX_CACHED_HISTORY_NODES = 16384;
+
+// Key of a coins entry: DB_COINS followed by the txid. It is written for
+// every coin read or flushed, so it is serialized in one piece, with the
+// same bytes as make_pair(DB_COINS, txid).
+struct CoinsKey
+{
+    char prefix;
+    uint256 txid;
 
-CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
+    explicit CoinsKey(const uint256& txidIn) : prefix(DB_COINS), txid(txidIn) {}
+
+    ADD_FIXED_SIZE_SERIALIZE_METHODS(1 + 32);
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(prefix);
+        READWRITE(txid);
+    }
+};
+
+CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe, size_t nNullifierCacheSize,
+                           bool fResidentNullifiersIn) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
+    OpenNullifierDB(dbName, nNullifierCacheSize, fMemory, fWipe);
+    LoadSubtrees(SAPLING);
+    LoadSubtrees(ORCHARD);
+    if (fResidentNullifiersIn)
+        LoadResidentNullifiers();
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, size_t nNullifierCacheSize,
+                           bool fResidentNullifiersIn) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
 {
+    OpenNullifierDB("chainstate", nNullifierCacheSize, fMemory, fWipe);
+    LoadSubtrees(SAPLING);
+    LoadSubtrees(ORCHARD);
+    if (fResidentNullifiersIn)
+        LoadResidentNullifiers();
+}
+
+//! Move every nullifier from one database to another, in bounded batches.
+static void MoveNullifiers(CDBWrapper& from, CDBWrapper& to)
+{
+    size_t nMoved = 0;
+    for (char dbChar : {DB_NULLIFIER, DB_SAPLING_NULLIFIER, DB_ORCHARD_NULLIFIER}) {
+        while (true) {
+            std::vector<uint256> vNullifiers;
+            {
+                std::unique_ptr<CDBIterator> pcursor(from.NewIterator());
+                for (pcursor->Seek(dbChar); pcursor->Valid() && vNullifiers.size() < NULLIFIER_BATCH_SIZE; pcursor->Next()) {
+                    std::pair<char, uint256> key;
+                    if (!pcursor->GetKey(key) || key.first != dbChar) {
+                        break;
+                    }
+                    vNullifiers.push_back(key.second);
+                }
+            }
+            if (vNullifiers.empty()) {
+                break;
+            }
+            // Write before erasing, so an interrupted move is resumed on the next start.
+            CDBBatch toBatch(to);
+            CDBBatch fromBatch(from);
+            for (const uint256& nf : vNullifiers) {
+                toBatch.Write(make_pair(dbChar, nf), true);
+                fromBatch.Erase(make_pair(dbChar, nf));
+            }
+            to.WriteBatch(toBatch, true);
+            from.WriteBatch(fromBatch);
+            nMoved += vNullifiers.size();
+        }
+    }
+    if (nMoved > 0) {
+        LogPrintf("Moved %u nullifiers between the chain state databases\n", (unsigned int)nMoved);
+    }
+}
+
+void CCoinsViewDB::OpenNullifierDB(const std::string& dbName, size_t nNullifierCacheSize, bool fMemory, bool fWipe)
+{
+    fs::path path = GetDataDir() / (dbName + "_nullifiers");
+    bool fSeparate = nNullifierCacheSize > 0;
+    if (!fSeparate) {
+        if (fMemory || !fs::exists(path)) {
+            return;
+        }
+        if (fWipe) {
+            fs::remove_all(path);
+            return;
+        }
+        // The nullifiers were kept separately by an earlier run; open that
+        // database to move them back below.
+        nNullifierCacheSize = nMinDbCache << 20;
+    }
+
+    CDBTuning tuning = DefaultDBTuning();
+    if (tuning.nBloomBits > 0) {
+        tuning.nBloomBits = std::max(tuning.nBloomBits, NULLIFIER_DB_BLOOM_BITS);
+    }
+    tuning.nMaxFileSize = NULLIFIER_DB_MAX_FILE_SIZE;
+    nullifierDb.reset(new CDBWrapper(path, nNullifierCacheSize, fMemory, fWipe, tuning));
+
+    // Finish a write to the nullifier database that was interrupted.
+    CNullifierJournal journal;
+    uint32_t nChunks = 0;
+    CNullifierJournal chunk;
+    while (db.Read(make_pair(DB_NULLIFIER_JOURNAL, nChunks), chunk)) {
+        journal.insert(journal.end(), chunk.begin(), chunk.end());
+        nChunks++;
+    }
+    if (nChunks > 0) {
+        LogPrintf("Applying %u journaled nullifier changes\n", (unsigned int)journal.size());
+        ApplyNullifierJournal(journal, nChunks);
+    }
+
+    if (fSeparate) {
+        MoveNullifiers(db, *nullifierDb);
+    } else {
+        MoveNullifiers(*nullifierDb, db);
+        nullifierDb.reset();
+        fs::remove_all(path);
+    }
+}
+
+static const char NULLIFIER_DB_CHARS[3] = {DB_NULLIFIER, DB_SAPLING_NULLIFIER, DB_ORCHARD_NULLIFIER};
+
+void CCoinsViewDB::LoadResidentNullifiers()
+{
+    std::unique_lock<std::shared_mutex> lock(cs_residentNullifiers);
+    size_t nTotal = 0, nUsage = 0;
+    for (int i = 0; i < 3; i++) {
+        char dbChar = NULLIFIER_DB_CHARS[i];
+        std::unique_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(NullifierDB()).NewIterator());
+        for (pcursor->Seek(dbChar); pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != dbChar) {
+                break;
+            }
+            residentNullifiers[i].Insert(key.second);
+        }
+        nTotal += residentNullifiers[i].Size();
+        nUsage += residentNullifiers[i].DynamicMemoryUsage();
+    }
+    fResidentNullifiers = true;
+    LogPrintf("Loaded %u nullifiers into memory (%.1fMiB)\n", (unsigned int)nTotal, nUsage * (1.0 / 1024 / 1024));
+}
+
+void CCoinsViewDB::UpdateResidentNullifiers(const CNullifierJournal& changes)
+{
+    std::unique_lock<std::shared_mutex> lock(cs_residentNullifiers);
+    for (const auto& change : changes) {
+        CNullifierSet& set = residentNullifiers[std::find(NULLIFIER_DB_CHARS, NULLIFIER_DB_CHARS + 3, change.first.first) - NULLIFIER_DB_CHARS];
+        if (change.second)
+            set.Insert(change.first.second);
+        else
+            set.Erase(change.first.second);
+    }
+}
+
+void CCoinsViewDB::ApplyNullifierJournal(const CNullifierJournal& journal, uint32_t nChunks)
+{
+    CDBBatch nullifierBatch(*nullifierDb);
+    for (const auto& change : journal) {
+        if (change.second)
+            nullifierBatch.Write(change.first, true);
+        else
+            nullifierBatch.Erase(change.first);
+    }
+    nullifierDb->WriteBatch(nullifierBatch, true);
+
+    CDBBatch batch(db);
+    for (uint32_t i = 0; i < nChunks; i++) {
+        batch.Erase(make_pair(DB_NULLIFIER_JOURNAL, i));
+    }
+    db.WriteBatch(batch);
 }
 
 bool CCoinsViewDB::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const {
@@ -115,15 +326,19 @@ bool CCoinsViewDB::GetNullifier(const uint256 &nf, ShieldedType type) const {
         default:
             throw runtime_error("Unknown shielded type");
     }
-    return db.Read(make_pair(dbChar, nf), spent);
+    if (fResidentNullifiers) {
+        std::shared_lock<std::shared_mutex> lock(cs_residentNullifiers);
+        return residentNullifiers[type - 1].Contains(nf);
+    }
+    return NullifierDB().Read(make_pair(dbChar, nf), spent);
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    return db.Read(CoinsKey(txid), coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    return db.Exists(CoinsKey(txid));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -156,23 +371,26 @@ uint256 CCoinsViewDB::GetBestAnchor(ShieldedType type) const {
     return hashBestAnchor;
 }
 
-HistoryIndex CCoinsViewDB::GetHistoryLength(uint32_t epochId) const {
-    HistoryIndex historyLength;
-    if (!db.Read(make_pair(DB_MMR_LENGTH, epochId), historyLength)) {
-        // Starting new history
-        historyLength = 0;
+CCoinsViewDB::HistoryEpochCache& CCoinsViewDB::LoadHistoryEpoch(uint32_t epochId) const {
+    auto it = historyCache.find(epochId);
+    if (it != historyCache.end()) {
+        return it->second;
     }
 
-    return historyLength;
+    HistoryEpochCache epoch;
+    if (!db.Read(make_pair(DB_MMR_LENGTH, epochId), epoch.length)) {
+        // Starting new history
+        epoch.length = 0;
+    }
+    if (!db.Read(make_pair(DB_MMR_ROOT, epochId), epoch.root)) {
+        epoch.root = uint256();
+    }
+    return historyCache.emplace(epochId, std::move(epoch)).first->second;
 }
 
-HistoryNode CCoinsViewDB::GetHistoryAt(uint32_t epochId, HistoryIndex index) const {
+HistoryNode CCoinsViewDB::ReadHistoryNode(uint32_t epochId, HistoryIndex index) const {
     HistoryNode mmrNode = {};
 
-    if (index >= GetHistoryLength(epochId)) {
-        throw runtime_error("History data inconsistent - reindex?");
-    }
-
     if (libzcash::IsV1HistoryTree(epochId)) {
         // History nodes serialized by `zcashd` versions that were unaware of NU5, used
         // the previous shorter maximum serialized length. Because we stored this as an
@@ -196,13 +414,70 @@ HistoryNode CCoinsViewDB::GetHistoryAt(uint32_t epochId, HistoryIndex index) con
     return mmrNode;
 }
 
-uint256 CCoinsViewDB::GetHistoryRoot(uint32_t epochId) const {
-    uint256 root;
-    if (!db.Read(make_pair(DB_MMR_ROOT, epochId), root))
-    {
-        root = uint256();
+void CCoinsViewDB::CacheHistoryNode(HistoryEpochCache& epoch, HistoryIndex index, const HistoryNode& node) const {
+    epoch.nodes[index] = std::make_pair(node, nHistoryTick++);
+    if (epoch.nodes.size() <= MAX_CACHED_HISTORY_NODES) {
+        return;
+    }
+
+    // Drop the least recently used half of the nodes.
+    std::vector<uint64_t> ticks;
+    ticks.reserve(epoch.nodes.size());
+    for (const auto& [_, entry] : epoch.nodes) {
+        ticks.push_back(entry.second);
+    }
+    auto median = ticks.begin() + ticks.size() / 2;
+    std::nth_element(ticks.begin(), median, ticks.end());
+    for (auto it = epoch.nodes.begin(); it != epoch.nodes.end();) {
+        it = it->second.second < *median ? epoch.nodes.erase(it) : std::next(it);
+    }
+}
+
+void CCoinsViewDB::UpdateHistoryCache(const CHistoryCacheMap& historyCacheMap) {
+    std::unique_lock<std::mutex> lock(cs_historyCache);
+    for (const auto& [epochId, update] : historyCacheMap) {
+        auto it = historyCache.find(epochId);
+        if (it == historyCache.end()) {
+            // Not cached yet; it will be read from the database when needed.
+            continue;
+        }
+        auto& epoch = it->second;
+        epoch.nodes.erase(epoch.nodes.lower_bound(update.updateDepth), epoch.nodes.end());
+        for (const auto& [index, node] : update.appends) {
+            CacheHistoryNode(epoch, index, node);
+        }
+        epoch.length = update.length;
+        epoch.root = update.root;
     }
-    return root;
+}
+
+HistoryIndex CCoinsViewDB::GetHistoryLength(uint32_t epochId) const {
+    std::unique_lock<std::mutex> lock(cs_historyCache);
+    return LoadHistoryEpoch(epochId).length;
+}
+
+HistoryNode CCoinsViewDB::GetHistoryAt(uint32_t epochId, HistoryIndex index) const {
+    std::unique_lock<std::mutex> lock(cs_historyCache);
+    auto& epoch = LoadHistoryEpoch(epochId);
+
+    if (index >= epoch.length) {
+        throw runtime_error("History data inconsistent - reindex?");
+    }
+
+    auto it = epoch.nodes.find(index);
+    if (it != epoch.nodes.end()) {
+        it->second.second = nHistoryTick++;
+        return it->second.first;
+    }
+
+    HistoryNode mmrNode = ReadHistoryNode(epochId, index);
+    CacheHistoryNode(epoch, index, mmrNode);
+    return mmrNode;
+}
+
+uint256 CCoinsViewDB::GetHistoryRoot(uint32_t epochId) const {
+    std::unique_lock<std::mutex> lock(cs_historyCache);
+    return LoadHistoryEpoch(epochId).root;
 }
 
 
@@ -218,29 +493,74 @@ std::optional<libzcash::LatestSubtree> CCoinsViewDB::GetLatestSubtree(ShieldedTy
 std::optional<libzcash::SubtreeData> CCoinsViewDB::GetSubtreeData(
         ShieldedType type, libzcash::SubtreeIndex index) const
 {
-    libzcash::SubtreeData subtreeData;
-    if (!db.Read(make_pair(DB_SUBTREE_DATA, make_pair((uint8_t) type, index)), subtreeData)) {
+    if (type != SAPLING && type != ORCHARD) {
+        return std::nullopt;
+    }
+    auto subtrees = std::atomic_load(type == SAPLING ? &saplingSubtrees : &orchardSubtrees);
+    if (index >= subtrees->size()) {
         return std::nullopt;
     }
-    return subtreeData;
+    return (*subtrees)[index];
+}
+
+void CCoinsViewDB::LoadSubtrees(ShieldedType type)
+{
+    auto subtrees = std::make_shared<SubtreeList>();
+    auto latestSubtree = GetLatestSubtree(type);
+    if (latestSubtree.has_value()) {
+        subtrees->reserve(latestSubtree->index + 1);
+        for (libzcash::SubtreeIndex index = 0; index <= latestSubtree->index; index++) {
+            libzcash::SubtreeData subtreeData;
+            if (!db.Read(make_pair(DB_SUBTREE_DATA, make_pair((uint8_t) type, index)), subtreeData)) {
+                break;
+            }
+            subtrees->push_back(subtreeData);
+        }
+    }
+    std::atomic_store(type == SAPLING ? &saplingSubtrees : &orchardSubtrees,
+                      std::shared_ptr<const SubtreeList>(std::move(subtrees)));
+}
+
+void CCoinsViewDB::UpdateSubtrees(ShieldedType type, const SubtreeCache& cache)
+{
+    auto& current = type == SAPLING ? saplingSubtrees : orchardSubtrees;
+    auto subtrees = std::atomic_load(&current);
+
+    // The subtrees after the cache's view of the latest one were erased,
+    // and the cache's new subtrees were written after it.
+    size_t nKept = cache.parentLatestSubtree.has_value() ? cache.parentLatestSubtree->index + 1 : 0;
+    if (nKept > subtrees->size()) {
+        // The list stopped short of the database; read it again.
+        LoadSubtrees(type);
+        return;
+    }
+    if (nKept == subtrees->size() && cache.newSubtrees.empty()) {
+        return;
+    }
+
+    auto updated = std::make_shared<SubtreeList>(subtrees->begin(), subtrees->begin() + nKept);
+    updated->insert(updated->end(), cache.newSubtrees.begin(), cache.newSubtrees.end());
+    std::atomic_store(&current, std::shared_ptr<const SubtreeList>(std::move(updated)));
 }
 
-void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char& dbChar)
+void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char& dbChar, bool fErase, CNullifierJournal* pjournal)
 {
     for (CNullifiersMap::iterator it = mapToUse.begin(); it != mapToUse.end();) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
-            if (!it->second.entered)
+            if (pjournal)
+                pjournal->emplace_back(make_pair(dbChar, it->first), it->second.entered);
+            else if (!it->second.entered)
                 batch.Erase(make_pair(dbChar, it->first));
             else
                 batch.Write(make_pair(dbChar, it->first), true);
             // TODO: changed++? ... See comment in CCoinsViewDB::BatchWrite. If this is needed we could return an int
         }
-        it = mapToUse.erase(it);
+        it = fErase ? mapToUse.erase(it) : std::next(it);
     }
 }
 
 template<typename Map, typename MapIterator, typename MapEntry, typename Tree>
-void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
+void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar, bool fErase)
 {
     for (MapIterator it = mapToUse.begin(); it != mapToUse.end();) {
         if (it->second.flags & MapEntry::DIRTY) {
@@ -248,12 +568,12 @@ void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
                 batch.Erase(make_pair(dbChar, it->first));
             else {
                 if (it->first != Tree::empty_root()) {
-                    batch.Write(make_pair(dbChar, it->first), it->second.tree);
+                    batch.Write(make_pair(dbChar, it->first), *it->second.tree);
                 }
             }
             // TODO: changed++?
         }
-        it = mapToUse.erase(it);
+        it = fErase ? mapToUse.erase(it) : std::next(it);
     }
 }
 
@@ -354,6 +674,47 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
                               CHistoryCacheMap &historyCacheMap,
                               SubtreeCache &cacheSaplingSubtrees,
                               SubtreeCache &cacheOrchardSubtrees) {
+    return WriteCoinsBatch(true, mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor, hashOrchardAnchor,
+                           mapSproutAnchors, mapSaplingAnchors, mapOrchardAnchors,
+                           mapSproutNullifiers, mapSaplingNullifiers, mapOrchardNullifiers,
+                           historyCacheMap, cacheSaplingSubtrees, cacheOrchardSubtrees);
+}
+
+bool CCoinsViewDB::WriteSnapshot(CCoinsMap &mapCoins,
+                                 const uint256 &hashBlock,
+                                 const uint256 &hashSproutAnchor,
+                                 const uint256 &hashSaplingAnchor,
+                                 const uint256 &hashOrchardAnchor,
+                                 CAnchorsSproutMap &mapSproutAnchors,
+                                 CAnchorsSaplingMap &mapSaplingAnchors,
+                                 CAnchorsOrchardMap &mapOrchardAnchors,
+                                 CNullifiersMap &mapSproutNullifiers,
+                                 CNullifiersMap &mapSaplingNullifiers,
+                                 CNullifiersMap &mapOrchardNullifiers,
+                                 CHistoryCacheMap &historyCacheMap,
+                                 SubtreeCache &cacheSaplingSubtrees,
+                                 SubtreeCache &cacheOrchardSubtrees) {
+    return WriteCoinsBatch(false, mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor, hashOrchardAnchor,
+                           mapSproutAnchors, mapSaplingAnchors, mapOrchardAnchors,
+                           mapSproutNullifiers, mapSaplingNullifiers, mapOrchardNullifiers,
+                           historyCacheMap, cacheSaplingSubtrees, cacheOrchardSubtrees);
+}
+
+bool CCoinsViewDB::WriteCoinsBatch(bool fErase,
+                                   CCoinsMap &mapCoins,
+                                   const uint256 &hashBlock,
+                                   const uint256 &hashSproutAnchor,
+                                   const uint256 &hashSaplingAnchor,
+                                   const uint256 &hashOrchardAnchor,
+                                   CAnchorsSproutMap &mapSproutAnchors,
+                                   CAnchorsSaplingMap &mapSaplingAnchors,
+                                   CAnchorsOrchardMap &mapOrchardAnchors,
+                                   CNullifiersMap &mapSproutNullifiers,
+                                   CNullifiersMap &mapSaplingNullifiers,
+                                   CNullifiersMap &mapOrchardNullifiers,
+                                   CHistoryCacheMap &historyCacheMap,
+                                   SubtreeCache &cacheSaplingSubtrees,
+                                   SubtreeCache &cacheOrchardSubtrees) {
     auto latestSaplingSubtree = GetLatestSubtree(SAPLING);
     auto latestOrchardSubtree = GetLatestSubtree(ORCHARD);
 
@@ -363,22 +724,41 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
+                batch.Erase(CoinsKey(it->first));
             else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+                batch.Write(CoinsKey(it->first), it->second.coins);
             changed++;
         }
         count++;
-        it = mapCoins.erase(it);
+        it = fErase ? mapCoins.erase(it) : std::next(it);
     }
 
-    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
-    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
-    ::BatchWriteAnchors<CAnchorsOrchardMap, CAnchorsOrchardMap::iterator, CAnchorsOrchardCacheEntry, OrchardMerkleFrontier>(batch, mapOrchardAnchors, DB_ORCHARD_ANCHOR);
-
-    ::BatchWriteNullifiers(batch, mapSproutNullifiers, DB_NULLIFIER);
-    ::BatchWriteNullifiers(batch, mapSaplingNullifiers, DB_SAPLING_NULLIFIER);
-    ::BatchWriteNullifiers(batch, mapOrchardNullifiers, DB_ORCHARD_NULLIFIER);
+    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR, fErase);
+    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR, fErase);
+    ::BatchWriteAnchors<CAnchorsOrchardMap, CAnchorsOrchardMap::iterator, CAnchorsOrchardCacheEntry, OrchardMerkleFrontier>(batch, mapOrchardAnchors, DB_ORCHARD_ANCHOR, fErase);
+
+    // With a separate nullifier database, the nullifier changes are journaled
+    // in this batch, next to the best block, and applied once it is written.
+    // They are also collected to update the resident nullifier sets.
+    CNullifierJournal journal;
+    CNullifierJournal* pjournal = nullifierDb || fResidentNullifiers ? &journal : nullptr;
+    ::BatchWriteNullifiers(batch, mapSproutNullifiers, DB_NULLIFIER, fErase, pjournal);
+    ::BatchWriteNullifiers(batch, mapSaplingNullifiers, DB_SAPLING_NULLIFIER, fErase, pjournal);
+    ::BatchWriteNullifiers(batch, mapOrchardNullifiers, DB_ORCHARD_NULLIFIER, fErase, pjournal);
+    uint32_t nJournalChunks = 0;
+    if (nullifierDb) {
+        for (size_t i = 0; i < journal.size(); i += NULLIFIER_BATCH_SIZE) {
+            CNullifierJournal chunk(journal.begin() + i, journal.begin() + std::min(journal.size(), i + NULLIFIER_BATCH_SIZE));
+            batch.Write(make_pair(DB_NULLIFIER_JOURNAL, nJournalChunks++), chunk);
+        }
+    } else {
+        for (const auto& change : journal) {
+            if (change.second)
+                batch.Write(change.first, true);
+            else
+                batch.Erase(change.first);
+        }
+    }
 
     ::BatchWriteHistory(batch, historyCacheMap);
 
@@ -398,10 +778,60 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         batch.Write(DB_BEST_ORCHARD_ANCHOR, hashOrchardAnchor);
 
     LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    if (nJournalChunks == 0) {
+        if (!db.WriteBatch(batch)) {
+            return false;
+        }
+        UpdateHistoryCache(historyCacheMap);
+        UpdateSubtrees(SAPLING, cacheSaplingSubtrees);
+        UpdateSubtrees(ORCHARD, cacheOrchardSubtrees);
+        if (fResidentNullifiers)
+            UpdateResidentNullifiers(journal);
+        return true;
+    }
+    // The nullifier database is written with sync, so this batch must be too,
+    // or a system crash could leave the coin database behind it.
+    db.WriteBatch(batch, true);
+    UpdateHistoryCache(historyCacheMap);
+    UpdateSubtrees(SAPLING, cacheSaplingSubtrees);
+    UpdateSubtrees(ORCHARD, cacheOrchardSubtrees);
+    ApplyNullifierJournal(journal, nJournalChunks);
+    if (fResidentNullifiers)
+        UpdateResidentNullifiers(journal);
+    return true;
+}
+
+struct CBlockTreeDB::PendingIndex
+{
+    std::map<uint256, CDiskTxPos> txIndex;
+    std::map<uint256, CCompactShieldedBlock> shieldedIndex;
+};
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe), pending(new PendingIndex()) {
+}
+
+CBlockTreeDB::~CBlockTreeDB() {
+    std::lock_guard<std::mutex> lock(cs_pending);
+    if (!pending->txIndex.empty() || !pending->shieldedIndex.empty()) {
+        CDBBatch batch(*this);
+        MovePendingIndex(batch);
+        try {
+            WriteBatch(batch, true);
+        } catch (const dbwrapper_error& e) {
+            LogPrintf("%s: failed to write pending index entries: %s\n", __func__, e.what());
+        }
+    }
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+void CBlockTreeDB::MovePendingIndex(CDBBatch& batch) {
+    for (const auto& it : pending->txIndex) {
+        batch.Write(make_pair(DB_TXINDEX, it.first), it.second);
+    }
+    for (const auto& it : pending->shieldedIndex) {
+        batch.Write(make_pair(DB_SHIELDEDINDEX, it.first), it.second);
+    }
+    pending->txIndex.clear();
+    pending->shieldedIndex.clear();
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) const {
@@ -470,6 +900,384 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     return true;
 }
 
+bool CCoinsViewDB::DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const {
+    metadata = CCoinsSnapshotMetadata();
+    metadata.hashBlock = GetBestBlock();
+    if (metadata.hashBlock.IsNull())
+        return error("CCoinsViewDB::DumpSnapshot() : the chain state is empty");
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << metadata.hashBlock;
+    file.write((const char*)COINS_SNAPSHOT_MAGIC, sizeof(COINS_SNAPSHOT_MAGIC));
+    file << COINS_SNAPSHOT_VERSION << metadata.hashBlock;
+
+    // Every record is written as it is stored, so the snapshot holds exactly
+    // what the chain state database would after connecting its block.
+    std::vector<unsigned char> key, value;
+    for (char dbChar : COINS_SNAPSHOT_RECORDS) {
+        bool fNullifiers = dbChar == DB_NULLIFIER || dbChar == DB_SAPLING_NULLIFIER || dbChar == DB_ORCHARD_NULLIFIER;
+        const CDBWrapper& source = fNullifiers ? NullifierDB() : db;
+        boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(source).NewIterator());
+        for (pcursor->Seek(dbChar); pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            pcursor->GetRawKey(key);
+            if (key.empty() || key[0] != (unsigned char)dbChar)
+                break;
+            pcursor->GetRawValue(value);
+            file << key << value;
+            ss << key << value;
+            metadata.nRecords++;
+            if (dbChar == DB_COINS)
+                metadata.nCoins++;
+        }
+    }
+    // An empty key ends the records.
+    file << std::vector<unsigned char>() << metadata.nRecords;
+    metadata.hashSnapshot = ss.GetHash();
+    file << metadata.hashSnapshot;
+    return true;
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn) :
+    CCoinsViewBacked(dbIn), db(dbIn), fFailed(false), fShutdown(false)
+{
+    writer = std::thread(&CCoinsViewBackgroundFlush::ThreadWrite, this);
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        fShutdown = true;
+    }
+    cond.notify_all();
+    // The writer finishes any snapshot in flight before it exits.
+    writer.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    RenameThread("zc-coinsflush");
+    while (true) {
+        Snapshot* snapshot;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait(lock, [&]() { return fShutdown || pending; });
+            if (!pending) return;
+            snapshot = pending.get();
+        }
+
+        // Readers only look the snapshot up, and nothing else modifies it
+        // until it is released below, so it can be written without holding cs.
+        int64_t nStart = GetTimeMicros();
+        bool fOk;
+        try {
+            fOk = db->WriteSnapshot(snapshot->mapCoins,
+                                    snapshot->hashBlock,
+                                    snapshot->hashSproutAnchor,
+                                    snapshot->hashSaplingAnchor,
+                                    snapshot->hashOrchardAnchor,
+                                    snapshot->mapSproutAnchors,
+                                    snapshot->mapSaplingAnchors,
+                                    snapshot->mapOrchardAnchors,
+                                    snapshot->mapSproutNullifiers,
+                                    snapshot->mapSaplingNullifiers,
+                                    snapshot->mapOrchardNullifiers,
+                                    snapshot->historyCacheMap,
+                                    snapshot->cacheSaplingSubtrees,
+                                    snapshot->cacheOrchardSubtrees);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: error writing to coin database: %s\n", __func__, e.what());
+            fOk = false;
+        }
+        LogPrint("coindb", "Background flush of %u coins took %.2fms\n",
+            (unsigned int)snapshot->mapCoins.size(), (GetTimeMicros() - nStart) * 0.001);
+
+        std::unique_ptr<Snapshot> done;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            done = std::move(pending);
+            if (!fOk) fFailed = true;
+        }
+        cond.notify_all();
+        // Free the snapshot outside the lock; for a large cache this takes a while.
+        done.reset();
+    }
+}
+
+template<typename Tree, typename Map>
+static std::optional<bool> GetSnapshotAnchor(const Map& map, const uint256 &rt, Tree &tree)
+{
+    // The database always has the empty root, whatever the cache says.
+    if (rt == Tree::empty_root()) return std::nullopt;
+    auto it = map.find(rt);
+    if (it == map.end()) return std::nullopt;
+    if (it->second.entered) tree = *it->second.tree;
+    return it->second.entered;
+}
+
+bool CCoinsViewBackgroundFlush::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto found = GetSnapshotAnchor(pending->mapSproutAnchors, rt, tree);
+            if (found.has_value()) return found.value();
+        }
+    }
+    return base->GetSproutAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto found = GetSnapshotAnchor(pending->mapSaplingAnchors, rt, tree);
+            if (found.has_value()) return found.value();
+        }
+    }
+    return base->GetSaplingAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetOrchardAnchorAt(const uint256 &rt, OrchardMerkleFrontier &tree) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto found = GetSnapshotAnchor(pending->mapOrchardAnchors, rt, tree);
+            if (found.has_value()) return found.value();
+        }
+    }
+    return base->GetOrchardAnchorAt(rt, tree);
+}
+
+bool CCoinsViewBackgroundFlush::GetNullifier(const uint256 &nf, ShieldedType type) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            const CNullifiersMap* map;
+            switch (type) {
+                case SPROUT:
+                    map = &pending->mapSproutNullifiers;
+                    break;
+                case SAPLING:
+                    map = &pending->mapSaplingNullifiers;
+                    break;
+                case ORCHARD:
+                    map = &pending->mapOrchardNullifiers;
+                    break;
+                default:
+                    throw std::runtime_error("Unknown shielded type");
+            }
+            auto it = map->find(nf);
+            if (it != map->end()) return it->second.entered;
+        }
+    }
+    return base->GetNullifier(nf, type);
+}
+
+bool CCoinsViewBackgroundFlush::GetCoins(const uint256 &txid, CCoins &coins) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto it = pending->mapCoins.find(txid);
+            if (it != pending->mapCoins.end()) {
+                // Pruned entries are erased from the database by the write.
+                if (it->second.coins.IsPruned()) return false;
+                coins = it->second.coins;
+                return true;
+            }
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoins(const uint256 &txid) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto it = pending->mapCoins.find(txid);
+            if (it != pending->mapCoins.end()) return !it->second.coins.IsPruned();
+        }
+    }
+    return base->HaveCoins(txid);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending && !pending->hashBlock.IsNull()) return pending->hashBlock;
+    }
+    return base->GetBestBlock();
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestAnchor(ShieldedType type) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            const uint256* hash;
+            switch (type) {
+                case SPROUT:
+                    hash = &pending->hashSproutAnchor;
+                    break;
+                case SAPLING:
+                    hash = &pending->hashSaplingAnchor;
+                    break;
+                case ORCHARD:
+                    hash = &pending->hashOrchardAnchor;
+                    break;
+                default:
+                    throw std::runtime_error("Unknown shielded type");
+            }
+            if (!hash->IsNull()) return *hash;
+        }
+    }
+    return base->GetBestAnchor(type);
+}
+
+HistoryIndex CCoinsViewBackgroundFlush::GetHistoryLength(uint32_t epochId) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto it = pending->historyCacheMap.find(epochId);
+            if (it != pending->historyCacheMap.end()) return it->second.length;
+        }
+    }
+    return base->GetHistoryLength(epochId);
+}
+
+HistoryNode CCoinsViewBackgroundFlush::GetHistoryAt(uint32_t epochId, HistoryIndex index) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto it = pending->historyCacheMap.find(epochId);
+            if (it != pending->historyCacheMap.end() && index >= it->second.updateDepth) {
+                auto node = it->second.appends.find(index);
+                if (node == it->second.appends.end()) {
+                    throw std::runtime_error("Invalid history request");
+                }
+                return node->second;
+            }
+        }
+    }
+    return base->GetHistoryAt(epochId, index);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetHistoryRoot(uint32_t epochId) const {
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (pending) {
+            auto it = pending->historyCacheMap.find(epochId);
+            if (it != pending->historyCacheMap.end()) return it->second.root;
+        }
+    }
+    return base->GetHistoryRoot(epochId);
+}
+
+std::optional<libzcash::LatestSubtree> CCoinsViewBackgroundFlush::GetLatestSubtree(ShieldedType type) const {
+    std::unique_lock<std::mutex> lock(cs);
+    if (pending) {
+        // The snapshot's subtree caches are initialized against the database
+        // as it was before the write, which still holds every subtree they
+        // defer to.
+        switch (type) {
+            case SAPLING:
+                return pending->cacheSaplingSubtrees.GetLatestSubtree(db);
+            case ORCHARD:
+                return pending->cacheOrchardSubtrees.GetLatestSubtree(db);
+            default:
+                throw std::runtime_error("GetLatestSubtree: unsupported shielded type");
+        }
+    }
+    lock.unlock();
+    return base->GetLatestSubtree(type);
+}
+
+std::optional<libzcash::SubtreeData> CCoinsViewBackgroundFlush::GetSubtreeData(
+    ShieldedType type,
+    libzcash::SubtreeIndex index) const
+{
+    std::unique_lock<std::mutex> lock(cs);
+    if (pending) {
+        switch (type) {
+            case SAPLING:
+                return pending->cacheSaplingSubtrees.GetSubtreeData(db, index);
+            case ORCHARD:
+                return pending->cacheOrchardSubtrees.GetSubtreeData(db, index);
+            default:
+                throw std::runtime_error("GetSubtreeData: unsupported shielded type");
+        }
+    }
+    lock.unlock();
+    return base->GetSubtreeData(type, index);
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins,
+                                           const uint256 &hashBlock,
+                                           const uint256 &hashSproutAnchor,
+                                           const uint256 &hashSaplingAnchor,
+                                           const uint256 &hashOrchardAnchor,
+                                           CAnchorsSproutMap &mapSproutAnchors,
+                                           CAnchorsSaplingMap &mapSaplingAnchors,
+                                           CAnchorsOrchardMap &mapOrchardAnchors,
+                                           CNullifiersMap &mapSproutNullifiers,
+                                           CNullifiersMap &mapSaplingNullifiers,
+                                           CNullifiersMap &mapOrchardNullifiers,
+                                           CHistoryCacheMap &historyCacheMap,
+                                           SubtreeCache &cacheSaplingSubtrees,
+                                           SubtreeCache &cacheOrchardSubtrees) {
+    assert(cacheSaplingSubtrees.initialized);
+    assert(cacheOrchardSubtrees.initialized);
+
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [&]() { return !pending; });
+    if (fFailed) return false;
+
+    // Nothing is layered in between, so the child's maps can be taken over
+    // whole; they are left empty for the caller to clear.
+    std::unique_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->mapCoins.swap(mapCoins);
+    snapshot->hashBlock = hashBlock;
+    snapshot->hashSproutAnchor = hashSproutAnchor;
+    snapshot->hashSaplingAnchor = hashSaplingAnchor;
+    snapshot->hashOrchardAnchor = hashOrchardAnchor;
+    snapshot->mapSproutAnchors.swap(mapSproutAnchors);
+    snapshot->mapSaplingAnchors.swap(mapSaplingAnchors);
+    snapshot->mapOrchardAnchors.swap(mapOrchardAnchors);
+    snapshot->mapSproutNullifiers.swap(mapSproutNullifiers);
+    snapshot->mapSaplingNullifiers.swap(mapSaplingNullifiers);
+    snapshot->mapOrchardNullifiers.swap(mapOrchardNullifiers);
+    snapshot->historyCacheMap.swap(historyCacheMap);
+    snapshot->cacheSaplingSubtrees = cacheSaplingSubtrees;
+    snapshot->cacheOrchardSubtrees = cacheOrchardSubtrees;
+    pending = std::move(snapshot);
+    lock.unlock();
+    cond.notify_all();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::GetStats(CCoinsStats &stats) const {
+    // Statistics are computed from the database alone.
+    if (!Sync()) return false;
+    return base->GetStats(stats);
+}
+
+bool CCoinsViewBackgroundFlush::DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const {
+    if (!Sync()) return false;
+    return base->DumpSnapshot(file, metadata);
+}
+
+bool CCoinsViewBackgroundFlush::Sync() const
+{
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [&]() { return !pending; });
+    return !fFailed;
+}
+
+bool CCoinsViewBackgroundFlush::IsFlushing() const
+{
+    std::unique_lock<std::mutex> lock(cs);
+    return (bool)pending;
+}
+
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo) {
     MetricsIncrementCounter("zcashd.debug.blocktree.write_batch");
     CDBBatch batch(*this);
@@ -482,6 +1290,9 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
         CDiskBlockIndex dbindex {it};
         batch.Write(key, dbindex);
     }
+    // Readers find the pending entries until the batch is written.
+    std::lock_guard<std::mutex> lock(cs_pending);
+    MovePendingIndex(batch);
     return WriteBatch(batch, true);
 }
 
@@ -498,14 +1309,51 @@ bool CBlockTreeDB::ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) const {
+    {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        auto it = pending->txIndex.find(txid);
+        if (it != pending->txIndex.end()) {
+            pos = it->second;
+            return true;
+        }
+    }
     return Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
 bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
+    std::lock_guard<std::mutex> lock(cs_pending);
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+        pending->txIndex[it->first] = it->second;
+    // Bound the memory held between flushes.
+    if (pending->txIndex.size() > MAX_PENDING_TX_INDEX) {
+        CDBBatch batch(*this);
+        MovePendingIndex(batch);
+        return WriteBatch(batch);
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadShieldedIndex(const uint256 &blockhash, CCompactShieldedBlock &compact) const {
+    {
+        std::lock_guard<std::mutex> lock(cs_pending);
+        auto it = pending->shieldedIndex.find(blockhash);
+        if (it != pending->shieldedIndex.end()) {
+            compact = it->second;
+            return true;
+        }
+    }
+    return Read(make_pair(DB_SHIELDEDINDEX, blockhash), compact);
+}
+
+bool CBlockTreeDB::WriteShieldedIndex(const uint256 &blockhash, const CCompactShieldedBlock &compact) {
+    std::lock_guard<std::mutex> lock(cs_pending);
+    pending->shieldedIndex[blockhash] = compact;
+    if (pending->shieldedIndex.size() > MAX_PENDING_SHIELDED_INDEX) {
+        CDBBatch batch(*this);
+        MovePendingIndex(batch);
+        return WriteBatch(batch);
+    }
+    return true;
 }
 
 // START insightexplorer
@@ -651,6 +1499,116 @@ bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &lt
     ltimestamp = lts.ltimestamp;
     return true;
 }
+
+bool CBlockTreeDB::ReadAddressSummary(const CAddressIndexIteratorKey &key, CAddressSummary &summary) const
+{
+    return Read(make_pair(DB_ADDRESSSUMMARY, key), summary);
+}
+
+bool CBlockTreeDB::ReadAddressLastHeight(const CAddressIndexIteratorKey &key, int beforeHeight, int &height)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // The entries of an address are ordered by height, so the last one
+    // below beforeHeight is the one before the first at or above it.
+    pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(key.type, key.hashBytes, beforeHeight)));
+    if (pcursor->Valid()) {
+        pcursor->Prev();
+    } else {
+        pcursor->SeekToLast();
+    }
+    std::pair<char, CAddressIndexKey> entry;
+    if (!(pcursor->Valid() && pcursor->GetKey(entry) && entry.first == DB_ADDRESSINDEX &&
+          entry.second.type == key.type && entry.second.hashBytes == key.hashBytes)) {
+        return false;
+    }
+    height = entry.second.blockHeight;
+    return true;
+}
+
+bool CBlockTreeDB::EraseAddressSummaries()
+{
+    // Erase in bounded batches, as there is a record for every address.
+    while (true) {
+        std::vector<CAddressIndexIteratorKey> vKeys;
+        {
+            boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+            for (pcursor->Seek(DB_ADDRESSSUMMARY); pcursor->Valid() && vKeys.size() < ADDRESS_SUMMARY_ERASE_BATCH_SIZE; pcursor->Next()) {
+                std::pair<char, CAddressIndexIteratorKey> key;
+                if (!pcursor->GetKey(key) || key.first != DB_ADDRESSSUMMARY) {
+                    break;
+                }
+                vKeys.push_back(key.second);
+            }
+        }
+        if (vKeys.empty()) {
+            return true;
+        }
+        CDBBatch batch(*this);
+        for (const CAddressIndexIteratorKey& key : vKeys) {
+            batch.Erase(make_pair(DB_ADDRESSSUMMARY, key));
+        }
+        if (!WriteBatch(batch)) {
+            return false;
+        }
+    }
+}
+
+bool CBlockTreeDB::UpdateInsightIndex(
+    const std::vector<CAddressIndexDbEntry> &addressIndex,
+    const std::vector<CAddressIndexDbEntry> &addressIndexErase,
+    const std::vector<CAddressUnspentDbEntry> &addressUnspentIndex,
+    const std::vector<CAddressSummaryDbEntry> &addressSummaries,
+    const std::vector<CSpentIndexDbEntry> &spentIndex,
+    const std::vector<CTimestampIndexKey> &timestampIndex,
+    const uint256 &hashBestBlock)
+{
+    CDBBatch batch(*this);
+    for (const CAddressIndexDbEntry& entry : addressIndexErase) {
+        batch.Erase(make_pair(DB_ADDRESSINDEX, entry.first));
+    }
+    for (const CAddressIndexDbEntry& entry : addressIndex) {
+        batch.Write(make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+    }
+    for (const CAddressUnspentDbEntry& entry : addressUnspentIndex) {
+        if (entry.second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+        }
+    }
+    for (const CAddressSummaryDbEntry& entry : addressSummaries) {
+        if (entry.second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSSUMMARY, entry.first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSSUMMARY, entry.first), entry.second);
+        }
+    }
+    for (const CSpentIndexDbEntry& entry : spentIndex) {
+        if (entry.second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, entry.first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, entry.first), entry.second);
+        }
+    }
+    for (const CTimestampIndexKey& key : timestampIndex) {
+        batch.Write(make_pair(DB_TIMESTAMPINDEX, key), 0);
+        batch.Write(make_pair(DB_BLOCKHASHINDEX, CTimestampBlockIndexKey(key.blockHash)),
+                    CTimestampBlockIndexValue(key.timestamp));
+    }
+    batch.Write(DB_INSIGHT_INDEX_BEST, hashBestBlock);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadInsightIndexBestBlock(uint256 &hashBestBlock) const
+{
+    return Read(DB_INSIGHT_INDEX_BEST, hashBestBlock);
+}
+
+bool CBlockTreeDB::WriteInsightIndexBestBlock(const uint256 &hashBestBlock)
+{
+    return Write(DB_INSIGHT_INDEX_BEST, hashBestBlock);
+}
 // END insightexplorer
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -667,102 +1625,146 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) const {
 
 bool CBlockTreeDB::LoadBlockIndexGuts(
     std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
-    const CChainParams& chainParams)
+    const CChainParams& chainParams,
+    int nThreads)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
-
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
+    // Block hashes are uniformly distributed, so splitting the key space on
+    // the first byte of the hash gives each worker a similar share.
+    size_t nWorkers = std::min(std::max(nThreads, 1), 256);
+    std::vector<std::vector<std::pair<uint256, CDiskBlockIndex>>> vLoaded(nWorkers);
+    std::vector<std::string> vErrors(nWorkers);
+
+    // Deserialize and check the entries whose hash starts with a byte in
+    // [nBegin, nEnd).
+    auto loadRange = [&](size_t nWorker, unsigned int nBegin, unsigned int nEnd) {
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+        uint256 start;
+        *start.begin() = nBegin;
+        pcursor->Seek(make_pair(DB_BLOCK_INDEX, start));
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= nEnd) {
+                break;
+            }
             CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->hashSproutAnchor     = diskindex.hashSproutAnchor;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->hashBlockCommitments  = diskindex.hashBlockCommitments;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->SetSolution(diskindex.GetSolution());
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nCachedBranchId = diskindex.nCachedBranchId;
-                pindexNew->nTx            = diskindex.nTx;
-                pindexNew->nChainSupplyDelta = diskindex.nChainSupplyDelta;
-                pindexNew->nTransparentValue = diskindex.nTransparentValue;
-                pindexNew->nLockboxValue = diskindex.nLockboxValue;
-                pindexNew->nSproutValue   = diskindex.nSproutValue;
-                pindexNew->nSaplingValue  = diskindex.nSaplingValue;
-                pindexNew->nOrchardValue  = diskindex.nOrchardValue;
-                pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
-                pindexNew->hashFinalOrchardRoot = diskindex.hashFinalOrchardRoot;
-                pindexNew->hashChainHistoryRoot = diskindex.hashChainHistoryRoot;
-                pindexNew->hashAuthDataRoot = diskindex.hashAuthDataRoot;
-
-                // Check the block hash against the required difficulty as encoded in the
-                // nBits field. The probability of this succeeding randomly is low enough
-                // that it is a useful check to detect logic or disk storage errors.
-                // Skip this check for genesis block (height 0) which is validated by hash match in chainparams.
-                if (pindexNew->nHeight > 0 && !CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, Params().GetConsensus()))
-                    return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
-
-                // ZIP 221 consistency checks
-                // These checks should only be performed for block index entries marked
-                // as consensus-valid (at the time they were written).
+            if (!pcursor->GetValue(diskindex)) {
+                vErrors[nWorker] = "LoadBlockIndex() : failed to read value";
+                return false;
+            }
+            uint256 hash = diskindex.GetBlockHash();
+
+            // Check the block hash against the required difficulty as encoded in the
+            // nBits field. The probability of this succeeding randomly is low enough
+            // that it is a useful check to detect logic or disk storage errors.
+            // Skip this check for genesis block (height 0) which is validated by hash match in chainparams.
+            if (diskindex.nHeight > 0 && !CheckProofOfWork(hash, diskindex.nBits, Params().GetConsensus())) {
+                vErrors[nWorker] = strprintf("LoadBlockIndex(): CheckProofOfWork failed: %s", diskindex.ToString());
+                return false;
+            }
+
+            // ZIP 221 consistency checks
+            // These checks should only be performed for block index entries marked
+            // as consensus-valid (at the time they were written).
+            //
+            if (diskindex.IsValid(BLOCK_VALID_CONSENSUS)) {
+                // We assume block index entries on disk that are not at least
+                // CHAIN_HISTORY_ROOT_VERSION were created by nodes that were
+                // not Heartwood aware. Such a node would not see Heartwood block
+                // headers as valid, and so this must *either* be an index entry
+                // for a block header on a non-Heartwood chain, or be marked as
+                // consensus-invalid.
                 //
-                if (pindexNew->IsValid(BLOCK_VALID_CONSENSUS)) {
-                    // We assume block index entries on disk that are not at least
-                    // CHAIN_HISTORY_ROOT_VERSION were created by nodes that were
-                    // not Heartwood aware. Such a node would not see Heartwood block
-                    // headers as valid, and so this must *either* be an index entry
-                    // for a block header on a non-Heartwood chain, or be marked as
-                    // consensus-invalid.
-                    //
-                    // It can also happen that the block index entry was written
-                    // by this node when it was Heartwood-aware (so its version
-                    // will be >= CHAIN_HISTORY_ROOT_VERSION), but received from
-                    // a non-upgraded peer. However that case the entry will be
-                    // marked as consensus-invalid.
-                    //
-                    if (diskindex.nClientVersion >= NU5_DATA_VERSION &&
-                        chainParams.GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_NU5)) {
-                        // From NU5 onwards we don't enforce a consistency check, because
-                        // after ZIP 244, hashBlockCommitments will not match any stored
-                        // commitment.
-                    } else if (diskindex.nClientVersion >= CHAIN_HISTORY_ROOT_VERSION &&
-                        chainParams.GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_HEARTWOOD)) {
-                        if (pindexNew->hashBlockCommitments != pindexNew->hashChainHistoryRoot) {
-                            return error(
-                                "LoadBlockIndex(): block index inconsistency detected (post-Heartwood; hashBlockCommitments %s != hashChainHistoryRoot %s): %s",
-                                pindexNew->hashBlockCommitments.ToString(), pindexNew->hashChainHistoryRoot.ToString(), pindexNew->ToString());
-                        }
-                    } else {
-                        if (pindexNew->hashBlockCommitments != pindexNew->hashFinalSaplingRoot) {
-                            return error(
-                                "LoadBlockIndex(): block index inconsistency detected (pre-Heartwood; hashBlockCommitments %s != hashFinalSaplingRoot %s): %s",
-                                pindexNew->hashBlockCommitments.ToString(), pindexNew->hashFinalSaplingRoot.ToString(), pindexNew->ToString());
-                        }
+                // It can also happen that the block index entry was written
+                // by this node when it was Heartwood-aware (so its version
+                // will be >= CHAIN_HISTORY_ROOT_VERSION), but received from
+                // a non-upgraded peer. However that case the entry will be
+                // marked as consensus-invalid.
+                //
+                if (diskindex.nClientVersion >= NU5_DATA_VERSION &&
+                    chainParams.GetConsensus().NetworkUpgradeActive(diskindex.nHeight, Consensus::UPGRADE_NU5)) {
+                    // From NU5 onwards we don't enforce a consistency check, because
+                    // after ZIP 244, hashBlockCommitments will not match any stored
+                    // commitment.
+                } else if (diskindex.nClientVersion >= CHAIN_HISTORY_ROOT_VERSION &&
+                    chainParams.GetConsensus().NetworkUpgradeActive(diskindex.nHeight, Consensus::UPGRADE_HEARTWOOD)) {
+                    if (diskindex.hashBlockCommitments != diskindex.hashChainHistoryRoot) {
+                        vErrors[nWorker] = strprintf(
+                            "LoadBlockIndex(): block index inconsistency detected (post-Heartwood; hashBlockCommitments %s != hashChainHistoryRoot %s): %s",
+                            diskindex.hashBlockCommitments.ToString(), diskindex.hashChainHistoryRoot.ToString(), diskindex.ToString());
+                        return false;
+                    }
+                } else {
+                    if (diskindex.hashBlockCommitments != diskindex.hashFinalSaplingRoot) {
+                        vErrors[nWorker] = strprintf(
+                            "LoadBlockIndex(): block index inconsistency detected (pre-Heartwood; hashBlockCommitments %s != hashFinalSaplingRoot %s): %s",
+                            diskindex.hashBlockCommitments.ToString(), diskindex.hashFinalSaplingRoot.ToString(), diskindex.ToString());
+                        return false;
                     }
                 }
+            }
 
-                pcursor->Next();
-            } else {
-                return error("LoadBlockIndex() : failed to read value");
+            vLoaded[nWorker].emplace_back(hash, std::move(diskindex));
+            pcursor->Next();
+        }
+        return true;
+    };
+
+    std::vector<std::future<bool>> vWorkers;
+    for (size_t i = 1; i < nWorkers; i++) {
+        vWorkers.push_back(std::async(std::launch::async, loadRange,
+            i, i * 256 / nWorkers, (i + 1) * 256 / nWorkers));
+    }
+    bool fOk = loadRange(0, 0, 256 / nWorkers);
+    for (auto& worker : vWorkers) {
+        fOk = worker.get() && fOk;
+    }
+    if (!fOk) {
+        for (const std::string& strError : vErrors) {
+            if (!strError.empty()) {
+                return error("%s", strError);
             }
-        } else {
-            break;
         }
     }
 
+    // Load mapBlockIndex
+    for (auto& loaded : vLoaded) {
+        for (auto& entry : loaded) {
+            boost::this_thread::interruption_point();
+            const CDiskBlockIndex& diskindex = entry.second;
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(entry.first);
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->hashSproutAnchor     = diskindex.hashSproutAnchor;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->hashBlockCommitments  = diskindex.hashBlockCommitments;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->SetSolution(diskindex.GetSolution());
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nCachedBranchId = diskindex.nCachedBranchId;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->nChainSupplyDelta = diskindex.nChainSupplyDelta;
+            pindexNew->nTransparentValue = diskindex.nTransparentValue;
+            pindexNew->nLockboxValue = diskindex.nLockboxValue;
+            pindexNew->nSproutValue   = diskindex.nSproutValue;
+            pindexNew->nSaplingValue  = diskindex.nSaplingValue;
+            pindexNew->nOrchardValue  = diskindex.nOrchardValue;
+            pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
+            pindexNew->hashFinalOrchardRoot = diskindex.hashFinalOrchardRoot;
+            pindexNew->hashChainHistoryRoot = diskindex.hashChainHistoryRoot;
+            pindexNew->hashAuthDataRoot = diskindex.hashAuthDataRoot;
+        }
+        loaded.clear();
+        loaded.shrink_to_fit();
+    }
+
     return true;
 }
@@ -10,9 +10,15 @@
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "nullifierset.h"
 
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -20,6 +26,7 @@
 #include "zcash/History.hpp"
 
 class CBlockIndex;
+struct CCompactShieldedBlock;
 
 // START insightexplorer
 struct CAddressUnspentKey;
@@ -27,6 +34,7 @@ struct CAddressUnspentValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
+struct CAddressSummary;
 struct CSpentIndexKey;
 struct CSpentIndexValue;
 struct CTimestampIndexKey;
@@ -37,6 +45,7 @@ struct CTimestampBlockIndexValue;
 typedef std::pair<CAddressUnspentKey, CAddressUnspentValue> CAddressUnspentDbEntry;
 typedef std::pair<CAddressIndexKey, CAmount> CAddressIndexDbEntry;
 typedef std::pair<CSpentIndexKey, CSpentIndexValue> CSpentIndexDbEntry;
+typedef std::pair<CAddressIndexIteratorKey, CAddressSummary> CAddressSummaryDbEntry;
 // END insightexplorer
 
 class uint256;
@@ -47,6 +56,12 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! -nullifierdb default
+static const bool DEFAULT_NULLIFIER_DB = false;
+//! Share of the chain state database cache given to the nullifier database, in percent
+static const int NULLIFIER_DB_CACHE_PERCENT = 25;
+//! -residentnullifiers default
+static const bool DEFAULT_RESIDENT_NULLIFIERS = false;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -73,16 +88,201 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/** Nullifier set changes, keyed by database key, that are yet to reach the nullifier database */
+typedef std::vector<std::pair<std::pair<char, uint256>, bool>> CNullifierJournal;
+
+/**
+ * CCoinsView backed by the coin database (chainstate/).
+ *
+ * The nullifier sets can be kept in a separate database (chainstate_nullifiers/)
+ * tuned for their access pattern: random keys that are never read back once
+ * spent, and lookups of new nullifiers that always miss. Its changes are
+ * journaled in the coin database batch, which also holds the best block, so
+ * the two databases are brought back in step after a crash.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
-    CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    //! Separate database for the nullifier sets, or null if they are kept in db
+    std::unique_ptr<CDBWrapper> nullifierDb;
+    CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory = false, bool fWipe = false,
+                 size_t nNullifierCacheSize = 0, bool fResidentNullifiers = false);
+private:
+    //! With -residentnullifiers, a copy of each pool's nullifier set (indexed
+    //! by ShieldedType - 1) that answers GetNullifier without the database.
+    //! It is loaded on opening and updated after every write.
+    bool fResidentNullifiers = false;
+    mutable std::shared_mutex cs_residentNullifiers;
+    CNullifierSet residentNullifiers[3];
+
+    void LoadResidentNullifiers();
+    void UpdateResidentNullifiers(const CNullifierJournal& changes);
+
+    //! The recently used part of one epoch's history tree (ZIP 221).
+    struct HistoryEpochCache {
+        HistoryIndex length;
+        uint256 root;
+        //! Nodes, each with the tick at which it was last used.
+        std::map<HistoryIndex, std::pair<HistoryNode, uint64_t>> nodes;
+    };
+
+    //! History tree lengths, roots and nodes kept in memory once read or
+    //! written, so that extending the tree each block does not read the
+    //! database. The peaks are used by every block and so stay cached.
+    mutable std::mutex cs_historyCache;
+    mutable std::map<uint32_t, HistoryEpochCache> historyCache;
+    mutable uint64_t nHistoryTick = 0;
+
+    HistoryEpochCache& LoadHistoryEpoch(uint32_t epochId) const;
+    HistoryNode ReadHistoryNode(uint32_t epochId, HistoryIndex index) const;
+    void CacheHistoryNode(HistoryEpochCache& epoch, HistoryIndex index, const HistoryNode& node) const;
+    //! Bring the cache in line with history changes that have been written.
+    void UpdateHistoryCache(const CHistoryCacheMap& historyCacheMap);
+
+    typedef std::vector<libzcash::SubtreeData> SubtreeList;
+
+    //! Completed subtrees of each pool in index order, loaded when the
+    //! database is opened and replaced after every write that changes them.
+    //! Readers take the current list with an atomic load rather than a lock,
+    //! so subtree queries from light clients do not reach the database.
+    std::shared_ptr<const SubtreeList> saplingSubtrees;
+    std::shared_ptr<const SubtreeList> orchardSubtrees;
+
+    void LoadSubtrees(ShieldedType type);
+    //! Bring the subtree list in line with subtree changes that have been written.
+    void UpdateSubtrees(ShieldedType type, const SubtreeCache& cache);
+
+    void OpenNullifierDB(const std::string& dbName, size_t nNullifierCacheSize, bool fMemory, bool fWipe);
+    const CDBWrapper& NullifierDB() const { return nullifierDb ? *nullifierDb : db; }
+    //! Write the journaled changes to the nullifier database, then drop the journal.
+    void ApplyNullifierJournal(const CNullifierJournal& journal, uint32_t nChunks);
+    bool WriteCoinsBatch(bool fErase,
+                    CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    const uint256 &hashOrchardAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CAnchorsOrchardMap &mapOrchardAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers,
+                    CNullifiersMap &mapOrchardNullifiers,
+                    CHistoryCacheMap &historyCacheMap,
+                    SubtreeCache &cacheSaplingSubtrees,
+                    SubtreeCache &cacheOrchardSubtrees);
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    /**
+     * If nNullifierCacheSize is nonzero, the nullifier sets are kept in a
+     * separate database with that cache size; otherwise they are kept in the
+     * coin database. Nullifiers are moved on opening if this has changed.
+     * If fResidentNullifiers is set, every nullifier is also kept in memory.
+     */
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, size_t nNullifierCacheSize = 0,
+                 bool fResidentNullifiers = false);
     ~CCoinsViewDB() {}
 
+    bool GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const;
+    bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const;
+    bool GetOrchardAnchorAt(const uint256 &rt, OrchardMerkleFrontier &tree) const;
+    bool GetNullifier(const uint256 &nf, ShieldedType type) const;
+    bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    bool HaveCoins(const uint256 &txid) const;
+    uint256 GetBestBlock() const;
+    uint256 GetBestAnchor(ShieldedType type) const;
+    HistoryIndex GetHistoryLength(uint32_t epochId) const;
+    HistoryNode GetHistoryAt(uint32_t epochId, HistoryIndex index) const;
+    uint256 GetHistoryRoot(uint32_t epochId) const;
+    std::optional<libzcash::LatestSubtree> GetLatestSubtree(ShieldedType type) const;
+    std::optional<libzcash::SubtreeData> GetSubtreeData(
+            ShieldedType type,
+            libzcash::SubtreeIndex index) const;
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    const uint256 &hashOrchardAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CAnchorsOrchardMap &mapOrchardAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers,
+                    CNullifiersMap &mapOrchardNullifiers,
+                    CHistoryCacheMap &historyCacheMap,
+                    SubtreeCache &cacheSaplingSubtrees,
+                    SubtreeCache &cacheOrchardSubtrees);
+    //! Like BatchWrite, but leaves the provided maps untouched so that they
+    //! can keep answering reads while the write is in progress.
+    bool WriteSnapshot(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    const uint256 &hashOrchardAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CAnchorsOrchardMap &mapOrchardAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers,
+                    CNullifiersMap &mapOrchardNullifiers,
+                    CHistoryCacheMap &historyCacheMap,
+                    SubtreeCache &cacheSaplingSubtrees,
+                    SubtreeCache &cacheOrchardSubtrees);
+    bool GetStats(CCoinsStats &stats) const;
+    bool DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const;
+};
+
+/**
+ * Layer between the coins cache and the coin database that lets the cache
+ * be flushed without waiting for the database write.
+ *
+ * BatchWrite takes over the child cache's maps as a snapshot and returns;
+ * a background thread then writes the snapshot to the database. Until that
+ * write has completed, reads are answered from the snapshot first, so the
+ * layers above see the state as of the flush. The best block and anchors
+ * are written in the same database batch as the coins, so they only become
+ * durable once the whole snapshot is on disk.
+ *
+ * Only one snapshot is in flight at a time: a BatchWrite issued while the
+ * previous write is still running waits for it.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked
+{
+private:
+    struct Snapshot {
+        CCoinsMap mapCoins;
+        uint256 hashBlock;
+        uint256 hashSproutAnchor;
+        uint256 hashSaplingAnchor;
+        uint256 hashOrchardAnchor;
+        CAnchorsSproutMap mapSproutAnchors;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CAnchorsOrchardMap mapOrchardAnchors;
+        CNullifiersMap mapSproutNullifiers;
+        CNullifiersMap mapSaplingNullifiers;
+        CNullifiersMap mapOrchardNullifiers;
+        CHistoryCacheMap historyCacheMap;
+        SubtreeCache cacheSaplingSubtrees = SubtreeCache(SAPLING);
+        SubtreeCache cacheOrchardSubtrees = SubtreeCache(ORCHARD);
+    };
+
+    CCoinsViewDB *db;
+
+    mutable std::mutex cs;
+    mutable std::condition_variable cond;
+    //! The snapshot being written, if any. Guarded by cs.
+    std::unique_ptr<Snapshot> pending;
+    //! Set once a background write has failed. Guarded by cs.
+    bool fFailed;
+    bool fShutdown;
+    std::thread writer;
+
+    void ThreadWrite();
+
+public:
+    CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn);
+    ~CCoinsViewBackgroundFlush();
+
     bool GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const;
     bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const;
     bool GetOrchardAnchorAt(const uint256 &rt, OrchardMerkleFrontier &tree) const;
@@ -113,6 +313,14 @@ public:
                     SubtreeCache &cacheSaplingSubtrees,
                     SubtreeCache &cacheOrchardSubtrees);
     bool GetStats(CCoinsStats &stats) const;
+    bool DumpSnapshot(CAutoFile& file, CCoinsSnapshotMetadata& metadata) const;
+
+    //! Wait until any snapshot in flight is on disk. Returns false if a
+    //! background write has failed.
+    bool Sync() const;
+
+    //! Whether a snapshot is currently being written.
+    bool IsFlushing() const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -120,10 +328,22 @@ class CBlockTreeDB : public CDBWrapper
 {
 public:
     CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CBlockTreeDB();
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+
+    struct PendingIndex;
+    //! Transaction and shielded index entries of connected blocks that
+    //! have not been written yet
+    mutable std::mutex cs_pending;
+    std::unique_ptr<PendingIndex> pending;
+
+    //! Move the pending index entries into a batch. cs_pending must be held.
+    void MovePendingIndex(CDBBatch& batch);
 public:
+    /** Write the block file information and block index entries, along
+     * with any pending index entries, and sync them to disk. */
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo);
     bool EraseBatchSync(const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info) const;
@@ -132,7 +352,14 @@ public:
     bool ReadReindexing(bool &fReindexing) const;
     bool ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex &dbindex) const;
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) const;
+    /**
+     * Transaction and shielded index entries are held in memory and written
+     * in the block index batch of the next flush, which always precedes the
+     * chain state flush. They are readable at once.
+     */
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
+    bool ReadShieldedIndex(const uint256 &blockhash, CCompactShieldedBlock &compact) const;
+    bool WriteShieldedIndex(const uint256 &blockhash, const CCompactShieldedBlock &compact);
 
     // START insightexplorer
     bool UpdateAddressUnspentIndex(const std::vector<CAddressUnspentDbEntry> &vect);
@@ -148,13 +375,43 @@ public:
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex,
             const CTimestampBlockIndexValue &logicalts);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS) const;
+    bool ReadAddressSummary(const CAddressIndexIteratorKey &key, CAddressSummary &summary) const;
+    /** Find the height of the last address index entry of an address below
+     * a height. Returns false if there is none. */
+    bool ReadAddressLastHeight(const CAddressIndexIteratorKey &key, int beforeHeight, int &height);
+    bool EraseAddressSummaries();
+    /**
+     * Apply the changes made to the insight explorer indexes by a run of
+     * blocks, and record the last of them as the best block, in one batch.
+     * Unspent index, spent index and summary entries with a null value are
+     * erased. Each timestamp index key is also written to the block hash
+     * index.
+     */
+    bool UpdateInsightIndex(
+            const std::vector<CAddressIndexDbEntry> &addressIndex,
+            const std::vector<CAddressIndexDbEntry> &addressIndexErase,
+            const std::vector<CAddressUnspentDbEntry> &addressUnspentIndex,
+            const std::vector<CAddressSummaryDbEntry> &addressSummaries,
+            const std::vector<CSpentIndexDbEntry> &spentIndex,
+            const std::vector<CTimestampIndexKey> &timestampIndex,
+            const uint256 &hashBestBlock);
+    /** The last block applied to the insight explorer indexes. Returns false
+     * if none has been recorded, as in databases that predate the record. */
+    bool ReadInsightIndexBestBlock(uint256 &hashBestBlock) const;
+    bool WriteInsightIndexBestBlock(const uint256 &hashBestBlock);
     // END insightexplorer
 
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue) const;
+    /**
+     * Load every block index entry, deserializing and checking them on up to
+     * nThreads threads (including the calling one). Only linking the entries
+     * through insertBlockIndex is done serially.
+     */
     bool LoadBlockIndexGuts(
         std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
-        const CChainParams& chainParams);
+        const CChainParams& chainParams,
+        int nThreads = 1);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -33,7 +33,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     hadNoDependencies(poolHasNoInputsOf),
     spendsCoinbase(_spendsCoinbase), sigOpCount(_sigOps), nBranchId(_nBranchId)
 {
-    nTxSize = ::GetSerializeSize(_tx, SER_NETWORK, PROTOCOL_VERSION);
+    nTxSize = _tx.GetTotalSize();
     nUsageSize = RecursiveDynamicUsage(*tx) + memusage::DynamicUsage(tx);
 
     nCountWithDescendants = 1;
@@ -41,6 +41,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nModFeesWithDescendants = nFee;
 
     feeDelta = 0;
+    nGraphIndex = 0;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -54,45 +55,97 @@ void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
     feeDelta = newFeeDelta;
 }
 
+void CTxMemPool::AddGraphNode(txiter entry)
+{
+    uint32_t n;
+    if (!vGraphFree.empty()) {
+        n = vGraphFree.back();
+        vGraphFree.pop_back();
+    } else {
+        n = vGraph.size();
+        vGraph.emplace_back();
+    }
+    vGraph[n].it = entry;
+    entry->nGraphIndex = n;
+}
+
+void CTxMemPool::RemoveGraphNode(txiter entry)
+{
+    GraphNode& node = vGraph[entry->nGraphIndex];
+    cachedInnerUsage -= memusage::DynamicUsage(node.parents) + memusage::DynamicUsage(node.children);
+    node.parents.clear();
+    node.parents.shrink_to_fit();
+    node.children.clear();
+    node.children.shrink_to_fit();
+    vGraphFree.push_back(entry->nGraphIndex);
+}
+
+template <typename Fn>
+void CTxMemPool::ForEachAncestor(txiter entry, Fn fn)
+{
+    uint64_t epoch = NewGraphEpoch();
+    std::vector<uint32_t> vStage;
+    VisitGraphNode(entry->nGraphIndex, epoch);
+    for (uint32_t p : vGraph[entry->nGraphIndex].parents) {
+        VisitGraphNode(p, epoch);
+        vStage.push_back(p);
+    }
+    while (!vStage.empty()) {
+        uint32_t n = vStage.back();
+        vStage.pop_back();
+        fn(vGraph[n].it);
+        for (uint32_t p : vGraph[n].parents) {
+            if (VisitGraphNode(p, epoch)) {
+                vStage.push_back(p);
+            }
+        }
+    }
+}
+
 // Update the given tx for any in-mempool descendants.
-// Assumes that setMemPoolChildren is correct for the given tx and all
+// Assumes that the graph's children are correct for the given tx and all
 // descendants.
-bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
+bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit, cacheMap &cachedDescendants, const std::vector<bool> &vExclude)
 {
-    // Track the number of entries (outside setExclude) that we'd need to visit
+    // Track the number of entries (outside vExclude) that we'd need to visit
     // (will bail out if it exceeds maxDescendantsToVisit)
     int nChildrenToVisit = 0;
 
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    uint64_t epoch = NewGraphEpoch();
+    std::vector<uint32_t> vStage, vAllDescendants;
+    for (uint32_t c : vGraph[updateIt->nGraphIndex].children) {
+        VisitGraphNode(c, epoch);
+        vStage.push_back(c);
+    }
 
-    while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        if (cit->IsDirty()) {
+    while (!vStage.empty()) {
+        uint32_t n = vStage.back();
+        vStage.pop_back();
+        if (vGraph[n].it->IsDirty()) {
             // Don't consider any more children if any descendant is dirty
             return false;
         }
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        for (const txiter childEntry : setChildren) {
-            cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
+        vAllDescendants.push_back(n);
+        for (uint32_t child : vGraph[n].children) {
+            cacheMap::const_iterator cacheIt = cachedDescendants.find(child);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
-                for (const txiter cacheEntry : cacheIt->second) {
+                for (uint32_t cached : cacheIt->second) {
                     // update visit count only for new child transactions
-                    // (outside of setExclude and stageEntries)
-                    if (setAllDescendants.insert(cacheEntry).second &&
-                            !setExclude.count(cacheEntry->GetTx().GetHash()) &&
-                            !stageEntries.count(cacheEntry)) {
-                        nChildrenToVisit++;
+                    // (outside of vExclude and the ones already reached)
+                    if (VisitGraphNode(cached, epoch)) {
+                        vAllDescendants.push_back(cached);
+                        if (!vExclude[cached]) {
+                            nChildrenToVisit++;
+                        }
                     }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (VisitGraphNode(child, epoch)) {
                 // Schedule for later processing and update our visit count
-                if (stageEntries.insert(childEntry).second && !setExclude.count(childEntry->GetTx().GetHash())) {
-                        nChildrenToVisit++;
+                vStage.push_back(child);
+                if (!vExclude[child]) {
+                    nChildrenToVisit++;
                 }
             }
             if (nChildrenToVisit > maxDescendantsToVisit) {
@@ -100,17 +153,19 @@ bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
-        if (!setExclude.count(cit->GetTx().GetHash())) {
+    std::vector<uint32_t>& vCached = cachedDescendants[updateIt->nGraphIndex];
+    for (uint32_t n : vAllDescendants) {
+        if (!vExclude[n]) {
+            txiter cit = vGraph[n].it;
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            vCached.push_back(n);
         }
     }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
@@ -124,43 +179,47 @@ bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit
 void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashesToUpdate)
 {
     LOCK(cs);
+    nSnapshotSequence++;
     // For each entry in vHashesToUpdate, store the set of in-mempool, but not
     // in-vHashesToUpdate transactions, so that we don't have to recalculate
     // descendants when we come across a previously seen entry.
     cacheMap mapMemPoolDescendantsToUpdate;
 
-    // Use a set for lookups into vHashesToUpdate (these entries are already
+    // Mark the graph nodes of vHashesToUpdate (these entries are already
     // accounted for in the state of their ancestors)
-    std::set<uint256> setAlreadyIncluded(vHashesToUpdate.begin(), vHashesToUpdate.end());
+    std::vector<bool> vAlreadyIncluded(vGraph.size(), false);
+    for (const uint256 &hash : vHashesToUpdate) {
+        txiter it = mapTx.find(hash);
+        if (it != mapTx.end()) {
+            vAlreadyIncluded[it->nGraphIndex] = true;
+        }
+    }
 
     // Iterate in reverse, so that whenever we are looking at a transaction
     // we are sure that all in-mempool descendants have already been processed.
     // This maximizes the benefit of the descendant cache and guarantees that
-    // setMemPoolChildren will be updated, an assumption made in
+    // the graph's children will be updated, an assumption made in
     // UpdateForDescendants.
     BOOST_REVERSE_FOREACH(const uint256 &hash, vHashesToUpdate) {
-        // we cache the in-mempool children to avoid duplicate updates
-        setEntries setChildren;
-        // calculate children from mapNextTx
         txiter it = mapTx.find(hash);
         if (it == mapTx.end()) {
             continue;
         }
         std::map<COutPoint, CInPoint>::iterator iter = mapNextTx.lower_bound(COutPoint(hash, 0));
-        // First calculate the children, and update setMemPoolChildren to
-        // include them, and update their setMemPoolParents to include this tx.
+        // First calculate the children from mapNextTx, and link them to this
+        // tx in the graph.
         for (; iter != mapNextTx.end() && iter->first.hash == hash; ++iter) {
             const uint256 &childHash = iter->second.ptx->GetHash();
             txiter childIter = mapTx.find(childHash);
             assert(childIter != mapTx.end());
-            // We can skip updating entries we've encountered before or that
-            // are in the block (which are already accounted for).
-            if (setChildren.insert(childIter).second && !setAlreadyIncluded.count(childHash)) {
+            // We can skip updating entries that are in the block (which are
+            // already accounted for). Linking a child twice has no effect.
+            if (!vAlreadyIncluded[childIter->nGraphIndex]) {
                 UpdateChild(it, childIter, true);
                 UpdateParent(childIter, it, true);
             }
         }
-        if (!UpdateForDescendants(it, 100, mapMemPoolDescendantsToUpdate, setAlreadyIncluded)) {
+        if (!UpdateForDescendants(it, 100, mapMemPoolDescendantsToUpdate, vAlreadyIncluded)) {
             // Mark as dirty if we can't do the calculation.
             mapTx.modify(it, set_dirty());
         }
@@ -169,8 +228,10 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */)
 {
-    setEntries parentHashes;
     const CTransaction &tx = entry.GetTx();
+    uint64_t epoch = NewGraphEpoch();
+    // Graph nodes of the ancestors found but not walked yet.
+    std::vector<uint32_t> vStage;
 
     if (fSearchForParents) {
         // Get parents of this transaction that are in the mempool
@@ -178,9 +239,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
-                if (parentHashes.size() + 1 > limitAncestorCount) {
+            if (piter != mapTx.end() && VisitGraphNode(piter->nGraphIndex, epoch)) {
+                vStage.push_back(piter->nGraphIndex);
+                if (vStage.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
                 }
@@ -190,16 +251,22 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        VisitGraphNode(it->nGraphIndex, epoch);
+        for (uint32_t p : vGraph[it->nGraphIndex].parents) {
+            VisitGraphNode(p, epoch);
+            vStage.push_back(p);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
+    // The number of ancestors found so far, walked or not.
+    size_t nAncestorsFound = vStage.size();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
-
+    while (!vStage.empty()) {
+        uint32_t n = vStage.back();
+        vStage.pop_back();
+        txiter stageit = vGraph[n].it;
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -213,13 +280,13 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
             return false;
         }
 
-        const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
-        for (const txiter &phash : setMemPoolParents) {
+        for (uint32_t p : vGraph[n].parents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (VisitGraphNode(p, epoch)) {
+                vStage.push_back(p);
+                nAncestorsFound++;
             }
-            if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
+            if (nAncestorsFound + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -229,26 +296,23 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
     return true;
 }
 
-void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
+void CTxMemPool::UpdateAncestorsOf(txiter it, const setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
-    // add or remove this tx as a child of each parent
-    for (txiter piter : parentIters) {
-        UpdateChild(piter, it, add);
+    // add this tx as a child of each parent
+    for (uint32_t p : vGraph[it->nGraphIndex].parents) {
+        UpdateChild(vGraph[p].it, it, true);
     }
-    const int64_t updateCount = (add ? 1 : -1);
-    const int64_t updateSize = updateCount * it->GetTxSize();
-    const CAmount updateFee = updateCount * it->GetModifiedFee();
+    const int64_t updateSize = it->GetTxSize();
+    const CAmount updateFee = it->GetModifiedFee();
     for (txiter ancestorIt : setAncestors) {
-        mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateFee, updateCount));
+        mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateFee, 1));
     }
 }
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    for (txiter updateIt : setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
+    for (uint32_t c : vGraph[it->nGraphIndex].children) {
+        UpdateParent(vGraph[c].it, it, false);
     }
 }
 
@@ -256,39 +320,39 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
 {
     // For each entry, walk back all ancestors and decrement size associated with this
     // transaction
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
     for (txiter removeIt : entriesToRemove) {
-        setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        // Since this is a tx that is already in the mempool, we can call CMPA
-        // with fSearchForParents = false.  If the mempool is in a consistent
-        // state, then using true or false should both be correct, though false
-        // should be a bit faster.
+        // The ancestors are walked through the graph's parents rather than
+        // by searching the transaction's inputs. If the mempool is in a
+        // consistent state, then both give the same result.
         // However, if we happen to be in the middle of processing a reorg, then
         // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of 
+        // of ancestors reachable via the graph will be the same as the set of
         // ancestors whose packages include this transaction, because when we
         // add a new transaction to the mempool in addUnchecked(), we assume it
         // has no children, and in the case of a reorg where that assumption is
         // false, the in-mempool children aren't linked to the in-block tx's
         // until UpdateTransactionsFromBlock() is called.
         // So if we're being called during a reorg, ie before
-        // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
+        // UpdateTransactionsFromBlock() has been called, then the graph will
         // differ from the set of mempool parents we'd calculate by searching,
-        // and it's important that we use the mapLinks[] notion of ancestor
+        // and it's important that we use the graph's notion of ancestor
         // transactions as the set of things to update for removal.
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.  This is
-        // fine since we don't need to use the mempool children of any entries
-        // to walk back over our ancestors (but we do need the mempool
-        // parents!)
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        const int64_t updateSize = -int64_t(removeIt->GetTxSize());
+        const CAmount updateFee = -removeIt->GetModifiedFee();
+        ForEachAncestor(removeIt, [&](txiter ancestorIt) {
+            mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateFee, -1));
+        });
+        // Sever the child links that point to removeIt in the entries for its
+        // parents. This is fine since we don't need to use the mempool
+        // children of any entries to walk back over our ancestors (but we do
+        // need the mempool parents!)
+        for (uint32_t p : vGraph[removeIt->nGraphIndex].parents) {
+            UpdateChild(vGraph[p].it, removeIt, false);
+        }
     }
     // After updating all the ancestor sizes, we can now sever the link between each
-    // transaction being removed and any mempool children (ie, update setMemPoolParents
-    // for each direct child of a transaction being removed).
+    // transaction being removed and any mempool children (ie, update the parents
+    // of each direct child of a transaction being removed).
     for (txiter removeIt : entriesToRemove) {
         UpdateChildrenForRemoval(removeIt);
     }
@@ -383,10 +447,11 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // Used by main.cpp AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     LOCK(cs);
+    nSnapshotSequence++;
     auto [cost, evictionWeight] = MempoolCostAndEvictionWeight(entry.GetTx(), entry.GetFee());
     limitSet->add(entry.GetTx().GetHash(), cost, evictionWeight);
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
+    AddGraphNode(newit);
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -398,6 +463,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
             mapTx.modify(newit, update_fee_delta(delta));
         }
     }
+    AddBlockCandidate(newit);
+    stats.Add(*newit);
 
     // Update cachedInnerUsage to include contained transaction's usage.
     // (When we update the entry for in-mempool parents, memory usage will be
@@ -405,7 +472,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     cachedInnerUsage += entry.DynamicMemoryUsage();
 
     const CTransaction& tx = newit->GetTx();
-    mapRecentlyAddedTx[tx.GetHash()] = &tx;
+    mapRecentlyAddedTx[tx.GetHash()] = newit->GetSharedTx();
     nRecentlyAddedSequence += 1;
     std::set<uint256> setParentTransactions;
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
@@ -426,7 +493,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
             UpdateParent(newit, pit, true);
         }
     }
-    UpdateAncestorsOf(true, newit, setAncestors);
+    UpdateAncestorsOf(newit, setAncestors);
 
     for (const JSDescription &joinsplit : tx.vJoinSplit) {
         for (const uint256 &nf : joinsplit.nullifiers) {
@@ -443,6 +510,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
 
+    NotifyEntryAdded(tx);
+
     return true;
 }
 
@@ -450,6 +519,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
+    nSnapshotSequence++;
+    nAddressSnapshotSequence++;
     const CTransaction& tx = entry.GetTx();
     std::vector<CMempoolAddressDeltaKey> inserted;
 
@@ -483,14 +554,7 @@ void CTxMemPool::getAddressIndex(
     const std::vector<std::pair<uint160, int>>& addresses,
     std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& results)
 {
-    LOCK(cs);
-    for (const auto& it : addresses) {
-        auto ait = mapAddress.lower_bound(CMempoolAddressDeltaKey(it.second, it.first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == it.first && (*ait).first.type == it.second) {
-            results.push_back(*ait);
-            ait++;
-        }
-    }
+    GetAddressSnapshot()->getAddressIndex(addresses, results);
 }
 
 void CTxMemPool::removeAddressIndex(const uint256& txhash)
@@ -499,6 +563,7 @@ void CTxMemPool::removeAddressIndex(const uint256& txhash)
     auto it = mapAddressInserted.find(txhash);
 
     if (it != mapAddressInserted.end()) {
+        nAddressSnapshotSequence++;
         std::vector<CMempoolAddressDeltaKey> keys = it->second;
         for (const auto& mit : keys) {
             mapAddress.erase(mit);
@@ -510,6 +575,7 @@ void CTxMemPool::removeAddressIndex(const uint256& txhash)
 void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
+    nAddressSnapshotSequence++;
     const CTransaction& tx = entry.GetTx();
     uint256 txhash = tx.GetHash();
     std::vector<CSpentIndexKey> inserted;
@@ -529,13 +595,7 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
 
 bool CTxMemPool::getSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    LOCK(cs);
-    std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare>::iterator it = mapSpent.find(key);
-    if (it != mapSpent.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+    return GetAddressSnapshot()->getSpentIndex(key, value);
 }
 
 void CTxMemPool::removeSpentIndex(const uint256 txhash)
@@ -544,6 +604,7 @@ void CTxMemPool::removeSpentIndex(const uint256 txhash)
     auto it = mapSpentInserted.find(txhash);
 
     if (it != mapSpentInserted.end()) {
+        nAddressSnapshotSequence++;
         std::vector<CSpentIndexKey> keys = (*it).second;
         for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
             mapSpent.erase(*mit);
@@ -573,10 +634,12 @@ void CTxMemPool::removeUnchecked(txiter it)
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
-    mapLinks.erase(it);
+    RemoveGraphNode(it);
+    RemoveBlockCandidate(it);
+    stats.Remove(*it);
     mapTx.erase(it);
     nTransactionsUpdated++;
+    nSnapshotSequence++;
 
     // insightexplorer
     if (fAddressIndex)
@@ -593,22 +656,24 @@ void CTxMemPool::removeUnchecked(txiter it)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    if (setDescendants.count(entryit)) {
+        return;
     }
+    uint64_t epoch = NewGraphEpoch();
+    std::vector<uint32_t> vStage;
+    VisitGraphNode(entryit->nGraphIndex, epoch);
+    vStage.push_back(entryit->nGraphIndex);
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
-    while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
-
-        const setEntries &setChildren = GetMemPoolChildren(it);
-        for (const txiter &childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+    while (!vStage.empty()) {
+        uint32_t n = vStage.back();
+        vStage.pop_back();
+        setDescendants.insert(vGraph[n].it);
+
+        for (uint32_t child : vGraph[n].children) {
+            if (VisitGraphNode(child, epoch) && !setDescendants.count(vGraph[child].it)) {
+                vStage.push_back(child);
             }
         }
     }
@@ -851,12 +916,17 @@ void CTxMemPool::removeWithoutBranchId(uint32_t nMemPoolBranchId)
 
 void CTxMemPool::_clear()
 {
-    mapLinks.clear();
+    vGraph.clear();
+    vGraphFree.clear();
+    candidatesPayingConventionalFee = weightedCandidates();
+    candidatesNotPayingConventionalFee = weightedCandidates();
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    stats = CTxMemPoolStats();
     ++nTransactionsUpdated;
+    ++nSnapshotSequence;
 }
 
 void CTxMemPool::clear()
@@ -877,6 +947,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
+    CTxMemPoolStats checkStats;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
     const int64_t nSpendHeight = GetSpendHeight(mempoolDuplicate);
@@ -887,11 +958,11 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
+        checkStats.Add(*it);
         const CTransaction& tx = it->GetTx();
-        txlinksMap::const_iterator linksiter = mapLinks.find(it);
-        assert(linksiter != mapLinks.end());
-        const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+        const GraphNode &node = vGraph[it->nGraphIndex];
+        assert(node.it == it);
+        innerUsage += memusage::DynamicUsage(node.parents) + memusage::DynamicUsage(node.children);
         bool fDependsWait = false;
         setEntries setParentCheck;
         for (const CTxIn &txin : tx.vin) {
@@ -913,7 +984,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             assert(it3->second.n == i);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        setEntries setParents(GetMemPoolParents(it).begin(), GetMemPoolParents(it).end());
+        assert(setParents.size() == node.parents.size());
+        assert(setParentCheck == setParents);
         // Check children against mapNextTx
         CTxMemPool::setEntries setChildrenCheck;
         std::map<COutPoint, CInPoint>::const_iterator iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
@@ -927,7 +1000,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
                 childModFee += childit->GetModifiedFee();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        setEntries setChildren(GetMemPoolChildren(it).begin(), GetMemPoolChildren(it).end());
+        assert(setChildren.size() == node.children.size());
+        assert(setChildrenCheck == setChildren);
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         if (!it->IsDirty()) {
@@ -982,6 +1057,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(checkStats == stats);
+    assert(candidatesPayingConventionalFee.size() + candidatesNotPayingConventionalFee.size() == mapTx.size());
+    candidatesPayingConventionalFee.checkInvariants();
+    candidatesNotPayingConventionalFee.checkInvariants();
 }
 
 template<typename T>
@@ -1042,31 +1121,124 @@ std::vector<CTxMemPool::indexed_transaction_set::const_iterator> CTxMemPool::Get
 
 void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 {
-    LOCK(cs);
-    auto iters = GetSortedDepthAndScore();
+    GetSnapshot()->queryHashes(vtxid);
+}
 
-    vtxid.clear();
-    vtxid.reserve(mapTx.size());
+std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
+{
+    return GetSnapshot()->infoAll();
+}
+
+std::shared_ptr<const CTxMemPoolSnapshot> CTxMemPool::GetSnapshot() const
+{
+    {
+        LOCK(cs_snapshot);
+        if (snapshot && snapshot->nSequence == nSnapshotSequence) {
+            return snapshot;
+        }
+    }
 
+    LOCK(cs);
+    {
+        // Another reader may have made one while we waited for cs.
+        LOCK(cs_snapshot);
+        if (snapshot && snapshot->nSequence == nSnapshotSequence) {
+            return snapshot;
+        }
+    }
+
+    auto fresh = std::make_shared<CTxMemPoolSnapshot>(nSnapshotSequence);
+    auto iters = GetSortedDepthAndScore();
+    fresh->entries.reserve(iters.size());
+    fresh->parents.reserve(iters.size());
     for (auto it : iters) {
-        vtxid.push_back(it->GetTx().GetHash());
+        fresh->entries.push_back(*it);
+        std::vector<uint256> parents;
+        for (txiter parent : GetMemPoolParents(it)) {
+            parents.push_back(parent->GetTx().GetHash());
+        }
+        fresh->parents.push_back(std::move(parents));
     }
+
+    LOCK(cs_snapshot);
+    snapshot = fresh;
+    return fresh;
 }
 
-std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
+std::shared_ptr<const CMempoolAddressSnapshot> CTxMemPool::GetAddressSnapshot() const
 {
+    {
+        LOCK(cs_snapshot);
+        if (addressSnapshot && addressSnapshot->nSequence == nAddressSnapshotSequence) {
+            return addressSnapshot;
+        }
+    }
+
     LOCK(cs);
-    auto iters = GetSortedDepthAndScore();
+    {
+        LOCK(cs_snapshot);
+        if (addressSnapshot && addressSnapshot->nSequence == nAddressSnapshotSequence) {
+            return addressSnapshot;
+        }
+    }
+
+    auto fresh = std::make_shared<CMempoolAddressSnapshot>(nAddressSnapshotSequence);
+    fresh->addressIndex.assign(mapAddress.begin(), mapAddress.end());
+    fresh->spentIndex.assign(mapSpent.begin(), mapSpent.end());
 
+    LOCK(cs_snapshot);
+    addressSnapshot = fresh;
+    return fresh;
+}
+
+std::vector<TxMempoolInfo> CTxMemPoolSnapshot::infoAll() const
+{
     std::vector<TxMempoolInfo> ret;
-    ret.reserve(mapTx.size());
-    for (auto it : iters) {
-        ret.push_back(TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize())});
+    ret.reserve(entries.size());
+    for (const CTxMemPoolEntry& entry : entries) {
+        ret.push_back(TxMempoolInfo{entry.GetSharedTx(), entry.GetTime(), CFeeRate(entry.GetFee(), entry.GetTxSize())});
     }
-
     return ret;
 }
 
+void CTxMemPoolSnapshot::queryHashes(std::vector<uint256>& vtxid) const
+{
+    vtxid.clear();
+    vtxid.reserve(entries.size());
+    for (const CTxMemPoolEntry& entry : entries) {
+        vtxid.push_back(entry.GetTx().GetHash());
+    }
+}
+
+void CMempoolAddressSnapshot::getAddressIndex(
+    const std::vector<std::pair<uint160, int>>& addresses,
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& results) const
+{
+    for (const auto& it : addresses) {
+        auto ait = std::lower_bound(addressIndex.begin(), addressIndex.end(), CMempoolAddressDeltaKey(it.second, it.first),
+            [](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& a, const CMempoolAddressDeltaKey& b) {
+                return CMempoolAddressDeltaKeyCompare()(a.first, b);
+            });
+        while (ait != addressIndex.end() && (*ait).first.addressBytes == it.first && (*ait).first.type == it.second) {
+            results.push_back(*ait);
+            ait++;
+        }
+    }
+}
+
+bool CMempoolAddressSnapshot::getSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value) const
+{
+    auto it = std::lower_bound(spentIndex.begin(), spentIndex.end(), key,
+        [](const std::pair<CSpentIndexKey, CSpentIndexValue>& a, const CSpentIndexKey& b) {
+            return CSpentIndexKeyCompare()(a.first, b);
+        });
+    if (it != spentIndex.end() && !CSpentIndexKeyCompare()(key, it->first)) {
+        value = it->second;
+        return true;
+    }
+    return false;
+}
+
 std::shared_ptr<const CTransaction> CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -1093,15 +1265,17 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const std::string str
         delta += nFeeDelta;
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
+            nSnapshotSequence++;
+            // The weight ratio depends on the modified fee.
+            RemoveBlockCandidate(it);
+            stats.Remove(*it);
             mapTx.modify(it, update_fee_delta(delta));
+            AddBlockCandidate(it);
+            stats.Add(*it);
             // Now update all ancestors' modified fees with descendants
-            setEntries setAncestors;
-            uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-            std::string dummy;
-            CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-            BOOST_FOREACH(txiter ancestorIt, setAncestors) {
+            ForEachAncestor(it, [&](txiter ancestorIt) {
                 mapTx.modify(ancestorIt, update_descendant_state(0, nFeeDelta, 0));
-            }
+            });
         }
     }
     LogPrintf("PrioritiseTransaction: %s feerate += %s\n", strHash, FormatMoney(nFeeDelta));
@@ -1145,22 +1319,31 @@ bool CTxMemPool::nullifierExists(const uint256& nullifier, ShieldedType type) co
     }
 }
 
-std::pair<std::vector<CTransaction>, uint64_t> CTxMemPool::DrainRecentlyAdded()
+std::pair<std::vector<std::shared_ptr<const CTransaction>>, uint64_t> CTxMemPool::DrainRecentlyAdded(size_t nMax)
 {
-    uint64_t recentlyAddedSequence;
-    std::vector<CTransaction> txs;
+    uint64_t recentlyAddedSequence = 0;
+    std::vector<std::shared_ptr<const CTransaction>> txs;
     {
         LOCK(cs);
-        recentlyAddedSequence = nRecentlyAddedSequence;
-        for (const auto& kv : mapRecentlyAddedTx) {
-            txs.push_back(*(kv.second));
+        auto it = mapRecentlyAddedTx.begin();
+        while (it != mapRecentlyAddedTx.end() && txs.size() < nMax) {
+            txs.push_back(std::move(it->second));
+            it = mapRecentlyAddedTx.erase(it);
+        }
+        if (mapRecentlyAddedTx.empty()) {
+            recentlyAddedSequence = nRecentlyAddedSequence;
         }
-        mapRecentlyAddedTx.clear();
     }
 
     return std::make_pair(txs, recentlyAddedSequence);
 }
 
+size_t CTxMemPool::RecentlyAddedBacklog()
+{
+    LOCK(cs);
+    return mapRecentlyAddedTx.size();
+}
+
 void CTxMemPool::SetNotifiedSequence(uint64_t recentlyAddedSequence) {
     assert(Params().NetworkIDString() == "regtest");
     LOCK(cs);
@@ -1205,8 +1388,9 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
     // boost::multi_index_contained is implemented.
     total += memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 9 * sizeof(void*)) * mapTx.size();
 
-    // Three metadata maps inherited from Bitcoin Core
-    total += memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks);
+    // Two metadata maps inherited from Bitcoin Core, and the dependency graph
+    total += memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas);
+    total += memusage::DynamicUsage(vGraph) + memusage::DynamicUsage(vGraphFree);
 
     // Saves iterating over the full map
     total += cachedInnerUsage;
@@ -1233,75 +1417,78 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
     return total;
 }
 
-void CTxMemPool::UpdateMetrics() const {
-    LOCK(cs);
-
+void CTxMemPoolStats::Update(const CTxMemPoolEntry& entry, bool fAdd)
+{
     static const int64_t WEIGHT_RATIO_20_PCT = WEIGHT_RATIO_SCALE / 5;
 
-    // Track the sum of unpaid actions within each transaction (as they are subject to the
-    // unpaid action limit). Transactions that have weight >= 1 have no unpaid actions by
-    // definition.
-    size_t unpaidActionsWithWeightLt20pct = 0;
-    size_t unpaidActionsWithWeightLt40pct = 0;
-    size_t unpaidActionsWithWeightLt60pct = 0;
-    size_t unpaidActionsWithWeightLt80pct = 0;
-    size_t unpaidActionsWithWeightLt1 = 0;
-
-    // Track the total number of paid actions across all transactions in the mempool. This
-    // added to the bucketed unpaid actions above is equal to the total number of
-    // conventional actions in the mempool.
-    size_t paidActions = 0;
-
-    // Track the sum of transaction sizes (the metric by which they are mainly
-    // limited) across several buckets.
-    size_t sizeWithWeightLt1 = 0;
-    size_t sizeWithWeightEq1 = 0;
-    size_t sizeWithWeightGt1 = 0;
-    size_t sizeWithWeightGt2 = 0;
-    size_t sizeWithWeightGt3 = 0;
-
-    for (auto entry : mapTx) {
-        size_t txSize = entry.GetTxSize();
-        size_t unpaidActions = entry.GetUnpaidActionCount();
-        paidActions += std::max(GRACE_ACTIONS, entry.GetTx().GetLogicalActionCount()) - unpaidActions;
-
-        int128_t weightRatio = entry.GetWeightRatio();
-        if (weightRatio > 3 * WEIGHT_RATIO_SCALE) {
-            sizeWithWeightGt3 += txSize;
-        } else if (weightRatio > 2 * WEIGHT_RATIO_SCALE) {
-            sizeWithWeightGt2 += txSize;
-        } else if (weightRatio > WEIGHT_RATIO_SCALE) {
-            sizeWithWeightGt1 += txSize;
-        } else if (weightRatio == WEIGHT_RATIO_SCALE) {
-            sizeWithWeightEq1 += txSize;
+    // Entries are added and removed with the same fee, so the buckets they
+    // fall into, and hence the totals, always balance.
+    auto apply = [fAdd](auto& total, auto value) {
+        if (fAdd) {
+            total += value;
         } else {
-            sizeWithWeightLt1 += txSize;
-            if (weightRatio < WEIGHT_RATIO_20_PCT) {
-                unpaidActionsWithWeightLt20pct += unpaidActions;
-            } else if (weightRatio < 2 * WEIGHT_RATIO_20_PCT) {
-                unpaidActionsWithWeightLt40pct += unpaidActions;
-            } else if (weightRatio < 3 * WEIGHT_RATIO_20_PCT) {
-                unpaidActionsWithWeightLt60pct += unpaidActions;
-            } else if (weightRatio < 4 * WEIGHT_RATIO_20_PCT) {
-                unpaidActionsWithWeightLt80pct += unpaidActions;
-            } else {
-                unpaidActionsWithWeightLt1 += unpaidActions;
-            }
+            total -= value;
+        }
+    };
+
+    uint64_t txSize = entry.GetTxSize();
+    CAmount fee = entry.GetModifiedFee();
+    apply(nTx, uint64_t(1));
+    apply(nBytes, txSize);
+    apply(nFees, fee);
+
+    // Transactions that have weight >= 1 have no unpaid actions by definition.
+    uint64_t nUnpaid = entry.GetUnpaidActionCount();
+    apply(nPaidActions, uint64_t(std::max(GRACE_ACTIONS, entry.GetTx().GetLogicalActionCount()) - nUnpaid));
+
+    int128_t weightRatio = entry.GetWeightRatio();
+    if (weightRatio > 3 * WEIGHT_RATIO_SCALE) {
+        apply(weightedBytes[4], txSize);
+    } else if (weightRatio > 2 * WEIGHT_RATIO_SCALE) {
+        apply(weightedBytes[3], txSize);
+    } else if (weightRatio > WEIGHT_RATIO_SCALE) {
+        apply(weightedBytes[2], txSize);
+    } else if (weightRatio == WEIGHT_RATIO_SCALE) {
+        apply(weightedBytes[1], txSize);
+    } else {
+        apply(weightedBytes[0], txSize);
+        if (weightRatio < WEIGHT_RATIO_20_PCT) {
+            apply(unpaidActions[0], nUnpaid);
+        } else if (weightRatio < 2 * WEIGHT_RATIO_20_PCT) {
+            apply(unpaidActions[1], nUnpaid);
+        } else if (weightRatio < 3 * WEIGHT_RATIO_20_PCT) {
+            apply(unpaidActions[2], nUnpaid);
+        } else if (weightRatio < 4 * WEIGHT_RATIO_20_PCT) {
+            apply(unpaidActions[3], nUnpaid);
+        } else {
+            apply(unpaidActions[4], nUnpaid);
         }
     }
 
-    MetricsGauge("zcash.mempool.actions.unpaid", unpaidActionsWithWeightLt20pct, "bk", "< 0.2");
-    MetricsGauge("zcash.mempool.actions.unpaid", unpaidActionsWithWeightLt40pct, "bk", "< 0.4");
-    MetricsGauge("zcash.mempool.actions.unpaid", unpaidActionsWithWeightLt60pct, "bk", "< 0.6");
-    MetricsGauge("zcash.mempool.actions.unpaid", unpaidActionsWithWeightLt80pct, "bk", "< 0.8");
-    MetricsGauge("zcash.mempool.actions.unpaid", unpaidActionsWithWeightLt1, "bk", "< 1");
-    MetricsGauge("zcash.mempool.actions.paid", paidActions);
+    // Negative modified fee rates are counted in the lowest bucket.
+    CAmount feeRate = CFeeRate(fee, txSize).GetFeePerK();
+    size_t bucket = std::upper_bound(
+        std::begin(FEE_RATE_BUCKETS) + 1, std::end(FEE_RATE_BUCKETS), feeRate) - std::begin(FEE_RATE_BUCKETS) - 1;
+    apply(feeRates[bucket].nTx, uint64_t(1));
+    apply(feeRates[bucket].nBytes, txSize);
+    apply(feeRates[bucket].nFees, fee);
+}
+
+void CTxMemPool::UpdateMetrics() const {
+    LOCK(cs);
+
+    MetricsGauge("zcash.mempool.actions.unpaid", stats.unpaidActions[0], "bk", "< 0.2");
+    MetricsGauge("zcash.mempool.actions.unpaid", stats.unpaidActions[1], "bk", "< 0.4");
+    MetricsGauge("zcash.mempool.actions.unpaid", stats.unpaidActions[2], "bk", "< 0.6");
+    MetricsGauge("zcash.mempool.actions.unpaid", stats.unpaidActions[3], "bk", "< 0.8");
+    MetricsGauge("zcash.mempool.actions.unpaid", stats.unpaidActions[4], "bk", "< 1");
+    MetricsGauge("zcash.mempool.actions.paid", stats.nPaidActions);
     MetricsGauge("zcash.mempool.size.transactions", size());
-    MetricsGauge("zcash.mempool.size.weighted", sizeWithWeightLt1, "bk", "< 1");
-    MetricsGauge("zcash.mempool.size.weighted", sizeWithWeightEq1, "bk", "1");
-    MetricsGauge("zcash.mempool.size.weighted", sizeWithWeightGt1, "bk", "> 1");
-    MetricsGauge("zcash.mempool.size.weighted", sizeWithWeightGt2, "bk", "> 2");
-    MetricsGauge("zcash.mempool.size.weighted", sizeWithWeightGt3, "bk", "> 3");
+    MetricsGauge("zcash.mempool.size.weighted", stats.weightedBytes[0], "bk", "< 1");
+    MetricsGauge("zcash.mempool.size.weighted", stats.weightedBytes[1], "bk", "1");
+    MetricsGauge("zcash.mempool.size.weighted", stats.weightedBytes[2], "bk", "> 1");
+    MetricsGauge("zcash.mempool.size.weighted", stats.weightedBytes[3], "bk", "> 2");
+    MetricsGauge("zcash.mempool.size.weighted", stats.weightedBytes[4], "bk", "> 3");
     MetricsGauge("zcash.mempool.size.bytes", GetTotalTxSize());
     MetricsGauge("zcash.mempool.usage.bytes", DynamicMemoryUsage());
 }
@@ -1349,38 +1536,62 @@ bool CTxMemPool::addUnchecked(const uint256&hash, const CTxMemPoolEntry &entry)
     return addUnchecked(hash, entry, setAncestors);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+void CTxMemPool::UpdateLinks(GraphLinks& links, uint32_t n, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    GraphLinks::iterator pos = std::find(links.begin(), links.end(), n);
+    cachedInnerUsage -= memusage::DynamicUsage(links);
+    if (add && pos == links.end()) {
+        links.push_back(n);
+    } else if (!add && pos != links.end()) {
+        *pos = links.back();
+        links.pop_back();
     }
+    cachedInnerUsage += memusage::DynamicUsage(links);
+}
+
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+{
+    UpdateLinks(vGraph[entry->nGraphIndex].children, child->nGraphIndex, add);
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLinks(vGraph[entry->nGraphIndex].parents, parent->nGraphIndex, add);
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+CTxMemPool::LinkedEntries CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.parents;
+    return LinkedEntries(vGraph, vGraph[entry->nGraphIndex].parents);
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+CTxMemPool::LinkedEntries CTxMemPool::GetMemPoolChildren(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.children;
+    return LinkedEntries(vGraph, vGraph[entry->nGraphIndex].children);
+}
+
+void CTxMemPool::AddBlockCandidate(txiter entry)
+{
+    int128_t weightRatio = entry->GetWeightRatio();
+    if (weightRatio >= WEIGHT_RATIO_SCALE) {
+        candidatesPayingConventionalFee.add(entry->GetTx().GetHash(), entry, weightRatio);
+    } else {
+        candidatesNotPayingConventionalFee.add(entry->GetTx().GetHash(), entry, weightRatio);
+    }
+}
+
+void CTxMemPool::RemoveBlockCandidate(txiter entry)
+{
+    const uint256& hash = entry->GetTx().GetHash();
+    if (!candidatesPayingConventionalFee.remove(hash)) {
+        candidatesNotPayingConventionalFee.remove(hash);
+    }
+}
+
+void CTxMemPool::GetBlockCandidates(weightedCandidates& paying, weightedCandidates& notPaying) const
+{
+    AssertLockHeld(cs);
+    paying = candidatesPayingConventionalFee.samplingCopy();
+    notPaying = candidatesNotPayingConventionalFee.samplingCopy();
 }
@@ -7,6 +7,10 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <set>
@@ -15,11 +19,13 @@
 #include "amount.h"
 #include "coins.h"
 #include "mempool_limit.h"
+#include "prevector.h"
 #include "primitives/transaction.h"
 #include "sync.h"
 #include "random.h"
 #include "addressindex.h"
 #include "spentindex.h"
+#include "support/hugepagearena.h"
 #include "util/time.h"
 #include "weighted_map.h"
 #include "zcash/Note.hpp"
@@ -28,6 +34,7 @@
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
 #include "boost/multi_index/hashed_index.hpp"
+#include <boost/signals2/signal.hpp>
 
 class CAutoFile;
 
@@ -77,6 +84,11 @@ private:
     uint64_t nSizeWithDescendants;   //! ... and size
     CAmount nModFeesWithDescendants; //! ... and total fees (all including us)
 
+    //! Position of this entry in the mempool's dependency graph. It is not
+    //! part of any mapTx index, so the mempool sets it in place.
+    mutable uint32_t nGraphIndex;
+    friend class CTxMemPool;
+
 public:
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
                     int64_t _nTime, unsigned int _nHeight,
@@ -264,6 +276,104 @@ struct TxMempoolInfo
     CFeeRate feeRate;
 };
 
+/**
+ * An immutable copy of the parts of the mempool that read-only RPCs and
+ * relay need to see all of at once. It is made on demand by
+ * CTxMemPool::GetSnapshot() and shared by every reader until the mempool
+ * changes, so readers don't hold CTxMemPool::cs while they iterate or
+ * serialize, and repeated reads of an unchanged mempool don't take it at all.
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    //! The mempool's snapshot sequence number when this was made.
+    const uint64_t nSequence;
+    //! Every entry, sorted by depth and score.
+    std::vector<CTxMemPoolEntry> entries;
+    //! The txids of each entry's in-mempool parents.
+    std::vector<std::vector<uint256>> parents;
+
+    explicit CTxMemPoolSnapshot(uint64_t nSequenceIn) : nSequence(nSequenceIn) {}
+
+    std::vector<TxMempoolInfo> infoAll() const;
+    void queryHashes(std::vector<uint256>& vtxid) const;
+};
+
+/**
+ * An immutable copy of the mempool address and spent indexes (see
+ * -insightexplorer and -lightwalletd), made by
+ * CTxMemPool::GetAddressSnapshot(). It is kept apart from CTxMemPoolSnapshot
+ * so that explorer lookups copy only these indexes, and only after a
+ * transaction has entered or left them, rather than the whole mempool after
+ * every change.
+ */
+class CMempoolAddressSnapshot
+{
+public:
+    //! The mempool's address snapshot sequence number when this was made.
+    const uint64_t nSequence;
+    //! The mempool address index, in order.
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> addressIndex;
+    //! The mempool spent index, in order.
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> spentIndex;
+
+    explicit CMempoolAddressSnapshot(uint64_t nSequenceIn) : nSequence(nSequenceIn) {}
+
+    void getAddressIndex(const std::vector<std::pair<uint160, int>>& addresses,
+                         std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& results) const;
+    bool getSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+};
+
+/**
+ * Fee and size totals over the mempool, updated as entries are added, removed
+ * and reprioritised, so that reporting them costs O(buckets) rather than a
+ * walk of the whole mempool.
+ */
+class CTxMemPoolStats
+{
+public:
+    /** Lower bounds, in zatoshis per 1000 bytes, of the fee rate buckets */
+    static constexpr CAmount FEE_RATE_BUCKETS[] = {
+        0, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000
+    };
+    static constexpr size_t FEE_RATE_BUCKET_COUNT = std::size(FEE_RATE_BUCKETS);
+
+    struct FeeRateBucket {
+        uint64_t nTx = 0;
+        uint64_t nBytes = 0;
+        CAmount nFees = 0;
+
+        bool operator==(const FeeRateBucket& other) const {
+            return nTx == other.nTx && nBytes == other.nBytes && nFees == other.nFees;
+        }
+    };
+
+    uint64_t nTx = 0;
+    uint64_t nBytes = 0;
+    //! Sum of the modified fees.
+    CAmount nFees = 0;
+    //! Logical actions paid for under ZIP 317, including grace actions.
+    uint64_t nPaidActions = 0;
+    //! Unpaid actions of the entries with a weight ratio < 0.2, < 0.4, < 0.6, < 0.8 and < 1.
+    std::array<uint64_t, 5> unpaidActions{};
+    //! Bytes of the entries with a weight ratio < 1, = 1, > 1, > 2 and > 3.
+    std::array<uint64_t, 5> weightedBytes{};
+    //! Entries by modified fee rate, in the ranges starting at FEE_RATE_BUCKETS.
+    std::array<FeeRateBucket, FEE_RATE_BUCKET_COUNT> feeRates{};
+
+    void Add(const CTxMemPoolEntry& entry) { Update(entry, true); }
+    void Remove(const CTxMemPoolEntry& entry) { Update(entry, false); }
+
+    bool operator==(const CTxMemPoolStats& other) const {
+        return nTx == other.nTx && nBytes == other.nBytes && nFees == other.nFees &&
+               nPaidActions == other.nPaidActions && unpaidActions == other.unpaidActions &&
+               weightedBytes == other.weightedBytes && feeRates == other.feeRates;
+    }
+
+private:
+    void Update(const CTxMemPoolEntry& entry, bool fAdd);
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain
  * transactions that may be included in the next block.
@@ -287,8 +397,10 @@ struct TxMempoolInfo
  *
  * In order for the feerate sort to remain correct, we must update transactions
  * in the mempool when new descendants arrive.  To facilitate this, we track
- * the set of in-mempool direct parents and direct children in mapLinks.  Within
- * each CTxMemPoolEntry, we track the size and fees of all descendants.
+ * the in-mempool direct parents and direct children of each entry in a
+ * dependency graph, vGraph, whose nodes are numbered densely and link to each
+ * other by number.  Within each CTxMemPoolEntry, we track the size and fees of
+ * all descendants.
  *
  * Usually when a new transaction is added to the mempool, it has no in-mempool
  * children (because any such children would be an orphan).  So in
@@ -320,7 +432,7 @@ struct TxMempoolInfo
  * state, to account for in-mempool, out-of-block descendants for all the
  * in-block transactions by calling UpdateTransactionsFromBlock().  Note that
  * until this is called, the mempool state is not consistent, and in particular
- * mapLinks may not be correct (and therefore functions like
+ * vGraph may not be correct (and therefore functions like
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely
  * on them to walk the mempool are not generally safe to use).
  *
@@ -349,10 +461,20 @@ private:
     uint64_t totalTxSize = 0;  //!< sum of all mempool tx' byte sizes
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
-    std::map<uint256, const CTransaction*> mapRecentlyAddedTx;
+    std::map<uint256, std::shared_ptr<const CTransaction>> mapRecentlyAddedTx;
     uint64_t nRecentlyAddedSequence = 0;
     uint64_t nNotifiedSequence = 0;
 
+    //! Incremented (with cs held) whenever something a snapshot copies changes.
+    std::atomic<uint64_t> nSnapshotSequence{0};
+    mutable Mutex cs_snapshot;
+    //! The latest snapshot made. Guarded by cs_snapshot.
+    mutable std::shared_ptr<const CTxMemPoolSnapshot> snapshot;
+    //! Incremented (with cs held) whenever the address or spent index changes.
+    std::atomic<uint64_t> nAddressSnapshotSequence{0};
+    //! The latest address snapshot made. Guarded by cs_snapshot.
+    mutable std::shared_ptr<const CMempoolAddressSnapshot> addressSnapshot;
+
     std::map<uint256, const CTransaction*> mapSproutNullifiers;
     std::map<libzcash::nullifier_t, const CTransaction*> mapSaplingNullifiers;
     std::map<uint256, const CTransaction*> mapOrchardNullifiers;
@@ -382,7 +504,9 @@ public:
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByScore
             >
-        >
+        >,
+        // nodes and hash buckets from the mempool huge page arena
+        hugepage_allocator<CTxMemPoolEntry, ARENA_MEMPOOL>
     > indexed_transaction_set;
 
     /**
@@ -434,21 +558,107 @@ public:
     // Type of a set of candidate transactions to be added to a block template.
     typedef WeightedMap<uint256, txiter, int128_t, GetRandInt128> weightedCandidates;
 
-    const setEntries & GetMemPoolParents(txiter entry) const;
-    const setEntries & GetMemPoolChildren(txiter entry) const;
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    //! The graph node numbers of an entry's direct parents or children.
+    typedef prevector<4, uint32_t> GraphLinks;
+
+    struct GraphNode {
+        txiter it;
+        GraphLinks parents;
+        GraphLinks children;
+        //! The last traversal of the graph that reached this node.
+        uint64_t nEpoch = 0;
+    };
 
-    struct TxLinks {
-        setEntries parents;
-        setEntries children;
+public:
+    /** The direct in-mempool parents or children of an entry. */
+    class LinkedEntries
+    {
+    private:
+        const std::vector<GraphNode>& graph;
+        const GraphLinks& links;
+
+    public:
+        class const_iterator
+        {
+        private:
+            const std::vector<GraphNode>* graph;
+            GraphLinks::const_iterator pos;
+
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef txiter value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const txiter* pointer;
+            typedef txiter reference;
+
+            const_iterator(const std::vector<GraphNode>* graphIn, GraphLinks::const_iterator posIn) : graph(graphIn), pos(posIn) {}
+            txiter operator*() const { return (*graph)[*pos].it; }
+            const_iterator& operator++() { ++pos; return *this; }
+            bool operator==(const const_iterator& other) const { return pos == other.pos; }
+            bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+        };
+
+        LinkedEntries(const std::vector<GraphNode>& graphIn, const GraphLinks& linksIn) : graph(graphIn), links(linksIn) {}
+
+        const_iterator begin() const { return const_iterator(&graph, links.begin()); }
+        const_iterator end() const { return const_iterator(&graph, links.end()); }
+        size_t size() const { return links.size(); }
+        bool empty() const { return links.empty(); }
+        size_t count(txiter entry) const
+        {
+            return std::count_if(links.begin(), links.end(), [&](uint32_t n) { return graph[n].it == entry; });
+        }
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
-    txlinksMap mapLinks;
+    LinkedEntries GetMemPoolParents(txiter entry) const;
+    LinkedEntries GetMemPoolChildren(txiter entry) const;
+
+    /**
+     * Copy the candidates for ZIP 317 block template construction, which are
+     * kept up to date as transactions are added, removed and prioritised.
+     * The copies only support takeRandom(). Requires cs to be held.
+     */
+    void GetBlockCandidates(weightedCandidates& paying, weightedCandidates& notPaying) const;
+private:
+    //! The in-mempool descendants found for each graph node, outside of the
+    //! ones being excluded, while updating after a reorg.
+    typedef std::map<uint32_t, std::vector<uint32_t>> cacheMap;
+
+    //! The dependency graph between entries, indexed by nGraphIndex.
+    std::vector<GraphNode> vGraph;
+    //! Numbers of the nodes in vGraph that are not in use.
+    std::vector<uint32_t> vGraphFree;
+    uint64_t nGraphEpoch = 0;
+
+    void AddGraphNode(txiter entry);
+    void RemoveGraphNode(txiter entry);
+    /** Start a traversal of the graph, in which each node is visited at most once. */
+    uint64_t NewGraphEpoch() { return ++nGraphEpoch; }
+    /** Mark node n as visited by the traversal epoch; false if it already was. */
+    bool VisitGraphNode(uint32_t n, uint64_t epoch)
+    {
+        if (vGraph[n].nEpoch == epoch) return false;
+        vGraph[n].nEpoch = epoch;
+        return true;
+    }
+    /** Call fn with each in-mempool ancestor of entry, as linked in the graph. */
+    template <typename Fn>
+    void ForEachAncestor(txiter entry, Fn fn);
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
+    void UpdateLinks(GraphLinks& links, uint32_t n, bool add);
+
+    //! Every entry, weighted by its ZIP 317 weight ratio, split by whether it
+    //! pays at least the conventional fee.
+    weightedCandidates candidatesPayingConventionalFee;
+    weightedCandidates candidatesNotPayingConventionalFee;
+
+    void AddBlockCandidate(txiter entry);
+    void RemoveBlockCandidate(txiter entry);
+
+    CTxMemPoolStats stats;
 
     // insightexplorer
     std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> mapAddress;
@@ -462,6 +672,9 @@ public:
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, CAmount> mapDeltas;
 
+    /** Raised (with cs held) whenever a transaction is added; handlers must be cheap */
+    boost::signals2::signal<void (const CTransaction&)> NotifyEntryAdded;
+
     /** Create a new CTxMemPool.
      *  minReasonableRelayFee should be a feerate which is, roughly, somewhere
      *  around what it "costs" to relay a transaction around the network and
@@ -548,13 +761,21 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      *  fSearchForParents = whether to search a tx's vin for in-mempool parents, or
-     *    look up parents from mapLinks. Must be true for entries not in the mempool
+     *    look up parents from vGraph. Must be true for entries not in the mempool
      */
     bool CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents = true);
 
     bool nullifierExists(const uint256& nullifier, ShieldedType type) const;
 
-    std::pair<std::vector<CTransaction>, uint64_t> DrainRecentlyAdded();
+    /**
+     * Take up to nMax of the transactions added since the last call. The
+     * sequence number is only returned (otherwise 0) once every recently
+     * added transaction has been taken, so that the rest are not reported as
+     * notified before they are handed out by a later call.
+     */
+    std::pair<std::vector<std::shared_ptr<const CTransaction>>, uint64_t> DrainRecentlyAdded(size_t nMax);
+    /** The number of recently added transactions still waiting to be drained. */
+    size_t RecentlyAddedBacklog();
     void SetNotifiedSequence(uint64_t recentlyAddedSequence);
     bool IsFullyNotified();
 
@@ -580,10 +801,29 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /**
+     * Return a snapshot of the current contents of the mempool. It is only
+     * made again, with cs held, if the mempool has changed since the last one.
+     */
+    std::shared_ptr<const CTxMemPoolSnapshot> GetSnapshot() const;
+
+    /**
+     * Return a snapshot of the mempool address and spent indexes. Readers
+     * only take cs to make it again after those indexes have changed.
+     */
+    std::shared_ptr<const CMempoolAddressSnapshot> GetAddressSnapshot() const;
+
     size_t DynamicMemoryUsage() const;
 
     void UpdateMetrics() const;
 
+    /** The fee and size totals over the mempool, without walking it. */
+    CTxMemPoolStats GetStats() const
+    {
+        LOCK(cs);
+        return stats;
+    }
+
     /** Return nCheckFrequency */
     uint32_t GetCheckFrequency() const {
         return nCheckFrequency;
@@ -599,14 +839,14 @@ private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
      *  the descendants for a single transaction that has been added to the
      *  mempool but may have child transactions in the mempool, eg during a
-     *  chain reorg.  setExclude is the set of descendant transactions in the
-     *  mempool that must not be accounted for (because any descendants in
-     *  setExclude were added to the mempool after the transaction being
+     *  chain reorg.  vExclude marks, by graph node, the descendant transactions
+     *  in the mempool that must not be accounted for (because any descendants
+     *  in vExclude were added to the mempool after the transaction being
      *  updated and hence their state is already reflected in the parent
      *  state).
      *
      *  If updating an entry requires looking at more than maxDescendantsToVisit
-     *  transactions, outside of the ones in setExclude, then give up.
+     *  transactions, outside of the ones in vExclude, then give up.
      *
      *  cachedDescendants will be updated with the descendants of the transaction
      *  being updated, so that future invocations don't need to walk the
@@ -615,9 +855,9 @@ private:
     bool UpdateForDescendants(txiter updateIt,
             int maxDescendantsToVisit,
             cacheMap &cachedDescendants,
-            const std::set<uint256> &setExclude);
-    /** Update ancestors of hash to add/remove it as a descendant transaction. */
-    void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors);
+            const std::vector<bool> &vExclude);
+    /** Update the ancestors of a transaction being added to add it as a descendant transaction. */
+    void UpdateAncestorsOf(txiter it, const setEntries &setAncestors);
     /** For each transaction being removed, update ancestors and any direct children. */
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove);
     /** Sever link between specified transaction and direct children. */
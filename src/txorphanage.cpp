@@ -0,0 +1,174 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "txorphanage.h"
+
+#include "core_memusage.h"
+#include "random.h"
+#include "serialize.h"
+#include "util/system.h"
+#include "util/time.h"
+
+bool CTxOrphanage::AddTx(const CTransaction& tx, NodeId peer)
+{
+    // See doc/book/src/design/p2p-data-propagation.md for why orphans are
+    // indexed by txid instead of wtxid.
+    const uint256& hash = tx.GetHash();
+    if (mapOrphans.count(hash))
+        return false;
+
+    // Ignore big transactions, to avoid a
+    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
+    // large transaction with a missing parent then we assume
+    // it will rebroadcast it later, after the parent transaction(s)
+    // have been mined or received.
+    unsigned int sz = tx.GetTotalSize();
+    if (sz >= MAX_ORPHAN_TX_SIZE)
+    {
+        LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
+        return false;
+    }
+
+    int64_t nTimeExpire = GetTime() + ORPHAN_TX_EXPIRE_TIME;
+    auto ret = mapOrphans.emplace(hash, COrphanTx{tx, peer, nTimeExpire, sz, vOrphanList.size()});
+    assert(ret.second);
+    for (const CTxIn& txin : tx.vin) {
+        mapOrphansByPrev[txin.prevout].insert(ret.first);
+    }
+    mapOrphansByPeer[peer].insert(hash);
+    setOrphansByExpiry.emplace(nTimeExpire, hash);
+    vOrphanList.push_back(ret.first);
+    nTotalTxSize += sz;
+
+    LogPrint("mempool", "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
+             mapOrphans.size(), mapOrphansByPrev.size());
+    return true;
+}
+
+int CTxOrphanage::EraseTx(const uint256& txid)
+{
+    OrphanIt it = mapOrphans.find(txid);
+    if (it == mapOrphans.end())
+        return 0;
+    const COrphanTx& orphan = it->second;
+    for (const CTxIn& txin : orphan.tx.vin)
+    {
+        auto itPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itPrev == mapOrphansByPrev.end())
+            continue;
+        itPrev->second.erase(it);
+        if (itPrev->second.empty())
+            mapOrphansByPrev.erase(itPrev);
+    }
+
+    auto itPeer = mapOrphansByPeer.find(orphan.fromPeer);
+    itPeer->second.erase(txid);
+    if (itPeer->second.empty())
+        mapOrphansByPeer.erase(itPeer);
+
+    setOrphansByExpiry.erase(std::make_pair(orphan.nTimeExpire, txid));
+
+    // Move the last orphan in the list into this one's place.
+    size_t nListPos = orphan.nListPos;
+    vOrphanList[nListPos] = vOrphanList.back();
+    vOrphanList[nListPos]->second.nListPos = nListPos;
+    vOrphanList.pop_back();
+
+    nTotalTxSize -= orphan.nTxSize;
+    mapOrphans.erase(it);
+    return 1;
+}
+
+void CTxOrphanage::EraseForPeer(NodeId peer)
+{
+    auto itPeer = mapOrphansByPeer.find(peer);
+    if (itPeer == mapOrphansByPeer.end())
+        return;
+
+    // EraseTx removes the peer's set once it is empty.
+    std::vector<uint256> vErase(itPeer->second.begin(), itPeer->second.end());
+    int nErased = 0;
+    for (const uint256& txid : vErase) {
+        nErased += EraseTx(txid);
+    }
+    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
+}
+
+unsigned int CTxOrphanage::LimitOrphans(unsigned int nMaxOrphans, size_t nMaxBytes)
+{
+    int64_t nNow = GetTime();
+    int nErased = 0;
+    while (!setOrphansByExpiry.empty() && setOrphansByExpiry.begin()->first <= nNow) {
+        nErased += EraseTx(setOrphansByExpiry.begin()->second);
+    }
+    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
+
+    unsigned int nEvicted = 0;
+    while (mapOrphans.size() > nMaxOrphans || nTotalTxSize > nMaxBytes)
+    {
+        // Evict a random orphan:
+        EraseTx(vOrphanList[GetRand(vOrphanList.size())]->first);
+        ++nEvicted;
+    }
+    return nEvicted;
+}
+
+const COrphanTx* CTxOrphanage::GetTx(const uint256& txid) const
+{
+    auto it = mapOrphans.find(txid);
+    if (it == mapOrphans.end())
+        return nullptr;
+    return &it->second;
+}
+
+void CTxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const
+{
+    const uint256& txid = tx.GetHash();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        auto it_by_prev = mapOrphansByPrev.find(COutPoint(txid, i));
+        if (it_by_prev != mapOrphansByPrev.end()) {
+            for (const auto& elem : it_by_prev->second) {
+                orphan_work_set.insert(elem->first);
+            }
+        }
+    }
+}
+
+void CTxOrphanage::GetConflicts(const CTransaction& tx, std::vector<uint256>& vConflicts) const
+{
+    for (const CTxIn& txin : tx.vin) {
+        auto itByPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itByPrev == mapOrphansByPrev.end()) continue;
+        for (const auto& elem : itByPrev->second) {
+            vConflicts.push_back(elem->first);
+        }
+    }
+}
+
+size_t CTxOrphanage::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapOrphans) + memusage::DynamicUsage(mapOrphansByPrev) +
+                    memusage::DynamicUsage(mapOrphansByPeer) + memusage::DynamicUsage(setOrphansByExpiry) +
+                    memusage::DynamicUsage(vOrphanList);
+    for (const auto& entry : mapOrphans) {
+        nUsage += RecursiveDynamicUsage(entry.second.tx);
+    }
+    for (const auto& entry : mapOrphansByPrev) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    for (const auto& entry : mapOrphansByPeer) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    return nUsage;
+}
+
+void CTxOrphanage::Clear()
+{
+    mapOrphans.clear();
+    mapOrphansByPrev.clear();
+    mapOrphansByPeer.clear();
+    setOrphansByExpiry.clear();
+    vOrphanList.clear();
+    nTotalTxSize = 0;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_TXORPHANAGE_H
+#define BITCOIN_TXORPHANAGE_H
+
+#include "net.h"
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+/** Expiration time for orphan transactions in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Orphan transactions of this many bytes or more are not kept */
+static const unsigned int MAX_ORPHAN_TX_SIZE = 100000;
+
+struct COrphanTx {
+    CTransaction tx;
+    NodeId fromPeer;
+    int64_t nTimeExpire;
+    //! Serialized size of tx, counted against the orphanage's size limit.
+    size_t nTxSize;
+    //! Position of this orphan in CTxOrphanage::vOrphanList.
+    size_t nListPos;
+};
+
+/**
+ * Transactions whose inputs are not known yet, kept until their parents
+ * arrive, they expire, or the peer that sent them disconnects.
+ *
+ * Orphans are indexed by txid, by the outpoints they spend, by the peer they
+ * came from and by expiry time, so every operation only touches the orphans
+ * it removes or returns. They are limited both in number and in total size.
+ *
+ * As with the rest of transaction relay, callers hold cs_main.
+ */
+class CTxOrphanage
+{
+private:
+    typedef std::map<uint256, COrphanTx>::iterator OrphanIt;
+
+    struct IteratorComparator
+    {
+        bool operator()(const OrphanIt& a, const OrphanIt& b) const
+        {
+            return &(*a) < &(*b);
+        }
+    };
+
+    std::map<uint256, COrphanTx> mapOrphans;
+    std::map<COutPoint, std::set<OrphanIt, IteratorComparator>> mapOrphansByPrev;
+    std::map<NodeId, std::set<uint256>> mapOrphansByPeer;
+    std::set<std::pair<int64_t, uint256>> setOrphansByExpiry;
+    //! Every orphan, in no particular order, to pick one at random in O(1).
+    std::vector<OrphanIt> vOrphanList;
+    size_t nTotalTxSize = 0;
+
+public:
+    /**
+     * Add tx, received from peer. Returns false if it is already an orphan
+     * or is too large to keep.
+     */
+    bool AddTx(const CTransaction& tx, NodeId peer);
+
+    /** Remove the orphan with this txid. Returns the number of orphans removed. */
+    int EraseTx(const uint256& txid);
+
+    /** Remove every orphan received from peer. */
+    void EraseForPeer(NodeId peer);
+
+    /**
+     * Remove expired orphans, then orphans chosen at random until at most
+     * nMaxOrphans are left and they take at most nMaxBytes in total. Returns
+     * the number removed at random.
+     */
+    unsigned int LimitOrphans(unsigned int nMaxOrphans, size_t nMaxBytes);
+
+    bool HaveTx(const uint256& txid) const { return mapOrphans.count(txid) > 0; }
+
+    /** The orphan with this txid, or nullptr. Only valid until the orphanage changes. */
+    const COrphanTx* GetTx(const uint256& txid) const;
+
+    /** Add the txids of the orphans spending outputs of tx to orphan_work_set. */
+    void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const;
+
+    /** Append the txids of the orphans spending any of the inputs of tx to vConflicts. */
+    void GetConflicts(const CTransaction& tx, std::vector<uint256>& vConflicts) const;
+
+    size_t Size() const { return mapOrphans.size(); }
+    size_t TotalTxSize() const { return nTotalTxSize; }
+    //! Number of distinct outpoints spent by orphans.
+    size_t PrevoutCount() const { return mapOrphansByPrev.size(); }
+    //! Memory used by the orphans and their indexes, in bytes.
+    size_t DynamicMemoryUsage() const;
+
+    void Clear();
+};
+
+#endif // BITCOIN_TXORPHANAGE_H
@@ -0,0 +1,97 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "txreconciliation.h"
+
+#include "hash.h"
+#include "pinsketch.h"
+
+#include <algorithm>
+
+CTxReconciliationState::CTxReconciliationState(bool fInitiatorIn, uint64_t nLocalSalt, uint64_t nRemoteSalt) :
+    fInitiator(fInitiatorIn),
+    k0(std::min(nLocalSalt, nRemoteSalt)),
+    k1(std::max(nLocalSalt, nRemoteSalt))
+{
+}
+
+uint32_t CTxReconciliationState::GetShortTxId(const CInv& inv) const
+{
+    CSipHasher hasher(k0, k1);
+    hasher.Write(inv.hash.begin(), inv.hash.size());
+    if (inv.type == MSG_WTX)
+        hasher.Write(inv.hashAux.begin(), inv.hashAux.size());
+    uint32_t id = hasher.Finalize();
+    // Zero can't be sketched.
+    return id ? id : 1;
+}
+
+bool CTxReconciliationState::Add(const CInv& inv)
+{
+    if (setPending.size() >= MAX_TXRECONCILIATION_SET_SIZE)
+        return false;
+    auto ret = setPending.emplace(GetShortTxId(inv), inv);
+    // Of two transactions with the same short ID, the second is flooded.
+    return ret.second || (ret.first->second.hash == inv.hash && ret.first->second.hashAux == inv.hashAux);
+}
+
+void CTxReconciliationState::StartRound(int64_t nNow)
+{
+    // Whatever is left of an unfinished round is tried again.
+    setPending.insert(setRound.begin(), setRound.end());
+    setRound = std::move(setPending);
+    setPending.clear();
+    fRoundInProgress = true;
+    nRoundStarted = nNow;
+}
+
+TxReconciliationSet CTxReconciliationState::EndRound()
+{
+    TxReconciliationSet set = std::move(setRound);
+    setRound.clear();
+    fRoundInProgress = false;
+    return set;
+}
+
+size_t ComputeSketchCapacity(size_t nLocalSize, size_t nRemoteSize, uint16_t q)
+{
+    size_t nDifference = std::max(nLocalSize, nRemoteSize) - std::min(nLocalSize, nRemoteSize);
+    size_t nCapacity = nDifference + (uint64_t(q) * std::min(nLocalSize, nRemoteSize)) / TXRECONCILIATION_Q_PRECISION + 1;
+    return std::min(nCapacity, MAX_SKETCH_CAPACITY);
+}
+
+std::vector<unsigned char> BuildTxReconciliationSketch(const TxReconciliationSet& set, size_t nCapacity)
+{
+    CPinSketch sketch(nCapacity);
+    for (const auto& entry : set)
+        sketch.Add(entry.first);
+    return sketch.Serialize();
+}
+
+bool ReconcileTxSketch(const TxReconciliationSet& set, const std::vector<unsigned char>& vSketch,
+                       std::vector<CInv>& vAnnounce, std::vector<uint32_t>& vAsk)
+{
+    vAnnounce.clear();
+    vAsk.clear();
+    CPinSketch sketch(0);
+    if (!CPinSketch::Deserialize(vSketch, sketch) || sketch.Capacity() == 0 || sketch.Capacity() > MAX_SKETCH_CAPACITY)
+        return false;
+
+    CPinSketch local(sketch.Capacity());
+    for (const auto& entry : set)
+        local.Add(entry.first);
+    sketch.Merge(local);
+
+    std::vector<uint32_t> vDifference;
+    if (!sketch.Decode(vDifference))
+        return false;
+    for (uint32_t id : vDifference) {
+        auto it = set.find(id);
+        if (it != set.end())
+            vAnnounce.push_back(it->second);
+        else
+            vAsk.push_back(id);
+    }
+    return true;
+}
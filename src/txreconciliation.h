@@ -0,0 +1,89 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_TXRECONCILIATION_H
+#define BITCOIN_TXRECONCILIATION_H
+
+#include "protocol.h"
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/** Default for -txreconciliation: announce transactions to peers that support it by set reconciliation. */
+static const bool DEFAULT_TXRECONCILIATION = false;
+/** The version of the reconciliation protocol we speak, sent in sendtxrcncl. */
+static const uint32_t TXRECONCILIATION_VERSION = 1;
+/** Time (in microseconds) between reconciliations we start with each outbound peer. */
+static const int64_t TXRECONCILIATION_INTERVAL = 8 * 1000000;
+/** Time (in microseconds) to wait for a peer's sketch before flooding the round's transactions instead. */
+static const int64_t TXRECONCILIATION_TIMEOUT = 60 * 1000000;
+/** Most transactions waiting for reconciliation with a peer; any more are announced with an inv. */
+static const size_t MAX_TXRECONCILIATION_SET_SIZE = 3000;
+/** Largest sketch we build or accept, in elements. */
+static const size_t MAX_SKETCH_CAPACITY = 128;
+/**
+ * How much of the smaller set we expect to differ, in units of
+ * 1 / TXRECONCILIATION_Q_PRECISION, on top of the difference in set sizes.
+ */
+static const uint16_t DEFAULT_TXRECONCILIATION_Q = 4096;
+static const uint16_t TXRECONCILIATION_Q_PRECISION = 16384;
+
+/** The transactions waiting to be announced to a peer by reconciliation, by short ID. */
+typedef std::map<uint32_t, CInv> TxReconciliationSet;
+
+/**
+ * A peer we announce transactions to by reconciling our sets, as in BIP 330.
+ * The peer that made the connection asks for a sketch of the other's set
+ * every TXRECONCILIATION_INTERVAL, decodes the difference with its own, then
+ * announces what the other lacks and asks for the rest by short ID. If the
+ * difference is too large to decode, both sides announce the round's
+ * transactions with inv messages instead.
+ */
+struct CTxReconciliationState {
+    //! Whether we start the reconciliations with this peer.
+    bool fInitiator;
+    //! The SipHash key for short IDs, derived from both peers' salts.
+    uint64_t k0;
+    uint64_t k1;
+    //! Transactions to announce in the next round.
+    TxReconciliationSet setPending;
+    //! Transactions announced in the round under way.
+    TxReconciliationSet setRound;
+    //! Whether a round is under way, and since when (in microseconds).
+    bool fRoundInProgress = false;
+    int64_t nRoundStarted = 0;
+    //! When we start the next round, if we are the initiator.
+    int64_t nNextRound = 0;
+
+    CTxReconciliationState(bool fInitiatorIn, uint64_t nLocalSalt, uint64_t nRemoteSalt);
+
+    /** The short ID of a transaction announced with inv. It is never zero. */
+    uint32_t GetShortTxId(const CInv& inv) const;
+
+    /** Queue a transaction for the next round. Returns false if it should be announced with an inv instead. */
+    bool Add(const CInv& inv);
+
+    /** Start a round, taking the pending transactions into it. */
+    void StartRound(int64_t nNow);
+
+    /** End the round, returning its transactions. */
+    TxReconciliationSet EndRound();
+};
+
+/** How many elements a sketch needs to hold the difference between sets of these sizes. */
+size_t ComputeSketchCapacity(size_t nLocalSize, size_t nRemoteSize, uint16_t q);
+
+/** Sketch the short IDs of a set. */
+std::vector<unsigned char> BuildTxReconciliationSketch(const TxReconciliationSet& set, size_t nCapacity);
+
+/**
+ * Compare a peer's sketch against ours. On success, vAnnounce holds the
+ * transactions the peer lacks and vAsk the short IDs of those we lack.
+ * Fails if the sketch is malformed or the difference too large.
+ */
+bool ReconcileTxSketch(const TxReconciliationSet& set, const std::vector<unsigned char>& vSketch,
+                       std::vector<CInv>& vAnnounce, std::vector<uint32_t>& vAsk);
+
+#endif // BITCOIN_TXRECONCILIATION_H
@@ -0,0 +1,200 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "txrequest.h"
+
+#include "util/system.h"
+
+#include <algorithm>
+
+void CTxRequestTracker::Wake(NodeId peer, int64_t nTime)
+{
+    auto it = mapPeers.find(peer);
+    if (it != mapPeers.end())
+        it->second.nNextCheck = std::min(it->second.nNextCheck, nTime);
+}
+
+void CTxRequestTracker::CompleteRequest(const WTxId& wtxid, std::vector<Announcement>& vAnn, Announcement& a)
+{
+    if (a.state == REQUESTED) {
+        auto it = mapPeers.find(a.peer);
+        if (it != mapPeers.end() && it->second.nInFlight-- == MAX_PEER_TX_REQUEST_IN_FLIGHT) {
+            // The peer has room for another request
+            Wake(a.peer, 0);
+        }
+        for (const Announcement& other : vAnn) {
+            if (other.state == CANDIDATE)
+                Wake(other.peer, other.nTime);
+        }
+    }
+    a.state = COMPLETED;
+}
+
+void CTxRequestTracker::EraseIfDone(TxIt it)
+{
+    for (const Announcement& a : it->second) {
+        if (a.state != COMPLETED)
+            return;
+    }
+    for (const Announcement& a : it->second) {
+        auto itPeer = mapPeers.find(a.peer);
+        if (itPeer != mapPeers.end())
+            itPeer->second.setAnnounced.erase(it->first);
+    }
+    mapTxs.erase(it);
+}
+
+bool CTxRequestTracker::ReceivedInv(NodeId peer, const CInv& inv, bool fPreferred, int64_t nNow)
+{
+    PeerInfo& info = mapPeers[peer];
+    if (info.setAnnounced.size() >= MAX_PEER_TX_ANNOUNCEMENTS)
+        return false;
+    WTxId wtxid(inv.hash, inv.hashAux);
+    if (!info.setAnnounced.insert(wtxid).second)
+        return false;
+
+    int64_t nReqTime = nNow;
+    if (!fPreferred)
+        nReqTime += TX_REQUEST_NONPREF_DELAY;
+    if (info.nInFlight >= MAX_PEER_TX_REQUEST_IN_FLIGHT)
+        nReqTime += TX_REQUEST_OVERLOADED_DELAY;
+    mapTxs[wtxid].push_back(Announcement{inv, peer, fPreferred, CANDIDATE, nReqTime, nSequence++});
+    Wake(peer, nReqTime);
+    return true;
+}
+
+std::vector<CInv> CTxRequestTracker::GetRequestable(NodeId peer, int64_t nNow)
+{
+    std::vector<CInv> vRequest;
+    auto itPeer = mapPeers.find(peer);
+    if (itPeer == mapPeers.end() || nNow < itPeer->second.nNextCheck)
+        return vRequest;
+    PeerInfo& info = itPeer->second;
+    info.nNextCheck = std::numeric_limits<int64_t>::max();
+
+    int64_t nNext = std::numeric_limits<int64_t>::max();
+    std::vector<WTxId> vDone;
+    for (const WTxId& wtxid : info.setAnnounced) {
+        // Woken again when one of the requests completes
+        if (info.nInFlight >= MAX_PEER_TX_REQUEST_IN_FLIGHT)
+            break;
+
+        std::vector<Announcement>& vAnn = mapTxs.find(wtxid)->second;
+        for (Announcement& a : vAnn) {
+            if (a.state == REQUESTED && a.nTime <= nNow) {
+                LogPrint("net", "timeout of inflight tx %s peer=%d\n", a.inv.ToString(), a.peer);
+                CompleteRequest(wtxid, vAnn, a);
+            }
+        }
+
+        Announcement* pOwn = nullptr;
+        Announcement* pBest = nullptr;
+        int64_t nExpiry = -1;
+        bool fLeft = false;
+        for (Announcement& a : vAnn) {
+            if (a.peer == peer)
+                pOwn = &a;
+            if (a.state == REQUESTED) {
+                nExpiry = a.nTime;
+            } else if (a.state == CANDIDATE) {
+                fLeft = true;
+                if (a.nTime > nNow)
+                    continue;
+                auto itOther = mapPeers.find(a.peer);
+                if (itOther == mapPeers.end() || itOther->second.nInFlight >= MAX_PEER_TX_REQUEST_IN_FLIGHT)
+                    continue;
+                if (!pBest || a.fPreferred > pBest->fPreferred ||
+                    (a.fPreferred == pBest->fPreferred && a.nSequence < pBest->nSequence))
+                    pBest = &a;
+            }
+        }
+
+        if (nExpiry >= 0) {
+            // Someone is asked already; look again when that times out
+            nNext = std::min(nNext, nExpiry);
+        } else if (!fLeft) {
+            vDone.push_back(wtxid);
+        } else if (pBest == pOwn) {
+            pOwn->state = REQUESTED;
+            pOwn->nTime = nNow + TX_REQUEST_TIMEOUT;
+            info.nInFlight++;
+            vRequest.push_back(pOwn->inv);
+            nNext = std::min(nNext, pOwn->nTime);
+        } else if (pOwn->state == CANDIDATE && pOwn->nTime > nNow) {
+            nNext = std::min(nNext, pOwn->nTime);
+        }
+        // Otherwise another announcer goes first, and wakes us if it fails.
+    }
+    info.nNextCheck = std::min(info.nNextCheck, nNext);
+
+    for (const WTxId& wtxid : vDone) {
+        auto it = mapTxs.find(wtxid);
+        if (it != mapTxs.end())
+            EraseIfDone(it);
+    }
+    return vRequest;
+}
+
+void CTxRequestTracker::ReceivedResponse(NodeId peer, const WTxId& wtxid)
+{
+    auto it = mapTxs.find(wtxid);
+    if (it == mapTxs.end())
+        return;
+    for (Announcement& a : it->second) {
+        if (a.peer == peer) {
+            CompleteRequest(wtxid, it->second, a);
+            break;
+        }
+    }
+    EraseIfDone(it);
+}
+
+void CTxRequestTracker::ForgetTx(const WTxId& wtxid)
+{
+    auto it = mapTxs.find(wtxid);
+    if (it == mapTxs.end())
+        return;
+    for (Announcement& a : it->second) {
+        if (a.state == REQUESTED) {
+            auto itPeer = mapPeers.find(a.peer);
+            if (itPeer != mapPeers.end() && itPeer->second.nInFlight-- == MAX_PEER_TX_REQUEST_IN_FLIGHT)
+                Wake(a.peer, 0);
+        }
+        a.state = COMPLETED;
+    }
+    EraseIfDone(it);
+}
+
+void CTxRequestTracker::DisconnectedPeer(NodeId peer)
+{
+    auto itPeer = mapPeers.find(peer);
+    if (itPeer == mapPeers.end())
+        return;
+    for (const WTxId& wtxid : itPeer->second.setAnnounced) {
+        auto it = mapTxs.find(wtxid);
+        std::vector<Announcement>& vAnn = it->second;
+        for (auto ia = vAnn.begin(); ia != vAnn.end(); ++ia) {
+            if (ia->peer == peer) {
+                CompleteRequest(wtxid, vAnn, *ia);
+                vAnn.erase(ia);
+                break;
+            }
+        }
+        // Only touches the other announcers' sets
+        EraseIfDone(it);
+    }
+    mapPeers.erase(itPeer);
+}
+
+size_t CTxRequestTracker::CountInFlight(NodeId peer) const
+{
+    auto it = mapPeers.find(peer);
+    return it == mapPeers.end() ? 0 : it->second.nInFlight;
+}
+
+size_t CTxRequestTracker::CountAnnounced(NodeId peer) const
+{
+    auto it = mapPeers.find(peer);
+    return it == mapPeers.end() ? 0 : it->second.setAnnounced.size();
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_TXREQUEST_H
+#define BITCOIN_TXREQUEST_H
+
+#include "net.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+
+#include <limits>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+/** Most transactions we wait for from one peer at a time. */
+static const size_t MAX_PEER_TX_REQUEST_IN_FLIGHT = 100;
+/** Most announced transactions we remember for one peer; further announcements are ignored. */
+static const size_t MAX_PEER_TX_ANNOUNCEMENTS = 5000;
+/** How long (in microseconds) to wait before asking an inbound peer, so outbound peers go first. */
+static const int64_t TX_REQUEST_NONPREF_DELAY = 2 * 1000000;
+/** Extra wait (in microseconds) for announcements from a peer with MAX_PEER_TX_REQUEST_IN_FLIGHT requests outstanding. */
+static const int64_t TX_REQUEST_OVERLOADED_DELAY = 2 * 1000000;
+/** How long (in microseconds) a peer has to deliver a transaction before we ask another announcer. */
+static const int64_t TX_REQUEST_TIMEOUT = 60 * 1000000;
+
+/**
+ * The transactions peers have announced to us and which of them we have
+ * asked for, so that each transaction is requested from one announcer at a
+ * time however many announce it.
+ *
+ * An announcement can be requested once its delay has passed: none for
+ * preferred (outbound) peers, TX_REQUEST_NONPREF_DELAY for the others, and
+ * TX_REQUEST_OVERLOADED_DELAY more if the peer was already at its in-flight
+ * limit. Of the announcements that are ready, preferred ones go first, then
+ * the earliest. When a request times out or the peer answers notfound or
+ * disconnects, the next announcer is asked. A transaction is forgotten once
+ * we have it or every announcer has been tried.
+ *
+ * Each peer keeps the time it next needs looking at, so GetRequestable is
+ * cheap for peers with nothing new. Times are in microseconds. As with the
+ * rest of transaction relay, callers hold cs_main.
+ */
+class CTxRequestTracker
+{
+private:
+    enum AnnouncementState { CANDIDATE, REQUESTED, COMPLETED };
+
+    struct Announcement {
+        CInv inv;
+        NodeId peer;
+        bool fPreferred;
+        AnnouncementState state;
+        //! For a candidate, when it can be requested; for a request, when it times out.
+        int64_t nTime;
+        //! Announcements are tried in the order they arrived.
+        uint64_t nSequence;
+    };
+
+    struct PeerInfo {
+        std::set<WTxId> setAnnounced;
+        size_t nInFlight = 0;
+        //! GetRequestable has nothing to do for the peer before this time.
+        int64_t nNextCheck = std::numeric_limits<int64_t>::max();
+    };
+
+    typedef std::map<WTxId, std::vector<Announcement>>::iterator TxIt;
+
+    std::map<WTxId, std::vector<Announcement>> mapTxs;
+    std::map<NodeId, PeerInfo> mapPeers;
+    uint64_t nSequence = 0;
+
+    void Wake(NodeId peer, int64_t nTime);
+    //! Mark a's request answered or abandoned and let the other announcers try.
+    void CompleteRequest(const WTxId& wtxid, std::vector<Announcement>& vAnn, Announcement& a);
+    //! Forget the transaction if no announcement of it is left to try.
+    void EraseIfDone(TxIt it);
+
+public:
+    /**
+     * peer announced inv at nNow. Returns false if it was ignored because
+     * the peer already announced it or too many other transactions.
+     */
+    bool ReceivedInv(NodeId peer, const CInv& inv, bool fPreferred, int64_t nNow);
+
+    /**
+     * The announcements to request from peer now, up to its in-flight limit.
+     * They are marked as requested, so the caller must send them or call
+     * ForgetTx for each.
+     */
+    std::vector<CInv> GetRequestable(NodeId peer, int64_t nNow);
+
+    /** peer sent the transaction or answered notfound. */
+    void ReceivedResponse(NodeId peer, const WTxId& wtxid);
+
+    /** We have the transaction or do not want it: drop every announcement of it. */
+    void ForgetTx(const WTxId& wtxid);
+
+    void DisconnectedPeer(NodeId peer);
+
+    size_t CountInFlight(NodeId peer) const;
+    size_t CountAnnounced(NodeId peer) const;
+    //! Number of distinct transactions announced.
+    size_t Size() const { return mapTxs.size(); }
+};
+
+#endif // BITCOIN_TXREQUEST_H
@@ -12,9 +12,14 @@
 #include "sync.h"
 
 #include <chrono>
+#include <time.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread.hpp>
 
+#ifdef WIN32
+#include <windows.h>
+#endif
+
 // This guards accesses to FixedClock and OffsetClock.
 RecursiveMutex cs_clock;
 
@@ -36,6 +41,26 @@ int64_t GetTimeMicros() {
     return zcashdClock->GetTimeMicros();
 }
 
+int64_t GetThreadCPUTimeMicros() {
+#ifdef WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    ULARGE_INTEGER nKernel, nUser;
+    nKernel.LowPart = kernel.dwLowDateTime;
+    nKernel.HighPart = kernel.dwHighDateTime;
+    nUser.LowPart = user.dwLowDateTime;
+    nUser.HighPart = user.dwHighDateTime;
+    // FILETIME counts 100ns intervals.
+    return (nKernel.QuadPart + nUser.QuadPart) / 10;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
 void SystemClock::SetGlobal() {
     zcashdClock = SystemClock::Instance();
 }
@@ -98,6 +98,9 @@ int64_t GetTime();
 int64_t GetTimeMillis();
 int64_t GetTimeMicros();
 
+/** CPU time (in microseconds) used by the calling thread. Not affected by the node clock. */
+int64_t GetThreadCPUTimeMicros();
+
 void MilliSleep(int64_t n);
 
 std::string DateTimeStrFormat(const char* pszFormat, int64_t nTime);
@@ -0,0 +1,269 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "v2transport.h"
+
+#include "random.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+static CKey NewEphemeralKey()
+{
+    CKey key;
+    unsigned char vch[32];
+    do {
+        GetRandBytes(vch, sizeof(vch));
+        key.Set(vch, vch + sizeof(vch), true);
+    } while (!key.IsValid());
+    memset(vch, 0, sizeof(vch));
+    return key;
+}
+
+static std::array<unsigned char, 32> NewEntropy()
+{
+    std::array<unsigned char, 32> entropy;
+    GetRandBytes(entropy.data(), entropy.size());
+    return entropy;
+}
+
+static std::vector<unsigned char> NewGarbage()
+{
+    std::vector<unsigned char> vGarbage(GetRand(CV2Transport::MAX_GARBAGE_LEN + 1));
+    if (!vGarbage.empty())
+        GetRandBytes(vGarbage.data(), vGarbage.size());
+    return vGarbage;
+}
+
+CV2Transport::CV2Transport(bool fInitiatorIn, const CMessageHeader::MessageStartChars& pchMessageStartIn, size_t nMaxMessageSizeIn) :
+    fInitiator(fInitiatorIn),
+    nMaxMessageSize(nMaxMessageSizeIn),
+    cipher(NewEphemeralKey(), NewEntropy().data()),
+    recvState(fInitiatorIn ? RecvState::KEY : RecvState::MAYBE_V1),
+    vSendGarbage(NewGarbage())
+{
+    memcpy(pchMessageStart, pchMessageStartIn, sizeof(pchMessageStart));
+    // The initiator sends its key right away.
+    fAdvance = fInitiator;
+}
+
+CV2Transport::CV2Transport(bool fInitiatorIn, const CMessageHeader::MessageStartChars& pchMessageStartIn, size_t nMaxMessageSizeIn,
+                           const CKey& key, const EllSwiftPubKey& pubkey, std::vector<unsigned char> vGarbage) :
+    fInitiator(fInitiatorIn),
+    nMaxMessageSize(nMaxMessageSizeIn),
+    cipher(key, pubkey),
+    recvState(fInitiatorIn ? RecvState::KEY : RecvState::MAYBE_V1),
+    vSendGarbage(std::move(vGarbage))
+{
+    assert(vSendGarbage.size() <= MAX_GARBAGE_LEN);
+    memcpy(pchMessageStart, pchMessageStartIn, sizeof(pchMessageStart));
+    fAdvance = fInitiator;
+}
+
+int CV2Transport::ReceiveBytes(const char* pch, unsigned int nBytes, CRecvBufferPool& pool)
+{
+    if (fAdvance || fHaveMessage)
+        return 0;
+
+    switch (recvState) {
+    case RecvState::MAYBE_V1: {
+        unsigned char prefix[V1_PREFIX_LEN] = {};
+        memcpy(prefix, pchMessageStart, CMessageHeader::MESSAGE_START_SIZE);
+        memcpy(prefix + CMessageHeader::MESSAGE_START_SIZE, "version", 7);
+
+        unsigned int nCopy = std::min<size_t>(nBytes, V1_PREFIX_LEN - vRecvBuffer.size());
+        vRecvBuffer.insert(vRecvBuffer.end(), pch, pch + nCopy);
+        if (memcmp(vRecvBuffer.data(), prefix, vRecvBuffer.size()) != 0) {
+            // Not v1, so these bytes start the peer's key, and we owe it ours.
+            recvState = RecvState::KEY;
+            fAdvance = true;
+        } else if (vRecvBuffer.size() == V1_PREFIX_LEN) {
+            recvState = RecvState::V1;
+            fAdvance = true;
+        }
+        return nCopy;
+    }
+    case RecvState::KEY: {
+        unsigned int nCopy = std::min<size_t>(nBytes, EllSwiftPubKey::SIZE - vRecvBuffer.size());
+        vRecvBuffer.insert(vRecvBuffer.end(), pch, pch + nCopy);
+        if (vRecvBuffer.size() == EllSwiftPubKey::SIZE) {
+            recvState = RecvState::KEY_RECEIVED;
+            fAdvance = true;
+        }
+        return nCopy;
+    }
+    case RecvState::GARB_GARBTERM: {
+        const unsigned char* terminator = cipher.GetReceiveGarbageTerminator();
+        const size_t nTermLen = BIP324Cipher::GARBAGE_TERMINATOR_LEN;
+        unsigned int n = 0;
+        while (n < nBytes) {
+            vRecvBuffer.push_back(pch[n++]);
+            size_t nSize = vRecvBuffer.size();
+            if (nSize >= nTermLen && memcmp(&vRecvBuffer[nSize - nTermLen], terminator, nTermLen) == 0) {
+                // What came before is the garbage, which the first packet authenticates.
+                vRecvBuffer.resize(nSize - nTermLen);
+                recvState = RecvState::VERSION;
+                return n;
+            }
+            if (nSize >= MAX_GARBAGE_LEN + nTermLen)
+                return -1;
+        }
+        return n;
+    }
+    case RecvState::VERSION:
+    case RecvState::APP:
+        return ReceivePacket(pch, nBytes, pool);
+    case RecvState::KEY_RECEIVED:
+    case RecvState::V1:
+        return 0;
+    }
+    assert(false);
+}
+
+int CV2Transport::ReceivePacket(const char* pch, unsigned int nBytes, CRecvBufferPool& pool)
+{
+    if (nRecvLengthPos < BIP324Cipher::LENGTH_LEN) {
+        unsigned int nCopy = std::min<size_t>(nBytes, BIP324Cipher::LENGTH_LEN - nRecvLengthPos);
+        memcpy(recvLength + nRecvLengthPos, pch, nCopy);
+        nRecvLengthPos += nCopy;
+        if (nRecvLengthPos == BIP324Cipher::LENGTH_LEN) {
+            uint32_t nContentsLen = cipher.DecryptLength(recvLength);
+            // The contents are a message's type, of at most 1 + COMMAND_SIZE bytes, and its payload.
+            if (nContentsLen > 1 + CMessageHeader::COMMAND_SIZE + nMaxMessageSize)
+                return -1;
+            nRecvPacketLen = BIP324Cipher::HEADER_LEN + nContentsLen + FSChaCha20Poly1305::EXPANSION;
+            nRecvPacketPos = 0;
+            pool.Acquire(vRecvPacket, nRecvPacketLen);
+        }
+        return nCopy;
+    }
+
+    unsigned int nCopy = std::min<size_t>(nBytes, nRecvPacketLen - nRecvPacketPos);
+    if (vRecvPacket.size() < nRecvPacketPos + nCopy) {
+        // Allocate up to 256 KiB ahead, but never more than the whole packet.
+        vRecvPacket.resize(std::min(nRecvPacketLen, nRecvPacketPos + nCopy + 256 * 1024));
+    }
+    memcpy(&vRecvPacket[nRecvPacketPos], pch, nCopy);
+    nRecvPacketPos += nCopy;
+    if (nRecvPacketPos < nRecvPacketLen)
+        return nCopy;
+
+    // The packet is complete.
+    nRecvLengthPos = 0;
+    unsigned char* packet = (unsigned char*)vRecvPacket.data();
+    bool fIgnore = false;
+    bool fOk = fFirstPacket ?
+        cipher.Decrypt(packet, nRecvPacketLen, vRecvBuffer.data(), vRecvBuffer.size(), fIgnore, packet) :
+        cipher.Decrypt(packet, nRecvPacketLen, NULL, 0, fIgnore, packet);
+    if (!fOk)
+        return -1;
+    if (fFirstPacket) {
+        fFirstPacket = false;
+        std::vector<unsigned char>().swap(vRecvBuffer);
+    }
+
+    size_t nContentsLen = nRecvPacketLen - BIP324Cipher::HEADER_LEN - FSChaCha20Poly1305::EXPANSION;
+    const unsigned char* contents = packet + BIP324Cipher::HEADER_LEN;
+    // Decoys are dropped. The contents of the version packet are for future
+    // extensions, and messages with a one-byte type are ones we don't know.
+    bool fMessage = !fIgnore && recvState == RecvState::APP &&
+        nContentsLen >= 1 + CMessageHeader::COMMAND_SIZE && contents[0] == 0;
+    if (!fIgnore && recvState == RecvState::VERSION)
+        recvState = RecvState::APP;
+    if (!fMessage) {
+        pool.Release(vRecvPacket);
+        CSerializeData().swap(vRecvPacket);
+        return nCopy;
+    }
+
+    memcpy(messageCommand.data(), contents + 1, CMessageHeader::COMMAND_SIZE);
+    vRecvPacket.resize(BIP324Cipher::HEADER_LEN + nContentsLen);
+    vMessage.swap(vRecvPacket);
+    fHaveMessage = true;
+    return nCopy;
+}
+
+std::vector<unsigned char> CV2Transport::TakeV1Prefix()
+{
+    assert(recvState == RecvState::V1);
+    std::vector<unsigned char> vPrefix;
+    vPrefix.swap(vRecvBuffer);
+    return vPrefix;
+}
+
+bool CV2Transport::TakeMessage(std::array<char, CMessageHeader::COMMAND_SIZE>& command, CSerializeData& buffer, size_t& nPayloadStart)
+{
+    if (!fHaveMessage)
+        return false;
+    command = messageCommand;
+    buffer.swap(vMessage);
+    nPayloadStart = BIP324Cipher::HEADER_LEN + 1 + CMessageHeader::COMMAND_SIZE;
+    fHaveMessage = false;
+    return true;
+}
+
+void CV2Transport::QueueMessage(CSerializeData&& data)
+{
+    assert(sendState != SendState::READY && sendState != SendState::V1);
+    vSendPending.push_back(std::move(data));
+}
+
+void CV2Transport::EncryptMessage(const char* pchCommand, const unsigned char* payload, size_t nPayload, CSerializeData& out)
+{
+    assert(sendState == SendState::READY);
+    // A zero byte says a 12-byte command follows.
+    unsigned char type[1 + CMessageHeader::COMMAND_SIZE];
+    type[0] = 0;
+    memcpy(type + 1, pchCommand, CMessageHeader::COMMAND_SIZE);
+    out.resize(BIP324Cipher::EXPANSION + sizeof(type) + nPayload);
+    cipher.Encrypt(type, sizeof(type), payload, nPayload, NULL, 0, false, (unsigned char*)out.data());
+}
+
+void CV2Transport::AdvanceHandshake(std::vector<CSerializeData>& vSend)
+{
+    fAdvance = false;
+
+    if (recvState == RecvState::V1) {
+        // Whatever waited is sent as it is.
+        sendState = SendState::V1;
+        for (CSerializeData& data : vSendPending)
+            vSend.push_back(std::move(data));
+        vSendPending.clear();
+        return;
+    }
+
+    if (sendState == SendState::AWAITING_KEY) {
+        CSerializeData data(cipher.GetOurPubKey().begin(), cipher.GetOurPubKey().end());
+        data.insert(data.end(), vSendGarbage.begin(), vSendGarbage.end());
+        vSend.push_back(std::move(data));
+        sendState = SendState::KEY_SENT;
+    }
+
+    if (recvState == RecvState::KEY_RECEIVED) {
+        cipher.Initialize(EllSwiftPubKey(vRecvBuffer.data()), pchMessageStart, fInitiator);
+        vRecvBuffer.clear();
+        recvState = RecvState::GARB_GARBTERM;
+
+        // Our garbage terminator, then an empty version packet, which
+        // authenticates our garbage.
+        const unsigned char* terminator = cipher.GetSendGarbageTerminator();
+        CSerializeData data(terminator, terminator + BIP324Cipher::GARBAGE_TERMINATOR_LEN);
+        data.resize(BIP324Cipher::GARBAGE_TERMINATOR_LEN + BIP324Cipher::EXPANSION);
+        cipher.Encrypt(NULL, 0, NULL, 0, vSendGarbage.data(), vSendGarbage.size(), false,
+                       (unsigned char*)&data[BIP324Cipher::GARBAGE_TERMINATOR_LEN]);
+        vSend.push_back(std::move(data));
+        std::vector<unsigned char>().swap(vSendGarbage);
+        sendState = SendState::READY;
+
+        for (const CSerializeData& pending : vSendPending) {
+            CSerializeData packet;
+            EncryptMessage(&pending[CMessageHeader::MESSAGE_START_SIZE],
+                           (const unsigned char*)pending.data() + CMessageHeader::HEADER_SIZE,
+                           pending.size() - CMessageHeader::HEADER_SIZE, packet);
+            vSend.push_back(std::move(packet));
+        }
+        vSendPending.clear();
+    }
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_V2TRANSPORT_H
+#define BITCOIN_V2TRANSPORT_H
+
+#include "bip324.h"
+#include "netbufferpool.h"
+#include "protocol.h"
+#include "serialize.h"
+
+#include <array>
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * The v2 transport of BIP 324 for one connection, which encrypts and
+ * authenticates every message in place of the v1 checksum.
+ *
+ * The side that connects sends its public key and some garbage, and the other
+ * answers with the same, unless the first bytes it receives are a v1 version
+ * message, in which case the connection carries on as v1. Once a side has the
+ * other's key it sends its garbage terminator and a version packet; from then
+ * on messages are sent as encrypted packets. Messages to send before then wait.
+ *
+ * The receive side is used under the node's cs_vRecvMsg and the send side
+ * under its cs_vSend. AdvanceHandshake, which moves the send side on after
+ * something was received, needs both.
+ */
+class CV2Transport
+{
+public:
+    /** Most garbage either side sends before its garbage terminator. */
+    static constexpr size_t MAX_GARBAGE_LEN = 4095;
+    /** Bytes the version message of a v1 peer starts with: the network magic and "version". */
+    static constexpr size_t V1_PREFIX_LEN = CMessageHeader::MESSAGE_START_SIZE + CMessageHeader::COMMAND_SIZE;
+
+private:
+    enum class RecvState {
+        MAYBE_V1,       //!< Responder only: the first bytes may be a v1 version message.
+        KEY,            //!< Receiving the peer's public key.
+        KEY_RECEIVED,   //!< Waiting for AdvanceHandshake to derive the ciphers.
+        GARB_GARBTERM,  //!< Receiving garbage until its terminator.
+        VERSION,        //!< Receiving packets until the version packet.
+        APP,            //!< Receiving message packets.
+        V1,             //!< The peer speaks v1.
+    };
+    enum class SendState {
+        AWAITING_KEY,   //!< Nothing sent yet.
+        KEY_SENT,       //!< Our key and garbage are sent.
+        READY,          //!< Our version packet is sent, so messages can be.
+        V1,             //!< Messages are sent as v1.
+    };
+
+    const bool fInitiator;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    const size_t nMaxMessageSize;
+    BIP324Cipher cipher;
+
+    // Receive side.
+    RecvState recvState;
+    //! Whether AdvanceHandshake has something to do.
+    bool fAdvance = false;
+    //! The v1 prefix, the key or the garbage received so far.
+    std::vector<unsigned char> vRecvBuffer;
+    //! Whether the next packet is the first, which authenticates the garbage.
+    bool fFirstPacket = true;
+    unsigned char recvLength[BIP324Cipher::LENGTH_LEN];
+    size_t nRecvLengthPos = 0;
+    //! The packet being received, after its length, and how much has been.
+    CSerializeData vRecvPacket;
+    size_t nRecvPacketLen = 0;
+    size_t nRecvPacketPos = 0;
+    //! A received message waiting for TakeMessage.
+    bool fHaveMessage = false;
+    std::array<char, CMessageHeader::COMMAND_SIZE> messageCommand;
+    CSerializeData vMessage;
+
+    // Send side.
+    SendState sendState = SendState::AWAITING_KEY;
+    std::vector<unsigned char> vSendGarbage;
+    //! Messages, framed as v1, waiting for the handshake.
+    std::deque<CSerializeData> vSendPending;
+
+    int ReceivePacket(const char* pch, unsigned int nBytes, CRecvBufferPool& pool);
+
+public:
+    /** Start a connection with a fresh ephemeral key. */
+    CV2Transport(bool fInitiatorIn, const CMessageHeader::MessageStartChars& pchMessageStartIn, size_t nMaxMessageSizeIn);
+
+    /** Start a connection with the given key, key encoding and garbage, for tests. */
+    CV2Transport(bool fInitiatorIn, const CMessageHeader::MessageStartChars& pchMessageStartIn, size_t nMaxMessageSizeIn,
+                 const CKey& key, const EllSwiftPubKey& pubkey, std::vector<unsigned char> vGarbage);
+
+    // Receive side.
+
+    /**
+     * Take in bytes from the peer. Returns how many were used, which may be
+     * fewer than given: the rest should be given again after a message is
+     * taken or AdvanceHandshake is called. Returns -1 if the peer broke the
+     * protocol.
+     */
+    int ReceiveBytes(const char* pch, unsigned int nBytes, CRecvBufferPool& pool);
+
+    /** Whether AdvanceHandshake must be called before more bytes are received. */
+    bool NeedsAdvance() const { return fAdvance; }
+
+    /** Whether the peer turned out to speak v1. */
+    bool IsV1() const { return recvState == RecvState::V1; }
+
+    /** The bytes a v1 peer sent while we looked for a v2 one, which it is up to the caller to handle. */
+    std::vector<unsigned char> TakeV1Prefix();
+
+    /**
+     * Take the next received message, if there is one: its command, and a
+     * buffer whose bytes from nPayloadStart on are its payload.
+     */
+    bool TakeMessage(std::array<char, CMessageHeader::COMMAND_SIZE>& command, CSerializeData& buffer, size_t& nPayloadStart);
+
+    // Send side.
+
+    /** Whether messages are encrypted with EncryptMessage rather than waiting. */
+    bool IsSendReady() const { return sendState == SendState::READY; }
+
+    /** Whether messages are sent as v1. */
+    bool IsSendV1() const { return sendState == SendState::V1; }
+
+    /** The session ID both sides derived, once IsSendReady. */
+    const uint256& GetSessionId() const { return cipher.GetSessionId(); }
+
+    /** Keep a v1-framed message to send once the handshake lets us. */
+    void QueueMessage(CSerializeData&& data);
+
+    /** Encrypt a message with the given 12-byte command into a packet. */
+    void EncryptMessage(const char* pchCommand, const unsigned char* payload, size_t nPayload, CSerializeData& out);
+
+    /** Append what the handshake has us send now to vSend. Requires both locks. */
+    void AdvanceHandshake(std::vector<CSerializeData>& vSend);
+};
+
+#endif // BITCOIN_V2TRANSPORT_H
@@ -0,0 +1,134 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "validation_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+const int64_t LatencyHistogram::BUCKET_BOUNDS[LatencyHistogram::BUCKETS - 1] = {
+    100, 250, 500,
+    1000, 2500, 5000,
+    10000, 25000, 50000,
+    100000, 250000, 500000,
+    1000000, 2500000, 5000000,
+    10000000, 20000000, 30000000, 60000000,
+};
+
+LatencyHistogram::LatencyHistogram() : nSumMicros(0), nMaxMicros(0)
+{
+    for (auto& bucket : buckets) {
+        bucket = 0;
+    }
+}
+
+void LatencyHistogram::Record(int64_t nMicros)
+{
+    nMicros = std::max<int64_t>(nMicros, 0);
+    size_t i = std::upper_bound(std::begin(BUCKET_BOUNDS), std::end(BUCKET_BOUNDS), nMicros - 1) - std::begin(BUCKET_BOUNDS);
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    nSumMicros.fetch_add(nMicros, std::memory_order_relaxed);
+
+    int64_t nMax = nMaxMicros.load(std::memory_order_relaxed);
+    while (nMicros > nMax && !nMaxMicros.compare_exchange_weak(nMax, nMicros, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.nCount = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        snapshot.nCount += snapshot.buckets[i];
+    }
+    snapshot.nSumMicros = nSumMicros.load(std::memory_order_relaxed);
+    snapshot.nMaxMicros = nMaxMicros.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+int64_t LatencyHistogram::Snapshot::Percentile(double q) const
+{
+    if (nCount == 0) return 0;
+    uint64_t nRank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * nCount));
+    uint64_t nSeen = 0;
+    for (size_t i = 0; i < BUCKETS - 1; i++) {
+        nSeen += buckets[i];
+        if (nSeen >= nRank) return std::min(BUCKET_BOUNDS[i], nMaxMicros);
+    }
+    return nMaxMicros;
+}
+
+static LatencyHistogram validationPhases[VALIDATION_PHASE_COUNT];
+
+const char* ValidationPhaseName(ValidationPhase phase)
+{
+    switch (phase) {
+    case VALIDATION_PHASE_READ: return "read";
+    case VALIDATION_PHASE_PREFETCH: return "prefetch";
+    case VALIDATION_PHASE_INPUTS: return "inputs";
+    case VALIDATION_PHASE_SCRIPTS: return "scriptwait";
+    case VALIDATION_PHASE_SAPLING: return "sapling";
+    case VALIDATION_PHASE_ORCHARD: return "orchard";
+    case VALIDATION_PHASE_UNDO: return "undo";
+    case VALIDATION_PHASE_FLUSH: return "flush";
+    case VALIDATION_PHASE_CHAINSTATE: return "chainstate";
+    case VALIDATION_PHASE_CALLBACKS: return "callbacks";
+    case VALIDATION_PHASE_TOTAL: return "total";
+    case VALIDATION_PHASE_COUNT: break;
+    }
+    return "unknown";
+}
+
+void RecordValidationPhase(ValidationPhase phase, int64_t nMicros)
+{
+    validationPhases[phase].Record(nMicros);
+}
+
+LatencyHistogram::Snapshot GetValidationPhaseStats(ValidationPhase phase)
+{
+    return validationPhases[phase].GetSnapshot();
+}
+
+static std::atomic<uint64_t> verifiedItems[VERIFICATION_WORK_COUNT];
+static std::atomic<int64_t> verifiedMicros[VERIFICATION_WORK_COUNT];
+static std::atomic<uint64_t> skippedItems[VERIFICATION_WORK_COUNT];
+static std::atomic<int64_t> skippedMicros[VERIFICATION_WORK_COUNT];
+
+const char* VerificationWorkName(VerificationWork kind)
+{
+    switch (kind) {
+    case VERIFICATION_WORK_SCRIPTS: return "scripts";
+    case VERIFICATION_WORK_SAPLING: return "sapling";
+    case VERIFICATION_WORK_ORCHARD: return "orchard";
+    case VERIFICATION_WORK_COUNT: break;
+    }
+    return "unknown";
+}
+
+void RecordVerifiedWork(VerificationWork kind, uint64_t nItems, int64_t nMicros)
+{
+    if (nItems == 0) return;
+    verifiedItems[kind].fetch_add(nItems, std::memory_order_relaxed);
+    verifiedMicros[kind].fetch_add(std::max<int64_t>(nMicros, 0), std::memory_order_relaxed);
+}
+
+int64_t RecordSkippedWork(VerificationWork kind, uint64_t nItems)
+{
+    if (nItems == 0) return 0;
+    uint64_t nVerified = verifiedItems[kind].load(std::memory_order_relaxed);
+    int64_t nSaved = nVerified == 0 ? 0 :
+        (int64_t)((double)verifiedMicros[kind].load(std::memory_order_relaxed) * nItems / nVerified);
+    skippedItems[kind].fetch_add(nItems, std::memory_order_relaxed);
+    skippedMicros[kind].fetch_add(nSaved, std::memory_order_relaxed);
+    return nSaved;
+}
+
+SkippedWorkStats GetSkippedWorkStats(VerificationWork kind)
+{
+    SkippedWorkStats stats;
+    stats.nItems = skippedItems[kind].load(std::memory_order_relaxed);
+    stats.nEstimatedMicros = skippedMicros[kind].load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_VALIDATION_STATS_H
+#define BITCOIN_VALIDATION_STATS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Parts of connecting a block to the tip that are timed (see getvalidationstats) */
+enum ValidationPhase {
+    VALIDATION_PHASE_READ,        //!< Reading the block from disk
+    VALIDATION_PHASE_PREFETCH,    //!< Prefetching the block's inputs into the coins cache
+    VALIDATION_PHASE_INPUTS,      //!< Fetching transparent and shielded inputs from the coins view
+    VALIDATION_PHASE_SCRIPTS,     //!< Waiting for the script check queue
+    VALIDATION_PHASE_SAPLING,     //!< Sapling batch validation, which may overlap the script checks
+    VALIDATION_PHASE_ORCHARD,     //!< Orchard batch validation, which may overlap the script checks
+    VALIDATION_PHASE_UNDO,        //!< Writing undo data
+    VALIDATION_PHASE_FLUSH,       //!< Flushing the block's coins view into the tip
+    VALIDATION_PHASE_CHAINSTATE,  //!< Writing the chainstate to disk, if needed
+    VALIDATION_PHASE_CALLBACKS,   //!< Mempool updates and tip-update callbacks
+    VALIDATION_PHASE_TOTAL,       //!< The whole block, from reading it to the new tip
+    VALIDATION_PHASE_COUNT
+};
+
+/** Name of a phase as used by getvalidationstats */
+const char* ValidationPhaseName(ValidationPhase phase);
+
+/**
+ * Latency histogram with fixed, roughly logarithmic buckets from 0.1ms to
+ * 60s. Recording is lock-free, so it can stay enabled on every block;
+ * percentiles are estimated as the upper bound of the bucket they fall in.
+ */
+class LatencyHistogram
+{
+public:
+    static const size_t BUCKETS = 20;
+    /** Upper bound of each bucket in microseconds; the last one is unbounded */
+    static const int64_t BUCKET_BOUNDS[BUCKETS - 1];
+
+    LatencyHistogram();
+
+    void Record(int64_t nMicros);
+
+    struct Snapshot {
+        uint64_t nCount;
+        int64_t nSumMicros;
+        int64_t nMaxMicros;
+        uint64_t buckets[BUCKETS];
+
+        /** Estimated latency in microseconds at quantile q in [0, 1], 0 if empty */
+        int64_t Percentile(double q) const;
+    };
+    Snapshot GetSnapshot() const;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<int64_t> nSumMicros;
+    std::atomic<int64_t> nMaxMicros;
+};
+
+/** Record how long a phase took for a block connected to the tip */
+void RecordValidationPhase(ValidationPhase phase, int64_t nMicros);
+
+/** Get the histogram of a phase */
+LatencyHistogram::Snapshot GetValidationPhaseStats(ValidationPhase phase);
+
+/** Kinds of verification that -assumevalid skips */
+enum VerificationWork {
+    VERIFICATION_WORK_SCRIPTS,    //!< Transparent inputs whose scripts are checked
+    VERIFICATION_WORK_SAPLING,    //!< Transactions with a Sapling bundle
+    VERIFICATION_WORK_ORCHARD,    //!< Transactions with an Orchard bundle
+    VERIFICATION_WORK_COUNT
+};
+
+/** Name of a kind of verification as used by getvalidationstats */
+const char* VerificationWorkName(VerificationWork kind);
+
+/** Record that a checked block verified nItems of a kind in nMicros of wall-clock time */
+void RecordVerifiedWork(VerificationWork kind, uint64_t nItems, int64_t nMicros);
+
+/**
+ * Record that an assumed-valid block skipped nItems of a kind, and return
+ * the wall-clock time this is estimated to have saved, based on the average
+ * cost of that kind in checked blocks so far (0 if none were checked).
+ */
+int64_t RecordSkippedWork(VerificationWork kind, uint64_t nItems);
+
+struct SkippedWorkStats {
+    uint64_t nItems;
+    int64_t nEstimatedMicros;
+};
+
+/** Get the totals skipped for a kind of verification */
+SkippedWorkStats GetSkippedWorkStats(VerificationWork kind);
+
+#endif // BITCOIN_VALIDATION_STATS_H
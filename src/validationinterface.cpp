@@ -14,7 +14,12 @@
 
 #include <boost/thread.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <thread>
 
 #include <rust/metrics.h>
@@ -24,14 +29,156 @@ using namespace boost::placeholders;
 static CMainSignals g_signals;
 
 static constexpr const char* METRIC_WALLET_SYNCED_HEIGHT = "zcashd.wallet.synced.block.height";
+static constexpr const char* METRIC_WALLET_MEMPOOL_BATCH = "zcashd.wallet.mempool.batch.transactions";
+static constexpr const char* METRIC_WALLET_MEMPOOL_BACKLOG = "zcashd.wallet.mempool.backlog.transactions";
+
+static constexpr const char* METRIC_VALIDATION_CALLBACK_BACKLOG = "zcashd.validation.callbacks.backlog";
+
+static std::atomic<int> nWalletNotifiedHeight{-1};
+
+namespace {
+
+struct QueuedValidationCallback {
+    std::string strSubscriber;
+    std::function<void()> func;
+    int64_t nQueuedMicros;
+};
+
+std::mutex cs_validationCallbacks;
+std::condition_variable cvValidationCallbacks;
+//! The following are guarded by cs_validationCallbacks.
+std::deque<QueuedValidationCallback> queueValidationCallbacks;
+std::map<std::string, ValidationCallbackStats> mapValidationCallbackStats;
+bool fValidationCallbackThreadRunning = false;
+bool fStopValidationCallbackThread = false;
+bool fRunningValidationCallback = false;
+std::thread validationCallbackThread;
+std::thread::id validationCallbackThreadId;
+
+//! The UpdatedBlockTip connection of each registered interface. Guarded by cs_updatedBlockTipConnections.
+std::mutex cs_updatedBlockTipConnections;
+std::map<CValidationInterface*, std::pair<boost::signals2::connection, bool>> mapUpdatedBlockTipConnections;
+
+void ThreadValidationCallbacks()
+{
+    std::unique_lock<std::mutex> lock(cs_validationCallbacks);
+    while (true) {
+        cvValidationCallbacks.wait(lock, [] { return !queueValidationCallbacks.empty() || fStopValidationCallbackThread; });
+        if (queueValidationCallbacks.empty())
+            return;
+
+        QueuedValidationCallback callback = std::move(queueValidationCallbacks.front());
+        queueValidationCallbacks.pop_front();
+        fRunningValidationCallback = true;
+        lock.unlock();
+
+        int64_t nStart = GetTimeMicros();
+        try {
+            callback.func();
+        } catch (const std::exception& e) {
+            PrintExceptionContinue(&e, "ThreadValidationCallbacks()");
+        } catch (...) {
+            PrintExceptionContinue(NULL, "ThreadValidationCallbacks()");
+        }
+        int64_t nEnd = GetTimeMicros();
+
+        lock.lock();
+        ValidationCallbackStats& stats = mapValidationCallbackStats[callback.strSubscriber];
+        stats.nRun++;
+        stats.nBacklog--;
+        stats.nRunMicros += nEnd - nStart;
+        stats.nMaxDelayMicros = std::max(stats.nMaxDelayMicros, nStart - callback.nQueuedMicros);
+        fRunningValidationCallback = false;
+        MetricsGauge(METRIC_VALIDATION_CALLBACK_BACKLOG, queueValidationCallbacks.size());
+        cvValidationCallbacks.notify_all();
+    }
+}
+
+} // anon namespace
+
+void StartValidationCallbackThread()
+{
+    std::lock_guard<std::mutex> lock(cs_validationCallbacks);
+    if (fValidationCallbackThreadRunning)
+        return;
+    fStopValidationCallbackThread = false;
+    fValidationCallbackThreadRunning = true;
+    validationCallbackThread = std::thread(&TraceThread<void (*)()>, "valcallbacks", &ThreadValidationCallbacks);
+    validationCallbackThreadId = validationCallbackThread.get_id();
+}
+
+void StopValidationCallbackThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_validationCallbacks);
+        if (!fValidationCallbackThreadRunning)
+            return;
+        fStopValidationCallbackThread = true;
+    }
+    cvValidationCallbacks.notify_all();
+    validationCallbackThread.join();
+    std::lock_guard<std::mutex> lock(cs_validationCallbacks);
+    fValidationCallbackThreadRunning = false;
+}
+
+void QueueValidationCallback(const std::string& strSubscriber, std::function<void()> func)
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_validationCallbacks);
+        if (fValidationCallbackThreadRunning && !fStopValidationCallbackThread) {
+            ValidationCallbackStats& stats = mapValidationCallbackStats[strSubscriber];
+            stats.strSubscriber = strSubscriber;
+            stats.nQueued++;
+            stats.nBacklog++;
+            stats.nMaxBacklog = std::max(stats.nMaxBacklog, stats.nBacklog);
+            queueValidationCallbacks.push_back({strSubscriber, std::move(func), GetTimeMicros()});
+            cvValidationCallbacks.notify_all();
+            return;
+        }
+    }
+    func();
+}
+
+void SyncWithValidationCallbackQueue()
+{
+    std::unique_lock<std::mutex> lock(cs_validationCallbacks);
+    if (!fValidationCallbackThreadRunning || std::this_thread::get_id() == validationCallbackThreadId)
+        return;
+    cvValidationCallbacks.wait(lock, [] { return queueValidationCallbacks.empty() && !fRunningValidationCallback; });
+}
+
+std::vector<ValidationCallbackStats> GetValidationCallbackStats()
+{
+    std::vector<ValidationCallbackStats> result;
+    std::lock_guard<std::mutex> lock(cs_validationCallbacks);
+    for (const auto& entry : mapValidationCallbackStats)
+        result.push_back(entry.second);
+    return result;
+}
 
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+int GetWalletNotifiedHeight()
+{
+    return nWalletNotifiedHeight;
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName, bool fSynchronous) {
+    boost::signals2::connection updatedBlockTip;
+    if (fSynchronous) {
+        updatedBlockTip = g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+    } else {
+        updatedBlockTip = g_signals.UpdatedBlockTip.connect([pwalletIn, strName](const CBlockIndex *pindex) {
+            QueueValidationCallback(strName, [pwalletIn, pindex] { pwalletIn->UpdatedBlockTip(pindex); });
+        });
+    }
+    {
+        std::lock_guard<std::mutex> lock(cs_updatedBlockTipConnections);
+        mapUpdatedBlockTipConnections[pwalletIn] = std::make_pair(updatedBlockTip, fSynchronous);
+    }
     g_signals.GetBatchScanner.connect(boost::bind(&CValidationInterface::GetBatchScanner, pwalletIn));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
     g_signals.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
@@ -51,7 +198,19 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.EraseTransaction.disconnect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
     g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
     g_signals.GetBatchScanner.disconnect(boost::bind(&CValidationInterface::GetBatchScanner, pwalletIn));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
+    bool fSynchronous = true;
+    {
+        std::lock_guard<std::mutex> lock(cs_updatedBlockTipConnections);
+        auto it = mapUpdatedBlockTipConnections.find(pwalletIn);
+        if (it != mapUpdatedBlockTipConnections.end()) {
+            it->second.first.disconnect();
+            fSynchronous = it->second.second;
+            mapUpdatedBlockTipConnections.erase(it);
+        }
+    }
+    // Nothing queued for it may run once it is gone.
+    if (!fSynchronous)
+        SyncWithValidationCallbackQueue();
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -64,6 +223,11 @@ void UnregisterAllValidationInterfaces() {
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.GetBatchScanner.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
+    {
+        std::lock_guard<std::mutex> lock(cs_updatedBlockTipConnections);
+        mapUpdatedBlockTipConnections.clear();
+    }
+    SyncWithValidationCallbackQueue();
 }
 
 void AddTxToBatches(
@@ -98,16 +262,22 @@ void SyncWithWallets(
     g_signals.SyncTransaction(tx, pblock, nHeight);
 }
 
+// The most mempool transactions handed to wallets in one notification cycle.
+// Any more are left in the mempool's queue for the following cycles, so that
+// a burst of transactions cannot hold up block notifications or have all of
+// its copies in flight at once.
+static const size_t MAX_NOTIFY_RECENTLY_ADDED = 5000;
+
 struct CachedBlockData {
     CBlockIndex *pindex;
     MerkleFrontiers oldTrees;
-    std::list<CTransaction> txConflicted;
+    std::vector<std::shared_ptr<const CTransaction>> txConflicted;
 
     CachedBlockData(
         CBlockIndex *pindex,
         MerkleFrontiers oldTrees,
-        std::list<CTransaction> txConflicted):
-        pindex(pindex), oldTrees(oldTrees), txConflicted(txConflicted) {}
+        std::vector<std::shared_ptr<const CTransaction>> txConflicted):
+        pindex(pindex), oldTrees(oldTrees), txConflicted(std::move(txConflicted)) {}
 };
 
 void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
@@ -122,6 +292,7 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
         }
         MilliSleep(50);
     }
+    nWalletNotifiedHeight = pindexLastTip->nHeight;
 
     while (true) {
         // Run the notifier on an integer second in the steady clock.
@@ -149,7 +320,7 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
         // the ConnectBlock() call that generated this sequence number.
         std::optional<uint64_t> chainNotifiedSequence;
         // Transactions that have been recently added to the mempool.
-        std::pair<std::vector<CTransaction>, uint64_t> recentlyAdded;
+        std::pair<std::vector<std::shared_ptr<const CTransaction>>, uint64_t> recentlyAdded;
 
         {
             LOCK(cs_main);
@@ -207,7 +378,7 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
                 blockStack.emplace_back(
                     pindex,
                     oldFrontiers,
-                    recentlyConflicted.first);
+                    std::move(recentlyConflicted.first));
 
                 chainNotifiedSequence = recentlyConflicted.second;
 
@@ -229,7 +400,12 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
                 chainNotifiedSequence = GetChainConnectedSequence();
             }
             if (chainNotifiedSequence.has_value()) {
-                recentlyAdded = mempool.DrainRecentlyAdded();
+                recentlyAdded = mempool.DrainRecentlyAdded(MAX_NOTIFY_RECENTLY_ADDED);
+
+                // Report how many mempool transactions this cycle takes, and
+                // how many are held back for later cycles by the bound above.
+                MetricsGauge(METRIC_WALLET_MEMPOOL_BATCH, recentlyAdded.first.size());
+                MetricsGauge(METRIC_WALLET_MEMPOOL_BACKLOG, mempool.RecentlyAddedBacklog());
             }
         }
 
@@ -343,10 +519,10 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
             }
 
             // Batch transactions that went from mempool to conflicted:
-            for (const CTransaction &tx : blockData.txConflicted) {
+            for (const auto& ptx : blockData.txConflicted) {
                 AddTxToBatches(
                     batchScanners,
-                    tx,
+                    *ptx,
                     blockData.pindex->GetBlockHash(),
                     blockData.pindex->nHeight + 1);
             }
@@ -436,8 +612,8 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
             // than they are required, and will sit in memory for a bit longer.
             // The ZIP 401 mempool limits are around 80MB, which is well below
             // the limits we are concerned with here.
-            for (auto& tx : recentlyAdded.first) {
-                AddTxToBatches(batchScanners, tx, uint256(), pindexLastTip->nHeight + 1);
+            for (const auto& ptx : recentlyAdded.first) {
+                AddTxToBatches(batchScanners, *ptx, uint256(), pindexLastTip->nHeight + 1);
             }
         }
 
@@ -482,6 +658,7 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
             // On to the next block!
             pindexLastTip = pindexLastTip->pprev;
             MetricsGauge(METRIC_WALLET_SYNCED_HEIGHT, pindexLastTip->nHeight);
+            nWalletNotifiedHeight = pindexLastTip->nHeight;
         }
 
         // Notify block connections
@@ -536,8 +713,8 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
 
                 // Tell wallet about transactions that went from mempool
                 // to conflicted:
-                for (const CTransaction &tx : blockData.txConflicted) {
-                    SyncWithWallets(batchScanners, tx, NULL, blockData.pindex->nHeight + 1);
+                for (const auto& ptx : blockData.txConflicted) {
+                    SyncWithWallets(batchScanners, *ptx, NULL, blockData.pindex->nHeight + 1);
                 }
                 // ... and about transactions that got confirmed:
                 for (const CTransaction &tx : block.vtx) {
@@ -558,15 +735,16 @@ void ThreadNotifyWallets(CBlockIndex *pindexLastTip)
                 // This block is done!
                 pindexLastTip = blockData.pindex;
                 MetricsGauge(METRIC_WALLET_SYNCED_HEIGHT, pindexLastTip->nHeight);
+                nWalletNotifiedHeight = pindexLastTip->nHeight;
                 assert(blockStack.rbegin() != blockStackScanned);
                 blockStack.pop_back();
             }
         }
 
         // Notify transactions in the mempool
-        for (auto& tx : recentlyAdded.first) {
+        for (const auto& ptx : recentlyAdded.first) {
             try {
-                SyncWithWallets(batchScanners, tx, NULL, pindexLastTip->nHeight + 1);
+                SyncWithWallets(batchScanners, *ptx, NULL, pindexLastTip->nHeight + 1);
             } catch (const boost::thread_interrupted&) {
                 throw;
             } catch (const std::exception& e) {
@@ -7,7 +7,10 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include <functional>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
@@ -75,8 +78,12 @@ struct MerkleFrontiers {
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. UpdatedBlockTip is queued
+ * for it (see QueueValidationCallback) under strName, unless fSynchronous is
+ * set; the other notifications are delivered as before.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName = "validationinterface", bool fSynchronous = false);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -166,6 +173,42 @@ struct CMainSignals {
 
 CMainSignals& GetMainSignals();
 
+/**
+ * Notifications that listeners do not need before validation moves on are run
+ * in the order they were queued, on a thread of their own, so that a slow
+ * listener does not add to the time it takes to connect a block. Until the
+ * thread is started they run in the caller.
+ */
+void StartValidationCallbackThread();
+/** Run the callbacks queued so far and stop the thread. */
+void StopValidationCallbackThread();
+/** Queue func to run on the validation callback thread on behalf of strSubscriber. */
+void QueueValidationCallback(const std::string& strSubscriber, std::function<void()> func);
+/** Wait until every callback queued so far has run. */
+void SyncWithValidationCallbackQueue();
+
+struct ValidationCallbackStats {
+    std::string strSubscriber;
+    uint64_t nQueued = 0;
+    uint64_t nRun = 0;
+    //! Callbacks queued but not run yet, and the most there have been.
+    size_t nBacklog = 0;
+    size_t nMaxBacklog = 0;
+    //! Time spent in the callbacks, and the longest a callback waited to run.
+    int64_t nRunMicros = 0;
+    int64_t nMaxDelayMicros = 0;
+};
+
+/** Per-subscriber statistics of the validation callback queue, by subscriber name. */
+std::vector<ValidationCallbackStats> GetValidationCallbackStats();
+
 void ThreadNotifyWallets(CBlockIndex *pindexLastTip);
 
+/**
+ * Returns the height of the last block that ThreadNotifyWallets has finished
+ * notifying wallets of, or -1 if it has not started. Validation does not wait
+ * for the wallets, so this may trail the active chain.
+ */
+int GetWalletNotifiedHeight();
+
 #endif // BITCOIN_VALIDATIONINTERFACE_H
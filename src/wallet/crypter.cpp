@@ -242,6 +242,8 @@ bool CCryptoKeyStore::Lock()
         if (!SetCrypted())
             return false;
         vMasterKey.clear();
+        mapUnlockedKeys.clear();
+        unlockedMnemonicSeed.reset();
     }
 
     NotifyStatusChanged(this);
@@ -398,9 +400,10 @@ std::optional<MnemonicSeed> CCryptoKeyStore::GetMnemonicSeed() const
     if (fUseCrypto) {
         if (cryptedMnemonicSeed.second.empty()) {
             return std::nullopt;
-        } else {
-            return DecryptMnemonicSeed(vMasterKey, cryptedMnemonicSeed.second, cryptedMnemonicSeed.first);
+        } else if (!unlockedMnemonicSeed.has_value()) {
+            unlockedMnemonicSeed = DecryptMnemonicSeed(vMasterKey, cryptedMnemonicSeed.second, cryptedMnemonicSeed.first);
         }
+        return unlockedMnemonicSeed;
     } else {
         return CBasicKeyStore::GetMnemonicSeed();
     }
@@ -505,9 +508,17 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end())
     {
+        auto unlocked = mapUnlockedKeys.find(address);
+        if (unlocked != mapUnlockedKeys.end()) {
+            keyOut = unlocked->second;
+            return true;
+        }
         const CPubKey &vchPubKey = (*mi).second.first;
         const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-        return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+        if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut))
+            return false;
+        mapUnlockedKeys.emplace(address, keyOut);
+        return true;
     }
     return false;
 }
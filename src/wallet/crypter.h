@@ -147,6 +147,13 @@ private:
     //! keeps track of whether Unlock has run a thorough check before
     bool fDecryptionThoroughlyChecked;
 
+    //! Keys and the mnemonic seed decrypted since the wallet was unlocked.
+    //! Decrypting a key also checks it against its public key, which costs
+    //! about as much as a signature, so each is decrypted once per unlock.
+    //! Their secrets are held in locked memory, and Lock() drops them.
+    mutable std::map<CKeyID, CKey> mapUnlockedKeys;
+    mutable std::optional<MnemonicSeed> unlockedMnemonicSeed;
+
 protected:
     bool SetCrypted();
 
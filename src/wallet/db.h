@@ -138,7 +138,8 @@ protected:
 
             // Unserialize value
             try {
-                CDataStream ssValue((char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size(), SER_DISK, CLIENT_VERSION);
+                // Read in place, so that no other copy of the value is made.
+                CSpanReader ssValue(SER_DISK, CLIENT_VERSION, (char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size());
                 ssValue >> value;
             } catch (const std::exception&) {
                 return false;
@@ -152,6 +152,20 @@ TEST(TransactionBuilder, OrchardToOrchard) {
     EXPECT_TRUE(ContextualCheckTransaction(tx, state, Params(), 3, true));
     EXPECT_EQ(state.GetRejectReason(), "");
 
+    // The spend reveals the nullifier of our note, which a single check over
+    // all of the transaction's nullifiers finds. The dummy spends of the
+    // receiving transaction are not ours.
+    std::vector<std::array<uint8_t, 32>> nullifiers;
+    EXPECT_FALSE(wallet.AnyNullifierFromMe(nullifiers));
+    for (const auto& action : txRecv.GetOrchardBundle().GetDetails()->actions()) {
+        nullifiers.push_back(action.nullifier());
+    }
+    EXPECT_FALSE(wallet.AnyNullifierFromMe(nullifiers));
+    for (const auto& action : tx.GetOrchardBundle().GetDetails()->actions()) {
+        nullifiers.push_back(action.nullifier());
+    }
+    EXPECT_TRUE(wallet.AnyNullifierFromMe(nullifiers));
+
     // Revert to default
     RegtestDeactivateNU5();
 }
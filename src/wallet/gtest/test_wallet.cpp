@@ -1966,6 +1966,47 @@ TEST(WalletTests, SetBestChainIgnoresTxsWithoutShieldedData) {
     wallet.SetBestChain(walletdb, loc);
 }
 
+TEST(WalletTests, SetBestChainWritesUnwitnessedTxsOnce) {
+    SelectParams(CBaseChainParams::REGTEST);
+    TestWallet wallet(Params());
+    LOCK(wallet.cs_wallet);
+
+    MockWalletDB walletdb;
+    CBlockLocator loc;
+
+    auto sk = libzcash::SproutSpendingKey::random();
+    wallet.AddSproutSpendingKey(sk);
+
+    // A Sprout transaction whose note is not being witnessed
+    auto wtx = GetValidSproutReceive(sk, 10, true);
+    auto noteMap = wallet.FindMySproutNotes(wtx);
+    wtx.SetSproutNoteData(noteMap);
+    wallet.LoadWalletTx(wtx);
+
+    EXPECT_CALL(walletdb, TxnBegin())
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(walletdb, WriteOrchardWitnesses)
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(walletdb, WriteWitnessCacheSize(0))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(walletdb, WriteBestBlock(loc))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(walletdb, TxnCommit())
+        .WillRepeatedly(Return(true));
+
+    // The first flush writes it, later ones have nothing new to write.
+    EXPECT_CALL(walletdb, WriteTx(wtx))
+        .Times(1).WillOnce(Return(true));
+    wallet.SetBestChain(walletdb, loc);
+    wallet.SetBestChain(walletdb, loc);
+
+    // Adding it to the wallet again means it may have changed.
+    wallet.LoadWalletTx(wtx);
+    EXPECT_CALL(walletdb, WriteTx(wtx))
+        .Times(1).WillOnce(Return(true));
+    wallet.SetBestChain(walletdb, loc);
+}
+
 TEST(WalletTests, UpdateSproutNullifierNoteMap) {
     SelectParams(CBaseChainParams::REGTEST);
     TestWallet wallet(Params());
@@ -2377,6 +2418,33 @@ TEST(WalletTests, SproutNoteLocking) {
     EXPECT_FALSE(wallet.IsLockedNote(jsoutpt2));
 }
 
+TEST(WalletTests, CachedBalancesLastUntilWalletChanges) {
+    SelectParams(CBaseChainParams::REGTEST);
+    TestWallet wallet(Params());
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    int calls = 0;
+    auto compute = [&]() {
+        calls++;
+        return std::vector<CAmount>{calls};
+    };
+
+    EXPECT_EQ(wallet.GetCachedBalances("a", compute)[0], 1);
+    EXPECT_EQ(wallet.GetCachedBalances("a", compute)[0], 1);
+    EXPECT_EQ(wallet.GetCachedBalances("b", compute)[0], 2);
+    EXPECT_EQ(calls, 2);
+
+    // Locking a coin changes what is spendable.
+    COutPoint outpt(uint256(), 0);
+    wallet.LockCoin(outpt);
+    EXPECT_EQ(wallet.GetCachedBalances("a", compute)[0], 3);
+
+    // So does any change to the mempool.
+    mempool.AddTransactionsUpdated(1);
+    EXPECT_EQ(wallet.GetCachedBalances("a", compute)[0], 4);
+    EXPECT_EQ(wallet.GetCachedBalances("a", compute)[0], 4);
+}
+
 TEST(WalletTests, SaplingNoteLocking) {
     SelectParams(CBaseChainParams::REGTEST);
     TestWallet wallet(Params());
@@ -2412,6 +2480,41 @@ TEST(WalletTests, SaplingNoteLocking) {
     EXPECT_FALSE(wallet.IsLockedNote(sop2));
 }
 
+TEST(WalletTests, OrchardNoteLocking) {
+    SelectParams(CBaseChainParams::REGTEST);
+    TestWallet wallet(Params());
+    LOCK(wallet.cs_wallet);
+
+    OrchardOutPoint oop1 {uint256(), 1};
+    OrchardOutPoint oop2 {uint256(), 2};
+
+    // Test selective locking
+    wallet.LockNote(oop1);
+    EXPECT_TRUE(wallet.IsLockedNote(oop1));
+    EXPECT_FALSE(wallet.IsLockedNote(oop2));
+
+    // Test selective unlocking
+    wallet.UnlockNote(oop1);
+    EXPECT_FALSE(wallet.IsLockedNote(oop1));
+
+    // Test multiple locking
+    wallet.LockNote(oop1);
+    wallet.LockNote(oop2);
+    EXPECT_TRUE(wallet.IsLockedNote(oop1));
+    EXPECT_TRUE(wallet.IsLockedNote(oop2));
+
+    // Test list
+    auto v = wallet.ListLockedOrchardNotes();
+    EXPECT_EQ(v.size(), 2);
+    EXPECT_TRUE(std::find(v.begin(), v.end(), oop1) != v.end());
+    EXPECT_TRUE(std::find(v.begin(), v.end(), oop2) != v.end());
+
+    // Test unlock all
+    wallet.UnlockAllOrchardNotes();
+    EXPECT_FALSE(wallet.IsLockedNote(oop1));
+    EXPECT_FALSE(wallet.IsLockedNote(oop2));
+}
+
 TEST(WalletTests, GenerateUnifiedAddress) {
     (void) RegtestActivateSapling();
     TestWallet wallet(Params());
@@ -2486,6 +2589,55 @@ TEST(WalletTests, GenerateUnifiedAddress) {
     RegtestDeactivateSapling();
 }
 
+TEST(WalletTests, GenerateUnifiedAddressesInOneBatch) {
+    (void) RegtestActivateSapling();
+    TestWallet wallet(Params());
+    wallet.GenerateNewSeed();
+
+    LOCK(wallet.cs_wallet);
+
+    auto batchResult = wallet.GenerateUnifiedAddresses(0, {ReceiverType::Orchard}, 3);
+    WalletUABatchGenerationResult expected = WalletUAGenerationError::NoSuchAccount;
+    EXPECT_EQ(batchResult, expected);
+
+    auto ufvkpair = wallet.GenerateNewUnifiedSpendingKey();
+    auto ufvk = ufvkpair.first;
+    auto account = ufvkpair.second;
+
+    // The batch takes the same diversifier indices that as many calls to
+    // GenerateUnifiedAddress would.
+    auto uaResult = wallet.GenerateUnifiedAddress(account, {ReceiverType::Orchard});
+    auto ua = std::get_if<std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>>(&uaResult);
+    ASSERT_NE(ua, nullptr);
+    auto j = ua->second;
+
+    batchResult = wallet.GenerateUnifiedAddresses(account, {ReceiverType::Orchard}, 3);
+    auto uas = std::get_if<std::vector<std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>>>(&batchResult);
+    ASSERT_NE(uas, nullptr);
+    ASSERT_EQ(uas->size(), 3);
+    for (const auto& [addr, index] : *uas) {
+        j = j.succ().value();
+        EXPECT_EQ(index, j);
+
+        auto orchardReceiver = addr.GetOrchardReceiver();
+        ASSERT_TRUE(orchardReceiver.has_value());
+        EXPECT_EQ(orchardReceiver.value(), ufvk.GetOrchardKey().value().ToIncomingViewingKey().Address(index));
+
+        // Each address is recognized as the wallet's.
+        auto u4r = wallet.FindUnifiedAddressByReceiver(orchardReceiver.value());
+        ASSERT_TRUE(u4r.has_value());
+        EXPECT_EQ(u4r.value(), addr);
+    }
+
+    uaResult = wallet.GenerateUnifiedAddress(account, {ReceiverType::Orchard});
+    ua = std::get_if<std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>>(&uaResult);
+    ASSERT_NE(ua, nullptr);
+    EXPECT_EQ(ua->second, j.succ().value());
+
+    // Revert to default
+    RegtestDeactivateSapling();
+}
+
 TEST(WalletTests, GenerateUnifiedSpendingKeyAddsOrchardAddresses) {
     (void) RegtestActivateSapling();
     TestWallet wallet(Params());
@@ -6,8 +6,11 @@
 #define ZCASH_WALLET_ORCHARD_H
 
 #include <array>
+#include <cstring>
+#include <memory>
 
 #include "primitives/transaction.h"
+#include "shieldedindex.h"
 #include "transaction_builder.h"
 
 #include "rust/orchard/keys.h"
@@ -188,6 +191,113 @@ public:
     }
 };
 
+/**
+ * Trial-decrypts the compact Orchard actions of the shielded index with a fixed
+ * set of incoming viewing keys.
+ */
+class OrchardCompactDecryptor
+{
+private:
+    std::unique_ptr<OrchardCompactDecryptorPtr, decltype(&orchard_compact_decryptor_free)> inner;
+
+    OrchardCompactDecryptor(OrchardCompactDecryptorPtr* ptr) : inner(ptr, orchard_compact_decryptor_free) {}
+
+    friend class OrchardWallet;
+public:
+    /** Whether any of the given actions decrypts with one of the keys. */
+    bool AnyDecrypts(const std::vector<CCompactOrchardAction>& actions) const {
+        return orchard_compact_decryptor_any_decrypts(inner.get(), actions.data(), actions.size());
+    }
+};
+
+/**
+ * The Orchard note commitments of a run of consecutive blocks, collected so
+ * that `OrchardWallet::AppendBlocks` adds them to the note commitment tree in
+ * a single call. Only blocks at or above the checkpoint height (and the last
+ * block of the batch) are given checkpoints in the tree.
+ *
+ * The batch refers to the blocks' bundles and compact actions rather than
+ * copying them, so whatever owns those must be kept alive with `Retain` until
+ * the batch has been appended.
+ */
+class OrchardCommitmentBatch
+{
+private:
+    int nCheckpointFromHeight;
+    int nFirstHeight{0};
+    uint32_t nBlocks{0};
+    std::vector<RawOrchardBatchTx> vTxs;
+    std::vector<std::shared_ptr<const void>> vOwners;
+
+    friend class OrchardWallet;
+
+    void AddHeight(int nHeight) {
+        assert(nHeight >= 0);
+        if (nBlocks == 0) {
+            nFirstHeight = nHeight;
+        }
+        assert(nHeight == nFirstHeight + (int) nBlocks);
+        nBlocks++;
+    }
+
+    void AddTx(int nHeight, size_t txidx, const uint256& txid,
+               const OrchardBundlePtr* bundle,
+               const std::vector<CCompactOrchardAction>* actions) {
+        RawOrchardBatchTx tx;
+        tx.blockHeight = (uint32_t) nHeight;
+        tx.blockTxIdx = txidx;
+        std::memcpy(tx.txid, txid.begin(), sizeof(tx.txid));
+        tx.bundle = bundle;
+        tx.actions = actions ? actions->data() : nullptr;
+        tx.actionsLen = actions ? actions->size() : 0;
+        vTxs.push_back(tx);
+    }
+
+public:
+    explicit OrchardCommitmentBatch(int nCheckpointFromHeight) :
+        nCheckpointFromHeight(nCheckpointFromHeight) {}
+
+    bool Empty() const {
+        return nBlocks == 0;
+    }
+
+    /** Add the next block, which must outlive the batch. */
+    void AddBlock(int nHeight, const CBlock& block) {
+        AddHeight(nHeight);
+        for (size_t txidx = 0; txidx < block.vtx.size(); txidx++) {
+            const CTransaction& tx = block.vtx[txidx];
+            const OrchardBundlePtr* bundle = tx.GetOrchardBundle().GetDetails()->as_ptr();
+            if (bundle != nullptr) {
+                AddTx(nHeight, txidx, tx.GetHash(), bundle, nullptr);
+            }
+        }
+    }
+
+    /** Add the next block in its compact form, which must outlive the batch. */
+    void AddBlock(int nHeight, const CCompactShieldedBlock& block) {
+        AddHeight(nHeight);
+        for (size_t txidx = 0; txidx < block.vtx.size(); txidx++) {
+            const CCompactShieldedTx& tx = block.vtx[txidx];
+            if (!tx.vActions.empty()) {
+                AddTx(nHeight, txidx, tx.txid, nullptr, &tx.vActions);
+            }
+        }
+    }
+
+    /** Keep `owner` alive until the batch has been appended or cleared. */
+    void Retain(std::shared_ptr<const void> owner) {
+        if (vOwners.empty() || vOwners.back() != owner) {
+            vOwners.push_back(std::move(owner));
+        }
+    }
+
+    void Clear() {
+        nBlocks = 0;
+        vTxs.clear();
+        vOwners.clear();
+    }
+};
+
 class OrchardWallet
 {
 private:
@@ -286,7 +396,7 @@ public:
         if (orchard_wallet_add_notes_from_bundle(
                 inner.get(),
                 tx.GetHash().begin(),
-                tx.GetOrchardBundle().inner->as_ptr(),
+                tx.GetOrchardBundle().GetDetails()->as_ptr(),
                 &txMeta,
                 PushOrchardActionIVK,
                 PushSpendActionIdx
@@ -313,7 +423,7 @@ public:
         return orchard_wallet_load_bundle(
                 inner.get(),
                 tx.GetHash().begin(),
-                tx.GetOrchardBundle().inner->as_ptr(),
+                tx.GetOrchardBundle().GetDetails()->as_ptr(),
                 rawHints.data(),
                 rawHints.size(),
                 txMeta.vActionsSpendingMyNotes.data(),
@@ -335,7 +445,33 @@ public:
                     (uint32_t) nBlockHeight,
                     txidx,
                     tx.GetHash().begin(),
-                    tx.GetOrchardBundle().inner->as_ptr()
+                    tx.GetOrchardBundle().GetDetails()->as_ptr()
+                    )) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Append each Orchard note commitment from the compact form of a block to
+     * the wallet's note commitment tree. This is `AppendNoteCommitments` for
+     * blocks the wallet has only read from the shielded index.
+     *
+     * Returns `false` if the caller attempts to insert a block out-of-order.
+     */
+    bool AppendCompactNoteCommitments(const int nBlockHeight, const CCompactShieldedBlock& block) {
+        assert(nBlockHeight >= 0);
+        for (int txidx = 0; txidx < block.vtx.size(); txidx++) {
+            const CCompactShieldedTx& tx = block.vtx[txidx];
+            if (!orchard_wallet_append_compact_commitments(
+                    inner.get(),
+                    (uint32_t) nBlockHeight,
+                    txidx,
+                    tx.txid.begin(),
+                    tx.vActions.data(),
+                    tx.vActions.size()
                     )) {
                 return false;
             }
@@ -344,6 +480,34 @@ public:
         return true;
     }
 
+    /**
+     * Checkpoint the note commitment tree and append the note commitments of
+     * each block in the batch, skipping the checkpoints the batch says can
+     * never be rewound to. This is `CheckpointNoteCommitmentTree` followed by
+     * `AppendNoteCommitments` for every block, in one call.
+     *
+     * Returns `false` if the first block is not the successor of the last
+     * block the wallet has observed.
+     */
+    bool AppendBlocks(const OrchardCommitmentBatch& batch) {
+        if (batch.Empty()) return true;
+        return orchard_wallet_append_blocks(
+                inner.get(),
+                (uint32_t) batch.nFirstHeight,
+                batch.nBlocks,
+                (uint32_t) std::max(batch.nCheckpointFromHeight, 0),
+                batch.vTxs.data(),
+                batch.vTxs.size());
+    }
+
+    /**
+     * Return a trial decryptor for compact actions holding the incoming viewing
+     * keys the wallet has now. It can be used without holding the wallet lock.
+     */
+    OrchardCompactDecryptor GetCompactDecryptor() const {
+        return OrchardCompactDecryptor(orchard_wallet_compact_decryptor(inner.get()));
+    }
+
     uint256 GetLatestAnchor() const {
         uint256 value;
         // there is always a valid note commitment tree root at depth 0
@@ -441,6 +605,17 @@ public:
         return orchard_wallet_is_nullifier_from_me(inner.get(), nullifier.data());
     }
 
+    /**
+     * Returns true if any of the given nullifiers belongs to one of the notes
+     * in our wallet, crossing into the Orchard wallet only once.
+     */
+    bool AnyNullifierFromMe(const std::vector<std::array<uint8_t, 32>>& nullifiers) const {
+        return orchard_wallet_any_nullifier_from_me(
+            inner.get(),
+            reinterpret_cast<const unsigned char*>(nullifiers.data()),
+            nullifiers.size());
+    }
+
     std::vector<uint256> GetPotentialSpendsFromNullifier(const uint256& nullifier) const {
         std::vector<uint256> result;
         orchard_wallet_get_potential_spends_from_nullifier(
@@ -506,7 +681,7 @@ public:
         OrchardActions result;
         orchard_wallet_get_txdata(
                 inner.get(),
-                tx.GetOrchardBundle().inner->as_ptr(),
+                tx.GetOrchardBundle().GetDetails()->as_ptr(),
                 reinterpret_cast<const unsigned char*>(ovks.data()),
                 ovks.size(),
                 &result,
@@ -518,6 +693,10 @@ public:
     bool UnspentNotesAreSpendable() const {
         return orchard_wallet_unspent_notes_are_spendable(inner.get());
     }
+
+    size_t NoteDataUsage() const {
+        return orchard_wallet_note_data_usage(inner.get());
+    }
 };
 
 class OrchardWalletNoteCommitmentTreeWriter
@@ -69,6 +69,9 @@ const std::string ADDR_TYPE_SPROUT = "sprout";
 const std::string ADDR_TYPE_SAPLING = "sapling";
 const std::string ADDR_TYPE_ORCHARD = "orchard";
 
+// The most addresses z_getaddressesforaccount derives in one call.
+static const int64_t MAX_ADDRESSES_PER_BATCH = 100000;
+
 extern UniValue TxJoinSplitToJSON(const CTransaction& tx);
 
 int64_t nWalletUnlockTime;
@@ -1634,7 +1637,7 @@ void ListTransactions(const CWalletTx& wtx, int nMinDepth, bool fLong, UniValue&
             entry.pushKV("fee", ValueFromAmount(-nFee));
             if (fLong)
                 WalletTxToJSON(wtx, entry, asOfHeight);
-            entry.pushKV("size", static_cast<uint64_t>(GetSerializeSize(static_cast<CTransaction>(wtx), SER_NETWORK, PROTOCOL_VERSION)));
+            entry.pushKV("size", static_cast<uint64_t>(wtx.GetTotalSize()));
             ret.push_back(entry);
         }
     }
@@ -1671,7 +1674,7 @@ void ListTransactions(const CWalletTx& wtx, int nMinDepth, bool fLong, UniValue&
             entry.pushKV("vout", r.vout);
             if (fLong)
                 WalletTxToJSON(wtx, entry, asOfHeight);
-            entry.pushKV("size", static_cast<uint64_t>(GetSerializeSize(static_cast<CTransaction>(wtx), SER_NETWORK, PROTOCOL_VERSION)));
+            entry.pushKV("size", static_cast<uint64_t>(wtx.GetTotalSize()));
             ret.push_back(entry);
         }
     }
@@ -1682,11 +1685,14 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
     if (!EnsureWalletIsAvailable(fHelp))
         return NullUniValue;
 
-    if (fHelp || params.size() > 5)
+    if (fHelp || params.size() > 6)
         throw runtime_error(
-            "listtransactions ( \"dummy\" count from includeWatchonly asOfHeight)\n"
+            "listtransactions ( \"dummy\" count from includeWatchonly asOfHeight cursor )\n"
             "\nReturns up to 'count' of the most recent transactions associated with legacy transparent\n"
             "addresses of this wallet, skipping the first 'from' transactions.\n"
+            "\nTo page through a large wallet, start with a 'cursor' of -1 and pass the 'orderpos' of the\n"
+            "oldest entry returned as the 'cursor' of the next call. Each page then costs its own size\n"
+            "rather than the wallet's.\n"
             "\nThis API does not provide any information about transactions containing shielded inputs\n"
             "or outputs, and should only be used in circumstances where it is necessary to interoperate\n"
             "with legacy Bitcoin infrastructure. Use z_listreceivedbyaddress to obtain information about\n"
@@ -1697,6 +1703,9 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             "3. from           (numeric, optional, default=0) The number of transactions to skip\n"
             "4. includeWatchonly (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')\n"
             "5. " + asOfHeightMessage(false) +
+            "6. cursor         (numeric, optional) Only list transactions before this 'orderpos', or from the newest\n"
+            "                  if -1. Pages end on a whole transaction, so may hold more than 'count' entries;\n"
+            "                  'from' must be 0.\n"
             "\nResult:\n"
             "[\n"
             "  {\n"
@@ -1725,6 +1734,7 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             "                                          for 'send' and 'receive' category of transactions.\n"
             "    \"comment\": \"...\",       (string) If a comment is associated with the transaction.\n"
             "    \"size\": n,                (numeric) Transaction size in bytes\n"
+            "    \"orderpos\": n,            (numeric) The position of the transaction in the wallet's order\n"
             "  }\n"
             "]\n"
             "\nExamples:\n"
@@ -1753,10 +1763,16 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
 
     auto asOfHeight = parseAsOfHeight(params, 4);
 
+    std::optional<int64_t> cursor;
+    if (params.size() > 5 && !params[5].isNull())
+        cursor = params[5].get_int64();
+
     if (nCount < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
+    if (cursor.has_value() && nFrom != 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot combine from with a cursor");
 
     UniValue ret(UniValue::VARR);
 
@@ -1765,10 +1781,18 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
         const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
 
         // iterate backwards until we have nCount items to return:
-        for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+        CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin();
+        if (cursor.has_value() && cursor.value() >= 0)
+            it = CWallet::TxItems::const_reverse_iterator(txOrdered.lower_bound(cursor.value()));
+        for (; it != txOrdered.rend(); ++it)
         {
             CWalletTx *const pwtx = (*it).second;
-            ListTransactions(*pwtx, 0, true, ret, filter, asOfHeight);
+            UniValue entries(UniValue::VARR);
+            ListTransactions(*pwtx, 0, true, entries, filter, asOfHeight);
+            for (UniValue entry : entries.getValues()) {
+                entry.pushKV("orderpos", pwtx->nOrderPos);
+                ret.push_back(entry);
+            }
             if ((int)ret.size() >= (nCount+nFrom)) break;
         }
     }
@@ -1777,7 +1801,9 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
 
     if (nFrom > (int)ret.size())
         nFrom = ret.size();
-    if ((nFrom + nCount) > (int)ret.size())
+    // A cursor page keeps its last transaction whole, so that the next page
+    // can start right after it.
+    if ((nFrom + nCount) > (int)ret.size() || cursor.has_value())
         nCount = ret.size() - nFrom;
 
     vector<UniValue> arrTmp = ret.getValues();
@@ -2555,6 +2581,13 @@ UniValue getwalletinfo(const UniValue& params, bool fHelp)
             "  \"shielded_unconfirmed_balance\": xxx, (numeric, optional) the total unconfirmed shielded balance of the wallet in " + CURRENCY_UNIT + ".\n"
             "                              Not included if `asOfHeight` is specified.\n"
             "  \"txcount\": xxxxxxx,         (numeric) the total number of transactions in the wallet\n"
+            "  \"synced_height\": xxxxxx,    (numeric) the height of the last block the wallet has been updated with. The wallet\n"
+            "                              is updated in the background after blocks connect, so this may trail the chain tip.\n"
+            "  \"sync_lag\": xxx,            (numeric) the number of blocks the wallet is behind the chain tip\n"
+            "  \"memory_usage\": {            (object) estimated heap memory held by the wallet, in bytes\n"
+            "    \"transactions\": xxxxx,     (numeric) the wallet's transactions, with their Sprout and Sapling note data\n"
+            "    \"orchard_notes\": xxxxx     (numeric) the Orchard wallet's decrypted notes, nullifiers and spends\n"
+            "  },\n"
             "  \"keypoololdest\": xxxxxx,    (numeric) the timestamp (seconds since GMT epoch) of the oldest pre-generated key in the key pool\n"
             "  \"keypoolsize\": xxxx,        (numeric) how many new keys are pre-generated\n"
             "  \"unlocked_until\": ttt,      (numeric) the timestamp in seconds since epoch (midnight Jan 1 1970 GMT) that the wallet is unlocked for transfers, or 0 if the wallet is locked\n"
@@ -2585,6 +2618,13 @@ UniValue getwalletinfo(const UniValue& params, bool fHelp)
         obj.pushKV("shielded_unconfirmed_balance", FormatMoney(getBalanceZaddr(std::nullopt, asOfHeight, 0, 0)));
     }
     obj.pushKV("txcount",       (int)pwalletMain->mapWallet.size());
+    int nSyncedHeight = GetWalletNotifiedHeight();
+    obj.pushKV("synced_height", nSyncedHeight);
+    obj.pushKV("sync_lag",      std::max(chainActive.Height() - nSyncedHeight, 0));
+    UniValue memoryUsage(UniValue::VOBJ);
+    memoryUsage.pushKV("transactions",  (uint64_t)pwalletMain->WalletTxUsage());
+    memoryUsage.pushKV("orchard_notes", (uint64_t)pwalletMain->OrchardNoteDataUsage());
+    obj.pushKV("memory_usage",  memoryUsage);
     obj.pushKV("keypoololdest", pwalletMain->GetOldestKeyPoolTime());
     obj.pushKV("keypoolsize",   (int)pwalletMain->GetKeyPoolSize());
     if (pwalletMain->IsCrypted())
@@ -3070,6 +3110,12 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
             "Runs a benchmark of the selected benchmark type samplecount times,\n"
             "returning the running times of each sample.\n"
             "\n"
+            "The replayblocks benchmark takes a start and end height, and reconnects those\n"
+            "blocks of the active chain from disk to a rewound copy of the coins view. Its\n"
+            "samples also report blocks, transactions, blockspersecond, txpersecond, the\n"
+            "seconds spent in each phase, peakcacheusage and peakrss (in bytes). Run it on\n"
+            "a copy of a datadir with -connect=0.\n"
+            "\n"
             "Output: [\n"
             "  {\n"
             "    \"runningtime\": runningtime\n"
@@ -3092,6 +3138,7 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
     }
 
     std::vector<double> sample_times;
+    std::vector<UniValue> sample_details;
 
     JSDescription samplejoinsplit;
 
@@ -3136,12 +3183,24 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
                 nInputs = params[2].get_int();
             }
             sample_times.push_back(benchmark_large_tx(nInputs));
+        } else if (benchmarktype == "buildtransparenttx") {
+            int nInputs = 500;
+            if (params.size() >= 3) {
+                nInputs = params[2].get_int();
+            }
+            if (nInputs <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of inputs");
+            }
+            sample_times.push_back(benchmark_build_transparent_tx(nInputs));
         } else if (benchmarktype == "trydecryptnotes") {
             int nKeys = params[2].get_int();
             sample_times.push_back(benchmark_try_decrypt_sprout_notes(nKeys));
         } else if (benchmarktype == "trydecryptsaplingnotes") {
             int nKeys = params[2].get_int();
             sample_times.push_back(benchmark_try_decrypt_sapling_notes(nKeys));
+        } else if (benchmarktype == "trydecryptorchardnotes") {
+            int nKeys = params[2].get_int();
+            sample_times.push_back(benchmark_try_decrypt_orchard_notes(nKeys));
         } else if (benchmarktype == "incnotewitnesses") {
             int nTxs = params[2].get_int();
             sample_times.push_back(benchmark_increment_sprout_note_witnesses(nTxs));
@@ -3163,6 +3222,33 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
                 throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
             }
             sample_times.push_back(benchmark_connectblock_orchard());
+        } else if (benchmarktype == "replayblocks") {
+            if (params.size() < 4) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "replayblocks needs a start and end height");
+            }
+            int nStartHeight = params[2].get_int();
+            int nEndHeight = params[3].get_int();
+            if (nStartHeight < 1 || nEndHeight < nStartHeight || nEndHeight > chainActive.Height()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+            }
+            {
+                LOCK(cs_vNodes);
+                if (!vNodes.empty()) {
+                    throw JSONRPCError(RPC_MISC_ERROR, "Benchmark must be run with networking disabled (-connect=0)");
+                }
+            }
+            UniValue details(UniValue::VOBJ);
+            sample_times.push_back(benchmark_replay_blocks(nStartHeight, nEndHeight, details));
+            sample_details.push_back(details);
+        } else if (benchmarktype == "historytreeupdate") {
+            int nBlocks = 1000;
+            if (params.size() >= 3) {
+                nBlocks = params[2].get_int();
+            }
+            if (nBlocks <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of blocks");
+            }
+            sample_times.push_back(benchmark_history_tree_update(nBlocks));
         } else if (benchmarktype == "sendtoaddress") {
             if (Params().NetworkIDString() != "regtest") {
                 throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
@@ -3176,10 +3262,32 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
             sample_times.push_back(benchmark_loadwallet());
         } else if (benchmarktype == "listunspent") {
             sample_times.push_back(benchmark_listunspent());
+        } else if (benchmarktype == "zlistunspent") {
+            sample_times.push_back(benchmark_z_listunspent());
+        } else if (benchmarktype == "getbalanceforaccounts") {
+            sample_times.push_back(benchmark_getbalanceforaccounts());
+        } else if (benchmarktype == "selectnotes") {
+            sample_times.push_back(benchmark_select_notes());
+        } else if (benchmarktype == "setbestchain") {
+            sample_times.push_back(benchmark_setbestchain());
+        } else if (benchmarktype == "rescanwallet") {
+            if (Params().NetworkIDString() != "regtest") {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Benchmark must be run in regtest mode");
+            }
+            sample_times.push_back(benchmark_rescan_wallet());
         } else if (benchmarktype == "createsaplingspend") {
             sample_times.push_back(benchmark_create_sapling_spend());
         } else if (benchmarktype == "createsaplingoutput") {
             sample_times.push_back(benchmark_create_sapling_output());
+        } else if (benchmarktype == "createorchardbundle") {
+            int nOutputs = 1;
+            if (params.size() >= 3) {
+                nOutputs = params[2].get_int();
+            }
+            if (nOutputs <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of outputs");
+            }
+            sample_times.push_back(benchmark_create_orchard_bundle(nOutputs));
         } else if (benchmarktype == "verifysaplingspend") {
             sample_times.push_back(benchmark_verify_sapling_spend());
         } else if (benchmarktype == "verifysaplingoutput") {
@@ -3190,9 +3298,12 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
     }
 
     UniValue results(UniValue::VARR);
-    for (auto time : sample_times) {
+    for (size_t i = 0; i < sample_times.size(); i++) {
         UniValue result(UniValue::VOBJ);
-        result.pushKV("runningtime", time);
+        result.pushKV("runningtime", sample_times[i]);
+        if (i < sample_details.size()) {
+            result.pushKVs(sample_details[i]);
+        }
         results.push_back(result);
     }
 
@@ -3447,6 +3558,145 @@ UniValue z_getaddressforaccount(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue z_getaddressesforaccount(const UniValue& params, bool fHelp)
+{
+    if (!EnsureWalletIsAvailable(fHelp))
+        return NullUniValue;
+    if (fHelp || params.size() < 2 || params.size() > 3)
+        throw runtime_error(
+            "z_getaddressesforaccount account count ( [\"receiver_type\", ...] )\n"
+            "\nFor the given account number, derives `count` Unified Addresses at the next"
+            "\nunused diversifier indices, as that many calls to z_getaddressforaccount"
+            "\nwithout a diversifier index would. The addresses are derived in parallel and"
+            "\nwritten to the wallet in a single database transaction.\n"
+            "\nIf no list of receiver types is given (or the empty list \"[]\"), an Orchard"
+            "\nreceiver will be used.\n"
+            "\nArguments:\n"
+            "1. account         (numeric, required) an account number generated by z_getnewaccount\n"
+            "2. count           (numeric, required) the number of addresses to derive, at most " + strprintf("%d", MAX_ADDRESSES_PER_BATCH) + "\n"
+            "3. receiver_types  (json array of string, optional) the receiver types (valid value is \"orchard\")\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"account\": n,                          (numeric) the specified account number\n"
+            "  \"receiver_types\": [\"orchard\"],         (json array of string) the receiver types that the UAs contain\n"
+            "  \"addresses\": [\n"
+            "    {\n"
+            "      \"diversifier_index\": n,            (numeric) the index chosen\n"
+            "      \"address\": \"address\"               (string) the corresponding address\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("z_getaddressesforaccount", "0 1000")
+            + HelpExampleCli("z_getaddressesforaccount", "0 1000 '[\"orchard\"]'")
+            + HelpExampleRpc("z_getaddressesforaccount", "0, 1000")
+        );
+
+    // cs_main is required for obtaining the current height, for
+    // CWallet::DefaultReceiverTypes
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    int64_t accountInt = params[0].get_int64();
+    if (accountInt < 0 || accountInt >= ZCASH_LEGACY_ACCOUNT) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid account number, must be 0 <= account <= (2^31)-2.");
+    }
+    libzcash::AccountId account = accountInt;
+
+    int64_t count = params[1].get_int64();
+    if (count < 1 || count > MAX_ADDRESSES_PER_BATCH) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+            strprintf("Invalid count, must be 1 <= count <= %d.", MAX_ADDRESSES_PER_BATCH));
+    }
+
+    std::set<libzcash::ReceiverType> receiverTypes;
+    if (params.size() >= 3) {
+        receiverTypes = ReceiverTypesFromJSON(params[2].get_array())
+            .map_error([](const std::set<std::string>& invalidReceivers) {
+                throw JSONRPCError(
+                        RPC_INVALID_PARAMETER,
+                        strprintf(
+                            "%s %s. Argument must be “orchard”.",
+                            FormatList(
+                                    invalidReceivers,
+                                    "and",
+                                    [](const auto& receiver) { return "“" + receiver + "”"; }),
+                            invalidReceivers.size() == 1
+                            ? "is an invalid receiver type"
+                            : "are invalid receiver types"));
+            })
+            .value();
+    }
+    if (receiverTypes.empty()) {
+        // Default is Orchard only.
+        receiverTypes = CWallet::DefaultReceiverTypes(chainActive.Height());
+    }
+
+    EnsureWalletIsUnlocked();
+    EnsureWalletIsBackedUp(Params());
+
+    auto res = pwalletMain->GenerateUnifiedAddresses(account, receiverTypes, count);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("account", (uint64_t)account);
+    result.pushKV("receiver_types", ReceiverTypesToJSON(receiverTypes));
+
+    examine(res, match {
+        [&](const std::vector<std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>>& addrs) {
+            KeyIO keyIO(Params());
+            UniValue addresses(UniValue::VARR);
+            for (const auto& addr : addrs) {
+                UniValue entry(UniValue::VOBJ);
+                UniValue j;
+                j.setNumStr(ArbitraryIntStr(std::vector(addr.second.begin(), addr.second.end())));
+                entry.pushKV("diversifier_index", j);
+                entry.pushKV("address", keyIO.EncodePaymentAddress(addr.first));
+                addresses.push_back(entry);
+            }
+            result.pushKV("addresses", addresses);
+        },
+        [&](WalletUAGenerationError err) {
+            std::string strErr;
+            switch (err) {
+                case WalletUAGenerationError::NoSuchAccount:
+                    strErr = tfm::format("Error: account %d has not been generated by z_getnewaccount.", account);
+                    break;
+                case WalletUAGenerationError::ExistingAddressMismatch:
+                case WalletUAGenerationError::WalletEncrypted:
+                    // By construction, we should never see these errors; they are included
+                    // only for future-proofing.
+                    strErr = tfm::format("Error: could not generate addresses for account %d.", account);
+            }
+            throw JSONRPCError(RPC_WALLET_ERROR, strErr);
+        },
+        [&](UnifiedAddressGenerationError err) {
+            std::string strErr;
+            switch (err) {
+                case UnifiedAddressGenerationError::ShieldedReceiverNotFound:
+                    strErr = tfm::format(
+                        "Error: cannot generate an address containing no shielded receivers.");
+                    break;
+                case UnifiedAddressGenerationError::ReceiverTypeNotAvailable:
+                    strErr = tfm::format(
+                        "Error: one or more of the requested receiver types does not have a corresponding spending key in this account.");
+                    break;
+                case UnifiedAddressGenerationError::ReceiverTypeNotSupported:
+                    strErr = tfm::format(
+                        "Error: P2SH addresses can not be created using this RPC method.");
+                    break;
+                case UnifiedAddressGenerationError::NoAddressForDiversifier:
+                case UnifiedAddressGenerationError::InvalidTransparentChildIndex:
+                case UnifiedAddressGenerationError::DiversifierSpaceExhausted:
+                    strErr = tfm::format(
+                        "Error: ran out of diversifier indices. Generate a new account with z_getnewaccount");
+                    break;
+            }
+            throw JSONRPCError(RPC_WALLET_ERROR, strErr);
+        },
+    });
+
+    return result;
+}
+
 UniValue z_listaccounts(const UniValue& params, bool fHelp)
 {
     if (!EnsureWalletIsAvailable(fHelp))
@@ -4209,22 +4459,32 @@ UniValue z_getbalanceforaccount(const UniValue& params, bool fHelp)
             tfm::format("Error: account %d has not been generated by z_getnewaccount.", account));
     }
 
-    auto spendableInputs = pwalletMain->FindSpendableInputs(selector.value(), minconf, asOfHeight);
-    // Accounts never contain Sprout notes.
-    assert(spendableInputs.sproutNoteEntries.empty());
+    auto computeBalances = [&]() {
+        auto spendableInputs = pwalletMain->FindSpendableInputs(selector.value(), minconf, asOfHeight);
+        // Accounts never contain Sprout notes.
+        assert(spendableInputs.sproutNoteEntries.empty());
 
-    CAmount transparentBalance = 0;
-    CAmount saplingBalance = 0;
-    CAmount orchardBalance = 0;
-    for (const auto& t : spendableInputs.utxos) {
-        transparentBalance += t.Value();
-    }
-    for (const auto& t : spendableInputs.saplingNoteEntries) {
-        saplingBalance += t.note.value();
-    }
-    for (const auto& t : spendableInputs.orchardNoteMetadata) {
-        orchardBalance += t.GetNoteValue();
-    }
+        CAmount transparentBalance = 0;
+        CAmount saplingBalance = 0;
+        CAmount orchardBalance = 0;
+        for (const auto& t : spendableInputs.utxos) {
+            transparentBalance += t.Value();
+        }
+        for (const auto& t : spendableInputs.saplingNoteEntries) {
+            saplingBalance += t.note.value();
+        }
+        for (const auto& t : spendableInputs.orchardNoteMetadata) {
+            orchardBalance += t.GetNoteValue();
+        }
+        return std::vector<CAmount>{transparentBalance, saplingBalance, orchardBalance};
+    };
+    // Balances as of the current tip are reused until the wallet changes.
+    auto balances = asOfHeight.has_value()
+        ? computeBalances()
+        : pwalletMain->GetCachedBalances(strprintf("z_getbalanceforaccount/%d/%d", account, minconf), computeBalances);
+    CAmount transparentBalance = balances[0];
+    CAmount saplingBalance = balances[1];
+    CAmount orchardBalance = balances[2];
 
     UniValue pools(UniValue::VOBJ);
     auto renderBalance = [&](std::string poolName, CAmount balance) {
@@ -4291,8 +4551,15 @@ UniValue z_gettotalbalance(const UniValue& params, bool fHelp)
     // but they don't because wtx.GetAmounts() does not handle tx where there are no outputs
     // pwalletMain->GetBalance() does not accept min depth parameter
     // so we use our own method to get balance of utxos.
-    CAmount nBalance = getBalanceTaddr(std::nullopt, std::nullopt, nMinDepth, !fIncludeWatchonly);
-    CAmount nPrivateBalance = getBalanceZaddr(std::nullopt, std::nullopt, nMinDepth, INT_MAX, !fIncludeWatchonly);
+    auto balances = pwalletMain->GetCachedBalances(
+        strprintf("z_gettotalbalance/%d/%d", nMinDepth, fIncludeWatchonly),
+        [&]() {
+            return std::vector<CAmount>{
+                getBalanceTaddr(std::nullopt, std::nullopt, nMinDepth, !fIncludeWatchonly),
+                getBalanceZaddr(std::nullopt, std::nullopt, nMinDepth, INT_MAX, !fIncludeWatchonly)};
+        });
+    CAmount nBalance = balances[0];
+    CAmount nPrivateBalance = balances[1];
     CAmount nTotalBalance = nBalance + nPrivateBalance;
     UniValue result(UniValue::VOBJ);
     result.pushKV("transparent", FormatMoney(nBalance));
@@ -6070,7 +6337,7 @@ extern UniValue z_getpaymentdisclosure(const UniValue& params, bool fHelp); // i
 extern UniValue z_validatepaymentdisclosure(const UniValue &params, bool fHelp);
 
 static const CRPCCommand commands[] =
-{ //  category              name                        actor (function)           okSafeMode
+{ //  category              name                        actor (function)           okSafeMode, streamActor, okParallel, asyncActor
     //  --------------------- ------------------------    -----------------------    ----------
     { "rawtransactions",    "fundrawtransaction",       &fundrawtransaction,       false },
     { "hidden",             "resendwallettransactions", &resendwallettransactions, true  },
@@ -6113,7 +6380,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "zcsamplejoinsplit",        &zc_sample_joinsplit,      true  },
     { "wallet",             "z_listreceivedbyaddress",  &z_listreceivedbyaddress,  false },
     { "wallet",             "z_listunspent",            &z_listunspent,            false },
-    { "wallet",             "z_getbalance",             &z_getbalance,             false },
+    { "wallet",             "z_getbalance",             &z_getbalance,             false, nullptr, false, &RPCAwaitActor<z_getbalance> },
     { "wallet",             "z_gettotalbalance",        &z_gettotalbalance,        false },
     { "wallet",             "z_getbalanceforviewingkey",&z_getbalanceforviewingkey,false },
     { "wallet",             "z_getbalanceforaccount",   &z_getbalanceforaccount,   false },
@@ -6132,6 +6399,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "z_listaddresses",          &z_listaddresses,          true  },
     { "wallet",             "z_listunifiedreceivers",   &z_listunifiedreceivers,   true  },
     { "wallet",             "z_getaddressforaccount",   &z_getaddressforaccount,   true  },
+    { "wallet",             "z_getaddressesforaccount", &z_getaddressesforaccount, true  },
     { "wallet",             "z_exportkey",              &z_exportkey,              true  },
     { "wallet",             "z_importkey",              &z_importkey,              true  },
     { "wallet",             "z_exportviewingkey",       &z_exportviewingkey,       true  },
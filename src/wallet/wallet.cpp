@@ -13,6 +13,7 @@
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "consensus/consensus.h"
+#include "core_memusage.h"
 #include "fs.h"
 #include "init.h"
 #include "key_io.h"
@@ -36,10 +37,12 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <future>
 #include <numeric>
 #include <variant>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/scope_exit.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -744,30 +747,147 @@ WalletUAGenerationResult CWallet::GenerateUnifiedAddress(
 
         auto address = std::get<std::pair<UnifiedAddress, diversifier_index_t>>(addressGenerationResult);
 
-        assert(mapUfvkAddressMetadata[ufvkid].SetReceivers(address.second, receiverTypes));
+        if (fFileBacked) {
+            CWalletDB walletdb(strWalletFile);
+            SaveUnifiedAddress(ufvk.value(), address, receiverTypes, &walletdb);
+        } else {
+            SaveUnifiedAddress(ufvk.value(), address, receiverTypes, nullptr);
+        }
+
+        return address;
+    } else {
+        return WalletUAGenerationError::NoSuchAccount;
+    }
+}
 
-        // If the address has an Orchard component, add an association between
-        // that address and the Orchard IVK corresponding to the ufvk
-        auto hasOrchard = receiverTypes.find(ReceiverType::Orchard) != receiverTypes.end();
-        if (hasOrchard) {
-            auto fvk = ufvk.value().GetOrchardKey();
-            auto orchardReceiver = address.first.GetOrchardReceiver();
-            assert (fvk.has_value() && orchardReceiver.has_value());
+WalletUABatchGenerationResult CWallet::GenerateUnifiedAddresses(
+    const libzcash::AccountId& accountId,
+    const std::set<libzcash::ReceiverType>& receiverTypes,
+    size_t count)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!libzcash::HasShielded(receiverTypes)) {
+        return UnifiedAddressGenerationError::ShieldedReceiverNotFound;
+    }
 
-            AddOrchardRawAddress(fvk.value().ToIncomingViewingKey(), orchardReceiver.value());
+    auto ufvk = GetUnifiedFullViewingKeyByAccount(accountId);
+    if (!ufvk.has_value()) {
+        return WalletUAGenerationError::NoSuchAccount;
+    }
+    auto ufvkid = ufvk.value().GetKeyID();
+
+    // Begin one past the last diversifier index used, as GenerateUnifiedAddress does.
+    std::optional<diversifier_index_t> j = diversifier_index_t(0);
+    auto metadata = mapUfvkAddressMetadata.find(ufvkid);
+    if (metadata != mapUfvkAddressMetadata.end()) {
+        j = metadata->second.GetNextDiversifierIndex();
+        if (!j.has_value()) {
+            return UnifiedAddressGenerationError::DiversifierSpaceExhausted;
         }
+    }
 
-        // Save the metadata for the generated address so that we can re-derive
-        // it in the future.
-        ZcashdUnifiedAddressMetadata addrmeta(ufvkid, address.second, receiverTypes);
-        if (fFileBacked && !CWalletDB(strWalletFile).WriteUnifiedAddressMetadata(addrmeta)) {
-            throw std::runtime_error(
-                    "CWallet::AddUnifiedAddress(): Writing unified address metadata failed");
+    std::vector<std::pair<UnifiedAddress, diversifier_index_t>> addresses;
+    if (receiverTypes == std::set<ReceiverType>{ReceiverType::Orchard}) {
+        // Every diversifier index gives a valid Orchard receiver, so the
+        // indices are known up front and each address can be derived on its own.
+        std::vector<diversifier_index_t> indices;
+        for (size_t i = 0; i < count; i++) {
+            if (!j.has_value()) {
+                return UnifiedAddressGenerationError::DiversifierSpaceExhausted;
+            }
+            indices.push_back(j.value());
+            j = j.value().succ();
         }
 
-        return address;
+        std::vector<std::optional<UnifiedAddressGenerationResult>> results(count);
+        auto deriveRange = [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                results[i] = ufvk.value().Address(indices[i], receiverTypes);
+            }
+        };
+        size_t nWorkers = std::max<size_t>(std::min<size_t>(GetNumCores(), count), 1);
+        std::vector<std::future<void>> vWorkers;
+        for (size_t i = 1; i < nWorkers; i++) {
+            vWorkers.push_back(std::async(std::launch::async, deriveRange,
+                i * count / nWorkers, (i + 1) * count / nWorkers));
+        }
+        deriveRange(0, count / nWorkers);
+        for (auto& worker : vWorkers) {
+            worker.get();
+        }
+
+        for (auto& result : results) {
+            if (std::holds_alternative<UnifiedAddressGenerationError>(result.value())) {
+                return std::get<UnifiedAddressGenerationError>(result.value());
+            }
+            addresses.push_back(std::get<std::pair<UnifiedAddress, diversifier_index_t>>(result.value()));
+        }
     } else {
-        return WalletUAGenerationError::NoSuchAccount;
+        // Other receiver types can skip diversifier indices, so each search
+        // starts where the previous one ended.
+        for (size_t i = 0; i < count; i++) {
+            if (!j.has_value()) {
+                return UnifiedAddressGenerationError::DiversifierSpaceExhausted;
+            }
+            auto result = ufvk.value().FindAddress(j.value(), receiverTypes);
+            if (std::holds_alternative<UnifiedAddressGenerationError>(result)) {
+                return std::get<UnifiedAddressGenerationError>(result);
+            }
+            auto address = std::get<std::pair<UnifiedAddress, diversifier_index_t>>(result);
+            j = address.second.succ();
+            addresses.push_back(address);
+        }
+    }
+
+    if (fFileBacked) {
+        CWalletDB walletdb(strWalletFile);
+        if (!walletdb.TxnBegin()) {
+            throw std::runtime_error(
+                    "CWallet::GenerateUnifiedAddresses(): Beginning a database transaction failed");
+        }
+        for (const auto& address : addresses) {
+            SaveUnifiedAddress(ufvk.value(), address, receiverTypes, &walletdb);
+        }
+        if (!walletdb.TxnCommit()) {
+            throw std::runtime_error(
+                    "CWallet::GenerateUnifiedAddresses(): Committing the unified address metadata failed");
+        }
+    } else {
+        for (const auto& address : addresses) {
+            SaveUnifiedAddress(ufvk.value(), address, receiverTypes, nullptr);
+        }
+    }
+
+    return addresses;
+}
+
+void CWallet::SaveUnifiedAddress(
+    const libzcash::ZcashdUnifiedFullViewingKey& ufvk,
+    const std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>& address,
+    const std::set<libzcash::ReceiverType>& receiverTypes,
+    CWalletDB* pwalletdb)
+{
+    auto ufvkid = ufvk.GetKeyID();
+    assert(mapUfvkAddressMetadata[ufvkid].SetReceivers(address.second, receiverTypes));
+
+    // If the address has an Orchard component, add an association between
+    // that address and the Orchard IVK corresponding to the ufvk
+    auto hasOrchard = receiverTypes.find(ReceiverType::Orchard) != receiverTypes.end();
+    if (hasOrchard) {
+        auto fvk = ufvk.GetOrchardKey();
+        auto orchardReceiver = address.first.GetOrchardReceiver();
+        assert (fvk.has_value() && orchardReceiver.has_value());
+
+        AddOrchardRawAddress(fvk.value().ToIncomingViewingKey(), orchardReceiver.value());
+    }
+
+    // Save the metadata for the generated address so that we can re-derive
+    // it in the future.
+    ZcashdUnifiedAddressMetadata addrmeta(ufvkid, address.second, receiverTypes);
+    if (pwalletdb != nullptr && !pwalletdb->WriteUnifiedAddressMetadata(addrmeta)) {
+        throw std::runtime_error(
+                "CWallet::AddUnifiedAddress(): Writing unified address metadata failed");
     }
 }
 
@@ -1330,13 +1450,14 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 void CWallet::ChainTipAdded(const CBlockIndex *pindex,
                             const CBlock *pblock,
                             MerkleFrontiers frontiers,
-                            bool performOrchardWalletUpdates)
+                            bool performOrchardWalletUpdates,
+                            const CCompactShieldedBlock* pcompact)
 {
     const auto chainParams = Params();
     IncrementNoteWitnesses(
             chainParams.GetConsensus(),
             pindex, pblock,
-            frontiers, performOrchardWalletUpdates);
+            frontiers, performOrchardWalletUpdates, pcompact);
     UpdateSaplingNullifierNoteMapForBlock(pblock);
 
     // SetBestChain() can be expensive for large wallets, so do only
@@ -1360,6 +1481,8 @@ void CWallet::ChainTipAdded(const CBlockIndex *pindex,
             LOCK(cs_main);
             loc = chainActive.GetLocator(pindex);
         }
+        // The Orchard tree that is written must have caught up with pindex.
+        FlushOrchardRescanBatch();
         SetBestChain(loc);
     }
 }
@@ -1387,6 +1510,9 @@ void CWallet::ChainTip(const CBlockIndex *pindex,
         DecrementNoteWitnesses(consensus, pindex);
         UpdateSaplingNullifierNoteMapForBlock(pblock);
     }
+    // Balances read while the tip had moved but the wallet had not caught up
+    // must not outlive this block.
+    MarkBalancesDirty();
 
     auto hash = tfm::format("%s", pindex->GetBlockHash().ToString());
     auto height = tfm::format("%d", pindex->nHeight);
@@ -2189,7 +2315,9 @@ SpendableInputs CWallet::FindSpendableInputs(
     bool selectOrchard{selector.SelectsOrchard()};
 
     SpendableInputs unspent;
-    for (auto const& [wtxid, wtx] : mapWallet) {
+    for (const CWalletTx* pwtx : GetMaybeUnspentTxs(asOfHeight)) {
+        const CWalletTx& wtx = *pwtx;
+        const uint256 wtxid = wtx.GetHash();
         bool isCoinbase = wtx.IsCoinBase();
         auto nDepth = wtx.GetDepthInMainChain(asOfHeight);
 
@@ -2372,6 +2500,7 @@ SpendableInputs CWallet::FindSpendableInputs(
                 if (IsOrchardSpent(noteMeta.GetOutPoint(), asOfHeight)) {
                     continue;
                 }
+                if (IsLockedNote(noteMeta.GetOutPoint())) continue;
 
                 auto mit = mapWallet.find(noteMeta.GetOutPoint().hash);
 
@@ -2693,7 +2822,8 @@ void CWallet::IncrementNoteWitnesses(
         const CBlockIndex* pindex,
         const CBlock* pblockIn,
         MerkleFrontiers& frontiers,
-        bool performOrchardWalletUpdates)
+        bool performOrchardWalletUpdates,
+        const CCompactShieldedBlock* pcompact)
 {
     LOCK(cs_wallet);
     int chainHeight = pindex->nHeight;
@@ -2807,9 +2937,9 @@ void CWallet::IncrementNoteWitnesses(
     // 3) Apply the information we collected to the existing notes in the
     //    wallet that we are tracking. Step (2) above ensures that we won't
     //    attempt to re-update the notes discovered in this block even though
-    //    we iterate over all of mapWallet.
-    for (auto& it : mapWallet) {
-        CWalletTx& wtx = it.second;
+    //    we iterate over all of the wallet's Sprout and Sapling notes.
+    for (const uint256& txid : setNoteDataTxs) {
+        CWalletTx& wtx = mapWallet.at(txid);
         // Sprout
         ::IncrementNoteWitnesses(wtx.mapSproutNoteData,
                                  noteCommitmentsSprout,
@@ -2829,12 +2959,29 @@ void CWallet::IncrementNoteWitnesses(
     // If we're at or beyond NU5 activation, initialize if necessary and then
     // update the Orchard note commitment tree.
     if (performOrchardWalletUpdates && consensus.NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_NU5)) {
-        if (!orchardWallet.GetLastCheckpointHeight().has_value()) {
+        if (!orchardWallet.GetLastCheckpointHeight().has_value() &&
+            (!orchardRescanBatch.has_value() || orchardRescanBatch->Empty())) {
             orchardWallet.InitNoteCommitmentTree(frontiers.orchard);
         }
-        assert(orchardWallet.CheckpointNoteCommitmentTree(pindex->nHeight));
 
-        assert(orchardWallet.AppendNoteCommitments(pindex->nHeight, *pblock));
+        if (orchardRescanBatch.has_value()) {
+            // A rescan always passes the block it has read, which it keeps
+            // alive until the batch is flushed.
+            assert(pblock == pblockIn);
+            if (pcompact) {
+                orchardRescanBatch->AddBlock(pindex->nHeight, *pcompact);
+            } else {
+                orchardRescanBatch->AddBlock(pindex->nHeight, *pblock);
+            }
+        } else {
+            assert(orchardWallet.CheckpointNoteCommitmentTree(pindex->nHeight));
+
+            if (pcompact) {
+                assert(orchardWallet.AppendCompactNoteCommitments(pindex->nHeight, *pcompact));
+            } else {
+                assert(orchardWallet.AppendNoteCommitments(pindex->nHeight, *pblock));
+            }
+        }
 
         // This assertion slows scanning for blocks with few shielded transactions by an
         // order of magnitude. It is only intended as a consistency check between the node
@@ -2849,6 +2996,15 @@ void CWallet::IncrementNoteWitnesses(
     // of the wallet.dat is maintained).
 }
 
+void CWallet::FlushOrchardRescanBatch()
+{
+    LOCK(cs_wallet);
+    if (orchardRescanBatch.has_value() && !orchardRescanBatch->Empty()) {
+        assert(orchardWallet.AppendBlocks(orchardRescanBatch.value()));
+        orchardRescanBatch->Clear();
+    }
+}
+
 template<typename NoteDataMap>
 static void DecrementNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
 {
@@ -2909,11 +3065,12 @@ void CWallet::DecrementNoteWitnesses(const Consensus::Params& consensus, const C
     LOCK(cs_wallet);
     bool hasSprout = false;
     bool hasSapling = false;
-    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-        hasSprout |= !wtxItem.second.mapSproutNoteData.empty();
-        ::DecrementNoteWitnesses(wtxItem.second.mapSproutNoteData, pindex->nHeight, nWitnessCacheSize);
-        hasSapling |= !wtxItem.second.mapSaplingNoteData.empty();
-        ::DecrementNoteWitnesses(wtxItem.second.mapSaplingNoteData, pindex->nHeight, nWitnessCacheSize);
+    for (const uint256& txid : setNoteDataTxs) {
+        CWalletTx& wtx = mapWallet.at(txid);
+        hasSprout |= !wtx.mapSproutNoteData.empty();
+        ::DecrementNoteWitnesses(wtx.mapSproutNoteData, pindex->nHeight, nWitnessCacheSize);
+        hasSapling |= !wtx.mapSaplingNoteData.empty();
+        ::DecrementNoteWitnesses(wtx.mapSaplingNoteData, pindex->nHeight, nWitnessCacheSize);
     }
     if (nWitnessCacheSize > 0) {
         nWitnessCacheSize -= 1;
@@ -3132,6 +3289,31 @@ void CWallet::MarkDirty()
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
     }
+    MarkBalancesDirty();
+}
+
+std::vector<CAmount> CWallet::GetCachedBalances(
+        const std::string& key,
+        const std::function<std::vector<CAmount>()>& compute) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    uint64_t nGeneration = nBalanceGeneration;
+    uint256 tip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    unsigned int nMempool = mempool.GetTransactionsUpdated();
+    if (nGeneration != nBalanceCacheGeneration || tip != balanceCacheTip || nMempool != nBalanceCacheMempool) {
+        mapBalanceCache.clear();
+        nBalanceCacheGeneration = nGeneration;
+        balanceCacheTip = tip;
+        nBalanceCacheMempool = nMempool;
+    }
+
+    auto it = mapBalanceCache.find(key);
+    if (it == mapBalanceCache.end()) {
+        it = mapBalanceCache.emplace(key, compute()).first;
+    }
+    return it->second;
 }
 
 /**
@@ -3146,6 +3328,9 @@ bool CWallet::UpdateNullifierNoteMap()
         if (IsLocked())
             return false;
 
+        // Cached nullifiers may be filled in below.
+        setNoteDataTxsAtRest.clear();
+
         ZCNoteDecryption dec;
         for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
             for (mapSproutNoteData_t::value_type& item : wtxItem.second.mapSproutNoteData) {
@@ -3202,6 +3387,7 @@ void CWallet::UpdateNullifierNoteMapWithTx(const CWalletTx& wtx)
  */
 void CWallet::UpdateSaplingNullifierNoteMapWithTx(CWalletTx& wtx) {
     LOCK(cs_wallet);
+    setNoteDataTxsAtRest.erase(wtx.GetHash());
 
     for (mapSaplingNoteData_t::value_type &item : wtx.mapSaplingNoteData) {
         SaplingOutPoint op = item.first;
@@ -3265,9 +3451,77 @@ void CWallet::LoadWalletTx(const CWalletTx& wtxIn) {
     wtx.BindWallet(this);
     wtxOrdered.insert(make_pair(wtx.nOrderPos, &wtx));
     UpdateNullifierNoteMapWithTx(mapWallet[hash]);
+    IndexNoteData(wtx);
+    MarkBalancesDirty();
     AddToSpends(hash);
 }
 
+void CWallet::IndexNoteData(const CWalletTx& wtx)
+{
+    setNoteDataTxsAtRest.erase(wtx.GetHash());
+    if (!wtx.mapSproutNoteData.empty() || !wtx.mapSaplingNoteData.empty()) {
+        setNoteDataTxs.insert(wtx.GetHash());
+    }
+    if (!wtx.vout.empty()) {
+        setUnspentOutputTxs.insert(wtx.GetHash());
+    }
+}
+
+bool CWallet::IsSpentBeyondReorg(const uint256& hash, unsigned int n) const
+{
+    auto range = mapTxSpends.equal_range(COutPoint(hash, n));
+    for (auto it = range.first; it != range.second; ++it) {
+        auto mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain(std::nullopt) > WITNESS_CACHE_SIZE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<const CWalletTx*> CWallet::GetMaybeUnspentTxs(const std::optional<int>& asOfHeight) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    std::vector<const CWalletTx*> result;
+    if (asOfHeight.has_value()) {
+        result.reserve(mapWallet.size());
+        for (const auto& [_, wtx] : mapWallet) {
+            result.push_back(&wtx);
+        }
+        return result;
+    }
+
+    for (auto it = setUnspentOutputTxs.begin(); it != setUnspentOutputTxs.end(); ) {
+        auto mit = mapWallet.find(*it);
+        bool fDone = mit == mapWallet.end();
+        if (!fDone) {
+            const CWalletTx& wtx = mit->second;
+            fDone = true;
+            for (unsigned int i = 0; i < wtx.vout.size() && fDone; i++) {
+                fDone = IsMine(wtx.vout[i]) == ISMINE_NO || IsSpentBeyondReorg(*it, i);
+            }
+        }
+        if (fDone) {
+            it = setUnspentOutputTxs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<uint256> txids;
+    std::set_union(
+            setUnspentOutputTxs.begin(), setUnspentOutputTxs.end(),
+            setNoteDataTxs.begin(), setNoteDataTxs.end(),
+            std::back_inserter(txids));
+    result.reserve(txids.size());
+    for (const uint256& txid : txids) {
+        result.push_back(&mapWallet.at(txid));
+    }
+    return result;
+}
+
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, CWalletDB* pwalletdb)
 {
     { // additional scope left in place for backport whitespace compatibility
@@ -3279,6 +3533,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, CWalletDB* pwalletdb)
         CWalletTx& wtx = (*ret.first).second;
         wtx.BindWallet(this);
         UpdateNullifierNoteMapWithTx(wtx);
+        IndexNoteData(wtx);
+        MarkBalancesDirty();
         bool fInsertedNew = ret.second;
         if (fInsertedNew)
         {
@@ -3344,6 +3600,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, CWalletDB* pwalletdb)
             if (UpdatedNoteData(wtxIn, wtx)) {
                 fUpdated = true;
             }
+            IndexNoteData(wtx);
             if (wtxIn.fFromMe && wtxIn.fFromMe != wtx.fFromMe)
             {
                 wtx.fFromMe = wtxIn.fFromMe;
@@ -3638,6 +3895,7 @@ BatchScanner* CWallet::GetBatchScanner()
 
 void CWallet::MarkAffectedTransactionsDirty(const CTransaction& tx)
 {
+    MarkBalancesDirty();
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
@@ -3672,8 +3930,12 @@ void CWallet::EraseFromWallet(const uint256 &hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
+            setNoteDataTxs.erase(hash);
+            setUnspentOutputTxs.erase(hash);
+            MarkBalancesDirty();
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return;
 }
@@ -4040,12 +4302,11 @@ bool CWallet::IsFromMe(const CTransaction& tx) const
             return true;
         }
     }
+    std::vector<std::array<uint8_t, 32>> orchardNullifiers;
     for (const auto& action : tx.GetOrchardBundle().GetDetails()->actions()) {
-        if (orchardWallet.IsNullifierFromMe(action.nullifier())) {
-            return true;
-        }
+        orchardNullifiers.push_back(action.nullifier());
     }
-    return false;
+    return orchardWallet.AnyNullifierFromMe(orchardNullifiers);
 }
 
 CAmount CWallet::GetDebit(const CTransaction& tx, const isminefilter& filter) const
@@ -4574,6 +4835,99 @@ void CWallet::WitnessNoteCommitment(std::vector<uint256> commitments,
     }
 }
 
+/** Number of blocks in each stage of the wallet rescan pipeline. */
+static const size_t RESCAN_CHUNK_BLOCKS = 32;
+/** Number of blocks a rescan covers between the checkpoints it resumes from. */
+static const int RESCAN_CHECKPOINT_BLOCKS = 10000;
+
+namespace {
+/**
+ * A block being rescanned, with its transactions serialized for the batch
+ * scanner. With -shieldedindex, a block none of whose Orchard actions decrypt
+ * is only read from the index, and fCompact is set instead.
+ */
+struct RescanBlock {
+    CBlockIndex* pindex;
+    uint256 hash;
+    CDiskBlockPos pos;
+    CBlock block;
+    std::vector<std::vector<unsigned char>> vTxBytes;
+    CCompactShieldedBlock compact;
+    bool fCompact{false};
+    bool fRead{false};
+};
+}
+
+/** Read a rescanned block in full and serialize its transactions. */
+static bool ReadRescanBlock(RescanBlock& item, const Consensus::Params& consensus)
+{
+    if (!ReadBlockFromDisk(item.block, item.pos, consensus)) return false;
+    if (item.block.GetHash() != item.hash) {
+        LogPrintf("%s: block hash mismatch for %s at %s\n", __func__, item.hash.GetHex(), item.pos.ToString());
+        return false;
+    }
+    item.vTxBytes.reserve(item.block.vtx.size());
+    for (const CTransaction& tx : item.block.vtx) {
+        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+        ssTx << tx;
+        item.vTxBytes.emplace_back(ssTx.begin(), ssTx.end());
+    }
+    return true;
+}
+
+/**
+ * Read a chunk of blocks and serialize their transactions. This runs without
+ * any locks, so it only uses the positions and hashes captured while cs_main
+ * was held, and stops at the first block that cannot be read. If a decryptor
+ * is given, blocks whose shielded index entry has no Sprout or Sapling parts
+ * and no Orchard action it can decrypt are not read from disk.
+ */
+static void ReadRescanChunk(
+        std::vector<RescanBlock>& chunk,
+        const Consensus::Params& consensus,
+        const OrchardCompactDecryptor* decryptor)
+{
+    for (RescanBlock& item : chunk) {
+        if (ShutdownRequested()) return;
+        if (decryptor && pblocktree->ReadShieldedIndex(item.hash, item.compact)) {
+            item.fCompact = std::none_of(item.compact.vtx.begin(), item.compact.vtx.end(),
+                [&](const CCompactShieldedTx& tx) {
+                    return tx.fOtherShielded || decryptor->AnyDecrypts(tx.vActions);
+                });
+            if (item.fCompact) {
+                item.fRead = true;
+                continue;
+            }
+            item.compact = CCompactShieldedBlock();
+        }
+        if (!ReadRescanBlock(item, consensus)) return;
+        item.fRead = true;
+    }
+}
+
+bool CWallet::CompactBlockMayInvolveMe(const CCompactShieldedBlock& block) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::vector<std::array<uint8_t, 32>> orchardNullifiers;
+    for (const CCompactShieldedTx& tx : block.vtx) {
+        if (tx.fOtherShielded || mapWallet.count(tx.txid)) return true;
+        for (const COutPoint& prevout : tx.vTransparentIn) {
+            if (mapWallet.count(prevout.hash)) return true;
+        }
+        for (const CScript& script : tx.vTransparentOut) {
+            if (::IsMine(*this, script) != ISMINE_NO) return true;
+        }
+        for (const CCompactOrchardAction& action : tx.vActions) {
+            std::array<uint8_t, 32> nullifier;
+            std::copy(std::begin(action.nullifier), std::end(action.nullifier), nullifier.begin());
+            orchardNullifiers.push_back(nullifier);
+        }
+    }
+    // Check all of the block's Orchard spends in one call.
+    return orchardWallet.AnyNullifierFromMe(orchardNullifiers);
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -4597,6 +4951,22 @@ std::optional<int> CWallet::ScanForWalletTransactions(
     {
         LOCK2(cs_main, cs_wallet);
 
+        // Persist Sapling & Orchard note data that might have changed while
+        // rescanning, e.g. nullifiers, for the transactions found so far.
+        auto writeNoteData = [&](CWalletDB& walletdb) {
+            for (auto hash : myTxHashes) {
+                CWalletTx wtx = mapWallet[hash];
+                if (!wtx.mapSaplingNoteData.empty() || !wtx.orchardTxMeta.empty()) {
+                    if (!walletdb.WriteTx(wtx)) {
+                        LogPrintf(
+                                "Rescanning... WriteToDisk failed to update Sapling/Orchard note data for tx: %s\n",
+                                hash.ToString());
+                    }
+                }
+            }
+            myTxHashes.clear();
+        };
+
         // There is no need to read and scan blocks that were created before
         // our wallet birthday (as adjusted for block time variability).
         // If there is an Orchard wallet checkpoint, the rewind point must not
@@ -4651,75 +5021,188 @@ std::optional<int> CWallet::ScanForWalletTransactions(
         // Create a rescan-specific batch scanner for the wallet.
         auto batchScanner = WalletBatchScanner(this);
 
+        // Append the Orchard note commitments of each chunk in one call. Only
+        // blocks close enough to the tip to be rewound to by a reorg need a
+        // checkpoint in the tree; older ones would be evicted unused.
+        if (performOrchardWalletUpdates) {
+            orchardRescanBatch.emplace(chainActive.Height() - (int) WITNESS_CACHE_SIZE + 1);
+        }
+        BOOST_SCOPE_EXIT(this_) {
+            this_->FlushOrchardRescanBatch();
+            this_->orchardRescanBatch.reset();
+        } BOOST_SCOPE_EXIT_END
+
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex)
-        {
-            // Allow the rescan to be interrupted on a block boundary.
-            if (ShutdownRequested()) return std::nullopt;
 
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+        // The rescan is pipelined over chunks of blocks: while one chunk is
+        // read from disk in the background, the Sapling outputs of the chunk
+        // before it are trial-decrypted on the batch scanner's threadpool,
+        // and the chunk before that is applied to the wallet in chain order.
+        CBlockIndex* pindexNextRead = pindex;
+        auto nextChunk = [&]() {
+            auto chunk = std::make_shared<std::vector<RescanBlock>>();
+            while (pindexNextRead && chunk->size() < RESCAN_CHUNK_BLOCKS) {
+                RescanBlock item;
+                item.pindex = pindexNextRead;
+                item.hash = pindexNextRead->GetBlockHash();
+                item.pos = pindexNextRead->GetBlockPos();
+                chunk->push_back(std::move(item));
+                pindexNextRead = chainActive.Next(pindexNextRead);
+            }
+            return chunk;
+        };
+        // With -shieldedindex, blocks that cannot involve the wallet are only
+        // read from the index. The decryptor holds the Orchard keys the wallet
+        // has now, which cannot change while cs_wallet is held.
+        std::optional<OrchardCompactDecryptor> compactDecryptor;
+        if (fShieldedIndex) {
+            compactDecryptor = orchardWallet.GetCompactDecryptor();
+        }
+        const OrchardCompactDecryptor* decryptor = compactDecryptor ? &compactDecryptor.value() : nullptr;
+        auto startRead = [&](std::shared_ptr<std::vector<RescanBlock>> chunk) {
+            return std::async(std::launch::async, [chunk, &consensus, decryptor]() {
+                ReadRescanChunk(*chunk, consensus, decryptor);
+            });
+        };
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus)) {
-                throw std::runtime_error(
-                    strprintf("Can't read block %d from disk (%s)", pindex->nHeight, pindex->GetBlockHash().GetHex()));
-            }
-            for (CTransaction& tx : block.vtx) {
-                CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-                ssTx << tx;
-                std::vector<unsigned char> txBytes(ssTx.begin(), ssTx.end());
-                batchScanner.AddTransaction(tx, txBytes, pindex->GetBlockHash(), pindex->nHeight);
+        int nLastCheckpointHeight = pindex->nHeight;
+        std::shared_ptr<std::vector<RescanBlock>> readingChunk = nextChunk();
+        std::future<void> reading = startRead(readingChunk);
+        std::shared_ptr<std::vector<RescanBlock>> decryptingChunk;
+        while (readingChunk || decryptingChunk)
+        {
+            std::shared_ptr<std::vector<RescanBlock>> applyingChunk = decryptingChunk;
+            decryptingChunk = nullptr;
+            if (readingChunk) {
+                reading.get();
+                decryptingChunk = readingChunk;
+                readingChunk = nullptr;
+                if (pindexNextRead) {
+                    readingChunk = nextChunk();
+                    reading = startRead(readingChunk);
+                }
+
+                // Queue the whole chunk before flushing, so that its outputs
+                // are decrypted in large batches across the worker threads.
+                for (const RescanBlock& item : *decryptingChunk) {
+                    if (!item.fRead) break;
+                    if (item.fCompact) continue;
+                    for (size_t i = 0; i < item.block.vtx.size(); i++) {
+                        batchScanner.AddTransaction(item.block.vtx[i], item.vTxBytes[i], item.hash, item.pindex->nHeight);
+                    }
+                }
+                batchScanner.Flush();
             }
-            batchScanner.Flush();
-            for (CTransaction& tx : block.vtx)
+            if (!applyingChunk) continue;
+
+            for (RescanBlock& item : *applyingChunk)
             {
-                if (batchScanner.AddToWalletIfInvolvingMe(consensus, tx, &block, pindex->nHeight, fUpdate)) {
-                    myTxHashes.push_back(tx.GetHash());
-                    myTransactionsFound++;
+                pindex = item.pindex;
+                if (orchardRescanBatch.has_value()) {
+                    orchardRescanBatch->Retain(applyingChunk);
                 }
-            }
 
-            MerkleFrontiers frontiers;
-            // Juno Cash: Skip all anchor assertions during wallet rescan
-            // These checks are not needed during rescan - ConnectBlock already validates anchors
-            // Skipping prevents assertion failures when anchors may not be in database yet
-            // assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, frontiers.sprout));
-            // if (pindex->pprev) {
-            //     if (consensus.NetworkUpgradeActive(pindex->pprev->nHeight,  Consensus::UPGRADE_SAPLING)) {
-            //         assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, frontiers.sapling));
-            //     }
-            //     if (consensus.NetworkUpgradeActive(pindex->pprev->nHeight,  Consensus::UPGRADE_NU5)) {
-            //         assert(pcoinsTip->GetOrchardAnchorAt(pindex->pprev->hashFinalOrchardRoot, frontiers.orchard));
-            //     }
-            // }
-            // Increment note witness caches
-            ChainTipAdded(pindex, &block, frontiers, performOrchardWalletUpdates);
+                // Allow the rescan to be interrupted on a block boundary.
+                if (ShutdownRequested()) return std::nullopt;
 
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf(
-                        "Still rescanning. At block %d. Progress=%f\n",
-                        pindex->nHeight,
-                        Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                if (!item.fRead) {
+                    throw std::runtime_error(
+                        strprintf("Can't read block %d from disk (%s)", pindex->nHeight, pindex->GetBlockHash().GetHex()));
+                }
+                if (item.fCompact && !CompactBlockMayInvolveMe(item.compact))
+                {
+                    // Nothing in the block is ours, so only the note commitment
+                    // trees need it, and the index entry has their part.
+                    CBlock header(pindex->GetBlockHeader());
+                    MerkleFrontiers frontiers;
+                    ChainTipAdded(pindex, &header, frontiers, performOrchardWalletUpdates, &item.compact);
+                } else {
+                    if (item.fCompact) {
+                        // A transparent part or an Orchard spend may be ours,
+                        // which only the full block can tell.
+                        item.compact = CCompactShieldedBlock();
+                        if (!ReadRescanBlock(item, consensus)) {
+                            throw std::runtime_error(
+                                strprintf("Can't read block %d from disk (%s)", pindex->nHeight, pindex->GetBlockHash().GetHex()));
+                        }
+                        for (size_t i = 0; i < item.block.vtx.size(); i++) {
+                            batchScanner.AddTransaction(item.block.vtx[i], item.vTxBytes[i], item.hash, pindex->nHeight);
+                        }
+                        batchScanner.Flush();
+                    }
+                    CBlock& block = item.block;
+                    for (CTransaction& tx : block.vtx)
+                    {
+                        if (batchScanner.AddToWalletIfInvolvingMe(consensus, tx, &block, pindex->nHeight, fUpdate)) {
+                            myTxHashes.push_back(tx.GetHash());
+                            myTransactionsFound++;
+                        }
+                    }
+
+                    MerkleFrontiers frontiers;
+                    // Juno Cash: Skip all anchor assertions during wallet rescan
+                    // These checks are not needed during rescan - ConnectBlock already validates anchors
+                    // Skipping prevents assertion failures when anchors may not be in database yet
+                    // assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, frontiers.sprout));
+                    // if (pindex->pprev) {
+                    //     if (consensus.NetworkUpgradeActive(pindex->pprev->nHeight,  Consensus::UPGRADE_SAPLING)) {
+                    //         assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, frontiers.sapling));
+                    //     }
+                    //     if (consensus.NetworkUpgradeActive(pindex->pprev->nHeight,  Consensus::UPGRADE_NU5)) {
+                    //         assert(pcoinsTip->GetOrchardAnchorAt(pindex->pprev->hashFinalOrchardRoot, frontiers.orchard));
+                    //     }
+                    // }
+                    // Increment note witness caches
+                    ChainTipAdded(pindex, &block, frontiers, performOrchardWalletUpdates);
+
+                }
+
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf(
+                            "Still rescanning. At block %d. Progress=%f\n",
+                            pindex->nHeight,
+                            Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                }
+            }
+
+            // The chunk's blocks are released once the Orchard tree no longer
+            // refers to them.
+            FlushOrchardRescanBatch();
+
+            // Checkpoint the rescan every so often, so that if it is
+            // interrupted it resumes from here after a restart instead of
+            // starting over.
+            if (pindex->nHeight - nLastCheckpointHeight >= RESCAN_CHECKPOINT_BLOCKS && chainActive.Next(pindex)) {
+                CWalletDB walletdb(strWalletFile, "r+", false);
+                writeNoteData(walletdb);
+                auto locator = chainActive.GetLocator(pindex);
+                if (isInitScan) {
+                    // The wallet's note commitment trees are being rebuilt
+                    // alongside, so its best block moves with the rescan.
+                    SetBestChainINTERNAL(walletdb, locator);
+                }
+                walletdb.WriteRescanProgress(locator, isInitScan);
+                nLastCheckpointHeight = pindex->nHeight;
             }
         }
 
         // After rescanning, persist Sapling & Orchard note data that might have changed,
         // e.g. nullifiers. Do not flush the wallet here for performance reasons.
         CWalletDB walletdb(strWalletFile, "r+", false);
-        for (auto hash : myTxHashes) {
-            CWalletTx wtx = mapWallet[hash];
-            if (!wtx.mapSaplingNoteData.empty() || !wtx.orchardTxMeta.empty()) {
-                if (!walletdb.WriteTx(wtx)) {
-                    LogPrintf(
-                            "Rescanning... WriteToDisk failed to update Sapling/Orchard note data for tx: %s\n",
-                            hash.ToString());
-                }
-            }
+        writeNoteData(walletdb);
+
+        // The rescan is complete, so there is nothing left to resume. A
+        // pending rescan of the other kind is left for InitLoadWallet.
+        CBlockLocator rescanLocator;
+        bool fRescanInitScan;
+        if (walletdb.ReadRescanProgress(rescanLocator, fRescanInitScan) && fRescanInitScan == isInitScan) {
+            walletdb.EraseRescanProgress();
         }
 
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
@@ -4945,12 +5428,11 @@ bool CWalletTx::IsFromMe(const isminefilter& filter) const
             return true;
         }
     }
+    std::vector<std::array<uint8_t, 32>> orchardNullifiers;
     for (const auto& action : GetOrchardBundle().GetDetails()->actions()) {
-        if (pwallet->orchardWallet.IsNullifierFromMe(action.nullifier())) {
-            return true;
-        }
+        orchardNullifiers.push_back(action.nullifier());
     }
-    return false;
+    return pwallet->orchardWallet.AnyNullifierFromMe(orchardNullifiers);
 }
 
 bool CWalletTx::IsTrusted(const std::optional<int>& asOfHeight) const
@@ -5043,34 +5525,36 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
 
 CAmount CWallet::GetBalance(const std::optional<int>& asOfHeight, const isminefilter& filter, const int min_depth) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+    LOCK2(cs_main, cs_wallet);
+    auto compute = [&]() {
+        CAmount nTotal = 0;
+        for (const CWalletTx* pcoin : GetMaybeUnspentTxs(asOfHeight))
         {
-            const CWalletTx* pcoin = &entry.second;
             if (pcoin->IsTrusted(asOfHeight) && pcoin->GetDepthInMainChain(asOfHeight) >= min_depth) {
                 nTotal += pcoin->GetAvailableCredit(asOfHeight, true, filter);
             }
         }
-    }
+        return std::vector<CAmount>{nTotal};
+    };
 
-    return nTotal;
+    if (asOfHeight.has_value()) {
+        return compute()[0];
+    }
+    return GetCachedBalances(strprintf("getbalance/%d/%d", filter, min_depth), compute)[0];
 }
 
 CAmount CWallet::GetUnconfirmedTransparentBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances("unconfirmed", [&]() {
+        CAmount nTotal = 0;
+        for (const CWalletTx* pcoin : GetMaybeUnspentTxs(std::nullopt))
         {
-            const CWalletTx* pcoin = &entry.second;
             if (!CheckFinalTx(*pcoin) || (!pcoin->IsTrusted(std::nullopt) && pcoin->GetDepthInMainChain(std::nullopt) == 0))
                 nTotal += pcoin->GetAvailableCredit(std::nullopt);
         }
-    }
-    return nTotal;
+        return std::vector<CAmount>{nTotal};
+    })[0];
 }
 
 CAmount CWallet::GetImmatureBalance(const std::optional<int>& asOfHeight) const
@@ -5078,9 +5562,8 @@ CAmount CWallet::GetImmatureBalance(const std::optional<int>& asOfHeight) const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const CWalletTx* pcoin : GetMaybeUnspentTxs(asOfHeight))
         {
-            const CWalletTx* pcoin = &entry.second;
             nTotal += pcoin->GetImmatureCredit(asOfHeight);
         }
     }
@@ -5144,7 +5627,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins,
     vCoins.clear();
 
     {
-        for (const auto& [wtxid, pcoin] : mapWallet) {
+        for (const CWalletTx* pwtx : GetMaybeUnspentTxs(asOfHeight)) {
+            const CWalletTx& pcoin = *pwtx;
+            const uint256 wtxid = pcoin.GetHash();
             if (!CheckFinalTx(pcoin))
                 continue;
 
@@ -6067,6 +6552,33 @@ int64_t CWallet::GetOldestKeyPoolTime()
     return keypool.nTime;
 }
 
+/** The heap memory held by a witness cache, counting each list node. */
+template <typename Witness>
+static size_t WitnessCacheUsage(const std::list<Witness>& witnesses)
+{
+    return witnesses.size() * memusage::MallocUsage(sizeof(Witness) + 2 * sizeof(void*));
+}
+
+size_t CWallet::WalletTxUsage() const
+{
+    AssertLockHeld(cs_wallet);
+
+    size_t usage = memusage::DynamicUsage(mapWallet);
+    for (const auto& [txid, wtx] : mapWallet) {
+        usage += RecursiveDynamicUsage(static_cast<const CTransaction&>(wtx));
+        usage += memusage::DynamicUsage(wtx.mapValue);
+        usage += memusage::DynamicUsage(wtx.mapSproutNoteData);
+        for (const auto& [jsop, nd] : wtx.mapSproutNoteData) {
+            usage += WitnessCacheUsage(nd.witnesses);
+        }
+        usage += memusage::DynamicUsage(wtx.mapSaplingNoteData);
+        for (const auto& [op, nd] : wtx.mapSaplingNoteData) {
+            usage += WitnessCacheUsage(nd.witnesses);
+        }
+    }
+    return usage;
+}
+
 std::map<CTxDestination, CAmount> CWallet::GetAddressBalances(const std::optional<int>& asOfHeight)
 {
     map<CTxDestination, CAmount> balances;
@@ -6287,18 +6799,21 @@ void CWallet::LockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    MarkBalancesDirty();
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -6326,18 +6841,21 @@ void CWallet::LockNote(const JSOutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedSproutNotes
     setLockedSproutNotes.insert(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockNote(const JSOutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedSproutNotes
     setLockedSproutNotes.erase(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllSproutNotes()
 {
     AssertLockHeld(cs_wallet); // setLockedSproutNotes
     setLockedSproutNotes.clear();
+    MarkBalancesDirty();
 }
 
 bool CWallet::IsLockedNote(const JSOutPoint& outpt) const
@@ -6358,18 +6876,21 @@ void CWallet::LockNote(const SaplingOutPoint& output)
 {
     AssertLockHeld(cs_wallet);
     setLockedSaplingNotes.insert(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockNote(const SaplingOutPoint& output)
 {
     AssertLockHeld(cs_wallet);
     setLockedSaplingNotes.erase(output);
+    MarkBalancesDirty();
 }
 
 void CWallet::UnlockAllSaplingNotes()
 {
     AssertLockHeld(cs_wallet);
     setLockedSaplingNotes.clear();
+    MarkBalancesDirty();
 }
 
 bool CWallet::IsLockedNote(const SaplingOutPoint& output) const
@@ -6385,6 +6906,40 @@ std::vector<SaplingOutPoint> CWallet::ListLockedSaplingNotes()
     return vOutputs;
 }
 
+void CWallet::LockNote(const OrchardOutPoint& output)
+{
+    AssertLockHeld(cs_wallet);
+    setLockedOrchardNotes.insert(output);
+    MarkBalancesDirty();
+}
+
+void CWallet::UnlockNote(const OrchardOutPoint& output)
+{
+    AssertLockHeld(cs_wallet);
+    setLockedOrchardNotes.erase(output);
+    MarkBalancesDirty();
+}
+
+void CWallet::UnlockAllOrchardNotes()
+{
+    AssertLockHeld(cs_wallet);
+    setLockedOrchardNotes.clear();
+    MarkBalancesDirty();
+}
+
+bool CWallet::IsLockedNote(const OrchardOutPoint& output) const
+{
+    AssertLockHeld(cs_wallet);
+    return (setLockedOrchardNotes.count(output) > 0);
+}
+
+std::vector<OrchardOutPoint> CWallet::ListLockedOrchardNotes()
+{
+    AssertLockHeld(cs_wallet);
+    std::vector<OrchardOutPoint> vOutputs(setLockedOrchardNotes.begin(), setLockedOrchardNotes.end());
+    return vOutputs;
+}
+
 /** @} */ // end of Actions
 
 class CAffectedKeysVisitor {
@@ -6723,7 +7278,7 @@ bool CWallet::InitLoadWallet(const CChainParams& params, bool clearWitnessCaches
         LogPrintf("Default transparent address: %s\n", transparentAddr);
     }
 
-    RegisterValidationInterface(walletInstance);
+    RegisterValidationInterface(walletInstance, "wallet");
 
     // Check for Orchard note commitment tree corruption and trigger a rescan
     // if necessary.
@@ -6737,7 +7292,23 @@ bool CWallet::InitLoadWallet(const CChainParams& params, bool clearWitnessCaches
     // to happen automatically as a consequence of the genesis block (and subsequent
     // blocks) being added to the chain.
     CBlockIndex *pindexRescan = chainActive.Genesis();
-    if (clearWitnessCaches || GetBoolArg("-rescan", false)) {
+
+    // A rescan that was interrupted resumes from its last checkpoint.
+    CBlockIndex *pindexResume = nullptr;
+    bool fResumeInitScan = false;
+    {
+        CWalletDB walletdb(walletFile);
+        CBlockLocator locator;
+        if (walletdb.ReadRescanProgress(locator, fResumeInitScan)) {
+            pindexResume = FindForkInGlobalIndex(chainActive, locator);
+        }
+    }
+    if (pindexResume && fResumeInitScan && !clearWitnessCaches && orchardSpendable) {
+        // The checkpoint also moved the wallet's best block, so even a
+        // repeated -rescan carries on from there.
+        LogPrintf("InitLoadWallet: resuming interrupted rescan after block %d\n", pindexResume->nHeight);
+        pindexRescan = pindexResume;
+    } else if (clearWitnessCaches || GetBoolArg("-rescan", false)) {
         walletInstance->ClearNoteWitnessCache();
     } else {
         CWalletDB walletdb(walletFile);
@@ -6805,6 +7376,24 @@ bool CWallet::InitLoadWallet(const CChainParams& params, bool clearWitnessCaches
             }
         }
     }
+
+    // Finish a rescan for imported keys that was interrupted, unless the
+    // rescan above has already covered the blocks it had left.
+    if (pindexResume && fResumeInitScan && pindexRescan == chainActive.Tip()) {
+        CWalletDB(walletFile).EraseRescanProgress();
+    } else if (pindexResume && !fResumeInitScan) {
+        if (pindexRescan && pindexRescan->nHeight <= pindexResume->nHeight) {
+            CWalletDB(walletFile).EraseRescanProgress();
+        } else if (chainActive.Next(pindexResume)) {
+            LogPrintf("InitLoadWallet: resuming interrupted rescan after block %d\n", pindexResume->nHeight);
+            uiInterface.InitMessage(_("Rescanning..."));
+            if (!walletInstance->ScanForWalletTransactions(chainActive.Next(pindexResume), true, false).has_value()) {
+                return UIError(_("CWallet::InitLoadWallet: rescan interrupted due to shutdown request."));
+            }
+        } else {
+            CWalletDB(walletFile).EraseRescanProgress();
+        }
+    }
     walletInstance->SetBroadcastTransactions(GetBoolArg("-walletbroadcast", DEFAULT_WALLETBROADCAST));
 
     pwalletMain = walletInstance;
@@ -7067,8 +7656,10 @@ void CWallet::GetFilteredNotes(
     LOCK2(cs_main, cs_wallet);
 
     KeyIO keyIO(Params());
-    for (auto & p : mapWallet) {
-        CWalletTx wtx = p.second;
+    // Only transactions with Sprout or Sapling note data can contribute here;
+    // Orchard notes are read from the Orchard wallet below.
+    for (const uint256& txid : setNoteDataTxs) {
+        const CWalletTx& wtx = mapWallet.at(txid);
 
         // Filter the transactions before checking for notes
         if (!CheckFinalTx(wtx) ||
@@ -7206,6 +7797,11 @@ void CWallet::GetFilteredNotes(
             continue;
         }
 
+        // skip locked notes
+        if (ignoreLocked && IsLockedNote(noteMeta.GetOutPoint())) {
+            continue;
+        }
+
         auto wtx = GetWalletTx(noteMeta.GetOutPoint().hash);
         if (wtx) {
             auto confirmations = wtx->GetDepthInMainChain(asOfHeight);
@@ -33,6 +33,8 @@
 #include "base58.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <optional>
 #include <set>
@@ -457,6 +459,11 @@ typedef std::variant<
     libzcash::UnifiedAddressGenerationError,
     WalletUAGenerationError> WalletUAGenerationResult;
 
+typedef std::variant<
+    std::vector<std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>>,
+    libzcash::UnifiedAddressGenerationError,
+    WalletUAGenerationError> WalletUABatchGenerationResult;
+
 /**
  * A transaction with a bunch of additional info that only the owner cares about.
  * It includes any unrecorded transactions needed to link it back to the block chain.
@@ -1288,14 +1295,17 @@ public:
 
 protected:
     /**
-     * pindex is the new tip being connected.
+     * pindex is the new tip being connected. If pcompact is set, pblock holds
+     * no transactions, and the block's Orchard note commitments are taken from
+     * its shielded index entry instead.
      */
     void IncrementNoteWitnesses(
             const Consensus::Params& consensus,
             const CBlockIndex* pindex,
             const CBlock* pblock,
             MerkleFrontiers& frontiers,
-            bool performOrchardWalletUpdates
+            bool performOrchardWalletUpdates,
+            const CCompactShieldedBlock* pcompact = nullptr
             );
     /**
      * pindex is the old tip being disconnected.
@@ -1312,20 +1322,32 @@ protected:
             LogPrintf("SetBestChain(): Couldn't start atomic write\n");
             return;
         }
+        std::vector<uint256> vWrittenAtRest;
         try {
             LOCK(cs_wallet);
-            for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                auto wtx = wtxItem.second;
-                // We skip transactions for which mapSproutNoteData and mapSaplingNoteData
-                // are empty. This covers transactions that have no Sprout or Sapling data
-                // (i.e. are purely transparent), as well as shielding and unshielding
-                // transactions in which we only have transparent addresses involved.
-                if (!(wtx.mapSproutNoteData.empty() && wtx.mapSaplingNoteData.empty())) {
-                    if (!walletdb.WriteTx(wtx)) {
-                        LogPrintf("SetBestChain(): Failed to write CWalletTx, aborting atomic write\n");
-                        walletdb.TxnAbort();
-                        return;
-                    }
+            // We skip transactions for which mapSproutNoteData and mapSaplingNoteData
+            // are empty. This covers transactions that have no Sprout or Sapling data
+            // (i.e. are purely transparent), as well as shielding and unshielding
+            // transactions in which we only have transparent addresses involved.
+            for (const uint256& txid : setNoteDataTxs) {
+                const CWalletTx& wtx = mapWallet.at(txid);
+                if (wtx.mapSproutNoteData.empty() && wtx.mapSaplingNoteData.empty()) {
+                    continue;
+                }
+                // Once a transaction's witnesses have been dropped and written
+                // out, its witness state no longer changes from block to block.
+                bool fAtRest = IsNoteDataAtRest(wtx);
+                if (fAtRest && setNoteDataTxsAtRest.count(txid)) {
+                    continue;
+                }
+                setNoteDataTxsAtRest.erase(txid);
+                if (!walletdb.WriteTx(wtx)) {
+                    LogPrintf("SetBestChain(): Failed to write CWalletTx, aborting atomic write\n");
+                    walletdb.TxnAbort();
+                    return;
+                }
+                if (fAtRest) {
+                    vWrittenAtRest.push_back(txid);
                 }
             }
             // Add persistence of Orchard incremental witness tree
@@ -1357,6 +1379,10 @@ protected:
             LogPrintf("SetBestChain(): Couldn't commit atomic write\n");
             return;
         }
+        {
+            LOCK(cs_wallet);
+            setNoteDataTxsAtRest.insert(vWrittenAtRest.begin(), vWrittenAtRest.end());
+        }
     }
 
 private:
@@ -1366,7 +1392,14 @@ private:
             const CBlockIndex *pindex,
             const CBlock *pblock,
             MerkleFrontiers frontiers,
-            bool performOrchardWalletUpdates);
+            bool performOrchardWalletUpdates,
+            const CCompactShieldedBlock* pcompact = nullptr);
+    /**
+     * Whether any transaction of a block read from the shielded index may
+     * involve the wallet, so that the block has to be read in full. Orchard
+     * trial decryption has already been done when the entry was read.
+     */
+    bool CompactBlockMayInvolveMe(const CCompactShieldedBlock& block) const;
 
     /* Add a transparent secret key to the wallet. Internal use only. */
     CPubKey AddTransparentSecretKey(
@@ -1391,6 +1424,83 @@ protected:
      */
     OrchardWallet orchardWallet;
 
+    /**
+     * While a rescan is in progress, the Orchard note commitments of the
+     * blocks it applies are collected here and appended to orchardWallet's
+     * note commitment tree a chunk of blocks at a time. Guarded by cs_wallet.
+     */
+    std::optional<OrchardCommitmentBatch> orchardRescanBatch;
+
+    /** Append the Orchard note commitments collected by a rescan, if any. */
+    void FlushOrchardRescanBatch();
+
+    /**
+     * The transactions in mapWallet that have Sprout or Sapling note data, and
+     * so may be holding incremental witnesses. Only these are visited when the
+     * witness caches are moved on or back by a block, so that the per-block
+     * cost does not grow with the rest of the wallet. Guarded by cs_wallet.
+     */
+    std::set<uint256> setNoteDataTxs;
+
+    /**
+     * The transactions in setNoteDataTxs whose notes were no longer being
+     * witnessed when SetBestChain last wrote them, and which have not changed
+     * since. SetBestChain does not rewrite these. Guarded by cs_wallet.
+     */
+    std::set<uint256> setNoteDataTxsAtRest;
+
+    /** Whether none of the transaction's Sprout or Sapling notes is witnessed. */
+    static bool IsNoteDataAtRest(const CWalletTx& wtx) {
+        for (const auto& [_, nd] : wtx.mapSproutNoteData) {
+            if (!nd.witnesses.empty() || nd.witnessHeight != -1) return false;
+        }
+        for (const auto& [_, nd] : wtx.mapSaplingNoteData) {
+            if (!nd.witnesses.empty() || nd.witnessHeight != -1) return false;
+        }
+        return true;
+    }
+
+    /**
+     * The transactions in mapWallet that may still have an unspent transparent
+     * output of ours. A transaction is dropped from it lazily, once each of
+     * its outputs is either not ours or spent by a transaction buried too deep
+     * to be reorged out; a rescan that makes one of its outputs ours again
+     * adds it back through AddToWallet. Guarded by cs_wallet.
+     */
+    mutable std::set<uint256> setUnspentOutputTxs;
+
+    void IndexNoteData(const CWalletTx& wtx);
+    bool IsSpentBeyondReorg(const uint256& hash, unsigned int n) const;
+
+    /**
+     * Return, in txid order, the wallet transactions that may have a
+     * transparent output or a Sprout or Sapling note of ours that is unspent
+     * as of asOfHeight. This is every transaction when asOfHeight is set,
+     * since the indexes only describe the current chain.
+     */
+    std::vector<const CWalletTx*> GetMaybeUnspentTxs(const std::optional<int>& asOfHeight) const;
+
+    /**
+     * Record a newly generated unified address, so that it is recognized as
+     * the wallet's and can be re-derived after a restart.
+     */
+    void SaveUnifiedAddress(
+        const libzcash::ZcashdUnifiedFullViewingKey& ufvk,
+        const std::pair<libzcash::UnifiedAddress, libzcash::diversifier_index_t>& address,
+        const std::set<libzcash::ReceiverType>& receiverTypes,
+        CWalletDB* pwalletdb);
+
+    /**
+     * Balance query results, reused for as long as the wallet, the chain tip
+     * and the mempool are unchanged. nBalanceGeneration is bumped by every
+     * wallet event that can change a balance. Guarded by cs_wallet.
+     */
+    std::atomic<uint64_t> nBalanceGeneration{0};
+    mutable uint64_t nBalanceCacheGeneration{0};
+    mutable uint256 balanceCacheTip;
+    mutable unsigned int nBalanceCacheMempool{0};
+    mutable std::map<std::string, std::vector<CAmount>> mapBalanceCache;
+
     /**
      * The batch scanner for this wallet's CValidationInterface listener.
      *
@@ -1535,6 +1645,7 @@ public:
     std::set<COutPoint> setLockedCoins;
     std::set<JSOutPoint> setLockedSproutNotes;
     std::set<SaplingOutPoint> setLockedSaplingNotes;
+    std::set<OrchardOutPoint> setLockedOrchardNotes;
 
     int64_t nTimeFirstKey;
 
@@ -1672,6 +1783,12 @@ public:
     void UnlockAllSaplingNotes();
     std::vector<SaplingOutPoint> ListLockedSaplingNotes();
 
+    bool IsLockedNote(const OrchardOutPoint& output) const;
+    void LockNote(const OrchardOutPoint& output);
+    void UnlockNote(const OrchardOutPoint& output);
+    void UnlockAllOrchardNotes();
+    std::vector<OrchardOutPoint> ListLockedOrchardNotes();
+
     /**
      * keystore implementation
      * Generate a new key
@@ -1842,6 +1959,17 @@ public:
         const std::set<libzcash::ReceiverType>& receivers,
         std::optional<libzcash::diversifier_index_t> j = std::nullopt);
 
+    //! Generate `count` new unified addresses for the specified account and set
+    //! of receiver types, at the next unused diversifier indices.
+    //!
+    //! Orchard-only addresses are derived in parallel, as every diversifier
+    //! index yields one. The metadata for all of the addresses is written in a
+    //! single database transaction.
+    WalletUABatchGenerationResult GenerateUnifiedAddresses(
+        const libzcash::AccountId& accountId,
+        const std::set<libzcash::ReceiverType>& receivers,
+        size_t count);
+
     bool AddUnifiedFullViewingKey(const libzcash::UnifiedFullViewingKey &ufvk);
 
     bool LoadUnifiedFullViewingKey(const libzcash::UnifiedFullViewingKey &ufvk);
@@ -1893,6 +2021,21 @@ public:
     WalletDecryptedNotes TryDecryptShieldedOutputs(const CTransaction& tx);
 
     void MarkDirty();
+
+    /** Discard the cached balances; see GetCachedBalances. */
+    void MarkBalancesDirty() {
+        nBalanceGeneration++;
+    }
+
+    /**
+     * Return the amounts `compute` returns for the query named by `key`,
+     * calling it only if the wallet, the chain tip or the mempool has changed
+     * since the same query was last answered. Queries as of a fixed height
+     * should be answered directly instead.
+     */
+    std::vector<CAmount> GetCachedBalances(
+            const std::string& key,
+            const std::function<std::vector<CAmount>()>& compute) const;
     bool UpdateNullifierNoteMap();
     void UpdateNullifierNoteMapWithTx(const CWalletTx& wtx);
     void UpdateSaplingNullifierNoteMapWithTx(CWalletTx& wtx);
@@ -2106,6 +2249,19 @@ public:
         return setKeyPool.size();
     }
 
+    /**
+     * An estimate of the heap memory held by the wallet's transactions,
+     * including their Sprout and Sapling note data and witness caches.
+     */
+    size_t WalletTxUsage() const;
+
+    /** An estimate of the heap memory held by the Orchard wallet's note data. */
+    size_t OrchardNoteDataUsage() const
+    {
+        AssertLockHeld(cs_wallet);
+        return orchardWallet.NoteDataUsage();
+    }
+
     bool SetDefaultKey(const CPubKey &vchPubKey);
 
     //! signify that a particular wallet feature is now used. this may change nWalletVersion and nWalletMaxVersion if those are lower
@@ -23,6 +23,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 #include <atomic>
+#include <future>
 #include <string>
 
 using namespace std;
@@ -286,6 +287,27 @@ bool CWalletDB::ReadBestBlock(CBlockLocator& locator)
     return Read(std::string("bestblock_nomerkle"), locator);
 }
 
+bool CWalletDB::WriteRescanProgress(const CBlockLocator& locator, bool fInitScan)
+{
+    nWalletDBUpdateCounter++;
+    return Write(std::string("rescanprogress"), std::make_pair(fInitScan, locator));
+}
+
+bool CWalletDB::ReadRescanProgress(CBlockLocator& locator, bool& fInitScan)
+{
+    std::pair<bool, CBlockLocator> progress;
+    if (!Read(std::string("rescanprogress"), progress)) return false;
+    fInitScan = progress.first;
+    locator = progress.second;
+    return true;
+}
+
+bool CWalletDB::EraseRescanProgress()
+{
+    nWalletDBUpdateCounter++;
+    return Erase(std::string("rescanprogress"));
+}
+
 bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
 {
     nWalletDBUpdateCounter++;
@@ -361,6 +383,57 @@ public:
     }
 };
 
+/**
+ * Deserialize and check the value of a "tx" record whose type has already
+ * been read from ssKey. This touches no wallet state, so LoadWallet runs it
+ * on several records at once.
+ */
+static bool
+ReadWalletTx(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx,
+             bool& fUpgraded, string& strErr)
+{
+    fUpgraded = false;
+    try {
+        uint256 hash;
+        ssKey >> hash;
+        ssValue >> wtx;
+        CValidationState state;
+        auto verifier = ProofVerifier::Strict();
+        if (!(
+            CheckTransaction(wtx, state, verifier) &&
+            (wtx.GetHash() == hash) &&
+            state.IsValid())
+        ) {
+            return false;
+        }
+
+        // Undo serialize changes in 31600
+        if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+        {
+            if (!ssValue.empty())
+            {
+                char fTmp;
+                char fUnused;
+                std::string unused_string;
+                ssValue >> fTmp >> fUnused >> unused_string;
+                strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                                   wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = fTmp;
+            }
+            else
+            {
+                strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+                wtx.fTimeReceivedIsTxTime = 0;
+            }
+            fUpgraded = true;
+        }
+    } catch (...)
+    {
+        return false;
+    }
+    return true;
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, string& strType, string& strErr)
@@ -386,41 +459,13 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            auto verifier = ProofVerifier::Strict();
-            if (!(
-                CheckTransaction(wtx, state, verifier) &&
-                (wtx.GetHash() == hash) &&
-                state.IsValid())
-            ) {
+            bool fUpgraded;
+            if (!ReadWalletTx(ssKey, ssValue, wtx, fUpgraded, strErr)) {
                 return false;
             }
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    std::string unused_string;
-                    ssValue >> fTmp >> fUnused >> unused_string;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
+            if (fUpgraded)
+                wss.vWalletUpgrade.push_back(wtx.GetHash());
             if (wtx.nOrderPos == -1)
                 wss.fAnyUnordered = true;
 
@@ -944,6 +989,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        std::vector<std::pair<CDataStream, CDataStream>> vTxRecords;
         while (true)
         {
             // Read next record
@@ -958,8 +1004,18 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
-            // Try to be tolerant of single corrupt records:
+            // Transaction records make up most of a large wallet, and
+            // checking them does not depend on anything else in it, so they
+            // are set aside and decoded in parallel once the cursor is done.
             string strType, strErr;
+            CDataStream ssType(ssKey);
+            ssType >> strType;
+            if (strType == "tx") {
+                vTxRecords.emplace_back(std::move(ssType), std::move(ssValue));
+                continue;
+            }
+
+            // Try to be tolerant of single corrupt records:
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
             {
                 if (strType == "networkinfo") {
@@ -984,6 +1040,50 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
         pcursor->close();
 
+        // Each worker decodes a contiguous range of the records, and the
+        // results are then loaded in cursor order.
+        size_t nWorkers = std::max<size_t>(std::min<size_t>(GetNumCores(), vTxRecords.size()), 1);
+        std::vector<CWalletTx> vTxs(vTxRecords.size());
+        std::vector<char> vTxOk(vTxRecords.size());
+        std::vector<char> vTxUpgraded(vTxRecords.size());
+        std::vector<string> vTxErrs(vTxRecords.size());
+        auto readRange = [&](size_t nBegin, size_t nEnd) {
+            for (size_t i = nBegin; i < nEnd; i++) {
+                bool fUpgraded;
+                vTxOk[i] = ReadWalletTx(vTxRecords[i].first, vTxRecords[i].second, vTxs[i], fUpgraded, vTxErrs[i]);
+                vTxUpgraded[i] = fUpgraded;
+            }
+        };
+        std::vector<std::future<void>> vWorkers;
+        for (size_t i = 1; i < nWorkers; i++) {
+            vWorkers.push_back(std::async(std::launch::async, readRange,
+                i * vTxRecords.size() / nWorkers, (i + 1) * vTxRecords.size() / nWorkers));
+        }
+        readRange(0, vTxRecords.size() / nWorkers);
+        for (auto& worker : vWorkers) {
+            worker.get();
+        }
+        vTxRecords.clear();
+
+        for (size_t i = 0; i < vTxs.size(); i++) {
+            if (!vTxOk[i]) {
+                // Rescan if there is a bad transaction record:
+                fNoncriticalErrors = true;
+                LogPrintf("LoadWallet: Malformed transaction data encountered; starting with -rescan.");
+                SoftSetBoolArg("-rescan", true);
+            } else {
+                if (vTxUpgraded[i])
+                    wss.vWalletUpgrade.push_back(vTxs[i].GetHash());
+                if (vTxs[i].nOrderPos == -1)
+                    wss.fAnyUnordered = true;
+                pwallet->LoadWalletTx(vTxs[i]);
+            }
+            if (!vTxErrs[i].empty())
+                LogPrintf("LoadWallet: %s", vTxErrs[i]);
+            // Release each decoded transaction once the wallet has its copy.
+            vTxs[i] = CWalletTx();
+        }
+
         // Load unified address/account/key caches based on what was loaded
         if (!pwallet->LoadCaches()) {
             // We can be more permissive of certain kinds of failures during
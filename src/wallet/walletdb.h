@@ -425,6 +425,13 @@ public:
     bool WriteBestBlock(const CBlockLocator& locator);
     bool ReadBestBlock(CBlockLocator& locator);
 
+    /// Record how far a rescan has got, so that it can be resumed if it is
+    /// interrupted. fInitScan is set for a rescan that also rebuilds the
+    /// wallet's note commitment trees, as a -rescan at startup does.
+    bool WriteRescanProgress(const CBlockLocator& locator, bool fInitScan);
+    bool ReadRescanProgress(CBlockLocator& locator, bool& fInitScan);
+    bool EraseRescanProgress();
+
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
     bool WriteDefaultKey(const CPubKey& vchPubKey);
@@ -45,8 +45,10 @@ class WeightedMap
     // its weight, and the sum of the weights of all its descendants.
     std::vector<Node> nodes;
 
-    // The following map is to simplify removal.
+    // The following map is to simplify removal. It is not kept up to date in
+    // a copy made by samplingCopy().
     std::map<K, size_t> indexMap;
+    bool indexed = true;
 
     static inline size_t leftChild(size_t i) { return i*2 + 1; }
     static inline size_t rightChild(size_t i) { return i*2 + 2; }
@@ -56,9 +58,9 @@ public:
     // Check internal invariants (for tests).
     void checkInvariants() const
     {
-        assert(indexMap.size() == nodes.size());
+        assert(!indexed || indexMap.size() == nodes.size());
         for (size_t i = 0; i < nodes.size(); i++) {
-            assert(indexMap.at(nodes.at(i).key) == i);
+            assert(!indexed || indexMap.at(nodes.at(i).key) == i);
             assert(nodes.at(i).sumOfDescendantWeights == getWeightAt(leftChild(i)) + getWeightAt(rightChild(i)));
         }
     }
@@ -102,6 +104,33 @@ private:
         return findByWeight(rightChild(fromIndex), weightToFind - rightWeight);
     }
 
+    // Remove the entry at the given index, moving the last entry into its place.
+    void removeAt(size_t removeIndex)
+    {
+        K removeKey = nodes.at(removeIndex).key;
+
+        size_t lastIndex = nodes.size()-1;
+        Node lastNode = nodes.at(lastIndex);
+        W weightDelta = lastNode.weight - nodes.at(removeIndex).weight;
+        backPropagate(lastIndex, -lastNode.weight);
+
+        if (removeIndex < lastIndex) {
+            nodes[removeIndex].key = lastNode.key;
+            nodes[removeIndex].value = lastNode.value;
+            nodes[removeIndex].weight = lastNode.weight;
+            // nodes[removeIndex].sumOfDescendantWeights should not change here.
+            if (indexed) {
+                indexMap[lastNode.key] = removeIndex;
+            }
+            backPropagate(removeIndex, weightDelta);
+        }
+
+        if (indexed) {
+            indexMap.erase(removeKey);
+        }
+        nodes.pop_back();
+    }
+
 public:
     WeightedMap() {}
 
@@ -123,12 +152,24 @@ public:
         return nodes.size();
     }
 
+    // Return a copy of this map from which entries can only be taken with
+    // takeRandom(). This is cheaper than a full copy because the index by key
+    // is not copied.
+    WeightedMap samplingCopy() const
+    {
+        WeightedMap copy;
+        copy.nodes = nodes;
+        copy.indexed = false;
+        return copy;
+    }
+
     // Return false if the key already exists in the map.
     // Otherwise, add an entry mapping `key` to `value` with the given weight,
     // and return true. The weight must be positive.
     bool add(K key, V value, W weight)
     {
         assert(W() < weight);
+        assert(indexed);
         if (indexMap.count(key) > 0) {
             return false;
         }
@@ -148,30 +189,14 @@ public:
     // Otherwise, remove that key's entry and return its associated value.
     std::optional<V> remove(K key)
     {
+        assert(indexed);
         auto it = indexMap.find(key);
         if (it == indexMap.end()) {
             return std::nullopt;
         }
 
-        size_t removeIndex = it->second;
-        V removeValue = nodes.at(removeIndex).value;
-
-        size_t lastIndex = nodes.size()-1;
-        Node lastNode = nodes.at(lastIndex);
-        W weightDelta = lastNode.weight - nodes.at(removeIndex).weight;
-        backPropagate(lastIndex, -lastNode.weight);
-
-        if (removeIndex < lastIndex) {
-            nodes[removeIndex].key = lastNode.key;
-            nodes[removeIndex].value = lastNode.value;
-            nodes[removeIndex].weight = lastNode.weight;
-            // nodes[removeIndex].sumOfDescendantWeights should not change here.
-            indexMap[lastNode.key] = removeIndex;
-            backPropagate(removeIndex, weightDelta);
-        }
-
-        indexMap.erase(it);
-        nodes.pop_back();
+        V removeValue = nodes.at(it->second).value;
+        removeAt(it->second);
         return removeValue;
     }
 
@@ -191,7 +216,7 @@ public:
         assert(index < nodes.size());
         const Node& drop = nodes.at(index);
         auto res = std::make_tuple(drop.key, drop.value, drop.weight); // copy values
-        remove(drop.key);
+        removeAt(index);
         return res;
     }
 };
@@ -1,5 +1,6 @@
+#include <future>
 #include <stdexcept>
-
+#include <thread>
 
 #include "zcash/IncrementalMerkleTree.hpp"
 #include "crypto/sha256.h"
@@ -977,6 +978,90 @@ void IncrementalMerkleTree<Depth, Hash>::append(Hash obj) {
     }
 }
 
+// Below this many combines per thread, a level is cheaper to hash on the
+// calling thread than to hand out to workers.
+static const size_t MIN_COMBINES_PER_WORKER = 64;
+
+// Combines adjacent pairs of nodes at the given depth.
+template<typename Hash>
+static std::vector<Hash> combine_level(const std::vector<Hash>& nodes, size_t depth) {
+    std::vector<Hash> combined(nodes.size() / 2);
+    auto combineRange = [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; i++) {
+            combined[i] = Hash::combine(nodes[2*i], nodes[2*i+1], depth);
+        }
+    };
+
+    size_t nWorkers = std::max(
+        std::min((size_t)std::thread::hardware_concurrency(), combined.size() / MIN_COMBINES_PER_WORKER),
+        (size_t)1);
+    size_t chunkSize = (combined.size() + nWorkers - 1) / nWorkers;
+    std::vector<std::future<void>> workers;
+    for (size_t w = 1; w < nWorkers; w++) {
+        size_t start = std::min(w * chunkSize, combined.size());
+        size_t end = std::min(start + chunkSize, combined.size());
+        workers.push_back(std::async(std::launch::async, combineRange, start, end));
+    }
+    combineRange(0, std::min(chunkSize, combined.size()));
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    return combined;
+}
+
+template<size_t Depth, typename Hash>
+void IncrementalMerkleTree<Depth, Hash>::append_batch(const std::vector<Hash>& objs) {
+    if (objs.empty()) {
+        return;
+    }
+    if (is_complete(Depth) || objs.size() > ((size_t)1 << Depth) - size()) {
+        throw std::runtime_error("tree is full");
+    }
+
+    // The leaves that have not been combined yet: the current last pair,
+    // followed by the batch.
+    std::vector<Hash> level;
+    level.reserve(objs.size() + 2);
+    if (left) {
+        level.push_back(*left);
+    }
+    if (right) {
+        level.push_back(*right);
+    }
+    level.insert(level.end(), objs.begin(), objs.end());
+
+    // As with append(), the last pair of leaves is left uncombined.
+    size_t lastPair = (level.size() - 1) / 2;
+    left = level[2 * lastPair];
+    if (2 * lastPair + 1 < level.size()) {
+        right = level[2 * lastPair + 1];
+    } else {
+        right = std::nullopt;
+    }
+    level.resize(2 * lastPair);
+    level = combine_level(level, 0);
+
+    // Carry each level into the parents, which hold the collapsed left
+    // subtree (if any) that is waiting for its right sibling.
+    for (size_t i = 0; !level.empty(); i++) {
+        assert(i < Depth);
+        if (i == parents.size()) {
+            parents.push_back(std::nullopt);
+        }
+        if (parents[i]) {
+            level.insert(level.begin(), *parents[i]);
+        }
+        if (level.size() % 2 == 1) {
+            parents[i] = level.back();
+            level.pop_back();
+        } else {
+            parents[i] = std::nullopt;
+        }
+        level = combine_level(level, i+1);
+    }
+}
+
 // This is for allowing the witness to determine if a subtree has filled
 // to a particular depth, or for append() to ensure we're not appending
 // to a full tree.
@@ -173,6 +173,10 @@ public:
     std::optional<Hash> complete_subtree_root() const;
 
     void append(Hash obj);
+    //! Appends the leaves in order, producing the same tree as calling
+    //! append() on each of them. Each level of the tree is hashed in one
+    //! pass over the batch, spread across threads when the level is large.
+    void append_batch(const std::vector<Hash>& objs);
     Hash root() const {
         return root(Depth, std::deque<Hash>());
     }
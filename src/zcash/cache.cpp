@@ -3,20 +3,117 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "zcash/cache.h"
+#include "random.h"
 #include "util/system.h"
 
+#include <mutex>
+
 namespace libzcash
 {
+namespace {
+std::mutex cs_validityCaches;
+std::map<std::string, SavedValidityCache> mapStashedCaches;
+std::map<std::string, const BundleValidityCache*> mapBundleCaches;
+}
+
+void StashValidityCache(const std::string& kind, SavedValidityCache saved)
+{
+    std::lock_guard<std::mutex> lock(cs_validityCaches);
+    mapStashedCaches[kind] = std::move(saved);
+}
+
+std::optional<SavedValidityCache> TakeValidityCache(const std::string& kind)
+{
+    std::lock_guard<std::mutex> lock(cs_validityCaches);
+    auto it = mapStashedCaches.find(kind);
+    if (it == mapStashedCaches.end()) {
+        return std::nullopt;
+    }
+    SavedValidityCache saved = std::move(it->second);
+    mapStashedCaches.erase(it);
+    return saved;
+}
+
+BundleValidityCache::~BundleValidityCache()
+{
+    std::lock_guard<std::mutex> lock(cs_validityCaches);
+    for (auto it = mapBundleCaches.begin(); it != mapBundleCaches.end(); ++it) {
+        if (it->second == this) {
+            mapBundleCaches.erase(it);
+            break;
+        }
+    }
+}
+
+std::array<uint8_t, 32> BundleValidityCache::nonce() const
+{
+    std::array<uint8_t, 32> result;
+    std::copy(salt.begin(), salt.end(), result.begin());
+    return result;
+}
+
+void BundleValidityCache::insert(BundleCacheEntry e)
+{
+    cache::insert(e);
+}
+
+bool BundleValidityCache::contains(const BundleCacheEntry& e, bool erase) const
+{
+    bool fFound = cache::contains(e, erase);
+    (fFound ? nHits : nMisses).fetch_add(1, std::memory_order_relaxed);
+    return fFound;
+}
+
+void BundleValidityCache::GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const
+{
+    nHitsOut = nHits.load();
+    nMissesOut = nMisses.load();
+}
+
+SavedValidityCache BundleValidityCache::Save() const
+{
+    SavedValidityCache saved;
+    saved.salt = salt;
+    for_each([&](const BundleCacheEntry& e) {
+        uint256 entry;
+        std::copy(e.begin(), e.end(), entry.begin());
+        saved.entries.push_back(entry);
+    });
+    return saved;
+}
+
 std::unique_ptr<BundleValidityCache> NewBundleValidityCache(rust::Str kind, size_t nMaxCacheSize)
 {
-    auto cache = std::unique_ptr<BundleValidityCache>(new BundleValidityCache());
+    std::string strKind(kind.data(), kind.size());
+    std::optional<SavedValidityCache> saved = TakeValidityCache(strKind);
+    uint256 salt;
+    if (saved.has_value()) {
+        salt = saved->salt;
+    } else {
+        GetRandBytes(salt.begin(), salt.size());
+    }
+
+    auto cache = std::unique_ptr<BundleValidityCache>(new BundleValidityCache(salt));
     size_t nElems = cache->setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu requested for %s bundle cache, able to store %zu elements\n",
               (nElems * sizeof(BundleCacheEntry)) >> 20, nMaxCacheSize >> 20, kind, nElems);
+    if (saved.has_value()) {
+        for (const uint256& entry : saved->entries) {
+            BundleCacheEntry e;
+            std::copy(entry.begin(), entry.end(), e.begin());
+            cache->insert(e);
+        }
+        LogPrintf("Restored %zu entries to the %s bundle cache\n", saved->entries.size(), kind);
+    }
+
+    std::lock_guard<std::mutex> lock(cs_validityCaches);
+    mapBundleCaches[strKind] = cache.get();
     return cache;
 }
-} // namespace libzcash
 
-// Explicit instantiations for libzcash::BundleValidityCache
-template void libzcash::BundleValidityCache::insert(libzcash::BundleCacheEntry e);
-template bool libzcash::BundleValidityCache::contains(const libzcash::BundleCacheEntry& e, const bool erase) const;
+std::map<std::string, const BundleValidityCache*> GetBundleValidityCaches()
+{
+    std::lock_guard<std::mutex> lock(cs_validityCaches);
+    return mapBundleCaches;
+}
+} // namespace libzcash
@@ -6,10 +6,17 @@
 #define ZCASH_ZCASH_CACHE_H
 
 #include "cuckoocache.h"
+#include "serialize.h"
+#include "uint256.h"
 
 #include <rust/cxx.h>
 
 #include <array>
+#include <atomic>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace libzcash
 {
@@ -36,9 +43,60 @@ public:
     }
 };
 
-typedef CuckooCache::cache<BundleCacheEntry, BundleCacheHasher> BundleValidityCache;
+/**
+ * The salt and live entries of a validity cache, as saved on shutdown. A
+ * cache created with the same salt computes the same entries, so it still
+ * recognises what it had verified before the restart.
+ */
+struct SavedValidityCache
+{
+    uint256 salt;
+    std::vector<uint256> entries;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(salt);
+        READWRITE(entries);
+    }
+};
+
+/** Keep a saved cache for the cache of the same kind, which has not been created yet */
+void StashValidityCache(const std::string& kind, SavedValidityCache saved);
+/** Take the saved cache stashed for a cache of this kind, if any */
+std::optional<SavedValidityCache> TakeValidityCache(const std::string& kind);
+
+/**
+ * The validity cache of one shielded pool's bundles. The Rust side hashes the
+ * salt into every entry; it is kept here so that the cache can be saved.
+ */
+class BundleValidityCache : public CuckooCache::cache<BundleCacheEntry, BundleCacheHasher>
+{
+private:
+    uint256 salt;
+    mutable std::atomic<uint64_t> nHits{0};
+    mutable std::atomic<uint64_t> nMisses{0};
+
+public:
+    explicit BundleValidityCache(const uint256& saltIn) : salt(saltIn) {}
+    ~BundleValidityCache();
+
+    /** The salt, for the Rust side to hash into entries */
+    std::array<uint8_t, 32> nonce() const;
+
+    void insert(BundleCacheEntry e);
+    bool contains(const BundleCacheEntry& e, bool erase) const;
+
+    void GetStats(uint64_t& nHitsOut, uint64_t& nMissesOut) const;
+    /** The salt and the entries not marked for erasure. Validation must have stopped. */
+    SavedValidityCache Save() const;
+};
 
 std::unique_ptr<BundleValidityCache> NewBundleValidityCache(rust::Str kind, size_t nMaxCacheSize);
+
+/** The bundle validity caches created so far, by kind. They live until exit. */
+std::map<std::string, const BundleValidityCache*> GetBundleValidityCaches();
 } // namespace libzcash
 
 #endif // ZCASH_ZCASH_CACHE_H
@@ -3,6 +3,9 @@
 #include <map>
 #include <thread>
 #include <unistd.h>
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
 
 #include "coins.h"
 #include "util/system.h"
@@ -26,6 +29,7 @@
 #include "transaction_builder.h"
 #include "txdb.h"
 #include "util/test.h"
+#include "validation_stats.h"
 #include "wallet/wallet.h"
 
 #include "zcbenchmarks.h"
@@ -279,6 +283,30 @@ double benchmark_large_tx(size_t nInputs)
 // create a transaction using a key not in our original list of n, and then
 // check that the transaction is not associated with any of the keys in our
 // wallet. We call assert(...) to ensure that this is true.
+double benchmark_build_transparent_tx(size_t nInputs)
+{
+    CBasicKeyStore keystore;
+    CKey tsk = CKey::TestOnlyRandomKey(true);
+    keystore.AddKey(tsk);
+    auto scriptPubKey = GetScriptForDestination(tsk.GetPubKey().GetID());
+
+    // Spend every input to a single output, leaving only the fee.
+    auto builder = TransactionBuilder(Params(), 1, uint256(), SaplingMerkleTree::empty_root(), &keystore);
+    builder.SetFee(10000);
+    for (size_t i = 0; i < nInputs; i++) {
+        builder.AddTransparentInput(COutPoint(uint256S("1234"), i), scriptPubKey, 1000000);
+    }
+    builder.AddTransparentOutput(tsk.GetPubKey().GetID(), nInputs * 1000000 - 10000);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+
+    auto result = builder.Build();
+    assert(result.IsTx());
+
+    return timer_stop(tv_start);
+}
+
 double benchmark_try_decrypt_sprout_notes(size_t nKeys)
 {
     CWallet wallet(Params());
@@ -320,6 +348,39 @@ double benchmark_try_decrypt_sapling_notes(size_t nKeys)
     return timer_stop(tv_start);
 }
 
+double benchmark_try_decrypt_orchard_notes(size_t nKeys)
+{
+    RawHDSeed seed(32, 0);
+    GetRandBytes(seed.data(), seed.size());
+    auto coinType = Params().BIP44CoinType();
+
+    OrchardWallet orchardWallet;
+    for (int i = 0; i < nKeys; i++) {
+        orchardWallet.AddSpendingKey(libzcash::OrchardSpendingKey::ForAccount(seed, coinType, i));
+    }
+
+    // Pay an address whose key has not been added to the wallet
+    auto to = libzcash::OrchardSpendingKey::ForAccount(seed, coinType, nKeys)
+        .ToFullViewingKey()
+        .GetChangeAddress();
+    auto builder = orchard::Builder(false, OrchardMerkleFrontier::empty_root());
+    builder.AddOutput(std::nullopt, to, 10, std::nullopt);
+
+    CMutableTransaction mtx;
+    mtx.fOverwintered = true;
+    mtx.nVersionGroupId = ZIP225_VERSION_GROUP_ID;
+    mtx.nVersion = ZIP225_TX_VERSION;
+    mtx.nConsensusBranchId = NetworkUpgradeInfo[Consensus::UPGRADE_NU5].nBranchId;
+    mtx.orchardBundle = builder.Build().value().ProveAndSign({}, uint256()).value();
+    CTransaction tx(mtx);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    auto txMeta = orchardWallet.AddNotesIfInvolvingMe(tx);
+    assert(!txMeta.has_value());
+    return timer_stop(tv_start);
+}
+
 CWalletTx CreateSproutTxWithNoteData(const libzcash::SproutSpendingKey& sk) {
     auto wtx = GetValidSproutReceive(sk, 10, true);
     auto note = GetSproutNote(sk, wtx, 0, 1);
@@ -670,6 +731,35 @@ double benchmark_connectblock_sapling()
     return duration;
 }
 
+// Average time per block to extend the history tree (ZIP 221) of the
+// current epoch, with each block in its own view flushed into a view of the
+// chain tip, as ConnectBlock does.
+double benchmark_history_tree_update(size_t nBlocks)
+{
+    auto nHeight = chainActive.Height() + 1;
+    auto epochId = CurrentEpochBranchId(nHeight, Params().GetConsensus());
+    // Discarded afterwards, so that the node's chain state is not changed.
+    CCoinsViewCache tip(pcoinsTip);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nBlocks; i++) {
+        CCoinsViewCache view(&tip);
+        view.PushHistoryNode(epochId, libzcash::NewV2Leaf(
+            GetRandHash(),
+            GetTime(),
+            0x200f0f0f,
+            SaplingMerkleTree::empty_root(),
+            OrchardMerkleFrontier::empty_root(),
+            GetRandHash(),
+            nHeight + i,
+            0,
+            0));
+        view.Flush();
+    }
+    return timer_stop(tv_start) / nBlocks;
+}
+
 double benchmark_connectblock_orchard()
 {
     // Test for slowness encountered on 2022-06-20
@@ -716,6 +806,93 @@ double benchmark_connectblock_orchard()
     return duration;
 }
 
+// Reconnects the blocks of the active chain from nStartHeight to nEndHeight,
+// as read from disk, to a copy of the coins view rewound to just below them,
+// so that dbcache, -par and batch validation changes can be measured against
+// real blocks. The rewound view is discarded afterwards. Should be run on a
+// copy of a datadir with networking disabled, so nothing else touches the
+// chain state meanwhile.
+double benchmark_replay_blocks(int nStartHeight, int nEndHeight, UniValue& details)
+{
+    AssertLockHeld(cs_main);
+    const CChainParams& chainparams = Params();
+
+    static const ValidationPhase phases[] = {
+        VALIDATION_PHASE_INPUTS,
+        VALIDATION_PHASE_SCRIPTS,
+        VALIDATION_PHASE_SAPLING,
+        VALIDATION_PHASE_ORCHARD,
+        VALIDATION_PHASE_UNDO,
+    };
+    std::map<ValidationPhase, int64_t> phaseStart;
+    for (auto phase : phases) {
+        phaseStart[phase] = GetValidationPhaseStats(phase).nSumMicros;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    CCoinsViewCache rewound(pcoinsTip);
+    if (!RewindCoinsView(chainparams, rewound, chainActive[nStartHeight - 1]))
+        throw std::runtime_error("Failed to rewind the coins view");
+    int64_t nTimeRewind = GetTimeMicros() - nTimeStart;
+
+    CCoinsViewCache view(&rewound);
+    size_t nPeakCacheUsage = 0;
+    uint64_t nTransactions = 0;
+    int64_t nTimeRead = 0;
+    int64_t nTimeConnect = 0;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (int nHeight = nStartHeight; nHeight <= nEndHeight; nHeight++) {
+        CBlockIndex* pindex = chainActive[nHeight];
+        CBlock block;
+        int64_t nTime1 = GetTimeMicros();
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            throw std::runtime_error(strprintf("Failed to read block %d from disk", nHeight));
+        int64_t nTime2 = GetTimeMicros();
+        CValidationState state;
+        if (!ConnectBlock(block, state, pindex, view, chainparams))
+            throw std::runtime_error(strprintf("Failed to connect block %d: %s", nHeight, FormatStateMessage(state)));
+        int64_t nTime3 = GetTimeMicros();
+
+        nTimeRead += nTime2 - nTime1;
+        nTimeConnect += nTime3 - nTime2;
+        nTransactions += block.vtx.size();
+        nPeakCacheUsage = std::max(nPeakCacheUsage, rewound.DynamicMemoryUsage() + view.DynamicMemoryUsage());
+    }
+    double duration = timer_stop(tv_start);
+    int nBlocks = nEndHeight - nStartHeight + 1;
+
+    UniValue phaseTimes(UniValue::VOBJ);
+    phaseTimes.pushKV("rewind", nTimeRewind * 0.000001);
+    phaseTimes.pushKV("read", nTimeRead * 0.000001);
+    phaseTimes.pushKV("connect", nTimeConnect * 0.000001);
+    for (auto phase : phases) {
+        int64_t nMicros = GetValidationPhaseStats(phase).nSumMicros - phaseStart[phase];
+        phaseTimes.pushKV(ValidationPhaseName(phase), nMicros * 0.000001);
+    }
+
+    details.pushKV("blocks", nBlocks);
+    details.pushKV("transactions", nTransactions);
+    details.pushKV("blockspersecond", duration > 0 ? nBlocks / duration : 0.0);
+    details.pushKV("txpersecond", duration > 0 ? nTransactions / duration : 0.0);
+    details.pushKV("phases", phaseTimes);
+    details.pushKV("peakcacheusage", (uint64_t)nPeakCacheUsage);
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Kilobytes on Linux, bytes on macOS.
+#ifdef MAC_OSX
+        details.pushKV("peakrss", (int64_t)usage.ru_maxrss);
+#else
+        details.pushKV("peakrss", (int64_t)usage.ru_maxrss * 1024);
+#endif
+    }
+#endif
+
+    return duration;
+}
+
 extern UniValue getnewaddress(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue sendtoaddress(const UniValue& params, bool fHelp);
 
@@ -757,6 +934,75 @@ double benchmark_listunspent()
     return timer_stop(tv_start);
 }
 
+extern UniValue z_listunspent(const UniValue& params, bool fHelp);
+extern UniValue z_getbalanceforaccount(const UniValue& params, bool fHelp);
+
+static std::vector<libzcash::AccountId> wallet_accounts()
+{
+    LOCK(pwalletMain->cs_wallet);
+    std::vector<libzcash::AccountId> accounts;
+    for (const auto& [acctKey, ufvkId] : pwalletMain->mapUnifiedAccountKeys) {
+        accounts.push_back(acctKey.second);
+    }
+    return accounts;
+}
+
+double benchmark_z_listunspent()
+{
+    UniValue params(UniValue::VARR);
+    struct timeval tv_start;
+    timer_start(tv_start);
+    auto unspent = z_listunspent(params, false);
+    return timer_stop(tv_start);
+}
+
+double benchmark_getbalanceforaccounts()
+{
+    auto accounts = wallet_accounts();
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (auto account : accounts) {
+        UniValue params(UniValue::VARR);
+        params.push_back((int64_t)account);
+        auto balance = z_getbalanceforaccount(params, false);
+    }
+    return timer_stop(tv_start);
+}
+
+double benchmark_select_notes()
+{
+    auto accounts = wallet_accounts();
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (auto account : accounts) {
+        auto selector = pwalletMain->ZTXOSelectorForAccount(
+                account, true, TransparentCoinbasePolicy::Disallow);
+        if (!selector.has_value()) continue;
+        auto spendable = pwalletMain->FindSpendableInputs(selector.value(), 1, std::nullopt);
+        // Select enough notes for half of the account's funds, which makes
+        // the selection walk a realistic fraction of the account's notes.
+        spendable.LimitToAmount(spendable.Total() / 2, 0, {libzcash::OutputPool::Orchard});
+    }
+    return timer_stop(tv_start);
+}
+
+double benchmark_setbestchain()
+{
+    auto locator = chainActive.GetLocator();
+    struct timeval tv_start;
+    timer_start(tv_start);
+    pwalletMain->SetBestChain(locator);
+    return timer_stop(tv_start);
+}
+
+double benchmark_rescan_wallet()
+{
+    struct timeval tv_start;
+    timer_start(tv_start);
+    pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), false, false);
+    return timer_stop(tv_start);
+}
+
 double benchmark_create_sapling_spend()
 {
     auto sk = libzcash::SaplingSpendingKey::random();
@@ -818,6 +1064,32 @@ double benchmark_create_sapling_output()
     return t;
 }
 
+// Times the proof and signatures of an Orchard bundle paying nOutputs
+// recipients, which is what dominates building a large z_sendmany payout.
+double benchmark_create_orchard_bundle(size_t nOutputs)
+{
+    RawHDSeed seed(32, 0);
+    GetRandBytes(seed.data(), seed.size());
+    auto to = libzcash::OrchardSpendingKey::ForAccount(seed, Params().BIP44CoinType(), 0)
+        .ToFullViewingKey()
+        .GetChangeAddress();
+
+    auto builder = orchard::Builder(false, OrchardMerkleFrontier::empty_root());
+    for (size_t i = 0; i < nOutputs; i++) {
+        builder.AddOutput(std::nullopt, to, GetRand(MAX_MONEY / nOutputs), std::nullopt);
+    }
+    auto bundle = builder.Build().value();
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+
+    auto result = bundle.ProveAndSign({}, uint256());
+    assert(result.has_value());
+
+    double t = timer_stop(tv_start);
+    return t;
+}
+
 // Verify Sapling spend from testnet
 // txid: abbd823cbd3d4e3b52023599d81a96b74817e95ce5bb58354f979156bd22ecc8
 // position: 0
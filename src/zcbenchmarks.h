@@ -4,6 +4,8 @@
 #include <sys/time.h>
 #include <stdlib.h>
 
+#include <univalue.h>
+
 extern double benchmark_sleep();
 extern double benchmark_create_joinsplit();
 extern std::vector<double> benchmark_create_joinsplit_threaded(int nThreads);
@@ -12,18 +14,28 @@ extern std::vector<double> benchmark_solve_equihash_threaded(int nThreads);
 extern double benchmark_verify_joinsplit(const JSDescription &joinsplit);
 extern double benchmark_verify_equihash();
 extern double benchmark_large_tx(size_t nInputs);
+extern double benchmark_build_transparent_tx(size_t nInputs);
 extern double benchmark_try_decrypt_sprout_notes(size_t nAddrs);
 extern double benchmark_try_decrypt_sapling_notes(size_t nAddrs);
+extern double benchmark_try_decrypt_orchard_notes(size_t nAddrs);
 extern double benchmark_increment_sprout_note_witnesses(size_t nTxs);
 extern double benchmark_increment_sapling_note_witnesses(size_t nTxs);
 extern double benchmark_connectblock_slow();
 extern double benchmark_connectblock_sapling();
 extern double benchmark_connectblock_orchard();
+extern double benchmark_replay_blocks(int nStartHeight, int nEndHeight, UniValue& details);
+extern double benchmark_history_tree_update(size_t nBlocks);
 extern double benchmark_sendtoaddress(CAmount amount);
 extern double benchmark_loadwallet();
 extern double benchmark_listunspent();
+extern double benchmark_z_listunspent();
+extern double benchmark_getbalanceforaccounts();
+extern double benchmark_select_notes();
+extern double benchmark_setbestchain();
+extern double benchmark_rescan_wallet();
 extern double benchmark_create_sapling_spend();
 extern double benchmark_create_sapling_output();
+extern double benchmark_create_orchard_bundle(size_t nOutputs);
 extern double benchmark_verify_sapling_spend();
 extern double benchmark_verify_sapling_output();
 
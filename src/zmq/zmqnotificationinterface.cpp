@@ -39,6 +39,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubhashblock"] = CZMQAbstractNotifier::Create<CZMQPublishHashBlockNotifier>;
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
+    factories["pubrawblockheader"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockHeaderNotifier>;
+    factories["pubcompactblock"] = CZMQAbstractNotifier::Create<CZMQPublishCompactBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubcheckedblock"] = CZMQAbstractNotifier::Create<CZMQPublishCheckedBlockNotifier>;
 
@@ -52,6 +54,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            std::map<std::string, std::string>::const_iterator k = args.find("-zmq" + i->first + "hwm");
+            if (k != args.end())
+            {
+                notifier->SetOutboundMessageHighWaterMark(atoi(k->second));
+            }
             notifiers.push_back(notifier);
         }
     }
@@ -109,6 +116,7 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    CZMQAbstractPublishNotifier::StartPublishing();
     return true;
 }
 
@@ -118,6 +126,7 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        CZMQAbstractPublishNotifier::StopPublishing();
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
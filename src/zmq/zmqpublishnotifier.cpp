@@ -3,62 +3,84 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or https://www.opensource.org/licenses/mit-license.php .
 
+#include "blockencodings.h"
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "sync.h"
 #include "util/system.h"
 
-static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
+static const char *MSG_RAWBLOCKHEADER = "rawblockheader";
+static const char *MSG_COMPACTBLOCK = "compactblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_CHECKEDBLOCK = "checkedblock";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+namespace {
+struct CZMQQueuedMessage
 {
-    va_list args;
-    va_start(args, size);
-
-    while (1)
-    {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
+    CZMQAbstractPublishNotifier* notifier;
+    const char* command;
+    uint32_t nSequence;
+    size_t nSize;
+    CZMQBodyFn makeBody;
+};
+}
 
-        data = va_arg(args, const void*);
+/** Guards the queue and the notifiers' counters and registry */
+static Mutex cs_publish;
+static std::condition_variable condPublish;
+static std::deque<CZMQQueuedMessage> publishQueue GUARDED_BY(cs_publish);
+static size_t nPublishQueueBytes GUARDED_BY(cs_publish) = 0;
+static bool fPublishing GUARDED_BY(cs_publish) = false;
+static std::thread threadPublish;
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
-        {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            return -1;
-        }
+static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers GUARDED_BY(cs_publish);
 
-        zmq_msg_close(&msg);
+// Internal function to send one part of a multipart message
+static int zmq_send_part(void *sock, zmq_msg_t *msg, int flags)
+{
+    int rc = zmq_msg_send(msg, sock, flags);
+    zmq_msg_close(msg);
+    if (rc == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        return -1;
+    }
+    return 0;
+}
 
-        if (!data)
-            break;
+// Internal function to send one part copied from data
+static int zmq_send_copy(void *sock, const void* data, size_t size, int flags)
+{
+    zmq_msg_t msg;
 
-        size = va_arg(args, size_t);
+    int rc = zmq_msg_init_size(&msg, size);
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
     }
-    return 0;
+    memcpy(zmq_msg_data(&msg), data, size);
+    return zmq_send_part(sock, &msg, flags);
+}
+
+// Releases a message body once ZMQ is done with it
+static void zmq_free_body(void * /*data*/, void *hint)
+{
+    delete static_cast<std::shared_ptr<const void>*>(hint);
 }
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
+    LOCK(cs_publish);
 
     // check if address is being used by other publish notifier
     std::multimap<std::string, CZMQAbstractPublishNotifier*>::iterator i = mapPublishNotifiers.find(address);
@@ -72,7 +94,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint("zmq", "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -98,6 +130,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
+    LOCK(cs_publish);
 
     int count = mapPublishNotifiers.count(address);
 
@@ -125,21 +158,132 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
+bool CZMQAbstractPublishNotifier::Queue(const char *command, CZMQBodyFn makeBody, size_t nSize)
+{
+    LOCK(cs_publish);
+    uint32_t nSequenceQueued = nSequence++;
+    if (!fPublishing || publishQueue.size() >= MAX_ZMQ_QUEUE_MESSAGES ||
+        nPublishQueueBytes + nSize > MAX_ZMQ_QUEUE_BYTES)
+    {
+        nDropped++;
+        LogPrint("zmq", "zmq: Dropped %s message %u, publish queue full\n", command, nSequenceQueued);
+        return true;
+    }
+    publishQueue.push_back({this, command, nSequenceQueued, nSize, std::move(makeBody)});
+    nPublishQueueBytes += nSize;
+    condPublish.notify_one();
+    return true;
+}
+
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    auto buf = std::make_shared<std::string>(static_cast<const char*>(data), size);
+    return Queue(command, [buf](CZMQMessageBody& body) {
+        body.data = buf;
+        body.pbegin = buf->data();
+        body.pend = buf->data() + buf->size();
+        return true;
+    }, size);
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, CZMQBodyFn makeBody)
+{
+    // Nothing is held while the message waits, so it takes no queue bytes.
+    return Queue(command, std::move(makeBody), 0);
+}
+
+bool CZMQAbstractPublishNotifier::Send(const char *command, const CZMQMessageBody& body, uint32_t nSequenceIn)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
+    if (zmq_send_copy(psocket, command, strlen(command), ZMQ_SNDMORE) == -1)
         return false;
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    // The body is handed to ZMQ as it is, and released once sent.
+    zmq_msg_t msg;
+    auto holder = new std::shared_ptr<const void>(body.data);
+    int rc = zmq_msg_init_data(&msg, const_cast<char*>(body.pbegin), body.pend - body.pbegin, zmq_free_body, holder);
+    if (rc != 0)
+    {
+        delete holder;
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    if (zmq_send_part(psocket, &msg, ZMQ_SNDMORE) == -1)
+        return false;
 
-    return true;
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequenceIn);
+    return zmq_send_copy(psocket, msgseq, sizeof(msgseq), 0) == 0;
+}
+
+void CZMQAbstractPublishNotifier::ThreadPublish()
+{
+    RenameThread("zc-zmqpublish");
+    while (true)
+    {
+        CZMQQueuedMessage msg;
+        {
+            WAIT_LOCK(cs_publish, lock);
+            while (fPublishing && publishQueue.empty())
+                condPublish.wait(lock);
+            if (!fPublishing)
+                return;
+            msg = std::move(publishQueue.front());
+            publishQueue.pop_front();
+            nPublishQueueBytes -= msg.nSize;
+        }
+
+        CZMQMessageBody body;
+        if (!msg.makeBody(body) || !msg.notifier->Send(msg.command, body, msg.nSequence))
+        {
+            LOCK(cs_publish);
+            msg.notifier->nDropped++;
+            LogPrint("zmq", "zmq: Dropped %s message %u, unable to send\n", msg.command, msg.nSequence);
+        }
+    }
+}
+
+void CZMQAbstractPublishNotifier::StartPublishing()
+{
+    {
+        LOCK(cs_publish);
+        assert(!fPublishing);
+        fPublishing = true;
+    }
+    threadPublish = std::thread(&CZMQAbstractPublishNotifier::ThreadPublish);
+}
+
+void CZMQAbstractPublishNotifier::StopPublishing()
+{
+    {
+        LOCK(cs_publish);
+        if (!fPublishing)
+            return;
+        fPublishing = false;
+        condPublish.notify_all();
+    }
+    threadPublish.join();
+
+    LOCK(cs_publish);
+    for (const CZMQQueuedMessage& msg : publishQueue)
+        msg.notifier->nDropped++;
+    publishQueue.clear();
+    nPublishQueueBytes = 0;
+}
+
+std::vector<CZMQPublishStats> CZMQAbstractPublishNotifier::GetStats()
+{
+    LOCK(cs_publish);
+    std::vector<CZMQPublishStats> stats;
+    for (const auto& entry : mapPublishNotifiers)
+    {
+        const CZMQAbstractPublishNotifier* notifier = entry.second;
+        stats.push_back({notifier->GetType(), notifier->GetAddress(), notifier->GetOutboundMessageHighWaterMark(),
+                         notifier->nSequence, notifier->nDropped});
+    }
+    return stats;
 }
 
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
@@ -164,23 +308,65 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
-    LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
+    uint256 hash = pindex->GetBlockHash();
+    LogPrint("zmq", "zmq: Publish rawblock %s\n", hash.GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        pos = pindex->GetBlockPos();
+    }
+
+    // The block is sent as it is stored, straight from the mapped block file
+    // if possible, and read only once it is its turn to be sent.
+    return SendMessage(MSG_RAWBLOCK, [pos, hash](CZMQMessageBody& body) {
+        std::shared_ptr<const void> raw = ReadRawBlockFromDisk(pos, body.pbegin, body.pend);
+        if (!raw || GetRawBlockHash(body.pbegin, body.pend) != hash)
         {
             zmqError("Can't read block from disk");
             return false;
         }
+        body.data = std::move(raw);
+        return true;
+    });
+}
 
-        ss << block;
+bool CZMQPublishRawBlockHeaderNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint("zmq", "zmq: Publish rawblockheader %s\n", pindex->GetBlockHash().GetHex());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHeader();
+    return SendMessage(MSG_RAWBLOCKHEADER, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishCompactBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    LogPrint("zmq", "zmq: Publish compactblock %s\n", hash.GetHex());
+
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    // A BIP 152 cmpctblock message, built on the publishing thread.
+    return SendMessage(MSG_COMPACTBLOCK, [pos, hash](CZMQMessageBody& body) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos, Params().GetConsensus()) || block.GetHash() != hash)
+        {
+            zmqError("Can't read block from disk");
+            return false;
+        }
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CBlockHeaderAndShortTxIDs(block);
+        auto buf = std::make_shared<std::string>(ss.str());
+        body.data = buf;
+        body.pbegin = buf->data();
+        body.pend = buf->data() + buf->size();
+        return true;
+    });
 }
 
 bool CZMQPublishCheckedBlockNotifier::NotifyBlock(const CBlock& block)
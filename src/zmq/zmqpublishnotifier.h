@@ -8,25 +8,78 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 
+/** Most messages waiting to be published, over all notifiers */
+static const size_t MAX_ZMQ_QUEUE_MESSAGES = 10000;
+/** Most bytes of prepared message bodies waiting to be published */
+static const size_t MAX_ZMQ_QUEUE_BYTES = 128 * 1024 * 1024;
+
+/** The body of a message: [pbegin, pend), kept alive by data until sent. */
+struct CZMQMessageBody
+{
+    std::shared_ptr<const void> data;
+    const char* pbegin = nullptr;
+    const char* pend = nullptr;
+};
+
+/** Produces a message body on the publishing thread; false if it can't. */
+typedef std::function<bool(CZMQMessageBody&)> CZMQBodyFn;
+
+/** Counters of one notifier, as reported by getzmqnotifications */
+struct CZMQPublishStats
+{
+    std::string type;
+    std::string address;
+    int nHighWaterMark;
+    uint32_t nSequence;
+    uint64_t nDropped;
+};
+
+/**
+ * Notifiers only queue their messages; a single thread sends them, so that
+ * validation never waits on ZMQ, and because sockets may only be used by one
+ * thread at a time.
+ */
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
     uint32_t nSequence; //! upcounting per message sequence number
+    uint64_t nDropped; //! messages numbered but never sent
+
+    bool Queue(const char *command, CZMQBodyFn makeBody, size_t nSize);
+    bool Send(const char *command, const CZMQMessageBody& body, uint32_t nSequenceIn);
+
+    static void ThreadPublish();
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0), nDropped(0) {}
 
-    /* send zmq multipart message
+    /* queue zmq multipart message
        parts:
           * command
           * data
           * message sequence number
+       The message is numbered when it is queued. If the queue is full, or
+       the body can't be produced or sent, it is counted as dropped, and
+       subscribers see a gap in the sequence numbers.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* queue a message whose body is produced just before it is sent */
+    bool SendMessage(const char *command, CZMQBodyFn makeBody);
 
     bool Initialize(void *pcontext);
     void Shutdown();
+
+    /** Start the thread that sends queued messages */
+    static void StartPublishing();
+    /** Stop it, dropping messages not yet sent. Call before Shutdown. */
+    static void StopPublishing();
+    static std::vector<CZMQPublishStats> GetStats();
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
@@ -47,6 +100,18 @@ public:
     bool NotifyBlock(const CBlockIndex *pindex);
 };
 
+class CZMQPublishRawBlockHeaderNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex);
+};
+
+class CZMQPublishCompactBlockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex);
+};
+
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -0,0 +1,59 @@
+// Copyright (c) 2025 The Juno Cash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "util/strencodings.h"
+#include "zmq/zmqpublishnotifier.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"type\": \"pubhashtx\",          (string) Type of notification\n"
+            "    \"address\": \"...\",             (string) Address of the publisher\n"
+            "    \"hwm\": n,                     (numeric) Outbound message high water mark\n"
+            "    \"sequence\": n,                (numeric) Sequence number the next message will carry\n"
+            "    \"dropped\": n                  (numeric) Messages numbered but never sent, because the\n"
+            "                                          publish queue was full or the message could not be sent\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const CZMQPublishStats& stats : CZMQAbstractPublishNotifier::GetStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("type", stats.type);
+        obj.pushKV("address", stats.address);
+        obj.pushKV("hwm", stats.nHighWaterMark);
+        obj.pushKV("sequence", (int64_t)stats.nSequence);
+        obj.pushKV("dropped", (int64_t)stats.nDropped);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true  },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& tableRPC)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}